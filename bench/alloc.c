@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <fido.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+/*
+ * Count the allocations made by libfido2 and by libcbor on its behalf,
+ * through fido_set_allocator(); allocations made inside libcrypto and
+ * zlib are not counted. The counter is shared by all threads.
+ */
+
+static uint64_t	allocs;
+static int	counted;
+
+static void *
+bench_malloc(size_t size)
+{
+	__atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+
+	return (malloc(size));
+}
+
+static void *
+bench_calloc(size_t nmemb, size_t size)
+{
+	__atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+
+	return (calloc(nmemb, size));
+}
+
+static void *
+bench_realloc(void *ptr, size_t size)
+{
+	__atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+
+	return (realloc(ptr, size));
+}
+
+void
+bench_alloc_init(void)
+{
+	fido_allocator_t a;
+
+	memset(&a, 0, sizeof(a));
+	a.malloc = bench_malloc;
+	a.calloc = bench_calloc;
+	a.realloc = bench_realloc;
+	a.free = free;
+
+	counted = fido_set_allocator(&a) == FIDO_OK;
+}
+
+int
+bench_allocs_counted(void)
+{
+	return (counted);
+}
+
+uint64_t
+bench_allocs(void)
+{
+	return (__atomic_load_n(&allocs, __ATOMIC_RELAXED));
+}
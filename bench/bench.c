@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Microbenchmarks for libfido2's hot paths; none needs an authenticator.
+ *
+ * usage: bench [-b baseline] [-l us] [-r pct] [-t ms] [-w out] [name]
+ *
+ * Each benchmark whose name contains 'name' runs for at least 'ms'
+ * milliseconds (default 500), after one untimed run that warms up the
+ * library's caches. The virtual authenticator used by the e2e
+ * benchmarks takes 'us' microseconds to reply (default 0).
+ *
+ * With -w, the results are also written to 'out' in the format read
+ * by -b: one "name ns/op allocs/op" line per benchmark, '#' starting a
+ * comment. With -b, only the benchmarks listed in 'baseline' run, and
+ * bench exits with a non-zero status if any of them is more than 'pct'
+ * percent (default 25) slower than its baseline in each of three runs,
+ * or makes more than 'pct' percent more allocations per operation.
+ */
+
+#include <fido.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../openbsd-compat/openbsd-compat.h"
+#include "bench.h"
+#include "virtdev.h"
+
+#define BATCH_MAX	(1 << 16)
+#define BASE_MAX	128
+#define BASE_NAMELEN	64
+#define BASE_TRIES	3	/* runs before a regression is reported */
+
+struct base {
+	char	name[BASE_NAMELEN];
+	double	ns;
+	double	allocs;	/* < 0 if not counted */
+};
+
+static const char	*filter;
+static uint64_t		 min_ns = 500 * 1000000ULL;
+static struct base	 base[BASE_MAX];
+static size_t		 base_len;
+static int		 base_set;
+static double		 threshold = 25.0;
+static FILE		*out;
+static int		 regressed;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		err(1, "clock_gettime");
+
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+static void
+load_base(const char *path)
+{
+	FILE		*fp;
+	char		 line[256], name[BASE_NAMELEN], allocs[32];
+	char		*ep;
+	struct base	*b;
+	size_t		 lineno = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		err(1, "fopen %s", path);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		lineno++;
+		line[strcspn(line, "#\n")] = '\0';
+		if (line[strspn(line, " \t")] == '\0')
+			continue;
+		if (base_len == BASE_MAX)
+			errx(1, "%s:%zu: too many entries", path, lineno);
+		b = &base[base_len];
+		if (sscanf(line, "%63s %lf %31s", name, &b->ns, allocs) != 3 ||
+		    b->ns <= 0)
+			errx(1, "%s:%zu: invalid entry", path, lineno);
+		if (strcmp(allocs, "-") == 0)
+			b->allocs = -1;
+		else if ((b->allocs = strtod(allocs, &ep)) < 0 || *ep != '\0')
+			errx(1, "%s:%zu: invalid allocs/op", path, lineno);
+		memcpy(b->name, name, sizeof(b->name));
+		base_len++;
+	}
+	if (ferror(fp))
+		err(1, "%s", path);
+	fclose(fp);
+	base_set = 1;
+}
+
+static const struct base *
+find_base(const char *name)
+{
+	for (size_t i = 0; i < base_len; i++)
+		if (strcmp(base[i].name, name) == 0)
+			return (&base[i]);
+
+	return (NULL);
+}
+
+static void
+check_base(const struct base *b, double ns, double allocs)
+{
+	double	limit = 1.0 + threshold / 100.0;
+
+	if (ns > b->ns * limit) {
+		printf("%-32s regressed: %.1f ns/op, baseline %.1f\n",
+		    b->name, ns, b->ns);
+		regressed = 1;
+	}
+	/* allocations are counted, not sampled; allow for rounding only */
+	if (allocs >= 0 && b->allocs >= 0 &&
+	    allocs > b->allocs * limit + 0.005) {
+		printf("%-32s regressed: %.2f allocs/op, baseline %.2f\n",
+		    b->name, allocs, b->allocs);
+		regressed = 1;
+	}
+}
+
+/* time 'op' for at least min_ns */
+static void
+measure(const char *name, int (*op)(void *), void *arg, size_t nops,
+    double *ns_op, double *allocs_op, uint64_t *nout)
+{
+	uint64_t	t0, ns, n = 0, batch = 1, allocs;
+
+	allocs = bench_allocs();
+	t0 = now_ns();
+	do {
+		for (uint64_t i = 0; i < batch; i++)
+			if (op(arg) != 0)
+				errx(1, "%s: failed", name);
+		n += batch;
+		if (batch < BATCH_MAX)
+			batch *= 2;
+	} while ((ns = now_ns() - t0) < min_ns);
+	allocs = bench_allocs() - allocs;
+
+	n *= nops;
+	*ns_op = (double)ns / (double)n;
+	*allocs_op = -1;
+	if (bench_allocs_counted())
+		*allocs_op = (double)allocs / (double)n;
+	*nout = n;
+}
+
+void
+bench_run_batch(const char *name, int (*op)(void *), void *arg,
+    size_t nops)
+{
+	const struct base	*b = NULL;
+	uint64_t		 n, retry_n;
+	double			 ns_op, allocs_op, retry_ns, retry_allocs;
+
+	if (filter != NULL && strstr(name, filter) == NULL)
+		return;
+	if (base_set && (b = find_base(name)) == NULL)
+		return;
+	if (op(arg) != 0)
+		errx(1, "%s: failed", name);
+
+	measure(name, op, arg, nops, &ns_op, &allocs_op, &n);
+	/*
+	 * A single run is easily slowed down by the rest of the host; before
+	 * calling a regression, keep the fastest of a few.
+	 */
+	for (int i = 1; i < BASE_TRIES && b != NULL &&
+	    ns_op > b->ns * (1.0 + threshold / 100.0); i++) {
+		measure(name, op, arg, nops, &retry_ns, &retry_allocs,
+		    &retry_n);
+		if (retry_ns < ns_op) {
+			ns_op = retry_ns;
+			allocs_op = retry_allocs;
+			n = retry_n;
+		}
+	}
+
+	printf("%-32s %12.1f ns/op", name, ns_op);
+	if (allocs_op >= 0)
+		printf(" %8.2f allocs/op", allocs_op);
+	else
+		printf(" %8s allocs/op", "-");
+	printf(" %10" PRIu64 " ops\n", n);
+	if (out != NULL) {
+		fprintf(out, "%-32s %12.1f", name, ns_op);
+		if (allocs_op >= 0)
+			fprintf(out, " %8.2f\n", allocs_op);
+		else
+			fprintf(out, " %8s\n", "-");
+	}
+	if (b != NULL)
+		check_base(b, ns_op, allocs_op);
+	fflush(stdout);
+}
+
+void
+bench_run(const char *name, int (*op)(void *), void *arg)
+{
+	bench_run_batch(name, op, arg, 1);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bench [-b baseline] [-l us] [-r pct] [-t ms] "
+	    "[-w out] [name]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	char	*ep;
+	long	 n;
+	int	 ch;
+
+	while ((ch = getopt(argc, argv, "b:l:r:t:w:")) != -1) {
+		switch (ch) {
+		case 'b':
+			load_base(optarg);
+			break;
+		case 'l':
+			n = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || n < 0 ||
+			    n > 10000000)
+				errx(1, "-l: invalid argument");
+			virtdev_set_latency((unsigned int)n);
+			break;
+		case 't':
+			n = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || n < 1 ||
+			    n > 3600000)
+				errx(1, "-t: invalid argument");
+			min_ns = (uint64_t)n * 1000000ULL;
+			break;
+		case 'r':
+			n = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || n < 0 ||
+			    n > 1000)
+				errx(1, "-r: invalid argument");
+			threshold = (double)n;
+			break;
+		case 'w':
+			if ((out = fopen(optarg, "w")) == NULL)
+				err(1, "fopen %s", optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc > 1)
+		usage();
+	if (argc == 1)
+		filter = argv[0];
+
+	bench_alloc_init();
+	fido_init(0);
+
+	bench_verify();
+	bench_cbor();
+	bench_largeblob();
+	bench_hid();
+	bench_e2e();
+
+	if (out != NULL && fclose(out) != 0)
+		err(1, "fclose");
+
+	exit(regressed ? EXIT_FAILURE : 0);
+}
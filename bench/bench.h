@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Time 'op' on 'arg' under 'name' and report ns/op and allocations/op.
+ * 'op' returns 0 on success; a failing op aborts the benchmark.
+ */
+void bench_run(const char *, int (*)(void *), void *);
+
+/* as bench_run(), for an 'op' that performs 'n' operations per call */
+void bench_run_batch(const char *, int (*)(void *), void *, size_t);
+
+/* the benchmark groups */
+void bench_cbor(void);
+void bench_e2e(void);
+void bench_hid(void);
+void bench_largeblob(void);
+void bench_verify(void);
+
+/* allocations made through the library's allocator; see alloc.c */
+void bench_alloc_init(void);
+uint64_t bench_allocs(void);
+int bench_allocs_counted(void);
+
+#endif /* !_BENCH_H */
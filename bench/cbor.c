@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * CBOR encoding of authenticatorMakeCredential and authenticatorGetAssertion
+ * requests, and decoding of their replies, as done by fido_dev_make_cred()
+ * and fido_dev_get_assert() around the transport.
+ */
+
+#define _FIDO_INTERNAL
+
+#include <fido.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../fuzz/wiredata_fido2.h"
+#include "bench.h"
+
+#define REPORT_LEN	64
+
+static const unsigned char cdh[32] = {
+	0xec, 0x8d, 0x8f, 0x78, 0x42, 0x4a, 0x2b, 0xb7,
+	0x82, 0x34, 0xaa, 0xca, 0x07, 0xa1, 0xf6, 0x56,
+	0x42, 0x1c, 0xb6, 0xf6, 0xb3, 0x00, 0x86, 0x52,
+	0x35, 0x2d, 0xa2, 0x62, 0x4a, 0xbe, 0x89, 0x76,
+};
+
+static const unsigned char user_id[32] = {
+	0x78, 0x1c, 0x78, 0x60, 0xad, 0x88, 0xd2, 0x63,
+	0x32, 0x62, 0x2a, 0xf1, 0x74, 0x5d, 0xed, 0xb2,
+	0xe7, 0xa4, 0x2b, 0x44, 0x89, 0x29, 0x39, 0xc5,
+	0x56, 0x64, 0x01, 0x27, 0x0d, 0xbb, 0xc4, 0x49,
+};
+
+static const unsigned char wire_cred[] = { WIREDATA_CTAP_CBOR_CRED };
+static const unsigned char wire_assert[] = { WIREDATA_CTAP_CBOR_ASSERT };
+
+struct reply {
+	unsigned char	*ptr;
+	size_t		 len;
+};
+
+/* reassemble the CTAPHID message in a sequence of frames */
+static int
+unframe(struct reply *r, const unsigned char *wire, size_t len)
+{
+	size_t hdr, n, off = 0;
+
+	memset(r, 0, sizeof(*r));
+
+	if (len < REPORT_LEN)
+		return (-1);
+	r->len = (size_t)wire[5] << 8 | wire[6];
+	if ((r->ptr = calloc(1, r->len)) == NULL)
+		return (-1);
+
+	for (size_t i = 0; off < r->len; i += REPORT_LEN) {
+		if (i + REPORT_LEN > len) {
+			free(r->ptr);
+			return (-1);
+		}
+		hdr = i == 0 ? 7 : 5; /* cid, cmd, bcnt; or cid, seq */
+		if ((n = REPORT_LEN - hdr) > r->len - off)
+			n = r->len - off;
+		memcpy(r->ptr + off, wire + i + hdr, n);
+		off += n;
+	}
+
+	return (0);
+}
+
+static int
+encode_cred(void *arg)
+{
+	fido_cred_t	*cred = arg;
+	cbor_item_t	*argv[9];
+	fido_blob_t	 f;
+	int		 ok;
+
+	memset(argv, 0, sizeof(argv));
+	memset(&f, 0, sizeof(f));
+
+	ok = cbor_build_cred_frame(cred, cred->uv, argv, &f);
+
+	cbor_vector_free(argv, nitems(argv));
+	free(f.ptr);
+
+	return (ok);
+}
+
+static int
+encode_assert(void *arg)
+{
+	fido_assert_t	*assert = arg;
+	cbor_item_t	*argv[7];
+	fido_blob_t	 f;
+	size_t		 cdh_off;
+	int		 ok = -1;
+
+	memset(argv, 0, sizeof(argv));
+	memset(&f, 0, sizeof(f));
+
+	/* fido_dev_get_assert() encodes the allow list once per assertion */
+	fido_blob_reset(&assert->allow_cbor);
+	if (cbor_encode_pubkey_list(&assert->allow_list,
+	    &assert->allow_cbor) < 0)
+		goto fail;
+
+	ok = cbor_build_assert_frame(assert, assert->uv, argv, &f, &cdh_off);
+fail:
+	cbor_vector_free(argv, nitems(argv));
+	free(f.ptr);
+
+	return (ok);
+}
+
+/* as parse_makecred_reply() in src/cred.c */
+static int
+parse_cred(const cbor_item_t *key, const cbor_item_t *val, void *arg)
+{
+	fido_cred_t *cred = arg;
+
+	if (cbor_isa_uint(key) == false ||
+	    cbor_int_get_width(key) != CBOR_INT_8)
+		return (0);
+
+	switch (cbor_get_uint8(key)) {
+	case 1:
+		return (cbor_decode_fmt(val, &cred->fmt));
+	case 2:
+		if (fido_blob_decode(val, &cred->authdata_raw) < 0)
+			return (-1);
+		return (cbor_decode_cred_authdata(val, cred->type,
+		    &cred->authdata_cbor, &cred->authdata, &cred->attcred,
+		    &cred->authdata_ext));
+	case 3:
+		return (cbor_decode_attstmt(val, &cred->attstmt));
+	case 5:
+		return (fido_blob_decode(val, &cred->largeblob_key));
+	default:
+		return (0);
+	}
+}
+
+struct decode_cred {
+	fido_cred_t	*cred;
+	struct reply	 reply;
+};
+
+static int
+decode_cred(void *arg)
+{
+	struct decode_cred *d = arg;
+
+	fido_cred_reset_rx(d->cred);
+
+	return (cbor_parse_reply(d->reply.ptr, d->reply.len, d->cred,
+	    parse_cred) == FIDO_OK ? 0 : -1);
+}
+
+struct decode_assert {
+	fido_assert_t	*assert;
+	struct reply	 reply;
+};
+
+static int
+decode_assert(void *arg)
+{
+	struct decode_assert	*d = arg;
+	fido_assert_t		*assert = d->assert;
+	uint64_t		 n = 1;
+
+	fido_assert_reset_rx(assert);
+
+	if ((assert->stmt = calloc(1, sizeof(fido_assert_stmt))) == NULL)
+		return (-1);
+	assert->stmt_cnt = 1;
+	assert->stmt_len = 1;
+
+	return (cbor_parse_assert_reply(d->reply.ptr, d->reply.len,
+	    &assert->stmt[0], &n, 0) == FIDO_OK ? 0 : -1);
+}
+
+static fido_cred_t *
+cred_new(void)
+{
+	fido_cred_t	*cred;
+	unsigned char	 id[64];
+
+	if ((cred = fido_cred_new()) == NULL ||
+	    fido_cred_set_type(cred, COSE_ES256) != FIDO_OK ||
+	    fido_cred_set_clientdata_hash(cred, cdh, sizeof(cdh)) != FIDO_OK ||
+	    fido_cred_set_rp(cred, "localhost",
+	    "sweet home localhost") != FIDO_OK ||
+	    fido_cred_set_user(cred, user_id, sizeof(user_id), "john smith",
+	    "jsmith", NULL) != FIDO_OK ||
+	    fido_cred_set_rk(cred, FIDO_OPT_TRUE) != FIDO_OK) {
+		fido_cred_free(&cred);
+		return (NULL);
+	}
+
+	for (size_t i = 0; i < 4; i++) {
+		memset(id, (int)i, sizeof(id));
+		if (fido_cred_exclude(cred, id, sizeof(id)) != FIDO_OK) {
+			fido_cred_free(&cred);
+			return (NULL);
+		}
+	}
+
+	return (cred);
+}
+
+static fido_assert_t *
+assert_new(void)
+{
+	fido_assert_t	*assert;
+	unsigned char	 id[64];
+
+	if ((assert = fido_assert_new()) == NULL ||
+	    fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) != FIDO_OK ||
+	    fido_assert_set_rp(assert, "localhost") != FIDO_OK ||
+	    fido_assert_set_up(assert, FIDO_OPT_TRUE) != FIDO_OK) {
+		fido_assert_free(&assert);
+		return (NULL);
+	}
+
+	for (size_t i = 0; i < 4; i++) {
+		memset(id, (int)i, sizeof(id));
+		if (fido_assert_allow_cred(assert, id, sizeof(id)) != FIDO_OK) {
+			fido_assert_free(&assert);
+			return (NULL);
+		}
+	}
+
+	return (assert);
+}
+
+void
+bench_cbor(void)
+{
+	fido_cred_t		*cred;
+	fido_assert_t		*assert;
+	struct decode_cred	 dc;
+	struct decode_assert	 da;
+
+	if ((cred = cred_new()) == NULL || (assert = assert_new()) == NULL)
+		errx(1, "%s: setup", __func__);
+
+	bench_run("cbor/makecred-encode", encode_cred, cred);
+	bench_run("cbor/getassert-encode", encode_assert, assert);
+
+	fido_cred_free(&cred);
+	fido_assert_free(&assert);
+
+	memset(&dc, 0, sizeof(dc));
+	memset(&da, 0, sizeof(da));
+
+	if ((dc.cred = fido_cred_new()) == NULL ||
+	    fido_cred_set_type(dc.cred, COSE_ES256) != FIDO_OK ||
+	    unframe(&dc.reply, wire_cred, sizeof(wire_cred)) < 0 ||
+	    (da.assert = fido_assert_new()) == NULL ||
+	    unframe(&da.reply, wire_assert, sizeof(wire_assert)) < 0)
+		errx(1, "%s: setup", __func__);
+
+	bench_run("cbor/makecred-decode", decode_cred, &dc);
+	bench_run("cbor/getassert-decode", decode_assert, &da);
+
+	fido_cred_free(&dc.cred);
+	fido_assert_free(&da.assert);
+	free(dc.reply.ptr);
+	free(da.reply.ptr);
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * End-to-end fido_dev_open() and fido_dev_get_assert() against the
+ * virtual authenticator, from one thread and from several at once.
+ */
+
+#include <fido.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../openbsd-compat/openbsd-compat.h"
+#include "bench.h"
+#include "virtdev.h"
+
+#define ASSERTS_PER_THREAD	32
+#define THREADS_MAX		16
+
+static const unsigned char cdh[32] = {
+	0xec, 0x8d, 0x8f, 0x78, 0x42, 0x4a, 0x2b, 0xb7,
+	0x82, 0x34, 0xaa, 0xca, 0x07, 0xa1, 0xf6, 0x56,
+	0x42, 0x1c, 0xb6, 0xf6, 0xb3, 0x00, 0x86, 0x52,
+	0x35, 0x2d, 0xa2, 0x62, 0x4a, 0xbe, 0x89, 0x76,
+};
+
+struct worker {
+	pthread_t	 thread;
+	fido_dev_t	*dev;
+	fido_assert_t	*assert;
+	int		 ok;
+};
+
+static fido_dev_t *
+dev_open(void)
+{
+	fido_dev_io_t	 io;
+	fido_dev_t	*dev;
+
+	virtdev_io(&io);
+
+	if ((dev = fido_dev_new()) == NULL ||
+	    fido_dev_set_io_functions(dev, &io) != FIDO_OK ||
+	    fido_dev_open(dev, "virtdev") != FIDO_OK) {
+		fido_dev_free(&dev);
+		return (NULL);
+	}
+
+	return (dev);
+}
+
+static fido_assert_t *
+assert_new(void)
+{
+	fido_assert_t *assert;
+
+	if ((assert = fido_assert_new()) == NULL ||
+	    fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) != FIDO_OK ||
+	    fido_assert_set_rp(assert, "localhost") != FIDO_OK)
+		fido_assert_free(&assert);
+
+	return (assert);
+}
+
+static int
+open_close(void *arg)
+{
+	fido_dev_t *dev;
+
+	(void)arg;
+
+	if ((dev = dev_open()) == NULL)
+		return (-1);
+
+	fido_dev_close(dev);
+	fido_dev_free(&dev);
+
+	return (0);
+}
+
+static int
+get_assert(void *arg)
+{
+	struct worker *w = arg;
+
+	return (fido_dev_get_assert(w->dev, w->assert, NULL) == FIDO_OK &&
+	    fido_assert_count(w->assert) == 1 ? 0 : -1);
+}
+
+static int
+open_get_assert(void *arg)
+{
+	struct worker	*w = arg;
+	int		 ok;
+
+	if ((w->dev = dev_open()) == NULL)
+		return (-1);
+
+	ok = get_assert(w);
+
+	fido_dev_close(w->dev);
+	fido_dev_free(&w->dev);
+
+	return (ok);
+}
+
+static void *
+worker_main(void *arg)
+{
+	struct worker *w = arg;
+
+	w->ok = 0;
+	for (size_t i = 0; i < ASSERTS_PER_THREAD; i++)
+		if (get_assert(w) < 0) {
+			w->ok = -1;
+			break;
+		}
+
+	return (NULL);
+}
+
+struct pool {
+	struct worker	w[THREADS_MAX];
+	size_t		n;
+};
+
+static int
+pool_run(void *arg)
+{
+	struct pool	*p = arg;
+	size_t		 started;
+	int		 ok = 0;
+
+	for (started = 0; started < p->n; started++)
+		if (pthread_create(&p->w[started].thread, NULL, worker_main,
+		    &p->w[started]) != 0) {
+			ok = -1;
+			break;
+		}
+	for (size_t i = 0; i < started; i++) {
+		if (pthread_join(p->w[i].thread, NULL) != 0)
+			ok = -1;
+		if (p->w[i].ok < 0)
+			ok = -1;
+	}
+
+	return (ok);
+}
+
+static int
+worker_setup(struct worker *w)
+{
+	memset(w, 0, sizeof(*w));
+
+	return ((w->dev = dev_open()) == NULL ||
+	    (w->assert = assert_new()) == NULL ? -1 : 0);
+}
+
+static void
+worker_teardown(struct worker *w)
+{
+	if (w->dev != NULL) {
+		fido_dev_close(w->dev);
+		fido_dev_free(&w->dev);
+	}
+	fido_assert_free(&w->assert);
+}
+
+void
+bench_e2e(void)
+{
+	static const size_t	 threads[] = { 1, 4, THREADS_MAX };
+	static struct pool	 p;
+	struct worker		 w;
+	char			 name[64];
+
+	bench_run("e2e/open-close", open_close, NULL);
+
+	if (worker_setup(&w) < 0)
+		errx(1, "%s: worker_setup", __func__);
+	bench_run("e2e/get_assert", get_assert, &w);
+	worker_teardown(&w);
+
+	if ((w.assert = assert_new()) == NULL)
+		errx(1, "%s: assert_new", __func__);
+	bench_run("e2e/open-get_assert-close", open_get_assert, &w);
+	fido_assert_free(&w.assert);
+
+	/* ns/op is per assertion, across all threads */
+	for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+		p.n = threads[i];
+		for (size_t j = 0; j < p.n; j++)
+			if (worker_setup(&p.w[j]) < 0)
+				errx(1, "%s: worker_setup", __func__);
+		snprintf(name, sizeof(name), "e2e/get_assert-%zuthreads",
+		    p.n);
+		bench_run_batch(name, pool_run, &p, p.n * ASSERTS_PER_THREAD);
+		for (size_t j = 0; j < p.n; j++)
+			worker_teardown(&p.w[j]);
+	}
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * CTAPHID fragmentation by fido_tx() and reassembly by fido_rx() over an
+ * in-memory device that replays recorded frames, as in regress/dev.c.
+ */
+
+#define _FIDO_INTERNAL
+
+#include <fido.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../fuzz/wiredata_fido2.h"
+#include "bench.h"
+
+#define REPORT_LEN	(64 + 1)
+
+static int		 fake_dev_handle;
+static unsigned char	 ctap_nonce[8];
+static unsigned char	*replay_ptr;
+static size_t		 replay_len;
+static size_t		 replay_off;
+static int		 initialised;
+
+static void *
+dummy_open(const char *path)
+{
+	(void)path;
+
+	return (&fake_dev_handle);
+}
+
+static void
+dummy_close(void *handle)
+{
+	(void)handle;
+}
+
+/* hand out the replay buffer a report at a time, starting over at its end */
+static int
+dummy_read(void *handle, unsigned char *ptr, size_t len, int ms)
+{
+	(void)handle;
+	(void)ms;
+
+	if (replay_ptr == NULL || len != REPORT_LEN - 1 ||
+	    replay_len < len || replay_len % len != 0)
+		return (-1);
+
+	if (!initialised) {
+		memcpy(&replay_ptr[7], ctap_nonce, sizeof(ctap_nonce));
+		initialised = 1;
+	}
+
+	memcpy(ptr, replay_ptr + replay_off, len);
+	replay_off = (replay_off + len) % replay_len;
+
+	return ((int)len);
+}
+
+static int
+dummy_write(void *handle, const unsigned char *ptr, size_t len)
+{
+	(void)handle;
+
+	if (len != REPORT_LEN)
+		return (-1);
+	if (!initialised)
+		memcpy(ctap_nonce, &ptr[8], sizeof(ctap_nonce));
+
+	return ((int)len);
+}
+
+static void
+replay(unsigned char *ptr, size_t len)
+{
+	replay_ptr = ptr;
+	replay_len = len;
+	replay_off = 0;
+}
+
+/* address the frames in ptr to the device's channel */
+static void
+set_cid(const fido_dev_t *dev, unsigned char *ptr, size_t len)
+{
+	for (size_t i = 0; i + REPORT_LEN - 1 <= len; i += REPORT_LEN - 1)
+		memcpy(&ptr[i], &dev->cid, sizeof(dev->cid));
+}
+
+static fido_dev_t *
+dev_open(void)
+{
+	static unsigned char	 data[] = {
+		WIREDATA_CTAP_INIT,
+		WIREDATA_CTAP_CBOR_INFO,
+	};
+	fido_dev_io_t		 io;
+	fido_dev_t		*dev;
+
+	memset(&io, 0, sizeof(io));
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	initialised = 0;
+	replay(data, sizeof(data));
+
+	if ((dev = fido_dev_new()) == NULL ||
+	    fido_dev_set_io_functions(dev, &io) != FIDO_OK ||
+	    fido_dev_open(dev, "bench") != FIDO_OK) {
+		fido_dev_free(&dev);
+		return (NULL);
+	}
+
+	return (dev);
+}
+
+struct tx {
+	fido_dev_t	*dev;
+	unsigned char	 buf[1024];
+};
+
+static int
+tx(void *arg)
+{
+	struct tx	*t = arg;
+	int		 ms = -1;
+
+	return (fido_tx(t->dev, CTAP_CMD_CBOR, t->buf, sizeof(t->buf),
+	    &ms) < 0 ? -1 : 0);
+}
+
+struct rx {
+	fido_dev_t	*dev;
+	unsigned char	 buf[FIDO_MAXMSG];
+};
+
+static int
+rx(void *arg)
+{
+	struct rx	*r = arg;
+	int		 ms = -1;
+
+	return (fido_rx(r->dev, CTAP_CMD_CBOR, r->buf, sizeof(r->buf),
+	    &ms) <= 0 ? -1 : 0);
+}
+
+void
+bench_hid(void)
+{
+	static unsigned char	 cred[] = { WIREDATA_CTAP_CBOR_CRED };
+	static unsigned char	 assert[] = { WIREDATA_CTAP_CBOR_ASSERT };
+	static struct tx	 t;
+	static struct rx	 r;
+	fido_dev_t		*dev;
+
+	if ((dev = dev_open()) == NULL)
+		errx(1, "%s: dev_open", __func__);
+
+	memset(t.buf, 0x2a, sizeof(t.buf));
+	t.dev = dev;
+	r.dev = dev;
+
+	set_cid(dev, cred, sizeof(cred));
+	set_cid(dev, assert, sizeof(assert));
+
+	bench_run("hid/tx-1k", tx, &t);
+
+	replay(cred, sizeof(cred));
+	bench_run("hid/rx-makecred", rx, &r);
+
+	replay(assert, sizeof(assert));
+	bench_run("hid/rx-getassert", rx, &r);
+
+	replay(NULL, 0);
+
+	fido_dev_close(dev);
+	fido_dev_free(&dev);
+}
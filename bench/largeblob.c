@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Sealing (compression, then AES-256-GCM) and opening of a largeBlob
+ * entry, as done by largeblob_seal() and largeblob_decrypt() followed by
+ * fido_uncompress() in src/largeblob.c.
+ */
+
+#define _FIDO_INTERNAL
+
+#include <fido.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+struct entry {
+	fido_blob_t	key;
+	fido_blob_t	body;
+	fido_blob_t	nonce;
+	fido_blob_t	ciphertext;
+	uint64_t	origsiz;
+};
+
+static int
+aad(fido_blob_t *out, uint64_t size)
+{
+	uint8_t buf[4 + sizeof(uint64_t)];
+
+	memcpy(buf, "blob", 4);
+	size = htole64(size);
+	memcpy(&buf[4], &size, sizeof(uint64_t));
+
+	return (fido_blob_set(out, buf, sizeof(buf)));
+}
+
+static int
+seal(void *arg)
+{
+	struct entry	*e = arg;
+	fido_blob_t	*plaintext = NULL, *ad = NULL;
+	int		 ok = -1;
+
+	fido_blob_reset(&e->ciphertext);
+
+	if ((plaintext = fido_blob_new()) == NULL ||
+	    (ad = fido_blob_new()) == NULL ||
+	    fido_compress(plaintext, &e->body) != FIDO_OK ||
+	    aad(ad, e->body.len) < 0 ||
+	    fido_get_random(e->nonce.ptr, e->nonce.len) < 0 ||
+	    aes256_gcm_enc(&e->key, &e->nonce, ad, plaintext,
+	    &e->ciphertext) < 0)
+		goto fail;
+
+	e->origsiz = e->body.len;
+
+	ok = 0;
+fail:
+	fido_blob_free(&plaintext);
+	fido_blob_free(&ad);
+
+	return (ok);
+}
+
+static int
+open_entry(void *arg)
+{
+	struct entry	*e = arg;
+	fido_blob_t	*plaintext = NULL, *ad = NULL, out;
+	int		 ok = -1;
+
+	memset(&out, 0, sizeof(out));
+
+	if ((plaintext = fido_blob_new()) == NULL ||
+	    (ad = fido_blob_new()) == NULL ||
+	    aad(ad, e->origsiz) < 0 ||
+	    aes256_gcm_dec(&e->key, &e->nonce, ad, &e->ciphertext,
+	    plaintext) < 0 ||
+	    fido_uncompress(&out, plaintext, (size_t)e->origsiz) != FIDO_OK ||
+	    out.len != e->body.len)
+		goto fail;
+
+	ok = 0;
+fail:
+	fido_blob_free(&plaintext);
+	fido_blob_free(&ad);
+	fido_blob_reset(&out);
+
+	return (ok);
+}
+
+/* a body that compresses about as well as structured application data */
+static int
+entry_setup(struct entry *e, size_t len)
+{
+	unsigned char	 key[32];
+	unsigned char	*body;
+	size_t		 n = 0;
+	int		 w;
+
+	memset(e, 0, sizeof(*e));
+	memset(key, 0x5a, sizeof(key));
+
+	if ((body = malloc(len + 64)) == NULL)
+		return (-1);
+	for (unsigned i = 0; n < len; i++) {
+		if ((w = snprintf((char *)body + n, 64,
+		    "{\"id\":%u,\"name\":\"entry-%08x\",\"seen\":%u},", i,
+		    i * 2654435761U, i * 40503U % 1000)) < 0) {
+			free(body);
+			return (-1);
+		}
+		n += (size_t)w;
+	}
+
+	if (fido_blob_set(&e->key, key, sizeof(key)) < 0 ||
+	    fido_blob_set(&e->body, body, len) < 0 ||
+	    fido_blob_set(&e->nonce, key, 12) < 0) {
+		free(body);
+		return (-1);
+	}
+
+	free(body);
+
+	return (seal(e));
+}
+
+static void
+entry_reset(struct entry *e)
+{
+	fido_blob_reset(&e->key);
+	fido_blob_reset(&e->body);
+	fido_blob_reset(&e->nonce);
+	fido_blob_reset(&e->ciphertext);
+}
+
+void
+bench_largeblob(void)
+{
+	static const struct {
+		const char	*seal;
+		const char	*open;
+		size_t		 len;
+	} size[] = {
+		{ "largeblob/seal-1k", "largeblob/open-1k", 1024 },
+		{ "largeblob/seal-16k", "largeblob/open-16k", 16384 },
+	};
+	struct entry e;
+
+	for (size_t i = 0; i < nitems(size); i++) {
+		if (entry_setup(&e, size[i].len) < 0)
+			errx(1, "%s: entry_setup", __func__);
+		bench_run(size[i].seal, seal, &e);
+		bench_run(size[i].open, open_entry, &e);
+		entry_reset(&e);
+	}
+}
@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _BENCH_TPM_H
+#define _BENCH_TPM_H
+
+/*
+ * A credential attested by a TPM (fmt "tpm", COSE_ES256), taken from
+ * regress/cred.c; rp "localhost".
+ */
+
+static const unsigned char tpm_clientdata[32] = {
+	0xf9, 0x64, 0x57, 0xe7, 0x2d, 0x97, 0xf6, 0xbb,
+	0xdd, 0xd7, 0xfb, 0x06, 0x37, 0x62, 0xea, 0x26,
+	0x20, 0x44, 0x8e, 0x69, 0x7c, 0x03, 0xf2, 0x31,
+	0x2f, 0x99, 0xdc, 0xaf, 0x3e, 0x8a, 0x91, 0x6b,
+};
+
+static const unsigned char tpm_authdata[166] = {
+	0x58, 0xa4, 0x49, 0x96, 0x0d, 0xe5, 0x88, 0x0e,
+	0x8c, 0x68, 0x74, 0x34, 0x17, 0x0f, 0x64, 0x76,
+	0x60, 0x5b, 0x8f, 0xe4, 0xae, 0xb9, 0xa2, 0x86,
+	0x32, 0xc7, 0x99, 0x5c, 0xf3, 0xba, 0x83, 0x1d,
+	0x97, 0x63, 0x45, 0x00, 0x00, 0x00, 0x00, 0x08,
+	0x98, 0x70, 0x58, 0xca, 0xdc, 0x4b, 0x81, 0xb6,
+	0xe1, 0x30, 0xde, 0x50, 0xdc, 0xbe, 0x96, 0x00,
+	0x20, 0xa8, 0xdf, 0x03, 0xf7, 0xbf, 0x39, 0x51,
+	0x94, 0x95, 0x8f, 0xa4, 0x84, 0x97, 0x30, 0xbc,
+	0x3c, 0x7e, 0x1c, 0x99, 0x91, 0x4d, 0xae, 0x6d,
+	0xfb, 0xdf, 0x53, 0xb5, 0xb6, 0x1f, 0x3a, 0x4e,
+	0x6a, 0xa5, 0x01, 0x02, 0x03, 0x26, 0x20, 0x01,
+	0x21, 0x58, 0x20, 0xfb, 0xd6, 0xba, 0x74, 0xe6,
+	0x6e, 0x5c, 0x87, 0xef, 0x89, 0xa2, 0xe8, 0x3d,
+	0x0b, 0xe9, 0x69, 0x2c, 0x07, 0x07, 0x7a, 0x8a,
+	0x1e, 0xce, 0x12, 0xea, 0x3b, 0xb3, 0xf1, 0xf3,
+	0xd9, 0xc3, 0xe6, 0x22, 0x58, 0x20, 0x3c, 0x68,
+	0x51, 0x94, 0x54, 0x8d, 0xeb, 0x9f, 0xb2, 0x2c,
+	0x66, 0x75, 0xb6, 0xb7, 0x55, 0x22, 0x0d, 0x87,
+	0x59, 0xc4, 0x39, 0x91, 0x62, 0x17, 0xc2, 0xc3,
+	0x53, 0xa5, 0x26, 0x97, 0x4f, 0x2d
+};
+
+
+static const unsigned char tpm_attstmt[3841] = {
+	0xa6, 0x63, 0x61, 0x6c, 0x67, 0x39, 0xff, 0xfe,
+	0x63, 0x73, 0x69, 0x67, 0x59, 0x01, 0x00, 0x6d,
+	0x11, 0x61, 0x1f, 0x45, 0xb9, 0x7f, 0x65, 0x6f,
+	0x97, 0x46, 0xfe, 0xbb, 0x8a, 0x98, 0x07, 0xa3,
+	0xbc, 0x67, 0x5c, 0xd7, 0x65, 0xa4, 0xf4, 0x6c,
+	0x5b, 0x37, 0x75, 0xa4, 0x7f, 0x08, 0x52, 0xeb,
+	0x1e, 0x12, 0xe2, 0x78, 0x8c, 0x7d, 0x94, 0xab,
+	0x7b, 0xed, 0x05, 0x17, 0x67, 0x7e, 0xaa, 0x02,
+	0x89, 0x6d, 0xe8, 0x6d, 0x43, 0x30, 0x99, 0xc6,
+	0xf9, 0x59, 0xe5, 0x82, 0x3c, 0x56, 0x4e, 0x77,
+	0x11, 0x25, 0xe4, 0x43, 0x6a, 0xae, 0x92, 0x4f,
+	0x60, 0x92, 0x50, 0xf9, 0x65, 0x0e, 0x44, 0x38,
+	0x3d, 0xf7, 0xaf, 0x66, 0x89, 0xc7, 0xe6, 0xe6,
+	0x01, 0x07, 0x9e, 0x90, 0xfd, 0x6d, 0xaa, 0x35,
+	0x51, 0x51, 0xbf, 0x54, 0x13, 0x95, 0xc2, 0x17,
+	0xfa, 0x32, 0x0f, 0xa7, 0x82, 0x17, 0x58, 0x6c,
+	0x3d, 0xea, 0x88, 0xd8, 0x64, 0xc7, 0xf8, 0xc2,
+	0xd6, 0x1c, 0xbb, 0xea, 0x1e, 0xb3, 0xd9, 0x4c,
+	0xa7, 0xce, 0x18, 0x1e, 0xcb, 0x42, 0x5f, 0xbf,
+	0x44, 0xe7, 0xf1, 0x22, 0xe0, 0x5b, 0xeb, 0xff,
+	0xb6, 0x1e, 0x6f, 0x60, 0x12, 0x16, 0x63, 0xfe,
+	0xab, 0x5e, 0x31, 0x13, 0xdb, 0x72, 0xc6, 0x9a,
+	0xf8, 0x8f, 0x19, 0x6b, 0x2e, 0xaf, 0x7d, 0xca,
+	0x9f, 0xbc, 0x6b, 0x1a, 0x8b, 0x5e, 0xe3, 0x9e,
+	0xaa, 0x8c, 0x79, 0x9c, 0x4e, 0xed, 0xe4, 0xff,
+	0x3d, 0x12, 0x79, 0x90, 0x09, 0x61, 0x97, 0x67,
+	0xbf, 0x04, 0xac, 0x37, 0xea, 0xa9, 0x1f, 0x9f,
+	0x52, 0x64, 0x0b, 0xeb, 0xc3, 0x61, 0xd4, 0x13,
+	0xb0, 0x84, 0xf1, 0x3c, 0x74, 0x83, 0xcc, 0xa8,
+	0x1c, 0x14, 0xe6, 0x9d, 0xfe, 0xec, 0xee, 0xa1,
+	0xd2, 0xc2, 0x0a, 0xa6, 0x36, 0x08, 0xbb, 0x17,
+	0xa5, 0x7b, 0x53, 0x34, 0x0e, 0xc9, 0x09, 0xe5,
+	0x10, 0xa6, 0x85, 0x01, 0x71, 0x66, 0xff, 0xd0,
+	0x6d, 0x4b, 0x93, 0xdb, 0x81, 0x25, 0x01, 0x63,
+	0x76, 0x65, 0x72, 0x63, 0x32, 0x2e, 0x30, 0x63,
+	0x78, 0x35, 0x63, 0x82, 0x59, 0x05, 0xc4, 0x30,
+	0x82, 0x05, 0xc0, 0x30, 0x82, 0x03, 0xa8, 0xa0,
+	0x03, 0x02, 0x01, 0x02, 0x02, 0x10, 0x30, 0xcd,
+	0xf2, 0x7e, 0x81, 0xc0, 0x43, 0x85, 0xa2, 0xd7,
+	0x29, 0xef, 0xf7, 0x9f, 0xa5, 0x2b, 0x30, 0x0d,
+	0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d,
+	0x01, 0x01, 0x0b, 0x05, 0x00, 0x30, 0x41, 0x31,
+	0x3f, 0x30, 0x3d, 0x06, 0x03, 0x55, 0x04, 0x03,
+	0x13, 0x36, 0x45, 0x55, 0x53, 0x2d, 0x53, 0x54,
+	0x4d, 0x2d, 0x4b, 0x45, 0x59, 0x49, 0x44, 0x2d,
+	0x31, 0x41, 0x44, 0x42, 0x39, 0x39, 0x34, 0x41,
+	0x42, 0x35, 0x38, 0x42, 0x45, 0x35, 0x37, 0x41,
+	0x30, 0x43, 0x43, 0x39, 0x42, 0x39, 0x30, 0x30,
+	0x45, 0x37, 0x38, 0x35, 0x31, 0x45, 0x31, 0x41,
+	0x34, 0x33, 0x43, 0x30, 0x38, 0x36, 0x36, 0x30,
+	0x30, 0x1e, 0x17, 0x0d, 0x32, 0x31, 0x31, 0x31,
+	0x30, 0x32, 0x31, 0x35, 0x30, 0x36, 0x35, 0x33,
+	0x5a, 0x17, 0x0d, 0x32, 0x37, 0x30, 0x36, 0x30,
+	0x33, 0x31, 0x39, 0x34, 0x30, 0x31, 0x36, 0x5a,
+	0x30, 0x00, 0x30, 0x82, 0x01, 0x22, 0x30, 0x0d,
+	0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d,
+	0x01, 0x01, 0x01, 0x05, 0x00, 0x03, 0x82, 0x01,
+	0x0f, 0x00, 0x30, 0x82, 0x01, 0x0a, 0x02, 0x82,
+	0x01, 0x01, 0x00, 0xdb, 0xd5, 0x9a, 0xfc, 0x09,
+	0xa7, 0xc4, 0xa5, 0x5f, 0xbe, 0x5f, 0xa2, 0xeb,
+	0xd6, 0x8e, 0xed, 0xc5, 0x67, 0xa6, 0xa7, 0xd9,
+	0xb2, 0x46, 0xc6, 0xe0, 0xae, 0x0c, 0x02, 0x25,
+	0x0a, 0xf2, 0xc5, 0x96, 0xdc, 0xb7, 0x0e, 0xb9,
+	0x86, 0xd3, 0x51, 0xbb, 0x63, 0xf0, 0x4f, 0x8a,
+	0x5e, 0xd7, 0xf7, 0xff, 0xbb, 0x29, 0xbd, 0x58,
+	0xcf, 0x75, 0x02, 0x39, 0xcb, 0x80, 0xf1, 0xd4,
+	0xb6, 0x75, 0x67, 0x2f, 0x27, 0x4d, 0x0c, 0xcc,
+	0x18, 0x59, 0x87, 0xfa, 0x51, 0xd1, 0x80, 0xb5,
+	0x1a, 0xac, 0xac, 0x29, 0x51, 0xcf, 0x27, 0xaa,
+	0x74, 0xac, 0x3e, 0x59, 0x56, 0x67, 0xe4, 0x42,
+	0xe8, 0x30, 0x35, 0xb2, 0xf6, 0x27, 0x91, 0x62,
+	0x60, 0x42, 0x42, 0x12, 0xde, 0xfe, 0xdd, 0xee,
+	0xe8, 0xa8, 0x82, 0xf9, 0xb1, 0x08, 0xd5, 0x8d,
+	0x57, 0x9a, 0x29, 0xb9, 0xb4, 0xe9, 0x19, 0x1e,
+	0x33, 0x7d, 0x37, 0xa0, 0xce, 0x2e, 0x53, 0x13,
+	0x39, 0xb6, 0x12, 0x61, 0x63, 0xbf, 0xd3, 0x42,
+	0xeb, 0x6f, 0xed, 0xc1, 0x8e, 0x26, 0xba, 0x7d,
+	0x8b, 0x37, 0x7c, 0xbb, 0x42, 0x1e, 0x56, 0x76,
+	0xda, 0xdb, 0x35, 0x6b, 0x80, 0xe1, 0x8e, 0x00,
+	0xac, 0xd2, 0xfc, 0x22, 0x96, 0x14, 0x0c, 0xf4,
+	0xe4, 0xc5, 0xad, 0x14, 0xb7, 0x4d, 0x46, 0x63,
+	0x30, 0x79, 0x3a, 0x7c, 0x33, 0xb5, 0xe5, 0x2e,
+	0xbb, 0x5f, 0xca, 0xf2, 0x75, 0xe3, 0x4e, 0x99,
+	0x64, 0x1b, 0x26, 0x99, 0x60, 0x1a, 0x79, 0xcc,
+	0x30, 0x2c, 0xb3, 0x4c, 0x59, 0xf7, 0x77, 0x59,
+	0xd5, 0x90, 0x70, 0x21, 0x79, 0x8c, 0x1f, 0x79,
+	0x0a, 0x12, 0x8b, 0x3b, 0x37, 0x2d, 0x97, 0x39,
+	0x89, 0x92, 0x0c, 0x44, 0x7c, 0xe9, 0x9f, 0xce,
+	0x6d, 0xad, 0xc5, 0xae, 0xea, 0x8e, 0x50, 0x22,
+	0x37, 0xe0, 0xd1, 0x9e, 0xd6, 0xe6, 0xa8, 0xcc,
+	0x21, 0xfb, 0xff, 0x02, 0x03, 0x01, 0x00, 0x01,
+	0xa3, 0x82, 0x01, 0xf3, 0x30, 0x82, 0x01, 0xef,
+	0x30, 0x0e, 0x06, 0x03, 0x55, 0x1d, 0x0f, 0x01,
+	0x01, 0xff, 0x04, 0x04, 0x03, 0x02, 0x07, 0x80,
+	0x30, 0x0c, 0x06, 0x03, 0x55, 0x1d, 0x13, 0x01,
+	0x01, 0xff, 0x04, 0x02, 0x30, 0x00, 0x30, 0x6d,
+	0x06, 0x03, 0x55, 0x1d, 0x20, 0x01, 0x01, 0xff,
+	0x04, 0x63, 0x30, 0x61, 0x30, 0x5f, 0x06, 0x09,
+	0x2b, 0x06, 0x01, 0x04, 0x01, 0x82, 0x37, 0x15,
+	0x1f, 0x30, 0x52, 0x30, 0x50, 0x06, 0x08, 0x2b,
+	0x06, 0x01, 0x05, 0x05, 0x07, 0x02, 0x02, 0x30,
+	0x44, 0x1e, 0x42, 0x00, 0x54, 0x00, 0x43, 0x00,
+	0x50, 0x00, 0x41, 0x00, 0x20, 0x00, 0x20, 0x00,
+	0x54, 0x00, 0x72, 0x00, 0x75, 0x00, 0x73, 0x00,
+	0x74, 0x00, 0x65, 0x00, 0x64, 0x00, 0x20, 0x00,
+	0x20, 0x00, 0x50, 0x00, 0x6c, 0x00, 0x61, 0x00,
+	0x74, 0x00, 0x66, 0x00, 0x6f, 0x00, 0x72, 0x00,
+	0x6d, 0x00, 0x20, 0x00, 0x20, 0x00, 0x49, 0x00,
+	0x64, 0x00, 0x65, 0x00, 0x6e, 0x00, 0x74, 0x00,
+	0x69, 0x00, 0x74, 0x00, 0x79, 0x30, 0x10, 0x06,
+	0x03, 0x55, 0x1d, 0x25, 0x04, 0x09, 0x30, 0x07,
+	0x06, 0x05, 0x67, 0x81, 0x05, 0x08, 0x03, 0x30,
+	0x59, 0x06, 0x03, 0x55, 0x1d, 0x11, 0x01, 0x01,
+	0xff, 0x04, 0x4f, 0x30, 0x4d, 0xa4, 0x4b, 0x30,
+	0x49, 0x31, 0x16, 0x30, 0x14, 0x06, 0x05, 0x67,
+	0x81, 0x05, 0x02, 0x01, 0x0c, 0x0b, 0x69, 0x64,
+	0x3a, 0x35, 0x33, 0x35, 0x34, 0x34, 0x44, 0x32,
+	0x30, 0x31, 0x17, 0x30, 0x15, 0x06, 0x05, 0x67,
+	0x81, 0x05, 0x02, 0x02, 0x0c, 0x0c, 0x53, 0x54,
+	0x33, 0x33, 0x48, 0x54, 0x50, 0x48, 0x41, 0x48,
+	0x42, 0x34, 0x31, 0x16, 0x30, 0x14, 0x06, 0x05,
+	0x67, 0x81, 0x05, 0x02, 0x03, 0x0c, 0x0b, 0x69,
+	0x64, 0x3a, 0x30, 0x30, 0x34, 0x39, 0x30, 0x30,
+	0x30, 0x34, 0x30, 0x1f, 0x06, 0x03, 0x55, 0x1d,
+	0x23, 0x04, 0x18, 0x30, 0x16, 0x80, 0x14, 0x45,
+	0x1a, 0xec, 0xfc, 0x91, 0x70, 0xf8, 0x83, 0x8b,
+	0x9c, 0x47, 0x2f, 0x0b, 0x9f, 0x07, 0xf3, 0x2f,
+	0x7c, 0xa2, 0x8a, 0x30, 0x1d, 0x06, 0x03, 0x55,
+	0x1d, 0x0e, 0x04, 0x16, 0x04, 0x14, 0x55, 0xa6,
+	0xee, 0xe3, 0x28, 0xdd, 0x40, 0x7f, 0x21, 0xd2,
+	0x7b, 0x8c, 0x69, 0x2f, 0x8c, 0x08, 0x29, 0xbc,
+	0x95, 0xb8, 0x30, 0x81, 0xb2, 0x06, 0x08, 0x2b,
+	0x06, 0x01, 0x05, 0x05, 0x07, 0x01, 0x01, 0x04,
+	0x81, 0xa5, 0x30, 0x81, 0xa2, 0x30, 0x81, 0x9f,
+	0x06, 0x08, 0x2b, 0x06, 0x01, 0x05, 0x05, 0x07,
+	0x30, 0x02, 0x86, 0x81, 0x92, 0x68, 0x74, 0x74,
+	0x70, 0x3a, 0x2f, 0x2f, 0x61, 0x7a, 0x63, 0x73,
+	0x70, 0x72, 0x6f, 0x64, 0x65, 0x75, 0x73, 0x61,
+	0x69, 0x6b, 0x70, 0x75, 0x62, 0x6c, 0x69, 0x73,
+	0x68, 0x2e, 0x62, 0x6c, 0x6f, 0x62, 0x2e, 0x63,
+	0x6f, 0x72, 0x65, 0x2e, 0x77, 0x69, 0x6e, 0x64,
+	0x6f, 0x77, 0x73, 0x2e, 0x6e, 0x65, 0x74, 0x2f,
+	0x65, 0x75, 0x73, 0x2d, 0x73, 0x74, 0x6d, 0x2d,
+	0x6b, 0x65, 0x79, 0x69, 0x64, 0x2d, 0x31, 0x61,
+	0x64, 0x62, 0x39, 0x39, 0x34, 0x61, 0x62, 0x35,
+	0x38, 0x62, 0x65, 0x35, 0x37, 0x61, 0x30, 0x63,
+	0x63, 0x39, 0x62, 0x39, 0x30, 0x30, 0x65, 0x37,
+	0x38, 0x35, 0x31, 0x65, 0x31, 0x61, 0x34, 0x33,
+	0x63, 0x30, 0x38, 0x36, 0x36, 0x30, 0x2f, 0x62,
+	0x36, 0x63, 0x30, 0x64, 0x39, 0x38, 0x64, 0x2d,
+	0x35, 0x37, 0x38, 0x61, 0x2d, 0x34, 0x62, 0x66,
+	0x62, 0x2d, 0x61, 0x32, 0x64, 0x33, 0x2d, 0x65,
+	0x64, 0x66, 0x65, 0x35, 0x66, 0x38, 0x32, 0x30,
+	0x36, 0x30, 0x31, 0x2e, 0x63, 0x65, 0x72, 0x30,
+	0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7,
+	0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x03, 0x82,
+	0x02, 0x01, 0x00, 0x2a, 0x08, 0x30, 0x1f, 0xfd,
+	0x8f, 0x80, 0x9b, 0x4b, 0x37, 0x82, 0x61, 0x86,
+	0x36, 0x57, 0x90, 0xb5, 0x1d, 0x1f, 0xa3, 0xae,
+	0x68, 0xac, 0xa7, 0x96, 0x6a, 0x25, 0x5e, 0xc5,
+	0x82, 0x7c, 0x36, 0x64, 0x58, 0x11, 0xcb, 0xa5,
+	0xee, 0xbf, 0xc4, 0xdb, 0xa0, 0xc7, 0x82, 0x3b,
+	0xa3, 0x85, 0x9b, 0xc4, 0xee, 0x07, 0x36, 0xd7,
+	0xc7, 0xb6, 0x23, 0xed, 0xc2, 0x73, 0xab, 0xbe,
+	0xbe, 0xee, 0x63, 0x17, 0xf9, 0xd7, 0x7a, 0x23,
+	0x7b, 0xf8, 0x09, 0x7a, 0xaa, 0x7f, 0x67, 0xc3,
+	0x04, 0x84, 0x71, 0x9b, 0x06, 0x9c, 0x07, 0x42,
+	0x4b, 0x65, 0x41, 0x56, 0x58, 0x14, 0x92, 0xb0,
+	0xb9, 0xaf, 0xa1, 0x39, 0xd4, 0x08, 0x2d, 0x71,
+	0xd5, 0x6c, 0x56, 0xb9, 0x2b, 0x1e, 0xf3, 0x93,
+	0xa5, 0xe9, 0xb2, 0x9b, 0x4d, 0x05, 0x2b, 0xbc,
+	0xd2, 0x20, 0x57, 0x3b, 0xa4, 0x01, 0x68, 0x8c,
+	0x23, 0x20, 0x7d, 0xbb, 0x71, 0xe4, 0x2a, 0x24,
+	0xba, 0x75, 0x0c, 0x89, 0x54, 0x22, 0xeb, 0x0e,
+	0xb2, 0xf4, 0xc2, 0x1f, 0x02, 0xb7, 0xe3, 0x06,
+	0x41, 0x15, 0x6b, 0xf3, 0xc8, 0x2d, 0x5b, 0xc2,
+	0x21, 0x82, 0x3e, 0xe8, 0x95, 0x40, 0x39, 0x9e,
+	0x91, 0x68, 0x33, 0x0c, 0x3d, 0x45, 0xef, 0x99,
+	0x79, 0xe6, 0x32, 0xc9, 0x00, 0x84, 0x36, 0xfb,
+	0x0a, 0x8d, 0x41, 0x1c, 0x32, 0x64, 0x06, 0x9e,
+	0x0f, 0xb5, 0x04, 0xcc, 0x08, 0xb1, 0xb6, 0x2b,
+	0xcf, 0x36, 0x0f, 0x73, 0x14, 0x8e, 0x25, 0x44,
+	0xb3, 0x0c, 0x34, 0x14, 0x96, 0x0c, 0x8a, 0x65,
+	0xa1, 0xde, 0x8e, 0xc8, 0x9d, 0xbe, 0x66, 0xdf,
+	0x06, 0x91, 0xca, 0x15, 0x0f, 0x92, 0xd5, 0x2a,
+	0x0b, 0xdc, 0x4c, 0x6a, 0xf3, 0x16, 0x4a, 0x3e,
+	0xb9, 0x76, 0xbc, 0xfe, 0x62, 0xd4, 0xa8, 0xcd,
+	0x94, 0x78, 0x0d, 0xdd, 0x94, 0xfd, 0x5e, 0x63,
+	0x57, 0x27, 0x05, 0x9c, 0xd0, 0x80, 0x91, 0x91,
+	0x79, 0xe8, 0x5e, 0x18, 0x64, 0x22, 0xe4, 0x2c,
+	0x13, 0x65, 0xa4, 0x51, 0x5a, 0x1e, 0x3b, 0x71,
+	0x2e, 0x70, 0x9f, 0xc4, 0xa5, 0x20, 0xcd, 0xef,
+	0xd8, 0x3f, 0xa4, 0xf5, 0x89, 0x8a, 0xa5, 0x4f,
+	0x76, 0x2d, 0x49, 0x56, 0x00, 0x8d, 0xde, 0x40,
+	0xba, 0x24, 0x46, 0x51, 0x38, 0xad, 0xdb, 0xc4,
+	0x04, 0xf4, 0x6e, 0xc0, 0x29, 0x48, 0x07, 0x6a,
+	0x1b, 0x26, 0x32, 0x0a, 0xfb, 0xea, 0x71, 0x2a,
+	0x11, 0xfc, 0x98, 0x7c, 0x44, 0x87, 0xbc, 0x06,
+	0x3a, 0x4d, 0xbd, 0x91, 0x63, 0x4f, 0x26, 0x48,
+	0x54, 0x47, 0x1b, 0xbd, 0xf0, 0xf1, 0x56, 0x05,
+	0xc5, 0x0f, 0x8f, 0x20, 0xa5, 0xcc, 0xfb, 0x76,
+	0xb0, 0xbd, 0x83, 0xde, 0x7f, 0x39, 0x4f, 0xcf,
+	0x61, 0x74, 0x52, 0xa7, 0x1d, 0xf6, 0xb5, 0x5e,
+	0x4a, 0x82, 0x20, 0xc1, 0x94, 0xaa, 0x2c, 0x33,
+	0xd6, 0x0a, 0xf9, 0x8f, 0x92, 0xc6, 0x29, 0x80,
+	0xf5, 0xa2, 0xb1, 0xff, 0xb6, 0x2b, 0xaa, 0x04,
+	0x00, 0x72, 0xb4, 0x12, 0xbb, 0xb1, 0xf1, 0x3c,
+	0x88, 0xa3, 0xab, 0x49, 0x17, 0x90, 0x80, 0x59,
+	0xa2, 0x96, 0x41, 0x69, 0x74, 0x33, 0x8a, 0x28,
+	0x33, 0x7e, 0xb3, 0x19, 0x92, 0x28, 0xc1, 0xf0,
+	0xd1, 0x82, 0xd5, 0x42, 0xff, 0xe7, 0xa5, 0x3f,
+	0x1e, 0xb6, 0x4a, 0x23, 0xcc, 0x6a, 0x7f, 0x15,
+	0x15, 0x52, 0x25, 0xb1, 0xca, 0x21, 0x95, 0x11,
+	0x53, 0x3e, 0x1f, 0x50, 0x33, 0x12, 0x7a, 0x62,
+	0xce, 0xcc, 0x71, 0xc2, 0x5f, 0x34, 0x47, 0xc6,
+	0x7c, 0x71, 0xfa, 0xa0, 0x54, 0x00, 0xb2, 0xdf,
+	0xc5, 0x54, 0xac, 0x6c, 0x53, 0xef, 0x64, 0x6b,
+	0x08, 0x82, 0xd8, 0x16, 0x1e, 0xca, 0x40, 0xf3,
+	0x1f, 0xdf, 0x56, 0x63, 0x10, 0xbc, 0xd7, 0xa0,
+	0xeb, 0xee, 0xd1, 0x95, 0xe5, 0xef, 0xf1, 0x6a,
+	0x83, 0x2d, 0x5a, 0x59, 0x06, 0xef, 0x30, 0x82,
+	0x06, 0xeb, 0x30, 0x82, 0x04, 0xd3, 0xa0, 0x03,
+	0x02, 0x01, 0x02, 0x02, 0x13, 0x33, 0x00, 0x00,
+	0x05, 0x23, 0xbf, 0xe8, 0xa1, 0x1a, 0x2a, 0x68,
+	0xbd, 0x09, 0x00, 0x00, 0x00, 0x00, 0x05, 0x23,
+	0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86,
+	0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x30,
+	0x81, 0x8c, 0x31, 0x0b, 0x30, 0x09, 0x06, 0x03,
+	0x55, 0x04, 0x06, 0x13, 0x02, 0x55, 0x53, 0x31,
+	0x13, 0x30, 0x11, 0x06, 0x03, 0x55, 0x04, 0x08,
+	0x13, 0x0a, 0x57, 0x61, 0x73, 0x68, 0x69, 0x6e,
+	0x67, 0x74, 0x6f, 0x6e, 0x31, 0x10, 0x30, 0x0e,
+	0x06, 0x03, 0x55, 0x04, 0x07, 0x13, 0x07, 0x52,
+	0x65, 0x64, 0x6d, 0x6f, 0x6e, 0x64, 0x31, 0x1e,
+	0x30, 0x1c, 0x06, 0x03, 0x55, 0x04, 0x0a, 0x13,
+	0x15, 0x4d, 0x69, 0x63, 0x72, 0x6f, 0x73, 0x6f,
+	0x66, 0x74, 0x20, 0x43, 0x6f, 0x72, 0x70, 0x6f,
+	0x72, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x31, 0x36,
+	0x30, 0x34, 0x06, 0x03, 0x55, 0x04, 0x03, 0x13,
+	0x2d, 0x4d, 0x69, 0x63, 0x72, 0x6f, 0x73, 0x6f,
+	0x66, 0x74, 0x20, 0x54, 0x50, 0x4d, 0x20, 0x52,
+	0x6f, 0x6f, 0x74, 0x20, 0x43, 0x65, 0x72, 0x74,
+	0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x65, 0x20,
+	0x41, 0x75, 0x74, 0x68, 0x6f, 0x72, 0x69, 0x74,
+	0x79, 0x20, 0x32, 0x30, 0x31, 0x34, 0x30, 0x1e,
+	0x17, 0x0d, 0x32, 0x31, 0x30, 0x36, 0x30, 0x33,
+	0x31, 0x39, 0x34, 0x30, 0x31, 0x36, 0x5a, 0x17,
+	0x0d, 0x32, 0x37, 0x30, 0x36, 0x30, 0x33, 0x31,
+	0x39, 0x34, 0x30, 0x31, 0x36, 0x5a, 0x30, 0x41,
+	0x31, 0x3f, 0x30, 0x3d, 0x06, 0x03, 0x55, 0x04,
+	0x03, 0x13, 0x36, 0x45, 0x55, 0x53, 0x2d, 0x53,
+	0x54, 0x4d, 0x2d, 0x4b, 0x45, 0x59, 0x49, 0x44,
+	0x2d, 0x31, 0x41, 0x44, 0x42, 0x39, 0x39, 0x34,
+	0x41, 0x42, 0x35, 0x38, 0x42, 0x45, 0x35, 0x37,
+	0x41, 0x30, 0x43, 0x43, 0x39, 0x42, 0x39, 0x30,
+	0x30, 0x45, 0x37, 0x38, 0x35, 0x31, 0x45, 0x31,
+	0x41, 0x34, 0x33, 0x43, 0x30, 0x38, 0x36, 0x36,
+	0x30, 0x30, 0x82, 0x02, 0x22, 0x30, 0x0d, 0x06,
+	0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01,
+	0x01, 0x01, 0x05, 0x00, 0x03, 0x82, 0x02, 0x0f,
+	0x00, 0x30, 0x82, 0x02, 0x0a, 0x02, 0x82, 0x02,
+	0x01, 0x00, 0xdb, 0x03, 0x34, 0x82, 0xfa, 0x81,
+	0x1c, 0x84, 0x0b, 0xa0, 0x0e, 0x60, 0xd8, 0x9d,
+	0x84, 0xf4, 0x81, 0xc4, 0xe9, 0xff, 0xcf, 0xe9,
+	0xa3, 0x57, 0x53, 0x60, 0xa8, 0x19, 0xce, 0xbe,
+	0xe1, 0x97, 0xee, 0x5d, 0x8c, 0x9f, 0xe4, 0xbd,
+	0xef, 0xbd, 0x94, 0x14, 0xe4, 0x74, 0x41, 0x02,
+	0xe9, 0x03, 0x19, 0x9f, 0xdd, 0x48, 0x2d, 0xbd,
+	0xca, 0x26, 0x47, 0x2c, 0x01, 0x31, 0x5f, 0x34,
+	0xef, 0x59, 0x35, 0x48, 0x36, 0x3d, 0x1e, 0xdf,
+	0xd8, 0x13, 0xf0, 0xd0, 0x67, 0xc1, 0xb0, 0x47,
+	0x67, 0xa2, 0xd6, 0x62, 0xc8, 0xe1, 0x00, 0x36,
+	0x8b, 0x45, 0xf6, 0x3b, 0x96, 0x60, 0xa0, 0x45,
+	0x26, 0xcb, 0xc7, 0x0b, 0x5b, 0x97, 0xd1, 0xaf,
+	0x54, 0x25, 0x7a, 0x67, 0xe4, 0x2a, 0xd8, 0x9d,
+	0x53, 0x05, 0xbd, 0x12, 0xac, 0xa2, 0x8e, 0x95,
+	0xb4, 0x2a, 0xca, 0x89, 0x93, 0x64, 0x97, 0x25,
+	0xdc, 0x1f, 0xa9, 0xe0, 0x55, 0x07, 0x38, 0x1d,
+	0xee, 0x02, 0x90, 0x22, 0xf5, 0xad, 0x4e, 0x5c,
+	0xf8, 0xc5, 0x1f, 0x9e, 0x84, 0x7e, 0x13, 0x47,
+	0x52, 0xa2, 0x36, 0xf9, 0xf6, 0xbf, 0x76, 0x9e,
+	0x0f, 0xdd, 0x14, 0x99, 0xb9, 0xd8, 0x5a, 0x42,
+	0x3d, 0xd8, 0xbf, 0xdd, 0xb4, 0x9b, 0xbf, 0x6a,
+	0x9f, 0x89, 0x13, 0x75, 0xaf, 0x96, 0xd2, 0x72,
+	0xdf, 0xb3, 0x80, 0x6f, 0x84, 0x1a, 0x9d, 0x06,
+	0x55, 0x09, 0x29, 0xea, 0xa7, 0x05, 0x31, 0xec,
+	0x47, 0x3a, 0xcf, 0x3f, 0x9c, 0x2c, 0xbd, 0xd0,
+	0x7d, 0xe4, 0x75, 0x5b, 0x33, 0xbe, 0x12, 0x86,
+	0x09, 0xcf, 0x66, 0x9a, 0xeb, 0xf8, 0xf8, 0x72,
+	0x91, 0x88, 0x4a, 0x5e, 0x89, 0x62, 0x6a, 0x94,
+	0xdc, 0x48, 0x37, 0x13, 0xd8, 0x91, 0x02, 0xe3,
+	0x42, 0x41, 0x7c, 0x2f, 0xe3, 0xb6, 0x0f, 0xb4,
+	0x96, 0x06, 0x80, 0xca, 0x28, 0x01, 0x6f, 0x4b,
+	0xcd, 0x28, 0xd4, 0x2c, 0x94, 0x7e, 0x40, 0x7e,
+	0xdf, 0x01, 0xe5, 0xf2, 0x33, 0xd4, 0xda, 0xf4,
+	0x1a, 0x17, 0xf7, 0x5d, 0xcb, 0x66, 0x2c, 0x2a,
+	0xeb, 0xe1, 0xb1, 0x4a, 0xc3, 0x85, 0x63, 0xb2,
+	0xac, 0xd0, 0x3f, 0x1a, 0x8d, 0xa5, 0x0c, 0xee,
+	0x4f, 0xde, 0x74, 0x9c, 0xe0, 0x5a, 0x10, 0xc7,
+	0xb8, 0xe4, 0xec, 0xe7, 0x73, 0xa6, 0x41, 0x42,
+	0x37, 0xe1, 0xdf, 0xb9, 0xc7, 0xb5, 0x14, 0xa8,
+	0x80, 0x95, 0xa0, 0x12, 0x67, 0x99, 0xf5, 0xba,
+	0x25, 0x0a, 0x74, 0x86, 0x71, 0x9c, 0x7f, 0x59,
+	0x97, 0xd2, 0x3f, 0x10, 0xfe, 0x6a, 0xb9, 0xe4,
+	0x47, 0x36, 0xfb, 0x0f, 0x50, 0xee, 0xfc, 0x87,
+	0x99, 0x7e, 0x36, 0x64, 0x1b, 0xc7, 0x13, 0xb3,
+	0x33, 0x18, 0x71, 0xa4, 0xc3, 0xb0, 0xfc, 0x45,
+	0x37, 0x11, 0x40, 0xb3, 0xde, 0x2c, 0x9f, 0x0a,
+	0xcd, 0xaf, 0x5e, 0xfb, 0xd5, 0x9c, 0xea, 0xd7,
+	0x24, 0x19, 0x3a, 0x92, 0x80, 0xa5, 0x63, 0xc5,
+	0x3e, 0xdd, 0x51, 0xd0, 0x9f, 0xb8, 0x5e, 0xd5,
+	0xf1, 0xfe, 0xa5, 0x93, 0xfb, 0x7f, 0xd9, 0xb8,
+	0xb7, 0x0e, 0x0d, 0x12, 0x71, 0xf0, 0x52, 0x9d,
+	0xe9, 0xd0, 0xd2, 0x8b, 0x38, 0x8b, 0x85, 0x83,
+	0x98, 0x24, 0x88, 0xe8, 0x42, 0x30, 0x83, 0x12,
+	0xef, 0x09, 0x96, 0x2f, 0x21, 0x81, 0x05, 0x30,
+	0x0c, 0xbb, 0xba, 0x21, 0x39, 0x16, 0x12, 0xe8,
+	0x4b, 0x7b, 0x7a, 0x66, 0xb8, 0x22, 0x2c, 0x71,
+	0xaf, 0x59, 0xa1, 0xfc, 0x61, 0xf1, 0xb4, 0x5e,
+	0xfc, 0x43, 0x19, 0x45, 0x6e, 0xa3, 0x45, 0xe4,
+	0xcb, 0x66, 0x5f, 0xe0, 0x57, 0xf6, 0x0a, 0x30,
+	0xa3, 0xd6, 0x51, 0x24, 0xc9, 0x07, 0x55, 0x82,
+	0x4a, 0x66, 0x0e, 0x9d, 0xb2, 0x2f, 0x84, 0x56,
+	0x6c, 0x3e, 0x71, 0xef, 0x9b, 0x35, 0x4d, 0x72,
+	0xdc, 0x46, 0x2a, 0xe3, 0x7b, 0x13, 0x20, 0xbf,
+	0xab, 0x77, 0x02, 0x03, 0x01, 0x00, 0x01, 0xa3,
+	0x82, 0x01, 0x8e, 0x30, 0x82, 0x01, 0x8a, 0x30,
+	0x0e, 0x06, 0x03, 0x55, 0x1d, 0x0f, 0x01, 0x01,
+	0xff, 0x04, 0x04, 0x03, 0x02, 0x02, 0x84, 0x30,
+	0x1b, 0x06, 0x03, 0x55, 0x1d, 0x25, 0x04, 0x14,
+	0x30, 0x12, 0x06, 0x09, 0x2b, 0x06, 0x01, 0x04,
+	0x01, 0x82, 0x37, 0x15, 0x24, 0x06, 0x05, 0x67,
+	0x81, 0x05, 0x08, 0x03, 0x30, 0x16, 0x06, 0x03,
+	0x55, 0x1d, 0x20, 0x04, 0x0f, 0x30, 0x0d, 0x30,
+	0x0b, 0x06, 0x09, 0x2b, 0x06, 0x01, 0x04, 0x01,
+	0x82, 0x37, 0x15, 0x1f, 0x30, 0x12, 0x06, 0x03,
+	0x55, 0x1d, 0x13, 0x01, 0x01, 0xff, 0x04, 0x08,
+	0x30, 0x06, 0x01, 0x01, 0xff, 0x02, 0x01, 0x00,
+	0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04,
+	0x16, 0x04, 0x14, 0x45, 0x1a, 0xec, 0xfc, 0x91,
+	0x70, 0xf8, 0x83, 0x8b, 0x9c, 0x47, 0x2f, 0x0b,
+	0x9f, 0x07, 0xf3, 0x2f, 0x7c, 0xa2, 0x8a, 0x30,
+	0x1f, 0x06, 0x03, 0x55, 0x1d, 0x23, 0x04, 0x18,
+	0x30, 0x16, 0x80, 0x14, 0x7a, 0x8c, 0x0a, 0xce,
+	0x2f, 0x48, 0x62, 0x17, 0xe2, 0x94, 0xd1, 0xae,
+	0x55, 0xc1, 0x52, 0xec, 0x71, 0x74, 0xa4, 0x56,
+	0x30, 0x70, 0x06, 0x03, 0x55, 0x1d, 0x1f, 0x04,
+	0x69, 0x30, 0x67, 0x30, 0x65, 0xa0, 0x63, 0xa0,
+	0x61, 0x86, 0x5f, 0x68, 0x74, 0x74, 0x70, 0x3a,
+	0x2f, 0x2f, 0x77, 0x77, 0x77, 0x2e, 0x6d, 0x69,
+	0x63, 0x72, 0x6f, 0x73, 0x6f, 0x66, 0x74, 0x2e,
+	0x63, 0x6f, 0x6d, 0x2f, 0x70, 0x6b, 0x69, 0x6f,
+	0x70, 0x73, 0x2f, 0x63, 0x72, 0x6c, 0x2f, 0x4d,
+	0x69, 0x63, 0x72, 0x6f, 0x73, 0x6f, 0x66, 0x74,
+	0x25, 0x32, 0x30, 0x54, 0x50, 0x4d, 0x25, 0x32,
+	0x30, 0x52, 0x6f, 0x6f, 0x74, 0x25, 0x32, 0x30,
+	0x43, 0x65, 0x72, 0x74, 0x69, 0x66, 0x69, 0x63,
+	0x61, 0x74, 0x65, 0x25, 0x32, 0x30, 0x41, 0x75,
+	0x74, 0x68, 0x6f, 0x72, 0x69, 0x74, 0x79, 0x25,
+	0x32, 0x30, 0x32, 0x30, 0x31, 0x34, 0x2e, 0x63,
+	0x72, 0x6c, 0x30, 0x7d, 0x06, 0x08, 0x2b, 0x06,
+	0x01, 0x05, 0x05, 0x07, 0x01, 0x01, 0x04, 0x71,
+	0x30, 0x6f, 0x30, 0x6d, 0x06, 0x08, 0x2b, 0x06,
+	0x01, 0x05, 0x05, 0x07, 0x30, 0x02, 0x86, 0x61,
+	0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x77,
+	0x77, 0x77, 0x2e, 0x6d, 0x69, 0x63, 0x72, 0x6f,
+	0x73, 0x6f, 0x66, 0x74, 0x2e, 0x63, 0x6f, 0x6d,
+	0x2f, 0x70, 0x6b, 0x69, 0x6f, 0x70, 0x73, 0x2f,
+	0x63, 0x65, 0x72, 0x74, 0x73, 0x2f, 0x4d, 0x69,
+	0x63, 0x72, 0x6f, 0x73, 0x6f, 0x66, 0x74, 0x25,
+	0x32, 0x30, 0x54, 0x50, 0x4d, 0x25, 0x32, 0x30,
+	0x52, 0x6f, 0x6f, 0x74, 0x25, 0x32, 0x30, 0x43,
+	0x65, 0x72, 0x74, 0x69, 0x66, 0x69, 0x63, 0x61,
+	0x74, 0x65, 0x25, 0x32, 0x30, 0x41, 0x75, 0x74,
+	0x68, 0x6f, 0x72, 0x69, 0x74, 0x79, 0x25, 0x32,
+	0x30, 0x32, 0x30, 0x31, 0x34, 0x2e, 0x63, 0x72,
+	0x74, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48,
+	0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00,
+	0x03, 0x82, 0x02, 0x01, 0x00, 0x48, 0x24, 0x32,
+	0xe8, 0xd6, 0x38, 0xda, 0x65, 0xec, 0x1b, 0x18,
+	0x8e, 0x37, 0x07, 0xd5, 0x18, 0x5a, 0xc8, 0xb9,
+	0xbb, 0x24, 0x8a, 0x4d, 0xa1, 0x3c, 0x9e, 0x46,
+	0x76, 0xcf, 0xa5, 0xdf, 0xd7, 0x61, 0xba, 0x05,
+	0x89, 0x3c, 0x13, 0xc2, 0x1f, 0x71, 0xe3, 0xec,
+	0x5d, 0x54, 0x9e, 0xd9, 0x01, 0x5a, 0x10, 0x3b,
+	0x17, 0x75, 0xde, 0xa1, 0x45, 0xbf, 0x1d, 0x1b,
+	0x41, 0x21, 0x42, 0x68, 0x22, 0x6b, 0xbb, 0xcb,
+	0x11, 0x04, 0xd2, 0xae, 0x86, 0xcf, 0x73, 0x5a,
+	0xf2, 0x80, 0x18, 0x00, 0xf0, 0xd6, 0x6c, 0x5a,
+	0x1e, 0xb3, 0x4d, 0x30, 0x02, 0x4a, 0x6a, 0x03,
+	0x36, 0x42, 0xde, 0xb2, 0x52, 0x55, 0xff, 0x71,
+	0xeb, 0x7b, 0x8b, 0x55, 0x6c, 0xdf, 0x05, 0x35,
+	0x47, 0x70, 0x53, 0xfb, 0x6c, 0xba, 0x06, 0xb2,
+	0x61, 0x86, 0xdc, 0x2a, 0x64, 0x81, 0x24, 0x79,
+	0x46, 0x73, 0x04, 0x55, 0x59, 0xed, 0xd6, 0x06,
+	0x61, 0x15, 0xf9, 0x8d, 0x78, 0x39, 0x7b, 0x84,
+	0x7a, 0x40, 0x45, 0x13, 0x1a, 0x91, 0x71, 0x8f,
+	0xd1, 0x4f, 0x78, 0x10, 0x68, 0x9b, 0x15, 0x79,
+	0x3f, 0x79, 0x2d, 0x9b, 0xc7, 0x5d, 0xa3, 0xcf,
+	0xa9, 0x14, 0xb0, 0xc4, 0xdb, 0xa9, 0x45, 0x6a,
+	0x6e, 0x60, 0x45, 0x0b, 0x14, 0x25, 0xc7, 0x74,
+	0xd0, 0x36, 0xaf, 0xc5, 0xbd, 0x4f, 0x7b, 0xc0,
+	0x04, 0x43, 0x85, 0xbb, 0x06, 0x36, 0x77, 0x26,
+	0x02, 0x23, 0x0b, 0xf8, 0x57, 0x8f, 0x1f, 0x27,
+	0x30, 0x95, 0xff, 0x83, 0x23, 0x2b, 0x49, 0x33,
+	0x43, 0x62, 0x87, 0x5d, 0x27, 0x12, 0x1a, 0x68,
+	0x7b, 0xba, 0x2d, 0xf6, 0xed, 0x2c, 0x26, 0xb5,
+	0xbb, 0xe2, 0x6f, 0xc2, 0x61, 0x17, 0xfc, 0x72,
+	0x14, 0x57, 0x2c, 0x2c, 0x5a, 0x92, 0x13, 0x41,
+	0xc4, 0x7e, 0xb5, 0x64, 0x5b, 0x86, 0x57, 0x13,
+	0x14, 0xff, 0xf5, 0x04, 0xb9, 0x3d, 0x2d, 0xc3,
+	0xe9, 0x75, 0x1f, 0x68, 0x0b, 0xb5, 0x76, 0xe1,
+	0x7d, 0xe3, 0xb0, 0x14, 0xa8, 0x45, 0x05, 0x98,
+	0x81, 0x32, 0xc1, 0xf5, 0x49, 0x4d, 0x58, 0xa4,
+	0xee, 0xd8, 0x84, 0xba, 0x65, 0x07, 0x8d, 0xf7,
+	0x9a, 0xff, 0x7d, 0xa5, 0xbc, 0x9a, 0xed, 0x4a,
+	0x5d, 0xa4, 0x97, 0x4b, 0x4d, 0x31, 0x90, 0xb5,
+	0x7d, 0x28, 0x77, 0x25, 0x88, 0x1c, 0xbf, 0x78,
+	0x22, 0xb2, 0xb5, 0x5c, 0x9a, 0xc9, 0x63, 0x17,
+	0x96, 0xe9, 0xc2, 0x52, 0x30, 0xb8, 0x9b, 0x37,
+	0x69, 0x1a, 0x6a, 0x66, 0x76, 0x18, 0xac, 0xc0,
+	0x48, 0xee, 0x46, 0x5b, 0xbe, 0x6a, 0xd5, 0x72,
+	0x07, 0xdc, 0x7d, 0x05, 0xbe, 0x76, 0x7d, 0xa5,
+	0x5e, 0x53, 0xb5, 0x47, 0x80, 0x58, 0xf0, 0xaf,
+	0x6f, 0x4e, 0xc0, 0xf1, 0x1e, 0x37, 0x64, 0x15,
+	0x42, 0x96, 0x18, 0x3a, 0x89, 0xc8, 0x14, 0x48,
+	0x89, 0x5c, 0x12, 0x88, 0x98, 0x0b, 0x7b, 0x4e,
+	0xce, 0x1c, 0xda, 0xd5, 0xa4, 0xd3, 0x32, 0x32,
+	0x74, 0x5b, 0xcc, 0xfd, 0x2b, 0x02, 0xfb, 0xae,
+	0xd0, 0x5a, 0x4c, 0xc9, 0xc1, 0x35, 0x19, 0x90,
+	0x5f, 0xca, 0x14, 0xeb, 0x4c, 0x17, 0xd7, 0xe3,
+	0xe2, 0x5d, 0xb4, 0x49, 0xaa, 0xf0, 0x50, 0x87,
+	0xc3, 0x20, 0x00, 0xda, 0xe9, 0x04, 0x80, 0x64,
+	0xac, 0x9f, 0xcd, 0x26, 0x41, 0x48, 0xe8, 0x4c,
+	0x46, 0xcc, 0x5b, 0xd7, 0xca, 0x4c, 0x1b, 0x43,
+	0x43, 0x1e, 0xbd, 0x94, 0xe7, 0xa7, 0xa6, 0x86,
+	0xe5, 0xd1, 0x78, 0x29, 0xa2, 0x40, 0xc5, 0xc5,
+	0x47, 0xb6, 0x6d, 0x53, 0xde, 0xac, 0x97, 0x74,
+	0x24, 0x57, 0xcc, 0x05, 0x93, 0xfd, 0x52, 0x35,
+	0x29, 0xd5, 0xe0, 0xfa, 0x23, 0x0d, 0xd7, 0xaa,
+	0x8b, 0x07, 0x4b, 0xf6, 0x64, 0xc7, 0xad, 0x3c,
+	0xa1, 0xb5, 0xc5, 0x70, 0xaf, 0x46, 0xfe, 0x9a,
+	0x82, 0x4d, 0x75, 0xb8, 0x6d, 0x67, 0x70, 0x75,
+	0x62, 0x41, 0x72, 0x65, 0x61, 0x58, 0x76, 0x00,
+	0x23, 0x00, 0x0b, 0x00, 0x04, 0x00, 0x72, 0x00,
+	0x20, 0x9d, 0xff, 0xcb, 0xf3, 0x6c, 0x38, 0x3a,
+	0xe6, 0x99, 0xfb, 0x98, 0x68, 0xdc, 0x6d, 0xcb,
+	0x89, 0xd7, 0x15, 0x38, 0x84, 0xbe, 0x28, 0x03,
+	0x92, 0x2c, 0x12, 0x41, 0x58, 0xbf, 0xad, 0x22,
+	0xae, 0x00, 0x10, 0x00, 0x10, 0x00, 0x03, 0x00,
+	0x10, 0x00, 0x20, 0xfb, 0xd6, 0xba, 0x74, 0xe6,
+	0x6e, 0x5c, 0x87, 0xef, 0x89, 0xa2, 0xe8, 0x3d,
+	0x0b, 0xe9, 0x69, 0x2c, 0x07, 0x07, 0x7a, 0x8a,
+	0x1e, 0xce, 0x12, 0xea, 0x3b, 0xb3, 0xf1, 0xf3,
+	0xd9, 0xc3, 0xe6, 0x00, 0x20, 0x3c, 0x68, 0x51,
+	0x94, 0x54, 0x8d, 0xeb, 0x9f, 0xb2, 0x2c, 0x66,
+	0x75, 0xb6, 0xb7, 0x55, 0x22, 0x0d, 0x87, 0x59,
+	0xc4, 0x39, 0x91, 0x62, 0x17, 0xc2, 0xc3, 0x53,
+	0xa5, 0x26, 0x97, 0x4f, 0x2d, 0x68, 0x63, 0x65,
+	0x72, 0x74, 0x49, 0x6e, 0x66, 0x6f, 0x58, 0xa1,
+	0xff, 0x54, 0x43, 0x47, 0x80, 0x17, 0x00, 0x22,
+	0x00, 0x0b, 0x73, 0xbe, 0xb7, 0x40, 0x82, 0xc0,
+	0x49, 0x9a, 0xf7, 0xf2, 0xd0, 0x79, 0x6c, 0x88,
+	0xf3, 0x56, 0x7b, 0x7a, 0x7d, 0xcd, 0x70, 0xd1,
+	0xbc, 0x41, 0x88, 0x48, 0x51, 0x03, 0xf3, 0x58,
+	0x3e, 0xb8, 0x00, 0x14, 0x9f, 0x57, 0x39, 0x67,
+	0xa8, 0x7b, 0xd8, 0xf6, 0x9e, 0x75, 0xc9, 0x85,
+	0xab, 0xe3, 0x55, 0xc7, 0x9c, 0xf6, 0xd8, 0x4f,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x36, 0x1c, 0x12,
+	0xfd, 0xc6, 0x05, 0xc6, 0x2b, 0xf5, 0xe9, 0x88,
+	0x01, 0x1f, 0x70, 0x8d, 0x98, 0x2a, 0x04, 0x21,
+	0x30, 0x00, 0x22, 0x00, 0x0b, 0xf4, 0xfd, 0x9a,
+	0x33, 0x55, 0x21, 0x08, 0x27, 0x48, 0x55, 0x01,
+	0x56, 0xf9, 0x0b, 0x4e, 0x47, 0x55, 0x08, 0x2e,
+	0x3c, 0x91, 0x3d, 0x6e, 0x53, 0xcf, 0x08, 0xe9,
+	0x0a, 0x4b, 0xc9, 0x7e, 0x99, 0x00, 0x22, 0x00,
+	0x0b, 0x51, 0xd3, 0x38, 0xfe, 0xaa, 0xda, 0xc6,
+	0x68, 0x84, 0x39, 0xe7, 0xb1, 0x03, 0x22, 0x5e,
+	0xc4, 0xd3, 0xf1, 0x0c, 0xec, 0x35, 0x5d, 0x50,
+	0xa3, 0x9d, 0xab, 0xa1, 0x7b, 0x61, 0x51, 0x8f,
+	0x4e
+};
+
+#endif /* !_BENCH_TPM_H */
@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * fido_assert_verify() per algorithm and fido_cred_verify() per
+ * attestation format. Keys, certificates and signatures are made at
+ * startup, except for the "tpm" statement, which is a fixture.
+ */
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+
+#define _FIDO_INTERNAL
+
+#include <fido.h>
+#include <fido/es256.h>
+#include <fido/es384.h>
+#include <fido/rs256.h>
+#include <fido/eddsa.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../openbsd-compat/openbsd-compat.h"
+#include "bench.h"
+#include "tpm.h"
+
+#define RP_ID	"localhost"
+
+struct iov {
+	const unsigned char	*ptr;
+	size_t			 len;
+};
+
+struct assert_bench {
+	fido_assert_t	*assert;
+	int		 cose;
+	void		*pk;
+};
+
+static const unsigned char cdh[32] = {
+	0xec, 0x8d, 0x8f, 0x78, 0x42, 0x4a, 0x2b, 0xb7,
+	0x82, 0x34, 0xaa, 0xca, 0x07, 0xa1, 0xf6, 0x56,
+	0x42, 0x1c, 0xb6, 0xf6, 0xb3, 0x00, 0x86, 0x52,
+	0x35, 0x2d, 0xa2, 0x62, 0x4a, 0xbe, 0x89, 0x76,
+};
+
+static EVP_PKEY *
+keygen(int cose)
+{
+	EVP_PKEY_CTX	*ctx = NULL;
+	EVP_PKEY	*pkey = NULL;
+	int		 ok = -1;
+
+	switch (cose) {
+	case COSE_ES256:
+	case COSE_ES384:
+		if ((ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL)) == NULL ||
+		    EVP_PKEY_keygen_init(ctx) <= 0 ||
+		    EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx,
+		    cose == COSE_ES256 ? NID_X9_62_prime256v1 :
+		    NID_secp384r1) <= 0)
+			goto fail;
+		break;
+	case COSE_RS256:
+		if ((ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL)) == NULL ||
+		    EVP_PKEY_keygen_init(ctx) <= 0 ||
+		    EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) <= 0)
+			goto fail;
+		break;
+	case COSE_EDDSA:
+		if ((ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519,
+		    NULL)) == NULL || EVP_PKEY_keygen_init(ctx) <= 0)
+			goto fail;
+		break;
+	default:
+		goto fail;
+	}
+
+	if (EVP_PKEY_keygen(ctx, &pkey) <= 0)
+		goto fail;
+
+	ok = 0;
+fail:
+	EVP_PKEY_CTX_free(ctx);
+	if (ok < 0) {
+		EVP_PKEY_free(pkey);
+		pkey = NULL;
+	}
+
+	return (pkey);
+}
+
+/* sign the concatenation of 'n' buffers; ed25519 needs them in one */
+static int
+sign(EVP_PKEY *pkey, int cose, const struct iov *v, size_t n,
+    unsigned char *sig, size_t *siglen)
+{
+	EVP_MD_CTX	*ctx = NULL;
+	const EVP_MD	*md;
+	unsigned char	*msg = NULL;
+	size_t		 len = 0;
+	int		 ok = -1;
+
+	for (size_t i = 0; i < n; i++)
+		len += v[i].len;
+	if ((msg = malloc(len)) == NULL)
+		goto fail;
+	len = 0;
+	for (size_t i = 0; i < n; i++) {
+		memcpy(msg + len, v[i].ptr, v[i].len);
+		len += v[i].len;
+	}
+
+	switch (cose) {
+	case COSE_ES384:
+		md = EVP_sha384();
+		break;
+	case COSE_EDDSA:
+		md = NULL;
+		break;
+	default:
+		md = EVP_sha256();
+		break;
+	}
+
+	if ((ctx = EVP_MD_CTX_new()) == NULL ||
+	    EVP_DigestSignInit(ctx, NULL, md, NULL, pkey) != 1 ||
+	    EVP_DigestSign(ctx, sig, siglen, msg, len) != 1)
+		goto fail;
+
+	ok = 0;
+fail:
+	EVP_MD_CTX_free(ctx);
+	free(msg);
+
+	return (ok);
+}
+
+static int
+rp_id_hash(unsigned char *hash)
+{
+	return (SHA256((const unsigned char *)RP_ID, strlen(RP_ID),
+	    hash) == hash ? 0 : -1);
+}
+
+static void
+pk_free(int cose, void *pk)
+{
+	switch (cose) {
+	case COSE_ES256:
+		es256_pk_free((es256_pk_t **)&pk);
+		break;
+	case COSE_ES384:
+		es384_pk_free((es384_pk_t **)&pk);
+		break;
+	case COSE_RS256:
+		rs256_pk_free((rs256_pk_t **)&pk);
+		break;
+	case COSE_EDDSA:
+		eddsa_pk_free((eddsa_pk_t **)&pk);
+		break;
+	}
+}
+
+static void *
+pk_new(int cose, const EVP_PKEY *pkey)
+{
+	void	*pk = NULL;
+	int	 r = FIDO_ERR_INTERNAL;
+
+	switch (cose) {
+	case COSE_ES256:
+		if ((pk = es256_pk_new()) != NULL)
+			r = es256_pk_from_EVP_PKEY(pk, pkey);
+		break;
+	case COSE_ES384:
+		if ((pk = es384_pk_new()) != NULL)
+			r = es384_pk_from_EVP_PKEY(pk, pkey);
+		break;
+	case COSE_RS256:
+		if ((pk = rs256_pk_new()) != NULL)
+			r = rs256_pk_from_EVP_PKEY(pk, pkey);
+		break;
+	case COSE_EDDSA:
+		if ((pk = eddsa_pk_new()) != NULL)
+			r = eddsa_pk_from_EVP_PKEY(pk, pkey);
+		break;
+	}
+
+	if (r != FIDO_OK) {
+		pk_free(cose, pk);
+		return (NULL);
+	}
+
+	return (pk);
+}
+
+static int
+assert_setup(struct assert_bench *b, int cose)
+{
+	EVP_PKEY	*pkey = NULL;
+	unsigned char	 authdata[37];
+	unsigned char	 sig[512];
+	size_t		 siglen = sizeof(sig);
+	struct iov	 msg[2];
+	int		 ok = -1;
+
+	memset(b, 0, sizeof(*b));
+	b->cose = cose;
+
+	/* rpIdHash, flags (up), signCount */
+	memset(authdata, 0, sizeof(authdata));
+	if (rp_id_hash(authdata) < 0)
+		goto fail;
+	authdata[32] = 0x01;
+	authdata[36] = 0x01;
+
+	msg[0].ptr = authdata;
+	msg[0].len = sizeof(authdata);
+	msg[1].ptr = cdh;
+	msg[1].len = sizeof(cdh);
+
+	if ((pkey = keygen(cose)) == NULL ||
+	    sign(pkey, cose, msg, 2, sig, &siglen) < 0 ||
+	    (b->pk = pk_new(cose, pkey)) == NULL ||
+	    (b->assert = fido_assert_new()) == NULL ||
+	    fido_assert_set_count(b->assert, 1) != FIDO_OK ||
+	    fido_assert_set_rp(b->assert, RP_ID) != FIDO_OK ||
+	    fido_assert_set_clientdata_hash(b->assert, cdh,
+	    sizeof(cdh)) != FIDO_OK ||
+	    fido_assert_set_authdata_raw(b->assert, 0, authdata,
+	    sizeof(authdata)) != FIDO_OK ||
+	    fido_assert_set_sig(b->assert, 0, sig, siglen) != FIDO_OK)
+		goto fail;
+
+	ok = 0;
+fail:
+	EVP_PKEY_free(pkey);
+
+	return (ok);
+}
+
+static void
+assert_teardown(struct assert_bench *b)
+{
+	fido_assert_free(&b->assert);
+	pk_free(b->cose, b->pk);
+}
+
+static int
+assert_verify(void *arg)
+{
+	struct assert_bench *b = arg;
+
+	return (fido_assert_verify(b->assert, 0, b->cose, b->pk) == FIDO_OK ?
+	    0 : -1);
+}
+
+static X509 *
+self_signed(EVP_PKEY *pkey)
+{
+	X509		*cert;
+	X509_NAME	*name;
+
+	if ((cert = X509_new()) == NULL ||
+	    X509_set_version(cert, 2) != 1 ||
+	    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1) != 1 ||
+	    X509_gmtime_adj(X509_getm_notBefore(cert), 0) == NULL ||
+	    X509_gmtime_adj(X509_getm_notAfter(cert), 86400) == NULL ||
+	    X509_set_pubkey(cert, pkey) != 1 ||
+	    (name = X509_get_subject_name(cert)) == NULL ||
+	    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+	    (const unsigned char *)"bench", -1, -1, 0) != 1 ||
+	    X509_set_issuer_name(cert, name) != 1 ||
+	    X509_sign(cert, pkey, EVP_sha256()) == 0) {
+		X509_free(cert);
+		return (NULL);
+	}
+
+	return (cert);
+}
+
+/*
+ * authData with attested credential data: rpIdHash, flags (up, at),
+ * signCount, aaguid, credentialId, and the credential key as COSE_Key
+ */
+static size_t
+cred_authdata(unsigned char *ptr, const es256_pk_t *pk,
+    const unsigned char *id, size_t id_len)
+{
+	static const unsigned char cose_hdr[] = {
+		0xa5, 0x01, 0x02, 0x03, 0x26, 0x20, 0x01, 0x21, 0x58, 0x20,
+	};
+	size_t n = 0;
+
+	if (rp_id_hash(ptr) < 0)
+		return (0);
+	n += 32;
+	ptr[n++] = 0x41;
+	memset(ptr + n, 0, 4 + 16);
+	ptr[n + 3] = 0x01;
+	n += 4 + 16;
+	ptr[n++] = (unsigned char)(id_len >> 8);
+	ptr[n++] = (unsigned char)id_len;
+	memcpy(ptr + n, id, id_len);
+	n += id_len;
+	memcpy(ptr + n, cose_hdr, sizeof(cose_hdr));
+	n += sizeof(cose_hdr);
+	memcpy(ptr + n, pk->x, sizeof(pk->x));
+	n += sizeof(pk->x);
+	ptr[n++] = 0x22;
+	ptr[n++] = 0x58;
+	ptr[n++] = 0x20;
+	memcpy(ptr + n, pk->y, sizeof(pk->y));
+	n += sizeof(pk->y);
+
+	return (n);
+}
+
+static fido_cred_t *
+cred_new(const char *fmt, const unsigned char *authdata, size_t authdata_len,
+    const unsigned char *sig, size_t sig_len, const unsigned char *x509,
+    size_t x509_len)
+{
+	fido_cred_t *cred;
+
+	if ((cred = fido_cred_new()) == NULL ||
+	    fido_cred_set_type(cred, COSE_ES256) != FIDO_OK ||
+	    fido_cred_set_rp(cred, RP_ID, NULL) != FIDO_OK ||
+	    fido_cred_set_clientdata_hash(cred, cdh, sizeof(cdh)) != FIDO_OK ||
+	    fido_cred_set_authdata_raw(cred, authdata,
+	    authdata_len) != FIDO_OK ||
+	    fido_cred_set_fmt(cred, fmt) != FIDO_OK ||
+	    fido_cred_set_sig(cred, sig, sig_len) != FIDO_OK ||
+	    (x509 != NULL && fido_cred_set_x509(cred, x509,
+	    x509_len) != FIDO_OK))
+		fido_cred_free(&cred);
+
+	return (cred);
+}
+
+/* packed (full and self attestation) and fido-u2f statements */
+static int
+cred_setup(fido_cred_t **packed, fido_cred_t **self, fido_cred_t **u2f)
+{
+	EVP_PKEY	*att = NULL, *key = NULL;
+	X509		*cert = NULL;
+	es256_pk_t	*pk = NULL;
+	unsigned char	 id[32], authdata[256], sig[128], point[65], prefix;
+	unsigned char	*der = NULL;
+	size_t		 authdata_len, siglen;
+	struct iov	 msg[5];
+	int		 der_len, ok = -1;
+
+	*packed = *self = *u2f = NULL;
+
+	memset(id, 0x2a, sizeof(id));
+
+	if ((att = keygen(COSE_ES256)) == NULL ||
+	    (key = keygen(COSE_ES256)) == NULL ||
+	    (cert = self_signed(att)) == NULL ||
+	    (der_len = i2d_X509(cert, &der)) <= 0 ||
+	    (pk = pk_new(COSE_ES256, key)) == NULL ||
+	    (authdata_len = cred_authdata(authdata, pk, id, sizeof(id))) == 0)
+		goto fail;
+
+	msg[0].ptr = authdata;
+	msg[0].len = authdata_len;
+	msg[1].ptr = cdh;
+	msg[1].len = sizeof(cdh);
+
+	siglen = sizeof(sig);
+	if (sign(att, COSE_ES256, msg, 2, sig, &siglen) < 0 ||
+	    (*packed = cred_new("packed", authdata, authdata_len, sig, siglen,
+	    der, (size_t)der_len)) == NULL)
+		goto fail;
+
+	siglen = sizeof(sig);
+	if (sign(key, COSE_ES256, msg, 2, sig, &siglen) < 0 ||
+	    (*self = cred_new("packed", authdata, authdata_len, sig, siglen,
+	    NULL, 0)) == NULL)
+		goto fail;
+
+	/* 0x00, rpIdHash, clientDataHash, credentialId, 0x04 || x || y */
+	prefix = 0x00;
+	point[0] = 0x04;
+	memcpy(point + 1, pk->x, sizeof(pk->x));
+	memcpy(point + 1 + sizeof(pk->x), pk->y, sizeof(pk->y));
+	msg[0].ptr = &prefix;
+	msg[0].len = sizeof(prefix);
+	msg[1].ptr = authdata; /* rpIdHash */
+	msg[1].len = 32;
+	msg[2].ptr = cdh;
+	msg[2].len = sizeof(cdh);
+	msg[3].ptr = id;
+	msg[3].len = sizeof(id);
+	msg[4].ptr = point;
+	msg[4].len = sizeof(point);
+
+	siglen = sizeof(sig);
+	if (sign(att, COSE_ES256, msg, 5, sig, &siglen) < 0 ||
+	    (*u2f = cred_new("fido-u2f", authdata, authdata_len, sig, siglen,
+	    der, (size_t)der_len)) == NULL)
+		goto fail;
+
+	ok = 0;
+fail:
+	if (ok < 0) {
+		fido_cred_free(packed);
+		fido_cred_free(self);
+		fido_cred_free(u2f);
+	}
+	EVP_PKEY_free(att);
+	EVP_PKEY_free(key);
+	X509_free(cert);
+	OPENSSL_free(der);
+	es256_pk_free(&pk);
+
+	return (ok);
+}
+
+static fido_cred_t *
+tpm_setup(void)
+{
+	fido_cred_t *cred;
+
+	if ((cred = fido_cred_new()) == NULL ||
+	    fido_cred_set_type(cred, COSE_ES256) != FIDO_OK ||
+	    fido_cred_set_clientdata(cred, tpm_clientdata,
+	    sizeof(tpm_clientdata)) != FIDO_OK ||
+	    fido_cred_set_rp(cred, RP_ID, NULL) != FIDO_OK ||
+	    fido_cred_set_authdata(cred, tpm_authdata,
+	    sizeof(tpm_authdata)) != FIDO_OK ||
+	    fido_cred_set_uv(cred, FIDO_OPT_TRUE) != FIDO_OK ||
+	    fido_cred_set_fmt(cred, "tpm") != FIDO_OK ||
+	    fido_cred_set_attstmt(cred, tpm_attstmt,
+	    sizeof(tpm_attstmt)) != FIDO_OK)
+		fido_cred_free(&cred);
+
+	return (cred);
+}
+
+static int
+cred_verify(void *arg)
+{
+	return (fido_cred_verify(arg) == FIDO_OK ? 0 : -1);
+}
+
+static int
+cred_verify_self(void *arg)
+{
+	return (fido_cred_verify_self(arg) == FIDO_OK ? 0 : -1);
+}
+
+static void
+skip(const char *name)
+{
+	printf("%-32s %12s\n", name, "unsupported");
+}
+
+void
+bench_verify(void)
+{
+	static const struct {
+		const char	*name;
+		int		 cose;
+	} alg[] = {
+		{ "assert_verify/es256", COSE_ES256 },
+		{ "assert_verify/es384", COSE_ES384 },
+		{ "assert_verify/rs256", COSE_RS256 },
+		{ "assert_verify/eddsa", COSE_EDDSA },
+	};
+	struct assert_bench	 b;
+	fido_cred_t		*packed, *self, *u2f, *tpm;
+
+	for (size_t i = 0; i < nitems(alg); i++) {
+		if (assert_setup(&b, alg[i].cose) < 0 ||
+		    assert_verify(&b) < 0)
+			skip(alg[i].name);
+		else
+			bench_run(alg[i].name, assert_verify, &b);
+		assert_teardown(&b);
+	}
+
+	if (cred_setup(&packed, &self, &u2f) < 0)
+		errx(1, "%s: cred_setup", __func__);
+
+	bench_run("cred_verify/packed", cred_verify, packed);
+	bench_run("cred_verify/packed-self", cred_verify_self, self);
+	bench_run("cred_verify/fido-u2f", cred_verify, u2f);
+
+	/* the statement is signed with sha-1, which some systems refuse */
+	if ((tpm = tpm_setup()) == NULL || cred_verify(tpm) < 0)
+		skip("cred_verify/tpm");
+	else
+		bench_run("cred_verify/tpm", cred_verify, tpm);
+
+	fido_cred_free(&packed);
+	fido_cred_free(&self);
+	fido_cred_free(&u2f);
+	fido_cred_free(&tpm);
+}
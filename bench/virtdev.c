@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../fuzz/wiredata_fido2.h"
+#include "virtdev.h"
+
+#define REPORT_LEN	64
+#define REPLY_MAX	(32 * REPORT_LEN)
+#define ERR_INVALID_CMD	0x01 /* CTAPHID_ERROR and CTAP2 status code */
+
+struct virtdev {
+	unsigned char	cid[4];
+	unsigned char	reply[REPLY_MAX];
+	size_t		reply_len;
+	size_t		reply_off;
+	unsigned long	delay_us; /* left before the reply is readable */
+};
+
+static const unsigned char wire_init[] = { WIREDATA_CTAP_INIT };
+static const unsigned char wire_info[] = { WIREDATA_CTAP_CBOR_INFO };
+static const unsigned char wire_cred[] = { WIREDATA_CTAP_CBOR_CRED };
+static const unsigned char wire_assert[] = { WIREDATA_CTAP_CBOR_ASSERT };
+
+static unsigned int latency_us;
+
+static void
+sleep_us(unsigned long us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(us / 1000000);
+	ts.tv_nsec = (long)(us % 1000000) * 1000;
+
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+		continue;
+}
+
+/* queue the frames in 'wire', addressed to 'cid' */
+static void
+queue(struct virtdev *v, const unsigned char *wire, size_t len,
+    const unsigned char *cid)
+{
+	if (len > sizeof(v->reply))
+		len = sizeof(v->reply) - sizeof(v->reply) % REPORT_LEN;
+
+	memcpy(v->reply, wire, len);
+	for (size_t i = 0; i < len; i += REPORT_LEN)
+		memcpy(&v->reply[i], cid, sizeof(v->cid));
+
+	v->reply_len = len;
+	v->reply_off = 0;
+	v->delay_us = latency_us;
+}
+
+static void
+queue_error(struct virtdev *v, const unsigned char *cid, uint8_t cmd)
+{
+	unsigned char frame[REPORT_LEN];
+
+	memset(frame, 0, sizeof(frame));
+	frame[4] = CTAP_FRAME_INIT | cmd;
+	frame[6] = 1; /* bcnt */
+	frame[7] = ERR_INVALID_CMD;
+
+	queue(v, frame, sizeof(frame), cid);
+}
+
+static void
+queue_cbor(struct virtdev *v, const unsigned char *cid, uint8_t cbor_cmd)
+{
+	switch (cbor_cmd) {
+	case CTAP_CBOR_GETINFO:
+		queue(v, wire_info, sizeof(wire_info), cid);
+		break;
+	case CTAP_CBOR_MAKECRED:
+		queue(v, wire_cred, sizeof(wire_cred), cid);
+		break;
+	case CTAP_CBOR_ASSERT:
+		queue(v, wire_assert, sizeof(wire_assert), cid);
+		break;
+	default:
+		queue_error(v, cid, CTAP_CMD_CBOR);
+		break;
+	}
+}
+
+static void *
+virtdev_open(const char *path)
+{
+	struct virtdev	*v;
+	uint32_t	 cid;
+
+	(void)path;
+
+	if ((v = calloc(1, sizeof(*v))) == NULL)
+		return (NULL);
+
+	/* unique among open devices, and never the broadcast channel */
+	cid = (uint32_t)((uintptr_t)v >> 4) | 1;
+	if (cid == UINT32_MAX)
+		cid = 1;
+	memcpy(v->cid, &cid, sizeof(v->cid));
+
+	return (v);
+}
+
+static void
+virtdev_close(void *handle)
+{
+	free(handle);
+}
+
+static int
+virtdev_read(void *handle, unsigned char *ptr, size_t len, int ms)
+{
+	struct virtdev *v = handle;
+
+	if (len != REPORT_LEN || v->reply_off == v->reply_len)
+		return (-1);
+
+	if (v->delay_us) {
+		if (ms >= 0 && (unsigned long)ms * 1000 < v->delay_us) {
+			sleep_us((unsigned long)ms * 1000);
+			v->delay_us -= (unsigned long)ms * 1000;
+			return (-1); /* timeout */
+		}
+		sleep_us(v->delay_us);
+		v->delay_us = 0;
+	}
+
+	memcpy(ptr, &v->reply[v->reply_off], len);
+	v->reply_off += len;
+
+	return ((int)len);
+}
+
+static int
+virtdev_write(void *handle, const unsigned char *ptr, size_t len)
+{
+	struct virtdev		*v = handle;
+	const unsigned char	*frame = ptr + 1; /* skip the report id */
+
+	if (len != REPORT_LEN + 1)
+		return (-1);
+
+	/* requests are answered when their first frame arrives */
+	if ((frame[4] & CTAP_FRAME_INIT) == 0)
+		return ((int)len);
+
+	switch (frame[4] & ~CTAP_FRAME_INIT) {
+	case CTAP_CMD_INIT:
+		queue(v, wire_init, sizeof(wire_init), frame);
+		memcpy(&v->reply[7], &frame[7], 8); /* nonce */
+		memcpy(&v->reply[15], v->cid, sizeof(v->cid));
+		break;
+	case CTAP_CMD_CBOR:
+		queue_cbor(v, frame, frame[7]);
+		break;
+	case CTAP_CMD_CANCEL:
+		break; /* no reply */
+	default:
+		queue_error(v, frame, CTAP_CMD_ERROR);
+		break;
+	}
+
+	return ((int)len);
+}
+
+void
+virtdev_io(fido_dev_io_t *io)
+{
+	memset(io, 0, sizeof(*io));
+
+	io->open = virtdev_open;
+	io->close = virtdev_close;
+	io->read = virtdev_read;
+	io->write = virtdev_write;
+}
+
+void
+virtdev_set_latency(unsigned int us)
+{
+	latency_us = us;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _VIRTDEV_H
+#define _VIRTDEV_H
+
+#include <fido.h>
+
+/*
+ * An in-process CTAPHID authenticator. Each fido_dev_open() through
+ * virtdev_io() opens a channel of its own, so devices may be used from
+ * different threads. CTAPHID_INIT is answered with the caller's nonce;
+ * authenticatorGetInfo, authenticatorMakeCredential and
+ * authenticatorGetAssertion with the replies recorded in
+ * fuzz/wiredata_fido2.h; other commands with CTAP2_ERR_INVALID_COMMAND.
+ */
+
+/* fill 'io' with the virtual device's handlers */
+void virtdev_io(fido_dev_io_t *io);
+
+/*
+ * Delay each reply by 'us' microseconds; a read with a shorter timeout
+ * times out. Set before opening devices.
+ */
+void virtdev_set_latency(unsigned int us);
+
+#endif /* !_VIRTDEV_H */
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Share a HID authenticator with other processes over a unix socket,
+ * until the device is removed. Clients open "broker:<socket>".
+ */
+
+#include <fido.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../openbsd-compat/openbsd-compat.h"
+
+int
+main(int argc, char **argv)
+{
+	fido_broker_t	*b;
+	int		 r;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: broker <device> <socket>\n");
+		exit(EXIT_FAILURE);
+	}
+
+	fido_init(0);
+
+	if ((b = fido_broker_new()) == NULL)
+		errx(1, "fido_broker_new");
+
+	if ((r = fido_broker_open(b, argv[1], argv[2])) != FIDO_OK)
+		errx(1, "fido_broker_open: %s (0x%x)", fido_strerr(r), r);
+
+	while ((r = fido_broker_work(b, -1)) == FIDO_OK)
+		continue;
+
+	fido_broker_free(&b);
+
+	if (r != FIDO_ERR_RX)
+		errx(1, "fido_broker_work: %s (0x%x)", fido_strerr(r), r);
+
+	exit(0);
+}
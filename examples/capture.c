@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Capture the CTAPHID frames exchanged with an authenticator while
+ * querying its information, or render a capture.
+ *
+ * A capture is a sequence of records, each a 16-byte header followed by
+ * a frame. The header holds, in big-endian order: the direction (1
+ * byte; FIDO_CAPTURE_TX or FIDO_CAPTURE_RX), a zero byte, the length of
+ * the frame (2 bytes), the channel id (4 bytes), and a monotonic
+ * timestamp in microseconds (8 bytes).
+ */
+
+#include <fido.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../openbsd-compat/openbsd-compat.h"
+
+#define HDRLEN	16
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: capture -r <file>\n");
+	fprintf(stderr, "       capture <file> <device>\n");
+	exit(EXIT_FAILURE);
+}
+
+static void
+put_be(unsigned char *ptr, uint64_t v, size_t len)
+{
+	for (size_t i = len; i > 0; i--) {
+		ptr[i - 1] = (unsigned char)(v & 0xff);
+		v >>= 8;
+	}
+}
+
+static uint64_t
+get_be(const unsigned char *ptr, size_t len)
+{
+	uint64_t v = 0;
+
+	for (size_t i = 0; i < len; i++)
+		v = v << 8 | ptr[i];
+
+	return (v);
+}
+
+/* called by libfido2 for each frame; should be kept cheap */
+static void
+write_record(void *arg, const fido_capture_t *c)
+{
+	FILE		*f = arg;
+	unsigned char	 hdr[HDRLEN];
+
+	if (c->len > UINT16_MAX)
+		return;
+
+	memset(hdr, 0, sizeof(hdr));
+	hdr[0] = (unsigned char)c->dir;
+	put_be(&hdr[2], c->len, 2);
+	put_be(&hdr[4], c->cid, 4);
+	put_be(&hdr[8], c->ts_us, 8);
+
+	if (fwrite(hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+	    fwrite(c->ptr, 1, c->len, f) != c->len)
+		warnx("%s: fwrite", __func__);
+}
+
+static void
+capture(const char *path, const char *device)
+{
+	fido_dev_t		*dev;
+	fido_cbor_info_t	*ci;
+	FILE			*f;
+	int			 r;
+
+	if ((f = fopen(path, "wb")) == NULL)
+		err(1, "fopen %s", path);
+	if ((dev = fido_dev_new()) == NULL)
+		errx(1, "fido_dev_new");
+	if ((ci = fido_cbor_info_new()) == NULL)
+		errx(1, "fido_cbor_info_new");
+
+	fido_set_capture_handler(write_record, f);
+
+	if ((r = fido_dev_open(dev, device)) != FIDO_OK)
+		errx(1, "fido_dev_open: %s (0x%x)", fido_strerr(r), r);
+	if ((r = fido_dev_get_cbor_info(dev, ci)) != FIDO_OK)
+		errx(1, "fido_dev_get_cbor_info: %s (0x%x)", fido_strerr(r), r);
+	if ((r = fido_dev_close(dev)) != FIDO_OK)
+		errx(1, "fido_dev_close: %s (0x%x)", fido_strerr(r), r);
+
+	fido_set_capture_handler(NULL, NULL);
+
+	if (fclose(f) != 0)
+		err(1, "fclose %s", path);
+
+	fido_cbor_info_free(&ci);
+	fido_dev_free(&dev);
+}
+
+static void
+render(const char *path)
+{
+	FILE		*f;
+	unsigned char	 hdr[HDRLEN];
+	unsigned char	 frame[UINT16_MAX];
+	uint64_t	 t0 = 0, ts;
+	size_t		 len;
+	int		 first = 1;
+
+	if ((f = fopen(path, "rb")) == NULL)
+		err(1, "fopen %s", path);
+
+	while (fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr)) {
+		len = (size_t)get_be(&hdr[2], 2);
+		if (fread(frame, 1, len, f) != len)
+			errx(1, "%s: truncated record", path);
+		ts = get_be(&hdr[8], 8);
+		if (first) {
+			t0 = ts;
+			first = 0;
+		}
+		printf("%10.3f ms %s cid=0x%08llx len=%zu\n",
+		    (double)(ts - t0) / 1000.0,
+		    hdr[0] == FIDO_CAPTURE_TX ? "tx" : "rx",
+		    (unsigned long long)get_be(&hdr[4], 4), len);
+		for (size_t i = 0; i < len; i++)
+			printf("%s%02x%s", i % 16 == 0 ? "  " : " ", frame[i],
+			    i % 16 == 15 || i == len - 1 ? "\n" : "");
+	}
+
+	if (ferror(f))
+		err(1, "fread %s", path);
+
+	fclose(f);
+}
+
+int
+main(int argc, char **argv)
+{
+	fido_init(0);
+
+	if (argc == 3 && strcmp(argv[1], "-r") == 0)
+		render(argv[2]);
+	else if (argc == 3)
+		capture(argv[1], argv[2]);
+	else
+		usage();
+
+	exit(0);
+}
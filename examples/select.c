@@ -166,13 +166,12 @@ out:
 		*idx = 0;
 	}
 
-	for (size_t i = 0; i < ndevs; i++) {
-		if (devtab[i] && devtab[i] != *dev) {
-			fido_dev_cancel(devtab[i]);
-			fido_dev_close(devtab[i]);
-			fido_dev_free(&devtab[i]);
-		}
-	}
+	for (size_t i = 0; i < ndevs; i++)
+		if (devtab[i] == *dev)
+			devtab[i] = NULL; /* keep the selected device open */
+	fido_dev_cancel_many(devtab, ndevs);
+	for (size_t i = 0; i < ndevs; i++)
+		fido_dev_free(&devtab[i]);
 
 	free(devtab);
 
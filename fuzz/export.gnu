@@ -223,6 +223,7 @@
 		fido_dev_info_product;
 		fido_dev_info_product_string;
 		fido_dev_info_ptr;
+		fido_dev_info_serial_string;
 		fido_dev_info_set;
 		fido_dev_info_vendor;
 		fido_dev_is_fido2;
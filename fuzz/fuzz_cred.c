@@ -440,7 +440,7 @@ test(const struct param *p)
 {
 	prng_init((unsigned int)p->seed);
 	fuzz_clock_reset();
-	fido_init(FIDO_DEBUG);
+	fuzz_fido_init();
 	fido_set_log_handler(consume_str);
 
 	test_cred(p);
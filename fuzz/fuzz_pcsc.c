@@ -173,6 +173,7 @@ test_manifest(void)
 		consume_str(fido_dev_info_path(di));
 		consume_str(fido_dev_info_manufacturer_string(di));
 		consume_str(fido_dev_info_product_string(di));
+		consume_str(fido_dev_info_serial_string(di));
 		vendor_id = fido_dev_info_vendor(di);
 		product_id = fido_dev_info_product(di);
 		consume(&vendor_id, sizeof(vendor_id));
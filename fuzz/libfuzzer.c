@@ -15,11 +15,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "mutator_aux.h"
 
 extern int fuzz_save_corpus;
+int fuzz_persist;
 
 static bool debug;
 static unsigned int flags = MUTATE_ALL;
@@ -123,6 +125,56 @@ save_corpus(const struct param *p)
 	return r;
 }
 
+/* run the harness n times on its dummy seed and report execs/s */
+static int
+bench(const char *argv0, const char *opt)
+{
+	const char *name, *s;
+	char *ep;
+	unsigned long n;
+	uint8_t *buf = NULL;
+	struct param *p = NULL;
+	struct timespec t0, t1;
+	double secs;
+	int status = 1;
+
+	if ((s = strchr(opt, '=')) == NULL || *++s == '\0' ||
+	    (n = strtoul(s, &ep, 10)) == 0 || *ep != '\0') {
+		warnx("usage: --fido-bench=<iterations>");
+		goto fail;
+	}
+	if ((buf = malloc(MAXCORPUS)) == NULL) {
+		warn("malloc");
+		goto fail;
+	}
+	if ((p = unpack(buf, pack_dummy(buf, MAXCORPUS))) == NULL) {
+		warnx("unpack");
+		goto fail;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (unsigned long i = 0; i < n; i++)
+		test(p);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	secs = (double)(t1.tv_sec - t0.tv_sec) +
+	    (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+	if ((name = strrchr(argv0, '/')) != NULL)
+		name++;
+	else
+		name = argv0;
+	printf("%s%s: %lu execs in %.3fs, %.0f execs/s\n", name,
+	    fuzz_persist ? " (persist)" : "", n, secs,
+	    secs > 0 ? (double)n / secs : 0);
+
+	status = 0;
+fail:
+	free(buf);
+	free(p);
+
+	return status;
+}
+
 static void
 parse_mutate_flags(const char *opt, unsigned int *mutate_flags)
 {
@@ -145,6 +197,7 @@ int
 LLVMFuzzerInitialize(int *argc, char ***argv)
 {
 	unsigned int mutate_flags = 0;
+	const char *bench_opt = NULL;
 
 	for (int i = 0; i < *argc; i++)
 		if (strcmp((*argv)[i], "--fido-debug") == 0) {
@@ -153,10 +206,16 @@ LLVMFuzzerInitialize(int *argc, char ***argv)
 			exit(save_seed((*argv)[i]));
 		} else if (strncmp((*argv)[i], "--fido-mutate=", 14) == 0) {
 			parse_mutate_flags((*argv)[i], &mutate_flags);
+		} else if (strcmp((*argv)[i], "--fido-persist") == 0) {
+			fuzz_persist = 1;
+		} else if (strncmp((*argv)[i], "--fido-bench=", 13) == 0) {
+			bench_opt = (*argv)[i];
 		}
 
 	if (mutate_flags)
 		flags = mutate_flags;
+	if (bench_opt != NULL)
+		exit(bench((*argv)[0], bench_opt));
 
 	return 0;
 }
@@ -15,15 +15,21 @@
 #include <string.h>
 
 #include "mutator_aux.h"
+#include "wiredata_fido2.h"
 
 int fido_nfc_rx(fido_dev_t *, uint8_t, unsigned char *, size_t, int);
 int fido_nfc_tx(fido_dev_t *, uint8_t, const unsigned char *, size_t);
 size_t LLVMFuzzerMutate(uint8_t *, size_t, size_t);
 
 extern int prng_up;
+extern int fuzz_persist;
 static const uint8_t *wire_data_ptr = NULL;
 static size_t wire_data_len = 0;
 
+/* the open replayed by --fido-persist */
+static const uint8_t persist_init[] = { WIREDATA_CTAP_INIT };
+static const uint8_t persist_info[] = { WIREDATA_CTAP_CBOR_INFO };
+
 void
 consume(const void *body, size_t len)
 {
@@ -284,6 +290,66 @@ fd_write(int fd, const void *ptr, size_t len)
 	return buf_write(ptr, len);
 }
 
+static void
+skip_wire_data(const uint8_t *ptr, size_t len)
+{
+	if (wire_data_len >= len && memcmp(wire_data_ptr, ptr, len) == 0) {
+		wire_data_ptr += len;
+		wire_data_len -= len;
+	}
+}
+
+/*
+ * With --fido-persist, the channel and authenticatorGetInfo reply of a
+ * canned open are cached by libfido2, and later opens are served from
+ * that snapshot. Should the cache have been dropped, the canned open is
+ * replayed without fault injection, so that no wire data is consumed
+ * either way. Wire data recorded without --fido-persist starts with an
+ * open, which is skipped if unmodified.
+ */
+static int
+persist_open(fido_dev_t *dev)
+{
+	const uint8_t	*ptr = wire_data_ptr;
+	size_t		 len = wire_data_len;
+	uint8_t		 canned[sizeof(persist_init) + sizeof(persist_info)];
+	int		 up = prng_up;
+	int		 r;
+
+	memcpy(canned, persist_init, sizeof(persist_init));
+	memcpy(canned + sizeof(persist_init), persist_info,
+	    sizeof(persist_info));
+
+	prng_up = 0;
+	set_wire_data(canned, sizeof(canned));
+	r = fido_dev_open(dev, "nodev");
+	set_wire_data(ptr, len);
+	prng_up = up;
+
+	skip_wire_data(persist_init, sizeof(persist_init));
+	skip_wire_data(persist_info, sizeof(persist_info));
+
+	return r;
+}
+
+/*
+ * Per-input library initialisation. With --fido-persist, the library is
+ * initialised once, with channel and authenticatorGetInfo caching, so
+ * that the snapshot taken by persist_open() survives across inputs.
+ */
+void
+fuzz_fido_init(void)
+{
+	static int done;
+
+	if (!fuzz_persist)
+		fido_init(FIDO_DEBUG);
+	else if (!done) {
+		fido_init(FIDO_DEBUG | FIDO_CHANNEL_CACHE | FIDO_INFO_CACHE);
+		done = 1;
+	}
+}
+
 fido_dev_t *
 open_dev(int nfc)
 {
@@ -320,7 +386,8 @@ open_dev(int nfc)
 	}
 
 	if (fido_dev_set_timeout(dev, 300) != FIDO_OK ||
-	    fido_dev_open(dev, "nodev") != FIDO_OK)
+	    (fuzz_persist && !nfc ? persist_open(dev) :
+	    fido_dev_open(dev, "nodev")) != FIDO_OK)
 		goto fail;
 
 	return dev;
@@ -96,6 +96,7 @@ int nfc_read(void *, unsigned char *, size_t, int);
 int nfc_write(void *, const unsigned char *, size_t);
 
 fido_dev_t *open_dev(int);
+void fuzz_fido_init(void);
 void set_wire_data(const uint8_t *, size_t);
 
 void fuzz_clock_reset(void);
@@ -25,6 +25,10 @@ LONG __wrap_SCardReleaseContext(SCARDCONTEXT);
 LONG __wrap_SCardConnect(SCARDCONTEXT, LPCSTR, DWORD, DWORD, LPSCARDHANDLE,
     LPDWORD);
 LONG __wrap_SCardDisconnect(SCARDHANDLE, DWORD);
+LONG __wrap_SCardBeginTransaction(SCARDHANDLE);
+LONG __wrap_SCardEndTransaction(SCARDHANDLE, DWORD);
+LONG __wrap_SCardStatus(SCARDHANDLE, LPSTR, LPDWORD, LPDWORD, LPDWORD, LPBYTE,
+    LPDWORD);
 LONG __wrap_SCardTransmit(SCARDHANDLE, const SCARD_IO_REQUEST *, LPCBYTE,
     DWORD, SCARD_IO_REQUEST *, LPBYTE, LPDWORD);
 
@@ -113,6 +117,45 @@ __wrap_SCardDisconnect(SCARDHANDLE hCard, DWORD dwDisposition)
 	return SCARD_S_SUCCESS;
 }
 
+LONG
+__wrap_SCardBeginTransaction(SCARDHANDLE hCard)
+{
+	assert(hCard == 1);
+
+	if (uniform_random(400) < 1)
+		return SCARD_E_SHARING_VIOLATION;
+
+	return SCARD_S_SUCCESS;
+}
+
+LONG
+__wrap_SCardEndTransaction(SCARDHANDLE hCard, DWORD dwDisposition)
+{
+	assert(hCard == 1);
+	assert(dwDisposition == SCARD_LEAVE_CARD);
+
+	return SCARD_S_SUCCESS;
+}
+
+LONG
+__wrap_SCardStatus(SCARDHANDLE hCard, LPSTR szReaderName,
+    LPDWORD pcchReaderLen, LPDWORD pdwState, LPDWORD pdwProtocol,
+    LPBYTE pbAtr, LPDWORD pcbAtrLen)
+{
+	assert(hCard == 1);
+	(void)szReaderName;
+	(void)pcchReaderLen;
+	(void)pdwState;
+	(void)pdwProtocol;
+	(void)pbAtr;
+	(void)pcbAtrLen;
+
+	if (uniform_random(400) < 1)
+		return SCARD_W_REMOVED_CARD;
+
+	return SCARD_S_SUCCESS;
+}
+
 extern void consume(const void *body, size_t len);
 
 LONG
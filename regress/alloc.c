@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <string.h>
+
+#define _FIDO_INTERNAL
+
+#include <fido.h>
+
+static void
+secure_pool(void)
+{
+	const unsigned char	 pin[] = "1234";
+	fido_blob_t		 b[3];
+	unsigned char		*p;
+
+	memset(b, 0, sizeof(b));
+
+	/* one slot per class; secrets spill into larger slots, then the heap */
+	assert(fido_set_secure_pool(1) == FIDO_OK);
+	assert((p = fido_secure_alloc(FIDO_MAXMSG)) != NULL);
+	assert(fido_secure_size(p) == FIDO_MAXMSG);
+	for (size_t i = 0; i < 3; i++)
+		assert(fido_blob_set_secure(&b[i], pin, sizeof(pin)) == 0);
+	assert(fido_secure_size(b[0].ptr) == 32);
+	assert(fido_secure_size(b[1].ptr) == 64);
+	assert(fido_secure_size(b[2].ptr) == 0);
+	for (size_t i = 0; i < 3; i++)
+		fido_blob_reset(&b[i]);
+	fido_freezero(p, FIDO_MAXMSG);
+
+	assert(fido_set_secure_pool(2) == FIDO_OK);
+	for (size_t i = 0; i < 3; i++)
+		assert(fido_blob_set_secure(&b[i], pin, sizeof(pin)) == 0);
+	assert(fido_secure_size(b[0].ptr) == 32);
+	assert(fido_secure_size(b[1].ptr) == 32);
+	assert(fido_secure_size(b[2].ptr) == 64);
+	assert(fido_set_secure_pool(0) == FIDO_ERR_INTERNAL);
+
+	/* released slots are cleared and reused */
+	p = b[1].ptr;
+	fido_blob_reset(&b[1]);
+	assert(p[0] == 0);
+	assert((p = fido_secure_alloc(33)) != NULL);
+	assert(fido_secure_size(p) == 64);
+	fido_freezero(p, 33);
+	assert(fido_blob_set_secure(&b[1], pin, sizeof(pin)) == 0);
+	assert(fido_secure_size(b[1].ptr) == 32);
+	assert((p = fido_realloc(b[1].ptr, 128)) != NULL);
+	assert(fido_secure_size(p) == FIDO_MAXMSG);
+	assert(memcmp(p, pin, sizeof(pin)) == 0);
+	b[1].ptr = p;
+
+	for (size_t i = 0; i < 3; i++)
+		fido_blob_reset(&b[i]);
+	assert(fido_set_secure_pool(0) == FIDO_OK);
+	assert((p = fido_secure_alloc(32)) != NULL);
+	assert(fido_secure_size(p) == 0);
+	fido_freezero(p, 32);
+}
+
+int
+main(void)
+{
+	fido_init(0);
+
+	secure_pool();
+
+	exit(0);
+}
@@ -8,8 +8,14 @@
 #undef NDEBUG
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+
 #define _FIDO_INTERNAL
 
 #include <fido.h>
@@ -619,6 +625,487 @@ es256_PKEY(void)
 	EVP_PKEY_free(pkey);
 }
 
+/* verification with a prepared public key */
+static void
+prepared_pk(void)
+{
+	fido_assert_t *a;
+	fido_pk_t *pk;
+	es256_pk_t *es256;
+	rs256_pk_t *rs256;
+
+	a = alloc_assert();
+	es256 = alloc_es256_pk();
+	rs256 = alloc_rs256_pk();
+	assert((pk = fido_pk_new()) != NULL);
+	assert(fido_pk_type(pk) == COSE_UNSPEC);
+	assert(es256_pk_from_ptr(es256, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(rs256_pk_from_ptr(rs256, rs256_pk, sizeof(rs256_pk)) == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_set(pk, COSE_UNSPEC, es256) == FIDO_ERR_UNSUPPORTED_OPTION);
+	assert(fido_pk_set(pk, COSE_ES256, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_type(pk) == COSE_UNSPEC);
+	assert(fido_pk_set(pk, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_pk_type(pk) == COSE_ES256);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_OK);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_OK);
+	assert(fido_assert_verify_prepared(a, 1, pk) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_verify_prepared(a, 0, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_set(pk, COSE_RS256, rs256) == FIDO_OK);
+	assert(fido_pk_type(pk) == COSE_RS256);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_ERR_INVALID_SIG);
+	assert(fido_pk_set(pk, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig) - 1) == FIDO_OK);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "example.com") == FIDO_OK);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_ERR_INVALID_PARAM);
+	fido_pk_free(&pk);
+	assert(pk == NULL);
+	fido_pk_free(&pk);
+	fido_pk_free(NULL);
+	free_assert(a);
+	free_es256_pk(es256);
+	free_rs256_pk(rs256);
+}
+
+/* prepared public keys decoded from der and cose */
+static void
+prepared_pk_import(void)
+{
+	fido_assert_t *a;
+	fido_pk_t *pk;
+	es256_pk_t *es256;
+	EVP_PKEY *pkey;
+	unsigned char *der = NULL;
+	unsigned char cose[77];
+	int der_len;
+
+	a = alloc_assert();
+	es256 = alloc_es256_pk();
+	assert((pk = fido_pk_new()) != NULL);
+	assert(es256_pk_from_ptr(es256, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert((pkey = es256_pk_to_EVP_PKEY(es256)) != NULL);
+	assert((der_len = i2d_PUBKEY(pkey, &der)) > 0);
+	/* {1: 2, 3: -7, -1: 1, -2: x, -3: y} */
+	memcpy(cose, "\xa5\x01\x02\x03\x26\x20\x01\x21\x58\x20", 10);
+	memcpy(cose + 10, es256_pk, 32);
+	memcpy(cose + 42, "\x22\x58\x20", 3);
+	memcpy(cose + 45, es256_pk + 32, 32);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_pk_set_der(pk, NULL, 0) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_set_der(pk, der, (size_t)der_len - 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_set_der(pk, cose, sizeof(cose)) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_type(pk) == COSE_UNSPEC);
+	assert(fido_pk_set_der(pk, der, (size_t)der_len) == FIDO_OK);
+	assert(fido_pk_type(pk) == COSE_ES256);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_OK);
+	assert(fido_pk_set_cose(pk, NULL, 0) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_set_cose(pk, cose, sizeof(cose) - 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_set_cose(pk, der, (size_t)der_len) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_pk_type(pk) == COSE_UNSPEC);
+	assert(fido_pk_set_cose(pk, cose, sizeof(cose)) == FIDO_OK);
+	assert(fido_pk_type(pk) == COSE_ES256);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_OK);
+	cose[12] ^= 0x01;
+	assert(fido_pk_set_cose(pk, cose, sizeof(cose)) == FIDO_ERR_INVALID_ARGUMENT);
+	cose[12] ^= 0x01;
+	/* kty and alg out of order */
+	memcpy(cose + 1, "\x03\x26\x01\x02", 4);
+	assert(fido_pk_set_cose(pk, cose, sizeof(cose)) == FIDO_ERR_INVALID_ARGUMENT);
+	memcpy(cose + 1, "\x01\x02\x03\x26", 4);
+	assert(fido_pk_set_cose(pk, cose, sizeof(cose)) == FIDO_OK);
+	/* no y coordinate */
+	cose[0] = 0xa4;
+	assert(fido_pk_set_cose(pk, cose, 42) == FIDO_ERR_INVALID_ARGUMENT);
+	fido_pk_free(&pk);
+	free_assert(a);
+	free_es256_pk(es256);
+	EVP_PKEY_free(pkey);
+	OPENSSL_free(der);
+}
+
+/* prepared public keys looked up in a key store */
+static void
+keystore(void)
+{
+	const char *path = "regress_keystore";
+	const unsigned char id1[] = { 0x01, 0x02, 0x03 };
+	const unsigned char id2[] = { 0x04, 0x05 };
+	fido_assert_t *a;
+	fido_keystore_t *ks;
+	fido_pk_t *pk;
+	es256_pk_t *es256;
+	rs256_pk_t *rs256;
+	uint32_t n;
+
+	a = alloc_assert();
+	es256 = alloc_es256_pk();
+	rs256 = alloc_rs256_pk();
+	assert((ks = fido_keystore_new()) != NULL);
+	assert((pk = fido_pk_new()) != NULL);
+	assert(es256_pk_from_ptr(es256, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(rs256_pk_from_ptr(rs256, rs256_pk, sizeof(rs256_pk)) == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_keystore_get_pk(ks, id1, sizeof(id1), pk) == FIDO_ERR_NOT_ALLOWED);
+	assert(fido_keystore_add(ks, NULL, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_keystore_add(ks, id1, sizeof(id1), COSE_ES256, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_keystore_add(ks, id1, sizeof(id1), COSE_UNSPEC, es256) == FIDO_ERR_UNSUPPORTED_OPTION);
+	assert(fido_keystore_add(ks, id1, sizeof(id1), COSE_ES256, es256) == FIDO_OK);
+	assert(fido_keystore_add(ks, id2, sizeof(id2), COSE_RS256, rs256) == FIDO_OK);
+	assert(fido_keystore_write(ks, path) == FIDO_OK);
+	assert(fido_keystore_count(ks) == 0);
+	assert(fido_keystore_open(ks, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_keystore_open(ks, path) == FIDO_OK);
+	assert(fido_keystore_count(ks) == 2);
+	assert(fido_keystore_get_pk(ks, id1, sizeof(id1) - 1, pk) == FIDO_ERR_NO_CREDENTIALS);
+	assert(fido_pk_type(pk) == COSE_UNSPEC);
+	assert(fido_keystore_get_pk(ks, id1, sizeof(id1), pk) == FIDO_OK);
+	assert(fido_pk_type(pk) == COSE_ES256);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_OK);
+	assert(fido_keystore_get_pk(ks, id2, sizeof(id2), pk) == FIDO_OK);
+	assert(fido_pk_type(pk) == COSE_RS256);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_ERR_INVALID_SIG);
+	/* signature counters only move forward */
+	assert(fido_assert_verify_keystore(a, 0, ks) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_keystore_get_sigcount(ks, id1, sizeof(id1), &n) == FIDO_OK);
+	assert(n == 0);
+	assert(fido_keystore_update_sigcount(ks, id1, sizeof(id1), 0) == FIDO_OK);
+	assert(fido_keystore_update_sigcount(ks, id1, sizeof(id1), 3) == FIDO_OK);
+	assert(fido_keystore_update_sigcount(ks, id1, sizeof(id1), 3) == FIDO_ERR_SIGCOUNT);
+	assert(fido_keystore_update_sigcount(ks, id1, sizeof(id1), 0) == FIDO_ERR_SIGCOUNT);
+	assert(fido_keystore_update_sigcount(ks, id2, sizeof(id2) - 1, 1) == FIDO_ERR_NO_CREDENTIALS);
+	assert(fido_keystore_get_sigcount(ks, id1, sizeof(id1), &n) == FIDO_OK);
+	assert(n == 3);
+	assert(fido_keystore_get_sigcount(ks, id2, sizeof(id2), &n) == FIDO_OK);
+	assert(n == 0);
+	/* and survive a rewrite of the store */
+	assert(fido_keystore_write(ks, path) == FIDO_OK);
+	assert(fido_keystore_open(ks, path) == FIDO_OK);
+	assert(fido_keystore_get_sigcount(ks, id1, sizeof(id1), &n) == FIDO_OK);
+	assert(n == 3);
+	/* a duplicate id is rejected, and the old store left in place */
+	assert(fido_keystore_add(ks, id1, sizeof(id1), COSE_RS256, rs256) == FIDO_OK);
+	assert(fido_keystore_write(ks, path) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_keystore_get_pk(ks, id1, sizeof(id1), pk) == FIDO_OK);
+	assert(fido_pk_type(pk) == COSE_ES256);
+	fido_keystore_free(&ks);
+	assert(ks == NULL);
+	fido_keystore_free(&ks);
+	fido_keystore_free(NULL);
+	assert(remove(path) == 0);
+	fido_pk_free(&pk);
+	free_assert(a);
+	free_es256_pk(es256);
+	free_rs256_pk(rs256);
+}
+
+/* repeated rs256 verification with generated keys */
+static EVP_PKEY *
+rs256_keygen(rs256_pk_t *pk)
+{
+	EVP_PKEY_CTX *ctx;
+	EVP_PKEY *pkey = NULL;
+
+	assert((ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL)) != NULL);
+	assert(EVP_PKEY_keygen_init(ctx) == 1);
+	assert(EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) == 1);
+	assert(EVP_PKEY_keygen(ctx, &pkey) == 1);
+	assert(rs256_pk_from_EVP_PKEY(pk, pkey) == FIDO_OK);
+	EVP_PKEY_CTX_free(ctx);
+
+	return (pkey);
+}
+
+static void
+rs256_repeated(void)
+{
+	fido_assert_t *a;
+	rs256_pk_t *pkA;
+	rs256_pk_t *pkB;
+	EVP_PKEY *pkey;
+	EVP_MD_CTX *mdctx;
+	unsigned char msg[sizeof(authdata) - 2 + sizeof(cdh)];
+	unsigned char rsig[256];
+	size_t rsig_len = sizeof(rsig);
+
+	a = alloc_assert();
+	pkA = alloc_rs256_pk();
+	pkB = alloc_rs256_pk();
+	pkey = rs256_keygen(pkA);
+	EVP_PKEY_free(rs256_keygen(pkB));
+	/* authdata is a cbor byte string with a two-byte header */
+	memcpy(msg, authdata + 2, sizeof(authdata) - 2);
+	memcpy(msg + sizeof(authdata) - 2, cdh, sizeof(cdh));
+	assert((mdctx = EVP_MD_CTX_new()) != NULL);
+	assert(EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL, pkey) == 1);
+	assert(EVP_DigestSign(mdctx, rsig, &rsig_len, msg, sizeof(msg)) == 1);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, rsig, rsig_len) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_RS256, pkA) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_RS256, pkA) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_RS256, pkB) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_verify(a, 0, COSE_RS256, pkA) == FIDO_OK);
+	rsig[0] ^= 0x01;
+	assert(fido_assert_set_sig(a, 0, rsig, rsig_len) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_RS256, pkA) == FIDO_ERR_INVALID_SIG);
+	rsig[0] ^= 0x01;
+	assert(fido_assert_set_sig(a, 0, rsig, rsig_len) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_RS256, pkA) == FIDO_OK);
+	EVP_MD_CTX_free(mdctx);
+	EVP_PKEY_free(pkey);
+	free_assert(a);
+	free_rs256_pk(pkA);
+	free_rs256_pk(pkB);
+}
+
+/* batch verification */
+static void
+batch_verify(void)
+{
+	fido_assert_t *a;
+	es256_pk_t *es256;
+	rs256_pk_t *rs256;
+	fido_assert_verify_item_t v[3];
+
+	a = alloc_assert();
+	es256 = alloc_es256_pk();
+	rs256 = alloc_rs256_pk();
+	assert(es256_pk_from_ptr(es256, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(rs256_pk_from_ptr(rs256, rs256_pk, sizeof(rs256_pk)) == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	memset(v, 0, sizeof(v));
+	v[0].assert = a;
+	v[0].cose_alg = COSE_ES256;
+	v[0].pk = es256;
+	v[1] = v[0];
+	v[2] = v[0];
+	v[0].r = v[1].r = v[2].r = -1;
+	assert(fido_assert_verify_batch(NULL, 0) == FIDO_OK);
+	assert(fido_assert_verify_batch(NULL, 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_verify_batch(v, 3) == FIDO_OK);
+	assert(v[0].r == FIDO_OK && v[1].r == FIDO_OK && v[2].r == FIDO_OK);
+	v[1].cose_alg = COSE_RS256;
+	v[1].pk = rs256;
+	v[2].idx = 1;
+	assert(fido_assert_verify_batch(v, 3) == FIDO_ERR_INVALID_SIG);
+	assert(v[0].r == FIDO_OK);
+	assert(v[1].r == FIDO_ERR_INVALID_SIG);
+	assert(v[2].r == FIDO_ERR_INVALID_ARGUMENT);
+	v[0].assert = NULL;
+	assert(fido_assert_verify_batch(v, 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(v[0].r == FIDO_ERR_INVALID_ARGUMENT);
+	free_assert(a);
+	free_es256_pk(es256);
+	free_rs256_pk(rs256);
+}
+
+static int verify_handler_r;
+static int verify_handler_calls;
+
+static int
+verify_handler(void *arg, int cose_alg, const void *pk,
+    const unsigned char *dgst, size_t dgst_len, const unsigned char *s,
+    size_t s_len)
+{
+	assert(arg == &verify_handler_calls);
+	assert(cose_alg == COSE_ES256);
+	assert(memcmp(pk, es256_pk, sizeof(es256_pk)) == 0);
+	assert(dgst != NULL && dgst_len == 32);
+	assert(s_len == sizeof(sig) && memcmp(s, sig, sizeof(sig)) == 0);
+	verify_handler_calls++;
+
+	return (verify_handler_r);
+}
+
+/* es256 verification routed through fido_set_verify_handler() */
+static void
+external_verify(void)
+{
+	fido_assert_t *a;
+	fido_pk_t *pk;
+	es256_pk_t *es256;
+
+	a = alloc_assert();
+	es256 = alloc_es256_pk();
+	assert((pk = fido_pk_new()) != NULL);
+	assert(es256_pk_from_ptr(es256, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(fido_pk_set(pk, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	fido_set_verify_handler(verify_handler, &verify_handler_calls);
+	/* the handler's verdict is final */
+	verify_handler_r = FIDO_ERR_INVALID_SIG;
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_ERR_INVALID_SIG);
+	assert(verify_handler_calls == 2);
+	/* any other error is a failed verification */
+	verify_handler_r = FIDO_ERR_INTERNAL;
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_SIG);
+	assert(verify_handler_calls == 3);
+	/* declined; verified by the library */
+	verify_handler_r = FIDO_ERR_UNSUPPORTED_ALGORITHM;
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_OK);
+	assert(verify_handler_calls == 5);
+	verify_handler_r = FIDO_OK;
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(verify_handler_calls == 6);
+	fido_set_verify_handler(NULL, NULL);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(verify_handler_calls == 6);
+	fido_pk_free(&pk);
+	free_assert(a);
+	free_es256_pk(es256);
+}
+
+/* outcomes kept by FIDO_VERIFY_CACHE */
+static void
+verify_cache(void)
+{
+	fido_assert_t *a, *b;
+	fido_pk_t *pk;
+	es256_pk_t *es256;
+	int n;
+
+	fido_init(FIDO_VERIFY_CACHE);
+	a = alloc_assert();
+	b = alloc_assert();
+	es256 = alloc_es256_pk();
+	assert((pk = fido_pk_new()) != NULL);
+	assert(es256_pk_from_ptr(es256, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(fido_pk_set(pk, COSE_ES256, es256) == FIDO_OK);
+	for (size_t i = 0; i < 2; i++) {
+		fido_assert_t *x = i == 0 ? a : b;
+		assert(fido_assert_set_clientdata_hash(x, cdh,
+		    sizeof(cdh)) == FIDO_OK);
+		assert(fido_assert_set_rp(x, "localhost") == FIDO_OK);
+		assert(fido_assert_set_count(x, 1) == FIDO_OK);
+		assert(fido_assert_set_authdata(x, 0, authdata,
+		    sizeof(authdata)) == FIDO_OK);
+		assert(fido_assert_set_up(x, FIDO_OPT_FALSE) == FIDO_OK);
+		assert(fido_assert_set_uv(x, FIDO_OPT_FALSE) == FIDO_OK);
+		assert(fido_assert_set_sig(x, 0, sig, sizeof(sig)) == FIDO_OK);
+	}
+	fido_set_verify_handler(verify_handler, &verify_handler_calls);
+	n = verify_handler_calls;
+	verify_handler_r = FIDO_ERR_UNSUPPORTED_ALGORITHM;
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(verify_handler_calls == n + 1);
+	/* a replayed assertion; the same key, prepared or not */
+	assert(fido_assert_verify(b, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_assert_verify_prepared(b, 0, pk) == FIDO_OK);
+	assert(verify_handler_calls == n + 1);
+	/* the rest of the assertion is checked on every call */
+	assert(fido_assert_set_rp(b, "example.com") == FIDO_OK);
+	assert(fido_assert_verify(b, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_PARAM);
+	assert(fido_assert_set_uv(a, FIDO_OPT_TRUE) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_PARAM);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	/* a new handler drops the kept outcomes; failures are kept too */
+	fido_set_verify_handler(verify_handler, &verify_handler_calls);
+	verify_handler_r = FIDO_ERR_INVALID_SIG;
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_verify_prepared(a, 0, pk) == FIDO_ERR_INVALID_SIG);
+	assert(verify_handler_calls == n + 2);
+	/* disabled */
+	fido_init(0);
+	verify_handler_r = FIDO_OK;
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(verify_handler_calls == n + 4);
+	fido_set_verify_handler(NULL, NULL);
+	fido_pk_free(&pk);
+	free_assert(a);
+	free_assert(b);
+	free_es256_pk(es256);
+}
+
+/* the rp_id hash is cached by fido_assert_set_rp() */
+static void
+rp_id_hash(void)
+{
+	fido_assert_t *a;
+	es256_pk_t *pk;
+
+	a = alloc_assert();
+	pk = alloc_es256_pk();
+	assert(es256_pk_from_ptr(pk, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(a->rp_id_hash.len == 32);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	assert(memcmp(a->rp_id_hash.ptr, a->stmt[0].authdata.rp_id_hash,
+	    32) == 0);
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_OK);
+	/* without a cached hash, the rp_id is hashed on demand */
+	free(a->rp_id_hash.ptr);
+	a->rp_id_hash.ptr = NULL;
+	a->rp_id_hash.len = 0;
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "example.com") == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_ERR_INVALID_PARAM);
+	assert(fido_assert_set_rp(a, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(a->rp_id_hash.ptr == NULL && a->rp_id_hash.len == 0);
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_ERR_INVALID_ARGUMENT);
+	/* statements can be replaced without losing the rp */
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 2) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 1, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 1, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_assert_verify(a, 1, COSE_ES256, pk) == FIDO_OK);
+	free_assert(a);
+	free_es256_pk(pk);
+}
+
 static void
 raw_authdata(void)
 {
@@ -660,6 +1147,579 @@ raw_authdata(void)
 	free_assert(a);
 }
 
+static void
+raw_authdata_verify(void)
+{
+	fido_assert_t *a;
+	es256_pk_t *pk;
+	unsigned char big[300];
+	const unsigned char *ptr;
+
+	a = alloc_assert();
+	pk = alloc_es256_pk();
+	assert(es256_pk_from_ptr(pk, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_authdata_raw(a, 0, authdata + 2,
+	    sizeof(authdata) - 2) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_OK);
+	assert(fido_assert_authdata_len(a, 0) == sizeof(authdata));
+	assert(memcmp(fido_assert_authdata_ptr(a, 0), authdata,
+	    sizeof(authdata)) == 0);
+	/* longer authdata needs a wider cbor length prefix */
+	memset(big, 0, sizeof(big));
+	memcpy(big, authdata + 2, sizeof(authdata) - 2);
+	assert(fido_assert_set_authdata_raw(a, 0, big,
+	    sizeof(big)) == FIDO_OK);
+	assert(fido_assert_authdata_raw_len(a, 0) == sizeof(big));
+	assert(fido_assert_authdata_len(a, 0) == sizeof(big) + 3);
+	assert((ptr = fido_assert_authdata_ptr(a, 0)) != NULL);
+	assert(ptr[0] == 0x59 && ptr[1] == 0x01 && ptr[2] == 0x2c);
+	assert(memcmp(ptr + 3, big, sizeof(big)) == 0);
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_set_authdata_raw(a, 0, big, 10) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_authdata_ptr(a, 0) == NULL);
+	assert(fido_assert_authdata_raw_ptr(a, 0) == NULL);
+	free_assert(a);
+	free_es256_pk(pk);
+}
+
+static EVP_PKEY *
+generate_key(int cose_alg)
+{
+	EVP_PKEY_CTX *ctx;
+	EVP_PKEY *pkey = NULL;
+
+	if (cose_alg == COSE_EDDSA) {
+		assert((ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519,
+		    NULL)) != NULL);
+		assert(EVP_PKEY_keygen_init(ctx) == 1);
+	} else {
+		assert((ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL)) != NULL);
+		assert(EVP_PKEY_keygen_init(ctx) == 1);
+		assert(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx,
+		    NID_X9_62_prime256v1) == 1);
+	}
+	assert(EVP_PKEY_keygen(ctx, &pkey) == 1);
+	EVP_PKEY_CTX_free(ctx);
+
+	return (pkey);
+}
+
+/* authdata larger than any fixed scratch buffer */
+static void
+large_authdata(int cose_alg)
+{
+	fido_assert_t *a;
+	es256_pk_t *es256;
+	eddsa_pk_t *eddsa;
+	EVP_PKEY *pkey;
+	EVP_MD_CTX *ctx;
+	unsigned char *msg, *big_sig;
+	size_t big_len = 4096, sig_len;
+	const void *pk;
+
+	a = alloc_assert();
+	es256 = alloc_es256_pk();
+	eddsa = alloc_eddsa_pk();
+	pkey = generate_key(cose_alg);
+	if (cose_alg == COSE_EDDSA) {
+		assert(eddsa_pk_from_EVP_PKEY(eddsa, pkey) == FIDO_OK);
+		pk = eddsa;
+	} else {
+		assert(es256_pk_from_EVP_PKEY(es256, pkey) == FIDO_OK);
+		pk = es256;
+	}
+	assert((msg = calloc(1, big_len + sizeof(cdh))) != NULL);
+	memcpy(msg, authdata + 2, sizeof(authdata) - 2);
+	memset(msg + sizeof(authdata) - 2, 0xa5,
+	    big_len - (sizeof(authdata) - 2));
+	memcpy(msg + big_len, cdh, sizeof(cdh));
+	assert((ctx = EVP_MD_CTX_new()) != NULL);
+	assert(EVP_DigestSignInit(ctx, NULL, cose_alg == COSE_EDDSA ? NULL :
+	    EVP_sha256(), NULL, pkey) == 1);
+	assert(EVP_DigestSign(ctx, NULL, &sig_len, msg,
+	    big_len + sizeof(cdh)) == 1);
+	assert((big_sig = calloc(1, sig_len)) != NULL);
+	assert(EVP_DigestSign(ctx, big_sig, &sig_len, msg,
+	    big_len + sizeof(cdh)) == 1);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_authdata_raw(a, 0, msg, big_len) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, big_sig, sig_len) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, cose_alg, pk) == FIDO_OK);
+	msg[big_len - 1] ^= 1;
+	assert(fido_assert_set_authdata_raw(a, 0, msg, big_len) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, cose_alg,
+	    pk) == FIDO_ERR_INVALID_SIG);
+	EVP_MD_CTX_free(ctx);
+	EVP_PKEY_free(pkey);
+	free(big_sig);
+	free(msg);
+	free_assert(a);
+	free_es256_pk(es256);
+	free_eddsa_pk(eddsa);
+}
+
+/* repeated eddsa verification; a failed one leaves no stale state */
+static void
+eddsa_repeated(void)
+{
+	fido_assert_t *a;
+	eddsa_pk_t *pkA;
+	eddsa_pk_t *pkB;
+	EVP_PKEY *pkey;
+	EVP_MD_CTX *mdctx;
+	unsigned char msg[sizeof(authdata) - 2 + sizeof(cdh)];
+	unsigned char esig[64];
+	size_t esig_len = sizeof(esig);
+
+	a = alloc_assert();
+	pkA = alloc_eddsa_pk();
+	pkB = alloc_eddsa_pk();
+	pkey = generate_key(COSE_EDDSA);
+	assert(eddsa_pk_from_EVP_PKEY(pkB, pkey) == FIDO_OK);
+	EVP_PKEY_free(pkey);
+	pkey = generate_key(COSE_EDDSA);
+	assert(eddsa_pk_from_EVP_PKEY(pkA, pkey) == FIDO_OK);
+	/* authdata is a cbor byte string with a two-byte header */
+	memcpy(msg, authdata + 2, sizeof(authdata) - 2);
+	memcpy(msg + sizeof(authdata) - 2, cdh, sizeof(cdh));
+	assert((mdctx = EVP_MD_CTX_new()) != NULL);
+	assert(EVP_DigestSignInit(mdctx, NULL, NULL, NULL, pkey) == 1);
+	assert(EVP_DigestSign(mdctx, esig, &esig_len, msg, sizeof(msg)) == 1);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, esig, esig_len) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_EDDSA, pkA) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_EDDSA, pkA) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_EDDSA,
+	    pkB) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_verify(a, 0, COSE_EDDSA, pkA) == FIDO_OK);
+	esig[0] ^= 0x01;
+	assert(fido_assert_set_sig(a, 0, esig, esig_len) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_EDDSA,
+	    pkA) == FIDO_ERR_INVALID_SIG);
+	esig[0] ^= 0x01;
+	assert(fido_assert_set_sig(a, 0, esig, esig_len) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_EDDSA, pkA) == FIDO_OK);
+	EVP_MD_CTX_free(mdctx);
+	EVP_PKEY_free(pkey);
+	free_assert(a);
+	free_eddsa_pk(pkA);
+	free_eddsa_pk(pkB);
+}
+
+/* the signed hash is reused across keys, and follows cdh and authdata */
+static void
+signed_hash_reuse(void)
+{
+	fido_assert_t *a;
+	es256_pk_t *es256;
+	rs256_pk_t *rs256;
+	eddsa_pk_t *eddsa;
+	unsigned char junk_cdh[sizeof(cdh)];
+	unsigned char junk_authdata[sizeof(authdata)];
+
+	memcpy(junk_cdh, cdh, sizeof(cdh));
+	junk_cdh[0] = (unsigned char)~junk_cdh[0];
+	memcpy(junk_authdata, authdata, sizeof(authdata));
+	junk_authdata[sizeof(authdata) - 1] ^= 0x01; /* signCount */
+
+	a = alloc_assert();
+	es256 = alloc_es256_pk();
+	rs256 = alloc_rs256_pk();
+	eddsa = alloc_eddsa_pk();
+	assert(es256_pk_from_ptr(es256, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(rs256_pk_from_ptr(rs256, rs256_pk, sizeof(rs256_pk)) == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_RS256, rs256) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_EDDSA, eddsa) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(a, junk_cdh,
+	    sizeof(junk_cdh)) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, junk_authdata,
+	    sizeof(junk_authdata)) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_SIG);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_OK);
+	free_assert(a);
+	free_es256_pk(es256);
+	free_rs256_pk(rs256);
+	free_eddsa_pk(eddsa);
+}
+
+/* allocations made while the recycling allocator is installed */
+static size_t recycle_allocs;
+
+static void *
+recycle_malloc(size_t size)
+{
+	recycle_allocs++;
+
+	return (malloc(size));
+}
+
+static void *
+recycle_calloc(size_t nmemb, size_t size)
+{
+	recycle_allocs++;
+
+	return (calloc(nmemb, size));
+}
+
+static void *
+recycle_realloc(void *ptr, size_t size)
+{
+	recycle_allocs++;
+
+	return (realloc(ptr, size));
+}
+
+static void
+recycle_free(void *ptr)
+{
+	free(ptr);
+}
+
+static void
+set_assert(fido_assert_t *a)
+{
+	assert(fido_assert_set_clientdata_hash(a, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, authdata,
+	    sizeof(authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sizeof(sig)) == FIDO_OK);
+}
+
+static void
+recycle(void)
+{
+	fido_allocator_t alloc;
+	fido_assert_t *a;
+	es256_pk_t *pk;
+	const unsigned char *ptr[3];
+	int r;
+
+	memset(&alloc, 0, sizeof(alloc));
+	alloc.malloc = recycle_malloc;
+	alloc.calloc = recycle_calloc;
+	alloc.realloc = recycle_realloc;
+	alloc.free = recycle_free;
+	if ((r = fido_set_allocator(&alloc)) == FIDO_ERR_INTERNAL)
+		return; /* libcbor < 0.10 lacks cbor_set_allocs() */
+	assert(r == FIDO_OK);
+
+	a = alloc_assert();
+	pk = alloc_es256_pk();
+	assert(es256_pk_from_ptr(pk, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	fido_assert_recycle(NULL);
+	fido_assert_recycle(a);
+	set_assert(a);
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_OK);
+	ptr[0] = fido_assert_clientdata_hash_ptr(a);
+	ptr[1] = fido_assert_authdata_ptr(a, 0);
+	ptr[2] = fido_assert_sig_ptr(a, 0);
+
+	fido_assert_recycle(a);
+	assert(fido_assert_count(a) == 0);
+	assert(fido_assert_clientdata_hash_ptr(a) == NULL);
+	assert(fido_assert_clientdata_hash_len(a) == 0);
+	assert(strcmp(fido_assert_rp_id(a), "localhost") == 0);
+	assert(fido_assert_verify(a, 0, COSE_ES256,
+	    pk) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_sig_ptr(a, 0) == NULL);
+	assert(fido_assert_authdata_ptr(a, 0) == NULL);
+	assert(fido_assert_authdata_raw_ptr(a, 0) == NULL);
+	assert(fido_assert_verify(a, 0, COSE_ES256,
+	    pk) == FIDO_ERR_INVALID_ARGUMENT);
+
+	/* the buffers of the previous assertion are reused */
+	for (int i = 0; i < 3; i++) {
+		fido_assert_recycle(a);
+		recycle_allocs = 0;
+		set_assert(a);
+		assert(recycle_allocs == 0);
+		assert(fido_assert_clientdata_hash_ptr(a) == ptr[0]);
+		assert(fido_assert_authdata_ptr(a, 0) == ptr[1]);
+		assert(fido_assert_sig_ptr(a, 0) == ptr[2]);
+		assert(fido_assert_authdata_len(a, 0) == sizeof(authdata));
+		assert(memcmp(fido_assert_authdata_ptr(a, 0), authdata,
+		    sizeof(authdata)) == 0);
+		assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_OK);
+	}
+
+	/* more statements than before */
+	fido_assert_recycle(a);
+	assert(fido_assert_set_count(a, 2) == FIDO_OK);
+	assert(fido_assert_count(a) == 2);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_count(a) == 1);
+
+	free_assert(a);
+	free_es256_pk(pk);
+	assert(fido_set_allocator(NULL) == FIDO_OK);
+}
+
+static void
+webauthn_json(void)
+{
+	static const char cd[] = "{\"type\":\"webauthn.get\","
+	    "\"challenge\":\"AAAA\",\"origin\":\"https://localhost\"}";
+	char b64[3][128], json[1024];
+	unsigned char md[32];
+	size_t len;
+	fido_assert_t *a;
+
+	len = sizeof(b64[0]);
+	assert(fido_base64_encode((const unsigned char *)cd, strlen(cd),
+	    b64[0], &len, FIDO_BASE64_URL) == FIDO_OK);
+	len = sizeof(b64[1]);
+	assert(fido_base64_encode(authdata + 2, sizeof(authdata) - 2, b64[1],
+	    &len, FIDO_BASE64_URL) == FIDO_OK);
+	len = sizeof(b64[2]);
+	assert(fido_base64_encode(sig, sizeof(sig), b64[2], &len,
+	    FIDO_BASE64_URL) == FIDO_OK);
+	assert(snprintf(json, sizeof(json), "{\"id\": \"AQID\", "
+	    "\"rawId\": \"AQID\", \"type\": \"public-key\",\n"
+	    "\"response\": {\"clientDataJSON\": \"%s\", "
+	    "\"authenticatorData\": \"%s\", \"signature\": \"%s\", "
+	    "\"userHandle\": null},\n\"clientExtensionResults\": "
+	    "{\"x\": [1, -2.5e3, true, \"\\\"\"]}}\n", b64[0], b64[1],
+	    b64[2]) < (int)sizeof(json));
+
+	a = alloc_assert();
+	assert(fido_assert_from_webauthn_json(a, NULL, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_from_webauthn_json(a, json, strlen(json)) ==
+	    FIDO_OK);
+	assert(fido_assert_count(a) == 1);
+	SHA256((const unsigned char *)cd, strlen(cd), md);
+	assert(fido_assert_clientdata_hash_len(a) == sizeof(md));
+	assert(memcmp(fido_assert_clientdata_hash_ptr(a), md,
+	    sizeof(md)) == 0);
+	assert(fido_assert_authdata_len(a, 0) == sizeof(authdata));
+	assert(memcmp(fido_assert_authdata_ptr(a, 0), authdata,
+	    sizeof(authdata)) == 0);
+	assert(fido_assert_sig_len(a, 0) == sizeof(sig));
+	assert(memcmp(fido_assert_sig_ptr(a, 0), sig, sizeof(sig)) == 0);
+	assert(fido_assert_id_len(a, 0) == 3);
+	assert(memcmp(fido_assert_id_ptr(a, 0), "\x01\x02\x03", 3) == 0);
+	assert(fido_assert_user_id_len(a, 0) == 0);
+	/* truncated, trailing garbage, wrong type */
+	assert(fido_assert_from_webauthn_json(a, json, strlen(json) - 3) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_count(a) == 0);
+	assert(fido_assert_clientdata_hash_ptr(a) == NULL);
+	json[strlen(json) - 1] = '}';
+	assert(fido_assert_from_webauthn_json(a, json, strlen(json)) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	json[strlen(json) - 1] = ' ';
+	assert(fido_assert_from_webauthn_json(a, json, strlen(json)) ==
+	    FIDO_OK);
+	memcpy(strstr(json, "public-key"), "public-kez", 10);
+	assert(fido_assert_from_webauthn_json(a, json, strlen(json)) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	free_assert(a);
+}
+
+static void
+clientdata_stream(void)
+{
+	static const unsigned char cd[] = "{\"type\":\"webauthn.get\","
+	    "\"challenge\":\"AAAA\",\"origin\":\"https://localhost\"}";
+	fido_assert_t *a, *b;
+	const size_t len = sizeof(cd) - 1;
+
+	a = alloc_assert();
+	b = alloc_assert();
+	assert(fido_assert_set_clientdata(a, cd, len) == FIDO_OK);
+	assert(fido_assert_set_clientdata_update(b, cd,
+	    len) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_set_clientdata_final(b) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_set_clientdata_init(b) == FIDO_OK);
+	for (size_t i = 0; i < len; i += 7)
+		assert(fido_assert_set_clientdata_update(b, cd + i,
+		    len - i < 7 ? len - i : 7) == FIDO_OK);
+	assert(fido_assert_set_clientdata_update(b, NULL, 0) == FIDO_OK);
+	assert(fido_assert_set_clientdata_update(b, NULL,
+	    1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_set_clientdata_final(b) == FIDO_OK);
+	assert(fido_assert_clientdata_hash_len(b) ==
+	    fido_assert_clientdata_hash_len(a));
+	assert(memcmp(fido_assert_clientdata_hash_ptr(b),
+	    fido_assert_clientdata_hash_ptr(a),
+	    fido_assert_clientdata_hash_len(a)) == 0);
+	/* the hash is set */
+	assert(fido_assert_set_clientdata_init(b) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_set_clientdata_final(b) == FIDO_ERR_INVALID_ARGUMENT);
+	free_assert(a);
+	free_assert(b);
+}
+
+/* process-wide log handler */
+static size_t log_lines;
+
+static void
+count_log_line(const char *line)
+{
+	assert(line != NULL && strchr(line, '\n') != NULL);
+	log_lines++;
+}
+
+static void
+global_log_handler(void)
+{
+	fido_assert_t *a;
+	es256_pk_t *es256;
+	size_t n;
+
+	a = alloc_assert();
+	es256 = alloc_es256_pk();
+	assert(es256_pk_from_ptr(es256, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(log_lines == 0);
+	fido_set_global_log_handler(count_log_line);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_ARGUMENT);
+	assert((n = log_lines) > 0);
+	fido_set_global_log_handler(NULL);
+	assert(fido_assert_verify(a, 0, COSE_ES256, es256) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(log_lines == n);
+	free_assert(a);
+	free_es256_pk(es256);
+}
+
+/* malformed items are refused before the device is touched */
+static void
+hmac_secret_args(void)
+{
+	fido_hmac_secret_item_t v[2];
+	fido_dev_t *d;
+	fido_dev_io_t io_f;
+	unsigned char id[16], salt[64];
+
+	memset(&io_f, 0, sizeof(io_f));
+	memset(v, 0, sizeof(v));
+	memset(id, 1, sizeof(id));
+	memset(salt, 2, sizeof(salt));
+
+	d = alloc_dev();
+	io_f.open = dummy_open;
+	io_f.close = dummy_close;
+	io_f.read = dummy_read;
+	io_f.write = dummy_write;
+	assert(fido_dev_set_io_functions(d, &io_f) == FIDO_OK);
+
+	v[0].cred_ptr = v[1].cred_ptr = id;
+	v[0].cred_len = v[1].cred_len = sizeof(id);
+	v[0].salt_ptr = v[1].salt_ptr = salt;
+	v[0].salt_len = 32;
+	v[1].salt_len = 64;
+	assert(fido_dev_hmac_secret(d, NULL, FIDO_OPT_OMIT, v, 2,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_hmac_secret(d, "localhost", FIDO_OPT_OMIT, NULL, 2,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_hmac_secret(d, "localhost", FIDO_OPT_OMIT, v, 0,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	v[1].salt_len = 48;
+	assert(fido_dev_hmac_secret(d, "localhost", FIDO_OPT_OMIT, v, 2,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	v[1].salt_len = 64;
+	v[1].cred_len = 0;
+	assert(fido_dev_hmac_secret(d, "localhost", FIDO_OPT_OMIT, v, 2,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	v[1].cred_len = sizeof(id);
+	v[0].salt_ptr = NULL;
+	assert(fido_dev_hmac_secret(d, "localhost", FIDO_OPT_OMIT, v, 2,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	free_dev(d);
+}
+
+static void
+hmac_secret_batch(void)
+{
+	fido_hmac_secret_item_t v[3];
+	fido_assert_t *a;
+	unsigned char secret[64];
+
+	memset(secret, 3, sizeof(secret));
+	a = alloc_assert();
+	assert(fido_assert_set_count(a, 3) == FIDO_OK);
+	assert(fido_assert_set_hmac_secret(a, 0, secret, 32) == FIDO_OK);
+	assert(fido_assert_set_hmac_secret(a, 2, secret, 64) == FIDO_OK);
+	assert(fido_assert_hmac_secret_batch(a, NULL, 3) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_hmac_secret_batch(a, v, 4) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_hmac_secret_batch(a, v, 3) == FIDO_OK);
+	assert(v[0].r == FIDO_OK && v[0].secret_len == 32);
+	assert(memcmp(v[0].secret, secret, 32) == 0);
+	assert(v[1].r == FIDO_ERR_UNSUPPORTED_EXTENSION);
+	assert(v[1].secret_len == 0);
+	assert(v[2].r == FIDO_OK && v[2].secret_len == 64);
+	assert(memcmp(v[2].secret, secret, 64) == 0);
+	free_assert(a);
+}
+
+/* without statements left on a device, there is nothing to fetch */
+static void
+fetch_limit(void)
+{
+	fido_assert_t *a;
+	fido_dev_t *d;
+	fido_dev_io_t io_f;
+
+	memset(&io_f, 0, sizeof(io_f));
+	a = alloc_assert();
+	d = alloc_dev();
+	io_f.open = dummy_open;
+	io_f.close = dummy_close;
+	io_f.read = dummy_read;
+	io_f.write = dummy_write;
+	assert(fido_dev_set_io_functions(d, &io_f) == FIDO_OK);
+
+	assert(fido_assert_set_fetch_limit(a, 2) == FIDO_OK);
+	assert(fido_assert_pending(a) == 0);
+	assert(fido_dev_get_assert_next(d, a, 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_set_count(a, 3) == FIDO_OK);
+	assert(fido_assert_pending(a) == 0);
+	assert(fido_dev_get_assert_next(d, a, 1) == FIDO_ERR_INVALID_ARGUMENT);
+	fido_assert_recycle(a);
+	assert(fido_assert_pending(a) == 0);
+	free_assert(a);
+	free_dev(d);
+}
+
 int
 main(void)
 {
@@ -680,6 +1740,26 @@ main(void)
 	rs256_PKEY();
 	es256_PKEY();
 	raw_authdata();
+	raw_authdata_verify();
+	large_authdata(COSE_ES256);
+	large_authdata(COSE_EDDSA);
+	eddsa_repeated();
+	signed_hash_reuse();
+	prepared_pk();
+	prepared_pk_import();
+	rs256_repeated();
+	keystore();
+	batch_verify();
+	external_verify();
+	verify_cache();
+	rp_id_hash();
+	recycle();
+	webauthn_json();
+	clientdata_stream();
+	global_log_handler();
+	hmac_secret_args();
+	hmac_secret_batch();
+	fetch_limit();
 
 	exit(0);
 }
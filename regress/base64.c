@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fido.h>
+
+/* RFC 4648, section 10 */
+static const struct {
+	const char *in;
+	const char *std;
+	const char *url;
+} vectors[] = {
+	{ "", "", "" },
+	{ "f", "Zg==", "Zg" },
+	{ "fo", "Zm8=", "Zm8" },
+	{ "foo", "Zm9v", "Zm9v" },
+	{ "foob", "Zm9vYg==", "Zm9vYg" },
+	{ "fooba", "Zm9vYmE=", "Zm9vYmE" },
+	{ "foobar", "Zm9vYmFy", "Zm9vYmFy" },
+};
+
+static void
+rfc4648(void)
+{
+	unsigned char	out[16];
+	char		enc[16];
+	size_t		len, n;
+
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		n = strlen(vectors[i].in);
+		len = sizeof(enc);
+		assert(fido_base64_encode((const void *)vectors[i].in, n, enc,
+		    &len, 0) == FIDO_OK);
+		assert(len == strlen(vectors[i].std));
+		assert(strcmp(enc, vectors[i].std) == 0);
+		len = sizeof(enc);
+		assert(fido_base64_encode((const void *)vectors[i].in, n, enc,
+		    &len, FIDO_BASE64_URL) == FIDO_OK);
+		assert(strcmp(enc, vectors[i].url) == 0);
+		/* padding is optional when decoding */
+		len = sizeof(out);
+		assert(fido_base64_decode(vectors[i].std,
+		    strlen(vectors[i].std), out, &len, 0) == FIDO_OK);
+		assert(len == n && memcmp(out, vectors[i].in, n) == 0);
+		len = sizeof(out);
+		assert(fido_base64_decode(vectors[i].url,
+		    strlen(vectors[i].url), out, &len, 0) == FIDO_OK);
+		assert(len == n && memcmp(out, vectors[i].in, n) == 0);
+		len = sizeof(out);
+		assert(fido_base64_decode(vectors[i].std,
+		    strlen(vectors[i].std), out, &len, FIDO_BASE64_URL) ==
+		    FIDO_OK);
+		assert(len == n && memcmp(out, vectors[i].in, n) == 0);
+	}
+}
+
+static void
+alphabet(void)
+{
+	unsigned char	out[16];
+	size_t		len;
+
+	len = sizeof(out);
+	assert(fido_base64_decode("+/+/", 4, out, &len, 0) == FIDO_OK);
+	assert(len == 3 && memcmp(out, "\xfb\xff\xbf", 3) == 0);
+	len = sizeof(out);
+	assert(fido_base64_decode("-_-_", 4, out, &len, FIDO_BASE64_URL) ==
+	    FIDO_OK);
+	assert(len == 3 && memcmp(out, "\xfb\xff\xbf", 3) == 0);
+	len = sizeof(out);
+	assert(fido_base64_decode("-_-_", 4, out, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	len = sizeof(out);
+	assert(fido_base64_decode("+/+/", 4, out, &len, FIDO_BASE64_URL) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	len = sizeof(out);
+	assert(fido_base64_decode("Zm9v\n", 5, out, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	len = sizeof(out);
+	assert(fido_base64_decode("Zm9vY", 5, out, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	len = sizeof(out);
+	assert(fido_base64_decode("Zm9=", 4, out, &len, 0) == FIDO_OK);
+	assert(fido_base64_decode("Zm==", 4, out, &len, 0) == FIDO_OK);
+	len = sizeof(out);
+	assert(fido_base64_decode("Zm9v=", 5, out, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	len = sizeof(out);
+	assert(fido_base64_decode("Z===", 4, out, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_base64_decode("Zm9v", 4, out, &len, 0x02) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+}
+
+static void
+sizes(void)
+{
+	unsigned char	out[3];
+	char		enc[9];
+	size_t		len;
+
+	len = 8;
+	assert(fido_base64_encode((const void *)"foobar", 6, enc, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	len = 9;
+	assert(fido_base64_encode((const void *)"foobar", 6, enc, &len, 0) ==
+	    FIDO_OK);
+	assert(len == 8);
+	len = 2;
+	assert(fido_base64_decode("Zm9v", 4, out, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	len = 3;
+	assert(fido_base64_decode("Zm9v", 4, out, &len, 0) == FIDO_OK);
+	assert(len == 3);
+	assert(fido_base64_encode(NULL, 1, enc, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_base64_decode(NULL, 1, out, &len, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+}
+
+/* long inputs, through the vector code where there is one */
+static void
+roundtrip(void)
+{
+	unsigned char	*buf, *dec;
+	char		*enc;
+	size_t		 n, len;
+
+	assert((buf = malloc(1024)) != NULL);
+	assert((dec = malloc(1024)) != NULL);
+	assert((enc = malloc(2048)) != NULL);
+
+	for (size_t i = 0; i < 1024; i++)
+		buf[i] = (unsigned char)(i * 37 + 11);
+	for (n = 0; n <= 1024; n += 7) {
+		for (int flags = 0; flags <= FIDO_BASE64_URL; flags++) {
+			len = 2048;
+			assert(fido_base64_encode(buf, n, enc, &len, flags) ==
+			    FIDO_OK);
+			assert(strlen(enc) == len);
+			len = 1024;
+			assert(fido_base64_decode(enc, strlen(enc), dec, &len,
+			    flags) == FIDO_OK);
+			assert(len == n && memcmp(dec, buf, n) == 0);
+			/* in place */
+			len = 2048;
+			assert(fido_base64_decode(enc, strlen(enc),
+			    (unsigned char *)enc, &len, flags) == FIDO_OK);
+			assert(len == n && memcmp(enc, buf, n) == 0);
+		}
+		/* a bad character anywhere is caught */
+		if (n >= 3) {
+			len = 2048;
+			assert(fido_base64_encode(buf, n, enc, &len, 0) ==
+			    FIDO_OK);
+			enc[len / 2] = '*';
+			len = 1024;
+			assert(fido_base64_decode(enc, strlen(enc), dec, &len,
+			    0) == FIDO_ERR_INVALID_ARGUMENT);
+		}
+	}
+
+	free(buf);
+	free(dec);
+	free(enc);
+}
+
+int
+main(void)
+{
+	fido_init(0);
+
+	rfc4648();
+	alphabet();
+	sizes();
+	roundtrip();
+
+	exit(0);
+}
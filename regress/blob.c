@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#define _FIDO_INTERNAL
+
+#include <fido.h>
+
+static void
+blob_append(void)
+{
+	const unsigned char	 chunk[7] = { 1, 2, 3, 4, 5, 6, 7 };
+	fido_blob_t		 b;
+	unsigned char		*p;
+	size_t			 cap = 0, ngrow = 0;
+
+	memset(&b, 0, sizeof(b));
+
+	/* the buffer grows geometrically */
+	for (size_t i = 0; i < 10000; i++) {
+		assert(fido_blob_append(&b, chunk, sizeof(chunk)) == 0);
+		if (b.cap != cap) {
+			assert(b.cap >= 2 * cap);
+			cap = b.cap;
+			ngrow++;
+		}
+	}
+	assert(b.len == 10000 * sizeof(chunk));
+	assert(ngrow < 20);
+	for (size_t i = 0; i < b.len; i++)
+		assert(b.ptr[i] == chunk[i % sizeof(chunk)]);
+
+	/* reserved and cleared capacity is used without reallocating */
+	fido_blob_clear(&b);
+	p = b.ptr;
+	assert(b.len == 0 && b.cap == cap);
+	assert(fido_blob_reserve(&b, cap) == 0);
+	assert(fido_blob_set(&b, chunk, sizeof(chunk)) == 0);
+	assert(fido_blob_append(&b, chunk, sizeof(chunk)) == 0);
+	assert(b.ptr == p && b.len == 2 * sizeof(chunk));
+	fido_blob_reset(&b);
+
+	assert(fido_blob_reserve(&b, 100) == 0);
+	assert(b.ptr != NULL && b.len == 0 && b.cap == 100);
+	assert(fido_blob_append(&b, NULL, 1) < 0);
+	assert(fido_blob_append(&b, chunk, sizeof(chunk)) == 0);
+	assert(fido_blob_reserve(&b, SIZE_MAX) < 0); /* overflow */
+	fido_blob_reset(&b);
+}
+
+int
+main(void)
+{
+	fido_init(0);
+
+	blob_append();
+
+	exit(0);
+}
@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include <openssl/sha.h>
+#include <zlib.h>
 
 #define _FIDO_INTERNAL
 
@@ -255,6 +256,86 @@ rfc1951_reinflate(void)
 	free(out.ptr);
 }
 
+static int
+collect(void *arg, const unsigned char *ptr, size_t len)
+{
+	fido_blob_t *b = arg;
+	unsigned char *tmp;
+
+	assert(len > 0);
+	assert((tmp = realloc(b->ptr, b->len + len)) != NULL);
+	memcpy(tmp + b->len, ptr, len);
+	b->ptr = tmp;
+	b->len += len;
+
+	return 0;
+}
+
+static int
+refuse(void *arg, const unsigned char *ptr, size_t len)
+{
+	(void)arg;
+	(void)ptr;
+	(void)len;
+
+	return -1;
+}
+
+static void
+rfc1951_stream(void)
+{
+	fido_blob_t in, out, stream;
+
+	memset(&in, 0, sizeof(in));
+	memset(&out, 0, sizeof(out));
+	memset(&stream, 0, sizeof(stream));
+	in.ptr = random_words;
+	in.len = sizeof(random_words);
+
+	assert(fido_compress(&out, &in) == FIDO_OK);
+	assert(fido_compress_stream(&in, 0, 0, NULL, collect,
+	    &stream) == FIDO_OK);
+	assert(stream.len == out.len);
+	assert(memcmp(stream.ptr, out.ptr, out.len) == 0);
+	assert(fido_compress_stream(&in, 0, 0, NULL, refuse,
+	    NULL) == FIDO_ERR_INTERNAL);
+
+	free(out.ptr);
+	free(stream.ptr);
+}
+
+static void
+rfc1950_dict(void)
+{
+	fido_blob_t in, out, dict, z;
+	fido_blob_array_t a;
+
+	memset(&in, 0, sizeof(in));
+	memset(&out, 0, sizeof(out));
+	memset(&z, 0, sizeof(z));
+	memset(&a, 0, sizeof(a));
+	in.ptr = random_words;
+	in.len = sizeof(random_words);
+	dict.ptr = random_words + 256;
+	dict.len = 256;
+
+	assert(fido_compress_stream(&in, 10, 0, NULL, collect,
+	    &z) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_compress_stream(&in, 9, Z_FILTERED, &dict, collect,
+	    &z) == FIDO_OK);
+	assert(fido_uncompress(&out, &z, in.len) != FIDO_OK);
+	assert(fido_uncompress_dict(&out, &z, in.len, &a) != FIDO_OK);
+
+	a.ptr = &dict;
+	a.len = 1;
+	assert(fido_uncompress_dict(&out, &z, in.len, &a) == FIDO_OK);
+	assert(out.len == in.len);
+	assert(memcmp(out.ptr, in.ptr, out.len) == 0);
+
+	free(out.ptr);
+	free(z.ptr);
+}
+
 int
 main(void)
 {
@@ -263,6 +344,8 @@ main(void)
 	rfc1950_inflate();
 	rfc1951_inflate();
 	rfc1951_reinflate();
+	rfc1951_stream();
+	rfc1950_dict();
 
 	exit(0);
 }
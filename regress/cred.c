@@ -11,6 +11,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <time.h>
 
 #define _FIDO_INTERNAL
 
@@ -182,6 +183,42 @@ static const unsigned char authdata_tpm_es256[166] =  {
 	0x53, 0xa5, 0x26, 0x97, 0x4f, 0x2d
 };
 
+static const unsigned char authdata_self[166] = {
+	0x58, 0xa4, 0x49, 0x96, 0x0d, 0xe5, 0x88, 0x0e,
+	0x8c, 0x68, 0x74, 0x34, 0x17, 0x0f, 0x64, 0x76,
+	0x60, 0x5b, 0x8f, 0xe4, 0xae, 0xb9, 0xa2, 0x86,
+	0x32, 0xc7, 0x99, 0x5c, 0xf3, 0xba, 0x83, 0x1d,
+	0x97, 0x63, 0x41, 0x00, 0x00, 0x00, 0x01, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x20, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e,
+	0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26,
+	0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e,
+	0x2f, 0xa5, 0x01, 0x02, 0x03, 0x26, 0x20, 0x01,
+	0x21, 0x58, 0x20, 0x18, 0x90, 0x4c, 0x19, 0x67,
+	0xec, 0xb2, 0x3d, 0xab, 0x0e, 0xce, 0x71, 0x2d,
+	0x74, 0x34, 0x38, 0x6d, 0xb3, 0x5c, 0x60, 0xfd,
+	0x87, 0x69, 0x2c, 0x2e, 0xe8, 0x58, 0x59, 0x0c,
+	0xd7, 0x6d, 0x89, 0x22, 0x58, 0x20, 0xf5, 0xca,
+	0x93, 0x9d, 0x15, 0x6b, 0x91, 0xa5, 0x57, 0xe6,
+	0xba, 0xda, 0x59, 0x98, 0x0c, 0x90, 0xaa, 0x97,
+	0xb4, 0xd4, 0x91, 0xa1, 0xd8, 0x26, 0x28, 0xe2,
+	0xea, 0x4d, 0xb5, 0x79, 0x1d, 0x9e
+};
+
+static const unsigned char sig_self[70] = {
+	0x30, 0x44, 0x02, 0x20, 0x53, 0x38, 0xa6, 0xca,
+	0x45, 0xd5, 0xcd, 0xe9, 0x2b, 0x1c, 0xdf, 0x39,
+	0x2e, 0xed, 0x2a, 0x2b, 0x39, 0x9e, 0x0e, 0x06,
+	0x28, 0x02, 0x2f, 0xc4, 0x25, 0x26, 0xc5, 0xbf,
+	0x59, 0xda, 0x6f, 0x45, 0x02, 0x20, 0x4f, 0xa1,
+	0xeb, 0x6b, 0x64, 0x3f, 0xa3, 0x25, 0x74, 0x13,
+	0x56, 0x27, 0xca, 0xfa, 0xe7, 0x9f, 0x80, 0x62,
+	0xd9, 0x87, 0xae, 0xd6, 0x96, 0x17, 0x19, 0x16,
+	0xa4, 0xbc, 0xe3, 0xbc, 0x4f, 0x8d
+};
+
 static const unsigned char x509[742] = {
 	0x30, 0x82, 0x02, 0xe2, 0x30, 0x81, 0xcb, 0x02,
 	0x01, 0x01, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86,
@@ -1797,6 +1834,292 @@ const unsigned char aaguid_tpm[16] = {
 	0xb6, 0xe1, 0x30, 0xde, 0x50, 0xdc, 0xbe, 0x96,
 };
 
+/*
+ * a root, and packed statements over authdata with x5c = [leaf,
+ * intermediate]; the second leaf has an unknown critical extension
+ */
+static const unsigned char x509_root_packed[410] = {
+	0x30, 0x82, 0x01, 0x96, 0x30, 0x82, 0x01, 0x3b,
+	0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x14, 0x76,
+	0xc6, 0x94, 0xed, 0x43, 0xf2, 0x90, 0xdd, 0xad,
+	0xfe, 0x3c, 0x7b, 0x4a, 0x60, 0x6a, 0x67, 0xcf,
+	0xfd, 0x0f, 0xa5, 0x30, 0x0a, 0x06, 0x08, 0x2a,
+	0x86, 0x48, 0xce, 0x3d, 0x04, 0x03, 0x02, 0x30,
+	0x17, 0x31, 0x15, 0x30, 0x13, 0x06, 0x03, 0x55,
+	0x04, 0x03, 0x0c, 0x0c, 0x72, 0x65, 0x67, 0x72,
+	0x65, 0x73, 0x73, 0x20, 0x72, 0x6f, 0x6f, 0x74,
+	0x30, 0x20, 0x17, 0x0d, 0x32, 0x36, 0x31, 0x30,
+	0x31, 0x35, 0x30, 0x36, 0x34, 0x31, 0x35, 0x31,
+	0x5a, 0x18, 0x0f, 0x32, 0x31, 0x32, 0x36, 0x30,
+	0x39, 0x32, 0x31, 0x30, 0x36, 0x34, 0x31, 0x35,
+	0x31, 0x5a, 0x30, 0x17, 0x31, 0x15, 0x30, 0x13,
+	0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x0c, 0x72,
+	0x65, 0x67, 0x72, 0x65, 0x73, 0x73, 0x20, 0x72,
+	0x6f, 0x6f, 0x74, 0x30, 0x59, 0x30, 0x13, 0x06,
+	0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01,
+	0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03,
+	0x01, 0x07, 0x03, 0x42, 0x00, 0x04, 0xe9, 0xfd,
+	0x8d, 0xf5, 0xc2, 0xc3, 0x56, 0x9a, 0xf1, 0x87,
+	0x81, 0xa4, 0x01, 0xba, 0xf4, 0x71, 0x88, 0x75,
+	0x55, 0x49, 0x68, 0xf3, 0x01, 0x54, 0xde, 0xe6,
+	0x45, 0x26, 0x18, 0xb1, 0x8b, 0xab, 0x30, 0xbc,
+	0x9e, 0xb2, 0x9b, 0x4c, 0x57, 0x04, 0x86, 0xa6,
+	0xef, 0xbe, 0xa2, 0xc8, 0xb4, 0x68, 0x22, 0x50,
+	0xc7, 0x03, 0x98, 0x38, 0xea, 0x82, 0xe7, 0x6b,
+	0x98, 0x99, 0xee, 0x6c, 0xb6, 0x8c, 0xa3, 0x63,
+	0x30, 0x61, 0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d,
+	0x0e, 0x04, 0x16, 0x04, 0x14, 0xf0, 0x7b, 0xb6,
+	0x40, 0xf8, 0xa6, 0x93, 0x42, 0x40, 0xbf, 0x46,
+	0xec, 0x24, 0x8a, 0x09, 0xfe, 0x6e, 0xcb, 0x1e,
+	0x81, 0x30, 0x1f, 0x06, 0x03, 0x55, 0x1d, 0x23,
+	0x04, 0x18, 0x30, 0x16, 0x80, 0x14, 0xf0, 0x7b,
+	0xb6, 0x40, 0xf8, 0xa6, 0x93, 0x42, 0x40, 0xbf,
+	0x46, 0xec, 0x24, 0x8a, 0x09, 0xfe, 0x6e, 0xcb,
+	0x1e, 0x81, 0x30, 0x0f, 0x06, 0x03, 0x55, 0x1d,
+	0x13, 0x01, 0x01, 0xff, 0x04, 0x05, 0x30, 0x03,
+	0x01, 0x01, 0xff, 0x30, 0x0e, 0x06, 0x03, 0x55,
+	0x1d, 0x0f, 0x01, 0x01, 0xff, 0x04, 0x04, 0x03,
+	0x02, 0x01, 0x06, 0x30, 0x0a, 0x06, 0x08, 0x2a,
+	0x86, 0x48, 0xce, 0x3d, 0x04, 0x03, 0x02, 0x03,
+	0x49, 0x00, 0x30, 0x46, 0x02, 0x21, 0x00, 0xc4,
+	0x38, 0x21, 0x80, 0x81, 0x3a, 0xbb, 0x58, 0x85,
+	0xa2, 0x29, 0x9e, 0xad, 0x31, 0xba, 0xf7, 0xf0,
+	0x68, 0xa5, 0x09, 0x37, 0x82, 0x56, 0x8a, 0x84,
+	0x2f, 0x35, 0xdc, 0x59, 0x76, 0x00, 0xcc, 0x02,
+	0x21, 0x00, 0xb6, 0x28, 0xc1, 0xaa, 0x7b, 0x30,
+	0x7e, 0x90, 0x05, 0x6b, 0x44, 0xc1, 0x38, 0x4e,
+	0x8b, 0xc1, 0xfc, 0x95, 0x14, 0x49, 0x30, 0xa3,
+	0x24, 0x0d, 0x21, 0x78, 0xd9, 0x2f, 0x19, 0xa4,
+	0x39, 0xcc,
+};
+
+static const unsigned char attstmt_packed[871] = {
+	0xa3, 0x63, 0x61, 0x6c, 0x67, 0x26, 0x63, 0x73,
+	0x69, 0x67, 0x58, 0x47, 0x30, 0x45, 0x02, 0x20,
+	0x14, 0x1d, 0xba, 0x28, 0x78, 0x01, 0xb1, 0xb7,
+	0x2c, 0x0f, 0x12, 0x38, 0x99, 0x73, 0x4f, 0x34,
+	0x08, 0xb1, 0x00, 0x2b, 0x34, 0x40, 0x96, 0xae,
+	0x89, 0xb4, 0x65, 0x84, 0xfe, 0x83, 0x7f, 0x8a,
+	0x02, 0x21, 0x00, 0xa2, 0xa2, 0x95, 0x64, 0x2b,
+	0xc4, 0x08, 0x15, 0x5f, 0xf3, 0x25, 0xa5, 0x67,
+	0x71, 0x57, 0xb3, 0x64, 0x91, 0xb4, 0x82, 0xd0,
+	0xd0, 0xf5, 0xf2, 0xfb, 0x6d, 0xef, 0x67, 0x80,
+	0x42, 0x86, 0x1d, 0x63, 0x78, 0x35, 0x63, 0x82,
+	0x59, 0x01, 0x7b, 0x30, 0x82, 0x01, 0x77, 0x30,
+	0x82, 0x01, 0x1d, 0xa0, 0x03, 0x02, 0x01, 0x02,
+	0x02, 0x01, 0x03, 0x30, 0x0a, 0x06, 0x08, 0x2a,
+	0x86, 0x48, 0xce, 0x3d, 0x04, 0x03, 0x02, 0x30,
+	0x1f, 0x31, 0x1d, 0x30, 0x1b, 0x06, 0x03, 0x55,
+	0x04, 0x03, 0x0c, 0x14, 0x72, 0x65, 0x67, 0x72,
+	0x65, 0x73, 0x73, 0x20, 0x69, 0x6e, 0x74, 0x65,
+	0x72, 0x6d, 0x65, 0x64, 0x69, 0x61, 0x74, 0x65,
+	0x30, 0x20, 0x17, 0x0d, 0x32, 0x36, 0x31, 0x30,
+	0x31, 0x35, 0x30, 0x36, 0x34, 0x31, 0x35, 0x32,
+	0x5a, 0x18, 0x0f, 0x32, 0x31, 0x32, 0x36, 0x30,
+	0x39, 0x32, 0x31, 0x30, 0x36, 0x34, 0x31, 0x35,
+	0x32, 0x5a, 0x30, 0x17, 0x31, 0x15, 0x30, 0x13,
+	0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x0c, 0x72,
+	0x65, 0x67, 0x72, 0x65, 0x73, 0x73, 0x20, 0x6c,
+	0x65, 0x61, 0x66, 0x30, 0x59, 0x30, 0x13, 0x06,
+	0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01,
+	0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03,
+	0x01, 0x07, 0x03, 0x42, 0x00, 0x04, 0x3e, 0xb0,
+	0x90, 0x1c, 0x23, 0x28, 0x83, 0x38, 0xf2, 0xed,
+	0x4b, 0x2c, 0xa3, 0x29, 0x8f, 0x95, 0x5a, 0x9d,
+	0x5b, 0x05, 0x96, 0x14, 0x54, 0xe4, 0xc4, 0xa0,
+	0xa1, 0xd6, 0x52, 0xa9, 0xab, 0xf2, 0xeb, 0x33,
+	0x51, 0x0c, 0x6c, 0x14, 0x65, 0x94, 0x11, 0xf3,
+	0xf7, 0x6b, 0x1f, 0x71, 0x2e, 0xdf, 0xfd, 0x13,
+	0xfb, 0xc5, 0x6b, 0xa4, 0x50, 0xcf, 0x58, 0xea,
+	0xad, 0xdf, 0x55, 0xb2, 0xde, 0x8d, 0xa3, 0x50,
+	0x30, 0x4e, 0x30, 0x0c, 0x06, 0x03, 0x55, 0x1d,
+	0x13, 0x01, 0x01, 0xff, 0x04, 0x02, 0x30, 0x00,
+	0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04,
+	0x16, 0x04, 0x14, 0x77, 0x01, 0x7d, 0x37, 0xe7,
+	0x27, 0x43, 0x42, 0xd7, 0xf9, 0xd1, 0x70, 0x8c,
+	0xab, 0xdf, 0x53, 0x24, 0x78, 0x6c, 0xd5, 0x30,
+	0x1f, 0x06, 0x03, 0x55, 0x1d, 0x23, 0x04, 0x18,
+	0x30, 0x16, 0x80, 0x14, 0x64, 0xce, 0x62, 0xba,
+	0x94, 0x5e, 0xe3, 0x16, 0x3f, 0x67, 0x3f, 0x8a,
+	0x60, 0x13, 0x86, 0x8b, 0xde, 0x6a, 0x56, 0x65,
+	0x30, 0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce,
+	0x3d, 0x04, 0x03, 0x02, 0x03, 0x48, 0x00, 0x30,
+	0x45, 0x02, 0x20, 0x13, 0xfc, 0x80, 0x12, 0x6f,
+	0xd0, 0xc5, 0xe7, 0x1e, 0xfd, 0xd4, 0xf0, 0x2e,
+	0xb8, 0xed, 0x59, 0xec, 0x02, 0xed, 0x05, 0xd4,
+	0xb1, 0x56, 0x92, 0x83, 0xf2, 0x5f, 0x9d, 0x2f,
+	0xbd, 0x9d, 0x65, 0x02, 0x21, 0x00, 0x9f, 0x4b,
+	0x91, 0x0f, 0xb0, 0x36, 0x30, 0x95, 0xf7, 0x91,
+	0x92, 0xdd, 0x99, 0x8b, 0xd1, 0x74, 0x5f, 0xcc,
+	0xba, 0xf9, 0x28, 0x77, 0x0d, 0xd1, 0x45, 0x67,
+	0x85, 0xc9, 0xa2, 0xe5, 0x3f, 0x31, 0x59, 0x01,
+	0x8e, 0x30, 0x82, 0x01, 0x8a, 0x30, 0x82, 0x01,
+	0x30, 0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x01,
+	0x02, 0x30, 0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48,
+	0xce, 0x3d, 0x04, 0x03, 0x02, 0x30, 0x17, 0x31,
+	0x15, 0x30, 0x13, 0x06, 0x03, 0x55, 0x04, 0x03,
+	0x0c, 0x0c, 0x72, 0x65, 0x67, 0x72, 0x65, 0x73,
+	0x73, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x30, 0x20,
+	0x17, 0x0d, 0x32, 0x36, 0x31, 0x30, 0x31, 0x35,
+	0x30, 0x36, 0x34, 0x31, 0x35, 0x32, 0x5a, 0x18,
+	0x0f, 0x32, 0x31, 0x32, 0x36, 0x30, 0x39, 0x32,
+	0x31, 0x30, 0x36, 0x34, 0x31, 0x35, 0x32, 0x5a,
+	0x30, 0x1f, 0x31, 0x1d, 0x30, 0x1b, 0x06, 0x03,
+	0x55, 0x04, 0x03, 0x0c, 0x14, 0x72, 0x65, 0x67,
+	0x72, 0x65, 0x73, 0x73, 0x20, 0x69, 0x6e, 0x74,
+	0x65, 0x72, 0x6d, 0x65, 0x64, 0x69, 0x61, 0x74,
+	0x65, 0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a,
+	0x86, 0x48, 0xce, 0x3d, 0x02, 0x01, 0x06, 0x08,
+	0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07,
+	0x03, 0x42, 0x00, 0x04, 0xe5, 0x80, 0x28, 0x89,
+	0xb3, 0xb3, 0x5f, 0x4d, 0x58, 0xd8, 0xf7, 0x24,
+	0xd3, 0x60, 0xfe, 0x59, 0xb6, 0xc3, 0x87, 0xe8,
+	0xaf, 0x37, 0x48, 0xcc, 0x6a, 0xd7, 0x59, 0xec,
+	0xe7, 0xa4, 0xbb, 0x57, 0x7a, 0x22, 0xc6, 0xe7,
+	0xe4, 0xa8, 0x40, 0xa8, 0xda, 0x66, 0x52, 0xa0,
+	0x61, 0x95, 0x34, 0x20, 0xc7, 0xc1, 0x3a, 0xdf,
+	0x9a, 0x91, 0x4e, 0x4b, 0x95, 0xec, 0xd0, 0x80,
+	0x51, 0xd5, 0x98, 0x92, 0xa3, 0x63, 0x30, 0x61,
+	0x30, 0x0f, 0x06, 0x03, 0x55, 0x1d, 0x13, 0x01,
+	0x01, 0xff, 0x04, 0x05, 0x30, 0x03, 0x01, 0x01,
+	0xff, 0x30, 0x0e, 0x06, 0x03, 0x55, 0x1d, 0x0f,
+	0x01, 0x01, 0xff, 0x04, 0x04, 0x03, 0x02, 0x01,
+	0x06, 0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e,
+	0x04, 0x16, 0x04, 0x14, 0x64, 0xce, 0x62, 0xba,
+	0x94, 0x5e, 0xe3, 0x16, 0x3f, 0x67, 0x3f, 0x8a,
+	0x60, 0x13, 0x86, 0x8b, 0xde, 0x6a, 0x56, 0x65,
+	0x30, 0x1f, 0x06, 0x03, 0x55, 0x1d, 0x23, 0x04,
+	0x18, 0x30, 0x16, 0x80, 0x14, 0xf0, 0x7b, 0xb6,
+	0x40, 0xf8, 0xa6, 0x93, 0x42, 0x40, 0xbf, 0x46,
+	0xec, 0x24, 0x8a, 0x09, 0xfe, 0x6e, 0xcb, 0x1e,
+	0x81, 0x30, 0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48,
+	0xce, 0x3d, 0x04, 0x03, 0x02, 0x03, 0x48, 0x00,
+	0x30, 0x45, 0x02, 0x21, 0x00, 0xb4, 0xbd, 0x53,
+	0xf5, 0x05, 0xf9, 0xdd, 0x16, 0x0e, 0x00, 0x4f,
+	0x01, 0x9d, 0x38, 0x67, 0x9a, 0xd4, 0x33, 0xba,
+	0xa4, 0x36, 0x75, 0x38, 0x85, 0x34, 0x9e, 0x14,
+	0x61, 0xcc, 0x15, 0xe3, 0x10, 0x02, 0x20, 0x41,
+	0x72, 0x41, 0xf2, 0x2b, 0xba, 0xf7, 0xad, 0x77,
+	0x5a, 0x24, 0xbf, 0x7f, 0xfe, 0xfc, 0x1e, 0x91,
+	0x23, 0x26, 0x02, 0xfb, 0x46, 0x20, 0x5d, 0x3a,
+	0x5a, 0x41, 0x1f, 0xed, 0x7e, 0x32, 0xef,
+};
+
+static const unsigned char attstmt_packed_crit[893] = {
+	0xa3, 0x63, 0x61, 0x6c, 0x67, 0x26, 0x63, 0x73,
+	0x69, 0x67, 0x58, 0x47, 0x30, 0x45, 0x02, 0x20,
+	0x14, 0x1d, 0xba, 0x28, 0x78, 0x01, 0xb1, 0xb7,
+	0x2c, 0x0f, 0x12, 0x38, 0x99, 0x73, 0x4f, 0x34,
+	0x08, 0xb1, 0x00, 0x2b, 0x34, 0x40, 0x96, 0xae,
+	0x89, 0xb4, 0x65, 0x84, 0xfe, 0x83, 0x7f, 0x8a,
+	0x02, 0x21, 0x00, 0xa2, 0xa2, 0x95, 0x64, 0x2b,
+	0xc4, 0x08, 0x15, 0x5f, 0xf3, 0x25, 0xa5, 0x67,
+	0x71, 0x57, 0xb3, 0x64, 0x91, 0xb4, 0x82, 0xd0,
+	0xd0, 0xf5, 0xf2, 0xfb, 0x6d, 0xef, 0x67, 0x80,
+	0x42, 0x86, 0x1d, 0x63, 0x78, 0x35, 0x63, 0x82,
+	0x59, 0x01, 0x91, 0x30, 0x82, 0x01, 0x8d, 0x30,
+	0x82, 0x01, 0x32, 0xa0, 0x03, 0x02, 0x01, 0x02,
+	0x02, 0x01, 0x04, 0x30, 0x0a, 0x06, 0x08, 0x2a,
+	0x86, 0x48, 0xce, 0x3d, 0x04, 0x03, 0x02, 0x30,
+	0x1f, 0x31, 0x1d, 0x30, 0x1b, 0x06, 0x03, 0x55,
+	0x04, 0x03, 0x0c, 0x14, 0x72, 0x65, 0x67, 0x72,
+	0x65, 0x73, 0x73, 0x20, 0x69, 0x6e, 0x74, 0x65,
+	0x72, 0x6d, 0x65, 0x64, 0x69, 0x61, 0x74, 0x65,
+	0x30, 0x20, 0x17, 0x0d, 0x32, 0x36, 0x31, 0x30,
+	0x31, 0x35, 0x30, 0x36, 0x34, 0x31, 0x35, 0x32,
+	0x5a, 0x18, 0x0f, 0x32, 0x31, 0x32, 0x36, 0x30,
+	0x39, 0x32, 0x31, 0x30, 0x36, 0x34, 0x31, 0x35,
+	0x32, 0x5a, 0x30, 0x17, 0x31, 0x15, 0x30, 0x13,
+	0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x0c, 0x72,
+	0x65, 0x67, 0x72, 0x65, 0x73, 0x73, 0x20, 0x6c,
+	0x65, 0x61, 0x66, 0x30, 0x59, 0x30, 0x13, 0x06,
+	0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01,
+	0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03,
+	0x01, 0x07, 0x03, 0x42, 0x00, 0x04, 0x3e, 0xb0,
+	0x90, 0x1c, 0x23, 0x28, 0x83, 0x38, 0xf2, 0xed,
+	0x4b, 0x2c, 0xa3, 0x29, 0x8f, 0x95, 0x5a, 0x9d,
+	0x5b, 0x05, 0x96, 0x14, 0x54, 0xe4, 0xc4, 0xa0,
+	0xa1, 0xd6, 0x52, 0xa9, 0xab, 0xf2, 0xeb, 0x33,
+	0x51, 0x0c, 0x6c, 0x14, 0x65, 0x94, 0x11, 0xf3,
+	0xf7, 0x6b, 0x1f, 0x71, 0x2e, 0xdf, 0xfd, 0x13,
+	0xfb, 0xc5, 0x6b, 0xa4, 0x50, 0xcf, 0x58, 0xea,
+	0xad, 0xdf, 0x55, 0xb2, 0xde, 0x8d, 0xa3, 0x65,
+	0x30, 0x63, 0x30, 0x0c, 0x06, 0x03, 0x55, 0x1d,
+	0x13, 0x01, 0x01, 0xff, 0x04, 0x02, 0x30, 0x00,
+	0x30, 0x13, 0x06, 0x0a, 0x2b, 0x06, 0x01, 0x04,
+	0x01, 0x82, 0xc4, 0x0a, 0x63, 0x01, 0x01, 0x01,
+	0xff, 0x04, 0x02, 0x05, 0x00, 0x30, 0x1d, 0x06,
+	0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16, 0x04, 0x14,
+	0x77, 0x01, 0x7d, 0x37, 0xe7, 0x27, 0x43, 0x42,
+	0xd7, 0xf9, 0xd1, 0x70, 0x8c, 0xab, 0xdf, 0x53,
+	0x24, 0x78, 0x6c, 0xd5, 0x30, 0x1f, 0x06, 0x03,
+	0x55, 0x1d, 0x23, 0x04, 0x18, 0x30, 0x16, 0x80,
+	0x14, 0x64, 0xce, 0x62, 0xba, 0x94, 0x5e, 0xe3,
+	0x16, 0x3f, 0x67, 0x3f, 0x8a, 0x60, 0x13, 0x86,
+	0x8b, 0xde, 0x6a, 0x56, 0x65, 0x30, 0x0a, 0x06,
+	0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x04, 0x03,
+	0x02, 0x03, 0x49, 0x00, 0x30, 0x46, 0x02, 0x21,
+	0x00, 0xe0, 0x23, 0xac, 0xa5, 0x54, 0x57, 0x23,
+	0x22, 0x8f, 0x2e, 0xa4, 0xa7, 0x2e, 0x3d, 0x91,
+	0x57, 0xde, 0x58, 0x4e, 0x2b, 0xa4, 0x7b, 0x30,
+	0x40, 0x2b, 0xb8, 0x5e, 0x84, 0xc5, 0xd6, 0x9d,
+	0xc2, 0x02, 0x21, 0x00, 0xc8, 0x74, 0x63, 0x45,
+	0x5e, 0x18, 0xab, 0x26, 0x0c, 0x2c, 0xdf, 0x29,
+	0x28, 0xca, 0x14, 0x5d, 0xb0, 0xc7, 0x4e, 0x6b,
+	0x00, 0x11, 0xb0, 0xa5, 0xbb, 0xc2, 0x6a, 0x1b,
+	0x1d, 0x59, 0x83, 0x86, 0x59, 0x01, 0x8e, 0x30,
+	0x82, 0x01, 0x8a, 0x30, 0x82, 0x01, 0x30, 0xa0,
+	0x03, 0x02, 0x01, 0x02, 0x02, 0x01, 0x02, 0x30,
+	0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d,
+	0x04, 0x03, 0x02, 0x30, 0x17, 0x31, 0x15, 0x30,
+	0x13, 0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x0c,
+	0x72, 0x65, 0x67, 0x72, 0x65, 0x73, 0x73, 0x20,
+	0x72, 0x6f, 0x6f, 0x74, 0x30, 0x20, 0x17, 0x0d,
+	0x32, 0x36, 0x31, 0x30, 0x31, 0x35, 0x30, 0x36,
+	0x34, 0x31, 0x35, 0x32, 0x5a, 0x18, 0x0f, 0x32,
+	0x31, 0x32, 0x36, 0x30, 0x39, 0x32, 0x31, 0x30,
+	0x36, 0x34, 0x31, 0x35, 0x32, 0x5a, 0x30, 0x1f,
+	0x31, 0x1d, 0x30, 0x1b, 0x06, 0x03, 0x55, 0x04,
+	0x03, 0x0c, 0x14, 0x72, 0x65, 0x67, 0x72, 0x65,
+	0x73, 0x73, 0x20, 0x69, 0x6e, 0x74, 0x65, 0x72,
+	0x6d, 0x65, 0x64, 0x69, 0x61, 0x74, 0x65, 0x30,
+	0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48,
+	0xce, 0x3d, 0x02, 0x01, 0x06, 0x08, 0x2a, 0x86,
+	0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03, 0x42,
+	0x00, 0x04, 0xe5, 0x80, 0x28, 0x89, 0xb3, 0xb3,
+	0x5f, 0x4d, 0x58, 0xd8, 0xf7, 0x24, 0xd3, 0x60,
+	0xfe, 0x59, 0xb6, 0xc3, 0x87, 0xe8, 0xaf, 0x37,
+	0x48, 0xcc, 0x6a, 0xd7, 0x59, 0xec, 0xe7, 0xa4,
+	0xbb, 0x57, 0x7a, 0x22, 0xc6, 0xe7, 0xe4, 0xa8,
+	0x40, 0xa8, 0xda, 0x66, 0x52, 0xa0, 0x61, 0x95,
+	0x34, 0x20, 0xc7, 0xc1, 0x3a, 0xdf, 0x9a, 0x91,
+	0x4e, 0x4b, 0x95, 0xec, 0xd0, 0x80, 0x51, 0xd5,
+	0x98, 0x92, 0xa3, 0x63, 0x30, 0x61, 0x30, 0x0f,
+	0x06, 0x03, 0x55, 0x1d, 0x13, 0x01, 0x01, 0xff,
+	0x04, 0x05, 0x30, 0x03, 0x01, 0x01, 0xff, 0x30,
+	0x0e, 0x06, 0x03, 0x55, 0x1d, 0x0f, 0x01, 0x01,
+	0xff, 0x04, 0x04, 0x03, 0x02, 0x01, 0x06, 0x30,
+	0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16,
+	0x04, 0x14, 0x64, 0xce, 0x62, 0xba, 0x94, 0x5e,
+	0xe3, 0x16, 0x3f, 0x67, 0x3f, 0x8a, 0x60, 0x13,
+	0x86, 0x8b, 0xde, 0x6a, 0x56, 0x65, 0x30, 0x1f,
+	0x06, 0x03, 0x55, 0x1d, 0x23, 0x04, 0x18, 0x30,
+	0x16, 0x80, 0x14, 0xf0, 0x7b, 0xb6, 0x40, 0xf8,
+	0xa6, 0x93, 0x42, 0x40, 0xbf, 0x46, 0xec, 0x24,
+	0x8a, 0x09, 0xfe, 0x6e, 0xcb, 0x1e, 0x81, 0x30,
+	0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d,
+	0x04, 0x03, 0x02, 0x03, 0x48, 0x00, 0x30, 0x45,
+	0x02, 0x21, 0x00, 0xb4, 0xbd, 0x53, 0xf5, 0x05,
+	0xf9, 0xdd, 0x16, 0x0e, 0x00, 0x4f, 0x01, 0x9d,
+	0x38, 0x67, 0x9a, 0xd4, 0x33, 0xba, 0xa4, 0x36,
+	0x75, 0x38, 0x85, 0x34, 0x9e, 0x14, 0x61, 0xcc,
+	0x15, 0xe3, 0x10, 0x02, 0x20, 0x41, 0x72, 0x41,
+	0xf2, 0x2b, 0xba, 0xf7, 0xad, 0x77, 0x5a, 0x24,
+	0xbf, 0x7f, 0xfe, 0xfc, 0x1e, 0x91, 0x23, 0x26,
+	0x02, 0xfb, 0x46, 0x20, 0x5d, 0x3a, 0x5a, 0x41,
+	0x1f, 0xed, 0x7e, 0x32, 0xef,
+};
+
 const char rp_id[] = "localhost";
 const char rp_name[] = "sweet home localhost";
 
@@ -1889,6 +2212,8 @@ empty_cred(void)
 	assert(fido_cred_clientdata_hash_ptr(c) == NULL);
 	assert(fido_cred_flags(c) == 0);
 	assert(fido_cred_fmt(c) == NULL);
+	assert(fido_cred_hmac_secret_len(c) == 0);
+	assert(fido_cred_hmac_secret_ptr(c) == NULL);
 	assert(fido_cred_id_len(c) == 0);
 	assert(fido_cred_id_ptr(c) == NULL);
 	assert(fido_cred_prot(c) == 0);
@@ -1942,7 +2267,11 @@ valid_cred(void)
 	assert(fido_cred_set_x509(c, x509, sizeof(x509)) == FIDO_OK);
 	assert(fido_cred_set_sig(c, sig, sizeof(sig)) == FIDO_OK);
 	assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+	assert(fido_cred_set_hmac_salt(c, cdh, 31) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_set_hmac_salt(c, cdh, 32) == FIDO_OK);
+	/* the salt is an input of the request only */
 	assert(fido_cred_verify(c) == FIDO_OK);
+	assert(fido_cred_hmac_secret_ptr(c) == NULL);
 	assert(fido_cred_prot(c) == 0);
 	assert(fido_cred_pubkey_len(c) == sizeof(pubkey));
 	assert(memcmp(fido_cred_pubkey_ptr(c), pubkey, sizeof(pubkey)) == 0);
@@ -1953,6 +2282,54 @@ valid_cred(void)
 	free_cred(c);
 }
 
+static void
+recycle(void)
+{
+	fido_cred_t *c;
+	const unsigned char *ptr[3];
+
+	c = alloc_cred();
+	fido_cred_recycle(NULL);
+	for (int i = 0; i < 3; i++) {
+		fido_cred_recycle(c);
+		assert(fido_cred_type(c) == 0);
+		assert(fido_cred_clientdata_hash_ptr(c) == NULL);
+		assert(fido_cred_authdata_ptr(c) == NULL);
+		assert(fido_cred_authdata_raw_ptr(c) == NULL);
+		assert(fido_cred_sig_ptr(c) == NULL);
+		assert(fido_cred_x5c_ptr(c) == NULL);
+		assert(fido_cred_id_ptr(c) == NULL);
+		assert(fido_cred_verify(c) == FIDO_ERR_INVALID_ARGUMENT);
+		assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+		assert(fido_cred_set_clientdata_hash(c, cdh,
+		    sizeof(cdh)) == FIDO_OK);
+		assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+		assert(fido_cred_set_authdata(c, authdata,
+		    sizeof(authdata)) == FIDO_OK);
+		assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+		assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+		assert(fido_cred_set_x509(c, x509, sizeof(x509)) == FIDO_OK);
+		assert(fido_cred_set_sig(c, sig, sizeof(sig)) == FIDO_OK);
+		assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+		assert(fido_cred_verify(c) == FIDO_OK);
+		assert(strcmp(fido_cred_rp_id(c), rp_id) == 0);
+		assert(strcmp(fido_cred_fmt(c), "packed") == 0);
+		assert(fido_cred_id_len(c) == sizeof(id));
+		assert(memcmp(fido_cred_id_ptr(c), id, sizeof(id)) == 0);
+		if (i == 0) {
+			ptr[0] = fido_cred_clientdata_hash_ptr(c);
+			ptr[1] = fido_cred_authdata_ptr(c);
+			ptr[2] = fido_cred_sig_ptr(c);
+			continue;
+		}
+		/* the buffers of the previous credential are reused */
+		assert(fido_cred_clientdata_hash_ptr(c) == ptr[0]);
+		assert(fido_cred_authdata_ptr(c) == ptr[1]);
+		assert(fido_cred_sig_ptr(c) == ptr[2]);
+	}
+	free_cred(c);
+}
+
 static void
 no_cdh(void)
 {
@@ -2271,6 +2648,11 @@ junk_authdata(void)
 	c = alloc_cred();
 	assert(fido_cred_set_authdata(c, junk,
 	    sizeof(authdata)) == FIDO_ERR_INVALID_ARGUMENT);
+	assert((junk = realloc(junk, sizeof(authdata) + 1)) != NULL);
+	memcpy(junk, authdata, sizeof(authdata));
+	junk[sizeof(authdata)] = 0x00;
+	assert(fido_cred_set_authdata(c, junk,
+	    sizeof(authdata) + 1) == FIDO_ERR_INVALID_ARGUMENT);
 	assert(fido_cred_authdata_len(c) == 0);
 	assert(fido_cred_authdata_ptr(c) == NULL);
 	assert(fido_cred_authdata_raw_len(c) == 0);
@@ -2359,6 +2741,40 @@ junk_x509(void)
 	free(junk);
 }
 
+static void
+repeated_x509(void)
+{
+	fido_cred_t *c;
+	unsigned char *junk;
+
+	junk = malloc(sizeof(sig));
+	assert(junk != NULL);
+	memcpy(junk, sig, sizeof(sig));
+	junk[0] = (unsigned char)~junk[0];
+
+	for (int i = 0; i < 3; i++) {
+		c = alloc_cred();
+		assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+		assert(fido_cred_set_clientdata_hash(c, cdh,
+		    sizeof(cdh)) == FIDO_OK);
+		assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+		assert(fido_cred_set_authdata(c, authdata,
+		    sizeof(authdata)) == FIDO_OK);
+		assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+		assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+		assert(fido_cred_set_x509(c, x509, sizeof(x509)) == FIDO_OK);
+		/* a known certificate does not vouch for a bad signature */
+		assert(fido_cred_set_sig(c, i == 1 ? junk : sig,
+		    sizeof(sig)) == FIDO_OK);
+		assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+		assert(fido_cred_verify(c) == (i == 1 ?
+		    FIDO_ERR_INVALID_SIG : FIDO_OK));
+		free_cred(c);
+	}
+
+	free(junk);
+}
+
 /* github issue #6 */
 static void
 invalid_type(void)
@@ -2509,6 +2925,31 @@ fmt_none(void)
 	free_cred(c);
 }
 
+static void
+fmt_apple_android_key(void)
+{
+	fido_cred_t *c;
+
+	/* a packed statement's certificate lacks the extensions checked */
+	c = alloc_cred();
+	assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(c, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+	assert(fido_cred_set_authdata(c, authdata, sizeof(authdata)) == FIDO_OK);
+	assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_x509(c, x509, sizeof(x509)) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "apple") == FIDO_OK);
+	assert(fido_cred_verify(c) == FIDO_ERR_INVALID_SIG);
+	assert(fido_cred_set_sig(c, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "android-key") == FIDO_OK);
+	assert(fido_cred_verify(c) == FIDO_ERR_INVALID_PARAM);
+	assert(fido_cred_verify_self(c) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+	assert(fido_cred_verify(c) == FIDO_OK);
+	free_cred(c);
+}
+
 static void
 valid_tpm_rs256_cred(bool xfail)
 {
@@ -2568,6 +3009,146 @@ valid_tpm_es256_cred(bool xfail)
 	free_cred(c);
 }
 
+static void
+attest_store(bool xfail)
+{
+	fido_attest_store_t *store, *empty;
+	fido_cred_t *c;
+	int expected = xfail ? FIDO_ERR_INVALID_SIG : FIDO_OK;
+
+	/* x509_1_tpm_es256 expires on 2027-06-03 */
+	if (time(NULL) >= 1812051616)
+		return;
+
+	assert((store = fido_attest_store_new()) != NULL);
+	assert((empty = fido_attest_store_new()) != NULL);
+	assert(fido_attest_store_add(store, NULL, 0) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_attest_store_add(store, x509_1_tpm_es256, 16) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_attest_store_add(store, x509_1_tpm_es256, sizeof(x509_1_tpm_es256)) == FIDO_OK);
+
+	c = alloc_cred();
+	assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata(c, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+	assert(fido_cred_set_authdata(c, authdata_tpm_es256, sizeof(authdata_tpm_es256)) == FIDO_OK);
+	assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_uv(c, FIDO_OPT_TRUE) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "tpm") == FIDO_OK);
+	assert(fido_cred_set_attstmt(c, attstmt_tpm_es256, sizeof(attstmt_tpm_es256)) == FIDO_OK);
+	assert(fido_cred_verify_chain(c, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	/* the second pass verifies the leaf against the memoized x5c[1] */
+	assert(fido_cred_verify_chain(c, store) == expected);
+	assert(fido_cred_verify_chain(c, store) == expected);
+	assert(fido_cred_verify_chain(c, empty) == (xfail ? expected : FIDO_ERR_INVALID_SIG));
+	free_cred(c);
+
+	/* a known intermediate does not vouch for an unrelated leaf */
+	c = alloc_cred();
+	assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(c, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+	assert(fido_cred_set_authdata(c, authdata, sizeof(authdata)) == FIDO_OK);
+	assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_x509(c, x509, sizeof(x509)) == FIDO_OK);
+	assert(fido_cred_set_sig(c, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+	assert(fido_cred_verify(c) == FIDO_OK);
+	assert(fido_cred_verify_chain(c, store) == FIDO_ERR_INVALID_SIG);
+	free_cred(c);
+
+	fido_attest_store_free(&store);
+	fido_attest_store_free(&empty);
+	assert(store == NULL && empty == NULL);
+}
+
+static fido_cred_t *
+alloc_packed_cred(const unsigned char *attstmt, size_t attstmt_len)
+{
+	fido_cred_t *c;
+
+	c = alloc_cred();
+	assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(c, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+	assert(fido_cred_set_authdata(c, authdata, sizeof(authdata)) == FIDO_OK);
+	assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+	assert(fido_cred_set_attstmt(c, attstmt, attstmt_len) == FIDO_OK);
+	assert(fido_cred_x5c_list_count(c) == 2);
+	assert(fido_cred_verify(c) == FIDO_OK);
+
+	return (c);
+}
+
+static void
+attest_store_critical(void)
+{
+	fido_attest_store_t *store;
+	fido_cred_t *c, *crit;
+
+	assert((store = fido_attest_store_new()) != NULL);
+	assert(fido_attest_store_add(store, x509_root_packed,
+	    sizeof(x509_root_packed)) == FIDO_OK);
+	c = alloc_packed_cred(attstmt_packed, sizeof(attstmt_packed));
+	crit = alloc_packed_cred(attstmt_packed_crit,
+	    sizeof(attstmt_packed_crit));
+	/* rejected with the intermediate unknown to the store ... */
+	assert(fido_cred_verify_chain(crit, store) == FIDO_ERR_INVALID_SIG);
+	assert(fido_cred_verify_chain(c, store) == FIDO_OK);
+	/* ... and once it has been memoized */
+	assert(fido_cred_verify_chain(c, store) == FIDO_OK);
+	assert(fido_cred_verify_chain(crit, store) == FIDO_ERR_INVALID_SIG);
+	free_cred(c);
+	free_cred(crit);
+	fido_attest_store_free(&store);
+}
+
+static void
+batch_verify(void)
+{
+	fido_cred_verify_item_t v[3];
+	fido_cred_t *c, *junk;
+
+	c = alloc_cred();
+	assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(c, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+	assert(fido_cred_set_authdata(c, authdata, sizeof(authdata)) == FIDO_OK);
+	assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_x509(c, x509, sizeof(x509)) == FIDO_OK);
+	assert(fido_cred_set_sig(c, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+	junk = alloc_cred();
+	assert(fido_cred_set_type(junk, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(junk, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(junk, rp_id, rp_name) == FIDO_OK);
+	assert(fido_cred_set_authdata(junk, authdata, sizeof(authdata)) == FIDO_OK);
+	assert(fido_cred_set_rk(junk, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_uv(junk, FIDO_OPT_TRUE) == FIDO_OK);
+	assert(fido_cred_set_x509(junk, x509, sizeof(x509)) == FIDO_OK);
+	assert(fido_cred_set_sig(junk, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_cred_set_fmt(junk, "packed") == FIDO_OK);
+
+	memset(v, 0, sizeof(v));
+	v[0].cred = v[1].cred = v[2].cred = c;
+	v[0].r = v[1].r = v[2].r = -1;
+	assert(fido_cred_verify_batch(NULL, 0, NULL) == FIDO_OK);
+	assert(fido_cred_verify_batch(NULL, 1, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_verify_batch(v, 3, NULL) == FIDO_OK);
+	assert(v[0].r == FIDO_OK && v[1].r == FIDO_OK && v[2].r == FIDO_OK);
+	v[1].cred = junk;
+	v[2].cred = NULL;
+	assert(fido_cred_verify_batch(v, 3, NULL) == FIDO_ERR_INVALID_PARAM);
+	assert(v[0].r == FIDO_OK);
+	assert(v[1].r == FIDO_ERR_INVALID_PARAM);
+	assert(v[2].r == FIDO_ERR_INVALID_ARGUMENT);
+	free_cred(c);
+	free_cred(junk);
+}
+
 static void
 push_kv(cbor_item_t *map, const char *key, cbor_item_t *value)
 {
@@ -2586,9 +3167,12 @@ push_kv(cbor_item_t *map, const char *key, cbor_item_t *value)
 static void
 attestation_object(void)
 {
+	static const unsigned char ver[] = {
+		0x63, 0x76, 0x65, 0x72, 0x63, 0x32, 0x2e, 0x30,
+	};
 	struct cbor_load_result cbor;
-	unsigned char *attobj = NULL;
-	size_t len, alloclen = 0;
+	unsigned char *attobj = NULL, *padded;
+	size_t len, off, alloclen = 0;
 	cbor_item_t *map;
 	fido_cred_t *c;
 
@@ -2619,10 +3203,188 @@ attestation_object(void)
 	assert(memcmp(fido_cred_id_ptr(c), id_tpm_es256, sizeof(id_tpm_es256)) == 0);
 	assert(fido_cred_aaguid_len(c) == sizeof(aaguid_tpm));
 	assert(memcmp(fido_cred_aaguid_ptr(c), aaguid_tpm, sizeof(aaguid_tpm)) == 0);
+	assert(fido_cred_x5c_list_count(c) == 2);
+
+	/* a non-shortest head; attStmt is re-encoded */
+	assert((padded = malloc(len + 1)) != NULL);
+	for (off = 0; off + sizeof(ver) <= len; off++)
+		if (memcmp(&attobj[off], ver, sizeof(ver)) == 0)
+			break;
+	assert(off + sizeof(ver) <= len);
+	off += 4; /* the head of "2.0" */
+	memcpy(padded, attobj, off);
+	padded[off] = 0x78;
+	padded[off + 1] = 0x03;
+	memcpy(&padded[off + 2], &attobj[off + 1], len - off - 1);
+	assert(fido_cred_set_attobj(c, padded, len + 1) == FIDO_OK);
+	assert(strcmp(fido_cred_fmt(c), "tpm") == 0);
+	assert(fido_cred_attstmt_len(c) == sizeof(attstmt_tpm_es256));
+	assert(memcmp(fido_cred_attstmt_ptr(c), attstmt_tpm_es256, sizeof(attstmt_tpm_es256)) == 0);
+	assert(fido_cred_authdata_len(c) == sizeof(authdata_tpm_es256));
+	assert(memcmp(fido_cred_authdata_ptr(c), authdata_tpm_es256, sizeof(authdata_tpm_es256)) == 0);
+	assert(fido_cred_x5c_list_count(c) == 2);
 	free_cred(c);
+	free(padded);
 	free(attobj);
 }
 
+static void
+self_attestation(void)
+{
+	fido_cred_t	*c;
+	fido_pk_t	*pk;
+	unsigned char	 junk[sizeof(sig_self)];
+
+	c = alloc_cred();
+	assert((pk = fido_pk_new()) != NULL);
+	assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(c, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+	assert(fido_cred_set_authdata(c, authdata_self,
+	    sizeof(authdata_self)) == FIDO_OK);
+	assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_sig(c, sig_self, sizeof(sig_self)) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+	assert(fido_cred_verify(c) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_verify_self(c) == FIDO_OK);
+	assert(fido_cred_verify_self_pk(c, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_verify_self_pk(c, pk) == FIDO_OK);
+	assert(fido_pk_type(pk) == COSE_ES256);
+	/* a failed verification leaves the key empty */
+	memcpy(junk, sig_self, sizeof(junk));
+	junk[sizeof(junk) - 1] ^= 0x01;
+	assert(fido_cred_set_sig(c, junk, sizeof(junk)) == FIDO_OK);
+	assert(fido_cred_verify_self(c) == FIDO_ERR_INVALID_SIG);
+	assert(fido_cred_verify_self_pk(c, pk) == FIDO_ERR_INVALID_SIG);
+	assert(fido_pk_type(pk) == 0);
+	fido_pk_free(&pk);
+	free_cred(c);
+}
+
+static void
+clientdata_stream(void)
+{
+	static const unsigned char cd[] = "{\"type\":\"webauthn.create\","
+	    "\"challenge\":\"AAAA\",\"origin\":\"https://localhost\"}";
+	fido_cred_t *a, *b;
+	const size_t len = sizeof(cd) - 1;
+
+	a = alloc_cred();
+	b = alloc_cred();
+	assert(fido_cred_set_clientdata(a, cd, len) == FIDO_OK);
+	assert(fido_cred_set_clientdata_update(b, cd,
+	    len) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_set_clientdata_final(b) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_set_clientdata_init(b) == FIDO_OK);
+	for (size_t i = 0; i < len; i += 7)
+		assert(fido_cred_set_clientdata_update(b, cd + i,
+		    len - i < 7 ? len - i : 7) == FIDO_OK);
+	assert(fido_cred_set_clientdata_update(b, NULL, 0) == FIDO_OK);
+	assert(fido_cred_set_clientdata_update(b, NULL,
+	    1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_set_clientdata_final(b) == FIDO_OK);
+	assert(fido_cred_clientdata_hash_len(b) ==
+	    fido_cred_clientdata_hash_len(a));
+	assert(memcmp(fido_cred_clientdata_hash_ptr(b),
+	    fido_cred_clientdata_hash_ptr(a),
+	    fido_cred_clientdata_hash_len(a)) == 0);
+	/* the hash is set */
+	assert(fido_cred_set_clientdata_init(b) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_set_clientdata_final(b) == FIDO_ERR_INVALID_ARGUMENT);
+	free_cred(a);
+	free_cred(b);
+}
+
+static void
+serialize(void)
+{
+	fido_cred_t *c, *d;
+	unsigned char *ptr;
+	size_t len, off;
+
+	c = alloc_cred();
+	d = alloc_cred();
+	assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(c, cdh, sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(c, rp_id, rp_name) == FIDO_OK);
+	assert(fido_cred_set_authdata(c, authdata, sizeof(authdata)) == FIDO_OK);
+	assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_x509(c, x509, sizeof(x509)) == FIDO_OK);
+	assert(fido_cred_set_sig(c, sig, sizeof(sig)) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+	assert(fido_cred_verify(c) == FIDO_OK);
+	assert(fido_cred_serialize(c, NULL, &len) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_serialize(c, &ptr, &len) == FIDO_OK);
+	assert(fido_cred_deserialize(d, NULL, 0) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_deserialize(d, ptr, len - 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_type(d) == 0);
+	assert(fido_cred_authdata_ptr(d) == NULL);
+	ptr[0] ^= 0x01;
+	assert(fido_cred_deserialize(d, ptr, len) == FIDO_ERR_INVALID_ARGUMENT);
+	ptr[0] ^= 0x01;
+	/* the decoded flags must agree with the authdata */
+	off = 8 + 5 * 4 + 4 + strlen("packed") + 4 + strlen(rp_id) + 4 +
+	    strlen(rp_name) + 4 + sizeof(cdh) + 4 + sizeof(authdata) + 4 +
+	    sizeof(authdata) - 2 + 32;
+	assert(off < len && ptr[off] == fido_cred_flags(c));
+	ptr[off] ^= 0x04;
+	assert(fido_cred_deserialize(d, ptr, len) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_authdata_ptr(d) == NULL);
+	ptr[off] ^= 0x04;
+	assert(fido_cred_deserialize(d, ptr, len) == FIDO_OK);
+	assert(fido_cred_verify(d) == FIDO_OK);
+	assert(fido_cred_type(d) == COSE_ES256);
+	assert(strcmp(fido_cred_fmt(d), "packed") == 0);
+	assert(strcmp(fido_cred_rp_id(d), rp_id) == 0);
+	assert(strcmp(fido_cred_rp_name(d), rp_name) == 0);
+	assert(fido_cred_authdata_len(d) == sizeof(authdata));
+	assert(memcmp(fido_cred_authdata_ptr(d), authdata, sizeof(authdata)) == 0);
+	assert(fido_cred_pubkey_len(d) == sizeof(pubkey));
+	assert(memcmp(fido_cred_pubkey_ptr(d), pubkey, sizeof(pubkey)) == 0);
+	assert(fido_cred_id_len(d) == sizeof(id));
+	assert(memcmp(fido_cred_id_ptr(d), id, sizeof(id)) == 0);
+	assert(fido_cred_aaguid_len(d) == sizeof(aaguid));
+	assert(memcmp(fido_cred_aaguid_ptr(d), aaguid, sizeof(aaguid)) == 0);
+	assert(fido_cred_x5c_len(d) == sizeof(x509));
+	assert(memcmp(fido_cred_x5c_ptr(d), x509, sizeof(x509)) == 0);
+	assert(fido_cred_sig_len(d) == sizeof(sig));
+	assert(memcmp(fido_cred_sig_ptr(d), sig, sizeof(sig)) == 0);
+	assert(fido_cred_sigcount(d) == fido_cred_sigcount(c));
+	assert(fido_cred_flags(d) == fido_cred_flags(c));
+	free(ptr);
+	free_cred(c);
+	free_cred(d);
+}
+
+static void
+exclude_list(void)
+{
+	const unsigned char	*ptr[3] = { id, id, NULL };
+	const size_t		 len[3] = { sizeof(id), sizeof(id), 1 };
+	fido_cred_t		*c;
+
+	c = alloc_cred();
+	for (size_t i = 0; i < 100; i++)
+		assert(fido_cred_exclude(c, id, sizeof(id)) == FIDO_OK);
+	assert(c->excl.len == 100);
+	assert(c->excl.cap >= 100 && c->excl.cap < 200);
+	assert(fido_cred_set_exclude_list(c, NULL, NULL, 1) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_cred_set_exclude_list(c, ptr, len, 3) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(c->excl.len == 100);
+	assert(fido_cred_set_exclude_list(c, ptr, len, 2) == FIDO_OK);
+	assert(c->excl.len == 2 && c->excl.cap == 2);
+	assert(c->excl.ptr[1].len == sizeof(id));
+	assert(memcmp(c->excl.ptr[1].ptr, id, sizeof(id)) == 0);
+	assert(fido_cred_exclude(c, id, sizeof(id)) == FIDO_OK);
+	assert(c->excl.len == 3);
+	assert(fido_cred_set_exclude_list(c, NULL, NULL, 0) == FIDO_OK);
+	assert(c->excl.len == 0 && c->excl.ptr == NULL);
+	free_cred(c);
+}
+
 int
 main(void)
 {
@@ -2632,6 +3394,7 @@ main(void)
 
 	empty_cred();
 	valid_cred();
+	recycle();
 	no_cdh();
 	no_rp_id();
 	no_rp_name();
@@ -2646,6 +3409,7 @@ main(void)
 	junk_authdata();
 	junk_x509();
 	junk_sig();
+	repeated_x509();
 	wrong_options();
 	invalid_type();
 	bad_cbor_serialize();
@@ -2654,9 +3418,17 @@ main(void)
 	wrong_credprot();
 	raw_authdata();
 	fmt_none();
+	fmt_apple_android_key();
 	valid_tpm_rs256_cred(xfail);
 	valid_tpm_es256_cred(xfail);
+	attest_store(xfail);
+	attest_store_critical();
+	batch_verify();
 	attestation_object();
+	clientdata_stream();
+	self_attestation();
+	serialize();
+	exclude_list();
 
 	exit(0);
 }
@@ -7,13 +7,18 @@
 
 #undef NDEBUG
 
+#include <openssl/evp.h>
+
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
 
 #define _FIDO_INTERNAL
 
 #include <fido.h>
+#include <fido/config.h>
+#include <fido/credman.h>
 
 #include "../fuzz/wiredata_fido2.h"
 
@@ -25,6 +30,10 @@ static size_t	 wiredata_len;
 static int	 fake_dev_handle;
 static int	 initialised;
 static long	 interval_ms;
+static uint8_t	 capture_buf[1024];
+static size_t	 capture_len;
+static size_t	 capture_want;
+static size_t	 capture_cnt;
 
 #if defined(_MSC_VER)
 static int
@@ -124,6 +133,46 @@ dummy_write(void *handle, const unsigned char *ptr, size_t len)
 	return ((int)len);
 }
 
+static int
+capture_write(void *handle, const unsigned char *ptr, size_t len)
+{
+	const unsigned char	*body;
+	size_t			 n;
+
+	assert(len == REPORT_LEN);
+
+	if (ptr[5] == (CTAP_FRAME_INIT | CTAP_CMD_CBOR)) {
+		capture_want = (size_t)((ptr[6] << 8) | ptr[7]);
+		capture_len = 0;
+		capture_cnt++;
+		body = &ptr[1 + CTAP_INIT_HEADER_LEN];
+		n = REPORT_LEN - 1 - CTAP_INIT_HEADER_LEN;
+	} else if ((ptr[5] & CTAP_FRAME_INIT) == 0) {
+		body = &ptr[1 + CTAP_CONT_HEADER_LEN];
+		n = REPORT_LEN - 1 - CTAP_CONT_HEADER_LEN;
+	} else
+		return (dummy_write(handle, ptr, len));
+
+	if (n > capture_want - capture_len)
+		n = capture_want - capture_len;
+	assert(capture_len + n <= sizeof(capture_buf));
+	memcpy(&capture_buf[capture_len], body, n);
+	capture_len += n;
+
+	return (dummy_write(handle, ptr, len));
+}
+
+/* echo the nonce of a later CTAPHID_INIT in the next report */
+static int
+init_write(void *handle, const unsigned char *ptr, size_t len)
+{
+	if (initialised && wiredata_ptr != NULL && wiredata_len >= 15 &&
+	    memcmp(&ptr[1], "\xff\xff\xff\xff\x86", 5) == 0)
+		memcpy(&wiredata_ptr[7], &ptr[8], sizeof(ctap_nonce));
+
+	return (dummy_write(handle, ptr, len));
+}
+
 static uint8_t *
 wiredata_setup(const uint8_t *data, size_t len)
 {
@@ -150,6 +199,36 @@ wiredata_setup(const uint8_t *data, size_t len)
 	return (wiredata_ptr);
 }
 
+static size_t
+wiredata_frame(uint8_t *out, size_t outlen, const uint8_t *cid, uint8_t cmd,
+    const uint8_t *msg, size_t len)
+{
+	const size_t	 pkt = REPORT_LEN - 1;
+	size_t		 off, n;
+	uint8_t		 seq = 0;
+
+	assert(len <= UINT16_MAX && outlen >= pkt);
+	memset(out, 0, outlen);
+	memcpy(out, cid, 4);
+	out[4] = CTAP_FRAME_INIT | cmd;
+	out[5] = (uint8_t)(len >> 8);
+	out[6] = (uint8_t)(len & 0xff);
+	n = len < pkt - CTAP_INIT_HEADER_LEN ? len : pkt - CTAP_INIT_HEADER_LEN;
+	memcpy(&out[CTAP_INIT_HEADER_LEN], msg, n);
+	for (off = pkt; n < len; off += pkt) {
+		size_t m = len - n;
+		if (m > pkt - CTAP_CONT_HEADER_LEN)
+			m = pkt - CTAP_CONT_HEADER_LEN;
+		assert(off + pkt <= outlen);
+		memcpy(&out[off], cid, 4);
+		out[off + 4] = seq++;
+		memcpy(&out[off + CTAP_CONT_HEADER_LEN], &msg[n], m);
+		n += m;
+	}
+
+	return (off);
+}
+
 static void
 wiredata_clear(uint8_t **wiredata)
 {
@@ -336,6 +415,95 @@ has_pin(void)
 	wiredata_clear(&wiredata);
 }
 
+static void
+pin_minlen_rpid(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 status[] = { WIREDATA_CTAP_CBOR_STATUS };
+	const char	*rpid[] = { "a.example", "b.example", "c.example" };
+	uint8_t		 data[sizeof(info) + sizeof(status)];
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	memcpy(data, info, sizeof(info));
+	memcpy(data + sizeof(info), status, sizeof(status));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(dev->info != NULL);
+	dev->info->maxrpid_minlen = 2;
+	/* rejected without a request */
+	assert(fido_dev_set_pin_minlen_rpid(dev, rpid, 3,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(wiredata_len == sizeof(status));
+	assert(fido_dev_set_pin_minlen_rpid(dev, rpid, 2, NULL) == FIDO_OK);
+	assert(wiredata_len == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+health_snapshot(void)
+{
+	const uint8_t	 data[] = {
+			    WIREDATA_CTAP_CBOR_INFO,
+			    WIREDATA_CTAP_CBOR_INFO,
+			    WIREDATA_CTAP_CBOR_RETRIES
+			 };
+	fido_dev_health_t h;
+	fido_cbor_info_t *ci;
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+	memset(&h, 0, sizeof(h));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((ci = fido_cbor_info_new()) != NULL);
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_health_snapshot(dev, NULL, NULL) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	/* the fixture has no clientPin option; pretend it does */
+	dev->flags |= FIDO_DEV_PIN_SET;
+	h.info = ci;
+	h.metadata = NULL;
+	h.bio = NULL;
+	assert(fido_dev_health_snapshot(dev, &h, NULL) == FIDO_OK);
+	assert(h.info_r == FIDO_OK);
+	assert(fido_cbor_info_versions_len(ci) != 0);
+	assert(h.pin_retries_r == FIDO_OK);
+	assert(h.pin_retries == 8);
+	/* skipped without a round trip */
+	assert(h.uv_retries_r == FIDO_ERR_UNSUPPORTED_OPTION);
+	assert(h.uv_retries == -1);
+	assert(h.metadata_r == FIDO_ERR_UNSUPPORTED_OPTION);
+	assert(h.bio_r == FIDO_ERR_UNSUPPORTED_OPTION);
+	assert(wiredata_len == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_cbor_info_free(&ci);
+	wiredata_clear(&wiredata);
+}
+
 static void
 timeout_rx(void)
 {
@@ -408,6 +576,48 @@ timeout_ok(void)
 	interval_ms = 0;
 }
 
+static void
+timeout_deadline(void)
+{
+	const uint8_t	 timeout_deadline_data[] = {
+			    WIREDATA_CTAP_CBOR_INFO,
+			    WIREDATA_CTAP_KEEPALIVE,
+			    WIREDATA_CTAP_KEEPALIVE,
+			    WIREDATA_CTAP_KEEPALIVE,
+			    WIREDATA_CTAP_KEEPALIVE,
+			    WIREDATA_CTAP_KEEPALIVE,
+			    WIREDATA_CTAP_CBOR_STATUS
+			 };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the thread's deadline bounds the device's timeout */
+	wiredata = wiredata_setup(timeout_deadline_data,
+	    sizeof(timeout_deadline_data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_set_timeout(dev, 30 * 1000) == FIDO_OK);
+	assert(fido_set_deadline(3 * 1000) == FIDO_OK);
+	interval_ms = 1000;
+	assert(fido_dev_reset(dev) == FIDO_ERR_RX);
+	assert(fido_set_deadline(-1) == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+	interval_ms = 0;
+
+	assert(fido_set_deadline(-2) == FIDO_ERR_INVALID_ARGUMENT);
+}
+
 static void
 timeout_misc(void)
 {
@@ -420,6 +630,2982 @@ timeout_misc(void)
 	fido_dev_free(&dev);
 }
 
+static void
+timeout_adaptive(void)
+{
+	const uint8_t	 timeout_adaptive_data[] = {
+			    WIREDATA_CTAP_CBOR_INFO,
+			    WIREDATA_CTAP_CBOR_INFO,
+			    WIREDATA_CTAP_CBOR_INFO,
+			    WIREDATA_CTAP_CBOR_INFO,
+			    WIREDATA_CTAP_CBOR_INFO,
+			 };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_cbor_info_t *ci;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* four prompt replies, then one that takes over 500ms */
+	wiredata = wiredata_setup(timeout_adaptive_data,
+	    sizeof(timeout_adaptive_data));
+	assert((ci = fido_cbor_info_new()) != NULL);
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_set_adaptive_timeout(dev, 2) == FIDO_OK);
+	assert(fido_dev_set_timeout(dev, 30 * 1000) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_get_cbor_info(dev, ci) == FIDO_OK);
+	assert(fido_dev_get_cbor_info(dev, ci) == FIDO_OK);
+	assert(fido_dev_get_cbor_info(dev, ci) == FIDO_OK);
+	interval_ms = 200;
+	assert(fido_dev_get_cbor_info(dev, ci) == FIDO_ERR_RX);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+	interval_ms = 0;
+
+	/* disabled, the same reply is awaited */
+	wiredata = wiredata_setup(timeout_adaptive_data,
+	    sizeof(timeout_adaptive_data));
+	assert(fido_dev_set_adaptive_timeout(dev, 0) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	interval_ms = 200;
+	assert(fido_dev_get_cbor_info(dev, ci) == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_cbor_info_free(&ci);
+	wiredata_clear(&wiredata);
+	interval_ms = 0;
+}
+
+static void
+retained_info(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	const fido_cbor_info_t *ci;
+	const char	*version;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_cbor_info(dev) == NULL);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert((ci = fido_dev_cbor_info(dev)) != NULL);
+	assert(fido_cbor_info_versions_len(ci) == 3);
+	assert(fido_cbor_info_maxmsgsiz(ci) == dev->maxmsgsize);
+	assert(strcmp(fido_cbor_info_versions_ptr(ci)[1], "FIDO_2_0") == 0);
+	assert(fido_cbor_info_options_len(ci) == 5);
+	assert(fido_cbor_info_options_present(ci) == (FIDO_INFO_OPT_PLAT |
+	    FIDO_INFO_OPT_RK | FIDO_INFO_OPT_PIN | FIDO_INFO_OPT_UP |
+	    FIDO_INFO_OPT_CM_PRE));
+	assert(fido_cbor_info_options_enabled(ci) == (FIDO_INFO_OPT_RK |
+	    FIDO_INFO_OPT_UP | FIDO_INFO_OPT_CM_PRE));
+	assert(fido_cbor_info_algorithm_count(ci) == 2);
+	assert(strcmp(fido_cbor_info_algorithm_type(ci, 1), "public-key") == 0);
+	assert(fido_cbor_info_algorithm_cose(ci, 1) == COSE_EDDSA);
+	assert(fido_dev_has_pin(dev) == false);
+	assert(fido_dev_supports_credman(dev) == true);
+	version = fido_cbor_info_versions_ptr(ci)[1];
+	assert(fido_dev_close(dev) == FIDO_OK);
+	assert(fido_dev_cbor_info(dev) == NULL);
+	wiredata_clear(&wiredata);
+
+	/* dropped when falling back to u2f */
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert((ci = fido_dev_cbor_info(dev)) != NULL);
+	/* common strings are shared, not copied */
+	assert(fido_cbor_info_versions_ptr(ci)[1] == version);
+	fido_dev_force_u2f(dev);
+	assert(fido_dev_cbor_info(dev) == NULL);
+	fido_dev_force_fido2(dev);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+deferred_info(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	fido_init(FIDO_DEFER_GETINFO);
+
+	/* only CTAPHID_INIT is exchanged */
+	wiredata = wiredata_setup(NULL, 0);
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_is_fido2(dev));
+	assert(fido_dev_supports_pin(dev) == false);
+	assert(fido_dev_cbor_info(dev) == NULL);
+	assert(dev->maxmsgsize == 0);
+	wiredata_clear(&wiredata);
+
+	/* the first operation that needs it fetches getinfo */
+	wiredata_ptr = wiredata = malloc(sizeof(cbor_info_data));
+	assert(wiredata != NULL);
+	memcpy(wiredata, cbor_info_data, sizeof(cbor_info_data));
+	wiredata_len = sizeof(cbor_info_data);
+	initialised = 1;
+	assert(fido_dev_get_touch_begin(dev) == FIDO_OK);
+	assert(fido_dev_supports_pin(dev));
+	assert(fido_dev_cbor_info(dev) != NULL);
+	assert(dev->maxmsgsize != 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+
+	fido_init(0);
+}
+
+/* open a device of the given model; 'left' bytes of wiredata remain */
+static fido_dev_t *
+quirk_open(int16_t vendor, int16_t product, size_t left)
+{
+	fido_dev_t	*dev;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	dev->vendor_id = vendor;
+	dev->product_id = product;
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(wiredata_len == left);
+
+	return (dev);
+}
+
+static void
+quirks(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev;
+
+	assert(fido_set_quirk(0x1050, 0x0120, -1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_set_quirk(0x1050, 0x0120, 2) == FIDO_ERR_INVALID_ARGUMENT);
+
+	/* getinfo fails; the device falls back to u2f, and is recorded */
+	wiredata = wiredata_setup(NULL, 0);
+	dev = quirk_open(0x1050, 0x0120, 0);
+	assert(fido_dev_is_fido2(dev) == false);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+
+	/* the next open of the same model does not probe */
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	dev = quirk_open(0x1050, 0x0120, sizeof(cbor_info_data));
+	assert(fido_dev_is_fido2(dev) == false);
+	assert(fido_dev_cbor_info(dev) == NULL);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+
+	/* other models, and devices opened by path alone, still do */
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	dev = quirk_open(0x1050, 0x0407, 0);
+	assert(fido_dev_is_fido2(dev));
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	dev = quirk_open(0, 0, 0);
+	assert(fido_dev_is_fido2(dev));
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+
+	/* a quirk set by the application overrides the recorded one */
+	assert(fido_set_quirk(0x1050, 0x0120, FIDO_QUIRK_NONE) == FIDO_OK);
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	dev = quirk_open(0x1050, 0x0120, 0);
+	assert(fido_dev_is_fido2(dev));
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+
+	assert(fido_set_quirk(0x1050, 0x0407, FIDO_QUIRK_U2F) == FIDO_OK);
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	dev = quirk_open(0x1050, 0x0407, sizeof(cbor_info_data));
+	assert(fido_dev_is_fido2(dev) == false);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+	assert(fido_set_quirk(0x1050, 0x0407, FIDO_QUIRK_NONE) == FIDO_OK);
+}
+
+static void
+touch_any(void)
+{
+	const uint8_t	 data[] = {
+		WIREDATA_CTAP_CBOR_INFO,
+		WIREDATA_CTAP_CBOR_STATUS
+	};
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_t	*devtab[2];
+	fido_dev_io_t	 io;
+	size_t		 idx;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	devtab[0] = NULL;
+	devtab[1] = dev;
+	assert(fido_dev_get_touch_any(NULL, 2, &idx, -1) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_get_touch_any(devtab, 0, &idx, -1) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_get_touch_any(devtab, 1, &idx, -1) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_get_touch_any(devtab, 2, &idx, 1000) == FIDO_OK);
+	assert(idx == 1);
+	/* no reply */
+	assert(fido_dev_get_touch_any(devtab, 2, &idx, 100) ==
+	    FIDO_ERR_TIMEOUT);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+count_keepalive(void *arg, uint8_t status, int ms)
+{
+	int *n = arg;
+
+	assert(status == CTAP_KEEPALIVE_UPNEEDED);
+	assert(ms >= 0);
+	(*n)++;
+}
+
+static void
+async_assert(void)
+{
+	uint8_t		 data[] = {
+		WIREDATA_CTAP_CBOR_INFO,
+		WIREDATA_CTAP_KEEPALIVE,
+		WIREDATA_CTAP_CBOR_ASSERT
+	};
+	const uint8_t	 cdh[32] = { 0 };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_assert_t	*assert = NULL;
+	fido_dev_io_t	 io;
+	int		 keepalives = 0;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_rp(assert, "localhost") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_get_pollfd(dev) == -1);
+	assert(fido_dev_get_pollhandle(dev) == NULL);
+	assert(fido_dev_set_keepalive_handler(dev, count_keepalive,
+	    &keepalives) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_get_pollfd(dev) == -1); /* custom io */
+	assert(fido_dev_get_pollhandle(dev) == NULL);
+	dev->maxmsgsize = FIDO_MAXMSG * 2; /* scratch buffer follows */
+	assert(fido_dev_poll(dev, 0) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_get_assert_complete(dev, assert) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_get_assert_submit(dev, assert, NULL) == FIDO_OK);
+	assert(fido_dev_make_cred_complete(dev, NULL) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_poll(dev, 0) == FIDO_ERR_TIMEOUT); /* keepalive */
+	assert(keepalives == 1);
+	assert(fido_dev_poll(dev, 0) == FIDO_OK);
+	assert(fido_dev_poll(dev, 0) == FIDO_OK);
+	assert(fido_dev_get_assert_complete(dev, assert) == FIDO_OK);
+	assert(fido_assert_count(assert) == 1);
+	assert(fido_assert_authdata_len(assert, 0) != 0);
+	assert(fido_assert_sig_len(assert, 0) != 0);
+	/* replies are read into the device's scratch buffer, then cleared */
+	assert(dev->msgbuf != NULL);
+	assert(dev->msgbuf_busy == false);
+	assert(dev->msgbuf_len == FIDO_MAXMSG * 2);
+	for (size_t i = 0; i < dev->msgbuf_len; i++)
+		assert(dev->msgbuf[i] == 0);
+	assert(fido_dev_poll(dev, 0) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_assert_free(&assert);
+	wiredata_clear(&wiredata);
+}
+
+struct metrics_log {
+	fido_dev_metrics_t	m[4];
+	size_t			n;
+};
+
+static void
+log_metrics(void *arg, const fido_dev_metrics_t *m)
+{
+	struct metrics_log *log = arg;
+
+	assert(log->n < sizeof(log->m) / sizeof(log->m[0]));
+	log->m[log->n++] = *m;
+}
+
+static void
+metrics(void)
+{
+	uint8_t			 data[] = {
+		WIREDATA_CTAP_CBOR_INFO,
+		WIREDATA_CTAP_KEEPALIVE,
+		WIREDATA_CTAP_CBOR_ASSERT
+	};
+	const uint8_t		 cdh[32] = { 0 };
+	uint8_t			*wiredata;
+	fido_dev_t		*dev = NULL;
+	fido_assert_t		*assert = NULL;
+	fido_dev_io_t		 io;
+	struct metrics_log	 log;
+
+	memset(&io, 0, sizeof(io));
+	memset(&log, 0, sizeof(log));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_rp(assert, "localhost") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_set_metrics_handler(dev, log_metrics,
+	    &log) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(log.n == 2);
+	assert(log.m[0].cmd == CTAP_CMD_INIT);
+	assert(log.m[0].cbor_cmd == 0);
+	assert(log.m[0].tx_len == 8); /* nonce */
+	assert(log.m[0].rx_len == 17);
+	assert(log.m[0].tx_frames == 1 && log.m[0].rx_frames == 1);
+	assert(log.m[0].rtt_ms >= 0);
+	assert(log.m[1].cmd == CTAP_CMD_CBOR);
+	assert(log.m[1].cbor_cmd == CTAP_CBOR_GETINFO);
+	assert(log.m[1].tx_len == 1);
+	assert(log.m[1].rx_len > 0);
+	assert(log.m[1].rx_frames > 1);
+	assert(log.m[1].keepalives == 0);
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_OK);
+	assert(log.n == 3);
+	assert(log.m[2].cmd == CTAP_CMD_CBOR);
+	assert(log.m[2].cbor_cmd == CTAP_CBOR_ASSERT);
+	assert(log.m[2].keepalives == 1);
+	assert(log.m[2].rx_len > 0);
+	assert(log.m[2].rx_frames > log.m[2].keepalives);
+	assert(log.m[2].up_ms >= 0 && log.m[2].rtt_ms >= log.m[2].up_ms);
+	assert(fido_dev_set_metrics_handler(dev, NULL, NULL) == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_assert_free(&assert);
+	wiredata_clear(&wiredata);
+}
+
+struct trace_log {
+	fido_trace_t	t[16];
+	size_t		n;
+};
+
+static void
+log_trace(void *arg, const fido_trace_t *t)
+{
+	struct trace_log *log = arg;
+
+	assert(log->n < sizeof(log->t) / sizeof(log->t[0]));
+	log->t[log->n++] = *t;
+}
+
+static void
+trace(void)
+{
+	uint8_t			 data[] = {
+		WIREDATA_CTAP_CBOR_INFO,
+		WIREDATA_CTAP_CBOR_ASSERT
+	};
+	const uint8_t		 cdh[32] = { 0 };
+	uint8_t			*wiredata;
+	fido_dev_t		*dev = NULL;
+	fido_assert_t		*assert = NULL;
+	fido_dev_io_t		 io;
+	struct trace_log	 log;
+	const fido_trace_t	*op;
+
+	memset(&io, 0, sizeof(io));
+	memset(&log, 0, sizeof(log));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_rp(assert, "localhost") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	fido_set_trace_handler(log_trace, &log);
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_OK);
+	fido_set_trace_handler(NULL, NULL);
+	assert(log.n == 6);
+	op = &log.t[0];
+	assert(op->phase == FIDO_TRACE_BEGIN);
+	assert(strcmp(op->op, "fido_dev_get_assert") == 0);
+	assert(op->id != 0 && op->parent == 0);
+	assert(strcmp(op->path, "dummy") == 0);
+	assert(log.t[1].phase == FIDO_TRACE_BEGIN);
+	assert(strcmp(log.t[1].op, "fido_tx") == 0);
+	assert(log.t[1].parent == op->id && log.t[1].id != op->id);
+	assert(log.t[1].cmd == CTAP_CMD_CBOR);
+	assert(log.t[1].cbor_cmd == CTAP_CBOR_ASSERT);
+	assert(log.t[1].len > 0);
+	assert(log.t[2].phase == FIDO_TRACE_END);
+	assert(log.t[2].id == log.t[1].id);
+	assert(log.t[2].status == FIDO_OK);
+	assert(log.t[3].phase == FIDO_TRACE_BEGIN);
+	assert(strcmp(log.t[3].op, "fido_rx") == 0);
+	assert(log.t[3].parent == op->id && log.t[3].len == 0);
+	assert(log.t[4].phase == FIDO_TRACE_END);
+	assert(log.t[4].id == log.t[3].id);
+	assert(log.t[4].status == FIDO_OK && log.t[4].len > 0);
+	assert(log.t[5].phase == FIDO_TRACE_END);
+	assert(log.t[5].id == op->id && log.t[5].status == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_assert_free(&assert);
+	wiredata_clear(&wiredata);
+}
+
+struct alloc_stats {
+	size_t	allocs;
+	size_t	live;
+	size_t	peak;
+};
+
+static struct alloc_stats alloc_stats;
+
+/* each block is prefixed with its size */
+static void *
+counting_malloc(size_t size)
+{
+	size_t *p;
+
+	if ((p = malloc(sizeof(*p) + size)) == NULL)
+		return (NULL);
+
+	*p = size;
+	alloc_stats.allocs++;
+	alloc_stats.live += size;
+	if (alloc_stats.live > alloc_stats.peak)
+		alloc_stats.peak = alloc_stats.live;
+
+	return (p + 1);
+}
+
+static void *
+counting_calloc(size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (nmemb != 0 && size > SIZE_MAX / nmemb)
+		return (NULL);
+	if ((p = counting_malloc(nmemb * size)) != NULL)
+		memset(p, 0, nmemb * size);
+
+	return (p);
+}
+
+static void
+counting_free(void *ptr)
+{
+	size_t *p = ptr;
+
+	if (p == NULL)
+		return;
+
+	assert(alloc_stats.live >= p[-1]);
+	alloc_stats.live -= p[-1];
+	free(p - 1);
+}
+
+static void *
+counting_realloc(void *ptr, size_t size)
+{
+	void *p;
+
+	if ((p = counting_malloc(size)) == NULL)
+		return (NULL);
+	if (ptr != NULL) {
+		size_t old = ((size_t *)ptr)[-1];
+		memcpy(p, ptr, old < size ? old : size);
+		counting_free(ptr);
+	}
+
+	return (p);
+}
+
+static void
+allocator(void)
+{
+	uint8_t			 data[] = {
+		WIREDATA_CTAP_CBOR_INFO,
+		WIREDATA_CTAP_CBOR_ASSERT
+	};
+	const uint8_t		 cdh[32] = { 0 };
+	uint8_t			*wiredata;
+	fido_dev_t		*dev = NULL;
+	fido_assert_t		*assert = NULL;
+	fido_dev_io_t		 io;
+	fido_allocator_t	 a;
+	int			 r;
+
+	memset(&io, 0, sizeof(io));
+	memset(&a, 0, sizeof(a));
+	memset(&alloc_stats, 0, sizeof(alloc_stats));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	a.malloc = counting_malloc;
+	a.calloc = counting_calloc;
+	a.realloc = counting_realloc;
+	assert(fido_set_allocator(&a) == FIDO_ERR_INVALID_ARGUMENT);
+	a.free = counting_free; /* freezero is optional */
+	if ((r = fido_set_allocator(&a)) == FIDO_ERR_INTERNAL)
+		return; /* libcbor < 0.10 lacks cbor_set_allocs() */
+	assert(r == FIDO_OK);
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_rp(assert, "localhost") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_OK);
+	assert(fido_assert_count(assert) == 1);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_assert_free(&assert);
+
+	assert(alloc_stats.allocs > 0);
+	assert(alloc_stats.peak > 0);
+	assert(alloc_stats.live == 0);
+
+	assert(fido_set_allocator(NULL) == FIDO_OK);
+	wiredata_clear(&wiredata);
+}
+
+struct capture_log {
+	fido_capture_t	c[16];
+	unsigned char	hdr[16][8];
+	size_t		n;
+};
+
+static void
+log_capture(void *arg, const fido_capture_t *c)
+{
+	struct capture_log *log = arg;
+
+	assert(log->n < sizeof(log->c) / sizeof(log->c[0]));
+	assert(c->len >= sizeof(log->hdr[0]));
+	memcpy(log->hdr[log->n], c->ptr, sizeof(log->hdr[0]));
+	log->c[log->n] = *c;
+	log->c[log->n++].ptr = NULL;
+}
+
+static void
+capture(void)
+{
+	const uint8_t		 data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t			*wiredata;
+	fido_dev_t		*dev = NULL;
+	fido_dev_io_t		 io;
+	struct capture_log	 log;
+
+	memset(&io, 0, sizeof(io));
+	memset(&log, 0, sizeof(log));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	fido_set_capture_handler(log_capture, &log);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	fido_set_capture_handler(NULL, NULL);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	/* init request and reply, getinfo request and reply */
+	assert(log.n > 4);
+	assert(log.c[0].dir == FIDO_CAPTURE_TX);
+	assert(log.c[0].cid == 0xffffffff);
+	assert(log.c[0].len == REPORT_LEN - 1);
+	assert(log.hdr[0][4] == (CTAP_FRAME_INIT | CTAP_CMD_INIT));
+	assert(log.c[1].dir == FIDO_CAPTURE_RX);
+	assert(log.c[1].cid == 0xffffffff);
+	assert(log.c[1].len == REPORT_LEN - 1);
+	assert(log.hdr[1][4] == (CTAP_FRAME_INIT | CTAP_CMD_INIT));
+	assert(log.c[2].dir == FIDO_CAPTURE_TX);
+	assert(log.c[2].cid != 0xffffffff);
+	assert(log.hdr[2][4] == (CTAP_FRAME_INIT | CTAP_CMD_CBOR));
+	assert(log.hdr[2][7] == CTAP_CBOR_GETINFO);
+	for (size_t i = 3; i < log.n; i++) {
+		assert(log.c[i].dir == FIDO_CAPTURE_RX);
+		assert(log.c[i].ts_us >= log.c[i - 1].ts_us);
+	}
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+largeblob_array(void)
+{
+	uint8_t		 data[] = {
+		WIREDATA_CTAP_CBOR_INFO,
+		WIREDATA_CTAP_CBOR_LARGEBLOB_GET_ARRAY
+	};
+	const uint8_t	 key[32] = { 0 };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	unsigned char	*ptr = NULL;
+	size_t		 len = 0;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	/* a single, short chunk read straight into the array */
+	assert(fido_dev_largeblob_get_array(dev, &ptr, &len) == FIDO_OK);
+	assert(ptr != NULL);
+	assert(len == 0x1e0 - 16);
+	assert(ptr[0] == 0x81);
+	assert(dev->msgbuf_busy == false);
+	free(ptr);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_largeblob_get(dev, key, sizeof(key), &ptr,
+	    &len) == FIDO_ERR_NOTFOUND);
+	assert(ptr == NULL && len == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static size_t
+ctap_payload(const uint8_t *frames, size_t len, uint8_t *out)
+{
+	size_t n, bcnt;
+
+	assert(len >= REPORT_LEN - 1);
+	bcnt = (size_t)frames[5] << 8 | frames[6];
+	n = bcnt < REPORT_LEN - 8 ? bcnt : REPORT_LEN - 8;
+	memcpy(out, frames + 7, n);
+	for (size_t i = REPORT_LEN - 1; n < bcnt; i += REPORT_LEN - 1) {
+		size_t m = bcnt - n < REPORT_LEN - 6 ? bcnt - n : REPORT_LEN - 6;
+		assert(i + 5 + m <= len);
+		memcpy(out + n, frames + i + 5, m);
+		n += m;
+	}
+
+	return bcnt;
+}
+
+static void
+largeblob_stream(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 get_array[] = {
+		WIREDATA_CTAP_CBOR_LARGEBLOB_GET_ARRAY
+	};
+	const uint8_t	 key[32] = { 0 };
+	const size_t	 chunklen = 40;
+	uint8_t		 payload[sizeof(get_array)];
+	uint8_t		 data[sizeof(info) + 16 * (REPORT_LEN - 1)];
+	uint8_t		*wiredata, *array, *p;
+	size_t		 array_len, n;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	unsigned char	*ptr = NULL;
+	size_t		 len = 0;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* reply 0x00, {0x01: bytes(0x01e0)} */
+	ctap_payload(get_array, sizeof(get_array), payload);
+	assert(payload[0] == 0x00 && payload[3] == 0x59);
+	array = payload + 6;
+	array_len = 0x01e0;
+
+	/* serve the array in small chunks, ending in an empty one */
+	memset(data, 0, sizeof(data));
+	memcpy(data, info, sizeof(info));
+	p = data + sizeof(info);
+	for (size_t off = 0; off <= array_len; off += chunklen) {
+		n = array_len - off < chunklen ? array_len - off : chunklen;
+		assert(p + REPORT_LEN - 1 <= data + sizeof(data));
+		memcpy(p, info, sizeof(uint32_t));
+		p[4] = 0x90; /* CTAP_FRAME_INIT | CTAP_CMD_CBOR */
+		p[5] = 0;
+		p[6] = (uint8_t)(n + 5);
+		p[7] = 0x00;
+		p[8] = 0xa1;
+		p[9] = 0x01;
+		p[10] = 0x58;
+		p[11] = (uint8_t)n;
+		memcpy(p + 12, array + off, n);
+		p += REPORT_LEN - 1;
+	}
+
+	for (int corrupt = 0; corrupt < 2; corrupt++) {
+		if (corrupt)
+			data[sizeof(info) + 12 * (REPORT_LEN - 1) - 1] ^= 1;
+		wiredata = wiredata_setup(data, (size_t)(p - data));
+		assert((dev = fido_dev_new()) != NULL);
+		assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+		assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+		dev->maxmsgsize = 64 + chunklen;
+		assert(fido_dev_largeblob_get(dev, key, sizeof(key), &ptr,
+		    &len) == FIDO_ERR_NOTFOUND);
+		assert(ptr == NULL && len == 0);
+		assert(wiredata_len == 0); /* every chunk was read */
+		assert(fido_dev_close(dev) == FIDO_OK);
+		fido_dev_free(&dev);
+		wiredata_clear(&wiredata);
+	}
+}
+
+struct largeblob_progress {
+	size_t n;
+	size_t done;
+	size_t total;
+};
+
+static void
+largeblob_progress_cb(void *arg, size_t done, size_t total)
+{
+	struct largeblob_progress *lp = arg;
+
+	assert(done >= lp->done);
+	assert(total == 0 || total == done);
+	lp->n++;
+	lp->done = done;
+	lp->total = total;
+}
+
+static void
+largeblob_retry(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 get_array[] = {
+		WIREDATA_CTAP_CBOR_LARGEBLOB_GET_ARRAY
+	};
+	const size_t	 chunklen = 40;
+	struct largeblob_progress lp;
+	uint8_t		 payload[sizeof(get_array)];
+	uint8_t		 data[sizeof(info) + 16 * (REPORT_LEN - 1)];
+	uint8_t		*wiredata, *array, *p;
+	size_t		 array_len, n, nchunk = 0;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	unsigned char	*ptr = NULL;
+	size_t		 len = 0;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	ctap_payload(get_array, sizeof(get_array), payload);
+	array = payload + 6;
+	array_len = 0x01e0;
+
+	/* serve the array in small chunks; the fourth reply is garbled */
+	memset(data, 0, sizeof(data));
+	memcpy(data, info, sizeof(info));
+	p = data + sizeof(info);
+	for (size_t off = 0; off <= array_len; off += chunklen) {
+		n = array_len - off < chunklen ? array_len - off : chunklen;
+		if (nchunk++ == 3) {
+			memcpy(p, info, sizeof(uint32_t));
+			p[4] = 0x90; /* CTAP_FRAME_INIT | CTAP_CMD_CBOR */
+			p[5] = 0;
+			p[6] = 2;
+			p[7] = 0x00;
+			p[8] = 0xff;
+			p += REPORT_LEN - 1;
+		}
+		assert(p + REPORT_LEN - 1 <= data + sizeof(data));
+		memcpy(p, info, sizeof(uint32_t));
+		p[4] = 0x90;
+		p[5] = 0;
+		p[6] = (uint8_t)(n + 5);
+		p[7] = 0x00;
+		p[8] = 0xa1;
+		p[9] = 0x01;
+		p[10] = 0x58;
+		p[11] = (uint8_t)n;
+		memcpy(p + 12, array + off, n);
+		p += REPORT_LEN - 1;
+	}
+
+	for (int retry = 0; retry < 2; retry++) {
+		memset(&lp, 0, sizeof(lp));
+		wiredata = wiredata_setup(data, (size_t)(p - data));
+		assert((dev = fido_dev_new()) != NULL);
+		assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+		assert(fido_dev_set_largeblob_retry(dev, -1) ==
+		    FIDO_ERR_INVALID_ARGUMENT);
+		assert(fido_dev_set_largeblob_retry(dev, 9) ==
+		    FIDO_ERR_INVALID_ARGUMENT);
+		assert(fido_dev_set_largeblob_retry(dev, retry) == FIDO_OK);
+		assert(fido_dev_set_largeblob_progress(dev,
+		    largeblob_progress_cb, &lp) == FIDO_OK);
+		assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+		dev->maxmsgsize = 64 + chunklen;
+		if (retry == 0) {
+			assert(fido_dev_largeblob_get_array(dev, &ptr,
+			    &len) != FIDO_OK);
+			assert(ptr == NULL && len == 0);
+			assert(lp.n == 3 && lp.done == 3 * chunklen);
+			assert(lp.total == 0);
+		} else {
+			/* resumed at the garbled chunk's offset */
+			assert(fido_dev_largeblob_get_array(dev, &ptr,
+			    &len) == FIDO_OK);
+			assert(len == array_len - 16);
+			assert(memcmp(ptr, array, len) == 0);
+			assert(lp.n == nchunk);
+			assert(lp.done == array_len && lp.total == array_len);
+			assert(wiredata_len == 0);
+			free(ptr);
+			ptr = NULL;
+		}
+		assert(fido_dev_close(dev) == FIDO_OK);
+		fido_dev_free(&dev);
+		wiredata_clear(&wiredata);
+	}
+}
+
+static void
+largeblob_batch(void)
+{
+	uint8_t		 data[] = {
+		WIREDATA_CTAP_CBOR_INFO,
+		WIREDATA_CTAP_CBOR_LARGEBLOB_GET_ARRAY,
+		WIREDATA_CTAP_CBOR_STATUS,
+		WIREDATA_CTAP_CBOR_STATUS
+	};
+	const uint8_t	 key[2][32] = { { 0 }, { 1 } };
+	uint8_t		 blob[64];
+	fido_largeblob_item_t v[2];
+	unsigned char	*ptr[2];
+	size_t		 len[2];
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+	memset(v, 0, sizeof(v));
+
+	for (size_t i = 0; i < sizeof(blob); i++)
+		blob[i] = (uint8_t)(i * 151 + 7);
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	for (size_t i = 0; i < 2; i++) {
+		v[i].key_ptr = key[i];
+		v[i].key_len = sizeof(key[i]);
+		v[i].blob_ptr = blob;
+		v[i].blob_len = sizeof(blob);
+		v[i].r = -1;
+	}
+
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_largeblob_set_batch(dev, v, 0,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_largeblob_remove_batch(dev, NULL, 1,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	v[1].key_len--;
+	assert(fido_dev_largeblob_set_batch(dev, v, 2,
+	    NULL) == FIDO_ERR_INVALID_ARGUMENT);
+	v[1].key_len++;
+	assert(v[0].r == -1 && v[1].r == -1);
+
+	/* neither key has an entry; the array is read once */
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_largeblob_get_batch(dev, v, 2, NULL,
+	    len) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_largeblob_get_batch(dev, v, 2, ptr,
+	    len) == FIDO_ERR_NOTFOUND);
+	assert(v[0].r == FIDO_ERR_NOTFOUND && v[1].r == FIDO_ERR_NOTFOUND);
+	assert(ptr[0] == NULL && ptr[1] == NULL && len[0] == 0 && len[1] == 0);
+	assert(wiredata_len == 2 * (REPORT_LEN - 1)); /* statuses left */
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+
+	/* nothing to remove; the array is read but not written */
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_largeblob_remove_batch(dev, v, 2,
+	    NULL) == FIDO_ERR_NOTFOUND);
+	assert(v[0].r == FIDO_ERR_NOTFOUND && v[1].r == FIDO_ERR_NOTFOUND);
+	assert(wiredata_len == 2 * (REPORT_LEN - 1)); /* statuses left */
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+
+	/* two additions, one read and one write */
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_largeblob_set_batch(dev, v, 2, NULL) == FIDO_OK);
+	assert(v[0].r == FIDO_OK && v[1].r == FIDO_OK);
+	assert(wiredata_len == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+largeblob_cache(void)
+{
+	uint8_t		 data[] = {
+		WIREDATA_CTAP_CBOR_INFO,
+		WIREDATA_CTAP_CBOR_LARGEBLOB_GET_ARRAY,
+		WIREDATA_CTAP_CBOR_STATUS,
+		WIREDATA_CTAP_CBOR_STATUS
+	};
+	const uint8_t	 key[32] = { 2 };
+	uint8_t		 blob[64], *ptr, *vptr[2];
+	size_t		 len, vlen[2];
+	fido_largeblob_item_t v[2];
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+	memset(v, 0, sizeof(v));
+
+	for (size_t i = 0; i < sizeof(blob); i++)
+		blob[i] = (uint8_t)(i * 151 + 7);
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_set_largeblob_cache(dev, true) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_largeblob_set(dev, key, sizeof(key), blob,
+	    sizeof(blob), NULL) == FIDO_OK);
+	assert(wiredata_len == 0);
+
+	/* the array just written is read back without a transaction */
+	assert(fido_dev_largeblob_get(dev, key, sizeof(key), &ptr,
+	    &len) == FIDO_OK);
+	assert(len == sizeof(blob) && memcmp(ptr, blob, len) == 0);
+	free(ptr);
+	assert(fido_dev_largeblob_get_array(dev, &ptr, &len) == FIDO_OK);
+	free(ptr);
+
+	/* a key given twice is resolved twice */
+	for (size_t i = 0; i < 2; i++) {
+		v[i].key_ptr = key;
+		v[i].key_len = sizeof(key);
+	}
+	assert(fido_dev_largeblob_get_batch(dev, v, 2, vptr, vlen) == FIDO_OK);
+	for (size_t i = 0; i < 2; i++) {
+		assert(v[i].r == FIDO_OK);
+		assert(vlen[i] == sizeof(blob));
+		assert(memcmp(vptr[i], blob, sizeof(blob)) == 0);
+		free(vptr[i]);
+	}
+
+	/* disabling the cache discards it */
+	assert(fido_dev_set_largeblob_cache(dev, false) == FIDO_OK);
+	assert(fido_dev_largeblob_get_array(dev, &ptr, &len) != FIDO_OK);
+	assert(ptr == NULL && len == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+/* append a largeBlob array element sealed with 'key' to 'p' */
+static uint8_t *
+largeblob_seal(uint8_t *p, const uint8_t key[32], uint8_t fill)
+{
+	const uint8_t	 nonce[12] = { fill };
+	uint8_t		 aad[12] = { 'b', 'l', 'o', 'b', 16 };
+	uint8_t		 pt[16];
+	EVP_CIPHER_CTX	*ctx;
+	int		 n;
+
+	memset(pt, fill, sizeof(pt));
+	*p++ = 0xa3; /* map(3) */
+	*p++ = 0x01; /* ciphertext */
+	*p++ = 0x58;
+	*p++ = sizeof(pt) + 16;
+	assert((ctx = EVP_CIPHER_CTX_new()) != NULL);
+	assert(EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key,
+	    nonce) == 1);
+	assert(EVP_EncryptUpdate(ctx, NULL, &n, aad, sizeof(aad)) == 1);
+	assert(EVP_EncryptUpdate(ctx, p, &n, pt, sizeof(pt)) == 1);
+	assert(EVP_EncryptFinal_ex(ctx, p + n, &n) == 1);
+	p += sizeof(pt);
+	assert(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, p) == 1);
+	p += 16;
+	EVP_CIPHER_CTX_free(ctx);
+	*p++ = 0x02; /* nonce */
+	*p++ = 0x4c;
+	memcpy(p, nonce, sizeof(nonce));
+	p += sizeof(nonce);
+	*p++ = 0x03; /* origSize */
+	*p++ = 0x10;
+
+	return p;
+}
+
+static void
+largeblob_match(void)
+{
+	const uint8_t	 key[3][32] = { { 1 }, { 2 }, { 3 } };
+	uint8_t		 array[4 * 64], *p = array;
+	fido_largeblob_item_t v[2];
+	size_t		 match[4];
+
+	memset(v, 0, sizeof(v));
+	for (size_t i = 0; i < 2; i++) {
+		v[i].key_ptr = key[i];
+		v[i].key_len = sizeof(key[i]);
+	}
+
+	/* key 1, an unknown key, key 0, key 1 again */
+	*p++ = 0x84;
+	p = largeblob_seal(p, key[1], 0x11);
+	p = largeblob_seal(p, key[2], 0x22);
+	p = largeblob_seal(p, key[0], 0x33);
+	p = largeblob_seal(p, key[1], 0x44);
+	assert(p <= array + sizeof(array));
+
+	assert(fido_largeblob_array_match(array, (size_t)(p - array), v, 2,
+	    match, 3) == FIDO_ERR_INVALID_ARGUMENT);
+	v[1].key_len--;
+	assert(fido_largeblob_array_match(array, (size_t)(p - array), v, 2,
+	    match, 4) == FIDO_ERR_INVALID_ARGUMENT);
+	v[1].key_len++;
+	assert(fido_largeblob_array_match(array, (size_t)(p - array), v, 2,
+	    match, 4) == FIDO_OK);
+	assert(match[0] == 1 && match[1] == SIZE_MAX);
+	assert(match[2] == 0 && match[3] == 1);
+	assert(fido_largeblob_array_match(array, (size_t)(p - array), NULL, 0,
+	    match, 4) == FIDO_OK);
+	for (size_t i = 0; i < 4; i++)
+		assert(match[i] == SIZE_MAX);
+}
+
+static void
+token_cache(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 meta[] = { WIREDATA_CTAP_CBOR_CREDMAN_META };
+	const uint8_t	 status[] = { WIREDATA_CTAP_CBOR_STATUS };
+	uint8_t		 data[sizeof(info) + 2 * sizeof(authkey) +
+			     2 * sizeof(pintoken) + 3 * sizeof(meta) +
+			     sizeof(status)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_credman_metadata_t *md = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* token, cached use, rejected use, new token */
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, meta, sizeof(meta));
+	p += sizeof(meta);
+	memcpy(p, meta, sizeof(meta));
+	p += sizeof(meta);
+	memcpy(p, status, sizeof(status));
+	p[7] = FIDO_ERR_PIN_AUTH_INVALID;
+	p += sizeof(status);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, meta, sizeof(meta));
+	p += sizeof(meta);
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((md = fido_credman_metadata_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_set_token_cache(dev, true) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_credman_get_dev_metadata(dev, md, "1234") == FIDO_OK);
+	assert(dev->token != NULL && dev->ecdh != NULL);
+	assert(fido_credman_get_dev_metadata(dev, md, "1234") == FIDO_OK);
+	assert(fido_credman_get_dev_metadata(dev, md,
+	    "1234") == FIDO_ERR_PIN_AUTH_INVALID);
+	assert(dev->token == NULL && dev->ecdh == NULL);
+	assert(fido_credman_get_dev_metadata(dev, md, "1234") == FIDO_OK);
+	assert(fido_credman_rk_remaining(md) == 25);
+	assert(wiredata_len == 0);
+	assert(dev->token != NULL);
+	assert(fido_dev_set_token_cache(dev, false) == FIDO_OK);
+	assert(dev->token == NULL && dev->ecdh == NULL);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_credman_metadata_free(&md);
+	wiredata_clear(&wiredata);
+}
+
+static void
+prewarm(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 reply[] = { WIREDATA_CTAP_CBOR_ASSERT };
+	const uint8_t	 cdh[32] = { 0 };
+	uint8_t		 data[sizeof(info) + sizeof(authkey) +
+			     sizeof(pintoken) + sizeof(reply)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_assert_t	*assert = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, reply, sizeof(reply));
+	p += sizeof(reply);
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_rp(assert, "localhost") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_prewarm(dev, "localhost", "1234",
+	    FIDO_PREWARM_TOKEN) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_prewarm(dev, NULL, NULL, 0x80) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_prewarm(dev, NULL, "1234",
+	    FIDO_PREWARM_TOKEN) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_prewarm(dev, "localhost", "1234",
+	    FIDO_PREWARM_ECDH | FIDO_PREWARM_TOKEN) == FIDO_OK);
+	assert(dev->ecdh != NULL && dev->token != NULL);
+	/* the assertion is a single request */
+	assert(fido_dev_get_assert(dev, assert, "1234") == FIDO_OK);
+	assert(wiredata_len == 0);
+	assert(dev->token == NULL && dev->ecdh != NULL);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_assert_free(&assert);
+	wiredata_clear(&wiredata);
+}
+
+static void
+ecdh_cache(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 meta[] = { WIREDATA_CTAP_CBOR_CREDMAN_META };
+	uint8_t		 data[sizeof(info) + sizeof(authkey) +
+			     2 * sizeof(pintoken) + 2 * sizeof(meta)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_credman_metadata_t *md = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* one key agreement, two tokens */
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	for (int i = 0; i < 2; i++) {
+		memcpy(p, pintoken, sizeof(pintoken));
+		p += sizeof(pintoken);
+		memcpy(p, meta, sizeof(meta));
+		p += sizeof(meta);
+	}
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((md = fido_credman_metadata_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_credman_get_dev_metadata(dev, md, "1234") == FIDO_OK);
+	assert(dev->ecdh != NULL && dev->token == NULL);
+	assert(fido_credman_get_dev_metadata(dev, md, "1234") == FIDO_OK);
+	assert(wiredata_len == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	assert(dev->ecdh == NULL);
+	fido_dev_free(&dev);
+	fido_credman_metadata_free(&md);
+	wiredata_clear(&wiredata);
+}
+
+static void
+ecdh_pool(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 meta[] = { WIREDATA_CTAP_CBOR_CREDMAN_META };
+	uint8_t		 data[sizeof(info) + sizeof(authkey) +
+			     sizeof(pintoken) + sizeof(meta)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_credman_metadata_t *md = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, meta, sizeof(meta));
+	p += sizeof(meta);
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	assert(fido_ecdh_pool_fill(17) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_ecdh_pool_fill(2) == FIDO_OK);
+	assert(fido_ecdh_pool_fill(2) == FIDO_OK);
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((md = fido_credman_metadata_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_credman_get_dev_metadata(dev, md, "1234") == FIDO_OK);
+	assert(wiredata_len == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_credman_metadata_free(&md);
+	wiredata_clear(&wiredata);
+
+	assert(fido_ecdh_pool_fill(1) == FIDO_OK);
+	assert(fido_ecdh_pool_fill(0) == FIDO_OK);
+}
+
+static void
+credman_rk_all(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 rplist[] = { WIREDATA_CTAP_CBOR_CREDMAN_RPLIST };
+	const uint8_t	 rklist[] = { WIREDATA_CTAP_CBOR_CREDMAN_RKLIST };
+	uint8_t		 data[sizeof(info) + sizeof(authkey) +
+			     sizeof(pintoken) + sizeof(rplist) +
+			     3 * sizeof(rklist)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_credman_rp_t *rp = NULL;
+	fido_credman_rk_t *rk = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* one token, three relying parties with five credentials each */
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, rplist, sizeof(rplist));
+	p += sizeof(rplist);
+	for (int i = 0; i < 3; i++) {
+		memcpy(p, rklist, sizeof(rklist));
+		p += sizeof(rklist);
+	}
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((rp = fido_credman_rp_new()) != NULL);
+	assert((rk = fido_credman_rk_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_credman_get_dev_rk_all(dev, rp, rk, "1234") == FIDO_OK);
+	assert(wiredata_len == 0);
+	assert(dev->token == NULL);
+	assert(fido_credman_rp_count(rp) == 3);
+	assert(fido_credman_rk_count(rk) == 15);
+	assert(strcmp(fido_cred_rp_id(fido_credman_rk(rk, 0)),
+	    "yubico.com") == 0);
+	assert(strcmp(fido_cred_rp_id(fido_credman_rk(rk, 5)),
+	    "yubikey.org") == 0);
+	assert(strcmp(fido_cred_rp_id(fido_credman_rk(rk, 14)),
+	    "webauthn.dev") == 0);
+	assert(fido_cred_id_len(fido_credman_rk(rk, 14)) == 16);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_credman_rp_free(&rp);
+	fido_credman_rk_free(&rk);
+	wiredata_clear(&wiredata);
+}
+
+static void
+credman_batch(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 status[] = { WIREDATA_CTAP_CBOR_STATUS };
+	const uint8_t	 cred_id[16] = { 0x01 };
+	uint8_t		 data[sizeof(info) + sizeof(authkey) +
+			     sizeof(pintoken) + 3 * sizeof(status)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_credman_rk_item_t v[4];
+
+	memset(&io, 0, sizeof(io));
+	memset(&v, 0, sizeof(v));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* one token; the second credential is missing, the third invalid */
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	for (int i = 0; i < 3; i++) {
+		memcpy(p, status, sizeof(status));
+		if (i == 1)
+			p[7] = FIDO_ERR_NO_CREDENTIALS;
+		p += sizeof(status);
+	}
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	for (size_t i = 0; i < nitems(v); i++) {
+		v[i].cred_ptr = i == 2 ? NULL : cred_id;
+		v[i].cred_len = sizeof(cred_id);
+		v[i].r = -1;
+	}
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_credman_del_dev_rk_batch(dev, NULL, 1,
+	    "1234") == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_credman_del_dev_rk_batch(dev, v, nitems(v),
+	    "1234") == FIDO_ERR_NO_CREDENTIALS);
+	assert(wiredata_len == 0);
+	assert(dev->token == NULL);
+	assert(v[0].r == FIDO_OK);
+	assert(v[1].r == FIDO_ERR_NO_CREDENTIALS);
+	assert(v[2].r == FIDO_ERR_INVALID_ARGUMENT);
+	assert(v[3].r == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+credman_iter(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 rplist[] = { WIREDATA_CTAP_CBOR_CREDMAN_RPLIST };
+	const uint8_t	 rklist[] = { WIREDATA_CTAP_CBOR_CREDMAN_RKLIST };
+	uint8_t		 data[sizeof(info) + sizeof(authkey) +
+			     2 * sizeof(pintoken) + sizeof(rplist) +
+			     4 * sizeof(rklist)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_credman_iter_t *it = NULL;
+	const fido_cred_t *cred;
+	size_t		 n;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* every relying party, then a single one */
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, rplist, sizeof(rplist));
+	p += sizeof(rplist);
+	for (int i = 0; i < 3; i++) {
+		memcpy(p, rklist, sizeof(rklist));
+		p += sizeof(rklist);
+	}
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, rklist, sizeof(rklist));
+	p += sizeof(rklist);
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((it = fido_credman_iter_new()) != NULL);
+	assert(fido_credman_iter_next(it, &cred) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(cred == NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_credman_iter_begin(dev, it, NULL, "1234") == FIDO_OK);
+	for (n = 0; fido_credman_iter_next(it, &cred) == FIDO_OK &&
+	    cred != NULL; n++)
+		if (n == 14)
+			assert(strcmp(fido_cred_rp_id(cred),
+			    "webauthn.dev") == 0);
+	assert(n == 15);
+	fido_credman_iter_end(it);
+	assert(dev->token == NULL);
+	/* stop at the second credential */
+	assert(fido_credman_iter_begin(dev, it, "yubico.com",
+	    "1234") == FIDO_OK);
+	assert(fido_credman_iter_next(it, &cred) == FIDO_OK && cred != NULL);
+	assert(fido_credman_iter_next(it, &cred) == FIDO_OK && cred != NULL);
+	assert(strcmp(fido_cred_rp_id(cred), "yubico.com") == 0);
+	assert(fido_cred_id_len(cred) == 16);
+	fido_credman_iter_free(&it);
+	assert(dev->token == NULL && dev->token_cache == false);
+	assert(wiredata_len != 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+credman_session(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 rplist[] = { WIREDATA_CTAP_CBOR_CREDMAN_RPLIST };
+	const uint8_t	 rklist[] = { WIREDATA_CTAP_CBOR_CREDMAN_RKLIST };
+	const uint8_t	 unknown[32] = { 0 };
+	uint8_t		 data[sizeof(info) + sizeof(authkey) +
+			     sizeof(pintoken) + sizeof(rplist) +
+			     sizeof(rklist)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_credman_session_t *s = NULL;
+	const fido_credman_rp_t *rp;
+	const fido_credman_rk_t *rk, *again;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* one token, three relying parties; one of them is looked up */
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, rplist, sizeof(rplist));
+	p += sizeof(rplist);
+	memcpy(p, rklist, sizeof(rklist));
+	p += sizeof(rklist);
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((s = fido_credman_session_new()) != NULL);
+	assert(fido_credman_session_rk(s, unknown, sizeof(unknown),
+	    &rk) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(rk == NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_credman_session_begin(dev, s, "1234") == FIDO_OK);
+	rp = fido_credman_session_rp(s);
+	assert(fido_credman_rp_count(rp) == 3);
+	for (size_t i = 1; i < fido_credman_rp_count(rp); i++)
+		assert(memcmp(fido_credman_rp_id_hash_ptr(rp, i - 1),
+		    fido_credman_rp_id_hash_ptr(rp, i), 32) < 0);
+	assert(fido_credman_session_rk(s, fido_credman_rp_id_hash_ptr(rp, 1),
+	    fido_credman_rp_id_hash_len(rp, 1), &rk) == FIDO_OK);
+	assert(wiredata_len == 0);
+	assert(fido_credman_rk_count(rk) == 5);
+	assert(strcmp(fido_cred_rp_id(fido_credman_rk(rk, 0)),
+	    fido_credman_rp_id(rp, 1)) == 0);
+	/* from memory */
+	assert(fido_credman_session_rk(s, fido_credman_rp_id_hash_ptr(rp, 1),
+	    fido_credman_rp_id_hash_len(rp, 1), &again) == FIDO_OK);
+	assert(again == rk);
+	assert(fido_credman_session_rk(s, unknown, sizeof(unknown),
+	    &rk) == FIDO_ERR_NO_CREDENTIALS);
+	assert(rk == NULL);
+	assert(dev->token != NULL);
+	fido_credman_session_end(s);
+	assert(dev->token == NULL);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_credman_session_free(&s);
+	wiredata_clear(&wiredata);
+}
+
+static void
+keystore_rk(void)
+{
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 authkey[] = { WIREDATA_CTAP_CBOR_AUTHKEY };
+	const uint8_t	 pintoken[] = { WIREDATA_CTAP_CBOR_PINTOKEN };
+	const uint8_t	 rklist[] = { WIREDATA_CTAP_CBOR_CREDMAN_RKLIST };
+	const char	*path = "regress_keystore_rk";
+	uint8_t		 data[sizeof(info) + sizeof(authkey) +
+			     sizeof(pintoken) + sizeof(rklist)];
+	uint8_t		*wiredata, *p = data;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_credman_rk_t *rk = NULL;
+	fido_keystore_t	*ks = NULL;
+	fido_pk_t	*pk = NULL;
+	const fido_cred_t *cred;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	memcpy(p, info, sizeof(info));
+	p += sizeof(info);
+	memcpy(p, authkey, sizeof(authkey));
+	p += sizeof(authkey);
+	memcpy(p, pintoken, sizeof(pintoken));
+	p += sizeof(pintoken);
+	memcpy(p, rklist, sizeof(rklist));
+	p += sizeof(rklist);
+	assert(p == data + sizeof(data));
+
+	/* the reply frames are captured on different channels */
+	for (size_t i = 0; i < sizeof(data); i += REPORT_LEN - 1)
+		memcpy(&data[i], &data[0], sizeof(uint32_t));
+
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert((rk = fido_credman_rk_new()) != NULL);
+	assert((ks = fido_keystore_new()) != NULL);
+	assert((pk = fido_pk_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_credman_get_dev_rk(dev, "yubico.com", rk,
+	    "1234") == FIDO_OK);
+	assert(fido_credman_rk_count(rk) == 5);
+	/* all of the keys, as decoded, in one go */
+	assert(fido_keystore_add_rk(ks, rk) == FIDO_OK);
+	assert(fido_keystore_write(ks, path) == FIDO_OK);
+	assert(fido_keystore_open(ks, path) == FIDO_OK);
+	assert(fido_keystore_count(ks) == 5);
+	for (size_t i = 0; i < fido_credman_rk_count(rk); i++) {
+		cred = fido_credman_rk(rk, i);
+		assert(fido_keystore_get_pk(ks, fido_cred_id_ptr(cred),
+		    fido_cred_id_len(cred), pk) == FIDO_OK);
+		assert(fido_pk_type(pk) == fido_cred_type(cred));
+	}
+	/* a credential already in the store */
+	assert(fido_keystore_add_cred(ks, fido_credman_rk(rk, 0)) == FIDO_OK);
+	assert(fido_keystore_write(ks, path) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(remove(path) == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	fido_credman_rk_free(&rk);
+	fido_keystore_free(&ks);
+	fido_pk_free(&pk);
+	wiredata_clear(&wiredata);
+}
+
+static void
+open_many(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_info_t	*devlist;
+	fido_dev_t	*dev[3];
+	fido_dev_io_t	 io;
+	int		 status[3];
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	assert((devlist = fido_dev_info_new(1)) != NULL);
+	assert(fido_dev_info_set(devlist, 0, "dummy", "manufacturer",
+	    "product", &io, NULL) == FIDO_OK);
+	assert(strcmp(fido_dev_info_serial_string(devlist), "") == 0);
+	assert(fido_dev_open_many(NULL, 0, NULL) == FIDO_OK);
+	assert(fido_dev_open_many(NULL, 1, status) == FIDO_ERR_INVALID_ARGUMENT);
+
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert((dev[0] = fido_dev_new_with_info(devlist)) != NULL);
+	assert(fido_dev_set_io_functions(dev[0], &io) == FIDO_OK);
+	dev[1] = NULL;
+	assert((dev[2] = fido_dev_new()) != NULL); /* no path */
+	assert(fido_dev_open_many(dev, 3, status) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(status[0] == FIDO_OK);
+	assert(status[1] == FIDO_ERR_INVALID_ARGUMENT);
+	assert(status[2] == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_is_fido2(dev[0]));
+	assert(fido_dev_cbor_info(dev[0]) != NULL);
+	assert(fido_dev_close(dev[0]) == FIDO_OK);
+	assert(fido_dev_close(dev[2]) == FIDO_ERR_INVALID_ARGUMENT);
+	wiredata_clear(&wiredata);
+
+	/* no getinfo reply; fall back to u2f */
+	wiredata = wiredata_setup(NULL, 0);
+	assert(fido_dev_open_many(dev, 1, status) == FIDO_OK);
+	assert(status[0] == FIDO_OK);
+	assert(fido_dev_is_fido2(dev[0]) == false);
+	assert(fido_dev_cbor_info(dev[0]) == NULL);
+	assert(fido_dev_close(dev[0]) == FIDO_OK);
+	wiredata_clear(&wiredata);
+
+	fido_dev_free(&dev[0]);
+	fido_dev_free(&dev[2]);
+	fido_dev_info_free(&devlist, 1);
+}
+
+static void
+cancel_many(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev[3];
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	assert(fido_dev_cancel_many(NULL, 0) == FIDO_OK);
+	assert(fido_dev_cancel_many(NULL, 1) == FIDO_ERR_INVALID_ARGUMENT);
+
+	for (size_t i = 0; i < 2; i++) {
+		wiredata = wiredata_setup(cbor_info_data,
+		    sizeof(cbor_info_data));
+		assert((dev[i] = fido_dev_new()) != NULL);
+		assert(fido_dev_set_io_functions(dev[i], &io) == FIDO_OK);
+		assert(fido_dev_open(dev[i], "dummy") == FIDO_OK);
+		wiredata_clear(&wiredata);
+	}
+	assert((dev[2] = fido_dev_new()) != NULL); /* not open */
+
+	/* no replies are read */
+	assert(fido_dev_cancel_many(dev, 3) == FIDO_OK);
+	for (size_t i = 0; i < 3; i++) {
+		assert(fido_dev_close(dev[i]) == FIDO_ERR_INVALID_ARGUMENT);
+		fido_dev_free(&dev[i]);
+	}
+}
+
+static int
+pool_step(fido_dev_t *dev, size_t idx, void *arg)
+{
+	size_t *n = arg;
+
+	assert(dev != NULL && fido_dev_is_fido2(dev));
+	assert(idx == 0);
+	(*n)++;
+
+	return (*n > 2 ? FIDO_ERR_NOTFOUND : FIDO_OK);
+}
+
+static void
+pool_progress(void *arg, size_t idx, size_t step, int status)
+{
+	size_t *n = arg;
+
+	assert(idx == 0);
+	assert(step == *n % 2);
+	assert(status == (*n >= 2 ? FIDO_ERR_NOTFOUND : FIDO_OK));
+	(*n)++;
+}
+
+static void
+pool(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_info_t	*devlist;
+	fido_dev_pool_t	*pool;
+	fido_dev_io_t	 io;
+	size_t		 nsteps = 0, nprogress = 0;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* the second entry has no path */
+	assert((devlist = fido_dev_info_new(2)) != NULL);
+	assert(fido_dev_info_set(devlist, 0, "dummy", "manufacturer",
+	    "product", &io, NULL) == FIDO_OK);
+
+	fido_dev_pool_free(NULL);
+	assert((pool = fido_dev_pool_new()) != NULL);
+	assert(fido_dev_pool_len(pool) == 0);
+	assert(fido_dev_pool_dev(pool, 0) == NULL);
+	assert(fido_dev_pool_status(pool, 0) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_pool_open(pool, devlist, 0) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_pool_add(pool, NULL, NULL) == FIDO_ERR_INVALID_ARGUMENT);
+
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert(fido_dev_pool_open(pool, devlist, 2) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	wiredata_clear(&wiredata);
+	assert(fido_dev_pool_open(pool, devlist, 2) ==
+	    FIDO_ERR_INVALID_ARGUMENT); /* already open */
+	assert(fido_dev_pool_len(pool) == 2);
+	assert(fido_dev_pool_status(pool, 0) == FIDO_OK);
+	assert(fido_dev_pool_status(pool, 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_pool_dev(pool, 0)->token_cache);
+
+	/* two steps; the failed device is skipped */
+	assert(fido_dev_pool_add(pool, pool_step, &nsteps) == FIDO_OK);
+	assert(fido_dev_pool_add(pool, pool_step, &nsteps) == FIDO_OK);
+	assert(fido_dev_pool_set_progress(pool, pool_progress,
+	    &nprogress) == FIDO_OK);
+	assert(fido_dev_pool_work(pool) == FIDO_OK);
+	assert(nsteps == 2 && nprogress == 2);
+	assert(fido_dev_pool_work(pool) == FIDO_OK); /* nothing left */
+	assert(nsteps == 2);
+
+	/* the third call fails, and the fourth is not made */
+	assert(fido_dev_pool_rewind(pool) == FIDO_OK);
+	assert(fido_dev_pool_add(pool, pool_step, &nsteps) == FIDO_OK);
+	assert(fido_dev_pool_add(pool, pool_step, &nsteps) == FIDO_OK);
+	assert(fido_dev_pool_work(pool) == FIDO_ERR_NOTFOUND);
+	assert(nsteps == 3 && nprogress == 3);
+	assert(fido_dev_pool_status(pool, 0) == FIDO_ERR_NOTFOUND);
+	assert(fido_dev_pool_status(pool, 1) == FIDO_ERR_INVALID_ARGUMENT);
+
+	/* rewinding restores the status of open devices only */
+	assert(fido_dev_pool_rewind(pool) == FIDO_OK);
+	assert(fido_dev_pool_status(pool, 0) == FIDO_OK);
+	assert(fido_dev_pool_status(pool, 1) == FIDO_ERR_INVALID_ARGUMENT);
+
+	fido_dev_pool_free(&pool);
+	assert(pool == NULL);
+	fido_dev_info_free(&devlist, 2);
+}
+
+static void
+channel_cache(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		 error_frame[REPORT_LEN - 1];
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_cbor_info_t *ci;
+	uint32_t	 cid;
+	uint64_t	 maxmsgsize;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	fido_init(FIDO_CHANNEL_CACHE);
+
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_is_fido2(dev));
+	cid = dev->cid;
+	maxmsgsize = dev->maxmsgsize;
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+
+	/* reopen without talking to the device */
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_is_fido2(dev));
+	assert(dev->cid == cid);
+	assert(dev->maxmsgsize == maxmsgsize);
+
+	/* the device no longer knows the channel */
+	memset(error_frame, 0, sizeof(error_frame));
+	memcpy(error_frame, &cid, sizeof(cid));
+	error_frame[4] = CTAP_FRAME_INIT | CTAP_CMD_ERROR;
+	error_frame[6] = 1;
+	error_frame[7] = FIDO_ERR_INVALID_CHANNEL;
+	wiredata_ptr = error_frame;
+	wiredata_len = sizeof(error_frame);
+	initialised = 1;
+	assert((ci = fido_cbor_info_new()) != NULL);
+	assert(fido_dev_get_cbor_info(dev, ci) == FIDO_ERR_RX);
+	fido_cbor_info_free(&ci);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_ptr = NULL;
+	wiredata_len = 0;
+	initialised = 0;
+	assert(fido_dev_open(dev, "dummy") == FIDO_ERR_RX);
+
+	/* a fresh channel is established and cached again */
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+
+	/* fido_init() discards the cache */
+	fido_init(0);
+	assert(fido_dev_open(dev, "dummy") == FIDO_ERR_RX);
+	fido_dev_free(&dev);
+}
+
+static void
+info_cache(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev[2];
+	fido_dev_io_t	 io;
+	const fido_cbor_info_t *ci[2];
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	fido_init(FIDO_INFO_CACHE);
+
+	/* the second reply is copied from the first */
+	for (size_t i = 0; i < 2; i++) {
+		wiredata = wiredata_setup(cbor_info_data,
+		    sizeof(cbor_info_data));
+		assert((dev[i] = fido_dev_new()) != NULL);
+		assert(fido_dev_set_io_functions(dev[i], &io) == FIDO_OK);
+		assert(fido_dev_open(dev[i], "dummy") == FIDO_OK);
+		assert((ci[i] = fido_dev_cbor_info(dev[i])) != NULL);
+		wiredata_clear(&wiredata);
+	}
+	assert(fido_cbor_info_versions_len(ci[1]) == 3);
+	assert(fido_cbor_info_versions_ptr(ci[0]) !=
+	    fido_cbor_info_versions_ptr(ci[1]));
+	assert(strcmp(fido_cbor_info_versions_ptr(ci[1])[1], "FIDO_2_0") == 0);
+	assert(fido_cbor_info_options_len(ci[1]) == 5);
+	assert(fido_cbor_info_options_enabled(ci[1]) ==
+	    fido_cbor_info_options_enabled(ci[0]));
+	assert(strcmp(fido_cbor_info_algorithm_type(ci[1], 1),
+	    "public-key") == 0);
+	assert(fido_cbor_info_maxmsgsiz(ci[1]) ==
+	    fido_cbor_info_maxmsgsiz(ci[0]));
+	assert(fido_cbor_info_rk_remaining(ci[1]) ==
+	    fido_cbor_info_rk_remaining(ci[0]));
+	assert(fido_dev_supports_credman(dev[1]) == true);
+	for (size_t i = 0; i < 2; i++) {
+		assert(fido_dev_close(dev[i]) == FIDO_OK);
+		fido_dev_free(&dev[i]);
+	}
+
+	/* a cached channel gets the reply without a getinfo exchange */
+	fido_init(FIDO_INFO_CACHE | FIDO_CHANNEL_CACHE);
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert((dev[0] = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev[0], &io) == FIDO_OK);
+	assert(fido_dev_open(dev[0], "dummy") == FIDO_OK);
+	assert(fido_dev_close(dev[0]) == FIDO_OK);
+	wiredata_clear(&wiredata);
+	assert(fido_dev_open(dev[0], "dummy") == FIDO_OK);
+	assert((ci[0] = fido_dev_cbor_info(dev[0])) != NULL);
+	assert(fido_cbor_info_options_len(ci[0]) == 5);
+	assert(fido_dev_close(dev[0]) == FIDO_OK);
+	fido_dev_free(&dev[0]);
+
+	fido_init(0);
+}
+
+static size_t profile_lines;
+
+static void
+log_profile(const char *line)
+{
+	if (strncmp(line, "profile: dummy: ", 16) == 0)
+		profile_lines++;
+}
+
+static void
+profile(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	size_t		 n;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	fido_set_log_handler(log_profile);
+	fido_init(FIDO_PROFILE);
+
+	/* written when the device is closed */
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(profile_lines == 0);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	assert((n = profile_lines) > 0);
+	wiredata_clear(&wiredata);
+
+	/* not recorded once disabled */
+	fido_init(0);
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	assert(profile_lines == n);
+	wiredata_clear(&wiredata);
+	fido_dev_free(&dev);
+}
+
+struct log_count {
+	const fido_dev_t *dev;
+	size_t		  n[FIDO_LOG_XXD + 1];
+};
+
+static void
+log_context(void *arg, int level, const fido_dev_t *dev, const char *op,
+    const char *msg)
+{
+	struct log_count *c = arg;
+
+	assert(level >= FIDO_LOG_ERROR && level <= FIDO_LOG_XXD);
+	assert(dev == c->dev);
+	assert(op != NULL);
+	assert(strchr(msg, '\n') == NULL);
+	c->n[level]++;
+}
+
+static void
+log_level(void)
+{
+	const uint8_t	 cbor_info_data[] = { WIREDATA_CTAP_CBOR_INFO };
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	struct log_count c;
+
+	memset(&io, 0, sizeof(io));
+	memset(&c, 0, sizeof(c));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	assert(fido_set_log_level(-1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_set_log_level(FIDO_LOG_XXD + 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_set_log_level(FIDO_LOG_NONE) == FIDO_OK);
+	fido_set_log_context_handler(log_context, &c);
+
+	/* nothing is formatted at the default level */
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	c.dev = dev;
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+	assert(c.n[FIDO_LOG_DEBUG] == 0 && c.n[FIDO_LOG_XXD] == 0);
+
+	/* the device's level overrides it */
+	assert(fido_dev_set_log_level(dev, -2) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_set_log_level(dev, FIDO_LOG_DEBUG) == FIDO_OK);
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+	assert(c.n[FIDO_LOG_DEBUG] > 0 && c.n[FIDO_LOG_XXD] == 0);
+
+	assert(fido_dev_set_log_level(dev, FIDO_LOG_XXD) == FIDO_OK);
+	wiredata = wiredata_setup(cbor_info_data, sizeof(cbor_info_data));
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	wiredata_clear(&wiredata);
+	assert(c.n[FIDO_LOG_XXD] > 0);
+
+	fido_set_log_context_handler(NULL, NULL);
+	assert(fido_set_log_level(FIDO_LOG_XXD) == FIDO_OK);
+	fido_dev_free(&dev);
+}
+
+static void
+request_frames(void)
+{
+	const uint8_t	 data[] = {
+		WIREDATA_CTAP_CBOR_INFO
+	};
+	const uint8_t	 make_cred[] = {
+		0x01, 0xa6, 0x01, 0x58, 0x20, 0x01, 0x02, 0x03,
+		0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+		0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+		0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b,
+		0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x02, 0xa2, 0x62,
+		0x69, 0x64, 0x6b, 0x65, 0x78, 0x61, 0x6d, 0x70,
+		0x6c, 0x65, 0x2e, 0x6f, 0x72, 0x67, 0x64, 0x6e,
+		0x61, 0x6d, 0x65, 0x67, 0x45, 0x78, 0x61, 0x6d,
+		0x70, 0x6c, 0x65, 0x03, 0xa3, 0x62, 0x69, 0x64,
+		0x44, 0x01, 0x02, 0x03, 0x04, 0x64, 0x6e, 0x61,
+		0x6d, 0x65, 0x64, 0x6a, 0x61, 0x6e, 0x65, 0x6b,
+		0x64, 0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x4e,
+		0x61, 0x6d, 0x65, 0x68, 0x4a, 0x61, 0x6e, 0x65,
+		0x20, 0x44, 0x6f, 0x65, 0x04, 0x81, 0xa2, 0x63,
+		0x61, 0x6c, 0x67, 0x26, 0x64, 0x74, 0x79, 0x70,
+		0x65, 0x6a, 0x70, 0x75, 0x62, 0x6c, 0x69, 0x63,
+		0x2d, 0x6b, 0x65, 0x79, 0x05, 0x81, 0xa2, 0x62,
+		0x69, 0x64, 0x44, 0x05, 0x06, 0x07, 0x08, 0x64,
+		0x74, 0x79, 0x70, 0x65, 0x6a, 0x70, 0x75, 0x62,
+		0x6c, 0x69, 0x63, 0x2d, 0x6b, 0x65, 0x79, 0x07,
+		0xa1, 0x62, 0x72, 0x6b, 0xf5,
+	};
+	const uint8_t	 get_assert[] = {
+		0x02, 0xa4, 0x01, 0x6b, 0x65, 0x78, 0x61, 0x6d,
+		0x70, 0x6c, 0x65, 0x2e, 0x6f, 0x72, 0x67, 0x02,
+		0x58, 0x20, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+		0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+		0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+		0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e,
+		0x1f, 0x20, 0x03, 0x82, 0xa2, 0x62, 0x69, 0x64,
+		0x44, 0x05, 0x06, 0x07, 0x08, 0x64, 0x74, 0x79,
+		0x70, 0x65, 0x6a, 0x70, 0x75, 0x62, 0x6c, 0x69,
+		0x63, 0x2d, 0x6b, 0x65, 0x79, 0xa2, 0x62, 0x69,
+		0x64, 0x44, 0x09, 0x0a, 0x0b, 0x0c, 0x64, 0x74,
+		0x79, 0x70, 0x65, 0x6a, 0x70, 0x75, 0x62, 0x6c,
+		0x69, 0x63, 0x2d, 0x6b, 0x65, 0x79, 0x05, 0xa1,
+		0x62, 0x75, 0x70, 0xf4,
+	};
+	const unsigned char excl[] = { 0x05, 0x06, 0x07, 0x08 };
+	const unsigned char allow[] = { 0x09, 0x0a, 0x0b, 0x0c };
+	const unsigned char user_id[] = { 0x01, 0x02, 0x03, 0x04 };
+	unsigned char	 cdh[32];
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_cred_t	*cred = NULL;
+	fido_assert_t	*assert = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = capture_write;
+
+	for (size_t i = 0; i < sizeof(cdh); i++)
+		cdh[i] = (unsigned char)(i + 1);
+
+	/* canonical encoding, byte for byte */
+	wiredata = wiredata_setup(data, sizeof(data));
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert((cred = fido_cred_new()) != NULL);
+	assert(fido_cred_set_type(cred, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(cred, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(cred, "example.org", "Example") == FIDO_OK);
+	assert(fido_cred_set_user(cred, user_id, sizeof(user_id), "jane",
+	    "Jane Doe", NULL) == FIDO_OK);
+	assert(fido_cred_exclude(cred, excl, sizeof(excl)) == FIDO_OK);
+	assert(fido_cred_set_rk(cred, FIDO_OPT_TRUE) == FIDO_OK);
+	capture_len = 0;
+	/* no reply */
+	assert(fido_dev_make_cred(dev, cred, NULL) == FIDO_ERR_RX);
+	assert(capture_len == sizeof(make_cred));
+	assert(memcmp(capture_buf, make_cred, sizeof(make_cred)) == 0);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_rp(assert, "example.org") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	assert(fido_assert_allow_cred(assert, excl, sizeof(excl)) == FIDO_OK);
+	assert(fido_assert_allow_cred(assert, allow,
+	    sizeof(allow)) == FIDO_OK);
+	assert(fido_assert_set_up(assert, FIDO_OPT_FALSE) == FIDO_OK);
+	capture_len = 0;
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_ERR_RX);
+	assert(capture_len == sizeof(get_assert));
+	assert(memcmp(capture_buf, get_assert, sizeof(get_assert)) == 0);
+	/* again, from the cached allow list */
+	capture_len = 0;
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_ERR_RX);
+	assert(capture_len == sizeof(get_assert));
+	assert(memcmp(capture_buf, get_assert, sizeof(get_assert)) == 0);
+	/* the cache follows the list */
+	assert(fido_assert_empty_allow_list(assert) == FIDO_OK);
+	assert(fido_assert_allow_cred(assert, excl, sizeof(excl)) == FIDO_OK);
+	capture_len = 0;
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_ERR_RX);
+	assert(capture_len == sizeof(get_assert) - 25);
+	assert(capture_buf[1] == 0xa4 && capture_buf[51] == 0x81);
+	assert(fido_assert_allow_cred(assert, allow,
+	    sizeof(allow)) == FIDO_OK);
+	capture_len = 0;
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_ERR_RX);
+	assert(capture_len == sizeof(get_assert));
+	assert(memcmp(capture_buf, get_assert, sizeof(get_assert)) == 0);
+	/* a new cdh is patched into the kept frame */
+	for (size_t i = 0; i < sizeof(cdh); i++)
+		cdh[i] = (unsigned char)(0xa0 + i);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	capture_len = 0;
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_ERR_RX);
+	assert(capture_len == sizeof(get_assert));
+	assert(memcmp(capture_buf, get_assert, 18) == 0);
+	assert(memcmp(capture_buf + 18, cdh, sizeof(cdh)) == 0);
+	assert(memcmp(capture_buf + 50, get_assert + 50,
+	    sizeof(get_assert) - 50) == 0);
+	/* other changes are not */
+	assert(fido_assert_set_up(assert, FIDO_OPT_TRUE) == FIDO_OK);
+	capture_len = 0;
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_ERR_RX);
+	assert(capture_len == sizeof(get_assert));
+	assert(memcmp(capture_buf + 18, cdh, sizeof(cdh)) == 0);
+	assert(capture_buf[sizeof(get_assert) - 1] == 0xf5);
+	assert(fido_assert_set_rp(assert, "example.com") == FIDO_OK);
+	capture_len = 0;
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_ERR_RX);
+	assert(capture_len == sizeof(get_assert));
+	assert(memcmp(capture_buf + 4, "example.com", 11) == 0);
+	fido_assert_free(&assert);
+	fido_cred_free(&cred);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+assert_reply(void)
+{
+	const uint8_t	 info[] = {
+		WIREDATA_CTAP_CBOR_INFO
+	};
+	const uint8_t	 reply1[] = {
+		0x00, 0xa6, 0x01, 0xa3, 0x61, 0x78, 0x01, 0x62,
+		0x69, 0x64, 0x42, 0x01, 0x02, 0x64, 0x74, 0x79,
+		0x70, 0x65, 0x6a, 0x70, 0x75, 0x62, 0x6c, 0x69,
+		0x63, 0x2d, 0x6b, 0x65, 0x79, 0x02, 0x58, 0x25,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x01, 0x00, 0x00, 0x00, 0x03, 0x03, 0x48, 0x30,
+		0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x04,
+		0xa4, 0x62, 0x69, 0x64, 0x41, 0xaa, 0x63, 0x66,
+		0x6f, 0x6f, 0x82, 0x01, 0xa1, 0x02, 0x03, 0x64,
+		0x6e, 0x61, 0x6d, 0x65, 0x64, 0x6a, 0x61, 0x6e,
+		0x65, 0x6b, 0x64, 0x69, 0x73, 0x70, 0x6c, 0x61,
+		0x79, 0x4e, 0x61, 0x6d, 0x65, 0x64, 0x4a, 0x61,
+		0x6e, 0x65, 0x05, 0x02, 0x09, 0xa1, 0x66, 0x6e,
+		0x65, 0x73, 0x74, 0x65, 0x64, 0x82, 0x82, 0x01,
+		0x02, 0x41, 0x00,
+	};
+	const uint8_t	 reply2[] = {
+		0x00, 0xa3, 0x01, 0xa2, 0x62, 0x69, 0x64, 0x42,
+		0x03, 0x04, 0x64, 0x74, 0x79, 0x70, 0x65, 0x6a,
+		0x70, 0x75, 0x62, 0x6c, 0x69, 0x63, 0x2d, 0x6b,
+		0x65, 0x79, 0x02, 0x58, 0x25, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x01, 0x00, 0x00,
+		0x00, 0x03, 0x03, 0x48, 0x40, 0x41, 0x42, 0x43,
+		0x44, 0x45, 0x46, 0x47,
+	};
+	const uint8_t	 reply_dup[] = {
+		0x00, 0xa2, 0x03, 0x41, 0x01, 0x03, 0x41, 0x02,
+	};
+	const uint8_t	 reply_unsorted[] = {
+		0x00, 0xa1, 0x01, 0xa2, 0x64, 0x74, 0x79, 0x70,
+		0x65, 0x6a, 0x70, 0x75, 0x62, 0x6c, 0x69, 0x63,
+		0x2d, 0x6b, 0x65, 0x79, 0x62, 0x69, 0x64, 0x41,
+		0x01,
+	};
+	const unsigned char	 cdh[32] = { 0 };
+	unsigned char	 junk[96];
+	uint8_t		 data[sizeof(info) + 16 * (REPORT_LEN - 1)];
+	uint8_t		*wiredata;
+	size_t		 len;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_assert_t	*assert = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+	memset(junk, 0x5a, sizeof(junk));
+
+	/* numberOfCredentials, unknown keys, then getNextAssertion */
+	memcpy(data, info, sizeof(info));
+	len = sizeof(info);
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, reply1, sizeof(reply1));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, reply2, sizeof(reply2));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, reply_dup, sizeof(reply_dup));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, reply_unsorted, sizeof(reply_unsorted));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, reply1, sizeof(reply1));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, reply2, sizeof(reply2));
+	wiredata = wiredata_setup(data, len);
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_rp(assert, "example.org") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_OK);
+	assert(fido_assert_count(assert) == 2);
+	assert(fido_assert_id_len(assert, 0) == 2);
+	assert(memcmp(fido_assert_id_ptr(assert, 0), &reply1[11], 2) == 0);
+	assert(fido_assert_id_len(assert, 1) == 2);
+	assert(memcmp(fido_assert_id_ptr(assert, 1), &reply2[8], 2) == 0);
+	assert(fido_assert_user_id_len(assert, 0) == 1);
+	assert(strcmp(fido_assert_user_name(assert, 0), "jane") == 0);
+	assert(strcmp(fido_assert_user_display_name(assert, 0), "Jane") == 0);
+	assert(fido_assert_user_name(assert, 1) == NULL);
+	assert(fido_assert_authdata_len(assert, 0) == 2 + 37);
+	assert(memcmp(fido_assert_authdata_ptr(assert, 0), &reply1[30],
+	    2 + 37) == 0);
+	assert(fido_assert_sigcount(assert, 1) == 3);
+	assert(fido_assert_sig_len(assert, 0) == 8);
+	assert(memcmp(fido_assert_sig_ptr(assert, 1), &reply2[sizeof(reply2) -
+	    8], 8) == 0);
+	/* statements point into the replies; setters replace the pointer */
+	assert(fido_assert_set_sig(assert, 0, junk, sizeof(junk)) == FIDO_OK);
+	assert(fido_assert_sig_len(assert, 0) == sizeof(junk));
+	assert(memcmp(fido_assert_sig_ptr(assert, 0), junk, sizeof(junk)) == 0);
+	assert(fido_assert_set_sig(assert, 1, junk, 4) == FIDO_OK);
+	assert(fido_assert_sig_len(assert, 1) == 4);
+	assert(memcmp(fido_assert_id_ptr(assert, 1), &reply2[8], 2) == 0);
+	assert(memcmp(fido_assert_authdata_ptr(assert, 0), &reply1[30],
+	    2 + 37) == 0);
+	/* duplicate key */
+	assert(fido_dev_get_assert(dev, assert, NULL) ==
+	    FIDO_ERR_RX_INVALID_CBOR);
+	/* non-canonical key order */
+	assert(fido_dev_get_assert(dev, assert, NULL) ==
+	    FIDO_ERR_RX_INVALID_CBOR);
+	/* the first two again, with ids and users decoded on access */
+	assert(fido_assert_set_lazy(assert, true) == FIDO_OK);
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_OK);
+	assert(fido_assert_count(assert) == 2);
+	assert(fido_assert_sigcount(assert, 1) == 3);
+	assert(fido_assert_sig_len(assert, 0) == 8);
+	assert(strcmp(fido_assert_user_name(assert, 0), "jane") == 0);
+	assert(fido_assert_user_id_len(assert, 0) == 1);
+	assert(fido_assert_user_name(assert, 1) == NULL);
+	assert(fido_assert_id_len(assert, 1) == 2);
+	assert(memcmp(fido_assert_id_ptr(assert, 1), &reply2[8], 2) == 0);
+	assert(fido_assert_id_ptr(assert, 1) == fido_assert_id_ptr(assert, 1));
+	assert(fido_assert_id_ptr(assert, 2) == NULL);
+	fido_assert_free(&assert);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+assert_batched(void)
+{
+	const uint8_t	 info[] = {
+		WIREDATA_CTAP_CBOR_INFO
+	};
+	const uint8_t	 no_cred[] = { FIDO_ERR_NO_CREDENTIALS };
+	const uint8_t	 reply[] = {
+		0x00, 0xa3, 0x01, 0xa2, 0x62, 0x69, 0x64, 0x50,
+		0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09,
+		0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09,
+		0x64, 0x74, 0x79, 0x70, 0x65, 0x6a, 0x70, 0x75,
+		0x62, 0x6c, 0x69, 0x63, 0x2d, 0x6b, 0x65, 0x79,
+		0x02, 0x58, 0x25, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49,
+		0x49, 0x49, 0x49, 0x01, 0x00, 0x00, 0x00, 0x03,
+		0x03, 0x48, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45,
+		0x46, 0x47,
+	};
+	const unsigned char	 cdh[32] = { 0 };
+	unsigned char	 id[16];
+	uint8_t		 data[sizeof(info) + 8 * (REPORT_LEN - 1)];
+	uint8_t		*wiredata;
+	size_t		 len;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_assert_t	*assert = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = capture_write;
+
+	/* maxCredCountInList=8: two silent probes, then the real request */
+	memcpy(data, info, sizeof(info));
+	len = sizeof(info);
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, no_cred, sizeof(no_cred));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, reply, sizeof(reply));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_CBOR, reply, sizeof(reply));
+	wiredata = wiredata_setup(data, len);
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_rp(assert, "example.org") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	for (int i = 0; i < 20; i++) {
+		memset(id, i, sizeof(id));
+		assert(fido_assert_allow_cred(assert, id,
+		    sizeof(id)) == FIDO_OK);
+	}
+	capture_cnt = 0;
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_OK);
+	assert(capture_cnt == 3);
+	assert(wiredata_len == 0);
+	/* the last request carries the second batch and no options */
+	assert(capture_buf[0] == CTAP_CBOR_ASSERT && capture_buf[1] == 0xa3);
+	assert(capture_buf[51] == 0x88 && capture_buf[57] == 8);
+	assert(fido_assert_count(assert) == 1);
+	assert(fido_assert_id_len(assert, 0) == sizeof(id));
+	assert(memcmp(fido_assert_id_ptr(assert, 0), &reply[8],
+	    sizeof(id)) == 0);
+	fido_assert_free(&assert);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+u2f_assert_lookup(void)
+{
+	const uint8_t	 info[] = {
+		WIREDATA_CTAP_CBOR_INFO
+	};
+	const uint8_t	 sw_wrong_data[] = { 0x6a, 0x80 };
+	const uint8_t	 sw_not_satisfied[] = { 0x69, 0x85 };
+	const uint8_t	 auth[] = {
+		0x01, 0x00, 0x00, 0x00, 0x07, 0x30, 0x06, 0x02,
+		0x01, 0x01, 0x02, 0x01, 0x01, 0x90, 0x00,
+	};
+	const unsigned char	 cdh[32] = { 0 };
+	unsigned char	 id[16];
+	uint8_t		 data[sizeof(info) + 8 * (REPORT_LEN - 1)];
+	uint8_t		*wiredata;
+	size_t		 len;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+	fido_assert_t	*assert = NULL;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	/* FIDO_U2F_FIRST: stop at the first key handle the token knows */
+	memcpy(data, info, sizeof(info));
+	len = sizeof(info);
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_MSG, sw_wrong_data, sizeof(sw_wrong_data));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_MSG, sw_not_satisfied, sizeof(sw_not_satisfied));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_MSG, auth, sizeof(auth));
+	/* FIDO_U2F_NO_PROBE: sign directly, skipping foreign handles */
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_MSG, sw_wrong_data, sizeof(sw_wrong_data));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_MSG, auth, sizeof(auth));
+	wiredata = wiredata_setup(data, len);
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	fido_dev_force_u2f(dev);
+	assert((assert = fido_assert_new()) != NULL);
+	assert(fido_assert_set_u2f_flags(assert, 0x80) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_assert_set_u2f_flags(assert, FIDO_U2F_FIRST) == FIDO_OK);
+	assert(fido_assert_set_rp(assert, "example.org") == FIDO_OK);
+	assert(fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) == FIDO_OK);
+	for (int i = 0; i < 3; i++) {
+		memset(id, i, sizeof(id));
+		assert(fido_assert_allow_cred(assert, id,
+		    sizeof(id)) == FIDO_OK);
+	}
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_OK);
+	assert(fido_assert_count(assert) == 1);
+	memset(id, 1, sizeof(id));
+	assert(fido_assert_id_len(assert, 0) == sizeof(id));
+	assert(memcmp(fido_assert_id_ptr(assert, 0), id, sizeof(id)) == 0);
+	assert(fido_assert_sigcount(assert, 0) == 7);
+	assert(fido_assert_set_u2f_flags(assert, FIDO_U2F_FIRST |
+	    FIDO_U2F_NO_PROBE) == FIDO_OK);
+	assert(fido_dev_get_assert(dev, assert, NULL) == FIDO_OK);
+	assert(fido_assert_count(assert) == 1);
+	assert(memcmp(fido_assert_id_ptr(assert, 0), id, sizeof(id)) == 0);
+	assert(wiredata_len == 0);
+	fido_assert_free(&assert);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+monitor_count_cb(void *arg, int event, const fido_dev_info_t *di)
+{
+	size_t *n = arg;
+
+	assert(fido_dev_info_path(di) != NULL);
+	if (event == FIDO_DEV_MONITOR_ADD)
+		(*n)++;
+	else {
+		assert(event == FIDO_DEV_MONITOR_REMOVE);
+		assert(*n > 0);
+		(*n)--;
+	}
+}
+
+static void
+monitor(void)
+{
+	fido_dev_monitor_t	*m;
+	size_t			 n = 0;
+
+	fido_dev_monitor_free(NULL);
+	assert((m = fido_dev_monitor_new()) != NULL);
+	assert(fido_dev_monitor_len(m) == 0);
+	assert(fido_dev_monitor_ptr(m, 0) == NULL);
+	assert(fido_dev_monitor_fd(m) == -1);
+	assert(fido_dev_monitor_poll(m, 0) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_monitor_set_cb(m, monitor_count_cb, &n) == FIDO_OK);
+	assert(fido_dev_monitor_start(m) == FIDO_OK);
+	assert(fido_dev_monitor_start(m) == FIDO_ERR_INVALID_ARGUMENT);
+	/* the callback tracks the list, whatever the host has plugged in */
+	assert(fido_dev_monitor_len(m) == n);
+	assert(fido_dev_monitor_poll(m, 0) == FIDO_OK);
+	assert(fido_dev_monitor_len(m) == n);
+	assert(fido_dev_monitor_ptr(m, n) == NULL);
+	for (size_t i = 0; i < n; i++)
+		assert(fido_dev_monitor_ptr(m, i) != NULL);
+	fido_dev_monitor_free(&m);
+	assert(m == NULL);
+}
+
+static void
+ping(void)
+{
+	const uint8_t	 info[] = {
+		WIREDATA_CTAP_CBOR_INFO
+	};
+	uint8_t		 msg[100], bad[100];
+	uint8_t		 data[sizeof(info) + 8 * (REPORT_LEN - 1)];
+	uint8_t		 big[FIDO_MAXMSG + 1];
+	uint8_t		*wiredata;
+	size_t		 len;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	for (size_t i = 0; i < sizeof(msg); i++)
+		msg[i] = (uint8_t)i;
+	memcpy(bad, msg, sizeof(bad));
+	bad[sizeof(bad) - 1] ^= 0xff;
+	memset(big, 0, sizeof(big));
+
+	/* an echo spanning two frames, an empty one, then a corrupt one */
+	memcpy(data, info, sizeof(info));
+	len = sizeof(info);
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_PING, msg, sizeof(msg));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_PING, msg, 0);
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_PING, bad, sizeof(bad));
+	wiredata = wiredata_setup(data, len);
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_ping(dev, NULL, 1) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_ping(dev, big, sizeof(big)) ==
+	    FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_ping(dev, msg, sizeof(msg)) == FIDO_OK);
+	assert(fido_dev_ping(dev, NULL, 0) == FIDO_OK);
+	assert(fido_dev_ping(dev, msg, sizeof(msg)) == FIDO_ERR_RX);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+open_channel(void)
+{
+	const uint8_t	 init[] = { WIREDATA_CTAP_INIT };
+	const uint8_t	 info[] = { WIREDATA_CTAP_CBOR_INFO };
+	const uint8_t	 cid[] = { 0x00, 0x22, 0x00, 0x03 };
+	const uint8_t	 msg[] = "device", chmsg[] = "channel";
+	uint8_t		 data[2 * sizeof(info) + sizeof(init) +
+			    2 * (REPORT_LEN - 1)];
+	uint8_t		*wiredata;
+	size_t		 len;
+	fido_dev_t	*dev = NULL, *ch = NULL, *other = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = init_write;
+
+	/*
+	 * getInfo for the device; CTAPHID_INIT and getInfo for the channel,
+	 * which gets cid 0x00220003; then the channel's ping reply, read by
+	 * the device and queued, ahead of the device's
+	 */
+	memcpy(data, info, sizeof(info));
+	len = sizeof(info);
+	memcpy(&data[len], init, sizeof(init));
+	memcpy(&data[len + 15], cid, sizeof(cid));
+	len += sizeof(init);
+	memcpy(&data[len], info, sizeof(info));
+	for (size_t off = 0; off < sizeof(info); off += REPORT_LEN - 1)
+		memcpy(&data[len + off], cid, sizeof(cid));
+	len += sizeof(info);
+	len += wiredata_frame(&data[len], sizeof(data) - len, cid,
+	    CTAP_CMD_PING, chmsg, sizeof(chmsg));
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_PING, msg, sizeof(msg));
+	assert(len == sizeof(data));
+	wiredata = wiredata_setup(data, len);
+	assert((dev = fido_dev_new()) != NULL);
+	assert((ch = fido_dev_new()) != NULL);
+	assert((other = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open_channel(dev, ch) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_open_channel(dev, dev) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_open_channel(dev, ch) == FIDO_OK);
+	assert(fido_dev_is_fido2(ch));
+	assert(fido_dev_open_channel(dev, ch) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_close(dev) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_ping(dev, msg, sizeof(msg)) == FIDO_OK);
+	/* the device has nothing left to say; the reply was queued */
+	assert(wiredata_len == 0);
+	assert(fido_dev_ping(ch, chmsg, sizeof(chmsg)) == FIDO_OK);
+	/* nor does the channel get its own reply twice */
+	assert(fido_dev_ping(ch, chmsg, sizeof(chmsg)) == FIDO_ERR_RX);
+	assert(fido_dev_close(ch) == FIDO_OK);
+	/* an unanswered CTAPHID_INIT leaves the channel closed */
+	assert(fido_dev_open_channel(dev, other) == FIDO_ERR_RX);
+	assert(fido_dev_close(other) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&other);
+	fido_dev_free(&ch);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+static void
+lock(void)
+{
+	const uint8_t	 info[] = {
+		WIREDATA_CTAP_CBOR_INFO
+	};
+	const uint8_t	 none[1] = { 0 };
+	uint8_t		 data[sizeof(info) + 4 * (REPORT_LEN - 1)];
+	uint8_t		*wiredata;
+	size_t		 len;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	memcpy(data, info, sizeof(info));
+	len = sizeof(info);
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_LOCK, none, 0);
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_LOCK, none, 0);
+	/* a lock reply carrying data is rejected */
+	len += wiredata_frame(&data[len], sizeof(data) - len, info,
+	    CTAP_CMD_LOCK, none, sizeof(none));
+	wiredata = wiredata_setup(data, len);
+	assert((dev = fido_dev_new()) != NULL);
+	assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+	assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+	assert(fido_dev_lock(dev, 11) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_set_lock(dev, 11) == FIDO_ERR_INVALID_ARGUMENT);
+	assert(fido_dev_set_lock(dev, 10) == FIDO_OK);
+	assert(fido_dev_set_lock(dev, 0) == FIDO_OK);
+	assert(fido_dev_lock(dev, 5) == FIDO_OK);
+	assert(fido_dev_unlock(dev) == FIDO_OK);
+	assert(fido_dev_lock(dev, 5) == FIDO_ERR_RX);
+	assert(fido_dev_close(dev) == FIDO_OK);
+	fido_dev_free(&dev);
+	wiredata_clear(&wiredata);
+}
+
+/* a device echoing the reports written to it, whatever their length */
+static uint8_t	 loop_buf[64][CTAP_MAX_REPORT_LEN];
+static size_t	 loop_len;
+static size_t	 loop_head;
+static size_t	 loop_tail;
+
+static int
+loop_read(void *handle, unsigned char *ptr, size_t len, int ms)
+{
+	(void)ms;
+
+	assert(handle == &fake_dev_handle);
+	assert(len == loop_len);
+
+	if (loop_head == loop_tail)
+		return (-1);
+	memcpy(ptr, loop_buf[loop_head++ % nitems(loop_buf)], len);
+
+	return ((int)len);
+}
+
+static int
+loop_write(void *handle, const unsigned char *ptr, size_t len)
+{
+	assert(handle == &fake_dev_handle);
+	assert(len == loop_len + 1);
+	assert(loop_tail - loop_head < nitems(loop_buf));
+
+	memcpy(loop_buf[loop_tail++ % nitems(loop_buf)], ptr + 1, len - 1);
+
+	return ((int)len);
+}
+
+static void
+large_report(void)
+{
+	const uint8_t	 info[] = {
+		WIREDATA_CTAP_CBOR_INFO
+	};
+	/* 2000 bytes take 4 reports of 512 bytes, 2 of 1024, 34 of 64 */
+	const size_t	 lens[] = { 512, CTAP_MAX_REPORT_LEN, 64 };
+	const size_t	 frames[] = { 4, 2, 34 };
+	uint8_t		 msg[2000];
+	uint8_t		*wiredata;
+	fido_dev_t	*dev = NULL;
+	fido_dev_io_t	 io;
+
+	memset(&io, 0, sizeof(io));
+
+	io.open = dummy_open;
+	io.close = dummy_close;
+	io.read = dummy_read;
+	io.write = dummy_write;
+
+	for (size_t i = 0; i < sizeof(msg); i++)
+		msg[i] = (uint8_t)i;
+
+	for (size_t i = 0; i < nitems(lens); i++) {
+		wiredata = wiredata_setup(info, sizeof(info));
+		assert((dev = fido_dev_new()) != NULL);
+		assert(fido_dev_set_io_functions(dev, &io) == FIDO_OK);
+		assert(fido_dev_open(dev, "dummy") == FIDO_OK);
+		dev->io.read = loop_read;
+		dev->io.write = loop_write;
+		dev->rx_len = dev->tx_len = loop_len = lens[i];
+		loop_head = loop_tail = 0;
+		assert(fido_dev_ping(dev, msg, sizeof(msg)) == FIDO_OK);
+		assert(loop_tail == frames[i]);
+		assert(loop_head == loop_tail);
+		assert(fido_dev_close(dev) == FIDO_OK);
+		fido_dev_free(&dev);
+		wiredata_clear(&wiredata);
+	}
+}
+
+static void
+manifest_disabled(void)
+{
+	fido_dev_info_t		*devlist;
+	fido_dev_monitor_t	*m;
+	size_t			 ndevs = 1;
+
+	fido_init(FIDO_MANIFEST_NO_HID | FIDO_MANIFEST_NO_NFC |
+	    FIDO_MANIFEST_NO_PCSC | FIDO_MANIFEST_NO_WINHELLO);
+	assert((devlist = fido_dev_info_new(8)) != NULL);
+	assert(fido_dev_info_manifest(devlist, 8, &ndevs) == FIDO_OK);
+	assert(ndevs == 0);
+	fido_dev_info_free(&devlist, 8);
+	assert((m = fido_dev_monitor_new()) != NULL);
+	assert(fido_dev_monitor_start(m) == FIDO_OK);
+	assert(fido_dev_monitor_fd(m) == -1);
+	assert(fido_dev_monitor_poll(m, 0) == FIDO_OK);
+	assert(fido_dev_monitor_len(m) == 0);
+	fido_dev_monitor_free(&m);
+	fido_init(0);
+}
+
 int
 main(void)
 {
@@ -431,9 +3617,54 @@ main(void)
 	double_close();
 	is_fido2();
 	has_pin();
+	pin_minlen_rpid();
+	health_snapshot();
 	timeout_rx();
 	timeout_ok();
+	timeout_deadline();
 	timeout_misc();
+	timeout_adaptive();
+	retained_info();
+	deferred_info();
+	quirks();
+	touch_any();
+	async_assert();
+	metrics();
+	trace();
+	capture();
+	allocator();
+	open_many();
+	cancel_many();
+	pool();
+	largeblob_array();
+	largeblob_stream();
+	largeblob_retry();
+	largeblob_batch();
+	largeblob_cache();
+	largeblob_match();
+	token_cache();
+	prewarm();
+	ecdh_cache();
+	ecdh_pool();
+	credman_rk_all();
+	credman_batch();
+	credman_iter();
+	credman_session();
+	keystore_rk();
+	channel_cache();
+	info_cache();
+	profile();
+	log_level();
+	request_frames();
+	assert_reply();
+	assert_batched();
+	u2f_assert_lookup();
+	monitor();
+	ping();
+	open_channel();
+	lock();
+	large_report();
+	manifest_disabled();
 
 	exit(0);
 }
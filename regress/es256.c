@@ -16,6 +16,7 @@
 #include <fido/es256.h>
 
 #include <openssl/bio.h>
+#include <openssl/obj_mac.h>
 #include <openssl/pem.h>
 
 #define ASSERT_NOT_NULL(e)	assert((e) != NULL)
@@ -182,6 +183,51 @@ valid_curve(const unsigned char *raw, size_t raw_len)
 	es256_pk_free(&pkB);
 }
 
+/* repeated validation, including after eviction from the key cache */
+static void
+repeated_validation(void)
+{
+	EVP_PKEY *pkeyA;
+	EVP_PKEY *pkeyB;
+	EVP_PKEY_CTX *ctx;
+	es256_pk_t *pkA;
+	es256_pk_t *pkB;
+	unsigned char raw[64];
+
+	ASSERT_NOT_NULL((ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL)));
+	assert(EVP_PKEY_keygen_init(ctx) == 1);
+	assert(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx,
+	    NID_X9_62_prime256v1) == 1);
+	ASSERT_NOT_NULL((pkA = es256_pk_new()));
+	ASSERT_NOT_NULL((pkB = es256_pk_new()));
+	ASSERT_OK(es256_pk_from_ptr(pkA, p256v1_raw, sizeof(p256v1_raw)));
+	ASSERT_OK(es256_pk_from_ptr(pkA, p256v1_raw, sizeof(p256v1_raw)));
+	ASSERT_INVAL(es256_pk_from_ptr(pkB, p256k1_raw, sizeof(p256k1_raw)));
+	ASSERT_INVAL(es256_pk_from_ptr(pkB, p256k1_raw, sizeof(p256k1_raw)));
+	ASSERT_NOT_NULL((pkeyA = es256_pk_to_EVP_PKEY(pkA)));
+	for (int i = 0; i < 16; i++) {
+		pkeyB = NULL;
+		assert(EVP_PKEY_keygen(ctx, &pkeyB) == 1);
+		ASSERT_OK(es256_pk_from_EVP_PKEY(pkB, pkeyB));
+		EVP_PKEY_free(pkeyB);
+		memcpy(raw, pkB, sizeof(raw));
+		ASSERT_OK(es256_pk_from_ptr(pkB, raw, sizeof(raw)));
+		ASSERT_NOT_NULL((pkeyB = es256_pk_to_EVP_PKEY(pkB)));
+		assert(EVP_PKEY_cmp(pkeyA, pkeyB) != 1);
+		EVP_PKEY_free(pkeyB);
+	}
+	ASSERT_OK(es256_pk_from_ptr(pkA, p256v1_raw, sizeof(p256v1_raw)));
+	ASSERT_NOT_NULL((pkeyB = es256_pk_to_EVP_PKEY(pkA)));
+	assert(EVP_PKEY_cmp(pkeyA, pkeyB) == 1);
+	assert(pkeyA != pkeyB);
+
+	EVP_PKEY_free(pkeyA);
+	EVP_PKEY_free(pkeyB);
+	EVP_PKEY_CTX_free(ctx);
+	es256_pk_free(&pkA);
+	es256_pk_free(&pkB);
+}
+
 int
 main(void)
 {
@@ -194,6 +240,7 @@ main(void)
 	invalid_curve(p256k1_raw + 1, sizeof(p256k1_raw) - 1); /* libfido2 */
 	valid_curve(p256v1_raw, sizeof(p256v1_raw)); /* uncompressed */
 	valid_curve(p256v1_raw + 1, sizeof(p256v1_raw) - 1); /* libfido2 */
+	repeated_validation();
 
 	exit(0);
 }
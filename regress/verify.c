@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <fido.h>
+#include <fido/es256.h>
+
+/*
+ * Linked against fido2_verify, which has no device or transport code:
+ * only verification functions may be called here (no fido_init()).
+ */
+
+static const unsigned char es256_pk[64] = {
+	0x34, 0xeb, 0x99, 0x77, 0x02, 0x9c, 0x36, 0x38,
+	0xbb, 0xc2, 0xae, 0xa0, 0xa0, 0x18, 0xc6, 0x64,
+	0xfc, 0xe8, 0x49, 0x92, 0xd7, 0x74, 0x9e, 0x0c,
+	0x46, 0x8c, 0x9d, 0xa6, 0xdf, 0x46, 0xf7, 0x84,
+	0x60, 0x1e, 0x0f, 0x8b, 0x23, 0x85, 0x4a, 0x9a,
+	0xec, 0xc1, 0x08, 0x9f, 0x30, 0xd0, 0x0d, 0xd7,
+	0x76, 0x7b, 0x55, 0x48, 0x91, 0x7c, 0x4f, 0x0f,
+	0x64, 0x1a, 0x1d, 0xf8, 0xbe, 0x14, 0x90, 0x8a,
+};
+
+static const unsigned char assert_cdh[32] = {
+	0xec, 0x8d, 0x8f, 0x78, 0x42, 0x4a, 0x2b, 0xb7,
+	0x82, 0x34, 0xaa, 0xca, 0x07, 0xa1, 0xf6, 0x56,
+	0x42, 0x1c, 0xb6, 0xf6, 0xb3, 0x00, 0x86, 0x52,
+	0x35, 0x2d, 0xa2, 0x62, 0x4a, 0xbe, 0x89, 0x76,
+};
+
+static const unsigned char assert_authdata[39] = {
+	0x58, 0x25, 0x49, 0x96, 0x0d, 0xe5, 0x88, 0x0e,
+	0x8c, 0x68, 0x74, 0x34, 0x17, 0x0f, 0x64, 0x76,
+	0x60, 0x5b, 0x8f, 0xe4, 0xae, 0xb9, 0xa2, 0x86,
+	0x32, 0xc7, 0x99, 0x5c, 0xf3, 0xba, 0x83, 0x1d,
+	0x97, 0x63, 0x00, 0x00, 0x00, 0x00, 0x03,
+};
+
+static const unsigned char assert_sig[72] = {
+	0x30, 0x46, 0x02, 0x21, 0x00, 0xf6, 0xd1, 0xa3,
+	0xd5, 0x24, 0x2b, 0xde, 0xee, 0xa0, 0x90, 0x89,
+	0xcd, 0xf8, 0x9e, 0xbd, 0x6b, 0x4d, 0x55, 0x79,
+	0xe4, 0xc1, 0x42, 0x27, 0xb7, 0x9b, 0x9b, 0xa4,
+	0x0a, 0xe2, 0x47, 0x64, 0x0e, 0x02, 0x21, 0x00,
+	0xe5, 0xc9, 0xc2, 0x83, 0x47, 0x31, 0xc7, 0x26,
+	0xe5, 0x25, 0xb2, 0xb4, 0x39, 0xa7, 0xfc, 0x3d,
+	0x70, 0xbe, 0xe9, 0x81, 0x0d, 0x4a, 0x62, 0xa9,
+	0xab, 0x4a, 0x91, 0xc0, 0x7d, 0x2d, 0x23, 0x1e,
+};
+
+static const unsigned char cred_cdh[32] = {
+	0xf9, 0x64, 0x57, 0xe7, 0x2d, 0x97, 0xf6, 0xbb,
+	0xdd, 0xd7, 0xfb, 0x06, 0x37, 0x62, 0xea, 0x26,
+	0x20, 0x44, 0x8e, 0x69, 0x7c, 0x03, 0xf2, 0x31,
+	0x2f, 0x99, 0xdc, 0xaf, 0x3e, 0x8a, 0x91, 0x6b,
+};
+
+static const unsigned char cred_authdata[166] = {
+	0x58, 0xa4, 0x49, 0x96, 0x0d, 0xe5, 0x88, 0x0e,
+	0x8c, 0x68, 0x74, 0x34, 0x17, 0x0f, 0x64, 0x76,
+	0x60, 0x5b, 0x8f, 0xe4, 0xae, 0xb9, 0xa2, 0x86,
+	0x32, 0xc7, 0x99, 0x5c, 0xf3, 0xba, 0x83, 0x1d,
+	0x97, 0x63, 0x41, 0x00, 0x00, 0x00, 0x01, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x20, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e,
+	0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26,
+	0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e,
+	0x2f, 0xa5, 0x01, 0x02, 0x03, 0x26, 0x20, 0x01,
+	0x21, 0x58, 0x20, 0x18, 0x90, 0x4c, 0x19, 0x67,
+	0xec, 0xb2, 0x3d, 0xab, 0x0e, 0xce, 0x71, 0x2d,
+	0x74, 0x34, 0x38, 0x6d, 0xb3, 0x5c, 0x60, 0xfd,
+	0x87, 0x69, 0x2c, 0x2e, 0xe8, 0x58, 0x59, 0x0c,
+	0xd7, 0x6d, 0x89, 0x22, 0x58, 0x20, 0xf5, 0xca,
+	0x93, 0x9d, 0x15, 0x6b, 0x91, 0xa5, 0x57, 0xe6,
+	0xba, 0xda, 0x59, 0x98, 0x0c, 0x90, 0xaa, 0x97,
+	0xb4, 0xd4, 0x91, 0xa1, 0xd8, 0x26, 0x28, 0xe2,
+	0xea, 0x4d, 0xb5, 0x79, 0x1d, 0x9e
+};
+
+static const unsigned char cred_sig[70] = {
+	0x30, 0x44, 0x02, 0x20, 0x53, 0x38, 0xa6, 0xca,
+	0x45, 0xd5, 0xcd, 0xe9, 0x2b, 0x1c, 0xdf, 0x39,
+	0x2e, 0xed, 0x2a, 0x2b, 0x39, 0x9e, 0x0e, 0x06,
+	0x28, 0x02, 0x2f, 0xc4, 0x25, 0x26, 0xc5, 0xbf,
+	0x59, 0xda, 0x6f, 0x45, 0x02, 0x20, 0x4f, 0xa1,
+	0xeb, 0x6b, 0x64, 0x3f, 0xa3, 0x25, 0x74, 0x13,
+	0x56, 0x27, 0xca, 0xfa, 0xe7, 0x9f, 0x80, 0x62,
+	0xd9, 0x87, 0xae, 0xd6, 0x96, 0x17, 0x19, 0x16,
+	0xa4, 0xbc, 0xe3, 0xbc, 0x4f, 0x8d
+};
+
+static fido_assert_t *
+alloc_assert(const unsigned char *sig, size_t sig_len)
+{
+	fido_assert_t *a;
+
+	a = fido_assert_new();
+	assert(a != NULL);
+	assert(fido_assert_set_clientdata_hash(a, assert_cdh,
+	    sizeof(assert_cdh)) == FIDO_OK);
+	assert(fido_assert_set_rp(a, "localhost") == FIDO_OK);
+	assert(fido_assert_set_count(a, 1) == FIDO_OK);
+	assert(fido_assert_set_authdata(a, 0, assert_authdata,
+	    sizeof(assert_authdata)) == FIDO_OK);
+	assert(fido_assert_set_up(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_uv(a, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_assert_set_sig(a, 0, sig, sig_len) == FIDO_OK);
+
+	return (a);
+}
+
+static fido_cred_t *
+alloc_cred(const unsigned char *sig, size_t sig_len)
+{
+	fido_cred_t *c;
+
+	c = fido_cred_new();
+	assert(c != NULL);
+	assert(fido_cred_set_type(c, COSE_ES256) == FIDO_OK);
+	assert(fido_cred_set_clientdata_hash(c, cred_cdh,
+	    sizeof(cred_cdh)) == FIDO_OK);
+	assert(fido_cred_set_rp(c, "localhost",
+	    "sweet home localhost") == FIDO_OK);
+	assert(fido_cred_set_authdata(c, cred_authdata,
+	    sizeof(cred_authdata)) == FIDO_OK);
+	assert(fido_cred_set_rk(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_uv(c, FIDO_OPT_FALSE) == FIDO_OK);
+	assert(fido_cred_set_sig(c, sig, sig_len) == FIDO_OK);
+	assert(fido_cred_set_fmt(c, "packed") == FIDO_OK);
+
+	return (c);
+}
+
+static void
+assert_es256(void)
+{
+	fido_assert_t *a;
+	es256_pk_t *pk;
+	unsigned char junk[sizeof(assert_sig)];
+
+	assert((pk = es256_pk_new()) != NULL);
+	assert(es256_pk_from_ptr(pk, es256_pk, sizeof(es256_pk)) == FIDO_OK);
+	a = alloc_assert(assert_sig, sizeof(assert_sig));
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_OK);
+	fido_assert_free(&a);
+	memcpy(junk, assert_sig, sizeof(junk));
+	junk[sizeof(junk) - 1] ^= 0x01;
+	a = alloc_assert(junk, sizeof(junk));
+	assert(fido_assert_verify(a, 0, COSE_ES256, pk) == FIDO_ERR_INVALID_SIG);
+	fido_assert_free(&a);
+	es256_pk_free(&pk);
+}
+
+static void
+cred_es256(void)
+{
+	fido_cred_t *c;
+	unsigned char junk[sizeof(cred_sig)];
+
+	c = alloc_cred(cred_sig, sizeof(cred_sig));
+	assert(fido_cred_verify_self(c) == FIDO_OK);
+	fido_cred_free(&c);
+	memcpy(junk, cred_sig, sizeof(junk));
+	junk[sizeof(junk) - 1] ^= 0x01;
+	c = alloc_cred(junk, sizeof(junk));
+	assert(fido_cred_verify_self(c) == FIDO_ERR_INVALID_SIG);
+	fido_cred_free(&c);
+}
+
+int
+main(void)
+{
+	assert_es256();
+	cred_es256();
+
+	exit(0);
+}
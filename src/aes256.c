@@ -7,12 +7,81 @@
 
 #include "fido.h"
 
+/*
+ * CBC contexts kept by a device alongside its cached shared secret. Each
+ * is keyed on first use, so that the pin protocol operations of a session
+ * go through one key schedule per direction; only the IV is set per call.
+ */
+struct aes256_cache {
+	EVP_CIPHER_CTX *ctx[2]; /* decrypt, encrypt */
+};
+
+struct aes256_cache *
+aes256_cache_new(void)
+{
+	return fido_calloc(1, sizeof(struct aes256_cache));
+}
+
+void
+aes256_cache_free(struct aes256_cache **cache_p)
+{
+	struct aes256_cache *cache;
+
+	if (cache_p == NULL || (cache = *cache_p) == NULL)
+		return;
+	for (size_t i = 0; i < nitems(cache->ctx); i++)
+		EVP_CIPHER_CTX_free(cache->ctx[i]);
+	fido_free(cache);
+	*cache_p = NULL;
+}
+
+/* the cached context for 'secret', if it is the device's shared secret */
+static EVP_CIPHER_CTX **
+aes256_cache_slot(const fido_dev_t *dev, const fido_blob_t *secret,
+    int encrypt)
+{
+	if (dev->aes == NULL || dev->ecdh == NULL ||
+	    dev->ecdh->len != secret->len ||
+	    timingsafe_bcmp(dev->ecdh->ptr, secret->ptr, secret->len) != 0)
+		return NULL;
+
+	return &dev->aes->ctx[encrypt != 0];
+}
+
+/* set up 'ctx', or the context in 'cached' if any, for a message */
+static EVP_CIPHER_CTX *
+aes256_cbc_init(EVP_CIPHER_CTX **cached, const fido_blob_t *key,
+    const u_char *iv, int encrypt)
+{
+	EVP_CIPHER_CTX *ctx;
+	const EVP_CIPHER *cipher;
+
+	if (cached != NULL && *cached != NULL) {
+		if (EVP_CipherInit_ex(*cached, NULL, NULL, NULL, iv,
+		    encrypt) == 0) {
+			fido_log_debug("%s: EVP_CipherInit_ex", __func__);
+			return NULL;
+		}
+		return *cached;
+	}
+	if ((ctx = EVP_CIPHER_CTX_new()) == NULL ||
+	    (cipher = fido_cipher_aes256_cbc()) == NULL ||
+	    EVP_CipherInit_ex(ctx, cipher, NULL, key->ptr, iv, encrypt) == 0) {
+		fido_log_debug("%s: EVP_CipherInit_ex", __func__);
+		EVP_CIPHER_CTX_free(ctx);
+		return NULL;
+	}
+	if (cached != NULL)
+		*cached = ctx;
+
+	return ctx;
+}
+
 static int
 aes256_cbc(const fido_blob_t *key, const u_char *iv, const fido_blob_t *in,
-    fido_blob_t *out, int encrypt)
+    fido_blob_t *out, int encrypt, EVP_CIPHER_CTX **cached)
 {
 	EVP_CIPHER_CTX *ctx = NULL;
-	const EVP_CIPHER *cipher;
 	int ok = -1;
 
 	memset(out, 0, sizeof(*out));
@@ -26,25 +95,28 @@ aes256_cbc(const fido_blob_t *key, const u_char *iv, const fido_blob_t *in,
 		goto fail;
 	}
 	out->len = in->len;
-	if ((out->ptr = calloc(1, out->len)) == NULL) {
+	/* decrypted tokens and hmac-secret outputs are secrets */
+	if ((out->ptr = encrypt ? fido_calloc(1, out->len) :
+	    fido_secure_alloc(out->len)) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		goto fail;
 	}
-	if ((ctx = EVP_CIPHER_CTX_new()) == NULL ||
-	    (cipher = EVP_aes_256_cbc()) == NULL) {
-		fido_log_debug("%s: EVP_CIPHER_CTX_new", __func__);
+	if ((ctx = aes256_cbc_init(cached, key, iv, encrypt)) == NULL)
 		goto fail;
-	}
-	if (EVP_CipherInit(ctx, cipher, key->ptr, iv, encrypt) == 0 ||
-	    EVP_Cipher(ctx, out->ptr, in->ptr, (u_int)out->len) < 0) {
+	if (EVP_Cipher(ctx, out->ptr, in->ptr, (u_int)out->len) < 0) {
 		fido_log_debug("%s: EVP_Cipher", __func__);
 		goto fail;
 	}
 
 	ok = 0;
 fail:
-	if (ctx != NULL)
+	if (cached == NULL)
 		EVP_CIPHER_CTX_free(ctx);
+	else if (ok < 0 && ctx != NULL) {
+		/* in an unknown state */
+		EVP_CIPHER_CTX_free(*cached);
+		*cached = NULL;
+	}
 	if (ok < 0)
 		fido_blob_reset(out);
 
@@ -53,18 +125,18 @@ fail:
 
 static int
 aes256_cbc_proto1(const fido_blob_t *key, const fido_blob_t *in,
-    fido_blob_t *out, int encrypt)
+    fido_blob_t *out, int encrypt, EVP_CIPHER_CTX **cached)
 {
 	u_char iv[16];
 
 	memset(&iv, 0, sizeof(iv));
 
-	return aes256_cbc(key, iv, in, out, encrypt);
+	return aes256_cbc(key, iv, in, out, encrypt, cached);
 }
 
 static int
 aes256_cbc_fips(const fido_blob_t *secret, const fido_blob_t *in,
-    fido_blob_t *out, int encrypt)
+    fido_blob_t *out, int encrypt, EVP_CIPHER_CTX **cached)
 {
 	fido_blob_t key, cin, cout;
 	u_char iv[16];
@@ -81,8 +153,8 @@ aes256_cbc_fips(const fido_blob_t *secret, const fido_blob_t *in,
 		return -1;
 	}
 	if (encrypt) {
-		if (fido_get_random(iv, sizeof(iv)) < 0) {
-			fido_log_debug("%s: fido_get_random", __func__);
+		if (fido_get_nonce(iv, sizeof(iv)) < 0) {
+			fido_log_debug("%s: fido_get_nonce", __func__);
 			return -1;
 		}
 		cin = *in;
@@ -93,11 +165,12 @@ aes256_cbc_fips(const fido_blob_t *secret, const fido_blob_t *in,
 	}
 	key.ptr = secret->ptr + 32;
 	key.len = secret->len - 32;
-	if (aes256_cbc(&key, iv, &cin, &cout, encrypt) < 0)
+	if (aes256_cbc(&key, iv, &cin, &cout, encrypt, cached) < 0)
 		return -1;
 	if (encrypt) {
 		if (cout.len > SIZE_MAX - sizeof(iv) ||
-		    (out->ptr = calloc(1, sizeof(iv) + cout.len)) == NULL) {
+		    (out->ptr = fido_calloc(1,
+		    sizeof(iv) + cout.len)) == NULL) {
 			fido_blob_reset(&cout);
 			return -1;
 		}
@@ -134,12 +207,12 @@ aes256_gcm(const fido_blob_t *key, const fido_blob_t *nonce,
 	}
 	/* add tag to (on encrypt) or trim tag from the output (on decrypt) */
 	out->len = encrypt ? in->len + 16 : in->len - 16;
-	if ((out->ptr = calloc(1, out->len)) == NULL) {
+	if ((out->ptr = fido_calloc(1, out->len)) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		goto fail;
 	}
 	if ((ctx = EVP_CIPHER_CTX_new()) == NULL ||
-	    (cipher = EVP_aes_256_gcm()) == NULL) {
+	    (cipher = fido_cipher_aes256_gcm()) == NULL) {
 		fido_log_debug("%s: EVP_CIPHER_CTX_new", __func__);
 		goto fail;
 	}
@@ -189,16 +262,42 @@ int
 aes256_cbc_enc(const fido_dev_t *dev, const fido_blob_t *secret,
     const fido_blob_t *in, fido_blob_t *out)
 {
+	EVP_CIPHER_CTX **cached = aes256_cache_slot(dev, secret, 1);
+
 	return fido_dev_get_pin_protocol(dev) == 2 ? aes256_cbc_fips(secret,
-	    in, out, 1) : aes256_cbc_proto1(secret, in, out, 1);
+	    in, out, 1, cached) : aes256_cbc_proto1(secret, in, out, 1,
+	    cached);
 }
 
 int
 aes256_cbc_dec(const fido_dev_t *dev, const fido_blob_t *secret,
     const fido_blob_t *in, fido_blob_t *out)
 {
+	EVP_CIPHER_CTX **cached = aes256_cache_slot(dev, secret, 0);
+
+	return fido_dev_get_pin_protocol(dev) == 2 ? aes256_cbc_fips(secret,
+	    in, out, 0, cached) : aes256_cbc_proto1(secret, in, out, 0,
+	    cached);
+}
+
+/*
+ * Decryption of several messages under 'secret' with one key schedule:
+ * '*ctx' is keyed on the first call and only given a new IV by the next
+ * ones. The caller frees it. The device's cached context is used instead
+ * if 'secret' is its shared secret.
+ */
+int
+aes256_cbc_dec_ctx(const fido_dev_t *dev, EVP_CIPHER_CTX **ctx,
+    const fido_blob_t *secret, const fido_blob_t *in, fido_blob_t *out)
+{
+	EVP_CIPHER_CTX **cached;
+
+	if ((cached = aes256_cache_slot(dev, secret, 0)) == NULL)
+		cached = ctx;
+
 	return fido_dev_get_pin_protocol(dev) == 2 ? aes256_cbc_fips(secret,
-	    in, out, 0) : aes256_cbc_proto1(secret, in, out, 0);
+	    in, out, 0, cached) : aes256_cbc_proto1(secret, in, out, 0,
+	    cached);
 }
 
 int
@@ -214,3 +313,119 @@ aes256_gcm_dec(const fido_blob_t *key, const fido_blob_t *nonce,
 {
 	return aes256_gcm(key, nonce, aad, in, out, 0);
 }
+
+/*
+ * A keyed AES-256-GCM decryption context, so that many ciphertexts can be
+ * checked against the same key without repeating the key setup.
+ */
+EVP_CIPHER_CTX *
+aes256_gcm_dec_new(const fido_blob_t *key)
+{
+	EVP_CIPHER_CTX *ctx = NULL;
+	const EVP_CIPHER *cipher;
+
+	if (key->len != 32) {
+		fido_log_debug("%s: invalid key len %zu", __func__, key->len);
+		return NULL;
+	}
+	if ((ctx = EVP_CIPHER_CTX_new()) == NULL ||
+	    (cipher = fido_cipher_aes256_gcm()) == NULL ||
+	    EVP_CipherInit_ex(ctx, cipher, NULL, key->ptr, NULL, 0) == 0) {
+		fido_log_debug("%s: EVP_CipherInit_ex", __func__);
+		EVP_CIPHER_CTX_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+/* 'out' must hold at least in->len - 16 bytes */
+int
+aes256_gcm_dec_ctx(EVP_CIPHER_CTX *ctx, const fido_blob_t *nonce,
+    const fido_blob_t *aad, const fido_blob_t *in, unsigned char *out)
+{
+	if (nonce->len != 12 || aad->len > UINT_MAX) {
+		fido_log_debug("%s: invalid params %zu, %zu", __func__,
+		    nonce->len, aad->len);
+		return -1;
+	}
+	if (in->len > UINT_MAX || in->len < 16) {
+		fido_log_debug("%s: invalid input len %zu", __func__, in->len);
+		return -1;
+	}
+	if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, nonce->ptr, 0) == 0 ||
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16,
+	    in->ptr + in->len - 16) == 0) {
+		fido_log_debug("%s: EVP_CipherInit_ex", __func__);
+		return -1;
+	}
+	if (EVP_Cipher(ctx, NULL, aad->ptr, (u_int)aad->len) < 0 ||
+	    EVP_Cipher(ctx, out, in->ptr, (u_int)(in->len - 16)) < 0 ||
+	    EVP_Cipher(ctx, NULL, NULL, 0) < 0) {
+		fido_log_debug("%s: EVP_Cipher", __func__);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Incremental encryption: aes256_gcm_enc_new() authenticates 'aad', each
+ * aes256_gcm_enc_update() appends the ciphertext of its input to 'out',
+ * and aes256_gcm_enc_final() appends the mac tag.
+ */
+EVP_CIPHER_CTX *
+aes256_gcm_enc_new(const fido_blob_t *key, const fido_blob_t *nonce,
+    const fido_blob_t *aad)
+{
+	EVP_CIPHER_CTX *ctx = NULL;
+	const EVP_CIPHER *cipher;
+
+	if (nonce->len != 12 || key->len != 32 || aad->len > UINT_MAX) {
+		fido_log_debug("%s: invalid params %zu, %zu, %zu", __func__,
+		    nonce->len, key->len, aad->len);
+		return NULL;
+	}
+	if ((ctx = EVP_CIPHER_CTX_new()) == NULL ||
+	    (cipher = fido_cipher_aes256_gcm()) == NULL ||
+	    EVP_CipherInit(ctx, cipher, key->ptr, nonce->ptr, 1) == 0 ||
+	    EVP_Cipher(ctx, NULL, aad->ptr, (u_int)aad->len) < 0) {
+		fido_log_debug("%s: EVP_CipherInit", __func__);
+		EVP_CIPHER_CTX_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+int
+aes256_gcm_enc_update(EVP_CIPHER_CTX *ctx, const u_char *ptr, size_t len,
+    fido_blob_t *out)
+{
+	if (len > UINT_MAX || fido_blob_reserve(out, len) < 0) {
+		fido_log_debug("%s: len=%zu", __func__, len);
+		return -1;
+	}
+	if (EVP_Cipher(ctx, out->ptr + out->len, ptr, (u_int)len) < 0) {
+		fido_log_debug("%s: EVP_Cipher", __func__);
+		return -1;
+	}
+	out->len += len;
+
+	return 0;
+}
+
+int
+aes256_gcm_enc_final(EVP_CIPHER_CTX *ctx, fido_blob_t *out)
+{
+	if (fido_blob_reserve(out, 16) < 0 ||
+	    EVP_Cipher(ctx, NULL, NULL, 0) < 0 ||
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16,
+	    out->ptr + out->len) == 0) {
+		fido_log_debug("%s: EVP_CIPHER_CTX_ctrl", __func__);
+		return -1;
+	}
+	out->len += 16;
+
+	return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "fido.h"
+
+/* cbor_set_allocs() is always available from libcbor 0.10 */
+#if defined(CBOR_CUSTOM_ALLOC) || CBOR_MAJOR_VERSION > 0 || \
+    CBOR_MINOR_VERSION >= 10
+#define HAVE_CBOR_SET_ALLOCS
+#endif
+
+/* sqrt(SIZE_MAX + 1); see recallocarray.c */
+#define MUL_NO_OVERFLOW	((size_t)1 << (sizeof(size_t) * 4))
+
+/* wrappers, as the addresses of dllimport functions are not constant */
+static void *
+default_malloc(size_t size)
+{
+	return (malloc(size));
+}
+
+static void *
+default_calloc(size_t nmemb, size_t size)
+{
+	return (calloc(nmemb, size));
+}
+
+static void *
+default_realloc(void *ptr, size_t size)
+{
+	return (realloc(ptr, size));
+}
+
+static void
+default_free(void *ptr)
+{
+	free(ptr);
+}
+
+static void
+default_freezero(void *ptr, size_t len)
+{
+	freezero(ptr, len);
+}
+
+static const fido_allocator_t default_allocator = {
+	default_malloc,
+	default_calloc,
+	default_realloc,
+	default_free,
+	default_freezero,
+};
+
+static fido_allocator_t allocator = {
+	default_malloc,
+	default_calloc,
+	default_realloc,
+	default_free,
+	default_freezero,
+};
+
+/*
+ * The allocator is shared by all threads and also backs libcbor; it may
+ * only be changed while no object allocated through it is alive.
+ */
+int
+fido_set_allocator(const fido_allocator_t *a)
+{
+	if (a == NULL)
+		a = &default_allocator;
+	if (a->malloc == NULL || a->calloc == NULL || a->realloc == NULL ||
+	    a->free == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+#ifdef HAVE_CBOR_SET_ALLOCS
+	if (a == &default_allocator)
+		cbor_set_allocs(malloc, realloc, free);
+	else
+		cbor_set_allocs(fido_malloc, fido_realloc, fido_free);
+#else
+	/* buffers from cbor_serialize_alloc() would come from libc */
+	if (a != &default_allocator) {
+		fido_log_debug("%s: libcbor lacks cbor_set_allocs", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+#endif
+
+	allocator = *a;
+
+	return (FIDO_OK);
+}
+
+void *
+fido_malloc(size_t size)
+{
+	return (allocator.malloc(size));
+}
+
+void *
+fido_calloc(size_t nmemb, size_t size)
+{
+	return (allocator.calloc(nmemb, size));
+}
+
+void *
+fido_realloc(void *ptr, size_t size)
+{
+	size_t	 n;
+	void	*p;
+
+	if ((n = fido_secure_size(ptr)) == 0)
+		return (allocator.realloc(ptr, size));
+	if ((p = fido_secure_alloc(size)) == NULL)
+		return (NULL);
+
+	memcpy(p, ptr, n < size ? n : size);
+	fido_secure_free(ptr);
+
+	return (p);
+}
+
+void
+fido_free(void *ptr)
+{
+	if (ptr != NULL && fido_secure_free(ptr) < 0)
+		allocator.free(ptr);
+}
+
+void
+fido_freezero(void *ptr, size_t len)
+{
+	if (ptr == NULL || fido_secure_free(ptr) == 0)
+		return;
+	if (allocator.freezero != NULL) {
+		allocator.freezero(ptr, len);
+		return;
+	}
+
+	explicit_bzero(ptr, len);
+	allocator.free(ptr);
+}
+
+/* recallocarray(3) over the library's allocator */
+void *
+fido_recallocarray(void *ptr, size_t oldnmemb, size_t newnmemb, size_t size)
+{
+	size_t	 oldsize, newsize;
+	void	*newptr;
+
+	if (ptr == NULL)
+		return (fido_calloc(newnmemb, size));
+
+	if ((newnmemb >= MUL_NO_OVERFLOW || size >= MUL_NO_OVERFLOW) &&
+	    newnmemb > 0 && SIZE_MAX / newnmemb < size) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	newsize = newnmemb * size;
+
+	if ((oldnmemb >= MUL_NO_OVERFLOW || size >= MUL_NO_OVERFLOW) &&
+	    oldnmemb > 0 && SIZE_MAX / oldnmemb < size) {
+		errno = EINVAL;
+		return (NULL);
+	}
+	oldsize = oldnmemb * size;
+
+	if ((newptr = fido_malloc(newsize)) == NULL)
+		return (NULL);
+
+	if (newsize > oldsize) {
+		memcpy(newptr, ptr, oldsize);
+		memset((char *)newptr + oldsize, 0, newsize - oldsize);
+	} else
+		memcpy(newptr, ptr, newsize);
+
+	fido_freezero(ptr, oldsize);
+
+	return (newptr);
+}
+
+char *
+fido_strdup(const char *s)
+{
+	char	*p;
+	size_t	 len;
+
+	len = strlen(s) + 1;
+	if ((p = fido_malloc(len)) == NULL)
+		return (NULL);
+
+	memcpy(p, s, len);
+
+	return (p);
+}
+
+/* asprintf(3) over the library's allocator */
+int
+fido_asprintf(char **strp, const char *fmt, ...)
+{
+	va_list	 ap;
+	int	 n;
+
+	*strp = NULL;
+
+	va_start(ap, fmt);
+	n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (n < 0 || (*strp = fido_malloc((size_t)n + 1)) == NULL)
+		return (-1);
+
+	va_start(ap, fmt);
+	if (vsnprintf(*strp, (size_t)n + 1, fmt, ap) != n) {
+		fido_free(*strp);
+		*strp = NULL;
+		n = -1;
+	}
+	va_end(ap);
+
+	return (n);
+}
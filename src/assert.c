@@ -6,35 +6,127 @@
  */
 
 #include <openssl/sha.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #include "fido.h"
 #include "fido/es256.h"
 #include "fido/rs256.h"
 #include "fido/eddsa.h"
 
-static int
-adjust_assert_count(const cbor_item_t *key, const cbor_item_t *val, void *arg)
+/* reply members decoded on first access if assert->lazy: 1, 4 and 7 */
+#define LAZY_KEYS	((1U << 1) | (1U << 4) | (1U << 7))
+
+/*
+ * Replies are copied into chunks owned by the assertion, and the byte
+ * strings of its statements point into the copies: a statement costs no
+ * allocation of its own, and those of a multi-statement reply sit next to
+ * each other. Chunks never move; they are wiped and freed with the
+ * statements.
+ */
+#define ARENA_MINCAP	2048
+
+struct fido_assert_arena {
+	struct fido_assert_arena	*next;
+	size_t				 len;
+	size_t				 cap;
+	unsigned char			 buf[];
+};
+
+static void
+arena_free(fido_assert_t *assert)
 {
-	fido_assert_t	*assert = arg;
-	uint64_t	 n;
+	struct fido_assert_arena *a;
 
-	/* numberOfCredentials; see section 6.2 */
-	if (cbor_isa_uint(key) == false ||
-	    cbor_int_get_width(key) != CBOR_INT_8 ||
-	    cbor_get_uint8(key) != 5) {
-		fido_log_debug("%s: cbor_type", __func__);
-		return (0); /* ignore */
+	while ((a = assert->arena) != NULL) {
+		assert->arena = a->next;
+		fido_freezero(a, sizeof(*a) + a->cap);
 	}
+}
 
-	if (cbor_decode_uint64(val, &n) < 0 || n > SIZE_MAX) {
-		fido_log_debug("%s: cbor_decode_uint64", __func__);
-		return (-1);
+/*
+ * The frame of the last getAssertion request is kept in assert->tmpl. A
+ * request that differs from it only in its clientDataHash and
+ * pinUvAuthParam is sent by patching those into the kept frame, without
+ * encoding anything else again. The frame is dropped when the rp id or
+ * allow list change; the options and extensions it was built with are
+ * compared below. Requests with hmac-secret are not kept, their salts
+ * being encrypted for each request.
+ */
+static void
+tmpl_reset(fido_assert_t *assert)
+{
+	fido_blob_reset(&assert->tmpl.frame);
+	memset(&assert->tmpl, 0, sizeof(assert->tmpl));
+}
+
+#ifndef FIDO_VERIFY_ONLY
+static unsigned char *
+arena_alloc(fido_assert_t *assert, size_t n)
+{
+	struct fido_assert_arena	*a = assert->arena;
+	size_t				 cap;
+	unsigned char			*ptr;
+
+	if (a == NULL || a->cap - a->len < n) {
+		cap = ARENA_MINCAP;
+		if (a != NULL && a->cap <= SIZE_MAX / 2 && a->cap * 2 > cap)
+			cap = a->cap * 2;
+		if (n > cap)
+			cap = n;
+		if (cap > SIZE_MAX - sizeof(*a) ||
+		    (a = fido_malloc(sizeof(*a) + cap)) == NULL) {
+			fido_log_debug("%s: malloc", __func__);
+			return (NULL);
+		}
+		a->next = assert->arena;
+		a->len = 0;
+		a->cap = cap;
+		assert->arena = a;
+	}
+
+	ptr = &a->buf[a->len];
+	a->len += n;
+
+	return (ptr);
+}
+
+/* copy 'msg' to the arena of 'assert' and decode it into 'stmt' */
+static int
+parse_assert_reply(fido_assert_t *assert, fido_assert_stmt *stmt,
+    const unsigned char *msg, size_t msglen, uint64_t *ncred)
+{
+	unsigned char	*reply;
+	int		 r;
+
+	if ((reply = arena_alloc(assert, msglen)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+	if (msglen > 0)
+		memcpy(reply, msg, msglen);
+
+	if ((r = cbor_parse_assert_reply(reply, msglen, stmt, ncred,
+	    assert->lazy ? LAZY_KEYS : 0)) != FIDO_OK) {
+		fido_log_debug("%s: cbor_parse_assert_reply", __func__);
+		return (r);
+	}
+	if (assert->lazy) {
+		stmt->reply.ptr = reply;
+		stmt->reply.len = msglen;
+		stmt->reply.view = true;
 	}
 
-	if (assert->stmt_len != 0 || assert->stmt_cnt != 1 ||
+	return (FIDO_OK);
+}
+
+static int
+adjust_assert_count(fido_assert_t *assert, uint64_t n)
+{
+	/* numberOfCredentials; see section 6.2 */
+	if (n > SIZE_MAX || assert->stmt_len != 0 || assert->stmt_cnt != 1 ||
 	    (size_t)n < assert->stmt_cnt) {
-		fido_log_debug("%s: stmt_len=%zu, stmt_cnt=%zu, n=%zu",
-		    __func__, assert->stmt_len, assert->stmt_cnt, (size_t)n);
+		fido_log_debug("%s: stmt_len=%zu, stmt_cnt=%zu", __func__,
+		    assert->stmt_len, assert->stmt_cnt);
 		return (-1);
 	}
 
@@ -48,37 +140,72 @@ adjust_assert_count(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 	return (0);
 }
 
-static int
-parse_assert_reply(const cbor_item_t *key, const cbor_item_t *val, void *arg)
+static bool
+tmpl_match(const fido_assert_t *assert, fido_opt_t uv, const cbor_item_t *auth,
+    const cbor_item_t *prot)
 {
-	fido_assert_stmt *stmt = arg;
+	const fido_assert_tmpl_t *t = &assert->tmpl;
 
-	if (cbor_isa_uint(key) == false ||
-	    cbor_int_get_width(key) != CBOR_INT_8) {
-		fido_log_debug("%s: cbor type", __func__);
-		return (0); /* ignore */
-	}
+	if (t->frame.ptr == NULL || t->up != assert->up || t->uv != uv ||
+	    t->ext != assert->ext.mask ||
+	    t->cdh + assert->cdh.len > t->frame.len)
+		return (false);
+	if (auth == NULL)
+		return (t->param == 0 && prot == NULL);
 
-	switch (cbor_get_uint8(key)) {
-	case 1: /* credential id */
-		return (cbor_decode_cred_id(val, &stmt->id));
-	case 2: /* authdata */
-		if (fido_blob_decode(val, &stmt->authdata_raw) < 0) {
-			fido_log_debug("%s: fido_blob_decode", __func__);
-			return (-1);
+	return (t->param != 0 && cbor_isa_bytestring(auth) &&
+	    cbor_bytestring_is_definite(auth) &&
+	    cbor_bytestring_length(auth) == t->param_len &&
+	    prot != NULL && cbor_isa_uint(prot) &&
+	    cbor_get_int(prot) == t->prot);
+}
+
+static void
+tmpl_patch(fido_assert_t *assert, const cbor_item_t *auth)
+{
+	fido_assert_tmpl_t *t = &assert->tmpl;
+
+	memcpy(t->frame.ptr + t->cdh, assert->cdh.ptr, assert->cdh.len);
+	if (auth != NULL)
+		memcpy(t->frame.ptr + t->param, cbor_bytestring_handle(auth),
+		    t->param_len);
+}
+
+/* keep 'f', built with 'uv', 'auth' and 'prot', as assert->tmpl */
+static void
+tmpl_store(fido_assert_t *assert, fido_opt_t uv, const cbor_item_t *auth,
+    const cbor_item_t *prot, fido_blob_t *f, size_t cdh_off)
+{
+	fido_assert_tmpl_t *t = &assert->tmpl;
+
+	tmpl_reset(assert);
+
+	if (assert->ext.mask & FIDO_EXT_HMAC_SECRET)
+		return;
+	if (auth != NULL) {
+		/* the frame ends with {6: auth, 7: prot}; prot is one byte */
+		if (!cbor_isa_bytestring(auth) ||
+		    !cbor_bytestring_is_definite(auth) ||
+		    prot == NULL || !cbor_isa_uint(prot) ||
+		    cbor_get_int(prot) > 23 ||
+		    (t->param_len = cbor_bytestring_length(auth)) == 0 ||
+		    f->len < t->param_len + 3 ||
+		    f->ptr[f->len - 2] != 7 ||
+		    memcmp(f->ptr + f->len - 2 - t->param_len,
+		    cbor_bytestring_handle(auth), t->param_len) != 0) {
+			tmpl_reset(assert);
+			return;
 		}
-		return (cbor_decode_assert_authdata(val, &stmt->authdata_cbor,
-		    &stmt->authdata, &stmt->authdata_ext));
-	case 3: /* signature */
-		return (fido_blob_decode(val, &stmt->sig));
-	case 4: /* user attributes */
-		return (cbor_decode_user(val, &stmt->user));
-	case 7: /* large blob key */
-		return (fido_blob_decode(val, &stmt->largeblob_key));
-	default: /* ignore */
-		fido_log_debug("%s: cbor type", __func__);
-		return (0);
+		t->param = f->len - 2 - t->param_len;
+		t->prot = cbor_get_int(prot);
 	}
+
+	t->frame = *f;
+	t->cdh = cdh_off;
+	t->up = assert->up;
+	t->uv = uv;
+	t->ext = assert->ext.mask;
+	memset(f, 0, sizeof(*f));
 }
 
 static int
@@ -89,44 +216,20 @@ fido_dev_get_assert_tx(fido_dev_t *dev, fido_assert_t *assert,
 	fido_opt_t	 uv = assert->uv;
 	cbor_item_t	*argv[7];
 	const uint8_t	 cmd = CTAP_CBOR_ASSERT;
+	size_t		 cdh_off = 0;
 	int		 r;
 
 	memset(argv, 0, sizeof(argv));
 	memset(&f, 0, sizeof(f));
 
 	/* do we have everything we need? */
-	if (assert->rp_id == NULL || assert->cdh.ptr == NULL) {
+	if (assert->rp_id == NULL || fido_blob_is_empty(&assert->cdh)) {
 		fido_log_debug("%s: rp_id=%p, cdh.ptr=%p", __func__,
 		    (void *)assert->rp_id, (void *)assert->cdh.ptr);
 		r = FIDO_ERR_INVALID_ARGUMENT;
 		goto fail;
 	}
 
-	if ((argv[0] = cbor_build_string(assert->rp_id)) == NULL ||
-	    (argv[1] = fido_blob_encode(&assert->cdh)) == NULL) {
-		fido_log_debug("%s: cbor encode", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
-	}
-
-	/* allowed credentials */
-	if (assert->allow_list.len) {
-		const fido_blob_array_t *cl = &assert->allow_list;
-		if ((argv[2] = cbor_encode_pubkey_list(cl)) == NULL) {
-			fido_log_debug("%s: cbor_encode_pubkey_list", __func__);
-			r = FIDO_ERR_INTERNAL;
-			goto fail;
-		}
-	}
-
-	if (assert->ext.mask)
-		if ((argv[3] = cbor_encode_assert_ext(dev, &assert->ext, ecdh,
-		    pk)) == NULL) {
-			fido_log_debug("%s: cbor_encode_assert_ext", __func__);
-			r = FIDO_ERR_INTERNAL;
-			goto fail;
-		}
-
 	/* user verification */
 	if (pin != NULL || (uv == FIDO_OPT_TRUE &&
 	    fido_dev_supports_permissions(dev))) {
@@ -138,26 +241,50 @@ fido_dev_get_assert_tx(fido_dev_t *dev, fido_assert_t *assert,
 		uv = FIDO_OPT_OMIT;
 	}
 
-	/* options */
-	if (assert->up != FIDO_OPT_OMIT || uv != FIDO_OPT_OMIT)
-		if ((argv[4] = cbor_encode_assert_opt(assert->up, uv)) == NULL) {
-			fido_log_debug("%s: cbor_encode_assert_opt", __func__);
+	/* patch the kept frame */
+	if (tmpl_match(assert, uv, argv[5], argv[6])) {
+		tmpl_patch(assert, argv[5]);
+		if (fido_tx(dev, CTAP_CMD_CBOR, assert->tmpl.frame.ptr,
+		    assert->tmpl.frame.len, ms) < 0) {
+			fido_log_debug("%s: fido_tx", __func__);
+			r = FIDO_ERR_TX;
+			goto fail;
+		}
+		r = FIDO_OK;
+		goto fail;
+	}
+
+	/* allowed credentials; kept encoded for reuse on other devices */
+	if (assert->allow_list.len && assert->allow_cbor.ptr == NULL &&
+	    cbor_encode_pubkey_list(&assert->allow_list,
+	    &assert->allow_cbor) < 0) {
+		fido_log_debug("%s: cbor_encode_pubkey_list", __func__);
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
+	if (assert->ext.mask)
+		if ((argv[3] = cbor_encode_assert_ext(dev, &assert->ext, ecdh,
+		    pk)) == NULL) {
+			fido_log_debug("%s: cbor_encode_assert_ext", __func__);
 			r = FIDO_ERR_INTERNAL;
 			goto fail;
 		}
 
 	/* frame and transmit */
-	if (cbor_build_frame(cmd, argv, nitems(argv), &f) < 0 ||
+	if (cbor_build_assert_frame(assert, uv, argv, &f, &cdh_off) < 0 ||
 	    fido_tx(dev, CTAP_CMD_CBOR, f.ptr, f.len, ms) < 0) {
 		fido_log_debug("%s: fido_tx", __func__);
 		r = FIDO_ERR_TX;
 		goto fail;
 	}
 
+	tmpl_store(assert, uv, argv[5], argv[6], &f, cdh_off);
+
 	r = FIDO_OK;
 fail:
 	cbor_vector_free(argv, nitems(argv));
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return (r);
 }
@@ -166,48 +293,50 @@ static int
 fido_dev_get_assert_rx(fido_dev_t *dev, fido_assert_t *assert, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
+	uint64_t	 n = 1; /* numberOfCredentials */
 	int		 r;
 
 	fido_assert_reset_rx(assert);
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
 	}
 
 	/* start with room for a single assertion */
-	if ((assert->stmt = calloc(1, sizeof(fido_assert_stmt))) == NULL) {
+	if ((assert->stmt = fido_calloc(1, sizeof(fido_assert_stmt))) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 	assert->stmt_len = 0;
 	assert->stmt_cnt = 1;
 
-	/* adjust as needed */
-	if ((r = cbor_parse_reply(msg, (size_t)msglen, assert,
-	    adjust_assert_count)) != FIDO_OK) {
-		fido_log_debug("%s: adjust_assert_count", __func__);
+	/* parse the first assertion */
+	if ((r = parse_assert_reply(assert, &assert->stmt[0], msg,
+	    (size_t)msglen, &n)) != FIDO_OK) {
+		fido_log_debug("%s: parse_assert_reply", __func__);
 		goto out;
 	}
 
-	/* parse the first assertion */
-	if ((r = cbor_parse_reply(msg, (size_t)msglen, &assert->stmt[0],
-	    parse_assert_reply)) != FIDO_OK) {
-		fido_log_debug("%s: parse_assert_reply", __func__);
+	/* adjust as needed */
+	if (n != 1 && adjust_assert_count(assert, n) < 0) {
+		fido_log_debug("%s: adjust_assert_count", __func__);
+		r = FIDO_ERR_RX_INVALID_CBOR;
 		goto out;
 	}
 	assert->stmt_len = 1;
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
@@ -229,15 +358,16 @@ static int
 fido_get_next_assert_rx(fido_dev_t *dev, fido_assert_t *assert, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -251,19 +381,58 @@ fido_get_next_assert_rx(fido_dev_t *dev, fido_assert_t *assert, int *ms)
 		goto out;
 	}
 
-	if ((r = cbor_parse_reply(msg, (size_t)msglen,
-	    &assert->stmt[assert->stmt_len], parse_assert_reply)) != FIDO_OK) {
+	if ((r = parse_assert_reply(assert, &assert->stmt[assert->stmt_len],
+	    msg, (size_t)msglen, NULL)) != FIDO_OK) {
 		fido_log_debug("%s: parse_assert_reply", __func__);
 		goto out;
 	}
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
 
+/*
+ * Fetch up to 'n' of the assertions still held by the authenticator. The
+ * statements were allocated from numberOfCredentials when the first one
+ * was received; those not yet fetched stay empty, and out of reach of the
+ * accessors, until fido_dev_get_assert_next() asks for them. Fetching
+ * more than one is a sequence fido_dev_set_lock() applies to.
+ */
+static int
+fido_get_next_assert_wait(fido_dev_t *dev, fido_assert_t *assert, size_t n,
+    int *ms)
+{
+	const bool	lock = n > 1 && assert->stmt_len + 1 < assert->stmt_cnt;
+	int		r = FIDO_OK;
+
+	assert->stmt_more = false;
+	if (lock)
+		fido_dev_lock_begin(dev, ms);
+	for (; n > 0 && assert->stmt_len < assert->stmt_cnt; n--) {
+		if ((r = fido_get_next_assert_tx(dev, ms)) != FIDO_OK ||
+		    (r = fido_get_next_assert_rx(dev, assert, ms)) != FIDO_OK)
+			break;
+		assert->stmt_len++;
+	}
+	if (lock)
+		fido_dev_lock_end(dev);
+	if (r != FIDO_OK)
+		return (r);
+	assert->stmt_more = assert->stmt_len < assert->stmt_cnt;
+
+	return (FIDO_OK);
+}
+
+/* the number of assertions to fetch after the first */
+static size_t
+fetch_count(const fido_assert_t *assert)
+{
+	return (assert->stmt_fetch ? assert->stmt_fetch - 1 : SIZE_MAX);
+}
+
 static int
 fido_dev_get_assert_wait(fido_dev_t *dev, fido_assert_t *assert,
     const es256_pk_t *pk, const fido_blob_t *ecdh, const char *pin, int *ms)
@@ -275,42 +444,151 @@ fido_dev_get_assert_wait(fido_dev_t *dev, fido_assert_t *assert,
 	    (r = fido_dev_get_assert_rx(dev, assert, ms)) != FIDO_OK)
 		return (r);
 
-	while (assert->stmt_len < assert->stmt_cnt) {
-		if ((r = fido_get_next_assert_tx(dev, ms)) != FIDO_OK ||
-		    (r = fido_get_next_assert_rx(dev, assert, ms)) != FIDO_OK)
-			return (r);
-		assert->stmt_len++;
-	}
-
-	return (FIDO_OK);
+	return (fido_get_next_assert_wait(dev, assert, fetch_count(assert),
+	    ms));
 }
 
+/*
+ * The outputs of statements 'from' onwards, decrypted with a single cipher
+ * context.
+ */
 static int
 decrypt_hmac_secrets(const fido_dev_t *dev, fido_assert_t *assert,
-    const fido_blob_t *key)
+    const fido_blob_t *key, size_t from)
 {
-	for (size_t i = 0; i < assert->stmt_cnt; i++) {
+	EVP_CIPHER_CTX	*ctx = NULL;
+	int		 ok = -1;
+
+	for (size_t i = from; i < assert->stmt_len; i++) {
 		fido_assert_stmt *stmt = &assert->stmt[i];
-		if (stmt->authdata_ext.hmac_secret_enc.ptr != NULL) {
-			if (aes256_cbc_dec(dev, key,
-			    &stmt->authdata_ext.hmac_secret_enc,
-			    &stmt->hmac_secret) < 0) {
-				fido_log_debug("%s: aes256_cbc_dec %zu",
-				    __func__, i);
-				return (-1);
+		if (stmt->authdata_ext.hmac_secret_enc.ptr == NULL)
+			continue;
+		if (aes256_cbc_dec_ctx(dev, &ctx, key,
+		    &stmt->authdata_ext.hmac_secret_enc,
+		    &stmt->hmac_secret) < 0) {
+			fido_log_debug("%s: aes256_cbc_dec_ctx %zu", __func__,
+			    i);
+			goto fail;
+		}
+	}
+
+	ok = 0;
+fail:
+	EVP_CIPHER_CTX_free(ctx);
+
+	return (ok);
+}
+
+/*
+ * Allow lists longer than the authenticator's maxCredCountInList are split
+ * into batches. Each batch is probed with a silent (up=false, no uv, no
+ * extensions) getAssertion; the first batch to yield a credential is then
+ * used for the actual request, so that user presence is only collected
+ * once. Credential ids longer than maxCredIdLength are left out.
+ */
+static int
+fido_dev_get_assert_batched(fido_dev_t *dev, fido_assert_t *assert,
+    const es256_pk_t *pk, const fido_blob_t *ecdh, const char *pin, int *ms)
+{
+	const fido_blob_array_t	 list = assert->allow_list;
+	const fido_blob_t	 list_cbor = assert->allow_cbor;
+	const fido_assert_tmpl_t tmpl = assert->tmpl;
+	const fido_opt_t	 up = assert->up;
+	const fido_opt_t	 uv = assert->uv;
+	const int		 ext_mask = assert->ext.mask;
+	const uint64_t		 maxlen = dev->info->maxcredidlen;
+	const size_t		 max = (size_t)dev->info->maxcredcntlst;
+	fido_blob_t		*batch;
+	size_t			 i = 0, n;
+	int			 r = FIDO_ERR_NO_CREDENTIALS;
+
+	if ((batch = fido_calloc(max, sizeof(*batch))) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	memset(&assert->allow_cbor, 0, sizeof(assert->allow_cbor));
+	memset(&assert->tmpl, 0, sizeof(assert->tmpl));
+	assert->allow_list.ptr = batch;
+
+	while (i < list.len) {
+		for (n = 0; i < list.len && n < max; i++) {
+			if (maxlen && list.ptr[i].len > maxlen) {
+				fido_log_debug("%s: skipping id %zu, len=%zu",
+				    __func__, i, list.ptr[i].len);
+				continue;
 			}
+			batch[n++] = list.ptr[i];
 		}
+		if (n == 0)
+			break;
+		assert->allow_list.len = n;
+		assert->up = FIDO_OPT_FALSE;
+		assert->uv = FIDO_OPT_OMIT;
+		assert->ext.mask = 0;
+		if ((r = fido_dev_get_assert_tx(dev, assert, NULL, NULL, NULL,
+		    ms)) == FIDO_OK)
+			r = fido_dev_get_assert_rx(dev, assert, ms);
+		assert->up = up;
+		assert->uv = uv;
+		assert->ext.mask = ext_mask;
+		if (r == FIDO_OK) {
+			fido_log_debug("%s: batch ending at %zu", __func__, i);
+			r = fido_dev_get_assert_wait(dev, assert, pk, ecdh,
+			    pin, ms);
+			break;
+		}
+		fido_blob_reset(&assert->allow_cbor);
+		tmpl_reset(assert);
+		if (r != FIDO_ERR_NO_CREDENTIALS)
+			break;
 	}
 
-	return (0);
+	fido_blob_reset(&assert->allow_cbor);
+	tmpl_reset(assert);
+	assert->allow_list = list;
+	assert->allow_cbor = list_cbor;
+	assert->tmpl = tmpl;
+	fido_free(batch);
+
+	return (r);
 }
 
+/*
+ * Whether any of the 'n' credential ids at 'ids' is known to the
+ * authenticator for 'rp_id', found with a silent (up=false, no uv, no
+ * extensions) getAssertion; FIDO_ERR_NO_CREDENTIALS if none is.
+ */
 int
-fido_dev_get_assert(fido_dev_t *dev, fido_assert_t *assert, const char *pin)
+fido_dev_probe_creds(fido_dev_t *dev, const char *rp_id,
+    const fido_blob_t *cdh, fido_blob_t *ids, size_t n, int *ms)
+{
+	fido_assert_t	assert;
+	int		r;
+
+	memset(&assert, 0, sizeof(assert));
+	assert.rp_id = (char *)(uintptr_t)rp_id; /* not freed */
+	assert.cdh = *cdh; /* not freed */
+	assert.allow_list.ptr = ids;
+	assert.allow_list.len = n;
+	assert.up = FIDO_OPT_FALSE;
+	assert.uv = FIDO_OPT_OMIT;
+
+	if ((r = fido_dev_get_assert_tx(dev, &assert, NULL, NULL, NULL,
+	    ms)) == FIDO_OK)
+		r = fido_dev_get_assert_rx(dev, &assert, ms);
+
+	fido_blob_reset(&assert.allow_cbor);
+	tmpl_reset(&assert);
+	fido_assert_reset_rx(&assert);
+
+	return (r);
+}
+
+static int
+get_assert(fido_dev_t *dev, fido_assert_t *assert, const char *pin)
 {
 	fido_blob_t	*ecdh = NULL;
 	es256_pk_t	*pk = NULL;
-	int		 ms = dev->timeout_ms;
+	int		 ms = fido_time_budget(dev->timeout_ms);
 	int		 r;
 
 #ifdef USE_WINHELLO
@@ -318,16 +596,25 @@ fido_dev_get_assert(fido_dev_t *dev, fido_assert_t *assert, const char *pin)
 		return (fido_winhello_get_assert(dev, assert, pin, ms));
 #endif
 
-	if (assert->rp_id == NULL || assert->cdh.ptr == NULL) {
+	if (assert->rp_id == NULL || fido_blob_is_empty(&assert->cdh)) {
 		fido_log_debug("%s: rp_id=%p, cdh.ptr=%p", __func__,
 		    (void *)assert->rp_id, (void *)assert->cdh.ptr);
 		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
+	if ((r = fido_dev_get_deferred_info(dev, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		return (r);
+	}
+
 	if (fido_dev_is_fido2(dev) == false) {
 		if (pin != NULL || assert->ext.mask != 0)
 			return (FIDO_ERR_UNSUPPORTED_OPTION);
+#ifdef FIDO_NO_U2F
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+#else
 		return (u2f_authenticate(dev, assert, &ms));
+#endif
 	}
 
 	if (pin != NULL || (assert->uv == FIDO_OPT_TRUE &&
@@ -339,9 +626,15 @@ fido_dev_get_assert(fido_dev_t *dev, fido_assert_t *assert, const char *pin)
 		}
 	}
 
-	r = fido_dev_get_assert_wait(dev, assert, pk, ecdh, pin, &ms);
+	if (dev->info != NULL && dev->info->maxcredcntlst != 0 &&
+	    dev->info->maxcredcntlst <= SIZE_MAX &&
+	    assert->allow_list.len > dev->info->maxcredcntlst)
+		r = fido_dev_get_assert_batched(dev, assert, pk, ecdh, pin,
+		    &ms);
+	else
+		r = fido_dev_get_assert_wait(dev, assert, pk, ecdh, pin, &ms);
 	if (r == FIDO_OK && (assert->ext.mask & FIDO_EXT_HMAC_SECRET))
-		if (decrypt_hmac_secrets(dev, assert, ecdh) < 0) {
+		if (decrypt_hmac_secrets(dev, assert, ecdh, 0) < 0) {
 			fido_log_debug("%s: decrypt_hmac_secrets", __func__);
 			r = FIDO_ERR_INTERNAL;
 			goto fail;
@@ -354,6 +647,277 @@ fail:
 	return (r);
 }
 
+int
+fido_dev_get_assert(fido_dev_t *dev, fido_assert_t *assert, const char *pin)
+{
+	fido_trace_t span;
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = get_assert(dev, assert, pin);
+
+	return (fido_trace_end(&span, r));
+}
+
+int
+fido_dev_get_assert_submit(fido_dev_t *dev, fido_assert_t *assert,
+    const char *pin)
+{
+	fido_blob_t	*ecdh = NULL;
+	es256_pk_t	*pk = NULL;
+	int		 ms = fido_time_budget(dev->timeout_ms);
+	int		 r;
+
+#ifdef USE_WINHELLO
+	if (dev->flags & FIDO_DEV_WINHELLO)
+		return (fido_winhello_get_assert_submit(dev, assert, pin, ms));
+#endif
+
+	if (assert->rp_id == NULL || fido_blob_is_empty(&assert->cdh)) {
+		fido_log_debug("%s: rp_id=%p, cdh.ptr=%p", __func__,
+		    (void *)assert->rp_id, (void *)assert->cdh.ptr);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	fido_dev_async_reset(dev);
+
+	if ((r = fido_dev_get_deferred_info(dev, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		return (r);
+	}
+
+	/* u2f authentication is driven by repeated transmissions */
+	if (fido_dev_is_fido2(dev) == false)
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+
+	if (pin != NULL || (assert->uv == FIDO_OPT_TRUE &&
+	    fido_dev_supports_permissions(dev)) ||
+	    (assert->ext.mask & FIDO_EXT_HMAC_SECRET)) {
+		if ((r = fido_do_ecdh(dev, &pk, &ecdh, &ms)) != FIDO_OK) {
+			fido_log_debug("%s: fido_do_ecdh", __func__);
+			goto fail;
+		}
+	}
+
+	if ((r = fido_dev_get_assert_tx(dev, assert, pk, ecdh, pin,
+	    &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_assert_tx", __func__);
+		goto fail;
+	}
+
+	dev->async_cmd = CTAP_CBOR_ASSERT;
+	dev->async_ecdh = ecdh;
+	ecdh = NULL;
+fail:
+	es256_pk_free(&pk);
+	fido_blob_free(&ecdh);
+
+	return (r);
+}
+
+int
+fido_dev_get_assert_complete(fido_dev_t *dev, fido_assert_t *assert)
+{
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+#ifdef USE_WINHELLO
+	if (dev->flags & FIDO_DEV_WINHELLO)
+		return (fido_winhello_get_assert_complete(dev, assert));
+#endif
+	if (dev->async_cmd != CTAP_CBOR_ASSERT) {
+		fido_log_debug("%s: async_cmd=0x%02x", __func__,
+		    dev->async_cmd);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	if ((r = fido_dev_get_assert_rx(dev, assert, &ms)) != FIDO_OK ||
+	    (r = fido_get_next_assert_wait(dev, assert, fetch_count(assert),
+	    &ms)) != FIDO_OK)
+		goto fail;
+
+	if (assert->ext.mask & FIDO_EXT_HMAC_SECRET)
+		if (decrypt_hmac_secrets(dev, assert, dev->async_ecdh, 0) < 0) {
+			fido_log_debug("%s: decrypt_hmac_secrets", __func__);
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+
+	r = FIDO_OK;
+fail:
+	fido_dev_async_reset(dev);
+
+	return (r);
+}
+
+int
+fido_dev_get_assert_next(fido_dev_t *dev, fido_assert_t *assert, size_t n)
+{
+	size_t	from = assert->stmt_len;
+	int	ms = fido_time_budget(dev->timeout_ms);
+	int	r;
+
+	if (assert->stmt_more == false || n == 0) {
+		fido_log_debug("%s: stmt_more=%d, n=%zu", __func__,
+		    assert->stmt_more, n);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+	/* the outputs are encrypted with the request's shared secret */
+	if ((assert->ext.mask & FIDO_EXT_HMAC_SECRET) && dev->ecdh == NULL) {
+		fido_log_debug("%s: no shared secret", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	if ((r = fido_get_next_assert_wait(dev, assert, n, &ms)) != FIDO_OK)
+		return (r);
+	if (assert->ext.mask & FIDO_EXT_HMAC_SECRET)
+		if (decrypt_hmac_secrets(dev, assert, dev->ecdh, from) < 0) {
+			fido_log_debug("%s: decrypt_hmac_secrets", __func__);
+			return (FIDO_ERR_INTERNAL);
+		}
+
+	return (FIDO_OK);
+}
+
+/*
+ * The hmac-secret output of a single credential, decrypted straight into
+ * 'item'. The request carries a one-entry allow list, so the reply holds
+ * a single assertion and no authenticatorGetNextAssertion is needed; its
+ * signature is not of interest and is left unverified.
+ */
+static int
+hmac_secret_get(fido_dev_t *dev, fido_assert_t *assert,
+    fido_hmac_secret_item_t *item, const es256_pk_t *pk,
+    const fido_blob_t *ecdh, const char *pin, int *ms)
+{
+	fido_blob_t	*enc, secret;
+	int		 r;
+
+	memset(&secret, 0, sizeof(secret));
+
+	if ((r = fido_assert_empty_allow_list(assert)) != FIDO_OK ||
+	    (r = fido_assert_allow_cred(assert, item->cred_ptr,
+	    item->cred_len)) != FIDO_OK ||
+	    (r = fido_assert_set_hmac_salt(assert, item->salt_ptr,
+	    item->salt_len)) != FIDO_OK)
+		return (r);
+	if ((r = fido_dev_get_assert_tx(dev, assert, pk, ecdh, pin,
+	    ms)) != FIDO_OK ||
+	    (r = fido_dev_get_assert_rx(dev, assert, ms)) != FIDO_OK)
+		return (r);
+
+	enc = &assert->stmt[0].authdata_ext.hmac_secret_enc;
+	if (enc->ptr == NULL) {
+		fido_log_debug("%s: no hmac-secret", __func__);
+		r = FIDO_ERR_UNSUPPORTED_EXTENSION;
+		goto fail;
+	}
+	if (aes256_cbc_dec(dev, ecdh, enc, &secret) < 0 ||
+	    secret.len != item->salt_len) {
+		fido_log_debug("%s: aes256_cbc_dec", __func__);
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	memcpy(item->secret, secret.ptr, secret.len);
+	item->secret_len = secret.len;
+
+	r = FIDO_OK;
+fail:
+	fido_blob_reset(&secret);
+	fido_assert_reset_rx(assert);
+
+	return (r);
+}
+
+static int
+hmac_secret(fido_dev_t *dev, const char *rp_id, fido_opt_t up,
+    fido_hmac_secret_item_t *v, size_t n, const char *pin)
+{
+	fido_assert_t	*assert = NULL;
+	fido_blob_t	*ecdh = NULL;
+	es256_pk_t	*pk = NULL;
+	unsigned char	 cdh[32];
+	int		 ms = fido_time_budget(dev->timeout_ms);
+	int		 r;
+
+	for (size_t i = 0; i < n; i++) {
+		v[i].secret_len = 0;
+		v[i].r = FIDO_ERR_INTERNAL;
+	}
+
+	if ((r = fido_dev_get_deferred_info(dev, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		return (r);
+	}
+	if (fido_dev_is_fido2(dev) == false ||
+	    (dev->flags & FIDO_DEV_WINHELLO))
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+
+	/* the output does not depend on the client data hash */
+	if (fido_get_nonce(cdh, sizeof(cdh)) < 0)
+		return (FIDO_ERR_INTERNAL);
+
+	if ((assert = fido_assert_new()) == NULL) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	if ((r = fido_assert_set_rp(assert, rp_id)) != FIDO_OK ||
+	    (r = fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh))) != FIDO_OK ||
+	    (r = fido_assert_set_up(assert, up)) != FIDO_OK)
+		goto fail;
+	assert->ext.mask = FIDO_EXT_HMAC_SECRET;
+
+	/* one key agreement, reused for every credential */
+	if ((r = fido_do_ecdh(dev, &pk, &ecdh, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_do_ecdh", __func__);
+		goto fail;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		v[i].r = hmac_secret_get(dev, assert, &v[i], pk, ecdh, pin,
+		    &ms);
+		/* credentials the device does not hold fail individually */
+		if (v[i].r != FIDO_OK && v[i].r != FIDO_ERR_NO_CREDENTIALS) {
+			fido_log_debug("%s: item %zu: %d", __func__, i,
+			    v[i].r);
+			r = v[i].r;
+			goto fail;
+		}
+	}
+
+	r = FIDO_OK;
+fail:
+	explicit_bzero(cdh, sizeof(cdh));
+	fido_assert_free(&assert);
+	es256_pk_free(&pk);
+	fido_blob_free(&ecdh);
+
+	return (r);
+}
+
+int
+fido_dev_hmac_secret(fido_dev_t *dev, const char *rp_id, fido_opt_t up,
+    fido_hmac_secret_item_t *v, size_t n, const char *pin)
+{
+	fido_trace_t span;
+	int r;
+
+	if (rp_id == NULL || v == NULL || n == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	for (size_t i = 0; i < n; i++)
+		if (v[i].cred_ptr == NULL || v[i].cred_len == 0 ||
+		    v[i].salt_ptr == NULL || (v[i].salt_len != 32 &&
+		    v[i].salt_len != 64))
+			return (FIDO_ERR_INVALID_ARGUMENT);
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = hmac_secret(dev, rp_id, up, v, n, pin);
+
+	return (fido_trace_end(&span, r));
+}
+#endif /* !FIDO_VERIFY_ONLY */
+
 int
 fido_check_flags(uint8_t flags, fido_opt_t up, fido_opt_t uv)
 {
@@ -390,60 +954,51 @@ check_extensions(int authdata_ext, int ext)
 }
 
 static int
-get_es256_hash(fido_blob_t *dgst, const fido_blob_t *clientdata,
+get_digest(const EVP_MD *md, fido_blob_t *dgst, const fido_blob_t *clientdata,
     const fido_blob_t *authdata)
 {
-	const EVP_MD	*md;
 	EVP_MD_CTX	*ctx = NULL;
+	int		 md_len;
+	int		 ok = -1;
 
-	if (dgst->len < SHA256_DIGEST_LENGTH ||
-	    (md = EVP_sha256()) == NULL ||
-	    (ctx = EVP_MD_CTX_new()) == NULL ||
-	    EVP_DigestInit_ex(ctx, md, NULL) != 1 ||
-	    EVP_DigestUpdate(ctx, authdata->ptr, authdata->len) != 1 ||
-	    EVP_DigestUpdate(ctx, clientdata->ptr, clientdata->len) != 1 ||
-	    EVP_DigestFinal_ex(ctx, dgst->ptr, NULL) != 1) {
-		EVP_MD_CTX_free(ctx);
-		return (-1);
+	if (md == NULL || (md_len = EVP_MD_size(md)) <= 0 ||
+	    (dgst->ptr = fido_calloc(1, (size_t)md_len)) == NULL) {
+		fido_log_debug("%s: calloc", __func__);
+		goto fail;
 	}
-	dgst->len = SHA256_DIGEST_LENGTH;
+	dgst->len = (size_t)md_len;
 
-	EVP_MD_CTX_free(ctx);
-
-	return (0);
-}
-
-static int
-get_es384_hash(fido_blob_t *dgst, const fido_blob_t *clientdata,
-    const fido_blob_t *authdata)
-{
-	const EVP_MD	*md;
-	EVP_MD_CTX	*ctx = NULL;
-
-	if (dgst->len < SHA384_DIGEST_LENGTH ||
-	    (md = EVP_sha384()) == NULL ||
-	    (ctx = EVP_MD_CTX_new()) == NULL ||
+	if ((ctx = EVP_MD_CTX_new()) == NULL ||
 	    EVP_DigestInit_ex(ctx, md, NULL) != 1 ||
 	    EVP_DigestUpdate(ctx, authdata->ptr, authdata->len) != 1 ||
 	    EVP_DigestUpdate(ctx, clientdata->ptr, clientdata->len) != 1 ||
 	    EVP_DigestFinal_ex(ctx, dgst->ptr, NULL) != 1) {
-		EVP_MD_CTX_free(ctx);
-		return (-1);
+		fido_log_debug("%s: EVP_Digest", __func__);
+		goto fail;
 	}
-	dgst->len = SHA384_DIGEST_LENGTH;
 
+	ok = 0;
+fail:
 	EVP_MD_CTX_free(ctx);
 
-	return (0);
+	if (ok < 0)
+		fido_blob_reset(dgst);
+
+	return (ok);
 }
 
+#ifndef FIDO_NO_EDDSA
 static int
-get_eddsa_hash(fido_blob_t *dgst, const fido_blob_t *clientdata,
+get_eddsa_msg(fido_blob_t *dgst, const fido_blob_t *clientdata,
     const fido_blob_t *authdata)
 {
+	/* eddsa signs the message itself; it cannot be hashed in pieces */
 	if (SIZE_MAX - authdata->len < clientdata->len ||
-	    dgst->len < authdata->len + clientdata->len)
+	    (dgst->ptr = fido_malloc(authdata->len +
+	    clientdata->len)) == NULL) {
+		fido_log_debug("%s: malloc", __func__);
 		return (-1);
+	}
 
 	memcpy(dgst->ptr, authdata->ptr, authdata->len);
 	memcpy(dgst->ptr + authdata->len, clientdata->ptr, clientdata->len);
@@ -451,131 +1006,309 @@ get_eddsa_hash(fido_blob_t *dgst, const fido_blob_t *clientdata,
 
 	return (0);
 }
+#endif
 
 int
 fido_get_signed_hash(int cose_alg, fido_blob_t *dgst,
-    const fido_blob_t *clientdata, const fido_blob_t *authdata_cbor)
+    const fido_blob_t *clientdata, const fido_blob_t *authdata)
 {
-	cbor_item_t		*item = NULL;
-	fido_blob_t		 authdata;
-	struct cbor_load_result	 cbor;
-	int			 ok = -1;
+	int ok = -1;
 
 	fido_log_debug("%s: cose_alg=%d", __func__, cose_alg);
 
-	if ((item = cbor_load(authdata_cbor->ptr, authdata_cbor->len,
-	    &cbor)) == NULL || cbor_isa_bytestring(item) == false ||
-	    cbor_bytestring_is_definite(item) == false) {
+	if (dgst->ptr != NULL || authdata->ptr == NULL || authdata->len == 0) {
 		fido_log_debug("%s: authdata", __func__);
-		goto fail;
+		return (-1);
 	}
-	authdata.ptr = cbor_bytestring_handle(item);
-	authdata.len = cbor_bytestring_length(item);
 
 	switch (cose_alg) {
 	case COSE_ES256:
+#ifndef FIDO_NO_RS256
 	case COSE_RS256:
-		ok = get_es256_hash(dgst, clientdata, &authdata);
+#endif
+		ok = get_digest(fido_md_sha256(), dgst, clientdata, authdata);
 		break;
+#ifndef FIDO_NO_ES384
 	case COSE_ES384:
-		ok = get_es384_hash(dgst, clientdata, &authdata);
+		ok = get_digest(fido_md_sha384(), dgst, clientdata, authdata);
 		break;
+#endif
+#ifndef FIDO_NO_EDDSA
 	case COSE_EDDSA:
-		ok = get_eddsa_hash(dgst, clientdata, &authdata);
+		ok = get_eddsa_msg(dgst, clientdata, authdata);
 		break;
+#endif
 	default:
 		fido_log_debug("%s: unknown cose_alg", __func__);
 		break;
 	}
-fail:
-	if (item != NULL)
-		cbor_decref(&item);
 
 	return (ok);
 }
 
-int
-fido_assert_verify(const fido_assert_t *assert, size_t idx, int cose_alg,
-    const void *pk)
+/*
+ * The signed hash of a statement is kept once computed, one per digest, so
+ * that verifying against several keys hashes once. The slots live in the
+ * statement array, which the assertion reaches through a non-const
+ * pointer, as with stmt_fields(). Verification may run in several threads
+ * at once; a new hash is published with an atomic compare-and-swap, and
+ * the loser's copy freed.
+ * The hashes are dropped whenever the authdata or the cdh changes.
+ */
+static int
+dgst_slot(int cose_alg)
 {
-	unsigned char		 buf[1024]; /* XXX */
-	fido_blob_t		 dgst;
-	const fido_assert_stmt	*stmt = NULL;
-	int			 ok = -1;
-	int			 r;
+	switch (cose_alg) {
+	case COSE_ES256:
+	case COSE_RS256:
+		return (0);
+	case COSE_ES384:
+		return (1);
+	case COSE_EDDSA:
+		return (2);
+	default:
+		return (-1);
+	}
+}
 
-	dgst.ptr = buf;
-	dgst.len = sizeof(buf);
+static fido_blob_t *
+dgst_load(fido_blob_t **p)
+{
+#if defined(_MSC_VER)
+	return (_InterlockedCompareExchangePointer((void * volatile *)p, NULL,
+	    NULL));
+#else
+	return (__atomic_load_n(p, __ATOMIC_ACQUIRE));
+#endif
+}
 
-	if (idx >= assert->stmt_len || pk == NULL) {
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto out;
-	}
+/* store 'dgst' in an empty slot; false if another thread got there first */
+static bool
+dgst_publish(fido_blob_t **p, fido_blob_t *dgst)
+{
+#if defined(_MSC_VER)
+	return (_InterlockedCompareExchangePointer((void * volatile *)p, dgst,
+	    NULL) == NULL);
+#else
+	fido_blob_t *expected = NULL;
 
-	stmt = &assert->stmt[idx];
+	return (__atomic_compare_exchange_n(p, &expected, dgst, false,
+	    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+#endif
+}
+
+static void
+fido_assert_clean_dgst(fido_assert_stmt *stmt)
+{
+	for (size_t i = 0; i < nitems(stmt->dgst); i++)
+		fido_blob_free(&stmt->dgst[i]);
+}
+
+static void
+fido_assert_clean_dgst_all(fido_assert_t *assert)
+{
+	for (size_t i = 0; i < assert->stmt_cnt; i++)
+		fido_assert_clean_dgst(&assert->stmt[i]);
+}
+
+static int
+get_signed_hash(const fido_assert_t *assert, size_t idx, int cose_alg,
+    const fido_blob_t **dgst)
+{
+	fido_assert_stmt	*stmt = &assert->stmt[idx];
+	fido_blob_t		**cache, *d;
+	int			  slot;
 
 	/* do we have everything we need? */
-	if (assert->cdh.ptr == NULL || assert->rp_id == NULL ||
-	    stmt->authdata_cbor.ptr == NULL || stmt->sig.ptr == NULL) {
+	if (fido_blob_is_empty(&assert->cdh) || assert->rp_id == NULL ||
+	    fido_blob_is_empty(&stmt->authdata_raw) ||
+	    fido_blob_is_empty(&stmt->sig)) {
 		fido_log_debug("%s: cdh=%p, rp_id=%s, authdata=%p, sig=%p",
 		    __func__, (void *)assert->cdh.ptr, assert->rp_id,
-		    (void *)stmt->authdata_cbor.ptr, (void *)stmt->sig.ptr);
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto out;
+		    (void *)stmt->authdata_raw.ptr, (void *)stmt->sig.ptr);
+		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
 	if (fido_check_flags(stmt->authdata.flags, assert->up,
 	    assert->uv) < 0) {
 		fido_log_debug("%s: fido_check_flags", __func__);
-		r = FIDO_ERR_INVALID_PARAM;
-		goto out;
+		return (FIDO_ERR_INVALID_PARAM);
 	}
 
 	if (check_extensions(stmt->authdata_ext.mask, assert->ext.mask) < 0) {
 		fido_log_debug("%s: check_extensions", __func__);
-		r = FIDO_ERR_INVALID_PARAM;
-		goto out;
+		return (FIDO_ERR_INVALID_PARAM);
 	}
 
-	if (fido_check_rp_id(assert->rp_id, stmt->authdata.rp_id_hash) != 0) {
+	if (fido_check_rp_id(assert->rp_id, &assert->rp_id_hash,
+	    stmt->authdata.rp_id_hash) != 0) {
 		fido_log_debug("%s: fido_check_rp_id", __func__);
-		r = FIDO_ERR_INVALID_PARAM;
-		goto out;
+		return (FIDO_ERR_INVALID_PARAM);
 	}
 
-	if (fido_get_signed_hash(cose_alg, &dgst, &assert->cdh,
-	    &stmt->authdata_cbor) < 0) {
+	if ((slot = dgst_slot(cose_alg)) < 0) {
+		fido_log_debug("%s: unknown cose_alg %d", __func__, cose_alg);
+		return (FIDO_ERR_INTERNAL);
+	}
+	cache = &stmt->dgst[slot];
+	if ((*dgst = dgst_load(cache)) != NULL)
+		return (FIDO_OK);
+
+	if ((d = fido_blob_new()) == NULL ||
+	    fido_get_signed_hash(cose_alg, d, &assert->cdh,
+	    &stmt->authdata_raw) < 0) {
 		fido_log_debug("%s: fido_get_signed_hash", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto out;
+		fido_blob_free(&d);
+		return (FIDO_ERR_INTERNAL);
+	}
+	if (!dgst_publish(cache, d)) {
+		fido_blob_free(&d);
+		d = dgst_load(cache);
+	}
+	*dgst = d;
+
+	return (FIDO_OK);
+}
+
+static size_t
+pk_len(int cose_alg)
+{
+	switch (cose_alg) {
+	case COSE_ES256:
+		return (sizeof(es256_pk_t));
+	case COSE_ES384:
+		return (sizeof(es384_pk_t));
+	case COSE_RS256:
+		return (sizeof(rs256_pk_t));
+	case COSE_EDDSA:
+		return (sizeof(eddsa_pk_t));
+	default:
+		return (0);
 	}
+}
+
+int
+fido_assert_verify(const fido_assert_t *assert, size_t idx, int cose_alg,
+    const void *pk)
+{
+	const fido_blob_t	*dgst;
+	const fido_assert_stmt	*stmt = NULL;
+	fido_prof_t		 prof;
+	unsigned char		 key[SHA256_DIGEST_LENGTH];
+	bool			 keyed;
+	int			 ok = -1;
+	int			 r;
 
+	if (idx >= assert->stmt_len || pk == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	stmt = &assert->stmt[idx];
+
+	if ((r = get_signed_hash(assert, idx, cose_alg, &dgst)) != FIDO_OK) {
+		fido_log_debug("%s: get_signed_hash", __func__);
+		return (r);
+	}
+
+	keyed = fido_verify_cache_key(key, cose_alg, pk, pk_len(cose_alg),
+	    dgst, &stmt->sig) == 0;
+	if (keyed && fido_verify_cache_get(key, &r))
+		return (r);
+
+	fido_prof_begin(&prof, FIDO_PROF_VERIFY_SIG);
 	switch (cose_alg) {
 	case COSE_ES256:
-		ok = es256_pk_verify_sig(&dgst, pk, &stmt->sig);
+		ok = es256_pk_verify_sig(dgst, pk, &stmt->sig);
 		break;
+#ifndef FIDO_NO_ES384
 	case COSE_ES384:
-		ok = es384_pk_verify_sig(&dgst, pk, &stmt->sig);
+		ok = es384_pk_verify_sig(dgst, pk, &stmt->sig);
 		break;
+#endif
+#ifndef FIDO_NO_RS256
 	case COSE_RS256:
-		ok = rs256_pk_verify_sig(&dgst, pk, &stmt->sig);
+		ok = rs256_pk_verify_sig(dgst, pk, &stmt->sig);
 		break;
+#endif
+#ifndef FIDO_NO_EDDSA
 	case COSE_EDDSA:
-		ok = eddsa_pk_verify_sig(&dgst, pk, &stmt->sig);
+		ok = eddsa_pk_verify_sig(dgst, pk, &stmt->sig);
 		break;
+#endif
 	default:
 		fido_log_debug("%s: unsupported cose_alg %d", __func__,
 		    cose_alg);
-		r = FIDO_ERR_UNSUPPORTED_OPTION;
-		goto out;
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+	}
+	fido_prof_end(&prof, ok);
+
+	r = ok < 0 ? FIDO_ERR_INVALID_SIG : FIDO_OK;
+	if (keyed)
+		fido_verify_cache_put(key, r);
+
+	return (r);
+}
+
+int
+fido_assert_verify_prepared(const fido_assert_t *assert, size_t idx,
+    const fido_pk_t *pk)
+{
+	const fido_blob_t	*dgst;
+	const fido_blob_t	*sig;
+	fido_prof_t		 prof;
+	unsigned char		 key[SHA256_DIGEST_LENGTH];
+	bool			 keyed;
+	int			 r;
+
+	if (idx >= assert->stmt_len || pk == NULL || pk->pkey == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if ((r = get_signed_hash(assert, idx, pk->type, &dgst)) != FIDO_OK) {
+		fido_log_debug("%s: get_signed_hash", __func__);
+		return (r);
 	}
 
-	if (ok < 0)
+	sig = &assert->stmt[idx].sig;
+
+	/* only es256 and eddsa keys keep their raw form */
+	keyed = (pk->type == COSE_ES256 || pk->type == COSE_EDDSA) &&
+	    fido_verify_cache_key(key, pk->type, &pk->raw, pk_len(pk->type),
+	    dgst, sig) == 0;
+	if (keyed && fido_verify_cache_get(key, &r))
+		return (r);
+
+	fido_prof_begin(&prof, FIDO_PROF_VERIFY_SIG);
+	if (fido_prof_end(&prof, fido_pk_verify_sig(dgst, pk, sig)) < 0)
 		r = FIDO_ERR_INVALID_SIG;
-	else
-		r = FIDO_OK;
-out:
-	explicit_bzero(buf, sizeof(buf));
+	if (keyed)
+		fido_verify_cache_put(key, r);
+
+	return (r);
+}
+
+/*
+ * Verify the items in order, in the calling thread; callers wanting
+ * parallelism split the array between threads of their own.
+ */
+int
+fido_assert_verify_batch(fido_assert_verify_item_t *v, size_t n)
+{
+	int r = FIDO_OK;
+
+	if (v == NULL && n != 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	for (size_t i = 0; i < n; i++) {
+		if (v[i].assert == NULL)
+			v[i].r = FIDO_ERR_INVALID_ARGUMENT;
+		else
+			v[i].r = fido_assert_verify(v[i].assert, v[i].idx,
+			    v[i].cose_alg, v[i].pk);
+		if (v[i].r != FIDO_OK) {
+			fido_log_debug("%s: item %zu: %d", __func__, i, v[i].r);
+			if (r == FIDO_OK)
+				r = v[i].r;
+		}
+	}
 
 	return (r);
 }
@@ -592,6 +1325,48 @@ fido_assert_set_clientdata(fido_assert_t *assert, const unsigned char *data,
 		fido_blob_reset(&assert->cd);
 		return (FIDO_ERR_INTERNAL);
 	}
+	fido_assert_clean_dgst_all(assert);
+
+	return (FIDO_OK);
+}
+
+/*
+ * Feed the client data to sha256 as it arrives; only its hash is kept, as
+ * if set with fido_assert_set_clientdata_hash().
+ */
+int
+fido_assert_set_clientdata_init(fido_assert_t *assert)
+{
+	if (!fido_blob_is_empty(&assert->cd) ||
+	    !fido_blob_is_empty(&assert->cdh))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (fido_sha256_init(&assert->cd_ctx) < 0)
+		return (FIDO_ERR_INTERNAL);
+
+	return (FIDO_OK);
+}
+
+int
+fido_assert_set_clientdata_update(fido_assert_t *assert,
+    const unsigned char *data, size_t data_len)
+{
+	if (assert->cd_ctx == NULL || (data == NULL && data_len > 0))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (fido_sha256_update(assert->cd_ctx, data, data_len) < 0)
+		return (FIDO_ERR_INTERNAL);
+
+	return (FIDO_OK);
+}
+
+int
+fido_assert_set_clientdata_final(fido_assert_t *assert)
+{
+	if (assert->cd_ctx == NULL || !fido_blob_is_empty(&assert->cd) ||
+	    !fido_blob_is_empty(&assert->cdh))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (fido_sha256_final(&assert->cd_ctx, &assert->cdh) < 0)
+		return (FIDO_ERR_INTERNAL);
+	fido_assert_clean_dgst_all(assert);
 
 	return (FIDO_OK);
 }
@@ -603,6 +1378,7 @@ fido_assert_set_clientdata_hash(fido_assert_t *assert,
 	if (!fido_blob_is_empty(&assert->cd) ||
 	    fido_blob_set(&assert->cdh, hash, hash_len) < 0)
 		return (FIDO_ERR_INVALID_ARGUMENT);
+	fido_assert_clean_dgst_all(assert);
 
 	return (FIDO_OK);
 }
@@ -623,26 +1399,54 @@ fido_assert_set_hmac_secret(fido_assert_t *assert, size_t idx,
     const unsigned char *secret, size_t secret_len)
 {
 	if (idx >= assert->stmt_len || (secret_len != 32 && secret_len != 64) ||
-	    fido_blob_set(&assert->stmt[idx].hmac_secret, secret,
+	    fido_blob_set_secure(&assert->stmt[idx].hmac_secret, secret,
 	    secret_len) < 0)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
 	return (FIDO_OK);
 }
 
+/* drop the request as translated for webauthn.dll */
+static void
+fido_assert_clean_winhello(fido_assert_t *assert)
+{
+#if defined(USE_WINHELLO) && !defined(FIDO_VERIFY_ONLY)
+	fido_winhello_assert_cache_free(assert);
+#else
+	(void)assert;
+#endif
+}
+
 int
 fido_assert_set_rp(fido_assert_t *assert, const char *id)
 {
+	/* keep the hash of a recycled assertion */
+	if (id != NULL && assert->rp_id != NULL &&
+	    strcmp(assert->rp_id, id) == 0 &&
+	    !fido_blob_is_empty(&assert->rp_id_hash))
+		return (FIDO_OK);
+
+	fido_assert_clean_winhello(assert);
+	tmpl_reset(assert);
 	if (assert->rp_id != NULL) {
-		free(assert->rp_id);
+		fido_free(assert->rp_id);
 		assert->rp_id = NULL;
 	}
+	fido_blob_reset(&assert->rp_id_hash);
 
 	if (id == NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	if ((assert->rp_id = strdup(id)) == NULL)
+	if ((assert->rp_id = fido_strdup(id)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	if (fido_sha256(&assert->rp_id_hash, (const u_char *)id,
+	    strlen(id)) < 0) {
+		fido_log_debug("%s: fido_sha256", __func__);
+		fido_free(assert->rp_id);
+		assert->rp_id = NULL;
 		return (FIDO_ERR_INTERNAL);
+	}
 
 	return (FIDO_OK);
 }
@@ -651,15 +1455,16 @@ fido_assert_set_rp(fido_assert_t *assert, const char *id)
 int
 fido_assert_set_winhello_appid(fido_assert_t *assert, const char *id)
 {
+	fido_assert_clean_winhello(assert);
 	if (assert->appid != NULL) {
-		free(assert->appid);
+		fido_free(assert->appid);
 		assert->appid = NULL;
 	}
 
 	if (id == NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	if ((assert->appid = strdup(id)) == NULL)
+	if ((assert->appid = fido_strdup(id)) == NULL)
 		return (FIDO_ERR_INTERNAL);
 
 	return (FIDO_OK);
@@ -679,32 +1484,47 @@ int
 fido_assert_allow_cred(fido_assert_t *assert, const unsigned char *ptr,
     size_t len)
 {
-	fido_blob_t	 id;
-	fido_blob_t	*list_ptr;
-	int		 r;
+	if (fido_blob_array_append(&assert->allow_list, ptr, len) < 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	memset(&id, 0, sizeof(id));
+	fido_blob_reset(&assert->allow_cbor);
+	tmpl_reset(assert);
+	fido_assert_clean_winhello(assert);
 
-	if (assert->allow_list.len == SIZE_MAX) {
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto fail;
-	}
+	return (FIDO_OK);
+}
 
-	if (fido_blob_set(&id, ptr, len) < 0 || (list_ptr =
-	    recallocarray(assert->allow_list.ptr, assert->allow_list.len,
-	    assert->allow_list.len + 1, sizeof(fido_blob_t))) == NULL) {
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto fail;
-	}
+/*
+ * Replace the allow list with the 'n' credential ids at 'ptr', the i-th of
+ * which is 'len[i]' bytes long. The list is allocated once; on error, it
+ * is left untouched.
+ */
+int
+fido_assert_set_allow_list(fido_assert_t *assert,
+    const unsigned char * const *ptr, const size_t *len, size_t n)
+{
+	fido_blob_array_t list;
 
-	list_ptr[assert->allow_list.len++] = id;
-	assert->allow_list.ptr = list_ptr;
+	memset(&list, 0, sizeof(list));
 
-	return (FIDO_OK);
-fail:
-	free(id.ptr);
+	if (n != 0 && (ptr == NULL || len == NULL))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (fido_blob_array_reserve(&list, n) < 0)
+		return (FIDO_ERR_INTERNAL);
+	for (size_t i = 0; i < n; i++)
+		if (fido_blob_array_append(&list, ptr[i], len[i]) < 0) {
+			fido_log_debug("%s: id %zu", __func__, i);
+			fido_free_blob_array(&list);
+			return (FIDO_ERR_INVALID_ARGUMENT);
+		}
 
-	return (r);
+	fido_free_blob_array(&assert->allow_list);
+	assert->allow_list = list;
+	fido_blob_reset(&assert->allow_cbor);
+	tmpl_reset(assert);
+	fido_assert_clean_winhello(assert);
+
+	return (FIDO_OK);
 }
 
 int
@@ -712,6 +1532,9 @@ fido_assert_empty_allow_list(fido_assert_t *assert)
 {
 	fido_free_blob_array(&assert->allow_list);
 	memset(&assert->allow_list, 0, sizeof(assert->allow_list));
+	fido_blob_reset(&assert->allow_cbor);
+	tmpl_reset(assert);
+	fido_assert_clean_winhello(assert);
 
 	return (FIDO_OK);
 }
@@ -739,6 +1562,33 @@ fido_assert_set_options(fido_assert_t *assert, bool up, bool uv)
 	return (FIDO_OK);
 }
 
+int
+fido_assert_set_u2f_flags(fido_assert_t *assert, int flags)
+{
+	if ((flags & ~(FIDO_U2F_FIRST | FIDO_U2F_NO_PROBE)) != 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	assert->u2f_flags = flags;
+
+	return (FIDO_OK);
+}
+
+int
+fido_assert_set_fetch_limit(fido_assert_t *assert, size_t n)
+{
+	assert->stmt_fetch = n;
+
+	return (FIDO_OK);
+}
+
+int
+fido_assert_set_lazy(fido_assert_t *assert, bool lazy)
+{
+	assert->lazy = lazy;
+
+	return (FIDO_OK);
+}
+
 int
 fido_assert_set_up(fido_assert_t *assert, fido_opt_t up)
 {
@@ -758,7 +1608,7 @@ fido_assert_set_uv(fido_assert_t *assert, fido_opt_t uv)
 const unsigned char *
 fido_assert_clientdata_hash_ptr(const fido_assert_t *assert)
 {
-	return (assert->cdh.ptr);
+	return (fido_blob_is_empty(&assert->cdh) ? NULL : assert->cdh.ptr);
 }
 
 size_t
@@ -770,16 +1620,21 @@ fido_assert_clientdata_hash_len(const fido_assert_t *assert)
 fido_assert_t *
 fido_assert_new(void)
 {
-	return (calloc(1, sizeof(fido_assert_t)));
+	return (fido_calloc(1, sizeof(fido_assert_t)));
 }
 
 void
 fido_assert_reset_tx(fido_assert_t *assert)
 {
-	free(assert->rp_id);
-	free(assert->appid);
+	fido_assert_clean_winhello(assert);
+	fido_free(assert->rp_id);
+	fido_free(assert->appid);
+	fido_blob_reset(&assert->rp_id_hash);
 	fido_blob_reset(&assert->cd);
 	fido_blob_reset(&assert->cdh);
+	fido_assert_clean_dgst_all(assert);
+	EVP_MD_CTX_free(assert->cd_ctx);
+	assert->cd_ctx = NULL;
 	fido_blob_reset(&assert->ext.hmac_salt);
 	fido_assert_empty_allow_list(assert);
 	memset(&assert->ext, 0, sizeof(assert->ext));
@@ -787,6 +1642,9 @@ fido_assert_reset_tx(fido_assert_t *assert)
 	assert->appid = NULL;
 	assert->up = FIDO_OPT_OMIT;
 	assert->uv = FIDO_OPT_OMIT;
+	assert->u2f_flags = 0;
+	assert->stmt_fetch = 0;
+	assert->lazy = false;
 }
 
 static void
@@ -797,13 +1655,59 @@ fido_assert_reset_extattr(fido_assert_extattr_t *ext)
 	memset(ext, 0, sizeof(*ext));
 }
 
+/* the authdata buffers are kept for reuse */
+static void
+fido_assert_clean_authdata(fido_assert_stmt *stmt)
+{
+	fido_blob_clear(&stmt->authdata_cbor);
+	fido_blob_clear(&stmt->authdata_raw);
+	fido_assert_reset_extattr(&stmt->authdata_ext);
+	fido_assert_clean_dgst(stmt);
+	memset(&stmt->authdata, 0, sizeof(stmt->authdata));
+}
+
+static void
+fido_assert_free_lazy(fido_assert_stmt **lazy_p)
+{
+	fido_assert_stmt *lazy;
+
+	if (lazy_p == NULL || (lazy = *lazy_p) == NULL)
+		return;
+	fido_free(lazy->user.icon);
+	fido_free(lazy->user.name);
+	fido_free(lazy->user.display_name);
+	fido_blob_reset(&lazy->user.id);
+	fido_blob_reset(&lazy->id);
+	fido_blob_reset(&lazy->largeblob_key);
+	fido_free(lazy);
+	*lazy_p = NULL;
+}
+
+/* as above, for the signature; everything else is freed */
+static void
+fido_assert_clean_stmt(fido_assert_stmt *stmt)
+{
+	fido_assert_free_lazy(&stmt->lazy);
+	fido_blob_reset(&stmt->reply);
+	fido_free(stmt->user.icon);
+	fido_free(stmt->user.name);
+	fido_free(stmt->user.display_name);
+	fido_blob_reset(&stmt->user.id);
+	fido_blob_reset(&stmt->id);
+	fido_blob_reset(&stmt->hmac_secret);
+	fido_blob_reset(&stmt->largeblob_key);
+	fido_blob_clear(&stmt->sig);
+	fido_assert_clean_authdata(stmt);
+	memset(&stmt->user, 0, sizeof(stmt->user));
+}
+
 void
 fido_assert_reset_rx(fido_assert_t *assert)
 {
 	for (size_t i = 0; i < assert->stmt_cnt; i++) {
-		free(assert->stmt[i].user.icon);
-		free(assert->stmt[i].user.name);
-		free(assert->stmt[i].user.display_name);
+		fido_free(assert->stmt[i].user.icon);
+		fido_free(assert->stmt[i].user.name);
+		fido_free(assert->stmt[i].user.display_name);
 		fido_blob_reset(&assert->stmt[i].user.id);
 		fido_blob_reset(&assert->stmt[i].id);
 		fido_blob_reset(&assert->stmt[i].hmac_secret);
@@ -811,13 +1715,44 @@ fido_assert_reset_rx(fido_assert_t *assert)
 		fido_blob_reset(&assert->stmt[i].authdata_raw);
 		fido_blob_reset(&assert->stmt[i].largeblob_key);
 		fido_blob_reset(&assert->stmt[i].sig);
+		fido_blob_reset(&assert->stmt[i].reply);
 		fido_assert_reset_extattr(&assert->stmt[i].authdata_ext);
+		fido_assert_clean_dgst(&assert->stmt[i]);
+		fido_assert_free_lazy(&assert->stmt[i].lazy);
 		memset(&assert->stmt[i], 0, sizeof(assert->stmt[i]));
 	}
-	free(assert->stmt);
+	fido_free(assert->stmt);
+	arena_free(assert);
 	assert->stmt = NULL;
 	assert->stmt_len = 0;
 	assert->stmt_cnt = 0;
+	assert->stmt_more = false;
+}
+
+void
+fido_assert_recycle(fido_assert_t *assert)
+{
+	if (assert == NULL)
+		return;
+
+	for (size_t i = 0; i < assert->stmt_cnt; i++)
+		fido_assert_clean_stmt(&assert->stmt[i]);
+	arena_free(assert);
+	assert->stmt_len = 0;
+	assert->stmt_fetch = 0;
+	assert->stmt_more = false;
+	assert->lazy = false;
+
+	fido_blob_clear(&assert->cd);
+	fido_blob_clear(&assert->cdh);
+	EVP_MD_CTX_free(assert->cd_ctx);
+	assert->cd_ctx = NULL;
+	fido_blob_clear(&assert->ext.hmac_salt);
+	fido_assert_empty_allow_list(assert);
+	assert->ext.mask = 0;
+	assert->up = FIDO_OPT_OMIT;
+	assert->uv = FIDO_OPT_OMIT;
+	assert->u2f_flags = 0;
 }
 
 void
@@ -829,7 +1764,7 @@ fido_assert_free(fido_assert_t **assert_p)
 		return;
 	fido_assert_reset_tx(assert);
 	fido_assert_reset_rx(assert);
-	free(assert);
+	fido_free(assert);
 	*assert_p = NULL;
 }
 
@@ -839,6 +1774,12 @@ fido_assert_count(const fido_assert_t *assert)
 	return (assert->stmt_len);
 }
 
+size_t
+fido_assert_pending(const fido_assert_t *assert)
+{
+	return (assert->stmt_more ? assert->stmt_cnt - assert->stmt_len : 0);
+}
+
 const char *
 fido_assert_rp_id(const fido_assert_t *assert)
 {
@@ -869,6 +1810,9 @@ fido_assert_authdata_ptr(const fido_assert_t *assert, size_t idx)
 	if (idx >= assert->stmt_len)
 		return (NULL);
 
+	if (fido_blob_is_empty(&assert->stmt[idx].authdata_cbor))
+		return (NULL);
+
 	return (assert->stmt[idx].authdata_cbor.ptr);
 }
 
@@ -887,6 +1831,9 @@ fido_assert_authdata_raw_ptr(const fido_assert_t *assert, size_t idx)
 	if (idx >= assert->stmt_len)
 		return (NULL);
 
+	if (fido_blob_is_empty(&assert->stmt[idx].authdata_raw))
+		return (NULL);
+
 	return (assert->stmt[idx].authdata_raw.ptr);
 }
 
@@ -905,6 +1852,9 @@ fido_assert_sig_ptr(const fido_assert_t *assert, size_t idx)
 	if (idx >= assert->stmt_len)
 		return (NULL);
 
+	if (fido_blob_is_empty(&assert->stmt[idx].sig))
+		return (NULL);
+
 	return (assert->stmt[idx].sig.ptr);
 }
 
@@ -917,67 +1867,143 @@ fido_assert_sig_len(const fido_assert_t *assert, size_t idx)
 	return (assert->stmt[idx].sig.len);
 }
 
+/*
+ * With fido_assert_set_lazy(), the credential id, user and largeBlobKey of
+ * a statement are decoded from its reply when first asked for. Getters
+ * take a const assertion and may run in several threads at once; as for
+ * the signed hashes, the decoded fields are published with an atomic
+ * compare-and-swap, and the loser's copy freed.
+ */
+static fido_assert_stmt *
+lazy_load(fido_assert_stmt **p)
+{
+#if defined(_MSC_VER)
+	return (_InterlockedCompareExchangePointer((void * volatile *)p, NULL,
+	    NULL));
+#else
+	return (__atomic_load_n(p, __ATOMIC_ACQUIRE));
+#endif
+}
+
+static bool
+lazy_publish(fido_assert_stmt **p, fido_assert_stmt *lazy)
+{
+#if defined(_MSC_VER)
+	return (_InterlockedCompareExchangePointer((void * volatile *)p, lazy,
+	    NULL) == NULL);
+#else
+	fido_assert_stmt *expected = NULL;
+
+	return (__atomic_compare_exchange_n(p, &expected, lazy, false,
+	    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+#endif
+}
+
+/* the statement holding the credential id, user and largeBlobKey of 'idx' */
+static const fido_assert_stmt *
+stmt_fields(const fido_assert_t *assert, size_t idx)
+{
+	fido_assert_stmt *stmt, *lazy;
+
+	if (idx >= assert->stmt_len)
+		return (NULL);
+	stmt = &assert->stmt[idx];
+	if (stmt->reply.ptr == NULL)
+		return (stmt);
+	if ((lazy = lazy_load(&stmt->lazy)) != NULL)
+		return (lazy);
+
+	if ((lazy = fido_calloc(1, sizeof(*lazy))) == NULL)
+		return (NULL);
+	if (cbor_parse_assert_reply(stmt->reply.ptr, stmt->reply.len, lazy,
+	    NULL, ~LAZY_KEYS) != FIDO_OK) {
+		fido_log_debug("%s: cbor_parse_assert_reply", __func__);
+		fido_assert_free_lazy(&lazy);
+		return (NULL);
+	}
+	if (lazy_publish(&stmt->lazy, lazy) == false) {
+		fido_assert_free_lazy(&lazy);
+		return (lazy_load(&stmt->lazy));
+	}
+
+	return (lazy);
+}
+
 const unsigned char *
 fido_assert_id_ptr(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (NULL);
 
-	return (assert->stmt[idx].id.ptr);
+	return (stmt->id.ptr);
 }
 
 size_t
 fido_assert_id_len(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (0);
 
-	return (assert->stmt[idx].id.len);
+	return (stmt->id.len);
 }
 
 const unsigned char *
 fido_assert_user_id_ptr(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (NULL);
 
-	return (assert->stmt[idx].user.id.ptr);
+	return (stmt->user.id.ptr);
 }
 
 size_t
 fido_assert_user_id_len(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (0);
 
-	return (assert->stmt[idx].user.id.len);
+	return (stmt->user.id.len);
 }
 
 const char *
 fido_assert_user_icon(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (NULL);
 
-	return (assert->stmt[idx].user.icon);
+	return (stmt->user.icon);
 }
 
 const char *
 fido_assert_user_name(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (NULL);
 
-	return (assert->stmt[idx].user.name);
+	return (stmt->user.name);
 }
 
 const char *
 fido_assert_user_display_name(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (NULL);
 
-	return (assert->stmt[idx].user.display_name);
+	return (stmt->user.display_name);
 }
 
 const unsigned char *
@@ -998,22 +2024,54 @@ fido_assert_hmac_secret_len(const fido_assert_t *assert, size_t idx)
 	return (assert->stmt[idx].hmac_secret.len);
 }
 
+int
+fido_assert_hmac_secret_batch(const fido_assert_t *assert,
+    fido_hmac_secret_item_t *v, size_t n)
+{
+	const fido_assert_stmt *stmt;
+
+	if (v == NULL || n > assert->stmt_len)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	for (size_t i = 0; i < n; i++) {
+		stmt = &assert->stmt[i];
+		memset(&v[i], 0, sizeof(v[i]));
+		v[i].cred_ptr = fido_assert_id_ptr(assert, i);
+		v[i].cred_len = fido_assert_id_len(assert, i);
+		if (stmt->hmac_secret.ptr == NULL ||
+		    stmt->hmac_secret.len > sizeof(v[i].secret)) {
+			v[i].r = FIDO_ERR_UNSUPPORTED_EXTENSION;
+			continue;
+		}
+		memcpy(v[i].secret, stmt->hmac_secret.ptr,
+		    stmt->hmac_secret.len);
+		v[i].secret_len = stmt->hmac_secret.len;
+		v[i].r = FIDO_OK;
+	}
+
+	return (FIDO_OK);
+}
+
 const unsigned char *
 fido_assert_largeblob_key_ptr(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (NULL);
 
-	return (assert->stmt[idx].largeblob_key.ptr);
+	return (stmt->largeblob_key.ptr);
 }
 
 size_t
 fido_assert_largeblob_key_len(const fido_assert_t *assert, size_t idx)
 {
-	if (idx >= assert->stmt_len)
+	const fido_assert_stmt *stmt;
+
+	if ((stmt = stmt_fields(assert, idx)) == NULL)
 		return (0);
 
-	return (assert->stmt[idx].largeblob_key.len);
+	return (stmt->largeblob_key.len);
 }
 
 const unsigned char *
@@ -1034,67 +2092,31 @@ fido_assert_blob_len(const fido_assert_t *assert, size_t idx)
 	return (assert->stmt[idx].authdata_ext.blob.len);
 }
 
-static void
-fido_assert_clean_authdata(fido_assert_stmt *stmt)
-{
-	fido_blob_reset(&stmt->authdata_cbor);
-	fido_blob_reset(&stmt->authdata_raw);
-	fido_assert_reset_extattr(&stmt->authdata_ext);
-	memset(&stmt->authdata, 0, sizeof(stmt->authdata));
-}
-
 int
 fido_assert_set_authdata(fido_assert_t *assert, size_t idx,
     const unsigned char *ptr, size_t len)
 {
-	cbor_item_t		*item = NULL;
-	fido_assert_stmt	*stmt = NULL;
-	struct cbor_load_result	 cbor;
-	int			 r;
+	const unsigned char	*raw_ptr;
+	size_t			 raw_len;
 
 	if (idx >= assert->stmt_len || ptr == NULL || len == 0)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	stmt = &assert->stmt[idx];
-	fido_assert_clean_authdata(stmt);
-
-	if ((item = cbor_load(ptr, len, &cbor)) == NULL) {
-		fido_log_debug("%s: cbor_load", __func__);
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto fail;
-	}
-
-	if (fido_blob_decode(item, &stmt->authdata_raw) < 0) {
-	    fido_log_debug("%s: fido_blob_decode", __func__);
-	    r = FIDO_ERR_INTERNAL;
-	    goto fail;
-	}
-
-	if (cbor_decode_assert_authdata(item, &stmt->authdata_cbor,
-	    &stmt->authdata, &stmt->authdata_ext) < 0) {
-		fido_log_debug("%s: cbor_decode_assert_authdata", __func__);
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto fail;
+	if (cbor_unwrap_bytestring(ptr, len, &raw_ptr, &raw_len) < 0 ||
+	    raw_len == 0) {
+		fido_log_debug("%s: cbor_unwrap_bytestring", __func__);
+		fido_assert_clean_authdata(&assert->stmt[idx]);
+		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
-	r = FIDO_OK;
-fail:
-	if (item != NULL)
-		cbor_decref(&item);
-
-	if (r != FIDO_OK)
-		fido_assert_clean_authdata(stmt);
-
-	return (r);
+	return (fido_assert_set_authdata_raw(assert, idx, raw_ptr, raw_len));
 }
 
 int
 fido_assert_set_authdata_raw(fido_assert_t *assert, size_t idx,
     const unsigned char *ptr, size_t len)
 {
-	cbor_item_t		*item = NULL;
-	fido_assert_stmt	*stmt = NULL;
-	int			 r;
+	fido_assert_stmt *stmt = NULL;
 
 	if (idx >= assert->stmt_len || ptr == NULL || len == 0)
 		return (FIDO_ERR_INVALID_ARGUMENT);
@@ -1104,28 +2126,36 @@ fido_assert_set_authdata_raw(fido_assert_t *assert, size_t idx,
 
 	if (fido_blob_set(&stmt->authdata_raw, ptr, len) < 0) {
 		fido_log_debug("%s: fido_blob_set", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
+		fido_assert_clean_authdata(stmt);
+		return (FIDO_ERR_INTERNAL);
 	}
 
-	if ((item = cbor_build_bytestring(ptr, len)) == NULL) {
-		fido_log_debug("%s: cbor_build_bytestring", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
-	}
+	return (fido_assert_decode_authdata(stmt));
+}
+
+/* decode the statement's authdata_raw, which is cleaned on error */
+int
+fido_assert_decode_authdata(fido_assert_stmt *stmt)
+{
+	int r;
 
-	if (cbor_decode_assert_authdata(item, &stmt->authdata_cbor,
+	if (cbor_decode_assert_authdata_raw(&stmt->authdata_raw,
 	    &stmt->authdata, &stmt->authdata_ext) < 0) {
-		fido_log_debug("%s: cbor_decode_assert_authdata", __func__);
+		fido_log_debug("%s: cbor_decode_assert_authdata_raw", __func__);
 		r = FIDO_ERR_INVALID_ARGUMENT;
 		goto fail;
 	}
 
+	/* keep the cbor-encoded form available to the authdata getters */
+	if (cbor_wrap_bytestring(&stmt->authdata_raw,
+	    &stmt->authdata_cbor) < 0) {
+		fido_log_debug("%s: cbor_wrap_bytestring", __func__);
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
 	r = FIDO_OK;
 fail:
-	if (item != NULL)
-		cbor_decref(&item);
-
 	if (r != FIDO_OK)
 		fido_assert_clean_authdata(stmt);
 
@@ -1144,12 +2174,14 @@ fido_assert_set_sig(fido_assert_t *a, size_t idx, const unsigned char *ptr,
 	return (FIDO_OK);
 }
 
-/* XXX shrinking leaks memory; fortunately that shouldn't happen */
+/* statements beyond 'n' are emptied and kept for reuse */
 int
 fido_assert_set_count(fido_assert_t *assert, size_t n)
 {
 	void *new_stmt;
 
+	assert->stmt_more = false;
+
 #ifdef FIDO_FUZZ
 	if (n > UINT8_MAX) {
 		fido_log_debug("%s: n > UINT8_MAX", __func__);
@@ -1157,7 +2189,14 @@ fido_assert_set_count(fido_assert_t *assert, size_t n)
 	}
 #endif
 
-	new_stmt = recallocarray(assert->stmt, assert->stmt_cnt, n,
+	if (n <= assert->stmt_cnt) {
+		for (size_t i = n; i < assert->stmt_cnt; i++)
+			fido_assert_clean_stmt(&assert->stmt[i]);
+		assert->stmt_len = n;
+		return (FIDO_OK);
+	}
+
+	new_stmt = fido_recallocarray(assert->stmt, assert->stmt_cnt, n,
 	    sizeof(fido_assert_stmt));
 	if (new_stmt == NULL)
 		return (FIDO_ERR_INTERNAL);
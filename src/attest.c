@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include <openssl/x509_vfy.h>
+#include <openssl/x509v3.h>
+
+#include "fido.h"
+
+#ifndef TLS
+#define TLS
+#endif
+
+#define X5C_CACHE_LEN	32
+#define X5C_MEMO_LEN	32
+
+/*
+ * Attestation certificates most recently decoded in the executing
+ * thread, keyed by the SHA-256 of their DER encoding; the least recently
+ * used entry is evicted first.
+ */
+static TLS struct x5c_cache {
+	unsigned char	 hash[SHA256_DIGEST_LENGTH];
+	X509		*cert;
+	uint64_t	 used;
+} x5c_cache[X5C_CACHE_LEN];
+static TLS uint64_t x5c_tick;
+
+/*
+ * Intermediates found to chain to a trust anchor of a store, keyed by
+ * the store's id and the SHA-256 of the intermediate's DER encoding.
+ */
+static TLS struct x5c_memo {
+	uint64_t	 store_id;
+	unsigned char	 hash[SHA256_DIGEST_LENGTH];
+} x5c_memo[X5C_MEMO_LEN];
+static TLS size_t x5c_memo_next;
+
+static X509 *
+x5c_cache_get(const unsigned char *hash)
+{
+#ifndef FIDO_FUZZ
+	struct x5c_cache *e;
+
+	for (size_t i = 0; i < X5C_CACHE_LEN; i++) {
+		e = &x5c_cache[i];
+		if (e->cert == NULL ||
+		    memcmp(e->hash, hash, sizeof(e->hash)) != 0)
+			continue;
+		if (X509_up_ref(e->cert) != 1) {
+			fido_log_debug("%s: X509_up_ref", __func__);
+			return (NULL);
+		}
+		e->used = ++x5c_tick;
+		return (e->cert);
+	}
+#else
+	(void)hash;
+#endif
+	return (NULL);
+}
+
+static void
+x5c_cache_put(const unsigned char *hash, X509 *cert)
+{
+#ifndef FIDO_FUZZ
+	struct x5c_cache *e = &x5c_cache[0];
+
+	for (size_t i = 1; i < X5C_CACHE_LEN; i++)
+		if (x5c_cache[i].used < e->used)
+			e = &x5c_cache[i];
+	if (X509_up_ref(cert) != 1) {
+		fido_log_debug("%s: X509_up_ref", __func__);
+		return;
+	}
+
+	X509_free(e->cert);
+	memcpy(e->hash, hash, sizeof(e->hash));
+	e->cert = cert;
+	e->used = ++x5c_tick;
+#else
+	(void)hash;
+	(void)cert;
+#endif
+}
+
+static int
+x5c_hash(const fido_blob_t *der, unsigned char *hash)
+{
+	if (fido_sha256_buf(der->ptr, der->len, hash) < 0) {
+		fido_log_debug("%s: sha256", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/* decode a certificate, or take it from the cache; returns a reference */
+X509 *
+fido_x5c_cert(const fido_blob_t *der)
+{
+	unsigned char	 hash[SHA256_DIGEST_LENGTH];
+	const unsigned char *ptr = der->ptr;
+	X509		*cert;
+
+	/* openssl needs longs */
+	if (der->len > LONG_MAX) {
+		fido_log_debug("%s: len=%zu", __func__, der->len);
+		return (NULL);
+	}
+	if (x5c_hash(der, hash) < 0)
+		return (NULL);
+	if ((cert = x5c_cache_get(hash)) != NULL)
+		return (cert);
+
+	if ((cert = d2i_X509(NULL, &ptr, (long)der->len)) == NULL ||
+	    ptr != der->ptr + der->len) {
+		fido_log_debug("%s: d2i_X509", __func__);
+		X509_free(cert);
+		return (NULL);
+	}
+
+	x5c_cache_put(hash, cert);
+
+	return (cert);
+}
+
+static bool
+x5c_memo_find(const fido_attest_store_t *store, const fido_blob_t *der)
+{
+#ifndef FIDO_FUZZ
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+
+	if (x5c_hash(der, hash) < 0)
+		return (false);
+
+	for (size_t i = 0; i < X5C_MEMO_LEN; i++)
+		if (x5c_memo[i].store_id == store->id &&
+		    memcmp(x5c_memo[i].hash, hash, sizeof(hash)) == 0)
+			return (true);
+#else
+	(void)store;
+	(void)der;
+#endif
+	return (false);
+}
+
+static void
+x5c_memo_put(const fido_attest_store_t *store, const fido_blob_t *der)
+{
+#ifndef FIDO_FUZZ
+	struct x5c_memo *e = &x5c_memo[x5c_memo_next];
+
+	if (x5c_memo_find(store, der) || x5c_hash(der, e->hash) < 0)
+		return;
+
+	e->store_id = store->id;
+	x5c_memo_next = (x5c_memo_next + 1) % X5C_MEMO_LEN;
+#else
+	(void)store;
+	(void)der;
+#endif
+}
+
+static bool
+x5c_current(X509 *cert)
+{
+	return (X509_cmp_current_time(X509_get0_notBefore(cert)) < 0 &&
+	    X509_cmp_current_time(X509_get0_notAfter(cert)) > 0);
+}
+
+/*
+ * The checks X509_verify_cert() makes of the leaf itself under the
+ * store's parameters (no purpose set, critical extensions honoured): its
+ * extensions must decode, none of the critical ones may be unknown, and
+ * its names must satisfy the constraints of the intermediate.
+ */
+static int
+check_leaf(X509 *leaf, X509 *issuer)
+{
+	NAME_CONSTRAINTS	*nc;
+	int			 crit;
+	int			 ok = -1;
+
+	if (X509_check_purpose(leaf, -1, 0) != 1) {
+		fido_log_debug("%s: X509_check_purpose", __func__);
+		return (-1);
+	}
+	if (X509_get_extension_flags(leaf) & EXFLAG_CRITICAL) {
+		fido_log_debug("%s: unhandled critical extension", __func__);
+		return (-1);
+	}
+	if ((nc = X509_get_ext_d2i(issuer, NID_name_constraints, &crit,
+	    NULL)) == NULL) {
+		if (crit != -1) {
+			fido_log_debug("%s: name constraints", __func__);
+			return (-1);
+		}
+		return (0);
+	}
+	if (NAME_CONSTRAINTS_check(leaf, nc) != X509_V_OK) {
+		fido_log_debug("%s: NAME_CONSTRAINTS_check", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	NAME_CONSTRAINTS_free(nc);
+
+	return (ok);
+}
+
+/*
+ * Verify leaf against an intermediate already found to chain to one of
+ * the store's trust anchors: a signature check and the checks of
+ * check_leaf(), the chain above the intermediate having been verified.
+ */
+static int
+verify_memo(X509 *leaf, STACK_OF(X509) *chain)
+{
+	X509		*issuer = sk_X509_value(chain, 0);
+	EVP_PKEY	*pkey;
+
+	if (!x5c_current(leaf)) {
+		fido_log_debug("%s: leaf validity", __func__);
+		return (-1);
+	}
+	if (check_leaf(leaf, issuer) < 0) {
+		fido_log_debug("%s: check_leaf", __func__);
+		return (-1);
+	}
+	for (int i = 0; i < sk_X509_num(chain); i++)
+		if (!x5c_current(sk_X509_value(chain, i))) {
+			fido_log_debug("%s: x5c[%d] validity", __func__,
+			    i + 1);
+			return (-1);
+		}
+	if (X509_check_issued(issuer, leaf) != X509_V_OK ||
+	    (pkey = X509_get0_pubkey(issuer)) == NULL ||
+	    X509_verify(leaf, pkey) != 1) {
+		fido_log_debug("%s: X509_verify", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+verify_store(const fido_attest_store_t *store, X509 *leaf,
+    STACK_OF(X509) *chain, bool *via_x5c1)
+{
+	X509_STORE_CTX	*ctx = NULL;
+	STACK_OF(X509)	*path;
+	int		 ok = -1;
+
+	*via_x5c1 = false;
+
+	if ((ctx = X509_STORE_CTX_new()) == NULL ||
+	    X509_STORE_CTX_init(ctx, store->store, leaf, chain) != 1) {
+		fido_log_debug("%s: X509_STORE_CTX_init", __func__);
+		goto fail;
+	}
+	if (X509_verify_cert(ctx) != 1) {
+		fido_log_debug("%s: X509_verify_cert: %d", __func__,
+		    X509_STORE_CTX_get_error(ctx));
+		goto fail;
+	}
+
+	/* only remember x5c[1] if the verified path went through it */
+	if ((path = X509_STORE_CTX_get0_chain(ctx)) != NULL &&
+	    sk_X509_num(path) > 1 && sk_X509_num(chain) > 0 &&
+	    X509_cmp(sk_X509_value(path, 1), sk_X509_value(chain, 0)) == 0)
+		*via_x5c1 = true;
+
+	ok = 0;
+fail:
+	X509_STORE_CTX_free(ctx);
+
+	return (ok);
+}
+
+int
+fido_attest_verify_x5c(const fido_blob_array_t *x5c,
+    const fido_attest_store_t *store)
+{
+	X509		*leaf = NULL;
+	X509		*cert;
+	STACK_OF(X509)	*chain = NULL;
+	bool		 via_x5c1;
+	int		 r = FIDO_ERR_INTERNAL;
+
+	if (x5c->len == 0 || x5c->len > INT_MAX) {
+		fido_log_debug("%s: x5c->len=%zu", __func__, x5c->len);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+	if ((leaf = fido_x5c_cert(&x5c->ptr[0])) == NULL) {
+		fido_log_debug("%s: x5c[0]", __func__);
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto out;
+	}
+	if ((chain = sk_X509_new_null()) == NULL)
+		goto out;
+	for (size_t i = 1; i < x5c->len; i++) {
+		if ((cert = fido_x5c_cert(&x5c->ptr[i])) == NULL) {
+			fido_log_debug("%s: x5c[%zu]", __func__, i);
+			r = FIDO_ERR_INVALID_ARGUMENT;
+			goto out;
+		}
+		if (sk_X509_push(chain, cert) == 0) {
+			X509_free(cert);
+			goto out;
+		}
+	}
+
+	if (x5c->len > 1 && x5c_memo_find(store, &x5c->ptr[1])) {
+		r = verify_memo(leaf, chain) < 0 ? FIDO_ERR_INVALID_SIG :
+		    FIDO_OK;
+		goto out;
+	}
+	if (verify_store(store, leaf, chain, &via_x5c1) < 0) {
+		r = FIDO_ERR_INVALID_SIG;
+		goto out;
+	}
+	if (via_x5c1)
+		x5c_memo_put(store, &x5c->ptr[1]);
+
+	r = FIDO_OK;
+out:
+	X509_free(leaf);
+	sk_X509_pop_free(chain, X509_free);
+
+	return (r);
+}
+
+fido_attest_store_t *
+fido_attest_store_new(void)
+{
+	fido_attest_store_t *store;
+
+	if ((store = fido_calloc(1, sizeof(*store))) == NULL)
+		return (NULL);
+
+	/* the id outlives the store in other threads' memos */
+	if ((store->store = X509_STORE_new()) == NULL ||
+	    X509_STORE_set_flags(store->store,
+	    X509_V_FLAG_PARTIAL_CHAIN) != 1 ||
+	    fido_get_random(&store->id, sizeof(store->id)) < 0) {
+		fido_log_debug("%s: X509_STORE_new", __func__);
+		fido_attest_store_free(&store);
+		return (NULL);
+	}
+
+	return (store);
+}
+
+void
+fido_attest_store_free(fido_attest_store_t **store_p)
+{
+	fido_attest_store_t *store;
+
+	if (store_p == NULL || (store = *store_p) == NULL)
+		return;
+
+	X509_STORE_free(store->store);
+	fido_free(store);
+
+	*store_p = NULL;
+}
+
+int
+fido_attest_store_add(fido_attest_store_t *store, const unsigned char *ptr,
+    size_t len)
+{
+	const unsigned char	*end = ptr;
+	X509			*cert = NULL;
+	int			 r;
+
+	if (ptr == NULL || len == 0 || len > LONG_MAX)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if ((cert = d2i_X509(NULL, &end, (long)len)) == NULL ||
+	    end != ptr + len) {
+		fido_log_debug("%s: d2i_X509", __func__);
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto out;
+	}
+	if (X509_STORE_add_cert(store->store, cert) != 1) {
+		fido_log_debug("%s: X509_STORE_add_cert", __func__);
+		r = FIDO_ERR_INTERNAL;
+		goto out;
+	}
+
+	r = FIDO_OK;
+out:
+	X509_free(cert);
+
+	return (r);
+}
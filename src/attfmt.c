@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Attestation statement formats. Section references are relative to
+ * WebAuthn Level 2, 8. The "apple" and "android-key" statements are
+ * checked against extensions of the attestation certificate, whose DER
+ * encoding is parsed in place.
+ */
+
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "fido.h"
+#include "fido/rs256.h"
+
+/* 8.8: Apple anonymous attestation nonce extension */
+#define OID_APPLE_NONCE		"1.2.840.113635.100.8.2"
+
+/* 8.4.1: Android key attestation extension (KeyDescription) */
+#define OID_ANDROID_KEY		"1.3.6.1.4.1.11129.2.1.17"
+
+/* AuthorizationList tags and values (Android Keymaster) */
+#define KM_TAG_PURPOSE		1
+#define KM_TAG_ALL_APPLICATIONS	600
+#define KM_TAG_ORIGIN		702
+#define KM_PURPOSE_SIGN		2
+#define KM_ORIGIN_GENERATED	0
+
+/* DER identifier octets */
+#define DER_INTEGER		0x02
+#define DER_OCTET_STRING	0x04
+#define DER_ENUMERATED		0x0a
+#define DER_SEQUENCE		0x30
+#define DER_SET			0x31
+#define DER_CONTEXT		0xa0	/* context-specific, constructed */
+
+static const struct fmt {
+	const char	*name;
+	int		 id;
+} fmt_tab[] = {
+	{ "packed",		FIDO_FMT_PACKED },
+	{ "fido-u2f",		FIDO_FMT_U2F },
+	{ "none",		FIDO_FMT_NONE },
+	{ "tpm",		FIDO_FMT_TPM },
+	{ "apple",		FIDO_FMT_APPLE },
+	{ "android-key",	FIDO_FMT_ANDROID_KEY },
+};
+
+/* map an attestation statement format identifier to its FIDO_FMT_* */
+int
+fido_fmt_id(const char *name)
+{
+	if (name == NULL)
+		return (FIDO_FMT_UNKNOWN);
+
+	for (size_t i = 0; i < nitems(fmt_tab); i++)
+		if (strcmp(fmt_tab[i].name, name) == 0)
+			return (fmt_tab[i].id);
+
+	return (FIDO_FMT_UNKNOWN);
+}
+
+struct der {
+	int			 id;	/* class and constructed bits */
+	uint32_t		 tag;	/* tag number */
+	const unsigned char	*ptr;	/* contents */
+	size_t			 len;
+};
+
+/* read the next TLV; definite lengths only */
+static int
+der_next(const unsigned char **buf, size_t *len, struct der *d)
+{
+	const unsigned char	*p = *buf;
+	size_t			 n = *len;
+	size_t			 l;
+	uint8_t			 b;
+
+	if (n < 2)
+		return (-1);
+	d->id = *p & 0xe0;
+	d->tag = *p & 0x1f;
+	p++, n--;
+	if (d->tag == 0x1f) {
+		/* high tag number, base 128 */
+		d->tag = 0;
+		do {
+			if (n == 0 || d->tag > (UINT32_MAX >> 7))
+				return (-1);
+			b = *p++, n--;
+			d->tag = (d->tag << 7) | (b & 0x7f);
+		} while (b & 0x80);
+	}
+
+	if (n == 0)
+		return (-1);
+	b = *p++, n--;
+	if ((b & 0x80) == 0)
+		l = b;
+	else {
+		if ((b &= 0x7f) == 0 || b > sizeof(uint32_t) || b > n)
+			return (-1);
+		for (l = 0; b > 0; b--, n--)
+			l = (l << 8) | *p++;
+	}
+	if (l > n)
+		return (-1);
+
+	d->ptr = p;
+	d->len = l;
+	*buf = p + l;
+	*len = n - l;
+
+	return (0);
+}
+
+/* read a TLV of identifier 'id', plus 'tag' if context-specific */
+static int
+der_expect(const unsigned char **buf, size_t *len, int id, uint32_t tag,
+    struct der *d)
+{
+	if (der_next(buf, len, d) < 0 || d->id != (id & 0xe0) ||
+	    d->tag != (uint32_t)(id & 0x1f) + tag) {
+		fido_log_debug("%s: id=0x%02x, tag=%u", __func__, id, tag);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/* a small non-negative INTEGER or ENUMERATED */
+static int
+der_uint(const struct der *d, uint32_t *v)
+{
+	size_t n = d->len;
+	const unsigned char *p = d->ptr;
+
+	if (n == 0 || (p[0] & 0x80))
+		return (-1);
+	if (n > 1 && p[0] == 0)
+		p++, n--;
+	if (n > sizeof(*v))
+		return (-1);
+	for (*v = 0; n > 0; n--)
+		*v = (*v << 8) | *p++;
+
+	return (0);
+}
+
+/* the DER contents of a certificate extension; not a copy */
+static int
+get_ext(const X509 *cert, const char *oid, const unsigned char **ptr,
+    size_t *len)
+{
+	ASN1_OBJECT		*obj = NULL;
+	X509_EXTENSION		*ext;
+	const ASN1_OCTET_STRING	*data;
+	int			 i, ok = -1;
+
+	if ((obj = OBJ_txt2obj(oid, 1)) == NULL) {
+		fido_log_debug("%s: OBJ_txt2obj", __func__);
+		goto fail;
+	}
+	if ((i = X509_get_ext_by_OBJ(cert, obj, -1)) < 0 ||
+	    (ext = X509_get_ext(cert, i)) == NULL ||
+	    (data = X509_EXTENSION_get_data(ext)) == NULL ||
+	    ASN1_STRING_length(data) <= 0) {
+		fido_log_debug("%s: %s", __func__, oid);
+		goto fail;
+	}
+
+	*ptr = ASN1_STRING_get0_data(data);
+	*len = (size_t)ASN1_STRING_length(data);
+
+	ok = 0;
+fail:
+	ASN1_OBJECT_free(obj);
+
+	return (ok);
+}
+
+static EVP_PKEY *
+attcred_pkey(const fido_attcred_t *attcred)
+{
+	switch (attcred->type) {
+	case COSE_ES256:
+		return (es256_pk_get_EVP_PKEY(&attcred->pubkey.es256));
+#ifndef FIDO_NO_ES384
+	case COSE_ES384:
+		return (es384_pk_get_EVP_PKEY(&attcred->pubkey.es384));
+#endif
+#ifndef FIDO_NO_RS256
+	case COSE_RS256:
+		return (rs256_pk_to_EVP_PKEY(&attcred->pubkey.rs256));
+#endif
+#ifndef FIDO_NO_EDDSA
+	case COSE_EDDSA:
+		return (eddsa_pk_get_EVP_PKEY(&attcred->pubkey.eddsa));
+#endif
+	}
+
+	fido_log_debug("%s: unsupported type %d", __func__, attcred->type);
+
+	return (NULL);
+}
+
+/* the certificate must certify the credential's public key */
+static int
+check_cert_pubkey(X509 *cert, const fido_attcred_t *attcred)
+{
+	EVP_PKEY	*cert_pkey = NULL;
+	EVP_PKEY	*cred_pkey = NULL;
+	unsigned char	*a = NULL;
+	unsigned char	*b = NULL;
+	int		 alen, blen;
+	int		 ok = -1;
+
+	if ((cert_pkey = X509_get_pubkey(cert)) == NULL ||
+	    (cred_pkey = attcred_pkey(attcred)) == NULL) {
+		fido_log_debug("%s: pkey", __func__);
+		goto fail;
+	}
+	if ((alen = i2d_PUBKEY(cert_pkey, &a)) <= 0 ||
+	    (blen = i2d_PUBKEY(cred_pkey, &b)) <= 0) {
+		fido_log_debug("%s: i2d_PUBKEY", __func__);
+		goto fail;
+	}
+	if (alen != blen || timingsafe_bcmp(a, b, (size_t)alen) != 0) {
+		fido_log_debug("%s: pubkey mismatch", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	EVP_PKEY_free(cert_pkey);
+	EVP_PKEY_free(cred_pkey);
+	OPENSSL_free(a);
+	OPENSSL_free(b);
+
+	return (ok);
+}
+
+/*
+ * 8.8: the statement carries no signature; x5c[0] must hold 'nonce',
+ * the SHA-256 of authenticatorData || clientDataHash, in its nonce
+ * extension, and certify the credential's public key.
+ */
+int
+fido_check_apple(const fido_blob_t *nonce, const fido_attstmt_t *attstmt,
+    const fido_attcred_t *attcred)
+{
+	const unsigned char	*p;
+	size_t			 n;
+	struct der		 seq, tag, oct;
+	X509			*cert = NULL;
+	int			 ok = -1;
+
+	if (attstmt->x5c.len == 0) {
+		fido_log_debug("%s: x5c.len=0", __func__);
+		return (-1);
+	}
+	if ((cert = fido_x5c_cert(&attstmt->x5c.ptr[0])) == NULL ||
+	    get_ext(cert, OID_APPLE_NONCE, &p, &n) < 0)
+		goto fail;
+
+	/* SEQUENCE { [1] EXPLICIT OCTET STRING } */
+	if (der_expect(&p, &n, DER_SEQUENCE, 0, &seq) < 0 || n != 0 ||
+	    der_expect(&seq.ptr, &seq.len, DER_CONTEXT, 1, &tag) < 0 ||
+	    der_expect(&tag.ptr, &tag.len, DER_OCTET_STRING, 0, &oct) < 0 ||
+	    oct.len != nonce->len ||
+	    timingsafe_bcmp(oct.ptr, nonce->ptr, nonce->len) != 0) {
+		fido_log_debug("%s: nonce", __func__);
+		goto fail;
+	}
+
+	if (check_cert_pubkey(cert, attcred) < 0)
+		goto fail;
+
+	ok = 0;
+fail:
+	X509_free(cert);
+
+	return (ok);
+}
+
+/* fold an AuthorizationList into 'purpose' and 'origin' */
+static int
+check_auth_list(struct der *list, bool *sign, bool *generated)
+{
+	struct der	 d, v, e;
+	uint32_t	 x;
+
+	while (list->len > 0) {
+		if (der_next(&list->ptr, &list->len, &d) < 0)
+			return (-1);
+		if (d.id != DER_CONTEXT)
+			continue;
+		switch (d.tag) {
+		case KM_TAG_PURPOSE:
+			if (der_expect(&d.ptr, &d.len, DER_SET, 0, &v) < 0)
+				return (-1);
+			while (v.len > 0) {
+				if (der_expect(&v.ptr, &v.len, DER_INTEGER, 0,
+				    &e) < 0 || der_uint(&e, &x) < 0)
+					return (-1);
+				if (x == KM_PURPOSE_SIGN)
+					*sign = true;
+			}
+			break;
+		case KM_TAG_ALL_APPLICATIONS:
+			fido_log_debug("%s: allApplications", __func__);
+			return (-1);
+		case KM_TAG_ORIGIN:
+			if (der_expect(&d.ptr, &d.len, DER_INTEGER, 0, &v) < 0 ||
+			    der_uint(&v, &x) < 0)
+				return (-1);
+			if (x == KM_ORIGIN_GENERATED)
+				*generated = true;
+			break;
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * 8.4: the signature is made as in "packed" and checked by the caller;
+ * x5c[0] must certify the credential's public key, and its key
+ * description must bind clientDataHash to a key generated in the
+ * keystore for signing, usable by the calling application only. As
+ * policy on the key's security level is left to the relying party, the
+ * software- and TEE-enforced authorisation lists are considered alike.
+ */
+int
+fido_check_android_key(const fido_blob_t *cdh, const fido_attstmt_t *attstmt,
+    const fido_attcred_t *attcred)
+{
+	const unsigned char	*p;
+	size_t			 n;
+	struct der		 desc, d;
+	X509			*cert = NULL;
+	bool			 sign = false;
+	bool			 generated = false;
+	int			 ok = -1;
+
+	if (attstmt->x5c.len == 0) {
+		fido_log_debug("%s: x5c.len=0", __func__);
+		return (-1);
+	}
+	if ((cert = fido_x5c_cert(&attstmt->x5c.ptr[0])) == NULL ||
+	    get_ext(cert, OID_ANDROID_KEY, &p, &n) < 0)
+		goto fail;
+
+	/*
+	 * KeyDescription ::= SEQUENCE { attestationVersion INTEGER,
+	 * attestationSecurityLevel ENUMERATED, keymasterVersion INTEGER,
+	 * keymasterSecurityLevel ENUMERATED, attestationChallenge OCTET
+	 * STRING, uniqueId OCTET STRING, softwareEnforced AuthorizationList,
+	 * teeEnforced AuthorizationList, ... }
+	 */
+	if (der_expect(&p, &n, DER_SEQUENCE, 0, &desc) < 0 || n != 0 ||
+	    der_expect(&desc.ptr, &desc.len, DER_INTEGER, 0, &d) < 0 ||
+	    der_expect(&desc.ptr, &desc.len, DER_ENUMERATED, 0, &d) < 0 ||
+	    der_expect(&desc.ptr, &desc.len, DER_INTEGER, 0, &d) < 0 ||
+	    der_expect(&desc.ptr, &desc.len, DER_ENUMERATED, 0, &d) < 0 ||
+	    der_expect(&desc.ptr, &desc.len, DER_OCTET_STRING, 0, &d) < 0) {
+		fido_log_debug("%s: key description", __func__);
+		goto fail;
+	}
+	if (d.len != cdh->len || timingsafe_bcmp(d.ptr, cdh->ptr,
+	    cdh->len) != 0) {
+		fido_log_debug("%s: attestationChallenge", __func__);
+		goto fail;
+	}
+	if (der_expect(&desc.ptr, &desc.len, DER_OCTET_STRING, 0, &d) < 0 ||
+	    der_expect(&desc.ptr, &desc.len, DER_SEQUENCE, 0, &d) < 0 ||
+	    check_auth_list(&d, &sign, &generated) < 0 ||
+	    der_expect(&desc.ptr, &desc.len, DER_SEQUENCE, 0, &d) < 0 ||
+	    check_auth_list(&d, &sign, &generated) < 0) {
+		fido_log_debug("%s: authorization list", __func__);
+		goto fail;
+	}
+	if (!sign || !generated) {
+		fido_log_debug("%s: sign=%d, generated=%d", __func__, sign,
+		    generated);
+		goto fail;
+	}
+
+	if (check_cert_pubkey(cert, attcred) < 0)
+		goto fail;
+
+	ok = 0;
+fail:
+	X509_free(cert);
+
+	return (ok);
+}
@@ -53,7 +53,7 @@ fido_dev_authkey_tx(fido_dev_t *dev, int *ms)
 	r = FIDO_OK;
 fail:
 	cbor_vector_free(argv, nitems(argv));
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return (r);
 }
@@ -62,6 +62,7 @@ static int
 fido_dev_authkey_rx(fido_dev_t *dev, es256_pk_t *authkey, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
@@ -70,12 +71,12 @@ fido_dev_authkey_rx(fido_dev_t *dev, es256_pk_t *authkey, int *ms)
 
 	memset(authkey, 0, sizeof(*authkey));
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -83,7 +84,7 @@ fido_dev_authkey_rx(fido_dev_t *dev, es256_pk_t *authkey, int *ms)
 
 	r = cbor_parse_reply(msg, (size_t)msglen, authkey, parse_authkey);
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
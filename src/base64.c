@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "fido.h"
+
+/*
+ * Base64 and base64url (RFC 4648) without OpenSSL BIOs. Blocks of 12
+ * bytes or 16 characters are converted with SSSE3 where the processor
+ * has it; the remainder, and other processors, use the scalar code.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <tmmintrin.h>
+#define BASE64_SSSE3
+#endif
+
+static const char base64_std[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char base64_url[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/*
+ * Character values; 0x40 marks '+' and '/', only valid in base64, 0x80
+ * marks '-' and '_', only valid in base64url, and 0xff invalid ones.
+ */
+static const uint8_t base64_val[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0x7e, 0xff, 0xbe, 0xff, 0x7f,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+	0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xbf,
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+	0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+	0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+#ifdef BASE64_SSSE3
+static int
+base64_ssse3(void)
+{
+#ifdef __SSSE3__
+	return (1);
+#else
+	return (__builtin_cpu_supports("ssse3"));
+#endif
+}
+
+/* 12 bytes to 16 characters per round; returns the bytes consumed */
+__attribute__((target("ssse3")))
+static size_t
+base64_encode_ssse3(const unsigned char *in, size_t len, char *out, bool url)
+{
+	const __m128i	shuf = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6,
+			    8, 7, 10, 9, 11, 10);
+	__m128i		off, v, idx, t;
+	size_t		n = 0;
+
+	/* from each range of indices to its characters */
+	off = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	    url ? '-' - 62 : '+' - 62, url ? '_' - 63 : '/' - 63, 'A', 0, 0);
+
+	/* each round loads 16 bytes */
+	while (len - n >= 16) {
+		v = _mm_loadu_si128((const __m128i *)(const void *)(in + n));
+		v = _mm_shuffle_epi8(v, shuf);
+		/* split each 24-bit group into four 6-bit indices */
+		t = _mm_mulhi_epu16(_mm_and_si128(v,
+		    _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+		idx = _mm_or_si128(t, _mm_mullo_epi16(_mm_and_si128(v,
+		    _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010)));
+		/* map each index to the offset of its range */
+		t = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+		t = _mm_or_si128(t, _mm_and_si128(_mm_cmpgt_epi8(
+		    _mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+		t = _mm_add_epi8(idx, _mm_shuffle_epi8(off, t));
+		_mm_storeu_si128((__m128i *)(void *)out, t);
+		out += 16;
+		n += 12;
+	}
+
+	return (n);
+}
+
+/*
+ * 16 characters to 12 bytes per round, stopping at the first block with
+ * an invalid character; returns the characters consumed. The 16-byte
+ * store of a round ends no later than its load, so 'out' may be 'in'.
+ */
+__attribute__((target("ssse3")))
+static size_t
+base64_decode_ssse3(const char *in, size_t len, unsigned char *out, bool url)
+{
+	/* high nibble classes; the classes each low nibble is invalid in */
+	const __m128i	lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04,
+			    0x08, 0x04, 0x20, 0x10, 0x10, 0x10, 0x10, 0x10,
+			    0x10, 0x10, 0x10);
+	const __m128i	lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11,
+			    0x11, 0x11, 0x11, 0x11, 0x11, 0x13,
+			    url ? 0x3b : 0x3a, 0x3b, url ? 0x3a : 0x3b, 0x3b,
+			    url ? 0x33 : 0x3a);
+	/* offsets by high nibble, and the one character that differs */
+	const __m128i	roll = _mm_setr_epi8(0, 0, url ? 17 : 19, 4, -65, -65,
+			    -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i	odd = _mm_set1_epi8(url ? '_' : '/');
+	const __m128i	fix = _mm_set1_epi8(url ? 33 : -3);
+	const __m128i	nib = _mm_set1_epi8(0x0f);
+	const __m128i	pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14,
+			    13, 12, -1, -1, -1, -1);
+	__m128i		v, hi, lo, t;
+	size_t		i = 0;
+
+	/* leave room for the 4 bytes stored past each round's 12 */
+	while (len - i >= 24) {
+		v = _mm_loadu_si128((const __m128i *)(const void *)(in + i));
+		hi = _mm_and_si128(_mm_srli_epi16(v, 4), nib);
+		lo = _mm_and_si128(v, nib);
+		t = _mm_and_si128(_mm_shuffle_epi8(lut_hi, hi),
+		    _mm_shuffle_epi8(lut_lo, lo));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(t,
+		    _mm_setzero_si128())) != 0xffff)
+			break;
+		t = _mm_add_epi8(_mm_shuffle_epi8(roll, hi),
+		    _mm_and_si128(_mm_cmpeq_epi8(v, odd), fix));
+		v = _mm_add_epi8(v, t);
+		/* merge four 6-bit values into 24 bits per 32-bit lane */
+		v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+		v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+		v = _mm_shuffle_epi8(v, pack);
+		_mm_storeu_si128((__m128i *)(void *)(out + i / 4 * 3), v);
+		i += 16;
+	}
+
+	return (i);
+}
+#endif /* BASE64_SSSE3 */
+
+int
+fido_base64_encode(const unsigned char *ptr, size_t len, char *out,
+    size_t *out_len, int flags)
+{
+	const char	*a;
+	size_t		 n = 0, o = 0, need;
+	uint32_t	 w;
+	bool		 url;
+
+	if ((ptr == NULL && len > 0) || out == NULL || out_len == NULL ||
+	    (flags & ~FIDO_BASE64_URL) != 0 || len > SIZE_MAX / 4 * 3 - 3) {
+		fido_log_debug("%s: invalid argument", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	url = (flags & FIDO_BASE64_URL) != 0;
+	a = url ? base64_url : base64_std;
+	if (url)
+		need = len / 3 * 4 + (len % 3 ? len % 3 + 1 : 0);
+	else
+		need = (len + 2) / 3 * 4;
+	if (*out_len <= need) {
+		fido_log_debug("%s: out_len=%zu, need=%zu", __func__,
+		    *out_len, need + 1);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+#ifdef BASE64_SSSE3
+	if (base64_ssse3()) {
+		n = base64_encode_ssse3(ptr, len, out, url);
+		o = n / 3 * 4;
+	}
+#endif
+	for (; len - n >= 3; n += 3) {
+		w = (uint32_t)ptr[n] << 16 | (uint32_t)ptr[n + 1] << 8 |
+		    ptr[n + 2];
+		out[o++] = a[w >> 18];
+		out[o++] = a[(w >> 12) & 0x3f];
+		out[o++] = a[(w >> 6) & 0x3f];
+		out[o++] = a[w & 0x3f];
+	}
+	if (len - n > 0) {
+		w = (uint32_t)ptr[n] << 16;
+		if (len - n == 2)
+			w |= (uint32_t)ptr[n + 1] << 8;
+		out[o++] = a[w >> 18];
+		out[o++] = a[(w >> 12) & 0x3f];
+		if (len - n == 2)
+			out[o++] = a[(w >> 6) & 0x3f];
+		while (!url && o % 4 != 0)
+			out[o++] = '=';
+	}
+
+	out[o] = '\0';
+	*out_len = o;
+
+	return (FIDO_OK);
+}
+
+int
+fido_base64_decode(const char *in, size_t len, unsigned char *out,
+    size_t *out_len, int flags)
+{
+	const uint8_t	 reject = (flags & FIDO_BASE64_URL) ? 0x40 : 0x80;
+	size_t		 i = 0, o = 0, pad = 0, need;
+	uint32_t	 w;
+	uint8_t		 c[4];
+
+	if ((in == NULL && len > 0) || out == NULL || out_len == NULL ||
+	    (flags & ~FIDO_BASE64_URL) != 0) {
+		fido_log_debug("%s: invalid argument", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	/* padding is optional in both alphabets */
+	while (len > 0 && in[len - 1] == '=' && pad < 2) {
+		len--;
+		pad++;
+	}
+	if (len % 4 == 1 || (pad > 0 && (len + pad) % 4 != 0)) {
+		fido_log_debug("%s: len=%zu, pad=%zu", __func__, len, pad);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+	need = len / 4 * 3 + (len % 4 ? len % 4 - 1 : 0);
+	if (*out_len < need) {
+		fido_log_debug("%s: out_len=%zu, need=%zu", __func__,
+		    *out_len, need);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+#ifdef BASE64_SSSE3
+	if (base64_ssse3()) {
+		i = base64_decode_ssse3(in, len, out,
+		    (flags & FIDO_BASE64_URL) != 0);
+		o = i / 4 * 3;
+	}
+#endif
+	/* each group is read before its bytes are written; 'out' may be 'in' */
+	for (; len - i >= 4; i += 4) {
+		c[0] = base64_val[(unsigned char)in[i]];
+		c[1] = base64_val[(unsigned char)in[i + 1]];
+		c[2] = base64_val[(unsigned char)in[i + 2]];
+		c[3] = base64_val[(unsigned char)in[i + 3]];
+		if ((c[0] | c[1] | c[2] | c[3]) & reject)
+			goto fail;
+		w = (uint32_t)(c[0] & 0x3f) << 18 |
+		    (uint32_t)(c[1] & 0x3f) << 12 |
+		    (uint32_t)(c[2] & 0x3f) << 6 | (c[3] & 0x3f);
+		out[o++] = (unsigned char)(w >> 16);
+		out[o++] = (unsigned char)(w >> 8);
+		out[o++] = (unsigned char)w;
+	}
+	/* two or three characters left */
+	if (len - i > 0) {
+		c[0] = base64_val[(unsigned char)in[i]];
+		c[1] = base64_val[(unsigned char)in[i + 1]];
+		c[2] = len - i == 3 ? base64_val[(unsigned char)in[i + 2]] : 0;
+		if ((c[0] | c[1] | c[2]) & reject)
+			goto fail;
+		w = (uint32_t)(c[0] & 0x3f) << 18 |
+		    (uint32_t)(c[1] & 0x3f) << 12 |
+		    (uint32_t)(c[2] & 0x3f) << 6;
+		out[o++] = (unsigned char)(w >> 16);
+		if (len - i == 3)
+			out[o++] = (unsigned char)(w >> 8);
+	}
+
+	*out_len = o;
+
+	return (FIDO_OK);
+fail:
+	fido_log_debug("%s: invalid character in group at %zu", __func__, i);
+
+	return (FIDO_ERR_INVALID_ARGUMENT);
+}
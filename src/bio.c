@@ -41,7 +41,7 @@ bio_prepare_hmac(uint8_t cmd, cbor_item_t **argv, size_t argc,
 		goto fail;
 	}
 
-	if ((hmac_data->ptr = malloc(cbor_len + sizeof(prefix))) == NULL) {
+	if ((hmac_data->ptr = fido_malloc(cbor_len + sizeof(prefix))) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		goto fail;
 	}
@@ -52,7 +52,7 @@ bio_prepare_hmac(uint8_t cmd, cbor_item_t **argv, size_t argc,
 
 	ok = 0;
 fail:
-	free(cbor);
+	fido_free(cbor);
 
 	return (ok);
 }
@@ -75,13 +75,21 @@ bio_tx(fido_dev_t *dev, uint8_t subcmd, cbor_item_t **sub_argv, size_t sub_argc,
 	fido_blob_t	*ecdh = NULL;
 	fido_blob_t	 f;
 	fido_blob_t	 hmac;
-	const uint8_t	 cmd = bio_get_cmd(dev);
+	uint8_t		 cmd;
 	int		 r = FIDO_ERR_INTERNAL;
 
 	memset(&f, 0, sizeof(f));
 	memset(&hmac, 0, sizeof(hmac));
 	memset(&argv, 0, sizeof(argv));
 
+	if ((r = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		goto fail;
+	}
+
+	r = FIDO_ERR_INTERNAL;
+	cmd = bio_get_cmd(dev);
+
 	/* modality, subCommand */
 	if ((argv[0] = cbor_build_uint8(1)) == NULL ||
 	    (argv[1] = cbor_build_uint8(subcmd)) == NULL) {
@@ -130,8 +138,8 @@ fail:
 	cbor_vector_free(argv, nitems(argv));
 	es256_pk_free(&pk);
 	fido_blob_free(&ecdh);
-	free(f.ptr);
-	free(hmac.ptr);
+	fido_free(f.ptr);
+	fido_free(hmac.ptr);
 
 	return (r);
 }
@@ -139,7 +147,7 @@ fail:
 static void
 bio_reset_template(fido_bio_template_t *t)
 {
-	free(t->name);
+	fido_free(t->name);
 	t->name = NULL;
 	fido_blob_reset(&t->id);
 }
@@ -150,7 +158,7 @@ bio_reset_template_array(fido_bio_template_array_t *ta)
 	for (size_t i = 0; i < ta->n_alloc; i++)
 		bio_reset_template(&ta->ptr[i]);
 
-	free(ta->ptr);
+	fido_free(ta->ptr);
 	ta->ptr = NULL;
 	memset(ta, 0, sizeof(*ta));
 }
@@ -227,7 +235,8 @@ bio_parse_template_array(const cbor_item_t *key, const cbor_item_t *val,
 		return (-1);
 	}
 
-	if ((ta->ptr = calloc(cbor_array_size(val), sizeof(*ta->ptr))) == NULL)
+	if ((ta->ptr = fido_calloc(cbor_array_size(val),
+	    sizeof(*ta->ptr))) == NULL)
 		return (-1);
 
 	ta->n_alloc = cbor_array_size(val);
@@ -244,17 +253,18 @@ static int
 bio_rx_template_array(fido_dev_t *dev, fido_bio_template_array_t *ta, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
 	bio_reset_template_array(ta);
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -268,7 +278,7 @@ bio_rx_template_array(fido_dev_t *dev, fido_bio_template_array_t *ta, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
@@ -290,12 +300,17 @@ int
 fido_bio_dev_get_template_array(fido_dev_t *dev, fido_bio_template_array_t *ta,
     const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
 
 	if (pin == NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	return (bio_get_template_array_wait(dev, ta, pin, &ms));
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = bio_get_template_array_wait(dev, ta, pin, &ms);
+
+	return (fido_trace_end(&span, r));
 }
 
 static int
@@ -331,12 +346,17 @@ int
 fido_bio_dev_set_template_name(fido_dev_t *dev, const fido_bio_template_t *t,
     const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
 
 	if (pin == NULL || t->name == NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	return (bio_set_template_name_wait(dev, t, pin, &ms));
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = bio_set_template_name_wait(dev, t, pin, &ms);
+
+	return (fido_trace_end(&span, r));
 }
 
 static void
@@ -405,6 +425,7 @@ bio_rx_enroll_begin(fido_dev_t *dev, fido_bio_template_t *t,
     fido_bio_enroll_t *e, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
@@ -413,12 +434,12 @@ bio_rx_enroll_begin(fido_dev_t *dev, fido_bio_template_t *t,
 	e->remaining_samples = 0;
 	e->last_status = 0;
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -438,7 +459,7 @@ bio_rx_enroll_begin(fido_dev_t *dev, fido_bio_template_t *t,
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
@@ -475,15 +496,18 @@ int
 fido_bio_dev_enroll_begin(fido_dev_t *dev, fido_bio_template_t *t,
     fido_bio_enroll_t *e, uint32_t timo_ms, const char *pin)
 {
+	fido_trace_t	 span;
 	es256_pk_t	*pk = NULL;
 	fido_blob_t	*ecdh = NULL;
 	fido_blob_t	*token = NULL;
-	int		 ms = dev->timeout_ms;
+	int		 ms = fido_time_budget(dev->timeout_ms);
 	int		 r;
 
 	if (pin == NULL || e->token != NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+
 	if ((token = fido_blob_new()) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
@@ -494,8 +518,9 @@ fido_bio_dev_enroll_begin(fido_dev_t *dev, fido_bio_template_t *t,
 		goto fail;
 	}
 
-	if ((r = fido_dev_get_uv_token(dev, CTAP_CBOR_BIO_ENROLL_PRE, pin, ecdh,
-	    pk, NULL, token, &ms)) != FIDO_OK) {
+	/* the command bio_tx() uses, so that a cached token is shared */
+	if ((r = fido_dev_get_uv_token(dev, bio_get_cmd(dev), pin, ecdh, pk,
+	    NULL, token, &ms)) != FIDO_OK) {
 		fido_log_debug("%s: fido_dev_get_uv_token", __func__);
 		goto fail;
 	}
@@ -507,28 +532,29 @@ fail:
 	fido_blob_free(&ecdh);
 	fido_blob_free(&token);
 
-	if (r != FIDO_OK)
-		return (r);
+	if (r == FIDO_OK)
+		r = bio_enroll_begin_wait(dev, t, e, timo_ms, &ms);
 
-	return (bio_enroll_begin_wait(dev, t, e, timo_ms, &ms));
+	return (fido_trace_end(&span, r));
 }
 
 static int
 bio_rx_enroll_continue(fido_dev_t *dev, fido_bio_enroll_t *e, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
 	e->remaining_samples = 0;
 	e->last_status = 0;
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -542,14 +568,14 @@ bio_rx_enroll_continue(fido_dev_t *dev, fido_bio_enroll_t *e, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
 
 static int
-bio_enroll_continue_wait(fido_dev_t *dev, const fido_bio_template_t *t,
-    fido_bio_enroll_t *e, uint32_t timo_ms, int *ms)
+bio_enroll_continue_tx(fido_dev_t *dev, const fido_bio_template_t *t,
+    const fido_bio_enroll_t *e, uint32_t timo_ms, int *ms)
 {
 	cbor_item_t	*argv[3];
 	const uint8_t	 cmd = CMD_ENROLL_NEXT;
@@ -563,9 +589,8 @@ bio_enroll_continue_wait(fido_dev_t *dev, const fido_bio_template_t *t,
 		goto fail;
 	}
 
-	if ((r = bio_tx(dev, cmd, argv, 3, NULL, e->token, ms)) != FIDO_OK ||
-	    (r = bio_rx_enroll_continue(dev, e, ms)) != FIDO_OK) {
-		fido_log_debug("%s: tx/rx", __func__);
+	if ((r = bio_tx(dev, cmd, argv, 3, NULL, e->token, ms)) != FIDO_OK) {
+		fido_log_debug("%s: bio_tx", __func__);
 		goto fail;
 	}
 
@@ -576,16 +601,77 @@ fail:
 	return (r);
 }
 
+static int
+bio_enroll_continue_wait(fido_dev_t *dev, const fido_bio_template_t *t,
+    fido_bio_enroll_t *e, uint32_t timo_ms, int *ms)
+{
+	int r;
+
+	if ((r = bio_enroll_continue_tx(dev, t, e, timo_ms, ms)) != FIDO_OK ||
+	    (r = bio_rx_enroll_continue(dev, e, ms)) != FIDO_OK) {
+		fido_log_debug("%s: tx/rx", __func__);
+		return (r);
+	}
+
+	return (FIDO_OK);
+}
+
 int
 fido_bio_dev_enroll_continue(fido_dev_t *dev, const fido_bio_template_t *t,
     fido_bio_enroll_t *e, uint32_t timo_ms)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	if (e->token == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = bio_enroll_continue_wait(dev, t, e, timo_ms, &ms);
+
+	return (fido_trace_end(&span, r));
+}
+
+int
+fido_bio_dev_enroll_submit(fido_dev_t *dev, const fido_bio_template_t *t,
+    fido_bio_enroll_t *e, uint32_t timo_ms)
+{
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
 
 	if (e->token == NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	return (bio_enroll_continue_wait(dev, t, e, timo_ms, &ms));
+	fido_dev_async_reset(dev);
+
+	if ((r = bio_enroll_continue_tx(dev, t, e, timo_ms, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: bio_enroll_continue_tx", __func__);
+		return (r);
+	}
+
+	dev->async_cmd = bio_get_cmd(dev);
+
+	return (FIDO_OK);
+}
+
+int
+fido_bio_dev_enroll_complete(fido_dev_t *dev, fido_bio_enroll_t *e)
+{
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	if (dev->async_cmd != CTAP_CBOR_BIO_ENROLL &&
+	    dev->async_cmd != CTAP_CBOR_BIO_ENROLL_PRE) {
+		fido_log_debug("%s: async_cmd=0x%02x", __func__,
+		    dev->async_cmd);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	r = bio_rx_enroll_continue(dev, e, &ms);
+	fido_dev_async_reset(dev);
+
+	return (r);
 }
 
 static int
@@ -606,9 +692,14 @@ bio_enroll_cancel_wait(fido_dev_t *dev, int *ms)
 int
 fido_bio_dev_enroll_cancel(fido_dev_t *dev)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = bio_enroll_cancel_wait(dev, &ms);
 
-	return (bio_enroll_cancel_wait(dev, &ms));
+	return (fido_trace_end(&span, r));
 }
 
 static int
@@ -643,9 +734,14 @@ int
 fido_bio_dev_enroll_remove(fido_dev_t *dev, const fido_bio_template_t *t,
     const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = bio_enroll_remove_wait(dev, t, pin, &ms);
 
-	return (bio_enroll_remove_wait(dev, t, pin, &ms));
+	return (fido_trace_end(&span, r));
 }
 
 static void
@@ -693,17 +789,18 @@ static int
 bio_rx_info(fido_dev_t *dev, fido_bio_info_t *i, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
 	bio_reset_info(i);
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -717,13 +814,13 @@ bio_rx_info(fido_dev_t *dev, fido_bio_info_t *i, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
 
-static int
-bio_get_info_wait(fido_dev_t *dev, fido_bio_info_t *i, int *ms)
+int
+fido_bio_get_info_wait(fido_dev_t *dev, fido_bio_info_t *i, int *ms)
 {
 	int r;
 
@@ -740,9 +837,14 @@ bio_get_info_wait(fido_dev_t *dev, fido_bio_info_t *i, int *ms)
 int
 fido_bio_dev_get_info(fido_dev_t *dev, fido_bio_info_t *i)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = fido_bio_get_info_wait(dev, i, &ms);
 
-	return (bio_get_info_wait(dev, i, &ms));
+	return (fido_trace_end(&span, r));
 }
 
 const char *
@@ -772,13 +874,13 @@ fido_bio_template_array_count(const fido_bio_template_array_t *ta)
 fido_bio_template_array_t *
 fido_bio_template_array_new(void)
 {
-	return (calloc(1, sizeof(fido_bio_template_array_t)));
+	return (fido_calloc(1, sizeof(fido_bio_template_array_t)));
 }
 
 fido_bio_template_t *
 fido_bio_template_new(void)
 {
-	return (calloc(1, sizeof(fido_bio_template_t)));
+	return (fido_calloc(1, sizeof(fido_bio_template_t)));
 }
 
 void
@@ -790,7 +892,7 @@ fido_bio_template_array_free(fido_bio_template_array_t **tap)
 		return;
 
 	bio_reset_template_array(ta);
-	free(ta);
+	fido_free(ta);
 	*tap = NULL;
 }
 
@@ -803,17 +905,17 @@ fido_bio_template_free(fido_bio_template_t **tp)
 		return;
 
 	bio_reset_template(t);
-	free(t);
+	fido_free(t);
 	*tp = NULL;
 }
 
 int
 fido_bio_template_set_name(fido_bio_template_t *t, const char *name)
 {
-	free(t->name);
+	fido_free(t->name);
 	t->name = NULL;
 
-	if (name && (t->name = strdup(name)) == NULL)
+	if (name && (t->name = fido_strdup(name)) == NULL)
 		return (FIDO_ERR_INTERNAL);
 
 	return (FIDO_OK);
@@ -843,13 +945,13 @@ fido_bio_template(const fido_bio_template_array_t *ta, size_t idx)
 fido_bio_enroll_t *
 fido_bio_enroll_new(void)
 {
-	return (calloc(1, sizeof(fido_bio_enroll_t)));
+	return (fido_calloc(1, sizeof(fido_bio_enroll_t)));
 }
 
 fido_bio_info_t *
 fido_bio_info_new(void)
 {
-	return (calloc(1, sizeof(fido_bio_info_t)));
+	return (fido_calloc(1, sizeof(fido_bio_info_t)));
 }
 
 uint8_t
@@ -874,7 +976,7 @@ fido_bio_enroll_free(fido_bio_enroll_t **ep)
 
 	bio_reset_enroll(e);
 
-	free(e);
+	fido_free(e);
 	*ep = NULL;
 }
 
@@ -886,7 +988,7 @@ fido_bio_info_free(fido_bio_info_t **ip)
 	if (ip == NULL || (i = *ip) == NULL)
 		return;
 
-	free(i);
+	fido_free(i);
 	*ip = NULL;
 }
 
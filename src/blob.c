@@ -10,57 +10,169 @@
 fido_blob_t *
 fido_blob_new(void)
 {
-	return calloc(1, sizeof(fido_blob_t));
+	return fido_calloc(1, sizeof(fido_blob_t));
+}
+
+/*
+ * The allocated size of 'b'; blobs filled outside this file leave cap at 0,
+ * and views have none.
+ */
+static size_t
+blob_cap(const fido_blob_t *b)
+{
+	if (b->ptr == NULL || b->view)
+		return 0;
+
+	return b->cap > b->len ? b->cap : b->len;
+}
+
+/* reuse the buffer of 'b' if it holds 'len' bytes */
+static int
+blob_reuse(fido_blob_t *b, const u_char *ptr, size_t len)
+{
+	size_t cap;
+
+	if ((cap = blob_cap(b)) < len)
+		return -1;
+
+	memcpy(b->ptr, ptr, len);
+	explicit_bzero(b->ptr + len, cap - len);
+	b->len = len;
+	b->cap = cap;
+
+	return 0;
 }
 
 void
 fido_blob_reset(fido_blob_t *b)
 {
-	freezero(b->ptr, b->len);
+	if (!b->view)
+		fido_freezero(b->ptr, blob_cap(b));
 	explicit_bzero(b, sizeof(*b));
 }
 
+/* empty 'b', keeping its buffer for the next fido_blob_set() */
+void
+fido_blob_clear(fido_blob_t *b)
+{
+	if (b->view) {
+		explicit_bzero(b, sizeof(*b));
+		return;
+	}
+	if (b->ptr == NULL)
+		return;
+
+	b->cap = blob_cap(b);
+	b->len = 0;
+	explicit_bzero(b->ptr, b->cap);
+}
+
 int
 fido_blob_set(fido_blob_t *b, const u_char *ptr, size_t len)
 {
-	fido_blob_reset(b);
-
 	if (ptr == NULL || len == 0) {
 		fido_log_debug("%s: ptr=%p, len=%zu", __func__,
 		    (const void *)ptr, len);
+		fido_blob_reset(b);
 		return -1;
 	}
 
-	if ((b->ptr = malloc(len)) == NULL) {
+	if (blob_reuse(b, ptr, len) == 0)
+		return 0;
+
+	fido_blob_reset(b);
+
+	if ((b->ptr = fido_malloc(len)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		return -1;
 	}
 
 	memcpy(b->ptr, ptr, len);
 	b->len = len;
+	b->cap = len;
 
 	return 0;
 }
 
+/* as fido_blob_set(), for secrets; see secmem.c */
 int
-fido_blob_append(fido_blob_t *b, const u_char *ptr, size_t len)
+fido_blob_set_secure(fido_blob_t *b, const u_char *ptr, size_t len)
 {
-	u_char *tmp;
-
 	if (ptr == NULL || len == 0) {
 		fido_log_debug("%s: ptr=%p, len=%zu", __func__,
 		    (const void *)ptr, len);
+		fido_blob_reset(b);
 		return -1;
 	}
-	if (SIZE_MAX - b->len < len) {
+
+	/* only a pooled buffer may be reused */
+	if (fido_secure_size(b->ptr) != 0 && blob_reuse(b, ptr, len) == 0)
+		return 0;
+
+	fido_blob_reset(b);
+
+	if ((b->ptr = fido_secure_alloc(len)) == NULL) {
+		fido_log_debug("%s: fido_secure_alloc", __func__);
+		return -1;
+	}
+
+	memcpy(b->ptr, ptr, len);
+	b->len = len;
+	b->cap = len;
+
+	return 0;
+}
+
+/*
+ * Make room for 'n' more bytes in 'b'. A buffer that must grow at least
+ * doubles, so that a series of appends copies each byte O(1) times.
+ */
+int
+fido_blob_reserve(fido_blob_t *b, size_t n)
+{
+	u_char	*tmp;
+	size_t	 cap, need;
+
+	if ((cap = blob_cap(b)) - b->len >= n)
+		return 0;
+	if (SIZE_MAX - b->len < n) {
 		fido_log_debug("%s: overflow", __func__);
 		return -1;
 	}
-	if ((tmp = realloc(b->ptr, b->len + len)) == NULL) {
+	need = b->len + n;
+	if (cap <= SIZE_MAX / 2 && cap * 2 > need)
+		need = cap * 2;
+	if (b->view) {
+		/* copy out of the borrowed buffer */
+		if ((tmp = fido_malloc(need)) == NULL) {
+			fido_log_debug("%s: malloc", __func__);
+			return -1;
+		}
+		if (b->len > 0)
+			memcpy(tmp, b->ptr, b->len);
+		b->view = false;
+	} else if ((tmp = fido_realloc(b->ptr, need)) == NULL) {
 		fido_log_debug("%s: realloc", __func__);
 		return -1;
 	}
 	b->ptr = tmp;
+	b->cap = need;
+
+	return 0;
+}
+
+int
+fido_blob_append(fido_blob_t *b, const u_char *ptr, size_t len)
+{
+	if (ptr == NULL || len == 0) {
+		fido_log_debug("%s: ptr=%p, len=%zu", __func__,
+		    (const void *)ptr, len);
+		return -1;
+	}
+	if (fido_blob_reserve(b, len) < 0) {
+		fido_log_debug("%s: fido_blob_reserve", __func__);
+		return -1;
+	}
 	memcpy(&b->ptr[b->len], ptr, len);
 	b->len += len;
 
@@ -76,25 +188,83 @@ fido_blob_free(fido_blob_t **bp)
 		return;
 
 	fido_blob_reset(b);
-	free(b);
+	fido_free(b);
 	*bp = NULL;
 }
 
+/* the allocated entries of 'array'; arrays filled elsewhere leave cap at 0 */
+static size_t
+blob_array_cap(const fido_blob_array_t *array)
+{
+	if (array->ptr == NULL)
+		return 0;
+
+	return array->cap > array->len ? array->cap : array->len;
+}
+
+/* make room for 'n' more entries in 'array', growing it geometrically */
+int
+fido_blob_array_reserve(fido_blob_array_t *array, size_t n)
+{
+	fido_blob_t	*tmp;
+	size_t		 cap, need;
+
+	if ((cap = blob_array_cap(array)) - array->len >= n)
+		return 0;
+	if (SIZE_MAX - array->len < n) {
+		fido_log_debug("%s: overflow", __func__);
+		return -1;
+	}
+	need = array->len + n;
+	if (cap <= SIZE_MAX / 2 && cap * 2 > need)
+		need = cap * 2;
+	if ((tmp = fido_recallocarray(array->ptr, cap, need,
+	    sizeof(*tmp))) == NULL) {
+		fido_log_debug("%s: recallocarray", __func__);
+		return -1;
+	}
+	array->ptr = tmp;
+	array->cap = need;
+
+	return 0;
+}
+
+/* append a copy of the 'len' bytes at 'ptr' to 'array' */
+int
+fido_blob_array_append(fido_blob_array_t *array, const u_char *ptr,
+    size_t len)
+{
+	fido_blob_t b;
+
+	memset(&b, 0, sizeof(b));
+
+	if (fido_blob_set(&b, ptr, len) < 0) {
+		fido_log_debug("%s: fido_blob_set", __func__);
+		return -1;
+	}
+	if (fido_blob_array_reserve(array, 1) < 0) {
+		fido_log_debug("%s: fido_blob_array_reserve", __func__);
+		fido_blob_reset(&b);
+		return -1;
+	}
+	array->ptr[array->len++] = b;
+
+	return 0;
+}
+
 void
 fido_free_blob_array(fido_blob_array_t *array)
 {
 	if (array->ptr == NULL)
 		return;
 
-	for (size_t i = 0; i < array->len; i++) {
-		fido_blob_t *b = &array->ptr[i];
-		freezero(b->ptr, b->len);
-		b->ptr = NULL;
-	}
+	for (size_t i = 0; i < array->len; i++)
+		fido_blob_reset(&array->ptr[i]);
 
-	free(array->ptr);
+	fido_free(array->ptr);
 	array->ptr = NULL;
 	array->len = 0;
+	array->cap = 0;
 }
 
 cbor_item_t *
@@ -109,6 +279,18 @@ fido_blob_encode(const fido_blob_t *b)
 int
 fido_blob_decode(const cbor_item_t *item, fido_blob_t *b)
 {
+	if (!fido_blob_is_empty(b)) {
+		fido_log_debug("%s: dup", __func__);
+		return -1;
+	}
+	if (b->ptr != NULL && cbor_isa_bytestring(item) &&
+	    cbor_bytestring_is_definite(item) &&
+	    cbor_bytestring_length(item) != 0)
+		return fido_blob_set(b, cbor_bytestring_handle(item),
+		    cbor_bytestring_length(item));
+
+	fido_blob_reset(b);
+
 	return cbor_bytestring_copy(item, &b->ptr, &b->len);
 }
 
@@ -125,10 +307,12 @@ fido_blob_serialise(fido_blob_t *b, const cbor_item_t *item)
 
 	if (!fido_blob_is_empty(b))
 		return -1;
+	fido_blob_reset(b);
 	if ((b->len = cbor_serialize_alloc(item, &b->ptr, &alloc)) == 0) {
 		b->ptr = NULL;
 		return -1;
 	}
+	b->cap = alloc;
 
 	return 0;
 }
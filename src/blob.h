@@ -9,6 +9,7 @@
 #define _BLOB_H
 
 #include <cbor.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -18,11 +19,14 @@ extern "C" {
 typedef struct fido_blob {
 	unsigned char	*ptr;
 	size_t		 len;
+	size_t		 cap; /* allocated size, if above len */
+	bool		 view; /* ptr borrowed from a buffer owned elsewhere */
 } fido_blob_t;
 
 typedef struct fido_blob_array {
 	fido_blob_t	*ptr;
 	size_t		 len;
+	size_t		 cap; /* allocated entries, if above len */
 } fido_blob_array_t;
 
 cbor_item_t *fido_blob_encode(const fido_blob_t *);
@@ -30,9 +34,14 @@ fido_blob_t *fido_blob_new(void);
 int fido_blob_decode(const cbor_item_t *, fido_blob_t *);
 int fido_blob_is_empty(const fido_blob_t *);
 int fido_blob_set(fido_blob_t *, const u_char *, size_t);
+int fido_blob_set_secure(fido_blob_t *, const u_char *, size_t);
 int fido_blob_append(fido_blob_t *, const u_char *, size_t);
+int fido_blob_reserve(fido_blob_t *, size_t);
+void fido_blob_clear(fido_blob_t *);
 void fido_blob_free(fido_blob_t **);
 void fido_blob_reset(fido_blob_t *);
+int fido_blob_array_append(fido_blob_array_t *, const u_char *, size_t);
+int fido_blob_array_reserve(fido_blob_array_t *, size_t);
 void fido_free_blob_array(fido_blob_array_t *);
 
 #ifdef __cplusplus
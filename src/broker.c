@@ -0,0 +1,726 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef USE_BROKER
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "fido.h"
+
+/*
+ * A broker owns a HID authenticator and shares it with other processes
+ * over a unix socket, so that they need not take turns opening the
+ * device. Each record on the socket is one HID report. Clients run
+ * CTAPHID_INIT as they would on the device, and get a channel of their
+ * own from it; the broker forwards their reports as they come, and
+ * routes the device's reports back by channel id. A client may only use
+ * the channels allocated to it. The device arbitrates between channels
+ * as it would between processes; fido_dev_lock() keeps the others out.
+ *
+ * The getInfo reply is kept and returned to later clients without
+ * asking the device, until a request that may change it is forwarded.
+ *
+ * Requests are forwarded one at a time: once a client's request is on
+ * its way to the device, the other clients are not read from until the
+ * reply has been routed back, so that their requests queue up in their
+ * sockets instead of failing with CTAP1_ERR_CHANNEL_BUSY. Clients are
+ * served in turn.
+ *
+ * Clients open "broker:" followed by the path of the socket. Within the
+ * process, fido_broker_attach() hands the broker one end of a socket
+ * pair instead, so that application threads may share the device
+ * through it, each with a fido_dev_t of its own, while another thread
+ * runs fido_broker_work().
+ */
+
+#ifdef USE_BROKER
+
+#define BROKER_MAXCLIENT	64
+#define BROKER_MAXCID		4	/* channels remembered per client */
+#define BROKER_REPORT_LEN	CTAP_DEF_REPORT_LEN
+#define BROKER_BUSY_MS		5000	/* device silence ending a turn */
+
+#ifndef MIN
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+#endif
+
+struct broker_client {
+	int		fd;
+	uint32_t	cid[BROKER_MAXCID];	/* allocated to the client */
+	size_t		next;			/* cid slot to fill next */
+	unsigned char	nonce[8];		/* of a pending CTAPHID_INIT */
+	bool		init;
+};
+
+struct broker_io {
+	int fd;
+};
+
+static bool
+broker_owns(const struct broker_client *c, uint32_t cid)
+{
+	for (size_t i = 0; i < BROKER_MAXCID; i++)
+		if (c->cid[i] == cid && cid != 0)
+			return (true);
+
+	return (false);
+}
+
+static void
+broker_learn(struct broker_client *c, const unsigned char *pkt)
+{
+	uint32_t cid;
+
+	/* the allocated channel follows the nonce */
+	memcpy(&cid, pkt + CTAP_INIT_HEADER_LEN + sizeof(c->nonce),
+	    sizeof(cid));
+	if (cid == CTAP_CID_BROADCAST || broker_owns(c, cid))
+		return;
+
+	c->cid[c->next++ % BROKER_MAXCID] = cid;
+}
+
+static void
+broker_drop(fido_broker_t *b, size_t i)
+{
+	fido_log_debug("%s: client %zu", __func__, i);
+
+	if (b->client[i].fd == b->busy)
+		b->busy = -1;
+	fido_sock_close(b->client[i].fd);
+	b->client[i] = b->client[--b->nclient];
+}
+
+/* whether a cbor request leaves the getInfo reply as it is */
+static bool
+broker_keeps_info(uint8_t cmd)
+{
+	switch (cmd) {
+	case CTAP_CBOR_ASSERT:
+	case CTAP_CBOR_GETINFO:
+	case CTAP_CBOR_NEXT_ASSERT:
+	case CTAP_CBOR_LARGEBLOB:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
+/* reassemble the getInfo reply as it is routed to the client asking */
+static void
+broker_info_capture(fido_broker_t *b, const unsigned char *pkt, uint32_t cid)
+{
+	const size_t	len = b->report_len;
+	size_t		n;
+
+	if (!b->info_capture || cid != b->info_cid)
+		return;
+
+	if (pkt[4] == (CTAP_FRAME_INIT | CTAP_CMD_CBOR)) {
+		b->info_want = (size_t)((pkt[5] << 8) | pkt[6]);
+		b->info_seq = 0;
+		fido_blob_reset(&b->info_rx);
+		n = MIN(b->info_want, len - CTAP_INIT_HEADER_LEN);
+		if (fido_blob_append(&b->info_rx, pkt + CTAP_INIT_HEADER_LEN,
+		    n) < 0)
+			goto fail;
+	} else if ((pkt[4] & CTAP_FRAME_INIT) == 0 &&
+	    b->info_rx.len != 0 && pkt[4] == b->info_seq) {
+		b->info_seq++;
+		n = MIN(b->info_want - b->info_rx.len,
+		    len - CTAP_CONT_HEADER_LEN);
+		if (fido_blob_append(&b->info_rx, pkt + CTAP_CONT_HEADER_LEN,
+		    n) < 0)
+			goto fail;
+	} else {
+		return; /* keepalive */
+	}
+	if (b->info_rx.len < b->info_want)
+		return;
+
+	if (b->info_rx.len > 1 && b->info_rx.ptr[0] == FIDO_OK) {
+		fido_blob_reset(&b->info);
+		b->info = b->info_rx;
+		memset(&b->info_rx, 0, sizeof(b->info_rx));
+	}
+fail:
+	fido_blob_reset(&b->info_rx);
+	b->info_capture = false;
+}
+
+/* answer a getInfo request from the kept reply */
+static int
+broker_info_reply(const fido_broker_t *b, const struct broker_client *c,
+    uint32_t cid)
+{
+	unsigned char	pkt[BROKER_REPORT_LEN];
+	const size_t	len = b->report_len;
+	size_t		off, n;
+	uint8_t		seq = 0;
+
+	memset(pkt, 0, sizeof(pkt));
+	memcpy(pkt, &cid, sizeof(cid));
+	pkt[4] = CTAP_FRAME_INIT | CTAP_CMD_CBOR;
+	pkt[5] = (uint8_t)(b->info.len >> 8);
+	pkt[6] = (uint8_t)(b->info.len & 0xff);
+	n = MIN(b->info.len, len - CTAP_INIT_HEADER_LEN);
+	memcpy(pkt + CTAP_INIT_HEADER_LEN, b->info.ptr, n);
+	if (fido_sock_send(c->fd, pkt, len) < 0)
+		return (-1);
+
+	for (off = n; off < b->info.len; off += n) {
+		memset(pkt + sizeof(cid), 0, len - sizeof(cid));
+		pkt[4] = seq++;
+		n = MIN(b->info.len - off, len - CTAP_CONT_HEADER_LEN);
+		memcpy(pkt + CTAP_CONT_HEADER_LEN, b->info.ptr + off, n);
+		if (fido_sock_send(c->fd, pkt, len) < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/* forward a report from a client; FIDO_ERR_RX if the client is gone */
+static int
+broker_request(fido_broker_t *b, struct broker_client *c)
+{
+	unsigned char		 buf[BROKER_REPORT_LEN + 1]; /* report id */
+	const unsigned char	*pkt = buf + 1;
+	const size_t		 len = b->report_len + 1;
+	uint32_t		 cid;
+
+	if (fido_sock_recv(c->fd, buf, len) < 0)
+		return (FIDO_ERR_RX);
+
+	memcpy(&cid, pkt, sizeof(cid));
+	if (cid == CTAP_CID_BROADCAST) {
+		if (pkt[4] != (CTAP_FRAME_INIT | CTAP_CMD_INIT)) {
+			fido_log_debug("%s: broadcast cmd 0x%02x", __func__,
+			    pkt[4]);
+			return (FIDO_OK);
+		}
+		memcpy(c->nonce, pkt + CTAP_INIT_HEADER_LEN, sizeof(c->nonce));
+		c->init = true;
+	} else if (!broker_owns(c, cid)) {
+		fido_log_debug("%s: cid 0x%x not allocated to client",
+		    __func__, cid);
+		return (FIDO_OK);
+	} else if (pkt[4] == (CTAP_FRAME_INIT | CTAP_CMD_CBOR)) {
+		if (pkt[5] == 0 && pkt[6] == 1 &&
+		    pkt[CTAP_INIT_HEADER_LEN] == CTAP_CBOR_GETINFO) {
+			if (b->info.len != 0)
+				return (broker_info_reply(b, c, cid) < 0 ?
+				    FIDO_ERR_RX : FIDO_OK);
+			b->info_capture = true;
+			b->info_cid = cid;
+		} else if (!broker_keeps_info(pkt[CTAP_INIT_HEADER_LEN])) {
+			fido_blob_reset(&b->info);
+		}
+	}
+
+	if (fido_hid_write(b->dev, buf, len) != (int)len) {
+		fido_log_debug("%s: fido_hid_write", __func__);
+		return (FIDO_ERR_TX);
+	}
+
+	/* a new request, other than a cancel, starts the client's turn */
+	if ((pkt[4] & CTAP_FRAME_INIT) &&
+	    pkt[4] != (CTAP_FRAME_INIT | CTAP_CMD_CANCEL)) {
+		b->busy = c->fd;
+		b->busy_rx = false;
+		(void)fido_time_deadline(&b->busy_dl, BROKER_BUSY_MS, NULL);
+	}
+
+	return (FIDO_OK);
+}
+
+/* follow the reply to the client being served; its end ends the turn */
+static void
+broker_progress(fido_broker_t *b, const unsigned char *pkt)
+{
+	const size_t len = b->report_len;
+
+	(void)fido_time_deadline(&b->busy_dl, BROKER_BUSY_MS, NULL);
+
+	if (pkt[4] & CTAP_FRAME_INIT) {
+		if (pkt[4] == (CTAP_FRAME_INIT | CTAP_KEEPALIVE))
+			return;
+		b->busy_want = (size_t)((pkt[5] << 8) | pkt[6]);
+		b->busy_got = MIN(b->busy_want, len - CTAP_INIT_HEADER_LEN);
+		b->busy_rx = true;
+	} else if (b->busy_rx) {
+		b->busy_got += MIN(b->busy_want - b->busy_got,
+		    len - CTAP_CONT_HEADER_LEN);
+	}
+	if (b->busy_rx && b->busy_got == b->busy_want)
+		b->busy = -1;
+}
+
+/* route a report from the device to the client owning its channel */
+static void
+broker_reply(fido_broker_t *b, const unsigned char *pkt)
+{
+	struct broker_client	*c;
+	uint32_t		 cid;
+
+	memcpy(&cid, pkt, sizeof(cid));
+	broker_info_capture(b, pkt, cid);
+
+	for (size_t i = 0; i < b->nclient; i++) {
+		c = &b->client[i];
+		if (cid == CTAP_CID_BROADCAST) {
+			if (!c->init || pkt[4] != (CTAP_FRAME_INIT |
+			    CTAP_CMD_INIT) || memcmp(pkt + CTAP_INIT_HEADER_LEN,
+			    c->nonce, sizeof(c->nonce)) != 0)
+				continue;
+			c->init = false;
+		} else if (!broker_owns(c, cid))
+			continue;
+		if (pkt[4] == (CTAP_FRAME_INIT | CTAP_CMD_INIT))
+			broker_learn(c, pkt);
+		if (c->fd == b->busy)
+			broker_progress(b, pkt);
+		if (fido_sock_send(c->fd, pkt, b->report_len) < 0)
+			broker_drop(b, i);
+		return;
+	}
+
+	fido_log_debug("%s: no client for cid 0x%x", __func__, cid);
+}
+
+static bool
+broker_buffered(void *handle)
+{
+#if defined(__linux__) && !defined(USE_HIDAPI)
+	return (fido_hid_buffered(handle));
+#else
+	(void)handle;
+	return (false);
+#endif
+}
+
+static int
+broker_read(fido_broker_t *b)
+{
+	unsigned char	pkt[BROKER_REPORT_LEN];
+	const int	len = (int)b->report_len;
+
+	do {
+		if (fido_hid_read(b->dev, pkt, b->report_len, 0) != len) {
+			fido_log_debug("%s: fido_hid_read", __func__);
+			return (FIDO_ERR_RX);
+		}
+		broker_reply(b, pkt);
+	} while (broker_buffered(b->dev));
+
+	return (FIDO_OK);
+}
+
+static void
+broker_add(fido_broker_t *b, int fd)
+{
+	if (b->nclient == BROKER_MAXCLIENT) {
+		fido_log_debug("%s: too many clients", __func__);
+		fido_sock_close(fd);
+		return;
+	}
+	memset(&b->client[b->nclient], 0, sizeof(b->client[b->nclient]));
+	b->client[b->nclient++].fd = fd;
+}
+
+static void
+broker_accept(fido_broker_t *b)
+{
+	int fd;
+
+	if ((fd = fido_sock_accept(b->sock)) >= 0)
+		broker_add(b, fd);
+}
+
+/* take the socket handed over by fido_broker_attach() */
+static int
+broker_take(fido_broker_t *b)
+{
+	int fd;
+
+	if (fido_sock_peek(b->attach[0], (unsigned char *)&fd,
+	    sizeof(fd)) != (int)sizeof(fd) || fido_sock_recv(b->attach[0],
+	    (unsigned char *)&fd, sizeof(fd)) < 0)
+		return (-1);
+
+	return (fd);
+}
+
+fido_broker_t *
+fido_broker_new(void)
+{
+	fido_broker_t *b;
+
+	if ((b = fido_calloc(1, sizeof(*b))) == NULL)
+		return (NULL);
+	if ((b->client = fido_calloc(BROKER_MAXCLIENT,
+	    sizeof(*b->client))) == NULL) {
+		fido_free(b);
+		return (NULL);
+	}
+	b->sock = -1;
+	b->attach[0] = -1;
+	b->attach[1] = -1;
+	b->busy = -1;
+
+	return (b);
+}
+
+void
+fido_broker_free(fido_broker_t **b_p)
+{
+	fido_broker_t	*b;
+	int		 fd;
+
+	if (b_p == NULL || (b = *b_p) == NULL)
+		return;
+
+	while (b->nclient > 0)
+		broker_drop(b, b->nclient - 1);
+	if (b->sock != -1)
+		fido_sock_close(b->sock);
+	if (b->attach[0] != -1) {
+		while ((fd = broker_take(b)) != -1)
+			fido_sock_close(fd);
+		fido_sock_close(b->attach[0]);
+		fido_sock_close(b->attach[1]);
+	}
+	if (b->sock_path != NULL && unlink(b->sock_path) != 0)
+		fido_log_error(errno, "%s: unlink", __func__);
+	if (b->dev != NULL)
+		fido_hid_close(b->dev);
+	fido_blob_reset(&b->info);
+	fido_blob_reset(&b->info_rx);
+	fido_free(b->sock_path);
+	fido_free(b->client);
+	fido_free(b);
+
+	*b_p = NULL;
+}
+
+int
+fido_broker_open(fido_broker_t *b, const char *dev_path,
+    const char *sock_path)
+{
+	int r;
+
+	if (b->dev != NULL || dev_path == NULL || (sock_path != NULL &&
+	    !fido_sock_is_unix(sock_path)))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if ((b->dev = fido_hid_open(dev_path)) == NULL) {
+		fido_log_debug("%s: fido_hid_open", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+	/* clients use reports of CTAP_DEF_REPORT_LEN bytes */
+	if (fido_hid_report_in_len(b->dev) != BROKER_REPORT_LEN ||
+	    fido_hid_report_out_len(b->dev) != BROKER_REPORT_LEN) {
+		fido_log_debug("%s: report len", __func__);
+		r = FIDO_ERR_UNSUPPORTED_OPTION;
+		goto fail;
+	}
+	b->report_len = BROKER_REPORT_LEN;
+
+	if (fido_sock_pair(b->attach) < 0) {
+		b->attach[0] = -1;
+		b->attach[1] = -1;
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	if (sock_path == NULL)
+		return (FIDO_OK); /* attached clients only */
+	if ((b->sock_path = fido_strdup(sock_path)) == NULL) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	if ((b->sock = fido_sock_listen(sock_path)) < 0) {
+		fido_log_debug("%s: fido_sock_listen", __func__);
+		fido_free(b->sock_path);
+		b->sock_path = NULL; /* not ours to unlink */
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
+	return (FIDO_OK);
+fail:
+	if (b->attach[0] != -1) {
+		fido_sock_close(b->attach[0]);
+		fido_sock_close(b->attach[1]);
+		b->attach[0] = -1;
+		b->attach[1] = -1;
+	}
+	fido_hid_close(b->dev);
+	b->dev = NULL;
+
+	return (r);
+}
+
+/*
+ * Wait up to 'ms' milliseconds (-1 for ever) for reports from the device
+ * or the clients, and route those that arrived.
+ */
+int
+fido_broker_work(fido_broker_t *b, int ms)
+{
+	struct pollfd		 pfd[BROKER_MAXCLIENT + 3];
+	struct broker_client	*c;
+	size_t			 i, n, nclient;
+	int			 left = -1;
+	int			 fd, r;
+
+	if (b->dev == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if (b->busy != -1 && fido_time_remain(&b->busy_dl, &left) != 0) {
+		fido_log_debug("%s: device silent, ending turn", __func__);
+		b->busy = -1;
+	}
+
+	memset(pfd, 0, sizeof(pfd));
+	pfd[0].fd = b->sock;
+	pfd[1].fd = fido_hid_fd(b->dev);
+	pfd[2].fd = b->attach[0];
+	/* during a turn, the other clients' requests wait in their sockets */
+	for (i = 0; i < b->nclient; i++)
+		if (b->busy == -1 || b->busy == b->client[i].fd)
+			pfd[3 + i].fd = b->client[i].fd;
+		else
+			pfd[3 + i].fd = -1;
+	nclient = b->nclient;
+	n = 3 + nclient;
+	for (i = 0; i < n; i++)
+		pfd[i].events = POLLIN;
+	if (broker_buffered(b->dev))
+		ms = 0;
+	else if (b->busy != -1 && (ms < 0 || ms > left))
+		ms = left;
+
+	if ((r = poll(pfd, (nfds_t)n, ms)) < 0) {
+		if (errno == EINTR)
+			return (FIDO_OK);
+		fido_log_error(errno, "%s: poll", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	if (pfd[1].revents & (POLLERR | POLLHUP | POLLNVAL))
+		return (FIDO_ERR_RX);
+	if ((pfd[1].revents & POLLIN) || broker_buffered(b->dev))
+		if ((r = broker_read(b)) != FIDO_OK)
+			return (r);
+	if (b->nclient != nclient)
+		return (FIDO_OK); /* pfd[] no longer matches; poll again */
+
+	/* starting after the client last served */
+	for (size_t k = 0; k < nclient; k++) {
+		i = (b->turn + k) % nclient;
+		c = &b->client[i];
+		if (pfd[3 + i].revents == 0 || (b->busy != -1 &&
+		    b->busy != c->fd))
+			continue;
+		if ((r = broker_request(b, c)) == FIDO_ERR_RX) {
+			broker_drop(b, i);
+			return (FIDO_OK); /* pfd[] no longer matches */
+		} else if (r != FIDO_OK)
+			return (r);
+		if (b->busy == c->fd)
+			b->turn = i + 1;
+	}
+	if ((pfd[2].revents & POLLIN) && (fd = broker_take(b)) != -1)
+		broker_add(b, fd);
+	if (pfd[0].revents & POLLIN)
+		broker_accept(b);
+
+	return (FIDO_OK);
+}
+
+/*
+ * Open 'dev' on the broker, over a socket pair whose other end is taken
+ * by the thread running fido_broker_work().
+ */
+int
+fido_broker_attach(fido_broker_t *b, fido_dev_t *dev)
+{
+	struct broker_io	*io = NULL;
+	int			 fd[2] = { -1, -1 };
+	int			 r;
+
+	if (b->dev == NULL || dev->io_handle != NULL ||
+	    dev->io_attach != NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if ((io = fido_calloc(1, sizeof(*io))) == NULL ||
+	    fido_sock_pair(fd) < 0) {
+		fd[0] = fd[1] = -1;
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	if (fido_sock_send(b->attach[1], (const unsigned char *)&fd[0],
+	    sizeof(fd[0])) < 0) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	fd[0] = -1; /* the broker's now */
+	io->fd = fd[1];
+	dev->io_attach = io;
+	io = NULL;
+	fd[1] = -1;
+
+	if ((r = fido_dev_open(dev, FIDO_BROKER_PREFIX)) != FIDO_OK &&
+	    dev->io_attach != NULL) {
+		fido_broker_io_close(dev->io_attach);
+		dev->io_attach = NULL;
+	}
+
+	return (r);
+fail:
+	if (fd[0] != -1)
+		fido_sock_close(fd[0]);
+	if (fd[1] != -1)
+		fido_sock_close(fd[1]);
+	fido_free(io);
+
+	return (r);
+}
+
+bool
+fido_is_broker(const char *path)
+{
+	return (strncmp(path, FIDO_BROKER_PREFIX,
+	    strlen(FIDO_BROKER_PREFIX)) == 0);
+}
+
+void *
+fido_broker_io_open(const char *path)
+{
+	struct broker_io	*io;
+	const char		*sock_path;
+	int			 fd;
+
+	if (!fido_is_broker(path) || !fido_sock_is_unix((sock_path =
+	    path + strlen(FIDO_BROKER_PREFIX))))
+		return (NULL);
+	if ((fd = fido_sock_connect(sock_path)) < 0)
+		return (NULL);
+	if ((io = fido_calloc(1, sizeof(*io))) == NULL) {
+		fido_sock_close(fd);
+		return (NULL);
+	}
+	io->fd = fd;
+
+	return (io);
+}
+
+void
+fido_broker_io_close(void *handle)
+{
+	struct broker_io *io = handle;
+
+	fido_sock_close(io->fd);
+	fido_free(io);
+}
+
+int
+fido_broker_io_read(void *handle, unsigned char *buf, size_t len, int ms)
+{
+	struct broker_io *io = handle;
+
+	if (len != BROKER_REPORT_LEN) {
+		fido_log_debug("%s: len %zu", __func__, len);
+		return (-1);
+	}
+	if (fido_sock_poll(io->fd, ms) < 0 ||
+	    fido_sock_recv(io->fd, buf, len) < 0)
+		return (-1);
+
+	return ((int)len);
+}
+
+int
+fido_broker_io_write(void *handle, const unsigned char *buf, size_t len)
+{
+	struct broker_io *io = handle;
+
+	if (len != BROKER_REPORT_LEN + 1) {
+		fido_log_debug("%s: len %zu", __func__, len);
+		return (-1);
+	}
+	if (fido_sock_send(io->fd, buf, len) < 0)
+		return (-1);
+
+	return ((int)len);
+}
+
+int
+fido_dev_set_broker(fido_dev_t *d)
+{
+	if (d->io_handle != NULL) {
+		fido_log_debug("%s: device open", __func__);
+		return (-1);
+	}
+	d->io_own = true;
+	d->io = (fido_dev_io_t) {
+		fido_broker_io_open,
+		fido_broker_io_close,
+		fido_broker_io_read,
+		fido_broker_io_write,
+	};
+	memset(&d->transport, 0, sizeof(d->transport));
+
+	return (0);
+}
+
+#else /* USE_BROKER */
+
+fido_broker_t *
+fido_broker_new(void)
+{
+	return (NULL);
+}
+
+void
+fido_broker_free(fido_broker_t **b_p)
+{
+	(void)b_p;
+}
+
+int
+fido_broker_open(fido_broker_t *b, const char *dev_path,
+    const char *sock_path)
+{
+	(void)b;
+	(void)dev_path;
+	(void)sock_path;
+
+	return (FIDO_ERR_UNSUPPORTED_OPTION);
+}
+
+int
+fido_broker_work(fido_broker_t *b, int ms)
+{
+	(void)b;
+	(void)ms;
+
+	return (FIDO_ERR_UNSUPPORTED_OPTION);
+}
+
+int
+fido_broker_attach(fido_broker_t *b, fido_dev_t *dev)
+{
+	(void)b;
+	(void)dev;
+
+	return (FIDO_ERR_UNSUPPORTED_OPTION);
+}
+
+#endif /* USE_BROKER */
@@ -9,56 +9,231 @@
 #include <openssl/sha.h>
 #include "fido.h"
 
+/*
+ * Pull decoder over encoded CBOR. It is used to validate replies and to
+ * decode fixed-layout replies in place, copying only the fields that are
+ * kept; no libcbor tree is built. Only definite-length encodings are
+ * accepted.
+ */
+struct cbor_reader {
+	const unsigned char	*ptr;
+	size_t			 len;
+};
+
+#define CBOR_READER_MAXDEPTH	16
+
 static int
-check_key_type(cbor_item_t *item)
+cbor_reader_head(struct cbor_reader *r, uint8_t *major, uint64_t *v)
 {
-	if (item->type == CBOR_TYPE_UINT || item->type == CBOR_TYPE_NEGINT ||
-	    item->type == CBOR_TYPE_STRING)
+	uint8_t	ai;
+	size_t	n;
+
+	if (r->len < 1)
+		return (-1);
+
+	*major = (uint8_t)(r->ptr[0] >> 5);
+	ai = r->ptr[0] & 0x1f;
+	r->ptr++;
+	r->len--;
+
+	if (ai < 24) {
+		*v = ai;
 		return (0);
+	}
+
+	switch (ai) {
+	case 24:
+		n = 1;
+		break;
+	case 25:
+		n = 2;
+		break;
+	case 26:
+		n = 4;
+		break;
+	case 27:
+		n = 8;
+		break;
+	default:
+		fido_log_debug("%s: ai=%u", __func__, ai);
+		return (-1); /* reserved or indefinite */
+	}
 
-	fido_log_debug("%s: invalid type: %d", __func__, item->type);
+	if (r->len < n)
+		return (-1);
+	for (*v = 0; n > 0; n--) {
+		*v = (*v << 8) | r->ptr[0];
+		r->ptr++;
+		r->len--;
+	}
 
-	return (-1);
+	return (0);
 }
 
-/*
- * Validate CTAP2 canonical CBOR encoding rules for maps.
- */
 static int
-ctap_check_cbor(cbor_item_t *prev, cbor_item_t *curr)
+cbor_reader_string(struct cbor_reader *r, uint8_t type,
+    const unsigned char **ptr, size_t *len)
 {
-	size_t	curr_len;
-	size_t	prev_len;
+	uint8_t		major;
+	uint64_t	v;
 
-	if (check_key_type(prev) < 0 || check_key_type(curr) < 0)
+	if (cbor_reader_head(r, &major, &v) < 0 || major != type ||
+	    v > r->len) {
+		fido_log_debug("%s: cbor type", __func__);
 		return (-1);
+	}
 
-	if (prev->type != curr->type) {
-		if (prev->type < curr->type)
-			return (0);
-		fido_log_debug("%s: unsorted types", __func__);
+	*ptr = r->ptr;
+	*len = (size_t)v;
+	r->ptr += *len;
+	r->len -= *len;
+
+	return (0);
+}
+
+static int cbor_reader_skip(struct cbor_reader *, int);
+
+static int
+ctap_check_key(const unsigned char *prev, size_t prev_len,
+    const unsigned char *curr, size_t curr_len)
+{
+	uint8_t prev_type = (uint8_t)(prev[0] >> 5);
+	uint8_t curr_type = (uint8_t)(curr[0] >> 5);
+
+	if ((prev_type != CBOR_TYPE_UINT && prev_type != CBOR_TYPE_NEGINT &&
+	    prev_type != CBOR_TYPE_STRING) || (curr_type != CBOR_TYPE_UINT &&
+	    curr_type != CBOR_TYPE_NEGINT && curr_type != CBOR_TYPE_STRING)) {
+		fido_log_debug("%s: invalid type: %u, %u", __func__, prev_type,
+		    curr_type);
 		return (-1);
 	}
 
-	if (curr->type == CBOR_TYPE_UINT || curr->type == CBOR_TYPE_NEGINT) {
-		if (cbor_int_get_width(curr) >= cbor_int_get_width(prev) &&
-		    cbor_get_int(curr) > cbor_get_int(prev))
-			return (0);
-	} else {
-		curr_len = cbor_string_length(curr);
-		prev_len = cbor_string_length(prev);
-
-		if (curr_len > prev_len || (curr_len == prev_len &&
-		    memcmp(cbor_string_handle(prev), cbor_string_handle(curr),
-		    curr_len) < 0))
+	/* major type, then encoded length, then bytewise */
+	if (prev_type != curr_type) {
+		if (prev_type < curr_type)
 			return (0);
+		fido_log_debug("%s: unsorted types", __func__);
+		return (-1);
 	}
 
+	if (prev_len < curr_len || (prev_len == curr_len &&
+	    memcmp(prev, curr, curr_len) < 0))
+		return (0);
+
 	fido_log_debug("%s: invalid cbor", __func__);
 
 	return (-1);
 }
 
+/*
+ * Skip a map, validating CTAP2 canonical CBOR encoding rules for its keys.
+ */
+static int
+cbor_reader_skip_map(struct cbor_reader *r, uint64_t n, int depth)
+{
+	const unsigned char	*prev = NULL, *curr;
+	size_t			 prev_len = 0, curr_len;
+
+	for (uint64_t i = 0; i < n; i++) {
+		curr = r->ptr;
+		if (cbor_reader_skip(r, depth + 1) < 0)
+			return (-1);
+		curr_len = (size_t)(r->ptr - curr);
+		if (prev != NULL && ctap_check_key(prev, prev_len, curr,
+		    curr_len) < 0)
+			return (-1);
+		if (cbor_reader_skip(r, depth + 1) < 0)
+			return (-1);
+		prev = curr;
+		prev_len = curr_len;
+	}
+
+	return (0);
+}
+
+static int
+cbor_reader_skip(struct cbor_reader *r, int depth)
+{
+	uint8_t		major;
+	uint64_t	v;
+
+	if (depth > CBOR_READER_MAXDEPTH ||
+	    cbor_reader_head(r, &major, &v) < 0)
+		return (-1);
+
+	switch (major) {
+	case CBOR_TYPE_BYTESTRING:
+	case CBOR_TYPE_STRING:
+		if (v > r->len)
+			return (-1);
+		r->ptr += (size_t)v;
+		r->len -= (size_t)v;
+		return (0);
+	case CBOR_TYPE_MAP:
+		if (v > r->len / 2)
+			return (-1);
+		return (cbor_reader_skip_map(r, v, depth));
+	case CBOR_TYPE_ARRAY:
+		if (v > r->len)
+			return (-1);
+		break;
+	case CBOR_TYPE_TAG:
+		v = 1;
+		break;
+	default:
+		return (0); /* ints, simple values, floats */
+	}
+
+	while (v-- > 0)
+		if (cbor_reader_skip(r, depth + 1) < 0)
+			return (-1);
+
+	return (0);
+}
+
+/*
+ * Validate CTAP2 canonical CBOR encoding rules for the first encoded item
+ * in 'ptr': all lengths are definite and map keys are sorted. Done in a
+ * single pass over the encoded bytes, with one memcmp() per map key.
+ */
+static int
+ctap_check_cbor(const unsigned char *ptr, size_t len)
+{
+	struct cbor_reader r;
+
+	r.ptr = ptr;
+	r.len = len;
+
+	if (cbor_reader_skip(&r, 0) < 0) {
+		fido_log_debug("%s: invalid cbor", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * cbor_load() for data originating from an authenticator; the loaded item
+ * must pass ctap_check_cbor().
+ */
+cbor_item_t *
+cbor_load_ctap(const unsigned char *ptr, size_t len,
+    struct cbor_load_result *res)
+{
+	cbor_item_t *item;
+
+	if ((item = cbor_load(ptr, len, res)) == NULL)
+		return (NULL);
+
+	if (ctap_check_cbor(ptr, res->read) < 0) {
+		cbor_decref(&item);
+		res->error.code = CBOR_ERR_MALFORMATED;
+		return (NULL);
+	}
+
+	return (item);
+}
+
 int
 cbor_map_iter(const cbor_item_t *item, void *arg, int(*f)(const cbor_item_t *,
     const cbor_item_t *, void *))
@@ -79,10 +254,6 @@ cbor_map_iter(const cbor_item_t *item, void *arg, int(*f)(const cbor_item_t *,
 			    __func__, (void *)v[i].key, (void *)v[i].value, i);
 			return (-1);
 		}
-		if (i && ctap_check_cbor(v[i - 1].key, v[i].key) < 0) {
-			fido_log_debug("%s: ctap_check_cbor", __func__);
-			return (-1);
-		}
 		if (f(v[i].key, v[i].value, arg) < 0) {
 			fido_log_debug("%s: iterator < 0 on i=%zu", __func__,
 			    i);
@@ -117,14 +288,23 @@ cbor_array_iter(const cbor_item_t *item, void *arg, int(*f)(const cbor_item_t *,
 	return (0);
 }
 
+/*
+ * Parse a CTAP2 reply map, calling 'parser' on each of its entries. If
+ * 'prepare' is set, it is first called on the whole map, so that storage
+ * for what 'parser' decodes can be allocated at once.
+ */
 int
-cbor_parse_reply(const unsigned char *blob, size_t blob_len, void *arg,
+cbor_parse_reply_prepare(const unsigned char *blob, size_t blob_len,
+    void *arg, int(*prepare)(const cbor_item_t *, void *),
     int(*parser)(const cbor_item_t *, const cbor_item_t *, void *))
 {
 	cbor_item_t		*item = NULL;
 	struct cbor_load_result	 cbor;
+	fido_prof_t		 prof;
 	int			 r;
 
+	fido_prof_begin(&prof, FIDO_PROF_PARSE_REPLY);
+
 	if (blob_len < 1) {
 		fido_log_debug("%s: blob_len=%zu", __func__, blob_len);
 		r = FIDO_ERR_RX;
@@ -143,6 +323,12 @@ cbor_parse_reply(const unsigned char *blob, size_t blob_len, void *arg,
 		goto fail;
 	}
 
+	if (ctap_check_cbor(blob + 1, cbor.read) < 0) {
+		fido_log_debug("%s: ctap_check_cbor", __func__);
+		r = FIDO_ERR_RX_INVALID_CBOR;
+		goto fail;
+	}
+
 	if (cbor_isa_map(item) == false ||
 	    cbor_map_is_definite(item) == false) {
 		fido_log_debug("%s: cbor type", __func__);
@@ -150,6 +336,12 @@ cbor_parse_reply(const unsigned char *blob, size_t blob_len, void *arg,
 		goto fail;
 	}
 
+	if (prepare != NULL && prepare(item, arg) < 0) {
+		fido_log_debug("%s: prepare", __func__);
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
 	if (cbor_map_iter(item, arg, parser) < 0) {
 		fido_log_debug("%s: cbor_map_iter", __func__);
 		r = FIDO_ERR_RX_INVALID_CBOR;
@@ -161,273 +353,1266 @@ fail:
 	if (item != NULL)
 		cbor_decref(&item);
 
-	return (r);
+	return (fido_prof_end(&prof, r));
 }
 
-void
-cbor_vector_free(cbor_item_t **item, size_t len)
+int
+cbor_parse_reply(const unsigned char *blob, size_t blob_len, void *arg,
+    int(*parser)(const cbor_item_t *, const cbor_item_t *, void *))
 {
-	for (size_t i = 0; i < len; i++)
-		if (item[i] != NULL)
-			cbor_decref(&item[i]);
+	return (cbor_parse_reply_prepare(blob, blob_len, arg, NULL, parser));
 }
 
-int
-cbor_bytestring_copy(const cbor_item_t *item, unsigned char **buf, size_t *len)
+/*
+ * Point 'b' at the next byte string of 'r', without copying it; 'base' is
+ * a writable alias of the buffer 'r' reads from.
+ */
+static int
+cbor_reader_blob(struct cbor_reader *r, unsigned char *base, fido_blob_t *b)
 {
-	if (*buf != NULL || *len != 0) {
-		fido_log_debug("%s: dup", __func__);
-		return (-1);
-	}
+	const unsigned char	*ptr;
+	size_t			 len;
 
-	if (cbor_isa_bytestring(item) == false ||
-	    cbor_bytestring_is_definite(item) == false) {
-		fido_log_debug("%s: cbor type", __func__);
+	if (!fido_blob_is_empty(b)) {
+		fido_log_debug("%s: dup", __func__);
 		return (-1);
 	}
-
-	*len = cbor_bytestring_length(item);
-	if ((*buf = malloc(*len)) == NULL) {
-		*len = 0;
+	if (cbor_reader_string(r, CBOR_TYPE_BYTESTRING, &ptr, &len) < 0)
 		return (-1);
-	}
-
-	memcpy(*buf, cbor_bytestring_handle(item), *len);
+	fido_blob_reset(b);
+	b->ptr = base + (ptr - base);
+	b->len = len;
+	b->view = true;
 
 	return (0);
 }
 
-int
-cbor_string_copy(const cbor_item_t *item, char **str)
+static int
+cbor_reader_text(struct cbor_reader *r, char **str)
 {
-	size_t len;
+	const unsigned char	*ptr;
+	size_t			 len;
 
 	if (*str != NULL) {
 		fido_log_debug("%s: dup", __func__);
 		return (-1);
 	}
+	if (cbor_reader_string(r, CBOR_TYPE_STRING, &ptr, &len) < 0 ||
+	    len == SIZE_MAX || (*str = fido_malloc(len + 1)) == NULL)
+		return (-1);
+	memcpy(*str, ptr, len);
+	(*str)[len] = '\0';
 
-	if (cbor_isa_string(item) == false ||
-	    cbor_string_is_definite(item) == false) {
+	return (0);
+}
+
+static int
+cbor_reader_map(struct cbor_reader *r, uint64_t *n)
+{
+	uint8_t major;
+
+	if (cbor_reader_head(r, &major, n) < 0 || major != CBOR_TYPE_MAP ||
+	    *n > r->len / 2) {
 		fido_log_debug("%s: cbor type", __func__);
 		return (-1);
 	}
 
-	if ((len = cbor_string_length(item)) == SIZE_MAX ||
-	    (*str = malloc(len + 1)) == NULL)
+	return (0);
+}
+
+/*
+ * Read a map key. Returns 1 if it is a text string (in *key, *key_len),
+ * 0 if it should be ignored, -1 on error.
+ */
+static int
+cbor_reader_text_key(struct cbor_reader *r, const unsigned char **key,
+    size_t *key_len)
+{
+	if (r->len > 0 && (r->ptr[0] >> 5) == CBOR_TYPE_STRING)
+		return (cbor_reader_string(r, CBOR_TYPE_STRING, key,
+		    key_len) < 0 ? -1 : 1);
+
+	return (cbor_reader_skip(r, 1) < 0 ? -1 : 0);
+}
+
+static int
+cbor_reader_key_is(const unsigned char *key, size_t key_len, const char *s)
+{
+	return (strlen(s) == key_len && memcmp(key, s, key_len) == 0);
+}
+
+static int
+cbor_reader_cred_id(struct cbor_reader *r, unsigned char *base,
+    fido_blob_t *id)
+{
+	const unsigned char	*key;
+	size_t			 key_len;
+	uint64_t		 n;
+	int			 ok;
+
+	if (cbor_reader_map(r, &n) < 0)
 		return (-1);
 
-	memcpy(*str, cbor_string_handle(item), len);
-	(*str)[len] = '\0';
+	while (n-- > 0) {
+		if ((ok = cbor_reader_text_key(r, &key, &key_len)) < 0)
+			return (-1);
+		if (ok && cbor_reader_key_is(key, key_len, "id"))
+			ok = cbor_reader_blob(r, base, id);
+		else
+			ok = cbor_reader_skip(r, 1);
+		if (ok < 0) {
+			fido_log_debug("%s: id", __func__);
+			return (-1);
+		}
+	}
 
 	return (0);
 }
 
-int
-cbor_add_bytestring(cbor_item_t *item, const char *key,
-    const unsigned char *value, size_t value_len)
+static int
+cbor_reader_user(struct cbor_reader *r, unsigned char *base,
+    fido_user_t *user)
 {
-	struct cbor_pair pair;
-	int ok = -1;
+	const unsigned char	*key;
+	size_t			 key_len;
+	uint64_t		 n;
+	int			 ok;
 
-	memset(&pair, 0, sizeof(pair));
+	if (cbor_reader_map(r, &n) < 0)
+		return (-1);
 
-	if ((pair.key = cbor_build_string(key)) == NULL ||
-	    (pair.value = cbor_build_bytestring(value, value_len)) == NULL) {
-		fido_log_debug("%s: cbor_build", __func__);
-		goto fail;
+	while (n-- > 0) {
+		if ((ok = cbor_reader_text_key(r, &key, &key_len)) < 0)
+			return (-1);
+		if (ok == 0)
+			ok = cbor_reader_skip(r, 1);
+		else if (cbor_reader_key_is(key, key_len, "icon"))
+			ok = cbor_reader_text(r, &user->icon);
+		else if (cbor_reader_key_is(key, key_len, "name"))
+			ok = cbor_reader_text(r, &user->name);
+		else if (cbor_reader_key_is(key, key_len, "displayName"))
+			ok = cbor_reader_text(r, &user->display_name);
+		else if (cbor_reader_key_is(key, key_len, "id"))
+			ok = cbor_reader_blob(r, base, &user->id);
+		else
+			ok = cbor_reader_skip(r, 1);
+		if (ok < 0) {
+			fido_log_debug("%s: user", __func__);
+			return (-1);
+		}
 	}
 
-	if (!cbor_map_add(item, pair)) {
-		fido_log_debug("%s: cbor_map_add", __func__);
-		goto fail;
+	return (0);
+}
+
+/* the length of the shortest head encoding 'v' */
+static size_t
+cbor_head_len(uint64_t v)
+{
+	if (v < 24)
+		return (1);
+	if (v <= UINT8_MAX)
+		return (2);
+	if (v <= UINT16_MAX)
+		return (3);
+	if (v <= UINT32_MAX)
+		return (5);
+
+	return (9);
+}
+
+/*
+ * Read authenticator data into 'raw', and its encoding as a byte string
+ * into 'wrapped': in place, unless the length head must be re-encoded.
+ */
+static int
+cbor_reader_authdata(struct cbor_reader *r, unsigned char *base,
+    fido_blob_t *raw, fido_blob_t *wrapped)
+{
+	const unsigned char *head = r->ptr;
+
+	if (cbor_reader_blob(r, base, raw) < 0) {
+		fido_log_debug("%s: authdata", __func__);
+		return (-1);
 	}
 
-	ok = 0;
-fail:
-	if (pair.key)
-		cbor_decref(&pair.key);
-	if (pair.value)
-		cbor_decref(&pair.value);
+	if ((size_t)(raw->ptr - head) == cbor_head_len(raw->len) &&
+	    fido_blob_is_empty(wrapped)) {
+		fido_blob_reset(wrapped);
+		wrapped->ptr = base + (head - base);
+		wrapped->len = (size_t)(raw->ptr - head) + raw->len;
+		wrapped->view = true;
+	} else if (cbor_wrap_bytestring(raw, wrapped) < 0) {
+		fido_log_debug("%s: cbor_wrap_bytestring", __func__);
+		return (-1);
+	}
 
-	return (ok);
+	return (0);
+}
+
+static int
+cbor_reader_assert_authdata(struct cbor_reader *r, unsigned char *base,
+    fido_assert_stmt *stmt)
+{
+	if (cbor_reader_authdata(r, base, &stmt->authdata_raw,
+	    &stmt->authdata_cbor) < 0)
+		return (-1);
+
+	return (cbor_decode_assert_authdata_raw(&stmt->authdata_raw,
+	    &stmt->authdata, &stmt->authdata_ext));
 }
 
+/*
+ * Decode an authenticatorGetAssertion/authenticatorGetNextAssertion reply
+ * straight into 'stmt'. If 'ncred' is not NULL, numberOfCredentials is
+ * stored there when present; otherwise it is ignored. Members whose key
+ * is set in the 'skip' bitmask are stepped over. The byte strings of
+ * 'stmt' point into 'blob', which must outlive them.
+ */
 int
-cbor_add_string(cbor_item_t *item, const char *key, const char *value)
+cbor_parse_assert_reply(unsigned char *blob, size_t blob_len,
+    fido_assert_stmt *stmt, uint64_t *ncred, unsigned int skip)
 {
-	struct cbor_pair pair;
-	int ok = -1;
+	struct cbor_reader	r;
+	uint8_t			major;
+	uint64_t		n, key;
+	int			ok;
 
-	memset(&pair, 0, sizeof(pair));
+	if (blob_len < 1) {
+		fido_log_debug("%s: blob_len=%zu", __func__, blob_len);
+		return (FIDO_ERR_RX);
+	}
 
-	if ((pair.key = cbor_build_string(key)) == NULL ||
-	    (pair.value = cbor_build_string(value)) == NULL) {
-		fido_log_debug("%s: cbor_build", __func__);
-		goto fail;
+	if (blob[0] != FIDO_OK) {
+		fido_log_debug("%s: blob[0]=0x%02x", __func__, blob[0]);
+		return (blob[0]);
 	}
 
-	if (!cbor_map_add(item, pair)) {
-		fido_log_debug("%s: cbor_map_add", __func__);
-		goto fail;
+	r.ptr = blob + 1;
+	r.len = blob_len - 1;
+
+	if (cbor_reader_head(&r, &major, &n) < 0) {
+		fido_log_debug("%s: cbor_reader_head", __func__);
+		return (FIDO_ERR_RX_NOT_CBOR);
 	}
 
-	ok = 0;
-fail:
-	if (pair.key)
-		cbor_decref(&pair.key);
-	if (pair.value)
-		cbor_decref(&pair.value);
+	if (ctap_check_cbor(blob + 1, blob_len - 1) < 0) {
+		fido_log_debug("%s: ctap_check_cbor", __func__);
+		return (FIDO_ERR_RX_INVALID_CBOR);
+	}
 
-	return (ok);
+	if (major != CBOR_TYPE_MAP || n > r.len / 2) {
+		fido_log_debug("%s: cbor type", __func__);
+		return (FIDO_ERR_RX_INVALID_CBOR);
+	}
+
+	while (n-- > 0) {
+		if (r.len > 0 && (r.ptr[0] >> 5) == CBOR_TYPE_UINT) {
+			if (cbor_reader_head(&r, &major, &key) < 0)
+				return (FIDO_ERR_RX_INVALID_CBOR);
+		} else {
+			if (cbor_reader_skip(&r, 1) < 0)
+				return (FIDO_ERR_RX_INVALID_CBOR);
+			key = 0; /* ignore */
+		}
+		if (key < 32 && (skip & (1U << key)))
+			key = 0;
+
+		switch (key) {
+		case 1: /* credential id */
+			ok = cbor_reader_cred_id(&r, blob, &stmt->id);
+			break;
+		case 2: /* authdata */
+			ok = cbor_reader_assert_authdata(&r, blob, stmt);
+			break;
+		case 3: /* signature */
+			ok = cbor_reader_blob(&r, blob, &stmt->sig);
+			break;
+		case 4: /* user attributes */
+			ok = cbor_reader_user(&r, blob, &stmt->user);
+			break;
+		case 5: /* numberOfCredentials */
+			if (ncred == NULL) {
+				ok = cbor_reader_skip(&r, 1);
+				break;
+			}
+			if ((ok = cbor_reader_head(&r, &major, ncred)) == 0 &&
+			    major != CBOR_TYPE_UINT)
+				ok = -1;
+			break;
+		case 7: /* large blob key */
+			ok = cbor_reader_blob(&r, blob,
+			    &stmt->largeblob_key);
+			break;
+		default: /* ignore */
+			ok = cbor_reader_skip(&r, 1);
+			break;
+		}
+
+		if (ok < 0) {
+			fido_log_debug("%s: cbor_reader", __func__);
+			return (FIDO_ERR_RX_INVALID_CBOR);
+		}
+	}
+
+	return (FIDO_OK);
+}
+
+/*
+ * Step over the first item of 'r', checking that each of its heads has
+ * the shortest encoding of its argument, as libcbor would re-encode it.
+ */
+static int
+cbor_reader_shortest(struct cbor_reader *r, int depth)
+{
+	const unsigned char	*head = r->ptr;
+	uint8_t			 major;
+	uint64_t		 v;
+
+	if (depth > CBOR_READER_MAXDEPTH ||
+	    cbor_reader_head(r, &major, &v) < 0)
+		return (-1);
+	if (major == CBOR_TYPE_FLOAT_CTRL)
+		return (0); /* floats keep their width */
+	if ((size_t)(r->ptr - head) != cbor_head_len(v))
+		return (-1);
+
+	switch (major) {
+	case CBOR_TYPE_BYTESTRING:
+	case CBOR_TYPE_STRING:
+		if (v > r->len)
+			return (-1);
+		r->ptr += (size_t)v;
+		r->len -= (size_t)v;
+		return (0);
+	case CBOR_TYPE_MAP:
+		if (v > r->len / 2)
+			return (-1);
+		v *= 2;
+		break;
+	case CBOR_TYPE_ARRAY:
+		if (v > r->len)
+			return (-1);
+		break;
+	case CBOR_TYPE_TAG:
+		v = 1;
+		break;
+	default:
+		return (0);
+	}
+
+	while (v-- > 0)
+		if (cbor_reader_shortest(r, depth + 1) < 0)
+			return (-1);
+
+	return (0);
+}
+
+/* whether the first item in 'ptr' is encoded as libcbor would encode it */
+bool
+cbor_is_shortest(const unsigned char *ptr, size_t len)
+{
+	struct cbor_reader r;
+
+	r.ptr = ptr;
+	r.len = len;
+
+	return (cbor_reader_shortest(&r, 0) == 0);
+}
+
+static int
+cbor_reader_x5c(struct cbor_reader *r, unsigned char *base,
+    fido_blob_array_t *x5c)
+{
+	uint8_t		major;
+	uint64_t	n;
+
+	if (x5c->len) {
+		fido_log_debug("%s: dup", __func__);
+		return (-1);
+	}
+	if (cbor_reader_head(r, &major, &n) < 0 || major != CBOR_TYPE_ARRAY ||
+	    n > r->len) {
+		fido_log_debug("%s: cbor type", __func__);
+		return (-1);
+	}
+	if (fido_blob_array_reserve(x5c, (size_t)n) < 0)
+		return (-1);
+
+	while (n-- > 0)
+		if (cbor_reader_blob(r, base, &x5c->ptr[x5c->len++]) < 0)
+			return (-1);
+
+	return (0);
+}
+
+static int
+cbor_reader_attstmt_alg(struct cbor_reader *r, int *alg)
+{
+	uint8_t		major;
+	uint64_t	v;
+
+	if (cbor_reader_head(r, &major, &v) < 0 ||
+	    major != CBOR_TYPE_NEGINT || v > UINT16_MAX) {
+		fido_log_debug("%s: alg", __func__);
+		return (-1);
+	}
+	*alg = -(int)v - 1;
+	if (!fido_cose_alg_enabled(*alg)) {
+		fido_log_debug("%s: unsupported alg=%d", __func__, *alg);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/* as cbor_decode_attstmt(), keeping the encoded map in place */
+static int
+cbor_reader_attstmt(struct cbor_reader *r, unsigned char *base,
+    fido_attstmt_t *attstmt)
+{
+	const unsigned char	*start = r->ptr;
+	const unsigned char	*key;
+	size_t			 key_len;
+	uint64_t		 n;
+	int			 ok;
+
+	if (cbor_reader_map(r, &n) < 0)
+		return (-1);
+
+	while (n-- > 0) {
+		if ((ok = cbor_reader_text_key(r, &key, &key_len)) < 0)
+			return (-1);
+		if (ok == 0)
+			ok = cbor_reader_skip(r, 1);
+		else if (cbor_reader_key_is(key, key_len, "alg"))
+			ok = cbor_reader_attstmt_alg(r, &attstmt->alg);
+		else if (cbor_reader_key_is(key, key_len, "sig"))
+			ok = cbor_reader_blob(r, base, &attstmt->sig);
+		else if (cbor_reader_key_is(key, key_len, "x5c"))
+			ok = cbor_reader_x5c(r, base, &attstmt->x5c);
+		else if (cbor_reader_key_is(key, key_len, "certInfo"))
+			ok = cbor_reader_blob(r, base, &attstmt->certinfo);
+		else if (cbor_reader_key_is(key, key_len, "pubArea"))
+			ok = cbor_reader_blob(r, base, &attstmt->pubarea);
+		else
+			ok = cbor_reader_skip(r, 1);
+		if (ok < 0) {
+			fido_log_debug("%s: attStmt", __func__);
+			return (-1);
+		}
+	}
+
+	if (!fido_blob_is_empty(&attstmt->cbor)) {
+		fido_log_debug("%s: dup", __func__);
+		return (-1);
+	}
+	fido_blob_reset(&attstmt->cbor);
+	attstmt->cbor.ptr = base + (start - base);
+	attstmt->cbor.len = (size_t)(r->ptr - start);
+	attstmt->cbor.view = true;
+
+	return (0);
+}
+
+static int
+cbor_reader_fmt(struct cbor_reader *r, char **fmt)
+{
+	if (cbor_reader_text(r, fmt) < 0 ||
+	    fido_fmt_id(*fmt) == FIDO_FMT_UNKNOWN) {
+		fido_log_debug("%s: fmt", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+cbor_reader_cred_authdata(struct cbor_reader *r, unsigned char *base,
+    fido_cred_t *cred)
+{
+	if (cbor_reader_authdata(r, base, &cred->authdata_raw,
+	    &cred->authdata_cbor) < 0)
+		return (-1);
+
+	return (cbor_decode_cred_authdata_raw(&cred->authdata_raw, cred->type,
+	    &cred->authdata, &cred->attcred, &cred->authdata_ext));
+}
+
+/*
+ * Decode the attestation object in 'attobj' in a single pass, without a
+ * libcbor item tree. The byte strings of 'cred', attStmt included, point
+ * into 'attobj', which must outlive them and must have passed
+ * cbor_is_shortest(); certificates are left for fido_x5c_cert() to parse.
+ */
+int
+cbor_parse_attobj(unsigned char *attobj, size_t len, fido_cred_t *cred)
+{
+	struct cbor_reader	 r;
+	const unsigned char	*key;
+	size_t			 key_len;
+	uint64_t		 n;
+	int			 ok;
+
+	if (ctap_check_cbor(attobj, len) < 0) {
+		fido_log_debug("%s: ctap_check_cbor", __func__);
+		return (-1);
+	}
+
+	r.ptr = attobj;
+	r.len = len;
+
+	if (cbor_reader_map(&r, &n) < 0)
+		return (-1);
+
+	while (n-- > 0) {
+		if ((ok = cbor_reader_text_key(&r, &key, &key_len)) < 0)
+			return (-1);
+		if (ok == 0)
+			ok = cbor_reader_skip(&r, 1);
+		else if (cbor_reader_key_is(key, key_len, "fmt"))
+			ok = cbor_reader_fmt(&r, &cred->fmt);
+		else if (cbor_reader_key_is(key, key_len, "attStmt"))
+			ok = cbor_reader_attstmt(&r, attobj, &cred->attstmt);
+		else if (cbor_reader_key_is(key, key_len, "authData"))
+			ok = cbor_reader_cred_authdata(&r, attobj, cred);
+		else
+			ok = cbor_reader_skip(&r, 1);
+		if (ok < 0) {
+			fido_log_debug("%s: attobj", __func__);
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Locate the members of a reply's top-level map in place: the encoded
+ * value of unsigned key k < n is at ptr[k], len[k]; absent members have
+ * a NULL ptr. Other members are stepped over.
+ */
+int
+cbor_index_reply(const unsigned char *blob, size_t blob_len,
+    const unsigned char **ptr, size_t *len, size_t n)
+{
+	struct cbor_reader	r;
+	const unsigned char	*val;
+	uint8_t			major;
+	uint64_t		nmemb, key;
+
+	for (size_t i = 0; i < n; i++) {
+		ptr[i] = NULL;
+		len[i] = 0;
+	}
+
+	if (blob_len < 1) {
+		fido_log_debug("%s: blob_len=%zu", __func__, blob_len);
+		return (FIDO_ERR_RX);
+	}
+
+	if (blob[0] != FIDO_OK) {
+		fido_log_debug("%s: blob[0]=0x%02x", __func__, blob[0]);
+		return (blob[0]);
+	}
+
+	r.ptr = blob + 1;
+	r.len = blob_len - 1;
+
+	if (ctap_check_cbor(r.ptr, r.len) < 0) {
+		fido_log_debug("%s: ctap_check_cbor", __func__);
+		return (FIDO_ERR_RX_INVALID_CBOR);
+	}
+
+	if (cbor_reader_map(&r, &nmemb) < 0)
+		return (FIDO_ERR_RX_INVALID_CBOR);
+
+	while (nmemb-- > 0) {
+		key = n;
+		if (r.len > 0 && (r.ptr[0] >> 5) == CBOR_TYPE_UINT) {
+			if (cbor_reader_head(&r, &major, &key) < 0)
+				return (FIDO_ERR_RX_INVALID_CBOR);
+		} else if (cbor_reader_skip(&r, 1) < 0)
+			return (FIDO_ERR_RX_INVALID_CBOR);
+		val = r.ptr;
+		if (cbor_reader_skip(&r, 1) < 0)
+			return (FIDO_ERR_RX_INVALID_CBOR);
+		if (key < n) {
+			ptr[key] = val;
+			len[key] = (size_t)(r.ptr - val);
+		}
+	}
+
+	return (FIDO_OK);
+}
+
+/* an encoded unsigned integer, as located by cbor_index_reply() */
+int
+cbor_read_uint64(const unsigned char *ptr, size_t len, uint64_t *v)
+{
+	struct cbor_reader	r;
+	uint8_t			major;
+
+	r.ptr = ptr;
+	r.len = len;
+
+	if (cbor_reader_head(&r, &major, v) < 0 || major != CBOR_TYPE_UINT ||
+	    r.len != 0) {
+		fido_log_debug("%s: cbor type", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+void
+cbor_vector_free(cbor_item_t **item, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		if (item[i] != NULL)
+			cbor_decref(&item[i]);
+}
+
+int
+cbor_bytestring_copy(const cbor_item_t *item, unsigned char **buf, size_t *len)
+{
+	if (*buf != NULL || *len != 0) {
+		fido_log_debug("%s: dup", __func__);
+		return (-1);
+	}
+
+	if (cbor_isa_bytestring(item) == false ||
+	    cbor_bytestring_is_definite(item) == false) {
+		fido_log_debug("%s: cbor type", __func__);
+		return (-1);
+	}
+
+	*len = cbor_bytestring_length(item);
+	if ((*buf = fido_malloc(*len)) == NULL) {
+		*len = 0;
+		return (-1);
+	}
+
+	memcpy(*buf, cbor_bytestring_handle(item), *len);
+
+	return (0);
+}
+
+int
+cbor_string_copy(const cbor_item_t *item, char **str)
+{
+	size_t len;
+
+	if (*str != NULL) {
+		fido_log_debug("%s: dup", __func__);
+		return (-1);
+	}
+
+	if (cbor_isa_string(item) == false ||
+	    cbor_string_is_definite(item) == false) {
+		fido_log_debug("%s: cbor type", __func__);
+		return (-1);
+	}
+
+	if ((len = cbor_string_length(item)) == SIZE_MAX ||
+	    (*str = fido_malloc(len + 1)) == NULL)
+		return (-1);
+
+	memcpy(*str, cbor_string_handle(item), len);
+	(*str)[len] = '\0';
+
+	return (0);
+}
+
+int
+cbor_add_bytestring(cbor_item_t *item, const char *key,
+    const unsigned char *value, size_t value_len)
+{
+	struct cbor_pair pair;
+	int ok = -1;
+
+	memset(&pair, 0, sizeof(pair));
+
+	if ((pair.key = cbor_build_string(key)) == NULL ||
+	    (pair.value = cbor_build_bytestring(value, value_len)) == NULL) {
+		fido_log_debug("%s: cbor_build", __func__);
+		goto fail;
+	}
+
+	if (!cbor_map_add(item, pair)) {
+		fido_log_debug("%s: cbor_map_add", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	if (pair.key)
+		cbor_decref(&pair.key);
+	if (pair.value)
+		cbor_decref(&pair.value);
+
+	return (ok);
+}
+
+int
+cbor_add_string(cbor_item_t *item, const char *key, const char *value)
+{
+	struct cbor_pair pair;
+	int ok = -1;
+
+	memset(&pair, 0, sizeof(pair));
+
+	if ((pair.key = cbor_build_string(key)) == NULL ||
+	    (pair.value = cbor_build_string(value)) == NULL) {
+		fido_log_debug("%s: cbor_build", __func__);
+		goto fail;
+	}
+
+	if (!cbor_map_add(item, pair)) {
+		fido_log_debug("%s: cbor_map_add", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	if (pair.key)
+		cbor_decref(&pair.key);
+	if (pair.value)
+		cbor_decref(&pair.value);
+
+	return (ok);
+}
+
+int
+cbor_add_bool(cbor_item_t *item, const char *key, fido_opt_t value)
+{
+	struct cbor_pair pair;
+	int ok = -1;
+
+	memset(&pair, 0, sizeof(pair));
+
+	if ((pair.key = cbor_build_string(key)) == NULL ||
+	    (pair.value = cbor_build_bool(value == FIDO_OPT_TRUE)) == NULL) {
+		fido_log_debug("%s: cbor_build", __func__);
+		goto fail;
+	}
+
+	if (!cbor_map_add(item, pair)) {
+		fido_log_debug("%s: cbor_map_add", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	if (pair.key)
+		cbor_decref(&pair.key);
+	if (pair.value)
+		cbor_decref(&pair.value);
+
+	return (ok);
+}
+
+static int
+cbor_add_arg(cbor_item_t *item, uint8_t n, cbor_item_t *arg)
+{
+	struct cbor_pair pair;
+	int ok = -1;
+
+	memset(&pair, 0, sizeof(pair));
+
+	if (arg == NULL)
+		return (0); /* empty argument */
+
+	if ((pair.key = cbor_build_uint8(n)) == NULL) {
+		fido_log_debug("%s: cbor_build", __func__);
+		goto fail;
+	}
+
+	pair.value = arg;
+
+	if (!cbor_map_add(item, pair)) {
+		fido_log_debug("%s: cbor_map_add", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	if (pair.key)
+		cbor_decref(&pair.key);
+
+	return (ok);
+}
+
+cbor_item_t *
+cbor_flatten_vector(cbor_item_t *argv[], size_t argc)
+{
+	cbor_item_t	*map;
+	uint8_t		 i;
+
+	if (argc > UINT8_MAX - 1)
+		return (NULL);
+
+	if ((map = cbor_new_definite_map(argc)) == NULL)
+		return (NULL);
+
+	for (i = 0; i < argc; i++)
+		if (cbor_add_arg(map, (uint8_t)(i + 1), argv[i]) < 0)
+			break;
+
+	if (i != argc) {
+		cbor_decref(&map);
+		map = NULL;
+	}
+
+	return (map);
+}
+
+/*
+ * Direct CBOR writer. Requests are emitted straight into the outgoing
+ * frame; parameters that only exist as libcbor items are serialised in
+ * place at the tail of the buffer. All encodings use the shortest head
+ * form, and map keys are written in CTAP2 canonical order by the callers.
+ */
+struct cbor_writer {
+	unsigned char	*ptr;
+	size_t		 len;
+	size_t		 cap;
+};
+
+#define CBOR_WRITER_MINCAP	256
+
+static int
+cbor_writer_grow(struct cbor_writer *w, size_t n)
+{
+	unsigned char	*ptr;
+	size_t		 cap;
+
+	if (w->cap - w->len >= n)
+		return (0);
+	if (n > SIZE_MAX - w->len) {
+		fido_log_debug("%s: overflow", __func__);
+		return (-1);
+	}
+	cap = w->cap ? w->cap : CBOR_WRITER_MINCAP;
+	while (cap < w->len + n) {
+		if (cap > SIZE_MAX / 2) {
+			cap = w->len + n;
+			break;
+		}
+		cap *= 2;
+	}
+	if ((ptr = fido_realloc(w->ptr, cap)) == NULL) {
+		fido_log_debug("%s: realloc", __func__);
+		return (-1);
+	}
+	w->ptr = ptr;
+	w->cap = cap;
+
+	return (0);
+}
+
+static int
+cbor_writer_raw(struct cbor_writer *w, const void *ptr, size_t len)
+{
+	if (len == 0)
+		return (0);
+	if (cbor_writer_grow(w, len) < 0)
+		return (-1);
+	memcpy(w->ptr + w->len, ptr, len);
+	w->len += len;
+
+	return (0);
+}
+
+static int
+cbor_writer_head(struct cbor_writer *w, uint8_t major, uint64_t v)
+{
+	unsigned char	head[9];
+	size_t		n, len;
+
+	major = (uint8_t)(major << 5);
+	if (v < 24) {
+		head[0] = (unsigned char)(major | v);
+		len = 1;
+	} else {
+		if (v <= UINT8_MAX) {
+			head[0] = (unsigned char)(major | 24);
+			len = 2;
+		} else if (v <= UINT16_MAX) {
+			head[0] = (unsigned char)(major | 25);
+			len = 3;
+		} else if (v <= UINT32_MAX) {
+			head[0] = (unsigned char)(major | 26);
+			len = 5;
+		} else {
+			head[0] = (unsigned char)(major | 27);
+			len = 9;
+		}
+		for (n = len - 1; n > 0; n--) {
+			head[n] = (unsigned char)(v & 0xff);
+			v >>= 8;
+		}
+	}
+
+	return (cbor_writer_raw(w, head, len));
+}
+
+static int
+cbor_writer_bytes(struct cbor_writer *w, const unsigned char *ptr, size_t len)
+{
+	if (cbor_writer_head(w, CBOR_TYPE_BYTESTRING, len) < 0 ||
+	    cbor_writer_raw(w, ptr, len) < 0)
+		return (-1);
+
+	return (0);
+}
+
+static int
+cbor_writer_text(struct cbor_writer *w, const char *str)
+{
+	size_t len = strlen(str);
+
+	if (cbor_writer_head(w, CBOR_TYPE_STRING, len) < 0 ||
+	    cbor_writer_raw(w, str, len) < 0)
+		return (-1);
+
+	return (0);
+}
+
+static int
+cbor_writer_bool(struct cbor_writer *w, const char *key, fido_opt_t value)
+{
+	const unsigned char v = value == FIDO_OPT_TRUE ? 0xf5 : 0xf4;
+
+	if (cbor_writer_text(w, key) < 0 || cbor_writer_raw(w, &v, 1) < 0)
+		return (-1);
+
+	return (0);
+}
+
+static int
+cbor_writer_item(struct cbor_writer *w, const cbor_item_t *item)
+{
+	size_t n;
+
+	if (cbor_writer_grow(w, 64) < 0)
+		return (-1);
+	while ((n = cbor_serialize(item, w->ptr + w->len,
+	    w->cap - w->len)) == 0) {
+		/* a CTAPHID message is at most UINT16_MAX bytes long */
+		if (w->cap > UINT16_MAX ||
+		    cbor_writer_grow(w, w->cap) < 0) {
+			fido_log_debug("%s: cbor_serialize", __func__);
+			return (-1);
+		}
+	}
+	w->len += n;
+
+	return (0);
+}
+
+static int
+cbor_writer_rp_entity(struct cbor_writer *w, const fido_rp_t *rp)
+{
+	size_t n = 0;
+
+	if (rp->id != NULL)
+		n++;
+	if (rp->name != NULL)
+		n++;
+
+	if (cbor_writer_head(w, CBOR_TYPE_MAP, n) < 0 ||
+	    (rp->id && (cbor_writer_text(w, "id") < 0 ||
+	    cbor_writer_text(w, rp->id) < 0)) ||
+	    (rp->name && (cbor_writer_text(w, "name") < 0 ||
+	    cbor_writer_text(w, rp->name) < 0)))
+		return (-1);
+
+	return (0);
+}
+
+static int
+cbor_writer_user_entity(struct cbor_writer *w, const fido_user_t *user)
+{
+	const fido_blob_t	*id = &user->id;
+	const char		*display = user->display_name;
+	size_t			 n = 0;
+
+	if (id->ptr != NULL)
+		n++;
+	if (user->icon != NULL)
+		n++;
+	if (user->name != NULL)
+		n++;
+	if (display != NULL)
+		n++;
+
+	if (cbor_writer_head(w, CBOR_TYPE_MAP, n) < 0 ||
+	    (id->ptr && (cbor_writer_text(w, "id") < 0 ||
+	    cbor_writer_bytes(w, id->ptr, id->len) < 0)) ||
+	    (user->icon && (cbor_writer_text(w, "icon") < 0 ||
+	    cbor_writer_text(w, user->icon) < 0)) ||
+	    (user->name && (cbor_writer_text(w, "name") < 0 ||
+	    cbor_writer_text(w, user->name) < 0)) ||
+	    (display && (cbor_writer_text(w, "displayName") < 0 ||
+	    cbor_writer_text(w, display) < 0)))
+		return (-1);
+
+	return (0);
+}
+
+static int
+cbor_writer_pubkey_param(struct cbor_writer *w, int cose_alg)
+{
+	if (cose_alg > -1 || cose_alg < INT16_MIN) {
+		fido_log_debug("%s: cose_alg=%d", __func__, cose_alg);
+		return (-1);
+	}
+
+	if (cbor_writer_head(w, CBOR_TYPE_ARRAY, 1) < 0 ||
+	    cbor_writer_head(w, CBOR_TYPE_MAP, 2) < 0 ||
+	    cbor_writer_text(w, "alg") < 0 ||
+	    cbor_writer_head(w, CBOR_TYPE_NEGINT,
+	    (uint64_t)(-cose_alg - 1)) < 0 ||
+	    cbor_writer_text(w, "type") < 0 ||
+	    cbor_writer_text(w, "public-key") < 0)
+		return (-1);
+
+	return (0);
 }
 
-int
-cbor_add_bool(cbor_item_t *item, const char *key, fido_opt_t value)
+static int
+cbor_writer_pubkey_list(struct cbor_writer *w, const fido_blob_array_t *list)
 {
-	struct cbor_pair pair;
-	int ok = -1;
-
-	memset(&pair, 0, sizeof(pair));
+	if (cbor_writer_head(w, CBOR_TYPE_ARRAY, list->len) < 0)
+		return (-1);
 
-	if ((pair.key = cbor_build_string(key)) == NULL ||
-	    (pair.value = cbor_build_bool(value == FIDO_OPT_TRUE)) == NULL) {
-		fido_log_debug("%s: cbor_build", __func__);
-		goto fail;
+	for (size_t i = 0; i < list->len; i++) {
+		if (cbor_writer_head(w, CBOR_TYPE_MAP, 2) < 0 ||
+		    cbor_writer_text(w, "id") < 0 ||
+		    cbor_writer_bytes(w, list->ptr[i].ptr,
+		    list->ptr[i].len) < 0 ||
+		    cbor_writer_text(w, "type") < 0 ||
+		    cbor_writer_text(w, "public-key") < 0)
+			return (-1);
 	}
 
-	if (!cbor_map_add(item, pair)) {
-		fido_log_debug("%s: cbor_map_add", __func__);
-		goto fail;
-	}
+	return (0);
+}
 
-	ok = 0;
-fail:
-	if (pair.key)
-		cbor_decref(&pair.key);
-	if (pair.value)
-		cbor_decref(&pair.value);
+static int
+cbor_writer_opt(struct cbor_writer *w, const char *key, fido_opt_t v,
+    fido_opt_t uv)
+{
+	size_t n = 0;
 
-	return (ok);
+	if (v != FIDO_OPT_OMIT)
+		n++;
+	if (uv != FIDO_OPT_OMIT)
+		n++;
+
+	if (cbor_writer_head(w, CBOR_TYPE_MAP, n) < 0 ||
+	    (v != FIDO_OPT_OMIT && cbor_writer_bool(w, key, v) < 0) ||
+	    (uv != FIDO_OPT_OMIT && cbor_writer_bool(w, "uv", uv) < 0))
+		return (-1);
+
+	return (0);
 }
 
 static int
-cbor_add_uint8(cbor_item_t *item, const char *key, uint8_t value)
+cbor_writer_args(struct cbor_writer *w, uint8_t cmd, cbor_item_t *argv[],
+    size_t argc, size_t n)
 {
-	struct cbor_pair pair;
-	int ok = -1;
+	if (argc > UINT8_MAX - 1)
+		return (-1);
 
-	memset(&pair, 0, sizeof(pair));
+	for (size_t i = 0; i < argc; i++)
+		if (argv[i] != NULL)
+			n++;
 
-	if ((pair.key = cbor_build_string(key)) == NULL ||
-	    (pair.value = cbor_build_uint8(value)) == NULL) {
-		fido_log_debug("%s: cbor_build", __func__);
-		goto fail;
-	}
+	if (cbor_writer_raw(w, &cmd, 1) < 0 ||
+	    cbor_writer_head(w, CBOR_TYPE_MAP, n) < 0)
+		return (-1);
 
-	if (!cbor_map_add(item, pair)) {
-		fido_log_debug("%s: cbor_map_add", __func__);
-		goto fail;
-	}
+	return (0);
+}
 
-	ok = 0;
-fail:
-	if (pair.key)
-		cbor_decref(&pair.key);
-	if (pair.value)
-		cbor_decref(&pair.value);
+static int
+cbor_writer_arg(struct cbor_writer *w, uint8_t key, const cbor_item_t *arg)
+{
+	if (arg == NULL)
+		return (0); /* empty argument */
+	if (cbor_writer_head(w, CBOR_TYPE_UINT, key) < 0 ||
+	    cbor_writer_item(w, arg) < 0)
+		return (-1);
 
-	return (ok);
+	return (0);
 }
 
 static int
-cbor_add_arg(cbor_item_t *item, uint8_t n, cbor_item_t *arg)
+cbor_writer_done(struct cbor_writer *w, int ok, fido_blob_t *f)
 {
-	struct cbor_pair pair;
-	int ok = -1;
+	if (ok < 0) {
+		fido_free(w->ptr);
+		return (-1);
+	}
 
-	memset(&pair, 0, sizeof(pair));
+	f->ptr = w->ptr;
+	f->len = w->len;
+	f->cap = w->cap;
 
-	if (arg == NULL)
-		return (0); /* empty argument */
+	return (0);
+}
 
-	if ((pair.key = cbor_build_uint8(n)) == NULL) {
-		fido_log_debug("%s: cbor_build", __func__);
-		goto fail;
-	}
+int
+cbor_build_frame(uint8_t cmd, cbor_item_t *argv[], size_t argc, fido_blob_t *f)
+{
+	struct cbor_writer	w;
+	fido_prof_t		prof;
+	int			ok = -1;
 
-	pair.value = arg;
+	memset(&w, 0, sizeof(w));
+	fido_prof_begin(&prof, FIDO_PROF_BUILD_FRAME);
 
-	if (!cbor_map_add(item, pair)) {
-		fido_log_debug("%s: cbor_map_add", __func__);
+	if (cbor_writer_args(&w, cmd, argv, argc, 0) < 0)
 		goto fail;
-	}
+	for (size_t i = 0; i < argc; i++)
+		if (cbor_writer_arg(&w, (uint8_t)(i + 1), argv[i]) < 0)
+			goto fail;
 
 	ok = 0;
 fail:
-	if (pair.key)
-		cbor_decref(&pair.key);
-
-	return (ok);
+	return (fido_prof_end(&prof, cbor_writer_done(&w, ok, f)));
 }
 
-cbor_item_t *
-cbor_flatten_vector(cbor_item_t *argv[], size_t argc)
+/*
+ * Encode a list of credential ids as an array of
+ * PublicKeyCredentialDescriptors, as used in allowList and excludeList.
+ */
+int
+cbor_encode_pubkey_list(const fido_blob_array_t *list, fido_blob_t *out)
 {
-	cbor_item_t	*map;
-	uint8_t		 i;
-
-	if (argc > UINT8_MAX - 1)
-		return (NULL);
-
-	if ((map = cbor_new_definite_map(argc)) == NULL)
-		return (NULL);
+	struct cbor_writer	w;
+	int			ok = -1;
 
-	for (i = 0; i < argc; i++)
-		if (cbor_add_arg(map, (uint8_t)(i + 1), argv[i]) < 0)
-			break;
+	memset(&w, 0, sizeof(w));
 
-	if (i != argc) {
-		cbor_decref(&map);
-		map = NULL;
+	if (out->ptr != NULL || out->len != 0) {
+		fido_log_debug("%s: dup", __func__);
+		return (-1);
 	}
+	if (cbor_writer_pubkey_list(&w, list) < 0)
+		goto fail;
 
-	return (map);
+	ok = 0;
+fail:
+	return (cbor_writer_done(&w, ok, out));
 }
 
+/*
+ * authenticatorMakeCredential. The fixed parameters (clientDataHash, rp,
+ * user, pubKeyCredParams, excludeList, options) are taken from 'cred';
+ * argv[5] (extensions), argv[7] (pinUvAuthParam) and argv[8]
+ * (pinUvAuthProtocol) are optional items; all other slots must be NULL.
+ */
 int
-cbor_build_frame(uint8_t cmd, cbor_item_t *argv[], size_t argc, fido_blob_t *f)
+cbor_build_cred_frame(const fido_cred_t *cred, fido_opt_t uv,
+    cbor_item_t *argv[], fido_blob_t *f)
 {
-	cbor_item_t	*flat = NULL;
-	unsigned char	*cbor = NULL;
-	size_t		 cbor_len;
-	size_t		 cbor_alloc_len;
-	int		 ok = -1;
-
-	if ((flat = cbor_flatten_vector(argv, argc)) == NULL)
+	struct cbor_writer	w;
+	size_t			n = 4;
+	int			ok = -1;
+
+	memset(&w, 0, sizeof(w));
+
+	if (cred->excl.len)
+		n++;
+	if (cred->rk != FIDO_OPT_OMIT || uv != FIDO_OPT_OMIT)
+		n++;
+
+	if (cbor_writer_args(&w, CTAP_CBOR_MAKECRED, argv, 9, n) < 0 ||
+	    cbor_writer_head(&w, CBOR_TYPE_UINT, 1) < 0 ||
+	    cbor_writer_bytes(&w, cred->cdh.ptr, cred->cdh.len) < 0 ||
+	    cbor_writer_head(&w, CBOR_TYPE_UINT, 2) < 0 ||
+	    cbor_writer_rp_entity(&w, &cred->rp) < 0 ||
+	    cbor_writer_head(&w, CBOR_TYPE_UINT, 3) < 0 ||
+	    cbor_writer_user_entity(&w, &cred->user) < 0 ||
+	    cbor_writer_head(&w, CBOR_TYPE_UINT, 4) < 0 ||
+	    cbor_writer_pubkey_param(&w, cred->type) < 0)
 		goto fail;
-
-	cbor_len = cbor_serialize_alloc(flat, &cbor, &cbor_alloc_len);
-	if (cbor_len == 0 || cbor_len == SIZE_MAX) {
-		fido_log_debug("%s: cbor_len=%zu", __func__, cbor_len);
+	if (cred->excl.len && (cbor_writer_head(&w, CBOR_TYPE_UINT, 5) < 0 ||
+	    cbor_writer_pubkey_list(&w, &cred->excl) < 0))
 		goto fail;
-	}
-
-	if ((f->ptr = malloc(cbor_len + 1)) == NULL)
+	if (cbor_writer_arg(&w, 6, argv[5]) < 0)
+		goto fail;
+	if ((cred->rk != FIDO_OPT_OMIT || uv != FIDO_OPT_OMIT) &&
+	    (cbor_writer_head(&w, CBOR_TYPE_UINT, 7) < 0 ||
+	    cbor_writer_opt(&w, "rk", cred->rk, uv) < 0))
+		goto fail;
+	if (cbor_writer_arg(&w, 8, argv[7]) < 0 ||
+	    cbor_writer_arg(&w, 9, argv[8]) < 0)
 		goto fail;
-
-	f->len = cbor_len + 1;
-	f->ptr[0] = cmd;
-	memcpy(f->ptr + 1, cbor, f->len - 1);
 
 	ok = 0;
 fail:
-	if (flat != NULL)
-		cbor_decref(&flat);
+	return (cbor_writer_done(&w, ok, f));
+}
 
-	free(cbor);
+/*
+ * authenticatorGetAssertion. rpId, clientDataHash, allowList and options
+ * are taken from 'assert', using the pre-encoded allowList in
+ * assert->allow_cbor if there is one; argv[3] (extensions), argv[5]
+ * (pinUvAuthParam)
+ * and argv[6] (pinUvAuthProtocol) are optional items; all other slots
+ * must be NULL. The offset of clientDataHash in 'f' is stored in
+ * 'cdh_off'.
+ */
+int
+cbor_build_assert_frame(const fido_assert_t *assert, fido_opt_t uv,
+    cbor_item_t *argv[], fido_blob_t *f, size_t *cdh_off)
+{
+	struct cbor_writer	w;
+	size_t			n = 2;
+	int			ok = -1;
+
+	memset(&w, 0, sizeof(w));
+
+	if (assert->allow_list.len)
+		n++;
+	if (assert->up != FIDO_OPT_OMIT || uv != FIDO_OPT_OMIT)
+		n++;
+
+	if (cbor_writer_args(&w, CTAP_CBOR_ASSERT, argv, 7, n) < 0 ||
+	    cbor_writer_head(&w, CBOR_TYPE_UINT, 1) < 0 ||
+	    cbor_writer_text(&w, assert->rp_id) < 0 ||
+	    cbor_writer_head(&w, CBOR_TYPE_UINT, 2) < 0 ||
+	    cbor_writer_head(&w, CBOR_TYPE_BYTESTRING, assert->cdh.len) < 0)
+		goto fail;
+	*cdh_off = w.len;
+	if (cbor_writer_raw(&w, assert->cdh.ptr, assert->cdh.len) < 0)
+		goto fail;
+	if (assert->allow_list.len && assert->allow_cbor.ptr != NULL &&
+	    (cbor_writer_head(&w, CBOR_TYPE_UINT, 3) < 0 ||
+	    cbor_writer_raw(&w, assert->allow_cbor.ptr,
+	    assert->allow_cbor.len) < 0))
+		goto fail;
+	if (assert->allow_list.len && assert->allow_cbor.ptr == NULL &&
+	    (cbor_writer_head(&w, CBOR_TYPE_UINT, 3) < 0 ||
+	    cbor_writer_pubkey_list(&w, &assert->allow_list) < 0))
+		goto fail;
+	if (cbor_writer_arg(&w, 4, argv[3]) < 0)
+		goto fail;
+	if ((assert->up != FIDO_OPT_OMIT || uv != FIDO_OPT_OMIT) &&
+	    (cbor_writer_head(&w, CBOR_TYPE_UINT, 5) < 0 ||
+	    cbor_writer_opt(&w, "up", assert->up, uv) < 0))
+		goto fail;
+	if (cbor_writer_arg(&w, 6, argv[5]) < 0 ||
+	    cbor_writer_arg(&w, 7, argv[6]) < 0)
+		goto fail;
 
-	return (ok);
+	ok = 0;
+fail:
+	return (cbor_writer_done(&w, ok, f));
 }
 
 cbor_item_t *
@@ -535,32 +1720,6 @@ cbor_encode_pubkey(const fido_blob_t *pubkey)
 	return (cbor_key);
 }
 
-cbor_item_t *
-cbor_encode_pubkey_list(const fido_blob_array_t *list)
-{
-	cbor_item_t	*array = NULL;
-	cbor_item_t	*key = NULL;
-
-	if ((array = cbor_new_definite_array(list->len)) == NULL)
-		goto fail;
-
-	for (size_t i = 0; i < list->len; i++) {
-		if ((key = cbor_encode_pubkey(&list->ptr[i])) == NULL ||
-		    cbor_array_push(array, key) == false)
-			goto fail;
-		cbor_decref(&key);
-	}
-
-	return (array);
-fail:
-	if (key != NULL)
-		cbor_decref(&key);
-	if (array != NULL)
-		cbor_decref(&array);
-
-	return (NULL);
-}
-
 cbor_item_t *
 cbor_encode_str_array(const fido_str_array_t *a)
 {
@@ -587,103 +1746,44 @@ fail:
 	return (NULL);
 }
 
+#ifndef FIDO_VERIFY_ONLY
 static int
-cbor_encode_largeblob_key_ext(cbor_item_t *map)
-{
-	if (map == NULL ||
-	    cbor_add_bool(map, "largeBlobKey", FIDO_OPT_TRUE) < 0)
-		return (-1);
-
-	return (0);
-}
-
-cbor_item_t *
-cbor_encode_cred_ext(const fido_cred_ext_t *ext, const fido_blob_t *blob)
+cbor_add_uint8(cbor_item_t *item, const char *key, uint8_t value)
 {
-	cbor_item_t *item = NULL;
-	size_t size = 0;
-
-	if (ext->mask & FIDO_EXT_CRED_BLOB)
-		size++;
-	if (ext->mask & FIDO_EXT_HMAC_SECRET)
-		size++;
-	if (ext->mask & FIDO_EXT_CRED_PROTECT)
-		size++;
-	if (ext->mask & FIDO_EXT_LARGEBLOB_KEY)
-		size++;
-	if (ext->mask & FIDO_EXT_MINPINLEN)
-		size++;
+	struct cbor_pair pair;
+	int ok = -1;
 
-	if (size == 0 || (item = cbor_new_definite_map(size)) == NULL)
-		return (NULL);
+	memset(&pair, 0, sizeof(pair));
 
-	if (ext->mask & FIDO_EXT_CRED_BLOB) {
-		if (cbor_add_bytestring(item, "credBlob", blob->ptr,
-		    blob->len) < 0) {
-			cbor_decref(&item);
-			return (NULL);
-		}
-	}
-	if (ext->mask & FIDO_EXT_CRED_PROTECT) {
-		if (ext->prot < 0 || ext->prot > UINT8_MAX ||
-		    cbor_add_uint8(item, "credProtect",
-		    (uint8_t)ext->prot) < 0) {
-			cbor_decref(&item);
-			return (NULL);
-		}
-	}
-	if (ext->mask & FIDO_EXT_HMAC_SECRET) {
-		if (cbor_add_bool(item, "hmac-secret", FIDO_OPT_TRUE) < 0) {
-			cbor_decref(&item);
-			return (NULL);
-		}
-	}
-	if (ext->mask & FIDO_EXT_LARGEBLOB_KEY) {
-		if (cbor_encode_largeblob_key_ext(item) < 0) {
-			cbor_decref(&item);
-			return (NULL);
-		}
-	}
-	if (ext->mask & FIDO_EXT_MINPINLEN) {
-		if (cbor_add_bool(item, "minPinLength", FIDO_OPT_TRUE) < 0) {
-			cbor_decref(&item);
-			return (NULL);
-		}
+	if ((pair.key = cbor_build_string(key)) == NULL ||
+	    (pair.value = cbor_build_uint8(value)) == NULL) {
+		fido_log_debug("%s: cbor_build", __func__);
+		goto fail;
 	}
 
-	return (item);
-}
-
-cbor_item_t *
-cbor_encode_cred_opt(fido_opt_t rk, fido_opt_t uv)
-{
-	cbor_item_t *item = NULL;
-
-	if ((item = cbor_new_definite_map(2)) == NULL)
-		return (NULL);
-	if ((rk != FIDO_OPT_OMIT && cbor_add_bool(item, "rk", rk) < 0) ||
-	    (uv != FIDO_OPT_OMIT && cbor_add_bool(item, "uv", uv) < 0)) {
-		cbor_decref(&item);
-		return (NULL);
+	if (!cbor_map_add(item, pair)) {
+		fido_log_debug("%s: cbor_map_add", __func__);
+		goto fail;
 	}
 
-	return (item);
-}
-
-cbor_item_t *
-cbor_encode_assert_opt(fido_opt_t up, fido_opt_t uv)
-{
-	cbor_item_t *item = NULL;
+	ok = 0;
+fail:
+	if (pair.key)
+		cbor_decref(&pair.key);
+	if (pair.value)
+		cbor_decref(&pair.value);
 
-	if ((item = cbor_new_definite_map(2)) == NULL)
-		return (NULL);
-	if ((up != FIDO_OPT_OMIT && cbor_add_bool(item, "up", up) < 0) ||
-	    (uv != FIDO_OPT_OMIT && cbor_add_bool(item, "uv", uv) < 0)) {
-		cbor_decref(&item);
-		return (NULL);
-	}
+	return (ok);
+}
 
-	return (item);
+static int
+cbor_encode_largeblob_key_ext(cbor_item_t *map)
+{
+	if (map == NULL ||
+	    cbor_add_bool(map, "largeBlobKey", FIDO_OPT_TRUE) < 0)
+		return (-1);
+
+	return (0);
 }
 
 cbor_item_t *
@@ -709,7 +1809,7 @@ cbor_encode_pin_auth(const fido_dev_t *dev, const fido_blob_t *secret,
 	if (prot == CTAP_PIN_PROTOCOL2 && key.len > 32)
 		key.len = 32;
 
-	if ((md = EVP_sha256()) == NULL || HMAC(md, key.ptr,
+	if ((md = fido_md_sha256()) == NULL || HMAC(md, key.ptr,
 	    (int)key.len, data->ptr, data->len, dgst,
 	    &dgst_len) == NULL || dgst_len != SHA256_DIGEST_LENGTH)
 		return (NULL);
@@ -757,7 +1857,7 @@ cbor_encode_change_pin_auth(const fido_dev_t *dev, const fido_blob_t *secret,
 		key.len = 32;
 
 	if ((ctx = HMAC_CTX_new()) == NULL ||
-	    (md = EVP_sha256())  == NULL ||
+	    (md = fido_md_sha256())  == NULL ||
 	    HMAC_Init_ex(ctx, key.ptr, (int)key.len, md, NULL) == 0 ||
 	    HMAC_Update(ctx, new_pin_enc->ptr, new_pin_enc->len) == 0 ||
 	    HMAC_Update(ctx, pin_hash_enc->ptr, pin_hash_enc->len) == 0 ||
@@ -782,7 +1882,8 @@ fail:
 
 static int
 cbor_encode_hmac_secret_param(const fido_dev_t *dev, cbor_item_t *item,
-    const fido_blob_t *ecdh, const es256_pk_t *pk, const fido_blob_t *salt)
+    const char *name, const fido_blob_t *ecdh, const es256_pk_t *pk,
+    const fido_blob_t *salt)
 {
 	cbor_item_t		*param = NULL;
 	cbor_item_t		*argv[4];
@@ -837,7 +1938,7 @@ cbor_encode_hmac_secret_param(const fido_dev_t *dev, cbor_item_t *item,
 		goto fail;
 	}
 
-	if ((pair.key = cbor_build_string("hmac-secret")) == NULL) {
+	if ((pair.key = cbor_build_string(name)) == NULL) {
 		fido_log_debug("%s: cbor_build", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
@@ -866,6 +1967,78 @@ fail:
 	return (r);
 }
 
+cbor_item_t *
+cbor_encode_cred_ext(fido_dev_t *dev, const fido_cred_ext_t *ext,
+    const fido_blob_t *blob, const fido_blob_t *ecdh, const es256_pk_t *pk)
+{
+	cbor_item_t *item = NULL;
+	size_t size = 0;
+	bool mc;
+
+	mc = (ext->mask & FIDO_EXT_HMAC_SECRET) &&
+	    !fido_blob_is_empty(&ext->hmac_salt);
+
+	if (ext->mask & FIDO_EXT_CRED_BLOB)
+		size++;
+	if (ext->mask & FIDO_EXT_HMAC_SECRET)
+		size++;
+	if (ext->mask & FIDO_EXT_CRED_PROTECT)
+		size++;
+	if (ext->mask & FIDO_EXT_LARGEBLOB_KEY)
+		size++;
+	if (ext->mask & FIDO_EXT_MINPINLEN)
+		size++;
+	if (mc)
+		size++;
+
+	if (size == 0 || (item = cbor_new_definite_map(size)) == NULL)
+		return (NULL);
+
+	if (ext->mask & FIDO_EXT_CRED_BLOB) {
+		if (cbor_add_bytestring(item, "credBlob", blob->ptr,
+		    blob->len) < 0) {
+			cbor_decref(&item);
+			return (NULL);
+		}
+	}
+	if (ext->mask & FIDO_EXT_CRED_PROTECT) {
+		if (ext->prot < 0 || ext->prot > UINT8_MAX ||
+		    cbor_add_uint8(item, "credProtect",
+		    (uint8_t)ext->prot) < 0) {
+			cbor_decref(&item);
+			return (NULL);
+		}
+	}
+	if (ext->mask & FIDO_EXT_HMAC_SECRET) {
+		if (cbor_add_bool(item, "hmac-secret", FIDO_OPT_TRUE) < 0) {
+			cbor_decref(&item);
+			return (NULL);
+		}
+	}
+	if (ext->mask & FIDO_EXT_LARGEBLOB_KEY) {
+		if (cbor_encode_largeblob_key_ext(item) < 0) {
+			cbor_decref(&item);
+			return (NULL);
+		}
+	}
+	if (ext->mask & FIDO_EXT_MINPINLEN) {
+		if (cbor_add_bool(item, "minPinLength", FIDO_OPT_TRUE) < 0) {
+			cbor_decref(&item);
+			return (NULL);
+		}
+	}
+	/* CTAP 2.2: the hmac-secret outputs, returned by makeCredential */
+	if (mc) {
+		if (cbor_encode_hmac_secret_param(dev, item, "hmac-secret-mc",
+		    ecdh, pk, &ext->hmac_salt) < 0) {
+			cbor_decref(&item);
+			return (NULL);
+		}
+	}
+
+	return (item);
+}
+
 cbor_item_t *
 cbor_encode_assert_ext(fido_dev_t *dev, const fido_assert_ext_t *ext,
     const fido_blob_t *ecdh, const es256_pk_t *pk)
@@ -889,8 +2062,8 @@ cbor_encode_assert_ext(fido_dev_t *dev, const fido_assert_ext_t *ext,
 		}
 	}
 	if (ext->mask & FIDO_EXT_HMAC_SECRET) {
-		if (cbor_encode_hmac_secret_param(dev, item, ecdh, pk,
-		    &ext->hmac_salt) < 0) {
+		if (cbor_encode_hmac_secret_param(dev, item, "hmac-secret",
+		    ecdh, pk, &ext->hmac_salt) < 0) {
 			cbor_decref(&item);
 			return (NULL);
 		}
@@ -904,6 +2077,7 @@ cbor_encode_assert_ext(fido_dev_t *dev, const fido_assert_ext_t *ext,
 
 	return (item);
 }
+#endif /* !FIDO_VERIFY_ONLY */
 
 int
 cbor_decode_fmt(const cbor_item_t *item, char **fmt)
@@ -915,10 +2089,9 @@ cbor_decode_fmt(const cbor_item_t *item, char **fmt)
 		return (-1);
 	}
 
-	if (strcmp(type, "packed") && strcmp(type, "fido-u2f") &&
-	    strcmp(type, "none") && strcmp(type, "tpm")) {
+	if (fido_fmt_id(type) == FIDO_FMT_UNKNOWN) {
 		fido_log_debug("%s: type=%s", __func__, type);
-		free(type);
+		fido_free(type);
 		return (-1);
 	}
 
@@ -977,55 +2150,70 @@ find_cose_alg(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 }
 
 static int
-get_cose_alg(const cbor_item_t *item, int *cose_alg)
+check_cose_key(const struct cose_key *cose_key)
 {
-	struct cose_key cose_key;
-
-	memset(&cose_key, 0, sizeof(cose_key));
-
-	*cose_alg = 0;
-
-	if (cbor_isa_map(item) == false ||
-	    cbor_map_is_definite(item) == false ||
-	    cbor_map_iter(item, &cose_key, find_cose_alg) < 0) {
-		fido_log_debug("%s: cbor type", __func__);
-		return (-1);
-	}
-
-	switch (cose_key.alg) {
+	switch (cose_key->alg) {
 	case COSE_ES256:
-		if (cose_key.kty != COSE_KTY_EC2 ||
-		    cose_key.crv != COSE_P256) {
+		if (cose_key->kty != COSE_KTY_EC2 ||
+		    cose_key->crv != COSE_P256) {
 			fido_log_debug("%s: invalid kty/crv", __func__);
 			return (-1);
 		}
 		break;
+#ifndef FIDO_NO_ES384
 	case COSE_ES384:
-		if (cose_key.kty != COSE_KTY_EC2 ||
-		    cose_key.crv != COSE_P384) {
+		if (cose_key->kty != COSE_KTY_EC2 ||
+		    cose_key->crv != COSE_P384) {
 			fido_log_debug("%s: invalid kty/crv", __func__);
 			return (-1);
 		}
 		break;
+#endif
+#ifndef FIDO_NO_EDDSA
 	case COSE_EDDSA:
-		if (cose_key.kty != COSE_KTY_OKP ||
-		    cose_key.crv != COSE_ED25519) {
+		if (cose_key->kty != COSE_KTY_OKP ||
+		    cose_key->crv != COSE_ED25519) {
 			fido_log_debug("%s: invalid kty/crv", __func__);
 			return (-1);
 		}
 		break;
+#endif
+#ifndef FIDO_NO_RS256
 	case COSE_RS256:
-		if (cose_key.kty != COSE_KTY_RSA) {
+		if (cose_key->kty != COSE_KTY_RSA) {
 			fido_log_debug("%s: invalid kty/crv", __func__);
 			return (-1);
 		}
 		break;
+#endif
 	default:
-		fido_log_debug("%s: unknown alg %d", __func__, cose_key.alg);
+		fido_log_debug("%s: unknown alg %d", __func__, cose_key->alg);
+
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+get_cose_alg(const cbor_item_t *item, int *cose_alg)
+{
+	struct cose_key cose_key;
+
+	memset(&cose_key, 0, sizeof(cose_key));
 
+	*cose_alg = 0;
+
+	if (cbor_isa_map(item) == false ||
+	    cbor_map_is_definite(item) == false ||
+	    cbor_map_iter(item, &cose_key, find_cose_alg) < 0) {
+		fido_log_debug("%s: cbor type", __func__);
 		return (-1);
 	}
 
+	if (check_cose_key(&cose_key) < 0)
+		return (-1);
+
 	*cose_alg = cose_key.alg;
 
 	return (0);
@@ -1046,24 +2234,30 @@ cbor_decode_pubkey(const cbor_item_t *item, int *type, void *key)
 			return (-1);
 		}
 		break;
+#ifndef FIDO_NO_ES384
 	case COSE_ES384:
 		if (es384_pk_decode(item, key) < 0) {
 			fido_log_debug("%s: es384_pk_decode", __func__);
 			return (-1);
 		}
 		break;
+#endif
+#ifndef FIDO_NO_RS256
 	case COSE_RS256:
 		if (rs256_pk_decode(item, key) < 0) {
 			fido_log_debug("%s: rs256_pk_decode", __func__);
 			return (-1);
 		}
 		break;
+#endif
+#ifndef FIDO_NO_EDDSA
 	case COSE_EDDSA:
 		if (eddsa_pk_decode(item, key) < 0) {
 			fido_log_debug("%s: eddsa_pk_decode", __func__);
 			return (-1);
 		}
 		break;
+#endif
 	default:
 		fido_log_debug("%s: invalid cose_alg %d", __func__, *type);
 		return (-1);
@@ -1072,14 +2266,164 @@ cbor_decode_pubkey(const cbor_item_t *item, int *type, void *key)
 	return (0);
 }
 
+/*
+ * A COSE_Key read in place: the integer members, and the key parameters
+ * (labels -1, -2 and -3) left pointing into the encoded map.
+ */
+struct cose_key_raw {
+	struct cose_key		 hdr;
+	const unsigned char	*param[3];
+	size_t			 param_len[3];
+};
+
+/* the label of a COSE_Key member; 0 if it is not one we read */
+static int
+cbor_reader_cose_label(struct cbor_reader *r, int *label)
+{
+	uint8_t		major;
+	uint64_t	v;
+
+	*label = 0;
+	if (r->len < 1 || ((r->ptr[0] >> 5) != CBOR_TYPE_UINT &&
+	    (r->ptr[0] >> 5) != CBOR_TYPE_NEGINT))
+		return (cbor_reader_skip(r, 1));
+	if (cbor_reader_head(r, &major, &v) < 0)
+		return (-1);
+	if (major == CBOR_TYPE_UINT && v <= 3)
+		*label = (int)v;
+	else if (major == CBOR_TYPE_NEGINT && v <= 2)
+		*label = -(int)v - 1;
+
+	return (0);
+}
+
+static int
+cbor_reader_cose_int(struct cbor_reader *r, uint8_t type, int *v)
+{
+	uint8_t		major;
+	uint64_t	x;
+
+	if (*v != 0 || cbor_reader_head(r, &major, &x) < 0 ||
+	    major != type || x > INT_MAX) {
+		fido_log_debug("%s: cbor type", __func__);
+		return (-1);
+	}
+	*v = type == CBOR_TYPE_NEGINT ? -(int)x - 1 : (int)x;
+
+	return (0);
+}
+
+static int
+cbor_reader_cose_member(struct cbor_reader *r, int label,
+    struct cose_key_raw *k)
+{
+	uint8_t type = r->len > 0 ? (uint8_t)(r->ptr[0] >> 5) : 0xff;
+
+	if (label == 1)
+		return (cbor_reader_cose_int(r, CBOR_TYPE_UINT, &k->hdr.kty));
+	if (label == 3)
+		return (cbor_reader_cose_int(r, CBOR_TYPE_NEGINT, &k->hdr.alg));
+	/* -1 is the curve, or the modulus of an rsa key */
+	if (label == -1 && type == CBOR_TYPE_UINT)
+		return (cbor_reader_cose_int(r, CBOR_TYPE_UINT, &k->hdr.crv));
+	if (label < 0 && type == CBOR_TYPE_BYTESTRING)
+		return (cbor_reader_string(r, CBOR_TYPE_BYTESTRING,
+		    &k->param[-label - 1], &k->param_len[-label - 1]));
+
+	return (cbor_reader_skip(r, 1));
+}
+
+static int
+cose_key_param(const struct cose_key_raw *k, int label, void *ptr, size_t len)
+{
+	if (k->param[-label - 1] == NULL || k->param_len[-label - 1] != len) {
+		fido_log_debug("%s: label %d", __func__, label);
+		return (-1);
+	}
+	memcpy(ptr, k->param[-label - 1], len);
+
+	return (0);
+}
+
+/*
+ * Decode the COSE_Key at *buf straight into the es256_pk_t, es384_pk_t,
+ * rs256_pk_t or eddsa_pk_t at 'key', advancing *buf past it. The map must
+ * follow the CTAP2 canonical CBOR rules.
+ */
+int
+cbor_read_pubkey(const unsigned char **buf, size_t *len, int *type, void *key)
+{
+	struct cbor_reader	 r;
+	struct cose_key_raw	 k;
+	const unsigned char	*prev = NULL, *curr;
+	size_t			 prev_len = 0, curr_len;
+	es256_pk_t		*es256 = key;
+	es384_pk_t		*es384 = key;
+	rs256_pk_t		*rs256 = key;
+	eddsa_pk_t		*eddsa = key;
+	uint64_t		 n;
+	int			 label;
+
+	memset(&k, 0, sizeof(k));
+	r.ptr = *buf;
+	r.len = *len;
+	*type = 0;
+
+	if (cbor_reader_map(&r, &n) < 0)
+		return (-1);
+
+	while (n-- > 0) {
+		curr = r.ptr;
+		if (cbor_reader_cose_label(&r, &label) < 0)
+			return (-1);
+		curr_len = (size_t)(r.ptr - curr);
+		if ((prev != NULL && ctap_check_key(prev, prev_len, curr,
+		    curr_len) < 0) || cbor_reader_cose_member(&r, label,
+		    &k) < 0) {
+			fido_log_debug("%s: cose key", __func__);
+			return (-1);
+		}
+		prev = curr;
+		prev_len = curr_len;
+	}
+
+	if (check_cose_key(&k.hdr) < 0)
+		return (-1);
+
+	switch (k.hdr.alg) {
+	case COSE_ES256:
+		if (cose_key_param(&k, -2, es256->x, sizeof(es256->x)) < 0 ||
+		    cose_key_param(&k, -3, es256->y, sizeof(es256->y)) < 0)
+			return (-1);
+		break;
+	case COSE_ES384:
+		if (cose_key_param(&k, -2, es384->x, sizeof(es384->x)) < 0 ||
+		    cose_key_param(&k, -3, es384->y, sizeof(es384->y)) < 0)
+			return (-1);
+		break;
+	case COSE_RS256:
+		if (cose_key_param(&k, -1, rs256->n, sizeof(rs256->n)) < 0 ||
+		    cose_key_param(&k, -2, rs256->e, sizeof(rs256->e)) < 0)
+			return (-1);
+		break;
+	default: /* COSE_EDDSA */
+		if (cose_key_param(&k, -2, eddsa->x, sizeof(eddsa->x)) < 0)
+			return (-1);
+		break;
+	}
+
+	*type = k.hdr.alg;
+	*buf = r.ptr;
+	*len = r.len;
+
+	return (0);
+}
+
 static int
 decode_attcred(const unsigned char **buf, size_t *len, int cose_alg,
     fido_attcred_t *attcred)
 {
-	cbor_item_t		*item = NULL;
-	struct cbor_load_result	 cbor;
-	uint16_t		 id_len;
-	int			 ok = -1;
+	uint16_t id_len;
 
 	fido_log_xxd(*buf, *len, "%s", __func__);
 
@@ -1095,7 +2439,7 @@ decode_attcred(const unsigned char **buf, size_t *len, int cose_alg,
 	}
 
 	attcred->id.len = (size_t)be16toh(id_len);
-	if ((attcred->id.ptr = malloc(attcred->id.len)) == NULL)
+	if ((attcred->id.ptr = fido_malloc(attcred->id.len)) == NULL)
 		return (-1);
 
 	fido_log_debug("%s: attcred->id.len=%zu", __func__, attcred->id.len);
@@ -1105,31 +2449,19 @@ decode_attcred(const unsigned char **buf, size_t *len, int cose_alg,
 		return (-1);
 	}
 
-	if ((item = cbor_load(*buf, *len, &cbor)) == NULL) {
-		fido_log_debug("%s: cbor_load", __func__);
-		goto fail;
-	}
-
-	if (cbor_decode_pubkey(item, &attcred->type, &attcred->pubkey) < 0) {
-		fido_log_debug("%s: cbor_decode_pubkey", __func__);
-		goto fail;
+	if (cbor_read_pubkey(buf, len, &attcred->type,
+	    &attcred->pubkey) < 0) {
+		fido_log_debug("%s: cbor_read_pubkey", __func__);
+		return (-1);
 	}
 
 	if (attcred->type != cose_alg) {
 		fido_log_debug("%s: cose_alg mismatch (%d != %d)", __func__,
 		    attcred->type, cose_alg);
-		goto fail;
+		return (-1);
 	}
 
-	*buf += cbor.read;
-	*len -= cbor.read;
-
-	ok = 0;
-fail:
-	if (item != NULL)
-		cbor_decref(&item);
-
-	return (ok);
+	return (0);
 }
 
 static int
@@ -1171,7 +2503,7 @@ decode_attobj(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 
 	ok = 0;
 fail:
-	free(name);
+	fido_free(name);
 
 	return (ok);
 }
@@ -1233,11 +2565,16 @@ decode_cred_extension(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 		}
 		authdata_ext->mask |= FIDO_EXT_MINPINLEN;
 		authdata_ext->minpinlen = cbor_get_uint8(val);
+	} else if (strcmp(type, "hmac-secret-mc") == 0) {
+		if (fido_blob_decode(val, &authdata_ext->hmac_secret_enc) < 0) {
+			fido_log_debug("%s: fido_blob_decode", __func__);
+			goto out;
+		}
 	}
 
 	ok = 0;
 out:
-	free(type);
+	fido_free(type);
 
 	return (ok);
 }
@@ -1250,11 +2587,12 @@ decode_cred_extensions(const unsigned char **buf, size_t *len,
 	struct cbor_load_result	 cbor;
 	int			 ok = -1;
 
+	fido_blob_reset(&authdata_ext->hmac_secret_enc);
 	memset(authdata_ext, 0, sizeof(*authdata_ext));
 
 	fido_log_xxd(*buf, *len, "%s", __func__);
 
-	if ((item = cbor_load(*buf, *len, &cbor)) == NULL) {
+	if ((item = cbor_load_ctap(*buf, *len, &cbor)) == NULL) {
 		fido_log_debug("%s: cbor_load", __func__);
 		goto fail;
 	}
@@ -1307,7 +2645,7 @@ decode_assert_extension(const cbor_item_t *key, const cbor_item_t *val,
 
 	ok = 0;
 out:
-	free(type);
+	fido_free(type);
 
 	return (ok);
 }
@@ -1322,7 +2660,7 @@ decode_assert_extensions(const unsigned char **buf, size_t *len,
 
 	fido_log_xxd(*buf, *len, "%s", __func__);
 
-	if ((item = cbor_load(*buf, *len, &cbor)) == NULL) {
+	if ((item = cbor_load_ctap(*buf, *len, &cbor)) == NULL) {
 		fido_log_debug("%s: cbor_load", __func__);
 		goto fail;
 	}
@@ -1350,9 +2688,7 @@ cbor_decode_cred_authdata(const cbor_item_t *item, int cose_alg,
     fido_blob_t *authdata_cbor, fido_authdata_t *authdata,
     fido_attcred_t *attcred, fido_cred_ext_t *authdata_ext)
 {
-	const unsigned char	*buf = NULL;
-	size_t			 len;
-	size_t			 alloc_len;
+	fido_blob_t raw;
 
 	if (cbor_isa_bytestring(item) == false ||
 	    cbor_bytestring_is_definite(item) == false) {
@@ -1360,24 +2696,51 @@ cbor_decode_cred_authdata(const cbor_item_t *item, int cose_alg,
 		return (-1);
 	}
 
-	if (authdata_cbor->ptr != NULL ||
-	    (authdata_cbor->len = cbor_serialize_alloc(item,
-	    &authdata_cbor->ptr, &alloc_len)) == 0) {
-		fido_log_debug("%s: cbor_serialize_alloc", __func__);
+	memset(&raw, 0, sizeof(raw));
+	raw.ptr = cbor_bytestring_handle(item);
+	raw.len = cbor_bytestring_length(item);
+
+	if (cbor_wrap_bytestring(&raw, authdata_cbor) < 0) {
+		fido_log_debug("%s: cbor_wrap_bytestring", __func__);
 		return (-1);
 	}
 
-	buf = cbor_bytestring_handle(item);
-	len = cbor_bytestring_length(item);
-	fido_log_xxd(buf, len, "%s", __func__);
+	return (cbor_decode_cred_authdata_raw(&raw, cose_alg, authdata,
+	    attcred, authdata_ext));
+}
 
-	if (fido_buf_read(&buf, &len, authdata, sizeof(*authdata)) < 0) {
+/*
+ * The fixed header of authenticator data: rpIdHash, flags and signCount.
+ * Raw authenticator data is parsed in place; only the extensions that
+ * may follow are cbor.
+ */
+static int
+decode_authdata_hdr(const unsigned char **buf, size_t *len,
+    fido_authdata_t *authdata)
+{
+	if (fido_buf_read(buf, len, authdata, sizeof(*authdata)) < 0) {
 		fido_log_debug("%s: fido_buf_read", __func__);
 		return (-1);
 	}
 
 	authdata->sigcount = be32toh(authdata->sigcount);
 
+	return (0);
+}
+
+int
+cbor_decode_cred_authdata_raw(const fido_blob_t *authdata_raw, int cose_alg,
+    fido_authdata_t *authdata, fido_attcred_t *attcred,
+    fido_cred_ext_t *authdata_ext)
+{
+	const unsigned char	*buf = authdata_raw->ptr;
+	size_t			 len = authdata_raw->len;
+
+	fido_log_xxd(buf, len, "%s", __func__);
+
+	if (decode_authdata_hdr(&buf, &len, authdata) < 0)
+		return (-1);
+
 	if (attcred != NULL) {
 		if ((authdata->flags & CTAP_AUTHDATA_ATT_CRED) == 0 ||
 		    decode_attcred(&buf, &len, cose_alg, attcred) < 0)
@@ -1396,37 +2759,16 @@ cbor_decode_cred_authdata(const cbor_item_t *item, int cose_alg,
 }
 
 int
-cbor_decode_assert_authdata(const cbor_item_t *item, fido_blob_t *authdata_cbor,
+cbor_decode_assert_authdata_raw(const fido_blob_t *authdata_raw,
     fido_authdata_t *authdata, fido_assert_extattr_t *authdata_ext)
 {
-	const unsigned char	*buf = NULL;
-	size_t			 len;
-	size_t			 alloc_len;
-
-	if (cbor_isa_bytestring(item) == false ||
-	    cbor_bytestring_is_definite(item) == false) {
-		fido_log_debug("%s: cbor type", __func__);
-		return (-1);
-	}
-
-	if (authdata_cbor->ptr != NULL ||
-	    (authdata_cbor->len = cbor_serialize_alloc(item,
-	    &authdata_cbor->ptr, &alloc_len)) == 0) {
-		fido_log_debug("%s: cbor_serialize_alloc", __func__);
-		return (-1);
-	}
-
-	buf = cbor_bytestring_handle(item);
-	len = cbor_bytestring_length(item);
+	const unsigned char	*buf = authdata_raw->ptr;
+	size_t			 len = authdata_raw->len;
 
 	fido_log_debug("%s: buf=%p, len=%zu", __func__, (const void *)buf, len);
 
-	if (fido_buf_read(&buf, &len, authdata, sizeof(*authdata)) < 0) {
-		fido_log_debug("%s: fido_buf_read", __func__);
+	if (decode_authdata_hdr(&buf, &len, authdata) < 0)
 		return (-1);
-	}
-
-	authdata->sigcount = be32toh(authdata->sigcount);
 
 	if ((authdata->flags & CTAP_AUTHDATA_EXT_DATA) != 0) {
 		if (decode_assert_extensions(&buf, &len, authdata_ext) < 0) {
@@ -1441,6 +2783,53 @@ cbor_decode_assert_authdata(const cbor_item_t *item, fido_blob_t *authdata_cbor,
 	return (FIDO_OK);
 }
 
+int
+cbor_wrap_bytestring(const fido_blob_t *raw, fido_blob_t *out)
+{
+	unsigned char	hdr[9]; /* major type + 64-bit length */
+	size_t		hdr_len;
+
+	if (!fido_blob_is_empty(out) || fido_blob_is_empty(raw) ||
+	    (hdr_len = cbor_encode_bytestring_start(raw->len, hdr,
+	    sizeof(hdr))) == 0 || SIZE_MAX - hdr_len < raw->len) {
+		fido_log_debug("%s: cbor_encode_bytestring_start", __func__);
+		return (-1);
+	}
+
+	/* reuses the buffer of a cleared 'out' */
+	if (fido_blob_reserve(out, hdr_len + raw->len) < 0 ||
+	    fido_blob_append(out, hdr, hdr_len) < 0 ||
+	    fido_blob_append(out, raw->ptr, raw->len) < 0) {
+		fido_log_debug("%s: fido_blob_append", __func__);
+		fido_blob_reset(out);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * Locate the contents of the byte string encoded in 'ptr' without
+ * building a libcbor item; nothing is copied.
+ */
+int
+cbor_unwrap_bytestring(const unsigned char *ptr, size_t len,
+    const unsigned char **raw_ptr, size_t *raw_len)
+{
+	struct cbor_reader r;
+
+	r.ptr = ptr;
+	r.len = len;
+
+	if (cbor_reader_string(&r, CBOR_TYPE_BYTESTRING, raw_ptr,
+	    raw_len) < 0) {
+		fido_log_debug("%s: cbor_reader_string", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
 static int
 decode_x5c(const cbor_item_t *item, void *arg)
 {
@@ -1460,7 +2849,7 @@ decode_x5c(const cbor_item_t *item, void *arg)
 		return (-1);
 	}
 
-	if ((list_ptr = recallocarray(x5c->ptr, x5c->len,
+	if ((list_ptr = fido_recallocarray(x5c->ptr, x5c->len,
 	    x5c->len + 1, sizeof(x5c_blob))) == NULL) {
 		fido_blob_reset(&x5c_blob);
 		return (-1);
@@ -1507,9 +2896,7 @@ decode_attstmt_entry(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 			goto out;
 		}
 		attstmt->alg = -(int)cbor_get_int(val) - 1;
-		if (attstmt->alg != COSE_ES256 && attstmt->alg != COSE_ES384 &&
-		    attstmt->alg != COSE_RS256 && attstmt->alg != COSE_EDDSA &&
-		    attstmt->alg != COSE_RS1) {
+		if (!fido_cose_alg_enabled(attstmt->alg)) {
 			fido_log_debug("%s: unsupported attstmt->alg=%d",
 			    __func__, attstmt->alg);
 			goto out;
@@ -1538,7 +2925,7 @@ decode_attstmt_entry(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 
 	ok = 0;
 out:
-	free(name);
+	fido_free(name);
 
 	return (ok);
 }
@@ -1599,7 +2986,7 @@ decode_cred_id_entry(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 
 	ok = 0;
 out:
-	free(name);
+	fido_free(name);
 
 	return (ok);
 }
@@ -1654,7 +3041,7 @@ decode_user_entry(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 
 	ok = 0;
 out:
-	free(name);
+	fido_free(name);
 
 	return (ok);
 }
@@ -1700,7 +3087,7 @@ decode_rp_entity_entry(const cbor_item_t *key, const cbor_item_t *val,
 
 	ok = 0;
 out:
-	free(name);
+	fido_free(name);
 
 	return (ok);
 }
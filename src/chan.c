@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "fido.h"
+
+/*
+ * Extra CTAPHID channels on an open HID device. fido_dev_open_channel()
+ * gives another fido_dev_t a channel of its own on the device's handle;
+ * the device and its channels then share the handle, and may be used
+ * from different threads. One thread at a time reads from the handle:
+ * a report carrying another channel's id is queued for that channel,
+ * which takes it from its queue before reading from the handle itself.
+ * Reports of other ids are returned to the reader, which discards them
+ * as before. Writes, one report each, are serialised.
+ *
+ * Whether the device serves more than one channel at a time is up to
+ * it; most answer requests on other channels with CTAP1_ERR_CHANNEL_BUSY
+ * while a transaction is pending.
+ */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define chan_lock_try(p) \
+	(_InterlockedExchange((volatile long *)(p), 1) == 0)
+#define chan_unlock(p)	_InterlockedExchange((volatile long *)(p), 0)
+#else
+#define chan_lock_try(p) \
+	(__atomic_exchange_n((p), 1, __ATOMIC_ACQUIRE) == 0)
+#define chan_unlock(p)	__atomic_store_n((p), 0, __ATOMIC_RELEASE)
+#endif
+
+#define CHAN_MAX	8	/* channels per handle, the device's included */
+#define CHAN_QLEN	64	/* reports queued per channel */
+
+struct chan_report {
+	struct chan_report	*next;
+	size_t			 len;
+	unsigned char		 body[CTAP_MAX_REPORT_LEN];
+};
+
+struct chan_slot {
+	const fido_dev_t	*dev;   /* NULL if free */
+	uint32_t		 cid;   /* CTAP_CID_BROADCAST while opening */
+	struct chan_report	*head;
+	struct chan_report	*tail;
+	size_t			 len;
+};
+
+struct fido_chan {
+	int			 rlock; /* reading from the handle */
+	int			 wlock; /* writing to the handle */
+	int			 qlock; /* slots and queues */
+	struct chan_slot	 slot[CHAN_MAX]; /* [0]: the handle's owner */
+};
+
+static void
+chan_qlock(struct fido_chan *c)
+{
+	while (!chan_lock_try(&c->qlock))
+		continue;
+}
+
+static struct chan_slot *
+chan_slot(struct fido_chan *c, const fido_dev_t *dev)
+{
+	for (size_t i = 0; i < CHAN_MAX; i++)
+		if (c->slot[i].dev == dev)
+			return (&c->slot[i]);
+
+	return (NULL);
+}
+
+static void
+chan_slot_flush(struct chan_slot *s)
+{
+	struct chan_report *r;
+
+	while ((r = s->head) != NULL) {
+		s->head = r->next;
+		fido_freezero(r, sizeof(*r));
+	}
+
+	s->tail = NULL;
+	s->len = 0;
+}
+
+static bool
+chan_busy(const struct fido_chan *c)
+{
+	for (size_t i = 1; i < CHAN_MAX; i++)
+		if (c->slot[i].dev != NULL)
+			return (true);
+
+	return (false);
+}
+
+int
+fido_chan_attach(fido_dev_t *dev, fido_dev_t *ch)
+{
+	struct fido_chan	*c;
+	struct chan_slot	*s;
+
+	if ((c = dev->chan) == NULL) {
+		if ((c = fido_calloc(1, sizeof(*c))) == NULL) {
+			fido_log_debug("%s: fido_calloc", __func__);
+			return (FIDO_ERR_INTERNAL);
+		}
+		c->slot[0].dev = dev;
+		c->slot[0].cid = dev->cid;
+		dev->chan = c;
+	}
+
+	chan_qlock(c);
+	if ((s = chan_slot(c, NULL)) != NULL) {
+		s->dev = ch;
+		s->cid = CTAP_CID_BROADCAST;
+	}
+	chan_unlock(&c->qlock);
+
+	if (s == NULL) {
+		fido_log_debug("%s: %d channels", __func__, CHAN_MAX);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	ch->io = dev->io;
+	ch->io_own = dev->io_own;
+	ch->io_handle = dev->io_handle;
+	ch->rx_len = dev->rx_len;
+	ch->tx_len = dev->tx_len;
+	ch->chan = c;
+
+	return (FIDO_OK);
+}
+
+/* the channel id of 'dev' is known */
+void
+fido_chan_set_cid(fido_dev_t *dev)
+{
+	struct fido_chan	*c = dev->chan;
+	struct chan_slot	*s;
+
+	chan_qlock(c);
+	if ((s = chan_slot(c, dev)) != NULL)
+		s->cid = dev->cid;
+	chan_unlock(&c->qlock);
+}
+
+/*
+ * Returns 1 if 'dev' owned the handle, which may now be closed, 0 if it
+ * shared it, and -1 if 'dev' owns a handle still shared by channels.
+ */
+int
+fido_chan_detach(fido_dev_t *dev)
+{
+	struct fido_chan	*c = dev->chan;
+	struct chan_slot	*s;
+	bool			 owner;
+
+	chan_qlock(c);
+	if ((owner = (c->slot[0].dev == dev)) && chan_busy(c)) {
+		chan_unlock(&c->qlock);
+		fido_log_debug("%s: channels open", __func__);
+		return (-1);
+	}
+	if ((s = chan_slot(c, dev)) != NULL) {
+		chan_slot_flush(s);
+		s->dev = NULL;
+	}
+	chan_unlock(&c->qlock);
+
+	dev->chan = NULL;
+	if (owner)
+		fido_free(c);
+
+	return (owner);
+}
+
+/* queue a report read by 'dev' for the channel it belongs to, if any */
+static bool
+chan_route(struct fido_chan *c, const fido_dev_t *dev,
+    const unsigned char *ptr, size_t len)
+{
+	struct chan_slot	*s = NULL;
+	struct chan_report	*r;
+	uint32_t		 cid;
+
+	memcpy(&cid, ptr, sizeof(cid));
+	if (cid == dev->cid || len > sizeof(r->body))
+		return (false);
+
+	chan_qlock(c);
+	for (size_t i = 0; i < CHAN_MAX; i++)
+		if (c->slot[i].dev != NULL && c->slot[i].dev != dev &&
+		    c->slot[i].cid == cid) {
+			s = &c->slot[i];
+			break;
+		}
+	if (s == NULL) {
+		chan_unlock(&c->qlock);
+		return (false);
+	}
+	if (s->len == CHAN_QLEN || (r = fido_calloc(1, sizeof(*r))) == NULL) {
+		chan_unlock(&c->qlock);
+		fido_log_debug("%s: cid=0x%08x, dropped", __func__, cid);
+		return (true);
+	}
+	memcpy(r->body, ptr, len);
+	r->len = len;
+	if (s->tail != NULL)
+		s->tail->next = r;
+	else
+		s->head = r;
+	s->tail = r;
+	s->len++;
+	chan_unlock(&c->qlock);
+
+	return (true);
+}
+
+/* a report queued for 'dev'; returns its length, or 0 */
+static int
+chan_dequeue(struct fido_chan *c, const fido_dev_t *dev, unsigned char *ptr,
+    size_t len)
+{
+	struct chan_slot	*s;
+	struct chan_report	*r = NULL;
+	int			 n = 0;
+
+	chan_qlock(c);
+	if ((s = chan_slot(c, dev)) != NULL && (r = s->head) != NULL) {
+		if ((s->head = r->next) == NULL)
+			s->tail = NULL;
+		s->len--;
+	}
+	chan_unlock(&c->qlock);
+
+	if (r != NULL) {
+		if (r->len < len)
+			len = r->len;
+		memcpy(ptr, r->body, len);
+		n = (int)len;
+		fido_freezero(r, sizeof(*r));
+	}
+
+	return (n);
+}
+
+bool
+fido_chan_pending(const fido_dev_t *dev)
+{
+	struct fido_chan	*c = dev->chan;
+	struct chan_slot	*s;
+	bool			 pending;
+
+	chan_qlock(c);
+	pending = (s = chan_slot(c, dev)) != NULL && s->head != NULL;
+	chan_unlock(&c->qlock);
+
+	return (pending);
+}
+
+int
+fido_chan_read(fido_dev_t *dev, unsigned char *ptr, size_t len, int ms)
+{
+	struct fido_chan	*c = dev->chan;
+	fido_deadline_t		 dl;
+	bool			 routed;
+	int			 n;
+
+	if (fido_time_deadline(&dl, ms, NULL) != 0)
+		return (-1);
+
+	for (;;) {
+		routed = false;
+		if ((n = chan_dequeue(c, dev, ptr, len)) != 0)
+			return (n);
+		if (fido_time_wait(&dl, &ms) != 0)
+			return (-1);
+		if (!chan_lock_try(&c->rlock)) {
+			/* another thread is reading; wait for it */
+			if (ms == 0 || fido_time_sleep(1, &ms) != 0)
+				return (-1);
+			continue;
+		}
+		/* queued while the lock was being taken? */
+		if ((n = chan_dequeue(c, dev, ptr, len)) == 0) {
+			n = dev->io.read(dev->io_handle, ptr, len, ms);
+			routed = n > 0 && chan_route(c, dev, ptr, (size_t)n);
+		}
+		chan_unlock(&c->rlock);
+		if (!routed)
+			return (n);
+	}
+}
+
+int
+fido_chan_write(fido_dev_t *dev, const unsigned char *ptr, size_t len)
+{
+	struct fido_chan	*c = dev->chan;
+	int			 n;
+
+	while (!chan_lock_try(&c->wlock))
+		continue;
+	n = dev->io.write(dev->io_handle, ptr, len);
+	chan_unlock(&c->wlock);
+
+	return (n);
+}
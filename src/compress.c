@@ -9,36 +9,85 @@
 #include "fido.h"
 
 #define BOUND (1024UL * 1024UL)
+#define COMPRESS_CHUNK 4096
 
-/* zlib inflate (raw + headers) */
+/* look up the preset dictionary 'zs' asks for by its adler32 */
 static int
-rfc1950_inflate(fido_blob_t *out, const fido_blob_t *in, size_t origsiz)
+inflate_dict(z_stream *zs, const fido_blob_array_t *dict)
 {
-	u_long ilen, olen;
-	int z;
+	const fido_blob_t *d;
 
+	for (size_t i = 0; dict != NULL && i < dict->len; i++) {
+		d = &dict->ptr[i];
+		if (d->len == 0 || d->len > UINT_MAX ||
+		    adler32(adler32(0L, Z_NULL, 0), d->ptr,
+		    (u_int)d->len) != zs->adler)
+			continue;
+		if (inflateSetDictionary(zs, d->ptr, (u_int)d->len) != Z_OK) {
+			fido_log_debug("%s: inflateSetDictionary", __func__);
+			return -1;
+		}
+		return 0;
+	}
+	fido_log_debug("%s: no dictionary 0x%08lx", __func__,
+	    (u_long)zs->adler);
+
+	return -1;
+}
+
+/* zlib inflate (raw + headers), with a preset dictionary from 'dict' */
+static int
+rfc1950_inflate(fido_blob_t *out, const fido_blob_t *in, size_t origsiz,
+    const fido_blob_array_t *dict)
+{
+	z_stream zs;
+	u_int ilen, olen;
+	int r, z;
+
+	memset(&zs, 0, sizeof(zs));
 	memset(out, 0, sizeof(*out));
 
-	if (in->len > ULONG_MAX || (ilen = (u_long)in->len) > BOUND ||
-	    origsiz > ULONG_MAX || (olen = (u_long)origsiz) > BOUND) {
+	if (in->len > UINT_MAX || (ilen = (u_int)in->len) > BOUND ||
+	    origsiz > UINT_MAX || (olen = (u_int)origsiz) > BOUND) {
 		fido_log_debug("%s: in->len=%zu, origsiz=%zu", __func__,
 		    in->len, origsiz);
 		return FIDO_ERR_INVALID_ARGUMENT;
 	}
+	if ((z = inflateInit(&zs)) != Z_OK) {
+		fido_log_debug("%s: inflateInit: %d", __func__, z);
+		return FIDO_ERR_COMPRESS;
+	}
 
-	if ((out->ptr = calloc(1, olen)) == NULL)
-		return FIDO_ERR_INTERNAL;
+	if ((out->ptr = fido_calloc(1, olen)) == NULL) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
 	out->len = olen;
+	zs.next_in = in->ptr;
+	zs.avail_in = ilen;
+	zs.next_out = out->ptr;
+	zs.avail_out = olen;
 
-	if ((z = uncompress(out->ptr, &olen, in->ptr, ilen)) != Z_OK ||
-	    olen > SIZE_MAX || olen != out->len) {
-		fido_log_debug("%s: uncompress: %d, olen=%lu, out->len=%zu",
-		    __func__, z, olen, out->len);
-		fido_blob_reset(out);
-		return FIDO_ERR_COMPRESS;
+	if ((z = inflate(&zs, Z_FINISH)) == Z_NEED_DICT &&
+	    inflate_dict(&zs, dict) == 0)
+		z = inflate(&zs, Z_FINISH);
+	if (z != Z_STREAM_END || zs.avail_out != 0) {
+		fido_log_debug("%s: inflate: %d, avail_out=%u", __func__, z,
+		    zs.avail_out);
+		r = FIDO_ERR_COMPRESS;
+		goto fail;
 	}
 
-	return FIDO_OK;
+	r = FIDO_OK;
+fail:
+	if ((z = inflateEnd(&zs)) != Z_OK) {
+		fido_log_debug("%s: inflateEnd: %d", __func__, z);
+		r = FIDO_ERR_COMPRESS;
+	}
+	if (r != FIDO_OK)
+		fido_blob_reset(out);
+
+	return r;
 }
 
 /* raw inflate */
@@ -63,7 +112,7 @@ rfc1951_inflate(fido_blob_t *out, const fido_blob_t *in, size_t origsiz)
 		return FIDO_ERR_COMPRESS;
 	}
 
-	if ((out->ptr = calloc(1, olen)) == NULL) {
+	if ((out->ptr = fido_calloc(1, olen)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
@@ -96,73 +145,118 @@ fail:
 	return r;
 }
 
-/* raw deflate */
-static int
-rfc1951_deflate(fido_blob_t *out, const fido_blob_t *in)
+/*
+ * Deflate, handing the output to 'sink' at most COMPRESS_CHUNK bytes at a
+ * time, so that no buffer for the whole of it is needed. A 'level' of 0
+ * and a 'strategy' of 0 are zlib's defaults. The output is raw (RFC1951)
+ * unless a preset dictionary is given, in which case it is wrapped in a
+ * zlib header (RFC1950) naming the dictionary by its adler32.
+ */
+int
+fido_compress_stream(const fido_blob_t *in, int level, int strategy,
+    const fido_blob_t *dict, int (*sink)(void *, const u_char *, size_t),
+    void *arg)
 {
 	z_stream zs;
-	u_int ilen, olen;
+	u_char *buf;
+	u_int ilen;
+	size_t n;
 	int r, z;
 
 	memset(&zs, 0, sizeof(zs));
-	memset(out, 0, sizeof(*out));
 
 	if (in->len > UINT_MAX || (ilen = (u_int)in->len) > BOUND) {
 		fido_log_debug("%s: in->len=%zu", __func__, in->len);
 		return FIDO_ERR_INVALID_ARGUMENT;
 	}
-	if ((z = deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
-	    -MAX_WBITS, 8, Z_DEFAULT_STRATEGY)) != Z_OK) {
+	if (level < 0 || level > Z_BEST_COMPRESSION || strategy < 0 ||
+	    strategy > Z_FIXED || (dict != NULL && (dict->len == 0 ||
+	    dict->len > UINT_MAX))) {
+		fido_log_debug("%s: level=%d, strategy=%d, dict=%p", __func__,
+		    level, strategy, (const void *)dict);
+		return FIDO_ERR_INVALID_ARGUMENT;
+	}
+	if ((buf = fido_malloc(COMPRESS_CHUNK)) == NULL) {
+		fido_log_debug("%s: fido_malloc", __func__);
+		return FIDO_ERR_INTERNAL;
+	}
+	if ((z = deflateInit2(&zs, level ? level : Z_DEFAULT_COMPRESSION,
+	    Z_DEFLATED, dict != NULL ? MAX_WBITS : -MAX_WBITS, 8,
+	    strategy)) != Z_OK) {
 		fido_log_debug("%s: deflateInit2: %d", __func__, z);
+		fido_free(buf);
 		return FIDO_ERR_COMPRESS;
 	}
-
-	olen = BOUND;
-	if ((out->ptr = calloc(1, olen)) == NULL) {
-		r = FIDO_ERR_INTERNAL;
+	if (dict != NULL && (z = deflateSetDictionary(&zs, dict->ptr,
+	    (u_int)dict->len)) != Z_OK) {
+		fido_log_debug("%s: deflateSetDictionary: %d", __func__, z);
+		r = FIDO_ERR_COMPRESS;
 		goto fail;
 	}
-	out->len = olen;
+
 	zs.next_in = in->ptr;
 	zs.avail_in = ilen;
-	zs.next_out = out->ptr;
-	zs.avail_out = olen;
 
-	if ((z = deflate(&zs, Z_FINISH)) != Z_STREAM_END) {
-		fido_log_debug("%s: inflate: %d", __func__, z);
-		r = FIDO_ERR_COMPRESS;
-		goto fail;
-	}
-	if (zs.avail_out >= out->len) {
-		fido_log_debug("%s: %u > %zu", __func__, zs.avail_out,
-		    out->len);
-		r = FIDO_ERR_COMPRESS;
-		goto fail;
-	}
-	out->len -= zs.avail_out;
+	do {
+		zs.next_out = buf;
+		zs.avail_out = COMPRESS_CHUNK;
+		if ((z = deflate(&zs, Z_FINISH)) != Z_OK && z != Z_STREAM_END) {
+			fido_log_debug("%s: deflate: %d", __func__, z);
+			r = FIDO_ERR_COMPRESS;
+			goto fail;
+		}
+		if ((n = COMPRESS_CHUNK - zs.avail_out) > 0 &&
+		    sink(arg, buf, n) < 0) {
+			fido_log_debug("%s: sink", __func__);
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+	} while (z != Z_STREAM_END);
 
 	r = FIDO_OK;
 fail:
-	if ((z = deflateEnd(&zs)) != Z_OK) {
+	if ((z = deflateEnd(&zs)) != Z_OK && r == FIDO_OK) {
 		fido_log_debug("%s: deflateEnd: %d", __func__, z);
 		r = FIDO_ERR_COMPRESS;
 	}
-	if (r != FIDO_OK)
-		fido_blob_reset(out);
+	fido_freezero(buf, COMPRESS_CHUNK);
 
 	return r;
 }
 
+static int
+compress_append(void *arg, const u_char *ptr, size_t len)
+{
+	return fido_blob_append(arg, ptr, len);
+}
+
 int
 fido_compress(fido_blob_t *out, const fido_blob_t *in)
 {
-	return rfc1951_deflate(out, in);
+	int r;
+
+	memset(out, 0, sizeof(*out));
+
+	if ((r = fido_compress_stream(in, 0, 0, NULL, compress_append,
+	    out)) != FIDO_OK)
+		fido_blob_reset(out);
+
+	return r;
 }
 
 int
 fido_uncompress(fido_blob_t *out, const fido_blob_t *in, size_t origsiz)
 {
-	if (rfc1950_inflate(out, in, origsiz) == FIDO_OK)
-		return FIDO_OK; /* backwards compat with libfido2 < 1.11 */
+	return fido_uncompress_dict(out, in, origsiz, NULL);
+}
+
+/* as fido_uncompress(), looking up preset dictionaries in 'dict' */
+int
+fido_uncompress_dict(fido_blob_t *out, const fido_blob_t *in, size_t origsiz,
+    const fido_blob_array_t *dict)
+{
+	/* zlib headers: libfido2 < 1.11, or a preset dictionary */
+	if (rfc1950_inflate(out, in, origsiz, dict) == FIDO_OK)
+		return FIDO_OK;
 	return rfc1951_inflate(out, in, origsiz);
 }
@@ -29,7 +29,7 @@ config_prepare_hmac(uint8_t subcmd, const cbor_item_t *item, fido_blob_t *hmac)
 			return -1;
 		}
 	}
-	if ((hmac->ptr = malloc(cbor_len + sizeof(prefix))) == NULL) {
+	if ((hmac->ptr = fido_malloc(cbor_len + sizeof(prefix))) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		return -1;
 	}
@@ -54,6 +54,13 @@ config_tx(fido_dev_t *dev, uint8_t subcmd, cbor_item_t **paramv, size_t paramc,
 	memset(&hmac, 0, sizeof(hmac));
 	memset(&argv, 0, sizeof(argv));
 
+	if ((r = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		goto fail;
+	}
+
+	r = FIDO_ERR_INTERNAL;
+
 	/* subCommand */
 	if ((argv[0] = cbor_build_uint8(subcmd)) == NULL) {
 		fido_log_debug("%s: cbor encode", __func__);
@@ -98,8 +105,8 @@ fail:
 	cbor_vector_free(argv, nitems(argv));
 	es256_pk_free(&pk);
 	fido_blob_free(&ecdh);
-	free(f.ptr);
-	free(hmac.ptr);
+	fido_free(f.ptr);
+	fido_free(hmac.ptr);
 
 	return r;
 }
@@ -119,9 +126,14 @@ config_enable_entattest_wait(fido_dev_t *dev, const char *pin, int *ms)
 int
 fido_dev_enable_entattest(fido_dev_t *dev, const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
 
-	return (config_enable_entattest_wait(dev, pin, &ms));
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = config_enable_entattest_wait(dev, pin, &ms);
+
+	return (fido_trace_end(&span, r));
 }
 
 static int
@@ -139,9 +151,14 @@ config_toggle_always_uv_wait(fido_dev_t *dev, const char *pin, int *ms)
 int
 fido_dev_toggle_always_uv(fido_dev_t *dev, const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
 
-	return config_toggle_always_uv_wait(dev, pin, &ms);
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = config_toggle_always_uv_wait(dev, pin, &ms);
+
+	return (fido_trace_end(&span, r));
 }
 
 static int
@@ -157,6 +174,22 @@ config_pin_minlen_tx(fido_dev_t *dev, size_t len, bool force,
 		r = FIDO_ERR_INVALID_ARGUMENT;
 		goto fail;
 	}
+	/* the list replaces the previous one, and cannot be split */
+	if (rpid != NULL) {
+		if ((r = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK) {
+			fido_log_debug("%s: fido_dev_get_deferred_info",
+			    __func__);
+			goto fail;
+		}
+		if (dev->info != NULL && dev->info->maxrpid_minlen != 0 &&
+		    rpid->len > dev->info->maxrpid_minlen) {
+			fido_log_debug("%s: %zu rpids, max %llu", __func__,
+			    rpid->len,
+			    (unsigned long long)dev->info->maxrpid_minlen);
+			r = FIDO_ERR_INVALID_ARGUMENT;
+			goto fail;
+		}
+	}
 	if (len && (argv[0] = cbor_build_uint8((uint8_t)len)) == NULL) {
 		fido_log_debug("%s: cbor_encode_uint8", __func__);
 		r = FIDO_ERR_INTERNAL;
@@ -200,25 +233,36 @@ config_pin_minlen(fido_dev_t *dev, size_t len, bool force,
 int
 fido_dev_set_pin_minlen(fido_dev_t *dev, size_t len, const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = config_pin_minlen(dev, len, false, NULL, pin, &ms);
 
-	return config_pin_minlen(dev, len, false, NULL, pin, &ms);
+	return (fido_trace_end(&span, r));
 }
 
 int
 fido_dev_force_pin_change(fido_dev_t *dev, const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = config_pin_minlen(dev, 0, true, NULL, pin, &ms);
 
-	return config_pin_minlen(dev, 0, true, NULL, pin, &ms);
+	return (fido_trace_end(&span, r));
 }
 
 int
 fido_dev_set_pin_minlen_rpid(fido_dev_t *dev, const char * const *rpid,
     size_t n, const char *pin)
 {
+	fido_trace_t span;
 	fido_str_array_t sa;
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 	int r;
 
 	memset(&sa, 0, sizeof(sa));
@@ -227,7 +271,9 @@ fido_dev_set_pin_minlen_rpid(fido_dev_t *dev, const char * const *rpid,
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
 	r = config_pin_minlen(dev, 0, false, &sa, pin, &ms);
+	fido_trace_end(&span, r);
 fail:
 	fido_str_array_free(&sa);
 
@@ -15,6 +15,7 @@
 #define FIDO_MAXMSG_CRED	4096
 #endif
 
+#ifndef FIDO_VERIFY_ONLY
 static int
 parse_makecred_reply(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 {
@@ -47,14 +48,36 @@ parse_makecred_reply(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 	}
 }
 
+/* whether the request needs a shared secret with the authenticator */
+static bool
+make_cred_needs_ecdh(const fido_dev_t *dev, const fido_cred_t *cred,
+    const char *pin)
+{
+	return (pin != NULL || (cred->uv == FIDO_OPT_TRUE &&
+	    fido_dev_supports_permissions(dev)) ||
+	    ((cred->ext.mask & FIDO_EXT_HMAC_SECRET) &&
+	    !fido_blob_is_empty(&cred->ext.hmac_salt)));
+}
+
+/* checked before any key agreement, so that no request is sent in vain */
 static int
-fido_dev_make_cred_tx(fido_dev_t *dev, fido_cred_t *cred, const char *pin,
-    int *ms)
+make_cred_check_args(const fido_cred_t *cred)
+{
+	if (fido_blob_is_empty(&cred->cdh) || cred->type == 0) {
+		fido_log_debug("%s: cdh=%p, type=%d", __func__,
+		    (void *)cred->cdh.ptr, cred->type);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	return (FIDO_OK);
+}
+
+static int
+fido_dev_make_cred_tx(fido_dev_t *dev, fido_cred_t *cred, const es256_pk_t *pk,
+    const fido_blob_t *ecdh, const char *pin, int *ms)
 {
 	fido_blob_t	 f;
-	fido_blob_t	*ecdh = NULL;
 	fido_opt_t	 uv = cred->uv;
-	es256_pk_t	*pk = NULL;
 	cbor_item_t	*argv[9];
 	const uint8_t	 cmd = CTAP_CBOR_MAKECRED;
 	int		 r;
@@ -62,34 +85,10 @@ fido_dev_make_cred_tx(fido_dev_t *dev, fido_cred_t *cred, const char *pin,
 	memset(&f, 0, sizeof(f));
 	memset(argv, 0, sizeof(argv));
 
-	if (cred->cdh.ptr == NULL || cred->type == 0) {
-		fido_log_debug("%s: cdh=%p, type=%d", __func__,
-		    (void *)cred->cdh.ptr, cred->type);
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto fail;
-	}
-
-	if ((argv[0] = fido_blob_encode(&cred->cdh)) == NULL ||
-	    (argv[1] = cbor_encode_rp_entity(&cred->rp)) == NULL ||
-	    (argv[2] = cbor_encode_user_entity(&cred->user)) == NULL ||
-	    (argv[3] = cbor_encode_pubkey_param(cred->type)) == NULL) {
-		fido_log_debug("%s: cbor encode", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
-	}
-
-	/* excluded credentials */
-	if (cred->excl.len)
-		if ((argv[4] = cbor_encode_pubkey_list(&cred->excl)) == NULL) {
-			fido_log_debug("%s: cbor_encode_pubkey_list", __func__);
-			r = FIDO_ERR_INTERNAL;
-			goto fail;
-		}
-
 	/* extensions */
 	if (cred->ext.mask)
-		if ((argv[5] = cbor_encode_cred_ext(&cred->ext,
-		    &cred->blob)) == NULL) {
+		if ((argv[5] = cbor_encode_cred_ext(dev, &cred->ext,
+		    &cred->blob, ecdh, pk)) == NULL) {
 			fido_log_debug("%s: cbor_encode_cred_ext", __func__);
 			r = FIDO_ERR_INTERNAL;
 			goto fail;
@@ -98,10 +97,6 @@ fido_dev_make_cred_tx(fido_dev_t *dev, fido_cred_t *cred, const char *pin,
 	/* user verification */
 	if (pin != NULL || (uv == FIDO_OPT_TRUE &&
 	    fido_dev_supports_permissions(dev))) {
-		if ((r = fido_do_ecdh(dev, &pk, &ecdh, ms)) != FIDO_OK) {
-			fido_log_debug("%s: fido_do_ecdh", __func__);
-			goto fail;
-		}
 		if ((r = cbor_add_uv_params(dev, cmd, &cred->cdh, pk, ecdh,
 		    pin, cred->rp.id, &argv[7], &argv[8], ms)) != FIDO_OK) {
 			fido_log_debug("%s: cbor_add_uv_params", __func__);
@@ -110,16 +105,8 @@ fido_dev_make_cred_tx(fido_dev_t *dev, fido_cred_t *cred, const char *pin,
 		uv = FIDO_OPT_OMIT;
 	}
 
-	/* options */
-	if (cred->rk != FIDO_OPT_OMIT || uv != FIDO_OPT_OMIT)
-		if ((argv[6] = cbor_encode_cred_opt(cred->rk, uv)) == NULL) {
-			fido_log_debug("%s: cbor_encode_cred_opt", __func__);
-			r = FIDO_ERR_INTERNAL;
-			goto fail;
-		}
-
 	/* framing and transmission */
-	if (cbor_build_frame(cmd, argv, nitems(argv), &f) < 0 ||
+	if (cbor_build_cred_frame(cred, uv, argv, &f) < 0 ||
 	    fido_tx(dev, CTAP_CMD_CBOR, f.ptr, f.len, ms) < 0) {
 		fido_log_debug("%s: fido_tx", __func__);
 		r = FIDO_ERR_TX;
@@ -128,10 +115,8 @@ fido_dev_make_cred_tx(fido_dev_t *dev, fido_cred_t *cred, const char *pin,
 
 	r = FIDO_OK;
 fail:
-	es256_pk_free(&pk);
-	fido_blob_free(&ecdh);
 	cbor_vector_free(argv, nitems(argv));
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return (r);
 }
@@ -140,17 +125,20 @@ static int
 fido_dev_make_cred_rx(fido_dev_t *dev, fido_cred_t *cred, int *ms)
 {
 	unsigned char	*reply;
+	size_t		 reply_siz;
 	int		 reply_len;
 	int		 r;
 
 	fido_cred_reset_rx(cred);
 
-	if ((reply = malloc(FIDO_MAXMSG_CRED)) == NULL) {
+	if ((reply_siz = fido_dev_msgbuf_len(dev)) < FIDO_MAXMSG_CRED)
+		reply_siz = FIDO_MAXMSG_CRED;
+	if ((reply = fido_malloc(reply_siz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	if ((reply_len = fido_rx(dev, CTAP_CMD_CBOR, reply, FIDO_MAXMSG_CRED,
+	if ((reply_len = fido_rx(dev, CTAP_CMD_CBOR, reply, reply_siz,
 	    ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
@@ -171,7 +159,7 @@ fido_dev_make_cred_rx(fido_dev_t *dev, fido_cred_t *cred, int *ms)
 
 	r = FIDO_OK;
 fail:
-	free(reply);
+	fido_free(reply);
 
 	if (r != FIDO_OK)
 		fido_cred_reset_rx(cred);
@@ -179,60 +167,251 @@ fail:
 	return (r);
 }
 
+/* the hmac-secret-mc output, if any, encrypted with 'ecdh' */
+static int
+decrypt_hmac_secret(const fido_dev_t *dev, fido_cred_t *cred,
+    const fido_blob_t *ecdh)
+{
+	const fido_blob_t *enc = &cred->authdata_ext.hmac_secret_enc;
+
+	if (fido_blob_is_empty(enc))
+		return (0);
+	if (ecdh == NULL || aes256_cbc_dec(dev, ecdh, enc,
+	    &cred->hmac_secret) < 0) {
+		fido_log_debug("%s: aes256_cbc_dec", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
 static int
 fido_dev_make_cred_wait(fido_dev_t *dev, fido_cred_t *cred, const char *pin,
     int *ms)
 {
-	int  r;
+	fido_blob_t	*ecdh = NULL;
+	es256_pk_t	*pk = NULL;
+	int		 r;
 
-	if ((r = fido_dev_make_cred_tx(dev, cred, pin, ms)) != FIDO_OK ||
-	    (r = fido_dev_make_cred_rx(dev, cred, ms)) != FIDO_OK)
+	if ((r = make_cred_check_args(cred)) != FIDO_OK)
 		return (r);
+	if (make_cred_needs_ecdh(dev, cred, pin) &&
+	    (r = fido_do_ecdh(dev, &pk, &ecdh, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_do_ecdh", __func__);
+		goto fail;
+	}
+	if ((r = fido_dev_make_cred_tx(dev, cred, pk, ecdh, pin,
+	    ms)) != FIDO_OK ||
+	    (r = fido_dev_make_cred_rx(dev, cred, ms)) != FIDO_OK)
+		goto fail;
+	if (decrypt_hmac_secret(dev, cred, ecdh) < 0) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
 
-	return (FIDO_OK);
+	r = FIDO_OK;
+fail:
+	es256_pk_free(&pk);
+	fido_blob_free(&ecdh);
+
+	return (r);
 }
 
-int
-fido_dev_make_cred(fido_dev_t *dev, fido_cred_t *cred, const char *pin)
+/*
+ * Exclude lists longer than the authenticator's maxCredCountInList are
+ * screened in batches, each with a silent getAssertion. The request then
+ * carries only the batch holding an excluded credential, so that the
+ * authenticator still refuses it once user presence is collected, or no
+ * exclude list if no batch holds one. Credential ids longer than
+ * maxCredIdLength are left out.
+ */
+static int
+fido_dev_make_cred_batched(fido_dev_t *dev, fido_cred_t *cred,
+    const char *pin, int *ms)
 {
-	int ms = dev->timeout_ms;
+	const fido_blob_array_t	 list = cred->excl;
+	const uint64_t		 maxlen = dev->info->maxcredidlen;
+	const size_t		 max = (size_t)dev->info->maxcredcntlst;
+	fido_blob_t		*batch;
+	size_t			 i = 0, n = 0;
+	int			 r = FIDO_ERR_NO_CREDENTIALS;
+
+	if ((batch = fido_calloc(max, sizeof(*batch))) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	while (i < list.len) {
+		for (n = 0; i < list.len && n < max; i++) {
+			if (maxlen && list.ptr[i].len > maxlen) {
+				fido_log_debug("%s: skipping id %zu, len=%zu",
+				    __func__, i, list.ptr[i].len);
+				continue;
+			}
+			batch[n++] = list.ptr[i];
+		}
+		if (n == 0)
+			break;
+		if ((r = fido_dev_probe_creds(dev, cred->rp.id, &cred->cdh,
+		    batch, n, ms)) != FIDO_ERR_NO_CREDENTIALS)
+			break;
+		n = 0;
+	}
+
+	if (r == FIDO_OK || r == FIDO_ERR_NO_CREDENTIALS) {
+		fido_log_debug("%s: excluding %zu of %zu", __func__, n,
+		    list.len);
+		cred->excl.ptr = batch;
+		cred->excl.len = n;
+		r = fido_dev_make_cred_wait(dev, cred, pin, ms);
+		cred->excl = list;
+	}
+
+	fido_free(batch);
+
+	return (r);
+}
+
+static int
+make_cred(fido_dev_t *dev, fido_cred_t *cred, const char *pin)
+{
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
 
 #ifdef USE_WINHELLO
 	if (dev->flags & FIDO_DEV_WINHELLO)
 		return (fido_winhello_make_cred(dev, cred, pin, ms));
 #endif
+	if ((r = fido_dev_get_deferred_info(dev, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		return (r);
+	}
+
 	if (fido_dev_is_fido2(dev) == false) {
 		if (pin != NULL || cred->rk == FIDO_OPT_TRUE ||
 		    cred->ext.mask != 0)
 			return (FIDO_ERR_UNSUPPORTED_OPTION);
+#ifdef FIDO_NO_U2F
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+#else
 		return (u2f_register(dev, cred, &ms));
+#endif
 	}
 
+	if (dev->info != NULL && dev->info->maxcredcntlst != 0 &&
+	    dev->info->maxcredcntlst <= SIZE_MAX &&
+	    cred->excl.len > dev->info->maxcredcntlst)
+		return (fido_dev_make_cred_batched(dev, cred, pin, &ms));
+
 	return (fido_dev_make_cred_wait(dev, cred, pin, &ms));
 }
 
+int
+fido_dev_make_cred(fido_dev_t *dev, fido_cred_t *cred, const char *pin)
+{
+	fido_trace_t span;
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = make_cred(dev, cred, pin);
+
+	return (fido_trace_end(&span, r));
+}
+
+int
+fido_dev_make_cred_submit(fido_dev_t *dev, fido_cred_t *cred, const char *pin)
+{
+	fido_blob_t	*ecdh = NULL;
+	es256_pk_t	*pk = NULL;
+	int		 ms = fido_time_budget(dev->timeout_ms);
+	int		 r;
+
+#ifdef USE_WINHELLO
+	if (dev->flags & FIDO_DEV_WINHELLO)
+		return (fido_winhello_make_cred_submit(dev, cred, pin, ms));
+#endif
+	fido_dev_async_reset(dev);
+
+	if ((r = fido_dev_get_deferred_info(dev, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		return (r);
+	}
+
+	/* u2f registration is driven by repeated transmissions */
+	if (fido_dev_is_fido2(dev) == false)
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+
+	if ((r = make_cred_check_args(cred)) != FIDO_OK)
+		return (r);
+	if (make_cred_needs_ecdh(dev, cred, pin) &&
+	    (r = fido_do_ecdh(dev, &pk, &ecdh, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_do_ecdh", __func__);
+		goto fail;
+	}
+	if ((r = fido_dev_make_cred_tx(dev, cred, pk, ecdh, pin,
+	    &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_make_cred_tx", __func__);
+		goto fail;
+	}
+
+	dev->async_cmd = CTAP_CBOR_MAKECRED;
+	dev->async_ecdh = ecdh;
+	ecdh = NULL;
+fail:
+	es256_pk_free(&pk);
+	fido_blob_free(&ecdh);
+
+	return (r);
+}
+
+int
+fido_dev_make_cred_complete(fido_dev_t *dev, fido_cred_t *cred)
+{
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+#ifdef USE_WINHELLO
+	if (dev->flags & FIDO_DEV_WINHELLO)
+		return (fido_winhello_make_cred_complete(dev, cred));
+#endif
+	if (dev->async_cmd != CTAP_CBOR_MAKECRED) {
+		fido_log_debug("%s: async_cmd=0x%02x", __func__,
+		    dev->async_cmd);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	if ((r = fido_dev_make_cred_rx(dev, cred, &ms)) == FIDO_OK &&
+	    decrypt_hmac_secret(dev, cred, dev->async_ecdh) < 0)
+		r = FIDO_ERR_INTERNAL;
+	fido_dev_async_reset(dev);
+
+	return (r);
+}
+#endif /* !FIDO_VERIFY_ONLY */
+
 static int
 check_extensions(const fido_cred_ext_t *authdata_ext,
     const fido_cred_ext_t *ext)
 {
-	fido_cred_ext_t	 tmp;
-
 	/* XXX: largeBlobKey is not part of the extensions map */
-	memcpy(&tmp, ext, sizeof(tmp));
-	tmp.mask &= ~FIDO_EXT_LARGEBLOB_KEY;
-
-	return (timingsafe_bcmp(authdata_ext, &tmp, sizeof(*authdata_ext)));
+	return (authdata_ext->mask != (ext->mask & ~FIDO_EXT_LARGEBLOB_KEY) ||
+	    authdata_ext->prot != ext->prot ||
+	    authdata_ext->minpinlen != ext->minpinlen);
 }
 
 int
-fido_check_rp_id(const char *id, const unsigned char *obtained_hash)
+fido_check_rp_id(const char *id, const fido_blob_t *id_hash,
+    const unsigned char *obtained_hash)
 {
 	unsigned char expected_hash[SHA256_DIGEST_LENGTH];
 
+	/* use the cached hash if available */
+	if (id_hash != NULL && id_hash->len == SHA256_DIGEST_LENGTH)
+		return (timingsafe_bcmp(id_hash->ptr, obtained_hash,
+		    SHA256_DIGEST_LENGTH));
+
 	explicit_bzero(expected_hash, sizeof(expected_hash));
 
-	if (SHA256((const unsigned char *)id, strlen(id),
-	    expected_hash) != expected_hash) {
+	if (fido_sha256_buf((const unsigned char *)id, strlen(id),
+	    expected_hash) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		return (-1);
 	}
@@ -252,8 +431,13 @@ get_signed_hash_u2f(fido_blob_t *dgst, const unsigned char *rp_id,
 	EVP_MD_CTX	*ctx = NULL;
 	int		 ok = -1;
 
-	if (dgst->len < SHA256_DIGEST_LENGTH ||
-	    (md = EVP_sha256()) == NULL ||
+	if ((dgst->ptr = fido_calloc(1, SHA256_DIGEST_LENGTH)) == NULL) {
+		fido_log_debug("%s: calloc", __func__);
+		goto fail;
+	}
+	dgst->len = SHA256_DIGEST_LENGTH;
+
+	if ((md = fido_md_sha256()) == NULL ||
 	    (ctx = EVP_MD_CTX_new()) == NULL ||
 	    EVP_DigestInit_ex(ctx, md, NULL) != 1 ||
 	    EVP_DigestUpdate(ctx, &zero, sizeof(zero)) != 1 ||
@@ -267,21 +451,23 @@ get_signed_hash_u2f(fido_blob_t *dgst, const unsigned char *rp_id,
 		fido_log_debug("%s: sha256", __func__);
 		goto fail;
 	}
-	dgst->len = SHA256_DIGEST_LENGTH;
 
 	ok = 0;
 fail:
 	EVP_MD_CTX_free(ctx);
 
+	if (ok < 0)
+		fido_blob_reset(dgst);
+
 	return (ok);
 }
 
 static int
 verify_attstmt(const fido_blob_t *dgst, const fido_attstmt_t *attstmt)
 {
-	BIO		*rawcert = NULL;
 	X509		*cert = NULL;
 	EVP_PKEY	*pkey = NULL;
+	fido_prof_t	 prof;
 	int		 ok = -1;
 
 	if (!attstmt->x5c.len) {
@@ -289,46 +475,46 @@ verify_attstmt(const fido_blob_t *dgst, const fido_attstmt_t *attstmt)
 		return (-1);
 	}
 
-	/* openssl needs ints */
-	if (attstmt->x5c.ptr[0].len > INT_MAX) {
-		fido_log_debug("%s: x5c[0].len=%zu", __func__,
-		    attstmt->x5c.ptr[0].len);
-		return (-1);
-	}
-
 	/* fetch key from x509 */
-	if ((rawcert = BIO_new_mem_buf(attstmt->x5c.ptr[0].ptr,
-	    (int)attstmt->x5c.ptr[0].len)) == NULL ||
-	    (cert = d2i_X509_bio(rawcert, NULL)) == NULL ||
+	if ((cert = fido_x5c_cert(&attstmt->x5c.ptr[0])) == NULL ||
 	    (pkey = X509_get_pubkey(cert)) == NULL) {
 		fido_log_debug("%s: x509 key", __func__);
 		goto fail;
 	}
 
+	fido_prof_begin(&prof, FIDO_PROF_VERIFY_SIG);
 	switch (attstmt->alg) {
 	case COSE_UNSPEC:
 	case COSE_ES256:
 		ok = es256_verify_sig(dgst, pkey, &attstmt->sig);
 		break;
+#ifndef FIDO_NO_ES384
 	case COSE_ES384:
 		ok = es384_verify_sig(dgst, pkey, &attstmt->sig);
 		break;
+#endif
+#ifndef FIDO_NO_RS256
 	case COSE_RS256:
 		ok = rs256_verify_sig(dgst, pkey, &attstmt->sig);
 		break;
+#endif
+#ifndef FIDO_NO_RS1
 	case COSE_RS1:
 		ok = rs1_verify_sig(dgst, pkey, &attstmt->sig);
 		break;
+#endif
+#ifndef FIDO_NO_EDDSA
 	case COSE_EDDSA:
 		ok = eddsa_verify_sig(dgst, pkey, &attstmt->sig);
 		break;
+#endif
 	default:
 		fido_log_debug("%s: unknown alg %d", __func__, attstmt->alg);
 		break;
 	}
+	fido_prof_end(&prof, ok);
 
 fail:
-	BIO_free(rawcert);
 	X509_free(cert);
 	EVP_PKEY_free(pkey);
 
@@ -338,17 +524,20 @@ fail:
 int
 fido_cred_verify(const fido_cred_t *cred)
 {
-	unsigned char	buf[1024]; /* XXX */
 	fido_blob_t	dgst;
 	int		cose_alg;
+	int		fmt;
 	int		r;
 
-	dgst.ptr = buf;
-	dgst.len = sizeof(buf);
+	memset(&dgst, 0, sizeof(dgst));
+	fmt = fido_fmt_id(cred->fmt);
 
-	/* do we have everything we need? */
-	if (cred->cdh.ptr == NULL || cred->authdata_cbor.ptr == NULL ||
-	    cred->attstmt.x5c.ptr == NULL || cred->attstmt.sig.ptr == NULL ||
+	/* do we have everything we need? an apple statement has no sig */
+	if (fido_blob_is_empty(&cred->cdh) ||
+	    fido_blob_is_empty(&cred->authdata_cbor) ||
+	    cred->attstmt.x5c.ptr == NULL ||
+	    (fido_blob_is_empty(&cred->attstmt.sig) &&
+	    fmt != FIDO_FMT_APPLE) ||
 	    cred->fmt == NULL || cred->attcred.id.ptr == NULL ||
 	    cred->rp.id == NULL) {
 		fido_log_debug("%s: cdh=%p, authdata=%p, x5c=%p, sig=%p, "
@@ -361,7 +550,8 @@ fido_cred_verify(const fido_cred_t *cred)
 		goto out;
 	}
 
-	if (fido_check_rp_id(cred->rp.id, cred->authdata.rp_id_hash) != 0) {
+	if (fido_check_rp_id(cred->rp.id, &cred->rp_id_hash,
+	    cred->authdata.rp_id_hash) != 0) {
 		fido_log_debug("%s: fido_check_rp_id", __func__);
 		r = FIDO_ERR_INVALID_PARAM;
 		goto out;
@@ -383,14 +573,16 @@ fido_cred_verify(const fido_cred_t *cred)
 	if ((cose_alg = cred->attstmt.alg) == COSE_UNSPEC)
 		cose_alg = COSE_ES256; /* backwards compat */
 
-	if (!strcmp(cred->fmt, "packed")) {
+	switch (fmt) {
+	case FIDO_FMT_PACKED:
 		if (fido_get_signed_hash(cose_alg, &dgst, &cred->cdh,
-		    &cred->authdata_cbor) < 0) {
+		    &cred->authdata_raw) < 0) {
 			fido_log_debug("%s: fido_get_signed_hash", __func__);
 			r = FIDO_ERR_INTERNAL;
 			goto out;
 		}
-	} else if (!strcmp(cred->fmt, "fido-u2f")) {
+		break;
+	case FIDO_FMT_U2F:
 		if (get_signed_hash_u2f(&dgst, cred->authdata.rp_id_hash,
 		    sizeof(cred->authdata.rp_id_hash), &cred->cdh,
 		    &cred->attcred.id, &cred->attcred.pubkey.es256) < 0) {
@@ -398,15 +590,47 @@ fido_cred_verify(const fido_cred_t *cred)
 			r = FIDO_ERR_INTERNAL;
 			goto out;
 		}
-	} else if (!strcmp(cred->fmt, "tpm")) {
+		break;
+	case FIDO_FMT_TPM:
 		if (fido_get_signed_hash_tpm(&dgst, &cred->cdh,
 		    &cred->authdata_raw, &cred->attstmt, &cred->attcred) < 0) {
 			fido_log_debug("%s: fido_get_signed_hash_tpm", __func__);
 			r = FIDO_ERR_INTERNAL;
 			goto out;
 		}
-	} else {
-		fido_log_debug("%s: unknown fmt %s", __func__, cred->fmt);
+		break;
+	case FIDO_FMT_ANDROID_KEY:
+		if (fido_get_signed_hash(cose_alg, &dgst, &cred->cdh,
+		    &cred->authdata_raw) < 0) {
+			fido_log_debug("%s: fido_get_signed_hash", __func__);
+			r = FIDO_ERR_INTERNAL;
+			goto out;
+		}
+		if (fido_check_android_key(&cred->cdh, &cred->attstmt,
+		    &cred->attcred) < 0) {
+			fido_log_debug("%s: fido_check_android_key", __func__);
+			r = FIDO_ERR_INVALID_PARAM;
+			goto out;
+		}
+		break;
+	case FIDO_FMT_APPLE:
+		/* the nonce is hashed as a packed ES256 signature would be */
+		if (fido_get_signed_hash(COSE_ES256, &dgst, &cred->cdh,
+		    &cred->authdata_raw) < 0) {
+			fido_log_debug("%s: fido_get_signed_hash", __func__);
+			r = FIDO_ERR_INTERNAL;
+			goto out;
+		}
+		if (fido_check_apple(&dgst, &cred->attstmt,
+		    &cred->attcred) < 0) {
+			fido_log_debug("%s: fido_check_apple", __func__);
+			r = FIDO_ERR_INVALID_SIG;
+			goto out;
+		}
+		r = FIDO_OK;
+		goto out;
+	default:
+		fido_log_debug("%s: unsupported fmt %s", __func__, cred->fmt);
 		r = FIDO_ERR_INVALID_ARGUMENT;
 		goto out;
 	}
@@ -419,25 +643,66 @@ fido_cred_verify(const fido_cred_t *cred)
 
 	r = FIDO_OK;
 out:
-	explicit_bzero(buf, sizeof(buf));
+	fido_blob_reset(&dgst);
 
 	return (r);
 }
 
 int
-fido_cred_verify_self(const fido_cred_t *cred)
+fido_cred_verify_chain(const fido_cred_t *cred,
+    const fido_attest_store_t *store)
 {
-	unsigned char	buf[1024]; /* XXX */
-	fido_blob_t	dgst;
-	int		ok = -1;
-	int		r;
+	int r;
 
-	dgst.ptr = buf;
-	dgst.len = sizeof(buf);
+	if (store == NULL) {
+		fido_log_debug("%s: store=NULL", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+	if ((r = fido_cred_verify(cred)) != FIDO_OK)
+		return (r);
+
+	return (fido_attest_verify_x5c(&cred->attstmt.x5c, store));
+}
 
+int
+fido_cred_verify_batch(fido_cred_verify_item_t *v, size_t n,
+    const fido_attest_store_t *store)
+{
+	int r = FIDO_OK;
+
+	if (v == NULL && n != 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	/*
+	 * Items sharing an attestation certificate need no grouping: the
+	 * certificate is decoded once and then served by fido_x5c_cert().
+	 */
+	for (size_t i = 0; i < n; i++) {
+		if (v[i].cred == NULL)
+			v[i].r = FIDO_ERR_INVALID_ARGUMENT;
+		else if (store != NULL)
+			v[i].r = fido_cred_verify_chain(v[i].cred, store);
+		else
+			v[i].r = fido_cred_verify(v[i].cred);
+		if (v[i].r != FIDO_OK) {
+			fido_log_debug("%s: item %zu: %d", __func__, i, v[i].r);
+			if (r == FIDO_OK)
+				r = v[i].r;
+		}
+	}
+
+	return (r);
+}
+
+/* checks common to self attestations; the signed hash in 'dgst' */
+static int
+get_signed_hash_self(const fido_cred_t *cred, fido_blob_t *dgst)
+{
 	/* do we have everything we need? */
-	if (cred->cdh.ptr == NULL || cred->authdata_cbor.ptr == NULL ||
-	    cred->attstmt.x5c.ptr != NULL || cred->attstmt.sig.ptr == NULL ||
+	if (fido_blob_is_empty(&cred->cdh) ||
+	    fido_blob_is_empty(&cred->authdata_cbor) ||
+	    cred->attstmt.x5c.ptr != NULL ||
+	    fido_blob_is_empty(&cred->attstmt.sig) ||
 	    cred->fmt == NULL || cred->attcred.id.ptr == NULL ||
 	    cred->rp.id == NULL) {
 		fido_log_debug("%s: cdh=%p, authdata=%p, x5c=%p, sig=%p, "
@@ -446,73 +711,95 @@ fido_cred_verify_self(const fido_cred_t *cred)
 		    (void *)cred->attstmt.x5c.ptr,
 		    (void *)cred->attstmt.sig.ptr, (void *)cred->fmt,
 		    (void *)cred->attcred.id.ptr, cred->rp.id);
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto out;
+		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
-	if (fido_check_rp_id(cred->rp.id, cred->authdata.rp_id_hash) != 0) {
+	if (fido_check_rp_id(cred->rp.id, &cred->rp_id_hash,
+	    cred->authdata.rp_id_hash) != 0) {
 		fido_log_debug("%s: fido_check_rp_id", __func__);
-		r = FIDO_ERR_INVALID_PARAM;
-		goto out;
+		return (FIDO_ERR_INVALID_PARAM);
 	}
 
 	if (fido_check_flags(cred->authdata.flags, FIDO_OPT_TRUE,
 	    cred->uv) < 0) {
 		fido_log_debug("%s: fido_check_flags", __func__);
-		r = FIDO_ERR_INVALID_PARAM;
-		goto out;
+		return (FIDO_ERR_INVALID_PARAM);
 	}
 
 	if (check_extensions(&cred->authdata_ext, &cred->ext) != 0) {
 		fido_log_debug("%s: check_extensions", __func__);
-		r = FIDO_ERR_INVALID_PARAM;
-		goto out;
+		return (FIDO_ERR_INVALID_PARAM);
 	}
 
-	if (!strcmp(cred->fmt, "packed")) {
-		if (fido_get_signed_hash(cred->attcred.type, &dgst, &cred->cdh,
-		    &cred->authdata_cbor) < 0) {
+	switch (fido_fmt_id(cred->fmt)) {
+	case FIDO_FMT_PACKED:
+		if (fido_get_signed_hash(cred->attcred.type, dgst, &cred->cdh,
+		    &cred->authdata_raw) < 0) {
 			fido_log_debug("%s: fido_get_signed_hash", __func__);
-			r = FIDO_ERR_INTERNAL;
-			goto out;
+			return (FIDO_ERR_INTERNAL);
 		}
-	} else if (!strcmp(cred->fmt, "fido-u2f")) {
-		if (get_signed_hash_u2f(&dgst, cred->authdata.rp_id_hash,
+		break;
+	case FIDO_FMT_U2F:
+		if (get_signed_hash_u2f(dgst, cred->authdata.rp_id_hash,
 		    sizeof(cred->authdata.rp_id_hash), &cred->cdh,
 		    &cred->attcred.id, &cred->attcred.pubkey.es256) < 0) {
 			fido_log_debug("%s: get_signed_hash_u2f", __func__);
-			r = FIDO_ERR_INTERNAL;
-			goto out;
+			return (FIDO_ERR_INTERNAL);
 		}
-	} else {
-		fido_log_debug("%s: unknown fmt %s", __func__, cred->fmt);
-		r = FIDO_ERR_INVALID_ARGUMENT;
-		goto out;
+		break;
+	default:
+		fido_log_debug("%s: unsupported fmt %s", __func__, cred->fmt);
+		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
+	return (FIDO_OK);
+}
+
+int
+fido_cred_verify_self(const fido_cred_t *cred)
+{
+	fido_blob_t	dgst;
+	fido_prof_t	prof;
+	int		ok = -1;
+	int		r;
+
+	memset(&dgst, 0, sizeof(dgst));
+
+	if ((r = get_signed_hash_self(cred, &dgst)) != FIDO_OK)
+		goto out;
+
+	/* a one-off key; not worth a fido_pk_t and its cached context */
+	fido_prof_begin(&prof, FIDO_PROF_VERIFY_SIG);
 	switch (cred->attcred.type) {
 	case COSE_ES256:
 		ok = es256_pk_verify_sig(&dgst, &cred->attcred.pubkey.es256,
 		    &cred->attstmt.sig);
 		break;
+#ifndef FIDO_NO_ES384
 	case COSE_ES384:
 		ok = es384_pk_verify_sig(&dgst, &cred->attcred.pubkey.es384,
 		    &cred->attstmt.sig);
 		break;
+#endif
+#ifndef FIDO_NO_RS256
 	case COSE_RS256:
 		ok = rs256_pk_verify_sig(&dgst, &cred->attcred.pubkey.rs256,
 		    &cred->attstmt.sig);
 		break;
+#endif
+#ifndef FIDO_NO_EDDSA
 	case COSE_EDDSA:
 		ok = eddsa_pk_verify_sig(&dgst, &cred->attcred.pubkey.eddsa,
 		    &cred->attstmt.sig);
 		break;
+#endif
 	default:
 		fido_log_debug("%s: unsupported cose_alg %d", __func__,
 		    cred->attcred.type);
 		r = FIDO_ERR_UNSUPPORTED_OPTION;
 		goto out;
 	}
+	fido_prof_end(&prof, ok);
 
 	if (ok < 0)
 		r = FIDO_ERR_INVALID_SIG;
@@ -520,7 +807,48 @@ fido_cred_verify_self(const fido_cred_t *cred)
 		r = FIDO_OK;
 
 out:
-	explicit_bzero(buf, sizeof(buf));
+	fido_blob_reset(&dgst);
+
+	return (r);
+}
+
+int
+fido_cred_verify_self_pk(const fido_cred_t *cred, fido_pk_t *pk)
+{
+	fido_blob_t	dgst;
+	fido_prof_t	prof;
+	int		r;
+
+	memset(&dgst, 0, sizeof(dgst));
+
+	if (pk == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	fido_pk_reset(pk);
+
+	if ((r = get_signed_hash_self(cred, &dgst)) != FIDO_OK)
+		goto out;
+
+	/* decoded once, for the caller to keep */
+	if ((r = fido_pk_set(pk, cred->attcred.type,
+	    &cred->attcred.pubkey)) != FIDO_OK) {
+		fido_log_debug("%s: fido_pk_set", __func__);
+		goto out;
+	}
+
+	fido_prof_begin(&prof, FIDO_PROF_VERIFY_SIG);
+	if (fido_prof_end(&prof, fido_pk_verify_sig(&dgst, pk,
+	    &cred->attstmt.sig)) < 0) {
+		fido_log_debug("%s: fido_pk_verify_sig", __func__);
+		r = FIDO_ERR_INVALID_SIG;
+		goto out;
+	}
+
+	r = FIDO_OK;
+out:
+	if (r != FIDO_OK)
+		fido_pk_reset(pk);
+	fido_blob_reset(&dgst);
 
 	return (r);
 }
@@ -528,21 +856,24 @@ out:
 fido_cred_t *
 fido_cred_new(void)
 {
-	return (calloc(1, sizeof(fido_cred_t)));
+	return (fido_calloc(1, sizeof(fido_cred_t)));
 }
 
+/* the authdata buffers are kept for reuse */
 static void
 fido_cred_clean_authdata(fido_cred_t *cred)
 {
-	fido_blob_reset(&cred->authdata_cbor);
-	fido_blob_reset(&cred->authdata_raw);
+	fido_blob_clear(&cred->authdata_cbor);
+	fido_blob_clear(&cred->authdata_raw);
 	fido_blob_reset(&cred->attcred.id);
+	fido_blob_reset(&cred->authdata_ext.hmac_secret_enc);
 
 	memset(&cred->authdata_ext, 0, sizeof(cred->authdata_ext));
 	memset(&cred->authdata, 0, sizeof(cred->authdata));
 	memset(&cred->attcred, 0, sizeof(cred->attcred));
 }
 
+/* as above, for the signature */
 static void
 fido_cred_clean_attstmt(fido_attstmt_t *attstmt)
 {
@@ -550,18 +881,18 @@ fido_cred_clean_attstmt(fido_attstmt_t *attstmt)
 	fido_blob_reset(&attstmt->pubarea);
 	fido_blob_reset(&attstmt->cbor);
 	fido_free_blob_array(&attstmt->x5c);
-	fido_blob_reset(&attstmt->sig);
-
-	memset(attstmt, 0, sizeof(*attstmt));
+	fido_blob_clear(&attstmt->sig);
+	attstmt->alg = 0;
 }
 
 static void
 fido_cred_clean_attobj(fido_cred_t *cred)
 {
-	free(cred->fmt);
+	fido_free(cred->fmt);
 	cred->fmt = NULL;
 	fido_cred_clean_authdata(cred);
 	fido_cred_clean_attstmt(&cred->attstmt);
+	fido_blob_reset(&cred->attobj);
 }
 
 void
@@ -569,14 +900,18 @@ fido_cred_reset_tx(fido_cred_t *cred)
 {
 	fido_blob_reset(&cred->cd);
 	fido_blob_reset(&cred->cdh);
+	EVP_MD_CTX_free(cred->cd_ctx);
+	cred->cd_ctx = NULL;
 	fido_blob_reset(&cred->user.id);
 	fido_blob_reset(&cred->blob);
-
-	free(cred->rp.id);
-	free(cred->rp.name);
-	free(cred->user.icon);
-	free(cred->user.name);
-	free(cred->user.display_name);
+	fido_blob_reset(&cred->ext.hmac_salt);
+	fido_blob_reset(&cred->rp_id_hash);
+
+	fido_free(cred->rp.id);
+	fido_free(cred->rp.name);
+	fido_free(cred->user.icon);
+	fido_free(cred->user.name);
+	fido_free(cred->user.display_name);
 	fido_cred_empty_exclude_list(cred);
 
 	memset(&cred->rp, 0, sizeof(cred->rp));
@@ -592,7 +927,42 @@ void
 fido_cred_reset_rx(fido_cred_t *cred)
 {
 	fido_cred_clean_attobj(cred);
+	fido_blob_reset(&cred->authdata_cbor);
+	fido_blob_reset(&cred->authdata_raw);
+	fido_blob_reset(&cred->attstmt.sig);
 	fido_blob_reset(&cred->largeblob_key);
+	fido_blob_reset(&cred->hmac_secret);
+}
+
+void
+fido_cred_recycle(fido_cred_t *cred)
+{
+	if (cred == NULL)
+		return;
+
+	fido_cred_clean_attstmt(&cred->attstmt);
+	fido_cred_clean_authdata(cred);
+	fido_blob_reset(&cred->largeblob_key);
+	fido_blob_reset(&cred->hmac_secret);
+	fido_blob_clear(&cred->cd);
+	fido_blob_clear(&cred->cdh);
+	EVP_MD_CTX_free(cred->cd_ctx);
+	cred->cd_ctx = NULL;
+	fido_blob_reset(&cred->user.id);
+	fido_blob_reset(&cred->blob);
+	fido_blob_reset(&cred->ext.hmac_salt);
+
+	fido_free(cred->user.icon);
+	fido_free(cred->user.name);
+	fido_free(cred->user.display_name);
+	fido_cred_empty_exclude_list(cred);
+
+	memset(&cred->user, 0, sizeof(cred->user));
+	memset(&cred->ext, 0, sizeof(cred->ext));
+
+	cred->type = 0;
+	cred->rk = FIDO_OPT_OMIT;
+	cred->uv = FIDO_OPT_OMIT;
 }
 
 void
@@ -604,55 +974,32 @@ fido_cred_free(fido_cred_t **cred_p)
 		return;
 	fido_cred_reset_tx(cred);
 	fido_cred_reset_rx(cred);
-	free(cred);
+	fido_free(cred);
 	*cred_p = NULL;
 }
 
-int
-fido_cred_set_authdata(fido_cred_t *cred, const unsigned char *ptr, size_t len)
-{
-	cbor_item_t		*item = NULL;
-	struct cbor_load_result	 cbor;
-	int			 r = FIDO_ERR_INVALID_ARGUMENT;
-
-	fido_cred_clean_authdata(cred);
-
-	if (ptr == NULL || len == 0)
-		goto fail;
-
-	if ((item = cbor_load(ptr, len, &cbor)) == NULL) {
-		fido_log_debug("%s: cbor_load", __func__);
-		goto fail;
-	}
-
-	if (fido_blob_decode(item, &cred->authdata_raw) < 0) {
-		fido_log_debug("%s: fido_blob_decode", __func__);
-		goto fail;
-	}
-
-	if (cbor_decode_cred_authdata(item, cred->type, &cred->authdata_cbor,
-	    &cred->authdata, &cred->attcred, &cred->authdata_ext) < 0) {
-		fido_log_debug("%s: cbor_decode_cred_authdata", __func__);
-		goto fail;
-	}
-
-	r = FIDO_OK;
-fail:
-	if (item != NULL)
-		cbor_decref(&item);
+int
+fido_cred_set_authdata(fido_cred_t *cred, const unsigned char *ptr, size_t len)
+{
+	const unsigned char	*raw_ptr;
+	size_t			 raw_len;
 
-	if (r != FIDO_OK)
+	if (ptr == NULL || len == 0 ||
+	    cbor_unwrap_bytestring(ptr, len, &raw_ptr, &raw_len) < 0 ||
+	    raw_len == 0 || raw_ptr + raw_len != ptr + len) {
+		fido_log_debug("%s: cbor_unwrap_bytestring", __func__);
 		fido_cred_clean_authdata(cred);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
 
-	return (r);
+	return (fido_cred_set_authdata_raw(cred, raw_ptr, raw_len));
 }
 
 int
 fido_cred_set_authdata_raw(fido_cred_t *cred, const unsigned char *ptr,
     size_t len)
 {
-	cbor_item_t	*item = NULL;
-	int		 r = FIDO_ERR_INVALID_ARGUMENT;
+	int r = FIDO_ERR_INVALID_ARGUMENT;
 
 	fido_cred_clean_authdata(cred);
 
@@ -665,23 +1012,22 @@ fido_cred_set_authdata_raw(fido_cred_t *cred, const unsigned char *ptr,
 		goto fail;
 	}
 
-	if ((item = cbor_build_bytestring(ptr, len)) == NULL) {
-		fido_log_debug("%s: cbor_build_bytestring", __func__);
-		r = FIDO_ERR_INTERNAL;
+	if (cbor_decode_cred_authdata_raw(&cred->authdata_raw, cred->type,
+	    &cred->authdata, &cred->attcred, &cred->authdata_ext) < 0) {
+		fido_log_debug("%s: cbor_decode_cred_authdata_raw", __func__);
 		goto fail;
 	}
 
-	if (cbor_decode_cred_authdata(item, cred->type, &cred->authdata_cbor,
-	    &cred->authdata, &cred->attcred, &cred->authdata_ext) < 0) {
-		fido_log_debug("%s: cbor_decode_cred_authdata", __func__);
+	/* keep the cbor-encoded form available to the authdata getters */
+	if (cbor_wrap_bytestring(&cred->authdata_raw,
+	    &cred->authdata_cbor) < 0) {
+		fido_log_debug("%s: cbor_wrap_bytestring", __func__);
+		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
 	r = FIDO_OK;
 fail:
-	if (item != NULL)
-		cbor_decref(&item);
-
 	if (r != FIDO_OK)
 		fido_cred_clean_authdata(cred);
 
@@ -714,7 +1060,7 @@ fido_cred_set_x509(fido_cred_t *cred, const unsigned char *ptr, size_t len)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
-	if ((list_ptr = recallocarray(cred->attstmt.x5c.ptr,
+	if ((list_ptr = fido_recallocarray(cred->attstmt.x5c.ptr,
 	    cred->attstmt.x5c.len, cred->attstmt.x5c.len + 1,
 	    sizeof(x5c_blob))) == NULL) {
 		fido_blob_reset(&x5c_blob);
@@ -748,7 +1094,7 @@ fido_cred_set_attstmt(fido_cred_t *cred, const unsigned char *ptr, size_t len)
 	if (ptr == NULL || len == 0)
 		goto fail;
 
-	if ((item = cbor_load(ptr, len, &cbor)) == NULL) {
+	if ((item = cbor_load_ctap(ptr, len, &cbor)) == NULL) {
 		fido_log_debug("%s: cbor_load", __func__);
 		goto fail;
 	}
@@ -781,7 +1127,22 @@ fido_cred_set_attobj(fido_cred_t *cred, const unsigned char *ptr, size_t len)
 	if (ptr == NULL || len == 0)
 		goto fail;
 
-	if ((item = cbor_load(ptr, len, &cbor)) == NULL) {
+	/* in place, unless attStmt must be re-encoded */
+	if (cbor_is_shortest(ptr, len)) {
+		if (fido_blob_set(&cred->attobj, ptr, len) < 0) {
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+		if (cbor_parse_attobj(cred->attobj.ptr, len, cred) < 0) {
+			fido_log_debug("%s: cbor_parse_attobj", __func__);
+			fido_cred_clean_attobj(cred);
+			goto fail;
+		}
+		r = FIDO_OK;
+		goto fail;
+	}
+
+	if ((item = cbor_load_ctap(ptr, len, &cbor)) == NULL) {
 		fido_log_debug("%s: cbor_load", __func__);
 		goto fail;
 	}
@@ -801,27 +1162,36 @@ fail:
 int
 fido_cred_exclude(fido_cred_t *cred, const unsigned char *id_ptr, size_t id_len)
 {
-	fido_blob_t id_blob;
-	fido_blob_t *list_ptr;
+	if (fido_blob_array_reserve(&cred->excl, 1) < 0)
+		return (FIDO_ERR_INTERNAL);
+	if (fido_blob_array_append(&cred->excl, id_ptr, id_len) < 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	memset(&id_blob, 0, sizeof(id_blob));
+	return (FIDO_OK);
+}
 
-	if (fido_blob_set(&id_blob, id_ptr, id_len) < 0)
-		return (FIDO_ERR_INVALID_ARGUMENT);
+/* as fido_assert_set_allow_list(), for the exclude list */
+int
+fido_cred_set_exclude_list(fido_cred_t *cred,
+    const unsigned char * const *id_ptr, const size_t *id_len, size_t n)
+{
+	fido_blob_array_t list;
 
-	if (cred->excl.len == SIZE_MAX) {
-		free(id_blob.ptr);
-		return (FIDO_ERR_INVALID_ARGUMENT);
-	}
+	memset(&list, 0, sizeof(list));
 
-	if ((list_ptr = recallocarray(cred->excl.ptr, cred->excl.len,
-	    cred->excl.len + 1, sizeof(fido_blob_t))) == NULL) {
-		free(id_blob.ptr);
+	if (n != 0 && (id_ptr == NULL || id_len == NULL))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (fido_blob_array_reserve(&list, n) < 0)
 		return (FIDO_ERR_INTERNAL);
-	}
+	for (size_t i = 0; i < n; i++)
+		if (fido_blob_array_append(&list, id_ptr[i], id_len[i]) < 0) {
+			fido_log_debug("%s: id %zu", __func__, i);
+			fido_free_blob_array(&list);
+			return (FIDO_ERR_INVALID_ARGUMENT);
+		}
 
-	list_ptr[cred->excl.len++] = id_blob;
-	cred->excl.ptr = list_ptr;
+	fido_free_blob_array(&cred->excl);
+	cred->excl = list;
 
 	return (FIDO_OK);
 }
@@ -851,6 +1221,42 @@ fido_cred_set_clientdata(fido_cred_t *cred, const unsigned char *data,
 	return (FIDO_OK);
 }
 
+/* as fido_assert_set_clientdata_init(), for credentials */
+int
+fido_cred_set_clientdata_init(fido_cred_t *cred)
+{
+	if (!fido_blob_is_empty(&cred->cd) || !fido_blob_is_empty(&cred->cdh))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (fido_sha256_init(&cred->cd_ctx) < 0)
+		return (FIDO_ERR_INTERNAL);
+
+	return (FIDO_OK);
+}
+
+int
+fido_cred_set_clientdata_update(fido_cred_t *cred, const unsigned char *data,
+    size_t data_len)
+{
+	if (cred->cd_ctx == NULL || (data == NULL && data_len > 0))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (fido_sha256_update(cred->cd_ctx, data, data_len) < 0)
+		return (FIDO_ERR_INTERNAL);
+
+	return (FIDO_OK);
+}
+
+int
+fido_cred_set_clientdata_final(fido_cred_t *cred)
+{
+	if (cred->cd_ctx == NULL || !fido_blob_is_empty(&cred->cd) ||
+	    !fido_blob_is_empty(&cred->cdh))
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (fido_sha256_final(&cred->cd_ctx, &cred->cdh) < 0)
+		return (FIDO_ERR_INTERNAL);
+
+	return (FIDO_OK);
+}
+
 int
 fido_cred_set_clientdata_hash(fido_cred_t *cred, const unsigned char *hash,
     size_t hash_len)
@@ -867,26 +1273,37 @@ fido_cred_set_rp(fido_cred_t *cred, const char *id, const char *name)
 {
 	fido_rp_t *rp = &cred->rp;
 
+	/* keep the hash of a recycled credential */
+	if (id != NULL && rp->id != NULL && strcmp(rp->id, id) == 0 &&
+	    !fido_blob_is_empty(&cred->rp_id_hash) && (name == NULL ?
+	    rp->name == NULL : rp->name != NULL && strcmp(rp->name, name) == 0))
+		return (FIDO_OK);
+
 	if (rp->id != NULL) {
-		free(rp->id);
+		fido_free(rp->id);
 		rp->id = NULL;
 	}
 	if (rp->name != NULL) {
-		free(rp->name);
+		fido_free(rp->name);
 		rp->name = NULL;
 	}
+	fido_blob_reset(&cred->rp_id_hash);
 
-	if (id != NULL && (rp->id = strdup(id)) == NULL)
+	if (id != NULL && (rp->id = fido_strdup(id)) == NULL)
+		goto fail;
+	if (name != NULL && (rp->name = fido_strdup(name)) == NULL)
 		goto fail;
-	if (name != NULL && (rp->name = strdup(name)) == NULL)
+	if (id != NULL && fido_sha256(&cred->rp_id_hash, (const u_char *)id,
+	    strlen(id)) < 0)
 		goto fail;
 
 	return (FIDO_OK);
 fail:
-	free(rp->id);
-	free(rp->name);
+	fido_free(rp->id);
+	fido_free(rp->name);
 	rp->id = NULL;
 	rp->name = NULL;
+	fido_blob_reset(&cred->rp_id_hash);
 
 	return (FIDO_ERR_INTERNAL);
 }
@@ -898,43 +1315,37 @@ fido_cred_set_user(fido_cred_t *cred, const unsigned char *user_id,
 {
 	fido_user_t *up = &cred->user;
 
-	if (up->id.ptr != NULL) {
-		free(up->id.ptr);
-		up->id.ptr = NULL;
-		up->id.len = 0;
-	}
+	fido_blob_reset(&up->id);
 	if (up->name != NULL) {
-		free(up->name);
+		fido_free(up->name);
 		up->name = NULL;
 	}
 	if (up->display_name != NULL) {
-		free(up->display_name);
+		fido_free(up->display_name);
 		up->display_name = NULL;
 	}
 	if (up->icon != NULL) {
-		free(up->icon);
+		fido_free(up->icon);
 		up->icon = NULL;
 	}
 
 	if (user_id != NULL && fido_blob_set(&up->id, user_id, user_id_len) < 0)
 		goto fail;
-	if (name != NULL && (up->name = strdup(name)) == NULL)
+	if (name != NULL && (up->name = fido_strdup(name)) == NULL)
 		goto fail;
 	if (display_name != NULL &&
-	    (up->display_name = strdup(display_name)) == NULL)
+	    (up->display_name = fido_strdup(display_name)) == NULL)
 		goto fail;
-	if (icon != NULL && (up->icon = strdup(icon)) == NULL)
+	if (icon != NULL && (up->icon = fido_strdup(icon)) == NULL)
 		goto fail;
 
 	return (FIDO_OK);
 fail:
-	free(up->id.ptr);
-	free(up->name);
-	free(up->display_name);
-	free(up->icon);
+	fido_blob_reset(&up->id);
+	fido_free(up->name);
+	fido_free(up->display_name);
+	fido_free(up->icon);
 
-	up->id.ptr = NULL;
-	up->id.len = 0;
 	up->name = NULL;
 	up->display_name = NULL;
 	up->icon = NULL;
@@ -1013,6 +1424,17 @@ fido_cred_set_pin_minlen(fido_cred_t *cred, size_t len)
 	return (FIDO_OK);
 }
 
+int
+fido_cred_set_hmac_salt(fido_cred_t *cred, const unsigned char *salt,
+    size_t salt_len)
+{
+	if ((salt_len != 32 && salt_len != 64) ||
+	    fido_blob_set(&cred->ext.hmac_salt, salt, salt_len) < 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	return (FIDO_OK);
+}
+
 int
 fido_cred_set_blob(fido_cred_t *cred, const unsigned char *ptr, size_t len)
 {
@@ -1029,17 +1451,19 @@ fido_cred_set_blob(fido_cred_t *cred, const unsigned char *ptr, size_t len)
 int
 fido_cred_set_fmt(fido_cred_t *cred, const char *fmt)
 {
-	free(cred->fmt);
+	if (fmt != NULL && cred->fmt != NULL && strcmp(cred->fmt, fmt) == 0)
+		return (FIDO_OK);
+
+	fido_free(cred->fmt);
 	cred->fmt = NULL;
 
 	if (fmt == NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	if (strcmp(fmt, "packed") && strcmp(fmt, "fido-u2f") &&
-	    strcmp(fmt, "none") && strcmp(fmt, "tpm"))
+	if (fido_fmt_id(fmt) == FIDO_FMT_UNKNOWN)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	if ((cred->fmt = strdup(fmt)) == NULL)
+	if ((cred->fmt = fido_strdup(fmt)) == NULL)
 		return (FIDO_ERR_INTERNAL);
 
 	return (FIDO_OK);
@@ -1050,8 +1474,7 @@ fido_cred_set_type(fido_cred_t *cred, int cose_alg)
 {
 	if (cred->type != 0)
 		return (FIDO_ERR_INVALID_ARGUMENT);
-	if (cose_alg != COSE_ES256 && cose_alg != COSE_ES384 &&
-	    cose_alg != COSE_RS256 && cose_alg != COSE_EDDSA)
+	if (cose_alg == COSE_RS1 || !fido_cose_alg_enabled(cose_alg))
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
 	cred->type = cose_alg;
@@ -1080,7 +1503,7 @@ fido_cred_sigcount(const fido_cred_t *cred)
 const unsigned char *
 fido_cred_clientdata_hash_ptr(const fido_cred_t *cred)
 {
-	return (cred->cdh.ptr);
+	return (fido_blob_is_empty(&cred->cdh) ? NULL : cred->cdh.ptr);
 }
 
 size_t
@@ -1128,6 +1551,9 @@ fido_cred_x5c_list_len(const fido_cred_t *cred, size_t i)
 const unsigned char *
 fido_cred_sig_ptr(const fido_cred_t *cred)
 {
+	if (fido_blob_is_empty(&cred->attstmt.sig))
+		return (NULL);
+
 	return (cred->attstmt.sig.ptr);
 }
 
@@ -1140,6 +1566,9 @@ fido_cred_sig_len(const fido_cred_t *cred)
 const unsigned char *
 fido_cred_authdata_ptr(const fido_cred_t *cred)
 {
+	if (fido_blob_is_empty(&cred->authdata_cbor))
+		return (NULL);
+
 	return (cred->authdata_cbor.ptr);
 }
 
@@ -1152,6 +1581,9 @@ fido_cred_authdata_len(const fido_cred_t *cred)
 const unsigned char *
 fido_cred_authdata_raw_ptr(const fido_cred_t *cred)
 {
+	if (fido_blob_is_empty(&cred->authdata_raw))
+		return (NULL);
+
 	return (cred->authdata_raw.ptr);
 }
 
@@ -1314,3 +1746,418 @@ fido_cred_largeblob_key_len(const fido_cred_t *cred)
 {
 	return (cred->largeblob_key.len);
 }
+
+const unsigned char *
+fido_cred_hmac_secret_ptr(const fido_cred_t *cred)
+{
+	return (cred->hmac_secret.ptr);
+}
+
+size_t
+fido_cred_hmac_secret_len(const fido_cred_t *cred)
+{
+	return (cred->hmac_secret.len);
+}
+
+/*
+ * Serialised credentials, for storage after fido_cred_verify(). The
+ * fields are kept as decoded, so a credential is reloaded without
+ * parsing cbor. Integers are big-endian; a blob is its length (be32)
+ * followed by its bytes, and a string a blob, or 0xffffffff if NULL.
+ * The large blob key, a secret, is not kept.
+ */
+
+#define CRED_SER_MAGIC	"fido2cr1"
+#define CRED_SER_NULL	UINT32_MAX
+
+struct cred_ser {
+	unsigned char	*ptr; /* NULL when measuring */
+	size_t		 len;
+	size_t		 off;
+};
+
+static int
+ser_put(struct cred_ser *s, const void *ptr, size_t len)
+{
+	if (len > SIZE_MAX - s->off)
+		return (-1);
+	if (s->ptr != NULL && len > 0) {
+		if (s->off + len > s->len)
+			return (-1);
+		memcpy(s->ptr + s->off, ptr, len);
+	}
+	s->off += len;
+
+	return (0);
+}
+
+static int
+ser_put_be32(struct cred_ser *s, uint32_t v)
+{
+	unsigned char b[4];
+
+	b[0] = (unsigned char)(v >> 24);
+	b[1] = (unsigned char)(v >> 16);
+	b[2] = (unsigned char)(v >> 8);
+	b[3] = (unsigned char)v;
+
+	return (ser_put(s, b, sizeof(b)));
+}
+
+static int
+ser_put_size(struct cred_ser *s, size_t v)
+{
+	if (v >= CRED_SER_NULL)
+		return (-1);
+
+	return (ser_put_be32(s, (uint32_t)v));
+}
+
+static int
+ser_put_blob(struct cred_ser *s, const fido_blob_t *b)
+{
+	if (ser_put_size(s, b->len) < 0 || ser_put(s, b->ptr, b->len) < 0)
+		return (-1);
+
+	return (0);
+}
+
+static int
+ser_put_str(struct cred_ser *s, const char *str)
+{
+	if (str == NULL)
+		return (ser_put_be32(s, CRED_SER_NULL));
+	if (ser_put_size(s, strlen(str)) < 0 ||
+	    ser_put(s, str, strlen(str)) < 0)
+		return (-1);
+
+	return (0);
+}
+
+static size_t
+cred_pubkey_len(int cose_alg)
+{
+	switch (cose_alg) {
+	case COSE_ES256:
+		return (sizeof(es256_pk_t));
+	case COSE_ES384:
+		return (sizeof(es384_pk_t));
+	case COSE_RS256:
+		return (sizeof(rs256_pk_t));
+	case COSE_EDDSA:
+		return (sizeof(eddsa_pk_t));
+	default:
+		return (0);
+	}
+}
+
+static int
+cred_ser(struct cred_ser *s, const fido_cred_t *cred)
+{
+	const fido_attcred_t	*ac = &cred->attcred;
+	const fido_attstmt_t	*as = &cred->attstmt;
+
+	if (ser_put(s, CRED_SER_MAGIC, 8) < 0 ||
+	    ser_put_be32(s, (uint32_t)cred->type) < 0 ||
+	    ser_put_be32(s, (uint32_t)cred->uv) < 0 ||
+	    ser_put_be32(s, (uint32_t)cred->ext.mask) < 0 ||
+	    ser_put_be32(s, (uint32_t)cred->ext.prot) < 0 ||
+	    ser_put_size(s, cred->ext.minpinlen) < 0 ||
+	    ser_put_str(s, cred->fmt) < 0 ||
+	    ser_put_str(s, cred->rp.id) < 0 ||
+	    ser_put_str(s, cred->rp.name) < 0 ||
+	    ser_put_blob(s, &cred->cdh) < 0 ||
+	    ser_put_blob(s, &cred->authdata_cbor) < 0 ||
+	    ser_put_blob(s, &cred->authdata_raw) < 0 ||
+	    ser_put(s, cred->authdata.rp_id_hash,
+	    sizeof(cred->authdata.rp_id_hash)) < 0 ||
+	    ser_put(s, &cred->authdata.flags, 1) < 0 ||
+	    ser_put_be32(s, cred->authdata.sigcount) < 0 ||
+	    ser_put_be32(s, (uint32_t)cred->authdata_ext.mask) < 0 ||
+	    ser_put_be32(s, (uint32_t)cred->authdata_ext.prot) < 0 ||
+	    ser_put_size(s, cred->authdata_ext.minpinlen) < 0 ||
+	    ser_put(s, ac->aaguid, sizeof(ac->aaguid)) < 0 ||
+	    ser_put_blob(s, &ac->id) < 0 ||
+	    ser_put_be32(s, (uint32_t)ac->type) < 0 ||
+	    ser_put(s, &ac->pubkey, cred_pubkey_len(ac->type)) < 0 ||
+	    ser_put_blob(s, &as->certinfo) < 0 ||
+	    ser_put_blob(s, &as->pubarea) < 0 ||
+	    ser_put_blob(s, &as->cbor) < 0 ||
+	    ser_put_size(s, as->x5c.len) < 0)
+		return (-1);
+	for (size_t i = 0; i < as->x5c.len; i++)
+		if (ser_put_blob(s, &as->x5c.ptr[i]) < 0)
+			return (-1);
+	if (ser_put_blob(s, &as->sig) < 0 ||
+	    ser_put_be32(s, (uint32_t)as->alg) < 0)
+		return (-1);
+
+	return (0);
+}
+
+int
+fido_cred_serialize(const fido_cred_t *cred, unsigned char **ptr,
+    size_t *len)
+{
+	struct cred_ser s;
+
+	if (ptr == NULL || len == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	*ptr = NULL;
+	*len = 0;
+
+	memset(&s, 0, sizeof(s));
+	if (cred_ser(&s, cred) < 0) {
+		fido_log_debug("%s: cred_ser", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+	if ((s.ptr = fido_malloc(s.off)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+	s.len = s.off;
+	s.off = 0;
+	if (cred_ser(&s, cred) < 0 || s.off != s.len) {
+		fido_log_debug("%s: cred_ser", __func__);
+		fido_free(s.ptr);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	*ptr = s.ptr;
+	*len = s.len;
+
+	return (FIDO_OK);
+}
+
+static int
+de_be32(const unsigned char **buf, size_t *len, uint32_t *v)
+{
+	unsigned char b[4];
+
+	if (fido_buf_read(buf, len, b, sizeof(b)) < 0)
+		return (-1);
+	*v = (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 |
+	    (uint32_t)b[2] << 8 | (uint32_t)b[3];
+
+	return (0);
+}
+
+static int
+de_int(const unsigned char **buf, size_t *len, int *v)
+{
+	uint32_t u;
+
+	if (de_be32(buf, len, &u) < 0)
+		return (-1);
+	*v = (int)u;
+
+	return (0);
+}
+
+static int
+de_size(const unsigned char **buf, size_t *len, size_t *v)
+{
+	uint32_t u;
+
+	if (de_be32(buf, len, &u) < 0 || u == CRED_SER_NULL)
+		return (-1);
+	*v = u;
+
+	return (0);
+}
+
+static int
+de_blob(const unsigned char **buf, size_t *len, fido_blob_t *b)
+{
+	size_t n;
+
+	if (de_size(buf, len, &n) < 0 || n > *len)
+		return (-1);
+	if (n > 0 && fido_blob_set(b, *buf, n) < 0)
+		return (-1);
+	*buf += n;
+	*len -= n;
+
+	return (0);
+}
+
+/* a NUL-terminated copy; *str is NULL for a serialised NULL */
+static int
+de_str(const unsigned char **buf, size_t *len, char **str)
+{
+	uint32_t u;
+
+	*str = NULL;
+	if (de_be32(buf, len, &u) < 0)
+		return (-1);
+	if (u == CRED_SER_NULL)
+		return (0);
+	if (u > *len || memchr(*buf, '\0', u) != NULL ||
+	    (*str = fido_calloc(1, (size_t)u + 1)) == NULL)
+		return (-1);
+	memcpy(*str, *buf, u);
+	*buf += u;
+	*len -= u;
+
+	return (0);
+}
+
+static bool
+de_blob_eq(const fido_blob_t *a, const fido_blob_t *b)
+{
+	return (a->len == b->len &&
+	    (a->len == 0 || memcmp(a->ptr, b->ptr, a->len) == 0));
+}
+
+/*
+ * The decoded authdata is derived from authdata_raw, as by
+ * fido_cred_set_authdata_raw(); the decoded copy in the blob must match.
+ */
+static int
+de_authdata(fido_cred_t *cred, const unsigned char **buf, size_t *len)
+{
+	const fido_attcred_t	*ac = &cred->attcred;
+	fido_blob_t		 cbor, raw, id;
+	unsigned char		 rp_id_hash[32], aaguid[16], flags;
+	unsigned char		 pubkey[sizeof(ac->pubkey)];
+	uint32_t		 sigcount;
+	int			 mask, prot, type, ok = -1;
+	size_t			 minpinlen;
+
+	memset(&cbor, 0, sizeof(cbor));
+	memset(&raw, 0, sizeof(raw));
+	memset(&id, 0, sizeof(id));
+
+	if (de_blob(buf, len, &cbor) < 0 ||
+	    de_blob(buf, len, &raw) < 0 ||
+	    fido_buf_read(buf, len, rp_id_hash, sizeof(rp_id_hash)) < 0 ||
+	    fido_buf_read(buf, len, &flags, 1) < 0 ||
+	    de_be32(buf, len, &sigcount) < 0 ||
+	    de_int(buf, len, &mask) < 0 ||
+	    de_int(buf, len, &prot) < 0 ||
+	    de_size(buf, len, &minpinlen) < 0 ||
+	    fido_buf_read(buf, len, aaguid, sizeof(aaguid)) < 0 ||
+	    de_blob(buf, len, &id) < 0 ||
+	    de_int(buf, len, &type) < 0 ||
+	    (type != 0 && cred_pubkey_len(type) == 0) ||
+	    fido_buf_read(buf, len, pubkey, cred_pubkey_len(type)) < 0) {
+		fido_log_debug("%s: authdata", __func__);
+		goto fail;
+	}
+	if (!fido_blob_is_empty(&raw) && fido_cred_set_authdata_raw(cred,
+	    raw.ptr, raw.len) != FIDO_OK) {
+		fido_log_debug("%s: fido_cred_set_authdata_raw", __func__);
+		goto fail;
+	}
+	if (!de_blob_eq(&cbor, &cred->authdata_cbor) ||
+	    memcmp(rp_id_hash, cred->authdata.rp_id_hash,
+	    sizeof(rp_id_hash)) != 0 || flags != cred->authdata.flags ||
+	    sigcount != cred->authdata.sigcount ||
+	    mask != cred->authdata_ext.mask ||
+	    prot != cred->authdata_ext.prot ||
+	    minpinlen != cred->authdata_ext.minpinlen ||
+	    memcmp(aaguid, ac->aaguid, sizeof(aaguid)) != 0 ||
+	    !de_blob_eq(&id, &ac->id) || type != ac->type ||
+	    memcmp(pubkey, &ac->pubkey, cred_pubkey_len(type)) != 0) {
+		fido_log_debug("%s: authdata mismatch", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	fido_blob_reset(&cbor);
+	fido_blob_reset(&raw);
+	fido_blob_reset(&id);
+	explicit_bzero(pubkey, sizeof(pubkey));
+
+	return (ok);
+}
+
+static int
+cred_de(fido_cred_t *cred, const unsigned char *buf, size_t len)
+{
+	fido_attstmt_t	*as = &cred->attstmt;
+	unsigned char	 magic[8];
+	char		*fmt = NULL, *rp_id = NULL, *rp_name = NULL;
+	int		 uv, ok = -1;
+	size_t		 n;
+
+	if (fido_buf_read(&buf, &len, magic, sizeof(magic)) < 0 ||
+	    memcmp(magic, CRED_SER_MAGIC, sizeof(magic)) != 0) {
+		fido_log_debug("%s: magic", __func__);
+		goto fail;
+	}
+	if (de_int(&buf, &len, &cred->type) < 0 ||
+	    (cred->type != 0 && cred_pubkey_len(cred->type) == 0) ||
+	    de_int(&buf, &len, &uv) < 0 || uv < FIDO_OPT_OMIT ||
+	    uv > FIDO_OPT_TRUE ||
+	    de_int(&buf, &len, &cred->ext.mask) < 0 ||
+	    de_int(&buf, &len, &cred->ext.prot) < 0 ||
+	    de_size(&buf, &len, &cred->ext.minpinlen) < 0 ||
+	    de_str(&buf, &len, &fmt) < 0 ||
+	    de_str(&buf, &len, &rp_id) < 0 ||
+	    de_str(&buf, &len, &rp_name) < 0) {
+		fido_log_debug("%s: request", __func__);
+		goto fail;
+	}
+	cred->uv = (fido_opt_t)uv;
+	if ((fmt != NULL && fido_cred_set_fmt(cred, fmt) != FIDO_OK) ||
+	    (rp_id != NULL && fido_cred_set_rp(cred, rp_id,
+	    rp_name) != FIDO_OK)) {
+		fido_log_debug("%s: fmt/rp", __func__);
+		goto fail;
+	}
+	if (de_blob(&buf, &len, &cred->cdh) < 0 ||
+	    de_authdata(cred, &buf, &len) < 0) {
+		fido_log_debug("%s: authdata", __func__);
+		goto fail;
+	}
+	/* every certificate takes at least four bytes */
+	if (de_blob(&buf, &len, &as->certinfo) < 0 ||
+	    de_blob(&buf, &len, &as->pubarea) < 0 ||
+	    de_blob(&buf, &len, &as->cbor) < 0 ||
+	    de_size(&buf, &len, &n) < 0 || n > len / 4) {
+		fido_log_debug("%s: attstmt", __func__);
+		goto fail;
+	}
+	if (n > 0) {
+		if ((as->x5c.ptr = fido_calloc(n, sizeof(*as->x5c.ptr))) ==
+		    NULL)
+			goto fail;
+		as->x5c.len = n;
+		for (size_t i = 0; i < n; i++)
+			if (de_blob(&buf, &len, &as->x5c.ptr[i]) < 0) {
+				fido_log_debug("%s: x5c", __func__);
+				goto fail;
+			}
+	}
+	if (de_blob(&buf, &len, &as->sig) < 0 ||
+	    de_int(&buf, &len, &as->alg) < 0 || len != 0) {
+		fido_log_debug("%s: sig", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	fido_free(fmt);
+	fido_free(rp_id);
+	fido_free(rp_name);
+
+	return (ok);
+}
+
+int
+fido_cred_deserialize(fido_cred_t *cred, const unsigned char *ptr, size_t len)
+{
+	fido_cred_reset_tx(cred);
+	fido_cred_reset_rx(cred);
+
+	if (ptr == NULL || len == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if (cred_de(cred, ptr, len) < 0) {
+		fido_cred_reset_tx(cred);
+		fido_cred_reset_rx(cred);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	return (FIDO_OK);
+}
@@ -42,7 +42,7 @@ credman_grow_array(void **ptr, size_t *n_alloc, const size_t *n_rx, size_t n,
 		return (-1);
 	}
 
-	if ((new_ptr = recallocarray(*ptr, *n_alloc, n, size)) == NULL)
+	if ((new_ptr = fido_recallocarray(*ptr, *n_alloc, n, size)) == NULL)
 		return (-1);
 
 	*ptr = new_ptr;
@@ -129,13 +129,21 @@ credman_tx(fido_dev_t *dev, uint8_t subcmd, const void *param, const char *pin,
 	fido_blob_t	 hmac;
 	es256_pk_t	*pk = NULL;
 	cbor_item_t	*argv[4];
-	const uint8_t	 cmd = credman_get_cmd(dev);
+	uint8_t		 cmd;
 	int		 r = FIDO_ERR_INTERNAL;
 
 	memset(&f, 0, sizeof(f));
 	memset(&hmac, 0, sizeof(hmac));
 	memset(&argv, 0, sizeof(argv));
 
+	if ((r = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		goto fail;
+	}
+
+	r = FIDO_ERR_INTERNAL;
+	cmd = credman_get_cmd(dev);
+
 	if (fido_dev_is_fido2(dev) == false) {
 		fido_log_debug("%s: fido_dev_is_fido2", __func__);
 		r = FIDO_ERR_INVALID_COMMAND;
@@ -178,8 +186,8 @@ fail:
 	es256_pk_free(&pk);
 	fido_blob_free(&ecdh);
 	cbor_vector_free(argv, nitems(argv));
-	free(f.ptr);
-	free(hmac.ptr);
+	fido_free(f.ptr);
+	fido_free(hmac.ptr);
 
 	return (r);
 }
@@ -211,17 +219,18 @@ static int
 credman_rx_metadata(fido_dev_t *dev, fido_credman_metadata_t *metadata, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
 	memset(metadata, 0, sizeof(*metadata));
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -235,14 +244,14 @@ credman_rx_metadata(fido_dev_t *dev, fido_credman_metadata_t *metadata, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
 
-static int
-credman_get_metadata_wait(fido_dev_t *dev, fido_credman_metadata_t *metadata,
-    const char *pin, int *ms)
+int
+fido_credman_get_metadata_wait(fido_dev_t *dev,
+    fido_credman_metadata_t *metadata, const char *pin, int *ms)
 {
 	int r;
 
@@ -258,9 +267,14 @@ int
 fido_credman_get_dev_metadata(fido_dev_t *dev, fido_credman_metadata_t *metadata,
     const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = fido_credman_get_metadata_wait(dev, metadata, pin, &ms);
 
-	return (credman_get_metadata_wait(dev, metadata, pin, &ms));
+	return (fido_trace_end(&span, r));
 }
 
 static int
@@ -307,7 +321,7 @@ credman_reset_rk(fido_credman_rk_t *rk)
 		fido_cred_reset_rx(&rk->ptr[i]);
 	}
 
-	free(rk->ptr);
+	fido_free(rk->ptr);
 	rk->ptr = NULL;
 	memset(rk, 0, sizeof(*rk));
 }
@@ -345,17 +359,18 @@ static int
 credman_rx_rk(fido_dev_t *dev, fido_credman_rk_t *rk, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
 	credman_reset_rk(rk);
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -384,29 +399,44 @@ credman_rx_rk(fido_dev_t *dev, fido_credman_rk_t *rk, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
 
+/*
+ * Once a reply has been read, the authenticator is idle; if more entries are
+ * expected, ask for the next one before decoding this one so that the two
+ * overlap. On failure, the reply to that request is drained.
+ */
 static int
-credman_rx_next_rk(fido_dev_t *dev, fido_credman_rk_t *rk, int *ms)
+credman_rx_next_rk(fido_dev_t *dev, fido_credman_rk_t *rk, bool prefetch,
+    int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
+	bool		 pending = false;
 	int		 r;
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
 	}
 
+	if (prefetch) {
+		if ((r = credman_tx(dev, CMD_RK_NEXT, NULL, NULL, NULL,
+		    FIDO_OPT_FALSE, ms)) != FIDO_OK)
+			goto out;
+		pending = true;
+	}
+
 	/* sanity check */
 	if (rk->n_rx >= rk->n_alloc) {
 		fido_log_debug("%s: n_rx=%zu, n_alloc=%zu", __func__, rk->n_rx,
@@ -423,7 +453,41 @@ credman_rx_next_rk(fido_dev_t *dev, fido_credman_rk_t *rk, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	if (r != FIDO_OK && pending &&
+	    fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms) < 0)
+		fido_log_debug("%s: drain", __func__);
+
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
+
+	return (r);
+}
+
+static int
+credman_get_rk_dgst_wait(fido_dev_t *dev, const fido_blob_t *rp_dgst,
+    const char *rp_id, fido_credman_rk_t *rk, const char *pin, int *ms)
+{
+	int r;
+
+	fido_dev_lock_begin(dev, ms);
+	if ((r = credman_tx(dev, CMD_RK_BEGIN, rp_dgst, pin, rp_id,
+	    FIDO_OPT_TRUE, ms)) != FIDO_OK ||
+	    (r = credman_rx_rk(dev, rk, ms)) != FIDO_OK)
+		goto out;
+
+	if (rk->n_rx < rk->n_alloc && (r = credman_tx(dev, CMD_RK_NEXT, NULL,
+	    NULL, NULL, FIDO_OPT_FALSE, ms)) != FIDO_OK)
+		goto out;
+
+	while (rk->n_rx < rk->n_alloc) {
+		if ((r = credman_rx_next_rk(dev, rk,
+		    rk->n_rx + 1 < rk->n_alloc, ms)) != FIDO_OK)
+			goto out;
+		rk->n_rx++;
+	}
+
+	r = FIDO_OK;
+out:
+	fido_dev_lock_end(dev);
 
 	return (r);
 }
@@ -434,9 +498,8 @@ credman_get_rk_wait(fido_dev_t *dev, const char *rp_id, fido_credman_rk_t *rk,
 {
 	fido_blob_t	rp_dgst;
 	uint8_t		dgst[SHA256_DIGEST_LENGTH];
-	int		r;
 
-	if (SHA256((const unsigned char *)rp_id, strlen(rp_id), dgst) != dgst) {
+	if (fido_sha256_buf(rp_id, strlen(rp_id), dgst) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		return (FIDO_ERR_INTERNAL);
 	}
@@ -444,29 +507,21 @@ credman_get_rk_wait(fido_dev_t *dev, const char *rp_id, fido_credman_rk_t *rk,
 	rp_dgst.ptr = dgst;
 	rp_dgst.len = sizeof(dgst);
 
-	if ((r = credman_tx(dev, CMD_RK_BEGIN, &rp_dgst, pin, rp_id,
-	    FIDO_OPT_TRUE, ms)) != FIDO_OK ||
-	    (r = credman_rx_rk(dev, rk, ms)) != FIDO_OK)
-		return (r);
-
-	while (rk->n_rx < rk->n_alloc) {
-		if ((r = credman_tx(dev, CMD_RK_NEXT, NULL, NULL, NULL,
-		    FIDO_OPT_FALSE, ms)) != FIDO_OK ||
-		    (r = credman_rx_next_rk(dev, rk, ms)) != FIDO_OK)
-			return (r);
-		rk->n_rx++;
-	}
-
-	return (FIDO_OK);
+	return (credman_get_rk_dgst_wait(dev, &rp_dgst, rp_id, rk, pin, ms));
 }
 
 int
 fido_credman_get_dev_rk(fido_dev_t *dev, const char *rp_id,
     fido_credman_rk_t *rk, const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
 
-	return (credman_get_rk_wait(dev, rp_id, rk, pin, &ms));
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = credman_get_rk_wait(dev, rp_id, rk, pin, &ms);
+
+	return (fido_trace_end(&span, r));
 }
 
 static int
@@ -488,7 +543,7 @@ credman_del_rk_wait(fido_dev_t *dev, const unsigned char *cred_id,
 
 	r = FIDO_OK;
 fail:
-	free(cred.ptr);
+	fido_free(cred.ptr);
 
 	return (r);
 }
@@ -497,9 +552,14 @@ int
 fido_credman_del_dev_rk(fido_dev_t *dev, const unsigned char *cred_id,
     size_t cred_id_len, const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = credman_del_rk_wait(dev, cred_id, cred_id_len, pin, &ms);
 
-	return (credman_del_rk_wait(dev, cred_id, cred_id_len, pin, &ms));
+	return (fido_trace_end(&span, r));
 }
 
 static int
@@ -528,14 +588,14 @@ static void
 credman_reset_rp(fido_credman_rp_t *rp)
 {
 	for (size_t i = 0; i < rp->n_alloc; i++) {
-		free(rp->ptr[i].rp_entity.id);
-		free(rp->ptr[i].rp_entity.name);
+		fido_free(rp->ptr[i].rp_entity.id);
+		fido_free(rp->ptr[i].rp_entity.name);
 		rp->ptr[i].rp_entity.id = NULL;
 		rp->ptr[i].rp_entity.name = NULL;
 		fido_blob_reset(&rp->ptr[i].rp_id_hash);
 	}
 
-	free(rp->ptr);
+	fido_free(rp->ptr);
 	rp->ptr = NULL;
 	memset(rp, 0, sizeof(*rp));
 }
@@ -573,17 +633,18 @@ static int
 credman_rx_rp(fido_dev_t *dev, fido_credman_rp_t *rp, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
 	credman_reset_rp(rp);
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
@@ -612,29 +673,40 @@ credman_rx_rp(fido_dev_t *dev, fido_credman_rp_t *rp, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
 
 static int
-credman_rx_next_rp(fido_dev_t *dev, fido_credman_rp_t *rp, int *ms)
+credman_rx_next_rp(fido_dev_t *dev, fido_credman_rp_t *rp, bool prefetch,
+    int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
+	bool		 pending = false;
 	int		 r;
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
 	}
 
+	/* see credman_rx_next_rk() */
+	if (prefetch) {
+		if ((r = credman_tx(dev, CMD_RP_NEXT, NULL, NULL, NULL,
+		    FIDO_OPT_FALSE, ms)) != FIDO_OK)
+			goto out;
+		pending = true;
+	}
+
 	/* sanity check */
 	if (rp->n_rx >= rp->n_alloc) {
 		fido_log_debug("%s: n_rx=%zu, n_alloc=%zu", __func__, rp->n_rx,
@@ -651,7 +723,11 @@ credman_rx_next_rp(fido_dev_t *dev, fido_credman_rp_t *rp, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(msg, FIDO_MAXMSG);
+	if (r != FIDO_OK && pending &&
+	    fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms) < 0)
+		fido_log_debug("%s: drain", __func__);
+
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
@@ -662,28 +738,538 @@ credman_get_rp_wait(fido_dev_t *dev, fido_credman_rp_t *rp, const char *pin,
 {
 	int r;
 
+	fido_dev_lock_begin(dev, ms);
 	if ((r = credman_tx(dev, CMD_RP_BEGIN, NULL, pin, NULL,
 	    FIDO_OPT_TRUE, ms)) != FIDO_OK ||
 	    (r = credman_rx_rp(dev, rp, ms)) != FIDO_OK)
-		return (r);
+		goto out;
+
+	if (rp->n_rx < rp->n_alloc && (r = credman_tx(dev, CMD_RP_NEXT, NULL,
+	    NULL, NULL, FIDO_OPT_FALSE, ms)) != FIDO_OK)
+		goto out;
 
 	while (rp->n_rx < rp->n_alloc) {
-		if ((r = credman_tx(dev, CMD_RP_NEXT, NULL, NULL, NULL,
-		    FIDO_OPT_FALSE, ms)) != FIDO_OK ||
-		    (r = credman_rx_next_rp(dev, rp, ms)) != FIDO_OK)
-			return (r);
+		if ((r = credman_rx_next_rp(dev, rp,
+		    rp->n_rx + 1 < rp->n_alloc, ms)) != FIDO_OK)
+			goto out;
 		rp->n_rx++;
 	}
 
-	return (FIDO_OK);
+	r = FIDO_OK;
+out:
+	fido_dev_lock_end(dev);
+
+	return (r);
 }
 
 int
 fido_credman_get_dev_rp(fido_dev_t *dev, fido_credman_rp_t *rp, const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = credman_get_rp_wait(dev, rp, pin, &ms);
 
-	return (credman_get_rp_wait(dev, rp, pin, &ms));
+	return (fido_trace_end(&span, r));
+}
+
+/*
+ * Move the credentials in 'src' to the end of 'dst', tagging them with the
+ * relying party they belong to.
+ */
+static int
+credman_append_rk(fido_credman_rk_t *dst, fido_credman_rk_t *src,
+    const fido_rp_t *rp)
+{
+	fido_cred_t *new_ptr;
+
+	if (src->n_rx == 0)
+		return (0);
+	if (SIZE_MAX - dst->n_alloc < src->n_rx) {
+		fido_log_debug("%s: overflow", __func__);
+		return (-1);
+	}
+	if ((new_ptr = fido_recallocarray(dst->ptr, dst->n_alloc, dst->n_alloc +
+	    src->n_rx, sizeof(*dst->ptr))) == NULL)
+		return (-1);
+	dst->ptr = new_ptr;
+	dst->n_alloc += src->n_rx;
+
+	for (size_t i = 0; i < src->n_rx; i++) {
+		if (fido_cred_set_rp(&src->ptr[i], rp->id,
+		    rp->name) != FIDO_OK) {
+			fido_log_debug("%s: fido_cred_set_rp", __func__);
+			return (-1);
+		}
+		dst->ptr[dst->n_rx++] = src->ptr[i];
+		memset(&src->ptr[i], 0, sizeof(src->ptr[i]));
+	}
+
+	return (0);
+}
+
+/*
+ * Enumerate every relying party and its credentials. The PIN/UV auth token
+ * obtained for the first command is kept on the device for the remaining
+ * ones, as if fido_dev_set_token_cache() had been called.
+ */
+static int
+credman_get_rk_all_wait(fido_dev_t *dev, fido_credman_rp_t *rp,
+    fido_credman_rk_t *rk, const char *pin, int *ms)
+{
+	fido_credman_rk_t	 tmp;
+	bool			 cache = dev->token_cache;
+	int			 r;
+
+	memset(&tmp, 0, sizeof(tmp));
+	credman_reset_rk(rk);
+	dev->token_cache = true;
+	fido_dev_lock_begin(dev, ms);
+
+	if ((r = credman_get_rp_wait(dev, rp, pin, ms)) != FIDO_OK)
+		goto fail;
+
+	for (size_t i = 0; i < rp->n_rx; i++) {
+		/* no rp_id, so that the token stays valid for all of them */
+		if ((r = credman_get_rk_dgst_wait(dev, &rp->ptr[i].rp_id_hash,
+		    NULL, &tmp, pin, ms)) != FIDO_OK)
+			goto fail;
+		if (credman_append_rk(rk, &tmp, &rp->ptr[i].rp_entity) < 0) {
+			fido_log_debug("%s: credman_append_rk", __func__);
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+	}
+
+	r = FIDO_OK;
+fail:
+	if (!cache) {
+		fido_blob_free(&dev->token);
+		fido_blob_free(&dev->token_scope);
+	}
+	dev->token_cache = cache;
+	credman_reset_rk(&tmp);
+	fido_dev_lock_end(dev);
+
+	return (r);
+}
+
+int
+fido_credman_get_dev_rk_all(fido_dev_t *dev, fido_credman_rp_t *rp,
+    fido_credman_rk_t *rk, const char *pin)
+{
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = credman_get_rk_all_wait(dev, rp, rk, pin, &ms);
+
+	return (fido_trace_end(&span, r));
+}
+
+static int
+credman_parse_rk_total(const cbor_item_t *key, const cbor_item_t *val,
+    void *arg)
+{
+	uint64_t *n = arg;
+
+	/* totalCredentials */
+	if (cbor_isa_uint(key) == false ||
+	    cbor_int_get_width(key) != CBOR_INT_8 ||
+	    cbor_get_uint8(key) != 9) {
+		fido_log_debug("%s: cbor_type", __func__);
+		return (0); /* ignore */
+	}
+
+	if (cbor_decode_uint64(val, n) < 0) {
+		fido_log_debug("%s: cbor_decode_uint64", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+credman_iter_rx(fido_credman_iter_t *it, bool first, int *ms)
+{
+	const fido_rp_t	*rp = &it->rp.ptr[it->rp_idx - 1].rp_entity;
+	unsigned char	*msg;
+	size_t		 msgsiz = 0;
+	uint64_t	 n = 0;
+	int		 msglen;
+	int		 r;
+
+	fido_cred_reset_tx(&it->cred);
+	fido_cred_reset_rx(&it->cred);
+
+	if ((msg = fido_dev_msgbuf_get(it->dev, &msgsiz)) == NULL) {
+		r = FIDO_ERR_INTERNAL;
+		goto out;
+	}
+
+	if ((msglen = fido_rx(it->dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
+		fido_log_debug("%s: fido_rx", __func__);
+		r = FIDO_ERR_RX;
+		goto out;
+	}
+
+	if (first) {
+		if ((r = cbor_parse_reply(msg, (size_t)msglen, &n,
+		    credman_parse_rk_total)) != FIDO_OK) {
+			fido_log_debug("%s: credman_parse_rk_total", __func__);
+			goto out;
+		}
+		if (n > SIZE_MAX) {
+			fido_log_debug("%s: n > SIZE_MAX", __func__);
+			r = FIDO_ERR_INVALID_CBOR;
+			goto out;
+		}
+		it->n_rk = (size_t)n;
+		it->n_rx = 0;
+		if (it->n_rk == 0) {
+			fido_log_debug("%s: n_rk=0", __func__);
+			r = FIDO_OK;
+			goto out;
+		}
+	}
+
+	/* sanity check */
+	if (it->n_rx >= it->n_rk) {
+		fido_log_debug("%s: n_rx=%zu, n_rk=%zu", __func__, it->n_rx,
+		    it->n_rk);
+		r = FIDO_ERR_INTERNAL;
+		goto out;
+	}
+
+	if ((r = cbor_parse_reply(msg, (size_t)msglen, &it->cred,
+	    credman_parse_rk)) != FIDO_OK) {
+		fido_log_debug("%s: credman_parse_rk", __func__);
+		goto out;
+	}
+
+	if (fido_cred_set_rp(&it->cred, rp->id, rp->name) != FIDO_OK) {
+		fido_log_debug("%s: fido_cred_set_rp", __func__);
+		r = FIDO_ERR_INTERNAL;
+		goto out;
+	}
+
+	it->n_rx++;
+	it->fresh = true;
+
+	r = FIDO_OK;
+out:
+	fido_dev_msgbuf_put(it->dev, msg, msgsiz);
+
+	return (r);
+}
+
+static int
+credman_iter_next_rp(fido_credman_iter_t *it, int *ms)
+{
+	const struct fido_credman_single_rp *rp = &it->rp.ptr[it->rp_idx++];
+	int r;
+
+	if ((r = credman_tx(it->dev, CMD_RK_BEGIN, &rp->rp_id_hash, it->pin,
+	    it->scoped ? rp->rp_entity.id : NULL, FIDO_OPT_TRUE,
+	    ms)) != FIDO_OK ||
+	    (r = credman_iter_rx(it, true, ms)) != FIDO_OK)
+		return (r);
+
+	return (FIDO_OK);
+}
+
+static int
+credman_iter_next_rk(fido_credman_iter_t *it, int *ms)
+{
+	int r;
+
+	if ((r = credman_tx(it->dev, CMD_RK_NEXT, NULL, NULL, NULL,
+	    FIDO_OPT_FALSE, ms)) != FIDO_OK ||
+	    (r = credman_iter_rx(it, false, ms)) != FIDO_OK)
+		return (r);
+
+	return (FIDO_OK);
+}
+
+/*
+ * Set up 'it' to visit the resident credentials of 'rp_id' or, if NULL, of
+ * every relying party on the authenticator.
+ */
+static int
+credman_iter_setup(fido_dev_t *dev, fido_credman_iter_t *it, const char *rp_id,
+    const char *pin, int *ms)
+{
+	struct fido_credman_single_rp	*rp;
+	unsigned char			 dgst[SHA256_DIGEST_LENGTH];
+	int				 r;
+
+	if (pin != NULL && (it->pin = fido_strdup(pin)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	if (rp_id == NULL)
+		return (credman_get_rp_wait(dev, &it->rp, pin, ms));
+
+	if (fido_sha256_buf(rp_id, strlen(rp_id), dgst) < 0) {
+		fido_log_debug("%s: sha256", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+	if ((rp = fido_calloc(1, sizeof(*rp))) == NULL)
+		return (FIDO_ERR_INTERNAL);
+	it->rp.ptr = rp;
+	it->rp.n_alloc = it->rp.n_rx = 1;
+	it->scoped = true;
+
+	if ((rp->rp_entity.id = fido_strdup(rp_id)) == NULL ||
+	    fido_blob_set(&rp->rp_id_hash, dgst, sizeof(dgst)) < 0)
+		return (FIDO_ERR_INTERNAL);
+
+	/* fail early if the authenticator rejects the request */
+	if ((r = credman_iter_next_rp(it, ms)) != FIDO_OK)
+		return (r);
+
+	return (FIDO_OK);
+}
+
+int
+fido_credman_iter_begin(fido_dev_t *dev, fido_credman_iter_t *it,
+    const char *rp_id, const char *pin)
+{
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_credman_iter_end(it);
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+
+	it->dev = dev;
+	it->cache = dev->token_cache;
+	dev->token_cache = true;
+
+	if ((r = credman_iter_setup(dev, it, rp_id, pin, &ms)) != FIDO_OK)
+		fido_credman_iter_end(it);
+
+	return (fido_trace_end(&span, r));
+}
+
+int
+fido_credman_iter_next(fido_credman_iter_t *it, const fido_cred_t **cred)
+{
+	fido_trace_t span;
+	int ms;
+	int r;
+
+	*cred = NULL;
+
+	if (it->dev == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	ms = fido_time_budget(it->dev->timeout_ms);
+
+	for (;;) {
+		if (it->fresh) {
+			it->fresh = false;
+			*cred = &it->cred;
+			return (FIDO_OK);
+		}
+		if (it->n_rx >= it->n_rk && it->rp_idx >= it->rp.n_rx)
+			return (FIDO_OK); /* done */
+		fido_trace_begin(&span, it->dev, __func__, 0, 0, 0);
+		if (it->n_rx < it->n_rk)
+			r = credman_iter_next_rk(it, &ms);
+		else
+			r = credman_iter_next_rp(it, &ms);
+		if (fido_trace_end(&span, r) != FIDO_OK) {
+			fido_credman_iter_end(it);
+			return (r);
+		}
+	}
+}
+
+void
+fido_credman_iter_end(fido_credman_iter_t *it)
+{
+	fido_dev_t *dev;
+
+	if ((dev = it->dev) != NULL) {
+		if (!it->cache) {
+			fido_blob_free(&dev->token);
+			fido_blob_free(&dev->token_scope);
+		}
+		dev->token_cache = it->cache;
+	}
+	if (it->pin != NULL) {
+		explicit_bzero(it->pin, strlen(it->pin));
+		fido_free(it->pin);
+	}
+	credman_reset_rp(&it->rp);
+	fido_cred_reset_tx(&it->cred);
+	fido_cred_reset_rx(&it->cred);
+	memset(it, 0, sizeof(*it));
+}
+
+/*
+ * A credential management session: the relying parties are enumerated
+ * once, by fido_credman_session_begin(), and kept sorted by rp_id_hash.
+ * The credentials of a relying party are enumerated the first time they
+ * are looked up, and kept until the session ends. As with the iterator,
+ * the PIN/UV auth token is kept on the device for the whole session.
+ */
+static int
+credman_session_cmp(const void *a, const void *b)
+{
+	const struct fido_credman_single_rp *x = a, *y = b;
+	const size_t len = x->rp_id_hash.len;
+
+	if (len != y->rp_id_hash.len)
+		return (len < y->rp_id_hash.len ? -1 : 1);
+
+	return (len ? memcmp(x->rp_id_hash.ptr, y->rp_id_hash.ptr, len) : 0);
+}
+
+static int
+credman_session_setup(fido_dev_t *dev, fido_credman_session_t *s,
+    const char *pin, int *ms)
+{
+	int r;
+
+	if (pin != NULL && (s->pin = fido_strdup(pin)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	if ((r = credman_get_rp_wait(dev, &s->rp, pin, ms)) != FIDO_OK)
+		return (r);
+
+	if (s->rp.n_rx == 0)
+		return (FIDO_OK);
+	if ((s->rk = fido_calloc(s->rp.n_rx, sizeof(*s->rk))) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	qsort(s->rp.ptr, s->rp.n_rx, sizeof(*s->rp.ptr), credman_session_cmp);
+
+	return (FIDO_OK);
+}
+
+int
+fido_credman_session_begin(fido_dev_t *dev, fido_credman_session_t *s,
+    const char *pin)
+{
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_credman_session_end(s);
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+
+	s->dev = dev;
+	s->cache = dev->token_cache;
+	dev->token_cache = true;
+
+	if ((r = credman_session_setup(dev, s, pin, &ms)) != FIDO_OK)
+		fido_credman_session_end(s);
+
+	return (fido_trace_end(&span, r));
+}
+
+static int
+credman_session_fetch(fido_credman_session_t *s, size_t idx, int *ms)
+{
+	const struct fido_credman_single_rp	*rp = &s->rp.ptr[idx];
+	fido_credman_rk_t			*rk;
+	int					 r;
+
+	if ((rk = fido_credman_rk_new()) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	/* no rp_id, so that the token stays valid for all of them */
+	if ((r = credman_get_rk_dgst_wait(s->dev, &rp->rp_id_hash, NULL, rk,
+	    s->pin, ms)) != FIDO_OK)
+		goto fail;
+
+	for (size_t i = 0; i < rk->n_rx; i++)
+		if (fido_cred_set_rp(&rk->ptr[i], rp->rp_entity.id,
+		    rp->rp_entity.name) != FIDO_OK) {
+			fido_log_debug("%s: fido_cred_set_rp", __func__);
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+
+	s->rk[idx] = rk;
+
+	return (FIDO_OK);
+fail:
+	fido_credman_rk_free(&rk);
+
+	return (r);
+}
+
+int
+fido_credman_session_rk(fido_credman_session_t *s,
+    const unsigned char *rp_id_hash_ptr, size_t rp_id_hash_len,
+    const fido_credman_rk_t **rk)
+{
+	struct fido_credman_single_rp	 key, *rp;
+	fido_trace_t			 span;
+	size_t				 idx;
+	int				 ms;
+	int				 r;
+
+	*rk = NULL;
+
+	if (s->dev == NULL || rp_id_hash_ptr == NULL || rp_id_hash_len == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	memset(&key, 0, sizeof(key));
+	key.rp_id_hash.ptr = (unsigned char *)(uintptr_t)rp_id_hash_ptr;
+	key.rp_id_hash.len = rp_id_hash_len;
+
+	if (s->rp.n_rx == 0 || (rp = bsearch(&key, s->rp.ptr, s->rp.n_rx,
+	    sizeof(*s->rp.ptr), credman_session_cmp)) == NULL)
+		return (FIDO_ERR_NO_CREDENTIALS);
+
+	if (s->rk[(idx = (size_t)(rp - s->rp.ptr))] == NULL) {
+		ms = fido_time_budget(s->dev->timeout_ms);
+		fido_trace_begin(&span, s->dev, __func__, 0, 0, 0);
+		r = credman_session_fetch(s, idx, &ms);
+		if (fido_trace_end(&span, r) != FIDO_OK)
+			return (r);
+	}
+
+	*rk = s->rk[idx];
+
+	return (FIDO_OK);
+}
+
+const fido_credman_rp_t *
+fido_credman_session_rp(const fido_credman_session_t *s)
+{
+	return (&s->rp);
+}
+
+void
+fido_credman_session_end(fido_credman_session_t *s)
+{
+	fido_dev_t *dev;
+
+	if ((dev = s->dev) != NULL) {
+		if (!s->cache) {
+			fido_blob_free(&dev->token);
+			fido_blob_free(&dev->token_scope);
+		}
+		dev->token_cache = s->cache;
+	}
+	if (s->pin != NULL) {
+		explicit_bzero(s->pin, strlen(s->pin));
+		fido_free(s->pin);
+	}
+	if (s->rk != NULL) {
+		for (size_t i = 0; i < s->rp.n_rx; i++)
+			fido_credman_rk_free(&s->rk[i]);
+		fido_free(s->rk);
+	}
+	credman_reset_rp(&s->rp);
+	memset(s, 0, sizeof(*s));
 }
 
 static int
@@ -703,15 +1289,120 @@ credman_set_dev_rk_wait(fido_dev_t *dev, fido_cred_t *cred, const char *pin,
 int
 fido_credman_set_dev_rk(fido_dev_t *dev, fido_cred_t *cred, const char *pin)
 {
-	int ms = dev->timeout_ms;
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = credman_set_dev_rk_wait(dev, cred, pin, &ms);
+
+	return (fido_trace_end(&span, r));
+}
+
+/* errors specific to an item, after which a batch carries on */
+static bool
+credman_batch_item_error(int r)
+{
+	return (r == FIDO_ERR_INVALID_ARGUMENT || r == FIDO_ERR_NO_CREDENTIALS);
+}
+
+/*
+ * Apply 'subcmd' to each of the 'n' items in 'v'. The PIN/UV auth token
+ * obtained for the first item is kept on the device for the others, as if
+ * fido_dev_set_token_cache() had been called, and the key agreement is
+ * reused; each item then costs a single request. An error specific to an
+ * item is stored in it and the batch carries on; any other error ends the
+ * batch, and is stored in the items not yet applied.
+ */
+static int
+credman_batch_wait(fido_dev_t *dev, uint8_t subcmd, fido_credman_rk_item_t *v,
+    size_t n, const char *pin, int *ms)
+{
+	fido_blob_t	 id;
+	const void	*param;
+	bool		 cache = dev->token_cache;
+	size_t		 i;
+	int		 r = FIDO_OK;
+	int		 first = FIDO_OK;
+
+	memset(&id, 0, sizeof(id));
+	dev->token_cache = true;
+	fido_dev_lock_begin(dev, ms);
+
+	for (i = 0; i < n; i++) {
+		if (subcmd == CMD_DELETE_CRED) {
+			if (fido_blob_set(&id, v[i].cred_ptr,
+			    v[i].cred_len) < 0)
+				param = NULL;
+			else
+				param = &id;
+		} else
+			param = v[i].cred;
+		if (param == NULL)
+			r = FIDO_ERR_INVALID_ARGUMENT;
+		else if ((r = credman_tx(dev, subcmd, param, pin, NULL,
+		    FIDO_OPT_TRUE, ms)) == FIDO_OK)
+			r = fido_rx_cbor_status(dev, ms);
+		if ((v[i].r = r) != FIDO_OK) {
+			fido_log_debug("%s: item %zu: %d", __func__, i, r);
+			if (first == FIDO_OK)
+				first = r;
+			if (!credman_batch_item_error(r))
+				break;
+		}
+	}
+	while (++i < n)
+		v[i].r = r;
+
+	if (!cache) {
+		fido_blob_free(&dev->token);
+		fido_blob_free(&dev->token_scope);
+	}
+	dev->token_cache = cache;
+	fido_dev_lock_end(dev);
+	fido_free(id.ptr);
+
+	return (first);
+}
+
+int
+fido_credman_del_dev_rk_batch(fido_dev_t *dev, fido_credman_rk_item_t *v,
+    size_t n, const char *pin)
+{
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	if (v == NULL && n != 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = credman_batch_wait(dev, CMD_DELETE_CRED, v, n, pin, &ms);
 
-	return (credman_set_dev_rk_wait(dev, cred, pin, &ms));
+	return (fido_trace_end(&span, r));
+}
+
+int
+fido_credman_set_dev_rk_batch(fido_dev_t *dev, fido_credman_rk_item_t *v,
+    size_t n, const char *pin)
+{
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	if (v == NULL && n != 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	r = credman_batch_wait(dev, CMD_UPDATE_CRED, v, n, pin, &ms);
+
+	return (fido_trace_end(&span, r));
 }
 
 fido_credman_rk_t *
 fido_credman_rk_new(void)
 {
-	return (calloc(1, sizeof(fido_credman_rk_t)));
+	return (fido_calloc(1, sizeof(fido_credman_rk_t)));
 }
 
 void
@@ -723,7 +1414,7 @@ fido_credman_rk_free(fido_credman_rk_t **rk_p)
 		return;
 
 	credman_reset_rk(rk);
-	free(rk);
+	fido_free(rk);
 	*rk_p = NULL;
 }
 
@@ -742,10 +1433,48 @@ fido_credman_rk(const fido_credman_rk_t *rk, size_t idx)
 	return (&rk->ptr[idx]);
 }
 
+fido_credman_iter_t *
+fido_credman_iter_new(void)
+{
+	return (fido_calloc(1, sizeof(fido_credman_iter_t)));
+}
+
+void
+fido_credman_iter_free(fido_credman_iter_t **it_p)
+{
+	fido_credman_iter_t *it;
+
+	if (it_p == NULL || (it = *it_p) == NULL)
+		return;
+
+	fido_credman_iter_end(it);
+	fido_free(it);
+	*it_p = NULL;
+}
+
+fido_credman_session_t *
+fido_credman_session_new(void)
+{
+	return (fido_calloc(1, sizeof(fido_credman_session_t)));
+}
+
+void
+fido_credman_session_free(fido_credman_session_t **s_p)
+{
+	fido_credman_session_t *s;
+
+	if (s_p == NULL || (s = *s_p) == NULL)
+		return;
+
+	fido_credman_session_end(s);
+	fido_free(s);
+	*s_p = NULL;
+}
+
 fido_credman_metadata_t *
 fido_credman_metadata_new(void)
 {
-	return (calloc(1, sizeof(fido_credman_metadata_t)));
+	return (fido_calloc(1, sizeof(fido_credman_metadata_t)));
 }
 
 void
@@ -756,7 +1485,7 @@ fido_credman_metadata_free(fido_credman_metadata_t **metadata_p)
 	if (metadata_p == NULL || (metadata = *metadata_p) == NULL)
 		return;
 
-	free(metadata);
+	fido_free(metadata);
 	*metadata_p = NULL;
 }
 
@@ -775,7 +1504,7 @@ fido_credman_rk_remaining(const fido_credman_metadata_t *metadata)
 fido_credman_rp_t *
 fido_credman_rp_new(void)
 {
-	return (calloc(1, sizeof(fido_credman_rp_t)));
+	return (fido_calloc(1, sizeof(fido_credman_rp_t)));
 }
 
 void
@@ -787,7 +1516,7 @@ fido_credman_rp_free(fido_credman_rp_t **rp_p)
 		return;
 
 	credman_reset_rp(rp);
-	free(rp);
+	fido_free(rp);
 	*rp_p = NULL;
 }
 
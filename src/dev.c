@@ -6,12 +6,58 @@
  */
 
 #include "fido.h"
+#include "fido/es256.h"
 
 #ifndef TLS
 #define TLS
 #endif
 
 static TLS bool disable_u2f_fallback;
+static TLS bool channel_cache;
+static TLS bool defer_getinfo;
+static TLS int manifest_skip;
+
+#define CHANNEL_CACHE_LEN	8
+#define CHANNEL_PATH_MAX	256
+#define LOCK_MAXSECS		10	/* ctaphid */
+#define QUIRK_TAB_LEN		32
+
+/*
+ * CTAPHID channels and device capabilities remembered across
+ * fido_dev_close() and fido_dev_open(), keyed by device path. With
+ * FIDO_INFO_CACHE, the getInfo reply is restored from its template.
+ */
+struct channel {
+	char			path[CHANNEL_PATH_MAX];
+	fido_ctap_info_t	attr;
+	uint32_t		cid;
+	int			flags;
+	uint64_t		maxmsgsize;
+	bool			info;
+	unsigned char		aaguid[16];
+	uint64_t		fwversion;
+};
+
+static TLS struct channel channel_tab[CHANNEL_CACHE_LEN];
+static TLS size_t channel_next;
+
+/*
+ * Protocol quirks keyed by USB vendor and product ID, applied when a
+ * device allocated with fido_dev_new_with_info() is opened. Entries are
+ * set by fido_set_quirk(), or recorded when a device claiming CTAP2
+ * fails authenticatorGetInfo and falls back to U2F; a recorded entry
+ * may be evicted, one that was set may not.
+ */
+struct quirk {
+	int16_t	vendor;
+	int16_t	product;
+	int	quirk;
+	bool	used;
+	bool	pinned;	/* set by fido_set_quirk() */
+};
+
+static TLS struct quirk quirk_tab[QUIRK_TAB_LEN];
+static TLS size_t quirk_next;
 
 #ifdef FIDO_FUZZ
 static void
@@ -38,30 +84,24 @@ fido_dev_set_extension_flags(fido_dev_t *dev, const fido_cbor_info_t *info)
 static void
 fido_dev_set_option_flags(fido_dev_t *dev, const fido_cbor_info_t *info)
 {
-	char * const	*ptr = fido_cbor_info_options_name_ptr(info);
-	const bool	*val = fido_cbor_info_options_value_ptr(info);
-	size_t		 len = fido_cbor_info_options_len(info);
-
-	for (size_t i = 0; i < len; i++)
-		if (strcmp(ptr[i], "clientPin") == 0) {
-			dev->flags |= val[i] ?
-			    FIDO_DEV_PIN_SET : FIDO_DEV_PIN_UNSET;
-		} else if (strcmp(ptr[i], "credMgmt") == 0) {
-			if (val[i])
-				dev->flags |= FIDO_DEV_CREDMAN;
-		} else if (strcmp(ptr[i], "credentialMgmtPreview") == 0) {
-			if (val[i])
-				dev->flags |= FIDO_DEV_CREDMAN_PRE;
-		} else if (strcmp(ptr[i], "uv") == 0) {
-			dev->flags |= val[i] ?
-			    FIDO_DEV_UV_SET : FIDO_DEV_UV_UNSET;
-		} else if (strcmp(ptr[i], "pinUvAuthToken") == 0) {
-			if (val[i])
-				dev->flags |= FIDO_DEV_TOKEN_PERMS;
-		} else if (strcmp(ptr[i], "bioEnroll") == 0) {
-			dev->flags |= val[i] ?
-			    FIDO_DEV_BIO_SET : FIDO_DEV_BIO_UNSET;
-		}
+	const uint64_t	set = info->opt_present;
+	const uint64_t	on = info->opt_true;
+
+	if (set & FIDO_INFO_OPT_PIN)
+		dev->flags |= (on & FIDO_INFO_OPT_PIN) ?
+		    FIDO_DEV_PIN_SET : FIDO_DEV_PIN_UNSET;
+	if (on & FIDO_INFO_OPT_CREDMAN)
+		dev->flags |= FIDO_DEV_CREDMAN;
+	if (on & FIDO_INFO_OPT_CM_PRE)
+		dev->flags |= FIDO_DEV_CREDMAN_PRE;
+	if (set & FIDO_INFO_OPT_UV)
+		dev->flags |= (on & FIDO_INFO_OPT_UV) ?
+		    FIDO_DEV_UV_SET : FIDO_DEV_UV_UNSET;
+	if (on & FIDO_INFO_OPT_TOKEN)
+		dev->flags |= FIDO_DEV_TOKEN_PERMS;
+	if (set & FIDO_INFO_OPT_BIO)
+		dev->flags |= (on & FIDO_INFO_OPT_BIO) ?
+		    FIDO_DEV_BIO_SET : FIDO_DEV_BIO_UNSET;
 }
 
 static void
@@ -93,39 +133,168 @@ fido_dev_set_flags(fido_dev_t *dev, const fido_cbor_info_t *info)
 	fido_dev_set_protocol_flags(dev, info);
 }
 
-static int
-fido_dev_open_tx(fido_dev_t *dev, const char *path, int *ms)
+static bool
+channel_cacheable(const fido_dev_t *dev, const char *path)
 {
-	int r;
+	return (channel_cache && dev->transport.tx == NULL &&
+	    dev->transport.rx == NULL && dev->io_attach == NULL &&
+	    strlen(path) < CHANNEL_PATH_MAX);
+}
 
-	if (dev->io_handle != NULL) {
-		fido_log_debug("%s: handle=%p", __func__, dev->io_handle);
-		return (FIDO_ERR_INVALID_ARGUMENT);
+static struct channel *
+channel_lookup(const char *path)
+{
+	for (size_t i = 0; i < CHANNEL_CACHE_LEN; i++)
+		if (channel_tab[i].path[0] != '\0' &&
+		    strcmp(channel_tab[i].path, path) == 0)
+			return (&channel_tab[i]);
+
+	return (NULL);
+}
+
+static void
+channel_store(const fido_dev_t *dev, const char *path)
+{
+	struct channel *c;
+
+	if ((c = channel_lookup(path)) == NULL) {
+		c = &channel_tab[channel_next];
+		channel_next = (channel_next + 1) % CHANNEL_CACHE_LEN;
 	}
 
-	if (dev->io.open == NULL || dev->io.close == NULL) {
-		fido_log_debug("%s: NULL open/close", __func__);
-		return (FIDO_ERR_INVALID_ARGUMENT);
+	memset(c, 0, sizeof(*c));
+	memcpy(c->path, path, strlen(path));
+	c->attr = dev->attr;
+	c->cid = dev->cid;
+	c->flags = dev->flags;
+	c->maxmsgsize = dev->maxmsgsize;
+	if (dev->info != NULL) {
+		c->info = true;
+		memcpy(c->aaguid, dev->info->aaguid, sizeof(c->aaguid));
+		c->fwversion = dev->info->fwversion;
 	}
+}
 
-	if (dev->cid != CTAP_CID_BROADCAST) {
-		fido_log_debug("%s: cid=0x%x", __func__, dev->cid);
-		return (FIDO_ERR_INVALID_ARGUMENT);
+static void
+channel_flush(void)
+{
+	explicit_bzero(channel_tab, sizeof(channel_tab));
+	channel_next = 0;
+}
+
+static struct quirk *
+quirk_find(int16_t vendor, int16_t product)
+{
+	for (size_t i = 0; i < QUIRK_TAB_LEN; i++)
+		if (quirk_tab[i].used && quirk_tab[i].vendor == vendor &&
+		    quirk_tab[i].product == product)
+			return (&quirk_tab[i]);
+
+	return (NULL);
+}
+
+/* a free slot, or the next unpinned one */
+static struct quirk *
+quirk_slot(void)
+{
+	struct quirk *q;
+
+	for (size_t i = 0; i < QUIRK_TAB_LEN; i++)
+		if (!quirk_tab[i].used)
+			return (&quirk_tab[i]);
+	for (size_t i = 0; i < QUIRK_TAB_LEN; i++) {
+		q = &quirk_tab[quirk_next++ % QUIRK_TAB_LEN];
+		if (!q->pinned)
+			return (q);
+	}
+
+	return (NULL);
+}
+
+static int
+quirk_get(const fido_dev_t *dev)
+{
+	const struct quirk *q;
+
+	if ((dev->vendor_id == 0 && dev->product_id == 0) ||
+	    (q = quirk_find(dev->vendor_id, dev->product_id)) == NULL)
+		return (FIDO_QUIRK_NONE);
+
+	return (q->quirk);
+}
+
+static void
+quirk_record(const fido_dev_t *dev)
+{
+	struct quirk *q;
+
+	if (dev->vendor_id == 0 && dev->product_id == 0)
+		return;
+	if ((q = quirk_find(dev->vendor_id, dev->product_id)) != NULL) {
+		if (!q->pinned)
+			q->quirk = FIDO_QUIRK_U2F;
+		return;
 	}
+	if ((q = quirk_slot()) == NULL)
+		return;
 
-	if (fido_get_random(&dev->nonce, sizeof(dev->nonce)) < 0) {
-		fido_log_debug("%s: fido_get_random", __func__);
+	fido_log_debug("%s: 0x%04x:0x%04x", __func__,
+	    (uint16_t)dev->vendor_id, (uint16_t)dev->product_id);
+	q->vendor = dev->vendor_id;
+	q->product = dev->product_id;
+	q->quirk = FIDO_QUIRK_U2F;
+	q->used = true;
+	q->pinned = false;
+}
+
+int
+fido_set_quirk(int16_t vendor, int16_t product, int quirk)
+{
+	struct quirk *q;
+
+	if (quirk != FIDO_QUIRK_NONE && quirk != FIDO_QUIRK_U2F)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if ((q = quirk_find(vendor, product)) == NULL &&
+	    (q = quirk_slot()) == NULL) {
+		fido_log_debug("%s: table full", __func__);
 		return (FIDO_ERR_INTERNAL);
 	}
 
-	if ((dev->io_handle = dev->io.open(path)) == NULL) {
+	q->vendor = vendor;
+	q->product = product;
+	q->quirk = quirk;
+	q->used = true;
+	q->pinned = true;
+
+	return (FIDO_OK);
+}
+
+void
+fido_dev_invalidate_channel(const fido_dev_t *dev)
+{
+	for (size_t i = 0; i < CHANNEL_CACHE_LEN; i++)
+		if (channel_tab[i].path[0] != '\0' &&
+		    channel_tab[i].cid == dev->cid) {
+			fido_log_debug("%s: %s", __func__, channel_tab[i].path);
+			explicit_bzero(&channel_tab[i], sizeof(channel_tab[i]));
+		}
+}
+
+static int
+fido_dev_open_io(fido_dev_t *dev, const char *path)
+{
+	if (dev->io_attach != NULL) {
+		/* see fido_broker_attach() */
+		dev->io_handle = dev->io_attach;
+		dev->io_attach = NULL;
+	} else if ((dev->io_handle = dev->io.open(path)) == NULL) {
 		fido_log_debug("%s: dev->io.open", __func__);
 		return (FIDO_ERR_INTERNAL);
 	}
 
 	if (dev->io_own) {
-		dev->rx_len = CTAP_MAX_REPORT_LEN;
-		dev->tx_len = CTAP_MAX_REPORT_LEN;
+		dev->rx_len = CTAP_DEF_REPORT_LEN;
+		dev->tx_len = CTAP_DEF_REPORT_LEN;
 	} else {
 		dev->rx_len = fido_hid_report_in_len(dev->io_handle);
 		dev->tx_len = fido_hid_report_out_len(dev->io_handle);
@@ -138,15 +307,50 @@ fido_dev_open_tx(fido_dev_t *dev, const char *path, int *ms)
 	if (dev->rx_len < CTAP_MIN_REPORT_LEN ||
 	    dev->rx_len > CTAP_MAX_REPORT_LEN) {
 		fido_log_debug("%s: invalid rx_len %zu", __func__, dev->rx_len);
-		r = FIDO_ERR_RX;
-		goto fail;
+		dev->io.close(dev->io_handle);
+		dev->io_handle = NULL;
+		return (FIDO_ERR_RX);
 	}
 
 	if (dev->tx_len < CTAP_MIN_REPORT_LEN ||
 	    dev->tx_len > CTAP_MAX_REPORT_LEN) {
 		fido_log_debug("%s: invalid tx_len %zu", __func__, dev->tx_len);
-		r = FIDO_ERR_TX;
-		goto fail;
+		dev->io.close(dev->io_handle);
+		dev->io_handle = NULL;
+		return (FIDO_ERR_TX);
+	}
+
+	return (FIDO_OK);
+}
+
+static int
+fido_dev_open_tx(fido_dev_t *dev, const char *path, int *ms)
+{
+	int r;
+
+	if (dev->io_handle != NULL) {
+		fido_log_debug("%s: handle=%p", __func__, dev->io_handle);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	if (dev->io.open == NULL || dev->io.close == NULL) {
+		fido_log_debug("%s: NULL open/close", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	if (dev->cid != CTAP_CID_BROADCAST) {
+		fido_log_debug("%s: cid=0x%x", __func__, dev->cid);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	if (fido_get_nonce(&dev->nonce, sizeof(dev->nonce)) < 0) {
+		fido_log_debug("%s: fido_get_nonce", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	if ((r = fido_dev_open_io(dev, path)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_open_io", __func__);
+		return (r);
 	}
 
 	if (fido_tx(dev, CTAP_CMD_INIT, &dev->nonce, sizeof(dev->nonce),
@@ -165,17 +369,68 @@ fail:
 }
 
 static int
-fido_dev_open_rx(fido_dev_t *dev, int *ms)
+fido_dev_set_info(fido_dev_t *dev, fido_cbor_info_t *info, int r)
 {
-	fido_cbor_info_t	*info = NULL;
-	int			 reply_len;
-	int			 r;
+	if (r != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_cbor_info_wait: %d", __func__, r);
+		fido_cbor_info_free(&info);
+		if (disable_u2f_fallback || !FIDO_HAVE_U2F)
+			return (r);
+		fido_log_debug("%s: falling back to u2f", __func__);
+		fido_dev_force_u2f(dev);
+		quirk_record(dev);
+		return (FIDO_OK);
+	}
+
+	fido_dev_set_flags(dev, info);
+	dev->maxmsgsize = fido_cbor_info_maxmsgsiz(info);
+	fido_log_debug("%s: FIDO_MAXMSG=%d, maxmsgsiz=%lu", __func__,
+	    FIDO_MAXMSG, (unsigned long)dev->maxmsgsize);
+	fido_cbor_info_free(&dev->info);
+	dev->info = info;
+
+	return (FIDO_OK);
+}
+
+static int
+fido_dev_get_info(fido_dev_t *dev, int *ms)
+{
+	fido_cbor_info_t *info;
+
+	if ((info = fido_cbor_info_new()) == NULL) {
+		fido_log_debug("%s: fido_cbor_info_new", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	return (fido_dev_set_info(dev, info,
+	    fido_dev_get_cbor_info_wait(dev, info, ms)));
+}
+
+int
+fido_dev_get_deferred_info(fido_dev_t *dev, int *ms)
+{
+	int r;
+
+	if ((dev->flags & FIDO_DEV_INFO_PENDING) == 0)
+		return (FIDO_OK);
+
+	dev->flags &= ~FIDO_DEV_INFO_PENDING;
+
+	if ((r = fido_dev_get_info(dev, ms)) != FIDO_OK)
+		dev->flags |= FIDO_DEV_INFO_PENDING;
+
+	return (r);
+}
+
+static int
+fido_dev_open_rx_init(fido_dev_t *dev, int *ms)
+{
+	int reply_len;
 
 	if ((reply_len = fido_rx(dev, CTAP_CMD_INIT, &dev->attr,
 	    sizeof(dev->attr), ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
-		r = FIDO_ERR_RX;
-		goto fail;
+		return (FIDO_ERR_RX);
 	}
 
 #ifdef FIDO_FUZZ
@@ -185,73 +440,126 @@ fido_dev_open_rx(fido_dev_t *dev, int *ms)
 	if ((size_t)reply_len != sizeof(dev->attr) ||
 	    dev->attr.nonce != dev->nonce) {
 		fido_log_debug("%s: invalid nonce", __func__);
-		r = FIDO_ERR_RX;
-		goto fail;
+		return (FIDO_ERR_RX);
 	}
 
 	dev->flags = 0;
 	dev->cid = dev->attr.cid;
 
-	if (fido_dev_is_fido2(dev)) {
-		if ((info = fido_cbor_info_new()) == NULL) {
-			fido_log_debug("%s: fido_cbor_info_new", __func__);
-			r = FIDO_ERR_INTERNAL;
-			goto fail;
-		}
-		if ((r = fido_dev_get_cbor_info_wait(dev, info,
-		    ms)) != FIDO_OK) {
-			fido_log_debug("%s: fido_dev_cbor_info_wait: %d",
-			    __func__, r);
-			if (disable_u2f_fallback)
-				goto fail;
-			fido_log_debug("%s: falling back to u2f", __func__);
-			fido_dev_force_u2f(dev);
-		} else {
-			fido_dev_set_flags(dev, info);
-		}
+	if (fido_dev_is_fido2(dev) && quirk_get(dev) == FIDO_QUIRK_U2F) {
+		fido_log_debug("%s: quirk: u2f", __func__);
+		fido_dev_force_u2f(dev);
+	}
+
+	if (fido_dev_is_fido2(dev) && defer_getinfo)
+		dev->flags |= FIDO_DEV_INFO_PENDING;
+
+	return (FIDO_OK);
+}
+
+static void
+fido_dev_open_abort(fido_dev_t *dev)
+{
+	if (dev->chan == NULL)
+		dev->io.close(dev->io_handle);
+	else
+		fido_chan_detach(dev); /* a channel; the handle is shared */
+	dev->io_handle = NULL;
+}
+
+static int
+fido_dev_open_rx(fido_dev_t *dev, int *ms)
+{
+	int r;
+
+	if ((r = fido_dev_open_rx_init(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_open_rx_init", __func__);
+		goto fail;
 	}
 
-	if (fido_dev_is_fido2(dev) && info != NULL) {
-		dev->maxmsgsize = fido_cbor_info_maxmsgsiz(info);
-		fido_log_debug("%s: FIDO_MAXMSG=%d, maxmsgsiz=%lu", __func__,
-		    FIDO_MAXMSG, (unsigned long)dev->maxmsgsize);
+	if (fido_dev_is_fido2(dev) && !(dev->flags & FIDO_DEV_INFO_PENDING) &&
+	    (r = fido_dev_get_info(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_info", __func__);
+		goto fail;
 	}
 
 	r = FIDO_OK;
 fail:
-	fido_cbor_info_free(&info);
+	if (r != FIDO_OK)
+		fido_dev_open_abort(dev);
 
-	if (r != FIDO_OK) {
-		dev->io.close(dev->io_handle);
-		dev->io_handle = NULL;
+	return (r);
+}
+
+static int
+fido_dev_open_cached(fido_dev_t *dev, struct channel *c, const char *path)
+{
+	int r;
+
+	if (dev->io_handle != NULL || dev->io.open == NULL ||
+	    dev->io.close == NULL || dev->cid != CTAP_CID_BROADCAST) {
+		fido_log_debug("%s: invalid argument", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
-	return (r);
+	if ((r = fido_dev_open_io(dev, path)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_open_io", __func__);
+		explicit_bzero(c, sizeof(*c)); /* device gone? */
+		return (r);
+	}
+
+	dev->nonce = c->attr.nonce;
+	dev->attr = c->attr;
+	dev->cid = c->cid;
+	dev->flags = c->flags;
+	dev->maxmsgsize = c->maxmsgsize;
+	if (c->info)
+		dev->info = fido_cbor_info_cache_get(c->aaguid, c->fwversion);
+
+	return (FIDO_OK);
 }
 
 static int
 fido_dev_open_wait(fido_dev_t *dev, const char *path, int *ms)
 {
-	int r;
+	struct channel	*c;
+	int		 r;
 
 #ifdef USE_WINHELLO
 	if (strcmp(path, FIDO_WINHELLO_PATH) == 0)
 		return (fido_winhello_open(dev));
 #endif
+	if (channel_cacheable(dev, path) && (c = channel_lookup(path)) != NULL)
+		return (fido_dev_open_cached(dev, c, path));
+
 	if ((r = fido_dev_open_tx(dev, path, ms)) != FIDO_OK ||
 	    (r = fido_dev_open_rx(dev, ms)) != FIDO_OK)
 		return (r);
 
+	if (channel_cacheable(dev, path))
+		channel_store(dev, path);
+
 	return (FIDO_OK);
 }
 
+bool
+fido_manifest_disabled(int flag)
+{
+	return ((manifest_skip & flag) != 0);
+}
+
 static void
 run_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen,
-    const char *type, int (*manifest)(fido_dev_info_t *, size_t, size_t *))
+    const char *type, int flag,
+    int (*manifest)(fido_dev_info_t *, size_t, size_t *))
 {
 	size_t ndevs = 0;
 	int r;
 
+	if (fido_manifest_disabled(flag)) {
+		fido_log_debug("%s: %s disabled", __func__, type);
+		return;
+	}
 	if (*olen >= ilen) {
 		fido_log_debug("%s: skipping %s", __func__, type);
 		return;
@@ -268,15 +576,19 @@ fido_dev_info_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 {
 	*olen = 0;
 
-	run_manifest(devlist, ilen, olen, "hid", fido_hid_manifest);
+	run_manifest(devlist, ilen, olen, "hid", FIDO_MANIFEST_NO_HID,
+	    fido_hid_manifest);
 #ifdef USE_NFC
-	run_manifest(devlist, ilen, olen, "nfc", fido_nfc_manifest);
+	run_manifest(devlist, ilen, olen, "nfc", FIDO_MANIFEST_NO_NFC,
+	    fido_nfc_manifest);
 #endif
 #ifdef USE_PCSC
-	run_manifest(devlist, ilen, olen, "pcsc", fido_pcsc_manifest);
+	run_manifest(devlist, ilen, olen, "pcsc", FIDO_MANIFEST_NO_PCSC,
+	    fido_pcsc_manifest);
 #endif
 #ifdef USE_WINHELLO
-	run_manifest(devlist, ilen, olen, "winhello", fido_winhello_manifest);
+	run_manifest(devlist, ilen, olen, "winhello",
+	    FIDO_MANIFEST_NO_WINHELLO, fido_winhello_manifest);
 #endif
 
 	return (FIDO_OK);
@@ -285,7 +597,7 @@ fido_dev_info_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 int
 fido_dev_open_with_info(fido_dev_t *dev)
 {
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 
 	if (dev->path == NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
@@ -293,10 +605,148 @@ fido_dev_open_with_info(fido_dev_t *dev)
 	return (fido_dev_open_wait(dev, dev->path, &ms));
 }
 
+static int
+fido_dev_open_many_tx(fido_dev_t *dev, int *ms, bool *done)
+{
+	struct channel	*c;
+	int		 r;
+
+	*done = true;
+
+	if (dev == NULL || dev->path == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+#ifdef USE_WINHELLO
+	if (strcmp(dev->path, FIDO_WINHELLO_PATH) == 0)
+		return (fido_winhello_open(dev));
+#endif
+	if (channel_cacheable(dev, dev->path) &&
+	    (c = channel_lookup(dev->path)) != NULL)
+		return (fido_dev_open_cached(dev, c, dev->path));
+
+	if ((r = fido_dev_open_tx(dev, dev->path, ms)) == FIDO_OK)
+		*done = false;
+
+	return (r);
+}
+
+static int
+fido_dev_open_many_rx(fido_dev_t *dev, int *ms, bool *done)
+{
+	int r;
+
+	*done = true;
+
+	if ((r = fido_dev_open_rx_init(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_open_rx_init", __func__);
+		fido_dev_open_abort(dev);
+		return (r);
+	}
+
+	if (fido_dev_is_fido2(dev) && !(dev->flags & FIDO_DEV_INFO_PENDING)) {
+		*done = false;
+		return (fido_dev_get_cbor_info_tx(dev, ms));
+	}
+
+	return (FIDO_OK);
+}
+
+static int
+fido_dev_open_many_info(fido_dev_t *dev, int *ms, int r)
+{
+	fido_cbor_info_t *info;
+
+	if ((info = fido_cbor_info_new()) == NULL) {
+		fido_log_debug("%s: fido_cbor_info_new", __func__);
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
+	if (r == FIDO_OK)
+		r = fido_dev_get_cbor_info_rx(dev, info, ms);
+	if ((r = fido_dev_set_info(dev, info, r)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_set_info", __func__);
+		goto fail;
+	}
+
+	return (FIDO_OK);
+fail:
+	fido_dev_open_abort(dev);
+
+	return (r);
+}
+
+int
+fido_dev_open_many(fido_dev_t **devlist, size_t n, int *status)
+{
+	int	*ms = NULL;
+	bool	*done = NULL;
+	int	 r;
+
+	if (n == 0)
+		return (FIDO_OK);
+	if (devlist == NULL || status == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if ((ms = fido_calloc(n, sizeof(*ms))) == NULL ||
+	    (done = fido_calloc(n, sizeof(*done))) == NULL) {
+		r = FIDO_ERR_INTERNAL;
+		goto out;
+	}
+
+	/* greet every device before waiting on any of them */
+	for (size_t i = 0; i < n; i++) {
+		ms[i] = devlist[i] != NULL ?
+		    fido_time_budget(devlist[i]->timeout_ms) : -1;
+		status[i] = fido_dev_open_many_tx(devlist[i], &ms[i], &done[i]);
+	}
+	for (size_t i = 0; i < n; i++)
+		if (!done[i] && status[i] == FIDO_OK)
+			status[i] = fido_dev_open_many_rx(devlist[i], &ms[i],
+			    &done[i]);
+	for (size_t i = 0; i < n; i++)
+		if (!done[i])
+			status[i] = fido_dev_open_many_info(devlist[i], &ms[i],
+			    status[i]);
+
+	r = FIDO_OK;
+	for (size_t i = 0; i < n; i++) {
+		if (status[i] != FIDO_OK) {
+			fido_log_debug("%s: status[%zu]=%d", __func__, i,
+			    status[i]);
+			if (r == FIDO_OK)
+				r = status[i];
+		} else if (!fido_dev_is_winhello(devlist[i]) &&
+		    channel_cacheable(devlist[i], devlist[i]->path))
+			channel_store(devlist[i], devlist[i]->path);
+	}
+out:
+	fido_free(ms);
+	fido_free(done);
+
+	return (r);
+}
+
+/* remember the path of an opened device, e.g. for tracing; not fatal */
+static void
+fido_dev_set_path(fido_dev_t *dev, const char *path)
+{
+	char *p;
+
+	if (dev->path != NULL && strcmp(dev->path, path) == 0)
+		return;
+	if ((p = fido_strdup(path)) == NULL) {
+		fido_log_debug("%s: strdup", __func__);
+		return;
+	}
+	fido_free(dev->path);
+	dev->path = p;
+}
+
 int
 fido_dev_open(fido_dev_t *dev, const char *path)
 {
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
 
 #ifdef USE_NFC
 	if (fido_is_nfc(path) && fido_dev_set_nfc(dev) < 0) {
@@ -310,13 +760,70 @@ fido_dev_open(fido_dev_t *dev, const char *path)
 		return FIDO_ERR_INTERNAL;
 	}
 #endif
+#ifdef USE_BROKER
+	if (fido_is_broker(path) && fido_dev_set_broker(dev) < 0) {
+		fido_log_debug("%s: fido_dev_set_broker", __func__);
+		return FIDO_ERR_INTERNAL;
+	}
+	if (fido_is_remote(path) && fido_dev_set_remote(dev) < 0) {
+		fido_log_debug("%s: fido_dev_set_remote", __func__);
+		return FIDO_ERR_INTERNAL;
+	}
+#endif
+
+	fido_log_push(dev, __func__);
+	if ((r = fido_dev_open_wait(dev, path, &ms)) == FIDO_OK)
+		fido_dev_set_path(dev, path);
+	fido_log_pop();
+
+	return (r);
+}
+
+int
+fido_dev_open_channel(fido_dev_t *dev, fido_dev_t *ch)
+{
+	int ms = fido_time_budget(ch->timeout_ms);
+	int r;
+
+	if (dev == ch || dev->io_handle == NULL || dev->io.read == NULL ||
+	    dev->io.write == NULL || dev->transport.rx != NULL ||
+	    dev->transport.tx != NULL || ch->io_handle != NULL ||
+	    ch->cid != CTAP_CID_BROADCAST) {
+		fido_log_debug("%s: invalid argument", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	if (fido_get_nonce(&ch->nonce, sizeof(ch->nonce)) < 0) {
+		fido_log_debug("%s: fido_get_nonce", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	if ((r = fido_chan_attach(dev, ch)) != FIDO_OK) {
+		fido_log_debug("%s: fido_chan_attach", __func__);
+		return (r);
+	}
 
-	return (fido_dev_open_wait(dev, path, &ms));
+	fido_log_push(ch, __func__);
+	if (fido_tx(ch, CTAP_CMD_INIT, &ch->nonce, sizeof(ch->nonce),
+	    &ms) < 0) {
+		fido_log_debug("%s: fido_tx", __func__);
+		fido_dev_open_abort(ch);
+		r = FIDO_ERR_TX;
+	} else if ((r = fido_dev_open_rx(ch, &ms)) == FIDO_OK) {
+		fido_chan_set_cid(ch);
+		if (dev->path != NULL)
+			fido_dev_set_path(ch, dev->path);
+	}
+	fido_log_pop();
+
+	return (r);
 }
 
 int
 fido_dev_close(fido_dev_t *dev)
 {
+	int r;
+
 #ifdef USE_WINHELLO
 	if (dev->flags & FIDO_DEV_WINHELLO)
 		return (fido_winhello_close(dev));
@@ -324,9 +831,17 @@ fido_dev_close(fido_dev_t *dev)
 	if (dev->io_handle == NULL || dev->io.close == NULL)
 		return (FIDO_ERR_INVALID_ARGUMENT);
 
-	dev->io.close(dev->io_handle);
+	if (dev->chan == NULL || (r = fido_chan_detach(dev)) == 1)
+		dev->io.close(dev->io_handle);
+	else if (r < 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
 	dev->io_handle = NULL;
 	dev->cid = CTAP_CID_BROADCAST;
+	fido_prof_dump(dev->path);
+	fido_cbor_info_free(&dev->info);
+	fido_dev_async_reset(dev);
+	fido_dev_token_cache_reset(dev);
+	fido_dev_largeblob_cache_reset(dev);
 
 	return (FIDO_OK);
 }
@@ -347,10 +862,166 @@ fido_dev_set_sigmask(fido_dev_t *dev, const fido_sigset_t *sigmask)
 	return (FIDO_ERR_INVALID_ARGUMENT);
 }
 
+void
+fido_dev_async_reset(fido_dev_t *dev)
+{
+	dev->async_cmd = 0;
+	dev->rx_pending_len = 0;
+	fido_blob_free(&dev->async_ecdh);
+}
+
+void
+fido_dev_token_cache_reset(fido_dev_t *dev)
+{
+	fido_blob_free(&dev->token);
+	fido_blob_free(&dev->token_scope);
+	fido_blob_free(&dev->ecdh);
+	aes256_cache_free(&dev->aes);
+	if (dev->ecdh_pk != NULL)
+		explicit_bzero(dev->ecdh_pk, sizeof(*dev->ecdh_pk));
+	es256_pk_free(&dev->ecdh_pk);
+}
+
+/*
+ * Reply buffers are lent from a per-device scratch buffer, sized after the
+ * authenticator's maxMsgSize but never smaller than FIDO_MAXMSG; nested
+ * borrowers fall back to fido_malloc(). fido_rx() records how much of the
+ * scratch buffer it may have written to, so that only those bytes need
+ * clearing when the buffer is returned.
+ */
+size_t
+fido_dev_msgbuf_len(const fido_dev_t *dev)
+{
+	if (dev->maxmsgsize <= FIDO_MAXMSG)
+		return (FIDO_MAXMSG);
+	if (dev->maxmsgsize > UINT16_MAX) /* ctaphid bcnt */
+		return (UINT16_MAX);
+
+	return ((size_t)dev->maxmsgsize);
+}
+
+unsigned char *
+fido_dev_msgbuf_get(fido_dev_t *dev, size_t *len)
+{
+	size_t n = fido_dev_msgbuf_len(dev);
+
+	*len = 0;
+
+	if (dev->msgbuf_busy) {
+		unsigned char *ptr;
+		if ((ptr = fido_malloc(n)) != NULL)
+			*len = n;
+		return (ptr);
+	}
+	if (dev->msgbuf != NULL && dev->msgbuf_len != n) {
+		fido_freezero(dev->msgbuf, dev->msgbuf_len);
+		dev->msgbuf = NULL;
+		dev->msgbuf_len = 0;
+	}
+	if (dev->msgbuf == NULL) {
+		if ((dev->msgbuf = fido_calloc(1, n)) == NULL)
+			return (NULL);
+		dev->msgbuf_len = n;
+	}
+
+	dev->msgbuf_busy = true;
+	*len = n;
+
+	return (dev->msgbuf);
+}
+
+void
+fido_dev_msgbuf_put(fido_dev_t *dev, unsigned char *ptr, size_t len)
+{
+	if (ptr == NULL)
+		return;
+	if (ptr != dev->msgbuf) {
+		fido_freezero(ptr, len);
+		return;
+	}
+
+	explicit_bzero(ptr, dev->msgbuf_dirty);
+	dev->msgbuf_dirty = 0;
+	dev->msgbuf_busy = false;
+}
+
+void
+fido_dev_msgbuf_dirty(fido_dev_t *dev, size_t count, int n)
+{
+	size_t len = count;
+	size_t pad = CTAP_DEF_REPORT_LEN;
+
+	/* rx() may write up to a report's worth of padding past n */
+	if (dev->rx_len > pad)
+		pad = dev->rx_len;
+	if (n >= 0 && count > pad && (size_t)n < count - pad)
+		len = (size_t)n + pad;
+	if (len > dev->msgbuf_len)
+		len = dev->msgbuf_len;
+	if (len > dev->msgbuf_dirty)
+		dev->msgbuf_dirty = len;
+}
+
+int
+fido_dev_poll(fido_dev_t *dev, int ms)
+{
+	int r;
+
+#ifdef USE_WINHELLO
+	if (dev->flags & FIDO_DEV_WINHELLO)
+		return (fido_winhello_poll(dev, ms));
+#endif
+	if (dev->io_handle == NULL || dev->async_cmd == 0) {
+		fido_log_debug("%s: io_handle=%p, async_cmd=0x%02x", __func__,
+		    dev->io_handle, dev->async_cmd);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+	if (dev->transport.rx != NULL)
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+	if ((r = fido_rx_poll(dev, &ms)) < 0) {
+		fido_log_debug("%s: fido_rx_poll", __func__);
+		return (FIDO_ERR_RX);
+	}
+
+	return (r ? FIDO_OK : FIDO_ERR_TIMEOUT);
+}
+
+int
+fido_dev_get_pollfd(const fido_dev_t *dev)
+{
+	if (dev->io_handle == NULL)
+		return (-1);
+#ifdef USE_NFC
+	if (dev->transport.rx == fido_nfc_rx && dev->io.read == fido_nfc_read)
+		return (fido_nfc_fd(dev->io_handle));
+#endif
+	if (dev->transport.rx == NULL && dev->io.read == fido_hid_read)
+		return (fido_hid_fd(dev->io_handle));
+
+	return (-1);
+}
+
+void *
+fido_dev_get_pollhandle(const fido_dev_t *dev)
+{
+#ifdef USE_WINHELLO
+	if (dev->flags & FIDO_DEV_WINHELLO)
+		return (fido_winhello_handle(dev));
+#endif
+#if defined(_WIN32) && !defined(USE_HIDAPI)
+	if (dev->io_handle != NULL && dev->transport.rx == NULL &&
+	    dev->io.read == fido_hid_read)
+		return (fido_hid_win_event(dev->io_handle));
+#endif
+	(void)dev;
+
+	return (NULL);
+}
+
 int
 fido_dev_cancel(fido_dev_t *dev)
 {
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 
 #ifdef USE_WINHELLO
 	if (dev->flags & FIDO_DEV_WINHELLO)
@@ -364,6 +1035,171 @@ fido_dev_cancel(fido_dev_t *dev)
 	return (FIDO_OK);
 }
 
+/*
+ * Cancel the request outstanding on, and close, every open device in
+ * 'devlist'. The cancellations are all sent before any device is closed,
+ * and the authenticators' replies are not waited for.
+ */
+int
+fido_dev_cancel_many(fido_dev_t **devlist, size_t n)
+{
+	if (n == 0)
+		return (FIDO_OK);
+	if (devlist == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	for (size_t i = 0; i < n; i++)
+		if (devlist[i] != NULL && (devlist[i]->io_handle != NULL ||
+		    fido_dev_is_winhello(devlist[i])) &&
+		    fido_dev_cancel(devlist[i]) != FIDO_OK)
+			fido_log_debug("%s: fido_dev_cancel %zu", __func__, i);
+	for (size_t i = 0; i < n; i++)
+		if (devlist[i] != NULL && (devlist[i]->io_handle != NULL ||
+		    fido_dev_is_winhello(devlist[i])))
+			fido_dev_close(devlist[i]);
+
+	return (FIDO_OK);
+}
+
+/* send 'len' bytes in a CTAPHID_PING and check that they are echoed */
+int
+fido_dev_ping(fido_dev_t *dev, const unsigned char *ptr, size_t len)
+{
+	unsigned char	*msg;
+	size_t		 msgsiz = 0;
+	int		 ms = fido_time_budget(dev->timeout_ms);
+	int		 n, r;
+
+	if (ptr == NULL && len != 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+#ifdef USE_WINHELLO
+	if (dev->flags & FIDO_DEV_WINHELLO)
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+#endif
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+	if (len > msgsiz) {
+		fido_log_debug("%s: len=%zu, msgsiz=%zu", __func__, len,
+		    msgsiz);
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto out;
+	}
+
+	if (fido_tx(dev, CTAP_CMD_PING, ptr, len, &ms) < 0) {
+		fido_log_debug("%s: fido_tx", __func__);
+		r = FIDO_ERR_TX;
+		goto out;
+	}
+	if ((n = fido_rx(dev, CTAP_CMD_PING, msg, msgsiz, &ms)) < 0) {
+		fido_log_debug("%s: fido_rx", __func__);
+		r = FIDO_ERR_RX;
+		goto out;
+	}
+	if ((size_t)n != len || (len > 0 && memcmp(msg, ptr, len) != 0)) {
+		fido_log_debug("%s: echo mismatch, n=%d", __func__, n);
+		r = FIDO_ERR_RX;
+		goto out;
+	}
+
+	r = FIDO_OK;
+out:
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
+
+	return (r);
+}
+
+static int
+fido_dev_lock_wait(fido_dev_t *dev, uint8_t secs, int *ms)
+{
+	unsigned char	reply[CTAP_MAX_REPORT_LEN];
+	int		n;
+
+#ifdef USE_WINHELLO
+	if (dev->flags & FIDO_DEV_WINHELLO)
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+#endif
+	if (dev->transport.tx != NULL) {
+		fido_log_debug("%s: not a ctaphid device", __func__);
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+	}
+	if (fido_tx(dev, CTAP_CMD_LOCK, &secs, sizeof(secs), ms) < 0) {
+		fido_log_debug("%s: fido_tx", __func__);
+		return (FIDO_ERR_TX);
+	}
+	if ((n = fido_rx(dev, CTAP_CMD_LOCK, reply, sizeof(reply), ms)) != 0) {
+		fido_log_debug("%s: fido_rx, n=%d", __func__, n);
+		return (FIDO_ERR_RX);
+	}
+
+	return (FIDO_OK);
+}
+
+/* keep other channels off the device for 'seconds'; 0 releases the lock */
+int
+fido_dev_lock(fido_dev_t *dev, unsigned int seconds)
+{
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	if (seconds > LOCK_MAXSECS)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if ((r = fido_dev_lock_wait(dev, (uint8_t)seconds, &ms)) != FIDO_OK)
+		return (r);
+
+	dev->locked = seconds != 0;
+
+	return (FIDO_OK);
+}
+
+int
+fido_dev_unlock(fido_dev_t *dev)
+{
+	return (fido_dev_lock(dev, 0));
+}
+
+/* lock the device for 'seconds' around multi-request sequences; 0 to stop */
+int
+fido_dev_set_lock(fido_dev_t *dev, unsigned int seconds)
+{
+	if (seconds > LOCK_MAXSECS)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	dev->lock_secs = (uint8_t)seconds;
+
+	return (FIDO_OK);
+}
+
+/*
+ * Called before a sequence of requests that other channels should not
+ * interleave with. Only the outermost sequence takes the lock; failing
+ * to take it is not fatal, the sequence then runs unlocked.
+ */
+void
+fido_dev_lock_begin(fido_dev_t *dev, int *ms)
+{
+	if (dev->lock_secs == 0 || dev->lock_depth++ > 0 || dev->locked)
+		return;
+	if (fido_dev_lock_wait(dev, dev->lock_secs, ms) != FIDO_OK) {
+		fido_log_debug("%s: running unlocked", __func__);
+		return;
+	}
+
+	dev->lock_auto = true;
+}
+
+void
+fido_dev_lock_end(fido_dev_t *dev)
+{
+	int ms = fido_time_budget(dev->timeout_ms);
+
+	if (dev->lock_depth == 0 || --dev->lock_depth > 0 || !dev->lock_auto)
+		return;
+	if (fido_dev_lock_wait(dev, 0, &ms) != FIDO_OK)
+		fido_log_debug("%s: lock left to expire", __func__);
+
+	dev->lock_auto = false;
+}
+
 int
 fido_dev_set_io_functions(fido_dev_t *dev, const fido_dev_io_t *io)
 {
@@ -412,6 +1248,14 @@ fido_init(int flags)
 		fido_log_init();
 
 	disable_u2f_fallback = (flags & FIDO_DISABLE_U2F_FALLBACK);
+	channel_cache = (flags & FIDO_CHANNEL_CACHE);
+	defer_getinfo = (flags & FIDO_DEFER_GETINFO);
+	manifest_skip = flags & (FIDO_MANIFEST_NO_HID | FIDO_MANIFEST_NO_NFC |
+	    FIDO_MANIFEST_NO_PCSC | FIDO_MANIFEST_NO_WINHELLO);
+	channel_flush();
+	fido_cbor_info_cache_init(flags & FIDO_INFO_CACHE);
+	fido_verify_cache_init(flags & FIDO_VERIFY_CACHE);
+	fido_prof_init(flags & FIDO_PROFILE || getenv("FIDO_PROFILE") != NULL);
 }
 
 fido_dev_t *
@@ -419,11 +1263,12 @@ fido_dev_new(void)
 {
 	fido_dev_t *dev;
 
-	if ((dev = calloc(1, sizeof(*dev))) == NULL)
+	if ((dev = fido_calloc(1, sizeof(*dev))) == NULL)
 		return (NULL);
 
 	dev->cid = CTAP_CID_BROADCAST;
 	dev->timeout_ms = -1;
+	dev->log_level = -1;
 	dev->io = (fido_dev_io_t) {
 		&fido_hid_open,
 		&fido_hid_close,
@@ -439,7 +1284,7 @@ fido_dev_new_with_info(const fido_dev_info_t *di)
 {
 	fido_dev_t *dev;
 
-	if ((dev = calloc(1, sizeof(*dev))) == NULL)
+	if ((dev = fido_calloc(1, sizeof(*dev))) == NULL)
 		return (NULL);
 
 #if 0
@@ -452,12 +1297,17 @@ fido_dev_new_with_info(const fido_dev_info_t *di)
 #endif
 
 	dev->io = di->io;
-	dev->io_own = di->transport.tx != NULL || di->transport.rx != NULL;
+	/* i/o functions other than the HID backend's are the caller's own */
+	dev->io_own = di->transport.tx != NULL || di->transport.rx != NULL ||
+	    (di->io.read != NULL && di->io.read != fido_hid_read);
 	dev->transport = di->transport;
 	dev->cid = CTAP_CID_BROADCAST;
 	dev->timeout_ms = -1;
+	dev->log_level = -1;
+	dev->vendor_id = di->vendor_id;
+	dev->product_id = di->product_id;
 
-	if ((dev->path = strdup(di->path)) == NULL) {
+	if ((dev->path = fido_strdup(di->path)) == NULL) {
 		fido_log_debug("%s: strdup", __func__);
 		fido_dev_free(&dev);
 		return (NULL);
@@ -474,8 +1324,14 @@ fido_dev_free(fido_dev_t **dev_p)
 	if (dev_p == NULL || (dev = *dev_p) == NULL)
 		return;
 
-	free(dev->path);
-	free(dev);
+	fido_cbor_info_free(&dev->info);
+	fido_dev_async_reset(dev);
+	fido_dev_token_cache_reset(dev);
+	fido_dev_largeblob_cache_reset(dev);
+	fido_freezero(dev->msgbuf, dev->msgbuf_len);
+	fido_free_blob_array(&dev->largeblob_dict);
+	fido_free(dev->path);
+	fido_free(dev);
 
 	*dev_p = NULL;
 }
@@ -569,6 +1425,7 @@ fido_dev_force_u2f(fido_dev_t *dev)
 {
 	dev->attr.flags &= (uint8_t)~FIDO_CAP_CBOR;
 	dev->flags = 0;
+	fido_cbor_info_free(&dev->info);
 }
 
 void
@@ -588,12 +1445,38 @@ fido_dev_get_pin_protocol(const fido_dev_t *dev)
 	return (0);
 }
 
+const fido_cbor_info_t *
+fido_dev_cbor_info(const fido_dev_t *dev)
+{
+	return (dev->info);
+}
+
 uint64_t
 fido_dev_maxmsgsize(const fido_dev_t *dev)
 {
 	return (dev->maxmsgsize);
 }
 
+int
+fido_dev_set_keepalive_handler(fido_dev_t *dev, fido_dev_keepalive_t *handler,
+    void *arg)
+{
+	dev->keepalive = handler;
+	dev->keepalive_arg = arg;
+
+	return (FIDO_OK);
+}
+
+int
+fido_dev_set_metrics_handler(fido_dev_t *dev, fido_dev_metrics_cb_t *handler,
+    void *arg)
+{
+	dev->metrics_cb = handler;
+	dev->metrics_arg = arg;
+
+	return (FIDO_OK);
+}
+
 int
 fido_dev_set_timeout(fido_dev_t *dev, int ms)
 {
@@ -604,3 +1487,33 @@ fido_dev_set_timeout(fido_dev_t *dev, int ms)
 
 	return (FIDO_OK);
 }
+
+int
+fido_dev_set_log_level(fido_dev_t *dev, int level)
+{
+	if (level < -1 || level > FIDO_LOG_XXD)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	dev->log_level = level;
+
+	return (FIDO_OK);
+}
+
+int
+fido_dev_set_adaptive_timeout(fido_dev_t *dev, unsigned int factor)
+{
+	dev->rtt_factor = factor;
+
+	return (FIDO_OK);
+}
+
+int
+fido_dev_set_token_cache(fido_dev_t *dev, bool enable)
+{
+	if (!enable)
+		fido_dev_token_cache_reset(dev);
+
+	dev->token_cache = enable;
+
+	return (FIDO_OK);
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <dlfcn.h>
+#include <libudev.h>
+#include <pthread.h>
+#ifdef USE_PCSC
+#include <winscard.h>
+#endif
+
+#include "fido.h"
+#include "dlopen.h"
+
+#define UDEV_SONAME	"libudev.so.1"
+#define PCSC_SONAME	"libpcsclite.so.1"
+
+/* resolve 'name' into the function pointer at 'fp' */
+#define LIB_SYM(lib, name, fp)	lib_sym((lib), (name), &(fp), sizeof(fp))
+
+/* loaded once per process, on first use, and never unloaded */
+struct fido_udev_api		 fido_udev;
+static struct udev		*(*udev_new_fn)(void);
+static pthread_once_t		 udev_once = PTHREAD_ONCE_INIT;
+#ifdef USE_PCSC
+struct fido_pcsc_api		 fido_pcsc;
+static LONG			(*pcsc_establish_fn)(DWORD, LPCVOID, LPCVOID,
+				    LPSCARDCONTEXT);
+static pthread_once_t		 pcsc_once = PTHREAD_ONCE_INIT;
+#endif
+
+static void *
+lib_open(const char *soname)
+{
+	void *lib;
+
+	if ((lib = dlopen(soname, RTLD_NOW | RTLD_LOCAL)) == NULL)
+		fido_log_debug("%s: %s: %s", __func__, soname, dlerror());
+
+	return (lib);
+}
+
+/* POSIX has a function pointer fit in a void *; copied for -pedantic */
+static int
+lib_sym(void *lib, const char *name, void *fp, size_t fp_len)
+{
+	void *p;
+
+	if (fp_len != sizeof(p) || (p = dlsym(lib, name)) == NULL) {
+		fido_log_debug("%s: %s", __func__, name);
+		return (-1);
+	}
+	memcpy(fp, &p, fp_len);
+
+	return (0);
+}
+
+static void
+udev_load(void)
+{
+	struct fido_udev_api	*u = &fido_udev;
+	void			*lib;
+
+	if ((lib = lib_open(UDEV_SONAME)) == NULL)
+		return;
+	if (LIB_SYM(lib, "udev_unref", u->unref) < 0 ||
+	    LIB_SYM(lib, "udev_device_get_action",
+	    u->device_get_action) < 0 ||
+	    LIB_SYM(lib, "udev_device_get_devnode",
+	    u->device_get_devnode) < 0 ||
+	    LIB_SYM(lib, "udev_device_get_parent_with_subsystem_devtype",
+	    u->device_get_parent_with_subsystem_devtype) < 0 ||
+	    LIB_SYM(lib, "udev_device_get_sysattr_value",
+	    u->device_get_sysattr_value) < 0 ||
+	    LIB_SYM(lib, "udev_device_get_sysnum",
+	    u->device_get_sysnum) < 0 ||
+	    LIB_SYM(lib, "udev_device_new_from_syspath",
+	    u->device_new_from_syspath) < 0 ||
+	    LIB_SYM(lib, "udev_device_unref", u->device_unref) < 0 ||
+	    LIB_SYM(lib, "udev_enumerate_add_match_subsystem",
+	    u->enumerate_add_match_subsystem) < 0 ||
+	    LIB_SYM(lib, "udev_enumerate_get_list_entry",
+	    u->enumerate_get_list_entry) < 0 ||
+	    LIB_SYM(lib, "udev_enumerate_new", u->enumerate_new) < 0 ||
+	    LIB_SYM(lib, "udev_enumerate_scan_devices",
+	    u->enumerate_scan_devices) < 0 ||
+	    LIB_SYM(lib, "udev_enumerate_unref", u->enumerate_unref) < 0 ||
+	    LIB_SYM(lib, "udev_list_entry_get_name",
+	    u->list_entry_get_name) < 0 ||
+	    LIB_SYM(lib, "udev_list_entry_get_next",
+	    u->list_entry_get_next) < 0 ||
+	    LIB_SYM(lib, "udev_monitor_enable_receiving",
+	    u->monitor_enable_receiving) < 0 ||
+	    LIB_SYM(lib, "udev_monitor_filter_add_match_subsystem_devtype",
+	    u->monitor_filter_add_match_subsystem_devtype) < 0 ||
+	    LIB_SYM(lib, "udev_monitor_get_fd", u->monitor_get_fd) < 0 ||
+	    LIB_SYM(lib, "udev_monitor_new_from_netlink",
+	    u->monitor_new_from_netlink) < 0 ||
+	    LIB_SYM(lib, "udev_monitor_receive_device",
+	    u->monitor_receive_device) < 0 ||
+	    LIB_SYM(lib, "udev_monitor_unref", u->monitor_unref) < 0 ||
+	    LIB_SYM(lib, "udev_new", udev_new_fn) < 0) {
+		udev_new_fn = NULL;
+		dlclose(lib);
+	}
+}
+
+struct udev *
+fido_udev_new(void)
+{
+	int r;
+
+	if ((r = pthread_once(&udev_once, udev_load)) != 0) {
+		fido_log_error(r, "%s: pthread_once", __func__);
+		return (NULL);
+	}
+	if (udev_new_fn == NULL) {
+		fido_log_debug("%s: %s not loaded", __func__, UDEV_SONAME);
+		return (NULL);
+	}
+
+	return (udev_new_fn());
+}
+
+#ifdef USE_PCSC
+static void
+pcsc_load(void)
+{
+	struct fido_pcsc_api	*p = &fido_pcsc;
+	void			*lib;
+
+	if ((lib = lib_open(PCSC_SONAME)) == NULL)
+		return;
+	if (LIB_SYM(lib, "SCardBeginTransaction", p->begin_transaction) < 0 ||
+	    LIB_SYM(lib, "SCardConnect", p->connect) < 0 ||
+	    LIB_SYM(lib, "SCardDisconnect", p->disconnect) < 0 ||
+	    LIB_SYM(lib, "SCardEndTransaction", p->end_transaction) < 0 ||
+	    LIB_SYM(lib, "SCardListReaders", p->list_readers) < 0 ||
+	    LIB_SYM(lib, "SCardReleaseContext", p->release_context) < 0 ||
+	    LIB_SYM(lib, "SCardTransmit", p->transmit) < 0 ||
+	    (p->t0_pci = dlsym(lib, "g_rgSCardT0Pci")) == NULL ||
+	    (p->t1_pci = dlsym(lib, "g_rgSCardT1Pci")) == NULL ||
+	    LIB_SYM(lib, "SCardEstablishContext", pcsc_establish_fn) < 0) {
+		fido_log_debug("%s: %s", __func__, PCSC_SONAME);
+		pcsc_establish_fn = NULL;
+		dlclose(lib);
+	}
+}
+
+LONG
+fido_pcsc_establish_context(DWORD scope, LPCVOID r1, LPCVOID r2,
+    LPSCARDCONTEXT ctx)
+{
+	int r;
+
+	if ((r = pthread_once(&pcsc_once, pcsc_load)) != 0) {
+		fido_log_error(r, "%s: pthread_once", __func__);
+		return ((LONG)SCARD_E_NO_SERVICE);
+	}
+	if (pcsc_establish_fn == NULL) {
+		fido_log_debug("%s: %s not loaded", __func__, PCSC_SONAME);
+		return ((LONG)SCARD_E_NO_SERVICE);
+	}
+
+	return (pcsc_establish_fn(scope, r1, r2, ctx));
+}
+#endif /* USE_PCSC */
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _FIDO_DLOPEN_H
+#define _FIDO_DLOPEN_H
+
+/*
+ * With USE_DLOPEN, libudev and pcsclite are loaded by dlopen.c when first
+ * needed instead of when libfido2 is. Every use of libudev starts with
+ * udev_new() and every use of pcsclite with SCardEstablishContext(); those
+ * two load the library, and report failure if it is missing. The functions
+ * called afterwards go through pointers resolved at load time. Include this
+ * header after <libudev.h> or <winscard.h>.
+ */
+
+#if defined(USE_DLOPEN) && defined(udev_list_entry_foreach)
+struct fido_udev_api {
+	struct udev *(*unref)(struct udev *);
+	const char *(*device_get_action)(struct udev_device *);
+	const char *(*device_get_devnode)(struct udev_device *);
+	struct udev_device *(*device_get_parent_with_subsystem_devtype)(
+	    struct udev_device *, const char *, const char *);
+	const char *(*device_get_sysattr_value)(struct udev_device *,
+	    const char *);
+	const char *(*device_get_sysnum)(struct udev_device *);
+	struct udev_device *(*device_new_from_syspath)(struct udev *,
+	    const char *);
+	struct udev_device *(*device_unref)(struct udev_device *);
+	int (*enumerate_add_match_subsystem)(struct udev_enumerate *,
+	    const char *);
+	struct udev_list_entry *(*enumerate_get_list_entry)(
+	    struct udev_enumerate *);
+	struct udev_enumerate *(*enumerate_new)(struct udev *);
+	int (*enumerate_scan_devices)(struct udev_enumerate *);
+	struct udev_enumerate *(*enumerate_unref)(struct udev_enumerate *);
+	const char *(*list_entry_get_name)(struct udev_list_entry *);
+	struct udev_list_entry *(*list_entry_get_next)(
+	    struct udev_list_entry *);
+	int (*monitor_enable_receiving)(struct udev_monitor *);
+	int (*monitor_filter_add_match_subsystem_devtype)(
+	    struct udev_monitor *, const char *, const char *);
+	int (*monitor_get_fd)(struct udev_monitor *);
+	struct udev_monitor *(*monitor_new_from_netlink)(struct udev *,
+	    const char *);
+	struct udev_device *(*monitor_receive_device)(struct udev_monitor *);
+	struct udev_monitor *(*monitor_unref)(struct udev_monitor *);
+};
+
+extern struct fido_udev_api fido_udev;
+
+struct udev *fido_udev_new(void);
+
+#define udev_new		fido_udev_new
+#define udev_unref		fido_udev.unref
+#define udev_device_get_action	fido_udev.device_get_action
+#define udev_device_get_devnode	fido_udev.device_get_devnode
+#define udev_device_get_parent_with_subsystem_devtype \
+    fido_udev.device_get_parent_with_subsystem_devtype
+#define udev_device_get_sysattr_value \
+    fido_udev.device_get_sysattr_value
+#define udev_device_get_sysnum	fido_udev.device_get_sysnum
+#define udev_device_new_from_syspath \
+    fido_udev.device_new_from_syspath
+#define udev_device_unref	fido_udev.device_unref
+#define udev_enumerate_add_match_subsystem \
+    fido_udev.enumerate_add_match_subsystem
+#define udev_enumerate_get_list_entry \
+    fido_udev.enumerate_get_list_entry
+#define udev_enumerate_new	fido_udev.enumerate_new
+#define udev_enumerate_scan_devices \
+    fido_udev.enumerate_scan_devices
+#define udev_enumerate_unref	fido_udev.enumerate_unref
+#define udev_list_entry_get_name \
+    fido_udev.list_entry_get_name
+#define udev_list_entry_get_next \
+    fido_udev.list_entry_get_next
+#define udev_monitor_enable_receiving \
+    fido_udev.monitor_enable_receiving
+#define udev_monitor_filter_add_match_subsystem_devtype \
+    fido_udev.monitor_filter_add_match_subsystem_devtype
+#define udev_monitor_get_fd	fido_udev.monitor_get_fd
+#define udev_monitor_new_from_netlink \
+    fido_udev.monitor_new_from_netlink
+#define udev_monitor_receive_device \
+    fido_udev.monitor_receive_device
+#define udev_monitor_unref	fido_udev.monitor_unref
+#endif /* USE_DLOPEN && udev_list_entry_foreach */
+
+#if defined(USE_DLOPEN) && defined(SCARD_S_SUCCESS)
+struct fido_pcsc_api {
+	LONG (*begin_transaction)(SCARDHANDLE);
+	LONG (*connect)(SCARDCONTEXT, LPCSTR, DWORD, DWORD, LPSCARDHANDLE,
+	    LPDWORD);
+	LONG (*disconnect)(SCARDHANDLE, DWORD);
+	LONG (*end_transaction)(SCARDHANDLE, DWORD);
+	LONG (*list_readers)(SCARDCONTEXT, LPCSTR, LPSTR, LPDWORD);
+	LONG (*release_context)(SCARDCONTEXT);
+	LONG (*transmit)(SCARDHANDLE, const SCARD_IO_REQUEST *, LPCBYTE, DWORD,
+	    SCARD_IO_REQUEST *, LPBYTE, LPDWORD);
+	const SCARD_IO_REQUEST *t0_pci;
+	const SCARD_IO_REQUEST *t1_pci;
+};
+
+extern struct fido_pcsc_api fido_pcsc;
+
+LONG fido_pcsc_establish_context(DWORD, LPCVOID, LPCVOID, LPSCARDCONTEXT);
+
+#undef SCARD_PCI_T0
+#undef SCARD_PCI_T1
+
+#define SCardBeginTransaction	fido_pcsc.begin_transaction
+#define SCardConnect		fido_pcsc.connect
+#define SCardDisconnect		fido_pcsc.disconnect
+#define SCardEndTransaction	fido_pcsc.end_transaction
+#define SCardEstablishContext	fido_pcsc_establish_context
+#define SCardListReaders	fido_pcsc.list_readers
+#define SCardReleaseContext	fido_pcsc.release_context
+#define SCardTransmit		fido_pcsc.transmit
+#define SCARD_PCI_T0		(fido_pcsc.t0_pci)
+#define SCARD_PCI_T1		(fido_pcsc.t1_pci)
+#endif /* USE_DLOPEN && SCARD_S_SUCCESS */
+
+#endif /* !_FIDO_DLOPEN_H */
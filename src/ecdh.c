@@ -16,6 +16,44 @@
 #include "fido.h"
 #include "fido/es256.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define pool_load(p)	_InterlockedCompareExchangePointer((p), NULL, NULL)
+#define pool_take(p)	_InterlockedExchangePointer((p), NULL)
+#define pool_put(p, k) \
+	(_InterlockedCompareExchangePointer((p), (k), NULL) == NULL)
+#else
+#define pool_load(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define pool_take(p)	__atomic_exchange_n((p), NULL, __ATOMIC_ACQ_REL)
+#define pool_put(p, k)	pool_put_gcc((p), (k))
+#endif
+
+#define ECDH_POOL_LEN	16
+
+/* an ephemeral key pair, used for a single key agreement */
+struct ecdh_key {
+	es256_sk_t sk;
+	es256_pk_t pk;
+};
+
+/*
+ * Key pairs generated ahead of time by fido_ecdh_pool_fill(), shared by
+ * all threads. A slot is emptied with an atomic exchange, so that each
+ * key is taken once.
+ */
+static void *ecdh_pool[ECDH_POOL_LEN];
+
+#if !defined(_MSC_VER)
+static bool
+pool_put_gcc(void **p, void *k)
+{
+	void *o = NULL;
+
+	return (__atomic_compare_exchange_n(p, &o, k, false, __ATOMIC_ACQ_REL,
+	    __ATOMIC_ACQUIRE));
+}
+#endif
+
 #if defined(LIBRESSL_VERSION_NUMBER)
 static int
 hkdf_sha256(uint8_t *key, const char *info, const fido_blob_t *secret)
@@ -24,7 +62,7 @@ hkdf_sha256(uint8_t *key, const char *info, const fido_blob_t *secret)
 	uint8_t salt[32];
 
 	memset(salt, 0, sizeof(salt));
-	if ((md = EVP_sha256()) == NULL ||
+	if ((md = fido_md_sha256()) == NULL ||
 	    HKDF(key, SHA256_DIGEST_LENGTH, md, secret->ptr, secret->len, salt,
 	    sizeof(salt), (const uint8_t *)info, strlen(info)) != 1)
 		return -1;
@@ -47,6 +85,7 @@ hkdf_sha256(uint8_t *key, char *info, fido_blob_t *secret)
 		fido_log_debug("%s: invalid param", __func__);
 		goto fail;
 	}
+	/* EVP_MD_meth_dup() takes the built-in object only */
 	if ((const_md = EVP_sha256()) == NULL ||
 	    (md = EVP_MD_meth_dup(const_md)) == NULL ||
 	    (ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL)) == NULL) {
@@ -87,8 +126,8 @@ kdf(uint8_t prot, fido_blob_t *key, /* const */ fido_blob_t *secret)
 	case CTAP_PIN_PROTOCOL1:
 		/* use sha256 on the resulting secret */
 		key->len = SHA256_DIGEST_LENGTH;
-		if ((key->ptr = calloc(1, key->len)) == NULL ||
-		    SHA256(secret->ptr, secret->len, key->ptr) != key->ptr) {
+		if ((key->ptr = fido_secure_alloc(key->len)) == NULL ||
+		    fido_sha256_buf(secret->ptr, secret->len, key->ptr) < 0) {
 			fido_log_debug("%s: SHA256", __func__);
 			return -1;
 		}
@@ -96,7 +135,7 @@ kdf(uint8_t prot, fido_blob_t *key, /* const */ fido_blob_t *secret)
 	case CTAP_PIN_PROTOCOL2:
 		/* use two instances of hkdf-sha256 on the resulting secret */
 		key->len = 2 * SHA256_DIGEST_LENGTH;
-		if ((key->ptr = calloc(1, key->len)) == NULL ||
+		if ((key->ptr = fido_secure_alloc(key->len)) == NULL ||
 		    hkdf_sha256(key->ptr, hmac_info, secret) < 0 ||
 		    hkdf_sha256(key->ptr + SHA256_DIGEST_LENGTH, aes_info,
 		    secret) < 0) {
@@ -138,7 +177,7 @@ do_ecdh(const fido_dev_t *dev, const es256_sk_t *sk, const es256_pk_t *pk,
 		goto fail;
 	}
 	if (EVP_PKEY_derive(ctx, NULL, &secret->len) <= 0 ||
-	    (secret->ptr = calloc(1, secret->len)) == NULL ||
+	    (secret->ptr = fido_secure_alloc(secret->len)) == NULL ||
 	    EVP_PKEY_derive(ctx, secret->ptr, &secret->len) <= 0) {
 		fido_log_debug("%s: EVP_PKEY_derive", __func__);
 		goto fail;
@@ -164,39 +203,151 @@ fail:
 	return ok;
 }
 
+static int
+ecdh_cache_get(const fido_dev_t *dev, es256_pk_t **pk, fido_blob_t **ecdh)
+{
+	if ((*pk = es256_pk_new()) == NULL || (*ecdh = fido_blob_new()) == NULL ||
+	    fido_blob_set_secure(*ecdh, dev->ecdh->ptr, dev->ecdh->len) < 0) {
+		fido_log_debug("%s: fido_blob_set_secure", __func__);
+		return (-1);
+	}
+	memcpy(*pk, dev->ecdh_pk, sizeof(**pk));
+
+	return (0);
+}
+
+static void
+ecdh_cache_put(fido_dev_t *dev, const es256_pk_t *pk, const fido_blob_t *ecdh)
+{
+	fido_blob_free(&dev->ecdh);
+	aes256_cache_free(&dev->aes);
+	es256_pk_free(&dev->ecdh_pk);
+
+	if ((dev->ecdh_pk = es256_pk_new()) == NULL ||
+	    (dev->ecdh = fido_blob_new()) == NULL ||
+	    fido_blob_set_secure(dev->ecdh, ecdh->ptr, ecdh->len) < 0) {
+		fido_log_debug("%s: fido_blob_set_secure", __func__);
+		fido_blob_free(&dev->ecdh); /* not fatal */
+		es256_pk_free(&dev->ecdh_pk);
+		return;
+	}
+	memcpy(dev->ecdh_pk, pk, sizeof(*pk));
+	dev->aes = aes256_cache_new(); /* not fatal */
+}
+
+static void
+ecdh_key_free(struct ecdh_key **kp)
+{
+	if (*kp != NULL) {
+		fido_freezero(*kp, sizeof(**kp));
+		*kp = NULL;
+	}
+}
+
+static struct ecdh_key *
+ecdh_key_new(void)
+{
+	struct ecdh_key *k;
+
+	if ((k = fido_calloc(1, sizeof(*k))) == NULL)
+		return (NULL);
+	if (es256_sk_create(&k->sk) < 0 || es256_derive_pk(&k->sk,
+	    &k->pk) < 0) {
+		fido_log_debug("%s: es256_derive_pk", __func__);
+		ecdh_key_free(&k);
+	}
+
+	return (k);
+}
+
+/* a pooled key pair if there is one, otherwise a new one */
+static struct ecdh_key *
+ecdh_key_get(void)
+{
+	struct ecdh_key *k;
+
+	for (size_t i = 0; i < ECDH_POOL_LEN; i++)
+		if (pool_load(&ecdh_pool[i]) != NULL &&
+		    (k = pool_take(&ecdh_pool[i])) != NULL)
+			return (k);
+
+	return (ecdh_key_new());
+}
+
+int
+fido_ecdh_pool_fill(size_t n)
+{
+	struct ecdh_key	*k;
+	size_t		 have = 0;
+
+	if (n > ECDH_POOL_LEN)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	/* keep the first n keys */
+	for (size_t i = 0; i < ECDH_POOL_LEN; i++)
+		if (pool_load(&ecdh_pool[i]) != NULL && have++ >= n) {
+			k = pool_take(&ecdh_pool[i]);
+			ecdh_key_free(&k);
+		}
+
+	for (size_t i = 0; i < ECDH_POOL_LEN && have < n; i++) {
+		if (pool_load(&ecdh_pool[i]) != NULL)
+			continue;
+		if ((k = ecdh_key_new()) == NULL)
+			return (FIDO_ERR_INTERNAL);
+		if (pool_put(&ecdh_pool[i], k))
+			have++;
+		else
+			ecdh_key_free(&k);
+	}
+
+	return (FIDO_OK);
+}
+
 int
 fido_do_ecdh(fido_dev_t *dev, es256_pk_t **pk, fido_blob_t **ecdh, int *ms)
 {
-	es256_sk_t *sk = NULL; /* our private key */
+	struct ecdh_key *key = NULL; /* our key pair */
 	es256_pk_t *ak = NULL; /* authenticator's public key */
+	fido_trace_t span;
+	fido_prof_t prof;
 	int r;
 
 	*pk = NULL;
 	*ecdh = NULL;
-	if ((sk = es256_sk_new()) == NULL || (*pk = es256_pk_new()) == NULL) {
-		r = FIDO_ERR_INTERNAL;
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	fido_prof_begin(&prof, FIDO_PROF_ECDH);
+	if ((r = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
 		goto fail;
 	}
-	if (es256_sk_create(sk) < 0 || es256_derive_pk(sk, *pk) < 0) {
-		fido_log_debug("%s: es256_derive_pk", __func__);
+	/* the key agreement is kept for as long as dev is open */
+	if (dev->ecdh != NULL) {
+		if (ecdh_cache_get(dev, pk, ecdh) < 0)
+			r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	if ((key = ecdh_key_get()) == NULL || (*pk = es256_pk_new()) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
+	memcpy(*pk, &key->pk, sizeof(**pk));
 	if ((ak = es256_pk_new()) == NULL ||
 	    fido_dev_authkey(dev, ak, ms) != FIDO_OK) {
 		fido_log_debug("%s: fido_dev_authkey", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
-	if (do_ecdh(dev, sk, ak, ecdh) < 0) {
+	if (do_ecdh(dev, &key->sk, ak, ecdh) < 0) {
 		fido_log_debug("%s: do_ecdh", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
+	ecdh_cache_put(dev, *pk, *ecdh);
 
 	r = FIDO_OK;
 fail:
-	es256_sk_free(&sk);
+	ecdh_key_free(&key);
 	es256_pk_free(&ak);
 
 	if (r != FIDO_OK) {
@@ -204,5 +355,5 @@ fail:
 		fido_blob_free(ecdh);
 	}
 
-	return r;
+	return fido_trace_end(&span, fido_prof_end(&prof, r));
 }
@@ -11,6 +11,12 @@
 #include "fido.h"
 #include "fido/eddsa.h"
 
+#ifndef TLS
+#define TLS
+#endif
+
+#define PK_CACHE_LEN	8
+
 #if defined(LIBRESSL_VERSION_NUMBER) && LIBRESSL_VERSION_NUMBER < 0x3070000f
 EVP_PKEY *
 EVP_PKEY_new_raw_public_key(int type, ENGINE *e, const unsigned char *key,
@@ -105,7 +111,7 @@ eddsa_pk_decode(const cbor_item_t *item, eddsa_pk_t *k)
 eddsa_pk_t *
 eddsa_pk_new(void)
 {
-	return (calloc(1, sizeof(eddsa_pk_t)));
+	return (fido_calloc(1, sizeof(eddsa_pk_t)));
 }
 
 void
@@ -116,7 +122,7 @@ eddsa_pk_free(eddsa_pk_t **pkp)
 	if (pkp == NULL || (pk = *pkp) == NULL)
 		return;
 
-	freezero(pk, sizeof(*pk));
+	fido_freezero(pk, sizeof(*pk));
 	*pkp = NULL;
 }
 
@@ -130,8 +136,8 @@ eddsa_pk_from_ptr(eddsa_pk_t *pk, const void *ptr, size_t len)
 
 	memcpy(pk, ptr, sizeof(*pk));
 
-	if ((pkey = eddsa_pk_to_EVP_PKEY(pk)) == NULL) {
-		fido_log_debug("%s: eddsa_pk_to_EVP_PKEY", __func__);
+	if ((pkey = eddsa_pk_get_EVP_PKEY(pk)) == NULL) {
+		fido_log_debug("%s: eddsa_pk_get_EVP_PKEY", __func__);
 		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
@@ -152,6 +158,78 @@ eddsa_pk_to_EVP_PKEY(const eddsa_pk_t *k)
 	return (pkey);
 }
 
+/* keys most recently converted in the executing thread */
+static TLS struct pk_cache {
+	eddsa_pk_t	 pk;
+	EVP_PKEY	*pkey;
+	uint64_t	 used;
+} pk_cache[PK_CACHE_LEN];
+static TLS uint64_t pk_tick;
+
+static EVP_PKEY *
+pk_cache_get(const eddsa_pk_t *k)
+{
+#ifndef FIDO_FUZZ
+	struct pk_cache *e;
+
+	for (size_t i = 0; i < PK_CACHE_LEN; i++) {
+		e = &pk_cache[i];
+		if (e->pkey == NULL || memcmp(&e->pk, k, sizeof(*k)) != 0)
+			continue;
+		if (EVP_PKEY_up_ref(e->pkey) != 1) {
+			fido_log_debug("%s: EVP_PKEY_up_ref", __func__);
+			return (NULL);
+		}
+		e->used = ++pk_tick;
+		return (e->pkey);
+	}
+#else
+	(void)k;
+#endif
+	return (NULL);
+}
+
+static void
+pk_cache_put(const eddsa_pk_t *k, EVP_PKEY *pkey)
+{
+#ifndef FIDO_FUZZ
+	struct pk_cache *e = &pk_cache[0];
+
+	for (size_t i = 1; i < PK_CACHE_LEN; i++)
+		if (pk_cache[i].used < e->used)
+			e = &pk_cache[i];
+	if (EVP_PKEY_up_ref(pkey) != 1) {
+		fido_log_debug("%s: EVP_PKEY_up_ref", __func__);
+		return;
+	}
+
+	EVP_PKEY_free(e->pkey);
+	memcpy(&e->pk, k, sizeof(e->pk));
+	e->pkey = pkey;
+	e->used = ++pk_tick;
+#else
+	(void)k;
+	(void)pkey;
+#endif
+}
+
+/*
+ * Like eddsa_pk_to_EVP_PKEY(), but the returned key may be shared with
+ * other callers in the executing thread and must not be modified.
+ */
+EVP_PKEY *
+eddsa_pk_get_EVP_PKEY(const eddsa_pk_t *k)
+{
+	EVP_PKEY *pkey;
+
+	if ((pkey = pk_cache_get(k)) != NULL)
+		return (pkey);
+	if ((pkey = eddsa_pk_to_EVP_PKEY(k)) != NULL)
+		pk_cache_put(k, pkey);
+
+	return (pkey);
+}
+
 int
 eddsa_pk_from_EVP_PKEY(eddsa_pk_t *pk, const EVP_PKEY *pkey)
 {
@@ -169,6 +247,35 @@ eddsa_pk_from_EVP_PKEY(eddsa_pk_t *pk, const EVP_PKEY *pkey)
 	return (FIDO_OK);
 }
 
+/* a digest context reused by the executing thread's verifications */
+static TLS EVP_MD_CTX *verify_mdctx;
+
+static EVP_MD_CTX *
+mdctx_get(void)
+{
+#ifndef FIDO_FUZZ
+	if (verify_mdctx == NULL)
+		verify_mdctx = EVP_MD_CTX_new();
+
+	return (verify_mdctx);
+#else
+	return (EVP_MD_CTX_new());
+#endif
+}
+
+static void
+mdctx_put(EVP_MD_CTX *mdctx)
+{
+#ifndef FIDO_FUZZ
+	if (EVP_MD_CTX_reset(mdctx) != 1) {
+		EVP_MD_CTX_free(mdctx);
+		verify_mdctx = NULL;
+	}
+#else
+	EVP_MD_CTX_free(mdctx);
+#endif
+}
+
 int
 eddsa_verify_sig(const fido_blob_t *dgst, EVP_PKEY *pkey,
     const fido_blob_t *sig)
@@ -188,7 +295,7 @@ eddsa_verify_sig(const fido_blob_t *dgst, EVP_PKEY *pkey,
 		return (-1);
 	}
 
-	if ((mdctx = EVP_MD_CTX_new()) == NULL) {
+	if ((mdctx = mdctx_get()) == NULL) {
 		fido_log_debug("%s: EVP_MD_CTX_new", __func__);
 		goto fail;
 	}
@@ -206,7 +313,8 @@ eddsa_verify_sig(const fido_blob_t *dgst, EVP_PKEY *pkey,
 
 	ok = 0;
 fail:
-	EVP_MD_CTX_free(mdctx);
+	if (mdctx != NULL)
+		mdctx_put(mdctx);
 
 	return (ok);
 }
@@ -218,7 +326,16 @@ eddsa_pk_verify_sig(const fido_blob_t *dgst, const eddsa_pk_t *pk,
 	EVP_PKEY	*pkey;
 	int		 ok = -1;
 
-	if ((pkey = eddsa_pk_to_EVP_PKEY(pk)) == NULL ||
+	switch (fido_verify_handler(COSE_EDDSA, pk, dgst, sig)) {
+	case FIDO_OK:
+		return (0);
+	case FIDO_ERR_UNSUPPORTED_ALGORITHM:
+		break;
+	default:
+		return (-1);
+	}
+
+	if ((pkey = eddsa_pk_get_EVP_PKEY(pk)) == NULL ||
 	    eddsa_verify_sig(dgst, pkey, sig) < 0) {
 		fido_log_debug("%s: eddsa_verify_sig", __func__);
 		goto fail;
@@ -129,6 +129,8 @@ fido_strerr(int n)
 		return "FIDO_ERR_NOTFOUND";
 	case FIDO_ERR_COMPRESS:
 		return "FIDO_ERR_COMPRESS";
+	case FIDO_ERR_SIGCOUNT:
+		return "FIDO_ERR_SIGCOUNT";
 	case FIDO_ERR_INTERNAL:
 		return "FIDO_ERR_INTERNAL";
 	default:
@@ -8,6 +8,9 @@
 #include <openssl/bn.h>
 #include <openssl/ecdsa.h>
 #include <openssl/obj_mac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+#include <openssl/core_names.h>
+#endif
 
 #include "fido.h"
 #include "fido/es256.h"
@@ -18,6 +21,12 @@
 #define get0_EC_KEY(x)	EVP_PKEY_get0((x))
 #endif
 
+#ifndef TLS
+#define TLS
+#endif
+
+#define PK_CACHE_LEN	8
+
 static const int es256_nid = NID_X9_62_prime256v1;
 
 static int
@@ -143,7 +152,7 @@ fail:
 es256_sk_t *
 es256_sk_new(void)
 {
-	return (calloc(1, sizeof(es256_sk_t)));
+	return (fido_calloc(1, sizeof(es256_sk_t)));
 }
 
 void
@@ -154,14 +163,14 @@ es256_sk_free(es256_sk_t **skp)
 	if (skp == NULL || (sk = *skp) == NULL)
 		return;
 
-	freezero(sk, sizeof(*sk));
+	fido_freezero(sk, sizeof(*sk));
 	*skp = NULL;
 }
 
 es256_pk_t *
 es256_pk_new(void)
 {
-	return (calloc(1, sizeof(es256_pk_t)));
+	return (fido_calloc(1, sizeof(es256_pk_t)));
 }
 
 void
@@ -172,7 +181,7 @@ es256_pk_free(es256_pk_t **pkp)
 	if (pkp == NULL || (pk = *pkp) == NULL)
 		return;
 
-	freezero(pk, sizeof(*pk));
+	fido_freezero(pk, sizeof(*pk));
 	*pkp = NULL;
 }
 
@@ -190,8 +199,8 @@ es256_pk_from_ptr(es256_pk_t *pk, const void *ptr, size_t len)
 	else
 		memcpy(pk, ptr, sizeof(*pk)); /* libfido2 x||y format */
 
-	if ((pkey = es256_pk_to_EVP_PKEY(pk)) == NULL) {
-		fido_log_debug("%s: es256_pk_to_EVP_PKEY", __func__);
+	if ((pkey = es256_pk_get_EVP_PKEY(pk)) == NULL) {
+		fido_log_debug("%s: es256_pk_get_EVP_PKEY", __func__);
 		explicit_bzero(pk, sizeof(*pk));
 		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
@@ -265,6 +274,75 @@ fail:
 	return (ok);
 }
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+/* a key import context reused by the executing thread's conversions */
+static TLS EVP_PKEY_CTX *import_pctx;
+
+static EVP_PKEY_CTX *
+import_ctx_get(void)
+{
+	EVP_PKEY_CTX *pctx;
+
+#ifndef FIDO_FUZZ
+	if (import_pctx != NULL)
+		return (import_pctx);
+#endif
+	if ((pctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", NULL)) == NULL ||
+	    EVP_PKEY_fromdata_init(pctx) != 1) {
+		fido_log_debug("%s: EVP_PKEY_fromdata_init", __func__);
+		EVP_PKEY_CTX_free(pctx);
+		return (NULL);
+	}
+#ifndef FIDO_FUZZ
+	import_pctx = pctx;
+#endif
+
+	return (pctx);
+}
+
+static void
+import_ctx_put(EVP_PKEY_CTX *pctx)
+{
+#ifdef FIDO_FUZZ
+	EVP_PKEY_CTX_free(pctx);
+#else
+	(void)pctx;
+#endif
+}
+
+/*
+ * The key is imported through the EC key management provider, without
+ * a legacy EC_KEY. The point is checked to be on the curve on import.
+ */
+EVP_PKEY *
+es256_pk_to_EVP_PKEY(const es256_pk_t *k)
+{
+	EVP_PKEY_CTX	*pctx;
+	EVP_PKEY	*pkey = NULL;
+	OSSL_PARAM	 params[3];
+	unsigned char	 q[1 + sizeof(k->x) + sizeof(k->y)];
+	char		 group[] = SN_X9_62_prime256v1;
+
+	q[0] = POINT_CONVERSION_UNCOMPRESSED;
+	memcpy(&q[1], k->x, sizeof(k->x));
+	memcpy(&q[1 + sizeof(k->x)], k->y, sizeof(k->y));
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_PKEY_PARAM_GROUP_NAME,
+	    group, 0);
+	params[1] = OSSL_PARAM_construct_octet_string(OSSL_PKEY_PARAM_PUB_KEY,
+	    q, sizeof(q));
+	params[2] = OSSL_PARAM_construct_end();
+
+	if ((pctx = import_ctx_get()) == NULL)
+		return (NULL);
+	if (EVP_PKEY_fromdata(pctx, &pkey, EVP_PKEY_PUBLIC_KEY, params) != 1) {
+		fido_log_debug("%s: EVP_PKEY_fromdata", __func__);
+		pkey = NULL;
+	}
+	import_ctx_put(pctx);
+
+	return (pkey);
+}
+#else
 EVP_PKEY *
 es256_pk_to_EVP_PKEY(const es256_pk_t *k)
 {
@@ -332,6 +410,83 @@ fail:
 
 	return (pkey);
 }
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000 */
+
+/*
+ * Keys most recently converted in the executing thread. A key found here
+ * has already been checked to be on the curve, and the converted key is
+ * shared instead of being rebuilt.
+ */
+static TLS struct pk_cache {
+	es256_pk_t	 pk;
+	EVP_PKEY	*pkey;
+	uint64_t	 used;
+} pk_cache[PK_CACHE_LEN];
+static TLS uint64_t pk_tick;
+
+static EVP_PKEY *
+pk_cache_get(const es256_pk_t *k)
+{
+#ifndef FIDO_FUZZ
+	struct pk_cache *e;
+
+	for (size_t i = 0; i < PK_CACHE_LEN; i++) {
+		e = &pk_cache[i];
+		if (e->pkey == NULL || memcmp(&e->pk, k, sizeof(*k)) != 0)
+			continue;
+		if (EVP_PKEY_up_ref(e->pkey) != 1) {
+			fido_log_debug("%s: EVP_PKEY_up_ref", __func__);
+			return (NULL);
+		}
+		e->used = ++pk_tick;
+		return (e->pkey);
+	}
+#else
+	(void)k;
+#endif
+	return (NULL);
+}
+
+static void
+pk_cache_put(const es256_pk_t *k, EVP_PKEY *pkey)
+{
+#ifndef FIDO_FUZZ
+	struct pk_cache *e = &pk_cache[0];
+
+	for (size_t i = 1; i < PK_CACHE_LEN; i++)
+		if (pk_cache[i].used < e->used)
+			e = &pk_cache[i];
+	if (EVP_PKEY_up_ref(pkey) != 1) {
+		fido_log_debug("%s: EVP_PKEY_up_ref", __func__);
+		return;
+	}
+
+	EVP_PKEY_free(e->pkey);
+	memcpy(&e->pk, k, sizeof(e->pk));
+	e->pkey = pkey;
+	e->used = ++pk_tick;
+#else
+	(void)k;
+	(void)pkey;
+#endif
+}
+
+/*
+ * Like es256_pk_to_EVP_PKEY(), but the returned key may be shared with
+ * other callers in the executing thread and must not be modified.
+ */
+EVP_PKEY *
+es256_pk_get_EVP_PKEY(const es256_pk_t *k)
+{
+	EVP_PKEY *pkey;
+
+	if ((pkey = pk_cache_get(k)) != NULL)
+		return (pkey);
+	if ((pkey = es256_pk_to_EVP_PKEY(k)) != NULL)
+		pk_cache_put(k, pkey);
+
+	return (pkey);
+}
 
 int
 es256_pk_from_EC_KEY(es256_pk_t *pk, const EC_KEY *ec)
@@ -375,6 +530,10 @@ es256_pk_from_EC_KEY(es256_pk_t *pk, const EC_KEY *ec)
 	dx = sizeof(pk->x) - (size_t)nx;
 	dy = sizeof(pk->y) - (size_t)ny;
 
+	/* pk may have held a different key */
+	memset(pk->x, 0, dx);
+	memset(pk->y, 0, dy);
+
 	if ((nx = BN_bn2bin(x, pk->x + dx)) < 0 || (size_t)nx > sizeof(pk->x) ||
 	    (ny = BN_bn2bin(y, pk->y + dy)) < 0 || (size_t)ny > sizeof(pk->y)) {
 		fido_log_debug("%s: BN_bn2bin", __func__);
@@ -527,7 +686,16 @@ es256_pk_verify_sig(const fido_blob_t *dgst, const es256_pk_t *pk,
 	EVP_PKEY	*pkey;
 	int		 ok = -1;
 
-	if ((pkey = es256_pk_to_EVP_PKEY(pk)) == NULL ||
+	switch (fido_verify_handler(COSE_ES256, pk, dgst, sig)) {
+	case FIDO_OK:
+		return (0);
+	case FIDO_ERR_UNSUPPORTED_ALGORITHM:
+		break;
+	default:
+		return (-1);
+	}
+
+	if ((pkey = es256_pk_get_EVP_PKEY(pk)) == NULL ||
 	    es256_verify_sig(dgst, pkey, sig) < 0) {
 		fido_log_debug("%s: es256_verify_sig", __func__);
 		goto fail;
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include "fido.h"
+
+/*
+ * Digest and cipher objects. With OpenSSL 3, EVP_sha256() and friends
+ * return a shim that is resolved against the providers by every context
+ * initialised with it, and SHA256() fetches its implementation on every
+ * call. The objects here are fetched once, on first use, and shared by
+ * all threads; a fetched object is never modified. If a fetch fails, the
+ * built-in object is returned instead.
+ */
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define evp_load(p)	_InterlockedCompareExchangePointer((p), NULL, NULL)
+#define evp_cas(p, n) \
+	(_InterlockedCompareExchangePointer((p), (n), NULL) == NULL)
+#else
+#define evp_load(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define evp_cas(p, n)	evp_cas_gcc((p), (n))
+
+static bool
+evp_cas_gcc(void **p, void *n)
+{
+	void *o = NULL;
+
+	return (__atomic_compare_exchange_n(p, &o, n, false, __ATOMIC_ACQ_REL,
+	    __ATOMIC_ACQUIRE));
+}
+#endif
+
+static void *sha1_md;
+static void *sha256_md;
+static void *sha384_md;
+static void *aes256_cbc;
+static void *aes256_gcm;
+
+static const EVP_MD *
+md_get(void **slot, const char *name, const EVP_MD *builtin)
+{
+	EVP_MD *md;
+
+	if ((md = evp_load(slot)) != NULL)
+		return (md);
+	if ((md = EVP_MD_fetch(NULL, name, NULL)) == NULL) {
+		fido_log_debug("%s: EVP_MD_fetch %s", __func__, name);
+		return (builtin);
+	}
+	if (!evp_cas(slot, md)) {
+		/* another thread got there first */
+		EVP_MD_free(md);
+		md = evp_load(slot);
+	}
+
+	return (md);
+}
+
+static const EVP_CIPHER *
+cipher_get(void **slot, const char *name, const EVP_CIPHER *builtin)
+{
+	EVP_CIPHER *cipher;
+
+	if ((cipher = evp_load(slot)) != NULL)
+		return (cipher);
+	if ((cipher = EVP_CIPHER_fetch(NULL, name, NULL)) == NULL) {
+		fido_log_debug("%s: EVP_CIPHER_fetch %s", __func__, name);
+		return (builtin);
+	}
+	if (!evp_cas(slot, cipher)) {
+		EVP_CIPHER_free(cipher);
+		cipher = evp_load(slot);
+	}
+
+	return (cipher);
+}
+
+const EVP_MD *
+fido_md_sha1(void)
+{
+	return (md_get(&sha1_md, "SHA1", EVP_sha1()));
+}
+
+const EVP_MD *
+fido_md_sha256(void)
+{
+	return (md_get(&sha256_md, "SHA2-256", EVP_sha256()));
+}
+
+const EVP_MD *
+fido_md_sha384(void)
+{
+	return (md_get(&sha384_md, "SHA2-384", EVP_sha384()));
+}
+
+const EVP_CIPHER *
+fido_cipher_aes256_cbc(void)
+{
+	return (cipher_get(&aes256_cbc, "AES-256-CBC", EVP_aes_256_cbc()));
+}
+
+const EVP_CIPHER *
+fido_cipher_aes256_gcm(void)
+{
+	return (cipher_get(&aes256_gcm, "AES-256-GCM", EVP_aes_256_gcm()));
+}
+
+int
+fido_sha256_buf(const void *ptr, size_t len, unsigned char *dgst)
+{
+	const EVP_MD *md;
+
+	if ((md = fido_md_sha256()) == NULL ||
+	    EVP_Digest(ptr, len, dgst, NULL, md, NULL) != 1) {
+		fido_log_debug("%s: EVP_Digest", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+#else
+
+const EVP_MD *
+fido_md_sha1(void)
+{
+	return (EVP_sha1());
+}
+
+const EVP_MD *
+fido_md_sha256(void)
+{
+	return (EVP_sha256());
+}
+
+const EVP_MD *
+fido_md_sha384(void)
+{
+	return (EVP_sha384());
+}
+
+const EVP_CIPHER *
+fido_cipher_aes256_cbc(void)
+{
+	return (EVP_aes_256_cbc());
+}
+
+const EVP_CIPHER *
+fido_cipher_aes256_gcm(void)
+{
+	return (EVP_aes_256_gcm());
+}
+
+int
+fido_sha256_buf(const void *ptr, size_t len, unsigned char *dgst)
+{
+	if (SHA256(ptr, len, dgst) != dgst) {
+		fido_log_debug("%s: SHA256", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000 */
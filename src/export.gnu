@@ -30,6 +30,8 @@
 		fido_assert_empty_allow_list;
 		fido_assert_flags;
 		fido_assert_free;
+		fido_assert_from_webauthn_json;
+		fido_assert_hmac_secret_batch;
 		fido_assert_hmac_secret_len;
 		fido_assert_hmac_secret_ptr;
 		fido_assert_id_len;
@@ -37,18 +39,27 @@
 		fido_assert_largeblob_key_len;
 		fido_assert_largeblob_key_ptr;
 		fido_assert_new;
+		fido_assert_pending;
+		fido_assert_recycle;
 		fido_assert_rp_id;
+		fido_assert_set_allow_list;
 		fido_assert_set_authdata;
 		fido_assert_set_authdata_raw;
 		fido_assert_set_clientdata;
+		fido_assert_set_clientdata_final;
 		fido_assert_set_clientdata_hash;
+		fido_assert_set_clientdata_init;
+		fido_assert_set_clientdata_update;
 		fido_assert_set_count;
 		fido_assert_set_extensions;
+		fido_assert_set_fetch_limit;
 		fido_assert_set_hmac_salt;
 		fido_assert_set_hmac_secret;
+		fido_assert_set_lazy;
 		fido_assert_set_options;
 		fido_assert_set_rp;
 		fido_assert_set_sig;
+		fido_assert_set_u2f_flags;
 		fido_assert_set_up;
 		fido_assert_set_uv;
 		fido_assert_set_winhello_appid;
@@ -61,10 +72,20 @@
 		fido_assert_user_id_ptr;
 		fido_assert_user_name;
 		fido_assert_verify;
+		fido_assert_verify_batch;
+		fido_assert_verify_keystore;
+		fido_assert_verify_prepared;
+		fido_attest_store_add;
+		fido_attest_store_free;
+		fido_attest_store_new;
+		fido_base64_decode;
+		fido_base64_encode;
 		fido_bio_dev_enroll_begin;
 		fido_bio_dev_enroll_cancel;
+		fido_bio_dev_enroll_complete;
 		fido_bio_dev_enroll_continue;
 		fido_bio_dev_enroll_remove;
+		fido_bio_dev_enroll_submit;
 		fido_bio_dev_get_info;
 		fido_bio_dev_get_template_array;
 		fido_bio_dev_set_template_name;
@@ -87,6 +108,11 @@
 		fido_bio_template_new;
 		fido_bio_template_set_id;
 		fido_bio_template_set_name;
+		fido_broker_attach;
+		fido_broker_free;
+		fido_broker_new;
+		fido_broker_open;
+		fido_broker_work;
 		fido_cbor_info_aaguid_len;
 		fido_cbor_info_aaguid_ptr;
 		fido_cbor_info_algorithm_cose;
@@ -108,8 +134,10 @@
 		fido_cbor_info_minpinlen;
 		fido_cbor_info_new;
 		fido_cbor_info_new_pin_required;
+		fido_cbor_info_options_enabled;
 		fido_cbor_info_options_len;
 		fido_cbor_info_options_name_ptr;
+		fido_cbor_info_options_present;
 		fido_cbor_info_options_value_ptr;
 		fido_cbor_info_protocols_len;
 		fido_cbor_info_protocols_ptr;
@@ -128,23 +156,35 @@
 		fido_cred_authdata_raw_ptr;
 		fido_cred_clientdata_hash_len;
 		fido_cred_clientdata_hash_ptr;
+		fido_cred_deserialize;
 		fido_cred_display_name;
 		fido_cred_empty_exclude_list;
 		fido_cred_exclude;
 		fido_cred_flags;
+		fido_cred_hmac_secret_len;
+		fido_cred_hmac_secret_ptr;
 		fido_cred_largeblob_key_len;
 		fido_cred_largeblob_key_ptr;
+		fido_cred_serialize;
 		fido_cred_sigcount;
 		fido_cred_fmt;
 		fido_cred_free;
+		fido_cred_from_webauthn_json;
 		fido_cred_id_len;
 		fido_cred_id_ptr;
 		fido_cred_aaguid_len;
 		fido_cred_aaguid_ptr;
 		fido_credman_del_dev_rk;
+		fido_credman_del_dev_rk_batch;
 		fido_credman_get_dev_metadata;
 		fido_credman_get_dev_rk;
+		fido_credman_get_dev_rk_all;
 		fido_credman_get_dev_rp;
+		fido_credman_iter_begin;
+		fido_credman_iter_end;
+		fido_credman_iter_free;
+		fido_credman_iter_new;
+		fido_credman_iter_next;
 		fido_credman_metadata_free;
 		fido_credman_metadata_new;
 		fido_credman_rk;
@@ -160,12 +200,20 @@
 		fido_credman_rp_id_hash_ptr;
 		fido_credman_rp_name;
 		fido_credman_rp_new;
+		fido_credman_session_begin;
+		fido_credman_session_end;
+		fido_credman_session_free;
+		fido_credman_session_new;
+		fido_credman_session_rk;
+		fido_credman_session_rp;
 		fido_credman_set_dev_rk;
+		fido_credman_set_dev_rk_batch;
 		fido_cred_new;
 		fido_cred_pin_minlen;
 		fido_cred_prot;
 		fido_cred_pubkey_len;
 		fido_cred_pubkey_ptr;
+		fido_cred_recycle;
 		fido_cred_rp_id;
 		fido_cred_rp_name;
 		fido_cred_set_attstmt;
@@ -174,9 +222,14 @@
 		fido_cred_set_authdata_raw;
 		fido_cred_set_blob;
 		fido_cred_set_clientdata;
+		fido_cred_set_clientdata_final;
 		fido_cred_set_clientdata_hash;
+		fido_cred_set_clientdata_init;
+		fido_cred_set_clientdata_update;
+		fido_cred_set_exclude_list;
 		fido_cred_set_extensions;
 		fido_cred_set_fmt;
+		fido_cred_set_hmac_salt;
 		fido_cred_set_id;
 		fido_cred_set_options;
 		fido_cred_set_pin_minlen;
@@ -195,7 +248,10 @@
 		fido_cred_user_id_ptr;
 		fido_cred_user_name;
 		fido_cred_verify;
+		fido_cred_verify_batch;
+		fido_cred_verify_chain;
 		fido_cred_verify_self;
+		fido_cred_verify_self_pk;
 		fido_cred_x5c_len;
 		fido_cred_x5c_list_count;
 		fido_cred_x5c_list_len;
@@ -203,6 +259,7 @@
 		fido_cred_x5c_ptr;
 		fido_dev_build;
 		fido_dev_cancel;
+		fido_dev_cancel_many;
 		fido_dev_close;
 		fido_dev_enable_entattest;
 		fido_dev_flags;
@@ -211,13 +268,22 @@
 		fido_dev_force_u2f;
 		fido_dev_free;
 		fido_dev_get_assert;
+		fido_dev_get_assert_complete;
+		fido_dev_get_assert_next;
+		fido_dev_get_assert_submit;
 		fido_dev_get_cbor_info;
+		fido_dev_get_pollfd;
+		fido_dev_get_pollhandle;
+		fido_dev_cbor_info;
 		fido_dev_get_retry_count;
 		fido_dev_get_uv_retry_count;
 		fido_dev_get_touch_begin;
+		fido_dev_get_touch_any;
 		fido_dev_get_touch_status;
+		fido_dev_health_snapshot;
 		fido_dev_has_pin;
 		fido_dev_has_uv;
+		fido_dev_hmac_secret;
 		fido_dev_info_free;
 		fido_dev_info_manifest;
 		fido_dev_info_manufacturer_string;
@@ -226,26 +292,62 @@
 		fido_dev_info_product;
 		fido_dev_info_product_string;
 		fido_dev_info_ptr;
+		fido_dev_info_serial_string;
 		fido_dev_info_set;
 		fido_dev_info_vendor;
 		fido_dev_io_handle;
 		fido_dev_is_fido2;
 		fido_dev_is_winhello;
+		fido_dev_lock;
 		fido_dev_major;
 		fido_dev_make_cred;
+		fido_dev_make_cred_complete;
+		fido_dev_make_cred_submit;
 		fido_dev_minor;
+		fido_dev_monitor_fd;
+		fido_dev_monitor_free;
+		fido_dev_monitor_len;
+		fido_dev_monitor_new;
+		fido_dev_monitor_poll;
+		fido_dev_monitor_ptr;
+		fido_dev_monitor_set_cb;
+		fido_dev_monitor_start;
 		fido_dev_new;
 		fido_dev_new_with_info;
 		fido_dev_open;
+		fido_dev_open_channel;
+		fido_dev_open_many;
 		fido_dev_open_with_info;
+		fido_dev_ping;
+		fido_dev_poll;
+		fido_dev_pool_add;
+		fido_dev_pool_dev;
+		fido_dev_pool_free;
+		fido_dev_pool_len;
+		fido_dev_pool_new;
+		fido_dev_pool_open;
+		fido_dev_pool_rewind;
+		fido_dev_pool_set_progress;
+		fido_dev_pool_status;
+		fido_dev_pool_work;
 		fido_dev_protocol;
+		fido_dev_prewarm;
 		fido_dev_reset;
+		fido_dev_set_adaptive_timeout;
 		fido_dev_set_io_functions;
+		fido_dev_set_keepalive_handler;
+		fido_dev_set_largeblob_cache;
+		fido_dev_set_largeblob_progress;
+		fido_dev_set_largeblob_retry;
+		fido_dev_set_lock;
+		fido_dev_set_log_level;
+		fido_dev_set_metrics_handler;
 		fido_dev_set_pin;
 		fido_dev_set_pin_minlen;
 		fido_dev_set_pin_minlen_rpid;
 		fido_dev_set_sigmask;
 		fido_dev_set_timeout;
+		fido_dev_set_token_cache;
 		fido_dev_set_transport_functions;
 		fido_dev_supports_cred_prot;
 		fido_dev_supports_credman;
@@ -253,13 +355,51 @@
 		fido_dev_supports_pin;
 		fido_dev_supports_uv;
 		fido_dev_toggle_always_uv;
+		fido_dev_unlock;
+		fido_dev_largeblob_add_dict;
 		fido_dev_largeblob_get;
 		fido_dev_largeblob_get_array;
+		fido_dev_largeblob_get_batch;
 		fido_dev_largeblob_remove;
+		fido_dev_largeblob_remove_batch;
 		fido_dev_largeblob_set;
 		fido_dev_largeblob_set_array;
+		fido_dev_largeblob_set_batch;
+		fido_ecdh_pool_fill;
 		fido_init;
+		fido_keystore_add;
+		fido_keystore_add_cred;
+		fido_keystore_add_rk;
+		fido_keystore_count;
+		fido_keystore_free;
+		fido_keystore_get_pk;
+		fido_keystore_get_sigcount;
+		fido_keystore_new;
+		fido_keystore_open;
+		fido_keystore_update_sigcount;
+		fido_keystore_write;
+		fido_largeblob_array_match;
+		fido_pk_free;
+		fido_pk_new;
+		fido_pk_set;
+		fido_pk_set_cose;
+		fido_pk_set_der;
+		fido_pk_type;
+		fido_remote_free;
+		fido_remote_new;
+		fido_remote_open;
+		fido_remote_work;
+		fido_set_allocator;
+		fido_set_capture_handler;
+		fido_set_deadline;
+		fido_set_global_log_handler;
+		fido_set_log_context_handler;
 		fido_set_log_handler;
+		fido_set_log_level;
+		fido_set_quirk;
+		fido_set_secure_pool;
+		fido_set_trace_handler;
+		fido_set_verify_handler;
 		fido_strerr;
 		rs256_pk_free;
 		rs256_pk_from_ptr;
@@ -18,6 +18,7 @@
 
 #include <stdint.h>
 
+#include "fido/param.h"
 #include "fido/types.h"
 #include "blob.h"
 
@@ -25,45 +26,73 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/* allocator */
+void *fido_malloc(size_t);
+void *fido_calloc(size_t, size_t);
+void *fido_realloc(void *, size_t);
+void *fido_recallocarray(void *, size_t, size_t, size_t);
+void fido_free(void *);
+void fido_freezero(void *, size_t);
+char *fido_strdup(const char *);
+int fido_asprintf(char **, const char *, ...);
+void *fido_secure_alloc(size_t);
+size_t fido_secure_size(const void *);
+int fido_secure_free(void *);
+
 /* aes256 */
 int aes256_cbc_dec(const fido_dev_t *dev, const fido_blob_t *,
     const fido_blob_t *, fido_blob_t *);
+int aes256_cbc_dec_ctx(const fido_dev_t *, EVP_CIPHER_CTX **,
+    const fido_blob_t *, const fido_blob_t *, fido_blob_t *);
 int aes256_cbc_enc(const fido_dev_t *dev, const fido_blob_t *,
     const fido_blob_t *, fido_blob_t *);
 int aes256_gcm_dec(const fido_blob_t *, const fido_blob_t *,
     const fido_blob_t *, const fido_blob_t *, fido_blob_t *);
+int aes256_gcm_dec_ctx(EVP_CIPHER_CTX *, const fido_blob_t *,
+    const fido_blob_t *, const fido_blob_t *, unsigned char *);
 int aes256_gcm_enc(const fido_blob_t *, const fido_blob_t *,
     const fido_blob_t *, const fido_blob_t *, fido_blob_t *);
+EVP_CIPHER_CTX *aes256_gcm_dec_new(const fido_blob_t *);
+struct aes256_cache *aes256_cache_new(void);
+void aes256_cache_free(struct aes256_cache **);
+EVP_CIPHER_CTX *aes256_gcm_enc_new(const fido_blob_t *, const fido_blob_t *,
+    const fido_blob_t *);
+int aes256_gcm_enc_update(EVP_CIPHER_CTX *, const u_char *, size_t,
+    fido_blob_t *);
+int aes256_gcm_enc_final(EVP_CIPHER_CTX *, fido_blob_t *);
 
 /* cbor encoding functions */
 cbor_item_t *cbor_build_uint(const uint64_t);
 cbor_item_t *cbor_flatten_vector(cbor_item_t **, size_t);
-cbor_item_t *cbor_encode_assert_opt(fido_opt_t, fido_opt_t);
 cbor_item_t *cbor_encode_change_pin_auth(const fido_dev_t *,
     const fido_blob_t *, const fido_blob_t *, const fido_blob_t *);
-cbor_item_t *cbor_encode_cred_ext(const fido_cred_ext_t *, const fido_blob_t *);
+cbor_item_t *cbor_encode_cred_ext(fido_dev_t *, const fido_cred_ext_t *,
+    const fido_blob_t *, const fido_blob_t *, const es256_pk_t *);
 cbor_item_t *cbor_encode_assert_ext(fido_dev_t *,
     const fido_assert_ext_t *, const fido_blob_t *, const es256_pk_t *);
-cbor_item_t *cbor_encode_cred_opt(fido_opt_t, fido_opt_t);
 cbor_item_t *cbor_encode_pin_auth(const fido_dev_t *, const fido_blob_t *,
     const fido_blob_t *);
 cbor_item_t *cbor_encode_pin_opt(const fido_dev_t *);
 cbor_item_t *cbor_encode_pubkey(const fido_blob_t *);
-cbor_item_t *cbor_encode_pubkey_list(const fido_blob_array_t *);
 cbor_item_t *cbor_encode_pubkey_param(int);
+int cbor_encode_pubkey_list(const fido_blob_array_t *, fido_blob_t *);
 cbor_item_t *cbor_encode_rp_entity(const fido_rp_t *);
 cbor_item_t *cbor_encode_str_array(const fido_str_array_t *);
 cbor_item_t *cbor_encode_user_entity(const fido_user_t *);
 cbor_item_t *es256_pk_encode(const es256_pk_t *, int);
 
 /* cbor decoding functions */
+cbor_item_t *cbor_load_ctap(const unsigned char *, size_t,
+    struct cbor_load_result *);
 int cbor_decode_attstmt(const cbor_item_t *, fido_attstmt_t *);
 int cbor_decode_attobj(const cbor_item_t *, fido_cred_t *);
 int cbor_decode_bool(const cbor_item_t *, bool *);
 int cbor_decode_cred_authdata(const cbor_item_t *, int, fido_blob_t *,
     fido_authdata_t *, fido_attcred_t *, fido_cred_ext_t *);
-int cbor_decode_assert_authdata(const cbor_item_t *, fido_blob_t *,
-    fido_authdata_t *, fido_assert_extattr_t *);
+int cbor_decode_cred_authdata_raw(const fido_blob_t *, int, fido_authdata_t *,
+    fido_attcred_t *, fido_cred_ext_t *);
+int cbor_decode_assert_authdata_raw(const fido_blob_t *, fido_authdata_t *,
+    fido_assert_extattr_t *);
 int cbor_decode_cred_id(const cbor_item_t *, fido_blob_t *);
 int cbor_decode_fmt(const cbor_item_t *, char **);
 int cbor_decode_pubkey(const cbor_item_t *, int *, void *);
@@ -82,13 +111,31 @@ int cbor_add_bytestring(cbor_item_t *, const char *, const unsigned char *,
 int cbor_add_string(cbor_item_t *, const char *, const char *);
 int cbor_array_iter(const cbor_item_t *, void *, int(*)(const cbor_item_t *,
     void *));
+int cbor_build_assert_frame(const fido_assert_t *, fido_opt_t, cbor_item_t *[],
+    fido_blob_t *, size_t *);
+int cbor_build_cred_frame(const fido_cred_t *, fido_opt_t, cbor_item_t *[],
+    fido_blob_t *);
 int cbor_build_frame(uint8_t, cbor_item_t *[], size_t, fido_blob_t *);
 int cbor_bytestring_copy(const cbor_item_t *, unsigned char **, size_t *);
 int cbor_map_iter(const cbor_item_t *, void *, int(*)(const cbor_item_t *,
     const cbor_item_t *, void *));
 int cbor_string_copy(const cbor_item_t *, char **);
+int cbor_unwrap_bytestring(const unsigned char *, size_t,
+    const unsigned char **, size_t *);
+int cbor_wrap_bytestring(const fido_blob_t *, fido_blob_t *);
+int cbor_parse_assert_reply(unsigned char *, size_t, fido_assert_stmt *,
+    uint64_t *, unsigned int);
+int cbor_parse_attobj(unsigned char *, size_t, fido_cred_t *);
+bool cbor_is_shortest(const unsigned char *, size_t);
+int cbor_index_reply(const unsigned char *, size_t, const unsigned char **,
+    size_t *, size_t);
+int cbor_read_pubkey(const unsigned char **, size_t *, int *, void *);
+int cbor_read_uint64(const unsigned char *, size_t, uint64_t *);
 int cbor_parse_reply(const unsigned char *, size_t, void *,
     int(*)(const cbor_item_t *, const cbor_item_t *, void *));
+int cbor_parse_reply_prepare(const unsigned char *, size_t, void *,
+    int(*)(const cbor_item_t *, void *),
+    int(*)(const cbor_item_t *, const cbor_item_t *, void *));
 int cbor_add_uv_params(fido_dev_t *, uint8_t, const fido_blob_t *,
     const es256_pk_t *, const fido_blob_t *, const char *, const char *,
     cbor_item_t **, cbor_item_t **, int *);
@@ -98,7 +145,11 @@ int cbor_array_drop(cbor_item_t **, size_t);
 
 /* deflate */
 int fido_compress(fido_blob_t *, const fido_blob_t *);
+int fido_compress_stream(const fido_blob_t *, int, int, const fido_blob_t *,
+    int (*)(void *, const u_char *, size_t), void *);
 int fido_uncompress(fido_blob_t *, const fido_blob_t *, size_t);
+int fido_uncompress_dict(fido_blob_t *, const fido_blob_t *, size_t,
+    const fido_blob_array_t *);
 
 #ifndef nitems
 #define nitems(_a)	(sizeof((_a)) / sizeof((_a)[0]))
@@ -117,9 +168,17 @@ int fido_hid_get_usage(const uint8_t *, size_t, uint32_t *);
 int fido_hid_get_report_len(const uint8_t *, size_t, size_t *, size_t *);
 int fido_hid_unix_open(const char *);
 int fido_hid_unix_wait(int, int, const fido_sigset_t *);
+int fido_hid_unix_wait_many(const int *, bool *, size_t, int);
 int fido_hid_set_sigmask(void *, const fido_sigset_t *);
 size_t fido_hid_report_in_len(void *);
 size_t fido_hid_report_out_len(void *);
+int fido_hid_fd(void *);
+bool fido_hid_buffered(void *);
+void *fido_hid_win_event(void *);
+void *fido_hid_monitor_open(void);
+void  fido_hid_monitor_close(void *);
+int fido_hid_monitor_fd(void *);
+int fido_hid_monitor_read(void *, int *, fido_dev_info_t *);
 
 /* nfc i/o */
 bool fido_is_nfc(const char *);
@@ -131,6 +190,7 @@ int fido_nfc_write(void *, const unsigned char *, size_t);
 int fido_nfc_rx(fido_dev_t *, uint8_t, unsigned char *, size_t, int);
 int fido_nfc_tx(fido_dev_t *, uint8_t, const unsigned char *, size_t);
 int fido_nfc_set_sigmask(void *, const fido_sigset_t *);
+int fido_nfc_fd(void *);
 int fido_dev_set_nfc(fido_dev_t *);
 
 /* pcsc i/o */
@@ -143,6 +203,36 @@ int fido_pcsc_rx(fido_dev_t *, uint8_t, unsigned char *, size_t, int);
 int fido_pcsc_tx(fido_dev_t *, uint8_t, const unsigned char *, size_t);
 int fido_dev_set_pcsc(fido_dev_t *);
 
+/* broker i/o */
+bool fido_is_broker(const char *);
+void *fido_broker_io_open(const char *);
+void  fido_broker_io_close(void *);
+int fido_broker_io_read(void *, unsigned char *, size_t, int);
+int fido_broker_io_write(void *, const unsigned char *, size_t);
+int fido_dev_set_broker(fido_dev_t *);
+
+/* remote devices */
+bool fido_is_remote(const char *);
+void *fido_remote_io_open(const char *);
+void  fido_remote_io_close(void *);
+int fido_remote_rx(fido_dev_t *, uint8_t, unsigned char *, size_t, int);
+int fido_remote_tx(fido_dev_t *, uint8_t, const unsigned char *, size_t);
+int fido_dev_set_remote(fido_dev_t *);
+
+/* stream sockets */
+bool fido_sock_is_unix(const char *);
+int fido_sock_accept(int);
+int fido_sock_connect(const char *);
+int fido_sock_listen(const char *);
+int fido_sock_pair(int [2]);
+int fido_sock_peek(int, unsigned char *, size_t);
+int fido_sock_poll(int, int);
+int fido_sock_recv(int, unsigned char *, size_t);
+int fido_sock_send(int, const unsigned char *, size_t);
+int fido_sock_set_timeout(int, int);
+void fido_sock_close(int);
+void fido_sock_nosigpipe(int);
+
 /* windows hello */
 int fido_winhello_manifest(fido_dev_info_t *, size_t, size_t *);
 int fido_winhello_open(fido_dev_t *);
@@ -151,36 +241,86 @@ int fido_winhello_cancel(fido_dev_t *);
 int fido_winhello_get_assert(fido_dev_t *, fido_assert_t *, const char *, int);
 int fido_winhello_get_cbor_info(fido_dev_t *, fido_cbor_info_t *);
 int fido_winhello_make_cred(fido_dev_t *, fido_cred_t *, const char *, int);
+int fido_winhello_get_assert_submit(fido_dev_t *, fido_assert_t *,
+    const char *, int);
+int fido_winhello_get_assert_complete(fido_dev_t *, fido_assert_t *);
+int fido_winhello_make_cred_submit(fido_dev_t *, fido_cred_t *, const char *,
+    int);
+int fido_winhello_make_cred_complete(fido_dev_t *, fido_cred_t *);
+int fido_winhello_poll(fido_dev_t *, int);
+void *fido_winhello_handle(const fido_dev_t *);
+void fido_winhello_assert_cache_free(fido_assert_t *);
 
 /* generic i/o */
 int fido_rx_cbor_status(fido_dev_t *, int *);
+int fido_rx_poll(fido_dev_t *, int *);
+bool fido_rx_buffered(const fido_dev_t *);
 int fido_rx(fido_dev_t *, uint8_t, void *, size_t, int *);
 int fido_tx(fido_dev_t *, uint8_t, const void *, size_t, int *);
 
-/* log */
+/* channels sharing a handle */
+int fido_chan_attach(fido_dev_t *, fido_dev_t *);
+int fido_chan_detach(fido_dev_t *);
+void fido_chan_set_cid(fido_dev_t *);
+bool fido_chan_pending(const fido_dev_t *);
+int fido_chan_read(fido_dev_t *, unsigned char *, size_t, int);
+int fido_chan_write(fido_dev_t *, const unsigned char *, size_t);
+
+/*
+ * log; the macros test whether logging is enabled, and the level of
+ * the device being operated on, before evaluating their arguments.
+ * Per-frame transport traces may be compiled out separately with
+ * FIDO_NO_FRAME_LOG.
+ */
 #ifdef FIDO_NO_DIAGNOSTIC
 #define fido_log_init(...)	do { /* nothing */ } while (0)
 #define fido_log_debug(...)	do { /* nothing */ } while (0)
 #define fido_log_xxd(...)	do { /* nothing */ } while (0)
 #define fido_log_error(...)	do { /* nothing */ } while (0)
+#define fido_log_push(...)	do { /* nothing */ } while (0)
+#define fido_log_pop()		do { /* nothing */ } while (0)
 #else
+#ifndef TLS
+#define TLS
+#endif
+extern TLS int fido_log_thread; /* logging enabled in this thread */
+extern int fido_log_global;     /* logging enabled in all threads */
+#define fido_log_enabled()	(fido_log_thread || fido_log_global)
+#define fido_log_wanted(level)	(fido_log_enabled() && \
+	fido_log_level_ok(level))
+#define fido_log_debug(...)	do { if (fido_log_wanted(FIDO_LOG_DEBUG)) \
+	fido_do_log_debug(__VA_ARGS__); } while (0)
+#define fido_log_xxd(...)	do { if (fido_log_wanted(FIDO_LOG_XXD)) \
+	fido_do_log_xxd(__VA_ARGS__); } while (0)
+#define fido_log_error(...)	do { if (fido_log_wanted(FIDO_LOG_ERROR)) \
+	fido_do_log_error(__VA_ARGS__); } while (0)
+bool fido_log_level_ok(int);
+void fido_log_push(const fido_dev_t *, const char *);
+void fido_log_pop(void);
 #ifdef __GNUC__
 void fido_log_init(void);
-void fido_log_debug(const char *, ...)
+void fido_do_log_debug(const char *, ...)
     __attribute__((__format__ (printf, 1, 2)));
-void fido_log_xxd(const void *, size_t, const char *, ...)
+void fido_do_log_xxd(const void *, size_t, const char *, ...)
     __attribute__((__format__ (printf, 3, 4)));
-void fido_log_error(int, const char *, ...)
+void fido_do_log_error(int, const char *, ...)
     __attribute__((__format__ (printf, 2, 3)));
 #else
 void fido_log_init(void);
-void fido_log_debug(const char *, ...);
-void fido_log_xxd(const void *, size_t, const char *, ...);
-void fido_log_error(int, const char *, ...);
+void fido_do_log_debug(const char *, ...);
+void fido_do_log_xxd(const void *, size_t, const char *, ...);
+void fido_do_log_error(int, const char *, ...);
 #endif /* __GNUC__ */
 #endif /* FIDO_NO_DIAGNOSTIC */
+#if defined(FIDO_NO_DIAGNOSTIC) || defined(FIDO_NO_FRAME_LOG)
+#define fido_log_frame(...)	do { /* nothing */ } while (0)
+#define fido_log_frame_xxd(...)	do { /* nothing */ } while (0)
+#else
+#define fido_log_frame(...)	fido_log_debug(__VA_ARGS__)
+#define fido_log_frame_xxd(...)	fido_log_xxd(__VA_ARGS__)
+#endif
 
-/* u2f */
+/* u2f; absent with FIDO_NO_U2F */
 int u2f_register(fido_dev_t *, fido_cred_t *, int *);
 int u2f_authenticate(fido_dev_t *, fido_assert_t *, int *);
 int u2f_get_touch_begin(fido_dev_t *, int *);
@@ -189,38 +329,76 @@ int u2f_get_touch_status(fido_dev_t *, int *, int *);
 /* unexposed fido ops */
 uint8_t fido_dev_get_pin_protocol(const fido_dev_t *);
 int fido_dev_authkey(fido_dev_t *, es256_pk_t *, int *);
+int fido_dev_get_cbor_info_rx(fido_dev_t *, fido_cbor_info_t *, int *);
+int fido_dev_get_cbor_info_tx(fido_dev_t *, int *);
 int fido_dev_get_cbor_info_wait(fido_dev_t *, fido_cbor_info_t *, int *);
+int fido_dev_get_deferred_info(fido_dev_t *, int *);
+int fido_dev_get_pin_retry_count_wait(fido_dev_t *, int *, int *);
+int fido_dev_get_uv_retry_count_wait(fido_dev_t *, int *, int *);
+int fido_credman_get_metadata_wait(fido_dev_t *,
+    struct fido_credman_metadata *, const char *, int *);
+int fido_bio_get_info_wait(fido_dev_t *, struct fido_bio_info *, int *);
 int fido_dev_get_uv_token(fido_dev_t *, uint8_t, const char *,
     const fido_blob_t *, const es256_pk_t *, const char *, fido_blob_t *,
     int *);
+int fido_dev_probe_creds(fido_dev_t *, const char *, const fido_blob_t *,
+    fido_blob_t *, size_t, int *);
 uint64_t fido_dev_maxmsgsize(const fido_dev_t *);
 int fido_do_ecdh(fido_dev_t *, es256_pk_t **, fido_blob_t **, int *);
+void fido_dev_invalidate_channel(const fido_dev_t *);
+void fido_dev_async_reset(fido_dev_t *);
+void fido_dev_token_cache_reset(fido_dev_t *);
+void fido_dev_largeblob_cache_reset(fido_dev_t *);
+size_t fido_dev_msgbuf_len(const fido_dev_t *);
+unsigned char *fido_dev_msgbuf_get(fido_dev_t *, size_t *);
+void fido_dev_msgbuf_put(fido_dev_t *, unsigned char *, size_t);
+void fido_dev_msgbuf_dirty(fido_dev_t *, size_t, int);
+void fido_dev_lock_begin(fido_dev_t *, int *);
+void fido_dev_lock_end(fido_dev_t *);
 
 /* types */
-void fido_algo_array_free(fido_algo_array_t *);
-void fido_byte_array_free(fido_byte_array_t *);
-void fido_cert_array_free(fido_cert_array_t *);
-void fido_opt_array_free(fido_opt_array_t *);
 void fido_str_array_free(fido_str_array_t *);
-void fido_algo_free(fido_algo_t *);
 int fido_str_array_pack(fido_str_array_t *, const char * const *, size_t);
 
 /* misc */
+int fido_assert_decode_authdata(fido_assert_stmt *);
 void fido_assert_reset_rx(fido_assert_t *);
 void fido_assert_reset_tx(fido_assert_t *);
 void fido_cred_reset_rx(fido_cred_t *);
 void fido_cred_reset_tx(fido_cred_t *);
 void fido_cbor_info_reset(fido_cbor_info_t *);
+int fido_cbor_info_decode(fido_cbor_info_t *, const unsigned char *, size_t);
+void fido_cbor_info_cache_init(bool);
+fido_cbor_info_t *fido_cbor_info_cache_get(const unsigned char *, uint64_t);
 int fido_blob_serialise(fido_blob_t *, const cbor_item_t *);
 int fido_check_flags(uint8_t, fido_opt_t, fido_opt_t);
-int fido_check_rp_id(const char *, const unsigned char *);
+int fido_check_rp_id(const char *, const fido_blob_t *,
+    const unsigned char *);
+int fido_get_nonce(void *, size_t);
 int fido_get_random(void *, size_t);
 int fido_sha256(fido_blob_t *, const u_char *, size_t);
+int fido_sha256_buf(const void *, size_t, unsigned char *);
+int fido_sha256_final(EVP_MD_CTX **, fido_blob_t *);
+int fido_sha256_init(EVP_MD_CTX **);
+int fido_sha256_update(EVP_MD_CTX *, const u_char *, size_t);
 int fido_time_now(struct timespec *);
 int fido_time_delta(const struct timespec *, int *);
+int fido_time_deadline(fido_deadline_t *, int, struct timespec *);
+int fido_time_wait(fido_deadline_t *, int *);
+int fido_time_remain(fido_deadline_t *, int *);
+int fido_time_sleep(unsigned int, int *);
+int fido_time_budget(int);
 int fido_to_uint64(const char *, int, uint64_t *);
 
 /* crypto */
+const EVP_CIPHER *fido_cipher_aes256_cbc(void);
+const EVP_CIPHER *fido_cipher_aes256_gcm(void);
+const EVP_MD *fido_md_sha1(void);
+const EVP_MD *fido_md_sha256(void);
+const EVP_MD *fido_md_sha384(void);
+EVP_PKEY *eddsa_pk_get_EVP_PKEY(const eddsa_pk_t *);
+EVP_PKEY *es256_pk_get_EVP_PKEY(const es256_pk_t *);
+EVP_PKEY *es384_pk_get_EVP_PKEY(const es384_pk_t *);
 int es256_verify_sig(const fido_blob_t *, EVP_PKEY *, const fido_blob_t *);
 int es384_verify_sig(const fido_blob_t *, EVP_PKEY *, const fido_blob_t *);
 int rs256_verify_sig(const fido_blob_t *, EVP_PKEY *, const fido_blob_t *);
@@ -234,15 +412,42 @@ int rs256_pk_verify_sig(const fido_blob_t *, const rs256_pk_t *,
     const fido_blob_t *);
 int eddsa_pk_verify_sig(const fido_blob_t *, const eddsa_pk_t *,
     const fido_blob_t *);
+int fido_pk_verify_sig(const fido_blob_t *, const fido_pk_t *,
+    const fido_blob_t *);
+void fido_pk_reset(fido_pk_t *);
+void fido_prof_init(bool);
+void fido_prof_begin(fido_prof_t *, int);
+int fido_prof_end(fido_prof_t *, int);
+void fido_prof_dump(const char *);
+void fido_trace_begin(fido_trace_t *, const fido_dev_t *, const char *,
+    uint8_t, uint8_t, size_t);
+int fido_trace_end(fido_trace_t *, int);
+int fido_verify_handler(int, const void *, const fido_blob_t *,
+    const fido_blob_t *);
+void fido_verify_cache_init(bool);
+int fido_verify_cache_key(unsigned char *, int, const void *, size_t,
+    const fido_blob_t *, const fido_blob_t *);
+bool fido_verify_cache_get(const unsigned char *, int *);
+void fido_verify_cache_put(const unsigned char *, int);
+EVP_PKEY_CTX *rs256_verify_ctx_new(EVP_PKEY *);
 int fido_get_signed_hash(int, fido_blob_t *, const fido_blob_t *,
     const fido_blob_t *);
 int fido_get_signed_hash_tpm(fido_blob_t *, const fido_blob_t *,
     const fido_blob_t *, const fido_attstmt_t *, const fido_attcred_t *);
+X509 *fido_x5c_cert(const fido_blob_t *);
+int fido_fmt_id(const char *);
+int fido_check_apple(const fido_blob_t *, const fido_attstmt_t *,
+    const fido_attcred_t *);
+int fido_check_android_key(const fido_blob_t *, const fido_attstmt_t *,
+    const fido_attcred_t *);
+int fido_attest_verify_x5c(const fido_blob_array_t *,
+    const fido_attest_store_t *);
 
 /* device manifest functions */
 int fido_hid_manifest(fido_dev_info_t *, size_t, size_t *);
 int fido_nfc_manifest(fido_dev_info_t *, size_t, size_t *);
 int fido_pcsc_manifest(fido_dev_info_t *, size_t, size_t *);
+bool fido_manifest_disabled(int);
 
 /* fuzzing instrumentation */
 #ifdef FIDO_FUZZ
@@ -263,6 +468,62 @@ uint32_t uniform_random(uint32_t);
 #define FIDO_DEV_CREDMAN_PRE	0x0400
 #define FIDO_DEV_BIO_SET	0x0800
 #define FIDO_DEV_BIO_UNSET	0x1000
+#define FIDO_DEV_INFO_PENDING	0x2000
+
+/* attestation statement formats */
+#define FIDO_FMT_UNKNOWN	0
+#define FIDO_FMT_PACKED		1
+#define FIDO_FMT_U2F		2
+#define FIDO_FMT_NONE		3
+#define FIDO_FMT_TPM		4
+#define FIDO_FMT_APPLE		5
+#define FIDO_FMT_ANDROID_KEY	6
+
+/*
+ * COSE algorithms and protocols compiled in; see FIDO_ALGORITHMS and
+ * FIDO_NO_U2F. ES256 is always present, as the PIN/UV auth protocols
+ * depend on it.
+ */
+#ifdef FIDO_NO_ES384
+#define FIDO_HAVE_ES384	0
+#else
+#define FIDO_HAVE_ES384	1
+#endif
+#ifdef FIDO_NO_RS256
+#define FIDO_HAVE_RS256	0
+#else
+#define FIDO_HAVE_RS256	1
+#endif
+#ifdef FIDO_NO_RS1
+#define FIDO_HAVE_RS1	0
+#else
+#define FIDO_HAVE_RS1	1
+#endif
+#ifdef FIDO_NO_EDDSA
+#define FIDO_HAVE_EDDSA	0
+#else
+#define FIDO_HAVE_EDDSA	1
+#endif
+#ifdef FIDO_NO_U2F
+#define FIDO_HAVE_U2F	0
+#else
+#define FIDO_HAVE_U2F	1
+#endif
+#define fido_cose_alg_enabled(alg) ((alg) == COSE_ES256 || \
+	((alg) == COSE_ES384 && FIDO_HAVE_ES384) || \
+	((alg) == COSE_RS256 && FIDO_HAVE_RS256) || \
+	((alg) == COSE_RS1 && FIDO_HAVE_RS1) || \
+	((alg) == COSE_EDDSA && FIDO_HAVE_EDDSA))
+
+/* FIDO_PROFILE stages */
+#define FIDO_PROF_BUILD_FRAME	0
+#define FIDO_PROF_TX		1
+#define FIDO_PROF_RX		2
+#define FIDO_PROF_PARSE_REPLY	3
+#define FIDO_PROF_ECDH		4
+#define FIDO_PROF_UV_TOKEN	5
+#define FIDO_PROF_VERIFY_SIG	6
+#define FIDO_PROF_NSTAGE	7
 
 /* miscellanea */
 #define FIDO_DUMMY_CLIENTDATA	""
@@ -272,6 +533,8 @@ uint32_t uniform_random(uint32_t);
 #define FIDO_WINHELLO_PATH	"windows://hello"
 #define FIDO_NFC_PREFIX		"nfc:"
 #define FIDO_PCSC_PREFIX	"pcsc:"
+#define FIDO_BROKER_PREFIX	"broker:"
+#define FIDO_REMOTE_PREFIX	"remote:"
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -57,27 +57,97 @@ extern "C" {
 #endif /* __cplusplus */
 
 fido_assert_t *fido_assert_new(void);
+fido_attest_store_t *fido_attest_store_new(void);
+fido_broker_t *fido_broker_new(void);
 fido_cred_t *fido_cred_new(void);
 fido_dev_t *fido_dev_new(void);
 fido_dev_t *fido_dev_new_with_info(const fido_dev_info_t *);
+fido_dev_t *fido_dev_pool_dev(const fido_dev_pool_t *, size_t);
 fido_dev_info_t *fido_dev_info_new(size_t);
+fido_dev_monitor_t *fido_dev_monitor_new(void);
+fido_dev_pool_t *fido_dev_pool_new(void);
 fido_cbor_info_t *fido_cbor_info_new(void);
+fido_keystore_t *fido_keystore_new(void);
+fido_pk_t *fido_pk_new(void);
+fido_remote_t *fido_remote_new(void);
 void *fido_dev_io_handle(const fido_dev_t *);
 
 void fido_assert_free(fido_assert_t **);
+void fido_assert_recycle(fido_assert_t *);
+void fido_attest_store_free(fido_attest_store_t **);
+void fido_broker_free(fido_broker_t **);
 void fido_cbor_info_free(fido_cbor_info_t **);
 void fido_cred_free(fido_cred_t **);
+void fido_cred_recycle(fido_cred_t *);
 void fido_dev_force_fido2(fido_dev_t *);
 void fido_dev_force_u2f(fido_dev_t *);
 void fido_dev_free(fido_dev_t **);
 void fido_dev_info_free(fido_dev_info_t **, size_t);
+void fido_dev_monitor_free(fido_dev_monitor_t **);
+void fido_dev_pool_free(fido_dev_pool_t **);
+void fido_keystore_free(fido_keystore_t **);
+void fido_pk_free(fido_pk_t **);
+void fido_remote_free(fido_remote_t **);
 
 /* fido_init() flags. */
 #define FIDO_DEBUG	0x01
 #define FIDO_DISABLE_U2F_FALLBACK 0x02
+#define FIDO_CHANNEL_CACHE	0x04
+#define FIDO_DEFER_GETINFO	0x08
+#define FIDO_MANIFEST_NO_HID	0x10
+#define FIDO_MANIFEST_NO_NFC	0x20
+#define FIDO_MANIFEST_NO_PCSC	0x40
+#define FIDO_MANIFEST_NO_WINHELLO 0x80
+#define FIDO_INFO_CACHE		0x100
+#define FIDO_PROFILE		0x200
+#define FIDO_VERIFY_CACHE	0x400
+
+/* fido_set_quirk() quirks. */
+#define FIDO_QUIRK_NONE		0
+#define FIDO_QUIRK_U2F		1
+
+/* fido_dev_prewarm() flags. */
+#define FIDO_PREWARM_ECDH	0x01
+#define FIDO_PREWARM_TOKEN	0x02
+
+/* fido_dev_monitor_t events. */
+#define FIDO_DEV_MONITOR_ADD	1
+#define FIDO_DEV_MONITOR_REMOVE	2
+
+/* fido_trace_t phases. */
+#define FIDO_TRACE_BEGIN	1
+#define FIDO_TRACE_END		2
+
+/* fido_set_log_level() and fido_dev_set_log_level() levels. */
+#define FIDO_LOG_NONE		0
+#define FIDO_LOG_ERROR		1
+#define FIDO_LOG_DEBUG		2
+#define FIDO_LOG_XXD		3
+
+/* fido_capture_t directions. */
+#define FIDO_CAPTURE_TX		1
+#define FIDO_CAPTURE_RX		2
+
+/* fido_base64_encode() and fido_base64_decode() flags. */
+#define FIDO_BASE64_URL		0x01
+
+/* fido_assert_set_u2f_flags() flags. */
+#define FIDO_U2F_FIRST		0x01
+#define FIDO_U2F_NO_PROBE	0x02
 
 void fido_init(int);
+int fido_ecdh_pool_fill(size_t);
+int fido_set_allocator(const fido_allocator_t *);
+int fido_set_deadline(int);
+int fido_set_log_level(int);
+int fido_set_quirk(int16_t, int16_t, int);
+int fido_set_secure_pool(size_t);
+void fido_set_capture_handler(fido_capture_handler_t *, void *);
+void fido_set_global_log_handler(fido_log_handler_t *);
+void fido_set_log_context_handler(fido_log_context_handler_t *, void *);
 void fido_set_log_handler(fido_log_handler_t *);
+void fido_set_trace_handler(fido_trace_handler_t *, void *);
+void fido_set_verify_handler(fido_verify_handler_t *, void *);
 
 const unsigned char *fido_assert_authdata_ptr(const fido_assert_t *, size_t);
 const unsigned char *fido_assert_authdata_raw_ptr(const fido_assert_t *,
@@ -109,7 +179,11 @@ const char *fido_cred_user_name(const fido_cred_t *);
 const char *fido_dev_info_manufacturer_string(const fido_dev_info_t *);
 const char *fido_dev_info_path(const fido_dev_info_t *);
 const char *fido_dev_info_product_string(const fido_dev_info_t *);
+const char *fido_dev_info_serial_string(const fido_dev_info_t *);
+const fido_cbor_info_t *fido_dev_cbor_info(const fido_dev_t *);
 const fido_dev_info_t *fido_dev_info_ptr(const fido_dev_info_t *, size_t);
+const fido_dev_info_t *fido_dev_monitor_ptr(const fido_dev_monitor_t *,
+    size_t);
 const uint8_t *fido_cbor_info_protocols_ptr(const fido_cbor_info_t *);
 const uint64_t *fido_cbor_info_certs_value_ptr(const fido_cbor_info_t *);
 const unsigned char *fido_cbor_info_aaguid_ptr(const fido_cbor_info_t *);
@@ -119,6 +193,7 @@ const unsigned char *fido_cred_authdata_ptr(const fido_cred_t *);
 const unsigned char *fido_cred_authdata_raw_ptr(const fido_cred_t *);
 const unsigned char *fido_cred_clientdata_hash_ptr(const fido_cred_t *);
 const unsigned char *fido_cred_id_ptr(const fido_cred_t *);
+const unsigned char *fido_cred_hmac_secret_ptr(const fido_cred_t *);
 const unsigned char *fido_cred_largeblob_key_ptr(const fido_cred_t *);
 const unsigned char *fido_cred_pubkey_ptr(const fido_cred_t *);
 const unsigned char *fido_cred_sig_ptr(const fido_cred_t *);
@@ -128,36 +203,70 @@ const unsigned char *fido_cred_x5c_list_ptr(const fido_cred_t *, size_t);
 
 int fido_assert_allow_cred(fido_assert_t *, const unsigned char *, size_t);
 int fido_assert_empty_allow_list(fido_assert_t *);
+int fido_assert_from_webauthn_json(fido_assert_t *, const char *, size_t);
+int fido_assert_hmac_secret_batch(const fido_assert_t *,
+    fido_hmac_secret_item_t *, size_t);
+int fido_assert_set_allow_list(fido_assert_t *, const unsigned char * const *,
+    const size_t *, size_t);
 int fido_assert_set_authdata(fido_assert_t *, size_t, const unsigned char *,
     size_t);
 int fido_assert_set_authdata_raw(fido_assert_t *, size_t, const unsigned char *,
     size_t);
 int fido_assert_set_clientdata(fido_assert_t *, const unsigned char *, size_t);
+int fido_assert_set_clientdata_final(fido_assert_t *);
 int fido_assert_set_clientdata_hash(fido_assert_t *, const unsigned char *,
     size_t);
+int fido_assert_set_clientdata_init(fido_assert_t *);
+int fido_assert_set_clientdata_update(fido_assert_t *, const unsigned char *,
+    size_t);
 int fido_assert_set_count(fido_assert_t *, size_t);
 int fido_assert_set_extensions(fido_assert_t *, int);
+int fido_assert_set_fetch_limit(fido_assert_t *, size_t);
 int fido_assert_set_hmac_salt(fido_assert_t *, const unsigned char *, size_t);
 int fido_assert_set_hmac_secret(fido_assert_t *, size_t, const unsigned char *,
     size_t);
+int fido_assert_set_lazy(fido_assert_t *, bool);
 int fido_assert_set_options(fido_assert_t *, bool, bool);
 int fido_assert_set_rp(fido_assert_t *, const char *);
+int fido_assert_set_u2f_flags(fido_assert_t *, int);
 int fido_assert_set_up(fido_assert_t *, fido_opt_t);
 int fido_assert_set_uv(fido_assert_t *, fido_opt_t);
 int fido_assert_set_sig(fido_assert_t *, size_t, const unsigned char *, size_t);
 int fido_assert_set_winhello_appid(fido_assert_t *, const char *);
 int fido_assert_verify(const fido_assert_t *, size_t, int, const void *);
+int fido_assert_verify_batch(fido_assert_verify_item_t *, size_t);
+int fido_assert_verify_keystore(const fido_assert_t *, size_t,
+    const fido_keystore_t *);
+int fido_assert_verify_prepared(const fido_assert_t *, size_t,
+    const fido_pk_t *);
+int fido_attest_store_add(fido_attest_store_t *, const unsigned char *,
+    size_t);
+int fido_base64_decode(const char *, size_t, unsigned char *, size_t *, int);
+int fido_base64_encode(const unsigned char *, size_t, char *, size_t *, int);
+int fido_broker_attach(fido_broker_t *, fido_dev_t *);
+int fido_broker_open(fido_broker_t *, const char *, const char *);
+int fido_broker_work(fido_broker_t *, int);
 int fido_cbor_info_algorithm_cose(const fido_cbor_info_t *, size_t);
+int fido_cred_deserialize(fido_cred_t *, const unsigned char *, size_t);
 int fido_cred_empty_exclude_list(fido_cred_t *);
 int fido_cred_exclude(fido_cred_t *, const unsigned char *, size_t);
+int fido_cred_from_webauthn_json(fido_cred_t *, const char *, size_t);
 int fido_cred_prot(const fido_cred_t *);
+int fido_cred_serialize(const fido_cred_t *, unsigned char **, size_t *);
 int fido_cred_set_attstmt(fido_cred_t *, const unsigned char *, size_t);
 int fido_cred_set_attobj(fido_cred_t *, const unsigned char *, size_t);
 int fido_cred_set_authdata(fido_cred_t *, const unsigned char *, size_t);
 int fido_cred_set_authdata_raw(fido_cred_t *, const unsigned char *, size_t);
 int fido_cred_set_blob(fido_cred_t *, const unsigned char *, size_t);
+int fido_cred_set_hmac_salt(fido_cred_t *, const unsigned char *, size_t);
 int fido_cred_set_clientdata(fido_cred_t *, const unsigned char *, size_t);
+int fido_cred_set_clientdata_final(fido_cred_t *);
 int fido_cred_set_clientdata_hash(fido_cred_t *, const unsigned char *, size_t);
+int fido_cred_set_clientdata_init(fido_cred_t *);
+int fido_cred_set_clientdata_update(fido_cred_t *, const unsigned char *,
+    size_t);
+int fido_cred_set_exclude_list(fido_cred_t *, const unsigned char * const *,
+    const size_t *, size_t);
 int fido_cred_set_extensions(fido_cred_t *, int);
 int fido_cred_set_fmt(fido_cred_t *, const char *);
 int fido_cred_set_id(fido_cred_t *, const unsigned char *, size_t);
@@ -174,29 +283,89 @@ int fido_cred_set_user(fido_cred_t *, const unsigned char *, size_t,
     const char *, const char *, const char *);
 int fido_cred_set_x509(fido_cred_t *, const unsigned char *, size_t);
 int fido_cred_verify(const fido_cred_t *);
+int fido_cred_verify_batch(fido_cred_verify_item_t *, size_t,
+    const fido_attest_store_t *);
+int fido_cred_verify_chain(const fido_cred_t *, const fido_attest_store_t *);
 int fido_cred_verify_self(const fido_cred_t *);
+int fido_cred_verify_self_pk(const fido_cred_t *, fido_pk_t *);
 #ifdef _FIDO_SIGSET_DEFINED
 int fido_dev_set_sigmask(fido_dev_t *, const fido_sigset_t *);
 #endif
 int fido_dev_cancel(fido_dev_t *);
+int fido_dev_cancel_many(fido_dev_t **, size_t);
 int fido_dev_close(fido_dev_t *);
 int fido_dev_get_assert(fido_dev_t *, fido_assert_t *, const char *);
+int fido_dev_get_assert_complete(fido_dev_t *, fido_assert_t *);
+int fido_dev_get_assert_next(fido_dev_t *, fido_assert_t *, size_t);
+int fido_dev_get_assert_submit(fido_dev_t *, fido_assert_t *, const char *);
 int fido_dev_get_cbor_info(fido_dev_t *, fido_cbor_info_t *);
+int fido_dev_get_pollfd(const fido_dev_t *);
+void *fido_dev_get_pollhandle(const fido_dev_t *);
 int fido_dev_get_retry_count(fido_dev_t *, int *);
 int fido_dev_get_uv_retry_count(fido_dev_t *, int *);
+int fido_dev_get_touch_any(fido_dev_t **, size_t, size_t *, int);
 int fido_dev_get_touch_begin(fido_dev_t *);
 int fido_dev_get_touch_status(fido_dev_t *, int *, int);
+int fido_dev_health_snapshot(fido_dev_t *, fido_dev_health_t *, const char *);
+int fido_dev_hmac_secret(fido_dev_t *, const char *, fido_opt_t,
+    fido_hmac_secret_item_t *, size_t, const char *);
 int fido_dev_info_manifest(fido_dev_info_t *, size_t, size_t *);
 int fido_dev_info_set(fido_dev_info_t *, size_t, const char *, const char *,
     const char *, const fido_dev_io_t *, const fido_dev_transport_t *);
+int fido_dev_lock(fido_dev_t *, unsigned int);
 int fido_dev_make_cred(fido_dev_t *, fido_cred_t *, const char *);
+int fido_dev_monitor_fd(const fido_dev_monitor_t *);
+int fido_dev_monitor_poll(fido_dev_monitor_t *, int);
+int fido_dev_monitor_set_cb(fido_dev_monitor_t *, fido_dev_monitor_cb_t *,
+    void *);
+int fido_dev_monitor_start(fido_dev_monitor_t *);
+int fido_dev_make_cred_complete(fido_dev_t *, fido_cred_t *);
+int fido_dev_make_cred_submit(fido_dev_t *, fido_cred_t *, const char *);
+int fido_dev_open_channel(fido_dev_t *, fido_dev_t *);
+int fido_dev_open_many(fido_dev_t **, size_t, int *);
 int fido_dev_open_with_info(fido_dev_t *);
 int fido_dev_open(fido_dev_t *, const char *);
+int fido_dev_ping(fido_dev_t *, const unsigned char *, size_t);
+int fido_dev_poll(fido_dev_t *, int);
+int fido_dev_pool_add(fido_dev_pool_t *, fido_dev_pool_cb_t *, void *);
+int fido_dev_pool_open(fido_dev_pool_t *, const fido_dev_info_t *, size_t);
+int fido_dev_pool_rewind(fido_dev_pool_t *);
+int fido_dev_pool_set_progress(fido_dev_pool_t *, fido_dev_pool_progress_t *,
+    void *);
+int fido_dev_pool_status(const fido_dev_pool_t *, size_t);
+int fido_dev_pool_work(fido_dev_pool_t *);
+int fido_dev_prewarm(fido_dev_t *, const char *, const char *, int);
 int fido_dev_reset(fido_dev_t *);
+int fido_dev_set_adaptive_timeout(fido_dev_t *, unsigned int);
 int fido_dev_set_io_functions(fido_dev_t *, const fido_dev_io_t *);
+int fido_dev_set_keepalive_handler(fido_dev_t *, fido_dev_keepalive_t *,
+    void *);
+int fido_dev_set_lock(fido_dev_t *, unsigned int);
+int fido_dev_set_log_level(fido_dev_t *, int);
+int fido_dev_set_metrics_handler(fido_dev_t *, fido_dev_metrics_cb_t *,
+    void *);
 int fido_dev_set_pin(fido_dev_t *, const char *, const char *);
 int fido_dev_set_transport_functions(fido_dev_t *, const fido_dev_transport_t *);
 int fido_dev_set_timeout(fido_dev_t *, int);
+int fido_dev_set_token_cache(fido_dev_t *, bool);
+int fido_dev_unlock(fido_dev_t *);
+int fido_keystore_add(fido_keystore_t *, const unsigned char *, size_t, int,
+    const void *);
+int fido_keystore_add_cred(fido_keystore_t *, const fido_cred_t *);
+int fido_keystore_get_pk(const fido_keystore_t *, const unsigned char *,
+    size_t, fido_pk_t *);
+int fido_keystore_get_sigcount(const fido_keystore_t *,
+    const unsigned char *, size_t, uint32_t *);
+int fido_keystore_open(fido_keystore_t *, const char *);
+int fido_keystore_update_sigcount(const fido_keystore_t *,
+    const unsigned char *, size_t, uint32_t);
+int fido_keystore_write(fido_keystore_t *, const char *);
+int fido_pk_set(fido_pk_t *, int, const void *);
+int fido_pk_set_cose(fido_pk_t *, const unsigned char *, size_t);
+int fido_pk_set_der(fido_pk_t *, const unsigned char *, size_t);
+int fido_pk_type(const fido_pk_t *);
+int fido_remote_open(fido_remote_t *, fido_dev_t *, const char *);
+int fido_remote_work(fido_remote_t *, int);
 
 size_t fido_assert_authdata_len(const fido_assert_t *, size_t);
 size_t fido_assert_authdata_raw_len(const fido_assert_t *, size_t);
@@ -205,6 +374,7 @@ size_t fido_assert_count(const fido_assert_t *);
 size_t fido_assert_hmac_secret_len(const fido_assert_t *, size_t);
 size_t fido_assert_id_len(const fido_assert_t *, size_t);
 size_t fido_assert_largeblob_key_len(const fido_assert_t *, size_t);
+size_t fido_assert_pending(const fido_assert_t *);
 size_t fido_assert_sig_len(const fido_assert_t *, size_t);
 size_t fido_assert_user_id_len(const fido_assert_t *, size_t);
 size_t fido_assert_blob_len(const fido_assert_t *, size_t);
@@ -222,6 +392,7 @@ size_t fido_cred_authdata_len(const fido_cred_t *);
 size_t fido_cred_authdata_raw_len(const fido_cred_t *);
 size_t fido_cred_clientdata_hash_len(const fido_cred_t *);
 size_t fido_cred_id_len(const fido_cred_t *);
+size_t fido_cred_hmac_secret_len(const fido_cred_t *);
 size_t fido_cred_largeblob_key_len(const fido_cred_t *);
 size_t fido_cred_pin_minlen(const fido_cred_t *);
 size_t fido_cred_pubkey_len(const fido_cred_t *);
@@ -230,6 +401,9 @@ size_t fido_cred_user_id_len(const fido_cred_t *);
 size_t fido_cred_x5c_len(const fido_cred_t *);
 size_t fido_cred_x5c_list_count(const fido_cred_t *);
 size_t fido_cred_x5c_list_len(const fido_cred_t *, size_t);
+size_t fido_dev_monitor_len(const fido_dev_monitor_t *);
+size_t fido_dev_pool_len(const fido_dev_pool_t *);
+size_t fido_keystore_count(const fido_keystore_t *);
 
 uint8_t  fido_assert_flags(const fido_assert_t *, size_t);
 uint32_t fido_assert_sigcount(const fido_assert_t *, size_t);
@@ -250,6 +424,8 @@ uint64_t fido_cbor_info_maxlargeblob(const fido_cbor_info_t *);
 uint64_t fido_cbor_info_maxmsgsiz(const fido_cbor_info_t *);
 uint64_t fido_cbor_info_maxrpid_minpinlen(const fido_cbor_info_t *);
 uint64_t fido_cbor_info_minpinlen(const fido_cbor_info_t *);
+uint64_t fido_cbor_info_options_enabled(const fido_cbor_info_t *);
+uint64_t fido_cbor_info_options_present(const fido_cbor_info_t *);
 uint64_t fido_cbor_info_uv_attempts(const fido_cbor_info_t *);
 uint64_t fido_cbor_info_uv_modality(const fido_cbor_info_t *);
 int64_t  fido_cbor_info_rk_remaining(const fido_cbor_info_t *);
@@ -272,8 +448,21 @@ int fido_dev_largeblob_set(fido_dev_t *, const unsigned char *, size_t,
 int fido_dev_largeblob_remove(fido_dev_t *, const unsigned char *, size_t,
     const char *);
 int fido_dev_largeblob_get_array(fido_dev_t *, unsigned char **, size_t *);
+int fido_dev_largeblob_get_batch(fido_dev_t *, fido_largeblob_item_t *,
+    size_t, unsigned char **, size_t *);
 int fido_dev_largeblob_set_array(fido_dev_t *, const unsigned char *, size_t,
     const char *);
+int fido_dev_largeblob_remove_batch(fido_dev_t *, fido_largeblob_item_t *,
+    size_t, const char *);
+int fido_dev_largeblob_set_batch(fido_dev_t *, fido_largeblob_item_t *,
+    size_t, const char *);
+int fido_largeblob_array_match(const unsigned char *, size_t,
+    const fido_largeblob_item_t *, size_t, size_t *, size_t);
+int fido_dev_largeblob_add_dict(fido_dev_t *, const unsigned char *, size_t);
+int fido_dev_set_largeblob_cache(fido_dev_t *, bool);
+int fido_dev_set_largeblob_progress(fido_dev_t *,
+    fido_largeblob_progress_t *, void *);
+int fido_dev_set_largeblob_retry(fido_dev_t *, int);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -103,10 +103,13 @@ fido_bio_template_t *fido_bio_template_new(void);
 int fido_bio_dev_enroll_begin(fido_dev_t *, fido_bio_template_t *,
     fido_bio_enroll_t *, uint32_t, const char *);
 int fido_bio_dev_enroll_cancel(fido_dev_t *);
+int fido_bio_dev_enroll_complete(fido_dev_t *, fido_bio_enroll_t *);
 int fido_bio_dev_enroll_continue(fido_dev_t *, const fido_bio_template_t *,
     fido_bio_enroll_t *, uint32_t);
 int fido_bio_dev_enroll_remove(fido_dev_t *, const fido_bio_template_t *,
     const char *);
+int fido_bio_dev_enroll_submit(fido_dev_t *, const fido_bio_template_t *,
+    fido_bio_enroll_t *, uint32_t);
 int fido_bio_dev_get_info(fido_dev_t *, fido_bio_info_t *);
 int fido_bio_dev_get_template_array(fido_dev_t *, fido_bio_template_array_t *,
     const char *);
@@ -69,11 +69,41 @@ struct fido_credman_rk {
 	size_t n_alloc; /* number of allocated entries */
 	size_t n_rx;    /* number of populated entries */
 };
+
+struct fido_credman_iter {
+	fido_dev_t *dev;
+	char *pin;
+	struct fido_credman_rp rp; /* relying parties to visit */
+	size_t rp_idx;  /* next relying party */
+	bool scoped;    /* token bound to the relying party */
+	bool cache;     /* saved dev->token_cache */
+	fido_cred_t cred;
+	bool fresh;     /* cred not yet returned */
+	size_t n_rk;    /* credentials of the current relying party */
+	size_t n_rx;    /* credentials received so far */
+};
+
+struct fido_credman_session {
+	fido_dev_t *dev;
+	char *pin;
+	bool cache;     /* saved dev->token_cache */
+	struct fido_credman_rp rp; /* relying parties, by rp_id_hash */
+	struct fido_credman_rk **rk; /* per relying party; NULL until fetched */
+};
 #endif
 
+typedef struct fido_credman_iter fido_credman_iter_t;
 typedef struct fido_credman_metadata fido_credman_metadata_t;
 typedef struct fido_credman_rk fido_credman_rk_t;
 typedef struct fido_credman_rp fido_credman_rp_t;
+typedef struct fido_credman_session fido_credman_session_t;
+
+typedef struct fido_credman_rk_item {
+	const unsigned char *cred_ptr; /* credential id; for deletion */
+	size_t               cred_len;
+	const fido_cred_t   *cred;     /* credential; for update */
+	int                  r;        /* result; set by the library */
+} fido_credman_rk_item_t;
 
 const char *fido_credman_rp_id(const fido_credman_rp_t *, size_t);
 const char *fido_credman_rp_name(const fido_credman_rp_t *, size_t);
@@ -81,19 +111,37 @@ const char *fido_credman_rp_name(const fido_credman_rp_t *, size_t);
 const fido_cred_t *fido_credman_rk(const fido_credman_rk_t *, size_t);
 const unsigned char *fido_credman_rp_id_hash_ptr(const fido_credman_rp_t *,
     size_t);
+const fido_credman_rp_t *fido_credman_session_rp(
+    const fido_credman_session_t *);
 
+fido_credman_iter_t *fido_credman_iter_new(void);
 fido_credman_metadata_t *fido_credman_metadata_new(void);
 fido_credman_rk_t *fido_credman_rk_new(void);
 fido_credman_rp_t *fido_credman_rp_new(void);
+fido_credman_session_t *fido_credman_session_new(void);
 
 int fido_credman_del_dev_rk(fido_dev_t *, const unsigned char *, size_t,
     const char *);
+int fido_credman_del_dev_rk_batch(fido_dev_t *, fido_credman_rk_item_t *,
+    size_t, const char *);
 int fido_credman_get_dev_metadata(fido_dev_t *, fido_credman_metadata_t *,
     const char *);
 int fido_credman_get_dev_rk(fido_dev_t *, const char *, fido_credman_rk_t *,
     const char *);
+int fido_credman_get_dev_rk_all(fido_dev_t *, fido_credman_rp_t *,
+    fido_credman_rk_t *, const char *);
 int fido_credman_get_dev_rp(fido_dev_t *, fido_credman_rp_t *, const char *);
+int fido_credman_iter_begin(fido_dev_t *, fido_credman_iter_t *,
+    const char *, const char *);
+int fido_credman_iter_next(fido_credman_iter_t *, const fido_cred_t **);
+int fido_credman_session_begin(fido_dev_t *, fido_credman_session_t *,
+    const char *);
+int fido_credman_session_rk(fido_credman_session_t *, const unsigned char *,
+    size_t, const fido_credman_rk_t **);
 int fido_credman_set_dev_rk(fido_dev_t *, fido_cred_t *, const char *);
+int fido_credman_set_dev_rk_batch(fido_dev_t *, fido_credman_rk_item_t *,
+    size_t, const char *);
+int fido_keystore_add_rk(fido_keystore_t *, const fido_credman_rk_t *);
 
 size_t fido_credman_rk_count(const fido_credman_rk_t *);
 size_t fido_credman_rp_count(const fido_credman_rp_t *);
@@ -102,9 +150,13 @@ size_t fido_credman_rp_id_hash_len(const fido_credman_rp_t *, size_t);
 uint64_t fido_credman_rk_existing(const fido_credman_metadata_t *);
 uint64_t fido_credman_rk_remaining(const fido_credman_metadata_t *);
 
+void fido_credman_iter_end(fido_credman_iter_t *);
+void fido_credman_iter_free(fido_credman_iter_t **);
 void fido_credman_metadata_free(fido_credman_metadata_t **);
 void fido_credman_rk_free(fido_credman_rk_t **);
 void fido_credman_rp_free(fido_credman_rp_t **);
+void fido_credman_session_end(fido_credman_session_t *);
+void fido_credman_session_free(fido_credman_session_t **);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -92,6 +92,7 @@
 #define FIDO_ERR_INTERNAL		-9
 #define FIDO_ERR_NOTFOUND		-10
 #define FIDO_ERR_COMPRESS		-11
+#define FIDO_ERR_SIGCOUNT		-12
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,9 +43,14 @@
 #define CTAP_CMD_WINK			0x08
 #define CTAP_CMD_CBOR			0x10
 #define CTAP_CMD_CANCEL			0x11
+#define CTAP_CMD_ERROR			0x3f
 #define CTAP_KEEPALIVE			0x3b
 #define CTAP_FRAME_INIT			0x80
 
+/* CTAPHID_KEEPALIVE status codes. */
+#define CTAP_KEEPALIVE_PROCESSING	0x01
+#define CTAP_KEEPALIVE_UPNEEDED		0x02
+
 /* CTAPHID CBOR command opcodes. */
 #define CTAP_CBOR_MAKECRED		0x01
 #define CTAP_CBOR_ASSERT		0x02
@@ -74,8 +79,11 @@
 
 /* ISO7816-4 status words. */
 #define SW1_MORE_DATA			0x61
+#define SW_WRONG_LENGTH			0x6700
 #define SW_CONDITIONS_NOT_SATISFIED	0x6985
 #define SW_WRONG_DATA			0x6a80
+#define SW_INS_NOT_SUPPORTED		0x6d00
+#define SW_CLA_NOT_SUPPORTED		0x6e00
 #define SW_NO_ERROR			0x9000
 
 /* HID Broadcast channel ID. */
@@ -84,8 +92,11 @@
 #define CTAP_INIT_HEADER_LEN		7
 #define CTAP_CONT_HEADER_LEN		5
 
-/* Maximum length of a CTAP HID report in bytes. */
-#define CTAP_MAX_REPORT_LEN		64
+/* Length of a full-speed CTAP HID report in bytes; the default. */
+#define CTAP_DEF_REPORT_LEN		64
+
+/* Maximum length of a CTAP HID report in bytes; a high-speed packet. */
+#define CTAP_MAX_REPORT_LEN		1024
 
 /* Minimum length of a CTAP HID report in bytes. */
 #define CTAP_MIN_REPORT_LEN		(CTAP_INIT_HEADER_LEN + 1)
@@ -142,6 +153,12 @@
 #define FIDO_EXT_CRED_MASK	(FIDO_EXT_HMAC_SECRET|FIDO_EXT_CRED_PROTECT| \
 				 FIDO_EXT_LARGEBLOB_KEY|FIDO_EXT_CRED_BLOB| \
 				 FIDO_EXT_MINPINLEN)
+
+/* Round trips kept per request class for adaptive deadlines. */
+#define FIDO_RTT_NCLASS		3	/* getInfo, credMgmt, largeBlobs */
+#define FIDO_RTT_SAMPLES	16
+#define FIDO_RTT_MIN		4	/* before a deadline is derived */
+#define FIDO_RTT_FLOOR_MS	500
 #endif /* _FIDO_INTERNAL */
 
 /* Recognised UV modes. */
@@ -159,4 +176,25 @@
 #define FIDO_UV_MODE_EXT_PIN	0x0800	/* external pin verification */
 #define FIDO_UV_MODE_EXT_DRAWN	0x1000	/* external drawn pattern check */
 
+/* Recognised authenticatorGetInfo options. */
+#define FIDO_INFO_OPT_PLAT	0x00001	/* plat */
+#define FIDO_INFO_OPT_RK	0x00002	/* rk */
+#define FIDO_INFO_OPT_PIN	0x00004	/* clientPin */
+#define FIDO_INFO_OPT_UP	0x00008	/* up */
+#define FIDO_INFO_OPT_UV	0x00010	/* uv */
+#define FIDO_INFO_OPT_TOKEN	0x00020	/* pinUvAuthToken */
+#define FIDO_INFO_OPT_NO_MC_GA	0x00040	/* noMcGaPermissionsWithClientPin */
+#define FIDO_INFO_OPT_LARGEBLOB	0x00080	/* largeBlobs */
+#define FIDO_INFO_OPT_EP	0x00100	/* ep */
+#define FIDO_INFO_OPT_BIO	0x00200	/* bioEnroll */
+#define FIDO_INFO_OPT_UVM_PRE	0x00400	/* userVerificationMgmtPreview */
+#define FIDO_INFO_OPT_UV_BIO	0x00800	/* uvBioEnroll */
+#define FIDO_INFO_OPT_AUTHN_CFG	0x01000	/* authnrCfg */
+#define FIDO_INFO_OPT_UV_ACFG	0x02000	/* uvAcfg */
+#define FIDO_INFO_OPT_CREDMAN	0x04000	/* credMgmt */
+#define FIDO_INFO_OPT_CM_PRE	0x08000	/* credentialMgmtPreview */
+#define FIDO_INFO_OPT_MINPINLEN	0x10000	/* setMinPINLength */
+#define FIDO_INFO_OPT_MC_NO_UV	0x20000	/* makeCredUvNotRqd */
+#define FIDO_INFO_OPT_ALWAYS_UV	0x40000	/* alwaysUv */
+
 #endif /* !_FIDO_PARAM_H */
@@ -69,6 +69,118 @@ typedef enum {
 } fido_opt_t;
 
 typedef void fido_log_handler_t(const char *);
+typedef void fido_log_context_handler_t(void *, int, const struct fido_dev *,
+    const char *, const char *);
+
+typedef struct fido_allocator {
+	void *(*malloc)(size_t);
+	void *(*calloc)(size_t, size_t);
+	void *(*realloc)(void *, size_t);
+	void  (*free)(void *);
+	void  (*freezero)(void *, size_t); /* optional */
+} fido_allocator_t;
+
+typedef void fido_dev_keepalive_t(void *, uint8_t, int);
+
+typedef struct fido_dev_metrics {
+	uint8_t  cmd;        /* ctaphid command */
+	uint8_t  cbor_cmd;   /* ctap2 command if cmd is CTAP_CMD_CBOR; else 0 */
+	size_t   tx_len;     /* request length */
+	int      rx_len;     /* reply length; -1 on error */
+	unsigned tx_frames;  /* hid reports written */
+	unsigned rx_frames;  /* hid reports read, including keepalives */
+	unsigned keepalives; /* keepalive messages received */
+	int      up_ms;      /* time the authenticator waited for user presence */
+	int      rtt_ms;     /* time from request to reply; -1 if unknown */
+} fido_dev_metrics_t;
+
+typedef void fido_dev_metrics_cb_t(void *, const fido_dev_metrics_t *);
+
+typedef struct fido_trace {
+	int         phase;    /* FIDO_TRACE_BEGIN or FIDO_TRACE_END */
+	const char *op;       /* operation, e.g. "fido_dev_make_cred" */
+	uint64_t    id;       /* span id; unique within the thread */
+	uint64_t    parent;   /* id of the enclosing span; 0 if none */
+	const char *path;     /* device path; NULL if unknown */
+	uint8_t     cmd;      /* ctaphid command of "fido_tx"/"fido_rx" */
+	uint8_t     cbor_cmd; /* ctap2 command if cmd is CTAP_CMD_CBOR */
+	size_t      len;      /* payload length of "fido_tx"/"fido_rx" */
+	int         status;   /* FIDO_OK or FIDO_ERR_* at FIDO_TRACE_END */
+} fido_trace_t;
+
+typedef void fido_trace_handler_t(void *, const fido_trace_t *);
+
+typedef struct fido_capture {
+	int                  dir;   /* FIDO_CAPTURE_TX or FIDO_CAPTURE_RX */
+	uint32_t             cid;   /* channel id of the frame */
+	uint64_t             ts_us; /* monotonic time of the frame, in us */
+	const unsigned char *ptr;   /* ctaphid frame, without report id */
+	size_t               len;
+} fido_capture_t;
+
+typedef void fido_capture_handler_t(void *, const fido_capture_t *);
+typedef int fido_verify_handler_t(void *, int, const void *,
+    const unsigned char *, size_t, const unsigned char *, size_t);
+
+struct fido_dev_info;
+
+typedef void fido_dev_monitor_cb_t(void *, int, const struct fido_dev_info *);
+
+struct fido_dev;
+
+typedef int fido_dev_pool_cb_t(struct fido_dev *, size_t, void *);
+typedef void fido_dev_pool_progress_t(void *, size_t, size_t, int);
+typedef void fido_largeblob_progress_t(void *, size_t, size_t);
+
+struct fido_assert;
+
+typedef struct fido_assert_verify_item {
+	const struct fido_assert *assert;   /* assertion to verify */
+	size_t                    idx;      /* statement index */
+	int                       cose_alg; /* cose algorithm of pk */
+	const void               *pk;       /* public key */
+	int                       r;        /* result; set by the library */
+} fido_assert_verify_item_t;
+
+typedef struct fido_cred_verify_item {
+	const struct fido_cred *cred; /* credential to verify */
+	int                     r;    /* result; set by the library */
+} fido_cred_verify_item_t;
+
+typedef struct fido_dev_health {
+	struct fido_cbor_info        *info;     /* getinfo reply, or NULL */
+	struct fido_credman_metadata *metadata; /* credman metadata, or NULL */
+	struct fido_bio_info         *bio;      /* bio info, or NULL */
+	int pin_retries;    /* pin retries; -1 if not known */
+	int uv_retries;     /* uv retries; -1 if not known */
+	int info_r;         /* results; set by the library */
+	int pin_retries_r;
+	int uv_retries_r;
+	int metadata_r;
+	int bio_r;
+} fido_dev_health_t;
+
+typedef struct fido_largeblob_item {
+	const unsigned char *key_ptr;  /* largeBlob key */
+	size_t               key_len;
+	const unsigned char *blob_ptr; /* blob to set; unused on removal */
+	size_t               blob_len;
+	int                  level;    /* zlib level 1-9; 0 for the default */
+	int                  strategy; /* zlib strategy; 0 for the default */
+	const unsigned char *dict_ptr; /* preset dictionary; may be NULL */
+	size_t               dict_len;
+	int                  r;        /* result; set by the library */
+} fido_largeblob_item_t;
+
+typedef struct fido_hmac_secret_item {
+	const unsigned char *cred_ptr;   /* credential id */
+	size_t               cred_len;
+	const unsigned char *salt_ptr;   /* one or two 32-byte salts */
+	size_t               salt_len;
+	unsigned char        secret[64]; /* output; set by the library */
+	size_t               secret_len; /* set by the library */
+	int                  r;          /* result; set by the library */
+} fido_hmac_secret_item_t;
 
 #undef  _FIDO_SIGSET_DEFINED
 #define _FIDO_SIGSET_DEFINED
@@ -112,6 +224,16 @@ typedef struct eddsa_pk {
 	unsigned char x[32];
 } eddsa_pk_t;
 
+/* COSE public key, decoded for repeated signature verification */
+typedef struct fido_pk {
+	int           type; /* cose algorithm */
+	EVP_PKEY     *pkey; /* decoded public key */
+	union {
+		es256_pk_t es256;
+		eddsa_pk_t eddsa;
+	} raw;              /* for fido_set_verify_handler() */
+} fido_pk_t;
+
 PACKED_TYPE(fido_authdata_t,
 struct fido_authdata {
 	unsigned char rp_id_hash[32]; /* sha256 of fido_rp.id */
@@ -161,15 +283,19 @@ typedef struct fido_user {
 } fido_user_t;
 
 typedef struct fido_cred_ext {
-	int    mask;      /* enabled extensions */
-	int    prot;      /* protection policy */
-	size_t minpinlen; /* minimum pin length */
+	int         mask;            /* enabled extensions */
+	int         prot;            /* protection policy */
+	size_t      minpinlen;       /* minimum pin length */
+	fido_blob_t hmac_salt;       /* hmac-secret-mc salt */
+	fido_blob_t hmac_secret_enc; /* hmac-secret-mc output, encrypted */
 } fido_cred_ext_t;
 
 typedef struct fido_cred {
 	fido_blob_t       cd;            /* client data */
 	fido_blob_t       cdh;           /* client data hash */
+	EVP_MD_CTX       *cd_ctx;        /* client data being hashed */
 	fido_rp_t         rp;            /* relying party */
+	fido_blob_t       rp_id_hash;    /* sha256 of rp.id */
 	fido_user_t       user;          /* user entity */
 	fido_blob_array_t excl;          /* list of credential ids to exclude */
 	fido_opt_t        rk;            /* resident key */
@@ -183,8 +309,10 @@ typedef struct fido_cred {
 	fido_authdata_t   authdata;      /* decoded authdata payload */
 	fido_attcred_t    attcred;       /* returned credential (key + id) */
 	fido_attstmt_t    attstmt;       /* attestation statement (x509 + sig) */
+	fido_blob_t       attobj;        /* attobj the members point into */
 	fido_blob_t       largeblob_key; /* decoded large blob key */
 	fido_blob_t       blob;          /* CTAP 2.1 credBlob */
+	fido_blob_t       hmac_secret;   /* hmac-secret-mc output */
 } fido_cred_t;
 
 typedef struct fido_assert_extattr {
@@ -202,7 +330,10 @@ typedef struct _fido_assert_stmt {
 	fido_blob_t           authdata_raw;  /* raw authdata */
 	fido_authdata_t       authdata;      /* decoded authdata payload */
 	fido_blob_t           sig;           /* signature of cdh + authdata */
+	fido_blob_t          *dgst[3];       /* cached signed hashes */
 	fido_blob_t           largeblob_key; /* decoded large blob key */
+	fido_blob_t           reply;         /* undecoded reply, if lazy */
+	struct _fido_assert_stmt *lazy;      /* fields decoded from reply */
 } fido_assert_stmt;
 
 typedef struct fido_assert_ext {
@@ -210,18 +341,39 @@ typedef struct fido_assert_ext {
 	fido_blob_t hmac_salt;           /* optional hmac-secret salt */
 } fido_assert_ext_t;
 
+typedef struct fido_assert_tmpl {
+	fido_blob_t frame;     /* last getAssertion request */
+	size_t      cdh;       /* offset of clientDataHash in frame */
+	size_t      param;     /* offset of pinUvAuthParam in frame, or 0 */
+	size_t      param_len; /* length of pinUvAuthParam */
+	uint64_t    prot;      /* pinUvAuthProtocol */
+	fido_opt_t  up;        /* options and extensions of frame */
+	fido_opt_t  uv;
+	int         ext;
+} fido_assert_tmpl_t;
+
 typedef struct fido_assert {
 	char              *rp_id;        /* relying party id */
+	fido_blob_t        rp_id_hash;   /* sha256 of rp_id */
 	char              *appid;        /* winhello u2f appid */
 	fido_blob_t        cd;           /* client data */
 	fido_blob_t        cdh;          /* client data hash */
+	EVP_MD_CTX        *cd_ctx;       /* client data being hashed */
 	fido_blob_array_t  allow_list;   /* list of allowed credentials */
+	fido_blob_t        allow_cbor;   /* cbor-encoded allow_list */
+	fido_assert_tmpl_t tmpl;         /* see fido_dev_get_assert_tx() */
 	fido_opt_t         up;           /* user presence */
 	fido_opt_t         uv;           /* user verification */
+	int                u2f_flags;    /* see FIDO_U2F_* */
 	fido_assert_ext_t  ext;          /* enabled extensions */
 	fido_assert_stmt  *stmt;         /* array of expected assertions */
 	size_t             stmt_cnt;     /* number of allocated assertions */
 	size_t             stmt_len;     /* number of received assertions */
+	size_t             stmt_fetch;   /* assertions fetched eagerly; 0=all */
+	bool               stmt_more;    /* more held by the authenticator */
+	bool               lazy;         /* decode ids and user on access */
+	struct fido_assert_arena *arena; /* received replies; see assert.c */
+	void              *winhello;     /* winhello translation of the above */
 } fido_assert_t;
 
 typedef struct fido_opt_array {
@@ -277,6 +429,11 @@ typedef struct fido_cbor_info {
 	int64_t           rk_remaining;   /* remaining resident credentials */
 	bool              new_pin_reqd;   /* new pin required */
 	fido_cert_array_t certs;          /* associated certifications */
+	uint64_t          opt_present;    /* FIDO_INFO_OPT_* reported */
+	uint64_t          opt_true;       /* FIDO_INFO_OPT_* set to true */
+	unsigned char    *arena;          /* storage of the arrays above */
+	size_t            arena_len;
+	size_t            arena_off;
 } fido_cbor_info_t;
 
 typedef struct fido_dev_info {
@@ -285,10 +442,74 @@ typedef struct fido_dev_info {
 	int16_t               product_id;   /* 2-byte product id */
 	char                 *manufacturer; /* manufacturer string */
 	char                 *product;      /* product string */
+	char                 *serial;       /* serial number, or NULL */
 	fido_dev_io_t         io;           /* i/o functions */
 	fido_dev_transport_t  transport;    /* transport functions */
 } fido_dev_info_t;
 
+typedef struct fido_dev_monitor {
+	fido_dev_info_t       *devlist; /* known devices */
+	size_t                *source;  /* manifest each device came from */
+	size_t                 len;     /* number of known devices */
+	size_t                 cap;     /* allocated slots */
+	fido_dev_info_t       *scan;    /* reused by rescans */
+	size_t                 scan_len;
+	size_t                 scan_cap;
+	void                  *hid;     /* hid event source; NULL if rescanned */
+	bool                   started;
+	fido_dev_monitor_cb_t *cb;      /* add/remove callback */
+	void                  *cb_arg;
+} fido_dev_monitor_t;
+
+typedef struct fido_deadline {
+	struct timespec ts;    /* expiry, CLOCK_MONOTONIC */
+	int             ms;    /* time left at the last check; -1 if none */
+	bool            fresh; /* ms is current; no clock read needed */
+} fido_deadline_t;
+
+typedef struct fido_prof {
+	struct timespec start; /* CLOCK_MONOTONIC */
+	int             stage; /* FIDO_PROF_*; -1 if not recording */
+} fido_prof_t;
+
+typedef struct fido_broker {
+	void                  *dev;         /* hid handle of the device */
+	size_t                 report_len;
+	int                    sock;        /* listening unix socket */
+	char                  *sock_path;
+	int                    attach[2];   /* fido_broker_attach() handoff */
+	struct broker_client  *client;      /* connected clients */
+	size_t                 nclient;
+	size_t                 turn;        /* client to consider first */
+	int                    busy;        /* fd of the client served; or -1 */
+	fido_deadline_t        busy_dl;     /* silence before giving up */
+	size_t                 busy_want;   /* reply length, once known */
+	size_t                 busy_got;
+	bool                   busy_rx;     /* reply started */
+	fido_blob_t            info;        /* kept getInfo reply */
+	fido_blob_t            info_rx;     /* getInfo reply being routed */
+	size_t                 info_want;
+	uint32_t               info_cid;
+	uint8_t                info_seq;
+	bool                   info_capture;
+} fido_broker_t;
+
+typedef struct fido_dev_pool_step {
+	fido_dev_pool_cb_t *cb;
+	void               *cb_arg;
+} fido_dev_pool_step_t;
+
+typedef struct fido_dev_pool {
+	struct fido_dev          **dev;
+	int                       *status; /* open, then first failing step */
+	size_t                     len;
+	fido_dev_pool_step_t      *step;   /* run on each device, in order */
+	size_t                     nsteps;
+	fido_dev_pool_progress_t  *progress;
+	void                      *progress_arg;
+	long                       next;   /* next device to claim; atomic */
+} fido_dev_pool_t;
+
 PACKED_TYPE(fido_ctap_info_t,
 /* defined in section 8.1.9.1.3 (CTAPHID_INIT) of the fido2 ctap spec */
 struct fido_ctap_info {
@@ -301,12 +522,40 @@ struct fido_ctap_info {
 	uint8_t  flags;    /* capabilities flags; see FIDO_CAP_* */
 })
 
+typedef struct fido_attest_store {
+	X509_STORE *store; /* trust anchors */
+	uint64_t    id;    /* random; keys validation memos */
+} fido_attest_store_t;
+
+typedef struct fido_keystore {
+	struct keystore_entry *entry;    /* added keys, to be written */
+	size_t                 entry_len;
+	size_t                 entry_cap;
+	unsigned char         *keys;     /* raw keys of the added entries */
+	size_t                 keys_len;
+	size_t                 keys_cap;
+	const unsigned char   *map;      /* opened store, mapped read-only */
+	unsigned char         *ctr_map;  /* writable mapping, if any */
+	size_t                 map_len;
+	size_t                 ctr_off;  /* signature counters in the map */
+	size_t                 count;    /* keys in the opened store */
+} fido_keystore_t;
+
+typedef struct fido_rtt {
+	uint16_t ms[FIDO_RTT_SAMPLES]; /* most recent, in ms */
+	uint8_t  len;
+	uint8_t  next;
+} fido_rtt_t;
+
 typedef struct fido_dev {
 	uint64_t              nonce;      /* issued nonce */
 	fido_ctap_info_t      attr;       /* device attributes */
 	uint32_t              cid;        /* assigned channel id */
 	char                 *path;       /* device path */
+	int16_t               vendor_id;  /* from fido_dev_new_with_info() */
+	int16_t               product_id;
 	void                 *io_handle;  /* abstract i/o handle */
+	void                 *io_attach;  /* handle for the next open */
 	fido_dev_io_t         io;         /* i/o functions */
 	bool                  io_own;     /* device has own io/transport */
 	size_t                rx_len;     /* length of HID input reports */
@@ -315,14 +564,71 @@ typedef struct fido_dev {
 	fido_dev_transport_t  transport;  /* transport functions */
 	uint64_t	      maxmsgsize; /* max message size */
 	int		      timeout_ms; /* read timeout in ms */
+	fido_cbor_info_t     *info;       /* getinfo reply from open */
+	unsigned char         rx_pending[CTAP_MAX_REPORT_LEN]; /* polled frame */
+	unsigned char         rx_frame[CTAP_MAX_REPORT_LEN]; /* rx scratch */
+	size_t                rx_pending_len;
+	uint8_t               async_cmd;  /* submitted ctap command */
+	fido_blob_t          *async_ecdh; /* shared secret of async_cmd */
+	void                 *winhello_op; /* submitted windows hello request */
+	fido_blob_array_t     largeblob_dict; /* preset dictionaries */
+	bool                  largeblob_cache; /* reuse the largeBlob array */
+	fido_blob_t          *largeblob_array; /* cached array and digest */
+	int                   largeblob_retry; /* extra attempts per chunk */
+	fido_largeblob_progress_t *largeblob_progress; /* per chunk */
+	void                 *largeblob_progress_arg;
+	fido_dev_keepalive_t *keepalive;  /* keepalive handler */
+	void                 *keepalive_arg;
+	struct timespec       tx_ts;      /* last request transmitted */
+	uint8_t               rtt_cmd;    /* cbor request being timed */
+	fido_rtt_t            rtt[FIDO_RTT_NCLASS]; /* non-up round trips */
+	unsigned int          rtt_factor; /* adaptive deadline; 0 if off */
+	fido_dev_metrics_cb_t *metrics_cb; /* metrics handler */
+	void                 *metrics_arg;
+	fido_dev_metrics_t    metrics;    /* of the pending request */
+	bool                  metrics_pending;
+	bool                  up_wait;    /* user presence awaited since up_ts */
+	struct timespec       up_ts;
+	unsigned char        *msgbuf;     /* reply scratch */
+	size_t                msgbuf_len;
+	size_t                msgbuf_dirty; /* bytes of msgbuf to clear */
+	bool                  msgbuf_busy;
+	bool                  token_cache; /* reuse pinUvAuthTokens */
+	fido_blob_t          *token;      /* cached pinUvAuthToken */
+	fido_blob_t          *token_scope; /* cmd, pin digest, rpId of token */
+	es256_pk_t           *ecdh_pk;    /* cached platform key agreement */
+	fido_blob_t          *ecdh;       /* cached shared secret */
+	struct aes256_cache  *aes;        /* cipher contexts keyed with ecdh */
+	bool                  nfc_ext;    /* extended-length apdus over nfc */
+	uint8_t               lock_secs;  /* CTAPHID_LOCK around sequences */
+	unsigned int          lock_depth; /* nested sequences */
+	bool                  lock_auto;  /* lock taken by the outermost one */
+	bool                  locked;     /* lock taken by fido_dev_lock() */
+	int                   log_level;  /* FIDO_LOG_*; -1 if the default */
+	struct fido_chan     *chan;       /* channels sharing io_handle */
 } fido_dev_t;
 
+typedef struct fido_remote {
+	fido_dev_t            *dev;         /* served device; not owned */
+	int                    sock;        /* listening socket */
+	char                  *sock_path;   /* unix socket to remove */
+	struct remote_client  *client;      /* connected clients */
+	size_t                 nclient;
+} fido_remote_t;
+
 #else
 typedef struct fido_assert fido_assert_t;
+typedef struct fido_attest_store fido_attest_store_t;
+typedef struct fido_broker fido_broker_t;
 typedef struct fido_cbor_info fido_cbor_info_t;
 typedef struct fido_cred fido_cred_t;
 typedef struct fido_dev fido_dev_t;
 typedef struct fido_dev_info fido_dev_info_t;
+typedef struct fido_dev_monitor fido_dev_monitor_t;
+typedef struct fido_dev_pool fido_dev_pool_t;
+typedef struct fido_keystore fido_keystore_t;
+typedef struct fido_pk fido_pk_t;
+typedef struct fido_remote fido_remote_t;
 typedef struct es256_pk es256_pk_t;
 typedef struct es256_sk es256_sk_t;
 typedef struct es384_pk es384_pk_t;
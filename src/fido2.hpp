@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * C++20 bindings for libfido2. Header-only; every object below is a
+ * thin, move-only owner of the corresponding C object, adds no
+ * allocation of its own, and exposes the C object through get() for
+ * the functions not wrapped here. Errors are reported as
+ * std::error_code values in fido::category(); nothing throws.
+ */
+
+#ifndef _FIDO2_HPP
+#define _FIDO2_HPP
+
+#if __cplusplus < 202002L && (!defined(_MSVC_LANG) || _MSVC_LANG < 202002L)
+#error "fido2.hpp requires C++20"
+#endif
+
+#include <coroutine>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fido.h>
+#include <fido/eddsa.h>
+#include <fido/es256.h>
+#include <fido/es384.h>
+#include <fido/rs256.h>
+
+namespace fido {
+
+using bytes = std::span<const unsigned char>;
+
+class error_category final : public std::error_category {
+public:
+	const char *name() const noexcept override { return "fido"; }
+	std::string message(int r) const override { return fido_strerr(r); }
+};
+
+inline const std::error_category &
+category() noexcept
+{
+	static const error_category c;
+	return c;
+}
+
+/* FIDO_OK maps to an empty error code */
+inline std::error_code
+make_error_code(int r) noexcept
+{
+	return r == FIDO_OK ? std::error_code() : std::error_code(r, category());
+}
+
+namespace detail {
+
+inline bytes
+make_bytes(const unsigned char *ptr, size_t len) noexcept
+{
+	return ptr == nullptr ? bytes() : bytes(ptr, len);
+}
+
+/* an owning pointer to T, released with Free */
+template <class T, T *(*New)(), void (*Free)(T **)>
+class handle {
+public:
+	handle() noexcept = default;
+	explicit handle(T *p) noexcept : p_(p) {}
+	handle(const handle &) = delete;
+	handle &operator=(const handle &) = delete;
+	handle(handle &&o) noexcept : p_(std::exchange(o.p_, nullptr)) {}
+	handle &operator=(handle &&o) noexcept
+	{
+		if (this != &o)
+			reset(std::exchange(o.p_, nullptr));
+		return *this;
+	}
+	~handle() { reset(); }
+
+	T *get() const noexcept { return p_; }
+	T *release() noexcept { return std::exchange(p_, nullptr); }
+	void reset(T *p = nullptr) noexcept
+	{
+		T *o = std::exchange(p_, p);
+		Free(&o);
+	}
+	explicit operator bool() const noexcept { return p_ != nullptr; }
+
+protected:
+	/* a new C object; empty if it could not be allocated */
+	static T *make() noexcept { return New(); }
+
+private:
+	T *p_ = nullptr;
+};
+
+inline void
+dev_close_free(fido_dev_t **dev_p)
+{
+	if (*dev_p != nullptr)
+		(void)fido_dev_close(*dev_p);
+	fido_dev_free(dev_p);
+}
+
+} /* namespace detail */
+
+#define FIDO2_HPP_KEY(name)						\
+class name : public detail::handle<name##_t, name##_new, name##_free> {	\
+public:									\
+	using handle::handle;						\
+	static name create() noexcept { return name(make()); }		\
+};
+
+FIDO2_HPP_KEY(es256_pk)
+FIDO2_HPP_KEY(es384_pk)
+FIDO2_HPP_KEY(rs256_pk)
+FIDO2_HPP_KEY(eddsa_pk)
+
+#undef FIDO2_HPP_KEY
+
+class cbor_info : public detail::handle<fido_cbor_info_t, fido_cbor_info_new,
+    fido_cbor_info_free> {
+public:
+	using handle::handle;
+	static cbor_info create() noexcept { return cbor_info(make()); }
+
+	bytes aaguid() const noexcept
+	{
+		return detail::make_bytes(fido_cbor_info_aaguid_ptr(get()),
+		    fido_cbor_info_aaguid_len(get()));
+	}
+};
+
+class cred : public detail::handle<fido_cred_t, fido_cred_new,
+    fido_cred_free> {
+public:
+	using handle::handle;
+	static cred create() noexcept { return cred(make()); }
+
+#define FIDO2_HPP_BYTES(name)						\
+	bytes name() const noexcept					\
+	{								\
+		return detail::make_bytes(fido_cred_##name##_ptr(get()),\
+		    fido_cred_##name##_len(get()));			\
+	}
+	FIDO2_HPP_BYTES(aaguid)
+	FIDO2_HPP_BYTES(attstmt)
+	FIDO2_HPP_BYTES(authdata)
+	FIDO2_HPP_BYTES(authdata_raw)
+	FIDO2_HPP_BYTES(clientdata_hash)
+	FIDO2_HPP_BYTES(id)
+	FIDO2_HPP_BYTES(pubkey)
+	FIDO2_HPP_BYTES(sig)
+	FIDO2_HPP_BYTES(user_id)
+	FIDO2_HPP_BYTES(x5c)
+#undef FIDO2_HPP_BYTES
+
+	bytes x5c(size_t idx) const noexcept
+	{
+		return detail::make_bytes(fido_cred_x5c_list_ptr(get(), idx),
+		    fido_cred_x5c_list_len(get(), idx));
+	}
+	size_t x5c_count() const noexcept
+	{
+		return fido_cred_x5c_list_count(get());
+	}
+	const char *fmt() const noexcept { return fido_cred_fmt(get()); }
+	int type() const noexcept { return fido_cred_type(get()); }
+
+	std::error_code verify() const noexcept
+	{
+		return make_error_code(fido_cred_verify(get()));
+	}
+	std::error_code verify_self() const noexcept
+	{
+		return make_error_code(fido_cred_verify_self(get()));
+	}
+};
+
+class assertion : public detail::handle<fido_assert_t, fido_assert_new,
+    fido_assert_free> {
+public:
+	using handle::handle;
+	static assertion create() noexcept { return assertion(make()); }
+
+	size_t count() const noexcept { return fido_assert_count(get()); }
+
+#define FIDO2_HPP_BYTES(name)						\
+	bytes name(size_t idx) const noexcept				\
+	{								\
+		return detail::make_bytes(				\
+		    fido_assert_##name##_ptr(get(), idx),		\
+		    fido_assert_##name##_len(get(), idx));		\
+	}
+	FIDO2_HPP_BYTES(authdata)
+	FIDO2_HPP_BYTES(authdata_raw)
+	FIDO2_HPP_BYTES(blob)
+	FIDO2_HPP_BYTES(hmac_secret)
+	FIDO2_HPP_BYTES(id)
+	FIDO2_HPP_BYTES(largeblob_key)
+	FIDO2_HPP_BYTES(sig)
+	FIDO2_HPP_BYTES(user_id)
+#undef FIDO2_HPP_BYTES
+
+	bytes clientdata_hash() const noexcept
+	{
+		return detail::make_bytes(fido_assert_clientdata_hash_ptr(get()),
+		    fido_assert_clientdata_hash_len(get()));
+	}
+
+	std::error_code verify(size_t idx, int cose_alg,
+	    const void *pk) const noexcept
+	{
+		return make_error_code(fido_assert_verify(get(), idx, cose_alg,
+		    pk));
+	}
+};
+
+/* a device; closed, if open, when released */
+class dev : public detail::handle<fido_dev_t, fido_dev_new,
+    detail::dev_close_free> {
+public:
+	using handle::handle;
+	static dev create() noexcept { return dev(make()); }
+
+	std::error_code open(const char *path) noexcept
+	{
+		return make_error_code(fido_dev_open(get(), path));
+	}
+	std::error_code close() noexcept
+	{
+		return make_error_code(fido_dev_close(get()));
+	}
+	std::error_code cancel() noexcept
+	{
+		return make_error_code(fido_dev_cancel(get()));
+	}
+	std::error_code get_cbor_info(cbor_info &ci) noexcept
+	{
+		return make_error_code(fido_dev_get_cbor_info(get(), ci.get()));
+	}
+	std::error_code make_cred(cred &c, const char *pin) noexcept
+	{
+		return make_error_code(fido_dev_make_cred(get(), c.get(), pin));
+	}
+	std::error_code get_assert(assertion &a, const char *pin) noexcept
+	{
+		return make_error_code(fido_dev_get_assert(get(), a.get(), pin));
+	}
+	std::error_code set_timeout(int ms) noexcept
+	{
+		return make_error_code(fido_dev_set_timeout(get(), ms));
+	}
+	bool is_fido2() const noexcept { return fido_dev_is_fido2(get()); }
+};
+
+/*
+ * A request submitted with fido_dev_make_cred_submit() or
+ * fido_dev_get_assert_submit(), as seen by the application's event
+ * loop. The waiter given to the operation is called with a wakeup once
+ * the coroutine is suspended; it registers fd() or, on Windows,
+ * handle() with the event loop, and calls the wakeup each time the
+ * descriptor is readable or the handle signalled. A wakeup returning
+ * false wants to be called again on the next event, and one returning
+ * true has resumed the coroutine and must not be touched again. The
+ * handle changes as reports are read, and must be fetched anew before
+ * each wait. A request may be aborted with fido_dev_cancel().
+ */
+class wakeup {
+public:
+	wakeup(const wakeup &) = delete;
+	wakeup &operator=(const wakeup &) = delete;
+
+	int fd() const noexcept { return fido_dev_get_pollfd(dev_); }
+	void *handle() const noexcept { return fido_dev_get_pollhandle(dev_); }
+
+	bool operator()() noexcept
+	{
+		int r = fido_dev_poll(dev_, 0);
+
+		if (r == FIDO_ERR_TIMEOUT)
+			return false;
+		/* transports without fido_dev_poll() go straight to completion */
+		if (r == FIDO_OK || r == FIDO_ERR_UNSUPPORTED_OPTION)
+			r = complete_(dev_, obj_);
+		r_ = r;
+		h_.resume(); /* may destroy *this */
+
+		return true;
+	}
+
+protected:
+	using submit_fn = int (*)(fido_dev_t *, void *, const char *);
+	using complete_fn = int (*)(fido_dev_t *, void *);
+
+	wakeup(fido_dev_t *d, void *obj, const char *pin, submit_fn submit,
+	    complete_fn complete) noexcept
+	    : dev_(d), obj_(obj), pin_(pin), submit_(submit),
+	      complete_(complete) {}
+
+	fido_dev_t		*dev_;
+	void			*obj_;
+	const char		*pin_;
+	submit_fn		 submit_;
+	complete_fn		 complete_;
+	int			 r_ = FIDO_ERR_INTERNAL;
+	std::coroutine_handle<>	 h_;
+};
+
+/*
+ * The awaitable returned by fido::make_cred() and fido::get_assert().
+ * The request is submitted when awaited; the exchanges preceding it,
+ * such as obtaining a PIN/UV auth token, still block. If the device
+ * has neither a descriptor nor a handle to wait on, the reply is
+ * collected without suspending.
+ */
+template <class Waiter>
+class async_op : private wakeup {
+public:
+	async_op(fido_dev_t *d, void *obj, const char *pin, submit_fn submit,
+	    complete_fn complete, Waiter w) noexcept
+	    : wakeup(d, obj, pin, submit, complete), waiter_(std::move(w)) {}
+
+	bool await_ready() const noexcept { return false; }
+
+	bool await_suspend(std::coroutine_handle<> h) noexcept
+	{
+		if ((r_ = submit_(dev_, obj_, pin_)) != FIDO_OK)
+			return false;
+		if (fd() < 0 && handle() == nullptr) {
+			r_ = complete_(dev_, obj_);
+			return false;
+		}
+		h_ = h;
+		waiter_(static_cast<wakeup &>(*this));
+
+		return true;
+	}
+
+	std::error_code await_resume() const noexcept
+	{
+		return make_error_code(r_);
+	}
+
+private:
+	Waiter waiter_;
+};
+
+template <class Waiter>
+async_op<Waiter>
+make_cred(dev &d, cred &c, const char *pin, Waiter w) noexcept
+{
+	return async_op<Waiter>(d.get(), c.get(), pin,
+	    [](fido_dev_t *dp, void *o, const char *p) {
+		return fido_dev_make_cred_submit(dp,
+		    static_cast<fido_cred_t *>(o), p);
+	    },
+	    [](fido_dev_t *dp, void *o) {
+		return fido_dev_make_cred_complete(dp,
+		    static_cast<fido_cred_t *>(o));
+	    }, std::move(w));
+}
+
+template <class Waiter>
+async_op<Waiter>
+get_assert(dev &d, assertion &a, const char *pin, Waiter w) noexcept
+{
+	return async_op<Waiter>(d.get(), a.get(), pin,
+	    [](fido_dev_t *dp, void *o, const char *p) {
+		return fido_dev_get_assert_submit(dp,
+		    static_cast<fido_assert_t *>(o), p);
+	    },
+	    [](fido_dev_t *dp, void *o) {
+		return fido_dev_get_assert_complete(dp,
+		    static_cast<fido_assert_t *>(o));
+	    }, std::move(w));
+}
+
+} /* namespace fido */
+
+#endif /* !_FIDO2_HPP */
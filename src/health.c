@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "fido.h"
+#include "fido/bio.h"
+#include "fido/credman.h"
+
+/*
+ * The read-only queries a monitoring agent makes of a device, issued
+ * back to back on the open channel under one time budget and, with
+ * fido_dev_set_lock(), one CTAPHID_LOCK. Queries the device does not
+ * support are skipped without a round trip; the credman metadata query
+ * is the only one that needs a pinUvAuthToken.
+ */
+
+static bool
+health_supports_bio(const fido_dev_t *dev)
+{
+	return (dev->flags & (FIDO_DEV_BIO_SET|FIDO_DEV_BIO_UNSET));
+}
+
+static void
+health_reset(fido_dev_health_t *h)
+{
+	h->pin_retries = -1;
+	h->uv_retries = -1;
+	h->info_r = FIDO_ERR_UNSUPPORTED_OPTION;
+	h->pin_retries_r = FIDO_ERR_UNSUPPORTED_OPTION;
+	h->uv_retries_r = FIDO_ERR_UNSUPPORTED_OPTION;
+	h->metadata_r = FIDO_ERR_UNSUPPORTED_OPTION;
+	h->bio_r = FIDO_ERR_UNSUPPORTED_OPTION;
+}
+
+/* the first failure of a query that was made */
+static int
+health_result(int r, int q)
+{
+	if (r != FIDO_OK || q == FIDO_OK || q == FIDO_ERR_UNSUPPORTED_OPTION)
+		return (r);
+
+	return (q);
+}
+
+static int
+health_snapshot_wait(fido_dev_t *dev, fido_dev_health_t *h, const char *pin,
+    int *ms)
+{
+	int r = FIDO_OK;
+	int q;
+
+	if (h->info != NULL) {
+		h->info_r = fido_dev_get_cbor_info_wait(dev, h->info, ms);
+		r = health_result(r, h->info_r);
+	}
+
+	/* the queries below depend on the device's capabilities */
+	if ((q = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		return (health_result(r, q));
+	}
+
+	if (fido_dev_supports_pin(dev)) {
+		h->pin_retries_r = fido_dev_get_pin_retry_count_wait(dev,
+		    &h->pin_retries, ms);
+		r = health_result(r, h->pin_retries_r);
+		if (h->pin_retries_r != FIDO_OK)
+			h->pin_retries = -1;
+	}
+	if (fido_dev_supports_uv(dev)) {
+		h->uv_retries_r = fido_dev_get_uv_retry_count_wait(dev,
+		    &h->uv_retries, ms);
+		r = health_result(r, h->uv_retries_r);
+		if (h->uv_retries_r != FIDO_OK)
+			h->uv_retries = -1;
+	}
+	if (h->metadata != NULL && fido_dev_supports_credman(dev)) {
+		h->metadata_r = fido_credman_get_metadata_wait(dev, h->metadata,
+		    pin, ms);
+		r = health_result(r, h->metadata_r);
+	}
+	if (h->bio != NULL && health_supports_bio(dev)) {
+		h->bio_r = fido_bio_get_info_wait(dev, h->bio, ms);
+		r = health_result(r, h->bio_r);
+	}
+
+	return (r);
+}
+
+int
+fido_dev_health_snapshot(fido_dev_t *dev, fido_dev_health_t *h,
+    const char *pin)
+{
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	if (h == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	health_reset(h);
+
+	if (fido_dev_is_fido2(dev) == false)
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	fido_dev_lock_begin(dev, &ms);
+	r = health_snapshot_wait(dev, h, pin, &ms);
+	fido_dev_lock_end(dev);
+
+	return (fido_trace_end(&span, r));
+}
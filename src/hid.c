@@ -119,15 +119,16 @@ fido_hid_get_report_len(const uint8_t *report_ptr, size_t report_len,
 fido_dev_info_t *
 fido_dev_info_new(size_t n)
 {
-	return (calloc(n, sizeof(fido_dev_info_t)));
+	return (fido_calloc(n, sizeof(fido_dev_info_t)));
 }
 
 static void
 fido_dev_info_reset(fido_dev_info_t *di)
 {
-	free(di->path);
-	free(di->manufacturer);
-	free(di->product);
+	fido_free(di->path);
+	fido_free(di->manufacturer);
+	fido_free(di->product);
+	fido_free(di->serial);
 	memset(di, 0, sizeof(*di));
 }
 
@@ -142,7 +143,7 @@ fido_dev_info_free(fido_dev_info_t **devlist_p, size_t n)
 	for (size_t i = 0; i < n; i++)
 		fido_dev_info_reset(&devlist[i]);
 
-	free(devlist);
+	fido_free(devlist);
 
 	*devlist_p = NULL;
 }
@@ -167,9 +168,9 @@ fido_dev_info_set(fido_dev_info_t *devlist, size_t i,
 		goto out;
 	}
 
-	if ((path_copy = strdup(path)) == NULL ||
-	    (manu_copy = strdup(manufacturer)) == NULL ||
-	    (prod_copy = strdup(product)) == NULL) {
+	if ((path_copy = fido_strdup(path)) == NULL ||
+	    (manu_copy = fido_strdup(manufacturer)) == NULL ||
+	    (prod_copy = fido_strdup(product)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
@@ -184,9 +185,9 @@ fido_dev_info_set(fido_dev_info_t *devlist, size_t i,
 	r = FIDO_OK;
 out:
 	if (r != FIDO_OK) {
-		free(prod_copy);
-		free(manu_copy);
-		free(path_copy);
+		fido_free(prod_copy);
+		fido_free(manu_copy);
+		fido_free(path_copy);
 	}
 	return (r);
 }
@@ -220,3 +221,9 @@ fido_dev_info_product_string(const fido_dev_info_t *di)
 {
 	return (di->product);
 }
+
+const char *
+fido_dev_info_serial_string(const fido_dev_info_t *di)
+{
+	return (di->serial != NULL ? di->serial : "");
+}
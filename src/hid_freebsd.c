@@ -6,6 +6,9 @@
  */
 
 #include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 #include <dev/usb/usb_ioctl.h>
 #include <dev/usb/usbhid.h>
@@ -19,6 +22,10 @@
 
 #include "fido.h"
 
+#ifndef TLS
+#define TLS
+#endif
+
 #if defined(__MidnightBSD__)
 #define UHID_VENDOR    "MidnightBSD"
 #else
@@ -27,6 +34,36 @@
 
 #define MAX_UHID	64
 
+#define HID_CLASS_CACHE_LEN	32
+#define HID_CLASS_PATH_MAX	64
+#define HID_CLASS_STR_MAX	128
+
+#define DEVD_PIPE	"/var/run/devd.seqpacket.pipe"
+
+/*
+ * Classification and USB information of hidraw(4) and uhid(4) nodes,
+ * remembered across enumerations. devfs(5) nodes are created on attach,
+ * so a node is identified by its path, device number, inode, and change
+ * time, and a node recreated for another device is probed again.
+ */
+struct hid_class {
+	char		path[HID_CLASS_PATH_MAX];
+	dev_t		rdev;
+	ino_t		ino;
+	struct timespec	ctime;
+	bool		fido;
+	int16_t		vendor_id;
+	int16_t		product_id;
+	char		manufacturer[HID_CLASS_STR_MAX];
+	char		product[HID_CLASS_STR_MAX];
+	char		serial[HID_CLASS_STR_MAX];
+};
+
+typedef int hid_probe_t(const char *, struct hid_class *);
+
+static TLS struct hid_class hid_class_tab[HID_CLASS_CACHE_LEN];
+static TLS size_t hid_class_next;
+
 struct hid_freebsd {
 	int             fd;
 	size_t          report_in_len;
@@ -35,6 +72,10 @@ struct hid_freebsd {
 	const sigset_t *sigmaskp;
 };
 
+struct hid_freebsd_monitor {
+	int fd;
+};
+
 static bool
 is_fido(int fd)
 {
@@ -63,8 +104,9 @@ is_fido(int fd)
 }
 
 #ifdef USE_HIDRAW
+/* returns -1 if the node could not be queried */
 static int
-copy_info_hidraw(fido_dev_info_t *di, const char *path)
+probe_hidraw(const char *path, struct hid_class *c)
 {
 	int			fd = -1;
 	int			ok = -1;
@@ -72,60 +114,56 @@ copy_info_hidraw(fido_dev_info_t *di, const char *path)
 	struct hidraw_devinfo	devinfo;
 	char			rawname[129];
 
-	memset(di, 0, sizeof(*di));
 	memset(&udi, 0, sizeof(udi));
 	memset(&devinfo, 0, sizeof(devinfo));
 	memset(rawname, 0, sizeof(rawname));
 
-	if ((fd = fido_hid_unix_open(path)) == -1 || is_fido(fd) == 0)
-		goto fail;
+	if ((fd = fido_hid_unix_open(path)) == -1)
+		return (-1);
+	if ((c->fido = is_fido(fd)) == false) {
+		ok = 0;
+		goto out;
+	}
 
 	if (ioctl(fd, IOCTL_REQ(USB_GET_DEVICEINFO), &udi) == -1) {
 		if (ioctl(fd, IOCTL_REQ(HIDIOCGRAWINFO), &devinfo) == -1 ||
-		    ioctl(fd, IOCTL_REQ(HIDIOCGRAWNAME(128)), rawname) == -1 ||
-		    (di->path = strdup(path)) == NULL ||
-		    (di->manufacturer = strdup(UHID_VENDOR)) == NULL ||
-		    (di->product = strdup(rawname)) == NULL)
-			goto fail;
-		di->vendor_id = devinfo.vendor;
-		di->product_id = devinfo.product;
+		    ioctl(fd, IOCTL_REQ(HIDIOCGRAWNAME(128)), rawname) == -1)
+			goto out;
+		strlcpy(c->manufacturer, UHID_VENDOR, sizeof(c->manufacturer));
+		strlcpy(c->product, rawname, sizeof(c->product));
+		c->vendor_id = devinfo.vendor;
+		c->product_id = devinfo.product;
 	} else {
-		if ((di->path = strdup(path)) == NULL ||
-		    (di->manufacturer = strdup(udi.udi_vendor)) == NULL ||
-		    (di->product = strdup(udi.udi_product)) == NULL)
-			goto fail;
-		di->vendor_id = (int16_t)udi.udi_vendorNo;
-		di->product_id = (int16_t)udi.udi_productNo;
+		strlcpy(c->manufacturer, udi.udi_vendor,
+		    sizeof(c->manufacturer));
+		strlcpy(c->product, udi.udi_product, sizeof(c->product));
+		strlcpy(c->serial, udi.udi_serial, sizeof(c->serial));
+		c->vendor_id = (int16_t)udi.udi_vendorNo;
+		c->product_id = (int16_t)udi.udi_productNo;
 	}
 
 	ok = 0;
-fail:
-	if (fd != -1 && close(fd) == -1)
+out:
+	if (close(fd) == -1)
 		fido_log_error(errno, "%s: close %s", __func__, path);
 
-	if (ok < 0) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
-		explicit_bzero(di, sizeof(*di));
-	}
-
 	return (ok);
 }
 #endif /* USE_HIDRAW */
 
+/* returns -1 if the node could not be queried */
 static int
-copy_info_uhid(fido_dev_info_t *di, const char *path)
+probe_uhid(const char *path, struct hid_class *c)
 {
 	int			fd = -1;
-	int			ok = -1;
 	struct usb_device_info	udi;
 
-	memset(di, 0, sizeof(*di));
 	memset(&udi, 0, sizeof(udi));
 
-	if ((fd = fido_hid_unix_open(path)) == -1 || is_fido(fd) == 0)
-		goto fail;
+	if ((fd = fido_hid_unix_open(path)) == -1)
+		return (-1);
+	if ((c->fido = is_fido(fd)) == false)
+		goto out;
 
 	if (ioctl(fd, IOCTL_REQ(USB_GET_DEVICEINFO), &udi) == -1) {
 		fido_log_error(errno, "%s: ioctl", __func__);
@@ -134,26 +172,108 @@ copy_info_uhid(fido_dev_info_t *di, const char *path)
 		udi.udi_vendorNo = 0x0b5d; /* stolen from PCI_VENDOR_OPENBSD */
 	}
 
-	if ((di->path = strdup(path)) == NULL ||
-	    (di->manufacturer = strdup(udi.udi_vendor)) == NULL ||
-	    (di->product = strdup(udi.udi_product)) == NULL)
-		goto fail;
-	di->vendor_id = (int16_t)udi.udi_vendorNo;
-	di->product_id = (int16_t)udi.udi_productNo;
-
-	ok = 0;
-fail:
-	if (fd != -1 && close(fd) == -1)
+	strlcpy(c->manufacturer, udi.udi_vendor, sizeof(c->manufacturer));
+	strlcpy(c->product, udi.udi_product, sizeof(c->product));
+	strlcpy(c->serial, udi.udi_serial, sizeof(c->serial));
+	c->vendor_id = (int16_t)udi.udi_vendorNo;
+	c->product_id = (int16_t)udi.udi_productNo;
+out:
+	if (close(fd) == -1)
 		fido_log_error(errno, "%s: close %s", __func__, path);
 
-	if (ok < 0) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
-		explicit_bzero(di, sizeof(*di));
+	return (0);
+}
+
+static const struct hid_class *
+hid_class_lookup(const char *path, const struct stat *st)
+{
+	for (size_t i = 0; i < HID_CLASS_CACHE_LEN; i++) {
+		const struct hid_class *c = &hid_class_tab[i];
+		if (c->path[0] != '\0' && strcmp(c->path, path) == 0 &&
+		    c->rdev == st->st_rdev && c->ino == st->st_ino &&
+		    c->ctime.tv_sec == st->st_ctim.tv_sec &&
+		    c->ctime.tv_nsec == st->st_ctim.tv_nsec)
+			return (c);
 	}
 
-	return (ok);
+	return (NULL);
+}
+
+static void
+hid_class_store(const char *path, const struct stat *st,
+    const struct hid_class *probed)
+{
+	struct hid_class	*c = NULL;
+	size_t			 len;
+
+	if ((len = strlen(path)) >= HID_CLASS_PATH_MAX)
+		return;
+
+	/* replace a stale entry for the same path, if any */
+	for (size_t i = 0; i < HID_CLASS_CACHE_LEN; i++)
+		if (strcmp(hid_class_tab[i].path, path) == 0) {
+			c = &hid_class_tab[i];
+			break;
+		}
+	if (c == NULL) {
+		c = &hid_class_tab[hid_class_next];
+		hid_class_next = (hid_class_next + 1) % HID_CLASS_CACHE_LEN;
+	}
+
+	*c = *probed;
+	memset(c->path, 0, sizeof(c->path));
+	memcpy(c->path, path, len);
+	c->rdev = st->st_rdev;
+	c->ino = st->st_ino;
+	c->ctime = st->st_ctim;
+}
+
+static int
+copy_info(fido_dev_info_t *di, const char *path, hid_probe_t *probe)
+{
+	const struct hid_class	*cached;
+	struct hid_class	 c;
+	struct stat		 st;
+	bool			 cacheable;
+
+	memset(di, 0, sizeof(*di));
+	memset(&c, 0, sizeof(c));
+
+	if ((cacheable = stat(path, &st) == 0) &&
+	    (cached = hid_class_lookup(path, &st)) != NULL)
+		c = *cached;
+	else {
+		if (probe(path, &c) < 0)
+			return (-1); /* do not remember transient failures */
+		if (cacheable)
+			hid_class_store(path, &st, &c);
+	}
+
+	if (!c.fido)
+		return (-1);
+
+	if ((di->path = fido_strdup(path)) == NULL ||
+	    (di->manufacturer = fido_strdup(c.manufacturer)) == NULL ||
+	    (di->product = fido_strdup(c.product)) == NULL ||
+	    (c.serial[0] != '\0' &&
+	    (di->serial = fido_strdup(c.serial)) == NULL)) {
+		fido_free(di->path);
+		fido_free(di->manufacturer);
+		fido_free(di->product);
+		fido_free(di->serial);
+		explicit_bzero(di, sizeof(*di));
+		return (-1);
+	}
+	di->vendor_id = c.vendor_id;
+	di->product_id = c.product_id;
+	di->io = (fido_dev_io_t) {
+		fido_hid_open,
+		fido_hid_close,
+		fido_hid_read,
+		fido_hid_write,
+	};
+
+	return (0);
 }
 
 int
@@ -173,15 +293,8 @@ fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 #ifdef USE_HIDRAW
 	for (i = 0; i < MAX_UHID && *olen < ilen; i++) {
 		snprintf(path, sizeof(path), "/dev/hidraw%zu", i);
-		if (copy_info_hidraw(&devlist[*olen], path) == 0) {
-			devlist[*olen].io = (fido_dev_io_t) {
-				fido_hid_open,
-				fido_hid_close,
-				fido_hid_read,
-				fido_hid_write,
-			};
+		if (copy_info(&devlist[*olen], path, probe_hidraw) == 0)
 			++(*olen);
-		}
 	}
 	/* hidraw(4) is preferred over uhid(4) */
 	if (*olen != 0)
@@ -190,20 +303,143 @@ fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 
 	for (i = 0; i < MAX_UHID && *olen < ilen; i++) {
 		snprintf(path, sizeof(path), "/dev/uhid%zu", i);
-		if (copy_info_uhid(&devlist[*olen], path) == 0) {
-			devlist[*olen].io = (fido_dev_io_t) {
-				fido_hid_open,
-				fido_hid_close,
-				fido_hid_read,
-				fido_hid_write,
-			};
+		if (copy_info(&devlist[*olen], path, probe_uhid) == 0)
 			++(*olen);
-		}
 	}
 
 	return (FIDO_OK);
 }
 
+void *
+fido_hid_monitor_open(void)
+{
+	struct hid_freebsd_monitor	*ctx;
+	struct sockaddr_un		 sun;
+
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL)
+		return (NULL);
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strlcpy(sun.sun_path, DEVD_PIPE, sizeof(sun.sun_path));
+
+	if ((ctx->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC |
+	    SOCK_NONBLOCK, 0)) == -1 ||
+	    connect(ctx->fd, (struct sockaddr *)&sun, sizeof(sun)) == -1) {
+		fido_log_error(errno, "%s: %s", __func__, DEVD_PIPE);
+		fido_hid_monitor_close(ctx);
+		return (NULL);
+	}
+
+	return (ctx);
+}
+
+void
+fido_hid_monitor_close(void *handle)
+{
+	struct hid_freebsd_monitor *ctx = handle;
+
+	if (ctx->fd != -1 && close(ctx->fd) == -1)
+		fido_log_error(errno, "%s: close", __func__);
+
+	fido_free(ctx);
+}
+
+int
+fido_hid_monitor_fd(void *handle)
+{
+	struct hid_freebsd_monitor *ctx = handle;
+
+	return (ctx->fd);
+}
+
+/*
+ * Parse a devd(8) notification of the form "!system=DEVFS subsystem=CDEV
+ * type=CREATE cdev=hidraw0". Returns the probe function for the node, or
+ * NULL if the notification is not about a hidraw(4) or uhid(4) node.
+ */
+static hid_probe_t *
+devd_parse(char *msg, bool *create, char *path, size_t len)
+{
+	hid_probe_t	*probe;
+	char		*cdev;
+	char		*p;
+
+	if (strncmp(msg, "!system=DEVFS ", 14) != 0 ||
+	    strstr(msg, " subsystem=CDEV ") == NULL ||
+	    (cdev = strstr(msg, " cdev=")) == NULL)
+		return (NULL);
+	if (strstr(msg, " type=CREATE") != NULL)
+		*create = true;
+	else if (strstr(msg, " type=DESTROY") != NULL)
+		*create = false;
+	else
+		return (NULL);
+
+	cdev += strlen(" cdev=");
+	if ((p = strpbrk(cdev, " \n")) != NULL)
+		*p = '\0';
+	if (strncmp(cdev, "uhid", 4) == 0)
+		probe = probe_uhid;
+#ifdef USE_HIDRAW
+	else if (strncmp(cdev, "hidraw", 6) == 0)
+		probe = probe_hidraw;
+#endif
+	else
+		return (NULL);
+
+	if (snprintf(path, len, "/dev/%s", cdev) >= (int)len)
+		return (NULL);
+
+	return (probe);
+}
+
+/*
+ * Returns 1 and fills di with the next pending add or remove event, 0 if
+ * no event is pending, or -1 on error. The monitor socket is non-blocking.
+ * For removals, only the path of di is set.
+ */
+int
+fido_hid_monitor_read(void *handle, int *event, fido_dev_info_t *di)
+{
+	struct hid_freebsd_monitor	*ctx = handle;
+	hid_probe_t			*probe;
+	char				 msg[1024];
+	char				 path[64];
+	bool				 create;
+	ssize_t				 n;
+
+	memset(di, 0, sizeof(*di));
+
+	while ((n = recv(ctx->fd, msg, sizeof(msg) - 1, 0)) > 0) {
+		msg[n] = '\0';
+		if ((probe = devd_parse(msg, &create, path,
+		    sizeof(path))) == NULL)
+			continue;
+		if (!create) {
+			if ((di->path = fido_strdup(path)) == NULL)
+				return (-1);
+			*event = FIDO_DEV_MONITOR_REMOVE;
+			return (1);
+		}
+		if (copy_info(di, path, probe) == 0) {
+			*event = FIDO_DEV_MONITOR_ADD;
+			return (1);
+		}
+	}
+
+	if (n == 0) {
+		fido_log_debug("%s: devd closed the connection", __func__);
+		return (-1);
+	}
+	if (errno != EAGAIN && errno != EWOULDBLOCK) {
+		fido_log_error(errno, "%s: recv", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
 void *
 fido_hid_open(const char *path)
 {
@@ -215,11 +451,11 @@ fido_hid_open(const char *path)
 	memset(&buf, 0, sizeof(buf));
 	memset(&ugd, 0, sizeof(ugd));
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL)
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL)
 		return (NULL);
 
 	if ((ctx->fd = fido_hid_unix_open(path)) == -1) {
-		free(ctx);
+		fido_free(ctx);
 		return (NULL);
 	}
 
@@ -238,8 +474,8 @@ fido_hid_open(const char *path)
 		if (r == -1)
 			fido_log_error(errno, "%s: ioctl", __func__);
 		fido_log_debug("%s: using default report sizes", __func__);
-		ctx->report_in_len = CTAP_MAX_REPORT_LEN;
-		ctx->report_out_len = CTAP_MAX_REPORT_LEN;
+		ctx->report_in_len = CTAP_DEF_REPORT_LEN;
+		ctx->report_out_len = CTAP_DEF_REPORT_LEN;
 	}
 
 	return (ctx);
@@ -253,7 +489,7 @@ fido_hid_close(void *handle)
 	if (close(ctx->fd) == -1)
 		fido_log_error(errno, "%s: close", __func__);
 
-	free(ctx);
+	fido_free(ctx);
 }
 
 int
@@ -335,3 +571,11 @@ fido_hid_report_out_len(void *handle)
 
 	return (ctx->report_out_len);
 }
+
+int
+fido_hid_fd(void *handle)
+{
+	struct hid_freebsd *ctx = handle;
+
+	return (ctx->fd);
+}
@@ -12,16 +12,40 @@
 #include <fcntl.h>
 #endif
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#define HIDAPI_READER
+#endif
+
 #include <errno.h>
 #include <hidapi.h>
 #include <wchar.h>
 
 #include "fido.h"
 
+/*
+ * Where the platform has pipes, each handle has a reader thread that
+ * moves input reports from hidapi into a pipe as they arrive. Readers
+ * wait on the pipe, which is also the handle's pollable descriptor; a
+ * removed device closes the pipe's write end. The thread wakes every
+ * HIDAPI_READER_MS to notice the handle being closed.
+ */
+#define HIDAPI_READER_MS	100
+
 struct hid_hidapi {
 	void *handle;
 	size_t report_in_len;
 	size_t report_out_len;
+#ifdef HIDAPI_READER
+	pthread_t thread;
+	pthread_mutex_t mtx;
+	bool stop;
+	int report_pipe[2];
+#endif
 };
 
 static size_t
@@ -39,14 +63,14 @@ wcs_to_cs(const wchar_t *wcs)
 	char *cs;
 	size_t i;
 
-	if (wcs == NULL || (cs = calloc(fido_wcslen(wcs) + 1, 1)) == NULL)
+	if (wcs == NULL || (cs = fido_calloc(fido_wcslen(wcs) + 1, 1)) == NULL)
 		return NULL;
 
 	for (i = 0; i < fido_wcslen(wcs); i++) {
 		if (wcs[i] >= 128) {
 			/* give up on parsing non-ASCII text */
-			free(cs);
-			return strdup("hidapi device");
+			fido_free(cs);
+			return fido_strdup("hidapi device");
 		}
 		cs[i] = (char)wcs[i];
 	}
@@ -60,26 +84,31 @@ copy_info(fido_dev_info_t *di, const struct hid_device_info *d)
 	memset(di, 0, sizeof(*di));
 
 	if (d->path != NULL)
-		di->path = strdup(d->path);
+		di->path = fido_strdup(d->path);
 	else
-		di->path = strdup("");
+		di->path = fido_strdup("");
 
 	if (d->manufacturer_string != NULL)
 		di->manufacturer = wcs_to_cs(d->manufacturer_string);
 	else
-		di->manufacturer = strdup("");
+		di->manufacturer = fido_strdup("");
 
 	if (d->product_string != NULL)
 		di->product = wcs_to_cs(d->product_string);
 	else
-		di->product = strdup("");
+		di->product = fido_strdup("");
+
+	/* optional */
+	if (d->serial_number != NULL && *d->serial_number != L'\0')
+		di->serial = wcs_to_cs(d->serial_number);
 
 	if (di->path == NULL ||
 	    di->manufacturer == NULL ||
 	    di->product == NULL) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
+		fido_free(di->path);
+		fido_free(di->manufacturer);
+		fido_free(di->product);
+		fido_free(di->serial);
 		explicit_bzero(di, sizeof(*di));
 		return -1;
 	}
@@ -136,12 +165,12 @@ is_fido(const struct hid_device_info *hdi)
 	uint32_t usage_page = 0;
 	struct hidraw_report_descriptor *hrd;
 
-	if ((hrd = calloc(1, sizeof(*hrd))) == NULL ||
+	if ((hrd = fido_calloc(1, sizeof(*hrd))) == NULL ||
 	    get_report_descriptor(hdi->path, hrd) < 0 ||
 	    fido_hid_get_usage(hrd->value, hrd->size, &usage_page) < 0)
 		usage_page = 0;
 
-	free(hrd);
+	fido_free(hrd);
 
 	return usage_page == 0xf1d0;
 }
@@ -161,21 +190,153 @@ is_fido(const struct hid_device_info *hdi)
 }
 #endif
 
+#ifdef HIDAPI_READER
+static int
+set_nonblock(int fd)
+{
+	int flags;
+
+	if ((flags = fcntl(fd, F_GETFL)) == -1) {
+		fido_log_error(errno, "%s: fcntl F_GETFL", __func__);
+		return -1;
+	}
+
+	if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		fido_log_error(errno, "%s: fcntl F_SETFL", __func__);
+		return -1;
+	}
+
+	return 0;
+}
+
+static bool
+reader_stopped(struct hid_hidapi *ctx)
+{
+	bool stop;
+
+	pthread_mutex_lock(&ctx->mtx);
+	stop = ctx->stop;
+	pthread_mutex_unlock(&ctx->mtx);
+
+	return stop;
+}
+
+static void *
+reader_main(void *arg)
+{
+	struct hid_hidapi *ctx = arg;
+	unsigned char buf[CTAP_MAX_REPORT_LEN];
+	ssize_t r;
+	int n;
+
+	while (!reader_stopped(ctx)) {
+		if ((n = hid_read_timeout(ctx->handle, buf, ctx->report_in_len,
+		    HIDAPI_READER_MS)) == 0)
+			continue;
+		if (n < 0) {
+			fido_log_debug("%s: hid_read_timeout", __func__);
+			break;
+		}
+		if ((size_t)n != ctx->report_in_len) {
+			fido_log_debug("%s: %d != %zu", __func__, n,
+			    ctx->report_in_len);
+			continue;
+		}
+		/* a full pipe drops the report, as a full hidraw queue would */
+		if ((r = write(ctx->report_pipe[1], buf, (size_t)n)) == -1)
+			fido_log_error(errno, "%s: write", __func__);
+		else if (r != n)
+			fido_log_debug("%s: %zd != %d", __func__, r, n);
+	}
+
+	explicit_bzero(buf, sizeof(buf));
+	/* readers of a removed device see the end of its pipe */
+	close(ctx->report_pipe[1]);
+	ctx->report_pipe[1] = -1;
+
+	return NULL;
+}
+
+static int
+reader_start(struct hid_hidapi *ctx)
+{
+	sigset_t all, old;
+	int r;
+
+	if (pipe(ctx->report_pipe) == -1) {
+		fido_log_error(errno, "%s: pipe", __func__);
+		ctx->report_pipe[0] = ctx->report_pipe[1] = -1;
+		return -1;
+	}
+
+	if (set_nonblock(ctx->report_pipe[0]) < 0 ||
+	    set_nonblock(ctx->report_pipe[1]) < 0 ||
+	    (r = pthread_mutex_init(&ctx->mtx, NULL)) != 0) {
+		fido_log_debug("%s: init", __func__);
+		goto fail;
+	}
+
+	/* the thread inherits a mask blocking every signal, SIGPIPE included */
+	sigfillset(&all);
+	if ((r = pthread_sigmask(SIG_SETMASK, &all, &old)) != 0) {
+		fido_log_error(r, "%s: pthread_sigmask", __func__);
+		pthread_mutex_destroy(&ctx->mtx);
+		goto fail;
+	}
+	r = pthread_create(&ctx->thread, NULL, reader_main, ctx);
+	(void)pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (r != 0) {
+		fido_log_error(r, "%s: pthread_create", __func__);
+		pthread_mutex_destroy(&ctx->mtx);
+		goto fail;
+	}
+
+	return 0;
+fail:
+	close(ctx->report_pipe[0]);
+	close(ctx->report_pipe[1]);
+	ctx->report_pipe[0] = ctx->report_pipe[1] = -1;
+
+	return -1;
+}
+
+static void
+reader_stop(struct hid_hidapi *ctx)
+{
+	pthread_mutex_lock(&ctx->mtx);
+	ctx->stop = true;
+	pthread_mutex_unlock(&ctx->mtx);
+
+	pthread_join(ctx->thread, NULL);
+	pthread_mutex_destroy(&ctx->mtx);
+	close(ctx->report_pipe[0]);
+}
+#endif /* HIDAPI_READER */
+
 void *
 fido_hid_open(const char *path)
 {
 	struct hid_hidapi *ctx;
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL) {
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL) {
 		return (NULL);
 	}
 
 	if ((ctx->handle = hid_open_path(path)) == NULL) {
-		free(ctx);
+		fido_free(ctx);
 		return (NULL);
 	}
 
-	ctx->report_in_len = ctx->report_out_len = CTAP_MAX_REPORT_LEN;
+	ctx->report_in_len = ctx->report_out_len = CTAP_DEF_REPORT_LEN;
+
+#ifdef HIDAPI_READER
+	if (reader_start(ctx) < 0) {
+		fido_log_debug("%s: reader_start", __func__);
+		hid_close(ctx->handle);
+		fido_free(ctx);
+		return (NULL);
+	}
+#endif
 
 	return ctx;
 }
@@ -185,8 +346,11 @@ fido_hid_close(void *handle)
 {
 	struct hid_hidapi *ctx = handle;
 
+#ifdef HIDAPI_READER
+	reader_stop(ctx);
+#endif
 	hid_close(ctx->handle);
-	free(ctx);
+	fido_free(ctx);
 }
 
 int
@@ -198,6 +362,44 @@ fido_hid_set_sigmask(void *handle, const fido_sigset_t *sigmask)
 	return (FIDO_ERR_INTERNAL);
 }
 
+#ifdef HIDAPI_READER
+int
+fido_hid_read(void *handle, unsigned char *buf, size_t len, int ms)
+{
+	struct hid_hidapi *ctx = handle;
+	struct pollfd pfd;
+	ssize_t r;
+	int n;
+
+	if (len != ctx->report_in_len) {
+		fido_log_debug("%s: len %zu", __func__, len);
+		return -1;
+	}
+
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = ctx->report_pipe[0];
+	pfd.events = POLLIN;
+
+	if ((n = poll(&pfd, 1, ms)) < 1) {
+		if (n == -1)
+			fido_log_error(errno, "%s: poll", __func__);
+		return -1;
+	}
+
+	/* reports are written whole, and read likewise */
+	if ((r = read(ctx->report_pipe[0], buf, len)) == -1) {
+		fido_log_error(errno, "%s: read", __func__);
+		return -1;
+	}
+
+	if (r < 0 || (size_t)r != len) {
+		fido_log_debug("%s: %zd != %zu", __func__, r, len);
+		return -1;
+	}
+
+	return (int)len;
+}
+#else
 int
 fido_hid_read(void *handle, unsigned char *buf, size_t len, int ms)
 {
@@ -210,6 +412,7 @@ fido_hid_read(void *handle, unsigned char *buf, size_t len, int ms)
 
 	return hid_read_timeout(ctx->handle, buf, len, ms);
 }
+#endif
 
 int
 fido_hid_write(void *handle, const unsigned char *buf, size_t len)
@@ -267,3 +470,17 @@ fido_hid_report_out_len(void *handle)
 
 	return (ctx->report_out_len);
 }
+
+int
+fido_hid_fd(void *handle)
+{
+#ifdef HIDAPI_READER
+	struct hid_hidapi *ctx = handle;
+
+	return (ctx->report_pipe[0]);
+#else
+	(void)handle;
+
+	return (-1);
+#endif
+}
@@ -8,23 +8,65 @@
 #include <sys/types.h>
 #include <sys/file.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 
 #include <linux/hidraw.h>
 #include <linux/input.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <libudev.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "fido.h"
+#include "dlopen.h"
 
+#ifndef TLS
+#define TLS
+#endif
+
+#define HID_CLASS_CACHE_LEN	32
+#define HID_QUEUE_LEN		32	/* reports read ahead per device */
+#define HID_CLASS_PATH_MAX	64
+
+/*
+ * Report descriptor classification of hidraw nodes, remembered across
+ * enumerations. A node is identified by its path, device number, inode,
+ * and change time, so that a recreated or re-permissioned node is
+ * classified again.
+ */
+struct hid_class {
+	char		path[HID_CLASS_PATH_MAX];
+	dev_t		rdev;
+	ino_t		ino;
+	struct timespec	ctime;
+	bool		fido;
+};
+
+static TLS struct hid_class hid_class_tab[HID_CLASS_CACHE_LEN];
+static TLS size_t hid_class_next;
+
+/*
+ * Once the hidraw node is readable, every report immediately available
+ * is read into a queue, without blocking, so that the frames of a long
+ * reply are handed out without a poll for each.
+ */
 struct hid_linux {
 	int             fd;
 	size_t          report_in_len;
 	size_t          report_out_len;
 	sigset_t        sigmask;
 	const sigset_t *sigmaskp;
+	unsigned char  *queue;      /* HID_QUEUE_LEN reports */
+	size_t          queue_head;
+	size_t          queue_len;
+	bool            queue_err;  /* a read failed after queue_len reports */
+};
+
+struct hid_linux_monitor {
+	struct udev         *udev;
+	struct udev_monitor *mon;
 };
 
 static int
@@ -52,43 +94,110 @@ get_report_descriptor(int fd, struct hidraw_report_descriptor *hrd)
 	return (0);
 }
 
-static bool
-is_fido(const char *path)
+/* returns -1 if the node could not be opened */
+static int
+probe_fido(const char *path)
 {
 	int				 fd = -1;
+	int				 ok = -1;
 	uint32_t			 usage_page = 0;
 	struct hidraw_report_descriptor	*hrd = NULL;
 
-	if ((hrd = calloc(1, sizeof(*hrd))) == NULL ||
+	if ((hrd = fido_calloc(1, sizeof(*hrd))) == NULL ||
 	    (fd = fido_hid_unix_open(path)) == -1)
 		goto out;
 	if (get_report_descriptor(fd, hrd) < 0 ||
 	    fido_hid_get_usage(hrd->value, hrd->size, &usage_page) < 0)
 		usage_page = 0;
 
+	ok = usage_page == 0xf1d0;
 out:
-	free(hrd);
+	fido_free(hrd);
 
 	if (fd != -1 && close(fd) == -1)
 		fido_log_error(errno, "%s: close", __func__);
 
-	return (usage_page == 0xf1d0);
+	return (ok);
+}
+
+static struct hid_class *
+hid_class_lookup(const char *path, const struct stat *st)
+{
+	for (size_t i = 0; i < HID_CLASS_CACHE_LEN; i++) {
+		struct hid_class *c = &hid_class_tab[i];
+		if (c->path[0] != '\0' && strcmp(c->path, path) == 0 &&
+		    c->rdev == st->st_rdev && c->ino == st->st_ino &&
+		    c->ctime.tv_sec == st->st_ctim.tv_sec &&
+		    c->ctime.tv_nsec == st->st_ctim.tv_nsec)
+			return (c);
+	}
+
+	return (NULL);
+}
+
+static void
+hid_class_store(const char *path, const struct stat *st, bool fido)
+{
+	struct hid_class	*c = NULL;
+	size_t			 len;
+
+	if ((len = strlen(path)) >= HID_CLASS_PATH_MAX)
+		return;
+
+	/* replace a stale entry for the same path, if any */
+	for (size_t i = 0; i < HID_CLASS_CACHE_LEN; i++)
+		if (strcmp(hid_class_tab[i].path, path) == 0) {
+			c = &hid_class_tab[i];
+			break;
+		}
+	if (c == NULL) {
+		c = &hid_class_tab[hid_class_next];
+		hid_class_next = (hid_class_next + 1) % HID_CLASS_CACHE_LEN;
+	}
+
+	memset(c, 0, sizeof(*c));
+	memcpy(c->path, path, len);
+	c->rdev = st->st_rdev;
+	c->ino = st->st_ino;
+	c->ctime = st->st_ctim;
+	c->fido = fido;
+}
+
+static bool
+is_fido(const char *path)
+{
+	const struct hid_class	*c;
+	struct stat		 st;
+	bool			 cacheable;
+	int			 ok;
+
+	if ((cacheable = stat(path, &st) == 0) &&
+	    (c = hid_class_lookup(path, &st)) != NULL)
+		return (c->fido);
+
+	if ((ok = probe_fido(path)) < 0)
+		return (false); /* do not remember transient failures */
+	if (cacheable)
+		hid_class_store(path, &st, ok == 1);
+
+	return (ok == 1);
 }
 
 static int
 parse_uevent(const char *uevent, int *bus, int16_t *vendor_id,
-    int16_t *product_id, char **hid_name)
+    int16_t *product_id, char **hid_name, char **hid_uniq)
 {
 	char			*cp;
 	char			*p;
 	char			*s;
 	bool			 found_id = false;
 	bool			 found_name = false;
+	bool			 found_uniq = false;
 	short unsigned int	 x;
 	short unsigned int	 y;
 	short unsigned int	 z;
 
-	if ((s = cp = strdup(uevent)) == NULL)
+	if ((s = cp = fido_strdup(uevent)) == NULL)
 		return (-1);
 
 	while ((p = strsep(&cp, "\n")) != NULL && *p != '\0') {
@@ -100,12 +209,17 @@ parse_uevent(const char *uevent, int *bus, int16_t *vendor_id,
 				found_id = true;
 			}
 		} else if (!found_name && strncmp(p, "HID_NAME=", 9) == 0) {
-			if ((*hid_name = strdup(p + 9)) != NULL)
+			if ((*hid_name = fido_strdup(p + 9)) != NULL)
 				found_name = true;
+		} else if (!found_uniq && strncmp(p, "HID_UNIQ=", 9) == 0) {
+			/* optional */
+			if (p[9] != '\0')
+				*hid_uniq = fido_strdup(p + 9);
+			found_uniq = true;
 		}
 	}
 
-	free(s);
+	fido_free(s);
 
 	if (!found_name || !found_id)
 		return (-1);
@@ -125,7 +239,7 @@ get_parent_attr(struct udev_device *dev, const char *subsystem,
 	    udev_device_get_sysattr_value(parent, attr)) == NULL)
 		return (NULL);
 
-	return (strdup(value));
+	return (fido_strdup(value));
 }
 
 static char *
@@ -135,28 +249,24 @@ get_usb_attr(struct udev_device *dev, const char *attr)
 }
 
 static int
-copy_info(fido_dev_info_t *di, struct udev *udev,
-    struct udev_list_entry *udev_entry)
+copy_info_dev(fido_dev_info_t *di, struct udev_device *dev)
 {
-	const char		*name;
 	const char		*path;
 	char			*uevent = NULL;
-	struct udev_device	*dev = NULL;
 	int			 bus = 0;
 	char			*hid_name = NULL;
+	char			*hid_uniq = NULL;
 	int			 ok = -1;
 
 	memset(di, 0, sizeof(*di));
 
-	if ((name = udev_list_entry_get_name(udev_entry)) == NULL ||
-	    (dev = udev_device_new_from_syspath(udev, name)) == NULL ||
-	    (path = udev_device_get_devnode(dev)) == NULL ||
+	if ((path = udev_device_get_devnode(dev)) == NULL ||
 	    is_fido(path) == 0)
 		goto fail;
 
 	if ((uevent = get_parent_attr(dev, "hid", NULL, "uevent")) == NULL ||
 	    parse_uevent(uevent, &bus, &di->vendor_id, &di->product_id,
-	    &hid_name) < 0) {
+	    &hid_name, &hid_uniq) < 0) {
 		fido_log_debug("%s: uevent", __func__);
 		goto fail;
 	}
@@ -168,7 +278,7 @@ copy_info(fido_dev_info_t *di, struct udev *udev,
 	}
 #endif
 
-	di->path = strdup(path);
+	di->path = fido_strdup(path);
 	di->manufacturer = get_usb_attr(dev, "manufacturer");
 	di->product = get_usb_attr(dev, "product");
 
@@ -177,30 +287,53 @@ copy_info(fido_dev_info_t *di, struct udev *udev,
 		hid_name = NULL;
 	}
 	if (di->manufacturer == NULL)
-		di->manufacturer = strdup("");
+		di->manufacturer = fido_strdup("");
 	if (di->product == NULL)
-		di->product = strdup("");
+		di->product = fido_strdup("");
 	if (di->path == NULL || di->manufacturer == NULL || di->product == NULL)
 		goto fail;
 
+	/* optional; the usb serial number, or else the hid uniq string */
+	if ((di->serial = get_usb_attr(dev, "serial")) == NULL) {
+		di->serial = hid_uniq;
+		hid_uniq = NULL;
+	}
+
 	ok = 0;
 fail:
-	if (dev != NULL)
-		udev_device_unref(dev);
-
-	free(uevent);
-	free(hid_name);
+	fido_free(uevent);
+	fido_free(hid_name);
+	fido_free(hid_uniq);
 
 	if (ok < 0) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
+		fido_free(di->path);
+		fido_free(di->manufacturer);
+		fido_free(di->product);
+		fido_free(di->serial);
 		explicit_bzero(di, sizeof(*di));
 	}
 
 	return (ok);
 }
 
+static int
+copy_info(fido_dev_info_t *di, struct udev *udev,
+    struct udev_list_entry *udev_entry)
+{
+	const char		*name;
+	struct udev_device	*dev;
+	int			 ok;
+
+	if ((name = udev_list_entry_get_name(udev_entry)) == NULL ||
+	    (dev = udev_device_new_from_syspath(udev, name)) == NULL)
+		return (-1);
+
+	ok = copy_info_dev(di, dev);
+	udev_device_unref(dev);
+
+	return (ok);
+}
+
 int
 fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 {
@@ -254,6 +387,98 @@ fail:
 	return (r);
 }
 
+void *
+fido_hid_monitor_open(void)
+{
+	struct hid_linux_monitor *ctx;
+
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL)
+		return (NULL);
+
+	if ((ctx->udev = udev_new()) == NULL ||
+	    (ctx->mon = udev_monitor_new_from_netlink(ctx->udev,
+	    "udev")) == NULL ||
+	    udev_monitor_filter_add_match_subsystem_devtype(ctx->mon,
+	    "hidraw", NULL) < 0 ||
+	    udev_monitor_enable_receiving(ctx->mon) < 0) {
+		fido_log_debug("%s: udev_monitor", __func__);
+		fido_hid_monitor_close(ctx);
+		return (NULL);
+	}
+
+	return (ctx);
+}
+
+void
+fido_hid_monitor_close(void *handle)
+{
+	struct hid_linux_monitor *ctx = handle;
+
+	if (ctx->mon != NULL)
+		udev_monitor_unref(ctx->mon);
+	if (ctx->udev != NULL)
+		udev_unref(ctx->udev);
+
+	fido_free(ctx);
+}
+
+int
+fido_hid_monitor_fd(void *handle)
+{
+	struct hid_linux_monitor *ctx = handle;
+
+	return (udev_monitor_get_fd(ctx->mon));
+}
+
+/*
+ * Returns 1 and fills di with the next pending add or remove event, 0 if
+ * no event is pending, or -1 on error. The monitor socket is non-blocking.
+ * For removals, only the path of di is set.
+ */
+int
+fido_hid_monitor_read(void *handle, int *event, fido_dev_info_t *di)
+{
+	struct hid_linux_monitor	*ctx = handle;
+	struct udev_device		*dev;
+	const char			*action;
+	const char			*path;
+	int				 r;
+
+	memset(di, 0, sizeof(*di));
+
+	while ((dev = udev_monitor_receive_device(ctx->mon)) != NULL) {
+		r = 0;
+		if ((action = udev_device_get_action(dev)) == NULL ||
+		    (path = udev_device_get_devnode(dev)) == NULL)
+			goto next;
+		if (strcmp(action, "add") == 0) {
+			if (copy_info_dev(di, dev) == 0) {
+				di->io = (fido_dev_io_t) {
+					fido_hid_open,
+					fido_hid_close,
+					fido_hid_read,
+					fido_hid_write,
+				};
+				*event = FIDO_DEV_MONITOR_ADD;
+				r = 1;
+			}
+		} else if (strcmp(action, "remove") == 0) {
+			if ((di->path = fido_strdup(path)) == NULL)
+				r = -1;
+			else {
+				*event = FIDO_DEV_MONITOR_REMOVE;
+				r = 1;
+			}
+		}
+next:
+		udev_device_unref(dev);
+		if (r != 0)
+			return (r);
+	}
+
+	return (0);
+}
+
 void *
 fido_hid_open(const char *path)
 {
@@ -262,13 +487,14 @@ fido_hid_open(const char *path)
 	struct timespec tv_pause;
 	long interval_ms, retries = 0;
 	bool looped;
+	int flags;
 
 retry:
 	looped = false;
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL ||
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL ||
 	    (ctx->fd = fido_hid_unix_open(path)) == -1) {
-		free(ctx);
+		fido_free(ctx);
 		return (NULL);
 	}
 
@@ -300,17 +526,32 @@ retry:
 		goto retry;
 	}
 
-	if ((hrd = calloc(1, sizeof(*hrd))) == NULL ||
+	if ((hrd = fido_calloc(1, sizeof(*hrd))) == NULL ||
 	    get_report_descriptor(ctx->fd, hrd) < 0 ||
 	    fido_hid_get_report_len(hrd->value, hrd->size, &ctx->report_in_len,
 	    &ctx->report_out_len) < 0 || ctx->report_in_len == 0 ||
 	    ctx->report_out_len == 0) {
 		fido_log_debug("%s: using default report sizes", __func__);
-		ctx->report_in_len = CTAP_MAX_REPORT_LEN;
-		ctx->report_out_len = CTAP_MAX_REPORT_LEN;
+		ctx->report_in_len = CTAP_DEF_REPORT_LEN;
+		ctx->report_out_len = CTAP_DEF_REPORT_LEN;
 	}
 
-	free(hrd);
+	fido_free(hrd);
+
+	if ((ctx->queue = fido_calloc(HID_QUEUE_LEN,
+	    ctx->report_in_len)) == NULL) {
+		fido_log_debug("%s: calloc", __func__);
+		fido_hid_close(ctx);
+		return (NULL);
+	}
+
+	/* reads past the first of a batch must not block */
+	if ((flags = fcntl(ctx->fd, F_GETFL)) == -1 ||
+	    fcntl(ctx->fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		fido_log_error(errno, "%s: fcntl", __func__);
+		fido_hid_close(ctx);
+		return (NULL);
+	}
 
 	return (ctx);
 }
@@ -323,7 +564,8 @@ fido_hid_close(void *handle)
 	if (close(ctx->fd) == -1)
 		fido_log_error(errno, "%s: close", __func__);
 
-	free(ctx);
+	fido_freezero(ctx->queue, HID_QUEUE_LEN * ctx->report_in_len);
+	fido_free(ctx);
 }
 
 int
@@ -337,33 +579,68 @@ fido_hid_set_sigmask(void *handle, const fido_sigset_t *sigmask)
 	return (FIDO_OK);
 }
 
+/* read every report immediately available into the empty queue */
+static int
+hid_drain(struct hid_linux *ctx)
+{
+	unsigned char	*p;
+	ssize_t		 r;
+
+	ctx->queue_head = 0;
+
+	while (ctx->queue_len < HID_QUEUE_LEN) {
+		p = ctx->queue + ctx->queue_len * ctx->report_in_len;
+		if ((r = read(ctx->fd, p, ctx->report_in_len)) == -1) {
+			if (ctx->queue_len > 0 && (errno == EAGAIN ||
+			    errno == EWOULDBLOCK))
+				break;
+			fido_log_error(errno, "%s: read", __func__);
+			ctx->queue_err = ctx->queue_len > 0;
+			return (ctx->queue_err ? 0 : -1);
+		}
+		if (r < 0 || (size_t)r != ctx->report_in_len) {
+			fido_log_debug("%s: %zd != %zu", __func__, r,
+			    ctx->report_in_len);
+			ctx->queue_err = ctx->queue_len > 0;
+			return (ctx->queue_err ? 0 : -1);
+		}
+		ctx->queue_len++;
+	}
+
+	return (0);
+}
+
 int
 fido_hid_read(void *handle, unsigned char *buf, size_t len, int ms)
 {
 	struct hid_linux	*ctx = handle;
-	ssize_t			 r;
+	unsigned char		*p;
 
 	if (len != ctx->report_in_len) {
 		fido_log_debug("%s: len %zu", __func__, len);
 		return (-1);
 	}
 
-	if (fido_hid_unix_wait(ctx->fd, ms, ctx->sigmaskp) < 0) {
-		fido_log_debug("%s: fd not ready", __func__);
-		return (-1);
-	}
-
-	if ((r = read(ctx->fd, buf, len)) == -1) {
-		fido_log_error(errno, "%s: read", __func__);
-		return (-1);
+	if (ctx->queue_len == 0) {
+		if (ctx->queue_err) {
+			ctx->queue_err = false;
+			return (-1);
+		}
+		if (fido_hid_unix_wait(ctx->fd, ms, ctx->sigmaskp) < 0) {
+			fido_log_debug("%s: fd not ready", __func__);
+			return (-1);
+		}
+		if (hid_drain(ctx) < 0)
+			return (-1);
 	}
 
-	if (r < 0 || (size_t)r != len) {
-		fido_log_debug("%s: %zd != %zu", __func__, r, len);
-		return (-1);
-	}
+	p = ctx->queue + ctx->queue_head * len;
+	memcpy(buf, p, len);
+	explicit_bzero(p, len);
+	ctx->queue_head++;
+	ctx->queue_len--;
 
-	return ((int)r);
+	return ((int)len);
 }
 
 int
@@ -405,3 +682,20 @@ fido_hid_report_out_len(void *handle)
 
 	return (ctx->report_out_len);
 }
+
+int
+fido_hid_fd(void *handle)
+{
+	struct hid_linux *ctx = handle;
+
+	return (ctx->fd);
+}
+
+/* whether reports were read ahead of the descriptor */
+bool
+fido_hid_buffered(void *handle)
+{
+	struct hid_linux *ctx = handle;
+
+	return (ctx->queue_len > 0 || ctx->queue_err);
+}
@@ -23,6 +23,7 @@
 #include "fido.h"
 
 #define MAX_UHID	64
+#define RESYNC_MS	100
 
 struct hid_netbsd {
 	int             fd;
@@ -30,6 +31,9 @@ struct hid_netbsd {
 	size_t          report_out_len;
 	sigset_t        sigmask;
 	const sigset_t *sigmaskp;
+	bool            resync; /* nothing answered since open */
+	unsigned char   init[CTAP_MAX_REPORT_LEN + 1]; /* see fido_hid_write */
+	size_t          init_len;
 };
 
 /* Hack to make this work with newer kernels even if /usr/include is old.  */
@@ -98,9 +102,11 @@ copy_info(fido_dev_info_t *di, const char *path)
 		goto fail;
 	}
 
-	if ((di->path = strdup(path)) == NULL ||
-	    (di->manufacturer = strdup(udi.udi_vendor)) == NULL ||
-	    (di->product = strdup(udi.udi_product)) == NULL)
+	if ((di->path = fido_strdup(path)) == NULL ||
+	    (di->manufacturer = fido_strdup(udi.udi_vendor)) == NULL ||
+	    (di->product = fido_strdup(udi.udi_product)) == NULL ||
+	    (udi.udi_serial[0] != '\0' &&
+	    (di->serial = fido_strdup(udi.udi_serial)) == NULL))
 		goto fail;
 
 	di->vendor_id = (int16_t)udi.udi_vendorNo;
@@ -112,9 +118,10 @@ fail:
 		fido_log_error(errno, "%s: close", __func__);
 
 	if (ok < 0) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
+		fido_free(di->path);
+		fido_free(di->manufacturer);
+		fido_free(di->product);
+		fido_free(di->serial);
 		explicit_bzero(di, sizeof(*di));
 	}
 
@@ -151,6 +158,57 @@ fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 	return (FIDO_OK);
 }
 
+static int
+hid_read(struct hid_netbsd *ctx, unsigned char *buf, size_t len, int ms)
+{
+	ssize_t r;
+
+	if (len != ctx->report_in_len) {
+		fido_log_debug("%s: len %zu", __func__, len);
+		return (-1);
+	}
+
+	if (fido_hid_unix_wait(ctx->fd, ms, ctx->sigmaskp) < 0) {
+		fido_log_debug("%s: fd not ready", __func__);
+		return (-1);
+	}
+
+	if ((r = read(ctx->fd, buf, len)) == -1) {
+		fido_log_error(errno, "%s: read", __func__);
+		return (-1);
+	}
+
+	if (r < 0 || (size_t)r != len) {
+		fido_log_error(errno, "%s: %zd != %zu", __func__, r, len);
+		return (-1);
+	}
+
+	return ((int)r);
+}
+
+static int
+hid_write(struct hid_netbsd *ctx, const unsigned char *buf, size_t len)
+{
+	ssize_t r;
+
+	if (len != ctx->report_out_len + 1) {
+		fido_log_debug("%s: len %zu", __func__, len);
+		return (-1);
+	}
+
+	if ((r = write(ctx->fd, buf + 1, len - 1)) == -1) {
+		fido_log_error(errno, "%s: write", __func__);
+		return (-1);
+	}
+
+	if (r < 0 || (size_t)r != len - 1) {
+		fido_log_error(errno, "%s: %zd != %zu", __func__, r, len - 1);
+		return (-1);
+	}
+
+	return ((int)len);
+}
+
 /*
  * Workaround for NetBSD (as of 201910) bug that loses
  * sync of DATA0/DATA1 sequence bit across uhid open/close.
@@ -179,7 +237,7 @@ terrible_ping_kludge(struct hid_netbsd *ctx)
 		data[6] = 0;
 		data[7] = 1;
 		fido_log_debug("%s: send ping %d", __func__, i);
-		if (fido_hid_write(ctx, data, ctx->report_out_len + 1) == -1)
+		if (hid_write(ctx, data, ctx->report_out_len + 1) == -1)
 			return -1;
 		fido_log_debug("%s: wait reply", __func__);
 		memset(&pfd, 0, sizeof(pfd));
@@ -192,7 +250,7 @@ terrible_ping_kludge(struct hid_netbsd *ctx)
 			fido_log_debug("%s: timed out", __func__);
 			continue;
 		}
-		if (fido_hid_read(ctx, data, ctx->report_out_len, 250) == -1)
+		if (hid_read(ctx, data, ctx->report_out_len, 250) == -1)
 			return -1;
 		/*
 		 * Ping isn't always supported on the broadcast channel,
@@ -207,6 +265,46 @@ terrible_ping_kludge(struct hid_netbsd *ctx)
 	return -1;
 }
 
+static bool
+is_init(const unsigned char *buf, size_t len)
+{
+	/* report id, broadcast cid, CTAPHID_INIT */
+	return (len > 5 && buf[1] == 0xff && buf[2] == 0xff && buf[3] == 0xff &&
+	    buf[4] == 0xff && buf[5] == (CTAP_FRAME_INIT | CTAP_CMD_INIT));
+}
+
+/*
+ * Wait for the device to answer the CTAPHID_INIT written after open,
+ * resending it in case the first copy was dropped.
+ */
+static int
+resync_init(struct hid_netbsd *ctx, int *ms)
+{
+	struct pollfd pfd;
+	int i, n, wait;
+
+	for (i = 0; i < 3; i++) {
+		wait = *ms > -1 && *ms < RESYNC_MS ? *ms : RESYNC_MS;
+		memset(&pfd, 0, sizeof(pfd));
+		pfd.fd = ctx->fd;
+		pfd.events = POLLIN;
+		if ((n = poll(&pfd, 1, wait)) == -1) {
+			fido_log_error(errno, "%s: poll", __func__);
+			return (-1);
+		} else if (n > 0)
+			break;
+		if (*ms > -1)
+			*ms -= wait;
+		fido_log_debug("%s: resend init %d", __func__, i);
+		if (hid_write(ctx, ctx->init, ctx->init_len) == -1)
+			return (-1);
+	}
+	ctx->resync = false;
+	ctx->init_len = 0;
+
+	return (0);
+}
+
 void *
 fido_hid_open(const char *path)
 {
@@ -216,9 +314,9 @@ fido_hid_open(const char *path)
 
 	memset(&ucrd, 0, sizeof(ucrd));
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL ||
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL ||
 	    (ctx->fd = fido_hid_unix_open(path)) == -1) {
-		free(ctx);
+		fido_free(ctx);
 		return (NULL);
 	}
 
@@ -230,19 +328,21 @@ fido_hid_open(const char *path)
 		if (r == -1)
 			fido_log_error(errno, "%s: ioctl", __func__);
 		fido_log_debug("%s: using default report sizes", __func__);
-		ctx->report_in_len = CTAP_MAX_REPORT_LEN;
-		ctx->report_out_len = CTAP_MAX_REPORT_LEN;
+		ctx->report_in_len = CTAP_DEF_REPORT_LEN;
+		ctx->report_out_len = CTAP_DEF_REPORT_LEN;
+	}
+
+	if (!is_fido(ctx->fd)) {
+		fido_hid_close(ctx);
+		return NULL;
 	}
 
 	/*
 	 * NetBSD has a bug that causes it to lose
 	 * track of the DATA0/DATA1 sequence toggle across uhid device
-	 * open and close. This is a terrible hack to work around it.
+	 * open and close. Deal with it on first write.
 	 */
-	if (!is_fido(ctx->fd) || terrible_ping_kludge(ctx) != 0) {
-		fido_hid_close(ctx);
-		return NULL;
-	}
+	ctx->resync = true;
 
 	return (ctx);
 }
@@ -255,7 +355,7 @@ fido_hid_close(void *handle)
 	if (close(ctx->fd) == -1)
 		fido_log_error(errno, "%s: close", __func__);
 
-	free(ctx);
+	fido_free(ctx);
 }
 
 int
@@ -269,57 +369,45 @@ fido_hid_set_sigmask(void *handle, const fido_sigset_t *sigmask)
 	return (FIDO_OK);
 }
 
+
 int
 fido_hid_read(void *handle, unsigned char *buf, size_t len, int ms)
 {
-	struct hid_netbsd	*ctx = handle;
-	ssize_t			 r;
-
-	if (len != ctx->report_in_len) {
-		fido_log_debug("%s: len %zu", __func__, len);
-		return (-1);
-	}
-
-	if (fido_hid_unix_wait(ctx->fd, ms, ctx->sigmaskp) < 0) {
-		fido_log_debug("%s: fd not ready", __func__);
-		return (-1);
-	}
-
-	if ((r = read(ctx->fd, buf, len)) == -1) {
-		fido_log_error(errno, "%s: read", __func__);
-		return (-1);
-	}
+	struct hid_netbsd *ctx = handle;
 
-	if (r < 0 || (size_t)r != len) {
-		fido_log_error(errno, "%s: %zd != %zu", __func__, r, len);
+	if (ctx->resync && ctx->init_len != 0 && resync_init(ctx, &ms) < 0)
 		return (-1);
-	}
 
-	return ((int)r);
+	return (hid_read(ctx, buf, len, ms));
 }
 
+/*
+ * The first report written after open may be discarded by the device
+ * as a duplicate; see terrible_ping_kludge(). If that report is the
+ * CTAPHID_INIT sent by fido_dev_open(), keep a copy for resync_init()
+ * to resend, which costs nothing when the first copy gets through.
+ * Extra replies carry the broadcast cid and are skipped by the reader
+ * once it has moved to the allocated channel. Any other report is
+ * preceded by the ping kludge.
+ */
 int
 fido_hid_write(void *handle, const unsigned char *buf, size_t len)
 {
-	struct hid_netbsd	*ctx = handle;
-	ssize_t			 r;
-
-	if (len != ctx->report_out_len + 1) {
-		fido_log_debug("%s: len %zu", __func__, len);
-		return (-1);
-	}
-
-	if ((r = write(ctx->fd, buf + 1, len - 1)) == -1) {
-		fido_log_error(errno, "%s: write", __func__);
-		return (-1);
-	}
+	struct hid_netbsd *ctx = handle;
 
-	if (r < 0 || (size_t)r != len - 1) {
-		fido_log_error(errno, "%s: %zd != %zu", __func__, r, len - 1);
-		return (-1);
+	if (ctx->resync) {
+		if (len <= sizeof(ctx->init) && is_init(buf, len)) {
+			memcpy(ctx->init, buf, len);
+			ctx->init_len = len;
+		} else {
+			ctx->resync = false;
+			ctx->init_len = 0;
+			if (terrible_ping_kludge(ctx) != 0)
+				return (-1);
+		}
 	}
 
-	return ((int)len);
+	return (hid_write(ctx, buf, len));
 }
 
 size_t
@@ -337,3 +425,11 @@ fido_hid_report_out_len(void *handle)
 
 	return (ctx->report_out_len);
 }
+
+int
+fido_hid_fd(void *handle)
+{
+	struct hid_netbsd *ctx = handle;
+
+	return (ctx->fd);
+}
@@ -9,6 +9,8 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <unistd.h>
 
@@ -28,13 +30,74 @@
 
 struct hid_osx {
 	IOHIDDeviceRef	ref;
-	CFStringRef	loop_id;
 	int		report_pipe[2];
 	size_t		report_in_len;
 	size_t		report_out_len;
 	unsigned char	report[CTAP_MAX_REPORT_LEN];
 };
 
+/*
+ * Input reports are delivered by a run-loop thread shared by all open
+ * devices, started when the first device is opened and stopped when the
+ * last one is closed. Each device stays scheduled on its run loop while
+ * open, and its reports are written to a pipe, so that fido_hid_read()
+ * is a poll and a read on the pipe, and the read end may be handed to an
+ * application's event loop. Devices are scheduled and unscheduled by the
+ * thread itself, through a run-loop source, so that no callback runs for
+ * a device once fido_hid_close() has unscheduled it.
+ */
+
+enum hid_loop_op {
+	HID_LOOP_NONE,
+	HID_LOOP_SCHEDULE,
+	HID_LOOP_UNSCHEDULE,
+	HID_LOOP_MANAGER,
+};
+
+static struct hid_loop {
+	pthread_mutex_t		 mtx;
+	pthread_cond_t		 cond;
+	pthread_t		 thread;
+	CFRunLoopRef		 loop;     /* NULL if not running */
+	CFRunLoopSourceRef	 src;      /* owned by the thread */
+	bool			 starting;
+	size_t			 ndev;     /* devices scheduled */
+	enum hid_loop_op	 op;       /* pending request */
+	void			*op_arg;   /* device or manager */
+	uint64_t		 op_seq;   /* requests made */
+	uint64_t		 op_done;  /* requests carried out */
+} hid_loop = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * The FIDO devices present, kept by an IOHIDManager matching the FIDO
+ * usage page. The manager is created on first use and stays scheduled on
+ * the run-loop thread for the life of the process, which it keeps alive;
+ * its matching and removal callbacks maintain the list. Enumeration is
+ * then a copy of the list, and fido_hid_open() finds a device's service
+ * in it instead of looking the path up in the I/O Registry. Should the
+ * manager not be set up, devices are enumerated and opened as before.
+ */
+
+struct hid_entry {
+	IOHIDDeviceRef	 ref;     /* the manager's */
+	io_service_t	 service;
+	fido_dev_info_t	 info;
+};
+
+static struct hid_set {
+	pthread_mutex_t	  mtx;
+	bool		  init;    /* set-up attempted */
+	IOHIDManagerRef	  manager; /* NULL if set-up failed */
+	struct hid_entry *entry;
+	size_t		  len;
+	size_t		  cap;
+} hid_set = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+};
+
 static int
 get_int32(IOHIDDeviceRef dev, CFStringRef key, int32_t *v)
 {
@@ -140,14 +203,14 @@ get_str(IOHIDDeviceRef dev, char **manufacturer, char **product)
 	*product = NULL;
 
 	if (get_utf8(dev, CFSTR(kIOHIDManufacturerKey), buf, sizeof(buf)) < 0)
-		*manufacturer = strdup("");
+		*manufacturer = fido_strdup("");
 	else
-		*manufacturer = strdup(buf);
+		*manufacturer = fido_strdup(buf);
 
 	if (get_utf8(dev, CFSTR(kIOHIDProductKey), buf, sizeof(buf)) < 0)
-		*product = strdup("");
+		*product = fido_strdup("");
 	else
-		*product = strdup(buf);
+		*product = fido_strdup(buf);
 
 	if (*manufacturer == NULL || *product == NULL) {
 		fido_log_debug("%s: strdup", __func__);
@@ -157,8 +220,8 @@ get_str(IOHIDDeviceRef dev, char **manufacturer, char **product)
 	ok = 0;
 fail:
 	if (ok < 0) {
-		free(*manufacturer);
-		free(*product);
+		fido_free(*manufacturer);
+		fido_free(*product);
 		*manufacturer = NULL;
 		*product = NULL;
 	}
@@ -166,6 +229,19 @@ fail:
 	return (ok);
 }
 
+/* optional; NULL if absent */
+static char *
+get_serial(IOHIDDeviceRef dev)
+{
+	char	buf[128];
+
+	if (get_utf8(dev, CFSTR(kIOHIDSerialNumberKey), buf, sizeof(buf)) < 0 ||
+	    *buf == '\0')
+		return (NULL);
+
+	return (fido_strdup(buf));
+}
+
 static char *
 get_path(IOHIDDeviceRef dev)
 {
@@ -184,7 +260,8 @@ get_path(IOHIDDeviceRef dev)
 		return (NULL);
 	}
 
-	if (asprintf(&path, "%s%llu", IOREG, (unsigned long long)id) == -1) {
+	if (fido_asprintf(&path, "%s%llu", IOREG,
+	    (unsigned long long)id) == -1) {
 		fido_log_error(errno, "%s: asprintf", __func__);
 		return (NULL);
 	}
@@ -217,6 +294,16 @@ is_fido(IOHIDDeviceRef dev)
 	return (true);
 }
 
+static void
+free_info(fido_dev_info_t *di)
+{
+	fido_free(di->path);
+	fido_free(di->manufacturer);
+	fido_free(di->product);
+	fido_free(di->serial);
+	explicit_bzero(di, sizeof(*di));
+}
+
 static int
 copy_info(fido_dev_info_t *di, IOHIDDeviceRef dev)
 {
@@ -228,18 +315,18 @@ copy_info(fido_dev_info_t *di, IOHIDDeviceRef dev)
 	if (get_id(dev, &di->vendor_id, &di->product_id) < 0 ||
 	    get_str(dev, &di->manufacturer, &di->product) < 0 ||
 	    (di->path = get_path(dev)) == NULL) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
-		explicit_bzero(di, sizeof(*di));
+		free_info(di);
 		return (-1);
 	}
 
+	di->serial = get_serial(dev);
+
 	return (0);
 }
 
-int
-fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
+/* enumerate with a throwaway manager */
+static int
+manifest_scan(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 {
 	IOHIDManagerRef	 manager = NULL;
 	CFSetRef	 devset = NULL;
@@ -248,14 +335,6 @@ fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 	IOHIDDeviceRef	*devs = NULL;
 	int		 r = FIDO_ERR_INTERNAL;
 
-	*olen = 0;
-
-	if (ilen == 0)
-		return (FIDO_OK); /* nothing to do */
-
-	if (devlist == NULL)
-		return (FIDO_ERR_INVALID_ARGUMENT);
-
 	if ((manager = IOHIDManagerCreate(kCFAllocatorDefault,
 	    kIOHIDManagerOptionNone)) == NULL) {
 		fido_log_debug("%s: IOHIDManagerCreate", __func__);
@@ -276,7 +355,7 @@ fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 
 	devcnt = (size_t)n;
 
-	if ((devs = calloc(devcnt, sizeof(*devs))) == NULL) {
+	if ((devs = fido_calloc(devcnt, sizeof(*devs))) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		goto fail;
 	}
@@ -303,7 +382,7 @@ fail:
 	if (devset != NULL)
 		CFRelease(devset);
 
-	free(devs);
+	fido_free(devs);
 
 	return (r);
 }
@@ -323,6 +402,9 @@ report_callback(void *context, IOReturn result, void *dev, IOHIDReportType type,
 		return;
 	}
 
+	if (ctx->report_pipe[1] == -1)
+		return; /* removed */
+
 	if ((r = write(ctx->report_pipe[1], ptr, (size_t)len)) == -1) {
 		fido_log_error(errno, "%s: write", __func__);
 		return;
@@ -334,14 +416,465 @@ report_callback(void *context, IOReturn result, void *dev, IOHIDReportType type,
 	}
 }
 
+/* readers of a removed device see the end of its pipe */
 static void
 removal_callback(void *context, IOReturn result, void *sender)
+{
+	struct hid_osx *ctx = context;
+
+	(void)result;
+	(void)sender;
+
+	if (ctx->report_pipe[1] != -1) {
+		close(ctx->report_pipe[1]);
+		ctx->report_pipe[1] = -1;
+	}
+}
+
+/* the run-loop source: carry out the pending request */
+static void
+hid_loop_perform(void *info)
+{
+	struct hid_osx *ctx;
+
+	(void)info;
+
+	pthread_mutex_lock(&hid_loop.mtx);
+
+	switch (hid_loop.op) {
+	case HID_LOOP_SCHEDULE:
+		ctx = hid_loop.op_arg;
+		IOHIDDeviceScheduleWithRunLoop(ctx->ref, hid_loop.loop,
+		    kCFRunLoopDefaultMode);
+		break;
+	case HID_LOOP_UNSCHEDULE:
+		ctx = hid_loop.op_arg;
+		IOHIDDeviceUnscheduleFromRunLoop(ctx->ref, hid_loop.loop,
+		    kCFRunLoopDefaultMode);
+		break;
+	case HID_LOOP_MANAGER:
+		IOHIDManagerScheduleWithRunLoop(hid_loop.op_arg,
+		    hid_loop.loop, kCFRunLoopDefaultMode);
+		break;
+	default:
+		break;
+	}
+
+	hid_loop.op = HID_LOOP_NONE;
+	hid_loop.op_arg = NULL;
+	hid_loop.op_done++;
+	pthread_cond_broadcast(&hid_loop.cond);
+	pthread_mutex_unlock(&hid_loop.mtx);
+}
+
+static void *
+hid_loop_main(void *arg)
+{
+	CFRunLoopSourceContext	sctx;
+	CFRunLoopSourceRef	src;
+
+	(void)arg;
+
+	memset(&sctx, 0, sizeof(sctx));
+	sctx.perform = hid_loop_perform;
+
+	if ((src = CFRunLoopSourceCreate(NULL, 0, &sctx)) != NULL)
+		CFRunLoopAddSource(CFRunLoopGetCurrent(), src,
+		    kCFRunLoopDefaultMode);
+
+	pthread_mutex_lock(&hid_loop.mtx);
+	if (src != NULL) {
+		hid_loop.loop = CFRunLoopGetCurrent();
+		hid_loop.src = src;
+	}
+	hid_loop.starting = false;
+	pthread_cond_broadcast(&hid_loop.cond);
+	pthread_mutex_unlock(&hid_loop.mtx);
+
+	if (src == NULL) {
+		fido_log_debug("%s: CFRunLoopSourceCreate", __func__);
+		return (NULL);
+	}
+
+	CFRunLoopRun(); /* until hid_loop_stop() */
+
+	CFRunLoopRemoveSource(CFRunLoopGetCurrent(), src,
+	    kCFRunLoopDefaultMode);
+	CFRelease(src);
+
+	return (NULL);
+}
+
+/* called with the lock held */
+static int
+hid_loop_start(void)
+{
+	sigset_t	all, old;
+	int		r;
+
+	/* the thread inherits a mask blocking every signal */
+	sigfillset(&all);
+	if ((r = pthread_sigmask(SIG_SETMASK, &all, &old)) != 0) {
+		fido_log_error(r, "%s: pthread_sigmask", __func__);
+		return (-1);
+	}
+	hid_loop.starting = true;
+	if ((r = pthread_create(&hid_loop.thread, NULL, hid_loop_main,
+	    NULL)) != 0) {
+		fido_log_error(r, "%s: pthread_create", __func__);
+		hid_loop.starting = false;
+	}
+	(void)pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (r != 0)
+		return (-1);
+
+	while (hid_loop.starting)
+		pthread_cond_wait(&hid_loop.cond, &hid_loop.mtx);
+	if (hid_loop.loop == NULL) {
+		pthread_join(hid_loop.thread, NULL);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/* called with the lock held, with no request pending */
+static void
+hid_loop_stop(void)
+{
+	CFRunLoopStop(hid_loop.loop);
+	pthread_join(hid_loop.thread, NULL);
+	hid_loop.loop = NULL;
+	hid_loop.src = NULL;
+}
+
+/* have the thread carry out 'op' on 'arg'; called with the lock held */
+static void
+hid_loop_request(enum hid_loop_op op, void *arg)
+{
+	uint64_t seq;
+
+	while (hid_loop.op != HID_LOOP_NONE)
+		pthread_cond_wait(&hid_loop.cond, &hid_loop.mtx);
+
+	hid_loop.op = op;
+	hid_loop.op_arg = arg;
+	seq = ++hid_loop.op_seq;
+	CFRunLoopSourceSignal(hid_loop.src);
+	CFRunLoopWakeUp(hid_loop.loop);
+
+	while (hid_loop.op_done < seq)
+		pthread_cond_wait(&hid_loop.cond, &hid_loop.mtx);
+}
+
+/* schedule a device or, with HID_LOOP_MANAGER, the manager for good */
+static int
+hid_loop_attach(enum hid_loop_op op, void *arg)
+{
+	int ok = -1;
+
+	pthread_mutex_lock(&hid_loop.mtx);
+
+	if (hid_loop.ndev == 0 && hid_loop_start() < 0) {
+		fido_log_debug("%s: hid_loop_start", __func__);
+		goto out;
+	}
+
+	hid_loop_request(op, arg);
+	hid_loop.ndev++;
+
+	ok = 0;
+out:
+	pthread_mutex_unlock(&hid_loop.mtx);
+
+	return (ok);
+}
+
+static void
+hid_loop_detach(struct hid_osx *ctx)
+{
+	pthread_mutex_lock(&hid_loop.mtx);
+
+	hid_loop_request(HID_LOOP_UNSCHEDULE, ctx);
+	if (--hid_loop.ndev == 0)
+		hid_loop_stop();
+
+	pthread_mutex_unlock(&hid_loop.mtx);
+}
+
+static int
+dup_info(fido_dev_info_t *dst, const fido_dev_info_t *src)
+{
+	memset(dst, 0, sizeof(*dst));
+
+	if ((dst->path = fido_strdup(src->path)) == NULL ||
+	    (dst->manufacturer = fido_strdup(src->manufacturer)) == NULL ||
+	    (dst->product = fido_strdup(src->product)) == NULL ||
+	    (src->serial != NULL &&
+	    (dst->serial = fido_strdup(src->serial)) == NULL)) {
+		fido_log_debug("%s: strdup", __func__);
+		free_info(dst);
+		return (-1);
+	}
+
+	dst->vendor_id = src->vendor_id;
+	dst->product_id = src->product_id;
+	dst->io = (fido_dev_io_t) {
+		fido_hid_open,
+		fido_hid_close,
+		fido_hid_read,
+		fido_hid_write,
+	};
+
+	return (0);
+}
+
+/* called with hid_set.mtx held */
+static void
+hid_set_add(IOHIDDeviceRef dev)
+{
+	struct hid_entry	*e;
+	io_service_t		 s;
+	size_t			 cap;
+
+	for (size_t i = 0; i < hid_set.len; i++)
+		if (hid_set.entry[i].ref == dev)
+			return; /* already known */
+
+	if ((s = IOHIDDeviceGetService(dev)) == MACH_PORT_NULL) {
+		fido_log_debug("%s: IOHIDDeviceGetService", __func__);
+		return;
+	}
+
+	if (hid_set.len == hid_set.cap) {
+		cap = hid_set.cap ? hid_set.cap * 2 : 8;
+		if ((e = fido_recallocarray(hid_set.entry, hid_set.cap, cap,
+		    sizeof(*e))) == NULL) {
+			fido_log_debug("%s: fido_recallocarray", __func__);
+			return;
+		}
+		hid_set.entry = e;
+		hid_set.cap = cap;
+	}
+
+	e = &hid_set.entry[hid_set.len];
+	if (copy_info(&e->info, dev) < 0)
+		return;
+	if (IOObjectRetain(s) != KERN_SUCCESS) {
+		fido_log_debug("%s: IOObjectRetain", __func__);
+		free_info(&e->info);
+		return;
+	}
+
+	CFRetain(dev);
+	e->ref = dev;
+	e->service = s;
+	hid_set.len++;
+}
+
+/* called with hid_set.mtx held */
+static void
+hid_set_remove(IOHIDDeviceRef dev)
+{
+	struct hid_entry *e;
+
+	for (size_t i = 0; i < hid_set.len; i++) {
+		if ((e = &hid_set.entry[i])->ref != dev)
+			continue;
+		CFRelease(e->ref);
+		IOObjectRelease(e->service);
+		free_info(&e->info);
+		if (i != --hid_set.len) {
+			*e = hid_set.entry[hid_set.len];
+			memset(&hid_set.entry[hid_set.len], 0, sizeof(*e));
+		}
+		return;
+	}
+}
+
+static void
+manager_match_callback(void *context, IOReturn result, void *sender,
+    IOHIDDeviceRef dev)
 {
 	(void)context;
 	(void)result;
 	(void)sender;
 
-	CFRunLoopStop(CFRunLoopGetCurrent());
+	pthread_mutex_lock(&hid_set.mtx);
+	hid_set_add(dev);
+	pthread_mutex_unlock(&hid_set.mtx);
+}
+
+static void
+manager_removal_callback(void *context, IOReturn result, void *sender,
+    IOHIDDeviceRef dev)
+{
+	(void)context;
+	(void)result;
+	(void)sender;
+
+	pthread_mutex_lock(&hid_set.mtx);
+	hid_set_remove(dev);
+	pthread_mutex_unlock(&hid_set.mtx);
+}
+
+static CFDictionaryRef
+fido_matching(void)
+{
+	CFMutableDictionaryRef	d;
+	CFNumberRef		n;
+	int32_t			usage_page = 0xf1d0;
+
+	if ((d = CFDictionaryCreateMutable(kCFAllocatorDefault, 0,
+	    &kCFTypeDictionaryKeyCallBacks,
+	    &kCFTypeDictionaryValueCallBacks)) == NULL) {
+		fido_log_debug("%s: CFDictionaryCreateMutable", __func__);
+		return (NULL);
+	}
+
+	if ((n = CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type,
+	    &usage_page)) == NULL) {
+		fido_log_debug("%s: CFNumberCreate", __func__);
+		CFRelease(d);
+		return (NULL);
+	}
+
+	CFDictionarySetValue(d, CFSTR(kIOHIDPrimaryUsagePageKey), n);
+	CFRelease(n);
+
+	return (d);
+}
+
+/* set up the manager on first use; called with hid_set.mtx held */
+static int
+hid_set_init(void)
+{
+	IOHIDManagerRef	 manager = NULL;
+	CFDictionaryRef	 match = NULL;
+	CFSetRef	 devset = NULL;
+	IOHIDDeviceRef	*devs = NULL;
+	CFIndex		 n;
+	int		 ok = -1;
+
+	if (hid_set.init)
+		return (hid_set.manager != NULL ? 0 : -1);
+
+	hid_set.init = true;
+
+	if ((manager = IOHIDManagerCreate(kCFAllocatorDefault,
+	    kIOHIDManagerOptionNone)) == NULL) {
+		fido_log_debug("%s: IOHIDManagerCreate", __func__);
+		goto fail;
+	}
+
+	if ((match = fido_matching()) == NULL) {
+		fido_log_debug("%s: fido_matching", __func__);
+		goto fail;
+	}
+
+	IOHIDManagerSetDeviceMatching(manager, match);
+
+	/* the devices already present; the callbacks take it from here */
+	if ((devset = IOHIDManagerCopyDevices(manager)) != NULL &&
+	    (n = CFSetGetCount(devset)) > 0) {
+		if ((devs = fido_calloc((size_t)n, sizeof(*devs))) == NULL) {
+			fido_log_debug("%s: calloc", __func__);
+			goto fail;
+		}
+		CFSetGetValues(devset, (void *)devs);
+		for (CFIndex i = 0; i < n; i++)
+			hid_set_add(devs[i]);
+	}
+
+	IOHIDManagerRegisterDeviceMatchingCallback(manager,
+	    &manager_match_callback, NULL);
+	IOHIDManagerRegisterDeviceRemovalCallback(manager,
+	    &manager_removal_callback, NULL);
+
+	if (hid_loop_attach(HID_LOOP_MANAGER, manager) < 0) {
+		fido_log_debug("%s: hid_loop_attach", __func__);
+		goto fail;
+	}
+
+	hid_set.manager = manager;
+	manager = NULL;
+
+	ok = 0;
+fail:
+	if (ok < 0) {
+		while (hid_set.len > 0)
+			hid_set_remove(hid_set.entry[0].ref);
+		fido_free(hid_set.entry);
+		hid_set.entry = NULL;
+		hid_set.cap = 0;
+	}
+	if (manager != NULL)
+		CFRelease(manager);
+	if (match != NULL)
+		CFRelease(match);
+	if (devset != NULL)
+		CFRelease(devset);
+
+	fido_free(devs);
+
+	return (ok);
+}
+
+/* look 'path' up in the set; returns a retained service */
+static io_service_t
+hid_set_lookup(const char *path)
+{
+	io_service_t s = MACH_PORT_NULL;
+
+	pthread_mutex_lock(&hid_set.mtx);
+
+	if (hid_set.manager != NULL) {
+		for (size_t i = 0; i < hid_set.len; i++) {
+			if (strcmp(hid_set.entry[i].info.path, path) != 0)
+				continue;
+			if (IOObjectRetain(hid_set.entry[i].service) ==
+			    KERN_SUCCESS)
+				s = hid_set.entry[i].service;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&hid_set.mtx);
+
+	return (s);
+}
+
+int
+fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
+{
+	int r = FIDO_OK;
+
+	*olen = 0;
+
+	if (ilen == 0)
+		return (FIDO_OK); /* nothing to do */
+
+	if (devlist == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	pthread_mutex_lock(&hid_set.mtx);
+
+	if (hid_set_init() < 0) {
+		pthread_mutex_unlock(&hid_set.mtx);
+		return (manifest_scan(devlist, ilen, olen));
+	}
+
+	for (size_t i = 0; i < hid_set.len && *olen < ilen; i++) {
+		if (dup_info(&devlist[*olen], &hid_set.entry[i].info) < 0) {
+			r = FIDO_ERR_INTERNAL;
+			break;
+		}
+		(*olen)++;
+	}
+
+	pthread_mutex_unlock(&hid_set.mtx);
+
+	return (r);
 }
 
 static int
@@ -397,11 +930,10 @@ fido_hid_open(const char *path)
 {
 	struct hid_osx		*ctx;
 	io_registry_entry_t	 entry = MACH_PORT_NULL;
-	char			 loop_id[32];
+	bool			 opened = false;
 	int			 ok = -1;
-	int			 r;
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL) {
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		goto fail;
 	}
@@ -425,7 +957,8 @@ fido_hid_open(const char *path)
 		goto fail;
 	}
 
-	if ((entry = get_ioreg_entry(path)) == MACH_PORT_NULL) {
+	if ((entry = hid_set_lookup(path)) == MACH_PORT_NULL &&
+	    (entry = get_ioreg_entry(path)) == MACH_PORT_NULL) {
 		fido_log_debug("%s: get_ioreg_entry: %s", __func__, path);
 		goto fail;
 	}
@@ -453,38 +986,33 @@ fido_hid_open(const char *path)
 		fido_log_debug("%s: IOHIDDeviceOpen", __func__);
 		goto fail;
 	}
-
-	if ((r = snprintf(loop_id, sizeof(loop_id), "fido2-%p",
-	    (void *)ctx->ref)) < 0 || (size_t)r >= sizeof(loop_id)) {
-		fido_log_debug("%s: snprintf", __func__);
-		goto fail;
-	}
-
-	if ((ctx->loop_id = CFStringCreateWithCString(NULL, loop_id,
-	    kCFStringEncodingASCII)) == NULL) {
-		fido_log_debug("%s: CFStringCreateWithCString", __func__);
-		goto fail;
-	}
+	opened = true;
 
 	IOHIDDeviceRegisterInputReportCallback(ctx->ref, ctx->report,
 	    (long)ctx->report_in_len, &report_callback, ctx);
 	IOHIDDeviceRegisterRemovalCallback(ctx->ref, &removal_callback, ctx);
 
+	if (hid_loop_attach(HID_LOOP_SCHEDULE, ctx) < 0) {
+		fido_log_debug("%s: hid_loop_attach", __func__);
+		goto fail;
+	}
+
 	ok = 0;
 fail:
 	if (entry != MACH_PORT_NULL)
 		IOObjectRelease(entry);
 
 	if (ok < 0 && ctx != NULL) {
+		if (opened && IOHIDDeviceClose(ctx->ref,
+		    kIOHIDOptionsTypeSeizeDevice) != kIOReturnSuccess)
+			fido_log_debug("%s: IOHIDDeviceClose", __func__);
 		if (ctx->ref != NULL)
 			CFRelease(ctx->ref);
-		if (ctx->loop_id != NULL)
-			CFRelease(ctx->loop_id);
 		if (ctx->report_pipe[0] != -1)
 			close(ctx->report_pipe[0]);
 		if (ctx->report_pipe[1] != -1)
 			close(ctx->report_pipe[1]);
-		free(ctx);
+		fido_free(ctx);
 		ctx = NULL;
 	}
 
@@ -496,6 +1024,8 @@ fido_hid_close(void *handle)
 {
 	struct hid_osx *ctx = handle;
 
+	hid_loop_detach(ctx);
+
 	IOHIDDeviceRegisterInputReportCallback(ctx->ref, ctx->report,
 	    (long)ctx->report_in_len, NULL, ctx);
 	IOHIDDeviceRegisterRemovalCallback(ctx->ref, NULL, ctx);
@@ -505,13 +1035,13 @@ fido_hid_close(void *handle)
 		fido_log_debug("%s: IOHIDDeviceClose", __func__);
 
 	CFRelease(ctx->ref);
-	CFRelease(ctx->loop_id);
 
 	explicit_bzero(ctx->report, sizeof(ctx->report));
 	close(ctx->report_pipe[0]);
-	close(ctx->report_pipe[1]);
+	if (ctx->report_pipe[1] != -1)
+		close(ctx->report_pipe[1]);
 
-	free(ctx);
+	fido_free(ctx);
 }
 
 int
@@ -523,48 +1053,35 @@ fido_hid_set_sigmask(void *handle, const fido_sigset_t *sigmask)
 	return (FIDO_ERR_INTERNAL);
 }
 
-static void
-schedule_io_loop(struct hid_osx *ctx, int ms)
-{
-	IOHIDDeviceScheduleWithRunLoop(ctx->ref, CFRunLoopGetCurrent(),
-	    ctx->loop_id);
-
-	if (ms == -1)
-		ms = 5000; /* wait 5 seconds by default */
-
-	CFRunLoopRunInMode(ctx->loop_id, (double)ms/1000.0, true);
-
-	IOHIDDeviceUnscheduleFromRunLoop(ctx->ref, CFRunLoopGetCurrent(),
-	    ctx->loop_id);
-}
-
 int
 fido_hid_read(void *handle, unsigned char *buf, size_t len, int ms)
 {
-	struct hid_osx		*ctx = handle;
-	ssize_t			 r;
+	struct hid_osx	*ctx = handle;
+	struct pollfd	 pfd;
+	ssize_t		 r;
+	int		 n;
 
 	explicit_bzero(buf, len);
-	explicit_bzero(ctx->report, sizeof(ctx->report));
 
 	if (len != ctx->report_in_len || len > sizeof(ctx->report)) {
 		fido_log_debug("%s: len %zu", __func__, len);
 		return (-1);
 	}
 
-	/* check for pending frame  */
-	if ((r = read(ctx->report_pipe[0], buf, len)) == -1) {
-		if (errno != EAGAIN && errno != EWOULDBLOCK) {
-			fido_log_error(errno, "%s: read", __func__);
-			return (-1);
-		}
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = ctx->report_pipe[0];
+	pfd.events = POLLIN;
 
-		schedule_io_loop(ctx, ms);
+	if ((n = poll(&pfd, 1, ms)) < 1) {
+		if (n == -1)
+			fido_log_error(errno, "%s: poll", __func__);
+		return (-1);
+	}
 
-		if ((r = read(ctx->report_pipe[0], buf, len)) == -1) {
-			fido_log_error(errno, "%s: read", __func__);
-			return (-1);
-		}
+	/* reports are written whole, and read likewise */
+	if ((r = read(ctx->report_pipe[0], buf, len)) == -1) {
+		fido_log_error(errno, "%s: read", __func__);
+		return (-1);
 	}
 
 	if (r < 0 || (size_t)r != len) {
@@ -609,3 +1126,11 @@ fido_hid_report_out_len(void *handle)
 
 	return (ctx->report_out_len);
 }
+
+int
+fido_hid_fd(void *handle)
+{
+	struct hid_osx *ctx = handle;
+
+	return (ctx->report_pipe[0]);
+}
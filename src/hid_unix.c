@@ -74,3 +74,45 @@ fido_hid_unix_wait(int fd, int ms, const fido_sigset_t *sigmask)
 
 	return (0);
 }
+
+int
+fido_hid_unix_wait_many(const int *fd, bool *ready, size_t n, int ms)
+{
+	struct timespec ts;
+	struct pollfd *pfd;
+	int r;
+
+	if (n == 0 || n > UINT_MAX ||
+	    (pfd = fido_calloc(n, sizeof(*pfd))) == NULL)
+		return (-1);
+
+	for (size_t i = 0; i < n; i++) {
+		pfd[i].events = POLLIN;
+		pfd[i].fd = fd[i]; /* negative fds are ignored */
+		ready[i] = false;
+	}
+
+#ifdef FIDO_FUZZ
+	for (size_t i = 0; i < n; i++)
+		ready[i] = fd[i] >= 0;
+	fido_free(pfd);
+	return (0);
+#endif
+	if (ms > -1) {
+		ts.tv_sec = ms / 1000;
+		ts.tv_nsec = (ms % 1000) * 1000000;
+	}
+
+	if ((r = ppoll(pfd, (nfds_t)n, ms > -1 ? &ts : NULL, NULL)) < 0) {
+		fido_log_error(errno, "%s: ppoll", __func__);
+		fido_free(pfd);
+		return (-1);
+	}
+
+	for (size_t i = 0; i < n; i++)
+		ready[i] = (pfd[i].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+
+	fido_free(pfd);
+
+	return (0);
+}
@@ -13,6 +13,7 @@
 #endif
 #include <windows.h>
 #include <setupapi.h>
+#include <cfgmgr32.h>
 #include <initguid.h>
 #include <devpkey.h>
 #include <devpropdef.h>
@@ -33,15 +34,64 @@ DEFINE_DEVPROPKEY(DEVPKEY_Device_Parent, 0x4340a6c5, 0x93fa, 0x4706, 0x97,
     0x2c, 0x7b, 0x64, 0x80, 0x08, 0xa5, 0xa7, 8);
 #endif
 
-struct hid_win {
-	HANDLE		dev;
+#define HID_WIN_RING	4	/* reads kept posted per device */
+
+#if !defined(__MINGW32__) || __MINGW64_VERSION_MAJOR >= 8
+#define HID_WIN_NOTIFY	/* CM_Register_Notification() is available */
+#endif
+
+/*
+ * Input reports are read through a ring of overlapped reads, posted in
+ * ring order and completed in that order by the HID class driver, so
+ * that the continuation frames of a reply are already queued when they
+ * are asked for. The event of the read at the head of the ring is
+ * signalled once a report is available, and is what fido_dev_get_touch_any()
+ * waits on.
+ */
+struct hid_win_read {
 	OVERLAPPED	overlap;
-	int		report_pending;
-	size_t		report_in_len;
-	size_t		report_out_len;
+	bool		pending;
 	unsigned char	report[1 + CTAP_MAX_REPORT_LEN];
 };
 
+struct hid_win {
+	HANDLE			dev;
+	struct hid_win_read	ring[HID_WIN_RING];
+	size_t			head;	/* the next read to complete */
+	OVERLAPPED		write_overlap;
+	size_t			report_in_len;
+	size_t			report_out_len;
+};
+
+/*
+ * HID interfaces seen by previous enumerations, with the outcome of
+ * probing them, so that only new interfaces are opened and queried. A
+ * device interface notification marks the cache stale; until then, an
+ * enumeration is a copy of the FIDO entries. Without notifications, the
+ * interfaces are listed on every enumeration, but still probed once.
+ */
+struct hid_win_iface {
+	char		*path;
+	bool		 fido;
+	bool		 seen;	/* listed by the current scan */
+	fido_dev_info_t	 info;	/* if fido */
+};
+
+static struct hid_win_cache {
+	SRWLOCK			 lock;
+#ifdef HID_WIN_NOTIFY
+	bool			 init;	/* registration attempted */
+	HCMNOTIFICATION		 notify;
+#endif
+	volatile LONG		 stale;
+	struct hid_win_iface	*iface;
+	size_t			 len;
+	size_t			 cap;
+} hid_win_cache = {
+	.lock = SRWLOCK_INIT,
+	.stale = 1,
+};
+
 static bool
 is_fido(HANDLE dev)
 {
@@ -141,7 +191,7 @@ get_manufacturer(HANDLE dev, char **manufacturer)
 		goto fail;
 	}
 
-	if ((*manufacturer = malloc((size_t)utf8_len)) == NULL) {
+	if ((*manufacturer = fido_malloc((size_t)utf8_len)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		goto fail;
 	}
@@ -155,7 +205,7 @@ get_manufacturer(HANDLE dev, char **manufacturer)
 	ok = 0;
 fail:
 	if (ok < 0) {
-		free(*manufacturer);
+		fido_free(*manufacturer);
 		*manufacturer = NULL;
 	}
 
@@ -182,7 +232,7 @@ get_product(HANDLE dev, char **product)
 		goto fail;
 	}
 
-	if ((*product = malloc((size_t)utf8_len)) == NULL) {
+	if ((*product = fido_malloc((size_t)utf8_len)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		goto fail;
 	}
@@ -196,13 +246,54 @@ get_product(HANDLE dev, char **product)
 	ok = 0;
 fail:
 	if (ok < 0) {
-		free(*product);
+		fido_free(*product);
 		*product = NULL;
 	}
 
 	return (ok);
 }
 
+static int
+get_serial(HANDLE dev, char **serial)
+{
+	wchar_t	buf[512];
+	int	utf8_len;
+	int	ok = -1;
+
+	*serial = NULL;
+
+	if (HidD_GetSerialNumberString(dev, &buf, sizeof(buf)) == false) {
+		fido_log_debug("%s: HidD_GetSerialNumberString", __func__);
+		goto fail;
+	}
+
+	if ((utf8_len = WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, buf,
+	    -1, NULL, 0, NULL, NULL)) <= 1 || utf8_len > 128) {
+		fido_log_debug("%s: WideCharToMultiByte", __func__);
+		goto fail;
+	}
+
+	if ((*serial = fido_malloc((size_t)utf8_len)) == NULL) {
+		fido_log_debug("%s: malloc", __func__);
+		goto fail;
+	}
+
+	if (WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, buf, -1,
+	    *serial, utf8_len, NULL, NULL) != utf8_len) {
+		fido_log_debug("%s: WideCharToMultiByte", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	if (ok < 0) {
+		fido_free(*serial);
+		*serial = NULL;
+	}
+
+	return (ok);
+}
+
 static char *
 get_path(HDEVINFO devinfo, SP_DEVICE_INTERFACE_DATA *ifdata)
 {
@@ -225,7 +316,7 @@ get_path(HDEVINFO devinfo, SP_DEVICE_INTERFACE_DATA *ifdata)
 		goto fail;
 	}
 
-	if ((ifdetail = malloc(len)) == NULL) {
+	if ((ifdetail = fido_malloc(len)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		goto fail;
 	}
@@ -239,13 +330,13 @@ get_path(HDEVINFO devinfo, SP_DEVICE_INTERFACE_DATA *ifdata)
 		goto fail;
 	}
 
-	if ((path = strdup(ifdetail->DevicePath)) == NULL) {
+	if ((path = fido_strdup(ifdetail->DevicePath)) == NULL) {
 		fido_log_debug("%s: strdup", __func__);
 		goto fail;
 	}
 
 fail:
-	free(ifdetail);
+	fido_free(ifdetail);
 
 	return (path);
 }
@@ -275,7 +366,7 @@ hid_ok(HDEVINFO devinfo, DWORD idx)
 		goto fail;
 	}
 
-	if ((parent = malloc(len)) == NULL) {
+	if ((parent = fido_malloc(len)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		goto fail;
 	}
@@ -289,36 +380,46 @@ hid_ok(HDEVINFO devinfo, DWORD idx)
 
 	ok = wcsncmp(parent, L"USB\\", 4) == 0;
 fail:
-	free(parent);
+	fido_free(parent);
 
 	return (ok);
 }
 #endif
 
+static void
+free_info(fido_dev_info_t *di)
+{
+	fido_free(di->path);
+	fido_free(di->manufacturer);
+	fido_free(di->product);
+	fido_free(di->serial);
+	explicit_bzero(di, sizeof(*di));
+}
+
+/* returns 1 for a FIDO device, 0 for another, -1 on error */
 static int
 copy_info(fido_dev_info_t *di, HDEVINFO devinfo, DWORD idx,
-    SP_DEVICE_INTERFACE_DATA *ifdata)
+    const char *path)
 {
 	HANDLE	dev = INVALID_HANDLE_VALUE;
 	int	ok = -1;
 
 	memset(di, 0, sizeof(*di));
 
-	if ((di->path = get_path(devinfo, ifdata)) == NULL) {
-		fido_log_debug("%s: get_path", __func__);
-		goto fail;
-	}
-
-	fido_log_debug("%s: path=%s", __func__, di->path);
+	fido_log_debug("%s: path=%s", __func__, path);
 
 #ifndef FIDO_HID_ANY
 	if (hid_ok(devinfo, idx) == false) {
 		fido_log_debug("%s: hid_ok", __func__);
+		ok = 0;
 		goto fail;
 	}
+#else
+	(void)devinfo;
+	(void)idx;
 #endif
 
-	dev = CreateFileA(di->path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
+	dev = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
 	    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 	if (dev == INVALID_HANDLE_VALUE) {
 		fido_log_debug("%s: CreateFileA", __func__);
@@ -327,6 +428,12 @@ copy_info(fido_dev_info_t *di, HDEVINFO devinfo, DWORD idx,
 
 	if (is_fido(dev) == false) {
 		fido_log_debug("%s: is_fido", __func__);
+		ok = 0;
+		goto fail;
+	}
+
+	if ((di->path = fido_strdup(path)) == NULL) {
+		fido_log_debug("%s: strdup", __func__);
 		goto fail;
 	}
 
@@ -337,12 +444,12 @@ copy_info(fido_dev_info_t *di, HDEVINFO devinfo, DWORD idx,
 
 	if (get_manufacturer(dev, &di->manufacturer) < 0) {
 		fido_log_debug("%s: get_manufacturer", __func__);
-		di->manufacturer = strdup("");
+		di->manufacturer = fido_strdup("");
 	}
 
 	if (get_product(dev, &di->product) < 0) {
 		fido_log_debug("%s: get_product", __func__);
-		di->product = strdup("");
+		di->product = fido_strdup("");
 	}
 
 	if (di->manufacturer == NULL || di->product == NULL) {
@@ -350,59 +457,198 @@ copy_info(fido_dev_info_t *di, HDEVINFO devinfo, DWORD idx,
 		goto fail;
 	}
 
-	ok = 0;
+	/* optional */
+	if (get_serial(dev, &di->serial) < 0)
+		fido_log_debug("%s: get_serial", __func__);
+
+	ok = 1;
 fail:
 	if (dev != INVALID_HANDLE_VALUE)
 		CloseHandle(dev);
 
-	if (ok < 0) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
-		explicit_bzero(di, sizeof(*di));
-	}
+	if (ok < 1)
+		free_info(di);
 
 	return (ok);
 }
 
-int
-fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
+static int
+dup_info(fido_dev_info_t *dst, const fido_dev_info_t *src)
+{
+	memset(dst, 0, sizeof(*dst));
+
+	if ((dst->path = fido_strdup(src->path)) == NULL ||
+	    (dst->manufacturer = fido_strdup(src->manufacturer)) == NULL ||
+	    (dst->product = fido_strdup(src->product)) == NULL ||
+	    (src->serial != NULL &&
+	    (dst->serial = fido_strdup(src->serial)) == NULL)) {
+		fido_log_debug("%s: strdup", __func__);
+		free_info(dst);
+		return (-1);
+	}
+
+	dst->vendor_id = src->vendor_id;
+	dst->product_id = src->product_id;
+	dst->io = (fido_dev_io_t) {
+		fido_hid_open,
+		fido_hid_close,
+		fido_hid_read,
+		fido_hid_write,
+	};
+
+	return (0);
+}
+
+#ifdef HID_WIN_NOTIFY
+static DWORD CALLBACK
+notify_callback(HCMNOTIFICATION notify, PVOID context,
+    CM_NOTIFY_ACTION action, PCM_NOTIFY_EVENT_DATA data, DWORD len)
+{
+	(void)notify;
+	(void)context;
+	(void)data;
+	(void)len;
+
+	if (action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL ||
+	    action == CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL)
+		InterlockedExchange(&hid_win_cache.stale, 1);
+
+	return (ERROR_SUCCESS);
+}
+
+static void
+cache_register(void)
+{
+	CM_NOTIFY_FILTER	filter;
+	CONFIGRET		r;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.cbSize = sizeof(filter);
+	filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+	filter.u.DeviceInterface.ClassGuid = GUID_DEVINTERFACE_HID;
+
+	if ((r = CM_Register_Notification(&filter, NULL, notify_callback,
+	    &hid_win_cache.notify)) != CR_SUCCESS) {
+		fido_log_debug("%s: CM_Register_Notification 0x%lx", __func__,
+		    (u_long)r);
+		hid_win_cache.notify = NULL;
+	}
+}
+#endif /* HID_WIN_NOTIFY */
+
+static bool
+cache_notified(void)
+{
+#ifdef HID_WIN_NOTIFY
+	return (hid_win_cache.notify != NULL);
+#else
+	return (false);
+#endif
+}
+
+static struct hid_win_iface *
+cache_lookup(const char *path)
+{
+	for (size_t i = 0; i < hid_win_cache.len; i++)
+		if (strcmp(hid_win_cache.iface[i].path, path) == 0)
+			return (&hid_win_cache.iface[i]);
+
+	return (NULL);
+}
+
+/* probe a new interface; takes ownership of 'path' */
+static int
+cache_add(char *path, HDEVINFO devinfo, DWORD idx)
+{
+	struct hid_win_iface	*f;
+	size_t			 cap;
+	int			 r;
+
+	if (hid_win_cache.len == hid_win_cache.cap) {
+		cap = hid_win_cache.cap ? hid_win_cache.cap * 2 : 16;
+		if ((f = fido_recallocarray(hid_win_cache.iface,
+		    hid_win_cache.cap, cap, sizeof(*f))) == NULL) {
+			fido_log_debug("%s: fido_recallocarray", __func__);
+			fido_free(path);
+			return (-1);
+		}
+		hid_win_cache.iface = f;
+		hid_win_cache.cap = cap;
+	}
+
+	f = &hid_win_cache.iface[hid_win_cache.len];
+
+	/* errors are not remembered; the interface is probed again */
+	if ((r = copy_info(&f->info, devinfo, idx, path)) < 0) {
+		fido_free(path);
+		return (0);
+	}
+
+	f->path = path;
+	f->fido = r == 1;
+	f->seen = true;
+	hid_win_cache.len++;
+
+	return (0);
+}
+
+static void
+cache_prune(void)
+{
+	struct hid_win_iface *f;
+
+	for (size_t i = 0; i < hid_win_cache.len;) {
+		if ((f = &hid_win_cache.iface[i])->seen) {
+			i++;
+			continue;
+		}
+		fido_free(f->path);
+		free_info(&f->info);
+		*f = hid_win_cache.iface[--hid_win_cache.len];
+		memset(&hid_win_cache.iface[hid_win_cache.len], 0, sizeof(*f));
+	}
+}
+
+/* list the HID interfaces present, probing the new ones */
+static int
+cache_scan(void)
 {
 	GUID				hid_guid = GUID_DEVINTERFACE_HID;
 	HDEVINFO			devinfo = INVALID_HANDLE_VALUE;
 	SP_DEVICE_INTERFACE_DATA	ifdata;
+	struct hid_win_iface		*f;
+	char				*path;
 	DWORD				idx;
 	int				r = FIDO_ERR_INTERNAL;
 
-	*olen = 0;
-
-	if (ilen == 0)
-		return (FIDO_OK); /* nothing to do */
-	if (devlist == NULL)
-		return (FIDO_ERR_INVALID_ARGUMENT);
-
 	if ((devinfo = SetupDiGetClassDevsA(&hid_guid, NULL, NULL,
 	    DIGCF_DEVICEINTERFACE | DIGCF_PRESENT)) == INVALID_HANDLE_VALUE) {
 		fido_log_debug("%s: SetupDiGetClassDevsA", __func__);
 		goto fail;
 	}
 
+	for (size_t i = 0; i < hid_win_cache.len; i++)
+		hid_win_cache.iface[i].seen = false;
+
 	ifdata.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
 
 	for (idx = 0; SetupDiEnumDeviceInterfaces(devinfo, NULL, &hid_guid,
 	    idx, &ifdata) == true; idx++) {
-		if (copy_info(&devlist[*olen], devinfo, idx, &ifdata) == 0) {
-			devlist[*olen].io = (fido_dev_io_t) {
-				fido_hid_open,
-				fido_hid_close,
-				fido_hid_read,
-				fido_hid_write,
-			};
-			if (++(*olen) == ilen)
-				break;
+		if ((path = get_path(devinfo, &ifdata)) == NULL) {
+			fido_log_debug("%s: get_path", __func__);
+			continue;
+		}
+		if ((f = cache_lookup(path)) != NULL) {
+			f->seen = true;
+			fido_free(path);
+		} else if (cache_add(path, devinfo, idx) < 0) {
+			fido_log_debug("%s: cache_add", __func__);
+			goto fail;
 		}
 	}
 
+	cache_prune();
+
 	r = FIDO_OK;
 fail:
 	if (devinfo != INVALID_HANDLE_VALUE)
@@ -411,12 +657,56 @@ fail:
 	return (r);
 }
 
+int
+fido_hid_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
+{
+	struct hid_win_iface	*f;
+	int			 r = FIDO_OK;
+
+	*olen = 0;
+
+	if (ilen == 0)
+		return (FIDO_OK); /* nothing to do */
+	if (devlist == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	AcquireSRWLockExclusive(&hid_win_cache.lock);
+
+#ifdef HID_WIN_NOTIFY
+	if (hid_win_cache.init == false) {
+		hid_win_cache.init = true;
+		cache_register();
+	}
+#endif
+
+	/* a notification during the scan marks the cache stale again */
+	if ((InterlockedExchange(&hid_win_cache.stale, 0) != 0 ||
+	    cache_notified() == false) && (r = cache_scan()) != FIDO_OK) {
+		InterlockedExchange(&hid_win_cache.stale, 1);
+		goto out;
+	}
+
+	for (size_t i = 0; i < hid_win_cache.len && *olen < ilen; i++) {
+		if ((f = &hid_win_cache.iface[i])->fido == false)
+			continue;
+		if (dup_info(&devlist[*olen], &f->info) < 0) {
+			r = FIDO_ERR_INTERNAL;
+			goto out;
+		}
+		(*olen)++;
+	}
+out:
+	ReleaseSRWLockExclusive(&hid_win_cache.lock);
+
+	return (r);
+}
+
 void *
 fido_hid_open(const char *path)
 {
 	struct hid_win *ctx;
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL)
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL)
 		return (NULL);
 
 	ctx->dev = CreateFileA(path, GENERIC_READ | GENERIC_WRITE,
@@ -424,11 +714,21 @@ fido_hid_open(const char *path)
 	    FILE_FLAG_OVERLAPPED, NULL);
 
 	if (ctx->dev == INVALID_HANDLE_VALUE) {
-		free(ctx);
+		fido_free(ctx);
 		return (NULL);
 	}
 
-	if ((ctx->overlap.hEvent = CreateEventA(NULL, FALSE, FALSE,
+	/* manual-reset, so that a wait does not consume the completion */
+	for (size_t i = 0; i < HID_WIN_RING; i++) {
+		if ((ctx->ring[i].overlap.hEvent = CreateEventA(NULL, TRUE,
+		    FALSE, NULL)) == NULL) {
+			fido_log_debug("%s: CreateEventA", __func__);
+			fido_hid_close(ctx);
+			return (NULL);
+		}
+	}
+
+	if ((ctx->write_overlap.hEvent = CreateEventA(NULL, TRUE, FALSE,
 	    NULL)) == NULL) {
 		fido_log_debug("%s: CreateEventA", __func__);
 		fido_hid_close(ctx);
@@ -442,27 +742,43 @@ fido_hid_open(const char *path)
 		return (NULL);
 	}
 
+	if (ctx->report_in_len > sizeof(ctx->ring[0].report)) {
+		fido_log_debug("%s: report_in_len=%zu", __func__,
+		    ctx->report_in_len);
+		fido_hid_close(ctx);
+		return (NULL);
+	}
+
 	return (ctx);
 }
 
 void
 fido_hid_close(void *handle)
 {
-	struct hid_win *ctx = handle;
-
-	if (ctx->overlap.hEvent != NULL) {
-		if (ctx->report_pending) {
-			fido_log_debug("%s: report_pending", __func__);
-			if (CancelIoEx(ctx->dev, &ctx->overlap) == 0)
+	struct hid_win		*ctx = handle;
+	struct hid_win_read	*rd;
+	DWORD			 n;
+
+	/* the buffers of cancelled reads are written until they complete */
+	for (size_t i = 0; i < HID_WIN_RING; i++) {
+		rd = &ctx->ring[i];
+		if (rd->pending) {
+			if (CancelIoEx(ctx->dev, &rd->overlap) == 0)
 				fido_log_debug("%s CancelIoEx: 0x%lx",
 				    __func__, (u_long)GetLastError());
+			(void)GetOverlappedResult(ctx->dev, &rd->overlap, &n,
+			    TRUE);
 		}
-		CloseHandle(ctx->overlap.hEvent);
+		if (rd->overlap.hEvent != NULL)
+			CloseHandle(rd->overlap.hEvent);
+		explicit_bzero(rd->report, sizeof(rd->report));
 	}
 
-	explicit_bzero(ctx->report, sizeof(ctx->report));
+	if (ctx->write_overlap.hEvent != NULL)
+		CloseHandle(ctx->write_overlap.hEvent);
+
 	CloseHandle(ctx->dev);
-	free(ctx);
+	fido_free(ctx);
 }
 
 int
@@ -474,36 +790,54 @@ fido_hid_set_sigmask(void *handle, const fido_sigset_t *sigmask)
 	return (FIDO_ERR_INTERNAL);
 }
 
+/* post a read in every idle slot, in ring order from the head */
+static int
+post_reads(struct hid_win *ctx)
+{
+	struct hid_win_read *rd;
+
+	for (size_t i = 0; i < HID_WIN_RING; i++) {
+		rd = &ctx->ring[(ctx->head + i) % HID_WIN_RING];
+		if (rd->pending)
+			continue;
+		if (ReadFile(ctx->dev, rd->report, (DWORD)ctx->report_in_len,
+		    NULL, &rd->overlap) == 0 &&
+		    GetLastError() != ERROR_IO_PENDING) {
+			fido_log_debug("%s: ReadFile", __func__);
+			return (-1);
+		}
+		rd->pending = true;
+	}
+
+	return (0);
+}
+
 int
 fido_hid_read(void *handle, unsigned char *buf, size_t len, int ms)
 {
-	struct hid_win	*ctx = handle;
-	DWORD		 n;
+	struct hid_win		*ctx = handle;
+	struct hid_win_read	*rd;
+	DWORD			 n;
 
-	if (len != ctx->report_in_len - 1 || len > sizeof(ctx->report) - 1) {
+	if (len != ctx->report_in_len - 1 ||
+	    len > sizeof(ctx->ring[0].report) - 1) {
 		fido_log_debug("%s: len %zu", __func__, len);
 		return (-1);
 	}
 
-	if (ctx->report_pending == 0) {
-		memset(&ctx->report, 0, sizeof(ctx->report));
-		ResetEvent(ctx->overlap.hEvent);
-		if (ReadFile(ctx->dev, ctx->report, (DWORD)(len + 1), &n,
-		    &ctx->overlap) == 0 && GetLastError() != ERROR_IO_PENDING) {
-			CancelIo(ctx->dev);
-			fido_log_debug("%s: ReadFile", __func__);
-			return (-1);
-		}
-		ctx->report_pending = 1;
-	}
+	if (post_reads(ctx) < 0)
+		return (-1);
+
+	rd = &ctx->ring[ctx->head];
 
-	if (ms > -1 && WaitForSingleObject(ctx->overlap.hEvent,
+	if (ms > -1 && WaitForSingleObject(rd->overlap.hEvent,
 	    (DWORD)ms) != WAIT_OBJECT_0)
 		return (0);
 
-	ctx->report_pending = 0;
+	rd->pending = false;
+	ctx->head = (ctx->head + 1) % HID_WIN_RING;
 
-	if (GetOverlappedResult(ctx->dev, &ctx->overlap, &n, TRUE) == 0) {
+	if (GetOverlappedResult(ctx->dev, &rd->overlap, &n, TRUE) == 0) {
 		fido_log_debug("%s: GetOverlappedResult", __func__);
 		return (-1);
 	}
@@ -511,36 +845,47 @@ fido_hid_read(void *handle, unsigned char *buf, size_t len, int ms)
 	if (n != len + 1) {
 		fido_log_debug("%s: expected %zu, got %zu", __func__,
 		    len + 1, (size_t)n);
+		explicit_bzero(rd->report, sizeof(rd->report));
 		return (-1);
 	}
 
-	memcpy(buf, ctx->report + 1, len);
-	explicit_bzero(ctx->report, sizeof(ctx->report));
+	memcpy(buf, rd->report + 1, len);
+	explicit_bzero(rd->report, sizeof(rd->report));
 
 	return ((int)len);
 }
 
+/* a handle signalled once a report can be read; NULL on error */
+void *
+fido_hid_win_event(void *handle)
+{
+	struct hid_win *ctx = handle;
+
+	if (post_reads(ctx) < 0)
+		return (NULL);
+
+	return (ctx->ring[ctx->head].overlap.hEvent);
+}
+
 int
 fido_hid_write(void *handle, const unsigned char *buf, size_t len)
 {
 	struct hid_win	*ctx = handle;
-	OVERLAPPED	 overlap;
 	DWORD		 n;
 
-	memset(&overlap, 0, sizeof(overlap));
-
 	if (len != ctx->report_out_len) {
 		fido_log_debug("%s: len %zu", __func__, len);
 		return (-1);
 	}
 
-	if (WriteFile(ctx->dev, buf, (DWORD)len, NULL, &overlap) == 0 &&
-	    GetLastError() != ERROR_IO_PENDING) {
+	if (WriteFile(ctx->dev, buf, (DWORD)len, NULL,
+	    &ctx->write_overlap) == 0 && GetLastError() != ERROR_IO_PENDING) {
 		fido_log_debug("%s: WriteFile", __func__);
 		return (-1);
 	}
 
-	if (GetOverlappedResult(ctx->dev, &overlap, &n, TRUE) == 0) {
+	if (GetOverlappedResult(ctx->dev, &ctx->write_overlap, &n,
+	    TRUE) == 0) {
 		fido_log_debug("%s: GetOverlappedResult", __func__);
 		return (-1);
 	}
@@ -569,3 +914,11 @@ fido_hid_report_out_len(void *handle)
 
 	return (ctx->report_out_len - 1);
 }
+
+int
+fido_hid_fd(void *handle)
+{
+	(void)handle;
+
+	return (-1);
+}
@@ -7,26 +7,265 @@
 
 #include "fido.h"
 
+#ifndef TLS
+#define TLS
+#endif
+
+/*
+ * A decoded getInfo reply keeps its arrays and strings in one allocation,
+ * the arena, sized by a first walk over the reply. Strings reported by
+ * most authenticators, such as versions, transports and option names,
+ * are not copied but point into a table shared by all replies; known
+ * options are also recorded as FIDO_INFO_OPT_* bits.
+ */
+
+/*
+ * The options come first, in the order of their FIDO_INFO_OPT_* bits, so
+ * that an interned option name yields its bit without another compare.
+ */
+#define INFO_NOPT	19
+
+static char info_atom[][32] = {
+	"plat", "rk", "clientPin", "up", "uv", "pinUvAuthToken",
+	"noMcGaPermissionsWithClientPin", "largeBlobs", "ep", "bioEnroll",
+	"userVerificationMgmtPreview", "uvBioEnroll", "authnrCfg", "uvAcfg",
+	"credMgmt", "credentialMgmtPreview", "setMinPINLength",
+	"makeCredUvNotRqd", "alwaysUv",
+	"FIDO_2_0", "FIDO_2_1", "FIDO_2_1_PRE", "FIDO_2_2", "U2F_V2",
+	"credBlob", "credProtect", "hmac-secret", "hmac-secret-mc",
+	"largeBlobKey", "minPinLength", "thirdPartyPayment",
+	"ble", "hybrid", "internal", "nfc", "smart-card", "usb",
+	"public-key",
+};
+
+struct info_arg {
+	fido_cbor_info_t	*ci;
+	void			*v;
+};
+
+static char *
+info_atom_lookup(const unsigned char *ptr, size_t len)
+{
+	if (len >= sizeof(info_atom[0]))
+		return (NULL);
+
+	for (size_t i = 0; i < nitems(info_atom); i++)
+		if (info_atom[i][len] == '\0' &&
+		    memcmp(info_atom[i], ptr, len) == 0)
+			return (info_atom[i]);
+
+	return (NULL);
+}
+
+static bool
+info_key_is(const cbor_item_t *item, const char *s)
+{
+	const size_t len = strlen(s);
+
+	return (cbor_isa_string(item) && cbor_string_is_definite(item) &&
+	    cbor_string_length(item) == len &&
+	    memcmp(cbor_string_handle(item), s, len) == 0);
+}
+
+/* arena bytes for 'n' objects of 'size' bytes, including alignment */
+static size_t
+info_size(size_t n, size_t size)
+{
+	return (n * size + sizeof(uint64_t) - 1);
+}
+
+static void *
+info_alloc(fido_cbor_info_t *ci, size_t n, size_t size)
+{
+	size_t align, off;
+
+	align = size < sizeof(uint64_t) ? size : sizeof(uint64_t);
+	off = (ci->arena_off + align - 1) / align * align;
+	if (ci->arena == NULL || off > ci->arena_len ||
+	    n > (ci->arena_len - off) / size) {
+		fido_log_debug("%s: n=%zu, size=%zu", __func__, n, size);
+		return (NULL);
+	}
+	ci->arena_off = off + n * size;
+
+	return (ci->arena + off);
+}
+
+/* arena bytes for a copy of a text string; 0 if it is interned */
+static size_t
+string_size(const cbor_item_t *item)
+{
+	if (cbor_isa_string(item) == false ||
+	    cbor_string_is_definite(item) == false ||
+	    info_atom_lookup(cbor_string_handle(item),
+	    cbor_string_length(item)) != NULL)
+		return (0);
+
+	return (cbor_string_length(item) + 1);
+}
+
+static int
+string_copy(fido_cbor_info_t *ci, const cbor_item_t *item, char **str)
+{
+	const unsigned char	*ptr;
+	size_t			 len;
+
+	if (*str != NULL) {
+		fido_log_debug("%s: dup", __func__);
+		return (-1);
+	}
+
+	if (cbor_isa_string(item) == false ||
+	    cbor_string_is_definite(item) == false) {
+		fido_log_debug("%s: cbor type", __func__);
+		return (-1);
+	}
+
+	ptr = cbor_string_handle(item);
+	len = cbor_string_length(item);
+	if ((*str = info_atom_lookup(ptr, len)) != NULL)
+		return (0);
+
+	if (len == SIZE_MAX || (*str = info_alloc(ci, len + 1, 1)) == NULL)
+		return (-1);
+
+	memcpy(*str, ptr, len);
+	(*str)[len] = '\0';
+
+	return (0);
+}
+
+static int
+size_string(const cbor_item_t *item, void *arg)
+{
+	size_t *n = arg;
+
+	*n += string_size(item);
+
+	return (0);
+}
+
+static int
+size_map_key(const cbor_item_t *key, const cbor_item_t *val, void *arg)
+{
+	size_t *n = arg;
+
+	(void)val;
+	*n += string_size(key);
+
+	return (0);
+}
+
+static int
+size_algorithm_entry(const cbor_item_t *key, const cbor_item_t *val,
+    void *arg)
+{
+	size_t *n = arg;
+
+	if (info_key_is(key, "type"))
+		*n += string_size(val);
+
+	return (0);
+}
+
+static int
+size_algorithm(const cbor_item_t *item, void *arg)
+{
+	if (cbor_isa_map(item) && cbor_map_is_definite(item))
+		(void)cbor_map_iter(item, arg, size_algorithm_entry);
+
+	return (0);
+}
+
+static int
+size_reply_element(const cbor_item_t *key, const cbor_item_t *val, void *arg)
+{
+	size_t	*n = arg;
+	size_t	 len;
+
+	if (cbor_isa_uint(key) == false ||
+	    cbor_int_get_width(key) != CBOR_INT_8)
+		return (0);
+
+	if (cbor_isa_array(val) && cbor_array_is_definite(val)) {
+		len = cbor_array_size(val);
+		switch (cbor_get_uint8(key)) {
+		case 1: /* versions */
+		case 2: /* extensions */
+		case 9: /* transports */
+			*n += info_size(len, sizeof(char *));
+			(void)cbor_array_iter(val, n, size_string);
+			break;
+		case 6: /* pinProtocols */
+			*n += info_size(len, sizeof(uint8_t));
+			break;
+		case 10: /* algorithms */
+			*n += info_size(len, sizeof(fido_algo_t));
+			(void)cbor_array_iter(val, n, size_algorithm);
+			break;
+		}
+	} else if (cbor_isa_map(val) && cbor_map_is_definite(val)) {
+		len = cbor_map_size(val);
+		switch (cbor_get_uint8(key)) {
+		case 4: /* options */
+			*n += info_size(len, sizeof(char *));
+			*n += info_size(len, sizeof(bool));
+			(void)cbor_map_iter(val, n, size_map_key);
+			break;
+		case 19: /* certifications */
+			*n += info_size(len, sizeof(char *));
+			*n += info_size(len, sizeof(uint64_t));
+			(void)cbor_map_iter(val, n, size_map_key);
+			break;
+		}
+	}
+
+	return (0);
+}
+
+/* allocate the arena for the reply map 'item' */
+static int
+info_prepare(const cbor_item_t *item, void *arg)
+{
+	fido_cbor_info_t	*ci = arg;
+	size_t			 n = 0;
+
+	if (cbor_map_iter(item, &n, size_reply_element) < 0)
+		return (-1);
+	if (n == 0)
+		return (0);
+
+	if ((ci->arena = fido_calloc(1, n)) == NULL)
+		return (-1);
+	ci->arena_len = n;
+	ci->arena_off = 0;
+
+	return (0);
+}
+
 static int
 decode_string(const cbor_item_t *item, void *arg)
 {
-	fido_str_array_t	*a = arg;
-	const size_t		 i = a->len;
+	struct info_arg		*a = arg;
+	fido_str_array_t	*v = a->v;
 
 	/* keep ptr[x] and len consistent */
-	if (cbor_string_copy(item, &a->ptr[i]) < 0) {
-		fido_log_debug("%s: cbor_string_copy", __func__);
+	if (string_copy(a->ci, item, &v->ptr[v->len]) < 0) {
+		fido_log_debug("%s: string_copy", __func__);
 		return (-1);
 	}
 
-	a->len++;
+	v->len++;
 
 	return (0);
 }
 
 static int
-decode_string_array(const cbor_item_t *item, fido_str_array_t *v)
+decode_string_array(fido_cbor_info_t *ci, const cbor_item_t *item,
+    fido_str_array_t *v)
 {
+	struct info_arg a;
+
 	v->ptr = NULL;
 	v->len = 0;
 
@@ -36,11 +275,13 @@ decode_string_array(const cbor_item_t *item, fido_str_array_t *v)
 		return (-1);
 	}
 
-	v->ptr = calloc(cbor_array_size(item), sizeof(char *));
+	v->ptr = info_alloc(ci, cbor_array_size(item), sizeof(char *));
 	if (v->ptr == NULL)
 		return (-1);
 
-	if (cbor_array_iter(item, v, decode_string) < 0) {
+	a.ci = ci;
+	a.v = v;
+	if (cbor_array_iter(item, &a, decode_string) < 0) {
 		fido_log_debug("%s: decode_string", __func__);
 		return (-1);
 	}
@@ -63,10 +304,27 @@ decode_aaguid(const cbor_item_t *item, unsigned char *aaguid, size_t aaguid_len)
 	return (0);
 }
 
+/* 'name' was interned by string_copy(); unknown options have no bit */
+static void
+decode_option_bit(fido_cbor_info_t *ci, const char *name, bool value)
+{
+	uint64_t bit;
+
+	for (size_t i = 0; i < INFO_NOPT; i++)
+		if (name == info_atom[i]) {
+			bit = (uint64_t)1 << i;
+			ci->opt_present |= bit;
+			if (value)
+				ci->opt_true |= bit;
+			return;
+		}
+}
+
 static int
 decode_option(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 {
-	fido_opt_array_t	*o = arg;
+	struct info_arg		*a = arg;
+	fido_opt_array_t	*o = a->v;
 	const size_t		 i = o->len;
 
 	if (cbor_decode_bool(val, NULL) < 0) {
@@ -74,21 +332,25 @@ decode_option(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 		return (0); /* ignore */
 	}
 
-	if (cbor_string_copy(key, &o->name[i]) < 0) {
-		fido_log_debug("%s: cbor_string_copy", __func__);
+	if (string_copy(a->ci, key, &o->name[i]) < 0) {
+		fido_log_debug("%s: string_copy", __func__);
 		return (0); /* ignore */
 	}
 
 	/* keep name/value and len consistent */
 	o->value[i] = cbor_ctrl_value(val) == CBOR_CTRL_TRUE;
 	o->len++;
+	decode_option_bit(a->ci, o->name[i], o->value[i]);
 
 	return (0);
 }
 
 static int
-decode_options(const cbor_item_t *item, fido_opt_array_t *o)
+decode_options(fido_cbor_info_t *ci, const cbor_item_t *item,
+    fido_opt_array_t *o)
 {
+	struct info_arg a;
+
 	o->name = NULL;
 	o->value = NULL;
 	o->len = 0;
@@ -99,12 +361,15 @@ decode_options(const cbor_item_t *item, fido_opt_array_t *o)
 		return (-1);
 	}
 
-	o->name = calloc(cbor_map_size(item), sizeof(char *));
-	o->value = calloc(cbor_map_size(item), sizeof(bool));
+	o->name = info_alloc(ci, cbor_map_size(item), sizeof(char *));
+	o->value = info_alloc(ci, cbor_map_size(item), sizeof(bool));
 	if (o->name == NULL || o->value == NULL)
 		return (-1);
 
-	return (cbor_map_iter(item, o, decode_option));
+	a.ci = ci;
+	a.v = o;
+
+	return (cbor_map_iter(item, &a, decode_option));
 }
 
 static int
@@ -127,7 +392,8 @@ decode_protocol(const cbor_item_t *item, void *arg)
 }
 
 static int
-decode_protocols(const cbor_item_t *item, fido_byte_array_t *p)
+decode_protocols(fido_cbor_info_t *ci, const cbor_item_t *item,
+    fido_byte_array_t *p)
 {
 	p->ptr = NULL;
 	p->len = 0;
@@ -138,7 +404,7 @@ decode_protocols(const cbor_item_t *item, fido_byte_array_t *p)
 		return (-1);
 	}
 
-	p->ptr = calloc(cbor_array_size(item), sizeof(uint8_t));
+	p->ptr = info_alloc(ci, cbor_array_size(item), sizeof(uint8_t));
 	if (p->ptr == NULL)
 		return (-1);
 
@@ -154,42 +420,32 @@ static int
 decode_algorithm_entry(const cbor_item_t *key, const cbor_item_t *val,
     void *arg)
 {
-	fido_algo_t *alg = arg;
-	char *name = NULL;
-	int ok = -1;
-
-	if (cbor_string_copy(key, &name) < 0) {
-		fido_log_debug("%s: cbor type", __func__);
-		ok = 0; /* ignore */
-		goto out;
-	}
+	struct info_arg	*a = arg;
+	fido_algo_t	*alg = a->v;
 
-	if (!strcmp(name, "alg")) {
+	if (info_key_is(key, "alg")) {
 		if (cbor_isa_negint(val) == false ||
 		    cbor_get_int(val) > INT_MAX || alg->cose != 0) {
 			fido_log_debug("%s: alg", __func__);
-			goto out;
+			return (-1);
 		}
 		alg->cose = -(int)cbor_get_int(val) - 1;
-	} else if (!strcmp(name, "type")) {
-		if (cbor_string_copy(val, &alg->type) < 0) {
+	} else if (info_key_is(key, "type")) {
+		if (string_copy(a->ci, val, &alg->type) < 0) {
 			fido_log_debug("%s: type", __func__);
-			goto out;
+			return (-1);
 		}
 	}
 
-	ok = 0;
-out:
-	free(name);
-
-	return (ok);
+	return (0);
 }
 
 static int
 decode_algorithm(const cbor_item_t *item, void *arg)
 {
-	fido_algo_array_t *aa = arg;
-	const size_t i = aa->len;
+	struct info_arg		*a = arg;
+	fido_algo_array_t	*aa = a->v;
+	struct info_arg		 e;
 
 	if (cbor_isa_map(item) == false ||
 	    cbor_map_is_definite(item) == false) {
@@ -197,11 +453,12 @@ decode_algorithm(const cbor_item_t *item, void *arg)
 		return (-1);
 	}
 
-	memset(&aa->ptr[i], 0, sizeof(aa->ptr[i]));
+	memset(&aa->ptr[aa->len], 0, sizeof(aa->ptr[aa->len]));
 
-	if (cbor_map_iter(item, &aa->ptr[i], decode_algorithm_entry) < 0) {
+	e.ci = a->ci;
+	e.v = &aa->ptr[aa->len];
+	if (cbor_map_iter(item, &e, decode_algorithm_entry) < 0) {
 		fido_log_debug("%s: decode_algorithm_entry", __func__);
-		fido_algo_free(&aa->ptr[i]);
 		return (-1);
 	}
 
@@ -212,8 +469,11 @@ decode_algorithm(const cbor_item_t *item, void *arg)
 }
 
 static int
-decode_algorithms(const cbor_item_t *item, fido_algo_array_t *aa)
+decode_algorithms(fido_cbor_info_t *ci, const cbor_item_t *item,
+    fido_algo_array_t *aa)
 {
+	struct info_arg a;
+
 	aa->ptr = NULL;
 	aa->len = 0;
 
@@ -223,11 +483,13 @@ decode_algorithms(const cbor_item_t *item, fido_algo_array_t *aa)
 		return (-1);
 	}
 
-	aa->ptr = calloc(cbor_array_size(item), sizeof(fido_algo_t));
+	aa->ptr = info_alloc(ci, cbor_array_size(item), sizeof(fido_algo_t));
 	if (aa->ptr == NULL)
 		return (-1);
 
-	if (cbor_array_iter(item, aa, decode_algorithm) < 0) {
+	a.ci = ci;
+	a.v = aa;
+	if (cbor_array_iter(item, &a, decode_algorithm) < 0) {
 		fido_log_debug("%s: decode_algorithm", __func__);
 		return (-1);
 	}
@@ -238,7 +500,8 @@ decode_algorithms(const cbor_item_t *item, fido_algo_array_t *aa)
 static int
 decode_cert(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 {
-	fido_cert_array_t	*c = arg;
+	struct info_arg		*a = arg;
+	fido_cert_array_t	*c = a->v;
 	const size_t		 i = c->len;
 
 	if (cbor_is_int(val) == false) {
@@ -246,8 +509,8 @@ decode_cert(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 		return (0); /* ignore */
 	}
 
-	if (cbor_string_copy(key, &c->name[i]) < 0) {
-		fido_log_debug("%s: cbor_string_copy", __func__);
+	if (string_copy(a->ci, key, &c->name[i]) < 0) {
+		fido_log_debug("%s: string_copy", __func__);
 		return (0); /* ignore */
 	}
 
@@ -259,8 +522,11 @@ decode_cert(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 }
 
 static int
-decode_certs(const cbor_item_t *item, fido_cert_array_t *c)
+decode_certs(fido_cbor_info_t *ci, const cbor_item_t *item,
+    fido_cert_array_t *c)
 {
+	struct info_arg a;
+
 	c->name = NULL;
 	c->value = NULL;
 	c->len = 0;
@@ -271,12 +537,15 @@ decode_certs(const cbor_item_t *item, fido_cert_array_t *c)
 		return (-1);
 	}
 
-	c->name = calloc(cbor_map_size(item), sizeof(char *));
-	c->value = calloc(cbor_map_size(item), sizeof(uint64_t));
+	c->name = info_alloc(ci, cbor_map_size(item), sizeof(char *));
+	c->value = info_alloc(ci, cbor_map_size(item), sizeof(uint64_t));
 	if (c->name == NULL || c->value == NULL)
 		return (-1);
 
-	return (cbor_map_iter(item, c, decode_cert));
+	a.ci = ci;
+	a.v = c;
+
+	return (cbor_map_iter(item, &a, decode_cert));
 }
 
 static int
@@ -293,25 +562,25 @@ parse_reply_element(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 
 	switch (cbor_get_uint8(key)) {
 	case 1: /* versions */
-		return (decode_string_array(val, &ci->versions));
+		return (decode_string_array(ci, val, &ci->versions));
 	case 2: /* extensions */
-		return (decode_string_array(val, &ci->extensions));
+		return (decode_string_array(ci, val, &ci->extensions));
 	case 3: /* aaguid */
 		return (decode_aaguid(val, ci->aaguid, sizeof(ci->aaguid)));
 	case 4: /* options */
-		return (decode_options(val, &ci->options));
+		return (decode_options(ci, val, &ci->options));
 	case 5: /* maxMsgSize */
 		return (cbor_decode_uint64(val, &ci->maxmsgsiz));
 	case 6: /* pinProtocols */
-		return (decode_protocols(val, &ci->protocols));
+		return (decode_protocols(ci, val, &ci->protocols));
 	case 7: /* maxCredentialCountInList */
 		return (cbor_decode_uint64(val, &ci->maxcredcntlst));
 	case 8: /* maxCredentialIdLength */
 		return (cbor_decode_uint64(val, &ci->maxcredidlen));
 	case 9: /* transports */
-		return (decode_string_array(val, &ci->transports));
+		return (decode_string_array(ci, val, &ci->transports));
 	case 10: /* algorithms */
-		return (decode_algorithms(val, &ci->algorithms));
+		return (decode_algorithms(ci, val, &ci->algorithms));
 	case 11: /* maxSerializedLargeBlobArray */
 		return (cbor_decode_uint64(val, &ci->maxlargeblob));
 	case 12: /* forcePINChange */
@@ -329,7 +598,7 @@ parse_reply_element(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 	case 18: /* uvModality */
 		return (cbor_decode_uint64(val, &ci->uv_modality));
 	case 19: /* certifications */
-		return (decode_certs(val, &ci->certs));
+		return (decode_certs(ci, val, &ci->certs));
 	case 20: /* remainingDiscoverableCredentials */
 		if (cbor_decode_uint64(val, &x) < 0 || x > INT64_MAX) {
 			fido_log_debug("%s: cbor_decode_uint64", __func__);
@@ -343,7 +612,255 @@ parse_reply_element(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 	}
 }
 
+/* decode the getInfo reply 'msg' into 'ci', which must have been reset */
+int
+fido_cbor_info_decode(fido_cbor_info_t *ci, const unsigned char *msg,
+    size_t len)
+{
+	return (cbor_parse_reply_prepare(msg, len, ci, info_prepare,
+	    parse_reply_element));
+}
+
+#define INFO_CACHE_LEN	8
+#define INFO_NKEYS	21	/* members decoded by parse_reply_element() */
+
+/*
+ * Decoded getInfo replies kept as templates when FIDO_INFO_CACHE is set,
+ * keyed by aaguid and firmware version. A reply whose other members are
+ * encoded as in a template is not decoded again: the template is copied
+ * and only the volatile members, which vary between otherwise identical
+ * authenticators, are read from the reply.
+ */
+struct info_tmpl {
+	fido_cbor_info_t	*ci;
+	unsigned char		*reply;
+	const unsigned char	*ptr[INFO_NKEYS];
+	size_t			 len[INFO_NKEYS];
+};
+
+static TLS bool info_cache;
+static TLS struct info_tmpl info_tmpl[INFO_CACHE_LEN];
+static TLS size_t info_tmpl_next;
+
+static bool
+info_volatile(size_t key)
+{
+	/* preferredPlatformUvAttempts, remainingDiscoverableCredentials */
+	return (key == 17 || key == 20);
+}
+
+static bool
+info_member_eq(const struct info_tmpl *t, const unsigned char *const *ptr,
+    const size_t *len, size_t key)
+{
+	if (t->ptr[key] == NULL || ptr[key] == NULL)
+		return (t->ptr[key] == ptr[key]);
+
+	return (t->len[key] == len[key] &&
+	    memcmp(t->ptr[key], ptr[key], len[key]) == 0);
+}
+
+/* the template with the aaguid and fwVersion of a reply; NULL if none */
+static struct info_tmpl *
+info_tmpl_lookup(const unsigned char *const *ptr, const size_t *len)
+{
+	for (size_t i = 0; i < INFO_CACHE_LEN; i++)
+		if (info_tmpl[i].ci != NULL &&
+		    info_member_eq(&info_tmpl[i], ptr, len, 3) &&
+		    info_member_eq(&info_tmpl[i], ptr, len, 14))
+			return (&info_tmpl[i]);
+
+	return (NULL);
+}
+
+static void
+info_tmpl_reset(struct info_tmpl *t)
+{
+	fido_cbor_info_free(&t->ci);
+	fido_free(t->reply);
+	memset(t, 0, sizeof(*t));
+}
+
+/* 'p' moved from the arena of 'src' to 'arena' */
+static void *
+info_rebase(const fido_cbor_info_t *src, unsigned char *arena, void *p)
+{
+	const uintptr_t a = (uintptr_t)src->arena;
+	const uintptr_t q = (uintptr_t)p;
+
+	if (p == NULL || q < a || q - a >= src->arena_len)
+		return (p); /* interned */
+
+	return (arena + (q - a));
+}
+
+static void
+info_rebase_strings(const fido_cbor_info_t *src, unsigned char *arena,
+    char **v, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		v[i] = info_rebase(src, arena, v[i]);
+}
+
+/* copy 'src' into 'dst', which must have been reset */
+static int
+info_copy(fido_cbor_info_t *dst, const fido_cbor_info_t *src)
+{
+	unsigned char *arena = NULL;
+
+	if (src->arena != NULL) {
+		if ((arena = fido_malloc(src->arena_len)) == NULL)
+			return (-1);
+		memcpy(arena, src->arena, src->arena_off);
+	}
+
+	*dst = *src;
+	dst->arena = arena;
+	if (arena == NULL)
+		return (0);
+
+	dst->versions.ptr = info_rebase(src, arena, src->versions.ptr);
+	dst->extensions.ptr = info_rebase(src, arena, src->extensions.ptr);
+	dst->transports.ptr = info_rebase(src, arena, src->transports.ptr);
+	dst->options.name = info_rebase(src, arena, src->options.name);
+	dst->options.value = info_rebase(src, arena, src->options.value);
+	dst->protocols.ptr = info_rebase(src, arena, src->protocols.ptr);
+	dst->algorithms.ptr = info_rebase(src, arena, src->algorithms.ptr);
+	dst->certs.name = info_rebase(src, arena, src->certs.name);
+	dst->certs.value = info_rebase(src, arena, src->certs.value);
+
+	info_rebase_strings(src, arena, dst->versions.ptr, dst->versions.len);
+	info_rebase_strings(src, arena, dst->extensions.ptr,
+	    dst->extensions.len);
+	info_rebase_strings(src, arena, dst->transports.ptr,
+	    dst->transports.len);
+	info_rebase_strings(src, arena, dst->options.name, dst->options.len);
+	info_rebase_strings(src, arena, dst->certs.name, dst->certs.len);
+	for (size_t i = 0; i < dst->algorithms.len; i++)
+		dst->algorithms.ptr[i].type = info_rebase(src, arena,
+		    dst->algorithms.ptr[i].type);
+
+	return (0);
+}
+
+/* remember 'ci', decoded from 'msg', in place of 't' if set */
+static void
+info_tmpl_store(struct info_tmpl *t, const fido_cbor_info_t *ci,
+    const unsigned char *msg, size_t len)
+{
+	if (t == NULL) {
+		t = &info_tmpl[info_tmpl_next];
+		info_tmpl_next = (info_tmpl_next + 1) % INFO_CACHE_LEN;
+	}
+	info_tmpl_reset(t);
+
+	if ((t->ci = fido_cbor_info_new()) == NULL ||
+	    (t->reply = fido_malloc(len)) == NULL ||
+	    info_copy(t->ci, ci) < 0) {
+		fido_log_debug("%s: alloc", __func__);
+		info_tmpl_reset(t);
+		return;
+	}
+
+	memcpy(t->reply, msg, len);
+	if (cbor_index_reply(t->reply, len, t->ptr, t->len,
+	    INFO_NKEYS) != FIDO_OK)
+		info_tmpl_reset(t);
+}
+
+static int
+info_decode_volatile(fido_cbor_info_t *ci, const unsigned char *const *ptr,
+    const size_t *len)
+{
+	uint64_t x;
+
+	ci->uv_attempts = 0;
+	ci->rk_remaining = -1;
+
+	if (ptr[17] != NULL && cbor_read_uint64(ptr[17], len[17],
+	    &ci->uv_attempts) < 0)
+		return (-1);
+	if (ptr[20] != NULL) {
+		if (cbor_read_uint64(ptr[20], len[20], &x) < 0 ||
+		    x > INT64_MAX)
+			return (-1);
+		ci->rk_remaining = (int64_t)x;
+	}
+
+	return (0);
+}
+
+/* fido_cbor_info_decode(), from a template if one matches 'msg' */
 static int
+info_decode_cached(fido_cbor_info_t *ci, const unsigned char *msg,
+    size_t len)
+{
+	const unsigned char	*ptr[INFO_NKEYS];
+	size_t			 n[INFO_NKEYS];
+	struct info_tmpl	*t;
+	int			 r;
+
+	if ((r = cbor_index_reply(msg, len, ptr, n, INFO_NKEYS)) != FIDO_OK)
+		return (r);
+
+	if ((t = info_tmpl_lookup(ptr, n)) != NULL) {
+		for (size_t i = 0; i < INFO_NKEYS; i++)
+			if (!info_volatile(i) && !info_member_eq(t, ptr, n, i))
+				goto decode;
+		if (info_copy(ci, t->ci) < 0)
+			return (FIDO_ERR_INTERNAL);
+		if (info_decode_volatile(ci, ptr, n) < 0) {
+			fido_log_debug("%s: info_decode_volatile", __func__);
+			fido_cbor_info_reset(ci);
+			return (FIDO_ERR_RX_INVALID_CBOR);
+		}
+		return (FIDO_OK);
+	}
+decode:
+	if ((r = fido_cbor_info_decode(ci, msg, len)) == FIDO_OK)
+		info_tmpl_store(t, ci, msg, len);
+
+	return (r);
+}
+
+/* enable or disable the template cache, dropping its contents */
+void
+fido_cbor_info_cache_init(bool enable)
+{
+	for (size_t i = 0; i < INFO_CACHE_LEN; i++)
+		info_tmpl_reset(&info_tmpl[i]);
+	info_tmpl_next = 0;
+	info_cache = enable;
+}
+
+/*
+ * A copy of the template with 'aaguid' and 'fwversion', volatile members
+ * as last seen; NULL if there is none.
+ */
+fido_cbor_info_t *
+fido_cbor_info_cache_get(const unsigned char *aaguid, uint64_t fwversion)
+{
+	fido_cbor_info_t *ci;
+
+	for (size_t i = 0; i < INFO_CACHE_LEN; i++) {
+		if (info_tmpl[i].ci == NULL ||
+		    info_tmpl[i].ci->fwversion != fwversion ||
+		    memcmp(info_tmpl[i].ci->aaguid, aaguid,
+		    sizeof(info_tmpl[i].ci->aaguid)) != 0)
+			continue;
+		if ((ci = fido_cbor_info_new()) == NULL)
+			return (NULL);
+		if (info_copy(ci, info_tmpl[i].ci) < 0) {
+			fido_cbor_info_free(&ci);
+			return (NULL);
+		}
+		return (ci);
+	}
+
+	return (NULL);
+}
+
+int
 fido_dev_get_cbor_info_tx(fido_dev_t *dev, int *ms)
 {
 	const unsigned char cbor[] = { CTAP_CBOR_GETINFO };
@@ -358,10 +875,11 @@ fido_dev_get_cbor_info_tx(fido_dev_t *dev, int *ms)
 	return (FIDO_OK);
 }
 
-static int
+int
 fido_dev_get_cbor_info_rx(fido_dev_t *dev, fido_cbor_info_t *ci, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
@@ -370,20 +888,23 @@ fido_dev_get_cbor_info_rx(fido_dev_t *dev, fido_cbor_info_t *ci, int *ms)
 
 	fido_cbor_info_reset(ci);
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
 	}
 
-	r = cbor_parse_reply(msg, (size_t)msglen, ci, parse_reply_element);
+	if (info_cache)
+		r = info_decode_cached(ci, msg, (size_t)msglen);
+	else
+		r = fido_cbor_info_decode(ci, msg, (size_t)msglen);
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
@@ -407,7 +928,7 @@ fido_dev_get_cbor_info_wait(fido_dev_t *dev, fido_cbor_info_t *ci, int *ms)
 int
 fido_dev_get_cbor_info(fido_dev_t *dev, fido_cbor_info_t *ci)
 {
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 
 	return (fido_dev_get_cbor_info_wait(dev, ci, &ms));
 }
@@ -421,7 +942,7 @@ fido_cbor_info_new(void)
 {
 	fido_cbor_info_t *ci;
 
-	if ((ci = calloc(1, sizeof(fido_cbor_info_t))) == NULL)
+	if ((ci = fido_calloc(1, sizeof(fido_cbor_info_t))) == NULL)
 		return (NULL);
 
 	fido_cbor_info_reset(ci);
@@ -432,13 +953,20 @@ fido_cbor_info_new(void)
 void
 fido_cbor_info_reset(fido_cbor_info_t *ci)
 {
-	fido_str_array_free(&ci->versions);
-	fido_str_array_free(&ci->extensions);
-	fido_str_array_free(&ci->transports);
-	fido_opt_array_free(&ci->options);
-	fido_byte_array_free(&ci->protocols);
-	fido_algo_array_free(&ci->algorithms);
-	fido_cert_array_free(&ci->certs);
+	/* the arrays live in the arena */
+	memset(&ci->versions, 0, sizeof(ci->versions));
+	memset(&ci->extensions, 0, sizeof(ci->extensions));
+	memset(&ci->transports, 0, sizeof(ci->transports));
+	memset(&ci->options, 0, sizeof(ci->options));
+	memset(&ci->protocols, 0, sizeof(ci->protocols));
+	memset(&ci->algorithms, 0, sizeof(ci->algorithms));
+	memset(&ci->certs, 0, sizeof(ci->certs));
+	fido_free(ci->arena);
+	ci->arena = NULL;
+	ci->arena_len = 0;
+	ci->arena_off = 0;
+	ci->opt_present = 0;
+	ci->opt_true = 0;
 	ci->rk_remaining = -1;
 }
 
@@ -450,7 +978,7 @@ fido_cbor_info_free(fido_cbor_info_t **ci_p)
 	if (ci_p == NULL || (ci = *ci_p) ==  NULL)
 		return;
 	fido_cbor_info_reset(ci);
-	free(ci);
+	fido_free(ci);
 	*ci_p = NULL;
 }
 
@@ -520,6 +1048,18 @@ fido_cbor_info_options_len(const fido_cbor_info_t *ci)
 	return (ci->options.len);
 }
 
+uint64_t
+fido_cbor_info_options_present(const fido_cbor_info_t *ci)
+{
+	return (ci->opt_present);
+}
+
+uint64_t
+fido_cbor_info_options_enabled(const fido_cbor_info_t *ci)
+{
+	return (ci->opt_true);
+}
+
 uint64_t
 fido_cbor_info_maxcredbloblen(const fido_cbor_info_t *ci)
 {
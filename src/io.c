@@ -30,101 +30,216 @@ struct frame {
 #define MIN(x, y) ((x) > (y) ? (y) : (x))
 #endif
 
+#ifndef TLS
+#define TLS
+#endif
+
+static TLS fido_capture_handler_t *capture_handler;
+static TLS void *capture_handler_arg;
+
+/* milliseconds elapsed since ts, or -1 */
 static int
-tx_pkt(fido_dev_t *d, const void *pkt, size_t len, int *ms)
+elapsed_ms(const struct timespec *ts)
 {
-	struct timespec ts;
-	int n;
+	int ms = INT_MAX;
 
-	if (fido_time_now(&ts) != 0)
+	if (fido_time_delta(ts, &ms) != 0)
 		return (-1);
 
-	n = d->io.write(d->io_handle, pkt, len);
+	return (INT_MAX - ms);
+}
+
+/*
+ * Round trips of the requests that never wait for the user, kept per
+ * class so that a largeBlobs write does not set the pace of getInfo.
+ */
+static fido_rtt_t *
+rtt_class(fido_dev_t *d, uint8_t cbor_cmd)
+{
+	switch (cbor_cmd) {
+	case CTAP_CBOR_GETINFO:
+		return (&d->rtt[0]);
+	case CTAP_CBOR_CRED_MGMT:
+	case CTAP_CBOR_CRED_MGMT_PRE:
+		return (&d->rtt[1]);
+	case CTAP_CBOR_LARGEBLOB:
+		return (&d->rtt[2]);
+	}
+
+	return (NULL);
+}
+
+static void
+rtt_record(fido_dev_t *d)
+{
+	fido_rtt_t	*r;
+	int		 ms;
+
+	if ((r = rtt_class(d, d->rtt_cmd)) == NULL ||
+	    (ms = elapsed_ms(&d->tx_ts)) < 0)
+		return;
+
+	r->ms[r->next] = (uint16_t)MIN(ms, UINT16_MAX);
+	r->next = (uint8_t)((r->next + 1) % FIDO_RTT_SAMPLES);
+	if (r->len < FIDO_RTT_SAMPLES)
+		r->len++;
+}
+
+/* 'ms', or less if the device is known to answer faster */
+static int
+rtt_deadline(fido_dev_t *d, uint8_t cmd, int ms)
+{
+	const fido_rtt_t	*r;
+	int64_t			 max = 0;
+
+	if (d->rtt_factor == 0 || cmd != CTAP_CMD_CBOR || d->rtt_cmd == 0 ||
+	    (r = rtt_class(d, d->rtt_cmd)) == NULL || r->len < FIDO_RTT_MIN)
+		return (ms);
+
+	for (size_t i = 0; i < r->len; i++)
+		if (r->ms[i] > max)
+			max = r->ms[i];
+	if ((max *= d->rtt_factor) < FIDO_RTT_FLOOR_MS)
+		max = FIDO_RTT_FLOOR_MS;
+	if (ms >= 0 && ms <= max)
+		return (ms);
+
+	fido_log_debug("%s: cmd=0x%02x, ms=%d -> %d", __func__, d->rtt_cmd,
+	    ms, (int)MIN(max, INT_MAX));
+
+	return ((int)MIN(max, INT_MAX));
+}
+
+void
+fido_set_capture_handler(fido_capture_handler_t *handler, void *arg)
+{
+	capture_handler = handler;
+	capture_handler_arg = arg;
+}
+
+static void
+capture(int dir, const unsigned char *ptr, size_t len)
+{
+	fido_capture_t	c;
+	struct timespec	ts;
+
+	if (len < sizeof(c.cid) || fido_time_now(&ts) != 0)
+		return;
+
+	c.dir = dir;
+	c.cid = (uint32_t)ptr[0] << 24 | (uint32_t)ptr[1] << 16 |
+	    (uint32_t)ptr[2] << 8 | ptr[3];
+	c.ts_us = (uint64_t)ts.tv_sec * 1000000 +
+	    (uint64_t)ts.tv_nsec / 1000;
+	c.ptr = ptr;
+	c.len = len;
+
+	capture_handler(capture_handler_arg, &c);
+}
+
+static int
+tx_pkt(fido_dev_t *d, const void *pkt, size_t len)
+{
+	int n;
 
-	if (fido_time_delta(&ts, ms) != 0)
+	d->metrics.tx_frames++;
+
+	/* skip the report id */
+	if (capture_handler != NULL && len > 0)
+		capture(FIDO_CAPTURE_TX, (const unsigned char *)pkt + 1,
+		    len - 1);
+
+	if (d->chan != NULL)
+		n = fido_chan_write(d, pkt, len);
+	else
+		n = d->io.write(d->io_handle, pkt, len);
+	if (n < 0 || (size_t)n != len)
 		return (-1);
 
-	return (n);
+	return (0);
 }
 
 static int
-tx_empty(fido_dev_t *d, uint8_t cmd, int *ms)
+tx_empty(fido_dev_t *d, uint8_t cmd)
 {
 	struct frame	*fp;
 	unsigned char	 pkt[sizeof(*fp) + 1];
 	const size_t	 len = d->tx_len + 1;
-	int		 n;
 
 	memset(&pkt, 0, sizeof(pkt));
 	fp = (struct frame *)(pkt + 1);
 	fp->cid = d->cid;
 	fp->body.init.cmd = CTAP_FRAME_INIT | cmd;
 
-	if (len > sizeof(pkt) || (n = tx_pkt(d, pkt, len, ms)) < 0 ||
-	    (size_t)n != len)
+	if (len > sizeof(pkt) || tx_pkt(d, pkt, len) < 0)
 		return (-1);
 
 	return (0);
 }
 
+/*
+ * The frame helpers below share the caller's packet buffer: only the
+ * header and the payload bytes are rewritten for each frame, and only
+ * the unused tail of a short final frame is zeroed.
+ */
 static size_t
-tx_preamble(fido_dev_t *d, uint8_t cmd, const void *buf, size_t count, int *ms)
+tx_preamble(fido_dev_t *d, uint8_t cmd, unsigned char *pkt, const void *buf,
+    size_t count)
 {
-	struct frame	*fp;
-	unsigned char	 pkt[sizeof(*fp) + 1];
-	const size_t	 len = d->tx_len + 1;
-	int		 n;
+	struct frame	*fp = (struct frame *)(pkt + 1);
+	const size_t	 max = d->tx_len - CTAP_INIT_HEADER_LEN;
 
-	if (d->tx_len - CTAP_INIT_HEADER_LEN > sizeof(fp->body.init.data))
+	if (max > sizeof(fp->body.init.data))
 		return (0);
 
-	memset(&pkt, 0, sizeof(pkt));
-	fp = (struct frame *)(pkt + 1);
 	fp->cid = d->cid;
 	fp->body.init.cmd = CTAP_FRAME_INIT | cmd;
 	fp->body.init.bcnth = (count >> 8) & 0xff;
 	fp->body.init.bcntl = count & 0xff;
-	count = MIN(count, d->tx_len - CTAP_INIT_HEADER_LEN);
+	count = MIN(count, max);
 	memcpy(&fp->body.init.data, buf, count);
+	memset(&fp->body.init.data[count], 0, max - count);
 
-	if (len > sizeof(pkt) || (n = tx_pkt(d, pkt, len, ms)) < 0 ||
-	    (size_t)n != len)
+	if (tx_pkt(d, pkt, d->tx_len + 1) < 0)
 		return (0);
 
 	return (count);
 }
 
 static size_t
-tx_frame(fido_dev_t *d, uint8_t seq, const void *buf, size_t count, int *ms)
+tx_frame(fido_dev_t *d, uint8_t seq, unsigned char *pkt, const void *buf,
+    size_t count)
 {
-	struct frame	*fp;
-	unsigned char	 pkt[sizeof(*fp) + 1];
-	const size_t	 len = d->tx_len + 1;
-	int		 n;
+	struct frame	*fp = (struct frame *)(pkt + 1);
+	const size_t	 max = d->tx_len - CTAP_CONT_HEADER_LEN;
 
-	if (d->tx_len - CTAP_CONT_HEADER_LEN > sizeof(fp->body.cont.data))
+	if (max > sizeof(fp->body.cont.data))
 		return (0);
 
-	memset(&pkt, 0, sizeof(pkt));
-	fp = (struct frame *)(pkt + 1);
 	fp->cid = d->cid;
 	fp->body.cont.seq = seq;
-	count = MIN(count, d->tx_len - CTAP_CONT_HEADER_LEN);
+	count = MIN(count, max);
 	memcpy(&fp->body.cont.data, buf, count);
+	memset(&fp->body.cont.data[count], 0, max - count);
 
-	if (len > sizeof(pkt) || (n = tx_pkt(d, pkt, len, ms)) < 0 ||
-	    (size_t)n != len)
+	if (tx_pkt(d, pkt, d->tx_len + 1) < 0)
 		return (0);
 
 	return (count);
 }
 
 static int
-tx(fido_dev_t *d, uint8_t cmd, const unsigned char *buf, size_t count, int *ms)
+tx(fido_dev_t *d, uint8_t cmd, const unsigned char *buf, size_t count)
 {
-	size_t n, sent;
+	unsigned char	pkt[sizeof(struct frame) + 1];
+	size_t		n, sent;
+
+	if (d->tx_len + 1 > sizeof(pkt))
+		return (-1);
+
+	pkt[0] = 0; /* report id */
 
-	if ((sent = tx_preamble(d, cmd, buf, count, ms)) == 0) {
+	if ((sent = tx_preamble(d, cmd, pkt, buf, count)) == 0) {
 		fido_log_debug("%s: tx_preamble", __func__);
 		return (-1);
 	}
@@ -134,8 +249,8 @@ tx(fido_dev_t *d, uint8_t cmd, const unsigned char *buf, size_t count, int *ms)
 			fido_log_debug("%s: seq & 0x80", __func__);
 			return (-1);
 		}
-		if ((n = tx_frame(d, seq++, buf + sent, count - sent,
-		    ms)) == 0) {
+		if ((n = tx_frame(d, seq++, pkt, buf + sent,
+		    count - sent)) == 0) {
 			fido_log_debug("%s: tx_frame", __func__);
 			return (-1);
 		}
@@ -144,77 +259,160 @@ tx(fido_dev_t *d, uint8_t cmd, const unsigned char *buf, size_t count, int *ms)
 	return (0);
 }
 
-static int
-transport_tx(fido_dev_t *d, uint8_t cmd, const void *buf, size_t count, int *ms)
+int
+fido_tx(fido_dev_t *d, uint8_t cmd, const void *buf, size_t count, int *ms)
 {
-	struct timespec ts;
-	int n;
+	fido_deadline_t	dl;
+	fido_trace_t	span;
+	fido_prof_t	prof;
+	int		n = -1;
 
-	if (fido_time_now(&ts) != 0)
-		return (-1);
+	fido_log_debug("%s: dev=%p, cmd=0x%02x", __func__, (void *)d, cmd);
+	fido_log_xxd(buf, count, "%s", __func__);
 
-	n = d->transport.tx(d, cmd, buf, count);
+	fido_trace_begin(&span, d, __func__, cmd, cmd == CTAP_CMD_CBOR &&
+	    count > 0 ? *(const uint8_t *)buf : 0, count);
+	fido_prof_begin(&prof, FIDO_PROF_TX);
 
-	if (fido_time_delta(&ts, ms) != 0)
-		return (-1);
+	d->rx_pending_len = 0; /* stale */
+
+	if (d->transport.tx == NULL && (d->io_handle == NULL ||
+	    d->io.write == NULL || count > UINT16_MAX)) {
+		fido_log_debug("%s: invalid argument", __func__);
+		goto out;
+	}
+	/* a cancel belongs to the request it cancels */
+	if (cmd != CTAP_CMD_CANCEL) {
+		memset(&d->metrics, 0, sizeof(d->metrics));
+		d->metrics.cmd = cmd;
+		if (cmd == CTAP_CMD_CBOR && count > 0)
+			d->metrics.cbor_cmd = *(const uint8_t *)buf;
+		d->metrics.tx_len = count;
+		d->metrics_pending = d->metrics_cb != NULL;
+		d->up_wait = false;
+		d->rtt_cmd = d->metrics.cbor_cmd;
+		if (rtt_class(d, d->rtt_cmd) == NULL)
+			d->rtt_cmd = 0;
+	}
+	/* the keepalive, metrics and rtt clock starts with the deadline */
+	if (fido_time_deadline(&dl, *ms, d->keepalive != NULL ||
+	    d->metrics_cb != NULL || d->rtt_cmd != 0 ? &d->tx_ts : NULL) != 0)
+		goto out;
+
+	if (d->transport.tx != NULL)
+		n = d->transport.tx(d, cmd, buf, count);
+	else
+		n = count == 0 ? tx_empty(d, cmd) : tx(d, cmd, buf, count);
+
+	if (fido_time_remain(&dl, ms) != 0)
+		n = -1;
+out:
+	fido_prof_end(&prof, n);
+	fido_trace_end(&span, n < 0 ? FIDO_ERR_TX : FIDO_OK);
 
 	return (n);
 }
 
-int
-fido_tx(fido_dev_t *d, uint8_t cmd, const void *buf, size_t count, int *ms)
+static int
+rx_report(fido_dev_t *d, unsigned char *ptr, fido_deadline_t *dl)
 {
-	fido_log_debug("%s: dev=%p, cmd=0x%02x", __func__, (void *)d, cmd);
-	fido_log_xxd(buf, count, "%s", __func__);
+	int ms, n;
 
-	if (d->transport.tx != NULL)
-		return (transport_tx(d, cmd, buf, count, ms));
-	if (d->io_handle == NULL || d->io.write == NULL || count > UINT16_MAX) {
-		fido_log_debug("%s: invalid argument", __func__);
+	if (fido_time_wait(dl, &ms) != 0)
 		return (-1);
-	}
 
-	return (count == 0 ? tx_empty(d, cmd, ms) : tx(d, cmd, buf, count, ms));
+	d->metrics.rx_frames++;
+
+	if (d->chan != NULL)
+		n = fido_chan_read(d, ptr, d->rx_len, ms);
+	else
+		n = d->io.read(d->io_handle, ptr, d->rx_len, ms);
+	if (n < 0 || (size_t)n != d->rx_len)
+		return (-1);
+
+	if (capture_handler != NULL)
+		capture(FIDO_CAPTURE_RX, ptr, d->rx_len);
+
+	return (0);
 }
 
 static int
-rx_frame(fido_dev_t *d, struct frame *fp, int *ms)
+rx_frame(fido_dev_t *d, struct frame *fp, fido_deadline_t *dl)
 {
-	struct timespec ts;
-	int n;
+	if (d->rx_len > sizeof(*fp))
+		return (-1);
 
-	memset(fp, 0, sizeof(*fp));
+	/* only the bytes past the report need clearing */
+	memset((unsigned char *)fp + d->rx_len, 0, sizeof(*fp) - d->rx_len);
 
-	if (fido_time_now(&ts) != 0)
-		return (-1);
+	return (rx_report(d, (unsigned char *)fp, dl));
+}
 
-	if (d->rx_len > sizeof(*fp) || (n = d->io.read(d->io_handle,
-	    (unsigned char *)fp, d->rx_len, *ms)) < 0 || (size_t)n != d->rx_len)
-		return (-1);
+static void
+rx_keepalive(fido_dev_t *d, const struct frame *fp)
+{
+	const uint8_t	status = fp->body.init.data[0];
+	int		ms;
+
+	d->metrics.keepalives++;
+	if (status == CTAP_KEEPALIVE_UPNEEDED)
+		d->rtt_cmd = 0; /* not a plain round trip */
+	if (d->metrics_pending) {
+		if (status == CTAP_KEEPALIVE_UPNEEDED && !d->up_wait)
+			d->up_wait = fido_time_now(&d->up_ts) == 0;
+		else if (status != CTAP_KEEPALIVE_UPNEEDED && d->up_wait) {
+			if ((ms = elapsed_ms(&d->up_ts)) > 0)
+				d->metrics.up_ms += ms;
+			d->up_wait = false;
+		}
+	}
+
+	if (d->keepalive == NULL)
+		return;
+
+	ms = elapsed_ms(&d->tx_ts);
+
+	fido_log_frame("%s: status=0x%02x, elapsed=%d", __func__, status, ms);
 
-	return (fido_time_delta(&ts, ms));
+	d->keepalive(d->keepalive_arg, status, ms);
 }
 
 static int
-rx_preamble(fido_dev_t *d, uint8_t cmd, struct frame *fp, int *ms)
+rx_preamble(fido_dev_t *d, uint8_t cmd, struct frame *fp,
+    fido_deadline_t *dl)
 {
-	do {
-		if (rx_frame(d, fp, ms) < 0)
+	if (d->rx_pending_len != 0) {
+		/* frame already read by fido_rx_poll() */
+		memset(fp, 0, sizeof(*fp));
+		memcpy(fp, d->rx_pending, MIN(d->rx_pending_len, sizeof(*fp)));
+		d->rx_pending_len = 0;
+	} else do {
+		if (rx_frame(d, fp, dl) < 0)
 			return (-1);
 #ifdef FIDO_FUZZ
 		fp->cid = d->cid;
 #endif
+		if (fp->cid == d->cid &&
+		    fp->body.init.cmd == (CTAP_FRAME_INIT | CTAP_KEEPALIVE))
+			rx_keepalive(d, fp);
 	} while (fp->cid != d->cid || (fp->cid == d->cid &&
 	    fp->body.init.cmd == (CTAP_FRAME_INIT | CTAP_KEEPALIVE)));
 
 	if (d->rx_len > sizeof(*fp))
 		return (-1);
 
-	fido_log_xxd(fp, d->rx_len, "%s", __func__);
+	fido_log_frame_xxd(fp, d->rx_len, "%s", __func__);
 #ifdef FIDO_FUZZ
 	fp->body.init.cmd = (CTAP_FRAME_INIT | cmd);
 #endif
 
+	if (fp->body.init.cmd == (CTAP_FRAME_INIT | CTAP_CMD_ERROR) &&
+	    fp->body.init.data[0] == FIDO_ERR_INVALID_CHANNEL) {
+		fido_log_debug("%s: invalid channel 0x%x", __func__, d->cid);
+		fido_dev_invalidate_channel(d);
+		return (-1);
+	}
+
 	if (fp->cid != d->cid || fp->body.init.cmd != (CTAP_FRAME_INIT | cmd)) {
 		fido_log_debug("%s: cid (0x%x, 0x%x), cmd (0x%02x, 0x%02x)",
 		    __func__, fp->cid, d->cid, fp->body.init.cmd, cmd);
@@ -225,28 +423,105 @@ rx_preamble(fido_dev_t *d, uint8_t cmd, struct frame *fp, int *ms)
 }
 
 static int
-rx(fido_dev_t *d, uint8_t cmd, unsigned char *buf, size_t count, int *ms)
+rx_cont_check(const fido_dev_t *d, uint32_t cid, uint8_t seq, int expected)
+{
+	if (cid != d->cid || seq != expected) {
+		fido_log_debug("%s: cid (0x%x, 0x%x), seq (%d, %d)", __func__,
+		    cid, d->cid, seq, expected);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * Read a continuation frame into 'fp' and copy its payload to buf + off;
+ * used when buf cannot hold a full report at off.
+ */
+static int
+rx_cont(fido_dev_t *d, struct frame *fp, unsigned char *buf, size_t off,
+    size_t payload_len, int seq, fido_deadline_t *dl)
+{
+	if (rx_frame(d, fp, dl) < 0) {
+		fido_log_debug("%s: rx_frame", __func__);
+		return (-1);
+	}
+
+	fido_log_frame_xxd(fp, d->rx_len, "%s", __func__);
+#ifdef FIDO_FUZZ
+	fp->cid = d->cid;
+	fp->body.cont.seq = (uint8_t)seq;
+#endif
+	if (rx_cont_check(d, fp->cid, fp->body.cont.seq, seq) < 0)
+		return (-1);
+
+	memcpy(buf + off, fp->body.cont.data, MIN(payload_len - off,
+	    d->rx_len - CTAP_CONT_HEADER_LEN));
+
+	return (0);
+}
+
+/*
+ * Read a continuation frame straight into buf, so that its payload
+ * lands at buf + off. The frame header overwrites the CTAP_CONT_HEADER_LEN
+ * bytes preceding off, which are saved and restored around the read.
+ */
+static int
+rx_cont_direct(fido_dev_t *d, unsigned char *buf, size_t off, int seq,
+    fido_deadline_t *dl)
 {
-	struct frame f;
+	unsigned char	 hdr[CTAP_CONT_HEADER_LEN];
+	unsigned char	*ptr = buf + off - sizeof(hdr);
+	uint32_t	 cid = 0;
+	uint8_t		 fseq = 0;
+	int		 ok;
+
+	memcpy(hdr, ptr, sizeof(hdr));
+	if ((ok = rx_report(d, ptr, dl)) == 0) {
+		fido_log_frame_xxd(ptr, d->rx_len, "%s", __func__);
+		memcpy(&cid, ptr, sizeof(cid));
+		fseq = ptr[sizeof(cid)];
+	}
+	memcpy(ptr, hdr, sizeof(hdr));
+
+	if (ok < 0) {
+		fido_log_debug("%s: rx_report", __func__);
+		return (-1);
+	}
+#ifdef FIDO_FUZZ
+	cid = d->cid;
+	fseq = (uint8_t)seq;
+#endif
+
+	return (rx_cont_check(d, cid, fseq, seq));
+}
+
+static int
+rx(fido_dev_t *d, uint8_t cmd, unsigned char *buf, size_t count,
+    fido_deadline_t *dl)
+{
+	/* frames are too large for the stack; use the device's scratch */
+	struct frame *f = (struct frame *)d->rx_frame;
 	size_t r, payload_len, init_data_len, cont_data_len;
 
-	if (d->rx_len <= CTAP_INIT_HEADER_LEN ||
+	if (sizeof(*f) > sizeof(d->rx_frame) ||
+	    d->rx_len <= CTAP_INIT_HEADER_LEN ||
 	    d->rx_len <= CTAP_CONT_HEADER_LEN)
 		return (-1);
 
 	init_data_len = d->rx_len - CTAP_INIT_HEADER_LEN;
 	cont_data_len = d->rx_len - CTAP_CONT_HEADER_LEN;
 
-	if (init_data_len > sizeof(f.body.init.data) ||
-	    cont_data_len > sizeof(f.body.cont.data))
+	if (init_data_len > sizeof(f->body.init.data) ||
+	    cont_data_len > sizeof(f->body.cont.data))
 		return (-1);
 
-	if (rx_preamble(d, cmd, &f, ms) < 0) {
+	if (rx_preamble(d, cmd, f, dl) < 0) {
 		fido_log_debug("%s: rx_preamble", __func__);
 		return (-1);
 	}
 
-	payload_len = (size_t)((f.body.init.bcnth << 8) | f.body.init.bcntl);
+	payload_len = (size_t)((f->body.init.bcnth << 8) | f->body.init.bcntl);
 	fido_log_debug("%s: payload_len=%zu", __func__, payload_len);
 
 	if (count < payload_len) {
@@ -255,93 +530,221 @@ rx(fido_dev_t *d, uint8_t cmd, unsigned char *buf, size_t count, int *ms)
 	}
 
 	if (payload_len < init_data_len) {
-		memcpy(buf, f.body.init.data, payload_len);
+		memcpy(buf, f->body.init.data, payload_len);
 		return ((int)payload_len);
 	}
 
-	memcpy(buf, f.body.init.data, init_data_len);
+	memcpy(buf, f->body.init.data, init_data_len);
 	r = init_data_len;
 
 	for (int seq = 0; r < payload_len; seq++) {
-		if (rx_frame(d, &f, ms) < 0) {
-			fido_log_debug("%s: rx_frame", __func__);
-			return (-1);
-		}
-
-		fido_log_xxd(&f, d->rx_len, "%s", __func__);
-#ifdef FIDO_FUZZ
-		f.cid = d->cid;
-		f.body.cont.seq = (uint8_t)seq;
-#endif
-
-		if (f.cid != d->cid || f.body.cont.seq != seq) {
-			fido_log_debug("%s: cid (0x%x, 0x%x), seq (%d, %d)",
-			    __func__, f.cid, d->cid, f.body.cont.seq, seq);
-			return (-1);
-		}
-
-		if (payload_len - r > cont_data_len) {
-			memcpy(buf + r, f.body.cont.data, cont_data_len);
-			r += cont_data_len;
+		if (r >= CTAP_CONT_HEADER_LEN && r + cont_data_len <= count) {
+			if (rx_cont_direct(d, buf, r, seq, dl) < 0)
+				return (-1);
 		} else {
-			memcpy(buf + r, f.body.cont.data, payload_len - r);
-			r += payload_len - r; /* break */
+			if (rx_cont(d, f, buf, r, payload_len, seq, dl) < 0)
+				return (-1);
 		}
+		r += MIN(payload_len - r, cont_data_len);
 	}
 
 	return ((int)r);
 }
 
 static int
-transport_rx(fido_dev_t *d, uint8_t cmd, void *buf, size_t count, int *ms)
+transport_rx(fido_dev_t *d, uint8_t cmd, void *buf, size_t count,
+    fido_deadline_t *dl)
 {
-	struct timespec ts;
-	int n;
+	int ms;
 
-	if (fido_time_now(&ts) != 0)
+	if (fido_time_wait(dl, &ms) != 0)
 		return (-1);
 
-	n = d->transport.rx(d, cmd, buf, count, *ms);
+	return (d->transport.rx(d, cmd, buf, count, ms));
+}
 
-	if (fido_time_delta(&ts, ms) != 0)
-		return (-1);
+/*
+ * The authenticator discards or regenerates its pinUvAuthToken and key
+ * agreement on these errors; so must we.
+ */
+static void
+rx_check_token(fido_dev_t *d, const unsigned char *buf, int n)
+{
+	if (n < 1 || (d->token == NULL && d->ecdh == NULL))
+		return;
+
+	switch (buf[0]) {
+	case FIDO_ERR_PIN_INVALID:
+	case FIDO_ERR_PIN_BLOCKED:
+	case FIDO_ERR_PIN_AUTH_INVALID:
+	case FIDO_ERR_PIN_AUTH_BLOCKED:
+	case FIDO_ERR_PIN_NOT_SET:
+	case FIDO_ERR_PIN_REQUIRED:
+	case FIDO_ERR_PIN_TOKEN_EXPIRED:
+	case FIDO_ERR_UV_BLOCKED:
+	case FIDO_ERR_UV_INVALID:
+	case FIDO_ERR_UNAUTHORIZED_PERM:
+		fido_log_debug("%s: 0x%02x", __func__, buf[0]);
+		fido_dev_token_cache_reset(d);
+		break;
+	}
+}
 
-	return (n);
+static void
+rx_metrics(fido_dev_t *d, int n)
+{
+	int ms;
+
+	if (d->up_wait && (ms = elapsed_ms(&d->up_ts)) > 0)
+		d->metrics.up_ms += ms;
+
+	d->metrics.rx_len = n;
+	d->metrics.rtt_ms = elapsed_ms(&d->tx_ts);
+	d->metrics_pending = false;
+	d->up_wait = false;
+
+	d->metrics_cb(d->metrics_arg, &d->metrics);
 }
 
 int
 fido_rx(fido_dev_t *d, uint8_t cmd, void *buf, size_t count, int *ms)
 {
-	int n;
+	fido_deadline_t	dl;
+	fido_trace_t	span;
+	fido_prof_t	prof;
+	int		wait;
+	int		left;
+	int		n = -1;
 
 	fido_log_debug("%s: dev=%p, cmd=0x%02x, ms=%d", __func__, (void *)d,
 	    cmd, *ms);
 
-	if (d->transport.rx != NULL)
-		return (transport_rx(d, cmd, buf, count, ms));
-	if (d->io_handle == NULL || d->io.read == NULL || count > UINT16_MAX) {
+	fido_trace_begin(&span, d, __func__, cmd, 0, 0);
+	fido_prof_begin(&prof, FIDO_PROF_RX);
+
+	if (d->transport.rx == NULL && (d->io_handle == NULL ||
+	    d->io.read == NULL || count > UINT16_MAX)) {
 		fido_log_debug("%s: invalid argument", __func__);
-		return (-1);
+		goto out;
 	}
-	if ((n = rx(d, cmd, buf, count, ms)) >= 0)
+	wait = rtt_deadline(d, cmd, *ms);
+	if (fido_time_deadline(&dl, wait, NULL) != 0)
+		goto out;
+
+	if (d->transport.rx != NULL)
+		n = transport_rx(d, cmd, buf, count, &dl);
+	else if ((n = rx(d, cmd, buf, count, &dl)) >= 0)
 		fido_log_xxd(buf, (size_t)n, "%s", __func__);
+	if (fido_time_remain(&dl, &left) != 0)
+		n = -1;
+	else if (wait == *ms)
+		*ms = left;
+	else {
+		if (n < 0 && left == 0)
+			fido_log_debug("%s: adaptive deadline", __func__);
+		/* charge the caller's budget for the time spent */
+		if (*ms > 0)
+			*ms = *ms > wait - left ? *ms - (wait - left) : 0;
+	}
+
+	if (cmd == CTAP_CMD_CBOR && d->rtt_cmd != 0) {
+		if (n >= 0)
+			rtt_record(d);
+		d->rtt_cmd = 0;
+	}
+
+	if (buf == d->msgbuf)
+		fido_dev_msgbuf_dirty(d, count, n);
+	if (cmd == CTAP_CMD_CBOR)
+		rx_check_token(d, buf, n);
+	if (d->metrics_pending)
+		rx_metrics(d, n);
+out:
+	fido_prof_end(&prof, n);
+	if (n >= 0)
+		span.len = (size_t)n;
+	fido_trace_end(&span, n < 0 ? FIDO_ERR_RX : FIDO_OK);
 
 	return (n);
 }
 
+/* whether frames were read ahead of the descriptor or queued for the channel */
+bool
+fido_rx_buffered(const fido_dev_t *d)
+{
+	if (d->chan != NULL && fido_chan_pending(d))
+		return (true);
+#if defined(__linux__) && !defined(USE_HIDAPI)
+	if (d->io.read == fido_hid_read)
+		return (fido_hid_buffered(d->io_handle));
+#else
+	(void)d;
+#endif
+
+	return (false);
+}
+
+int
+fido_rx_poll(fido_dev_t *d, int *ms)
+{
+	fido_deadline_t	dl;
+	struct frame	*f = (struct frame *)d->rx_frame;
+	int		r = 0;
+
+	if (d->rx_pending_len != 0)
+		return (1);
+	if (d->transport.rx != NULL || d->io_handle == NULL ||
+	    d->io.read == NULL || d->rx_len > sizeof(*f)) {
+		fido_log_debug("%s: invalid argument", __func__);
+		return (-1);
+	}
+
+	if (fido_time_deadline(&dl, *ms, NULL) != 0)
+		return (-1);
+
+	/*
+	 * Skip keepalives and foreign frames until the deadline, and past
+	 * it while the backend holds frames it read ahead, which its
+	 * descriptor would not signal.
+	 */
+	do {
+		if (rx_frame(d, f, &dl) < 0)
+			break;
+#ifdef FIDO_FUZZ
+		f->cid = d->cid;
+#endif
+		if (f->cid != d->cid)
+			continue;
+		if (f->body.init.cmd == (CTAP_FRAME_INIT | CTAP_KEEPALIVE)) {
+			rx_keepalive(d, f);
+			continue;
+		}
+		memcpy(d->rx_pending, f, d->rx_len);
+		d->rx_pending_len = d->rx_len;
+		r = 1;
+		break;
+	} while (dl.ms != 0 || fido_rx_buffered(d));
+
+	if (fido_time_remain(&dl, ms) != 0)
+		return (-1);
+
+	return (r);
+}
+
 int
 fido_rx_cbor_status(fido_dev_t *d, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(d, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((msglen = fido_rx(d, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0 ||
+	if ((msglen = fido_rx(d, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0 ||
 	    (size_t)msglen < 1) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
@@ -350,7 +753,7 @@ fido_rx_cbor_status(fido_dev_t *d, int *ms)
 
 	r = msg[0];
 out:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(d, msg, msgsiz);
 
 	return (r);
 }
@@ -7,15 +7,10 @@
 
 #include "fido.h"
 
-iso7816_apdu_t *
-iso7816_new(uint8_t cla, uint8_t ins, uint8_t p1, uint16_t payload_len)
+static iso7816_apdu_t *
+apdu_setup(iso7816_apdu_t *apdu, size_t alloc_len, uint8_t cla, uint8_t ins,
+    uint8_t p1, uint16_t payload_len)
 {
-	iso7816_apdu_t *apdu;
-	size_t alloc_len;
-
-	alloc_len = sizeof(iso7816_apdu_t) + payload_len + 2; /* le1 le2 */
-	if ((apdu = calloc(1, alloc_len)) == NULL)
-		return NULL;
 	apdu->alloc_len = alloc_len;
 	apdu->payload_len = payload_len;
 	apdu->payload_ptr = apdu->payload;
@@ -28,6 +23,39 @@ iso7816_new(uint8_t cla, uint8_t ins, uint8_t p1, uint16_t payload_len)
 	return apdu;
 }
 
+iso7816_apdu_t *
+iso7816_new(uint8_t cla, uint8_t ins, uint8_t p1, uint16_t payload_len)
+{
+	iso7816_apdu_t *apdu;
+	size_t alloc_len;
+
+	alloc_len = sizeof(iso7816_apdu_t) + payload_len + 2; /* le1 le2 */
+	if ((apdu = fido_calloc(1, alloc_len)) == NULL)
+		return NULL;
+	apdu->heap = true;
+
+	return apdu_setup(apdu, alloc_len, cla, ins, p1, payload_len);
+}
+
+/*
+ * Like iso7816_new(), but build the apdu in buf when the payload fits;
+ * larger apdus are allocated. Either way, release with iso7816_free().
+ */
+iso7816_apdu_t *
+iso7816_init(iso7816_buf_t *buf, uint8_t cla, uint8_t ins, uint8_t p1,
+    uint16_t payload_len)
+{
+	size_t alloc_len;
+
+	if (payload_len > ISO7816_BUF_LEN)
+		return iso7816_new(cla, ins, p1, payload_len);
+
+	alloc_len = sizeof(iso7816_apdu_t) + payload_len + 2; /* le1 le2 */
+	memset(buf, 0, alloc_len);
+
+	return apdu_setup(&buf->apdu, alloc_len, cla, ins, p1, payload_len);
+}
+
 void
 iso7816_free(iso7816_apdu_t **apdu_p)
 {
@@ -35,7 +63,10 @@ iso7816_free(iso7816_apdu_t **apdu_p)
 
 	if (apdu_p == NULL || (apdu = *apdu_p) == NULL)
 		return;
-	freezero(apdu, apdu->alloc_len);
+	if (apdu->heap)
+		fido_freezero(apdu, apdu->alloc_len);
+	else
+		explicit_bzero(apdu, apdu->alloc_len);
 	*apdu_p = NULL;
 }
 
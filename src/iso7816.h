@@ -8,6 +8,7 @@
 #ifndef _ISO7816_H
 #define _ISO7816_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -17,6 +18,12 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/* Nc and Ne of an extended-length APDU, as used over NFC. */
+#define ISO7816_EXT_LEN	2048
+
+/* Payload that fits an iso7816_buf_t; enough for any U2F request. */
+#define ISO7816_BUF_LEN	512
+
 PACKED_TYPE(iso7816_header_t,
 struct iso7816_header {
 	uint8_t cla;
@@ -30,14 +37,23 @@ struct iso7816_header {
 
 typedef struct iso7816_apdu {
 	size_t            alloc_len;
+	bool              heap;
 	uint16_t          payload_len;
 	uint8_t          *payload_ptr;
 	iso7816_header_t  header;
 	uint8_t           payload[];
 } iso7816_apdu_t;
 
+/* Storage for iso7816_init(), usually on the caller's stack. */
+typedef union iso7816_buf {
+	iso7816_apdu_t    apdu;
+	unsigned char     buf[sizeof(iso7816_apdu_t) + ISO7816_BUF_LEN + 2];
+} iso7816_buf_t;
+
 const unsigned char *iso7816_ptr(const iso7816_apdu_t *);
 int iso7816_add(iso7816_apdu_t *, const void *, size_t);
+iso7816_apdu_t *iso7816_init(iso7816_buf_t *, uint8_t, uint8_t, uint8_t,
+    uint16_t);
 iso7816_apdu_t *iso7816_new(uint8_t, uint8_t, uint8_t, uint16_t);
 size_t iso7816_len(const iso7816_apdu_t *);
 void iso7816_free(iso7816_apdu_t **);
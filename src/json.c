@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "fido.h"
+
+/*
+ * Readers for the WebAuthn JSON form of a PublicKeyCredential, as produced
+ * by its toJSON() method. The document is read once, front to back; the
+ * base64url members of the response are decoded straight into the
+ * assertion or credential, reusing their buffers, and clientDataJSON is
+ * hashed as it is decoded. Members not needed for verification are
+ * skipped.
+ */
+
+#define JSON_MAXDEPTH	16
+#define JSON_CHUNK	4096	/* clientDataJSON characters per hash update */
+
+struct json {
+	const char	*ptr;
+	size_t		 len;
+	size_t		 off;
+};
+
+typedef int json_member_t(struct json *, int, const char *, size_t, void *);
+
+static int json_skip(struct json *, int);
+
+/* the next character that is not white space; -1 at the end */
+static int
+json_peek(struct json *j)
+{
+	while (j->off < j->len && (j->ptr[j->off] == ' ' ||
+	    j->ptr[j->off] == '\t' || j->ptr[j->off] == '\n' ||
+	    j->ptr[j->off] == '\r'))
+		j->off++;
+	if (j->off == j->len)
+		return (-1);
+
+	return ((unsigned char)j->ptr[j->off]);
+}
+
+static int
+json_expect(struct json *j, int c)
+{
+	if (json_peek(j) != c)
+		return (-1);
+	j->off++;
+
+	return (0);
+}
+
+/* the contents of a string, not unescaped; 'esc' if it has escapes */
+static int
+json_string(struct json *j, const char **ptr, size_t *len, int *esc)
+{
+	unsigned char c;
+
+	if (json_expect(j, '"') < 0)
+		return (-1);
+
+	*esc = 0;
+	for (size_t i = j->off; i < j->len; i++) {
+		if ((c = (unsigned char)j->ptr[i]) == '"') {
+			*ptr = j->ptr + j->off;
+			*len = i - j->off;
+			j->off = i + 1;
+			return (0);
+		}
+		if (c < 0x20)
+			return (-1);
+		if (c == '\\') {
+			if (++i == j->len)
+				return (-1);
+			*esc = 1;
+		}
+	}
+
+	return (-1);
+}
+
+static int
+json_key(const char *key, size_t len, const char *name)
+{
+	return (strlen(name) == len && memcmp(key, name, len) == 0);
+}
+
+/* call 'f' on each member of an object; 'f' reads the member's value */
+static int
+json_object(struct json *j, int depth, void *arg, json_member_t *f)
+{
+	const char	*key;
+	size_t		 len;
+	int		 esc, c;
+
+	if (depth > JSON_MAXDEPTH || json_expect(j, '{') < 0)
+		return (-1);
+	if (json_peek(j) == '}') {
+		j->off++;
+		return (0);
+	}
+
+	for (;;) {
+		if (json_string(j, &key, &len, &esc) < 0 ||
+		    json_expect(j, ':') < 0)
+			return (-1);
+		/* no member of interest is spelt with escapes */
+		if ((esc ? json_skip(j, depth) : f(j, depth, key, len,
+		    arg)) < 0) {
+			fido_log_debug("%s: member at %zu", __func__, j->off);
+			return (-1);
+		}
+		if ((c = json_peek(j)) == '}') {
+			j->off++;
+			return (0);
+		}
+		if (c != ',')
+			return (-1);
+		j->off++;
+	}
+}
+
+static int
+json_skip_member(struct json *j, int depth, const char *key, size_t len,
+    void *arg)
+{
+	(void)key;
+	(void)len;
+	(void)arg;
+
+	return (json_skip(j, depth));
+}
+
+static int
+json_skip_array(struct json *j, int depth)
+{
+	int c;
+
+	if (depth > JSON_MAXDEPTH || json_expect(j, '[') < 0)
+		return (-1);
+	if (json_peek(j) == ']') {
+		j->off++;
+		return (0);
+	}
+
+	for (;;) {
+		if (json_skip(j, depth) < 0)
+			return (-1);
+		if ((c = json_peek(j)) == ']') {
+			j->off++;
+			return (0);
+		}
+		if (c != ',')
+			return (-1);
+		j->off++;
+	}
+}
+
+/* numbers are not validated beyond their alphabet */
+static int
+json_skip_scalar(struct json *j)
+{
+	static const char *const literal[] = { "true", "false", "null" };
+	size_t n;
+
+	for (size_t i = 0; i < nitems(literal); i++) {
+		n = strlen(literal[i]);
+		if (j->len - j->off >= n &&
+		    memcmp(j->ptr + j->off, literal[i], n) == 0) {
+			j->off += n;
+			return (0);
+		}
+	}
+	for (n = j->off; n < j->len; n++)
+		if (strchr("+-.0123456789Ee", j->ptr[n]) == NULL ||
+		    j->ptr[n] == '\0')
+			break;
+	if (n == j->off)
+		return (-1);
+	j->off = n;
+
+	return (0);
+}
+
+static int
+json_skip(struct json *j, int depth)
+{
+	const char	*ptr;
+	size_t		 len;
+	int		 esc;
+
+	switch (json_peek(j)) {
+	case '"':
+		return (json_string(j, &ptr, &len, &esc));
+	case '{':
+		return (json_object(j, depth + 1, NULL, json_skip_member));
+	case '[':
+		return (json_skip_array(j, depth + 1));
+	default:
+		return (json_skip_scalar(j));
+	}
+}
+
+/*
+ * Decode a base64url string into 'b', reusing its buffer. If 'sha' is
+ * set, the bytes are also hashed, a chunk at a time as they are decoded.
+ */
+static int
+json_blob(struct json *j, fido_blob_t *b, EVP_MD_CTX *sha)
+{
+	const char	*ptr;
+	size_t		 len, n, out_len;
+	int		 esc;
+
+	if (json_string(j, &ptr, &len, &esc) < 0 || esc || len == 0)
+		return (-1);
+
+	fido_blob_clear(b);
+	if (fido_blob_reserve(b, len) < 0)
+		return (-1);
+
+	for (size_t i = 0; i < len; i += n) {
+		n = sha != NULL && len - i > JSON_CHUNK ? JSON_CHUNK : len - i;
+		/* padding may only end the string */
+		if (i + n < len && ptr[i + n - 1] == '=')
+			return (-1);
+		out_len = len - i; /* at least what is left to decode */
+		if (fido_base64_decode(ptr + i, n, b->ptr + b->len, &out_len,
+		    FIDO_BASE64_URL) != FIDO_OK)
+			return (-1);
+		if (sha != NULL && fido_sha256_update(sha, b->ptr + b->len,
+		    out_len) < 0)
+			return (-1);
+		b->len += out_len;
+	}
+
+	return (b->len == 0 ? -1 : 0);
+}
+
+/* decode clientDataJSON into 'cd', and its sha256 into 'cdh' */
+static int
+json_clientdata(struct json *j, fido_blob_t *cd, fido_blob_t *cdh)
+{
+	EVP_MD_CTX *ctx = NULL;
+
+	if (fido_sha256_init(&ctx) < 0)
+		return (-1);
+	if (json_blob(j, cd, ctx) < 0) {
+		fido_log_debug("%s: json_blob", __func__);
+		EVP_MD_CTX_free(ctx);
+		return (-1);
+	}
+
+	return (fido_sha256_final(&ctx, cdh));
+}
+
+static int
+json_type(struct json *j)
+{
+	const char	*ptr;
+	size_t		 len;
+	int		 esc;
+
+	if (json_string(j, &ptr, &len, &esc) < 0 || esc ||
+	    !json_key(ptr, len, "public-key"))
+		return (-1);
+
+	return (0);
+}
+
+static int
+assert_response(struct json *j, int depth, const char *key, size_t len,
+    void *arg)
+{
+	fido_assert_t		*assert = arg;
+	fido_assert_stmt	*stmt = &assert->stmt[0];
+
+	if (json_key(key, len, "clientDataJSON"))
+		return (json_clientdata(j, &assert->cd, &assert->cdh));
+	if (json_key(key, len, "authenticatorData")) {
+		if (json_blob(j, &stmt->authdata_raw, NULL) < 0 ||
+		    fido_assert_decode_authdata(stmt) != FIDO_OK)
+			return (-1);
+		return (0);
+	}
+	if (json_key(key, len, "signature"))
+		return (json_blob(j, &stmt->sig, NULL));
+	if (json_key(key, len, "userHandle") && json_peek(j) != 'n')
+		return (json_blob(j, &stmt->user.id, NULL));
+
+	return (json_skip(j, depth));
+}
+
+static int
+assert_member(struct json *j, int depth, const char *key, size_t len,
+    void *arg)
+{
+	fido_assert_t *assert = arg;
+
+	if (json_key(key, len, "response"))
+		return (json_object(j, depth + 1, assert, assert_response));
+	if (json_key(key, len, "rawId"))
+		return (json_blob(j, &assert->stmt[0].id, NULL));
+	if (json_key(key, len, "type"))
+		return (json_type(j));
+
+	return (json_skip(j, depth));
+}
+
+static int
+cred_response(struct json *j, int depth, const char *key, size_t len,
+    void *arg)
+{
+	fido_cred_t	*cred = arg;
+	fido_blob_t	 attobj;
+	int		 ok = -1;
+
+	if (json_key(key, len, "clientDataJSON"))
+		return (json_clientdata(j, &cred->cd, &cred->cdh));
+	if (!json_key(key, len, "attestationObject"))
+		return (json_skip(j, depth));
+
+	/* the attestation object is cbor, parsed once decoded */
+	memset(&attobj, 0, sizeof(attobj));
+	if (json_blob(j, &attobj, NULL) == 0 &&
+	    fido_cred_set_attobj(cred, attobj.ptr, attobj.len) == FIDO_OK)
+		ok = 0;
+	fido_blob_reset(&attobj);
+
+	return (ok);
+}
+
+static int
+cred_member(struct json *j, int depth, const char *key, size_t len,
+    void *arg)
+{
+	if (json_key(key, len, "response"))
+		return (json_object(j, depth + 1, arg, cred_response));
+	if (json_key(key, len, "type"))
+		return (json_type(j));
+
+	return (json_skip(j, depth));
+}
+
+int
+fido_assert_from_webauthn_json(fido_assert_t *assert, const char *ptr,
+    size_t len)
+{
+	struct json		 j;
+	fido_assert_stmt	*stmt;
+	int			 r;
+
+	if (ptr == NULL || len == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	fido_blob_reset(&assert->cd);
+	fido_blob_reset(&assert->cdh);
+	if ((r = fido_assert_set_count(assert, 0)) != FIDO_OK ||
+	    (r = fido_assert_set_count(assert, 1)) != FIDO_OK)
+		return (r);
+
+	memset(&j, 0, sizeof(j));
+	j.ptr = ptr;
+	j.len = len;
+	stmt = &assert->stmt[0];
+
+	if (json_object(&j, 0, assert, assert_member) < 0 ||
+	    json_peek(&j) != -1 || fido_blob_is_empty(&assert->cdh) ||
+	    fido_blob_is_empty(&stmt->authdata_raw) ||
+	    fido_blob_is_empty(&stmt->sig)) {
+		fido_log_debug("%s: invalid json at %zu", __func__, j.off);
+		fido_blob_reset(&assert->cd);
+		fido_blob_reset(&assert->cdh);
+		(void)fido_assert_set_count(assert, 0);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	return (FIDO_OK);
+}
+
+int
+fido_cred_from_webauthn_json(fido_cred_t *cred, const char *ptr, size_t len)
+{
+	struct json j;
+
+	if (ptr == NULL || len == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	fido_blob_reset(&cred->cd);
+	fido_blob_reset(&cred->cdh);
+	fido_cred_reset_rx(cred);
+
+	memset(&j, 0, sizeof(j));
+	j.ptr = ptr;
+	j.len = len;
+
+	if (json_object(&j, 0, cred, cred_member) < 0 ||
+	    json_peek(&j) != -1 || fido_blob_is_empty(&cred->cdh) ||
+	    cred->fmt == NULL || fido_blob_is_empty(&cred->authdata_raw)) {
+		fido_log_debug("%s: invalid json at %zu", __func__, j.off);
+		fido_blob_reset(&cred->cd);
+		fido_blob_reset(&cred->cdh);
+		fido_cred_reset_rx(cred);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	return (FIDO_OK);
+}
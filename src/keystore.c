@@ -0,0 +1,679 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#endif
+
+#include <openssl/sha.h>
+
+#include <errno.h>
+#include <stdio.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "fido.h"
+#include "fido/credman.h"
+
+/*
+ * A read-only file of credential public keys, looked up by credential
+ * id. The file starts with a header, followed by an index sorted by the
+ * sha256 of the credential id, followed by the keys in their raw form:
+ *
+ *   header:   "fido2ks1" | count (be32) | zero (be32)
+ *   index:    count * { sha256(id)[32] | cose_alg (be32) | offset (be64) }
+ *   keys:     es256: x|y, es384: x|y, rs256: n|e, eddsa: x; zero padded
+ *             to a multiple of four bytes
+ *   counters: count * signature counter (be32), in index order
+ *
+ * The file is mapped read-only and shared, so workers that open the
+ * same file share its pages. A lookup is a binary search of the index,
+ * with no parsing of the key. If the file is writable, the counters
+ * are also mapped writable, and updated in place with atomic
+ * compare-and-swap; they are the only part of the file ever modified.
+ */
+
+#define KS_MAGIC	"fido2ks1"
+#define KS_HDR_LEN	16
+#define KS_IDX_LEN	(SHA256_DIGEST_LENGTH + 4 + 8)
+#define KS_CTR_LEN	4
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ctr_load(p)	((uint32_t)_InterlockedOr((volatile long *)(p), 0))
+#define ctr_cas(p, o, n) \
+	((uint32_t)_InterlockedCompareExchange((volatile long *)(p), \
+	    (long)(n), (long)(o)) == (o))
+#else
+#define ctr_load(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ctr_cas(p, o, n) \
+	__atomic_compare_exchange_n((p), &(o), (n), false, __ATOMIC_ACQ_REL, \
+	    __ATOMIC_ACQUIRE)
+#endif
+
+struct keystore_entry {
+	unsigned char	hash[SHA256_DIGEST_LENGTH];
+	int		cose_alg;
+	size_t		off; /* in keys */
+};
+
+static size_t
+ks_raw_len(int cose_alg)
+{
+	switch (cose_alg) {
+	case COSE_ES256:
+		return (sizeof(es256_pk_t));
+	case COSE_ES384:
+		return (sizeof(es384_pk_t));
+	case COSE_RS256:
+		return (sizeof(rs256_pk_t));
+	case COSE_EDDSA:
+		return (sizeof(eddsa_pk_t));
+	default:
+		return (0);
+	}
+}
+
+static void
+ks_put_be32(unsigned char *p, uint32_t v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static uint32_t
+ks_get_be32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | (uint32_t)p[3]);
+}
+
+static int
+ks_entry_cmp(const void *a, const void *b)
+{
+	return (memcmp(a, b, SHA256_DIGEST_LENGTH));
+}
+
+static void
+ks_unmap(fido_keystore_t *ks)
+{
+	if (ks->map == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(ks->map);
+	if (ks->ctr_map != NULL)
+		UnmapViewOfFile(ks->ctr_map);
+#else
+	munmap((void *)(uintptr_t)ks->map, ks->map_len);
+	if (ks->ctr_map != NULL)
+		munmap(ks->ctr_map, ks->map_len);
+#endif
+	ks->map = NULL;
+	ks->ctr_map = NULL;
+	ks->map_len = 0;
+	ks->ctr_off = 0;
+	ks->count = 0;
+}
+
+/* the index position of 'hash' in the opened store; -1 if not there */
+static int64_t
+ks_find(const fido_keystore_t *ks, const unsigned char *hash)
+{
+	const unsigned char *idx;
+
+	if (ks->map == NULL || (idx = bsearch(hash, ks->map + KS_HDR_LEN,
+	    ks->count, KS_IDX_LEN, ks_entry_cmp)) == NULL)
+		return (-1);
+
+	return ((int64_t)((size_t)(idx - ks->map - KS_HDR_LEN) / KS_IDX_LEN));
+}
+
+/* the counter at index position 'i', as stored */
+static uint32_t
+ks_ctr_get(const fido_keystore_t *ks, size_t i)
+{
+	const uint32_t *p;
+
+	p = (const uint32_t *)(const void *)(ks->map + ks->ctr_off +
+	    i * KS_CTR_LEN);
+
+	return (ctr_load(p));
+}
+
+fido_keystore_t *
+fido_keystore_new(void)
+{
+	return (fido_calloc(1, sizeof(fido_keystore_t)));
+}
+
+void
+fido_keystore_free(fido_keystore_t **ks_p)
+{
+	fido_keystore_t *ks;
+
+	if (ks_p == NULL || (ks = *ks_p) == NULL)
+		return;
+	ks_unmap(ks);
+	fido_free(ks->entry);
+	fido_free(ks->keys);
+	fido_free(ks);
+
+	*ks_p = NULL;
+}
+
+/* room for 'n' more entries with 'keys_len' more bytes of keys */
+static int
+ks_reserve(fido_keystore_t *ks, size_t n, size_t keys_len)
+{
+	struct keystore_entry	*e;
+	unsigned char		*keys;
+	size_t			 cap;
+
+	if (n > UINT32_MAX - ks->entry_len ||
+	    keys_len > SIZE_MAX - ks->keys_len)
+		return (FIDO_ERR_INTERNAL);
+
+	if (ks->entry_len + n > ks->entry_cap) {
+		cap = ks->entry_cap == 0 ? 64 : ks->entry_cap * 2;
+		if (cap < ks->entry_len + n)
+			cap = ks->entry_len + n;
+		if ((e = fido_recallocarray(ks->entry, ks->entry_cap, cap,
+		    sizeof(*e))) == NULL)
+			return (FIDO_ERR_INTERNAL);
+		ks->entry = e;
+		ks->entry_cap = cap;
+	}
+	if (ks->keys_len + keys_len > ks->keys_cap) {
+		cap = ks->keys_cap == 0 ? 4096 : ks->keys_cap * 2;
+		if (cap < ks->keys_len + keys_len)
+			cap = ks->keys_len + keys_len;
+		if ((keys = fido_recallocarray(ks->keys, ks->keys_cap, cap,
+		    1)) == NULL)
+			return (FIDO_ERR_INTERNAL);
+		ks->keys = keys;
+		ks->keys_cap = cap;
+	}
+
+	return (FIDO_OK);
+}
+
+/* append a key to the room made by ks_reserve() */
+static int
+ks_append(fido_keystore_t *ks, const unsigned char *id, size_t id_len,
+    int cose_alg, const void *pk, size_t raw_len)
+{
+	struct keystore_entry *e = &ks->entry[ks->entry_len];
+
+	if (fido_sha256_buf(id, id_len, e->hash) < 0) {
+		fido_log_debug("%s: sha256", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+	e->cose_alg = cose_alg;
+	e->off = ks->keys_len;
+	memcpy(ks->keys + ks->keys_len, pk, raw_len);
+	ks->keys_len += raw_len;
+	ks->entry_len++;
+
+	return (FIDO_OK);
+}
+
+int
+fido_keystore_add(fido_keystore_t *ks, const unsigned char *id, size_t id_len,
+    int cose_alg, const void *pk)
+{
+	size_t	raw_len;
+	int	r;
+
+	if (id == NULL || id_len == 0 || pk == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if ((raw_len = ks_raw_len(cose_alg)) == 0) {
+		fido_log_debug("%s: unsupported cose_alg %d", __func__,
+		    cose_alg);
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+	}
+	if ((r = ks_reserve(ks, 1, raw_len)) != FIDO_OK)
+		return (r);
+
+	return (ks_append(ks, id, id_len, cose_alg, pk, raw_len));
+}
+
+/*
+ * The credential's key is added as decoded, from the attested credential
+ * data or a credman reply; no conversion is needed.
+ */
+int
+fido_keystore_add_cred(fido_keystore_t *ks, const fido_cred_t *cred)
+{
+	const fido_attcred_t *ac = &cred->attcred;
+
+	return (fido_keystore_add(ks, ac->id.ptr, ac->id.len, ac->type,
+	    &ac->pubkey));
+}
+
+/*
+ * All of the resident credentials in 'rk', or none: they are checked,
+ * and room is made for them, before the first is added.
+ */
+int
+fido_keystore_add_rk(fido_keystore_t *ks, const fido_credman_rk_t *rk)
+{
+	const fido_attcred_t	*ac;
+	size_t			 entry_len, keys_len, raw_len;
+	int			 r;
+
+	keys_len = 0;
+	for (size_t i = 0; i < rk->n_rx; i++) {
+		ac = &rk->ptr[i].attcred;
+		if (ac->id.ptr == NULL || ac->id.len == 0)
+			return (FIDO_ERR_INVALID_ARGUMENT);
+		if ((raw_len = ks_raw_len(ac->type)) == 0) {
+			fido_log_debug("%s: unsupported cose_alg %d", __func__,
+			    ac->type);
+			return (FIDO_ERR_UNSUPPORTED_OPTION);
+		}
+		keys_len += raw_len; /* bounded by rk's memory */
+	}
+	if ((r = ks_reserve(ks, rk->n_rx, keys_len)) != FIDO_OK)
+		return (r);
+
+	entry_len = ks->entry_len;
+	keys_len = ks->keys_len;
+	for (size_t i = 0; i < rk->n_rx; i++) {
+		ac = &rk->ptr[i].attcred;
+		if ((r = ks_append(ks, ac->id.ptr, ac->id.len, ac->type,
+		    &ac->pubkey, ks_raw_len(ac->type))) != FIDO_OK) {
+			ks->entry_len = entry_len;
+			ks->keys_len = keys_len;
+			return (r);
+		}
+	}
+
+	return (FIDO_OK);
+}
+
+static int
+ks_write(FILE *f, const fido_keystore_t *ks)
+{
+	unsigned char	hdr[KS_HDR_LEN];
+	unsigned char	idx[KS_IDX_LEN];
+	uint64_t	off;
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, KS_MAGIC, 8);
+	ks_put_be32(hdr + 8, (uint32_t)ks->entry_len);
+	if (fwrite(hdr, sizeof(hdr), 1, f) != 1)
+		return (-1);
+
+	for (size_t i = 0; i < ks->entry_len; i++) {
+		const struct keystore_entry *e = &ks->entry[i];
+		off = KS_HDR_LEN + (uint64_t)ks->entry_len * KS_IDX_LEN +
+		    e->off;
+		memcpy(idx, e->hash, sizeof(e->hash));
+		ks_put_be32(idx + 32, (uint32_t)e->cose_alg);
+		ks_put_be32(idx + 36, (uint32_t)(off >> 32));
+		ks_put_be32(idx + 40, (uint32_t)off);
+		if (fwrite(idx, sizeof(idx), 1, f) != 1)
+			return (-1);
+	}
+
+	if (ks->keys_len > 0 && fwrite(ks->keys, ks->keys_len, 1, f) != 1)
+		return (-1);
+	memset(hdr, 0, sizeof(hdr));
+	if (ks->keys_len % KS_CTR_LEN != 0 && fwrite(hdr, KS_CTR_LEN -
+	    ks->keys_len % KS_CTR_LEN, 1, f) != 1)
+		return (-1);
+
+	/* counters are carried over from the opened store */
+	for (size_t i = 0; i < ks->entry_len; i++) {
+		int64_t		j;
+		uint32_t	ctr = 0;
+
+		if ((j = ks_find(ks, ks->entry[i].hash)) >= 0)
+			ctr = ks_ctr_get(ks, (size_t)j);
+		if (fwrite(&ctr, sizeof(ctr), 1, f) != 1)
+			return (-1);
+	}
+
+	return (0);
+}
+
+int
+fido_keystore_write(fido_keystore_t *ks, const char *path)
+{
+	FILE	*f = NULL;
+	char	*tmp = NULL;
+	int	 r = FIDO_ERR_INTERNAL;
+#ifndef _WIN32
+	size_t	 len;
+	int	 fd;
+#endif
+
+	if (path == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	qsort(ks->entry, ks->entry_len, sizeof(*ks->entry), ks_entry_cmp);
+	for (size_t i = 1; i < ks->entry_len; i++)
+		if (ks_entry_cmp(&ks->entry[i - 1], &ks->entry[i]) == 0) {
+			fido_log_debug("%s: duplicate id", __func__);
+			return (FIDO_ERR_INVALID_ARGUMENT);
+		}
+
+#ifdef _WIN32
+	/* a store mapped by another process cannot be truncated */
+	if ((f = fopen(path, "wb")) == NULL) {
+		fido_log_error(errno, "%s: fopen", __func__);
+		goto fail;
+	}
+#else
+	/* replaced by rename(), so mapped copies of the old one stay valid */
+	len = strlen(path) + sizeof(".XXXXXX");
+	if ((tmp = fido_calloc(1, len)) == NULL)
+		goto fail;
+	snprintf(tmp, len, "%s.XXXXXX", path);
+	if ((fd = mkstemp(tmp)) < 0) {
+		fido_log_error(errno, "%s: mkstemp", __func__);
+		fido_free(tmp);
+		tmp = NULL;
+		goto fail;
+	}
+	if (fchmod(fd, 0644) != 0 || (f = fdopen(fd, "wb")) == NULL) {
+		fido_log_error(errno, "%s: fdopen", __func__);
+		close(fd);
+		goto fail;
+	}
+#endif
+	if (ks_write(f, ks) < 0 || fflush(f) != 0) {
+		fido_log_error(errno, "%s: fwrite", __func__);
+		goto fail;
+	}
+	if (fclose(f) != 0) {
+		fido_log_error(errno, "%s: fclose", __func__);
+		f = NULL;
+		goto fail;
+	}
+	f = NULL;
+#ifndef _WIN32
+	if (rename(tmp, path) != 0) {
+		fido_log_error(errno, "%s: rename", __func__);
+		goto fail;
+	}
+	fido_free(tmp);
+	tmp = NULL;
+#endif
+
+	r = FIDO_OK;
+fail:
+	if (f != NULL)
+		fclose(f);
+	if (tmp != NULL) {
+		(void)remove(tmp);
+		fido_free(tmp);
+	}
+
+	return (r);
+}
+
+/* the file at 'path', read-only, and writable in *rw if possible */
+static const unsigned char *
+ks_map(const char *path, size_t *len, unsigned char **rw)
+{
+#ifdef _WIN32
+	HANDLE		 file, mapping;
+	LARGE_INTEGER	 size;
+	DWORD		 share = FILE_SHARE_READ | FILE_SHARE_WRITE;
+	void		*p = NULL;
+	bool		 writable = true;
+
+	*rw = NULL;
+	if ((file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, share,
+	    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) ==
+	    INVALID_HANDLE_VALUE) {
+		writable = false;
+		file = CreateFileA(path, GENERIC_READ, share, NULL,
+		    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	}
+	if (file == INVALID_HANDLE_VALUE) {
+		fido_log_debug("%s: CreateFileA", __func__);
+		return (NULL);
+	}
+	if (GetFileSizeEx(file, &size) == 0 || size.QuadPart < KS_HDR_LEN ||
+	    (unsigned long long)size.QuadPart > SIZE_MAX) {
+		fido_log_debug("%s: GetFileSizeEx", __func__);
+		CloseHandle(file);
+		return (NULL);
+	}
+	if ((mapping = CreateFileMappingA(file, NULL, writable ?
+	    PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL)) != NULL) {
+		p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (p != NULL && writable)
+			*rw = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+	if (p == NULL) {
+		fido_log_debug("%s: MapViewOfFile", __func__);
+		return (NULL);
+	}
+	*len = (size_t)size.QuadPart;
+
+	return (p);
+#else
+	struct stat	 st;
+	void		*p, *w;
+	int		 fd, writable = 1;
+
+	*rw = NULL;
+	if ((fd = open(path, O_RDWR | O_CLOEXEC)) < 0 &&
+	    (errno == EACCES || errno == EPERM || errno == EROFS)) {
+		writable = 0;
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+	}
+	if (fd < 0) {
+		fido_log_error(errno, "%s: open", __func__);
+		return (NULL);
+	}
+	if (fstat(fd, &st) != 0 || st.st_size < KS_HDR_LEN ||
+	    (unsigned long long)st.st_size > SIZE_MAX) {
+		fido_log_debug("%s: fstat", __func__);
+		close(fd);
+		return (NULL);
+	}
+	p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p != MAP_FAILED && writable) {
+		if ((w = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, 0)) == MAP_FAILED)
+			fido_log_error(errno, "%s: mmap", __func__);
+		else
+			*rw = w;
+	}
+	close(fd);
+	if (p == MAP_FAILED) {
+		fido_log_error(errno, "%s: mmap", __func__);
+		return (NULL);
+	}
+#ifdef MADV_RANDOM
+	/* lookups touch a few pages anywhere in the file */
+	(void)madvise(p, (size_t)st.st_size, MADV_RANDOM);
+#endif
+	*len = (size_t)st.st_size;
+
+	return (p);
+#endif /* _WIN32 */
+}
+
+int
+fido_keystore_open(fido_keystore_t *ks, const char *path)
+{
+	size_t count;
+
+	ks_unmap(ks);
+
+	if (path == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if ((ks->map = ks_map(path, &ks->map_len, &ks->ctr_map)) == NULL) {
+		ks->map_len = 0;
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	count = ks_get_be32(ks->map + 8);
+	if (memcmp(ks->map, KS_MAGIC, 8) != 0 ||
+	    ks_get_be32(ks->map + 12) != 0 ||
+	    count > (ks->map_len - KS_HDR_LEN) / (KS_IDX_LEN + KS_CTR_LEN) ||
+	    (ks->map_len - count * KS_CTR_LEN) % KS_CTR_LEN != 0) {
+		fido_log_debug("%s: invalid store", __func__);
+		ks_unmap(ks);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	ks->count = count;
+	ks->ctr_off = ks->map_len - count * KS_CTR_LEN;
+
+	return (FIDO_OK);
+}
+
+size_t
+fido_keystore_count(const fido_keystore_t *ks)
+{
+	return (ks->count);
+}
+
+static int
+ks_lookup(const fido_keystore_t *ks, const unsigned char *id, size_t id_len,
+    size_t *pos)
+{
+	unsigned char	hash[SHA256_DIGEST_LENGTH];
+	int64_t		i;
+
+	if (ks->map == NULL)
+		return (FIDO_ERR_NOT_ALLOWED);
+	if (fido_sha256_buf(id, id_len, hash) < 0) {
+		fido_log_debug("%s: sha256", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+	if ((i = ks_find(ks, hash)) < 0)
+		return (FIDO_ERR_NO_CREDENTIALS);
+	*pos = (size_t)i;
+
+	return (FIDO_OK);
+}
+
+int
+fido_keystore_get_pk(const fido_keystore_t *ks, const unsigned char *id,
+    size_t id_len, fido_pk_t *pk)
+{
+	const unsigned char	*idx;
+	uint64_t		 off;
+	size_t			 pos, raw_len;
+	int			 cose_alg, r;
+
+	if (id == NULL || id_len == 0 || pk == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	fido_pk_reset(pk);
+	if ((r = ks_lookup(ks, id, id_len, &pos)) != FIDO_OK)
+		return (r);
+
+	idx = ks->map + KS_HDR_LEN + pos * KS_IDX_LEN;
+	cose_alg = (int)ks_get_be32(idx + 32);
+	off = (uint64_t)ks_get_be32(idx + 36) << 32 | ks_get_be32(idx + 40);
+	if ((raw_len = ks_raw_len(cose_alg)) == 0 || off > ks->ctr_off ||
+	    raw_len > ks->ctr_off - off) {
+		fido_log_debug("%s: invalid entry", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	/* the raw keys are byte arrays, and need no alignment */
+	return (fido_pk_set(pk, cose_alg, ks->map + off));
+}
+
+int
+fido_keystore_get_sigcount(const fido_keystore_t *ks,
+    const unsigned char *id, size_t id_len, uint32_t *sigcount)
+{
+	size_t	pos;
+	int	r;
+
+	if (id == NULL || id_len == 0 || sigcount == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if ((r = ks_lookup(ks, id, id_len, &pos)) != FIDO_OK)
+		return (r);
+	*sigcount = be32toh(ks_ctr_get(ks, pos));
+
+	return (FIDO_OK);
+}
+
+/*
+ * Record 'sigcount' if it is greater than the stored counter. A counter
+ * that does not advance means the credential may have been cloned,
+ * unless both are zero: the authenticator keeps no counter.
+ */
+int
+fido_keystore_update_sigcount(const fido_keystore_t *ks,
+    const unsigned char *id, size_t id_len, uint32_t sigcount)
+{
+	uint32_t	*p;
+	uint32_t	 cur, next = htobe32(sigcount);
+	size_t		 pos;
+	int		 r;
+
+	if (id == NULL || id_len == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if ((r = ks_lookup(ks, id, id_len, &pos)) != FIDO_OK)
+		return (r);
+	if (ks->ctr_map == NULL) {
+		fido_log_debug("%s: read-only store", __func__);
+		return (FIDO_ERR_NOT_ALLOWED);
+	}
+
+	p = (uint32_t *)(void *)(ks->ctr_map + ks->ctr_off +
+	    pos * KS_CTR_LEN);
+	for (;;) {
+		cur = ctr_load(p);
+		if (sigcount == 0 && cur == 0)
+			return (FIDO_OK);
+		if (sigcount <= be32toh(cur)) {
+			fido_log_debug("%s: sigcount %u <= %u", __func__,
+			    sigcount, be32toh(cur));
+			return (FIDO_ERR_SIGCOUNT);
+		}
+		if (ctr_cas(p, cur, next))
+			return (FIDO_OK);
+	}
+}
+
+int
+fido_assert_verify_keystore(const fido_assert_t *assert, size_t idx,
+    const fido_keystore_t *ks)
+{
+	const unsigned char	*id;
+	size_t			 id_len;
+	fido_pk_t		 pk;
+	int			 r;
+
+	if ((id = fido_assert_id_ptr(assert, idx)) == NULL ||
+	    (id_len = fido_assert_id_len(assert, idx)) == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	memset(&pk, 0, sizeof(pk));
+	if ((r = fido_keystore_get_pk(ks, id, id_len, &pk)) != FIDO_OK ||
+	    (r = fido_assert_verify_prepared(assert, idx, &pk)) != FIDO_OK)
+		goto out;
+	if (ks->ctr_map != NULL)
+		r = fido_keystore_update_sigcount(ks, id, id_len,
+		    fido_assert_sigcount(assert, idx));
+out:
+	fido_pk_reset(&pk);
+
+	return (r);
+}
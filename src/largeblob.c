@@ -5,6 +5,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <openssl/evp.h>
 #include <openssl/sha.h>
 
 #include "fido.h"
@@ -13,6 +14,10 @@
 #define LARGEBLOB_DIGEST_LENGTH	16
 #define LARGEBLOB_NONCE_LENGTH	12
 #define LARGEBLOB_TAG_LENGTH	16
+#define LARGEBLOB_AAD_LENGTH	12
+/* status, map(1), key 0x01, bytestring header with a 16-bit length */
+#define LARGEBLOB_GET_OVERHEAD	6
+#define LARGEBLOB_MAX_RETRY	8
 
 typedef struct largeblob {
 	size_t origsiz;
@@ -20,10 +25,33 @@ typedef struct largeblob {
 	fido_blob_t nonce;
 } largeblob_t;
 
+typedef struct largeblob_rx {
+	fido_blob_t *array; /* bytes received so far */
+	size_t count; /* bytes requested per chunk */
+	size_t got; /* bytes in the last chunk */
+} largeblob_rx_t;
+
+typedef struct largeblob_reader {
+	fido_dev_t *dev;
+	fido_blob_t window; /* array bytes from offset base */
+	largeblob_rx_t rx;
+	EVP_MD_CTX *sha;
+	size_t base; /* array offset of window.ptr[0] */
+	size_t pos; /* array offset of the next item */
+	size_t hashed; /* array bytes fed to sha */
+	bool eof; /* last chunk received */
+	bool bad; /* malformed array */
+} largeblob_reader_t;
+
+typedef struct largeblob_sealer {
+	EVP_CIPHER_CTX *ctx;
+	fido_blob_t *ciphertext; /* grows as compressed bytes are sealed */
+} largeblob_sealer_t;
+
 static largeblob_t *
 largeblob_new(void)
 {
-	return calloc(1, sizeof(largeblob_t));
+	return fido_calloc(1, sizeof(largeblob_t));
 }
 
 static void
@@ -42,54 +70,61 @@ largeblob_free(largeblob_t **blob_ptr)
 	if (blob_ptr == NULL || (blob = *blob_ptr) == NULL)
 		return;
 	largeblob_reset(blob);
-	free(blob);
+	fido_free(blob);
 	*blob_ptr = NULL;
 }
 
-static int
-largeblob_aad(fido_blob_t *aad, uint64_t size)
+static void
+largeblob_aad_build(uint8_t buf[LARGEBLOB_AAD_LENGTH], uint64_t size)
 {
-	uint8_t buf[4 + sizeof(uint64_t)];
-
 	buf[0] = 0x62; /* b */
 	buf[1] = 0x6c; /* l */
 	buf[2] = 0x6f; /* o */
 	buf[3] = 0x62; /* b */
 	size = htole64(size);
 	memcpy(&buf[4], &size, sizeof(uint64_t));
-
-	return fido_blob_set(aad, buf, sizeof(buf));
 }
 
-static fido_blob_t *
-largeblob_decrypt(const largeblob_t *blob, const fido_blob_t *key)
+static int
+largeblob_aad(fido_blob_t *aad, uint64_t size)
 {
-	fido_blob_t *plaintext = NULL, *aad = NULL;
-	int ok = -1;
+	uint8_t buf[LARGEBLOB_AAD_LENGTH];
 
-	if ((plaintext = fido_blob_new()) == NULL ||
-	    (aad = fido_blob_new()) == NULL) {
-		fido_log_debug("%s: fido_blob_new", __func__);
-		goto fail;
-	}
-	if (largeblob_aad(aad, blob->origsiz) < 0) {
-		fido_log_debug("%s: largeblob_aad", __func__);
-		goto fail;
-	}
-	if (aes256_gcm_dec(key, &blob->nonce, aad, &blob->ciphertext,
-	    plaintext) < 0) {
-		fido_log_debug("%s: aes256_gcm_dec", __func__);
-		goto fail;
-	}
+	largeblob_aad_build(buf, size);
 
-	ok = 0;
-fail:
-	fido_blob_free(&aad);
+	return fido_blob_set(aad, buf, sizeof(buf));
+}
 
-	if (ok < 0)
-		fido_blob_free(&plaintext);
+/*
+ * Trial decryption of an entry: 'ctx' is keyed once by the caller and
+ * reused for every entry tried, and the plaintext lands in a buffer that
+ * is likewise reused, so that a miss costs no allocation.
+ */
+static int
+largeblob_try(EVP_CIPHER_CTX *ctx, const largeblob_t *blob,
+    fido_blob_t *plaintext)
+{
+	uint8_t buf[LARGEBLOB_AAD_LENGTH];
+	fido_blob_t aad;
+	size_t len;
+
+	fido_blob_clear(plaintext);
+	if (blob->nonce.len != LARGEBLOB_NONCE_LENGTH ||
+	    blob->ciphertext.len < LARGEBLOB_TAG_LENGTH)
+		return -1;
+	len = blob->ciphertext.len - LARGEBLOB_TAG_LENGTH;
+	if (fido_blob_reserve(plaintext, len) < 0)
+		return -1;
+	largeblob_aad_build(buf, blob->origsiz);
+	memset(&aad, 0, sizeof(aad));
+	aad.ptr = buf;
+	aad.len = sizeof(buf);
+	if (aes256_gcm_dec_ctx(ctx, &blob->nonce, &aad, &blob->ciphertext,
+	    plaintext->ptr) < 0)
+		return -1;
+	plaintext->len = len;
 
-	return plaintext;
+	return 0;
 }
 
 static int
@@ -98,8 +133,8 @@ largeblob_get_nonce(largeblob_t *blob)
 	uint8_t buf[LARGEBLOB_NONCE_LENGTH];
 	int ok = -1;
 
-	if (fido_get_random(buf, sizeof(buf)) < 0) {
-		fido_log_debug("%s: fido_get_random", __func__);
+	if (fido_get_nonce(buf, sizeof(buf)) < 0) {
+		fido_log_debug("%s: fido_get_nonce", __func__);
 		goto fail;
 	}
 	if (fido_blob_set(&blob->nonce, buf, sizeof(buf)) < 0) {
@@ -114,22 +149,35 @@ fail:
 	return ok;
 }
 
+static int
+largeblob_seal_chunk(void *arg, const u_char *ptr, size_t len)
+{
+	largeblob_sealer_t *s = arg;
+
+	return aes256_gcm_enc_update(s->ctx, ptr, len, s->ciphertext);
+}
+
+/*
+ * Compress 'body' as per the options in 'v', encrypting the compressed
+ * bytes as they are produced.
+ */
 static int
 largeblob_seal(largeblob_t *blob, const fido_blob_t *body,
-    const fido_blob_t *key)
+    const fido_blob_t *key, const fido_largeblob_item_t *v)
 {
-	fido_blob_t *plaintext = NULL, *aad = NULL;
+	largeblob_sealer_t s;
+	fido_blob_t *aad = NULL, dict;
 	int ok = -1;
 
-	if ((plaintext = fido_blob_new()) == NULL ||
-	    (aad = fido_blob_new()) == NULL) {
+	memset(&s, 0, sizeof(s));
+	memset(&dict, 0, sizeof(dict));
+	dict.ptr = (u_char *)(uintptr_t)v->dict_ptr; /* not freed */
+	dict.len = v->dict_len;
+
+	if ((aad = fido_blob_new()) == NULL) {
 		fido_log_debug("%s: fido_blob_new", __func__);
 		goto fail;
 	}
-	if (fido_compress(plaintext, body) != FIDO_OK) {
-		fido_log_debug("%s: fido_compress", __func__);
-		goto fail;
-	}
 	if (largeblob_aad(aad, body->len) < 0) {
 		fido_log_debug("%s: largeblob_aad", __func__);
 		goto fail;
@@ -138,16 +186,30 @@ largeblob_seal(largeblob_t *blob, const fido_blob_t *body,
 		fido_log_debug("%s: largeblob_get_nonce", __func__);
 		goto fail;
 	}
-	if (aes256_gcm_enc(key, &blob->nonce, aad, plaintext,
-	    &blob->ciphertext) < 0) {
-		fido_log_debug("%s: aes256_gcm_enc", __func__);
+	if ((s.ctx = aes256_gcm_enc_new(key, &blob->nonce, aad)) == NULL) {
+		fido_log_debug("%s: aes256_gcm_enc_new", __func__);
+		goto fail;
+	}
+	fido_blob_reset(&blob->ciphertext);
+	s.ciphertext = &blob->ciphertext;
+	if (fido_compress_stream(body, v->level, v->strategy,
+	    dict.ptr != NULL ? &dict : NULL, largeblob_seal_chunk,
+	    &s) != FIDO_OK) {
+		fido_log_debug("%s: fido_compress_stream", __func__);
+		goto fail;
+	}
+	if (aes256_gcm_enc_final(s.ctx, &blob->ciphertext) < 0) {
+		fido_log_debug("%s: aes256_gcm_enc_final", __func__);
 		goto fail;
 	}
 	blob->origsiz = body->len;
 
 	ok = 0;
 fail:
-	fido_blob_free(&plaintext);
+	if (s.ctx != NULL)
+		EVP_CIPHER_CTX_free(s.ctx);
+	if (ok < 0)
+		fido_blob_reset(&blob->ciphertext);
 	fido_blob_free(&aad);
 
 	return ok;
@@ -179,7 +241,7 @@ largeblob_get_tx(fido_dev_t *dev, size_t offset, size_t count, int *ms)
 	r = FIDO_OK;
 fail:
 	cbor_vector_free(argv, nitems(argv));
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return r;
 }
@@ -188,38 +250,49 @@ static int
 parse_largeblob_reply(const cbor_item_t *key, const cbor_item_t *val,
     void *arg)
 {
+	largeblob_rx_t *rx = arg;
+	size_t len;
+
 	if (cbor_isa_uint(key) == false ||
 	    cbor_int_get_width(key) != CBOR_INT_8 ||
 	    cbor_get_uint8(key) != 1) {
 		fido_log_debug("%s: cbor type", __func__);
 		return 0; /* ignore */
 	}
+	if (rx->got != 0 || cbor_isa_bytestring(val) == false ||
+	    cbor_bytestring_is_definite(val) == false ||
+	    (len = cbor_bytestring_length(val)) > rx->count) {
+		fido_log_debug("%s: cbor bytestring", __func__);
+		return -1;
+	}
+	if (len != 0 && fido_blob_append(rx->array,
+	    cbor_bytestring_handle(val), len) < 0) {
+		fido_log_debug("%s: fido_blob_append", __func__);
+		return -1;
+	}
+	rx->got = len;
 
-	return fido_blob_decode(val, arg);
+	return 0;
 }
 
 static int
-largeblob_get_rx(fido_dev_t *dev, fido_blob_t **chunk, int *ms)
+largeblob_get_rx(fido_dev_t *dev, largeblob_rx_t *rx, int *ms)
 {
 	unsigned char *msg;
+	size_t msgsiz = 0;
 	int msglen, r;
 
-	*chunk = NULL;
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	rx->got = 0;
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto out;
 	}
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto out;
 	}
-	if ((*chunk = fido_blob_new()) == NULL) {
-		fido_log_debug("%s: fido_blob_new", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto out;
-	}
-	if ((r = cbor_parse_reply(msg, (size_t)msglen, *chunk,
+	if ((r = cbor_parse_reply(msg, (size_t)msglen, rx,
 	    parse_largeblob_reply)) != FIDO_OK) {
 		fido_log_debug("%s: parse_largeblob_reply", __func__);
 		goto out;
@@ -227,10 +300,7 @@ largeblob_get_rx(fido_dev_t *dev, fido_blob_t **chunk, int *ms)
 
 	r = FIDO_OK;
 out:
-	if (r != FIDO_OK)
-		fido_blob_free(chunk);
-
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return r;
 }
@@ -246,7 +316,7 @@ largeblob_array_load(const uint8_t *ptr, size_t len)
 		return NULL;
 	}
 	len -= LARGEBLOB_DIGEST_LENGTH;
-	if ((item = cbor_load(ptr, len, &cbor)) == NULL) {
+	if ((item = cbor_load_ctap(ptr, len, &cbor)) == NULL) {
 		fido_log_debug("%s: cbor_load", __func__);
 		return NULL;
 	}
@@ -259,20 +329,80 @@ largeblob_array_load(const uint8_t *ptr, size_t len)
 	return item;
 }
 
+/*
+ * Per spec, fragments are at most maxFragmentLength = maxMsgSize - 64;
+ * a get fragment must also fit our reply buffer along with its framing.
+ */
 static size_t
 get_chunklen(fido_dev_t *dev)
 {
 	uint64_t maxchunklen;
+	size_t buflen;
 
 	if ((maxchunklen = fido_dev_maxmsgsize(dev)) > SIZE_MAX)
 		maxchunklen = SIZE_MAX;
-	if (maxchunklen > FIDO_MAXMSG)
-		maxchunklen = FIDO_MAXMSG;
 	maxchunklen = maxchunklen > 64 ? maxchunklen - 64 : 0;
+	buflen = fido_dev_msgbuf_len(dev) - LARGEBLOB_GET_OVERHEAD;
+	if (maxchunklen > buflen)
+		maxchunklen = buflen;
 
 	return (size_t)maxchunklen;
 }
 
+/* errors after which a chunk is sent again; see fido_dev_set_largeblob_retry */
+static bool
+largeblob_retryable(int r)
+{
+	switch (r) {
+	case FIDO_ERR_TX:
+	case FIDO_ERR_RX:
+	case FIDO_ERR_RX_NOT_CBOR:
+	case FIDO_ERR_RX_INVALID_CBOR:
+	case FIDO_ERR_CHANNEL_BUSY:
+	case FIDO_ERR_TIMEOUT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void
+largeblob_progress(const fido_dev_t *dev, size_t done, size_t total)
+{
+	if (dev->largeblob_progress != NULL)
+		dev->largeblob_progress(dev->largeblob_progress_arg, done,
+		    total);
+}
+
+/*
+ * Read the chunk at 'offset' into rx->array; reads are idempotent, so a
+ * failed one is simply repeated, keeping the chunks already received.
+ */
+static int
+largeblob_get_chunk(fido_dev_t *dev, largeblob_rx_t *rx, size_t offset,
+    int *ms)
+{
+	const size_t len = rx->array->len;
+	int r;
+
+	for (int i = 0;; i++) {
+		if ((r = largeblob_get_tx(dev, offset, rx->count,
+		    ms)) == FIDO_OK &&
+		    (r = largeblob_get_rx(dev, rx, ms)) == FIDO_OK)
+			break;
+		if (i >= dev->largeblob_retry || !largeblob_retryable(r))
+			return r;
+		fido_log_debug("%s: offset=%zu, r=%d, retrying", __func__,
+		    offset, r);
+		rx->array->len = len; /* a partial reply */
+	}
+
+	largeblob_progress(dev, offset + rx->got,
+	    rx->got == rx->count ? 0 : offset + rx->got);
+
+	return FIDO_OK;
+}
+
 static int
 largeblob_do_decode(const cbor_item_t *key, const cbor_item_t *val, void *arg)
 {
@@ -329,14 +459,15 @@ largeblob_decode(largeblob_t *blob, const cbor_item_t *item)
 }
 
 static cbor_item_t *
-largeblob_encode(const fido_blob_t *body, const fido_blob_t *key)
+largeblob_encode(const fido_blob_t *body, const fido_blob_t *key,
+    const fido_largeblob_item_t *v)
 {
 	largeblob_t *blob;
 	cbor_item_t *argv[3], *item = NULL;
 
 	memset(argv, 0, sizeof(argv));
 	if ((blob = largeblob_new()) == NULL ||
-	    largeblob_seal(blob, body, key) < 0) {
+	    largeblob_seal(blob, body, key, v) < 0) {
 		fido_log_debug("%s: largeblob_seal", __func__);
 		goto fail;
 	}
@@ -354,41 +485,58 @@ fail:
 	return item;
 }
 
+/* decode and try 'item'; -1 if it is not an entry sealed under 'ctx' */
+static int
+largeblob_open(largeblob_t *blob, const cbor_item_t *item,
+    EVP_CIPHER_CTX *ctx, fido_blob_t *plaintext)
+{
+	largeblob_reset(blob);
+	if (largeblob_decode(blob, item) < 0 ||
+	    largeblob_try(ctx, blob, plaintext) < 0) {
+		largeblob_reset(blob);
+		return -1;
+	}
+
+	return 0;
+}
+
 static int
 largeblob_array_lookup(fido_blob_t *out, size_t *idx, const cbor_item_t *item,
-    const fido_blob_t *key)
+    const fido_blob_t *key, const fido_blob_array_t *dict)
 {
 	cbor_item_t **v;
-	fido_blob_t *plaintext = NULL;
+	EVP_CIPHER_CTX *ctx = NULL;
+	fido_blob_t plaintext;
 	largeblob_t blob;
 	int r;
 
+	memset(&plaintext, 0, sizeof(plaintext));
 	memset(&blob, 0, sizeof(blob));
 	if (idx != NULL)
 		*idx = 0;
 	if ((v = cbor_array_handle(item)) == NULL)
 		return FIDO_ERR_INVALID_ARGUMENT;
+	if ((ctx = aes256_gcm_dec_new(key)) == NULL)
+		return FIDO_ERR_INTERNAL;
+
+	r = FIDO_ERR_NOTFOUND;
 	for (size_t i = 0; i < cbor_array_size(item); i++) {
-		if (largeblob_decode(&blob, v[i]) < 0 ||
-		    (plaintext = largeblob_decrypt(&blob, key)) == NULL) {
-			fido_log_debug("%s: largeblob_decode", __func__);
-			largeblob_reset(&blob);
+		if (largeblob_open(&blob, v[i], ctx, &plaintext) < 0)
 			continue;
-		}
 		if (idx != NULL)
 			*idx = i;
+		if (out != NULL)
+			r = fido_uncompress_dict(out, &plaintext, blob.origsiz,
+			    dict);
+		else
+			r = FIDO_OK;
 		break;
 	}
-	if (plaintext == NULL) {
+	if (r == FIDO_ERR_NOTFOUND)
 		fido_log_debug("%s: not found", __func__);
-		return FIDO_ERR_NOTFOUND;
-	}
-	if (out != NULL)
-		r = fido_uncompress(out, plaintext, blob.origsiz);
-	else
-		r = FIDO_OK;
 
-	fido_blob_free(&plaintext);
+	EVP_CIPHER_CTX_free(ctx);
+	fido_blob_reset(&plaintext);
 	largeblob_reset(&blob);
 
 	return r;
@@ -402,7 +550,7 @@ largeblob_array_digest(u_char out[LARGEBLOB_DIGEST_LENGTH], const u_char *data,
 
 	if (data == NULL || len == 0)
 		return -1;
-	if (SHA256(data, len, dgst) != dgst)
+	if (fido_sha256_buf(data, len, dgst) < 0)
 		return -1;
 	memcpy(out, dgst, LARGEBLOB_DIGEST_LENGTH);
 
@@ -433,45 +581,463 @@ largeblob_array_check(const fido_blob_t *array)
 static int
 largeblob_get_array(fido_dev_t *dev, cbor_item_t **item, int *ms)
 {
-	fido_blob_t *array, *chunk = NULL;
-	size_t n;
+	fido_blob_t *array;
+	largeblob_rx_t rx;
 	int r;
 
 	*item = NULL;
-	if ((n = get_chunklen(dev)) == 0)
+	memset(&rx, 0, sizeof(rx));
+	if (dev->largeblob_array != NULL) {
+		/* digest checked when cached */
+		if ((*item = largeblob_array_load(dev->largeblob_array->ptr,
+		    dev->largeblob_array->len)) == NULL)
+			return FIDO_ERR_INTERNAL;
+		return FIDO_OK;
+	}
+	if ((r = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK)
+		return r;
+	if ((rx.count = get_chunklen(dev)) == 0)
 		return FIDO_ERR_INVALID_ARGUMENT;
 	if ((array = fido_blob_new()) == NULL)
 		return FIDO_ERR_INTERNAL;
+	rx.array = array;
 	do {
-		fido_blob_free(&chunk);
-		if ((r = largeblob_get_tx(dev, array->len, n, ms)) != FIDO_OK ||
-		    (r = largeblob_get_rx(dev, &chunk, ms)) != FIDO_OK) {
-			fido_log_debug("%s: largeblob_get_wait %zu/%zu",
-			    __func__, array->len, n);
+		/* grows geometrically; see fido_blob_reserve() */
+		if (fido_blob_reserve(array, rx.count) < 0) {
+			fido_log_debug("%s: fido_blob_reserve", __func__);
+			r = FIDO_ERR_INTERNAL;
 			goto fail;
 		}
-		if (fido_blob_append(array, chunk->ptr, chunk->len) < 0) {
-			fido_log_debug("%s: fido_blob_append", __func__);
-			r = FIDO_ERR_INTERNAL;
+		if ((r = largeblob_get_chunk(dev, &rx, array->len,
+		    ms)) != FIDO_OK) {
+			fido_log_debug("%s: largeblob_get_chunk %zu/%zu",
+			    __func__, array->len, rx.count);
 			goto fail;
 		}
-	} while (chunk->len == n);
+	} while (rx.got == rx.count);
 
 	if (largeblob_array_check(array) != 0)
 		*item = cbor_new_definite_array(0); /* per spec */
-	else
-		*item = largeblob_array_load(array->ptr, array->len);
+	else if ((*item = largeblob_array_load(array->ptr,
+	    array->len)) != NULL && dev->largeblob_cache) {
+		dev->largeblob_array = array;
+		array = NULL;
+	}
 	if (*item == NULL)
 		r = FIDO_ERR_INTERNAL;
 	else
 		r = FIDO_OK;
 fail:
 	fido_blob_free(&array);
-	fido_blob_free(&chunk);
 
 	return r;
 }
 
+/*
+ * Streaming reader: the serialised array is fetched one chunk at a time,
+ * hashed as it arrives, and parsed one item at a time, so that a lookup
+ * can stop at the first matching entry. Only the bytes that have yet to
+ * be parsed or hashed are kept.
+ */
+static int
+largeblob_reader_open(largeblob_reader_t *r, fido_dev_t *dev, int *ms)
+{
+	int ok;
+
+	memset(r, 0, sizeof(*r));
+	r->dev = dev;
+	r->rx.array = &r->window;
+
+	if ((ok = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK)
+		return ok;
+	if ((r->rx.count = get_chunklen(dev)) == 0)
+		return FIDO_ERR_INVALID_ARGUMENT;
+	if ((r->sha = EVP_MD_CTX_new()) == NULL ||
+	    EVP_DigestInit_ex(r->sha, fido_md_sha256(), NULL) != 1) {
+		fido_log_debug("%s: EVP_DigestInit_ex", __func__);
+		return FIDO_ERR_INTERNAL;
+	}
+
+	return FIDO_OK;
+}
+
+static void
+largeblob_reader_close(largeblob_reader_t *r)
+{
+	EVP_MD_CTX_free(r->sha);
+	fido_blob_reset(&r->window);
+	memset(r, 0, sizeof(*r));
+}
+
+static int
+largeblob_reader_fetch(largeblob_reader_t *r, int *ms)
+{
+	size_t drop, end;
+	int ok;
+
+	if (r->eof) {
+		fido_log_debug("%s: eof", __func__);
+		r->bad = true;
+		return FIDO_ERR_INVALID_CBOR;
+	}
+	/* discard bytes that have been both parsed and hashed */
+	drop = (r->pos < r->hashed ? r->pos : r->hashed) - r->base;
+	if (drop != 0) {
+		memmove(r->window.ptr, r->window.ptr + drop,
+		    r->window.len - drop);
+		r->window.len -= drop;
+		r->base += drop;
+	}
+	if (fido_blob_reserve(&r->window, r->rx.count) < 0) {
+		fido_log_debug("%s: fido_blob_reserve", __func__);
+		return FIDO_ERR_INTERNAL;
+	}
+	if ((ok = largeblob_get_chunk(r->dev, &r->rx, r->base +
+	    r->window.len, ms)) != FIDO_OK) {
+		fido_log_debug("%s: largeblob_get_chunk %zu/%zu", __func__,
+		    r->base + r->window.len, r->rx.count);
+		return ok;
+	}
+	if (r->rx.got != r->rx.count)
+		r->eof = true;
+	/* hash everything except a trailing digest's worth */
+	end = r->base + r->window.len;
+	if (end > LARGEBLOB_DIGEST_LENGTH &&
+	    (end -= LARGEBLOB_DIGEST_LENGTH) > r->hashed) {
+		if (EVP_DigestUpdate(r->sha, r->window.ptr +
+		    (r->hashed - r->base), end - r->hashed) != 1) {
+			fido_log_debug("%s: EVP_DigestUpdate", __func__);
+			return FIDO_ERR_INTERNAL;
+		}
+		r->hashed = end;
+	}
+
+	return FIDO_OK;
+}
+
+static int
+largeblob_reader_begin(largeblob_reader_t *r, size_t *nitems, int *ms)
+{
+	const uint8_t *p;
+	size_t avail, need;
+	uint64_t n;
+	int ok;
+
+	*nitems = 0;
+	for (;;) {
+		p = r->window.ptr + (r->pos - r->base);
+		if ((avail = r->window.len - (r->pos - r->base)) > 0) {
+			/* definite array header */
+			if ((p[0] & 0xe0) != 0x80 || (p[0] & 0x1f) > 27) {
+				fido_log_debug("%s: cbor type", __func__);
+				r->bad = true;
+				return FIDO_ERR_INVALID_CBOR;
+			}
+			if ((p[0] & 0x1f) < 24)
+				need = 1;
+			else
+				need = 1 + ((size_t)1 << ((p[0] & 0x1f) - 24));
+			if (avail >= need)
+				break;
+		}
+		if ((ok = largeblob_reader_fetch(r, ms)) != FIDO_OK)
+			return ok;
+	}
+	if ((n = p[0] & 0x1f) >= 24) {
+		n = 0;
+		for (size_t i = 1; i < need; i++)
+			n = (n << 8) | p[i];
+	}
+	if (n > SIZE_MAX) {
+		fido_log_debug("%s: nitems", __func__);
+		r->bad = true;
+		return FIDO_ERR_INVALID_CBOR;
+	}
+	r->pos += need;
+	*nitems = (size_t)n;
+
+	return FIDO_OK;
+}
+
+static int
+largeblob_reader_next(largeblob_reader_t *r, cbor_item_t **item, int *ms)
+{
+	struct cbor_load_result cbor;
+	size_t off, avail;
+	int ok;
+
+	*item = NULL;
+	for (;;) {
+		off = r->pos - r->base;
+		if ((avail = r->window.len - off) > 0) {
+			if ((*item = cbor_load_ctap(r->window.ptr + off, avail,
+			    &cbor)) != NULL) {
+				r->pos += cbor.read;
+				return FIDO_OK;
+			}
+			if (cbor.error.code != CBOR_ERR_NOTENOUGHDATA) {
+				fido_log_debug("%s: cbor_load", __func__);
+				r->bad = true;
+				return FIDO_ERR_INVALID_CBOR;
+			}
+		}
+		if ((ok = largeblob_reader_fetch(r, ms)) != FIDO_OK)
+			return ok;
+	}
+}
+
+/*
+ * Read the remainder of the array and check its digest. *valid is set
+ * only if the digest is correct; r->bad is set if the items parsed so far
+ * spilled into the digest.
+ */
+static int
+largeblob_reader_verify(largeblob_reader_t *r, int *valid, int *ms)
+{
+	u_char dgst[SHA256_DIGEST_LENGTH];
+	size_t pos = r->pos, len;
+	int ok;
+
+	*valid = 0;
+	while (!r->eof) {
+		r->pos = r->base + r->window.len; /* skip */
+		if ((ok = largeblob_reader_fetch(r, ms)) != FIDO_OK)
+			return ok;
+	}
+	if ((len = r->base + r->window.len) < LARGEBLOB_DIGEST_LENGTH ||
+	    r->hashed != len - LARGEBLOB_DIGEST_LENGTH) {
+		fido_log_debug("%s: len %zu", __func__, len);
+		return FIDO_OK;
+	}
+	if (pos > r->hashed)
+		r->bad = true;
+	if (EVP_DigestFinal_ex(r->sha, dgst, NULL) != 1) {
+		fido_log_debug("%s: EVP_DigestFinal_ex", __func__);
+		return FIDO_ERR_INTERNAL;
+	}
+	*valid = timingsafe_bcmp(dgst, r->window.ptr + (r->hashed - r->base),
+	    LARGEBLOB_DIGEST_LENGTH) == 0;
+
+	return FIDO_OK;
+}
+
+/*
+ * Look up the entry decrypting under key without holding the whole array.
+ * An entry that decrypts is authenticated by AES-GCM, so the lookup stops
+ * there; otherwise the array is read to the end and its digest checked,
+ * an invalid array being treated as empty as per spec.
+ */
+static int
+largeblob_stream_lookup(fido_dev_t *dev, fido_blob_t *out,
+    const fido_blob_t *key, int *ms)
+{
+	largeblob_reader_t rd;
+	largeblob_t blob;
+	cbor_item_t *item = NULL;
+	EVP_CIPHER_CTX *ctx = NULL;
+	fido_blob_t plaintext;
+	size_t n = 0;
+	int valid, r;
+
+	memset(&blob, 0, sizeof(blob));
+	memset(&plaintext, 0, sizeof(plaintext));
+	if ((r = largeblob_reader_open(&rd, dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: largeblob_reader_open", __func__);
+		goto fail;
+	}
+	if ((ctx = aes256_gcm_dec_new(key)) == NULL) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	if ((r = largeblob_reader_begin(&rd, &n, ms)) != FIDO_OK && !rd.bad) {
+		fido_log_debug("%s: largeblob_reader_begin", __func__);
+		goto fail;
+	}
+	for (size_t i = 0; !rd.bad && i < n; i++) {
+		if ((r = largeblob_reader_next(&rd, &item, ms)) != FIDO_OK) {
+			if (rd.bad)
+				break;
+			fido_log_debug("%s: largeblob_reader_next", __func__);
+			goto fail;
+		}
+		valid = largeblob_open(&blob, item, ctx, &plaintext);
+		cbor_decref(&item);
+		if (valid == 0) {
+			r = fido_uncompress_dict(out, &plaintext, blob.origsiz,
+			    &dev->largeblob_dict);
+			goto fail;
+		}
+	}
+	if ((r = largeblob_reader_verify(&rd, &valid, ms)) != FIDO_OK) {
+		fido_log_debug("%s: largeblob_reader_verify", __func__);
+		goto fail;
+	}
+	if (valid && rd.bad) {
+		fido_log_debug("%s: malformed array", __func__);
+		r = FIDO_ERR_INTERNAL;
+	} else {
+		fido_log_debug("%s: not found", __func__);
+		r = FIDO_ERR_NOTFOUND;
+	}
+fail:
+	if (item != NULL)
+		cbor_decref(&item);
+	if (ctx != NULL)
+		EVP_CIPHER_CTX_free(ctx);
+	fido_blob_reset(&plaintext);
+	largeblob_reset(&blob);
+	largeblob_reader_close(&rd);
+
+	return r;
+}
+
+/*
+ * Look up the entry decrypting under key in the whole array, which is
+ * kept by dev. A miss in an array read earlier may be due to another
+ * client having written since, so the array is then read afresh.
+ */
+static int
+largeblob_cache_lookup(fido_dev_t *dev, fido_blob_t *out,
+    const fido_blob_t *key, int *ms)
+{
+	cbor_item_t *array = NULL;
+	bool cached = dev->largeblob_array != NULL;
+	int r;
+
+	if ((r = largeblob_get_array(dev, &array, ms)) != FIDO_OK) {
+		fido_log_debug("%s: largeblob_get_array", __func__);
+		return r;
+	}
+	r = largeblob_array_lookup(out, NULL, array, key,
+	    &dev->largeblob_dict);
+	cbor_decref(&array);
+	if (r == FIDO_ERR_NOTFOUND && cached) {
+		fido_dev_largeblob_cache_reset(dev);
+		return largeblob_cache_lookup(dev, out, key, ms);
+	}
+
+	return r;
+}
+
+/*
+ * Try the entry 'item' against the keys of v[] that have not been resolved
+ * yet, decompressing it into out[i] for every key it decrypts under.
+ * Returns the number of keys resolved.
+ */
+static size_t
+largeblob_get_entry(const cbor_item_t *item, EVP_CIPHER_CTX **ctx,
+    fido_largeblob_item_t *v, fido_blob_t *out, size_t n,
+    const fido_blob_array_t *dict)
+{
+	largeblob_t blob;
+	fido_blob_t plaintext;
+	size_t resolved = 0;
+
+	memset(&blob, 0, sizeof(blob));
+	memset(&plaintext, 0, sizeof(plaintext));
+	if (largeblob_decode(&blob, item) < 0) {
+		fido_log_debug("%s: largeblob_decode", __func__);
+		goto out;
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (v[i].r != FIDO_ERR_NOTFOUND ||
+		    largeblob_try(ctx[i], &blob, &plaintext) < 0)
+			continue;
+		v[i].r = fido_uncompress_dict(&out[i], &plaintext,
+		    blob.origsiz, dict);
+		resolved++;
+	}
+out:
+	fido_blob_reset(&plaintext);
+	largeblob_reset(&blob);
+
+	return resolved;
+}
+
+/* as largeblob_stream_lookup, stopping once every key is resolved */
+static int
+largeblob_stream_get_batch(fido_dev_t *dev, EVP_CIPHER_CTX **ctx,
+    fido_largeblob_item_t *v, fido_blob_t *out, size_t n, int *ms)
+{
+	largeblob_reader_t rd;
+	cbor_item_t *item = NULL;
+	size_t nitems = 0, left = n;
+	int valid, r;
+
+	if ((r = largeblob_reader_open(&rd, dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: largeblob_reader_open", __func__);
+		goto fail;
+	}
+	if ((r = largeblob_reader_begin(&rd, &nitems,
+	    ms)) != FIDO_OK && !rd.bad) {
+		fido_log_debug("%s: largeblob_reader_begin", __func__);
+		goto fail;
+	}
+	for (size_t i = 0; !rd.bad && left > 0 && i < nitems; i++) {
+		if ((r = largeblob_reader_next(&rd, &item, ms)) != FIDO_OK) {
+			if (rd.bad)
+				break;
+			fido_log_debug("%s: largeblob_reader_next", __func__);
+			goto fail;
+		}
+		left -= largeblob_get_entry(item, ctx, v, out, n,
+		    &dev->largeblob_dict);
+		cbor_decref(&item);
+	}
+	if (left == 0) {
+		r = FIDO_OK;
+		goto fail;
+	}
+	if ((r = largeblob_reader_verify(&rd, &valid, ms)) != FIDO_OK) {
+		fido_log_debug("%s: largeblob_reader_verify", __func__);
+		goto fail;
+	}
+	if (valid && rd.bad) {
+		fido_log_debug("%s: malformed array", __func__);
+		r = FIDO_ERR_INTERNAL;
+	} else
+		r = FIDO_OK; /* the keys left are not found */
+fail:
+	if (item != NULL)
+		cbor_decref(&item);
+	largeblob_reader_close(&rd);
+
+	return r;
+}
+
+/* as largeblob_cache_lookup, for the keys of v[] not resolved yet */
+static int
+largeblob_cache_get_batch(fido_dev_t *dev, EVP_CIPHER_CTX **ctx,
+    fido_largeblob_item_t *v, fido_blob_t *out, size_t n, int *ms)
+{
+	cbor_item_t *array = NULL, **entry;
+	bool cached = dev->largeblob_array != NULL;
+	size_t left = 0;
+	int r;
+
+	if ((r = largeblob_get_array(dev, &array, ms)) != FIDO_OK) {
+		fido_log_debug("%s: largeblob_get_array", __func__);
+		return r;
+	}
+	if ((entry = cbor_array_handle(array)) == NULL) {
+		cbor_decref(&array);
+		return FIDO_ERR_INVALID_ARGUMENT;
+	}
+	for (size_t i = 0; i < n; i++)
+		if (v[i].r == FIDO_ERR_NOTFOUND)
+			left++;
+	for (size_t i = 0; left > 0 && i < cbor_array_size(array); i++)
+		left -= largeblob_get_entry(entry[i], ctx, v, out, n,
+		    &dev->largeblob_dict);
+	cbor_decref(&array);
+	if (left > 0 && cached) {
+		fido_dev_largeblob_cache_reset(dev);
+		return largeblob_cache_get_batch(dev, ctx, v, out, n, ms);
+	}
+
+	return FIDO_OK;
+}
+
 static int
 prepare_hmac(size_t offset, const u_char *data, size_t len, fido_blob_t *hmac)
 {
@@ -493,7 +1059,7 @@ prepare_hmac(size_t offset, const u_char *data, size_t len, fido_blob_t *hmac)
 	buf[33] = 0x00;
 	u32_offset = htole32((uint32_t)offset);
 	memcpy(&buf[34], &u32_offset, sizeof(uint32_t));
-	if (SHA256(data, len, &buf[38]) != &buf[38]) {
+	if (fido_sha256_buf(data, len, &buf[38]) < 0) {
 		fido_log_debug("%s: SHA256", __func__);
 		return -1;
 	}
@@ -540,11 +1106,46 @@ largeblob_set_tx(fido_dev_t *dev, const fido_blob_t *token, const u_char *chunk,
 fail:
 	cbor_vector_free(argv, nitems(argv));
 	fido_blob_free(&hmac);
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return r;
 }
 
+/*
+ * Write a chunk, sending it again with the same token after a transient
+ * failure. The authenticator then either takes it as before or, if it had
+ * already taken it, finds the offset out of sequence; in the latter case
+ * the write carries on, since the digest sent last lets the authenticator
+ * check the array as a whole.
+ */
+static int
+largeblob_set_chunk(fido_dev_t *dev, const fido_blob_t *token,
+    const u_char *chunk, size_t chunk_len, size_t offset, size_t totalsiz,
+    int *ms)
+{
+	int r;
+
+	for (int i = 0;; i++) {
+		if ((r = largeblob_set_tx(dev, token, chunk, chunk_len, offset,
+		    totalsiz, ms)) == FIDO_OK &&
+		    (r = fido_rx_cbor_status(dev, ms)) == FIDO_OK)
+			break;
+		if (i > 0 && offset > 0 && r == FIDO_ERR_INVALID_SEQ) {
+			fido_log_debug("%s: offset=%zu taken", __func__,
+			    offset);
+			break;
+		}
+		if (i >= dev->largeblob_retry || !largeblob_retryable(r))
+			return r;
+		fido_log_debug("%s: offset=%zu, r=%d, retrying", __func__,
+		    offset, r);
+	}
+
+	largeblob_progress(dev, offset + chunk_len, totalsiz);
+
+	return FIDO_OK;
+}
+
 static int
 largeblob_get_uv_token(fido_dev_t *dev, const char *pin, fido_blob_t **token,
     int *ms)
@@ -580,13 +1181,20 @@ static int
 largeblob_set_array(fido_dev_t *dev, const cbor_item_t *item, const char *pin,
     int *ms)
 {
-	unsigned char dgst[SHA256_DIGEST_LENGTH];
-	fido_blob_t cbor, *token = NULL;
+	EVP_MD_CTX *sha = NULL;
+	fido_blob_t cbor, dgst, *token = NULL;
 	size_t chunklen, maxchunklen, totalsize;
 	int r;
 
 	memset(&cbor, 0, sizeof(cbor));
+	memset(&dgst, 0, sizeof(dgst));
+	fido_dev_largeblob_cache_reset(dev); /* stale from the first chunk */
+	fido_dev_lock_begin(dev, ms);
 
+	if ((r = fido_dev_get_deferred_info(dev, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		goto fail;
+	}
 	if ((maxchunklen = get_chunklen(dev)) == 0) {
 		fido_log_debug("%s: maxchunklen=%zu", __func__, maxchunklen);
 		r = FIDO_ERR_INVALID_ARGUMENT;
@@ -602,17 +1210,12 @@ largeblob_set_array(fido_dev_t *dev, const cbor_item_t *item, const char *pin,
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
-	if (cbor.len > SIZE_MAX - sizeof(dgst)) {
+	if (cbor.len > SIZE_MAX - LARGEBLOB_DIGEST_LENGTH) {
 		fido_log_debug("%s: cbor.len=%zu", __func__, cbor.len);
 		r = FIDO_ERR_INVALID_ARGUMENT;
 		goto fail;
 	}
-	if (SHA256(cbor.ptr, cbor.len, dgst) != dgst) {
-		fido_log_debug("%s: SHA256", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
-	}
-	totalsize = cbor.len + sizeof(dgst) - 16; /* the first 16 bytes only */
+	totalsize = cbor.len + LARGEBLOB_DIGEST_LENGTH;
 	if (pin != NULL || fido_dev_supports_permissions(dev)) {
 		if ((r = largeblob_get_uv_token(dev, pin, &token,
 		    ms)) != FIDO_OK) {
@@ -620,116 +1223,185 @@ largeblob_set_array(fido_dev_t *dev, const cbor_item_t *item, const char *pin,
 			goto fail;
 		}
 	}
+	if (fido_sha256_init(&sha) < 0) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	/* the digest trailer is hashed in the same pass as chunks are sent */
 	for (size_t offset = 0; offset < cbor.len; offset += chunklen) {
 		if ((chunklen = cbor.len - offset) > maxchunklen)
 			chunklen = maxchunklen;
-		if ((r = largeblob_set_tx(dev, token, cbor.ptr + offset,
-		    chunklen, offset, totalsize, ms)) != FIDO_OK ||
-		    (r = fido_rx_cbor_status(dev, ms)) != FIDO_OK) {
+		if (fido_sha256_update(sha, cbor.ptr + offset, chunklen) < 0) {
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+		if ((r = largeblob_set_chunk(dev, token, cbor.ptr + offset,
+		    chunklen, offset, totalsize, ms)) != FIDO_OK) {
 			fido_log_debug("%s: body", __func__);
 			goto fail;
 		}
 	}
-	if ((r = largeblob_set_tx(dev, token, dgst, sizeof(dgst) - 16, cbor.len,
-	    totalsize, ms)) != FIDO_OK ||
-	    (r = fido_rx_cbor_status(dev, ms)) != FIDO_OK) {
+	if (fido_sha256_final(&sha, &dgst) < 0) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	/* the first 16 bytes only */
+	if ((r = largeblob_set_chunk(dev, token, dgst.ptr,
+	    LARGEBLOB_DIGEST_LENGTH, cbor.len, totalsize, ms)) != FIDO_OK) {
 		fido_log_debug("%s: dgst", __func__);
 		goto fail;
 	}
+	/* the array as now held by the authenticator */
+	if (dev->largeblob_cache &&
+	    fido_blob_append(&cbor, dgst.ptr, LARGEBLOB_DIGEST_LENGTH) == 0 &&
+	    (dev->largeblob_array = fido_blob_new()) != NULL) {
+		*dev->largeblob_array = cbor;
+		memset(&cbor, 0, sizeof(cbor));
+	}
 
 	r = FIDO_OK;
 fail:
+	EVP_MD_CTX_free(sha);
 	fido_blob_free(&token);
 	fido_blob_reset(&cbor);
+	fido_blob_reset(&dgst);
+	fido_dev_lock_end(dev);
 
 	return r;
 }
 
+/*
+ * Apply a batch of additions (or removals, if drop is set) to the array
+ * in a single read-modify-write cycle. The authenticator only accepts a
+ * complete array written from offset zero, so the array is rewritten in
+ * full, and only if an entry changed.
+ */
 static int
-largeblob_add(fido_dev_t *dev, const fido_blob_t *key, cbor_item_t *item,
-    const char *pin, int *ms)
+largeblob_batch(fido_dev_t *dev, fido_largeblob_item_t *v, size_t n,
+    int drop, const char *pin, int *ms)
 {
-	cbor_item_t *array = NULL;
-	size_t idx;
-	int r;
+	cbor_item_t *array = NULL, *item = NULL;
+	fido_blob_t key, body;
+	size_t idx, changed = 0;
+	int r, first = FIDO_OK;
 
+	memset(&key, 0, sizeof(key));
+	memset(&body, 0, sizeof(body));
+
+	/* the array may not change between reading and writing it */
+	fido_dev_lock_begin(dev, ms);
 	if ((r = largeblob_get_array(dev, &array, ms)) != FIDO_OK) {
 		fido_log_debug("%s: largeblob_get_array", __func__);
 		goto fail;
 	}
-
-	switch (r = largeblob_array_lookup(NULL, &idx, array, key)) {
-	case FIDO_OK:
-		if (!cbor_array_replace(array, idx, item)) {
+	for (size_t i = 0; i < n; i++) {
+		if (fido_blob_set_secure(&key, v[i].key_ptr,
+		    v[i].key_len) < 0 ||
+		    (!drop && fido_blob_set(&body, v[i].blob_ptr,
+		    v[i].blob_len) < 0)) {
+			fido_log_debug("%s: fido_blob_set", __func__);
 			r = FIDO_ERR_INTERNAL;
 			goto fail;
 		}
-		break;
-	case FIDO_ERR_NOTFOUND:
-		if (cbor_array_append(&array, item) < 0) {
+		if (!drop && (item = largeblob_encode(&body, &key,
+		    &v[i])) == NULL) {
+			fido_log_debug("%s: largeblob_encode", __func__);
 			r = FIDO_ERR_INTERNAL;
 			goto fail;
 		}
-		break;
-	default:
-		fido_log_debug("%s: largeblob_array_lookup", __func__);
-		goto fail;
+		switch (r = largeblob_array_lookup(NULL, &idx, array, &key,
+		    NULL)) {
+		case FIDO_OK:
+			if (drop ? cbor_array_drop(&array, idx) < 0 :
+			    !cbor_array_replace(array, idx, item)) {
+				r = FIDO_ERR_INTERNAL;
+				goto fail;
+			}
+			changed++;
+			break;
+		case FIDO_ERR_NOTFOUND:
+			if (drop)
+				break;
+			if (cbor_array_append(&array, item) < 0) {
+				r = FIDO_ERR_INTERNAL;
+				goto fail;
+			}
+			r = FIDO_OK;
+			changed++;
+			break;
+		default:
+			fido_log_debug("%s: largeblob_array_lookup", __func__);
+			goto fail;
+		}
+		if ((v[i].r = r) != FIDO_OK && first == FIDO_OK)
+			first = r;
+		if (item != NULL) {
+			cbor_decref(&item);
+			item = NULL;
+		}
+		fido_blob_reset(&key);
+		fido_blob_reset(&body);
 	}
 
-	if ((r = largeblob_set_array(dev, array, pin, ms)) != FIDO_OK) {
+	if (changed == 0) {
+		fido_log_debug("%s: unchanged", __func__);
+	} else if ((r = largeblob_set_array(dev, array, pin, ms)) != FIDO_OK) {
 		fido_log_debug("%s: largeblob_set_array", __func__);
 		goto fail;
 	}
 
-	r = FIDO_OK;
+	r = first;
 fail:
 	if (array != NULL)
 		cbor_decref(&array);
+	if (item != NULL)
+		cbor_decref(&item);
+
+	fido_blob_reset(&key);
+	fido_blob_reset(&body);
+	fido_dev_lock_end(dev);
 
 	return r;
 }
 
 static int
-largeblob_drop(fido_dev_t *dev, const fido_blob_t *key, const char *pin,
-    int *ms)
+largeblob_batch_check(const fido_largeblob_item_t *v, size_t n, int drop)
 {
-	cbor_item_t *array = NULL;
-	size_t idx;
-	int r;
-
-	if ((r = largeblob_get_array(dev, &array, ms)) != FIDO_OK) {
-		fido_log_debug("%s: largeblob_get_array", __func__);
-		goto fail;
-	}
-	if ((r = largeblob_array_lookup(NULL, &idx, array, key)) != FIDO_OK) {
-		fido_log_debug("%s: largeblob_array_lookup", __func__);
-		goto fail;
-	}
-	if (cbor_array_drop(&array, idx) < 0) {
-		fido_log_debug("%s: cbor_array_drop", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
+	if (v == NULL || n == 0) {
+		fido_log_debug("%s: invalid v=%p, n=%zu", __func__,
+		    (const void *)v, n);
+		return -1;
 	}
-	if ((r = largeblob_set_array(dev, array, pin, ms)) != FIDO_OK) {
-		fido_log_debug("%s: largeblob_set_array", __func__);
-		goto fail;
+	for (size_t i = 0; i < n; i++) {
+		if (v[i].key_len != 32) {
+			fido_log_debug("%s: invalid key len %zu", __func__,
+			    v[i].key_len);
+			return -1;
+		}
+		if (!drop && (v[i].blob_ptr == NULL || v[i].blob_len == 0)) {
+			fido_log_debug("%s: invalid blob_ptr=%p, blob_len=%zu",
+			    __func__, (const void *)v[i].blob_ptr,
+			    v[i].blob_len);
+			return -1;
+		}
+		if (!drop && (v[i].dict_ptr == NULL) != (v[i].dict_len == 0)) {
+			fido_log_debug("%s: invalid dict_ptr=%p, dict_len=%zu",
+			    __func__, (const void *)v[i].dict_ptr,
+			    v[i].dict_len);
+			return -1;
+		}
 	}
 
-	r = FIDO_OK;
-fail:
-	if (array != NULL)
-		cbor_decref(&array);
-
-	return r;
+	return 0;
 }
 
 int
 fido_dev_largeblob_get(fido_dev_t *dev, const unsigned char *key_ptr,
     size_t key_len, unsigned char **blob_ptr, size_t *blob_len)
 {
-	cbor_item_t *item = NULL;
+	fido_trace_t span;
 	fido_blob_t key, body;
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 	int r;
 
 	memset(&key, 0, sizeof(key));
@@ -746,107 +1418,232 @@ fido_dev_largeblob_get(fido_dev_t *dev, const unsigned char *key_ptr,
 	}
 	*blob_ptr = NULL;
 	*blob_len = 0;
-	if (fido_blob_set(&key, key_ptr, key_len) < 0) {
-		fido_log_debug("%s: fido_blob_set", __func__);
+	if (fido_blob_set_secure(&key, key_ptr, key_len) < 0) {
+		fido_log_debug("%s: fido_blob_set_secure", __func__);
 		return FIDO_ERR_INTERNAL;
 	}
-	if ((r = largeblob_get_array(dev, &item, &ms)) != FIDO_OK) {
-		fido_log_debug("%s: largeblob_get_array", __func__);
-		goto fail;
-	}
-	if ((r = largeblob_array_lookup(&body, NULL, item, &key)) != FIDO_OK)
-		fido_log_debug("%s: largeblob_array_lookup", __func__);
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	if (dev->largeblob_cache)
+		r = largeblob_cache_lookup(dev, &body, &key, &ms);
+	else
+		r = largeblob_stream_lookup(dev, &body, &key, &ms);
+	if (r != FIDO_OK)
+		fido_log_debug("%s: lookup", __func__);
 	else {
 		*blob_ptr = body.ptr;
 		*blob_len = body.len;
 	}
-fail:
-	if (item != NULL)
-		cbor_decref(&item);
 
 	fido_blob_reset(&key);
 
-	return r;
+	return fido_trace_end(&span, r);
 }
 
 int
-fido_dev_largeblob_set(fido_dev_t *dev, const unsigned char *key_ptr,
-    size_t key_len, const unsigned char *blob_ptr, size_t blob_len,
-    const char *pin)
+fido_dev_largeblob_get_batch(fido_dev_t *dev, fido_largeblob_item_t *v,
+    size_t n, unsigned char **blob_ptr, size_t *blob_len)
 {
-	cbor_item_t *item = NULL;
-	fido_blob_t key, body;
-	int ms = dev->timeout_ms;
-	int r;
+	fido_trace_t span;
+	EVP_CIPHER_CTX **ctx = NULL;
+	fido_blob_t key, *out = NULL;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r, first = FIDO_OK;
 
 	memset(&key, 0, sizeof(key));
-	memset(&body, 0, sizeof(body));
 
-	if (key_len != 32) {
-		fido_log_debug("%s: invalid key len %zu", __func__, key_len);
+	if (largeblob_batch_check(v, n, 1) < 0 || blob_ptr == NULL ||
+	    blob_len == NULL) {
+		fido_log_debug("%s: invalid blob_ptr=%p, blob_len=%p", __func__,
+		    (const void *)blob_ptr, (const void *)blob_len);
 		return FIDO_ERR_INVALID_ARGUMENT;
 	}
-	if (blob_ptr == NULL || blob_len == 0) {
-		fido_log_debug("%s: invalid blob_ptr=%p, blob_len=%zu", __func__,
-		    (const void *)blob_ptr, blob_len);
-		return FIDO_ERR_INVALID_ARGUMENT;
+	for (size_t i = 0; i < n; i++) {
+		blob_ptr[i] = NULL;
+		blob_len[i] = 0;
+		v[i].r = FIDO_ERR_NOTFOUND;
 	}
-	if (fido_blob_set(&key, key_ptr, key_len) < 0 ||
-	    fido_blob_set(&body, blob_ptr, blob_len) < 0) {
-		fido_log_debug("%s: fido_blob_set", __func__);
+	if ((ctx = fido_calloc(n, sizeof(*ctx))) == NULL ||
+	    (out = fido_calloc(n, sizeof(*out))) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
-	if ((item = largeblob_encode(&body, &key)) == NULL) {
-		fido_log_debug("%s: largeblob_encode", __func__);
-		r = FIDO_ERR_INTERNAL;
+	/* the key setup is done once for all entries */
+	for (size_t i = 0; i < n; i++) {
+		if (fido_blob_set_secure(&key, v[i].key_ptr,
+		    v[i].key_len) < 0 ||
+		    (ctx[i] = aes256_gcm_dec_new(&key)) == NULL) {
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+		fido_blob_reset(&key);
+	}
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	if (dev->largeblob_cache)
+		r = largeblob_cache_get_batch(dev, ctx, v, out, n, &ms);
+	else
+		r = largeblob_stream_get_batch(dev, ctx, v, out, n, &ms);
+	if (fido_trace_end(&span, r) != FIDO_OK) {
+		fido_log_debug("%s: lookup", __func__);
 		goto fail;
 	}
-	if ((r = largeblob_add(dev, &key, item, pin, &ms)) != FIDO_OK)
-		fido_log_debug("%s: largeblob_add", __func__);
-fail:
-	if (item != NULL)
-		cbor_decref(&item);
+	for (size_t i = 0; i < n; i++) {
+		if (v[i].r != FIDO_OK) {
+			if (first == FIDO_OK)
+				first = v[i].r;
+			continue;
+		}
+		blob_ptr[i] = out[i].ptr;
+		blob_len[i] = out[i].len;
+		memset(&out[i], 0, sizeof(out[i]));
+	}
 
+	r = first;
+fail:
+	if (ctx != NULL)
+		for (size_t i = 0; i < n; i++)
+			EVP_CIPHER_CTX_free(ctx[i]);
+	if (out != NULL)
+		for (size_t i = 0; i < n; i++)
+			fido_blob_reset(&out[i]);
+	fido_free(ctx);
+	fido_free(out);
 	fido_blob_reset(&key);
-	fido_blob_reset(&body);
 
 	return r;
 }
 
+int
+fido_dev_largeblob_set(fido_dev_t *dev, const unsigned char *key_ptr,
+    size_t key_len, const unsigned char *blob_ptr, size_t blob_len,
+    const char *pin)
+{
+	fido_largeblob_item_t v;
+
+	memset(&v, 0, sizeof(v));
+	v.key_ptr = key_ptr;
+	v.key_len = key_len;
+	v.blob_ptr = blob_ptr;
+	v.blob_len = blob_len;
+
+	return fido_dev_largeblob_set_batch(dev, &v, 1, pin);
+}
+
 int
 fido_dev_largeblob_remove(fido_dev_t *dev, const unsigned char *key_ptr,
     size_t key_len, const char *pin)
 {
-	fido_blob_t key;
-	int ms = dev->timeout_ms;
+	fido_largeblob_item_t v;
+
+	memset(&v, 0, sizeof(v));
+	v.key_ptr = key_ptr;
+	v.key_len = key_len;
+
+	return fido_dev_largeblob_remove_batch(dev, &v, 1, pin);
+}
+
+int
+fido_dev_largeblob_set_batch(fido_dev_t *dev, fido_largeblob_item_t *v,
+    size_t n, const char *pin)
+{
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
 	int r;
 
-	memset(&key, 0, sizeof(key));
+	if (largeblob_batch_check(v, n, 0) < 0)
+		return FIDO_ERR_INVALID_ARGUMENT;
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	if ((r = largeblob_batch(dev, v, n, 0, pin, &ms)) != FIDO_OK)
+		fido_log_debug("%s: largeblob_batch", __func__);
 
-	if (key_len != 32) {
-		fido_log_debug("%s: invalid key len %zu", __func__, key_len);
+	return fido_trace_end(&span, r);
+}
+
+int
+fido_dev_largeblob_remove_batch(fido_dev_t *dev, fido_largeblob_item_t *v,
+    size_t n, const char *pin)
+{
+	fido_trace_t span;
+	int ms = fido_time_budget(dev->timeout_ms);
+	int r;
+
+	if (largeblob_batch_check(v, n, 1) < 0)
+		return FIDO_ERR_INVALID_ARGUMENT;
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	if ((r = largeblob_batch(dev, v, n, 1, pin, &ms)) != FIDO_OK)
+		fido_log_debug("%s: largeblob_batch", __func__);
+
+	return fido_trace_end(&span, r);
+}
+
+int
+fido_dev_largeblob_add_dict(fido_dev_t *dev, const unsigned char *ptr,
+    size_t len)
+{
+	fido_blob_array_t *a = &dev->largeblob_dict;
+	fido_blob_t *p;
+
+	if (ptr == NULL || len == 0 || len > UINT_MAX) {
+		fido_log_debug("%s: invalid ptr=%p, len=%zu", __func__,
+		    (const void *)ptr, len);
 		return FIDO_ERR_INVALID_ARGUMENT;
 	}
-	if (fido_blob_set(&key, key_ptr, key_len) < 0) {
-		fido_log_debug("%s: fido_blob_set", __func__);
+	if (a->len == SIZE_MAX || (p = fido_recallocarray(a->ptr, a->len,
+	    a->len + 1, sizeof(*p))) == NULL)
 		return FIDO_ERR_INTERNAL;
-	}
-	if ((r = largeblob_drop(dev, &key, pin, &ms)) != FIDO_OK)
-		fido_log_debug("%s: largeblob_drop", __func__);
+	a->ptr = p;
+	if (fido_blob_set(&a->ptr[a->len], ptr, len) < 0)
+		return FIDO_ERR_INTERNAL;
+	a->len++;
 
-	fido_blob_reset(&key);
+	return FIDO_OK;
+}
 
-	return r;
+void
+fido_dev_largeblob_cache_reset(fido_dev_t *dev)
+{
+	fido_blob_free(&dev->largeblob_array);
+}
+
+int
+fido_dev_set_largeblob_cache(fido_dev_t *dev, bool enable)
+{
+	if (!enable)
+		fido_dev_largeblob_cache_reset(dev);
+
+	dev->largeblob_cache = enable;
+
+	return FIDO_OK;
+}
+
+int
+fido_dev_set_largeblob_progress(fido_dev_t *dev,
+    fido_largeblob_progress_t *progress, void *progress_arg)
+{
+	dev->largeblob_progress = progress;
+	dev->largeblob_progress_arg = progress_arg;
+
+	return FIDO_OK;
+}
+
+int
+fido_dev_set_largeblob_retry(fido_dev_t *dev, int n)
+{
+	if (n < 0 || n > LARGEBLOB_MAX_RETRY)
+		return FIDO_ERR_INVALID_ARGUMENT;
+
+	dev->largeblob_retry = n;
+
+	return FIDO_OK;
 }
 
 int
 fido_dev_largeblob_get_array(fido_dev_t *dev, unsigned char **cbor_ptr,
     size_t *cbor_len)
 {
+	fido_trace_t span;
 	cbor_item_t *item = NULL;
 	fido_blob_t cbor;
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 	int r;
 
 	memset(&cbor, 0, sizeof(cbor));
@@ -858,9 +1655,10 @@ fido_dev_largeblob_get_array(fido_dev_t *dev, unsigned char **cbor_ptr,
 	}
 	*cbor_ptr = NULL;
 	*cbor_len = 0;
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
 	if ((r = largeblob_get_array(dev, &item, &ms)) != FIDO_OK) {
 		fido_log_debug("%s: largeblob_get_array", __func__);
-		return r;
+		return fido_trace_end(&span, r);
 	}
 	if (fido_blob_serialise(&cbor, item) < 0) {
 		fido_log_debug("%s: fido_blob_serialise", __func__);
@@ -872,6 +1670,111 @@ fido_dev_largeblob_get_array(fido_dev_t *dev, unsigned char **cbor_ptr,
 
 	cbor_decref(&item);
 
+	return fido_trace_end(&span, r);
+}
+
+/*
+ * Try 'blob' against every key, those that have not matched an entry yet
+ * first: a largeBlob key normally owns a single entry.
+ */
+static size_t
+largeblob_match_entry(const largeblob_t *blob, EVP_CIPHER_CTX **ctx,
+    const bool *used, size_t nkeys, fido_blob_t *scratch)
+{
+	for (int pass = 0; pass < 2; pass++)
+		for (size_t i = 0; i < nkeys; i++)
+			if (used[i] == (pass != 0) &&
+			    largeblob_try(ctx[i], blob, scratch) == 0)
+				return i;
+
+	return SIZE_MAX;
+}
+
+int
+fido_largeblob_array_match(const unsigned char *cbor_ptr, size_t cbor_len,
+    const fido_largeblob_item_t *keys, size_t nkeys, size_t *match,
+    size_t nmatch)
+{
+	struct cbor_load_result cbor_result;
+	cbor_item_t *item = NULL, **v;
+	EVP_CIPHER_CTX **ctx = NULL;
+	bool *used = NULL;
+	fido_blob_t key, scratch;
+	largeblob_t blob;
+	size_t n, k;
+	int r;
+
+	memset(&key, 0, sizeof(key));
+	memset(&scratch, 0, sizeof(scratch));
+	memset(&blob, 0, sizeof(blob));
+
+	if (cbor_ptr == NULL || (keys == NULL && nkeys > 0) ||
+	    (match == NULL && nmatch > 0)) {
+		fido_log_debug("%s: invalid cbor_ptr=%p, keys=%p, match=%p",
+		    __func__, (const void *)cbor_ptr, (const void *)keys,
+		    (const void *)match);
+		return FIDO_ERR_INVALID_ARGUMENT;
+	}
+	if ((item = cbor_load_ctap(cbor_ptr, cbor_len,
+	    &cbor_result)) == NULL || !cbor_isa_array(item) ||
+	    !cbor_array_is_definite(item) ||
+	    (v = cbor_array_handle(item)) == NULL) {
+		fido_log_debug("%s: cbor_load", __func__);
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto fail;
+	}
+	if ((n = cbor_array_size(item)) > nmatch) {
+		fido_log_debug("%s: n=%zu, nmatch=%zu", __func__, n, nmatch);
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto fail;
+	}
+	if (nkeys > 0 && ((ctx = fido_calloc(nkeys, sizeof(*ctx))) == NULL ||
+	    (used = fido_calloc(nkeys, sizeof(*used))) == NULL)) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	/* the key setup is done once for all entries */
+	for (size_t i = 0; i < nkeys; i++) {
+		if (keys[i].key_ptr == NULL || keys[i].key_len != 32) {
+			fido_log_debug("%s: key %zu", __func__, i);
+			r = FIDO_ERR_INVALID_ARGUMENT;
+			goto fail;
+		}
+		if (fido_blob_set_secure(&key, keys[i].key_ptr,
+		    keys[i].key_len) < 0 ||
+		    (ctx[i] = aes256_gcm_dec_new(&key)) == NULL) {
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+		fido_blob_reset(&key);
+	}
+	for (size_t i = 0; i < n; i++) {
+		match[i] = SIZE_MAX;
+		if (largeblob_decode(&blob, v[i]) < 0) {
+			fido_log_debug("%s: largeblob_decode %zu", __func__, i);
+			largeblob_reset(&blob);
+			continue;
+		}
+		if ((k = largeblob_match_entry(&blob, ctx, used, nkeys,
+		    &scratch)) != SIZE_MAX) {
+			match[i] = k;
+			used[k] = true;
+		}
+		largeblob_reset(&blob);
+	}
+
+	r = FIDO_OK;
+fail:
+	if (ctx != NULL)
+		for (size_t i = 0; i < nkeys; i++)
+			EVP_CIPHER_CTX_free(ctx[i]);
+	fido_free(ctx);
+	fido_free(used);
+	fido_blob_reset(&key);
+	fido_blob_reset(&scratch);
+	if (item != NULL)
+		cbor_decref(&item);
+
 	return r;
 }
 
@@ -879,9 +1782,10 @@ int
 fido_dev_largeblob_set_array(fido_dev_t *dev, const unsigned char *cbor_ptr,
     size_t cbor_len, const char *pin)
 {
+	fido_trace_t span;
 	cbor_item_t *item = NULL;
 	struct cbor_load_result cbor_result;
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 	int r;
 
 	if (cbor_ptr == NULL || cbor_len == 0) {
@@ -889,14 +1793,15 @@ fido_dev_largeblob_set_array(fido_dev_t *dev, const unsigned char *cbor_ptr,
 		    (const void *)cbor_ptr, cbor_len);
 		return FIDO_ERR_INVALID_ARGUMENT;
 	}
-	if ((item = cbor_load(cbor_ptr, cbor_len, &cbor_result)) == NULL) {
+	if ((item = cbor_load_ctap(cbor_ptr, cbor_len, &cbor_result)) == NULL) {
 		fido_log_debug("%s: cbor_load", __func__);
 		return FIDO_ERR_INVALID_ARGUMENT;
 	}
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
 	if ((r = largeblob_set_array(dev, item, pin, &ms)) != FIDO_OK)
 		fido_log_debug("%s: largeblob_set_array", __func__);
 
 	cbor_decref(&item);
 
-	return r;
+	return fido_trace_end(&span, r);
 }
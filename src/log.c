@@ -14,16 +14,28 @@
 
 #ifndef FIDO_NO_DIAGNOSTIC
 
-#define XXDLEN	32
 #define XXDROW	128
 #define LINELEN	256
+#define CTXLEN	16	/* nested operations with a known context */
 
 #ifndef TLS
 #define TLS
 #endif
 
-static TLS int logging;
+struct log_ctx {
+	const fido_dev_t *dev;
+	const char *op;
+};
+
+TLS int fido_log_thread;
+int fido_log_global;
 static TLS fido_log_handler_t *log_handler;
+static fido_log_handler_t *global_log_handler; /* set before threads start */
+static fido_log_context_handler_t *context_handler; /* ditto */
+static void *context_handler_arg;
+static int log_level = FIDO_LOG_XXD; /* ditto */
+static TLS struct log_ctx log_ctx[CTXLEN];
+static TLS size_t log_ctx_depth;
 
 static void
 log_on_stderr(const char *str)
@@ -31,84 +43,144 @@ log_on_stderr(const char *str)
 	fprintf(stderr, "%s", str);
 }
 
+static const struct log_ctx *
+log_ctx_get(void)
+{
+	static const struct log_ctx none;
+	size_t i = log_ctx_depth < CTXLEN ? log_ctx_depth : CTXLEN;
+
+	return (i > 0 ? &log_ctx[i - 1] : &none);
+}
+
+/* 'line' is unterminated and has room for a newline */
+static void
+log_emit(int level, char *line, size_t size)
+{
+	const struct log_ctx *ctx;
+	size_t n;
+
+	if (context_handler != NULL) {
+		ctx = log_ctx_get();
+		context_handler(context_handler_arg, level, ctx->dev, ctx->op,
+		    line);
+		return;
+	}
+
+	if ((n = strlen(line)) + 1 < size) {
+		line[n] = '\n';
+		line[n + 1] = '\0';
+	}
+
+	if (log_handler != NULL)
+		log_handler(line);
+	else if (global_log_handler != NULL)
+		global_log_handler(line);
+	else
+		log_on_stderr(line);
+}
+
 static void
-do_log(const char *suffix, const char *fmt, va_list args)
+do_log(int level, const char *suffix, const char *fmt, va_list args)
 {
 	char line[LINELEN], body[LINELEN];
 
 	vsnprintf(body, sizeof(body), fmt, args);
 
 	if (suffix != NULL)
-		snprintf(line, sizeof(line), "%.180s: %.70s\n", body, suffix);
+		snprintf(line, sizeof(line), "%.180s: %.70s", body, suffix);
 	else
-		snprintf(line, sizeof(line), "%.180s\n", body);
+		snprintf(line, sizeof(line), "%.180s", body);
+
+	log_emit(level, line, sizeof(line));
+}
+
+/* whether a message of 'level' would be emitted in the current context */
+bool
+fido_log_level_ok(int level)
+{
+	const fido_dev_t *dev = log_ctx_get()->dev;
+
+	if (dev != NULL && dev->log_level >= 0)
+		return (level <= dev->log_level);
+
+	return (level <= log_level);
+}
+
+/* enter operation 'op' on 'dev', which may be NULL to inherit the device */
+void
+fido_log_push(const fido_dev_t *dev, const char *op)
+{
+	if (log_ctx_depth < CTXLEN) {
+		log_ctx[log_ctx_depth].dev = dev != NULL ? dev :
+		    log_ctx_get()->dev;
+		log_ctx[log_ctx_depth].op = op;
+	}
+	log_ctx_depth++;
+}
 
-	log_handler(line);
+void
+fido_log_pop(void)
+{
+	if (log_ctx_depth > 0)
+		log_ctx_depth--;
 }
 
 void
 fido_log_init(void)
 {
-	logging = 1;
-	log_handler = log_on_stderr;
+	fido_log_thread = 1;
+	log_handler = NULL;
 }
 
 void
-fido_log_debug(const char *fmt, ...)
+fido_do_log_debug(const char *fmt, ...)
 {
 	va_list args;
 
-	if (!logging || log_handler == NULL)
-		return;
-
 	va_start(args, fmt);
-	do_log(NULL, fmt, args);
+	do_log(FIDO_LOG_DEBUG, NULL, fmt, args);
 	va_end(args);
 }
 
 void
-fido_log_xxd(const void *buf, size_t count, const char *fmt, ...)
+fido_do_log_xxd(const void *buf, size_t count, const char *fmt, ...)
 {
+	static const char hex[] = "0123456789abcdef";
 	const uint8_t *ptr = buf;
-	char row[XXDROW], xxd[XXDLEN];
+	char row[XXDROW];
+	size_t off = 0;
 	va_list args;
 
-	if (!logging || log_handler == NULL)
-		return;
-
 	snprintf(row, sizeof(row), "buf=%p, len=%zu", buf, count);
 	va_start(args, fmt);
-	do_log(row, fmt, args);
+	do_log(FIDO_LOG_XXD, row, fmt, args);
 	va_end(args);
-	*row = '\0';
 
+	/* rows are formatted in place and bypass do_log() */
 	for (size_t i = 0; i < count; i++) {
-		*xxd = '\0';
 		if (i % 16 == 0)
-			snprintf(xxd, sizeof(xxd), "%04zu: %02x", i, *ptr++);
-		else
-			snprintf(xxd, sizeof(xxd), " %02x", *ptr++);
-		strlcat(row, xxd, sizeof(row));
+			off = (size_t)snprintf(row, sizeof(row), "%04zu:", i);
+		row[off++] = ' ';
+		row[off++] = hex[ptr[i] >> 4];
+		row[off++] = hex[ptr[i] & 0xf];
 		if (i % 16 == 15 || i == count - 1) {
-			fido_log_debug("%s", row);
-			*row = '\0';
+			row[off] = '\0';
+			log_emit(FIDO_LOG_XXD, row, sizeof(row));
 		}
 	}
 }
 
 void
-fido_log_error(int errnum, const char *fmt, ...)
+fido_do_log_error(int errnum, const char *fmt, ...)
 {
 	char errstr[LINELEN];
 	va_list args;
 
-	if (!logging || log_handler == NULL)
-		return;
 	if (strerror_r(errnum, errstr, sizeof(errstr)) != 0)
 		snprintf(errstr, sizeof(errstr), "error %d", errnum);
 
 	va_start(args, fmt);
-	do_log(errstr, fmt, args);
+	do_log(FIDO_LOG_ERROR, errstr, fmt, args);
 	va_end(args);
 }
 
@@ -119,4 +191,30 @@ fido_set_log_handler(fido_log_handler_t *handler)
 		log_handler = handler;
 }
 
+void
+fido_set_global_log_handler(fido_log_handler_t *handler)
+{
+	global_log_handler = handler;
+	fido_log_global = handler != NULL || context_handler != NULL;
+}
+
+void
+fido_set_log_context_handler(fido_log_context_handler_t *handler, void *arg)
+{
+	context_handler = handler;
+	context_handler_arg = arg;
+	fido_log_global = handler != NULL || global_log_handler != NULL;
+}
+
+int
+fido_set_log_level(int level)
+{
+	if (level < 0 || level > FIDO_LOG_XXD)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	log_level = level;
+
+	return (FIDO_OK);
+}
+
 #endif /* !FIDO_NO_DIAGNOSTIC */
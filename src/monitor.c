@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "fido.h"
+
+#define MONITOR_MINSCAN	64	/* initial devices per rescan and transport */
+#define MONITOR_MAXSCAN	1024
+
+static const struct monitor_source {
+	const char *type;
+	int flag; /* fido_init() flag disabling the source */
+	int (*manifest)(fido_dev_info_t *, size_t, size_t *);
+} monitor_source[] = {
+	{ "hid", FIDO_MANIFEST_NO_HID, fido_hid_manifest },
+#ifdef USE_NFC
+	{ "nfc", FIDO_MANIFEST_NO_NFC, fido_nfc_manifest },
+#endif
+#ifdef USE_PCSC
+	{ "pcsc", FIDO_MANIFEST_NO_PCSC, fido_pcsc_manifest },
+#endif
+#ifdef USE_WINHELLO
+	{ "winhello", FIDO_MANIFEST_NO_WINHELLO, fido_winhello_manifest },
+#endif
+};
+
+#define MONITOR_HID	0
+#define MONITOR_NSOURCES \
+	(sizeof(monitor_source) / sizeof(monitor_source[0]))
+
+static void
+info_reset(fido_dev_info_t *di)
+{
+	fido_free(di->path);
+	fido_free(di->manufacturer);
+	fido_free(di->product);
+	fido_free(di->serial);
+	memset(di, 0, sizeof(*di));
+}
+
+static bool
+devlist_find(const fido_dev_info_t *devlist, size_t len, const char *path,
+    size_t *idx)
+{
+	for (size_t i = 0; i < len; i++)
+		if (devlist[i].path != NULL &&
+		    strcmp(devlist[i].path, path) == 0) {
+			if (idx != NULL)
+				*idx = i;
+			return (true);
+		}
+
+	return (false);
+}
+
+static int
+monitor_grow(fido_dev_monitor_t *m)
+{
+	fido_dev_info_t	*devlist;
+	size_t		*source;
+	size_t		 cap;
+
+	if (m->len < m->cap)
+		return (0);
+	if (m->cap > SIZE_MAX / 2)
+		return (-1);
+
+	cap = m->cap ? m->cap * 2 : 8;
+
+	if ((devlist = fido_recallocarray(m->devlist, m->cap, cap,
+	    sizeof(*devlist))) == NULL)
+		return (-1);
+	m->devlist = devlist;
+	if ((source = fido_recallocarray(m->source, m->cap, cap,
+	    sizeof(*source))) == NULL)
+		return (-1);
+	m->source = source;
+	m->cap = cap;
+
+	return (0);
+}
+
+/* takes ownership of di's strings on success */
+static int
+monitor_add(fido_dev_monitor_t *m, size_t source, fido_dev_info_t *di)
+{
+	if (monitor_grow(m) < 0) {
+		fido_log_debug("%s: monitor_grow", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	m->devlist[m->len] = *di;
+	m->source[m->len] = source;
+	memset(di, 0, sizeof(*di));
+
+	if (m->cb != NULL)
+		m->cb(m->cb_arg, FIDO_DEV_MONITOR_ADD, &m->devlist[m->len]);
+
+	m->len++;
+
+	return (FIDO_OK);
+}
+
+static void
+monitor_remove(fido_dev_monitor_t *m, size_t idx)
+{
+	if (m->cb != NULL)
+		m->cb(m->cb_arg, FIDO_DEV_MONITOR_REMOVE, &m->devlist[idx]);
+
+	info_reset(&m->devlist[idx]);
+
+	if (idx != --m->len) {
+		m->devlist[idx] = m->devlist[m->len];
+		m->source[idx] = m->source[m->len];
+		memset(&m->devlist[m->len], 0, sizeof(m->devlist[m->len]));
+	}
+}
+
+/* a failed manifest may leave entries past m->scan_len */
+static void
+scan_reset(fido_dev_monitor_t *m)
+{
+	for (size_t i = 0; i < m->scan_cap; i++)
+		info_reset(&m->scan[i]);
+	m->scan_len = 0;
+}
+
+/*
+ * Enumerate source into m->scan, which is kept across rescans. A full
+ * scan may have been truncated, so it is retried with twice the room.
+ */
+static int
+monitor_scan(fido_dev_monitor_t *m, size_t source)
+{
+	fido_dev_info_t	*scan;
+	size_t		 cap;
+	int		 r;
+
+	if (m->scan == NULL) {
+		if ((m->scan = fido_dev_info_new(MONITOR_MINSCAN)) == NULL)
+			return (FIDO_ERR_INTERNAL);
+		m->scan_cap = MONITOR_MINSCAN;
+	}
+
+	for (;;) {
+		if ((r = monitor_source[source].manifest(m->scan, m->scan_cap,
+		    &m->scan_len)) != FIDO_OK)
+			return (r);
+		if (m->scan_len < m->scan_cap || m->scan_cap >= MONITOR_MAXSCAN)
+			return (FIDO_OK);
+		scan_reset(m);
+		cap = m->scan_cap * 2;
+		if ((scan = fido_recallocarray(m->scan, m->scan_cap, cap,
+		    sizeof(*scan))) == NULL)
+			return (FIDO_ERR_INTERNAL);
+		m->scan = scan;
+		m->scan_cap = cap;
+	}
+}
+
+static int
+monitor_rescan(fido_dev_monitor_t *m, size_t source)
+{
+	fido_dev_info_t	*devlist;
+	size_t		 ndevs;
+	int		 r;
+
+	if ((r = monitor_scan(m, source)) != FIDO_OK) {
+		fido_log_debug("%s: %s: 0x%x", __func__,
+		    monitor_source[source].type, r);
+		goto out;
+	}
+	devlist = m->scan;
+	ndevs = m->scan_len;
+
+	/* walk backwards; monitor_remove() swaps in the last entry */
+	for (size_t i = m->len; i > 0; i--)
+		if (m->source[i - 1] == source && !devlist_find(devlist, ndevs,
+		    m->devlist[i - 1].path, NULL))
+			monitor_remove(m, i - 1);
+
+	for (size_t i = 0; i < ndevs; i++) {
+		if (devlist_find(m->devlist, m->len, devlist[i].path, NULL))
+			continue;
+		if ((r = monitor_add(m, source, &devlist[i])) != FIDO_OK)
+			goto out;
+	}
+
+	r = FIDO_OK;
+out:
+	scan_reset(m);
+
+	return (r);
+}
+
+#ifdef USE_HID_MONITOR
+static int
+monitor_drain_hid(fido_dev_monitor_t *m)
+{
+	fido_dev_info_t	di;
+	size_t		idx;
+	int		event;
+	int		r;
+
+	while ((r = fido_hid_monitor_read(m->hid, &event, &di)) == 1) {
+		if (event == FIDO_DEV_MONITOR_REMOVE) {
+			if (devlist_find(m->devlist, m->len, di.path, &idx))
+				monitor_remove(m, idx);
+		} else if (!devlist_find(m->devlist, m->len, di.path, NULL)) {
+			if ((r = monitor_add(m, MONITOR_HID, &di)) != FIDO_OK) {
+				info_reset(&di);
+				return (r);
+			}
+		}
+		info_reset(&di);
+	}
+
+	if (r < 0) {
+		fido_log_debug("%s: fido_hid_monitor_read", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	return (FIDO_OK);
+}
+#endif /* USE_HID_MONITOR */
+
+fido_dev_monitor_t *
+fido_dev_monitor_new(void)
+{
+	return (fido_calloc(1, sizeof(fido_dev_monitor_t)));
+}
+
+void
+fido_dev_monitor_free(fido_dev_monitor_t **m_p)
+{
+	fido_dev_monitor_t *m;
+
+	if (m_p == NULL || (m = *m_p) == NULL)
+		return;
+
+#ifdef USE_HID_MONITOR
+	if (m->hid != NULL)
+		fido_hid_monitor_close(m->hid);
+#endif
+	fido_dev_info_free(&m->devlist, m->cap);
+	fido_dev_info_free(&m->scan, m->scan_cap);
+	fido_free(m->source);
+	fido_free(m);
+
+	*m_p = NULL;
+}
+
+int
+fido_dev_monitor_set_cb(fido_dev_monitor_t *m, fido_dev_monitor_cb_t *cb,
+    void *cb_arg)
+{
+	m->cb = cb;
+	m->cb_arg = cb_arg;
+
+	return (FIDO_OK);
+}
+
+int
+fido_dev_monitor_start(fido_dev_monitor_t *m)
+{
+	int r;
+
+	if (m->started)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+#ifdef USE_HID_MONITOR
+	/* subscribe before enumerating so that no event falls in between */
+	if (!fido_manifest_disabled(FIDO_MANIFEST_NO_HID) &&
+	    (m->hid = fido_hid_monitor_open()) == NULL)
+		fido_log_debug("%s: no hid events, rescanning", __func__);
+#endif
+	for (size_t i = 0; i < MONITOR_NSOURCES; i++)
+		if (!fido_manifest_disabled(monitor_source[i].flag) &&
+		    (r = monitor_rescan(m, i)) != FIDO_OK)
+			fido_log_debug("%s: %s: 0x%x", __func__,
+			    monitor_source[i].type, r);
+
+	m->started = true;
+
+	return (FIDO_OK);
+}
+
+int
+fido_dev_monitor_fd(const fido_dev_monitor_t *m)
+{
+#ifdef USE_HID_MONITOR
+	if (m->hid != NULL)
+		return (fido_hid_monitor_fd(m->hid));
+#else
+	(void)m;
+#endif
+	return (-1);
+}
+
+int
+fido_dev_monitor_poll(fido_dev_monitor_t *m, int ms)
+{
+	int r;
+
+	if (!m->started)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	for (size_t i = 0; i < MONITOR_NSOURCES; i++) {
+		if (fido_manifest_disabled(monitor_source[i].flag))
+			continue;
+#ifdef USE_HID_MONITOR
+		if (i == MONITOR_HID && m->hid != NULL) {
+			/* a timeout is not an error */
+			if (ms != 0)
+				(void)fido_hid_unix_wait(
+				    fido_hid_monitor_fd(m->hid), ms, NULL);
+			if ((r = monitor_drain_hid(m)) != FIDO_OK)
+				return (r);
+			continue;
+		}
+#endif
+		if ((r = monitor_rescan(m, i)) != FIDO_OK)
+			fido_log_debug("%s: %s: 0x%x", __func__,
+			    monitor_source[i].type, r);
+	}
+
+	(void)ms;
+
+	return (FIDO_OK);
+}
+
+size_t
+fido_dev_monitor_len(const fido_dev_monitor_t *m)
+{
+	return (m->len);
+}
+
+const fido_dev_info_t *
+fido_dev_monitor_ptr(const fido_dev_monitor_t *m, size_t idx)
+{
+	if (idx >= m->len)
+		return (NULL);
+
+	return (&m->devlist[idx]);
+}
@@ -32,6 +32,7 @@ static ssize_t (*fuzz_write)(int, const void *, size_t);
 #endif
 
 #define NETLINK_POLL_MS	100
+#define NETLINK_MSG_LEN	64
 
 /* XXX avoid signed NLA_ALIGNTO */
 #undef NLA_HDRLEN
@@ -48,6 +49,12 @@ typedef struct nlmsgbuf {
 	unsigned char  payload[];
 } nlmsgbuf_t;
 
+/* storage for an outgoing message built by nlmsg_init() */
+typedef union nlmsgstorage {
+	nlmsgbuf_t    m;
+	unsigned char buf[sizeof(nlmsgbuf_t) + NETLINK_MSG_LEN];
+} nlmsgstorage_t;
+
 typedef struct genlmsgbuf {
 	union {
 		struct genlmsghdr genl;
@@ -99,19 +106,16 @@ nlmsg_type(const nlmsgbuf_t *m)
 	return (m->u.nlmsg.nlmsg_type);
 }
 
+/* build a message in the siz bytes at m, which must be suitably aligned */
 static nlmsgbuf_t *
-nlmsg_new(uint16_t type, uint16_t flags, size_t len)
+nlmsg_init(nlmsgbuf_t *m, size_t siz, uint16_t type, uint16_t flags)
 {
-	nlmsgbuf_t *m;
-	size_t siz;
-
-	if (len > SIZE_MAX - sizeof(*m) ||
-	    (siz = sizeof(*m) + len) > UINT16_MAX ||
-	    (m = calloc(1, siz)) == NULL)
+	if (siz < sizeof(*m) || siz > UINT16_MAX)
 		return (NULL);
 
+	memset(m, 0, siz);
 	m->siz = siz;
-	m->len = len;
+	m->len = siz - sizeof(*m);
 	m->ptr = m->payload;
 	m->u.nlmsg.nlmsg_type = type;
 	m->u.nlmsg.nlmsg_flags = NLM_F_REQUEST | flags;
@@ -120,39 +124,39 @@ nlmsg_new(uint16_t type, uint16_t flags, size_t len)
 	return (m);
 }
 
-static nlamsgbuf_t *
-nla_from_buf(const unsigned char **ptr, size_t *len)
+/*
+ * Parse the attribute at *ptr into a. The attribute's header is copied;
+ * its payload is not, and a->ptr points into the caller's buffer.
+ */
+static int
+nla_from_buf(nlamsgbuf_t *a, unsigned char **ptr, size_t *len)
 {
-	nlamsgbuf_t h, *a;
 	size_t nlalen, skip;
 
-	if (*len < sizeof(h.u))
-		return (NULL);
+	if (*len < sizeof(a->u))
+		return (-1);
 
-	memset(&h, 0, sizeof(h));
-	memcpy(&h.u, *ptr, sizeof(h.u));
+	memset(a, 0, sizeof(*a));
+	memcpy(&a->u, *ptr, sizeof(a->u));
 
-	if ((nlalen = h.u.nla.nla_len) < sizeof(h.u) || nlalen > *len ||
-	    nlalen - sizeof(h.u) > UINT16_MAX ||
-	    nlalen > SIZE_MAX - sizeof(*a) ||
-	    (skip = NLMSG_ALIGN(nlalen)) > *len ||
-	    (a = calloc(1, sizeof(*a) + nlalen - sizeof(h.u))) == NULL)
-		return (NULL);
+	if ((nlalen = a->u.nla.nla_len) < sizeof(a->u) || nlalen > *len ||
+	    nlalen - sizeof(a->u) > UINT16_MAX ||
+	    (skip = NLMSG_ALIGN(nlalen)) > *len)
+		return (-1);
 
-	memcpy(&a->u, *ptr, nlalen);
-	a->siz = sizeof(*a) + nlalen - sizeof(h.u);
-	a->ptr = a->payload;
-	a->len = nlalen - sizeof(h.u);
+	a->siz = sizeof(*a);
+	a->ptr = *ptr + sizeof(a->u);
+	a->len = nlalen - sizeof(a->u);
 	*ptr += skip;
 	*len -= skip;
 
-	return (a);
+	return (0);
 }
 
-static nlamsgbuf_t *
-nla_getattr(nlamsgbuf_t *a)
+static int
+nla_getattr(nlamsgbuf_t *a, nlamsgbuf_t *out)
 {
-	return (nla_from_buf((void *)&a->ptr, &a->len));
+	return (nla_from_buf(out, &a->ptr, &a->len));
 }
 
 static uint16_t
@@ -161,10 +165,10 @@ nla_type(const nlamsgbuf_t *a)
 	return (a->u.nla.nla_type);
 }
 
-static nlamsgbuf_t *
-nlmsg_getattr(nlmsgbuf_t *m)
+static int
+nlmsg_getattr(nlmsgbuf_t *m, nlamsgbuf_t *out)
 {
-	return (nla_from_buf((void *)&m->ptr, &m->len));
+	return (nla_from_buf(out, &m->ptr, &m->len));
 }
 
 static int
@@ -179,29 +183,30 @@ nla_read(nlamsgbuf_t *a, void *buf, size_t cnt)
 	return (0);
 }
 
-static nlmsgbuf_t *
-nlmsg_from_buf(const unsigned char **ptr, size_t *len)
+/* like nla_from_buf(), for the message at *ptr */
+static int
+nlmsg_from_buf(nlmsgbuf_t *m, unsigned char **ptr, size_t *len)
 {
-	nlmsgbuf_t h, *m;
 	size_t msglen, skip;
 
-	if (*len < sizeof(h.u))
-		return (NULL);
+	if (*len < sizeof(m->u))
+		return (-1);
 
-	memset(&h, 0, sizeof(h));
-	memcpy(&h.u, *ptr, sizeof(h.u));
+	memset(m, 0, sizeof(*m));
+	memcpy(&m->u, *ptr, sizeof(m->u));
 
-	if ((msglen = h.u.nlmsg.nlmsg_len) < sizeof(h.u) || msglen > *len ||
-	    msglen - sizeof(h.u) > UINT16_MAX ||
-	    (skip = NLMSG_ALIGN(msglen)) > *len ||
-	    (m = nlmsg_new(0, 0, msglen - sizeof(h.u))) == NULL)
-		return (NULL);
+	if ((msglen = m->u.nlmsg.nlmsg_len) < sizeof(m->u) || msglen > *len ||
+	    msglen - sizeof(m->u) > UINT16_MAX ||
+	    (skip = NLMSG_ALIGN(msglen)) > *len)
+		return (-1);
 
-	memcpy(&m->u, *ptr, msglen);
+	m->siz = sizeof(*m);
+	m->ptr = *ptr + sizeof(m->u);
+	m->len = msglen - sizeof(m->u);
 	*ptr += skip;
 	*len -= skip;
 
-	return (m);
+	return (0);
 }
 
 static int
@@ -269,25 +274,21 @@ nlmsg_get_status(nlmsgbuf_t *m)
 static int
 nlmsg_setattr(nlmsgbuf_t *m, uint16_t type, const void *ptr, size_t len)
 {
-	int r;
-	char *padding;
+	static const char padding[NLMSG_ALIGNTO];
 	size_t skip;
 	nlamsgbuf_t a;
 
 	if ((skip = NLMSG_ALIGN(len)) > UINT16_MAX - sizeof(a.u) ||
-	    skip < len || (padding = calloc(1, skip - len)) == NULL)
+	    skip < len || skip - len > sizeof(padding))
 		return (-1);
 
 	memset(&a, 0, sizeof(a));
 	a.u.nla.nla_type = type;
 	a.u.nla.nla_len = (uint16_t)(len + sizeof(a.u));
-	r = nlmsg_write(m, &a.u, sizeof(a.u)) < 0 ||
-	    nlmsg_write(m, ptr, len) < 0 ||
-	    nlmsg_write(m, padding, skip - len) < 0 ? -1 : 0;
-
-	free(padding);
 
-	return (r);
+	return (nlmsg_write(m, &a.u, sizeof(a.u)) < 0 ||
+	    nlmsg_write(m, ptr, len) < 0 ||
+	    nlmsg_write(m, padding, skip - len) < 0 ? -1 : 0);
 }
 
 static int
@@ -327,8 +328,8 @@ nla_get_str(nlamsgbuf_t *a)
 	char *s = NULL;
 
 	if ((n = a->len) < 1 || a->ptr[n - 1] != '\0' ||
-	    (s = calloc(1, n)) == NULL || nla_read(a, s, n) < 0) {
-		free(s);
+	    (s = fido_calloc(1, n)) == NULL || nla_read(a, s, n) < 0) {
+		fido_free(s);
 		return (NULL);
 	}
 	s[n - 1] = '\0';
@@ -379,13 +380,10 @@ nlmsg_rx(int fd, unsigned char *ptr, size_t len, int ms)
 static int
 nlmsg_iter(nlmsgbuf_t *m, void *arg, int (*parser)(nlamsgbuf_t *, void *))
 {
-	nlamsgbuf_t *a;
-	int r;
+	nlamsgbuf_t a;
 
-	while ((a = nlmsg_getattr(m)) != NULL) {
-		r = parser(a, arg);
-		free(a);
-		if (r < 0) {
+	while (nlmsg_getattr(m, &a) == 0) {
+		if (parser(&a, arg) < 0) {
 			fido_log_debug("%s: parser", __func__);
 			return (-1);
 		}
@@ -397,13 +395,10 @@ nlmsg_iter(nlmsgbuf_t *m, void *arg, int (*parser)(nlamsgbuf_t *, void *))
 static int
 nla_iter(nlamsgbuf_t *g, void *arg, int (*parser)(nlamsgbuf_t *, void *))
 {
-	nlamsgbuf_t *a;
-	int r;
+	nlamsgbuf_t a;
 
-	while ((a = nla_getattr(g)) != NULL) {
-		r = parser(a, arg);
-		free(a);
-		if (r < 0) {
+	while (nla_getattr(g, &a) == 0) {
+		if (parser(&a, arg) < 0) {
 			fido_log_debug("%s: parser", __func__);
 			return (-1);
 		}
@@ -413,34 +408,27 @@ nla_iter(nlamsgbuf_t *g, void *arg, int (*parser)(nlamsgbuf_t *, void *))
 }
 
 static int
-nl_parse_reply(const uint8_t *blob, size_t blob_len, uint16_t msg_type,
+nl_parse_reply(uint8_t *blob, size_t blob_len, uint16_t msg_type,
     uint8_t genl_cmd, void *arg, int (*parser)(nlamsgbuf_t *, void *))
 {
-	nlmsgbuf_t *m;
-	int r;
+	nlmsgbuf_t m;
 
 	while (blob_len) {
-		if ((m = nlmsg_from_buf(&blob, &blob_len)) == NULL) {
+		if (nlmsg_from_buf(&m, &blob, &blob_len) < 0) {
 			fido_log_debug("%s: nlmsg", __func__);
 			return (-1);
 		}
-		if (nlmsg_type(m) == NLMSG_ERROR) {
-			r = nlmsg_get_status(m);
-			free(m);
-			return (r);
-		}
-		if (nlmsg_type(m) != msg_type ||
-		    nlmsg_get_genl(m, genl_cmd) < 0) {
+		if (nlmsg_type(&m) == NLMSG_ERROR)
+			return (nlmsg_get_status(&m));
+		if (nlmsg_type(&m) != msg_type ||
+		    nlmsg_get_genl(&m, genl_cmd) < 0) {
 			fido_log_debug("%s: skipping", __func__);
-			free(m);
 			continue;
 		}
-		if (parser != NULL && nlmsg_iter(m, arg, parser) < 0) {
+		if (parser != NULL && nlmsg_iter(&m, arg, parser) < 0) {
 			fido_log_debug("%s: nlmsg_iter", __func__);
-			free(m);
 			return (-1);
 		}
-		free(m);
 	}
 
 	return (0);
@@ -456,10 +444,10 @@ parse_mcastgrp(nlamsgbuf_t *a, void *arg)
 	case CTRL_ATTR_MCAST_GRP_NAME:
 		if ((name = nla_get_str(a)) == NULL ||
 		    strcmp(name, NFC_GENL_MCAST_EVENT_NAME) != 0) {
-			free(name);
+			fido_free(name);
 			return (-1); /* XXX skip? */
 		}
-		free(name);
+		fido_free(name);
 		return (0);
 	case CTRL_ATTR_MCAST_GRP_ID:
 		if (family->mcastgrp)
@@ -508,21 +496,20 @@ parse_family(nlamsgbuf_t *a, void *arg)
 static int
 nl_get_nfc_family(int fd, uint16_t *type, uint32_t *mcastgrp)
 {
+	nlmsgstorage_t st;
 	nlmsgbuf_t *m;
 	uint8_t reply[512];
 	nl_family_t family;
 	ssize_t r;
 	int ok;
 
-	if ((m = nlmsg_new(GENL_ID_CTRL, 0, 64)) == NULL ||
+	m = nlmsg_init(&st.m, sizeof(st), GENL_ID_CTRL, 0);
+	if (m == NULL ||
 	    nlmsg_set_genl(m, CTRL_CMD_GETFAMILY) < 0 ||
 	    nlmsg_set_u16(m, CTRL_ATTR_FAMILY_ID, GENL_ID_CTRL) < 0 ||
 	    nlmsg_set_str(m, CTRL_ATTR_FAMILY_NAME, NFC_GENL_NAME) < 0 ||
-	    nlmsg_tx(fd, m) < 0) {
-		free(m);
+	    nlmsg_tx(fd, m) < 0)
 		return (-1);
-	}
-	free(m);
 	memset(&family, 0, sizeof(family));
 	if ((r = nlmsg_rx(fd, reply, sizeof(reply), -1)) < 0) {
 		fido_log_debug("%s: nlmsg_rx", __func__);
@@ -564,19 +551,18 @@ parse_target(nlamsgbuf_t *a, void *arg)
 int
 fido_nl_power_nfc(fido_nl_t *nl, uint32_t dev)
 {
+	nlmsgstorage_t st;
 	nlmsgbuf_t *m;
 	uint8_t reply[512];
 	ssize_t r;
 	int ok;
 
-	if ((m = nlmsg_new(nl->nfc_type, NLM_F_ACK, 64)) == NULL ||
+	m = nlmsg_init(&st.m, sizeof(st), nl->nfc_type, NLM_F_ACK);
+	if (m == NULL ||
 	    nlmsg_set_genl(m, NFC_CMD_DEV_UP) < 0 ||
 	    nlmsg_set_u32(m, NFC_ATTR_DEVICE_INDEX, dev) < 0 ||
-	    nlmsg_tx(nl->fd, m) < 0) {
-		free(m);
+	    nlmsg_tx(nl->fd, m) < 0)
 		return (-1);
-	}
-	free(m);
 	if ((r = nlmsg_rx(nl->fd, reply, sizeof(reply), -1)) < 0) {
 		fido_log_debug("%s: nlmsg_rx", __func__);
 		return (-1);
@@ -593,20 +579,19 @@ fido_nl_power_nfc(fido_nl_t *nl, uint32_t dev)
 static int
 nl_nfc_poll(fido_nl_t *nl, uint32_t dev)
 {
+	nlmsgstorage_t st;
 	nlmsgbuf_t *m;
 	uint8_t reply[512];
 	ssize_t r;
 	int ok;
 
-	if ((m = nlmsg_new(nl->nfc_type, NLM_F_ACK, 64)) == NULL ||
+	m = nlmsg_init(&st.m, sizeof(st), nl->nfc_type, NLM_F_ACK);
+	if (m == NULL ||
 	    nlmsg_set_genl(m, NFC_CMD_START_POLL) < 0 ||
 	    nlmsg_set_u32(m, NFC_ATTR_DEVICE_INDEX, dev) < 0 ||
 	    nlmsg_set_u32(m, NFC_ATTR_PROTOCOLS, NFC_PROTO_ISO14443_MASK) < 0 ||
-	    nlmsg_tx(nl->fd, m) < 0) {
-		free(m);
+	    nlmsg_tx(nl->fd, m) < 0)
 		return (-1);
-	}
-	free(m);
 	if ((r = nlmsg_rx(nl->fd, reply, sizeof(reply), -1)) < 0) {
 		fido_log_debug("%s: nlmsg_rx", __func__);
 		return (-1);
@@ -623,20 +608,19 @@ nl_nfc_poll(fido_nl_t *nl, uint32_t dev)
 static int
 nl_dump_nfc_target(fido_nl_t *nl, uint32_t dev, uint32_t *target, int ms)
 {
+	nlmsgstorage_t st;
 	nlmsgbuf_t *m;
 	nl_target_t t;
 	uint8_t reply[512];
 	ssize_t r;
 	int ok;
 
-	if ((m = nlmsg_new(nl->nfc_type, NLM_F_DUMP, 64)) == NULL ||
+	m = nlmsg_init(&st.m, sizeof(st), nl->nfc_type, NLM_F_DUMP);
+	if (m == NULL ||
 	    nlmsg_set_genl(m, NFC_CMD_GET_TARGET) < 0 ||
 	    nlmsg_set_u32(m, NFC_ATTR_DEVICE_INDEX, dev) < 0 ||
-	    nlmsg_tx(nl->fd, m) < 0) {
-		free(m);
+	    nlmsg_tx(nl->fd, m) < 0)
 		return (-1);
-	}
-	free(m);
 	if ((r = nlmsg_rx(nl->fd, reply, sizeof(reply), ms)) < 0) {
 		fido_log_debug("%s: nlmsg_rx", __func__);
 		return (-1);
@@ -728,6 +712,18 @@ fido_nl_get_nfc_target(fido_nl_t *nl, uint32_t dev, uint32_t *target)
 	return (0);
 }
 
+/* look up a target found by an earlier poll, without polling again */
+int
+fido_nl_find_nfc_target(fido_nl_t *nl, uint32_t dev, uint32_t *target)
+{
+	if (nl_dump_nfc_target(nl, dev, target, NETLINK_POLL_MS) < 0) {
+		fido_log_debug("%s: nl_dump_nfc_target", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
 void
 fido_nl_free(fido_nl_t **nlp)
 {
@@ -738,7 +734,7 @@ fido_nl_free(fido_nl_t **nlp)
 	if (nl->fd != -1 && close(nl->fd) == -1)
 		fido_log_error(errno, "%s: close", __func__);
 
-	free(nl);
+	fido_free(nl);
 	*nlp = NULL;
 }
 
@@ -748,7 +744,7 @@ fido_nl_new(void)
 	fido_nl_t *nl;
 	int ok = -1;
 
-	if ((nl = calloc(1, sizeof(*nl))) == NULL)
+	if ((nl = fido_calloc(1, sizeof(*nl))) == NULL)
 		return (NULL);
 	if ((nl->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC,
 	    NETLINK_GENERIC)) == -1) {
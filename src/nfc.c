@@ -59,10 +59,69 @@ fail:
 	return ok;
 }
 
+static int
+tx_ext_apdu(fido_dev_t *d, const iso7816_header_t *h, const uint8_t *payload,
+    uint16_t payload_len, uint8_t cla_flags)
+{
+	uint8_t *apdu;
+	uint8_t sw[2];
+	size_t apdu_len;
+	int ok = -1;
+
+	apdu_len = (size_t)(7 + payload_len + 2);
+	if ((apdu = fido_calloc(1, apdu_len)) == NULL)
+		return -1;
+
+	apdu[0] = h->cla | cla_flags;
+	apdu[1] = h->ins;
+	apdu[2] = h->p1;
+	apdu[3] = h->p2;
+	apdu[5] = (uint8_t)(payload_len >> 8);
+	apdu[6] = (uint8_t)(payload_len & 0xff);
+	memcpy(&apdu[7], payload, payload_len);
+	apdu[7 + payload_len] = (uint8_t)(ISO7816_EXT_LEN >> 8);
+	apdu[8 + payload_len] = (uint8_t)(ISO7816_EXT_LEN & 0xff);
+
+	if (d->io.write(d->io_handle, apdu, apdu_len) < 0) {
+		fido_log_debug("%s: write", __func__);
+		goto fail;
+	}
+
+	if (cla_flags & 0x10) {
+		if (d->io.read(d->io_handle, sw, sizeof(sw), -1) != 2) {
+			fido_log_debug("%s: read", __func__);
+			goto fail;
+		}
+		if ((sw[0] << 8 | sw[1]) != SW_NO_ERROR) {
+			fido_log_debug("%s: unexpected sw", __func__);
+			goto fail;
+		}
+	}
+
+	ok = 0;
+fail:
+	fido_freezero(apdu, apdu_len);
+
+	return ok;
+}
+
+static int
+tx_apdu(fido_dev_t *d, const iso7816_header_t *h, const uint8_t *payload,
+    size_t payload_len, uint8_t cla_flags)
+{
+	/* commands without data gain nothing from the extended encoding */
+	if (d->nfc_ext && payload_len > 0)
+		return tx_ext_apdu(d, h, payload, (uint16_t)payload_len,
+		    cla_flags);
+
+	return tx_short_apdu(d, h, payload, (uint8_t)payload_len, cla_flags);
+}
+
 static int
 nfc_do_tx(fido_dev_t *d, const uint8_t *apdu_ptr, size_t apdu_len)
 {
 	iso7816_header_t h;
+	const size_t chunk = d->nfc_ext ? ISO7816_EXT_LEN : TX_CHUNK_SIZE;
 
 	if (fido_buf_read(&apdu_ptr, &apdu_len, &h, sizeof(h)) < 0) {
 		fido_log_debug("%s: header", __func__);
@@ -75,26 +134,51 @@ nfc_do_tx(fido_dev_t *d, const uint8_t *apdu_ptr, size_t apdu_len)
 
 	apdu_len -= 2; /* trim le1 le2 */
 
-	while (apdu_len > TX_CHUNK_SIZE) {
-		if (tx_short_apdu(d, &h, apdu_ptr, TX_CHUNK_SIZE, 0x10) < 0) {
+	while (apdu_len > chunk) {
+		if (tx_apdu(d, &h, apdu_ptr, chunk, 0x10) < 0) {
 			fido_log_debug("%s: chain", __func__);
 			return -1;
 		}
-		apdu_ptr += TX_CHUNK_SIZE;
-		apdu_len -= TX_CHUNK_SIZE;
+		apdu_ptr += chunk;
+		apdu_len -= chunk;
 	}
 
-	if (tx_short_apdu(d, &h, apdu_ptr, (uint8_t)apdu_len, 0) < 0) {
-		fido_log_debug("%s: tx_short_apdu", __func__);
+	if (tx_apdu(d, &h, apdu_ptr, apdu_len, 0) < 0) {
+		fido_log_debug("%s: tx_apdu", __func__);
 		return -1;
 	}
 
 	return 0;
 }
 
+static int
+tx_select(fido_dev_t *d)
+{
+	iso7816_buf_t abuf;
+	iso7816_apdu_t *apdu = NULL;
+	int ok = -1;
+
+	if ((apdu = iso7816_init(&abuf, 0, 0xa4, 0x04, sizeof(aid))) == NULL ||
+	    iso7816_add(apdu, aid, sizeof(aid)) < 0) {
+		fido_log_debug("%s: iso7816", __func__);
+		goto fail;
+	}
+	if (nfc_do_tx(d, iso7816_ptr(apdu), iso7816_len(apdu)) < 0) {
+		fido_log_debug("%s: nfc_do_tx", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	iso7816_free(&apdu);
+
+	return ok;
+}
+
 int
 fido_nfc_tx(fido_dev_t *d, uint8_t cmd, const unsigned char *buf, size_t count)
 {
+	iso7816_buf_t abuf;
 	iso7816_apdu_t *apdu = NULL;
 	const uint8_t *ptr;
 	size_t len;
@@ -102,15 +186,19 @@ fido_nfc_tx(fido_dev_t *d, uint8_t cmd, const unsigned char *buf, size_t count)
 
 	switch (cmd) {
 	case CTAP_CMD_INIT: /* select */
-		if ((apdu = iso7816_new(0, 0xa4, 0x04, sizeof(aid))) == NULL ||
-		    iso7816_add(apdu, aid, sizeof(aid)) < 0) {
-			fido_log_debug("%s: iso7816", __func__);
-			goto fail;
-		}
-		break;
+		/*
+		 * Select the applet with an extended-length apdu; rx_init()
+		 * falls back to short apdus if the card or reader refuses.
+		 */
+		d->nfc_ext = true;
+		if (tx_select(d) == 0)
+			return 0;
+		fido_log_debug("%s: no extended-length apdus", __func__);
+		d->nfc_ext = false;
+		return tx_select(d);
 	case CTAP_CMD_CBOR: /* wrap cbor */
-		if (count > UINT16_MAX || (apdu = iso7816_new(0x80, 0x10, 0x00,
-		    (uint16_t)count)) == NULL ||
+		if (count > UINT16_MAX || (apdu = iso7816_init(&abuf, 0x80,
+		    0x10, 0x00, (uint16_t)count)) == NULL ||
 		    iso7816_add(apdu, buf, count) < 0) {
 			fido_log_debug("%s: iso7816", __func__);
 			goto fail;
@@ -157,11 +245,24 @@ rx_init(fido_dev_t *d, unsigned char *buf, size_t count, int ms)
 
 	memset(attr, 0, sizeof(*attr));
 
-	if ((n = d->io.read(d->io_handle, f, sizeof(f), ms)) < 2 ||
-	    (f[n - 2] << 8 | f[n - 1]) != SW_NO_ERROR) {
+	if ((n = d->io.read(d->io_handle, f, sizeof(f), ms)) < 2) {
 		fido_log_debug("%s: read", __func__);
 		return -1;
 	}
+	if ((f[n - 2] << 8 | f[n - 1]) != SW_NO_ERROR && d->nfc_ext) {
+		/* typically SW_WRONG_LENGTH; select again with a short apdu */
+		fido_log_debug("%s: no extended-length apdus", __func__);
+		d->nfc_ext = false;
+		if (tx_select(d) < 0 ||
+		    (n = d->io.read(d->io_handle, f, sizeof(f), ms)) < 2) {
+			fido_log_debug("%s: select", __func__);
+			return -1;
+		}
+	}
+	if ((f[n - 2] << 8 | f[n - 1]) != SW_NO_ERROR) {
+		fido_log_debug("%s: sw", __func__);
+		return -1;
+	}
 
 	n -= 2;
 
@@ -186,13 +287,23 @@ rx_init(fido_dev_t *d, unsigned char *buf, size_t count, int ms)
 static int
 tx_get_response(fido_dev_t *d, uint8_t count)
 {
-	uint8_t apdu[5];
+	uint8_t apdu[7];
+	size_t apdu_len;
 
 	memset(apdu, 0, sizeof(apdu));
 	apdu[1] = 0xc0; /* GET_RESPONSE */
-	apdu[4] = count;
 
-	if (d->io.write(d->io_handle, apdu, sizeof(apdu)) < 0) {
+	if (d->nfc_ext) {
+		/* fetch up to Ne bytes at once, regardless of sw2 */
+		apdu[5] = (uint8_t)(ISO7816_EXT_LEN >> 8);
+		apdu[6] = (uint8_t)(ISO7816_EXT_LEN & 0xff);
+		apdu_len = 7;
+	} else {
+		apdu[4] = count;
+		apdu_len = 5;
+	}
+
+	if (d->io.write(d->io_handle, apdu, apdu_len) < 0) {
 		fido_log_debug("%s: write", __func__);
 		return -1;
 	}
@@ -200,67 +311,95 @@ tx_get_response(fido_dev_t *d, uint8_t count)
 	return 0;
 }
 
+/*
+ * Read a response apdu of at most len bytes, status word included. The
+ * data is read in place if it is sure to fit; otherwise, it goes through
+ * a scratch buffer, allocated on first use and freed by the caller.
+ */
 static int
-rx_apdu(fido_dev_t *d, uint8_t sw[2], unsigned char **buf, size_t *count, int *ms)
+rx_apdu(fido_dev_t *d, size_t len, uint8_t **scratch, uint8_t sw[2],
+    unsigned char **buf, size_t *count, fido_deadline_t *dl)
 {
-	uint8_t f[256 + 2];
-	struct timespec ts;
-	int n, ok = -1;
+	uint8_t *dst;
+	int ms, n;
 
-	if (fido_time_now(&ts) != 0)
-		goto fail;
+	if (*count >= len)
+		dst = *buf;
+	else if ((dst = *scratch) == NULL &&
+	    (dst = *scratch = fido_malloc(ISO7816_EXT_LEN + 2)) == NULL)
+		return -1;
+
+	if (fido_time_wait(dl, &ms) != 0)
+		return -1;
 
-	if ((n = d->io.read(d->io_handle, f, sizeof(f), *ms)) < 2) {
+	if ((n = d->io.read(d->io_handle, dst, len, ms)) < 2) {
 		fido_log_debug("%s: read", __func__);
-		goto fail;
+		return -1;
 	}
 
-	if (fido_time_delta(&ts, ms) != 0)
-		goto fail;
+	memcpy(sw, dst + n - 2, 2);
 
-	if (fido_buf_write(buf, count, f, (size_t)(n - 2)) < 0) {
-		fido_log_debug("%s: fido_buf_write", __func__);
-		goto fail;
+	if (dst == *buf) {
+		/* the status word is overwritten by the next piece */
+		*buf += n - 2;
+		*count -= (size_t)(n - 2);
+	} else {
+		if (fido_buf_write(buf, count, dst, (size_t)(n - 2)) < 0) {
+			fido_log_debug("%s: fido_buf_write", __func__);
+			explicit_bzero(dst, (size_t)n);
+			return -1;
+		}
+		explicit_bzero(dst, (size_t)n);
 	}
 
-	memcpy(sw, f + n - 2, 2);
-
-	ok = 0;
-fail:
-	explicit_bzero(f, sizeof(f));
-
-	return ok;
+	return 0;
 }
 
 static int
 rx_msg(fido_dev_t *d, unsigned char *buf, size_t count, int ms)
 {
+	fido_deadline_t dl;
 	uint8_t sw[2];
+	uint8_t *scratch = NULL;
 	const size_t bufsiz = count;
+	const size_t max = d->nfc_ext ? ISO7816_EXT_LEN + 2 : 256 + 2;
+	size_t len;
+	int r = -1;
 
-	if (rx_apdu(d, sw, &buf, &count, &ms) < 0) {
+	if (fido_time_deadline(&dl, ms, NULL) != 0 ||
+	    rx_apdu(d, max, &scratch, sw, &buf, &count, &dl) < 0) {
 		fido_log_debug("%s: preamble", __func__);
-		return -1;
+		goto fail;
 	}
 
-	while (sw[0] == SW1_MORE_DATA)
+	while (sw[0] == SW1_MORE_DATA) {
+		/* with short apdus, sw2 is the length of the next piece */
+		if (d->nfc_ext)
+			len = max;
+		else
+			len = (sw[1] == 0 ? 256 : sw[1]) + (size_t)2;
 		if (tx_get_response(d, sw[1]) < 0 ||
-		    rx_apdu(d, sw, &buf, &count, &ms) < 0) {
+		    rx_apdu(d, len, &scratch, sw, &buf, &count, &dl) < 0) {
 			fido_log_debug("%s: chain", __func__);
-			return -1;
+			goto fail;
 		}
+	}
 
 	if (fido_buf_write(&buf, &count, sw, sizeof(sw)) < 0) {
 		fido_log_debug("%s: sw", __func__);
-		return -1;
+		goto fail;
 	}
 
 	if (bufsiz - count > INT_MAX) {
 		fido_log_debug("%s: bufsiz", __func__);
-		return -1;
+		goto fail;
 	}
 
-	return (int)(bufsiz - count);
+	r = (int)(bufsiz - count);
+fail:
+	fido_free(scratch);
+
+	return r;
 }
 
 static int
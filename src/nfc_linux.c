@@ -22,6 +22,13 @@
 #include "fido/param.h"
 #include "netlink.h"
 #include "iso7816.h"
+#include "dlopen.h"
+
+#ifndef TLS
+#define TLS
+#endif
+
+#define NL_CACHE_LEN	4
 
 struct nfc_linux {
 	int             fd;
@@ -30,8 +37,50 @@ struct nfc_linux {
 	sigset_t	sigmask;
 	const sigset_t *sigmaskp;
 	struct fido_nl *nl;
+	bool            nl_ok;	/* nl may be reused by the next open */
 };
 
+/*
+ * Netlink sockets of powered adapters, kept across fido_nfc_open() and
+ * fido_nfc_close() in the executing thread. A cached socket has already
+ * resolved the nfc generic netlink family, and its adapter is up.
+ */
+static TLS struct nl_cache {
+	struct fido_nl *nl;
+	uint32_t        dev;
+} nl_cache[NL_CACHE_LEN];
+
+static struct fido_nl *
+nl_cache_take(uint32_t dev)
+{
+	struct fido_nl *nl;
+
+	for (size_t i = 0; i < NL_CACHE_LEN; i++)
+		if ((nl = nl_cache[i].nl) != NULL && nl_cache[i].dev == dev) {
+			nl_cache[i].nl = NULL;
+			return nl;
+		}
+
+	return NULL;
+}
+
+static void
+nl_cache_put(uint32_t dev, struct fido_nl **nlp)
+{
+#ifndef FIDO_FUZZ
+	for (size_t i = 0; i < NL_CACHE_LEN; i++)
+		if (nl_cache[i].nl == NULL) {
+			nl_cache[i].nl = *nlp;
+			nl_cache[i].dev = dev;
+			*nlp = NULL;
+			return;
+		}
+#else
+	(void)dev;
+#endif
+	fido_nl_free(nlp);
+}
+
 static char *
 get_parent_attr(struct udev_device *dev, const char *subsystem,
     const char *devtype, const char *attr)
@@ -44,7 +93,7 @@ get_parent_attr(struct udev_device *dev, const char *subsystem,
 	    udev_device_get_sysattr_value(parent, attr)) == NULL)
 		return NULL;
 
-	return strdup(value);
+	return fido_strdup(value);
 }
 
 static char *
@@ -68,7 +117,7 @@ copy_info(fido_dev_info_t *di, struct udev *udev,
 	if ((name = udev_list_entry_get_name(udev_entry)) == NULL ||
 	    (dev = udev_device_new_from_syspath(udev, name)) == NULL)
 		goto fail;
-	if (asprintf(&di->path, "%s/%s", FIDO_NFC_PREFIX, name) == -1) {
+	if (fido_asprintf(&di->path, "%s/%s", FIDO_NFC_PREFIX, name) == -1) {
 		di->path = NULL;
 		goto fail;
 	}
@@ -77,20 +126,21 @@ copy_info(fido_dev_info_t *di, struct udev *udev,
 		goto fail;
 	}
 	if ((di->manufacturer = get_usb_attr(dev, "manufacturer")) == NULL)
-		di->manufacturer = strdup("");
+		di->manufacturer = fido_strdup("");
 	if ((di->product = get_usb_attr(dev, "product")) == NULL)
-		di->product = strdup("");
+		di->product = fido_strdup("");
 	if (di->manufacturer == NULL || di->product == NULL)
 		goto fail;
+	di->serial = get_usb_attr(dev, "serial"); /* optional */
 	/* XXX assumes USB for vendor/product info */
 	if ((str = get_usb_attr(dev, "idVendor")) != NULL &&
 	    fido_to_uint64(str, 16, &id) == 0 && id <= UINT16_MAX)
 		di->vendor_id = (int16_t)id;
-	free(str);
+	fido_free(str);
 	if ((str = get_usb_attr(dev, "idProduct")) != NULL &&
 	    fido_to_uint64(str, 16, &id) == 0 && id <= UINT16_MAX)
 		di->product_id = (int16_t)id;
-	free(str);
+	fido_free(str);
 
 	ok = 0;
 fail:
@@ -98,9 +148,10 @@ fail:
 		udev_device_unref(dev);
 
 	if (ok < 0) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
+		fido_free(di->path);
+		fido_free(di->manufacturer);
+		fido_free(di->product);
+		fido_free(di->serial);
 		explicit_bzero(di, sizeof(*di));
 	}
 
@@ -223,10 +274,14 @@ nfc_free(struct nfc_linux **ctx_p)
 		return;
 	if (ctx->fd != -1 && close(ctx->fd) == -1)
 		fido_log_error(errno, "%s: close", __func__);
-	if (ctx->nl != NULL)
-		fido_nl_free(&ctx->nl);
+	if (ctx->nl != NULL) {
+		if (ctx->nl_ok)
+			nl_cache_put(ctx->dev, &ctx->nl);
+		else
+			fido_nl_free(&ctx->nl);
+	}
 
-	free(ctx);
+	fido_free(ctx);
 	*ctx_p = NULL;
 }
 
@@ -235,15 +290,19 @@ nfc_new(uint32_t dev)
 {
 	struct nfc_linux *ctx;
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL ||
-	    (ctx->nl = fido_nl_new()) == NULL) {
-		nfc_free(&ctx);
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL)
 		return NULL;
-	}
 
 	ctx->fd = -1;
 	ctx->dev = dev;
 
+	if ((ctx->nl = nl_cache_take(dev)) != NULL)
+		ctx->nl_ok = true;
+	else if ((ctx->nl = fido_nl_new()) == NULL) {
+		nfc_free(&ctx);
+		return NULL;
+	}
+
 	return ctx;
 }
 
@@ -262,6 +321,14 @@ fido_nfc_open(const char *path)
 		fido_log_debug("%s: nfc_new", __func__);
 		goto fail;
 	}
+	/* a target found by a previous open may still be in the field */
+	if (ctx->nl_ok) {
+		if (fido_nl_find_nfc_target(ctx->nl, ctx->dev,
+		    &ctx->target) == 0 && nfc_target_connect(ctx) == 0)
+			return ctx;
+		fido_log_debug("%s: polling", __func__);
+		ctx->nl_ok = false;
+	}
 	if (fido_nl_power_nfc(ctx->nl, ctx->dev) < 0 ||
 	    fido_nl_get_nfc_target(ctx->nl, ctx->dev, &ctx->target) < 0 ||
 	    nfc_target_connect(ctx) < 0) {
@@ -269,6 +336,8 @@ fido_nfc_open(const char *path)
 		goto fail;
 	}
 
+	ctx->nl_ok = true;
+
 	return ctx;
 fail:
 	nfc_free(&ctx);
@@ -294,6 +363,14 @@ fido_nfc_set_sigmask(void *handle, const fido_sigset_t *sigmask)
 	return FIDO_OK;
 }
 
+int
+fido_nfc_fd(void *handle)
+{
+	struct nfc_linux *ctx = handle;
+
+	return (ctx->fd);
+}
+
 int
 fido_nfc_read(void *handle, unsigned char *buf, size_t len, int ms)
 {
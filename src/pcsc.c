@@ -18,28 +18,74 @@
 #include "fido.h"
 #include "fido/param.h"
 #include "iso7816.h"
+#include "dlopen.h"
 
 #if defined(_WIN32) && !defined(__MINGW32__)
 #define SCardConnect SCardConnectA
 #define SCardListReaders SCardListReadersA
+#define SCardStatus SCardStatusA
 #endif
 
 #ifndef SCARD_PROTOCOL_Tx
 #define SCARD_PROTOCOL_Tx SCARD_PROTOCOL_ANY
 #endif
 
+#ifndef TLS
+#define TLS
+#endif
+
 #define BUFSIZE 1024	/* in bytes; passed to SCardListReaders() */
-#define APDULEN 264	/* 261 rounded up to the nearest multiple of 8 */
+#define APDULEN (ISO7816_EXT_LEN + 8) /* Ne + sw, rounded up to 8 */
 #define READERS 8	/* maximum number of readers */
 
+/*
+ * A PC/SC context shared by the manifest and the open handles of the
+ * executing thread, together with the reader list of the last manifest.
+ * The current context is kept when idle, so that opening a slot costs a
+ * single SCardConnect(); a context that reports itself as invalid is
+ * detached and released by its last user.
+ */
+struct pcsc_ctx {
+	SCARDCONTEXT	 ctx;
+	size_t		 ref;
+	char		*readers; /* multi-string returned by list_readers() */
+};
+
+static TLS struct pcsc_ctx *shared_ctx;
+
+/*
+ * Each CTAP request and its reply, which may take several APDUs, are
+ * exchanged within a PC/SC transaction, so that other clients of the
+ * reader cannot interleave their own APDUs, and pcscd arbitrates once
+ * per exchange rather than once per APDU.
+ */
 struct pcsc {
-	SCARDCONTEXT     ctx;
+	struct pcsc_ctx *ctx;
 	SCARDHANDLE      h;
 	SCARD_IO_REQUEST req;
 	uint8_t          rx_buf[APDULEN];
 	size_t           rx_len;
+	bool             txn;	/* in a transaction */
+	char            *reader;
+	uint8_t          select[32]; /* last successful select apdu */
+	size_t           select_len;
+	uint8_t          cap;	/* FIDO_CAP_* of the selected applet */
+	bool             ext;	/* extended-length apdus */
+	bool             resume; /* skip the select of fido_dev_open() */
+	bool             probe;	/* the applet may have been deselected */
 };
 
+/*
+ * Handles closed by the executing thread are parked with the fido applet
+ * still selected, so that reopening the reader costs neither an
+ * SCardConnect() nor a SELECT. A parked handle is reused only if
+ * SCardStatus() reports that the card has not been removed or reset; if
+ * another client of the reader selected a different applet in the
+ * meantime, the first apdu of the reopened handle is refused and
+ * repeated after the fido applet is selected again.
+ */
+static TLS struct pcsc *parked[READERS];
+
 static LONG
 list_readers(SCARDCONTEXT ctx, char **buf)
 {
@@ -47,7 +93,7 @@ list_readers(SCARDCONTEXT ctx, char **buf)
 	DWORD len;
 
 	len = BUFSIZE;
-	if ((*buf = calloc(1, len)) == NULL)
+	if ((*buf = fido_calloc(1, len)) == NULL)
 		goto fail;
 	if ((s = SCardListReaders(ctx, NULL, *buf, &len)) != SCARD_S_SUCCESS) {
 		fido_log_debug("%s: SCardListReaders 0x%lx", __func__, (long)s);
@@ -64,19 +110,86 @@ list_readers(SCARDCONTEXT ctx, char **buf)
 	}
 	return (LONG)SCARD_S_SUCCESS;
 fail:
-	free(*buf);
+	fido_free(*buf);
 	*buf = NULL;
 
 	return (LONG)SCARD_E_NO_READERS_AVAILABLE;
 }
 
+static void
+ctx_free(struct pcsc_ctx *c)
+{
+	if (c->ctx != 0)
+		SCardReleaseContext(c->ctx);
+	fido_free(c->readers);
+	fido_free(c);
+}
+
+static struct pcsc_ctx *
+ctx_get(LONG *s)
+{
+	struct pcsc_ctx *c;
+
+	if ((c = shared_ctx) == NULL) {
+		if ((c = fido_calloc(1, sizeof(*c))) == NULL) {
+			*s = (LONG)SCARD_E_NO_MEMORY;
+			return NULL;
+		}
+		if ((*s = SCardEstablishContext(SCARD_SCOPE_SYSTEM, NULL, NULL,
+		    &c->ctx)) != SCARD_S_SUCCESS || c->ctx == 0) {
+			fido_log_debug("%s: SCardEstablishContext 0x%lx",
+			    __func__, (long)*s);
+			if (*s == SCARD_S_SUCCESS)
+				*s = (LONG)SCARD_F_INTERNAL_ERROR;
+			c->ctx = 0;
+			ctx_free(c);
+			return NULL;
+		}
+		shared_ctx = c;
+	}
+	c->ref++;
+	*s = SCARD_S_SUCCESS;
+
+	return c;
+}
+
+static void
+ctx_put(struct pcsc_ctx *c, LONG s)
+{
+	if (s == (LONG)SCARD_E_INVALID_HANDLE ||
+	    s == (LONG)SCARD_E_NO_SERVICE) {
+		fido_log_debug("%s: dropping context, 0x%lx", __func__,
+		    (long)s);
+		if (c == shared_ctx)
+			shared_ctx = NULL;
+	}
+	if (--c->ref > 0)
+		return;
+#ifndef FIDO_FUZZ
+	if (c == shared_ctx)
+		return; /* keep idle */
+#endif
+	if (c == shared_ctx)
+		shared_ctx = NULL;
+	ctx_free(c);
+}
+
+static void
+ctx_set_readers(struct pcsc_ctx *c, char *readers)
+{
+	fido_free(c->readers);
+	c->readers = readers;
+}
+
 static char *
-get_reader(SCARDCONTEXT ctx, const char *path)
+get_reader(struct pcsc_ctx *c, const char *path, LONG *s)
 {
 	char *reader = NULL, *buf = NULL;
 	const char prefix[] = FIDO_PCSC_PREFIX "//slot";
 	uint64_t n;
 
+	*s = (LONG)SCARD_E_UNKNOWN_READER;
+
 	if (path == NULL)
 		goto out;
 	if (strncmp(path, prefix, strlen(prefix)) != 0 ||
@@ -85,21 +198,25 @@ get_reader(SCARDCONTEXT ctx, const char *path)
 		fido_log_debug("%s: invalid path %s", __func__, path);
 		goto out;
 	}
-	if (list_readers(ctx, &buf) != SCARD_S_SUCCESS) {
-		fido_log_debug("%s: list_readers", __func__);
-		goto out;
+	if (c->readers == NULL) {
+		if ((*s = list_readers(c->ctx, &buf)) != SCARD_S_SUCCESS) {
+			fido_log_debug("%s: list_readers", __func__);
+			goto out;
+		}
+		ctx_set_readers(c, buf);
 	}
-	for (const char *name = buf; *name != 0; name += strlen(name) + 1) {
+	for (const char *name = c->readers; *name != 0;
+	    name += strlen(name) + 1) {
 		if (n == 0) {
-			reader = strdup(name);
+			reader = fido_strdup(name);
+			*s = SCARD_S_SUCCESS;
 			goto out;
 		}
 		n--;
 	}
 	fido_log_debug("%s: failed to find reader %s", __func__, path);
+	*s = (LONG)SCARD_E_UNKNOWN_READER;
 out:
-	free(buf);
-
 	return reader;
 }
 
@@ -145,7 +262,8 @@ copy_info(fido_dev_info_t *di, SCARDCONTEXT ctx, const char *reader, size_t idx)
 		fido_log_debug("%s: prepare_io_request", __func__);
 		goto fail;
 	}
-	if (asprintf(&di->path, "%s//slot%zu", FIDO_PCSC_PREFIX, idx) == -1) {
+	if (fido_asprintf(&di->path, "%s//slot%zu", FIDO_PCSC_PREFIX,
+	    idx) == -1) {
 		di->path = NULL;
 		fido_log_debug("%s: asprintf", __func__);
 		goto fail;
@@ -154,8 +272,10 @@ copy_info(fido_dev_info_t *di, SCARDCONTEXT ctx, const char *reader, size_t idx)
 		fido_log_debug("%s: nfc_is_fido: %s", __func__, di->path);
 		goto fail;
 	}
-	if ((di->manufacturer = strdup("PC/SC")) == NULL ||
-	    (di->product = strdup(reader)) == NULL)
+	/* the slot index is not stable; the reader name is */
+	if ((di->manufacturer = fido_strdup("PC/SC")) == NULL ||
+	    (di->product = fido_strdup(reader)) == NULL ||
+	    (di->serial = fido_strdup(reader)) == NULL)
 		goto fail;
 
 	ok = 0;
@@ -163,9 +283,10 @@ fail:
 	if (h != 0)
 		SCardDisconnect(h, SCARD_LEAVE_CARD);
 	if (ok < 0) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
+		fido_free(di->path);
+		fido_free(di->manufacturer);
+		fido_free(di->product);
+		fido_free(di->serial);
 		explicit_bzero(di, sizeof(*di));
 	}
 
@@ -175,9 +296,9 @@ fail:
 int
 fido_pcsc_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 {
-	SCARDCONTEXT ctx = 0;
+	struct pcsc_ctx *c = NULL;
 	char *buf = NULL;
-	LONG s;
+	LONG s = SCARD_S_SUCCESS;
 	size_t idx = 0;
 	int r = FIDO_ERR_INTERNAL;
 
@@ -188,22 +309,23 @@ fido_pcsc_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 	if (devlist == NULL)
 		return FIDO_ERR_INVALID_ARGUMENT;
 
-	if ((s = SCardEstablishContext(SCARD_SCOPE_SYSTEM, NULL, NULL,
-	    &ctx)) != SCARD_S_SUCCESS || ctx == 0) {
-		fido_log_debug("%s: SCardEstablishContext 0x%lx", __func__,
-		    (long)s);
+	if ((c = ctx_get(&s)) == NULL) {
 		if (s == (LONG)SCARD_E_NO_SERVICE ||
 		    s == (LONG)SCARD_E_NO_SMARTCARD)
 			r = FIDO_OK; /* suppress error */
 		goto out;
 	}
-	if ((s = list_readers(ctx, &buf)) != SCARD_S_SUCCESS) {
+	if ((s = list_readers(c->ctx, &buf)) != SCARD_S_SUCCESS) {
 		fido_log_debug("%s: list_readers 0x%lx", __func__, (long)s);
+		ctx_set_readers(c, NULL);
 		if (s == (LONG)SCARD_E_NO_READERS_AVAILABLE)
 			r = FIDO_OK; /* suppress error */
 		goto out;
 	}
 
+	/* slot paths handed out below refer to this list */
+	ctx_set_readers(c, buf);
+
 	for (const char *name = buf; *name != 0; name += strlen(name) + 1) {
 		if (idx == READERS) {
 			fido_log_debug("%s: stopping at %zu readers", __func__,
@@ -211,7 +333,7 @@ fido_pcsc_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 			r = FIDO_OK;
 			goto out;
 		}
-		if (copy_info(&devlist[*olen], ctx, name, idx++) == 0) {
+		if (copy_info(&devlist[*olen], c->ctx, name, idx++) == 0) {
 			devlist[*olen].io = (fido_dev_io_t) {
 				fido_pcsc_open,
 				fido_pcsc_close,
@@ -229,39 +351,107 @@ fido_pcsc_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 
 	r = FIDO_OK;
 out:
-	free(buf);
-	if (ctx != 0)
-		SCardReleaseContext(ctx);
+	if (c != NULL)
+		ctx_put(c, s);
 
 	return r;
 }
 
+static void
+pcsc_free(struct pcsc *dev, LONG s)
+{
+	if (dev->h != 0)
+		SCardDisconnect(dev->h, SCARD_LEAVE_CARD);
+	if (dev->ctx != NULL)
+		ctx_put(dev->ctx, s);
+
+	explicit_bzero(dev->rx_buf, sizeof(dev->rx_buf));
+	fido_free(dev->reader);
+	fido_free(dev);
+}
+
+static struct pcsc *
+park_take(const struct pcsc_ctx *c, const char *reader)
+{
+	struct pcsc *dev;
+	DWORD len, state, prot;
+	LONG s = SCARD_S_SUCCESS;
+
+	for (size_t i = 0; i < READERS; i++) {
+		if ((dev = parked[i]) == NULL ||
+		    strcmp(dev->reader, reader) != 0)
+			continue;
+		parked[i] = NULL;
+		len = 0;
+		if (dev->ctx != c || (s = SCardStatus(dev->h, NULL, &len,
+		    &state, &prot, NULL, NULL)) != SCARD_S_SUCCESS) {
+			fido_log_debug("%s: SCardStatus 0x%lx", __func__,
+			    (long)s);
+			pcsc_free(dev, s);
+			return NULL;
+		}
+		dev->resume = true;
+		dev->probe = true;
+		return dev;
+	}
+
+	return NULL;
+}
+
+/* park 'dev' if its last exchange left the fido applet selected */
+static bool
+park_put(struct pcsc *dev)
+{
+#ifndef FIDO_FUZZ
+	if (dev->cap == 0 || dev->select_len == 0 || dev->ctx != shared_ctx)
+		return false;
+	for (size_t i = 0; i < READERS; i++)
+		if (parked[i] == NULL) {
+			parked[i] = dev;
+			return true;
+		}
+#else
+	(void)dev;
+#endif
+	return false;
+}
+
 void *
 fido_pcsc_open(const char *path)
 {
 	char *reader = NULL;
 	struct pcsc *dev = NULL;
-	SCARDCONTEXT ctx = 0;
+	struct pcsc_ctx *c = NULL;
 	SCARDHANDLE h = 0;
 	SCARD_IO_REQUEST req;
 	DWORD prot = 0;
-	LONG s;
+	LONG s = SCARD_S_SUCCESS;
 
 	memset(&req, 0, sizeof(req));
 
-	if ((s = SCardEstablishContext(SCARD_SCOPE_SYSTEM, NULL, NULL,
-	    &ctx)) != SCARD_S_SUCCESS || ctx == 0) {
-		fido_log_debug("%s: SCardEstablishContext 0x%lx", __func__,
-		    (long)s);
+	if ((c = ctx_get(&s)) == NULL)
 		goto fail;
-
-	}
-	if ((reader = get_reader(ctx, path)) == NULL) {
+	if ((reader = get_reader(c, path, &s)) == NULL) {
 		fido_log_debug("%s: get_reader(%s)", __func__, path);
 		goto fail;
 	}
-	if ((s = SCardConnect(ctx, reader, SCARD_SHARE_SHARED,
-	    SCARD_PROTOCOL_Tx, &h, &prot)) != SCARD_S_SUCCESS) {
+	if ((dev = park_take(c, reader)) != NULL) {
+		fido_log_debug("%s: resuming %s", __func__, reader);
+		goto fail; /* 'dev' holds its own reference to 'c' */
+	}
+	if ((s = SCardConnect(c->ctx, reader, SCARD_SHARE_SHARED,
+	    SCARD_PROTOCOL_Tx, &h, &prot)) == (LONG)SCARD_E_UNKNOWN_READER) {
+		/* the cached reader list is stale; list the readers again */
+		fido_free(reader);
+		ctx_set_readers(c, NULL);
+		if ((reader = get_reader(c, path, &s)) == NULL) {
+			fido_log_debug("%s: get_reader(%s)", __func__, path);
+			goto fail;
+		}
+		s = SCardConnect(c->ctx, reader, SCARD_SHARE_SHARED,
+		    SCARD_PROTOCOL_Tx, &h, &prot);
+	}
+	if (s != SCARD_S_SUCCESS) {
 		fido_log_debug("%s: SCardConnect 0x%lx", __func__, (long)s);
 		goto fail;
 	}
@@ -269,36 +459,71 @@ fido_pcsc_open(const char *path)
 		fido_log_debug("%s: prepare_io_request", __func__);
 		goto fail;
 	}
-	if ((dev = calloc(1, sizeof(*dev))) == NULL)
+	if ((dev = fido_calloc(1, sizeof(*dev))) == NULL)
 		goto fail;
 
-	dev->ctx = ctx;
+	dev->ctx = c;
 	dev->h = h;
 	dev->req = req;
-	ctx = 0;
+	dev->reader = reader;
+	c = NULL;
 	h = 0;
+	reader = NULL;
 fail:
 	if (h != 0)
 		SCardDisconnect(h, SCARD_LEAVE_CARD);
-	if (ctx != 0)
-		SCardReleaseContext(ctx);
-	free(reader);
+	if (c != NULL)
+		ctx_put(c, s);
+	fido_free(reader);
 
 	return dev;
 }
 
+/* failing to begin a transaction is not fatal; the exchange runs without */
+static void
+txn_begin(struct pcsc *dev)
+{
+	LONG s;
+
+	if (dev->txn)
+		return;
+	if ((s = SCardBeginTransaction(dev->h)) != SCARD_S_SUCCESS) {
+		fido_log_debug("%s: SCardBeginTransaction 0x%lx", __func__,
+		    (long)s);
+		return;
+	}
+
+	dev->txn = true;
+}
+
+static void
+txn_end(struct pcsc *dev)
+{
+	LONG s;
+
+	if (!dev->txn)
+		return;
+	if ((s = SCardEndTransaction(dev->h,
+	    SCARD_LEAVE_CARD)) != SCARD_S_SUCCESS)
+		fido_log_debug("%s: SCardEndTransaction 0x%lx", __func__,
+		    (long)s);
+
+	dev->txn = false;
+}
+
 void
 fido_pcsc_close(void *handle)
 {
 	struct pcsc *dev = handle;
 
-	if (dev->h != 0)
-		SCardDisconnect(dev->h, SCARD_LEAVE_CARD);
-	if (dev->ctx != 0)
-		SCardReleaseContext(dev->ctx);
-
+	txn_end(dev);
 	explicit_bzero(dev->rx_buf, sizeof(dev->rx_buf));
-	free(dev);
+	dev->rx_len = 0;
+	dev->resume = false;
+	dev->probe = false;
+
+	if (park_put(dev) == false)
+		pcsc_free(dev, SCARD_S_SUCCESS);
 }
 
 int
@@ -313,7 +538,8 @@ fido_pcsc_read(void *handle, unsigned char *buf, size_t len, int ms)
 		fido_log_debug("%s: rx_len", __func__);
 		return -1;
 	}
-	fido_log_xxd(dev->rx_buf, dev->rx_len, "%s: reading", __func__);
+	fido_log_frame_xxd(dev->rx_buf, dev->rx_len, "%s: reading",
+	    __func__);
 	memcpy(buf, dev->rx_buf, dev->rx_len);
 	explicit_bzero(dev->rx_buf, sizeof(dev->rx_buf));
 	r = (int)dev->rx_len;
@@ -322,23 +548,17 @@ fido_pcsc_read(void *handle, unsigned char *buf, size_t len, int ms)
 	return r;
 }
 
-int
-fido_pcsc_write(void *handle, const unsigned char *buf, size_t len)
+static int
+transmit(struct pcsc *dev, const unsigned char *buf, size_t len)
 {
-	struct pcsc *dev = handle;
 	DWORD n;
 	LONG s;
 
-	if (len > INT_MAX) {
-		fido_log_debug("%s: len", __func__);
-		return -1;
-	}
-
 	explicit_bzero(dev->rx_buf, sizeof(dev->rx_buf));
 	dev->rx_len = 0;
 	n = (DWORD)sizeof(dev->rx_buf);
 
-	fido_log_xxd(buf, len, "%s: writing", __func__);
+	fido_log_frame_xxd(buf, len, "%s: writing", __func__);
 
 	if ((s = SCardTransmit(dev->h, &dev->req, buf, (DWORD)len, NULL,
 	    dev->rx_buf, &n)) != SCARD_S_SUCCESS) {
@@ -348,7 +568,60 @@ fido_pcsc_write(void *handle, const unsigned char *buf, size_t len)
 	}
 	dev->rx_len = (size_t)n;
 
-	fido_log_xxd(dev->rx_buf, dev->rx_len, "%s: read", __func__);
+	fido_log_frame_xxd(dev->rx_buf, dev->rx_len, "%s: read",
+	    __func__);
+
+	return 0;
+}
+
+static int
+rx_sw(const struct pcsc *dev)
+{
+	if (dev->rx_len < 2 || dev->rx_len > sizeof(dev->rx_buf))
+		return -1;
+
+	return dev->rx_buf[dev->rx_len - 2] << 8 |
+	    dev->rx_buf[dev->rx_len - 1];
+}
+
+static bool
+is_select(const unsigned char *buf, size_t len)
+{
+	return len >= 4 && buf[0] == 0x00 && buf[1] == 0xa4 &&
+	    buf[2] == 0x04;
+}
+
+int
+fido_pcsc_write(void *handle, const unsigned char *buf, size_t len)
+{
+	struct pcsc *dev = handle;
+	int sw;
+
+	if (len > INT_MAX) {
+		fido_log_debug("%s: len", __func__);
+		return -1;
+	}
+	if (transmit(dev, buf, len) < 0)
+		return -1;
+
+	sw = rx_sw(dev);
+
+	/* another client of the reader may have selected its own applet */
+	if (dev->probe && (sw == SW_INS_NOT_SUPPORTED ||
+	    sw == SW_CLA_NOT_SUPPORTED)) {
+		fido_log_debug("%s: selecting again", __func__);
+		if (transmit(dev, dev->select, dev->select_len) < 0 ||
+		    rx_sw(dev) != SW_NO_ERROR ||
+		    transmit(dev, buf, len) < 0)
+			return -1;
+	}
+	dev->probe = false;
+
+	if (is_select(buf, len) && len <= sizeof(dev->select) &&
+	    sw == SW_NO_ERROR) {
+		memcpy(dev->select, buf, len);
+		dev->select_len = len;
+	}
 
 	return (int)len;
 }
@@ -356,13 +629,63 @@ fido_pcsc_write(void *handle, const unsigned char *buf, size_t len)
 int
 fido_pcsc_tx(fido_dev_t *d, uint8_t cmd, const u_char *buf, size_t count)
 {
-	return fido_nfc_tx(d, cmd, buf, count);
+	struct pcsc *dev = d->io_handle;
+	int r;
+
+	if (cmd == CTAP_CMD_INIT && dev->resume) {
+		/* the applet selected before the handle was parked */
+		d->nfc_ext = dev->ext;
+		return 0;
+	}
+
+	txn_begin(dev);
+	if ((r = fido_nfc_tx(d, cmd, buf, count)) < 0) {
+		txn_end(dev);
+		dev->cap = 0; /* do not park */
+	}
+
+	return r;
+}
+
+static int
+rx_resume(fido_dev_t *d, struct pcsc *dev, u_char *buf, size_t count)
+{
+	fido_ctap_info_t *attr = (fido_ctap_info_t *)buf;
+
+	dev->resume = false;
+
+	if (count != sizeof(*attr)) {
+		fido_log_debug("%s: count=%zu", __func__, count);
+		return -1;
+	}
+
+	memset(attr, 0, sizeof(*attr));
+	attr->flags = dev->cap;
+	memcpy(&attr->nonce, &d->nonce, sizeof(attr->nonce));
+
+	return (int)count;
 }
 
 int
 fido_pcsc_rx(fido_dev_t *d, uint8_t cmd, u_char *buf, size_t count, int ms)
 {
-	return fido_nfc_rx(d, cmd, buf, count, ms);
+	struct pcsc *dev = d->io_handle;
+	int r;
+
+	if (cmd == CTAP_CMD_INIT && dev->resume)
+		return rx_resume(d, dev, buf, count);
+
+	r = fido_nfc_rx(d, cmd, buf, count, ms);
+	txn_end(dev);
+
+	if (r < 0)
+		dev->cap = 0; /* do not park */
+	else if (cmd == CTAP_CMD_INIT && (size_t)r == count) {
+		dev->cap = ((const fido_ctap_info_t *)buf)->flags;
+		dev->ext = d->nfc_ext;
+	}
+
+	return r;
 }
 
 bool
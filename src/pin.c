@@ -19,19 +19,70 @@
 int
 fido_sha256(fido_blob_t *digest, const u_char *data, size_t data_len)
 {
-	if ((digest->ptr = calloc(1, SHA256_DIGEST_LENGTH)) == NULL)
+	u_char	md[SHA256_DIGEST_LENGTH];
+	int	ok;
+
+	if (fido_sha256_buf(data, data_len, md) < 0) {
+		fido_blob_reset(digest);
 		return (-1);
+	}
 
-	digest->len = SHA256_DIGEST_LENGTH;
+	ok = fido_blob_set(digest, md, sizeof(md));
+	explicit_bzero(md, sizeof(md));
 
-	if (SHA256(data, data_len, digest->ptr) != digest->ptr) {
-		fido_blob_reset(digest);
+	return (ok);
+}
+
+/* incremental sha256, for data that does not arrive at once */
+int
+fido_sha256_init(EVP_MD_CTX **ctx)
+{
+	EVP_MD_CTX_free(*ctx);
+
+	if ((*ctx = EVP_MD_CTX_new()) == NULL ||
+	    EVP_DigestInit_ex(*ctx, fido_md_sha256(), NULL) != 1) {
+		fido_log_debug("%s: EVP_DigestInit_ex", __func__);
+		EVP_MD_CTX_free(*ctx);
+		*ctx = NULL;
+		return (-1);
+	}
+
+	return (0);
+}
+
+int
+fido_sha256_update(EVP_MD_CTX *ctx, const u_char *data, size_t data_len)
+{
+	if (data_len > 0 && EVP_DigestUpdate(ctx, data, data_len) != 1) {
+		fido_log_debug("%s: EVP_DigestUpdate", __func__);
 		return (-1);
 	}
 
 	return (0);
 }
 
+/* the digest of the data seen by 'ctx', which is freed */
+int
+fido_sha256_final(EVP_MD_CTX **ctx, fido_blob_t *digest)
+{
+	u_char		md[SHA256_DIGEST_LENGTH];
+	unsigned int	md_len = sizeof(md);
+	int		ok = -1;
+
+	if (EVP_DigestFinal_ex(*ctx, md, &md_len) != 1) {
+		fido_log_debug("%s: EVP_DigestFinal_ex", __func__);
+		fido_blob_reset(digest);
+	} else
+		ok = fido_blob_set(digest, md, md_len);
+
+	explicit_bzero(md, sizeof(md));
+	EVP_MD_CTX_free(*ctx);
+	*ctx = NULL;
+
+	return (ok);
+}
+
+#ifndef FIDO_VERIFY_ONLY
 static int
 pin_sha256_enc(const fido_dev_t *dev, const fido_blob_t *shared,
     const fido_blob_t *pin, fido_blob_t **out)
@@ -45,7 +96,8 @@ pin_sha256_enc(const fido_dev_t *dev, const fido_blob_t *shared,
 		goto fail;
 	}
 
-	if (fido_sha256(ph, pin->ptr, pin->len) < 0 || ph->len < 16) {
+	if ((ph->ptr = fido_secure_alloc(SHA256_DIGEST_LENGTH)) == NULL ||
+	    fido_sha256_buf(pin->ptr, pin->len, ph->ptr) < 0) {
 		fido_log_debug("%s: SHA256", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
@@ -83,7 +135,7 @@ pad64(const char *pin, fido_blob_t **ppin)
 
 	ppin_len = (pin_len + 63U) & ~63U;
 	if (ppin_len < pin_len ||
-	    ((*ppin)->ptr = calloc(1, ppin_len)) == NULL) {
+	    ((*ppin)->ptr = fido_secure_alloc(ppin_len)) == NULL) {
 		fido_blob_free(ppin);
 		return (FIDO_ERR_INTERNAL);
 	}
@@ -167,9 +219,9 @@ ctap20_uv_token_tx(fido_dev_t *dev, const char *pin, const fido_blob_t *ecdh,
 		goto fail;
 	}
 
-	if ((p = fido_blob_new()) == NULL || fido_blob_set(p,
+	if ((p = fido_blob_new()) == NULL || fido_blob_set_secure(p,
 	    (const unsigned char *)pin, strlen(pin)) < 0) {
-		fido_log_debug("%s: fido_blob_set", __func__);
+		fido_log_debug("%s: fido_blob_set_secure", __func__);
 		r = FIDO_ERR_INVALID_ARGUMENT;
 		goto fail;
 	}
@@ -200,7 +252,7 @@ fail:
 	cbor_vector_free(argv, nitems(argv));
 	fido_blob_free(&p);
 	fido_blob_free(&phe);
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return (r);
 }
@@ -220,9 +272,9 @@ ctap21_uv_token_tx(fido_dev_t *dev, const char *pin, const fido_blob_t *ecdh,
 	memset(argv, 0, sizeof(argv));
 
 	if (pin != NULL) {
-		if ((p = fido_blob_new()) == NULL || fido_blob_set(p,
+		if ((p = fido_blob_new()) == NULL || fido_blob_set_secure(p,
 		    (const unsigned char *)pin, strlen(pin)) < 0) {
-			fido_log_debug("%s: fido_blob_set", __func__);
+			fido_log_debug("%s: fido_blob_set_secure", __func__);
 			r = FIDO_ERR_INVALID_ARGUMENT;
 			goto fail;
 		}
@@ -263,7 +315,7 @@ fail:
 	cbor_vector_free(argv, nitems(argv));
 	fido_blob_free(&p);
 	fido_blob_free(&phe);
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return (r);
 }
@@ -289,6 +341,7 @@ uv_token_rx(fido_dev_t *dev, const fido_blob_t *ecdh, fido_blob_t *token,
 {
 	fido_blob_t	*aes_token = NULL;
 	unsigned char	*msg = NULL;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
@@ -297,12 +350,12 @@ uv_token_rx(fido_dev_t *dev, const fido_blob_t *ecdh, fido_blob_t *token,
 		goto fail;
 	}
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto fail;
@@ -323,7 +376,7 @@ uv_token_rx(fido_dev_t *dev, const fido_blob_t *ecdh, fido_blob_t *token,
 	r = FIDO_OK;
 fail:
 	fido_blob_free(&aes_token);
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
@@ -347,12 +400,191 @@ uv_token_wait(fido_dev_t *dev, uint8_t cmd, const char *pin,
 	return (uv_token_rx(dev, ecdh, token, ms));
 }
 
+/*
+ * Tokens issued for makeCredential and getAssertion lose their permissions
+ * once used, so only those for management commands are worth keeping.
+ */
+static bool
+uv_token_cacheable(uint8_t cmd)
+{
+	return (cmd != CTAP_CBOR_ASSERT && cmd != CTAP_CBOR_MAKECRED);
+}
+
+static int
+uv_token_scope(fido_blob_t *scope, uint8_t cmd, const char *pin,
+    const char *rpid)
+{
+	unsigned char buf[1 + SHA256_DIGEST_LENGTH];
+	int ok = -1;
+
+	memset(buf, 0, sizeof(buf));
+	buf[0] = cmd;
+	if (pin != NULL && fido_sha256_buf(pin, strlen(pin), &buf[1]) < 0) {
+		fido_log_debug("%s: SHA256", __func__);
+		goto fail;
+	}
+	if (fido_blob_set(scope, buf, sizeof(buf)) < 0 || (rpid != NULL &&
+	    *rpid != '\0' && fido_blob_append(scope,
+	    (const unsigned char *)rpid, strlen(rpid)) < 0)) {
+		fido_log_debug("%s: fido_blob_set", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	explicit_bzero(buf, sizeof(buf));
+
+	return (ok);
+}
+
 int
 fido_dev_get_uv_token(fido_dev_t *dev, uint8_t cmd, const char *pin,
     const fido_blob_t *ecdh, const es256_pk_t *pk, const char *rpid,
     fido_blob_t *token, int *ms)
 {
-	return (uv_token_wait(dev, cmd, pin, ecdh, pk, rpid, token, ms));
+	fido_trace_t	 span;
+	fido_prof_t	 prof;
+	fido_blob_t	*scope = NULL;
+	int		 r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+	fido_prof_begin(&prof, FIDO_PROF_UV_TOKEN);
+
+	if (dev->token == NULL &&
+	    (!dev->token_cache || !uv_token_cacheable(cmd))) {
+		r = uv_token_wait(dev, cmd, pin, ecdh, pk, rpid, token, ms);
+		return (fido_trace_end(&span, fido_prof_end(&prof, r)));
+	}
+
+	if ((scope = fido_blob_new()) == NULL ||
+	    uv_token_scope(scope, cmd, pin, rpid) < 0) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+	if (dev->token != NULL && dev->token_scope->len == scope->len &&
+	    timingsafe_bcmp(dev->token_scope->ptr, scope->ptr,
+	    scope->len) == 0) {
+		fido_log_debug("%s: cached token", __func__);
+		if (fido_blob_set_secure(token, dev->token->ptr,
+		    dev->token->len) < 0)
+			r = FIDO_ERR_INTERNAL;
+		else
+			r = FIDO_OK;
+		/* a token obtained by fido_dev_prewarm() is used once */
+		if (!uv_token_cacheable(cmd)) {
+			fido_blob_free(&dev->token);
+			fido_blob_free(&dev->token_scope);
+		}
+		goto fail;
+	}
+
+	/* issuing a new token invalidates the cached one */
+	fido_blob_free(&dev->token);
+	fido_blob_free(&dev->token_scope);
+
+	if ((r = uv_token_wait(dev, cmd, pin, ecdh, pk, rpid, token,
+	    ms)) != FIDO_OK || !dev->token_cache || !uv_token_cacheable(cmd))
+		goto fail;
+	if ((dev->token = fido_blob_new()) == NULL ||
+	    fido_blob_set_secure(dev->token, token->ptr, token->len) < 0) {
+		fido_log_debug("%s: fido_blob_set_secure", __func__);
+		fido_blob_free(&dev->token); /* not fatal */
+		goto fail;
+	}
+	dev->token_scope = scope;
+	scope = NULL;
+fail:
+	fido_blob_free(&scope);
+
+	return (fido_trace_end(&span, fido_prof_end(&prof, r)));
+}
+
+static int
+uv_token_prewarm(fido_dev_t *dev, const char *pin, const char *rpid, int *ms)
+{
+	fido_blob_t	*ecdh = NULL;
+	fido_blob_t	*scope = NULL;
+	fido_blob_t	*token = NULL;
+	es256_pk_t	*pk = NULL;
+	int		 r;
+
+	if (rpid == NULL || *rpid == '\0' || (pin == NULL &&
+	    !fido_dev_supports_permissions(dev))) {
+		fido_log_debug("%s: rpid=%p, pin=%p", __func__,
+		    (const void *)rpid, (const void *)pin);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+	if ((r = fido_do_ecdh(dev, &pk, &ecdh, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_do_ecdh", __func__);
+		goto fail;
+	}
+	if ((scope = fido_blob_new()) == NULL ||
+	    (token = fido_blob_new()) == NULL ||
+	    uv_token_scope(scope, CTAP_CBOR_ASSERT, pin, rpid) < 0) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
+	fido_blob_free(&dev->token);
+	fido_blob_free(&dev->token_scope);
+
+	if ((r = uv_token_wait(dev, CTAP_CBOR_ASSERT, pin, ecdh, pk, rpid,
+	    token, ms)) != FIDO_OK) {
+		fido_log_debug("%s: uv_token_wait", __func__);
+		goto fail;
+	}
+	dev->token = token;
+	dev->token_scope = scope;
+	token = NULL;
+	scope = NULL;
+fail:
+	es256_pk_free(&pk);
+	fido_blob_free(&ecdh);
+	fido_blob_free(&scope);
+	fido_blob_free(&token);
+
+	return (r);
+}
+
+int
+fido_dev_prewarm(fido_dev_t *dev, const char *rpid, const char *pin,
+    int flags)
+{
+	es256_pk_t	*pk = NULL;
+	fido_blob_t	*ecdh = NULL;
+	fido_trace_t	 span;
+	int		 ms = fido_time_budget(dev->timeout_ms);
+	int		 r;
+
+	fido_trace_begin(&span, dev, __func__, 0, 0, 0);
+
+	if (dev->io_handle == NULL ||
+	    (flags & ~(FIDO_PREWARM_ECDH | FIDO_PREWARM_TOKEN)) != 0) {
+		fido_log_debug("%s: io_handle=%p, flags=0x%x", __func__,
+		    dev->io_handle, (unsigned)flags);
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto fail;
+	}
+	if ((r = fido_dev_get_deferred_info(dev, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		goto fail;
+	}
+	if (flags == 0)
+		goto fail;
+	if (fido_dev_is_fido2(dev) == false ||
+	    (dev->flags & FIDO_DEV_WINHELLO)) {
+		r = FIDO_ERR_UNSUPPORTED_OPTION;
+		goto fail;
+	}
+	if (flags & FIDO_PREWARM_TOKEN)
+		r = uv_token_prewarm(dev, pin, rpid, &ms);
+	else
+		r = fido_do_ecdh(dev, &pk, &ecdh, &ms);
+fail:
+	es256_pk_free(&pk);
+	fido_blob_free(&ecdh);
+
+	return (fido_trace_end(&span, r));
 }
 
 static int
@@ -371,9 +603,9 @@ fido_dev_change_pin_tx(fido_dev_t *dev, const char *pin, const char *oldpin,
 	memset(&f, 0, sizeof(f));
 	memset(argv, 0, sizeof(argv));
 
-	if ((opin = fido_blob_new()) == NULL || fido_blob_set(opin,
+	if ((opin = fido_blob_new()) == NULL || fido_blob_set_secure(opin,
 	    (const unsigned char *)oldpin, strlen(oldpin)) < 0) {
-		fido_log_debug("%s: fido_blob_set", __func__);
+		fido_log_debug("%s: fido_blob_set_secure", __func__);
 		r = FIDO_ERR_INVALID_ARGUMENT;
 		goto fail;
 	}
@@ -421,7 +653,7 @@ fail:
 	fido_blob_free(&ecdh);
 	fido_blob_free(&opin);
 	fido_blob_free(&opinhe);
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return (r);
 
@@ -473,7 +705,7 @@ fail:
 	es256_pk_free(&pk);
 	fido_blob_free(&ppine);
 	fido_blob_free(&ecdh);
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return (r);
 }
@@ -497,7 +729,9 @@ fido_dev_set_pin_wait(fido_dev_t *dev, const char *pin, const char *oldpin,
 		}
 	}
 
-	if ((r = fido_rx_cbor_status(dev, ms)) != FIDO_OK) {
+	r = fido_rx_cbor_status(dev, ms);
+	fido_dev_token_cache_reset(dev); /* tokens are reset with the pin */
+	if (r != FIDO_OK) {
 		fido_log_debug("%s: fido_rx_cbor_status", __func__);
 		return (r);
 	}
@@ -513,7 +747,7 @@ fido_dev_set_pin_wait(fido_dev_t *dev, const char *pin, const char *oldpin,
 int
 fido_dev_set_pin(fido_dev_t *dev, const char *pin, const char *oldpin)
 {
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 
 	return (fido_dev_set_pin_wait(dev, pin, oldpin, &ms));
 }
@@ -580,7 +814,7 @@ fido_dev_get_retry_count_tx(fido_dev_t *dev, uint8_t subcmd, int *ms)
 	r = FIDO_OK;
 fail:
 	cbor_vector_free(argv, nitems(argv));
-	free(f.ptr);
+	fido_free(f.ptr);
 
 	return (r);
 }
@@ -589,17 +823,18 @@ static int
 fido_dev_get_pin_retry_count_rx(fido_dev_t *dev, int *retries, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
 	*retries = 0;
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto fail;
@@ -613,12 +848,12 @@ fido_dev_get_pin_retry_count_rx(fido_dev_t *dev, int *retries, int *ms)
 
 	r = FIDO_OK;
 fail:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
 
-static int
+int
 fido_dev_get_pin_retry_count_wait(fido_dev_t *dev, int *retries, int *ms)
 {
 	int r;
@@ -633,7 +868,7 @@ fido_dev_get_pin_retry_count_wait(fido_dev_t *dev, int *retries, int *ms)
 int
 fido_dev_get_retry_count(fido_dev_t *dev, int *retries)
 {
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 
 	return (fido_dev_get_pin_retry_count_wait(dev, retries, &ms));
 }
@@ -642,17 +877,18 @@ static int
 fido_dev_get_uv_retry_count_rx(fido_dev_t *dev, int *retries, int *ms)
 {
 	unsigned char	*msg;
+	size_t		 msgsiz = 0;
 	int		 msglen;
 	int		 r;
 
 	*retries = 0;
 
-	if ((msg = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((msg = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, FIDO_MAXMSG, ms)) < 0) {
+	if ((msglen = fido_rx(dev, CTAP_CMD_CBOR, msg, msgsiz, ms)) < 0) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_ERR_RX;
 		goto fail;
@@ -666,12 +902,12 @@ fido_dev_get_uv_retry_count_rx(fido_dev_t *dev, int *retries, int *ms)
 
 	r = FIDO_OK;
 fail:
-	freezero(msg, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, msg, msgsiz);
 
 	return (r);
 }
 
-static int
+int
 fido_dev_get_uv_retry_count_wait(fido_dev_t *dev, int *retries, int *ms)
 {
 	int r;
@@ -686,7 +922,7 @@ fido_dev_get_uv_retry_count_wait(fido_dev_t *dev, int *retries, int *ms)
 int
 fido_dev_get_uv_retry_count(fido_dev_t *dev, int *retries)
 {
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 
 	return (fido_dev_get_uv_retry_count_wait(dev, retries, &ms));
 }
@@ -723,3 +959,4 @@ fail:
 
 	return (r);
 }
+#endif /* !FIDO_VERIFY_ONLY */
@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2024 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+
+#include "fido.h"
+#include "fido/es256.h"
+#include "fido/es384.h"
+#include "fido/rs256.h"
+#include "fido/eddsa.h"
+
+#ifndef TLS
+#define TLS
+#endif
+
+#define PK_CTX_CACHE_LEN	8
+#define VERIFY_CACHE_LEN	128
+
+typedef union {
+	es256_pk_t es256;
+	es384_pk_t es384;
+	rs256_pk_t rs256;
+	eddsa_pk_t eddsa;
+} pk_raw_t;
+
+static TLS fido_verify_handler_t *verify_handler;
+static TLS void *verify_handler_arg;
+
+/*
+ * FIDO_VERIFY_CACHE: outcomes of the signature checks made by
+ * fido_assert_verify() and fido_assert_verify_prepared() in the executing
+ * thread, keyed by SHA-256(cose_alg, public key, signed hash, signature),
+ * and replaced in the order they were recorded.
+ */
+static TLS bool verify_cache;
+static TLS struct verify_cache {
+	unsigned char	key[SHA256_DIGEST_LENGTH];
+	int		r;
+	bool		set;
+} verify_cache_tab[VERIFY_CACHE_LEN];
+static TLS size_t verify_cache_next;
+
+static void
+verify_cache_flush(void)
+{
+	explicit_bzero(verify_cache_tab, sizeof(verify_cache_tab));
+	verify_cache_next = 0;
+}
+
+/* enable or disable the verification cache, dropping its contents */
+void
+fido_verify_cache_init(bool enable)
+{
+	verify_cache_flush();
+	verify_cache = enable;
+}
+
+/* 0 if the cache is enabled and 'key' identifies the check */
+int
+fido_verify_cache_key(unsigned char *key, int cose_alg, const void *pk,
+    size_t pk_len, const fido_blob_t *dgst, const fido_blob_t *sig)
+{
+	EVP_MD_CTX	*ctx = NULL;
+	uint32_t	 alg = (uint32_t)cose_alg;
+	int		 ok = -1;
+
+	if (!verify_cache || pk_len == 0)
+		return (-1);
+
+	if ((ctx = EVP_MD_CTX_new()) == NULL ||
+	    EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1 ||
+	    EVP_DigestUpdate(ctx, &alg, sizeof(alg)) != 1 ||
+	    EVP_DigestUpdate(ctx, pk, pk_len) != 1 ||
+	    EVP_DigestUpdate(ctx, &dgst->len, sizeof(dgst->len)) != 1 ||
+	    EVP_DigestUpdate(ctx, dgst->ptr, dgst->len) != 1 ||
+	    EVP_DigestUpdate(ctx, sig->ptr, sig->len) != 1 ||
+	    EVP_DigestFinal_ex(ctx, key, NULL) != 1) {
+		fido_log_debug("%s: EVP_Digest", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	EVP_MD_CTX_free(ctx);
+
+	return (ok);
+}
+
+bool
+fido_verify_cache_get(const unsigned char *key, int *r)
+{
+	for (size_t i = 0; i < VERIFY_CACHE_LEN; i++)
+		if (verify_cache_tab[i].set && memcmp(verify_cache_tab[i].key,
+		    key, sizeof(verify_cache_tab[i].key)) == 0) {
+			*r = verify_cache_tab[i].r;
+			return (true);
+		}
+
+	return (false);
+}
+
+void
+fido_verify_cache_put(const unsigned char *key, int r)
+{
+	struct verify_cache *e = &verify_cache_tab[verify_cache_next];
+
+#ifndef FIDO_FUZZ
+	memcpy(e->key, key, sizeof(e->key));
+	e->r = r;
+	e->set = true;
+	verify_cache_next = (verify_cache_next + 1) % VERIFY_CACHE_LEN;
+#else
+	(void)e;
+	(void)key;
+	(void)r;
+#endif
+}
+
+void
+fido_set_verify_handler(fido_verify_handler_t *handler, void *arg)
+{
+	verify_handler = handler;
+	verify_handler_arg = arg;
+
+	/* outcomes recorded so far may have come from another handler */
+	verify_cache_flush();
+}
+
+/*
+ * Offer a verification to the application's handler. Returns FIDO_OK or
+ * FIDO_ERR_INVALID_SIG if it was handled, FIDO_ERR_UNSUPPORTED_ALGORITHM
+ * if the built-in implementation should be used.
+ */
+int
+fido_verify_handler(int cose_alg, const void *pk, const fido_blob_t *dgst,
+    const fido_blob_t *sig)
+{
+	int r;
+
+	if (verify_handler == NULL)
+		return (FIDO_ERR_UNSUPPORTED_ALGORITHM);
+
+	r = verify_handler(verify_handler_arg, cose_alg, pk, dgst->ptr,
+	    dgst->len, sig->ptr, sig->len);
+	if (r != FIDO_OK && r != FIDO_ERR_UNSUPPORTED_ALGORITHM) {
+		fido_log_debug("%s: cose_alg %d: 0x%x", __func__, cose_alg, r);
+		r = FIDO_ERR_INVALID_SIG;
+	}
+
+	return (r);
+}
+
+static EVP_PKEY *
+pk_to_EVP_PKEY(int cose_alg, const void *pk)
+{
+	switch (cose_alg) {
+	case COSE_ES256:
+		return (es256_pk_get_EVP_PKEY(pk));
+#ifndef FIDO_NO_ES384
+	case COSE_ES384:
+		return (es384_pk_get_EVP_PKEY(pk));
+#endif
+#ifndef FIDO_NO_RS256
+	case COSE_RS256:
+		return (rs256_pk_to_EVP_PKEY(pk));
+#endif
+#ifndef FIDO_NO_EDDSA
+	case COSE_EDDSA:
+		return (eddsa_pk_get_EVP_PKEY(pk));
+#endif
+	default:
+		fido_log_debug("%s: unsupported cose_alg %d", __func__,
+		    cose_alg);
+		return (NULL);
+	}
+}
+
+static EVP_PKEY_CTX *
+pk_verify_ctx_new(int cose_alg, EVP_PKEY *pkey)
+{
+	EVP_PKEY_CTX *pctx = NULL;
+
+	switch (cose_alg) {
+	case COSE_ES256:
+#ifndef FIDO_NO_ES384
+	case COSE_ES384:
+#endif
+		if ((pctx = EVP_PKEY_CTX_new(pkey, NULL)) == NULL ||
+		    EVP_PKEY_verify_init(pctx) != 1) {
+			fido_log_debug("%s: EVP_PKEY_verify_init", __func__);
+			goto fail;
+		}
+		break;
+#ifndef FIDO_NO_RS256
+	case COSE_RS256:
+		if ((pctx = rs256_verify_ctx_new(pkey)) == NULL) {
+			fido_log_debug("%s: rs256_verify_ctx_new", __func__);
+			goto fail;
+		}
+		break;
+#endif
+	default:
+		fido_log_debug("%s: unsupported cose_alg %d", __func__,
+		    cose_alg);
+		goto fail;
+	}
+
+	return (pctx);
+fail:
+	EVP_PKEY_CTX_free(pctx);
+
+	return (NULL);
+}
+
+/*
+ * Verification contexts of the prepared keys most recently used in the
+ * executing thread. An entry holds a reference to its key, so a key's
+ * address identifies it for as long as the entry exists.
+ */
+static TLS struct pk_ctx_cache {
+	EVP_PKEY	*pkey;
+	EVP_PKEY_CTX	*pctx;
+	uint64_t	 used;
+} pk_ctx_cache[PK_CTX_CACHE_LEN];
+static TLS uint64_t pk_ctx_tick;
+
+/* the caller frees *new_pctx, set if the context could not be cached */
+static EVP_PKEY_CTX *
+pk_ctx_get(const fido_pk_t *pk, EVP_PKEY_CTX **new_pctx)
+{
+	struct pk_ctx_cache	*e = &pk_ctx_cache[0];
+	EVP_PKEY_CTX		*pctx;
+
+	*new_pctx = NULL;
+
+#ifndef FIDO_FUZZ
+	for (size_t i = 0; i < PK_CTX_CACHE_LEN; i++)
+		if (pk_ctx_cache[i].pkey == pk->pkey &&
+		    pk_ctx_cache[i].pctx != NULL) {
+			pk_ctx_cache[i].used = ++pk_ctx_tick;
+			return (pk_ctx_cache[i].pctx);
+		}
+#endif
+	if ((pctx = pk_verify_ctx_new(pk->type, pk->pkey)) == NULL)
+		return (NULL);
+#ifndef FIDO_FUZZ
+	for (size_t i = 1; i < PK_CTX_CACHE_LEN; i++)
+		if (pk_ctx_cache[i].used < e->used)
+			e = &pk_ctx_cache[i];
+	if (EVP_PKEY_up_ref(pk->pkey) == 1) {
+		EVP_PKEY_CTX_free(e->pctx);
+		EVP_PKEY_free(e->pkey);
+		e->pkey = pk->pkey;
+		e->pctx = pctx;
+		e->used = ++pk_ctx_tick;
+		return (pctx);
+	}
+#else
+	(void)e;
+#endif
+	*new_pctx = pctx;
+
+	return (pctx);
+}
+
+void
+fido_pk_reset(fido_pk_t *pk)
+{
+	EVP_PKEY_free(pk->pkey);
+	memset(pk, 0, sizeof(*pk));
+}
+
+fido_pk_t *
+fido_pk_new(void)
+{
+	return (fido_calloc(1, sizeof(fido_pk_t)));
+}
+
+void
+fido_pk_free(fido_pk_t **pk_p)
+{
+	fido_pk_t *pk;
+
+	if (pk_p == NULL || (pk = *pk_p) == NULL)
+		return;
+	fido_pk_reset(pk);
+	fido_free(pk);
+	*pk_p = NULL;
+}
+
+/* takes ownership of pkey on success */
+static int
+pk_install(fido_pk_t *pk, int cose_alg, EVP_PKEY *pkey, const void *raw)
+{
+	EVP_PKEY_CTX *pctx = NULL;
+
+	/* make sure the key can be used for verification */
+	if (cose_alg != COSE_EDDSA &&
+	    (pctx = pk_verify_ctx_new(cose_alg, pkey)) == NULL) {
+		fido_log_debug("%s: pk_verify_ctx_new", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	EVP_PKEY_CTX_free(pctx);
+
+	pk->type = cose_alg;
+	pk->pkey = pkey;
+	if (cose_alg == COSE_ES256)
+		memcpy(&pk->raw.es256, raw, sizeof(pk->raw.es256));
+	else if (cose_alg == COSE_EDDSA)
+		memcpy(&pk->raw.eddsa, raw, sizeof(pk->raw.eddsa));
+
+	return (FIDO_OK);
+}
+
+int
+fido_pk_set(fido_pk_t *pk, int cose_alg, const void *ptr)
+{
+	EVP_PKEY	*pkey = NULL;
+	int		 r;
+
+	fido_pk_reset(pk);
+
+	if (ptr == NULL) {
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto fail;
+	}
+
+	if (cose_alg == COSE_RS1 || !fido_cose_alg_enabled(cose_alg)) {
+		fido_log_debug("%s: unsupported cose_alg %d", __func__,
+		    cose_alg);
+		r = FIDO_ERR_UNSUPPORTED_OPTION;
+		goto fail;
+	}
+
+	if ((pkey = pk_to_EVP_PKEY(cose_alg, ptr)) == NULL) {
+		fido_log_debug("%s: pk_to_EVP_PKEY", __func__);
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto fail;
+	}
+
+	if ((r = pk_install(pk, cose_alg, pkey, ptr)) != FIDO_OK)
+		goto fail;
+
+	return (FIDO_OK);
+fail:
+	EVP_PKEY_free(pkey);
+
+	return (r);
+}
+
+/*
+ * Check that pkey is a key we can verify with, and find its cose
+ * algorithm; the raw form of the key is kept for the verify handler.
+ */
+static int
+pk_from_EVP_PKEY(pk_raw_t *raw, const EVP_PKEY *pkey, int *cose_alg)
+{
+	switch (EVP_PKEY_base_id(pkey)) {
+	case EVP_PKEY_EC:
+		if (EVP_PKEY_bits(pkey) == 256) {
+			*cose_alg = COSE_ES256;
+			return (es256_pk_from_EVP_PKEY(&raw->es256, pkey));
+		}
+#ifndef FIDO_NO_ES384
+		if (EVP_PKEY_bits(pkey) == 384) {
+			*cose_alg = COSE_ES384;
+			return (es384_pk_from_EVP_PKEY(&raw->es384, pkey));
+		}
+#endif
+		break;
+#ifndef FIDO_NO_RS256
+	case EVP_PKEY_RSA:
+		*cose_alg = COSE_RS256;
+		return (rs256_pk_from_EVP_PKEY(&raw->rs256, pkey));
+#endif
+#ifndef FIDO_NO_EDDSA
+	case EVP_PKEY_ED25519:
+		*cose_alg = COSE_EDDSA;
+		return (eddsa_pk_from_EVP_PKEY(&raw->eddsa, pkey));
+#endif
+	}
+
+	fido_log_debug("%s: unsupported key type %d", __func__,
+	    EVP_PKEY_base_id(pkey));
+
+	return (FIDO_ERR_UNSUPPORTED_OPTION);
+}
+
+int
+fido_pk_set_der(fido_pk_t *pk, const unsigned char *ptr, size_t len)
+{
+	const unsigned char	*end = ptr;
+	EVP_PKEY		*pkey = NULL;
+	pk_raw_t		 raw;
+	int			 cose_alg;
+	int			 r;
+
+	fido_pk_reset(pk);
+	memset(&raw, 0, sizeof(raw));
+
+	/* openssl needs longs */
+	if (ptr == NULL || len == 0 || len > LONG_MAX) {
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto fail;
+	}
+
+	if ((pkey = d2i_PUBKEY(NULL, &end, (long)len)) == NULL ||
+	    end != ptr + len) {
+		fido_log_debug("%s: d2i_PUBKEY", __func__);
+		r = FIDO_ERR_INVALID_ARGUMENT;
+		goto fail;
+	}
+
+	if ((r = pk_from_EVP_PKEY(&raw, pkey, &cose_alg)) != FIDO_OK) {
+		fido_log_debug("%s: pk_from_EVP_PKEY", __func__);
+		goto fail;
+	}
+
+	/* the decoded key is used as is */
+	if ((r = pk_install(pk, cose_alg, pkey, &raw)) != FIDO_OK)
+		goto fail;
+
+	return (FIDO_OK);
+fail:
+	EVP_PKEY_free(pkey);
+
+	return (r);
+}
+
+int
+fido_pk_set_cose(fido_pk_t *pk, const unsigned char *ptr, size_t len)
+{
+	pk_raw_t	raw;
+	int		cose_alg;
+
+	fido_pk_reset(pk);
+	memset(&raw, 0, sizeof(raw));
+
+	if (ptr == NULL || len == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if (cbor_read_pubkey(&ptr, &len, &cose_alg, &raw) < 0 || len != 0) {
+		fido_log_debug("%s: cbor_read_pubkey", __func__);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	return (fido_pk_set(pk, cose_alg, &raw));
+}
+
+int
+fido_pk_type(const fido_pk_t *pk)
+{
+	return (pk->type);
+}
+
+int
+fido_pk_verify_sig(const fido_blob_t *dgst, const fido_pk_t *pk,
+    const fido_blob_t *sig)
+{
+	EVP_PKEY_CTX	*pctx;
+	EVP_PKEY_CTX	*new_pctx;
+	int		 ok = -1;
+
+	if (pk->pkey == NULL) {
+		fido_log_debug("%s: pkey=NULL", __func__);
+		return (-1);
+	}
+
+	if (pk->type == COSE_ES256 || pk->type == COSE_EDDSA) {
+		switch (fido_verify_handler(pk->type, &pk->raw, dgst, sig)) {
+		case FIDO_OK:
+			return (0);
+		case FIDO_ERR_UNSUPPORTED_ALGORITHM:
+			break;
+		default:
+			return (-1);
+		}
+	}
+
+#ifndef FIDO_NO_EDDSA
+	if (pk->type == COSE_EDDSA)
+		return (eddsa_verify_sig(dgst, pk->pkey, sig));
+
+#endif
+	if ((pctx = pk_ctx_get(pk, &new_pctx)) == NULL) {
+		fido_log_debug("%s: pk_ctx_get", __func__);
+		return (-1);
+	}
+	if (EVP_PKEY_verify(pctx, sig->ptr, sig->len, dgst->ptr,
+	    dgst->len) != 1) {
+		fido_log_debug("%s: EVP_PKEY_verify", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	EVP_PKEY_CTX_free(new_pctx);
+
+	return (ok);
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "fido.h"
+
+/*
+ * A set of devices opened together, and a list of steps to run on each.
+ * The pool creates no threads: fido_dev_pool_work() may be called from
+ * any number of application threads, each claiming the next unclaimed
+ * device with an atomic increment and running every step on it.
+ */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define pool_claim(p)	_InterlockedExchangeAdd((volatile long *)(p), 1)
+#else
+#define pool_claim(p)	__atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+#endif
+
+#define POOL_MAXDEV	4096
+
+fido_dev_pool_t *
+fido_dev_pool_new(void)
+{
+	return (fido_calloc(1, sizeof(fido_dev_pool_t)));
+}
+
+void
+fido_dev_pool_free(fido_dev_pool_t **pool_p)
+{
+	fido_dev_pool_t *pool;
+
+	if (pool_p == NULL || (pool = *pool_p) == NULL)
+		return;
+
+	for (size_t i = 0; i < pool->len; i++) {
+		if (pool->dev[i] == NULL)
+			continue;
+		if (pool->dev[i]->io_handle != NULL)
+			(void)fido_dev_close(pool->dev[i]);
+		fido_dev_free(&pool->dev[i]);
+	}
+	fido_free(pool->dev);
+	fido_free(pool->status);
+	fido_free(pool->step);
+	fido_free(pool);
+
+	*pool_p = NULL;
+}
+
+int
+fido_dev_pool_open(fido_dev_pool_t *pool, const fido_dev_info_t *devlist,
+    size_t n)
+{
+	fido_dev_t	**dev = NULL;
+	int		 *status = NULL;
+	int		  r;
+
+	if (pool->len != 0 || devlist == NULL || n == 0 || n > POOL_MAXDEV) {
+		fido_log_debug("%s: len=%zu, n=%zu", __func__, pool->len, n);
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	}
+
+	if ((dev = fido_calloc(n, sizeof(*dev))) == NULL ||
+	    (status = fido_calloc(n, sizeof(*status))) == NULL) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		/* a device without a path fails in fido_dev_open_many() */
+		if (devlist[i].path != NULL)
+			dev[i] = fido_dev_new_with_info(&devlist[i]);
+		else
+			dev[i] = fido_dev_new();
+		if (dev[i] == NULL) {
+			fido_log_debug("%s: fido_dev_new", __func__);
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+		/* steps on a device share its pin/uv auth token */
+		dev[i]->token_cache = true;
+	}
+
+	r = fido_dev_open_many(dev, n, status);
+
+	pool->dev = dev;
+	pool->status = status;
+	pool->len = n;
+	pool->next = 0;
+
+	return (r);
+fail:
+	if (dev != NULL)
+		for (size_t i = 0; i < n; i++)
+			fido_dev_free(&dev[i]);
+	fido_free(dev);
+	fido_free(status);
+
+	return (r);
+}
+
+int
+fido_dev_pool_add(fido_dev_pool_t *pool, fido_dev_pool_cb_t *cb, void *cb_arg)
+{
+	fido_dev_pool_step_t *step;
+
+	if (cb == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if ((step = fido_recallocarray(pool->step, pool->nsteps,
+	    pool->nsteps + 1, sizeof(*step))) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	step[pool->nsteps].cb = cb;
+	step[pool->nsteps].cb_arg = cb_arg;
+	pool->step = step;
+	pool->nsteps++;
+
+	return (FIDO_OK);
+}
+
+int
+fido_dev_pool_set_progress(fido_dev_pool_t *pool,
+    fido_dev_pool_progress_t *progress, void *progress_arg)
+{
+	pool->progress = progress;
+	pool->progress_arg = progress_arg;
+
+	return (FIDO_OK);
+}
+
+/* run the steps on unclaimed devices until none is left */
+int
+fido_dev_pool_work(fido_dev_pool_t *pool)
+{
+	size_t	i;
+	int	r, ok = FIDO_OK;
+
+	while ((i = (size_t)pool_claim(&pool->next)) < pool->len) {
+		if (pool->status[i] != FIDO_OK)
+			continue; /* not opened */
+		for (size_t j = 0; j < pool->nsteps; j++) {
+			r = pool->step[j].cb(pool->dev[i], i,
+			    pool->step[j].cb_arg);
+			if (pool->progress != NULL)
+				pool->progress(pool->progress_arg, i, j, r);
+			if (r != FIDO_OK) {
+				fido_log_debug("%s: dev %zu, step %zu: %d",
+				    __func__, i, j, r);
+				pool->status[i] = r;
+				if (ok == FIDO_OK)
+					ok = r;
+				break;
+			}
+		}
+	}
+
+	return (ok);
+}
+
+/* forget the steps and their outcome; the devices stay open */
+int
+fido_dev_pool_rewind(fido_dev_pool_t *pool)
+{
+	for (size_t i = 0; i < pool->len; i++)
+		if (pool->dev[i]->io_handle != NULL)
+			pool->status[i] = FIDO_OK;
+
+	fido_free(pool->step);
+	pool->step = NULL;
+	pool->nsteps = 0;
+	pool->next = 0;
+
+	return (FIDO_OK);
+}
+
+size_t
+fido_dev_pool_len(const fido_dev_pool_t *pool)
+{
+	return (pool->len);
+}
+
+fido_dev_t *
+fido_dev_pool_dev(const fido_dev_pool_t *pool, size_t idx)
+{
+	if (idx >= pool->len)
+		return (NULL);
+
+	return (pool->dev[idx]);
+}
+
+int
+fido_dev_pool_status(const fido_dev_pool_t *pool, size_t idx)
+{
+	if (idx >= pool->len)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	return (pool->status[idx]);
+}
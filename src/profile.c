@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fido.h"
+
+#ifndef TLS
+#define TLS
+#endif
+
+/*
+ * FIDO_PROFILE: wall-time histograms of internal stages, kept per thread
+ * and written to the log sink when a device is closed and at exit. Stage
+ * times are inclusive; an ECDH exchange also counts in fido_tx/fido_rx.
+ * Bucket b holds durations of less than 2^b microseconds not counted by
+ * bucket b - 1; the last bucket holds everything longer.
+ */
+
+#define PROF_NBUCKET	25	/* the last from ~8s */
+
+struct prof_hist {
+	uint64_t n;
+	uint64_t total_us;
+	uint64_t max_us;
+	uint64_t bucket[PROF_NBUCKET];
+};
+
+static const char *prof_name[FIDO_PROF_NSTAGE] = {
+	"cbor_build_frame",
+	"fido_tx",
+	"fido_rx",
+	"cbor_parse_reply",
+	"fido_do_ecdh",
+	"fido_dev_get_uv_token",
+	"verify_sig",
+};
+
+static TLS bool prof_enabled;
+static TLS struct prof_hist prof_hist[FIDO_PROF_NSTAGE];
+static bool prof_atexit; /* set before threads start */
+
+static void
+prof_emit(const char *line)
+{
+#ifndef FIDO_NO_DIAGNOSTIC
+	fido_do_log_debug("%s", line);
+#else
+	fprintf(stderr, "%s\n", line);
+#endif
+}
+
+static uint64_t
+prof_elapsed_us(const struct timespec *start)
+{
+	struct timespec now;
+	int64_t us;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+		return (0);
+
+	us = (int64_t)(now.tv_sec - start->tv_sec) * 1000000LL +
+	    (now.tv_nsec - start->tv_nsec) / 1000LL;
+
+	return (us < 0 ? 0 : (uint64_t)us);
+}
+
+static size_t
+prof_bucket(uint64_t us)
+{
+	size_t b = 0;
+
+	while (b < PROF_NBUCKET - 1 && us >= (1ULL << b))
+		b++;
+
+	return (b);
+}
+
+static void
+prof_dump(const char *what)
+{
+	const struct prof_hist *h;
+	char line[128];
+
+	for (size_t i = 0; i < FIDO_PROF_NSTAGE; i++) {
+		if ((h = &prof_hist[i])->n == 0)
+			continue;
+		snprintf(line, sizeof(line), "profile: %.48s: %s: n=%llu "
+		    "mean=%lluus max=%lluus", what, prof_name[i],
+		    (unsigned long long)h->n,
+		    (unsigned long long)(h->total_us / h->n),
+		    (unsigned long long)h->max_us);
+		prof_emit(line);
+		for (size_t b = 0; b < PROF_NBUCKET; b++) {
+			if (h->bucket[b] == 0)
+				continue;
+			snprintf(line, sizeof(line), "profile: %.48s: %s: "
+			    "%s%lluus %llu", what, prof_name[i],
+			    b < PROF_NBUCKET - 1 ? "<" : ">=",
+			    1ULL << (b < PROF_NBUCKET - 1 ? b : b - 1),
+			    (unsigned long long)h->bucket[b]);
+			prof_emit(line);
+		}
+	}
+
+	memset(prof_hist, 0, sizeof(prof_hist));
+}
+
+static void
+prof_dump_atexit(void)
+{
+	if (prof_enabled)
+		prof_dump("exit");
+}
+
+void
+fido_prof_init(bool enable)
+{
+	memset(prof_hist, 0, sizeof(prof_hist));
+	prof_enabled = enable;
+
+	if (enable && !prof_atexit && atexit(prof_dump_atexit) == 0)
+		prof_atexit = true;
+}
+
+void
+fido_prof_begin(fido_prof_t *p, int stage)
+{
+	p->stage = -1;
+
+	if (!prof_enabled || stage < 0 || stage >= FIDO_PROF_NSTAGE ||
+	    clock_gettime(CLOCK_MONOTONIC, &p->start) != 0)
+		return;
+
+	p->stage = stage;
+}
+
+/* record the stage timed in 'p'; returns 'r' */
+int
+fido_prof_end(fido_prof_t *p, int r)
+{
+	struct prof_hist *h;
+	uint64_t us;
+
+	if (p->stage < 0 || !prof_enabled)
+		return (r);
+
+	us = prof_elapsed_us(&p->start);
+	h = &prof_hist[p->stage];
+	h->n++;
+	h->total_us += us;
+	if (us > h->max_us)
+		h->max_us = us;
+	h->bucket[prof_bucket(us)]++;
+
+	return (r);
+}
+
+/* write and clear the calling thread's histograms */
+void
+fido_prof_dump(const char *what)
+{
+	if (prof_enabled)
+		prof_dump(what != NULL ? what : "-");
+}
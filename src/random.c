@@ -81,3 +81,106 @@ fail:
 #else
 #error "please provide an implementation of fido_get_random() for your platform"
 #endif /* _WIN32 */
+
+/*
+ * Randomness for values that are not long-term secrets: channel nonces,
+ * IVs and largeBlob nonces. Where fido_get_random() is a system call per
+ * invocation, these are served from a per-thread buffer of its output,
+ * refilled when used up, with each byte wiped once handed out. A page
+ * mapped with MADV_WIPEONFORK reads as zero in a child after fork(), so
+ * that the forking thread discards its buffer there instead of repeating
+ * its parent's output. Elsewhere, fido_get_random() is used directly:
+ * arc4random_buf() and BCryptGenRandom() already buffer in user space.
+ */
+
+#if !defined(_WIN32) && !defined(HAVE_ARC4RANDOM_BUF) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
+
+#if !defined(_WIN32) && !defined(HAVE_ARC4RANDOM_BUF) && \
+    defined(HAVE_MMAP) && defined(MADV_WIPEONFORK)
+
+#ifndef TLS
+#define TLS
+#endif
+
+#define RANDOM_BUF_LEN	512
+
+static TLS struct random_buf {
+	unsigned char	buf[RANDOM_BUF_LEN];
+	size_t		off;	/* bytes handed out */
+	bool		full;
+} random_buf;
+
+static unsigned char *fork_page;	/* zero after fork() */
+static int fork_page_failed;
+
+static unsigned char *
+get_fork_page(void)
+{
+	void		*p;
+	unsigned char	*exp = NULL;
+	long		 pagesz;
+
+	if ((p = __atomic_load_n(&fork_page, __ATOMIC_ACQUIRE)) != NULL ||
+	    __atomic_load_n(&fork_page_failed, __ATOMIC_RELAXED))
+		return (p);
+	if ((pagesz = sysconf(_SC_PAGESIZE)) <= 0 ||
+	    (p = mmap(NULL, (size_t)pagesz, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANON, -1, 0)) == MAP_FAILED) {
+		fido_log_debug("%s: mmap", __func__);
+		__atomic_store_n(&fork_page_failed, 1, __ATOMIC_RELAXED);
+		return (NULL);
+	}
+	if (madvise(p, (size_t)pagesz, MADV_WIPEONFORK) != 0) {
+		fido_log_debug("%s: madvise", __func__);
+		munmap(p, (size_t)pagesz);
+		__atomic_store_n(&fork_page_failed, 1, __ATOMIC_RELAXED);
+		return (NULL);
+	}
+	if (!__atomic_compare_exchange_n(&fork_page, &exp,
+	    p, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		/* another thread got there first */
+		munmap(p, (size_t)pagesz);
+		return (exp);
+	}
+
+	return (p);
+}
+
+int
+fido_get_nonce(void *buf, size_t len)
+{
+	struct random_buf	*rb = &random_buf;
+	volatile unsigned char	*page;
+
+	if (len > RANDOM_BUF_LEN / 4 || (page = get_fork_page()) == NULL)
+		return (fido_get_random(buf, len));
+
+	if (*page == 0) {
+		/* first use in this process; discard what fork() copied */
+		explicit_bzero(rb, sizeof(*rb));
+		*page = 1;
+	}
+	if (!rb->full || rb->off + len > sizeof(rb->buf)) {
+		if (fido_get_random(rb->buf, sizeof(rb->buf)) < 0) {
+			explicit_bzero(rb, sizeof(*rb));
+			return (-1);
+		}
+		rb->off = 0;
+		rb->full = true;
+	}
+
+	memcpy(buf, rb->buf + rb->off, len);
+	explicit_bzero(rb->buf + rb->off, len);
+	rb->off += len;
+
+	return (0);
+}
+#else
+int
+fido_get_nonce(void *buf, size_t len)
+{
+	return (fido_get_random(buf, len));
+}
+#endif
@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef USE_BROKER
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "fido.h"
+
+/*
+ * A remote device is an open device served over a stream socket, unix or
+ * TCP, one whole CTAP message at a time rather than one HID report at a
+ * time. Each message is preceded by a header:
+ *
+ *	cmd (1) | flags (1) | len (4, big endian) | origlen (4, big endian)
+ *
+ * where len is that of the payload that follows, and origlen that of
+ * the payload once inflated if REMOTE_DEFLATE is set. Requests are
+ * written as they are sent, without waiting for a reply, and answered
+ * in order; a client may thus have several in flight. CTAPHID_INIT is
+ * answered by the server, CTAPHID_CANCEL is forwarded without reply,
+ * also while the server waits for the device to answer an earlier
+ * request.
+ *
+ * Clients open "remote:" followed by the endpoint of the server.
+ */
+
+#ifdef USE_BROKER
+
+#define REMOTE_HDR_LEN		10
+#define REMOTE_DEFLATE		0x01	/* payload is deflated */
+#define REMOTE_ERROR		0x02	/* request failed; no payload */
+#define REMOTE_DEFLATE_MIN	256	/* shorter payloads are sent as is */
+#define REMOTE_MAXMSG		UINT16_MAX
+#define REMOTE_MAXCLIENT	16
+#define REMOTE_READ_MS		5000	/* for the rest of a message */
+#define REMOTE_POLL_MS		100	/* between looks at the client */
+
+struct remote_client {
+	int fd;
+};
+
+struct remote_io {
+	int fd;
+};
+
+static void
+remote_put32(unsigned char *ptr, size_t v)
+{
+	ptr[0] = (unsigned char)(v >> 24);
+	ptr[1] = (unsigned char)(v >> 16);
+	ptr[2] = (unsigned char)(v >> 8);
+	ptr[3] = (unsigned char)v;
+}
+
+static size_t
+remote_get32(const unsigned char *ptr)
+{
+	return ((size_t)ptr[0] << 24 | (size_t)ptr[1] << 16 |
+	    (size_t)ptr[2] << 8 | (size_t)ptr[3]);
+}
+
+/* send a message, deflated if that makes it shorter */
+static int
+remote_send(int fd, uint8_t cmd, uint8_t flags, const unsigned char *ptr,
+    size_t len)
+{
+	unsigned char	hdr[REMOTE_HDR_LEN];
+	fido_blob_t	in, z;
+	int		ok = -1;
+
+	memset(&z, 0, sizeof(z));
+	if (len > REMOTE_MAXMSG) {
+		fido_log_debug("%s: len=%zu", __func__, len);
+		return (-1);
+	}
+	if (len >= REMOTE_DEFLATE_MIN) {
+		in.ptr = (u_char *)(uintptr_t)ptr; /* not freed */
+		in.len = len;
+		if (fido_compress(&z, &in) == FIDO_OK && z.len < len)
+			flags |= REMOTE_DEFLATE;
+	}
+
+	hdr[0] = cmd;
+	hdr[1] = flags;
+	remote_put32(&hdr[2], (flags & REMOTE_DEFLATE) ? z.len : len);
+	remote_put32(&hdr[6], len);
+	if (fido_sock_send(fd, hdr, sizeof(hdr)) < 0 ||
+	    ((flags & REMOTE_DEFLATE) ? fido_sock_send(fd, z.ptr, z.len) :
+	    fido_sock_send(fd, ptr, len)) < 0)
+		goto fail;
+
+	ok = 0;
+fail:
+	fido_blob_reset(&z);
+
+	return (ok);
+}
+
+/* read a message into 'body', inflating it; the header must be waiting */
+static int
+remote_recv(int fd, uint8_t *cmd, uint8_t *flags, fido_blob_t *body)
+{
+	unsigned char	hdr[REMOTE_HDR_LEN];
+	fido_blob_t	z;
+	size_t		len, origlen;
+
+	memset(&z, 0, sizeof(z));
+	fido_blob_reset(body);
+	if (fido_sock_recv(fd, hdr, sizeof(hdr)) < 0)
+		return (-1);
+
+	*cmd = hdr[0];
+	*flags = hdr[1];
+	len = remote_get32(&hdr[2]);
+	origlen = remote_get32(&hdr[6]);
+	if (len > REMOTE_MAXMSG || origlen > REMOTE_MAXMSG ||
+	    ((*flags & REMOTE_DEFLATE) == 0 && len != origlen) ||
+	    ((*flags & REMOTE_ERROR) && len != 0)) {
+		fido_log_debug("%s: len=%zu, origlen=%zu, flags=0x%02x",
+		    __func__, len, origlen, *flags);
+		return (-1);
+	}
+	if (len == 0)
+		return (0);
+	if ((z.ptr = fido_malloc(len)) == NULL)
+		return (-1);
+	z.len = len;
+	if (fido_sock_recv(fd, z.ptr, z.len) < 0) {
+		fido_blob_reset(&z);
+		return (-1);
+	}
+	if ((*flags & REMOTE_DEFLATE) == 0) {
+		*body = z;
+		return (0);
+	}
+	if (fido_uncompress(body, &z, origlen) != FIDO_OK ||
+	    body->len != origlen) {
+		fido_log_debug("%s: fido_uncompress", __func__);
+		fido_blob_reset(&z);
+		fido_blob_reset(body);
+		return (-1);
+	}
+	fido_blob_reset(&z);
+
+	return (0);
+}
+
+static void
+remote_drop(fido_remote_t *r, size_t i)
+{
+	fido_log_debug("%s: client %zu", __func__, i);
+
+	fido_sock_close(r->client[i].fd);
+	r->client[i] = r->client[--r->nclient];
+}
+
+static void
+remote_cancel(fido_remote_t *r)
+{
+	int ms = fido_time_budget(r->dev->timeout_ms);
+
+	if (fido_tx(r->dev, CTAP_CMD_CANCEL, NULL, 0, &ms) < 0)
+		fido_log_debug("%s: fido_tx", __func__);
+}
+
+/*
+ * Look at the client while the device works on its request: forward a
+ * cancel, or cancel the request if the client is gone. Returns -1 once
+ * the client is gone, 0 while it may be looked at again, 1 once a later
+ * request is waiting, which is left for after the reply.
+ */
+static int
+remote_watch(fido_remote_t *r, const struct remote_client *c)
+{
+	struct pollfd	pfd;
+	unsigned char	hdr[REMOTE_HDR_LEN];
+	int		n;
+
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = c->fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) < 1)
+		return (0);
+	if ((n = fido_sock_peek(c->fd, hdr, sizeof(hdr))) == 0 ||
+	    (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+		remote_cancel(r);
+		return (-1);
+	}
+	if (n < (int)sizeof(hdr))
+		return (0); /* not all there yet */
+	if (hdr[0] != CTAP_CMD_CANCEL || remote_get32(&hdr[2]) != 0)
+		return (1);
+	if (fido_sock_recv(c->fd, hdr, sizeof(hdr)) < 0) {
+		remote_cancel(r);
+		return (-1);
+	}
+	remote_cancel(r);
+
+	return (0);
+}
+
+/*
+ * Wait for the device to start replying, looking at the client every
+ * REMOTE_POLL_MS. Devices that cannot be polled are not waited for;
+ * fido_rx() then blocks until the reply.
+ */
+static int
+remote_wait(fido_remote_t *r, const struct remote_client *c, int *ms)
+{
+	int	wait, left, n;
+	bool	watch = true, gone = false;
+
+	if (r->dev->transport.rx != NULL)
+		return (0);
+
+	while (*ms != 0) {
+		wait = left = *ms < 0 || *ms > REMOTE_POLL_MS ?
+		    REMOTE_POLL_MS : *ms;
+		if (fido_rx_poll(r->dev, &left) != 0)
+			break; /* a frame, or an error for fido_rx() */
+		if (*ms > 0)
+			*ms -= wait - left;
+		if (!watch)
+			continue;
+		if ((n = remote_watch(r, c)) < 0)
+			gone = true;
+		watch = n == 0;
+	}
+
+	return (gone ? -1 : 0);
+}
+
+static int
+remote_init(fido_remote_t *r, const struct remote_client *c,
+    const fido_blob_t *req)
+{
+	fido_ctap_info_t attr;
+
+	if (req->len != sizeof(attr.nonce)) {
+		fido_log_debug("%s: len=%zu", __func__, req->len);
+		return (remote_send(c->fd, CTAP_CMD_INIT, REMOTE_ERROR, NULL,
+		    0) < 0 ? FIDO_ERR_RX : FIDO_OK);
+	}
+	attr = r->dev->attr;
+	memcpy(&attr.nonce, req->ptr, sizeof(attr.nonce));
+
+	return (remote_send(c->fd, CTAP_CMD_INIT, 0, (unsigned char *)&attr,
+	    sizeof(attr)) < 0 ? FIDO_ERR_RX : FIDO_OK);
+}
+
+static int
+remote_forward(fido_remote_t *r, const struct remote_client *c, uint8_t cmd,
+    const fido_blob_t *req)
+{
+	unsigned char	*msg;
+	size_t		 msgsiz = 0;
+	int		 ms = fido_time_budget(r->dev->timeout_ms);
+	int		 n, gone, ok;
+
+	if (fido_tx(r->dev, cmd, req->ptr, req->len, &ms) < 0) {
+		fido_log_debug("%s: fido_tx", __func__);
+		return (remote_send(c->fd, cmd, REMOTE_ERROR, NULL, 0) < 0 ?
+		    FIDO_ERR_RX : FIDO_OK);
+	}
+	if ((msg = fido_dev_msgbuf_get(r->dev, &msgsiz)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	/* a cancelled request is answered too; read the answer */
+	gone = remote_wait(r, c, &ms);
+	if ((n = fido_rx(r->dev, cmd, msg, msgsiz, &ms)) < 0)
+		fido_log_debug("%s: fido_rx", __func__);
+	if (gone < 0)
+		ok = FIDO_ERR_RX;
+	else if (n < 0)
+		ok = remote_send(c->fd, cmd, REMOTE_ERROR, NULL, 0) < 0 ?
+		    FIDO_ERR_RX : FIDO_OK;
+	else
+		ok = remote_send(c->fd, cmd, 0, msg, (size_t)n) < 0 ?
+		    FIDO_ERR_RX : FIDO_OK;
+	fido_dev_msgbuf_put(r->dev, msg, msgsiz);
+
+	return (ok);
+}
+
+/* serve a request from a client; FIDO_ERR_RX if the client is gone */
+static int
+remote_serve(fido_remote_t *r, const struct remote_client *c)
+{
+	fido_blob_t	req;
+	uint8_t		cmd, flags;
+	int		ok;
+
+	memset(&req, 0, sizeof(req));
+	if (remote_recv(c->fd, &cmd, &flags, &req) < 0)
+		return (FIDO_ERR_RX);
+
+	switch (cmd) {
+	case CTAP_CMD_INIT:
+		ok = remote_init(r, c, &req);
+		break;
+	case CTAP_CMD_CANCEL:
+		remote_cancel(r);
+		ok = FIDO_OK;
+		break;
+	default:
+		ok = remote_forward(r, c, cmd, &req);
+		break;
+	}
+	fido_blob_reset(&req);
+
+	return (ok);
+}
+
+static void
+remote_accept(fido_remote_t *r)
+{
+	int fd;
+
+	if ((fd = fido_sock_accept(r->sock)) < 0)
+		return;
+	if (r->nclient == REMOTE_MAXCLIENT ||
+	    fido_sock_set_timeout(fd, REMOTE_READ_MS) < 0) {
+		fido_log_debug("%s: nclient=%zu", __func__, r->nclient);
+		fido_sock_close(fd);
+		return;
+	}
+	r->client[r->nclient++].fd = fd;
+}
+
+fido_remote_t *
+fido_remote_new(void)
+{
+	fido_remote_t *r;
+
+	if ((r = fido_calloc(1, sizeof(*r))) == NULL)
+		return (NULL);
+	if ((r->client = fido_calloc(REMOTE_MAXCLIENT,
+	    sizeof(*r->client))) == NULL) {
+		fido_free(r);
+		return (NULL);
+	}
+	r->sock = -1;
+
+	return (r);
+}
+
+void
+fido_remote_free(fido_remote_t **r_p)
+{
+	fido_remote_t *r;
+
+	if (r_p == NULL || (r = *r_p) == NULL)
+		return;
+
+	while (r->nclient > 0)
+		remote_drop(r, r->nclient - 1);
+	if (r->sock != -1)
+		fido_sock_close(r->sock);
+	if (r->sock_path != NULL && unlink(r->sock_path) != 0)
+		fido_log_error(errno, "%s: unlink", __func__);
+	fido_free(r->sock_path);
+	fido_free(r->client);
+	fido_free(r);
+
+	*r_p = NULL;
+}
+
+int
+fido_remote_open(fido_remote_t *r, fido_dev_t *dev, const char *endpoint)
+{
+	if (r->dev != NULL || dev == NULL || dev->io_handle == NULL ||
+	    endpoint == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	if (fido_sock_is_unix(endpoint) &&
+	    (r->sock_path = fido_strdup(endpoint)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+	if ((r->sock = fido_sock_listen(endpoint)) < 0) {
+		fido_log_debug("%s: fido_sock_listen", __func__);
+		fido_free(r->sock_path);
+		r->sock_path = NULL; /* not ours to unlink */
+		return (FIDO_ERR_INTERNAL);
+	}
+	r->dev = dev;
+
+	return (FIDO_OK);
+}
+
+/*
+ * Wait up to 'ms' milliseconds (-1 for ever) for requests from the
+ * clients, and serve those that arrived.
+ */
+int
+fido_remote_work(fido_remote_t *r, int ms)
+{
+	struct pollfd	pfd[REMOTE_MAXCLIENT + 1];
+	size_t		n, nclient;
+	int		ok;
+
+	if (r->dev == NULL)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	memset(pfd, 0, sizeof(pfd));
+	pfd[0].fd = r->sock;
+	for (size_t i = 0; i < r->nclient; i++)
+		pfd[1 + i].fd = r->client[i].fd;
+	nclient = r->nclient;
+	n = 1 + nclient;
+	for (size_t i = 0; i < n; i++)
+		pfd[i].events = POLLIN;
+
+	if (poll(pfd, (nfds_t)n, ms) < 0) {
+		if (errno == EINTR)
+			return (FIDO_OK);
+		fido_log_error(errno, "%s: poll", __func__);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	/* backwards, as dropping a client moves the last one to its slot */
+	for (size_t i = nclient; i > 0; i--) {
+		if (pfd[i].revents == 0)
+			continue;
+		if ((ok = remote_serve(r, &r->client[i - 1])) == FIDO_ERR_RX)
+			remote_drop(r, i - 1);
+		else if (ok != FIDO_OK)
+			return (ok);
+	}
+	if (pfd[0].revents & POLLIN)
+		remote_accept(r);
+
+	return (FIDO_OK);
+}
+
+bool
+fido_is_remote(const char *path)
+{
+	return (strncmp(path, FIDO_REMOTE_PREFIX,
+	    strlen(FIDO_REMOTE_PREFIX)) == 0);
+}
+
+void *
+fido_remote_io_open(const char *path)
+{
+	struct remote_io	*io;
+	int			 fd;
+
+	if (!fido_is_remote(path))
+		return (NULL);
+	if ((fd = fido_sock_connect(path + strlen(FIDO_REMOTE_PREFIX))) < 0)
+		return (NULL);
+	if ((io = fido_calloc(1, sizeof(*io))) == NULL) {
+		fido_sock_close(fd);
+		return (NULL);
+	}
+	io->fd = fd;
+
+	return (io);
+}
+
+void
+fido_remote_io_close(void *handle)
+{
+	struct remote_io *io = handle;
+
+	fido_sock_close(io->fd);
+	fido_free(io);
+}
+
+int
+fido_remote_tx(fido_dev_t *d, uint8_t cmd, const unsigned char *buf,
+    size_t count)
+{
+	struct remote_io *io = d->io_handle;
+
+	if (remote_send(io->fd, cmd, 0, buf, count) < 0) {
+		fido_log_debug("%s: remote_send", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+int
+fido_remote_rx(fido_dev_t *d, uint8_t cmd, unsigned char *buf, size_t count,
+    int ms)
+{
+	struct remote_io	*io = d->io_handle;
+	fido_blob_t		 body;
+	uint8_t			 rx_cmd, flags;
+	int			 n = -1;
+
+	memset(&body, 0, sizeof(body));
+	if (fido_sock_poll(io->fd, ms) < 0 ||
+	    remote_recv(io->fd, &rx_cmd, &flags, &body) < 0) {
+		fido_log_debug("%s: remote_recv", __func__);
+		return (-1);
+	}
+	if (rx_cmd != cmd || (flags & REMOTE_ERROR) || body.len > count ||
+	    body.len > INT_MAX) {
+		fido_log_debug("%s: cmd=0x%02x, flags=0x%02x, len=%zu",
+		    __func__, rx_cmd, flags, body.len);
+		goto fail;
+	}
+	if (body.len > 0)
+		memcpy(buf, body.ptr, body.len);
+
+	n = (int)body.len;
+fail:
+	fido_blob_reset(&body);
+
+	return (n);
+}
+
+int
+fido_dev_set_remote(fido_dev_t *d)
+{
+	if (d->io_handle != NULL) {
+		fido_log_debug("%s: device open", __func__);
+		return (-1);
+	}
+	d->io_own = true;
+	d->io = (fido_dev_io_t) {
+		fido_remote_io_open,
+		fido_remote_io_close,
+		NULL,
+		NULL,
+	};
+	d->transport = (fido_dev_transport_t) {
+		fido_remote_rx,
+		fido_remote_tx,
+	};
+
+	return (0);
+}
+
+#else /* USE_BROKER */
+
+fido_remote_t *
+fido_remote_new(void)
+{
+	return (NULL);
+}
+
+void
+fido_remote_free(fido_remote_t **r_p)
+{
+	(void)r_p;
+}
+
+int
+fido_remote_open(fido_remote_t *r, fido_dev_t *dev, const char *endpoint)
+{
+	(void)r;
+	(void)dev;
+	(void)endpoint;
+
+	return (FIDO_ERR_UNSUPPORTED_OPTION);
+}
+
+int
+fido_remote_work(fido_remote_t *r, int ms)
+{
+	(void)r;
+	(void)ms;
+
+	return (FIDO_ERR_UNSUPPORTED_OPTION);
+}
+
+#endif /* USE_BROKER */
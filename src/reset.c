@@ -25,6 +25,9 @@ fido_dev_reset_wait(fido_dev_t *dev, int *ms)
 {
 	int r;
 
+	fido_dev_token_cache_reset(dev);
+	fido_dev_largeblob_cache_reset(dev);
+
 	if ((r = fido_dev_reset_tx(dev, ms)) != FIDO_OK ||
 	    (r = fido_rx_cbor_status(dev, ms)) != FIDO_OK)
 		return (r);
@@ -40,7 +43,7 @@ fido_dev_reset_wait(fido_dev_t *dev, int *ms)
 int
 fido_dev_reset(fido_dev_t *dev)
 {
-	int ms = dev->timeout_ms;
+	int ms = fido_time_budget(dev->timeout_ms);
 
 	return (fido_dev_reset_wait(dev, &ms));
 }
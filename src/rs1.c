@@ -21,7 +21,7 @@ rs1_get_EVP_MD(void)
 {
 PRAGMA("GCC diagnostic push")
 PRAGMA("GCC diagnostic ignored \"-Wcast-qual\"")
-	return ((EVP_MD *)EVP_sha1());
+	return ((EVP_MD *)fido_md_sha1());
 PRAGMA("GCC diagnostic pop")
 }
 
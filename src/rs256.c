@@ -8,6 +8,10 @@
 #include <openssl/bn.h>
 #include <openssl/rsa.h>
 #include <openssl/obj_mac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+#include <openssl/core_names.h>
+#include <openssl/param_build.h>
+#endif
 
 #include "fido.h"
 #include "fido/rs256.h"
@@ -18,6 +22,12 @@
 #define get0_RSA(x)	EVP_PKEY_get0((x))
 #endif
 
+#ifndef TLS
+#define TLS
+#endif
+
+#define PK_CACHE_LEN	4
+
 #if defined(__GNUC__)
 #define PRAGMA(s) _Pragma(s)
 #else
@@ -29,7 +39,7 @@ rs256_get_EVP_MD(void)
 {
 PRAGMA("GCC diagnostic push")
 PRAGMA("GCC diagnostic ignored \"-Wcast-qual\"")
-	return ((EVP_MD *)EVP_sha256());
+	return ((EVP_MD *)fido_md_sha256());
 PRAGMA("GCC diagnostic pop")
 }
 
@@ -83,7 +93,7 @@ rs256_pk_decode(const cbor_item_t *item, rs256_pk_t *k)
 rs256_pk_t *
 rs256_pk_new(void)
 {
-	return (calloc(1, sizeof(rs256_pk_t)));
+	return (fido_calloc(1, sizeof(rs256_pk_t)));
 }
 
 void
@@ -94,7 +104,7 @@ rs256_pk_free(rs256_pk_t **pkp)
 	if (pkp == NULL || (pk = *pkp) == NULL)
 		return;
 
-	freezero(pk, sizeof(*pk));
+	fido_freezero(pk, sizeof(*pk));
 	*pkp = NULL;
 }
 
@@ -118,6 +128,95 @@ rs256_pk_from_ptr(rs256_pk_t *pk, const void *ptr, size_t len)
 	return (FIDO_OK);
 }
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+/* a key import context reused by the executing thread's conversions */
+static TLS EVP_PKEY_CTX *import_pctx;
+
+static EVP_PKEY_CTX *
+import_ctx_get(void)
+{
+	EVP_PKEY_CTX *pctx;
+
+#ifndef FIDO_FUZZ
+	if (import_pctx != NULL)
+		return (import_pctx);
+#endif
+	if ((pctx = EVP_PKEY_CTX_new_from_name(NULL, "RSA", NULL)) == NULL ||
+	    EVP_PKEY_fromdata_init(pctx) != 1) {
+		fido_log_debug("%s: EVP_PKEY_fromdata_init", __func__);
+		EVP_PKEY_CTX_free(pctx);
+		return (NULL);
+	}
+#ifndef FIDO_FUZZ
+	import_pctx = pctx;
+#endif
+
+	return (pctx);
+}
+
+static void
+import_ctx_put(EVP_PKEY_CTX *pctx)
+{
+#ifdef FIDO_FUZZ
+	EVP_PKEY_CTX_free(pctx);
+#else
+	(void)pctx;
+#endif
+}
+
+/* imported through the RSA key management provider, without a legacy RSA */
+EVP_PKEY *
+rs256_pk_to_EVP_PKEY(const rs256_pk_t *k)
+{
+	EVP_PKEY_CTX	*pctx = NULL;
+	EVP_PKEY	*pkey = NULL;
+	OSSL_PARAM_BLD	*bld = NULL;
+	OSSL_PARAM	*params = NULL;
+	BIGNUM		*n = NULL;
+	BIGNUM		*e = NULL;
+	int		 ok = -1;
+
+	if ((n = BN_bin2bn(k->n, sizeof(k->n), NULL)) == NULL ||
+	    (e = BN_bin2bn(k->e, sizeof(k->e), NULL)) == NULL) {
+		fido_log_debug("%s: BN_bin2bn", __func__);
+		goto fail;
+	}
+
+	if ((bld = OSSL_PARAM_BLD_new()) == NULL ||
+	    OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_N, n) != 1 ||
+	    OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_E, e) != 1 ||
+	    (params = OSSL_PARAM_BLD_to_param(bld)) == NULL) {
+		fido_log_debug("%s: OSSL_PARAM_BLD", __func__);
+		goto fail;
+	}
+
+	if ((pctx = import_ctx_get()) == NULL ||
+	    EVP_PKEY_fromdata(pctx, &pkey, EVP_PKEY_PUBLIC_KEY, params) != 1) {
+		fido_log_debug("%s: EVP_PKEY_fromdata", __func__);
+		goto fail;
+	}
+
+	if (EVP_PKEY_get_bits(pkey) != 2048) {
+		fido_log_debug("%s: invalid key length", __func__);
+		goto fail;
+	}
+
+	ok = 0;
+fail:
+	if (pctx != NULL)
+		import_ctx_put(pctx);
+	OSSL_PARAM_free(params);
+	OSSL_PARAM_BLD_free(bld);
+	BN_free(n);
+	BN_free(e);
+	if (ok < 0 && pkey != NULL) {
+		EVP_PKEY_free(pkey);
+		pkey = NULL;
+	}
+
+	return (pkey);
+}
+#else
 EVP_PKEY *
 rs256_pk_to_EVP_PKEY(const rs256_pk_t *k)
 {
@@ -173,6 +272,7 @@ fail:
 
 	return (pkey);
 }
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000 */
 
 int
 rs256_pk_from_RSA(rs256_pk_t *pk, const RSA *rsa)
@@ -221,13 +321,11 @@ rs256_pk_from_EVP_PKEY(rs256_pk_t *pk, const EVP_PKEY *pkey)
 	return (rs256_pk_from_RSA(pk, rsa));
 }
 
-int
-rs256_verify_sig(const fido_blob_t *dgst, EVP_PKEY *pkey,
-    const fido_blob_t *sig)
+EVP_PKEY_CTX *
+rs256_verify_ctx_new(EVP_PKEY *pkey)
 {
 	EVP_PKEY_CTX	*pctx = NULL;
 	EVP_MD		*md = NULL;
-	int		 ok = -1;
 
 	if (EVP_PKEY_base_id(pkey) != EVP_PKEY_RSA) {
 		fido_log_debug("%s: EVP_PKEY_base_id", __func__);
@@ -247,6 +345,25 @@ rs256_verify_sig(const fido_blob_t *dgst, EVP_PKEY *pkey,
 		goto fail;
 	}
 
+	return (pctx);
+fail:
+	EVP_PKEY_CTX_free(pctx);
+
+	return (NULL);
+}
+
+int
+rs256_verify_sig(const fido_blob_t *dgst, EVP_PKEY *pkey,
+    const fido_blob_t *sig)
+{
+	EVP_PKEY_CTX	*pctx = NULL;
+	int		 ok = -1;
+
+	if ((pctx = rs256_verify_ctx_new(pkey)) == NULL) {
+		fido_log_debug("%s: rs256_verify_ctx_new", __func__);
+		goto fail;
+	}
+
 	if (EVP_PKEY_verify(pctx, sig->ptr, sig->len, dgst->ptr,
 	    dgst->len) != 1) {
 		fido_log_debug("%s: EVP_PKEY_verify", __func__);
@@ -260,22 +377,97 @@ fail:
 	return (ok);
 }
 
+/*
+ * Verification contexts of the keys most recently used in the executing
+ * thread. Keeping the key alive also keeps the Montgomery context OpenSSL
+ * computes for the modulus on first use.
+ */
+static TLS struct pk_cache {
+	rs256_pk_t	 pk;
+	EVP_PKEY	*pkey;
+	EVP_PKEY_CTX	*pctx;
+	uint64_t	 used;
+} pk_cache[PK_CACHE_LEN];
+static TLS uint64_t pk_tick;
+
+/* returns a context owned by the cache */
+static EVP_PKEY_CTX *
+pk_cache_get(const rs256_pk_t *k)
+{
+#ifndef FIDO_FUZZ
+	struct pk_cache *e;
+
+	for (size_t i = 0; i < PK_CACHE_LEN; i++) {
+		e = &pk_cache[i];
+		if (e->pctx != NULL && memcmp(&e->pk, k, sizeof(*k)) == 0) {
+			e->used = ++pk_tick;
+			return (e->pctx);
+		}
+	}
+#else
+	(void)k;
+#endif
+	return (NULL);
+}
+
+/* takes ownership of pkey and pctx on success */
+static int
+pk_cache_put(const rs256_pk_t *k, EVP_PKEY *pkey, EVP_PKEY_CTX *pctx)
+{
+#ifndef FIDO_FUZZ
+	struct pk_cache *e = &pk_cache[0];
+
+	for (size_t i = 1; i < PK_CACHE_LEN; i++)
+		if (pk_cache[i].used < e->used)
+			e = &pk_cache[i];
+
+	EVP_PKEY_CTX_free(e->pctx);
+	EVP_PKEY_free(e->pkey);
+	memcpy(&e->pk, k, sizeof(e->pk));
+	e->pkey = pkey;
+	e->pctx = pctx;
+	e->used = ++pk_tick;
+
+	return (0);
+#else
+	(void)k;
+	(void)pkey;
+	(void)pctx;
+
+	return (-1);
+#endif
+}
+
 int
 rs256_pk_verify_sig(const fido_blob_t *dgst, const rs256_pk_t *pk,
     const fido_blob_t *sig)
 {
-	EVP_PKEY	*pkey;
+	EVP_PKEY	*pkey = NULL;
+	EVP_PKEY_CTX	*pctx = NULL;
+	bool		 cached = false;
 	int		 ok = -1;
 
-	if ((pkey = rs256_pk_to_EVP_PKEY(pk)) == NULL ||
-	    rs256_verify_sig(dgst, pkey, sig) < 0) {
-		fido_log_debug("%s: rs256_verify_sig", __func__);
+	if ((pctx = pk_cache_get(pk)) != NULL)
+		cached = true;
+	else if ((pkey = rs256_pk_to_EVP_PKEY(pk)) == NULL ||
+	    (pctx = rs256_verify_ctx_new(pkey)) == NULL) {
+		fido_log_debug("%s: rs256_verify_ctx_new", __func__);
+		goto fail;
+	} else if (pk_cache_put(pk, pkey, pctx) == 0)
+		cached = true;
+
+	if (EVP_PKEY_verify(pctx, sig->ptr, sig->len, dgst->ptr,
+	    dgst->len) != 1) {
+		fido_log_debug("%s: EVP_PKEY_verify", __func__);
 		goto fail;
 	}
 
 	ok = 0;
 fail:
-	EVP_PKEY_free(pkey);
+	if (!cached) {
+		EVP_PKEY_CTX_free(pctx);
+		EVP_PKEY_free(pkey);
+	}
 
 	return (ok);
 }
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "fido.h"
+
+/*
+ * A pool of locked, zeroed buffers for secrets: PINs and their hashes,
+ * shared secrets, PIN/UV auth tokens, hmac-secret outputs and largeBlob
+ * keys. The pool is mapped and locked once, by fido_set_secure_pool(),
+ * and split into slots of a few size classes. A slot is claimed with an
+ * atomic exchange, so threads may allocate concurrently, and is cleared
+ * when returned. A request takes the smallest free slot that holds it;
+ * requests that no free slot holds are served by fido_calloc().
+ */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define slot_claim(p)	(_InterlockedExchange8((volatile char *)(p), 1) == 0)
+#define slot_release(p)	_InterlockedExchange8((volatile char *)(p), 0)
+#else
+#define slot_claim(p)	(__atomic_exchange_n((p), 1, __ATOMIC_ACQUIRE) == 0)
+#define slot_release(p)	__atomic_store_n((p), 0, __ATOMIC_RELEASE)
+#endif
+
+static const size_t secmem_class[] = { 32, 64, FIDO_MAXMSG };
+
+static struct secmem {
+	unsigned char	*base;
+	size_t		 len;    /* mapped length */
+	size_t		 nslots; /* per size class */
+	char		*used;   /* nitems(secmem_class) * nslots flags */
+} secmem;
+
+static void *
+secmem_map(size_t len)
+{
+#ifdef _WIN32
+	void *p;
+
+	if ((p = VirtualAlloc(NULL, len, MEM_COMMIT | MEM_RESERVE,
+	    PAGE_READWRITE)) == NULL) {
+		fido_log_debug("%s: VirtualAlloc", __func__);
+		return (NULL);
+	}
+	if (VirtualLock(p, len) == 0) {
+		fido_log_debug("%s: VirtualLock", __func__);
+		VirtualFree(p, 0, MEM_RELEASE);
+		return (NULL);
+	}
+
+	return (p);
+#else
+	void *p;
+
+	if ((p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE |
+	    MAP_ANON, -1, 0)) == MAP_FAILED) {
+		fido_log_error(errno, "%s: mmap", __func__);
+		return (NULL);
+	}
+	if (mlock(p, len) != 0) {
+		fido_log_error(errno, "%s: mlock", __func__);
+		munmap(p, len);
+		return (NULL);
+	}
+#ifdef MADV_DONTDUMP
+	(void)madvise(p, len, MADV_DONTDUMP);
+#endif
+
+	return (p);
+#endif /* _WIN32 */
+}
+
+static void
+secmem_unmap(void *p, size_t len)
+{
+	explicit_bzero(p, len);
+#ifdef _WIN32
+	VirtualUnlock(p, len);
+	VirtualFree(p, 0, MEM_RELEASE);
+#else
+	munlock(p, len);
+	munmap(p, len);
+#endif
+}
+
+/* the size class and slot of 'ptr'; -1 if not in the pool */
+static int
+secmem_slot(const void *ptr, size_t *class, size_t *slot)
+{
+	const unsigned char	*p = ptr;
+	size_t			 off;
+
+	if (secmem.base == NULL || p < secmem.base ||
+	    p >= secmem.base + secmem.len)
+		return (-1);
+
+	off = (size_t)(p - secmem.base);
+	for (size_t i = 0; i < nitems(secmem_class); i++) {
+		const size_t n = secmem.nslots * secmem_class[i];
+		if (off < n) {
+			if (off % secmem_class[i] != 0)
+				return (-1);
+			*class = i;
+			*slot = off / secmem_class[i];
+			return (0);
+		}
+		off -= n;
+	}
+
+	return (-1); /* page padding */
+}
+
+int
+fido_set_secure_pool(size_t n)
+{
+	size_t	len = 0, pagesz;
+	char	*used = NULL;
+	void	*base;
+
+	if (secmem.base != NULL) {
+		len = nitems(secmem_class) * secmem.nslots;
+		for (size_t i = 0; i < len; i++)
+			if (secmem.used[i]) {
+				fido_log_debug("%s: pool in use", __func__);
+				return (FIDO_ERR_INTERNAL);
+			}
+		secmem_unmap(secmem.base, secmem.len);
+		fido_free(secmem.used);
+		memset(&secmem, 0, sizeof(secmem));
+		len = 0;
+	}
+	if (n == 0)
+		return (FIDO_OK);
+
+	for (size_t i = 0; i < nitems(secmem_class); i++) {
+		if (n > (SIZE_MAX - len) / secmem_class[i])
+			return (FIDO_ERR_INVALID_ARGUMENT);
+		len += n * secmem_class[i];
+	}
+#ifdef _WIN32
+	{
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		pagesz = si.dwPageSize;
+	}
+#else
+	pagesz = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	if (len > SIZE_MAX - pagesz)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	len = (len + pagesz - 1) / pagesz * pagesz;
+
+	if ((used = fido_calloc(nitems(secmem_class), n)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+	if ((base = secmem_map(len)) == NULL) {
+		fido_free(used);
+		return (FIDO_ERR_INTERNAL);
+	}
+
+	secmem.base = base;
+	secmem.len = len;
+	secmem.nslots = n;
+	secmem.used = used;
+
+	return (FIDO_OK);
+}
+
+/* zeroed memory for 'len' bytes of secrets; freed with fido_freezero() */
+void *
+fido_secure_alloc(size_t len)
+{
+	unsigned char *p;
+
+	if (secmem.base == NULL || len == 0)
+		return (fido_calloc(1, len));
+
+	p = secmem.base;
+	for (size_t i = 0; i < nitems(secmem_class); i++) {
+		if (len <= secmem_class[i]) {
+			char *used = &secmem.used[i * secmem.nslots];
+			for (size_t j = 0; j < secmem.nslots; j++)
+				if (slot_claim(&used[j]))
+					return (p + j * secmem_class[i]);
+		}
+		p += secmem.nslots * secmem_class[i];
+	}
+
+	return (fido_calloc(1, len));
+}
+
+/* the size of the pool slot holding 'ptr'; 0 if not pooled */
+size_t
+fido_secure_size(const void *ptr)
+{
+	size_t class, slot;
+
+	if (secmem_slot(ptr, &class, &slot) < 0)
+		return (0);
+
+	return (secmem_class[class]);
+}
+
+/* clear and return 'ptr' to the pool; -1 if not pooled */
+int
+fido_secure_free(void *ptr)
+{
+	size_t class, slot;
+
+	if (secmem_slot(ptr, &class, &slot) < 0)
+		return (-1);
+
+	explicit_bzero(ptr, secmem_class[class]);
+	slot_release(&secmem.used[class * secmem.nslots + slot]);
+
+	return (0);
+}
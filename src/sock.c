@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef USE_BROKER
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "fido.h"
+
+/*
+ * Stream sockets shared by the broker and remote devices. An endpoint
+ * is either the path of a unix socket, or "host:port" for TCP, with
+ * IPv6 addresses in brackets. Anything containing a slash or no colon
+ * is a path.
+ */
+
+#ifdef USE_BROKER
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL	0
+#endif
+
+#define SOCK_BACKLOG	16
+
+bool
+fido_sock_is_unix(const char *endpoint)
+{
+	return (strchr(endpoint, '/') != NULL ||
+	    strrchr(endpoint, ':') == NULL);
+}
+
+static int
+sock_unaddr(struct sockaddr_un *sun, const char *path)
+{
+	memset(sun, 0, sizeof(*sun));
+	sun->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sun->sun_path)) {
+		fido_log_debug("%s: path too long", __func__);
+		return (-1);
+	}
+	memcpy(sun->sun_path, path, strlen(path));
+
+	return (0);
+}
+
+/* split "host:port" or "[addr]:port" and resolve it */
+static struct addrinfo *
+sock_inaddr(const char *endpoint, bool passive)
+{
+	struct addrinfo	 hints, *ai = NULL;
+	char		*host, *port;
+	size_t		 len;
+	int		 r;
+
+	if ((host = fido_strdup(endpoint)) == NULL)
+		return (NULL);
+	port = strrchr(host, ':');
+	*port++ = '\0';
+	if (host[0] == '[' && (len = strlen(host)) > 1 &&
+	    host[len - 1] == ']') {
+		host[len - 1] = '\0';
+		memmove(host, host + 1, len - 1);
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = passive ? AI_PASSIVE : 0;
+	if ((r = getaddrinfo(*host != '\0' ? host : NULL, port, &hints,
+	    &ai)) != 0) {
+		fido_log_debug("%s: getaddrinfo: %s", __func__,
+		    gai_strerror(r));
+		ai = NULL;
+	}
+	fido_free(host);
+
+	return (ai);
+}
+
+void
+fido_sock_close(int fd)
+{
+	if (close(fd) != 0)
+		fido_log_error(errno, "%s: close", __func__);
+}
+
+void
+fido_sock_nosigpipe(int fd)
+{
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on)) != 0)
+		fido_log_error(errno, "%s: setsockopt", __func__);
+#else
+	(void)fd;
+#endif
+}
+
+/* small messages go out as they are written */
+static void
+sock_nodelay(int fd)
+{
+	int on = 1;
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) != 0)
+		fido_log_error(errno, "%s: setsockopt", __func__);
+}
+
+static int
+sock_listen_unix(const char *path)
+{
+	struct sockaddr_un	sun;
+	int			fd;
+
+	if (sock_unaddr(&sun, path) < 0)
+		return (-1);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		fido_log_error(errno, "%s: socket", __func__);
+		return (-1);
+	}
+	if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) != 0 ||
+	    listen(fd, SOCK_BACKLOG) != 0) {
+		fido_log_error(errno, "%s: bind", __func__);
+		fido_sock_close(fd);
+		return (-1);
+	}
+
+	return (fd);
+}
+
+static int
+sock_listen_tcp(const char *endpoint)
+{
+	struct addrinfo	*ai;
+	int		 fd = -1, on = 1;
+
+	if ((ai = sock_inaddr(endpoint, true)) == NULL)
+		return (-1);
+	if ((fd = socket(ai->ai_family, ai->ai_socktype,
+	    ai->ai_protocol)) < 0) {
+		fido_log_error(errno, "%s: socket", __func__);
+		goto fail;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+	    bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 ||
+	    listen(fd, SOCK_BACKLOG) != 0) {
+		fido_log_error(errno, "%s: bind", __func__);
+		fido_sock_close(fd);
+		fd = -1;
+	}
+fail:
+	freeaddrinfo(ai);
+
+	return (fd);
+}
+
+int
+fido_sock_listen(const char *endpoint)
+{
+	if (fido_sock_is_unix(endpoint))
+		return (sock_listen_unix(endpoint));
+
+	return (sock_listen_tcp(endpoint));
+}
+
+int
+fido_sock_accept(int sock)
+{
+	struct sockaddr_storage	ss;
+	socklen_t		len = sizeof(ss);
+	int			fd;
+
+	memset(&ss, 0, sizeof(ss));
+	if ((fd = accept(sock, (struct sockaddr *)&ss, &len)) < 0) {
+		fido_log_error(errno, "%s: accept", __func__);
+		return (-1);
+	}
+	fido_sock_nosigpipe(fd);
+	if (ss.ss_family != AF_UNIX)
+		sock_nodelay(fd);
+
+	return (fd);
+}
+
+/* a connected pair of unix sockets, for use within the process */
+int
+fido_sock_pair(int fd[2])
+{
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) != 0) {
+		fido_log_error(errno, "%s: socketpair", __func__);
+		return (-1);
+	}
+	fido_sock_nosigpipe(fd[0]);
+	fido_sock_nosigpipe(fd[1]);
+
+	return (0);
+}
+
+/* the first address of 'endpoint' that takes the connection */
+int
+fido_sock_connect(const char *endpoint)
+{
+	struct sockaddr_un	 sun;
+	struct addrinfo		*ai, *p;
+	int			 fd = -1;
+
+	if (fido_sock_is_unix(endpoint)) {
+		if (sock_unaddr(&sun, endpoint) < 0)
+			return (-1);
+		if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+			fido_log_error(errno, "%s: socket", __func__);
+			return (-1);
+		}
+		if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) != 0) {
+			fido_log_error(errno, "%s: connect", __func__);
+			fido_sock_close(fd);
+			return (-1);
+		}
+		fido_sock_nosigpipe(fd);
+		return (fd);
+	}
+
+	if ((ai = sock_inaddr(endpoint, false)) == NULL)
+		return (-1);
+	for (p = ai; p != NULL; p = p->ai_next) {
+		if ((fd = socket(p->ai_family, p->ai_socktype,
+		    p->ai_protocol)) < 0)
+			continue;
+		if (connect(fd, p->ai_addr, p->ai_addrlen) == 0)
+			break;
+		fido_log_error(errno, "%s: connect", __func__);
+		fido_sock_close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(ai);
+	if (fd != -1) {
+		fido_sock_nosigpipe(fd);
+		sock_nodelay(fd);
+	}
+
+	return (fd);
+}
+
+int
+fido_sock_send(int fd, const unsigned char *ptr, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = send(fd, ptr, len, MSG_NOSIGNAL)) < 0) {
+			if (errno == EINTR)
+				continue;
+			fido_log_error(errno, "%s: send", __func__);
+			return (-1);
+		}
+		ptr += n;
+		len -= (size_t)n;
+	}
+
+	return (0);
+}
+
+int
+fido_sock_recv(int fd, unsigned char *ptr, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = recv(fd, ptr, len, MSG_WAITALL)) <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+				fido_log_error(errno, "%s: recv", __func__);
+			return (-1);
+		}
+		ptr += n;
+		len -= (size_t)n;
+	}
+
+	return (0);
+}
+
+/* up to 'len' bytes waiting on 'fd', left there; 0 if the peer is gone */
+int
+fido_sock_peek(int fd, unsigned char *ptr, size_t len)
+{
+	ssize_t n;
+
+	if (len > INT_MAX)
+		return (-1);
+	while ((n = recv(fd, ptr, len, MSG_PEEK | MSG_DONTWAIT)) < 0 &&
+	    errno == EINTR)
+		continue;
+	if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+		fido_log_error(errno, "%s: recv", __func__);
+		return (0);
+	}
+
+	return (n < 0 ? -1 : (int)n);
+}
+
+/* bound the time fido_sock_recv() waits for the rest of a record */
+int
+fido_sock_set_timeout(int fd, int ms)
+{
+	struct timeval tv;
+
+	memset(&tv, 0, sizeof(tv));
+	tv.tv_sec = ms / 1000;
+	tv.tv_usec = (ms % 1000) * 1000;
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0) {
+		fido_log_error(errno, "%s: setsockopt", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/* wait up to 'ms' milliseconds for 'fd' to be readable */
+int
+fido_sock_poll(int fd, int ms)
+{
+	struct pollfd	pfd;
+	int		r;
+
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	while ((r = poll(&pfd, 1, ms)) < 0 && errno == EINTR)
+		continue;
+	if (r < 1) {
+		if (r < 0)
+			fido_log_error(errno, "%s: poll", __func__);
+		return (-1);
+	}
+
+	return (0);
+}
+
+#endif /* USE_BROKER */
@@ -5,9 +5,31 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #include <errno.h>
+
 #include "fido.h"
 
+#ifndef TLS
+#define TLS
+#endif
+
+/* the calling thread's deadline, as set by fido_set_deadline() */
+static TLS bool deadline_set;
+static TLS struct timespec deadline_ts;
+
+#if defined(_MSC_VER)
+static int
+usleep(unsigned int usec)
+{
+	Sleep(usec / 1000);
+
+	return (0);
+}
+#endif
+
 static int
 timespec_to_ms(const struct timespec *ts)
 {
@@ -73,3 +95,154 @@ fido_time_delta(const struct timespec *ts_start, int *ms_remain)
 
 	return 0;
 }
+
+/*
+ * A timeout is turned into an absolute monotonic deadline once per
+ * request. The time left is derived from the deadline when about to
+ * block, and when reporting back to the caller; it is neither tracked
+ * per frame nor subject to accumulated rounding.
+ */
+int
+fido_time_deadline(fido_deadline_t *dl, int ms, struct timespec *ts_now)
+{
+	struct timespec ts, ts_ms;
+
+	memset(dl, 0, sizeof(*dl));
+	dl->ms = ms < 0 ? -1 : ms;
+	dl->fresh = true;
+
+	if (ms < 0 && ts_now == NULL)
+		return 0;
+	if (fido_time_now(&ts) != 0)
+		return -1;
+	if (ts_now != NULL)
+		*ts_now = ts;
+	if (ms >= 0) {
+		ts_ms.tv_sec = ms / 1000;
+		ts_ms.tv_nsec = (ms % 1000) * 1000000L;
+		timespecadd(&ts, &ts_ms, &dl->ts);
+	}
+
+	return 0;
+}
+
+static int
+deadline_update(fido_deadline_t *dl, bool roundup)
+{
+	struct timespec ts_now, ts_delta;
+	int64_t ms;
+
+	if (fido_time_now(&ts_now) != 0)
+		return -1;
+	if (!timespeccmp(&ts_now, &dl->ts, <)) {
+		dl->ms = 0;
+		return 0;
+	}
+
+	timespecsub(&dl->ts, &ts_now, &ts_delta);
+	ms = (int64_t)ts_delta.tv_sec * 1000LL + ts_delta.tv_nsec / 1000000L;
+	if (roundup && ts_delta.tv_nsec % 1000000L != 0)
+		ms++;
+
+	dl->ms = ms > INT_MAX ? INT_MAX : (int)ms;
+
+	return 0;
+}
+
+/* time to block for; -1 if unbounded */
+int
+fido_time_wait(fido_deadline_t *dl, int *ms)
+{
+	if (dl->ms > 0 && !dl->fresh && deadline_update(dl, true) != 0)
+		return -1;
+
+	dl->fresh = false;
+	*ms = dl->ms;
+
+	return 0;
+}
+
+/* time left, rounded down, as reported to the caller */
+int
+fido_time_remain(fido_deadline_t *dl, int *ms_remain)
+{
+	if (dl->ms > 0 && deadline_update(dl, false) != 0)
+		return -1;
+
+	dl->fresh = false;
+	*ms_remain = dl->ms;
+
+	return 0;
+}
+
+int
+fido_set_deadline(int ms)
+{
+	struct timespec ts, ts_ms;
+
+	if (ms < -1)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+	if (ms == -1) {
+		deadline_set = false;
+		return (FIDO_OK);
+	}
+	if (fido_time_now(&ts) != 0)
+		return (FIDO_ERR_INTERNAL);
+
+	ts_ms.tv_sec = ms / 1000;
+	ts_ms.tv_nsec = (ms % 1000) * 1000000L;
+	timespecadd(&ts, &ts_ms, &deadline_ts);
+	deadline_set = true;
+
+	return (FIDO_OK);
+}
+
+/*
+ * The timeout for a request: 'ms', the device's timeout, bounded by the
+ * time left until the calling thread's deadline, if any.
+ */
+int
+fido_time_budget(int ms)
+{
+	struct timespec ts_now, ts_delta;
+	int64_t left;
+
+	if (!deadline_set)
+		return (ms);
+	if (fido_time_now(&ts_now) != 0)
+		return (0);
+	if (!timespeccmp(&ts_now, &deadline_ts, <))
+		return (0);
+
+	timespecsub(&deadline_ts, &ts_now, &ts_delta);
+	left = (int64_t)ts_delta.tv_sec * 1000LL +
+	    ts_delta.tv_nsec / 1000000L;
+	if (left > INT_MAX)
+		left = INT_MAX;
+	if (ms < 0 || left < ms)
+		return ((int)left);
+
+	return (ms);
+}
+
+int
+fido_time_sleep(unsigned int ms, int *ms_remain)
+{
+	if (*ms_remain > -1 && (unsigned int)*ms_remain < ms)
+		ms = (unsigned int)*ms_remain;
+
+	if (ms > UINT_MAX / 1000) {
+		fido_log_debug("%s: ms=%u", __func__, ms);
+		return (-1);
+	}
+
+	if (usleep(ms * 1000) < 0) {
+		fido_log_error(errno, "%s: usleep", __func__);
+		return (-1);
+	}
+
+	if (*ms_remain > -1)
+		*ms_remain -= (int)ms;
+
+	return (0);
+}
@@ -8,6 +8,8 @@
 #include <openssl/sha.h>
 #include "fido.h"
 
+#define TOUCH_PACE_MS	200
+
 int
 fido_dev_get_touch_begin(fido_dev_t *dev)
 {
@@ -18,7 +20,7 @@ fido_dev_get_touch_begin(fido_dev_t *dev)
 	unsigned char	 cdh[SHA256_DIGEST_LENGTH];
 	fido_rp_t	 rp;
 	fido_user_t	 user;
-	int		 ms = dev->timeout_ms;
+	int		 ms = fido_time_budget(dev->timeout_ms);
 	int		 r = FIDO_ERR_INTERNAL;
 
 	memset(&f, 0, sizeof(f));
@@ -27,16 +29,27 @@ fido_dev_get_touch_begin(fido_dev_t *dev)
 	memset(&rp, 0, sizeof(rp));
 	memset(&user, 0, sizeof(user));
 
+	if ((r = fido_dev_get_deferred_info(dev, &ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_deferred_info", __func__);
+		return (r);
+	}
+
+	r = FIDO_ERR_INTERNAL;
+
 	if (fido_dev_is_fido2(dev) == false)
+#ifdef FIDO_NO_U2F
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+#else
 		return (u2f_get_touch_begin(dev, &ms));
+#endif
 
-	if (SHA256((const void *)clientdata, strlen(clientdata), cdh) != cdh) {
+	if (fido_sha256_buf(clientdata, strlen(clientdata), cdh) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		return (FIDO_ERR_INTERNAL);
 	}
 
-	if ((rp.id = strdup(FIDO_DUMMY_RP_ID)) == NULL ||
-	    (user.name = strdup(FIDO_DUMMY_USER_NAME)) == NULL) {
+	if ((rp.id = fido_strdup(FIDO_DUMMY_RP_ID)) == NULL ||
+	    (user.name = fido_strdup(FIDO_DUMMY_USER_NAME)) == NULL) {
 		fido_log_debug("%s: strdup", __func__);
 		goto fail;
 	}
@@ -72,10 +85,10 @@ fido_dev_get_touch_begin(fido_dev_t *dev)
 	r = FIDO_OK;
 fail:
 	cbor_vector_free(argv, nitems(argv));
-	free(f.ptr);
-	free(rp.id);
-	free(user.name);
-	free(user.id.ptr);
+	fido_free(f.ptr);
+	fido_free(rp.id);
+	fido_free(user.name);
+	fido_free(user.id.ptr);
 
 	return (r);
 }
@@ -88,7 +101,11 @@ fido_dev_get_touch_status(fido_dev_t *dev, int *touched, int ms)
 	*touched = 0;
 
 	if (fido_dev_is_fido2(dev) == false)
+#ifdef FIDO_NO_U2F
+		return (FIDO_ERR_UNSUPPORTED_OPTION);
+#else
 		return (u2f_get_touch_status(dev, touched, &ms));
+#endif
 
 	switch ((r = fido_rx_cbor_status(dev, &ms))) {
 	case FIDO_ERR_PIN_AUTH_INVALID:
@@ -107,3 +124,223 @@ fido_dev_get_touch_status(fido_dev_t *dev, int *touched, int ms)
 
 	return (FIDO_OK);
 }
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+static int
+touch_any_poll(fido_dev_t **devtab, const bool *live, bool *ready,
+    size_t ndevs, int ms)
+{
+	int	*fd;
+	int	 r = -1;
+
+	if ((fd = fido_calloc(ndevs, sizeof(*fd))) == NULL)
+		return (-1);
+
+	for (size_t i = 0; i < ndevs; i++) {
+		fd[i] = -1;
+		if (live[i] == false)
+			continue;
+		/* u2f status polls transmit; fido2 status polls only read */
+		if (fido_dev_is_fido2(devtab[i]) == false ||
+		    devtab[i]->transport.rx != NULL ||
+		    (fd[i] = fido_dev_get_pollfd(devtab[i])) < 0)
+			goto out;
+		if (fido_rx_buffered(devtab[i]))
+			ms = 0; /* frames its descriptor would not signal */
+	}
+
+	if (fido_hid_unix_wait_many(fd, ready, ndevs, ms) < 0) {
+		fido_log_debug("%s: fido_hid_unix_wait_many", __func__);
+		goto out;
+	}
+
+	for (size_t i = 0; i < ndevs; i++)
+		if (fd[i] >= 0 && fido_rx_buffered(devtab[i]))
+			ready[i] = true;
+
+	r = 0;
+out:
+	fido_free(fd);
+
+	return (r);
+}
+#elif defined(_WIN32) && !defined(USE_HIDAPI)
+static int
+touch_any_poll(fido_dev_t **devtab, const bool *live, bool *ready,
+    size_t ndevs, int ms)
+{
+	HANDLE	ev[MAXIMUM_WAIT_OBJECTS];
+	size_t	pos[MAXIMUM_WAIT_OBJECTS];
+	DWORD	n = 0;
+	DWORD	r;
+
+	for (size_t i = 0; i < ndevs; i++) {
+		ready[i] = false;
+		if (live[i] == false)
+			continue;
+		/* as above; the event is that of the next pending read */
+		if (n == MAXIMUM_WAIT_OBJECTS ||
+		    fido_dev_is_fido2(devtab[i]) == false ||
+		    devtab[i]->transport.rx != NULL ||
+		    devtab[i]->io.read != fido_hid_read ||
+		    (ev[n] = fido_hid_win_event(devtab[i]->io_handle)) == NULL)
+			return (-1);
+		pos[n++] = i;
+	}
+	if (n == 0)
+		return (-1);
+
+	if ((r = WaitForMultipleObjects(n, ev, FALSE, ms > -1 ? (DWORD)ms :
+	    INFINITE)) == WAIT_FAILED) {
+		fido_log_debug("%s: WaitForMultipleObjects: 0x%lx", __func__,
+		    (u_long)GetLastError());
+		return (-1);
+	}
+	if (r == WAIT_TIMEOUT)
+		return (0);
+
+	for (DWORD k = 0; k < n; k++)
+		ready[pos[k]] = WaitForSingleObject(ev[k], 0) == WAIT_OBJECT_0;
+
+	return (0);
+}
+#else
+static int
+touch_any_poll(fido_dev_t **devtab, const bool *live, bool *ready,
+    size_t ndevs, int ms)
+{
+	(void)devtab;
+	(void)live;
+	(void)ready;
+	(void)ndevs;
+	(void)ms;
+
+	return (-1);
+}
+#endif
+
+static int
+touch_any_status(fido_dev_t *dev, bool *live, size_t *nlive, int *touched,
+    int ms)
+{
+	int r;
+
+	if ((r = fido_dev_get_touch_status(dev, touched, ms)) != FIDO_OK) {
+		fido_log_debug("%s: fido_dev_get_touch_status", __func__);
+		fido_dev_cancel(dev);
+		*live = false;
+		(*nlive)--;
+	}
+
+	return (r);
+}
+
+int
+fido_dev_get_touch_any(fido_dev_t **devtab, size_t ndevs, size_t *idx, int ms)
+{
+	struct timespec	 ts_start;
+	bool		*live = NULL;
+	bool		*ready = NULL;
+	size_t		 nlive = 0;
+	int		 ms_remain;
+	int		 slice;
+	int		 touched;
+	int		 r = FIDO_ERR_INVALID_ARGUMENT;
+
+	if (devtab == NULL || idx == NULL || ndevs == 0)
+		return (FIDO_ERR_INVALID_ARGUMENT);
+
+	*idx = 0;
+
+	if ((live = fido_calloc(ndevs, sizeof(*live))) == NULL ||
+	    (ready = fido_calloc(ndevs, sizeof(*ready))) == NULL) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
+	for (size_t i = 0; i < ndevs; i++) {
+		if (devtab[i] == NULL)
+			continue;
+		if ((r = fido_dev_get_touch_begin(devtab[i])) != FIDO_OK) {
+			fido_log_debug("%s: fido_dev_get_touch_begin %zu",
+			    __func__, i);
+			continue;
+		}
+		live[i] = true;
+		nlive++;
+	}
+
+	if (fido_time_now(&ts_start) != 0) {
+		r = FIDO_ERR_INTERNAL;
+		goto fail;
+	}
+
+	while (nlive > 0) {
+		ms_remain = ms;
+		if (fido_time_delta(&ts_start, &ms_remain) != 0) {
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+		if (ms_remain == 0) {
+			r = FIDO_ERR_TIMEOUT;
+			goto fail;
+		}
+		if (touch_any_poll(devtab, live, ready, ndevs,
+		    ms_remain) == 0) {
+			/* one wakeup, however many devices are waiting */
+			for (size_t i = 0; i < ndevs; i++) {
+				if (live[i] == false || ready[i] == false)
+					continue;
+				if ((r = touch_any_status(devtab[i], &live[i],
+				    &nlive, &touched, 0)) == FIDO_OK &&
+				    touched) {
+					*idx = i;
+					goto touched;
+				}
+			}
+			continue;
+		}
+		/* round robin, paced to keep u2f devices under 5Hz */
+		slice = TOUCH_PACE_MS / (int)nlive;
+		if (ms_remain > -1 && ms_remain < TOUCH_PACE_MS)
+			slice = ms_remain / (int)nlive;
+		if (slice < 1)
+			slice = 1;
+		for (size_t i = 0; i < ndevs; i++) {
+			if (live[i] == false)
+				continue;
+			if (fido_dev_is_fido2(devtab[i]) == false &&
+			    fido_time_sleep((unsigned int)slice,
+			    &ms_remain) != 0) {
+				r = FIDO_ERR_INTERNAL;
+				goto fail;
+			}
+			if ((r = touch_any_status(devtab[i], &live[i], &nlive,
+			    &touched, slice)) == FIDO_OK && touched) {
+				*idx = i;
+				goto touched;
+			}
+		}
+	}
+
+	fido_log_debug("%s: no device left", __func__);
+	goto fail;
+touched:
+	for (size_t i = 0; i < ndevs; i++)
+		if (live[i] && i != *idx)
+			fido_dev_cancel(devtab[i]);
+
+	fido_free(live);
+	fido_free(ready);
+
+	return (FIDO_OK);
+fail:
+	for (size_t i = 0; live != NULL && i < ndevs; i++)
+		if (live[i])
+			fido_dev_cancel(devtab[i]);
+
+	fido_free(live);
+	fido_free(ready);
+
+	return (r);
+}
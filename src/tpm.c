@@ -12,7 +12,6 @@
 
 #include <openssl/sha.h>
 
-#include "packed.h"
 #include "fido.h"
 
 /* Part 1, 4.89: TPM_GENERATED_VALUE */
@@ -38,307 +37,233 @@
 #define TPMA_SENSITIVE	0x00000020	/* data originates within tpm */
 #define TPMA_SIGN	0x00040000	/* object may sign */
 
-/* Part 2, 10.4.2: TPM2B_DIGEST */
-PACKED_TYPE(tpm_sha256_digest_t,
-struct tpm_sha256_digest {
-	uint16_t size; /* sizeof(body) */
-	uint8_t  body[32];
-})
-
-/* Part 2, 10.4.3: TPM2B_DATA */
-PACKED_TYPE(tpm_sha1_data_t,
-struct tpm_sha1_data {
-	uint16_t size; /* sizeof(body) */
-	uint8_t  body[20];
-})
-
-/* Part 2, 10.5.3: TPM2B_NAME */
-PACKED_TYPE(tpm_sha256_name_t,
-struct tpm_sha256_name {
-	uint16_t size; /* sizeof(alg) + sizeof(body) */
-	uint16_t alg;  /* TPM_ALG_SHA256 */
-	uint8_t  body[32];
-})
-
-/* Part 2, 10.11.1: TPMS_CLOCK_INFO */
-PACKED_TYPE(tpm_clock_info_t,
-struct tpm_clock_info {
-	uint64_t timestamp_ms;
-	uint32_t reset_count;   /* obfuscated by tpm */
-	uint32_t restart_count; /* obfuscated by tpm */
-	uint8_t  safe;          /* 1 if timestamp_ms is current */
-})
-
-/* Part 2, 10.12.8 TPMS_ATTEST */
-PACKED_TYPE(tpm_sha1_attest_t,
-struct tpm_sha1_attest {
-	uint32_t          magic;     /* TPM_MAGIC */
-	uint16_t          type;      /* TPM_ST_ATTEST_CERTIFY */
-	tpm_sha256_name_t signer;    /* full tpm path of signing key */
-	tpm_sha1_data_t   data;      /* signed sha1 */
-	tpm_clock_info_t  clock;
-	uint64_t          fwversion; /* obfuscated by tpm */
-	tpm_sha256_name_t name;      /* sha256 of tpm_rs256_pubarea_t */
-	tpm_sha256_name_t qual_name; /* full tpm path of attested key */
-})
-
-/* Part 2, 11.2.4.5: TPM2B_PUBLIC_KEY_RSA */
-PACKED_TYPE(tpm_rs256_key_t,
-struct tpm_rs256_key {
-	uint16_t size; /* sizeof(body) */
-	uint8_t  body[256];
-})
-
-/* Part 2, 11.2.5.1: TPM2B_ECC_PARAMETER */
-PACKED_TYPE(tpm_es256_coord_t,
-struct tpm_es256_coord {
-	uint16_t size; /* sizeof(body) */
-	uint8_t  body[32];
-})
-
-/* Part 2, 11.2.5.2: TPMS_ECC_POINT */
-PACKED_TYPE(tpm_es256_point_t,
-struct tpm_es256_point {
-	tpm_es256_coord_t x;
-	tpm_es256_coord_t y;
-})
-
-/* Part 2, 12.2.3.5: TPMS_RSA_PARMS */
-PACKED_TYPE(tpm_rs256_param_t,
-struct tpm_rs256_param {
-	uint16_t symmetric; /* TPM_ALG_NULL */
-	uint16_t scheme;    /* TPM_ALG_NULL */
-	uint16_t keybits;   /* 2048 */
-	uint32_t exponent;  /* zero (meaning 2^16 + 1) */
-})
-
-/* Part 2, 12.2.3.6: TPMS_ECC_PARMS */
-PACKED_TYPE(tpm_es256_param_t,
-struct tpm_es256_param {
-	uint16_t symmetric; /* TPM_ALG_NULL */
-	uint16_t scheme;    /* TPM_ALG_NULL */
-	uint16_t curve_id;  /* TPM_ECC_P256 */
-	uint16_t kdf;       /* TPM_ALG_NULL */
-})
-
-/* Part 2, 12.2.4: TPMT_PUBLIC */
-PACKED_TYPE(tpm_rs256_pubarea_t,
-struct tpm_rs256_pubarea {
-	uint16_t            alg;    /* TPM_ALG_RSA */
-	uint16_t            hash;   /* TPM_ALG_SHA256 */
-	uint32_t            attr;
-	tpm_sha256_digest_t policy; /* must be present? */
-	tpm_rs256_param_t   param;
-	tpm_rs256_key_t     key;
-})
-
-/* Part 2, 12.2.4: TPMT_PUBLIC */
-PACKED_TYPE(tpm_es256_pubarea_t,
-struct tpm_es256_pubarea {
-	uint16_t            alg;    /* TPM_ALG_ECC */
-	uint16_t            hash;   /* TPM_ALG_SHA256 */
-	uint32_t            attr;
-	tpm_sha256_digest_t policy; /* must be present? */
-	tpm_es256_param_t   param;
-	tpm_es256_point_t   point;
-})
+/* Part 2, 10.5.3: TPM2B_NAME of a TPM_ALG_SHA256 name */
+#define TPM_SHA256_NAME_LEN	(sizeof(uint16_t) + SHA256_DIGEST_LENGTH)
 
+/* Part 2, 10.11.1: TPMS_CLOCK_INFO, less the safe flag */
+#define TPM_CLOCK_INFO_LEN	(sizeof(uint64_t) + 2 * sizeof(uint32_t))
+
+/*
+ * The structures below are parsed in place, in the order in which their
+ * fields are marshalled. As the TPM marshals its structures big-endian
+ * and unpadded, no field is ever copied or byte-swapped in memory.
+ */
 static int
-get_signed_sha1(tpm_sha1_data_t *dgst, const fido_blob_t *authdata,
-    const fido_blob_t *clientdata)
+get_u8(const unsigned char **buf, size_t *len, uint8_t *v)
 {
-	const EVP_MD	*md = NULL;
-	EVP_MD_CTX	*ctx = NULL;
-	int		 ok = -1;
+	return fido_buf_read(buf, len, v, sizeof(*v));
+}
 
-	if ((dgst->size = sizeof(dgst->body)) != SHA_DIGEST_LENGTH ||
-	    (md = EVP_sha1()) == NULL ||
-	    (ctx = EVP_MD_CTX_new()) == NULL ||
-	    EVP_DigestInit_ex(ctx, md, NULL) != 1 ||
-	    EVP_DigestUpdate(ctx, authdata->ptr, authdata->len) != 1 ||
-	    EVP_DigestUpdate(ctx, clientdata->ptr, clientdata->len) != 1 ||
-	    EVP_DigestFinal_ex(ctx, dgst->body, NULL) != 1) {
-		fido_log_debug("%s: sha1", __func__);
-		goto fail;
-	}
+static int
+get_u16(const unsigned char **buf, size_t *len, uint16_t *v)
+{
+	if (*len < 2)
+		return -1;
 
-	ok = 0;
-fail:
-	EVP_MD_CTX_free(ctx);
+	*v = (uint16_t)(((*buf)[0] << 8) | (*buf)[1]);
+	*buf += 2;
+	*len -= 2;
 
-	return (ok);
+	return 0;
 }
 
 static int
-get_signed_name(tpm_sha256_name_t *name, const fido_blob_t *pubarea)
+get_u32(const unsigned char **buf, size_t *len, uint32_t *v)
 {
-	name->alg = TPM_ALG_SHA256;
-	name->size = sizeof(name->alg) + sizeof(name->body);
-	if (sizeof(name->body) != SHA256_DIGEST_LENGTH ||
-	    SHA256(pubarea->ptr, pubarea->len, name->body) != name->body) {
-		fido_log_debug("%s: sha256", __func__);
+	uint16_t hi, lo;
+
+	if (get_u16(buf, len, &hi) < 0 || get_u16(buf, len, &lo) < 0)
 		return -1;
-	}
+
+	*v = (uint32_t)hi << 16 | lo;
 
 	return 0;
 }
 
-static void
-bswap_rs256_pubarea(tpm_rs256_pubarea_t *x)
+static int
+skip(const unsigned char **buf, size_t *len, size_t count)
 {
-	x->alg = htobe16(x->alg);
-	x->hash = htobe16(x->hash);
-	x->attr = htobe32(x->attr);
-	x->policy.size = htobe16(x->policy.size);
-	x->param.symmetric = htobe16(x->param.symmetric);
-	x->param.scheme = htobe16(x->param.scheme);
-	x->param.keybits = htobe16(x->param.keybits);
-	x->key.size = htobe16(x->key.size);
+	if (count > *len)
+		return -1;
+
+	*buf += count;
+	*len -= count;
+
+	return 0;
 }
 
-static void
-bswap_es256_pubarea(tpm_es256_pubarea_t *x)
+/* Part 2, 10.4: TPM2B; the body is not copied */
+static int
+get_tpm2b(const unsigned char **buf, size_t *len, size_t expected_len,
+    const unsigned char **body)
 {
-	x->alg = htobe16(x->alg);
-	x->hash = htobe16(x->hash);
-	x->attr = htobe32(x->attr);
-	x->policy.size = htobe16(x->policy.size);
-	x->param.symmetric = htobe16(x->param.symmetric);
-	x->param.scheme = htobe16(x->param.scheme);
-	x->param.curve_id = htobe16(x->param.curve_id);
-	x->param.kdf = htobe16(x->param.kdf);
-	x->point.x.size = htobe16(x->point.x.size);
-	x->point.y.size = htobe16(x->point.y.size);
+	uint16_t size;
+
+	if (get_u16(buf, len, &size) < 0 || size != expected_len) {
+		fido_log_debug("%s: size", __func__);
+		return -1;
+	}
+	*body = *buf;
+
+	return skip(buf, len, size);
 }
 
-static void
-bswap_sha1_certinfo(tpm_sha1_attest_t *x)
+static bool
+tpm2b_is(const unsigned char **buf, size_t *len, const void *expected,
+    size_t expected_len)
 {
-	x->magic = htobe32(x->magic);
-	x->type = htobe16(x->type);
-	x->signer.size = htobe16(x->signer.size);
-	x->data.size = htobe16(x->data.size);
-	x->name.alg = htobe16(x->name.alg);
-	x->name.size = htobe16(x->name.size);
+	const unsigned char *body;
+
+	return get_tpm2b(buf, len, expected_len, &body) == 0 &&
+	    timingsafe_bcmp(body, expected, expected_len) == 0;
+}
+
+static bool
+u16_is(const unsigned char **buf, size_t *len, uint16_t expected)
+{
+	uint16_t v;
+
+	return get_u16(buf, len, &v) == 0 && v == expected;
 }
 
+/* Part 2, 12.2.4: TPMT_PUBLIC, up to and including the parameters */
 static int
-check_rs256_pubarea(const fido_blob_t *buf, const rs256_pk_t *pk)
+check_pubarea_header(const unsigned char **buf, size_t *len, uint16_t alg)
 {
-	const tpm_rs256_pubarea_t	*actual;
-	tpm_rs256_pubarea_t		 expected;
-	int				 ok;
+	const unsigned char	*policy;
+	const uint32_t		 required = TPMA_FIXED|TPMA_FIXED_P|
+				     TPMA_SENSITIVE|TPMA_SIGN;
+	uint32_t		 attr;
 
-	if (buf->len != sizeof(*actual)) {
-		fido_log_debug("%s: buf->len=%zu", __func__, buf->len);
+	if (!u16_is(buf, len, alg) || !u16_is(buf, len, TPM_ALG_SHA256)) {
+		fido_log_debug("%s: alg", __func__);
+		return -1;
+	}
+	if (get_u32(buf, len, &attr) < 0 ||
+	    (attr & (TPMA_RESERVED|TPMA_CLEAR)) != 0 ||
+	    (attr & required) != required) {
+		fido_log_debug("%s: attr", __func__);
+		return -1;
+	}
+	/* Part 2, 10.4.2: TPM2B_DIGEST; the policy itself is not checked */
+	if (get_tpm2b(buf, len, SHA256_DIGEST_LENGTH, &policy) < 0) {
+		fido_log_debug("%s: policy", __func__);
+		return -1;
+	}
+	/* Part 2, 12.2.3.5/6: symmetric and scheme of TPMS_{RSA,ECC}_PARMS */
+	if (!u16_is(buf, len, TPM_ALG_NULL) ||
+	    !u16_is(buf, len, TPM_ALG_NULL)) {
+		fido_log_debug("%s: symmetric/scheme", __func__);
 		return -1;
 	}
-	actual = (const void *)buf->ptr;
-
-	memset(&expected, 0, sizeof(expected));
-	expected.alg = TPM_ALG_RSA;
-	expected.hash = TPM_ALG_SHA256;
-	expected.attr = be32toh(actual->attr);
-	expected.attr &= ~(TPMA_RESERVED|TPMA_CLEAR);
-	expected.attr |= (TPMA_FIXED|TPMA_FIXED_P|TPMA_SENSITIVE|TPMA_SIGN);
-	expected.policy = actual->policy;
-	expected.policy.size = sizeof(expected.policy.body);
-	expected.param.symmetric = TPM_ALG_NULL;
-	expected.param.scheme = TPM_ALG_NULL;
-	expected.param.keybits = 2048;
-	expected.param.exponent = 0; /* meaning 2^16+1 */
-	expected.key.size = sizeof(expected.key.body);
-	memcpy(&expected.key.body, &pk->n, sizeof(expected.key.body));
-	bswap_rs256_pubarea(&expected);
-
-	ok = timingsafe_bcmp(&expected, actual, sizeof(expected));
-	explicit_bzero(&expected, sizeof(expected));
-
-	return ok != 0 ? -1 : 0;
+
+	return 0;
 }
 
 static int
-check_es256_pubarea(const fido_blob_t *buf, const es256_pk_t *pk)
+check_rs256_pubarea(const fido_blob_t *pubarea, const rs256_pk_t *pk)
 {
-	const tpm_es256_pubarea_t	*actual;
-	tpm_es256_pubarea_t		 expected;
-	int				 ok;
+	const unsigned char	*buf = pubarea->ptr;
+	size_t			 len = pubarea->len;
+	uint32_t		 exponent;
+
+	if (check_pubarea_header(&buf, &len, TPM_ALG_RSA) < 0 ||
+	    !u16_is(&buf, &len, 2048) ||
+	    get_u32(&buf, &len, &exponent) < 0 ||
+	    exponent != 0 || /* meaning 2^16+1 */
+	    !tpm2b_is(&buf, &len, pk->n, sizeof(pk->n)) || len != 0) {
+		fido_log_debug("%s: pubarea", __func__);
+		return -1;
+	}
+
+	return 0;
+}
 
-	if (buf->len != sizeof(*actual)) {
-		fido_log_debug("%s: buf->len=%zu", __func__, buf->len);
+static int
+check_es256_pubarea(const fido_blob_t *pubarea, const es256_pk_t *pk)
+{
+	const unsigned char	*buf = pubarea->ptr;
+	size_t			 len = pubarea->len;
+
+	/* TCG Alg. Registry, 5.2.4: the scheme is TPM_ALG_NULL */
+	if (check_pubarea_header(&buf, &len, TPM_ALG_ECC) < 0 ||
+	    !u16_is(&buf, &len, TPM_ECC_P256) ||
+	    !u16_is(&buf, &len, TPM_ALG_NULL) ||
+	    !tpm2b_is(&buf, &len, pk->x, sizeof(pk->x)) ||
+	    !tpm2b_is(&buf, &len, pk->y, sizeof(pk->y)) || len != 0) {
+		fido_log_debug("%s: pubarea", __func__);
 		return -1;
 	}
-	actual = (const void *)buf->ptr;
-
-	memset(&expected, 0, sizeof(expected));
-	expected.alg = TPM_ALG_ECC;
-	expected.hash = TPM_ALG_SHA256;
-	expected.attr = be32toh(actual->attr);
-	expected.attr &= ~(TPMA_RESERVED|TPMA_CLEAR);
-	expected.attr |= (TPMA_FIXED|TPMA_FIXED_P|TPMA_SENSITIVE|TPMA_SIGN);
-	expected.policy = actual->policy;
-	expected.policy.size = sizeof(expected.policy.body);
-	expected.param.symmetric = TPM_ALG_NULL;
-	expected.param.scheme = TPM_ALG_NULL; /* TCG Alg. Registry, 5.2.4 */
-	expected.param.curve_id = TPM_ECC_P256;
-	expected.param.kdf = TPM_ALG_NULL;
-	expected.point.x.size = sizeof(expected.point.x.body);
-	expected.point.y.size = sizeof(expected.point.y.body);
-	memcpy(&expected.point.x.body, &pk->x, sizeof(expected.point.x.body));
-	memcpy(&expected.point.y.body, &pk->y, sizeof(expected.point.y.body));
-	bswap_es256_pubarea(&expected);
-
-	ok = timingsafe_bcmp(&expected, actual, sizeof(expected));
-	explicit_bzero(&expected, sizeof(expected));
-
-	return ok != 0 ? -1 : 0;
+
+	return 0;
 }
 
+/* Part 2, 10.12.8: TPMS_ATTEST of type TPM_ST_ATTEST_CERTIFY */
 static int
-check_sha1_certinfo(const fido_blob_t *buf, const fido_blob_t *clientdata_hash,
-    const fido_blob_t *authdata_raw, const fido_blob_t *pubarea)
+check_certinfo(const fido_blob_t *certinfo, const EVP_MD *md,
+    const fido_blob_t *clientdata_hash, const fido_blob_t *authdata_raw,
+    const fido_blob_t *pubarea)
 {
-	const tpm_sha1_attest_t	*actual;
-	tpm_sha1_attest_t	 expected;
-	tpm_sha1_data_t		 signed_data;
-	tpm_sha256_name_t	 signed_name;
+	unsigned char		 data[EVP_MAX_MD_SIZE];
+	unsigned char		 name[SHA256_DIGEST_LENGTH];
+	const unsigned char	*buf = certinfo->ptr;
+	const unsigned char	*skipped;
+	size_t			 len = certinfo->len;
+	unsigned int		 data_len;
+	uint32_t		 magic;
+	uint8_t			 safe;
+	EVP_MD_CTX		*ctx = NULL;
 	int			 ok = -1;
 
-	memset(&signed_data, 0, sizeof(signed_data));
-	memset(&signed_name, 0, sizeof(signed_name));
+	/* extraData: the hash of attToBeSigned, with the hash of alg */
+	if ((ctx = EVP_MD_CTX_new()) == NULL ||
+	    EVP_DigestInit_ex(ctx, md, NULL) != 1 ||
+	    EVP_DigestUpdate(ctx, authdata_raw->ptr, authdata_raw->len) != 1 ||
+	    EVP_DigestUpdate(ctx, clientdata_hash->ptr,
+	    clientdata_hash->len) != 1 ||
+	    EVP_DigestFinal_ex(ctx, data, &data_len) != 1) {
+		fido_log_debug("%s: extraData", __func__);
+		goto fail;
+	}
+	/* name: the TPM_ALG_SHA256 hash of pubArea */
+	if (fido_sha256_buf(pubarea->ptr, pubarea->len, name) < 0) {
+		fido_log_debug("%s: name", __func__);
+		goto fail;
+	}
 
-	if (get_signed_sha1(&signed_data, authdata_raw, clientdata_hash) < 0 ||
-	    get_signed_name(&signed_name, pubarea) < 0) {
-		fido_log_debug("%s: get_signed_sha1/name", __func__);
+	if (get_u32(&buf, &len, &magic) < 0 || magic != TPM_MAGIC ||
+	    !u16_is(&buf, &len, TPM_ST_CERTIFY)) {
+		fido_log_debug("%s: magic/type", __func__);
+		goto fail;
+	}
+	if (get_tpm2b(&buf, &len, TPM_SHA256_NAME_LEN, &skipped) < 0 ||
+	    !tpm2b_is(&buf, &len, data, data_len)) {
+		fido_log_debug("%s: signer/extraData", __func__);
+		goto fail;
+	}
+	if (skip(&buf, &len, TPM_CLOCK_INFO_LEN) < 0 ||
+	    get_u8(&buf, &len, &safe) < 0 || safe != 1 ||
+	    skip(&buf, &len, sizeof(uint64_t)) < 0) {
+		fido_log_debug("%s: clock/fwversion", __func__);
 		goto fail;
 	}
-	if (buf->len != sizeof(*actual)) {
-		fido_log_debug("%s: buf->len=%zu", __func__, buf->len);
+	/* Part 2, 10.12.3: TPMS_CERTIFY_INFO */
+	if (!u16_is(&buf, &len, TPM_SHA256_NAME_LEN) ||
+	    !u16_is(&buf, &len, TPM_ALG_SHA256) ||
+	    fido_buf_read(&buf, &len, data, sizeof(name)) < 0 ||
+	    timingsafe_bcmp(data, name, sizeof(name)) != 0 ||
+	    get_tpm2b(&buf, &len, TPM_SHA256_NAME_LEN, &skipped) < 0 ||
+	    len != 0) {
+		fido_log_debug("%s: name/qualifiedName", __func__);
 		goto fail;
 	}
-	actual = (const void *)buf->ptr;
-
-	memset(&expected, 0, sizeof(expected));
-	expected.magic = TPM_MAGIC;
-	expected.type = TPM_ST_CERTIFY;
-	expected.signer = actual->signer;
-	expected.signer.size = sizeof(expected.signer.alg) +
-	    sizeof(expected.signer.body);
-	expected.data = signed_data;
-	expected.clock = actual->clock;
-	expected.clock.safe = 1;
-	expected.fwversion = actual->fwversion;
-	expected.name = signed_name;
-	expected.qual_name = actual->qual_name;
-	bswap_sha1_certinfo(&expected);
-
-	ok = timingsafe_bcmp(&expected, actual, sizeof(expected));
+
+	ok = 0;
 fail:
-	explicit_bzero(&expected, sizeof(expected));
-	explicit_bzero(&signed_data, sizeof(signed_data));
-	explicit_bzero(&signed_name, sizeof(signed_name));
+	EVP_MD_CTX_free(ctx);
+	explicit_bzero(data, sizeof(data));
 
-	return ok != 0 ? -1 : 0;
+	return ok;
 }
 
 int
@@ -346,10 +271,20 @@ fido_get_signed_hash_tpm(fido_blob_t *dgst, const fido_blob_t *clientdata_hash,
     const fido_blob_t *authdata_raw, const fido_attstmt_t *attstmt,
     const fido_attcred_t *attcred)
 {
-	const fido_blob_t *pubarea = &attstmt->pubarea;
-	const fido_blob_t *certinfo = &attstmt->certinfo;
-
-	if (attstmt->alg != COSE_RS1) {
+	const fido_blob_t	*pubarea = &attstmt->pubarea;
+	const fido_blob_t	*certinfo = &attstmt->certinfo;
+	const EVP_MD		*md;
+	unsigned int		 dgst_len;
+
+	switch (attstmt->alg) {
+	case COSE_RS1:
+		md = fido_md_sha1();
+		break;
+	case COSE_ES256:
+	case COSE_RS256:
+		md = fido_md_sha256();
+		break;
+	default:
 		fido_log_debug("%s: unsupported alg %d", __func__,
 		    attstmt->alg);
 		return -1;
@@ -374,18 +309,24 @@ fido_get_signed_hash_tpm(fido_blob_t *dgst, const fido_blob_t *clientdata_hash,
 		return -1;
 	}
 
-	if (check_sha1_certinfo(certinfo, clientdata_hash, authdata_raw,
-	    pubarea) < 0) {
-		fido_log_debug("%s: check_sha1_certinfo", __func__);
+	if (md == NULL || check_certinfo(certinfo, md, clientdata_hash,
+	    authdata_raw, pubarea) < 0) {
+		fido_log_debug("%s: check_certinfo", __func__);
+		return -1;
+	}
+
+	if ((dgst->ptr = fido_calloc(1, EVP_MAX_MD_SIZE)) == NULL) {
+		fido_log_debug("%s: calloc", __func__);
 		return -1;
 	}
 
-	if (dgst->len < SHA_DIGEST_LENGTH ||
-	    SHA1(certinfo->ptr, certinfo->len, dgst->ptr) != dgst->ptr) {
-		fido_log_debug("%s: sha1", __func__);
+	if (EVP_Digest(certinfo->ptr, certinfo->len, dgst->ptr, &dgst_len,
+	    md, NULL) != 1) {
+		fido_log_debug("%s: EVP_Digest", __func__);
+		fido_blob_reset(dgst);
 		return -1;
 	}
-	dgst->len = SHA_DIGEST_LENGTH;
+	dgst->len = dgst_len;
 
 	return 0;
 }
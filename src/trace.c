@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "fido.h"
+
+#ifndef TLS
+#define TLS
+#endif
+
+static TLS fido_trace_handler_t *trace_handler;
+static TLS void *trace_handler_arg;
+static TLS uint64_t trace_last_id;
+static TLS uint64_t trace_current; /* innermost open span; 0 if none */
+
+void
+fido_set_trace_handler(fido_trace_handler_t *handler, void *arg)
+{
+	trace_handler = handler;
+	trace_handler_arg = arg;
+}
+
+/*
+ * Open a span in 't', which the caller keeps until fido_trace_end(). A
+ * span opened without a handler stays silent, even if one is installed
+ * before it ends.
+ */
+void
+fido_trace_begin(fido_trace_t *t, const fido_dev_t *dev, const char *op,
+    uint8_t cmd, uint8_t cbor_cmd, size_t len)
+{
+	memset(t, 0, sizeof(*t));
+	fido_log_push(dev, op);
+
+	if (trace_handler == NULL)
+		return;
+
+	t->phase = FIDO_TRACE_BEGIN;
+	t->op = op;
+	t->id = ++trace_last_id;
+	t->parent = trace_current;
+	t->path = dev != NULL ? dev->path : NULL;
+	t->cmd = cmd;
+	t->cbor_cmd = cbor_cmd;
+	t->len = len;
+	t->status = FIDO_OK;
+
+	trace_current = t->id;
+	trace_handler(trace_handler_arg, t);
+}
+
+/* close the span in 't'; returns 'status' */
+int
+fido_trace_end(fido_trace_t *t, int status)
+{
+	fido_log_pop();
+
+	if (t->id == 0)
+		return (status);
+
+	t->phase = FIDO_TRACE_END;
+	t->status = status;
+	trace_current = t->parent;
+
+	if (trace_handler != NULL)
+		trace_handler(trace_handler_arg, t);
+
+	return (status);
+}
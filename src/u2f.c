@@ -8,54 +8,53 @@
 #include <openssl/sha.h>
 #include <openssl/x509.h>
 
-#ifdef HAVE_UNISTD_H
-#include <unistd.h>
-#endif
-#include <errno.h>
-
 #include "fido.h"
 #include "fido/es256.h"
 #include "fallthrough.h"
 
+#define U2F_PACE_MIN_MS (10)
 #define U2F_PACE_MS (100)
 
-#if defined(_MSC_VER)
-static int
-usleep(unsigned int usec)
-{
-	Sleep(usec / 1000);
-
-	return (0);
-}
-#endif
-
+/*
+ * Send 'apdu' until the token stops answering that user presence is
+ * missing, and return the final reply's length in *reply_len. The APDU
+ * is encoded once by the caller and re-sent as is. Retries start
+ * U2F_PACE_MIN_MS apart, so a touch that is already latched is seen
+ * at once, and back off to U2F_PACE_MS for a user who is slower.
+ */
 static int
-delay_ms(unsigned int ms, int *ms_remain)
+u2f_msg_up(fido_dev_t *dev, const iso7816_apdu_t *apdu, unsigned char *reply,
+    size_t msgsiz, int *reply_len, int *ms)
 {
-	if (*ms_remain > -1 && (unsigned int)*ms_remain < ms)
-		ms = (unsigned int)*ms_remain;
+	unsigned int pace = U2F_PACE_MIN_MS;
 
-	if (ms > UINT_MAX / 1000) {
-		fido_log_debug("%s: ms=%u", __func__, ms);
-		return (-1);
-	}
-
-	if (usleep(ms * 1000) < 0) {
-		fido_log_error(errno, "%s: usleep", __func__);
-		return (-1);
+	for (;;) {
+		if (fido_tx(dev, CTAP_CMD_MSG, iso7816_ptr(apdu),
+		    iso7816_len(apdu), ms) < 0) {
+			fido_log_debug("%s: fido_tx", __func__);
+			return (FIDO_ERR_TX);
+		}
+		if ((*reply_len = fido_rx(dev, CTAP_CMD_MSG, reply, msgsiz,
+		    ms)) < 2) {
+			fido_log_debug("%s: fido_rx", __func__);
+			return (FIDO_ERR_RX);
+		}
+		if (((reply[0] << 8) | reply[1]) != SW_CONDITIONS_NOT_SATISFIED)
+			return (FIDO_OK);
+		if (fido_time_sleep(pace, ms) != 0) {
+			fido_log_debug("%s: fido_time_sleep", __func__);
+			return (FIDO_ERR_RX);
+		}
+		if ((pace *= 2) > U2F_PACE_MS)
+			pace = U2F_PACE_MS;
 	}
-
-	if (*ms_remain > -1)
-		*ms_remain -= (int)ms;
-
-	return (0);
 }
 
 static int
 sig_get(fido_blob_t *sig, const unsigned char **buf, size_t *len)
 {
 	sig->len = *len; /* consume the whole buffer */
-	if ((sig->ptr = calloc(1, sig->len)) == NULL ||
+	if ((sig->ptr = fido_calloc(1, sig->len)) == NULL ||
 	    fido_buf_read(buf, len, sig->ptr, sig->len) < 0) {
 		fido_log_debug("%s: fido_buf_read", __func__);
 		fido_blob_reset(sig);
@@ -85,7 +84,7 @@ x5c_get(fido_blob_t *x5c, const unsigned char **buf, size_t *len)
 	}
 
 	/* read accordingly */
-	if ((x5c->ptr = calloc(1, x5c->len)) == NULL ||
+	if ((x5c->ptr = fido_calloc(1, x5c->len)) == NULL ||
 	    fido_buf_read(buf, len, x5c->ptr, x5c->len) < 0) {
 		fido_log_debug("%s: fido_buf_read", __func__);
 		goto fail;
@@ -112,8 +111,8 @@ authdata_fake(const char *rp_id, uint8_t flags, uint32_t sigcount,
 
 	memset(&ad, 0, sizeof(ad));
 
-	if (SHA256((const void *)rp_id, strlen(rp_id),
-	    ad.rp_id_hash) != ad.rp_id_hash) {
+	if (fido_sha256_buf((const void *)rp_id, strlen(rp_id),
+	    ad.rp_id_hash) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		return (-1);
 	}
@@ -144,17 +143,20 @@ authdata_fake(const char *rp_id, uint8_t flags, uint32_t sigcount,
 static int
 send_dummy_register(fido_dev_t *dev, int *ms)
 {
+	iso7816_buf_t	 abuf;
 	iso7816_apdu_t	*apdu = NULL;
 	unsigned char	*reply = NULL;
+	size_t		 msgsiz = 0;
 	unsigned char	 challenge[SHA256_DIGEST_LENGTH];
 	unsigned char	 application[SHA256_DIGEST_LENGTH];
+	int		 reply_len;
 	int		 r;
 
 	/* dummy challenge & application */
 	memset(&challenge, 0xff, sizeof(challenge));
 	memset(&application, 0xff, sizeof(application));
 
-	if ((apdu = iso7816_new(0, U2F_CMD_REGISTER, 0, 2 *
+	if ((apdu = iso7816_init(&abuf, 0, U2F_CMD_REGISTER, 0, 2 *
 	    SHA256_DIGEST_LENGTH)) == NULL ||
 	    iso7816_add(apdu, &challenge, sizeof(challenge)) < 0 ||
 	    iso7816_add(apdu, &application, sizeof(application)) < 0) {
@@ -163,53 +165,52 @@ send_dummy_register(fido_dev_t *dev, int *ms)
 		goto fail;
 	}
 
-	if ((reply = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((reply = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	do {
-		if (fido_tx(dev, CTAP_CMD_MSG, iso7816_ptr(apdu),
-		    iso7816_len(apdu), ms) < 0) {
-			fido_log_debug("%s: fido_tx", __func__);
-			r = FIDO_ERR_TX;
-			goto fail;
-		}
-		if (fido_rx(dev, CTAP_CMD_MSG, reply, FIDO_MAXMSG, ms) < 2) {
-			fido_log_debug("%s: fido_rx", __func__);
-			r = FIDO_ERR_RX;
-			goto fail;
-		}
-		if (delay_ms(U2F_PACE_MS, ms) != 0) {
-			fido_log_debug("%s: delay_ms", __func__);
-			r = FIDO_ERR_RX;
-			goto fail;
-		}
-	} while (((reply[0] << 8) | reply[1]) == SW_CONDITIONS_NOT_SATISFIED);
+	if ((r = u2f_msg_up(dev, apdu, reply, msgsiz, &reply_len,
+	    ms)) != FIDO_OK) {
+		fido_log_debug("%s: u2f_msg_up", __func__);
+		goto fail;
+	}
 
 	r = FIDO_OK;
 fail:
 	iso7816_free(&apdu);
-	freezero(reply, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, reply, msgsiz);
 
 	return (r);
 }
 
+/*
+ * Check-only authentication of each key handle in 'list'; found[i] is set
+ * to 1 if the i-th handle belongs to the device, 0 otherwise. The rp_id
+ * hash and the reply buffer are shared by all lookups. If 'first' is set,
+ * the lookup stops at the first handle found, and *n is set to the number
+ * of handles checked.
+ */
 static int
-key_lookup(fido_dev_t *dev, const char *rp_id, const fido_blob_t *key_id,
-    int *found, int *ms)
+key_lookup(fido_dev_t *dev, const char *rp_id, const fido_blob_array_t *list,
+    bool first, unsigned char *found, size_t *n, int *ms)
 {
+	iso7816_buf_t	 abuf;
 	iso7816_apdu_t	*apdu = NULL;
 	unsigned char	*reply = NULL;
+	size_t		 msgsiz = 0;
 	unsigned char	 challenge[SHA256_DIGEST_LENGTH];
 	unsigned char	 rp_id_hash[SHA256_DIGEST_LENGTH];
+	const fido_blob_t *key_id;
 	uint8_t		 key_id_len;
+	size_t		 i;
 	int		 r;
 
-	if (key_id->len > UINT8_MAX || rp_id == NULL) {
-		fido_log_debug("%s: key_id->len=%zu, rp_id=%p", __func__,
-		    key_id->len, (const void *)rp_id);
+	*n = 0;
+
+	if (rp_id == NULL) {
+		fido_log_debug("%s: rp_id=NULL", __func__);
 		r = FIDO_ERR_INVALID_ARGUMENT;
 		goto fail;
 	}
@@ -217,61 +218,79 @@ key_lookup(fido_dev_t *dev, const char *rp_id, const fido_blob_t *key_id,
 	memset(&challenge, 0xff, sizeof(challenge));
 	memset(&rp_id_hash, 0, sizeof(rp_id_hash));
 
-	if (SHA256((const void *)rp_id, strlen(rp_id),
-	    rp_id_hash) != rp_id_hash) {
+	if (fido_sha256_buf((const void *)rp_id, strlen(rp_id),
+	    rp_id_hash) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	key_id_len = (uint8_t)key_id->len;
-
-	if ((apdu = iso7816_new(0, U2F_CMD_AUTH, U2F_AUTH_CHECK, (uint16_t)(2 *
-	    SHA256_DIGEST_LENGTH + sizeof(key_id_len) + key_id_len))) == NULL ||
-	    iso7816_add(apdu, &challenge, sizeof(challenge)) < 0 ||
-	    iso7816_add(apdu, &rp_id_hash, sizeof(rp_id_hash)) < 0 ||
-	    iso7816_add(apdu, &key_id_len, sizeof(key_id_len)) < 0 ||
-	    iso7816_add(apdu, key_id->ptr, key_id_len) < 0) {
-		fido_log_debug("%s: iso7816", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
-	}
-
-	if ((reply = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((reply = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	if (fido_tx(dev, CTAP_CMD_MSG, iso7816_ptr(apdu),
-	    iso7816_len(apdu), ms) < 0) {
-		fido_log_debug("%s: fido_tx", __func__);
-		r = FIDO_ERR_TX;
-		goto fail;
-	}
-	if (fido_rx(dev, CTAP_CMD_MSG, reply, FIDO_MAXMSG, ms) != 2) {
-		fido_log_debug("%s: fido_rx", __func__);
-		r = FIDO_ERR_RX;
-		goto fail;
-	}
+	for (i = 0; i < list->len; i++) {
+		key_id = &list->ptr[i];
+		if (key_id->len > UINT8_MAX) {
+			fido_log_debug("%s: key_id->len=%zu", __func__,
+			    key_id->len);
+			r = FIDO_ERR_INVALID_ARGUMENT;
+			goto fail;
+		}
 
-	switch ((reply[0] << 8) | reply[1]) {
-	case SW_CONDITIONS_NOT_SATISFIED:
-		*found = 1; /* key exists */
-		break;
-	case SW_WRONG_DATA:
-		*found = 0; /* key does not exist */
-		break;
-	default:
-		/* unexpected sw */
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
+		key_id_len = (uint8_t)key_id->len;
+
+		if ((apdu = iso7816_init(&abuf, 0, U2F_CMD_AUTH, U2F_AUTH_CHECK,
+		    (uint16_t)(2 * SHA256_DIGEST_LENGTH + sizeof(key_id_len) +
+		    key_id_len))) == NULL ||
+		    iso7816_add(apdu, &challenge, sizeof(challenge)) < 0 ||
+		    iso7816_add(apdu, &rp_id_hash, sizeof(rp_id_hash)) < 0 ||
+		    iso7816_add(apdu, &key_id_len, sizeof(key_id_len)) < 0 ||
+		    iso7816_add(apdu, key_id->ptr, key_id_len) < 0) {
+			fido_log_debug("%s: iso7816", __func__);
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+
+		if (fido_tx(dev, CTAP_CMD_MSG, iso7816_ptr(apdu),
+		    iso7816_len(apdu), ms) < 0) {
+			fido_log_debug("%s: fido_tx", __func__);
+			r = FIDO_ERR_TX;
+			goto fail;
+		}
+		if (fido_rx(dev, CTAP_CMD_MSG, reply, msgsiz, ms) != 2) {
+			fido_log_debug("%s: fido_rx", __func__);
+			r = FIDO_ERR_RX;
+			goto fail;
+		}
+
+		iso7816_free(&apdu);
+
+		switch ((reply[0] << 8) | reply[1]) {
+		case SW_CONDITIONS_NOT_SATISFIED:
+			found[i] = 1; /* key exists */
+			break;
+		case SW_WRONG_DATA:
+			found[i] = 0; /* key does not exist */
+			break;
+		default:
+			/* unexpected sw */
+			r = FIDO_ERR_INTERNAL;
+			goto fail;
+		}
+
+		*n = i + 1;
+
+		if (first && found[i])
+			break;
 	}
 
 	r = FIDO_OK;
 fail:
 	iso7816_free(&apdu);
-	freezero(reply, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, reply, msgsiz);
 
 	return (r);
 }
@@ -313,8 +332,10 @@ static int
 do_auth(fido_dev_t *dev, const fido_blob_t *cdh, const char *rp_id,
     const fido_blob_t *key_id, fido_blob_t *sig, fido_blob_t *ad, int *ms)
 {
+	iso7816_buf_t	 abuf;
 	iso7816_apdu_t	*apdu = NULL;
 	unsigned char	*reply = NULL;
+	size_t		 msgsiz = 0;
 	unsigned char	 rp_id_hash[SHA256_DIGEST_LENGTH];
 	int		 reply_len;
 	uint8_t		 key_id_len;
@@ -332,8 +353,8 @@ do_auth(fido_dev_t *dev, const fido_blob_t *cdh, const char *rp_id,
 
 	memset(&rp_id_hash, 0, sizeof(rp_id_hash));
 
-	if (SHA256((const void *)rp_id, strlen(rp_id),
-	    rp_id_hash) != rp_id_hash) {
+	if (fido_sha256_buf((const void *)rp_id, strlen(rp_id),
+	    rp_id_hash) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
@@ -341,8 +362,9 @@ do_auth(fido_dev_t *dev, const fido_blob_t *cdh, const char *rp_id,
 
 	key_id_len = (uint8_t)key_id->len;
 
-	if ((apdu = iso7816_new(0, U2F_CMD_AUTH, U2F_AUTH_SIGN, (uint16_t)(2 *
-	    SHA256_DIGEST_LENGTH + sizeof(key_id_len) + key_id_len))) == NULL ||
+	if ((apdu = iso7816_init(&abuf, 0, U2F_CMD_AUTH, U2F_AUTH_SIGN,
+	    (uint16_t)(2 * SHA256_DIGEST_LENGTH + sizeof(key_id_len) +
+	    key_id_len))) == NULL ||
 	    iso7816_add(apdu, cdh->ptr, cdh->len) < 0 ||
 	    iso7816_add(apdu, &rp_id_hash, sizeof(rp_id_hash)) < 0 ||
 	    iso7816_add(apdu, &key_id_len, sizeof(key_id_len)) < 0 ||
@@ -352,31 +374,23 @@ do_auth(fido_dev_t *dev, const fido_blob_t *cdh, const char *rp_id,
 		goto fail;
 	}
 
-	if ((reply = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((reply = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	do {
-		if (fido_tx(dev, CTAP_CMD_MSG, iso7816_ptr(apdu),
-		    iso7816_len(apdu), ms) < 0) {
-			fido_log_debug("%s: fido_tx", __func__);
-			r = FIDO_ERR_TX;
-			goto fail;
-		}
-		if ((reply_len = fido_rx(dev, CTAP_CMD_MSG, reply,
-		    FIDO_MAXMSG, ms)) < 2) {
-			fido_log_debug("%s: fido_rx", __func__);
-			r = FIDO_ERR_RX;
-			goto fail;
-		}
-		if (delay_ms(U2F_PACE_MS, ms) != 0) {
-			fido_log_debug("%s: delay_ms", __func__);
-			r = FIDO_ERR_RX;
-			goto fail;
-		}
-	} while (((reply[0] << 8) | reply[1]) == SW_CONDITIONS_NOT_SATISFIED);
+	if ((r = u2f_msg_up(dev, apdu, reply, msgsiz, &reply_len,
+	    ms)) != FIDO_OK) {
+		fido_log_debug("%s: u2f_msg_up", __func__);
+		goto fail;
+	}
+
+	if (reply_len == 2 && ((reply[0] << 8) | reply[1]) == SW_WRONG_DATA) {
+		fido_log_debug("%s: key does not exist", __func__);
+		r = FIDO_ERR_CREDENTIAL_EXCLUDED;
+		goto fail;
+	}
 
 	if ((r = parse_auth_reply(sig, ad, rp_id, reply,
 	    (size_t)reply_len)) != FIDO_OK) {
@@ -386,7 +400,7 @@ do_auth(fido_dev_t *dev, const fido_blob_t *cdh, const char *rp_id,
 
 fail:
 	iso7816_free(&apdu);
-	freezero(reply, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, reply, msgsiz);
 
 	return (r);
 }
@@ -528,8 +542,8 @@ encode_cred_authdata(const char *rp_id, const uint8_t *kh, uint8_t kh_len,
 		goto fail;
 	}
 
-	if (SHA256((const void *)rp_id, strlen(rp_id),
-	    authdata.rp_id_hash) != authdata.rp_id_hash) {
+	if (fido_sha256_buf((const void *)rp_id, strlen(rp_id),
+	    authdata.rp_id_hash) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		goto fail;
 	}
@@ -542,7 +556,7 @@ encode_cred_authdata(const char *rp_id, const uint8_t *kh, uint8_t kh_len,
 
 	len = authdata_blob.len = sizeof(authdata) + sizeof(attcred_raw) +
 	    kh_len + pk_blob.len;
-	ptr = authdata_blob.ptr = calloc(1, authdata_blob.len);
+	ptr = authdata_blob.ptr = fido_calloc(1, authdata_blob.len);
 
 	fido_log_debug("%s: ptr=%p, len=%zu", __func__, (void *)ptr, len);
 
@@ -616,7 +630,7 @@ parse_register_reply(fido_cred_t *cred, const unsigned char *reply, size_t len)
 	/* pubkey + key handle */
 	if (fido_buf_read(&reply, &len, &pubkey, sizeof(pubkey)) < 0 ||
 	    fido_buf_read(&reply, &len, &kh_len, sizeof(kh_len)) < 0 ||
-	    (kh = calloc(1, kh_len)) == NULL ||
+	    (kh = fido_calloc(1, kh_len)) == NULL ||
 	    fido_buf_read(&reply, &len, kh, kh_len) < 0) {
 		fido_log_debug("%s: fido_buf_read", __func__);
 		goto fail;
@@ -652,7 +666,7 @@ parse_register_reply(fido_cred_t *cred, const unsigned char *reply, size_t len)
 
 	r = FIDO_OK;
 fail:
-	freezero(kh, kh_len);
+	fido_freezero(kh, kh_len);
 	fido_blob_reset(&x5c);
 	fido_blob_reset(&sig);
 	fido_blob_reset(&ad);
@@ -664,11 +678,15 @@ fail:
 int
 u2f_register(fido_dev_t *dev, fido_cred_t *cred, int *ms)
 {
+	iso7816_buf_t	 abuf;
 	iso7816_apdu_t	*apdu = NULL;
 	unsigned char	 rp_id_hash[SHA256_DIGEST_LENGTH];
 	unsigned char	*reply = NULL;
+	size_t		 msgsiz = 0;
+	unsigned char	*found;
+	size_t		 n;
+	bool		 excluded;
 	int		 reply_len;
-	int		 found;
 	int		 r;
 
 	if (cred->rk == FIDO_OPT_TRUE || cred->uv == FIDO_OPT_TRUE) {
@@ -677,20 +695,25 @@ u2f_register(fido_dev_t *dev, fido_cred_t *cred, int *ms)
 		return (FIDO_ERR_UNSUPPORTED_OPTION);
 	}
 
-	if (cred->type != COSE_ES256 || cred->cdh.ptr == NULL ||
+	if (cred->type != COSE_ES256 || fido_blob_is_empty(&cred->cdh) ||
 	    cred->rp.id == NULL || cred->cdh.len != SHA256_DIGEST_LENGTH) {
 		fido_log_debug("%s: type=%d, cdh=(%p,%zu)" , __func__,
 		    cred->type, (void *)cred->cdh.ptr, cred->cdh.len);
 		return (FIDO_ERR_INVALID_ARGUMENT);
 	}
 
-	for (size_t i = 0; i < cred->excl.len; i++) {
-		if ((r = key_lookup(dev, cred->rp.id, &cred->excl.ptr[i],
-		    &found, ms)) != FIDO_OK) {
+	if (cred->excl.len) {
+		if ((found = fido_calloc(cred->excl.len, 1)) == NULL)
+			return (FIDO_ERR_INTERNAL);
+		r = key_lookup(dev, cred->rp.id, &cred->excl, true, found, &n,
+		    ms);
+		excluded = r == FIDO_OK && n > 0 && found[n - 1];
+		fido_free(found);
+		if (r != FIDO_OK) {
 			fido_log_debug("%s: key_lookup", __func__);
 			return (r);
 		}
-		if (found) {
+		if (excluded) {
 			if ((r = send_dummy_register(dev, ms)) != FIDO_OK) {
 				fido_log_debug("%s: send_dummy_register",
 				    __func__);
@@ -702,13 +725,13 @@ u2f_register(fido_dev_t *dev, fido_cred_t *cred, int *ms)
 
 	memset(&rp_id_hash, 0, sizeof(rp_id_hash));
 
-	if (SHA256((const void *)cred->rp.id, strlen(cred->rp.id),
-	    rp_id_hash) != rp_id_hash) {
+	if (fido_sha256_buf((const void *)cred->rp.id, strlen(cred->rp.id),
+	    rp_id_hash) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		return (FIDO_ERR_INTERNAL);
 	}
 
-	if ((apdu = iso7816_new(0, U2F_CMD_REGISTER, 0, 2 *
+	if ((apdu = iso7816_init(&abuf, 0, U2F_CMD_REGISTER, 0, 2 *
 	    SHA256_DIGEST_LENGTH)) == NULL ||
 	    iso7816_add(apdu, cred->cdh.ptr, cred->cdh.len) < 0 ||
 	    iso7816_add(apdu, rp_id_hash, sizeof(rp_id_hash)) < 0) {
@@ -717,31 +740,17 @@ u2f_register(fido_dev_t *dev, fido_cred_t *cred, int *ms)
 		goto fail;
 	}
 
-	if ((reply = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((reply = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		r = FIDO_ERR_INTERNAL;
 		goto fail;
 	}
 
-	do {
-		if (fido_tx(dev, CTAP_CMD_MSG, iso7816_ptr(apdu),
-		    iso7816_len(apdu), ms) < 0) {
-			fido_log_debug("%s: fido_tx", __func__);
-			r = FIDO_ERR_TX;
-			goto fail;
-		}
-		if ((reply_len = fido_rx(dev, CTAP_CMD_MSG, reply,
-		    FIDO_MAXMSG, ms)) < 2) {
-			fido_log_debug("%s: fido_rx", __func__);
-			r = FIDO_ERR_RX;
-			goto fail;
-		}
-		if (delay_ms(U2F_PACE_MS, ms) != 0) {
-			fido_log_debug("%s: delay_ms", __func__);
-			r = FIDO_ERR_RX;
-			goto fail;
-		}
-	} while (((reply[0] << 8) | reply[1]) == SW_CONDITIONS_NOT_SATISFIED);
+	if ((r = u2f_msg_up(dev, apdu, reply, msgsiz, &reply_len,
+	    ms)) != FIDO_OK) {
+		fido_log_debug("%s: u2f_msg_up", __func__);
+		goto fail;
+	}
 
 	if ((r = parse_register_reply(cred, reply,
 	    (size_t)reply_len)) != FIDO_OK) {
@@ -750,7 +759,7 @@ u2f_register(fido_dev_t *dev, fido_cred_t *cred, int *ms)
 	}
 fail:
 	iso7816_free(&apdu);
-	freezero(reply, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, reply, msgsiz);
 
 	return (r);
 }
@@ -761,50 +770,39 @@ u2f_authenticate_single(fido_dev_t *dev, const fido_blob_t *key_id,
 {
 	fido_blob_t	sig;
 	fido_blob_t	ad;
-	int		found;
 	int		r;
 
 	memset(&sig, 0, sizeof(sig));
 	memset(&ad, 0, sizeof(ad));
 
-	if ((r = key_lookup(dev, fa->rp_id, key_id, &found, ms)) != FIDO_OK) {
-		fido_log_debug("%s: key_lookup", __func__);
-		goto fail;
-	}
-
-	if (!found) {
-		fido_log_debug("%s: not found", __func__);
-		r = FIDO_ERR_CREDENTIAL_EXCLUDED;
-		goto fail;
-	}
-
-	if (fido_blob_set(&fa->stmt[idx].id, key_id->ptr, key_id->len) < 0) {
-		fido_log_debug("%s: fido_blob_set", __func__);
-		r = FIDO_ERR_INTERNAL;
-		goto fail;
-	}
-
 	if (fa->up == FIDO_OPT_FALSE) {
 		fido_log_debug("%s: checking for key existence only", __func__);
 		r = FIDO_ERR_USER_PRESENCE_REQUIRED;
-		goto fail;
+		goto out;
 	}
 
 	if ((r = do_auth(dev, &fa->cdh, fa->rp_id, key_id, &sig, &ad,
 	    ms)) != FIDO_OK) {
 		fido_log_debug("%s: do_auth", __func__);
-		goto fail;
+		goto out;
 	}
 
 	if (fido_assert_set_authdata(fa, idx, ad.ptr, ad.len) != FIDO_OK ||
 	    fido_assert_set_sig(fa, idx, sig.ptr, sig.len) != FIDO_OK) {
 		fido_log_debug("%s: fido_assert_set", __func__);
 		r = FIDO_ERR_INTERNAL;
-		goto fail;
+		goto out;
 	}
 
 	r = FIDO_OK;
-fail:
+out:
+	if (r == FIDO_OK || r == FIDO_ERR_USER_PRESENCE_REQUIRED)
+		if (fido_blob_set(&fa->stmt[idx].id, key_id->ptr,
+		    key_id->len) < 0) {
+			fido_log_debug("%s: fido_blob_set", __func__);
+			r = FIDO_ERR_INTERNAL;
+		}
+
 	fido_blob_reset(&sig);
 	fido_blob_reset(&ad);
 
@@ -814,9 +812,12 @@ fail:
 int
 u2f_authenticate(fido_dev_t *dev, fido_assert_t *fa, int *ms)
 {
-	size_t	nfound = 0;
-	size_t	nauth_ok = 0;
-	int	r;
+	const bool	 first = (fa->u2f_flags & FIDO_U2F_FIRST) != 0;
+	unsigned char	*found = NULL;
+	size_t		 nlookup;
+	size_t		 nfound = 0;
+	size_t		 nauth_ok = 0;
+	int		 r;
 
 	if (fa->uv == FIDO_OPT_TRUE || fa->allow_list.ptr == NULL) {
 		fido_log_debug("%s: uv=%d, allow_list=%p", __func__, fa->uv,
@@ -829,7 +830,25 @@ u2f_authenticate(fido_dev_t *dev, fido_assert_t *fa, int *ms)
 		return (r);
 	}
 
-	for (size_t i = 0; i < fa->allow_list.len; i++) {
+	if ((found = fido_calloc(fa->allow_list.len, 1)) == NULL)
+		return (FIDO_ERR_INTERNAL);
+
+	/*
+	 * A signing request for a foreign key handle fails immediately, so
+	 * the check-only lookup may be skipped if user presence is required.
+	 */
+	if ((fa->u2f_flags & FIDO_U2F_NO_PROBE) && fa->up != FIDO_OPT_FALSE) {
+		memset(found, 1, fa->allow_list.len);
+		nlookup = fa->allow_list.len;
+	} else if ((r = key_lookup(dev, fa->rp_id, &fa->allow_list, first,
+	    found, &nlookup, ms)) != FIDO_OK) {
+		fido_log_debug("%s: key_lookup", __func__);
+		goto fail;
+	}
+
+	for (size_t i = 0; i < nlookup; i++) {
+		if (!found[i])
+			continue; /* ignore credentials that don't exist */
 		switch ((r = u2f_authenticate_single(dev,
 		    &fa->allow_list.ptr[i], fa, nfound, ms))) {
 		case FIDO_OK:
@@ -842,29 +861,37 @@ u2f_authenticate(fido_dev_t *dev, fido_assert_t *fa, int *ms)
 			if (r != FIDO_ERR_CREDENTIAL_EXCLUDED) {
 				fido_log_debug("%s: u2f_authenticate_single",
 				    __func__);
-				return (r);
+				goto fail;
 			}
 			/* ignore credentials that don't exist */
 		}
+		if (first && nfound)
+			break;
 	}
 
 	fa->stmt_len = nfound;
 
 	if (nfound == 0)
-		return (FIDO_ERR_NO_CREDENTIALS);
-	if (nauth_ok == 0)
-		return (FIDO_ERR_USER_PRESENCE_REQUIRED);
+		r = FIDO_ERR_NO_CREDENTIALS;
+	else if (nauth_ok == 0)
+		r = FIDO_ERR_USER_PRESENCE_REQUIRED;
+	else
+		r = FIDO_OK;
+fail:
+	fido_free(found);
 
-	return (FIDO_OK);
+	return (r);
 }
 
 int
 u2f_get_touch_begin(fido_dev_t *dev, int *ms)
 {
+	iso7816_buf_t	 abuf;
 	iso7816_apdu_t	*apdu = NULL;
 	const char	*clientdata = FIDO_DUMMY_CLIENTDATA;
 	const char	*rp_id = FIDO_DUMMY_RP_ID;
 	unsigned char	*reply = NULL;
+	size_t		 msgsiz = 0;
 	unsigned char	 clientdata_hash[SHA256_DIGEST_LENGTH];
 	unsigned char	 rp_id_hash[SHA256_DIGEST_LENGTH];
 	int		 r;
@@ -872,14 +899,14 @@ u2f_get_touch_begin(fido_dev_t *dev, int *ms)
 	memset(&clientdata_hash, 0, sizeof(clientdata_hash));
 	memset(&rp_id_hash, 0, sizeof(rp_id_hash));
 
-	if (SHA256((const void *)clientdata, strlen(clientdata),
-	    clientdata_hash) != clientdata_hash || SHA256((const void *)rp_id,
-	    strlen(rp_id), rp_id_hash) != rp_id_hash) {
+	if (fido_sha256_buf((const void *)clientdata, strlen(clientdata),
+	    clientdata_hash) < 0 || fido_sha256_buf((const void *)rp_id,
+	    strlen(rp_id), rp_id_hash) < 0) {
 		fido_log_debug("%s: sha256", __func__);
 		return (FIDO_ERR_INTERNAL);
 	}
 
-	if ((apdu = iso7816_new(0, U2F_CMD_REGISTER, 0, 2 *
+	if ((apdu = iso7816_init(&abuf, 0, U2F_CMD_REGISTER, 0, 2 *
 	    SHA256_DIGEST_LENGTH)) == NULL ||
 	    iso7816_add(apdu, clientdata_hash, sizeof(clientdata_hash)) < 0 ||
 	    iso7816_add(apdu, rp_id_hash, sizeof(rp_id_hash)) < 0) {
@@ -888,7 +915,7 @@ u2f_get_touch_begin(fido_dev_t *dev, int *ms)
 		goto fail;
 	}
 
-	if ((reply = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((reply = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		r =  FIDO_ERR_INTERNAL;
 		goto fail;
@@ -896,7 +923,7 @@ u2f_get_touch_begin(fido_dev_t *dev, int *ms)
 
 	if (dev->attr.flags & FIDO_CAP_WINK) {
 		fido_tx(dev, CTAP_CMD_WINK, NULL, 0, ms);
-		fido_rx(dev, CTAP_CMD_WINK, reply, FIDO_MAXMSG, ms);
+		fido_rx(dev, CTAP_CMD_WINK, reply, msgsiz, ms);
 	}
 
 	if (fido_tx(dev, CTAP_CMD_MSG, iso7816_ptr(apdu),
@@ -909,7 +936,7 @@ u2f_get_touch_begin(fido_dev_t *dev, int *ms)
 	r = FIDO_OK;
 fail:
 	iso7816_free(&apdu);
-	freezero(reply, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, reply, msgsiz);
 
 	return (r);
 }
@@ -918,16 +945,17 @@ int
 u2f_get_touch_status(fido_dev_t *dev, int *touched, int *ms)
 {
 	unsigned char	*reply;
+	size_t		 msgsiz = 0;
 	int		 reply_len;
 	int		 r;
 
-	if ((reply = malloc(FIDO_MAXMSG)) == NULL) {
+	if ((reply = fido_dev_msgbuf_get(dev, &msgsiz)) == NULL) {
 		fido_log_debug("%s: malloc", __func__);
 		r =  FIDO_ERR_INTERNAL;
 		goto out;
 	}
 
-	if ((reply_len = fido_rx(dev, CTAP_CMD_MSG, reply, FIDO_MAXMSG,
+	if ((reply_len = fido_rx(dev, CTAP_CMD_MSG, reply, msgsiz,
 	    ms)) < 2) {
 		fido_log_debug("%s: fido_rx", __func__);
 		r = FIDO_OK; /* ignore */
@@ -953,7 +981,7 @@ u2f_get_touch_status(fido_dev_t *dev, int *touched, int *ms)
 
 	r = FIDO_OK;
 out:
-	freezero(reply, FIDO_MAXMSG);
+	fido_dev_msgbuf_put(dev, reply, msgsiz);
 
 	return (r);
 }
@@ -36,8 +36,19 @@ struct winhello_assert {
 	WEBAUTHN_CLIENT_DATA				 cd;
 	WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS	 opt;
 	WEBAUTHN_ASSERTION				*assert;
+	const wchar_t					*rp_id;
+	BOOL						 appid_used;
+};
+
+/*
+ * The parts of an assertion request converted for webauthn.dll that do not
+ * change between calls: its rp id, appid and allow list. Kept in
+ * assert->winhello until one of them is set again.
+ */
+struct winhello_assert_cache {
 	wchar_t						*rp_id;
 	wchar_t						*appid;
+	WEBAUTHN_CREDENTIALS				 allow;
 };
 
 struct winhello_cred {
@@ -55,6 +66,17 @@ struct winhello_cred {
 	wchar_t						*display_name;
 };
 
+/* a request running on a worker thread; see fido_winhello_*_submit() */
+struct winhello_op {
+	HANDLE						 thread;
+	HWND						 w;
+	GUID						 cancel_id;
+	BOOL						 cancellable;
+	struct winhello_assert				*assert;
+	struct winhello_cred				*cred;
+	int						 r;
+};
+
 typedef DWORD	WINAPI	webauthn_get_api_version_t(void);
 typedef PCWSTR	WINAPI	webauthn_strerr_t(HRESULT);
 typedef HRESULT	WINAPI	webauthn_get_assert_t(HWND, LPCWSTR,
@@ -70,15 +92,22 @@ typedef HRESULT	WINAPI	webauthn_make_cred_t(HWND,
 			    PWEBAUTHN_CREDENTIAL_ATTESTATION *);
 typedef void	WINAPI	webauthn_free_assert_t(PWEBAUTHN_ASSERTION);
 typedef void	WINAPI	webauthn_free_attest_t(PWEBAUTHN_CREDENTIAL_ATTESTATION);
-
-static TLS BOOL				 webauthn_loaded;
-static TLS HMODULE			 webauthn_handle;
-static TLS webauthn_get_api_version_t	*webauthn_get_api_version;
-static TLS webauthn_strerr_t		*webauthn_strerr;
-static TLS webauthn_get_assert_t	*webauthn_get_assert;
-static TLS webauthn_make_cred_t		*webauthn_make_cred;
-static TLS webauthn_free_assert_t	*webauthn_free_assert;
-static TLS webauthn_free_attest_t	*webauthn_free_attest;
+typedef HRESULT	WINAPI	webauthn_get_cancel_id_t(GUID *);
+typedef HRESULT	WINAPI	webauthn_cancel_t(const GUID *);
+
+/* loaded once per process, by webauthn_init() */
+static INIT_ONCE			 webauthn_once = INIT_ONCE_STATIC_INIT;
+static BOOL				 webauthn_loaded;
+static DWORD				 webauthn_api_version;
+static HMODULE				 webauthn_handle;
+static webauthn_get_api_version_t	*webauthn_get_api_version;
+static webauthn_strerr_t		*webauthn_strerr;
+static webauthn_get_assert_t		*webauthn_get_assert;
+static webauthn_make_cred_t		*webauthn_make_cred;
+static webauthn_free_assert_t		*webauthn_free_assert;
+static webauthn_free_attest_t		*webauthn_free_attest;
+static webauthn_get_cancel_id_t		*webauthn_get_cancel_id;
+static webauthn_cancel_t		*webauthn_cancel;
 
 static int
 webauthn_load(void)
@@ -139,7 +168,19 @@ webauthn_load(void)
 		    __func__);
 		goto fail;
 	}
+	/* cancellation is optional */
+	webauthn_get_cancel_id =
+	    (webauthn_get_cancel_id_t *)GetProcAddress(webauthn_handle,
+	    "WebAuthNGetCancellationId");
+	webauthn_cancel = (webauthn_cancel_t *)GetProcAddress(webauthn_handle,
+	    "WebAuthNCancelCurrentOperation");
+	if (webauthn_get_cancel_id == NULL || webauthn_cancel == NULL) {
+		fido_log_debug("%s: no cancellation", __func__);
+		webauthn_get_cancel_id = NULL;
+		webauthn_cancel = NULL;
+	}
 
+	webauthn_api_version = n;
 	webauthn_loaded = true;
 
 	return 0;
@@ -151,12 +192,38 @@ fail:
 	webauthn_make_cred = NULL;
 	webauthn_free_assert = NULL;
 	webauthn_free_attest = NULL;
+	webauthn_get_cancel_id = NULL;
+	webauthn_cancel = NULL;
 	FreeLibrary(webauthn_handle);
 	webauthn_handle = NULL;
 
 	return -1;
 }
 
+static BOOL CALLBACK
+webauthn_load_once(PINIT_ONCE once, PVOID arg, PVOID *ctx)
+{
+	(void)once;
+	(void)arg;
+	(void)ctx;
+
+	(void)webauthn_load();
+
+	return TRUE; /* a failed load is not retried */
+}
+
+static int
+webauthn_init(void)
+{
+	if (InitOnceExecuteOnce(&webauthn_once, webauthn_load_once, NULL,
+	    NULL) == 0) {
+		fido_log_debug("%s: InitOnceExecuteOnce", __func__);
+		return -1;
+	}
+
+	return webauthn_loaded ? 0 : -1;
+}
+
 static wchar_t *
 to_utf16(const char *utf8)
 {
@@ -172,13 +239,13 @@ to_utf16(const char *utf8)
 		fido_log_debug("%s: MultiByteToWideChar %d", __func__, nch);
 		return NULL;
 	}
-	if ((utf16 = calloc((size_t)nch, sizeof(*utf16))) == NULL) {
+	if ((utf16 = fido_calloc((size_t)nch, sizeof(*utf16))) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		return NULL;
 	}
 	if (MultiByteToWideChar(CP_UTF8, 0, utf8, -1, utf16, nch) != nch) {
 		fido_log_debug("%s: MultiByteToWideChar", __func__);
-		free(utf16);
+		fido_free(utf16);
 		return NULL;
 	}
 
@@ -238,7 +305,7 @@ pack_credlist(WEBAUTHN_CREDENTIALS *out, const fido_blob_array_t *in)
 		fido_log_debug("%s: in->len=%zu", __func__, in->len);
 		return -1;
 	}
-	if ((out->pCredentials = calloc(in->len, sizeof(*c))) == NULL) {
+	if ((out->pCredentials = fido_calloc(in->len, sizeof(*c))) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		return -1;
 	}
@@ -402,7 +469,7 @@ pack_cred_ext(WEBAUTHN_EXTENSIONS *out, const fido_cred_ext_t *in)
 		n++;
 	if (in->mask & FIDO_EXT_CRED_PROTECT)
 		n++;
-	if ((out->pExtensions = calloc(n, sizeof(*e))) == NULL) {
+	if ((out->pExtensions = fido_calloc(n, sizeof(*e))) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		return -1;
 	}
@@ -412,7 +479,7 @@ pack_cred_ext(WEBAUTHN_EXTENSIONS *out, const fido_cred_ext_t *in)
 		 * NOTE: webauthn.dll ignores requests to enable hmac-secret
 		 * unless a discoverable credential is also requested.
 		 */
-		if ((b = calloc(1, sizeof(*b))) == NULL) {
+		if ((b = fido_calloc(1, sizeof(*b))) == NULL) {
 			fido_log_debug("%s: calloc", __func__);
 			return -1;
 		}
@@ -425,7 +492,7 @@ pack_cred_ext(WEBAUTHN_EXTENSIONS *out, const fido_cred_ext_t *in)
 		i++;
 	}
 	if (in->mask & FIDO_EXT_CRED_PROTECT) {
-		if ((p = calloc(1, sizeof(*p))) == NULL) {
+		if ((p = fido_calloc(1, sizeof(*p))) == NULL) {
 			fido_log_debug("%s: calloc", __func__);
 			return -1;
 		}
@@ -456,15 +523,21 @@ pack_assert_ext(WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS *out,
 		fido_log_debug("%s: mask 0x%x", __func__, in->mask);
 		return -1;
 	}
+	/* hmac-secret salts need version 6 options */
+	if (webauthn_api_version < WEBAUTHN_API_VERSION_4) {
+		fido_log_debug("%s: api version %lu", __func__,
+		    (u_long)webauthn_api_version);
+		return -1;
+	}
 	if (in->hmac_salt.ptr == NULL ||
 	    in->hmac_salt.len != WEBAUTHN_CTAP_ONE_HMAC_SECRET_LENGTH) {
 		fido_log_debug("%s: salt %p/%zu", __func__,
 		    (const void *)in->hmac_salt.ptr, in->hmac_salt.len);
 		return -1;
 	}
-	if ((v = calloc(1, sizeof(*v))) == NULL ||
-	    (s = calloc(1, sizeof(*s))) == NULL) {
-		free(v);
+	if ((v = fido_calloc(1, sizeof(*v))) == NULL ||
+	    (s = fido_calloc(1, sizeof(*s))) == NULL) {
+		fido_free(v);
 		fido_log_debug("%s: calloc", __func__);
 		return -1;
 	}
@@ -478,25 +551,53 @@ pack_assert_ext(WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS *out,
 	return 0;
 }
 
-static int
-pack_appid(WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS *opt, const char *id,
-    wchar_t **appid)
+void
+fido_winhello_assert_cache_free(fido_assert_t *assert)
 {
-	if (id == NULL)
-		return 0; /* nothing to do */
-	if ((opt->pbU2fAppId = calloc(1, sizeof(*opt->pbU2fAppId))) == NULL) {
+	struct winhello_assert_cache *c;
+
+	if ((c = assert->winhello) == NULL)
+		return;
+
+	fido_free(c->rp_id);
+	fido_free(c->appid);
+	fido_free(c->allow.pCredentials);
+	fido_free(c);
+
+	assert->winhello = NULL;
+}
+
+static const struct winhello_assert_cache *
+assert_cache(fido_assert_t *assert)
+{
+	struct winhello_assert_cache *c;
+
+	if (assert->winhello != NULL)
+		return assert->winhello;
+	if ((c = fido_calloc(1, sizeof(*c))) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
-		return -1;
+		return NULL;
 	}
-	if ((*appid = to_utf16(id)) == NULL) {
-		fido_log_debug("%s:  to_utf16", __func__);
-		return -1;
+	assert->winhello = c;
+	if ((c->rp_id = to_utf16(assert->rp_id)) == NULL) {
+		fido_log_debug("%s: rp_id", __func__);
+		goto fail;
+	}
+	if (assert->appid != NULL && (c->appid = to_utf16(assert->appid)) ==
+	    NULL) {
+		fido_log_debug("%s: appid", __func__);
+		goto fail;
+	}
+	if (pack_credlist(&c->allow, &assert->allow_list) < 0) {
+		fido_log_debug("%s: pack_credlist", __func__);
+		goto fail;
 	}
-	fido_log_debug("%s: using %s", __func__, id);
-	opt->pwszU2fAppId = *appid;
-	opt->dwVersion = WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS_VERSION_2;
 
-	return 0;
+	return c;
+fail:
+	fido_winhello_assert_cache_free(assert);
+
+	return NULL;
 }
 
 static void
@@ -510,9 +611,11 @@ unpack_appid(fido_assert_t *assert,
 		return;
 	}
 	fido_log_debug("%s: %s -> %s", __func__, assert->rp_id, assert->appid);
-	free(assert->rp_id);
+	fido_free(assert->rp_id);
+	fido_blob_reset(&assert->rp_id_hash); /* stale */
 	assert->rp_id = assert->appid;
 	assert->appid = NULL;
+	fido_winhello_assert_cache_free(assert); /* stale */
 }
 
 static int
@@ -604,20 +707,22 @@ unpack_hmac_secret(fido_assert_t *assert, const WEBAUTHN_ASSERTION *wa)
 }
 
 static int
-translate_fido_assert(struct winhello_assert *ctx, const fido_assert_t *assert,
+translate_fido_assert(struct winhello_assert *ctx, fido_assert_t *assert,
     const char *pin, int ms)
 {
-	WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS *opt;
+	WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS	*opt;
+	const struct winhello_assert_cache		*c;
 
 	/* not supported by webauthn.h */
 	if (assert->up == FIDO_OPT_FALSE) {
 		fido_log_debug("%s: up %d", __func__, assert->up);
 		return FIDO_ERR_UNSUPPORTED_OPTION;
 	}
-	if ((ctx->rp_id = to_utf16(assert->rp_id)) == NULL) {
-		fido_log_debug("%s: rp_id", __func__);
+	if ((c = assert_cache(assert)) == NULL) {
+		fido_log_debug("%s: assert_cache", __func__);
 		return FIDO_ERR_INTERNAL;
 	}
+	ctx->rp_id = c->rp_id;
 	if (pack_cd(&ctx->cd, &assert->cd) < 0) {
 		fido_log_debug("%s: pack_cd", __func__);
 		return FIDO_ERR_INTERNAL;
@@ -626,14 +731,14 @@ translate_fido_assert(struct winhello_assert *ctx, const fido_assert_t *assert,
 	opt = &ctx->opt;
 	opt->dwVersion = WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS_VERSION_1;
 	opt->dwTimeoutMilliseconds = ms < 0 ? MAXMSEC : (DWORD)ms;
-	if (pack_appid(opt, assert->appid, &ctx->appid) < 0) {
-		fido_log_debug("%s: pack_appid" , __func__);
-		return FIDO_ERR_INTERNAL;
-	}
-	if (pack_credlist(&opt->CredentialList, &assert->allow_list) < 0) {
-		fido_log_debug("%s: pack_credlist", __func__);
-		return FIDO_ERR_INTERNAL;
-	}
+	if (c->appid != NULL) {
+		fido_log_debug("%s: using %s", __func__, assert->appid);
+		opt->pbU2fAppId = &ctx->appid_used;
+		opt->pwszU2fAppId = c->appid;
+		opt->dwVersion =
+		    WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS_VERSION_2;
+	}
+	opt->CredentialList = c->allow; /* borrowed */
 	if (pack_assert_ext(opt, &assert->ext) < 0) {
 		fido_log_debug("%s: pack_assert_ext", __func__);
 		return FIDO_ERR_UNSUPPORTED_EXTENSION;
@@ -751,7 +856,7 @@ translate_winhello_cred(fido_cred_t *cred,
 		fido_log_debug("%s: pbAttestationObject", __func__);
 		goto fail;
 	}
-	if ((item = cbor_load(att->pbAttestationObject,
+	if ((item = cbor_load_ctap(att->pbAttestationObject,
 	    att->cbAttestationObject, &cbor)) == NULL) {
 		fido_log_debug("%s: cbor_load", __func__);
 		goto fail;
@@ -809,13 +914,10 @@ winhello_assert_free(struct winhello_assert *ctx)
 	if (ctx->assert != NULL)
 		webauthn_free_assert(ctx->assert);
 
-	free(ctx->rp_id);
-	free(ctx->appid);
-	free(ctx->opt.CredentialList.pCredentials);
 	if (ctx->opt.pHmacSecretSaltValues != NULL)
-		free(ctx->opt.pHmacSecretSaltValues->pGlobalHmacSalt);
-	free(ctx->opt.pHmacSecretSaltValues);
-	free(ctx);
+		fido_free(ctx->opt.pHmacSecretSaltValues->pGlobalHmacSalt);
+	fido_free(ctx->opt.pHmacSecretSaltValues);
+	fido_free(ctx);
 }
 
 static void
@@ -826,19 +928,114 @@ winhello_cred_free(struct winhello_cred *ctx)
 	if (ctx->att != NULL)
 		webauthn_free_attest(ctx->att);
 
-	free(ctx->rp_id);
-	free(ctx->rp_name);
-	free(ctx->user_name);
-	free(ctx->user_icon);
-	free(ctx->display_name);
-	free(ctx->opt.CredentialList.pCredentials);
+	fido_free(ctx->rp_id);
+	fido_free(ctx->rp_name);
+	fido_free(ctx->user_name);
+	fido_free(ctx->user_icon);
+	fido_free(ctx->display_name);
+	fido_free(ctx->opt.CredentialList.pCredentials);
 	for (size_t i = 0; i < ctx->opt.Extensions.cExtensions; i++) {
 		WEBAUTHN_EXTENSION *e;
 		e = &ctx->opt.Extensions.pExtensions[i];
-		free(e->pvExtension);
+		fido_free(e->pvExtension);
+	}
+	fido_free(ctx->opt.Extensions.pExtensions);
+	fido_free(ctx);
+}
+
+static int
+winhello_window(HWND *w)
+{
+	if ((*w = GetForegroundWindow()) == NULL) {
+		fido_log_debug("%s: GetForegroundWindow", __func__);
+		if ((*w = GetTopWindow(NULL)) == NULL) {
+			fido_log_debug("%s: GetTopWindow", __func__);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* ask webauthn.dll to let 'opt' be cancelled through op->cancel_id */
+static GUID *
+winhello_op_cancel_id(struct winhello_op *op)
+{
+	HRESULT hr;
+
+	if (webauthn_get_cancel_id == NULL)
+		return NULL;
+	if ((hr = webauthn_get_cancel_id(&op->cancel_id)) != S_OK) {
+		fido_log_debug("%s: %ls", __func__, webauthn_strerr(hr));
+		return NULL;
+	}
+	op->cancellable = true;
+
+	return &op->cancel_id;
+}
+
+static DWORD WINAPI
+winhello_op_main(LPVOID arg)
+{
+	struct winhello_op *op = arg;
+
+	if (op->assert != NULL)
+		op->r = winhello_get_assert(op->w, op->assert);
+	else
+		op->r = winhello_make_cred(op->w, op->cred);
+
+	return 0;
+}
+
+static int
+winhello_op_start(fido_dev_t *dev, struct winhello_op *op)
+{
+	if ((op->thread = CreateThread(NULL, 0, winhello_op_main, op, 0,
+	    NULL)) == NULL) {
+		fido_log_debug("%s: CreateThread", __func__);
+		return FIDO_ERR_INTERNAL;
 	}
-	free(ctx->opt.Extensions.pExtensions);
-	free(ctx);
+	dev->winhello_op = op;
+
+	return FIDO_OK;
+}
+
+/* wait for the worker, and take its request off 'dev' */
+static struct winhello_op *
+winhello_op_join(fido_dev_t *dev)
+{
+	struct winhello_op *op;
+
+	if ((op = dev->winhello_op) == NULL)
+		return NULL;
+	if (WaitForSingleObject(op->thread, INFINITE) != WAIT_OBJECT_0)
+		fido_log_debug("%s: WaitForSingleObject", __func__);
+	CloseHandle(op->thread);
+	dev->winhello_op = NULL;
+
+	return op;
+}
+
+static void
+winhello_op_free(struct winhello_op *op)
+{
+	if (op == NULL)
+		return;
+
+	winhello_assert_free(op->assert);
+	winhello_cred_free(op->cred);
+	fido_free(op);
+}
+
+/* cancel the request pending on 'dev', if any, and discard it */
+static void
+winhello_op_abort(fido_dev_t *dev)
+{
+	if (dev->winhello_op == NULL)
+		return;
+
+	(void)fido_winhello_cancel(dev);
+	winhello_op_free(winhello_op_join(dev));
 }
 
 int
@@ -852,23 +1049,23 @@ fido_winhello_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 	if (devlist == NULL) {
 		return FIDO_ERR_INVALID_ARGUMENT;
 	}
-	if (!webauthn_loaded && webauthn_load() < 0) {
-		fido_log_debug("%s: webauthn_load", __func__);
+	if (webauthn_init() < 0) {
+		fido_log_debug("%s: webauthn_init", __func__);
 		return FIDO_OK; /* not an error */
 	}
 
 	di = &devlist[*olen];
 	memset(di, 0, sizeof(*di));
-	di->path = strdup(FIDO_WINHELLO_PATH);
-	di->manufacturer = strdup("Microsoft Corporation");
-	di->product = strdup("Windows Hello");
+	di->path = fido_strdup(FIDO_WINHELLO_PATH);
+	di->manufacturer = fido_strdup("Microsoft Corporation");
+	di->product = fido_strdup("Windows Hello");
 	di->vendor_id = VENDORID;
 	di->product_id = PRODID;
 	if (di->path == NULL || di->manufacturer == NULL ||
 	    di->product == NULL) {
-		free(di->path);
-		free(di->manufacturer);
-		free(di->product);
+		fido_free(di->path);
+		fido_free(di->manufacturer);
+		fido_free(di->product);
 		explicit_bzero(di, sizeof(*di));
 		return FIDO_ERR_INTERNAL;
 	}
@@ -880,8 +1077,8 @@ fido_winhello_manifest(fido_dev_info_t *devlist, size_t ilen, size_t *olen)
 int
 fido_winhello_open(fido_dev_t *dev)
 {
-	if (!webauthn_loaded && webauthn_load() < 0) {
-		fido_log_debug("%s: webauthn_load", __func__);
+	if (webauthn_init() < 0) {
+		fido_log_debug("%s: webauthn_init", __func__);
 		return FIDO_ERR_INTERNAL;
 	}
 	if (dev->flags != 0)
@@ -895,6 +1092,7 @@ fido_winhello_open(fido_dev_t *dev)
 int
 fido_winhello_close(fido_dev_t *dev)
 {
+	winhello_op_abort(dev);
 	memset(dev, 0, sizeof(*dev));
 
 	return FIDO_OK;
@@ -903,9 +1101,20 @@ fido_winhello_close(fido_dev_t *dev)
 int
 fido_winhello_cancel(fido_dev_t *dev)
 {
-	(void)dev;
+	const struct winhello_op	*op = dev->winhello_op;
+	HRESULT				 hr;
 
-	return FIDO_ERR_INTERNAL;
+	/* only submitted requests can be cancelled */
+	if (op == NULL || op->cancellable == false) {
+		fido_log_debug("%s: op=%p", __func__, (const void *)op);
+		return FIDO_ERR_INTERNAL;
+	}
+	if ((hr = webauthn_cancel(&op->cancel_id)) != S_OK) {
+		fido_log_debug("%s: %ls", __func__, webauthn_strerr(hr));
+		return FIDO_ERR_INTERNAL;
+	}
+
+	return FIDO_OK;
 }
 
 int
@@ -920,16 +1129,13 @@ fido_winhello_get_assert(fido_dev_t *dev, fido_assert_t *assert,
 
 	fido_assert_reset_rx(assert);
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL) {
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		goto fail;
 	}
-	if ((w = GetForegroundWindow()) == NULL) {
-		fido_log_debug("%s: GetForegroundWindow", __func__);
-		if ((w = GetTopWindow(NULL)) == NULL) {
-			fido_log_debug("%s: GetTopWindow", __func__);
-			goto fail;
-		}
+	if (winhello_window(&w) < 0) {
+		fido_log_debug("%s: winhello_window", __func__);
+		goto fail;
 	}
 	if ((r = translate_fido_assert(ctx, assert, pin, ms)) != FIDO_OK) {
 		fido_log_debug("%s: translate_fido_assert", __func__);
@@ -950,36 +1156,39 @@ fail:
 	return r;
 }
 
+/*
+ * The getInfo reply webauthn.dll stands for: versions U2F_V2, FIDO_2_0 and
+ * FIDO_2_1_PRE; extensions credProtect and hmac-secret; options rk, up, uv
+ * and plat; transports nfc and usb.
+ */
+static const unsigned char winhello_info[] = {
+	0x00, 0xa4, 0x01, 0x83, 0x66, 0x55, 0x32, 0x46,
+	0x5f, 0x56, 0x32, 0x68, 0x46, 0x49, 0x44, 0x4f,
+	0x5f, 0x32, 0x5f, 0x30, 0x6c, 0x46, 0x49, 0x44,
+	0x4f, 0x5f, 0x32, 0x5f, 0x31, 0x5f, 0x50, 0x52,
+	0x45, 0x02, 0x82, 0x6b, 0x63, 0x72, 0x65, 0x64,
+	0x50, 0x72, 0x6f, 0x74, 0x65, 0x63, 0x74, 0x6b,
+	0x68, 0x6d, 0x61, 0x63, 0x2d, 0x73, 0x65, 0x63,
+	0x72, 0x65, 0x74, 0x04, 0xa4, 0x62, 0x72, 0x6b,
+	0xf5, 0x62, 0x75, 0x70, 0xf5, 0x62, 0x75, 0x76,
+	0xf5, 0x64, 0x70, 0x6c, 0x61, 0x74, 0xf5, 0x09,
+	0x82, 0x63, 0x6e, 0x66, 0x63, 0x63, 0x75, 0x73,
+	0x62,
+};
+
 int
 fido_winhello_get_cbor_info(fido_dev_t *dev, fido_cbor_info_t *ci)
 {
-	const char *v[3] = { "U2F_V2", "FIDO_2_0", "FIDO_2_1_PRE" };
-	const char *e[2] = { "credProtect", "hmac-secret" };
-	const char *t[2] = { "nfc", "usb" };
-	const char *o[4] = { "rk", "up", "uv", "plat" };
+	int r;
 
 	(void)dev;
 
 	fido_cbor_info_reset(ci);
 
-	if (fido_str_array_pack(&ci->versions, v, nitems(v)) < 0 ||
-	    fido_str_array_pack(&ci->extensions, e, nitems(e)) < 0 ||
-	    fido_str_array_pack(&ci->transports, t, nitems(t)) < 0) {
-		fido_log_debug("%s: fido_str_array_pack", __func__);
-		return FIDO_ERR_INTERNAL;
-	}
-	if ((ci->options.name = calloc(nitems(o), sizeof(char *))) == NULL ||
-	    (ci->options.value = calloc(nitems(o), sizeof(bool))) == NULL) {
-		fido_log_debug("%s: calloc", __func__);
-		return FIDO_ERR_INTERNAL;
-	}
-	for (size_t i = 0; i < nitems(o); i++) {
-		if ((ci->options.name[i] = strdup(o[i])) == NULL) {
-			fido_log_debug("%s: strdup", __func__);
-			return FIDO_ERR_INTERNAL;
-		}
-		ci->options.value[i] = true;
-		ci->options.len++;
+	if ((r = fido_cbor_info_decode(ci, winhello_info,
+	    sizeof(winhello_info))) != FIDO_OK) {
+		fido_log_debug("%s: fido_cbor_info_decode", __func__);
+		return r;
 	}
 
 	return FIDO_OK;
@@ -997,16 +1206,13 @@ fido_winhello_make_cred(fido_dev_t *dev, fido_cred_t *cred, const char *pin,
 
 	fido_cred_reset_rx(cred);
 
-	if ((ctx = calloc(1, sizeof(*ctx))) == NULL) {
+	if ((ctx = fido_calloc(1, sizeof(*ctx))) == NULL) {
 		fido_log_debug("%s: calloc", __func__);
 		goto fail;
 	}
-	if ((w = GetForegroundWindow()) == NULL) {
-		fido_log_debug("%s: GetForegroundWindow", __func__);
-		if ((w = GetTopWindow(NULL)) == NULL) {
-			fido_log_debug("%s: GetTopWindow", __func__);
-			goto fail;
-		}
+	if (winhello_window(&w) < 0) {
+		fido_log_debug("%s: winhello_window", __func__);
+		goto fail;
 	}
 	if ((r = translate_fido_cred(ctx, cred, pin, ms)) != FIDO_OK) {
 		fido_log_debug("%s: translate_fido_cred", __func__);
@@ -1027,3 +1233,155 @@ fail:
 
 	return r;
 }
+
+int
+fido_winhello_get_assert_submit(fido_dev_t *dev, fido_assert_t *assert,
+    const char *pin, int ms)
+{
+	struct winhello_op	*op;
+	int			 r = FIDO_ERR_INTERNAL;
+
+	winhello_op_abort(dev);
+	fido_assert_reset_rx(assert);
+
+	if ((op = fido_calloc(1, sizeof(*op))) == NULL ||
+	    (op->assert = fido_calloc(1, sizeof(*op->assert))) == NULL) {
+		fido_log_debug("%s: calloc", __func__);
+		goto fail;
+	}
+	if (winhello_window(&op->w) < 0) {
+		fido_log_debug("%s: winhello_window", __func__);
+		goto fail;
+	}
+	if ((r = translate_fido_assert(op->assert, assert, pin,
+	    ms)) != FIDO_OK) {
+		fido_log_debug("%s: translate_fido_assert", __func__);
+		goto fail;
+	}
+	if ((op->assert->opt.pCancellationId = winhello_op_cancel_id(op)) !=
+	    NULL && op->assert->opt.dwVersion <
+	    WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS_VERSION_3)
+		op->assert->opt.dwVersion =
+		    WEBAUTHN_AUTHENTICATOR_GET_ASSERTION_OPTIONS_VERSION_3;
+	if ((r = winhello_op_start(dev, op)) != FIDO_OK) {
+		fido_log_debug("%s: winhello_op_start", __func__);
+		goto fail;
+	}
+
+	return FIDO_OK;
+fail:
+	winhello_op_free(op);
+
+	return r;
+}
+
+int
+fido_winhello_get_assert_complete(fido_dev_t *dev, fido_assert_t *assert)
+{
+	struct winhello_op	*op = dev->winhello_op;
+	int			 r;
+
+	if (op == NULL || op->assert == NULL) {
+		fido_log_debug("%s: op=%p", __func__, (void *)op);
+		return FIDO_ERR_INVALID_ARGUMENT;
+	}
+
+	op = winhello_op_join(dev);
+	if ((r = op->r) == FIDO_OK &&
+	    (r = translate_winhello_assert(assert, op->assert)) != FIDO_OK)
+		fido_log_debug("%s: translate_winhello_assert", __func__);
+	winhello_op_free(op);
+
+	return r;
+}
+
+int
+fido_winhello_make_cred_submit(fido_dev_t *dev, fido_cred_t *cred,
+    const char *pin, int ms)
+{
+	struct winhello_op	*op;
+	int			 r = FIDO_ERR_INTERNAL;
+
+	winhello_op_abort(dev);
+	fido_cred_reset_rx(cred);
+
+	if ((op = fido_calloc(1, sizeof(*op))) == NULL ||
+	    (op->cred = fido_calloc(1, sizeof(*op->cred))) == NULL) {
+		fido_log_debug("%s: calloc", __func__);
+		goto fail;
+	}
+	if (winhello_window(&op->w) < 0) {
+		fido_log_debug("%s: winhello_window", __func__);
+		goto fail;
+	}
+	if ((r = translate_fido_cred(op->cred, cred, pin, ms)) != FIDO_OK) {
+		fido_log_debug("%s: translate_fido_cred", __func__);
+		goto fail;
+	}
+	if ((op->cred->opt.pCancellationId = winhello_op_cancel_id(op)) !=
+	    NULL && op->cred->opt.dwVersion <
+	    WEBAUTHN_AUTHENTICATOR_MAKE_CREDENTIAL_OPTIONS_VERSION_2)
+		op->cred->opt.dwVersion =
+		    WEBAUTHN_AUTHENTICATOR_MAKE_CREDENTIAL_OPTIONS_VERSION_2;
+	if ((r = winhello_op_start(dev, op)) != FIDO_OK) {
+		fido_log_debug("%s: winhello_op_start", __func__);
+		goto fail;
+	}
+
+	return FIDO_OK;
+fail:
+	winhello_op_free(op);
+
+	return r;
+}
+
+int
+fido_winhello_make_cred_complete(fido_dev_t *dev, fido_cred_t *cred)
+{
+	struct winhello_op	*op = dev->winhello_op;
+	int			 r;
+
+	if (op == NULL || op->cred == NULL) {
+		fido_log_debug("%s: op=%p", __func__, (void *)op);
+		return FIDO_ERR_INVALID_ARGUMENT;
+	}
+
+	op = winhello_op_join(dev);
+	if ((r = op->r) == FIDO_OK &&
+	    (r = translate_winhello_cred(cred, op->cred->att)) != FIDO_OK)
+		fido_log_debug("%s: translate_winhello_cred", __func__);
+	winhello_op_free(op);
+
+	return r;
+}
+
+int
+fido_winhello_poll(fido_dev_t *dev, int ms)
+{
+	const struct winhello_op *op = dev->winhello_op;
+
+	if (op == NULL) {
+		fido_log_debug("%s: no request", __func__);
+		return FIDO_ERR_INVALID_ARGUMENT;
+	}
+
+	switch (WaitForSingleObject(op->thread, ms < 0 ? INFINITE :
+	    (DWORD)ms)) {
+	case WAIT_OBJECT_0:
+		return FIDO_OK;
+	case WAIT_TIMEOUT:
+		return FIDO_ERR_TIMEOUT;
+	default:
+		fido_log_debug("%s: WaitForSingleObject", __func__);
+		return FIDO_ERR_INTERNAL;
+	}
+}
+
+/* the worker thread of the pending request, signalled once it is done */
+void *
+fido_winhello_handle(const fido_dev_t *dev)
+{
+	const struct winhello_op *op = dev->winhello_op;
+
+	return op != NULL ? op->thread : NULL;
+}
@@ -208,6 +208,76 @@ print_assert(FILE *out_f, const fido_assert_t *assert, size_t idx, int flags)
 	free(user_id);
 }
 
+static int
+cmp_usec(const void *a, const void *b)
+{
+	const long long x = *(const long long *)a;
+	const long long y = *(const long long *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * Make 'count' assertions on the open device, varying the client data
+ * hash in each, and report their latency in microseconds on stderr.
+ * The assertions of the last iteration are left in 'assert'.
+ */
+static int
+bench_assert(fido_dev_t *dev, fido_assert_t *assert, const char *pin,
+    size_t count)
+{
+	struct timespec	 t0, t1;
+	unsigned char	*base;
+	unsigned char	*cdh;
+	long long	*usec;
+	long long	 total = 0;
+	size_t		 len;
+	int		 r;
+
+	len = fido_assert_clientdata_hash_len(assert);
+	if ((base = malloc(len)) == NULL || (cdh = malloc(len)) == NULL ||
+	    (usec = calloc(count, sizeof(*usec))) == NULL)
+		errx(1, "malloc");
+	memcpy(base, fido_assert_clientdata_hash_ptr(assert), len);
+
+	for (size_t i = 0; i < count; i++) {
+		/* a different challenge per iteration */
+		memcpy(cdh, base, len);
+		for (size_t j = 0; j < sizeof(i) && j < len; j++)
+			cdh[j] ^= (unsigned char)(i >> (8 * j));
+		if ((r = fido_assert_set_clientdata_hash(assert, cdh,
+		    len)) != FIDO_OK)
+			errx(1, "fido_assert_set_clientdata_hash: %s",
+			    fido_strerr(r));
+		if (clock_gettime(CLOCK_MONOTONIC, &t0) != 0)
+			err(1, "clock_gettime");
+		if ((r = fido_dev_get_assert(dev, assert, pin)) != FIDO_OK) {
+			warnx("iteration %zu", i);
+			goto out;
+		}
+		if (clock_gettime(CLOCK_MONOTONIC, &t1) != 0)
+			err(1, "clock_gettime");
+		timespecsub(&t1, &t0, &t1);
+		usec[i] = (long long)t1.tv_sec * 1000000 + t1.tv_nsec / 1000;
+		total += usec[i];
+	}
+
+	qsort(usec, count, sizeof(*usec), cmp_usec);
+
+	fprintf(stderr, "%6s %8s %8s %8s %8s %8s %8s %8s\n", "count", "min",
+	    "mean", "p50", "p90", "p99", "max", "sig/s");
+	fprintf(stderr, "%6zu %8lld %8lld %8lld %8lld %8lld %8lld %8.1f\n",
+	    count, usec[0], total / (long long)count, usec[count / 2],
+	    usec[count * 9 / 10], usec[count * 99 / 100], usec[count - 1],
+	    total > 0 ? (double)count * 1000000 / (double)total : 0.0);
+out:
+	free(usec);
+	free(cdh);
+	free(base);
+
+	return (r);
+}
+
 int
 assert_get(int argc, char **argv)
 {
@@ -216,17 +286,19 @@ assert_get(int argc, char **argv)
 	struct toggle opt;
 	char prompt[1024];
 	char pin[128];
+	char *pinp = NULL;
 	char *in_path = NULL;
 	char *out_path = NULL;
 	FILE *in_f = NULL;
 	FILE *out_f = NULL;
 	int flags = 0;
+	int count = 0;
 	int ch;
 	int r;
 
 	opt.up = opt.uv = opt.pin = FIDO_OPT_OMIT;
 
-	while ((ch = getopt(argc, argv, "bdhi:o:prt:uvw")) != -1) {
+	while ((ch = getopt(argc, argv, "bdhi:n:o:prt:uvw")) != -1) {
 		switch (ch) {
 		case 'b':
 			flags |= FLAG_LARGEBLOB;
@@ -240,6 +312,10 @@ assert_get(int argc, char **argv)
 		case 'i':
 			in_path = optarg;
 			break;
+		case 'n':
+			if ((count = base10(optarg)) < 1)
+				errx(1, "-n: invalid count %s", optarg);
+			break;
 		case 'o':
 			out_path = optarg;
 			break;
@@ -271,7 +347,7 @@ assert_get(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
-	if (argc < 1)
+	if (argc < 1 || (count > 0 && (flags & FLAG_CD)))
 		usage();
 
 	in_f = open_read(in_path);
@@ -296,9 +372,13 @@ assert_get(int argc, char **argv)
 			explicit_bzero(pin, sizeof(pin));
 			errx(1, "invalid PIN length");
 		}
-		r = fido_dev_get_assert(dev, assert, pin);
-	} else
-		r = fido_dev_get_assert(dev, assert, NULL);
+		pinp = pin;
+	}
+
+	if (count > 0)
+		r = bench_assert(dev, assert, pinp, (size_t)count);
+	else
+		r = fido_dev_get_assert(dev, assert, pinp);
 
 	explicit_bzero(pin, sizeof(pin));
 
@@ -21,64 +21,89 @@
 #include "../openbsd-compat/openbsd-compat.h"
 #include "extern.h"
 
-static fido_assert_t *
-prepare_assert(FILE *in_f, int flags)
+/* records verified per worker in each round of a batch */
+#define BATCH_CHUNK	64
+
+struct verify_rec {
+	char *key_name;
+	const fido_pk_t *key; /* NULL if the key could not be loaded */
+	fido_assert_t *assert;
+	int r;
+};
+
+static void
+read_assert(FILE *in_f, int flags, struct blob *cdh, char **rpid,
+    struct blob *authdata, struct blob *sig)
 {
-	fido_assert_t *assert = NULL;
-	struct blob cdh;
-	struct blob authdata;
-	struct blob sig;
-	char *rpid = NULL;
 	int r;
 
-	memset(&cdh, 0, sizeof(cdh));
-	memset(&authdata, 0, sizeof(authdata));
-	memset(&sig, 0, sizeof(sig));
+	memset(cdh, 0, sizeof(*cdh));
+	memset(authdata, 0, sizeof(*authdata));
+	memset(sig, 0, sizeof(*sig));
 
-	r = base64_read(in_f, &cdh);
-	r |= string_read(in_f, &rpid);
-	r |= base64_read(in_f, &authdata);
-	r |= base64_read(in_f, &sig);
+	r = base64_read(in_f, cdh);
+	r |= string_read(in_f, rpid);
+	r |= base64_read(in_f, authdata);
+	r |= base64_read(in_f, sig);
 	if (r < 0)
 		errx(1, "input error");
 
 	if (flags & FLAG_DEBUG) {
 		fprintf(stderr, "client data hash:\n");
-		xxd(cdh.ptr, cdh.len);
-		fprintf(stderr, "relying party id: %s\n", rpid);
+		xxd(cdh->ptr, cdh->len);
+		fprintf(stderr, "relying party id: %s\n", *rpid);
 		fprintf(stderr, "authenticator data:\n");
-		xxd(authdata.ptr, authdata.len);
+		xxd(authdata->ptr, authdata->len);
 		fprintf(stderr, "signature:\n");
-		xxd(sig.ptr, sig.len);
+		xxd(sig->ptr, sig->len);
 	}
+}
 
-	if ((assert = fido_assert_new()) == NULL)
-		errx(1, "fido_assert_new");
-	if ((r = fido_assert_set_count(assert, 1)) != FIDO_OK)
-		errx(1, "fido_assert_count: %s", fido_strerr(r));
+static int
+set_assert(fido_assert_t *assert, const struct blob *cdh, const char *rpid,
+    const struct blob *authdata, const struct blob *sig, int flags)
+{
+	int r;
 
-	if ((r = fido_assert_set_clientdata_hash(assert, cdh.ptr,
-	    cdh.len)) != FIDO_OK ||
+	if ((r = fido_assert_set_count(assert, 1)) != FIDO_OK ||
+	    (r = fido_assert_set_clientdata_hash(assert, cdh->ptr,
+	    cdh->len)) != FIDO_OK ||
 	    (r = fido_assert_set_rp(assert, rpid)) != FIDO_OK ||
-	    (r = fido_assert_set_authdata(assert, 0, authdata.ptr,
-	    authdata.len)) != FIDO_OK ||
-	    (r = fido_assert_set_sig(assert, 0, sig.ptr, sig.len)) != FIDO_OK)
-		errx(1, "fido_assert_set: %s", fido_strerr(r));
+	    (r = fido_assert_set_authdata(assert, 0, authdata->ptr,
+	    authdata->len)) != FIDO_OK ||
+	    (r = fido_assert_set_sig(assert, 0, sig->ptr, sig->len)) != FIDO_OK)
+		return (r);
 
-	if (flags & FLAG_UP) {
-		if ((r = fido_assert_set_up(assert, FIDO_OPT_TRUE)) != FIDO_OK)
-			errx(1, "fido_assert_set_up: %s", fido_strerr(r));
-	}
-	if (flags & FLAG_UV) {
-		if ((r = fido_assert_set_uv(assert, FIDO_OPT_TRUE)) != FIDO_OK)
-			errx(1, "fido_assert_set_uv: %s", fido_strerr(r));
-	}
-	if (flags & FLAG_HMAC) {
-		if ((r = fido_assert_set_extensions(assert,
-		    FIDO_EXT_HMAC_SECRET)) != FIDO_OK)
-			errx(1, "fido_assert_set_extensions: %s",
-			    fido_strerr(r));
-	}
+	if ((flags & FLAG_UP) && (r = fido_assert_set_up(assert,
+	    FIDO_OPT_TRUE)) != FIDO_OK)
+		return (r);
+	if ((flags & FLAG_UV) && (r = fido_assert_set_uv(assert,
+	    FIDO_OPT_TRUE)) != FIDO_OK)
+		return (r);
+	if ((flags & FLAG_HMAC) && (r = fido_assert_set_extensions(assert,
+	    FIDO_EXT_HMAC_SECRET)) != FIDO_OK)
+		return (r);
+
+	return (FIDO_OK);
+}
+
+static fido_assert_t *
+prepare_assert(FILE *in_f, int flags)
+{
+	fido_assert_t *assert = NULL;
+	struct blob cdh;
+	struct blob authdata;
+	struct blob sig;
+	char *rpid = NULL;
+	int r;
+
+	read_assert(in_f, flags, &cdh, &rpid, &authdata, &sig);
+
+	if ((assert = fido_assert_new()) == NULL)
+		errx(1, "fido_assert_new");
+	if ((r = set_assert(assert, &cdh, rpid, &authdata, &sig,
+	    flags)) != FIDO_OK)
+		errx(1, "fido_assert_set: %s", fido_strerr(r));
 
 	free(cdh.ptr);
 	free(authdata.ptr);
@@ -88,6 +113,7 @@ prepare_assert(FILE *in_f, int flags)
 	return (assert);
 }
 
+/* NULL, with a warning, if 'file' does not hold a key of type 'type' */
 static void *
 load_pubkey(int type, const char *file)
 {
@@ -103,41 +129,49 @@ load_pubkey(int type, const char *file)
 	switch (type) {
 	case COSE_ES256:
 		if ((ec = read_ec_pubkey(file)) == NULL)
-			errx(1, "read_ec_pubkey");
-		if ((es256_pk = es256_pk_new()) == NULL)
-			errx(1, "es256_pk_new");
-		if (es256_pk_from_EC_KEY(es256_pk, ec) != FIDO_OK)
-			errx(1, "es256_pk_from_EC_KEY");
+			warnx("read_ec_pubkey");
+		else if ((es256_pk = es256_pk_new()) == NULL)
+			warnx("es256_pk_new");
+		else if (es256_pk_from_EC_KEY(es256_pk, ec) != FIDO_OK) {
+			warnx("es256_pk_from_EC_KEY");
+			es256_pk_free(&es256_pk);
+		}
 		pk = es256_pk;
 		EC_KEY_free(ec);
 		break;
 	case COSE_ES384:
 		if ((ec = read_ec_pubkey(file)) == NULL)
-			errx(1, "read_ec_pubkey");
-		if ((es384_pk = es384_pk_new()) == NULL)
-			errx(1, "es384_pk_new");
-		if (es384_pk_from_EC_KEY(es384_pk, ec) != FIDO_OK)
-			errx(1, "es384_pk_from_EC_KEY");
+			warnx("read_ec_pubkey");
+		else if ((es384_pk = es384_pk_new()) == NULL)
+			warnx("es384_pk_new");
+		else if (es384_pk_from_EC_KEY(es384_pk, ec) != FIDO_OK) {
+			warnx("es384_pk_from_EC_KEY");
+			es384_pk_free(&es384_pk);
+		}
 		pk = es384_pk;
 		EC_KEY_free(ec);
 		break;
 	case COSE_RS256:
 		if ((rsa = read_rsa_pubkey(file)) == NULL)
-			errx(1, "read_rsa_pubkey");
-		if ((rs256_pk = rs256_pk_new()) == NULL)
-			errx(1, "rs256_pk_new");
-		if (rs256_pk_from_RSA(rs256_pk, rsa) != FIDO_OK)
-			errx(1, "rs256_pk_from_RSA");
+			warnx("read_rsa_pubkey");
+		else if ((rs256_pk = rs256_pk_new()) == NULL)
+			warnx("rs256_pk_new");
+		else if (rs256_pk_from_RSA(rs256_pk, rsa) != FIDO_OK) {
+			warnx("rs256_pk_from_RSA");
+			rs256_pk_free(&rs256_pk);
+		}
 		pk = rs256_pk;
 		RSA_free(rsa);
 		break;
 	case COSE_EDDSA:
 		if ((eddsa = read_eddsa_pubkey(file)) == NULL)
-			errx(1, "read_eddsa_pubkey");
-		if ((eddsa_pk = eddsa_pk_new()) == NULL)
-			errx(1, "eddsa_pk_new");
-		if (eddsa_pk_from_EVP_PKEY(eddsa_pk, eddsa) != FIDO_OK)
-			errx(1, "eddsa_pk_from_EVP_PKEY");
+			warnx("read_eddsa_pubkey");
+		else if ((eddsa_pk = eddsa_pk_new()) == NULL)
+			warnx("eddsa_pk_new");
+		else if (eddsa_pk_from_EVP_PKEY(eddsa_pk, eddsa) != FIDO_OK) {
+			warnx("eddsa_pk_from_EVP_PKEY");
+			eddsa_pk_free(&eddsa_pk);
+		}
 		pk = eddsa_pk;
 		EVP_PKEY_free(eddsa);
 		break;
@@ -148,20 +182,197 @@ load_pubkey(int type, const char *file)
 	return (pk);
 }
 
+static void
+free_pubkey(int type, void *pk)
+{
+	es256_pk_t *es256_pk;
+	es384_pk_t *es384_pk;
+	rs256_pk_t *rs256_pk;
+	eddsa_pk_t *eddsa_pk;
+
+	switch (type) {
+	case COSE_ES256:
+		es256_pk = pk;
+		es256_pk_free(&es256_pk);
+		break;
+	case COSE_ES384:
+		es384_pk = pk;
+		es384_pk_free(&es384_pk);
+		break;
+	case COSE_RS256:
+		rs256_pk = pk;
+		rs256_pk_free(&rs256_pk);
+		break;
+	case COSE_EDDSA:
+		eddsa_pk = pk;
+		eddsa_pk_free(&eddsa_pk);
+		break;
+	}
+}
+
+static void
+free_prepared(void *arg)
+{
+	fido_pk_t *pk = arg;
+
+	fido_pk_free(&pk);
+}
+
+/* the key named 'name' in 'dir', decoded once and cached; NULL on error */
+static const fido_pk_t *
+get_pubkey(struct cache *keys, const char *dir, int type, const char *name)
+{
+	fido_pk_t *key = NULL;
+	char *path = NULL;
+	void *pk = NULL;
+	int r;
+
+	if (cache_get(keys, name, strlen(name), (void **)&key) == 0)
+		return (key);
+
+	/* key names are file names, not paths */
+	if (*name == '\0' || *name == '.' || strpbrk(name, "/\\") != NULL)
+		warnx("invalid key name %s", name);
+	else if (asprintf(&path, "%s/%s", dir, name) == -1)
+		errx(1, "asprintf");
+	else if ((pk = load_pubkey(type, path)) == NULL)
+		warnx("could not load key %s", path);
+	else if ((key = fido_pk_new()) == NULL)
+		errx(1, "fido_pk_new");
+	else if ((r = fido_pk_set(key, type, pk)) != FIDO_OK) {
+		warnx("fido_pk_set %s: %s", path, fido_strerr(r));
+		fido_pk_free(&key);
+	}
+	free_pubkey(type, pk);
+	free(path);
+
+	/* failures are cached as well */
+	if (cache_put(keys, name, strlen(name), key) < 0)
+		errx(1, "cache_put");
+
+	return (key);
+}
+
+/* read the next record into 'rec'; 0 at the end of the input */
+static int
+read_rec(FILE *in_f, int flags, struct cache *keys, const char *dir,
+    int type, struct verify_rec *rec)
+{
+	struct blob cdh;
+	struct blob authdata;
+	struct blob sig;
+	char *rpid = NULL;
+
+	if (string_read(in_f, &rec->key_name) < 0) {
+		if (ferror(in_f) || !feof(in_f))
+			errx(1, "input error");
+		return (0);
+	}
+	if (flags & FLAG_DEBUG)
+		fprintf(stderr, "key: %s\n", rec->key_name);
+
+	read_assert(in_f, flags, &cdh, &rpid, &authdata, &sig);
+
+	rec->key = get_pubkey(keys, dir, type, rec->key_name);
+	fido_assert_recycle(rec->assert);
+	rec->r = set_assert(rec->assert, &cdh, rpid, &authdata, &sig, flags);
+
+	free(cdh.ptr);
+	free(authdata.ptr);
+	free(sig.ptr);
+	free(rpid);
+
+	return (1);
+}
+
+static void
+verify_rec(void *arg, size_t i)
+{
+	struct verify_rec *rec = (struct verify_rec *)arg + i;
+
+	if (rec->key != NULL && rec->r == FIDO_OK)
+		rec->r = fido_assert_verify_prepared(rec->assert, 0, rec->key);
+}
+
+/*
+ * Verify a stream of records, each a key name followed by an assertion,
+ * printing a line per record in input order. Keys are read from 'dir'
+ * once; records are verified by 'jobs' workers, in rounds of
+ * BATCH_CHUNK records per worker.
+ */
+static int
+verify_batch(FILE *in_f, FILE *out_f, const char *dir, int type, int flags,
+    size_t jobs)
+{
+	struct verify_rec *rec;
+	struct cache *keys;
+	struct pool *pool;
+	size_t nrec, n, recno = 0;
+	int failed = 0;
+
+	nrec = jobs * BATCH_CHUNK;
+	if ((rec = calloc(nrec, sizeof(*rec))) == NULL)
+		errx(1, "calloc");
+	for (size_t i = 0; i < nrec; i++)
+		if ((rec[i].assert = fido_assert_new()) == NULL)
+			errx(1, "fido_assert_new");
+	if ((keys = cache_new(free_prepared)) == NULL)
+		errx(1, "cache_new");
+	pool = pool_new(jobs);
+
+	do {
+		for (n = 0; n < nrec; n++)
+			if (read_rec(in_f, flags, keys, dir, type,
+			    &rec[n]) == 0)
+				break;
+		pool_run(pool, n, verify_rec, rec);
+		for (size_t i = 0; i < n; i++) {
+			const char *status = "ok";
+
+			if (rec[i].key == NULL)
+				status = "key_error";
+			else if (rec[i].r != FIDO_OK)
+				status = fido_strerr(rec[i].r);
+			if (rec[i].key == NULL || rec[i].r != FIDO_OK)
+				failed = 1;
+			fprintf(out_f, "%zu %s %s\n", ++recno, status,
+			    rec[i].key_name);
+			free(rec[i].key_name);
+			rec[i].key_name = NULL;
+		}
+		fflush(out_f);
+	} while (n == nrec);
+
+	for (size_t i = 0; i < nrec; i++)
+		fido_assert_free(&rec[i].assert);
+	free(rec);
+	cache_free(&keys);
+	pool_free(&pool);
+
+	return (failed);
+}
+
 int
 assert_verify(int argc, char **argv)
 {
 	fido_assert_t *assert = NULL;
 	void *pk = NULL;
 	char *in_path = NULL;
+	char *out_path = NULL;
+	char *jobs = NULL;
 	FILE *in_f = NULL;
+	FILE *out_f = NULL;
 	int type = COSE_ES256;
+	int batch = 0;
 	int flags = 0;
 	int ch;
 	int r;
 
-	while ((ch = getopt(argc, argv, "dhi:pv")) != -1) {
+	while ((ch = getopt(argc, argv, "Bdhi:j:o:pv")) != -1) {
 		switch (ch) {
+		case 'B':
+			batch = 1;
+			break;
 		case 'd':
 			flags |= FLAG_DEBUG;
 			break;
@@ -171,6 +382,12 @@ assert_verify(int argc, char **argv)
 		case 'i':
 			in_path = optarg;
 			break;
+		case 'j':
+			jobs = optarg;
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
 		case 'p':
 			flags |= FLAG_UP;
 			break;
@@ -187,6 +404,8 @@ assert_verify(int argc, char **argv)
 
 	if (argc < 1 || argc > 2)
 		usage();
+	if (!batch && (jobs != NULL || out_path != NULL))
+		usage();
 
 	in_f = open_read(in_path);
 
@@ -195,7 +414,17 @@ assert_verify(int argc, char **argv)
 
 	fido_init((flags & FLAG_DEBUG) ? FIDO_DEBUG : 0);
 
-	pk = load_pubkey(type, argv[0]);
+	if (batch) {
+		out_f = open_write(out_path);
+		r = verify_batch(in_f, out_f, argv[0], type, flags,
+		    batch_jobs(jobs));
+		fclose(out_f);
+		fclose(in_f);
+		exit(r);
+	}
+
+	if ((pk = load_pubkey(type, argv[0])) == NULL)
+		errx(1, "load_pubkey");
 	assert = prepare_assert(in_f, flags);
 	if ((r = fido_assert_verify(assert, 0, type, pk)) != FIDO_OK)
 		errx(1, "fido_assert_verify: %s", fido_strerr(r));
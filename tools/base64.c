@@ -5,9 +5,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-#include <openssl/bio.h>
-#include <openssl/evp.h>
-
+#include <fido.h>
 #include <limits.h>
 #include <stdint.h>
 #include <string.h>
@@ -18,96 +16,63 @@
 int
 base64_encode(const void *ptr, size_t len, char **out)
 {
-	BIO  *bio_b64 = NULL;
-	BIO  *bio_mem = NULL;
-	char *b64_ptr = NULL;
-	long  b64_len;
-	int   n;
-	int   ok = -1;
-
-	if (ptr == NULL || out == NULL || len > INT_MAX)
-		return (-1);
-
-	*out = NULL;
+	size_t n;
 
-	if ((bio_b64 = BIO_new(BIO_f_base64())) == NULL)
-		goto fail;
-	if ((bio_mem = BIO_new(BIO_s_mem())) == NULL)
-		goto fail;
-
-	BIO_set_flags(bio_b64, BIO_FLAGS_BASE64_NO_NL);
-	BIO_push(bio_b64, bio_mem);
-
-	n = BIO_write(bio_b64, ptr, (int)len);
-	if (n < 0 || (size_t)n != len)
-		goto fail;
+	if (ptr == NULL || out == NULL || len > SIZE_MAX / 4 * 3 - 3)
+		return (-1);
 
-	if (BIO_flush(bio_b64) < 0)
-		goto fail;
+	n = (len + 2) / 3 * 4 + 1;
+	if ((*out = malloc(n)) == NULL)
+		return (-1);
+	if (fido_base64_encode(ptr, len, *out, &n, 0) != FIDO_OK) {
+		free(*out);
+		*out = NULL;
+		return (-1);
+	}
 
-	b64_len = BIO_get_mem_data(bio_b64, &b64_ptr);
-	if (b64_len < 0 || (size_t)b64_len == SIZE_MAX || b64_ptr == NULL)
-		goto fail;
-	if ((*out = calloc(1, (size_t)b64_len + 1)) == NULL)
-		goto fail;
+	return (0);
+}
 
-	memcpy(*out, b64_ptr, (size_t)b64_len);
-	ok = 0;
+/* base64 decodes into no more bytes than it has characters */
+static int
+base64_decode_inplace(unsigned char *buf, size_t len, size_t *outlen)
+{
+	*outlen = len;
 
-fail:
-	BIO_free(bio_b64);
-	BIO_free(bio_mem);
+	if (len == 0 || fido_base64_decode((const char *)buf, len, buf,
+	    outlen, 0) != FIDO_OK || *outlen == 0)
+		return (-1);
 
-	return (ok);
+	return (0);
 }
 
 int
 base64_decode(const char *in, void **ptr, size_t *len)
 {
-	BIO    *bio_mem = NULL;
-	BIO    *bio_b64 = NULL;
-	size_t  alloc_len;
-	int     n;
-	int     ok = -1;
+	size_t inlen;
 
-	if (in == NULL || ptr == NULL || len == NULL || strlen(in) > INT_MAX)
+	if (in == NULL || ptr == NULL || len == NULL)
 		return (-1);
 
 	*ptr = NULL;
 	*len = 0;
 
-	if ((bio_b64 = BIO_new(BIO_f_base64())) == NULL)
-		goto fail;
-	if ((bio_mem = BIO_new_mem_buf((const void *)in, -1)) == NULL)
-		goto fail;
-
-	BIO_set_flags(bio_b64, BIO_FLAGS_BASE64_NO_NL);
-	BIO_push(bio_b64, bio_mem);
-
-	alloc_len = strlen(in);
-	if ((*ptr = calloc(1, alloc_len)) == NULL)
-		goto fail;
-
-	n = BIO_read(bio_b64, *ptr, (int)alloc_len);
-	if (n <= 0 || BIO_eof(bio_b64) == 0)
-		goto fail;
-
-	*len = (size_t)n;
-	ok = 0;
-
-fail:
-	BIO_free(bio_b64);
-	BIO_free(bio_mem);
+	if ((inlen = strlen(in)) == 0 || (*ptr = malloc(inlen)) == NULL)
+		return (-1);
 
-	if (ok < 0) {
+	*len = inlen;
+	if (fido_base64_decode(in, inlen, *ptr, len, 0) != FIDO_OK ||
+	    *len == 0) {
 		free(*ptr);
 		*ptr = NULL;
 		*len = 0;
+		return (-1);
 	}
 
-	return (ok);
+	return (0);
 }
 
+/* read a line of base64 and decode it in the line's own buffer */
 int
 base64_read(FILE *f, struct blob *out)
 {
@@ -124,12 +89,20 @@ base64_read(FILE *f, struct blob *out)
 		return (-1);
 	}
 
-	if (base64_decode(line, (void **)&out->ptr, &out->len) < 0) {
+	/* trim \n and \r\n */
+	if (n > 0 && line[n - 1] == '\n')
+		n--;
+	if (n > 0 && line[n - 1] == '\r')
+		n--;
+
+	if (base64_decode_inplace((unsigned char *)line, (size_t)n,
+	    &out->len) < 0) {
 		free(line);
+		out->len = 0;
 		return (-1);
 	}
 
-	free(line);
+	out->ptr = (unsigned char *)line;
 
 	return (0);
 }
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Helpers for the -B batch modes of fido2-assert and fido2-cred: a cache
+ * of parsed objects keyed by byte strings, and a pool of workers running
+ * a function over arrays of records.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "../openbsd-compat/openbsd-compat.h"
+#include "extern.h"
+
+#define BATCH_JOBS_MAX	256
+#define CACHE_SIZ_MIN	64
+
+struct cache_ent {
+	unsigned char *key;
+	size_t len;
+	void *val;
+};
+
+struct cache {
+	struct cache_ent *ent;
+	size_t n;	/* entries in use */
+	size_t siz;	/* power of two */
+	void (*free_val)(void *);
+};
+
+static uint64_t
+cache_hash(const void *ptr, size_t len)
+{
+	const unsigned char *p = ptr;
+	uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a */
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+
+	return (h);
+}
+
+static struct cache_ent *
+cache_slot(struct cache_ent *ent, size_t siz, const void *key, size_t len)
+{
+	size_t i = (size_t)cache_hash(key, len) & (siz - 1);
+
+	while (ent[i].key != NULL && (ent[i].len != len ||
+	    memcmp(ent[i].key, key, len) != 0))
+		i = (i + 1) & (siz - 1);
+
+	return (&ent[i]);
+}
+
+static int
+cache_grow(struct cache *c)
+{
+	struct cache_ent *ent, *e;
+	size_t siz;
+
+	if (c->siz > SIZE_MAX / 2 / sizeof(*ent))
+		return (-1);
+	siz = c->siz * 2;
+	if ((ent = calloc(siz, sizeof(*ent))) == NULL)
+		return (-1);
+	for (size_t i = 0; i < c->siz; i++) {
+		if (c->ent[i].key == NULL)
+			continue;
+		e = cache_slot(ent, siz, c->ent[i].key, c->ent[i].len);
+		*e = c->ent[i];
+	}
+
+	free(c->ent);
+	c->ent = ent;
+	c->siz = siz;
+
+	return (0);
+}
+
+struct cache *
+cache_new(void (*free_val)(void *))
+{
+	struct cache *c;
+
+	if ((c = calloc(1, sizeof(*c))) == NULL)
+		return (NULL);
+	if ((c->ent = calloc(CACHE_SIZ_MIN, sizeof(*c->ent))) == NULL) {
+		free(c);
+		return (NULL);
+	}
+	c->siz = CACHE_SIZ_MIN;
+	c->free_val = free_val;
+
+	return (c);
+}
+
+/* look 'key' up; -1 if absent, otherwise 0 with its value in 'val' */
+int
+cache_get(const struct cache *c, const void *key, size_t len, void **val)
+{
+	const struct cache_ent *e;
+
+	e = cache_slot(c->ent, c->siz, key, len);
+	if (e->key == NULL)
+		return (-1);
+	*val = e->val;
+
+	return (0);
+}
+
+/* associate 'val', which may be NULL, with 'key'; the cache owns 'val' */
+int
+cache_put(struct cache *c, const void *key, size_t len, void *val)
+{
+	struct cache_ent *e;
+
+	if (c->n + 1 > c->siz / 4 * 3 && cache_grow(c) < 0)
+		return (-1);
+
+	e = cache_slot(c->ent, c->siz, key, len);
+	if (e->key != NULL) {
+		if (c->free_val != NULL && e->val != NULL)
+			c->free_val(e->val);
+		e->val = val;
+		return (0);
+	}
+	if ((e->key = malloc(len ? len : 1)) == NULL)
+		return (-1);
+	memcpy(e->key, key, len);
+	e->len = len;
+	e->val = val;
+	c->n++;
+
+	return (0);
+}
+
+void
+cache_free(struct cache **cp)
+{
+	struct cache *c;
+
+	if (cp == NULL || (c = *cp) == NULL)
+		return;
+
+	for (size_t i = 0; i < c->siz; i++) {
+		if (c->ent[i].key == NULL)
+			continue;
+		if (c->free_val != NULL && c->ent[i].val != NULL)
+			c->free_val(c->ent[i].val);
+		free(c->ent[i].key);
+	}
+	free(c->ent);
+	free(c);
+
+	*cp = NULL;
+}
+
+/* the number of workers: 'str' if given, otherwise one per online cpu */
+size_t
+batch_jobs(const char *str)
+{
+	int n;
+
+	if (str != NULL) {
+		if ((n = base10(str)) < 1 || n > BATCH_JOBS_MAX)
+			errx(1, "-j: invalid number of jobs %s", str);
+		return ((size_t)n);
+	}
+#if defined(HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+	{
+		long ncpu;
+
+		if ((ncpu = sysconf(_SC_NPROCESSORS_ONLN)) > BATCH_JOBS_MAX)
+			return (BATCH_JOBS_MAX);
+		if (ncpu > 0)
+			return ((size_t)ncpu);
+	}
+#endif
+
+	return (1);
+}
+
+struct pool {
+	size_t nt; /* threads besides the caller's */
+#ifdef HAVE_PTHREAD
+	pthread_t *t;
+	pthread_mutex_t mtx;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	void (*fn)(void *, size_t);
+	void *arg;
+	size_t n;
+	size_t next;
+	size_t busy;
+	unsigned long gen;
+	int quit;
+#endif
+};
+
+#ifdef HAVE_PTHREAD
+/* claim and run items of the current round; called with the lock held */
+static void
+pool_work(struct pool *p)
+{
+	size_t i;
+
+	p->busy++;
+	while (p->next < p->n) {
+		i = p->next++;
+		if (pthread_mutex_unlock(&p->mtx) != 0)
+			errx(1, "pthread_mutex_unlock");
+		p->fn(p->arg, i);
+		if (pthread_mutex_lock(&p->mtx) != 0)
+			errx(1, "pthread_mutex_lock");
+	}
+	if (--p->busy == 0 && pthread_cond_broadcast(&p->done) != 0)
+		errx(1, "pthread_cond_broadcast");
+}
+
+static void *
+pool_worker(void *arg)
+{
+	struct pool *p = arg;
+	unsigned long gen = 0;
+
+	if (pthread_mutex_lock(&p->mtx) != 0)
+		errx(1, "pthread_mutex_lock");
+	for (;;) {
+		while (!p->quit && p->gen == gen)
+			if (pthread_cond_wait(&p->start, &p->mtx) != 0)
+				errx(1, "pthread_cond_wait");
+		if (p->quit)
+			break;
+		gen = p->gen;
+		pool_work(p);
+	}
+	if (pthread_mutex_unlock(&p->mtx) != 0)
+		errx(1, "pthread_mutex_unlock");
+
+	return (NULL);
+}
+#endif /* HAVE_PTHREAD */
+
+/*
+ * A pool of 'jobs' workers, the calling thread included. The threads
+ * persist across pool_run() calls, and with them whatever libfido2 keeps
+ * per thread: verification contexts and decoded certificates.
+ */
+struct pool *
+pool_new(size_t jobs)
+{
+	struct pool *p;
+
+	if ((p = calloc(1, sizeof(*p))) == NULL)
+		errx(1, "calloc");
+#ifdef HAVE_PTHREAD
+	if (jobs < 2)
+		return (p);
+	if ((p->t = calloc(jobs - 1, sizeof(*p->t))) == NULL)
+		errx(1, "calloc");
+	if (pthread_mutex_init(&p->mtx, NULL) != 0 ||
+	    pthread_cond_init(&p->start, NULL) != 0 ||
+	    pthread_cond_init(&p->done, NULL) != 0)
+		errx(1, "pthread_init");
+	for (p->nt = 0; p->nt < jobs - 1; p->nt++)
+		if (pthread_create(&p->t[p->nt], NULL, pool_worker, p) != 0)
+			errx(1, "pthread_create");
+#else
+	(void)jobs;
+#endif
+
+	return (p);
+}
+
+/* call fn(arg, i) for every i in [0, n); returns once all calls have */
+void
+pool_run(struct pool *p, size_t n, void (*fn)(void *, size_t), void *arg)
+{
+	if (p->nt == 0 || n < 2) {
+		for (size_t i = 0; i < n; i++)
+			fn(arg, i);
+		return;
+	}
+#ifdef HAVE_PTHREAD
+	if (pthread_mutex_lock(&p->mtx) != 0)
+		errx(1, "pthread_mutex_lock");
+	p->fn = fn;
+	p->arg = arg;
+	p->n = n;
+	p->next = 0;
+	p->gen++;
+	if (pthread_cond_broadcast(&p->start) != 0)
+		errx(1, "pthread_cond_broadcast");
+	pool_work(p);
+	while (p->busy > 0)
+		if (pthread_cond_wait(&p->done, &p->mtx) != 0)
+			errx(1, "pthread_cond_wait");
+	if (pthread_mutex_unlock(&p->mtx) != 0)
+		errx(1, "pthread_mutex_unlock");
+#endif
+}
+
+void
+pool_free(struct pool **pp)
+{
+	struct pool *p;
+
+	if (pp == NULL || (p = *pp) == NULL)
+		return;
+
+#ifdef HAVE_PTHREAD
+	if (p->nt > 0) {
+		if (pthread_mutex_lock(&p->mtx) != 0)
+			errx(1, "pthread_mutex_lock");
+		p->quit = 1;
+		if (pthread_cond_broadcast(&p->start) != 0)
+			errx(1, "pthread_cond_broadcast");
+		if (pthread_mutex_unlock(&p->mtx) != 0)
+			errx(1, "pthread_mutex_unlock");
+		for (size_t i = 0; i < p->nt; i++)
+			if (pthread_join(p->t[i], NULL) != 0)
+				errx(1, "pthread_join");
+		pthread_cond_destroy(&p->done);
+		pthread_cond_destroy(&p->start);
+		pthread_mutex_destroy(&p->mtx);
+	}
+	free(p->t);
+#endif
+	free(p);
+
+	*pp = NULL;
+}
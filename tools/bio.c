@@ -257,22 +257,9 @@ type_str(uint8_t t)
 }
 
 void
-bio_info(fido_dev_t *dev)
+bio_info(const fido_bio_info_t *i)
 {
-	fido_bio_info_t	*i = NULL;
-
-	if ((i = fido_bio_info_new()) == NULL) {
-		warnx("fido_bio_info_new");
-		return;
-	}
-	if (fido_bio_dev_get_info(dev, i) != FIDO_OK) {
-		fido_bio_info_free(&i);
-		return;
-	}
-
 	printf("sensor type: %u (%s)\n", (unsigned)fido_bio_info_type(i),
 	    type_str(fido_bio_info_type(i)));
 	printf("max samples: %u\n", (unsigned)fido_bio_info_max_samples(i));
-
-	fido_bio_info_free(&i);
 }
@@ -53,7 +53,7 @@ config_always_uv(char *path, int toggle)
 	int v, r, ok = 1;
 
 	dev = open_dev(path);
-	if (get_devopt(dev, "alwaysUv", &v) < 0) {
+	if (get_devopt(dev, FIDO_INFO_OPT_ALWAYS_UV, &v) < 0) {
 		warnx("%s: getdevopt", __func__);
 		goto out;
 	}
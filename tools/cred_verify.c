@@ -5,6 +5,9 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
 #include <fido.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,106 +19,293 @@
 #include "../openbsd-compat/openbsd-compat.h"
 #include "extern.h"
 
-static fido_cred_t *
-prepare_cred(FILE *in_f, int type, int flags)
-{
-	fido_cred_t *cred = NULL;
+/* records verified per worker in each round of a batch */
+#define BATCH_CHUNK	64
+
+struct cred_in {
 	struct blob cdh;
 	struct blob authdata;
 	struct blob id;
 	struct blob sig;
 	struct blob x5c;
-	char *rpid = NULL;
-	char *fmt = NULL;
+	char *rpid;
+	char *fmt;
+};
+
+struct verify_rec {
+	fido_cred_t *cred;
+	char *id; /* base64, as read */
 	int r;
+	long long usec;
+};
+
+struct verify_batch {
+	struct verify_rec *rec;
+	const fido_attest_store_t *store;
+};
 
-	memset(&cdh, 0, sizeof(cdh));
-	memset(&authdata, 0, sizeof(authdata));
-	memset(&id, 0, sizeof(id));
-	memset(&sig, 0, sizeof(sig));
-	memset(&x5c, 0, sizeof(x5c));
-
-	r = base64_read(in_f, &cdh);
-	r |= string_read(in_f, &rpid);
-	r |= string_read(in_f, &fmt);
-	r |= base64_read(in_f, &authdata);
-	r |= base64_read(in_f, &id);
-	r |= base64_read(in_f, &sig);
+/* read a credential; 'batch' records have a possibly empty x5c line */
+static int
+read_cred(FILE *in_f, int flags, int batch, struct cred_in *in)
+{
+	char *x5c = NULL;
+	int r;
+
+	memset(in, 0, sizeof(*in));
+
+	r = base64_read(in_f, &in->cdh);
+	r |= string_read(in_f, &in->rpid);
+	r |= string_read(in_f, &in->fmt);
+	r |= base64_read(in_f, &in->authdata);
+	r |= base64_read(in_f, &in->id);
+	r |= base64_read(in_f, &in->sig);
 	if (r < 0)
-		errx(1, "input error");
+		return (-1);
 
-	(void)base64_read(in_f, &x5c);
+	if (!batch)
+		(void)base64_read(in_f, &in->x5c);
+	else if (string_read(in_f, &x5c) < 0 || (*x5c != '\0' &&
+	    base64_decode(x5c, (void **)&in->x5c.ptr, &in->x5c.len) < 0)) {
+		free(x5c);
+		return (-1);
+	}
+	free(x5c);
 
 	if (flags & FLAG_DEBUG) {
 		fprintf(stderr, "client data hash:\n");
-		xxd(cdh.ptr, cdh.len);
-		fprintf(stderr, "relying party id: %s\n", rpid);
-		fprintf(stderr, "format: %s\n", fmt);
+		xxd(in->cdh.ptr, in->cdh.len);
+		fprintf(stderr, "relying party id: %s\n", in->rpid);
+		fprintf(stderr, "format: %s\n", in->fmt);
 		fprintf(stderr, "authenticator data:\n");
-		xxd(authdata.ptr, authdata.len);
+		xxd(in->authdata.ptr, in->authdata.len);
 		fprintf(stderr, "credential id:\n");
-		xxd(id.ptr, id.len);
+		xxd(in->id.ptr, in->id.len);
 		fprintf(stderr, "signature:\n");
-		xxd(sig.ptr, sig.len);
+		xxd(in->sig.ptr, in->sig.len);
 		fprintf(stderr, "x509:\n");
-		xxd(x5c.ptr, x5c.len);
+		xxd(in->x5c.ptr, in->x5c.len);
 	}
 
-	if ((cred = fido_cred_new()) == NULL)
-		errx(1, "fido_cred_new");
+	return (0);
+}
+
+static void
+free_cred_in(struct cred_in *in)
+{
+	free(in->cdh.ptr);
+	free(in->authdata.ptr);
+	free(in->id.ptr);
+	free(in->sig.ptr);
+	free(in->x5c.ptr);
+	free(in->rpid);
+	free(in->fmt);
+}
+
+static int
+set_cred(fido_cred_t *cred, int type, const struct cred_in *in, int flags,
+    int cred_prot)
+{
+	int r;
 
 	if ((r = fido_cred_set_type(cred, type)) != FIDO_OK ||
-	    (r = fido_cred_set_clientdata_hash(cred, cdh.ptr,
-	    cdh.len)) != FIDO_OK ||
-	    (r = fido_cred_set_rp(cred, rpid, NULL)) != FIDO_OK ||
-	    (r = fido_cred_set_authdata(cred, authdata.ptr,
-	    authdata.len)) != FIDO_OK ||
-	    (r = fido_cred_set_sig(cred, sig.ptr, sig.len)) != FIDO_OK ||
-	    (r = fido_cred_set_fmt(cred, fmt)) != FIDO_OK)
+	    (r = fido_cred_set_clientdata_hash(cred, in->cdh.ptr,
+	    in->cdh.len)) != FIDO_OK ||
+	    (r = fido_cred_set_rp(cred, in->rpid, NULL)) != FIDO_OK ||
+	    (r = fido_cred_set_authdata(cred, in->authdata.ptr,
+	    in->authdata.len)) != FIDO_OK ||
+	    (r = fido_cred_set_sig(cred, in->sig.ptr, in->sig.len)) != FIDO_OK ||
+	    (r = fido_cred_set_fmt(cred, in->fmt)) != FIDO_OK)
+		return (r);
+
+	if (in->x5c.ptr != NULL && (r = fido_cred_set_x509(cred, in->x5c.ptr,
+	    in->x5c.len)) != FIDO_OK)
+		return (r);
+	if ((flags & FLAG_UV) && (r = fido_cred_set_uv(cred,
+	    FIDO_OPT_TRUE)) != FIDO_OK)
+		return (r);
+	if ((flags & FLAG_HMAC) && (r = fido_cred_set_extensions(cred,
+	    FIDO_EXT_HMAC_SECRET)) != FIDO_OK)
+		return (r);
+	if (cred_prot > 0 && (r = fido_cred_set_prot(cred,
+	    cred_prot)) != FIDO_OK)
+		return (r);
+
+	return (FIDO_OK);
+}
+
+static fido_cred_t *
+prepare_cred(FILE *in_f, int type, int flags, int cred_prot)
+{
+	fido_cred_t *cred = NULL;
+	struct cred_in in;
+	int r;
+
+	if (read_cred(in_f, flags, 0, &in) < 0)
+		errx(1, "input error");
+
+	if ((cred = fido_cred_new()) == NULL)
+		errx(1, "fido_cred_new");
+	if ((r = set_cred(cred, type, &in, flags, cred_prot)) != FIDO_OK)
 		errx(1, "fido_cred_set: %s", fido_strerr(r));
 
-	if (x5c.ptr != NULL) {
-		if ((r = fido_cred_set_x509(cred, x5c.ptr, x5c.len)) != FIDO_OK)
-			errx(1, "fido_cred_set_x509: %s", fido_strerr(r));
-	}
+	free_cred_in(&in);
 
-	if (flags & FLAG_UV) {
-		if ((r = fido_cred_set_uv(cred, FIDO_OPT_TRUE)) != FIDO_OK)
-			errx(1, "fido_cred_set_uv: %s", fido_strerr(r));
-	}
-	if (flags & FLAG_HMAC) {
-		if ((r = fido_cred_set_extensions(cred,
-		    FIDO_EXT_HMAC_SECRET)) != FIDO_OK)
-			errx(1, "fido_cred_set_extensions: %s", fido_strerr(r));
+	return (cred);
+}
+
+/* the PEM-encoded certificates in 'path', as trust anchors */
+static fido_attest_store_t *
+load_anchors(const char *path)
+{
+	fido_attest_store_t *store;
+	FILE *f;
+	X509 *cert;
+	unsigned char *der;
+	size_t n = 0;
+	int len, r;
+
+	if ((f = fopen(path, "r")) == NULL)
+		err(1, "fopen %s", path);
+	if ((store = fido_attest_store_new()) == NULL)
+		errx(1, "fido_attest_store_new");
+	while ((cert = PEM_read_X509(f, NULL, NULL, NULL)) != NULL) {
+		der = NULL;
+		if ((len = i2d_X509(cert, &der)) <= 0)
+			errx(1, "i2d_X509");
+		if ((r = fido_attest_store_add(store, der,
+		    (size_t)len)) != FIDO_OK)
+			errx(1, "fido_attest_store_add: %s", fido_strerr(r));
+		OPENSSL_free(der);
+		X509_free(cert);
+		n++;
 	}
+	if (n == 0)
+		errx(1, "%s: no certificates", path);
+	fclose(f);
 
-	free(cdh.ptr);
-	free(authdata.ptr);
-	free(id.ptr);
-	free(sig.ptr);
-	free(x5c.ptr);
-	free(rpid);
-	free(fmt);
+	return (store);
+}
 
-	return (cred);
+static void
+verify_rec(void *arg, size_t i)
+{
+	struct verify_batch *vb = arg;
+	struct verify_rec *rec = &vb->rec[i];
+	struct timespec t0, t1;
+
+	if (rec->r != FIDO_OK)
+		return;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &t0) != 0)
+		err(1, "clock_gettime");
+	if (vb->store != NULL)
+		rec->r = fido_cred_verify_chain(rec->cred, vb->store);
+	else if (fido_cred_x5c_ptr(rec->cred) == NULL)
+		rec->r = fido_cred_verify_self(rec->cred);
+	else
+		rec->r = fido_cred_verify(rec->cred);
+	if (clock_gettime(CLOCK_MONOTONIC, &t1) != 0)
+		err(1, "clock_gettime");
+
+	timespecsub(&t1, &t0, &t1);
+	rec->usec = (long long)t1.tv_sec * 1000000 + t1.tv_nsec / 1000;
+}
+
+/*
+ * Verify a stream of credentials, printing a JSON object per credential
+ * in input order. Credentials are verified by 'jobs' workers, in rounds of
+ * BATCH_CHUNK credentials per worker; attestation certificates decoded
+ * by a worker are kept for the credentials it verifies next.
+ */
+static int
+verify_batch(FILE *in_f, FILE *out_f, const fido_attest_store_t *store,
+    int type, int flags, int cred_prot, size_t jobs)
+{
+	struct verify_batch vb;
+	struct cred_in in;
+	struct pool *pool;
+	size_t nrec, n, recno = 0;
+	int failed = 0;
+
+	nrec = jobs * BATCH_CHUNK;
+	memset(&vb, 0, sizeof(vb));
+	vb.store = store;
+	if ((vb.rec = calloc(nrec, sizeof(*vb.rec))) == NULL)
+		errx(1, "calloc");
+	for (size_t i = 0; i < nrec; i++)
+		if ((vb.rec[i].cred = fido_cred_new()) == NULL)
+			errx(1, "fido_cred_new");
+	pool = pool_new(jobs);
+
+	do {
+		for (n = 0; n < nrec; n++) {
+			struct verify_rec *rec = &vb.rec[n];
+
+			if (read_cred(in_f, flags, 1, &in) < 0) {
+				if (ferror(in_f) || !feof(in_f) ||
+				    in.cdh.ptr != NULL)
+					errx(1, "input error");
+				free_cred_in(&in);
+				break;
+			}
+			if (base64_encode(in.id.ptr, in.id.len, &rec->id) < 0)
+				errx(1, "base64_encode");
+			fido_cred_recycle(rec->cred);
+			rec->r = set_cred(rec->cred, type, &in, flags,
+			    cred_prot);
+			rec->usec = 0;
+			free_cred_in(&in);
+		}
+		pool_run(pool, n, verify_rec, &vb);
+		for (size_t i = 0; i < n; i++) {
+			struct verify_rec *rec = &vb.rec[i];
+
+			if (rec->r != FIDO_OK)
+				failed = 1;
+			fprintf(out_f, "{\"record\":%zu,\"id\":\"%s\","
+			    "\"result\":\"%s\",\"usec\":%lld}\n", ++recno,
+			    rec->id, rec->r == FIDO_OK ? "ok" :
+			    fido_strerr(rec->r), rec->usec);
+			free(rec->id);
+			rec->id = NULL;
+		}
+		fflush(out_f);
+	} while (n == nrec);
+
+	for (size_t i = 0; i < nrec; i++)
+		fido_cred_free(&vb.rec[i].cred);
+	free(vb.rec);
+	pool_free(&pool);
+
+	return (failed);
 }
 
 int
 cred_verify(int argc, char **argv)
 {
 	fido_cred_t *cred = NULL;
+	fido_attest_store_t *store = NULL;
+	char *anchors = NULL;
 	char *in_path = NULL;
 	char *out_path = NULL;
+	char *jobs = NULL;
 	FILE *in_f = NULL;
 	FILE *out_f = NULL;
 	int type = COSE_ES256;
+	int batch = 0;
 	int flags = 0;
 	int cred_prot = -1;
 	int ch;
 	int r;
 
-	while ((ch = getopt(argc, argv, "c:dhi:o:v")) != -1) {
+	while ((ch = getopt(argc, argv, "Ba:c:dhi:j:o:v")) != -1) {
 		switch (ch) {
+		case 'B':
+			batch = 1;
+			break;
+		case 'a':
+			anchors = optarg;
+			break;
 		case 'c':
 			if ((cred_prot = base10(optarg)) < 0)
 				errx(1, "-c: invalid argument '%s'", optarg);
@@ -129,6 +319,9 @@ cred_verify(int argc, char **argv)
 		case 'i':
 			in_path = optarg;
 			break;
+		case 'j':
+			jobs = optarg;
+			break;
 		case 'o':
 			out_path = optarg;
 			break;
@@ -145,6 +338,8 @@ cred_verify(int argc, char **argv)
 
 	if (argc > 1)
 		usage();
+	if (!batch && (anchors != NULL || jobs != NULL))
+		usage();
 
 	in_f = open_read(in_path);
 	out_f = open_write(out_path);
@@ -153,15 +348,20 @@ cred_verify(int argc, char **argv)
 		errx(1, "unknown type %s", argv[0]);
 
 	fido_init((flags & FLAG_DEBUG) ? FIDO_DEBUG : 0);
-	cred = prepare_cred(in_f, type, flags);
 
-	if (cred_prot > 0) {
-		r = fido_cred_set_prot(cred, cred_prot);
-		if (r != FIDO_OK) {
-			errx(1, "fido_cred_set_prot: %s", fido_strerr(r));
-		}
+	if (batch) {
+		if (anchors != NULL)
+			store = load_anchors(anchors);
+		r = verify_batch(in_f, out_f, store, type, flags, cred_prot,
+		    batch_jobs(jobs));
+		fido_attest_store_free(&store);
+		fclose(in_f);
+		fclose(out_f);
+		exit(r);
 	}
 
+	cred = prepare_cred(in_f, type, flags, cred_prot);
+
 	if (fido_cred_x5c_ptr(cred) == NULL) {
 		if ((r = fido_cred_verify_self(cred)) != FIDO_OK)
 			errx(1, "fido_cred_verify_self: %s", fido_strerr(r));
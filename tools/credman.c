@@ -5,9 +5,12 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <openssl/evp.h>
+
 #include <fido.h>
 #include <fido/credman.h>
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,8 +19,31 @@
 #endif
 
 #include "../openbsd-compat/openbsd-compat.h"
+#ifdef _MSC_VER
+#include "../openbsd-compat/posix_win.h"
+#endif
+
 #include "extern.h"
 
+/*
+ * The inventory cache is a text file holding the relying parties and
+ * resident credentials of an authenticator:
+ *
+ *	inventory <serial> <aaguid> <existing rks> <remaining rks> <rps>
+ *	rp\t<rp_id_hash>\t<rp_id>
+ *	rk\t<rp_id>\t<cred_id> <display_name> <user_id> <type> <prot>
+ *	end
+ *
+ * where <serial> is the device's serial number, or '-' if unknown, and
+ * <rps> the sha256 of the rp_id_hash list returned by enumerateRPs. It is
+ * considered current as long as its first line matches the authenticator.
+ */
+#define INVENTORY_MAGIC	"inventory"
+#define INVENTORY_END	"end"
+#define INVENTORY_DEVS	64
+#define INVENTORY_KEYLEN	512
+
+
 int
 credman_get_metadata(fido_dev_t *dev, const char *path)
 {
@@ -184,6 +210,360 @@ out:
 	exit(ok);
 }
 
+/* the serial number of the device at 'path', or "-" */
+static const char *
+inventory_serial(const fido_dev_info_t *devlist, size_t ndevs,
+    const char *path)
+{
+	const fido_dev_info_t *di;
+	const char *serial;
+
+	for (size_t i = 0; i < ndevs; i++) {
+		di = fido_dev_info_ptr(devlist, i);
+		if (strcmp(fido_dev_info_path(di), path) != 0)
+			continue;
+		serial = fido_dev_info_serial_string(di);
+		if (*serial == '\0' || strlen(serial) > 128 ||
+		    strchr(serial, '\n') != NULL)
+			break;
+		return serial;
+	}
+
+	return "-";
+}
+
+/* the hex-encoded sha256 of the rp_id_hash list in 'rp' */
+static int
+inventory_rp_digest(const fido_credman_rp_t *rp, char *hex, size_t hexlen)
+{
+	EVP_MD_CTX *ctx = NULL;
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int mdlen;
+	int ok = -1;
+
+	if ((ctx = EVP_MD_CTX_new()) == NULL ||
+	    EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1) {
+		warnx("%s: EVP_DigestInit_ex", __func__);
+		goto out;
+	}
+	for (size_t i = 0; i < fido_credman_rp_count(rp); i++)
+		if (EVP_DigestUpdate(ctx, fido_credman_rp_id_hash_ptr(rp, i),
+		    fido_credman_rp_id_hash_len(rp, i)) != 1) {
+			warnx("%s: EVP_DigestUpdate", __func__);
+			goto out;
+		}
+	if (EVP_DigestFinal_ex(ctx, md, &mdlen) != 1 ||
+	    hexlen < 2 * (size_t)mdlen + 1) {
+		warnx("%s: EVP_DigestFinal_ex", __func__);
+		goto out;
+	}
+	for (unsigned int i = 0; i < mdlen; i++)
+		snprintf(&hex[2 * i], 3, "%02x", md[i]);
+
+	ok = 0;
+out:
+	EVP_MD_CTX_free(ctx);
+
+	return ok;
+}
+
+static int
+inventory_key(fido_dev_t *dev, const char *path,
+    const fido_credman_metadata_t *metadata, const fido_credman_rp_t *rp,
+    char *key, size_t keylen)
+{
+	const fido_cbor_info_t *ci;
+	fido_cbor_info_t *ci_new = NULL;
+	fido_dev_info_t *devlist = NULL;
+	const unsigned char *aaguid;
+	char hex[2 * 16 + 1], rps[2 * EVP_MAX_MD_SIZE + 1];
+	size_t len, ndevs = 0;
+	int n, r, ok = -1;
+
+	if ((ci = fido_dev_cbor_info(dev)) == NULL) {
+		if ((ci_new = fido_cbor_info_new()) == NULL) {
+			warnx("fido_cbor_info_new");
+			goto out;
+		}
+		if ((r = fido_dev_get_cbor_info(dev, ci_new)) != FIDO_OK) {
+			warnx("fido_dev_get_cbor_info: %s", fido_strerr(r));
+			goto out;
+		}
+		ci = ci_new;
+	}
+	aaguid = fido_cbor_info_aaguid_ptr(ci);
+	if ((len = fido_cbor_info_aaguid_len(ci)) != 16) {
+		warnx("%s: aaguid len %zu", __func__, len);
+		goto out;
+	}
+	for (size_t i = 0; i < len; i++)
+		snprintf(&hex[2 * i], 3, "%02x", aaguid[i]);
+	if (inventory_rp_digest(rp, rps, sizeof(rps)) < 0)
+		goto out;
+	/* without a serial, the cache is still keyed on the rest */
+	if ((devlist = fido_dev_info_new(INVENTORY_DEVS)) == NULL ||
+	    fido_dev_info_manifest(devlist, INVENTORY_DEVS, &ndevs) != FIDO_OK)
+		ndevs = 0;
+	if ((n = snprintf(key, keylen, "%s %s %s %llu %llu %s",
+	    INVENTORY_MAGIC, inventory_serial(devlist, ndevs, path), hex,
+	    (unsigned long long)fido_credman_rk_existing(metadata),
+	    (unsigned long long)fido_credman_rk_remaining(metadata),
+	    rps)) < 0 || (size_t)n >= keylen) {
+		warnx("%s: snprintf", __func__);
+		goto out;
+	}
+
+	ok = 0;
+out:
+	fido_dev_info_free(&devlist, INVENTORY_DEVS);
+	fido_cbor_info_free(&ci_new);
+
+	return ok;
+}
+
+static void
+strip_newline(char *line)
+{
+	line[strcspn(line, "\n")] = '\0';
+}
+
+/*
+ * Print the relying parties in 'cache' or, if 'rp_id' is not NULL, the
+ * credentials of 'rp_id'. Returns -1 without printing anything if 'cache'
+ * is absent, incomplete, or does not match 'key'.
+ */
+static int
+inventory_print(const char *cache, const char *key, const char *rp_id)
+{
+	FILE *f;
+	char *line = NULL, *id, *rest;
+	size_t linesize = 0;
+	unsigned idx = 0;
+	int complete = 0, ok = -1;
+
+	if ((f = fopen(cache, "r")) == NULL)
+		return -1;
+	if (getline(&line, &linesize, f) <= 0)
+		goto out;
+	strip_newline(line);
+	if (strcmp(line, key) != 0)
+		goto out;
+	while (getline(&line, &linesize, f) > 0) {
+		strip_newline(line);
+		if (strcmp(line, INVENTORY_END) == 0) {
+			complete = 1;
+			break;
+		}
+	}
+	if (!complete || fseek(f, 0, SEEK_SET) != 0 ||
+	    getline(&line, &linesize, f) <= 0)
+		goto out;
+	while (getline(&line, &linesize, f) > 0) {
+		strip_newline(line);
+		if (strcmp(line, INVENTORY_END) == 0)
+			break;
+		rest = line;
+		if (strsep(&rest, "\t") == NULL || (id = strsep(&rest,
+		    "\t")) == NULL || rest == NULL) {
+			warnx("%s: malformed line", cache);
+			goto out;
+		}
+		if (rp_id == NULL && strcmp(line, "rp") == 0)
+			printf("%02u: %s %s\n", idx++, id, rest);
+		else if (rp_id != NULL && strcmp(line, "rk") == 0 &&
+		    strcmp(id, rp_id) == 0)
+			printf("%02u: %s\n", idx++, rest);
+	}
+
+	ok = 0;
+out:
+	free(line);
+	fclose(f);
+
+	return ok;
+}
+
+static int
+inventory_write(FILE *f, const char *key, const fido_credman_rp_t *rp,
+    const fido_credman_rk_t *rk)
+{
+	const fido_cred_t *cred;
+	const char *rp_id, *name;
+	char *hash = NULL, *id = NULL, *user_id = NULL;
+	int ok = -1;
+
+	fprintf(f, "%s\n", key);
+	for (size_t i = 0; i < fido_credman_rp_count(rp); i++) {
+		if ((rp_id = fido_credman_rp_id(rp, i)) == NULL ||
+		    strpbrk(rp_id, "\t\n") != NULL) {
+			warnx("%s: rp_id %zu", __func__, i);
+			goto out;
+		}
+		if (base64_encode(fido_credman_rp_id_hash_ptr(rp, i),
+		    fido_credman_rp_id_hash_len(rp, i), &hash) < 0) {
+			warnx("output error");
+			goto out;
+		}
+		fprintf(f, "rp\t%s\t%s\n", hash, rp_id);
+		free(hash);
+		hash = NULL;
+	}
+	for (size_t i = 0; i < fido_credman_rk_count(rk); i++) {
+		if ((cred = fido_credman_rk(rk, i)) == NULL ||
+		    (rp_id = fido_cred_rp_id(cred)) == NULL) {
+			warnx("fido_credman_rk");
+			goto out;
+		}
+		if ((name = fido_cred_display_name(cred)) != NULL &&
+		    strchr(name, '\n') != NULL) {
+			warnx("%s: display name %zu", __func__, i);
+			goto out;
+		}
+		if (base64_encode(fido_cred_id_ptr(cred), fido_cred_id_len(cred),
+		    &id) < 0 || base64_encode(fido_cred_user_id_ptr(cred),
+		    fido_cred_user_id_len(cred), &user_id) < 0) {
+			warnx("output error");
+			goto out;
+		}
+		fprintf(f, "rk\t%s\t%s %s %s %s %s\n", rp_id, id,
+		    name != NULL ? name : "(null)", user_id,
+		    cose_string(fido_cred_type(cred)),
+		    prot_string(fido_cred_prot(cred)));
+		free(id);
+		free(user_id);
+		id = NULL;
+		user_id = NULL;
+	}
+	fprintf(f, "%s\n", INVENTORY_END);
+
+	ok = 0;
+out:
+	free(hash);
+	free(id);
+	free(user_id);
+
+	return ok;
+}
+
+static int
+inventory_save(fido_dev_t *dev, const char *path, const char *cache,
+    const char *key, char **pin)
+{
+	fido_credman_rp_t *rp = NULL;
+	fido_credman_rk_t *rk = NULL;
+	FILE *f = NULL;
+	int fd, r, ok = -1;
+
+	if ((rp = fido_credman_rp_new()) == NULL ||
+	    (rk = fido_credman_rk_new()) == NULL) {
+		warnx("fido_credman_rk_new");
+		goto out;
+	}
+	if ((r = fido_credman_get_dev_rk_all(dev, rp, rk,
+	    *pin)) != FIDO_OK && *pin == NULL &&
+	    should_retry_with_pin(dev, r)) {
+		if ((*pin = get_pin(path)) == NULL)
+			goto out;
+		r = fido_credman_get_dev_rk_all(dev, rp, rk, *pin);
+	}
+	if (r != FIDO_OK) {
+		warnx("fido_credman_get_dev_rk_all: %s", fido_strerr(r));
+		goto out;
+	}
+	if ((fd = open(cache, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0) {
+		warn("open %s", cache);
+		goto out;
+	}
+	if ((f = fdopen(fd, "w")) == NULL) {
+		warn("fdopen %s", cache);
+		close(fd);
+		goto out;
+	}
+	if (inventory_write(f, key, rp, rk) < 0)
+		goto out;
+
+	ok = 0;
+out:
+	if (f != NULL && fclose(f) != 0) {
+		warn("close %s", cache);
+		ok = -1;
+	}
+	fido_credman_rp_free(&rp);
+	fido_credman_rk_free(&rk);
+
+	return ok;
+}
+
+/*
+ * List the relying parties or, if 'rp_id' is not NULL, the credentials of
+ * 'rp_id' from the inventory cache, refreshing it first if the
+ * authenticator's credential metadata or relying parties changed.
+ */
+int
+credman_list_cached(const char *path, const char *rp_id, const char *cache)
+{
+	fido_dev_t *dev = NULL;
+	fido_credman_metadata_t *metadata = NULL;
+	fido_credman_rp_t *rp = NULL;
+	char *pin = NULL;
+	char key[INVENTORY_KEYLEN];
+	int r, ok = 1;
+
+	dev = open_dev(path);
+	/* metadata and enumeration share a pin/uv auth token */
+	if ((r = fido_dev_set_token_cache(dev, true)) != FIDO_OK) {
+		warnx("fido_dev_set_token_cache: %s", fido_strerr(r));
+		goto out;
+	}
+	if ((metadata = fido_credman_metadata_new()) == NULL) {
+		warnx("fido_credman_metadata_new");
+		goto out;
+	}
+	if ((r = fido_credman_get_dev_metadata(dev, metadata,
+	    NULL)) != FIDO_OK && should_retry_with_pin(dev, r)) {
+		if ((pin = get_pin(path)) == NULL)
+			goto out;
+		r = fido_credman_get_dev_metadata(dev, metadata, pin);
+	}
+	if (r != FIDO_OK) {
+		warnx("fido_credman_get_dev_metadata: %s", fido_strerr(r));
+		goto out;
+	}
+	if ((rp = fido_credman_rp_new()) == NULL) {
+		warnx("fido_credman_rp_new");
+		goto out;
+	}
+	if ((r = fido_credman_get_dev_rp(dev, rp, pin)) != FIDO_OK &&
+	    pin == NULL && should_retry_with_pin(dev, r)) {
+		if ((pin = get_pin(path)) == NULL)
+			goto out;
+		r = fido_credman_get_dev_rp(dev, rp, pin);
+	}
+	if (r != FIDO_OK) {
+		warnx("fido_credman_get_dev_rp: %s", fido_strerr(r));
+		goto out;
+	}
+	if (inventory_key(dev, path, metadata, rp, key, sizeof(key)) < 0)
+		goto out;
+	if (inventory_print(cache, key, rp_id) == 0) {
+		ok = 0;
+		goto out;
+	}
+	if (inventory_save(dev, path, cache, key, &pin) < 0 ||
+	    inventory_print(cache, key, rp_id) < 0)
+		goto out;
+
+	ok = 0;
+out:
+	freezero(pin, PINBUF_LEN);
+	fido_credman_metadata_free(&metadata);
+	fido_credman_rp_free(&rp);
+	fido_dev_close(dev);
+	fido_dev_free(&dev);
+
+	exit(ok);
+}
+
 int
 credman_print_rk(fido_dev_t *dev, const char *path, const char *rp_id,
     const char *cred_id)
@@ -13,6 +13,7 @@
 #include <openssl/ec.h>
 
 #include <fido.h>
+#include <fido/bio.h>
 #include <stddef.h>
 #include <stdio.h>
 
@@ -21,7 +22,10 @@ struct blob {
 	size_t len;
 };
 
-#define TOKEN_OPT	"CDGILPRSVabcdefi:k:l:m:n:p:ru"
+struct cache;
+struct pool;
+
+#define TOKEN_OPT	"BCDGILPRSVXabcdefi:k:l:m:n:o:p:ruw"
 
 #define FLAG_DEBUG	0x001
 #define FLAG_QUIET	0x002
@@ -48,9 +52,10 @@ int assert_verify(int, char **);
 int base64_decode(const char *, void **, size_t *);
 int base64_encode(const void *, size_t, char **);
 int base64_read(FILE *, struct blob *);
+size_t batch_jobs(const char *);
 int bio_delete(const char *, const char *);
 int bio_enroll(const char *);
-void bio_info(fido_dev_t *);
+void bio_info(const fido_bio_info_t *);
 int bio_list(const char *);
 int bio_set_name(const char *, const char *, const char *);
 int blob_clean(const char *);
@@ -60,6 +65,10 @@ int blob_get(const char *, const char *, const char *, const char *,
     const char *);
 int blob_set(const char *, const char *, const char *, const char *,
     const char *);
+struct cache *cache_new(void (*)(void *));
+int cache_get(const struct cache *, const void *, size_t, void **);
+int cache_put(struct cache *, const void *, size_t, void *);
+void cache_free(struct cache **);
 int config_always_uv(char *, int);
 int config_entattest(char *);
 int config_force_pin_change(char *);
@@ -72,30 +81,38 @@ int credman_delete_rk(const char *, const char *);
 int credman_update_rk(const char *, const char *, const char *, const char *,
     const char *);
 int credman_get_metadata(fido_dev_t *, const char *);
+int credman_list_cached(const char *, const char *, const char *);
 int credman_list_rk(const char *, const char *);
 int credman_list_rp(const char *);
 int credman_print_rk(fido_dev_t *, const char *, const char *, const char *);
-int get_devopt(fido_dev_t *, const char *, int *);
+int get_devopt(fido_dev_t *, uint64_t, int *);
+int map_file(const char *, struct blob *);
 int pin_change(char *);
 int pin_set(char *);
 int should_retry_with_pin(const fido_dev_t *, int);
 int string_read(FILE *, char **);
+int token_bench(int, char **, char *);
 int token_config(int, char **, char *);
 int token_delete(int, char **, char *);
 int token_get(int, char **, char *);
 int token_info(int, char **, char *);
 int token_list(int, char **, char *);
-int token_reset(char *);
+int token_provision(int, char **);
+int token_reset(int, char **);
+int token_serve(int, char **, char *);
 int token_set(int, char **, char *);
 int write_es256_pubkey(FILE *, const void *, size_t);
 int write_es384_pubkey(FILE *, const void *, size_t);
 int write_rsa_pubkey(FILE *, const void *, size_t);
-int read_file(const char *, u_char **, size_t *);
 int write_file(const char *, const u_char *, size_t);
 RSA *read_rsa_pubkey(const char *);
 EVP_PKEY *read_eddsa_pubkey(const char *);
 int write_eddsa_pubkey(FILE *, const void *, size_t);
+void pool_free(struct pool **);
+struct pool *pool_new(size_t);
+void pool_run(struct pool *, size_t, void (*)(void *, size_t), void *);
 void print_cred(FILE *, int, const fido_cred_t *);
+void unmap_file(struct blob *);
 void usage(void);
 void xxd(const void *, size_t);
 int base10(const char *);
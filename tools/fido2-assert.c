@@ -29,8 +29,9 @@ void
 usage(void)
 {
 	fprintf(stderr,
-"usage: fido2-assert -G [-bdhpruvw] [-t option] [-i input_file] [-o output_file] device\n"
+"usage: fido2-assert -G [-bdhpruvw] [-t option] [-i input_file] [-n count] [-o output_file] device\n"
 "       fido2-assert -V [-dhpv] [-i input_file] key_file [type]\n"
+"       fido2-assert -V -B [-dhpv] [-j jobs] [-i input_file] [-o output_file] key_dir [type]\n"
 	);
 
 	exit(1);
@@ -0,0 +1,590 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * fido2-bench: drive a mix of operations against one or more devices from
+ * a number of workers, and report throughput and latency percentiles per
+ * operation. Each worker has its own device handle; workers on the same
+ * device contend for it as separate CTAPHID channels would.
+ *
+ * Example usage:
+ *
+ * $ fido2-bench -m info=1,assert=4 -n 1000 -t 2 /dev/hidraw5 /dev/hidraw6
+ * $ fido2-bench -m verify -n 10000 -t 8
+ */
+
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+
+#include <fido.h>
+#include <fido/credman.h>
+#include <fido/es256.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "../openbsd-compat/openbsd-compat.h"
+#include "extern.h"
+
+#define BENCH_OPT	"adi:m:n:r:t:"
+#define BENCH_DEV_MAX	64
+#define BENCH_THR_MAX	64
+#define BENCH_WEIGHT_MAX 100
+
+enum {
+	OP_INFO,
+	OP_ASSERT,
+	OP_METADATA,
+	OP_LARGEBLOB,
+	OP_VERIFY,
+	OP_MAX
+};
+
+static const char *op_name[OP_MAX] = {
+	"info",
+	"assert",
+	"metadata",
+	"largeblob",
+	"verify",
+};
+
+struct bench_op {
+	long long *usec;	/* latencies of completed operations */
+	size_t n;
+	size_t errors;
+	int first_error;
+};
+
+struct bench_worker {
+	size_t id;
+	fido_dev_t *dev;	/* NULL for verification only */
+	const char *pin;
+	fido_assert_t *assert;	/* for OP_ASSERT */
+	fido_assert_t *signed_assert; /* for OP_VERIFY */
+	struct bench_op op[OP_MAX];
+#ifdef HAVE_PTHREAD
+	pthread_t t;
+#endif
+};
+
+struct bench {
+	int sched[OP_MAX * BENCH_WEIGHT_MAX]; /* the mix, expanded */
+	size_t nsched;
+	bool uses[OP_MAX];
+	size_t count;		/* operations per worker */
+	const char *rp_id;
+	void *cred_id;
+	size_t cred_id_len;
+	unsigned char authdata[37]; /* for OP_VERIFY */
+	unsigned char sig[80];
+	size_t sig_len;
+	es256_pk_t *pk;
+	struct bench_worker *w;
+	size_t nw;
+};
+
+static struct bench bench;
+
+void
+usage(void)
+{
+	fprintf(stderr,
+"usage: fido2-bench [-d] [-i cred_id] [-m mix] [-n count] [-r rp_id] [-t threads] device ...\n"
+"       fido2-bench -a [-d] [-i cred_id] [-m mix] [-n count] [-r rp_id] [-t threads]\n"
+"       fido2-bench -m verify [-n count] [-t threads]\n"
+	);
+
+	exit(1);
+}
+
+static int
+op_lookup(const char *name, size_t len)
+{
+	for (int i = 0; i < OP_MAX; i++)
+		if (strlen(op_name[i]) == len &&
+		    strncmp(op_name[i], name, len) == 0)
+			return (i);
+
+	return (-1);
+}
+
+/* parse "op[=weight],..." into the schedule workers cycle through */
+static void
+parse_mix(const char *str)
+{
+	char *dup, *p, *tok, *eq;
+	int op, weight;
+
+	if ((dup = strdup(str)) == NULL)
+		err(1, "strdup");
+
+	p = dup;
+	while ((tok = strsep(&p, ",")) != NULL) {
+		weight = 1;
+		if ((eq = strchr(tok, '=')) != NULL) {
+			*eq++ = '\0';
+			if ((weight = base10(eq)) < 1 ||
+			    weight > BENCH_WEIGHT_MAX)
+				errx(1, "-m: invalid weight %s", eq);
+		}
+		if ((op = op_lookup(tok, strlen(tok))) < 0)
+			errx(1, "-m: unknown operation %s", tok);
+		if (bench.uses[op])
+			errx(1, "-m: duplicate operation %s", tok);
+		bench.uses[op] = true;
+		for (int i = 0; i < weight; i++)
+			bench.sched[bench.nsched++] = op;
+	}
+
+	free(dup);
+}
+
+static bool
+uses_dev(void)
+{
+	return (bench.uses[OP_INFO] || bench.uses[OP_ASSERT] ||
+	    bench.uses[OP_METADATA] || bench.uses[OP_LARGEBLOB]);
+}
+
+/*
+ * A signed assertion for OP_VERIFY, made with a throwaway P-256 key so
+ * that verification can be measured without a device.
+ */
+static void
+verify_setup(void)
+{
+	static const unsigned char cdh[32];
+	EVP_PKEY_CTX *ctx = NULL;
+	EVP_MD_CTX *mdctx = NULL;
+	EVP_PKEY *pkey = NULL;
+	unsigned int len;
+
+	memset(bench.authdata, 0, sizeof(bench.authdata));
+	if (EVP_Digest(bench.rp_id, strlen(bench.rp_id), bench.authdata,
+	    &len, EVP_sha256(), NULL) != 1 || len != 32)
+		errx(1, "EVP_Digest");
+	bench.authdata[32] = 0x01; /* up */
+
+	if ((ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL)) == NULL ||
+	    EVP_PKEY_keygen_init(ctx) != 1 ||
+	    EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx,
+	    NID_X9_62_prime256v1) != 1 ||
+	    EVP_PKEY_keygen(ctx, &pkey) != 1)
+		errx(1, "EVP_PKEY_keygen");
+
+	bench.sig_len = sizeof(bench.sig);
+	if ((mdctx = EVP_MD_CTX_new()) == NULL ||
+	    EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL, pkey) != 1 ||
+	    EVP_DigestSignUpdate(mdctx, bench.authdata,
+	    sizeof(bench.authdata)) != 1 ||
+	    EVP_DigestSignUpdate(mdctx, cdh, sizeof(cdh)) != 1 ||
+	    EVP_DigestSignFinal(mdctx, bench.sig, &bench.sig_len) != 1)
+		errx(1, "EVP_DigestSign");
+
+	if ((bench.pk = es256_pk_new()) == NULL ||
+	    es256_pk_from_EVP_PKEY(bench.pk, pkey) != FIDO_OK)
+		errx(1, "es256_pk_from_EVP_PKEY");
+
+	EVP_MD_CTX_free(mdctx);
+	EVP_PKEY_CTX_free(ctx);
+	EVP_PKEY_free(pkey);
+}
+
+static fido_assert_t *
+verify_assert_new(void)
+{
+	static const unsigned char cdh[32];
+	fido_assert_t *assert;
+
+	if ((assert = fido_assert_new()) == NULL)
+		errx(1, "fido_assert_new");
+	if (fido_assert_set_clientdata_hash(assert, cdh,
+	    sizeof(cdh)) != FIDO_OK ||
+	    fido_assert_set_rp(assert, bench.rp_id) != FIDO_OK ||
+	    fido_assert_set_count(assert, 1) != FIDO_OK ||
+	    fido_assert_set_authdata_raw(assert, 0, bench.authdata,
+	    sizeof(bench.authdata)) != FIDO_OK ||
+	    fido_assert_set_sig(assert, 0, bench.sig,
+	    bench.sig_len) != FIDO_OK)
+		errx(1, "fido_assert_set");
+
+	return (assert);
+}
+
+/* a silent assertion, reused by the worker */
+static fido_assert_t *
+get_assert_new(void)
+{
+	fido_assert_t *assert;
+
+	if ((assert = fido_assert_new()) == NULL)
+		errx(1, "fido_assert_new");
+	if (fido_assert_set_rp(assert, bench.rp_id) != FIDO_OK ||
+	    fido_assert_set_up(assert, FIDO_OPT_FALSE) != FIDO_OK)
+		errx(1, "fido_assert_set");
+	if (bench.cred_id != NULL && fido_assert_allow_cred(assert,
+	    bench.cred_id, bench.cred_id_len) != FIDO_OK)
+		errx(1, "fido_assert_allow_cred");
+
+	return (assert);
+}
+
+static int
+op_info(struct bench_worker *w)
+{
+	fido_cbor_info_t *ci;
+	int r;
+
+	if ((ci = fido_cbor_info_new()) == NULL)
+		return (FIDO_ERR_INTERNAL);
+	r = fido_dev_get_cbor_info(w->dev, ci);
+	fido_cbor_info_free(&ci);
+
+	return (r);
+}
+
+static int
+op_assert(struct bench_worker *w, size_t i)
+{
+	unsigned char cdh[32];
+	int r;
+
+	memset(cdh, 0, sizeof(cdh));
+	memcpy(cdh, &i, sizeof(i));
+	if ((r = fido_assert_set_clientdata_hash(w->assert, cdh,
+	    sizeof(cdh))) != FIDO_OK)
+		return (r);
+	/* a completed lookup, whether or not it found a credential */
+	if ((r = fido_dev_get_assert(w->dev, w->assert,
+	    NULL)) == FIDO_ERR_NO_CREDENTIALS)
+		r = FIDO_OK;
+
+	return (r);
+}
+
+static int
+op_metadata(struct bench_worker *w)
+{
+	fido_credman_metadata_t *md;
+	int r;
+
+	if ((md = fido_credman_metadata_new()) == NULL)
+		return (FIDO_ERR_INTERNAL);
+	r = fido_credman_get_dev_metadata(w->dev, md, w->pin);
+	fido_credman_metadata_free(&md);
+
+	return (r);
+}
+
+static int
+op_largeblob(struct bench_worker *w)
+{
+	unsigned char *ptr = NULL;
+	size_t len = 0;
+	int r;
+
+	r = fido_dev_largeblob_get_array(w->dev, &ptr, &len);
+	free(ptr);
+
+	return (r);
+}
+
+static int
+op_verify(struct bench_worker *w)
+{
+	return (fido_assert_verify(w->signed_assert, 0, COSE_ES256,
+	    bench.pk));
+}
+
+static int
+op_run(struct bench_worker *w, int op, size_t i)
+{
+	switch (op) {
+	case OP_INFO:
+		return (op_info(w));
+	case OP_ASSERT:
+		return (op_assert(w, i));
+	case OP_METADATA:
+		return (op_metadata(w));
+	case OP_LARGEBLOB:
+		return (op_largeblob(w));
+	case OP_VERIFY:
+		return (op_verify(w));
+	}
+
+	return (FIDO_ERR_INTERNAL);
+}
+
+static void
+worker_run(struct bench_worker *w)
+{
+	struct timespec t0, t1;
+	struct bench_op *o;
+	int op, r;
+
+	for (size_t i = 0; i < bench.count; i++) {
+		/* workers start at different points of the mix */
+		op = bench.sched[(w->id + i) % bench.nsched];
+		o = &w->op[op];
+		if (clock_gettime(CLOCK_MONOTONIC, &t0) != 0)
+			err(1, "clock_gettime");
+		r = op_run(w, op, i);
+		if (clock_gettime(CLOCK_MONOTONIC, &t1) != 0)
+			err(1, "clock_gettime");
+		if (r != FIDO_OK) {
+			if (o->errors++ == 0)
+				o->first_error = r;
+			continue;
+		}
+		timespecsub(&t1, &t0, &t1);
+		o->usec[o->n++] = (long long)t1.tv_sec * 1000000 +
+		    t1.tv_nsec / 1000;
+	}
+}
+
+#ifdef HAVE_PTHREAD
+static void *
+worker_thread(void *arg)
+{
+	worker_run(arg);
+
+	return (NULL);
+}
+#endif
+
+static void
+worker_setup(struct bench_worker *w, size_t id, const char *path,
+    const char *pin)
+{
+	int r;
+
+	w->id = id;
+	w->pin = pin;
+	if (path != NULL) {
+		if ((w->dev = fido_dev_new()) == NULL)
+			errx(1, "fido_dev_new");
+		if ((r = fido_dev_open(w->dev, path)) != FIDO_OK)
+			errx(1, "fido_dev_open %s: %s", path, fido_strerr(r));
+	}
+	if (bench.uses[OP_ASSERT])
+		w->assert = get_assert_new();
+	if (bench.uses[OP_VERIFY])
+		w->signed_assert = verify_assert_new();
+	for (int i = 0; i < OP_MAX; i++)
+		if (bench.uses[i] && (w->op[i].usec = calloc(bench.count,
+		    sizeof(*w->op[i].usec))) == NULL)
+			err(1, "calloc");
+}
+
+static void
+worker_free(struct bench_worker *w)
+{
+	if (w->dev != NULL) {
+		fido_dev_close(w->dev);
+		fido_dev_free(&w->dev);
+	}
+	fido_assert_free(&w->assert);
+	fido_assert_free(&w->signed_assert);
+	for (int i = 0; i < OP_MAX; i++)
+		free(w->op[i].usec);
+}
+
+static int
+cmp_usec(const void *a, const void *b)
+{
+	const long long x = *(const long long *)a;
+	const long long y = *(const long long *)b;
+
+	return ((x > y) - (x < y));
+}
+
+static void
+report(double secs)
+{
+	long long *usec;
+	size_t n, errors, total;
+	int first_error;
+
+	printf("%zu worker%s, %.3fs\n", bench.nw, plural(bench.nw), secs);
+	printf("%-10s %8s %6s %10s %8s %8s %8s %8s %8s\n", "op", "count",
+	    "errors", "ops/s", "min", "p50", "p90", "p99", "max");
+
+	for (int op = 0; op < OP_MAX; op++) {
+		if (!bench.uses[op])
+			continue;
+		total = errors = 0;
+		first_error = FIDO_OK;
+		for (size_t i = 0; i < bench.nw; i++) {
+			total += bench.w[i].op[op].n;
+			errors += bench.w[i].op[op].errors;
+			if (first_error == FIDO_OK)
+				first_error = bench.w[i].op[op].first_error;
+		}
+		if (total == 0) {
+			printf("%-10s %8d %6zu\n", op_name[op], 0, errors);
+		} else {
+			if ((usec = calloc(total, sizeof(*usec))) == NULL)
+				err(1, "calloc");
+			n = 0;
+			for (size_t i = 0; i < bench.nw; i++) {
+				memcpy(&usec[n], bench.w[i].op[op].usec,
+				    bench.w[i].op[op].n * sizeof(*usec));
+				n += bench.w[i].op[op].n;
+			}
+			qsort(usec, total, sizeof(*usec), cmp_usec);
+			printf("%-10s %8zu %6zu %10.1f %8lld %8lld %8lld %8lld "
+			    "%8lld\n", op_name[op], total, errors,
+			    secs > 0 ? (double)total / secs : 0.0, usec[0],
+			    usec[total / 2], usec[total * 9 / 10],
+			    usec[total * 99 / 100], usec[total - 1]);
+			free(usec);
+		}
+		if (errors > 0)
+			warnx("%s: %s (0x%x)", op_name[op],
+			    fido_strerr(first_error), first_error);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	fido_dev_info_t *devlist = NULL;
+	const char *path[BENCH_DEV_MAX];
+	char *pin[BENCH_DEV_MAX];
+	struct timespec t0, t1;
+	size_t ndevs = 0, nthreads = 1;
+	int all = 0, flags = 0;
+	int ch, n, r, failed = 0;
+
+	memset(pin, 0, sizeof(pin));
+	bench.count = 100;
+	bench.rp_id = "localhost";
+
+	while ((ch = getopt(argc, argv, BENCH_OPT)) != -1) {
+		switch (ch) {
+		case 'a':
+			all = 1;
+			break;
+		case 'd':
+			flags = FIDO_DEBUG;
+			break;
+		case 'i':
+			if (base64_decode(optarg, &bench.cred_id,
+			    &bench.cred_id_len) < 0)
+				errx(1, "-i: invalid cred_id %s", optarg);
+			break;
+		case 'm':
+			if (bench.nsched != 0)
+				usage();
+			parse_mix(optarg);
+			break;
+		case 'n':
+			if ((n = base10(optarg)) < 1)
+				errx(1, "-n: invalid count %s", optarg);
+			bench.count = (size_t)n;
+			break;
+		case 'r':
+			bench.rp_id = optarg;
+			break;
+		case 't':
+			if ((n = base10(optarg)) < 1 || n > BENCH_THR_MAX)
+				errx(1, "-t: invalid threads %s", optarg);
+			nthreads = (size_t)n;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (bench.nsched == 0)
+		parse_mix("info");
+	if ((all && argc > 0) || (!all && uses_dev() != (argc > 0)) ||
+	    argc > BENCH_DEV_MAX)
+		usage();
+
+	fido_init(flags);
+
+	if (all) {
+		if ((devlist = fido_dev_info_new(BENCH_DEV_MAX)) == NULL)
+			errx(1, "fido_dev_info_new");
+		if ((r = fido_dev_info_manifest(devlist, BENCH_DEV_MAX,
+		    &ndevs)) != FIDO_OK)
+			errx(1, "fido_dev_info_manifest: %s (0x%x)",
+			    fido_strerr(r), r);
+		if (ndevs == 0)
+			errx(1, "no devices found");
+		for (size_t i = 0; i < ndevs; i++)
+			path[i] = fido_dev_info_path(fido_dev_info_ptr(devlist,
+			    i));
+	} else {
+		ndevs = (size_t)argc;
+		for (size_t i = 0; i < ndevs; i++)
+			path[i] = argv[i];
+	}
+
+	if (bench.uses[OP_VERIFY])
+		verify_setup();
+	if (bench.uses[OP_METADATA])
+		for (size_t i = 0; i < ndevs; i++)
+			if ((pin[i] = get_pin(path[i])) == NULL)
+				errx(1, "get_pin");
+
+	/* devices are opened up front; only the operations are timed */
+	bench.nw = (ndevs > 0 ? ndevs : 1) * nthreads;
+	if ((bench.w = calloc(bench.nw, sizeof(*bench.w))) == NULL)
+		err(1, "calloc");
+	for (size_t i = 0; i < bench.nw; i++)
+		worker_setup(&bench.w[i], i, ndevs > 0 ? path[i % ndevs] :
+		    NULL, ndevs > 0 ? pin[i % ndevs] : NULL);
+
+	if (clock_gettime(CLOCK_MONOTONIC, &t0) != 0)
+		err(1, "clock_gettime");
+#ifdef HAVE_PTHREAD
+	for (size_t i = 0; i < bench.nw; i++)
+		if (pthread_create(&bench.w[i].t, NULL, worker_thread,
+		    &bench.w[i]) != 0)
+			errx(1, "pthread_create");
+	for (size_t i = 0; i < bench.nw; i++)
+		if (pthread_join(bench.w[i].t, NULL) != 0)
+			errx(1, "pthread_join");
+#else
+	for (size_t i = 0; i < bench.nw; i++)
+		worker_run(&bench.w[i]);
+#endif
+	if (clock_gettime(CLOCK_MONOTONIC, &t1) != 0)
+		err(1, "clock_gettime");
+	timespecsub(&t1, &t0, &t1);
+
+	report((double)t1.tv_sec + (double)t1.tv_nsec / 1e9);
+
+	for (size_t i = 0; i < bench.nw; i++) {
+		for (int op = 0; op < OP_MAX; op++)
+			if (bench.w[i].op[op].errors > 0)
+				failed = 1;
+		worker_free(&bench.w[i]);
+	}
+	for (size_t i = 0; i < ndevs; i++)
+		if (pin[i] != NULL)
+			freezero(pin[i], PINBUF_LEN);
+	free(bench.w);
+	free(bench.cred_id);
+	es256_pk_free(&bench.pk);
+	fido_dev_info_free(&devlist, BENCH_DEV_MAX);
+
+	exit(failed);
+}
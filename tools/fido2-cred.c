@@ -29,6 +29,7 @@ usage(void)
 	fprintf(stderr,
 "usage: fido2-cred -M [-bdhqruvw] [-c cred_protect] [-i input_file] [-o output_file] device [type]\n"
 "       fido2-cred -V [-dhv] [-c cred_protect] [-i input_file] [-o output_file] [type]\n"
+"       fido2-cred -V -B [-dhv] [-a anchor_file] [-c cred_protect] [-j jobs] [-i input_file] [-o output_file] [type]\n"
 	);
 
 	exit(1);
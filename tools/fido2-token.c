@@ -18,19 +18,26 @@ void
 usage(void)
 {
 	fprintf(stderr,
-"usage: fido2-token -C [-d] device\n"
+"usage: fido2-token -B [-d] [-n count] device\n"
+"       fido2-token -C [-d] device\n"
 "       fido2-token -Db [-k key_path] [-i cred_id -n rp_id] device\n"
 "       fido2-token -Dei template_id device\n"
 "       fido2-token -Du device\n"
 "       fido2-token -Gb [-k key_path] [-i cred_id -n rp_id] blob_path device\n"
 "       fido2-token -I [-cd] [-k rp_id -i cred_id]  device\n"
-"       fido2-token -L [-bder] [-k rp_id] [device]\n"
-"       fido2-token -R [-d] device\n"
+"       fido2-token -I -a [-d]\n"
+"       fido2-token -L [-bder] [-k rp_id] [-o cache_path] [device]\n"
+"       fido2-token -P [-d] script_file device ...\n"
+"       fido2-token -P -a [-d] script_file\n"
+"       fido2-token -R [-d] device ...\n"
+"       fido2-token -R -a [-d]\n"
+"       fido2-token -R -w [-d] [-n count]\n"
 "       fido2-token -S [-adefu] [-l pin_length] [-i template_id -n template_name] device\n"
 "       fido2-token -Sb [-k key_path] [-i cred_id -n rp_id] blob_path device\n"
 "       fido2-token -Sc -i cred_id -k user_id -n name -p display_name device\n"
 "       fido2-token -Sm rp_id device\n"
 "       fido2-token -V\n"
+"       fido2-token -X [-d] endpoint device\n"
 	);
 
 	exit(1);
@@ -63,9 +70,11 @@ main(int argc, char **argv)
 		case 'l':
 		case 'm':
 		case 'n':
+		case 'o':
 		case 'p':
 		case 'r':
 		case 'u':
+		case 'w':
 			break; /* ignore */
 		case 'd':
 			flags = FIDO_DEBUG;
@@ -84,6 +93,8 @@ main(int argc, char **argv)
 	fido_init(flags);
 
 	switch (action) {
+	case 'B':
+		return (token_bench(argc, argv, device));
 	case 'C':
 		return (pin_change(device));
 	case 'D':
@@ -94,14 +105,18 @@ main(int argc, char **argv)
 		return (token_info(argc, argv, device));
 	case 'L':
 		return (token_list(argc, argv, device));
+	case 'P':
+		return (token_provision(argc, argv));
 	case 'R':
-		return (token_reset(device));
+		return (token_reset(argc, argv));
 	case 'S':
 		return (token_set(argc, argv, device));
 	case 'V':
 		fprintf(stderr, "%d.%d.%d\n", _FIDO_MAJOR, _FIDO_MINOR,
 		    _FIDO_PATCH);
 		exit(0);
+	case 'X':
+		return (token_serve(argc, argv, device));
 	}
 
 	usage();
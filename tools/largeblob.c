@@ -20,27 +20,62 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
-#include <zlib.h>
 
 #include "../openbsd-compat/openbsd-compat.h"
 #include "extern.h"
 
-#define BOUND (1024UL * 1024UL)
-
 struct rkmap {
-	fido_credman_rp_t  *rp; /* known rps */
-	fido_credman_rk_t **rk; /* rk per rp */
+	fido_credman_session_t   *session; /* rps, rks looked up */
+	const fido_credman_rp_t  *rp;      /* known rps */
+	const fido_credman_rk_t **rk;      /* rk per rp */
+	fido_largeblob_item_t    *key;     /* known largeblob keys */
+	const fido_cred_t       **cred;    /* rk per key */
+	size_t                   *key_rp;  /* rp per key */
+	size_t                    nkeys;
 };
 
 static void
 free_rkmap(struct rkmap *map)
 {
-	if (map->rp != NULL) {
-		for (size_t i = 0; i < fido_credman_rp_count(map->rp); i++)
-			fido_credman_rk_free(&map->rk[i]);
-		fido_credman_rp_free(&map->rp);
-	}
+	fido_credman_session_free(&map->session);
 	free(map->rk);
+	free(map->key);
+	free(map->cred);
+	free(map->key_rp);
+}
+
+static int
+index_keys(struct rkmap *map)
+{
+	const fido_cred_t *cred;
+	size_t n = 0;
+
+	for (size_t i = 0; i < fido_credman_rp_count(map->rp); i++)
+		n += fido_credman_rk_count(map->rk[i]);
+	if (n == 0)
+		return 0;
+	if ((map->key = calloc(n, sizeof(*map->key))) == NULL ||
+	    (map->cred = calloc(n, sizeof(*map->cred))) == NULL ||
+	    (map->key_rp = calloc(n, sizeof(*map->key_rp))) == NULL) {
+		warnx("%s: calloc", __func__);
+		return -1;
+	}
+	for (size_t i = 0; i < fido_credman_rp_count(map->rp); i++)
+		for (size_t j = 0; j < fido_credman_rk_count(map->rk[i]); j++) {
+			if ((cred = fido_credman_rk(map->rk[i], j)) == NULL ||
+			    fido_cred_largeblob_key_ptr(cred) == NULL ||
+			    fido_cred_largeblob_key_len(cred) != 32)
+				continue;
+			map->key[map->nkeys].key_ptr =
+			    fido_cred_largeblob_key_ptr(cred);
+			map->key[map->nkeys].key_len =
+			    fido_cred_largeblob_key_len(cred);
+			map->cred[map->nkeys] = cred;
+			map->key_rp[map->nkeys] = i;
+			map->nkeys++;
+		}
+
+	return 0;
 }
 
 static int
@@ -51,16 +86,18 @@ map_known_rps(fido_dev_t *dev, const char *path, struct rkmap *map)
 	size_t n;
 	int r, ok = -1;
 
-	if ((map->rp = fido_credman_rp_new()) == NULL) {
-		warnx("%s: fido_credman_rp_new", __func__);
+	if ((map->session = fido_credman_session_new()) == NULL) {
+		warnx("%s: fido_credman_session_new", __func__);
 		goto out;
 	}
 	if ((pin = get_pin(path)) == NULL)
 		goto out;
-	if ((r = fido_credman_get_dev_rp(dev, map->rp, pin)) != FIDO_OK) {
-		warnx("fido_credman_get_dev_rp: %s", fido_strerr(r));
+	if ((r = fido_credman_session_begin(dev, map->session,
+	    pin)) != FIDO_OK) {
+		warnx("fido_credman_session_begin: %s", fido_strerr(r));
 		goto out;
 	}
+	map->rp = fido_credman_session_rp(map->session);
 	if ((n = fido_credman_rp_count(map->rp)) > UINT8_MAX) {
 		warnx("%s: fido_credman_rp_count > UINT8_MAX", __func__);
 		goto out;
@@ -74,17 +111,17 @@ map_known_rps(fido_dev_t *dev, const char *path, struct rkmap *map)
 			warnx("%s: fido_credman_rp_id %zu", __func__, i);
 			goto out;
 		}
-		if ((map->rk[i] = fido_credman_rk_new()) == NULL) {
-			warnx("%s: fido_credman_rk_new", __func__);
-			goto out;
-		}
-		if ((r = fido_credman_get_dev_rk(dev, rp_id, map->rk[i],
-		    pin)) != FIDO_OK) {
-			warnx("%s: fido_credman_get_dev_rk %s: %s", __func__,
+		if ((r = fido_credman_session_rk(map->session,
+		    fido_credman_rp_id_hash_ptr(map->rp, i),
+		    fido_credman_rp_id_hash_len(map->rp, i),
+		    &map->rk[i])) != FIDO_OK) {
+			warnx("%s: fido_credman_session_rk %s: %s", __func__,
 			    rp_id, fido_strerr(r));
 			goto out;
 		}
 	}
+	if (index_keys(map) < 0)
+		goto out;
 
 	ok = 0;
 out:
@@ -206,7 +243,7 @@ blob_set(const char *path, const char *keyf, const char *rp_id,
 	memset(&key, 0, sizeof(key));
 	memset(&blob, 0, sizeof(blob));
 
-	if (read_file(blobf, &blob.ptr, &blob.len) < 0 ||
+	if (map_file(blobf, &blob) < 0 ||
 	    load_key(keyf, cred_id64, rp_id, path, dev, &pin, &key) < 0)
 		goto out;
 	if ((r = fido_dev_largeblob_set(dev, key.ptr, key.len, blob.ptr,
@@ -224,7 +261,7 @@ blob_set(const char *path, const char *keyf, const char *rp_id,
 	ok = 0; /* success */
 out:
 	freezero(key.ptr, key.len);
-	freezero(blob.ptr, blob.len);
+	unmap_file(&blob);
 	freezero(pin, PINBUF_LEN);
 
 	fido_dev_close(dev);
@@ -304,129 +341,6 @@ out:
 	exit(ok);
 }
 
-static int
-try_decompress(const struct blob *in, uint64_t origsiz, int wbits)
-{
-	struct blob out;
-	z_stream zs;
-	u_int ilen, olen;
-	int ok = -1;
-
-	memset(&zs, 0, sizeof(zs));
-	memset(&out, 0, sizeof(out));
-
-	if (in->len > UINT_MAX || (ilen = (u_int)in->len) > BOUND)
-		return -1;
-	if (origsiz > SIZE_MAX || origsiz > UINT_MAX ||
-	    (olen = (u_int)origsiz) > BOUND)
-		return -1;
-	if (inflateInit2(&zs, wbits) != Z_OK)
-		return -1;
-
-	if ((out.ptr = calloc(1, olen)) == NULL)
-		goto fail;
-
-	out.len = olen;
-	zs.next_in = in->ptr;
-	zs.avail_in = ilen;
-	zs.next_out = out.ptr;
-	zs.avail_out = olen;
-
-	if (inflate(&zs, Z_FINISH) != Z_STREAM_END)
-		goto fail;
-	if (zs.avail_out != 0)
-		goto fail;
-
-	ok = 0;
-fail:
-	if (inflateEnd(&zs) != Z_OK)
-		ok = -1;
-
-	freezero(out.ptr, out.len);
-
-	return ok;
-}
-
-static int
-decompress(const struct blob *plaintext, uint64_t origsiz)
-{
-	if (try_decompress(plaintext, origsiz, MAX_WBITS) == 0) /* rfc1950 */
-		return 0;
-	return try_decompress(plaintext, origsiz, -MAX_WBITS); /* rfc1951 */
-}
-
-static int
-decode(const struct blob *ciphertext, const struct blob *nonce,
-    uint64_t origsiz, const fido_cred_t *cred)
-{
-	uint8_t aad[4 + sizeof(uint64_t)];
-	EVP_CIPHER_CTX *ctx = NULL;
-	const EVP_CIPHER *cipher;
-	struct blob plaintext;
-	uint64_t tmp;
-	int ok = -1;
-
-	memset(&plaintext, 0, sizeof(plaintext));
-
-	if (nonce->len != 12)
-		return -1;
-	if (cred == NULL ||
-	    fido_cred_largeblob_key_ptr(cred) == NULL ||
-	    fido_cred_largeblob_key_len(cred) != 32)
-		return -1;
-	if (ciphertext->len > UINT_MAX ||
-	    ciphertext->len > SIZE_MAX - 16 ||
-	    ciphertext->len < 16)
-		return -1;
-	plaintext.len = ciphertext->len - 16;
-	if ((plaintext.ptr = calloc(1, plaintext.len)) == NULL)
-		return -1;
-	if ((ctx = EVP_CIPHER_CTX_new()) == NULL ||
-	    (cipher = EVP_aes_256_gcm()) == NULL ||
-	    EVP_CipherInit(ctx, cipher, fido_cred_largeblob_key_ptr(cred),
-	    nonce->ptr, 0) == 0)
-		goto out;
-	if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16,
-	    ciphertext->ptr + ciphertext->len - 16) == 0)
-		goto out;
-	aad[0] = 0x62; /* b */
-	aad[1] = 0x6c; /* l */
-	aad[2] = 0x6f; /* o */
-	aad[3] = 0x62; /* b */
-	tmp = htole64(origsiz);
-	memcpy(&aad[4], &tmp, sizeof(uint64_t));
-	if (EVP_Cipher(ctx, NULL, aad, (u_int)sizeof(aad)) < 0 ||
-	    EVP_Cipher(ctx, plaintext.ptr, ciphertext->ptr,
-	    (u_int)plaintext.len) < 0 ||
-	    EVP_Cipher(ctx, NULL, NULL, 0) < 0)
-		goto out;
-	if (decompress(&plaintext, origsiz) < 0)
-		goto out;
-
-	ok = 0;
-out:
-	freezero(plaintext.ptr, plaintext.len);
-
-	if (ctx != NULL)
-		EVP_CIPHER_CTX_free(ctx);
-
-	return ok;
-}
-
-static const fido_cred_t *
-try_rp(const fido_credman_rk_t *rk, const struct blob *ciphertext,
-    const struct blob *nonce, uint64_t origsiz)
-{
-	const fido_cred_t *cred;
-
-	for (size_t i = 0; i < fido_credman_rk_count(rk); i++)
-		if ((cred = fido_credman_rk(rk, i)) != NULL &&
-		    decode(ciphertext, nonce, origsiz, cred) == 0)
-			return cred;
-
-	return NULL;
-}
-
 static int
 decode_cbor_blob(struct blob *out, const cbor_item_t *item)
 {
@@ -484,7 +398,8 @@ decode_blob_entry(const cbor_item_t *item, struct blob *ciphertext,
 }
 
 static void
-print_blob_entry(size_t idx, const cbor_item_t *item, const struct rkmap *map)
+print_blob_entry(size_t idx, const cbor_item_t *item, const struct rkmap *map,
+    size_t key)
 {
 	struct blob ciphertext, nonce;
 	const fido_cred_t *cred = NULL;
@@ -499,12 +414,9 @@ print_blob_entry(size_t idx, const cbor_item_t *item, const struct rkmap *map)
 		printf("%02zu: <skipped: bad cbor>\n", idx);
 		goto out;
 	}
-	for (size_t i = 0; i < fido_credman_rp_count(map->rp); i++) {
-		if ((cred = try_rp(map->rk[i], &ciphertext, &nonce,
-		    origsiz)) != NULL) {
-			rp_id = fido_credman_rp_id(map->rp, i);
-			break;
-		}
+	if (key < map->nkeys) {
+		cred = map->cred[key];
+		rp_id = fido_credman_rp_id(map->rp, map->key_rp[key]);
 	}
 	if (cred == NULL) {
 		if ((cred_id = strdup("<unknown>")) == NULL) {
@@ -530,12 +442,12 @@ out:
 }
 
 static cbor_item_t *
-get_cbor_array(fido_dev_t *dev)
+get_cbor_array(fido_dev_t *dev, struct blob *cbor)
 {
 	struct cbor_load_result cbor_result;
 	cbor_item_t *item = NULL;
 	u_char *cbor_ptr = NULL;
-	size_t cbor_len;
+	size_t cbor_len = 0;
 	int r, ok = -1;
 
 	if ((r = fido_dev_largeblob_get_array(dev, &cbor_ptr,
@@ -575,7 +487,11 @@ out:
 		cbor_decref(&item);
 		item = NULL;
 	}
-	free(cbor_ptr);
+	if (item != NULL) {
+		cbor->ptr = cbor_ptr;
+		cbor->len = cbor_len;
+	} else
+		free(cbor_ptr);
 
 	return item;
 }
@@ -584,14 +500,17 @@ int
 blob_list(const char *path)
 {
 	struct rkmap map;
+	struct blob cbor;
 	fido_dev_t *dev = NULL;
 	cbor_item_t *item = NULL, **v;
-	int ok = 1;
+	size_t *match = NULL;
+	int r, ok = 1;
 
 	memset(&map, 0, sizeof(map));
+	memset(&cbor, 0, sizeof(cbor));
 	dev = open_dev(path);
 	if (map_known_rps(dev, path, &map) < 0 ||
-	    (item = get_cbor_array(dev)) == NULL)
+	    (item = get_cbor_array(dev, &cbor)) == NULL)
 		goto out;
 	if (cbor_array_size(item) == 0) {
 		ok = 0; /* nothing to do */
@@ -601,12 +520,24 @@ blob_list(const char *path)
 		warnx("%s: cbor_array_handle", __func__);
 		goto out;
 	}
+	if ((match = calloc(cbor_array_size(item), sizeof(*match))) == NULL) {
+		warnx("%s: calloc", __func__);
+		goto out;
+	}
+	if ((r = fido_largeblob_array_match(cbor.ptr, cbor.len, map.key,
+	    map.nkeys, match, cbor_array_size(item))) != FIDO_OK) {
+		warnx("%s: fido_largeblob_array_match: %s", __func__,
+		    fido_strerr(r));
+		goto out;
+	}
 	for (size_t i = 0; i < cbor_array_size(item); i++)
-		print_blob_entry(i, v[i], &map);
+		print_blob_entry(i, v[i], &map, match[i]);
 
 	ok = 0; /* success */
 out:
 	free_rkmap(&map);
+	free(match);
+	free(cbor.ptr);
 
 	if (item != NULL)
 		cbor_decref(&item);
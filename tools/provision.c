@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * fido2-token -P: apply a script of provisioning steps to one or more
+ * devices. Each device is opened once and keeps its pinUvAuthToken
+ * across steps; devices are provisioned concurrently.
+ */
+
+#include <fido.h>
+#include <fido/config.h>
+#include <fido/credman.h>
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "../openbsd-compat/openbsd-compat.h"
+#ifdef _MSC_VER
+#include "../openbsd-compat/posix_win.h"
+#endif
+
+#include "extern.h"
+
+enum {
+	STEP_SET_PIN,
+	STEP_PIN_MINLEN,
+	STEP_PIN_MINLEN_RPID,
+	STEP_FORCE_PIN_CHANGE,
+	STEP_ALWAYS_UV,
+	STEP_ENABLE_ENTATTEST,
+	STEP_DELETE_RK,
+};
+
+struct step {
+	int type;
+	char *text;	/* as written in the script */
+	size_t line;
+	size_t len;	/* pin-minlen */
+	int toggle;	/* always-uv */
+	char **rpid;	/* pin-minlen-rpid */
+	size_t nrpid;
+	void *id;	/* delete-rk */
+	size_t idlen;
+};
+
+struct script {
+	struct step *step;
+	size_t n;
+	bool set_pin;
+};
+
+struct prov_dev {
+	const char *path;
+	const fido_dev_info_t *di; /* with -a */
+	fido_dev_t *dev;
+	int open_r;
+	bool has_pin;
+	size_t done;	/* steps attempted */
+	int r;		/* outcome of the last attempted step */
+};
+
+struct prov {
+	const struct script *script;
+	struct prov_dev *pd;
+	const char *pin;
+};
+
+static const struct {
+	const char *name;
+	int type;
+	int nargs;
+} step_tab[] = {
+	{ "set-pin",		STEP_SET_PIN,		0 },
+	{ "pin-minlen",		STEP_PIN_MINLEN,	1 },
+	{ "pin-minlen-rpid",	STEP_PIN_MINLEN_RPID,	1 },
+	{ "force-pin-change",	STEP_FORCE_PIN_CHANGE,	0 },
+	{ "always-uv",		STEP_ALWAYS_UV,		1 },
+	{ "enable-entattest",	STEP_ENABLE_ENTATTEST,	0 },
+	{ "delete-rk",		STEP_DELETE_RK,		1 },
+};
+
+static void
+parse_rpids(struct step *s, const char *arg)
+{
+	char *otmp, *tmp, *cp;
+
+	if ((tmp = strdup(arg)) == NULL)
+		err(1, "strdup");
+	otmp = tmp;
+	while ((cp = strsep(&tmp, ",")) != NULL) {
+		if (*cp == '\0')
+			errx(1, "line %zu: empty rp_id", s->line);
+		if (s->nrpid == SIZE_MAX || (s->rpid = recallocarray(s->rpid,
+		    s->nrpid, s->nrpid + 1, sizeof(*s->rpid))) == NULL)
+			err(1, "recallocarray");
+		if ((s->rpid[s->nrpid++] = strdup(cp)) == NULL)
+			err(1, "strdup");
+	}
+	free(otmp);
+}
+
+static void
+parse_step(struct step *s, char *line)
+{
+	char *word[3];
+	size_t nwords = 0;
+	int len;
+
+	while (nwords < sizeof(word) / sizeof(word[0]) &&
+	    (word[nwords] = strsep(&line, " \t")) != NULL)
+		if (*word[nwords] != '\0')
+			nwords++;
+	if (line != NULL && strspn(line, " \t") != strlen(line))
+		errx(1, "line %zu: too many arguments", s->line);
+
+	for (size_t i = 0; i < sizeof(step_tab) / sizeof(step_tab[0]); i++) {
+		if (strcmp(word[0], step_tab[i].name) != 0)
+			continue;
+		if (nwords != (size_t)step_tab[i].nargs + 1)
+			errx(1, "line %zu: %s takes %d argument%s", s->line,
+			    step_tab[i].name, step_tab[i].nargs,
+			    plural((size_t)step_tab[i].nargs));
+		s->type = step_tab[i].type;
+		switch (s->type) {
+		case STEP_PIN_MINLEN:
+			if ((len = base10(word[1])) < 0 || len > 63)
+				errx(1, "line %zu: invalid length %s",
+				    s->line, word[1]);
+			s->len = (size_t)len;
+			break;
+		case STEP_PIN_MINLEN_RPID:
+			parse_rpids(s, word[1]);
+			break;
+		case STEP_ALWAYS_UV:
+			if (strcmp(word[1], "on") == 0)
+				s->toggle = 1;
+			else if (strcmp(word[1], "off") == 0)
+				s->toggle = 0;
+			else
+				errx(1, "line %zu: expected on or off",
+				    s->line);
+			break;
+		case STEP_DELETE_RK:
+			if (base64_decode(word[1], &s->id, &s->idlen) < 0)
+				errx(1, "line %zu: invalid credential id",
+				    s->line);
+			break;
+		}
+		return;
+	}
+
+	errx(1, "line %zu: unknown step %s", s->line, word[0]);
+}
+
+/* one step per line; blank lines and lines starting with '#' are skipped */
+static void
+read_script(const char *path, struct script *sc)
+{
+	FILE *f;
+	char *line = NULL, *cp;
+	size_t linesize = 0, lineno = 0;
+	ssize_t n;
+	struct step *s;
+
+	memset(sc, 0, sizeof(*sc));
+	f = open_read(path);
+
+	while ((n = getline(&line, &linesize, f)) > 0) {
+		lineno++;
+		if ((size_t)n != strlen(line))
+			errx(1, "line %zu: embedded NUL", lineno);
+		line[strcspn(line, "\r\n")] = '\0';
+		for (cp = line; isspace((unsigned char)*cp); cp++)
+			continue;
+		if (*cp == '\0' || *cp == '#')
+			continue;
+		if ((sc->step = recallocarray(sc->step, sc->n, sc->n + 1,
+		    sizeof(*sc->step))) == NULL)
+			err(1, "recallocarray");
+		s = &sc->step[sc->n++];
+		s->line = lineno;
+		if ((s->text = strdup(cp)) == NULL)
+			err(1, "strdup");
+		parse_step(s, cp);
+		if (s->type == STEP_SET_PIN) {
+			if (sc->n != 1)
+				errx(1, "line %zu: set-pin must be the first "
+				    "step", lineno);
+			sc->set_pin = true;
+		}
+	}
+	if (ferror(f))
+		err(1, "%s", path);
+
+	free(line);
+	fclose(f);
+
+	if (sc->n == 0)
+		errx(1, "%s: no steps", path);
+}
+
+static void
+free_script(struct script *sc)
+{
+	for (size_t i = 0; i < sc->n; i++) {
+		struct step *s = &sc->step[i];
+
+		for (size_t j = 0; j < s->nrpid; j++)
+			free(s->rpid[j]);
+		free(s->rpid);
+		free(s->id);
+		free(s->text);
+	}
+	free(sc->step);
+}
+
+static int
+run_step(struct prov_dev *pd, const struct step *s, const char *pin)
+{
+	const char *p = pd->has_pin ? pin : NULL;
+	int v, r;
+
+	switch (s->type) {
+	case STEP_SET_PIN:
+		if ((r = fido_dev_set_pin(pd->dev, pin, NULL)) == FIDO_OK)
+			pd->has_pin = true;
+		return (r);
+	case STEP_PIN_MINLEN:
+		return (fido_dev_set_pin_minlen(pd->dev, s->len, p));
+	case STEP_PIN_MINLEN_RPID:
+		return (fido_dev_set_pin_minlen_rpid(pd->dev,
+		    (const char * const *)s->rpid, s->nrpid, p));
+	case STEP_FORCE_PIN_CHANGE:
+		return (fido_dev_force_pin_change(pd->dev, p));
+	case STEP_ALWAYS_UV:
+		if (get_devopt(pd->dev, FIDO_INFO_OPT_ALWAYS_UV, &v) < 0)
+			return (FIDO_ERR_INTERNAL);
+		if (v == -1)
+			return (FIDO_ERR_UNSUPPORTED_OPTION);
+		if (v == s->toggle)
+			return (FIDO_OK);
+		return (fido_dev_toggle_always_uv(pd->dev, p));
+	case STEP_ENABLE_ENTATTEST:
+		return (fido_dev_enable_entattest(pd->dev, p));
+	case STEP_DELETE_RK:
+		return (fido_credman_del_dev_rk(pd->dev, s->id, s->idlen, p));
+	}
+
+	return (FIDO_ERR_INTERNAL);
+}
+
+static void
+open_one(void *arg, size_t i)
+{
+	struct prov *pv = arg;
+	struct prov_dev *pd = &pv->pd[i];
+
+	if (pd->di != NULL) {
+		if ((pd->dev = fido_dev_new_with_info(pd->di)) == NULL)
+			errx(1, "fido_dev_new_with_info");
+		pd->open_r = fido_dev_open_with_info(pd->dev);
+	} else {
+		if ((pd->dev = fido_dev_new()) == NULL)
+			errx(1, "fido_dev_new");
+		pd->open_r = fido_dev_open(pd->dev, pd->path);
+	}
+	if (pd->open_r != FIDO_OK)
+		return;
+
+	pd->has_pin = fido_dev_has_pin(pd->dev);
+	pd->open_r = fido_dev_set_token_cache(pd->dev, true);
+}
+
+static void
+provision_one(void *arg, size_t i)
+{
+	struct prov *pv = arg;
+	struct prov_dev *pd = &pv->pd[i];
+
+	if (pd->open_r != FIDO_OK)
+		return;
+
+	for (pd->done = 0; pd->done < pv->script->n; ) {
+		pd->r = run_step(pd, &pv->script->step[pd->done++], pv->pin);
+		if (pd->r != FIDO_OK)
+			break;
+	}
+}
+
+/* the PIN set by set-pin, or the devices' current PIN */
+static char *
+read_pin(const struct script *sc, const char *what)
+{
+	char prompt[1024];
+	char *pin1, *pin2;
+	int r;
+
+	if (!sc->set_pin) {
+		if ((pin1 = get_pin(what)) == NULL)
+			exit(1);
+		return (pin1);
+	}
+
+	if ((pin1 = calloc(1, PINBUF_LEN)) == NULL ||
+	    (pin2 = calloc(1, PINBUF_LEN)) == NULL)
+		err(1, "calloc");
+	if ((r = snprintf(prompt, sizeof(prompt), "Enter new PIN for %s: ",
+	    what)) < 0 || (size_t)r >= sizeof(prompt))
+		errx(1, "snprintf");
+	if (!readpassphrase(prompt, pin1, PINBUF_LEN, RPP_ECHO_OFF) ||
+	    !readpassphrase("Enter the same PIN again: ", pin2, PINBUF_LEN,
+	    RPP_ECHO_OFF))
+		errx(1, "readpassphrase");
+	if (strcmp(pin1, pin2) != 0)
+		errx(1, "PINs do not match");
+	if (strlen(pin1) < 4 || strlen(pin1) > 63)
+		errx(1, "invalid PIN length");
+	freezero(pin2, PINBUF_LEN);
+
+	return (pin1);
+}
+
+int
+token_provision(int argc, char **argv)
+{
+	fido_dev_info_t *devlist = NULL;
+	struct script sc;
+	struct prov pv;
+	struct pool *pool;
+	char *pin = NULL;
+	size_t ndevs = 0;
+	bool need_pin = false;
+	int all = 0;
+	int ch, r, failed = 0;
+
+	optind = 1;
+
+	while ((ch = getopt(argc, argv, TOKEN_OPT)) != -1) {
+		switch (ch) {
+		case 'a':
+			all = 1;
+			break;
+		default:
+			break; /* ignore */
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1 || (all && argc > 1) || (!all && argc < 2))
+		usage();
+
+	read_script(argv[0], &sc);
+
+	memset(&pv, 0, sizeof(pv));
+	pv.script = &sc;
+	if (all) {
+		if ((devlist = fido_dev_info_new(64)) == NULL)
+			errx(1, "fido_dev_info_new");
+		if ((r = fido_dev_info_manifest(devlist, 64,
+		    &ndevs)) != FIDO_OK)
+			errx(1, "fido_dev_info_manifest: %s (0x%x)",
+			    fido_strerr(r), r);
+		if (ndevs == 0)
+			errx(1, "no devices found");
+	} else
+		ndevs = (size_t)argc - 1;
+	if ((pv.pd = calloc(ndevs, sizeof(*pv.pd))) == NULL)
+		err(1, "calloc");
+	for (size_t i = 0; i < ndevs; i++) {
+		if (all) {
+			pv.pd[i].di = fido_dev_info_ptr(devlist, i);
+			pv.pd[i].path = fido_dev_info_path(pv.pd[i].di);
+		} else
+			pv.pd[i].path = argv[i + 1];
+	}
+
+	pool = pool_new(ndevs);
+	pool_run(pool, ndevs, open_one, &pv);
+
+	for (size_t i = 0; i < ndevs; i++)
+		if (pv.pd[i].open_r == FIDO_OK &&
+		    (sc.set_pin || pv.pd[i].has_pin))
+			need_pin = true;
+	if (need_pin)
+		pv.pin = pin = read_pin(&sc, ndevs == 1 ? pv.pd[0].path :
+		    "the devices");
+
+	pool_run(pool, ndevs, provision_one, &pv);
+	pool_free(&pool);
+
+	for (size_t i = 0; i < ndevs; i++) {
+		struct prov_dev *pd = &pv.pd[i];
+
+		if (pd->open_r != FIDO_OK) {
+			printf("%s: open: %s\n", pd->path,
+			    fido_strerr(pd->open_r));
+			failed = 1;
+		}
+		for (size_t j = 0; pd->open_r == FIDO_OK && j < sc.n; j++) {
+			const char *status = "ok";
+
+			if (j >= pd->done)
+				status = "skipped";
+			else if (j == pd->done - 1 && pd->r != FIDO_OK) {
+				status = fido_strerr(pd->r);
+				failed = 1;
+			}
+			printf("%s: %s: %s\n", pd->path, sc.step[j].text,
+			    status);
+		}
+		fido_dev_close(pd->dev);
+		fido_dev_free(&pd->dev);
+	}
+
+	if (pin != NULL)
+		freezero(pin, PINBUF_LEN);
+	free(pv.pd);
+	free_script(&sc);
+	fido_dev_info_free(&devlist, ndevs);
+
+	exit(failed);
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2026 Yubico AB. All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * fido2-token -R: reset one or more devices. Authenticators only accept
+ * a reset shortly after power-up, so devices are reset concurrently and,
+ * with -w, as soon as they are attached.
+ */
+
+#include <fido.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "../openbsd-compat/openbsd-compat.h"
+#ifdef _MSC_VER
+#include "../openbsd-compat/posix_win.h"
+#endif
+
+#include "extern.h"
+
+#define RESET_MANIFEST_MAX	64
+#define RESET_WATCH_MS		1000	/* between checks of -n */
+#define RESET_RESCAN_MS		100	/* without hotplug events */
+
+struct reset_job {
+	char *path;
+	fido_dev_t *dev;	/* from the device list, if any */
+	int r;
+	bool done;
+#ifdef HAVE_PTHREAD
+	pthread_t t;
+	bool joined;
+#endif
+};
+
+struct reset_watch {
+	struct reset_job **job;
+	size_t n;
+	size_t cap;
+	size_t max;	/* -n; 0 for no limit */
+	bool armed;	/* devices present at start are left alone */
+	int failed;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t mtx;
+#endif
+};
+
+static void
+reset_one(struct reset_job *job)
+{
+	if (job->dev == NULL) {
+		if ((job->dev = fido_dev_new()) == NULL)
+			errx(1, "fido_dev_new");
+		job->r = fido_dev_open(job->dev, job->path);
+	} else
+		job->r = fido_dev_open_with_info(job->dev);
+	if (job->r != FIDO_OK)
+		return;
+
+	job->r = fido_dev_reset(job->dev);
+	fido_dev_close(job->dev);
+}
+
+static void
+reset_run(void *arg, size_t i)
+{
+	struct reset_job *job = arg;
+
+	reset_one(&job[i]);
+}
+
+static void
+pause_ms(int ms)
+{
+#ifdef _WIN32
+	Sleep((DWORD)ms);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+	(void)nanosleep(&ts, NULL);
+#endif
+}
+
+static void
+watch_report(struct reset_watch *rw, struct reset_job *job)
+{
+#ifdef HAVE_PTHREAD
+	if (pthread_mutex_lock(&rw->mtx) != 0)
+		errx(1, "pthread_mutex_lock");
+#endif
+	printf("%s: %s\n", job->path, job->r == FIDO_OK ? "ok" :
+	    fido_strerr(job->r));
+	fflush(stdout);
+	if (job->r != FIDO_OK)
+		rw->failed = 1;
+	job->done = true;
+#ifdef HAVE_PTHREAD
+	if (pthread_mutex_unlock(&rw->mtx) != 0)
+		errx(1, "pthread_mutex_unlock");
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+struct watch_arg {
+	struct reset_watch *rw;
+	struct reset_job *job;
+};
+
+static void *
+watch_worker(void *arg)
+{
+	struct watch_arg *wa = arg;
+
+	reset_one(wa->job);
+	watch_report(wa->rw, wa->job);
+	free(wa);
+
+	return (NULL);
+}
+#endif
+
+/* join the workers that are done, or all of them */
+static void
+watch_reap(struct reset_watch *rw, bool all)
+{
+#ifdef HAVE_PTHREAD
+	struct reset_job *job;
+	bool done;
+
+	for (size_t i = 0; i < rw->n; i++) {
+		job = rw->job[i];
+		if (pthread_mutex_lock(&rw->mtx) != 0)
+			errx(1, "pthread_mutex_lock");
+		done = job->done;
+		if (pthread_mutex_unlock(&rw->mtx) != 0)
+			errx(1, "pthread_mutex_unlock");
+		if (job->joined || (!done && !all))
+			continue;
+		if (pthread_join(job->t, NULL) != 0)
+			errx(1, "pthread_join");
+		job->joined = true;
+	}
+#else
+	(void)rw;
+	(void)all;
+#endif
+}
+
+static void
+watch_cb(void *arg, int event, const fido_dev_info_t *di)
+{
+	struct reset_watch *rw = arg;
+	struct reset_job *job, **p;
+#ifdef HAVE_PTHREAD
+	struct watch_arg *wa;
+#endif
+
+	if (event != FIDO_DEV_MONITOR_ADD || !rw->armed ||
+	    (rw->max != 0 && rw->n >= rw->max))
+		return;
+
+	if (rw->n == rw->cap) {
+		if ((p = recallocarray(rw->job, rw->cap, rw->cap + 16,
+		    sizeof(*p))) == NULL)
+			err(1, "recallocarray");
+		rw->job = p;
+		rw->cap += 16;
+	}
+	if ((job = calloc(1, sizeof(*job))) == NULL ||
+	    (job->path = strdup(fido_dev_info_path(di))) == NULL)
+		err(1, "calloc");
+	if ((job->dev = fido_dev_new_with_info(di)) == NULL)
+		errx(1, "fido_dev_new_with_info");
+	rw->job[rw->n++] = job;
+
+#ifdef HAVE_PTHREAD
+	if ((wa = calloc(1, sizeof(*wa))) == NULL)
+		err(1, "calloc");
+	wa->rw = rw;
+	wa->job = job;
+	if (pthread_create(&job->t, NULL, watch_worker, wa) != 0)
+		errx(1, "pthread_create");
+#else
+	reset_one(job);
+	watch_report(rw, job);
+#endif
+}
+
+static int
+reset_watch(size_t max)
+{
+	fido_dev_monitor_t *m;
+	struct reset_watch rw;
+	int r;
+
+	memset(&rw, 0, sizeof(rw));
+	rw.max = max;
+#ifdef HAVE_PTHREAD
+	if (pthread_mutex_init(&rw.mtx, NULL) != 0)
+		errx(1, "pthread_mutex_init");
+#endif
+
+	if ((m = fido_dev_monitor_new()) == NULL)
+		errx(1, "fido_dev_monitor_new");
+	if ((r = fido_dev_monitor_set_cb(m, watch_cb, &rw)) != FIDO_OK ||
+	    (r = fido_dev_monitor_start(m)) != FIDO_OK)
+		errx(1, "fido_dev_monitor_start: %s", fido_strerr(r));
+	rw.armed = true;
+
+	fprintf(stderr, "Waiting for devices; touch each one when it "
+	    "blinks.\n");
+
+	while (rw.max == 0 || rw.n < rw.max) {
+		if ((r = fido_dev_monitor_poll(m, RESET_WATCH_MS)) != FIDO_OK)
+			errx(1, "fido_dev_monitor_poll: %s", fido_strerr(r));
+		if (fido_dev_monitor_fd(m) == -1)
+			pause_ms(RESET_RESCAN_MS);
+		watch_reap(&rw, false);
+	}
+
+	watch_reap(&rw, true);
+	fido_dev_monitor_free(&m);
+
+	for (size_t i = 0; i < rw.n; i++) {
+		fido_dev_free(&rw.job[i]->dev);
+		free(rw.job[i]->path);
+		free(rw.job[i]);
+	}
+	free(rw.job);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&rw.mtx);
+#endif
+
+	exit(rw.failed);
+}
+
+int
+token_reset(int argc, char **argv)
+{
+	fido_dev_info_t *devlist = NULL;
+	struct reset_job *job;
+	struct pool *pool;
+	const char *count = NULL;
+	size_t ndevs = 0;
+	int all = 0, watch = 0;
+	int ch, n, r, failed = 0;
+
+	optind = 1;
+
+	while ((ch = getopt(argc, argv, TOKEN_OPT)) != -1) {
+		switch (ch) {
+		case 'a':
+			all = 1;
+			break;
+		case 'n':
+			count = optarg;
+			break;
+		case 'w':
+			watch = 1;
+			break;
+		default:
+			break; /* ignore */
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (watch) {
+		if (all || argc > 0)
+			usage();
+		n = 0;
+		if (count != NULL && (n = base10(count)) < 1)
+			errx(1, "-n: invalid count %s", count);
+		return (reset_watch((size_t)n));
+	}
+
+	if (count != NULL || (all && argc > 0) || (!all && argc < 1))
+		usage();
+
+	if (all) {
+		if ((devlist = fido_dev_info_new(RESET_MANIFEST_MAX)) == NULL)
+			errx(1, "fido_dev_info_new");
+		if ((r = fido_dev_info_manifest(devlist, RESET_MANIFEST_MAX,
+		    &ndevs)) != FIDO_OK)
+			errx(1, "fido_dev_info_manifest: %s (0x%x)",
+			    fido_strerr(r), r);
+		if (ndevs == 0)
+			errx(1, "no devices found");
+	} else
+		ndevs = (size_t)argc;
+
+	if ((job = calloc(ndevs, sizeof(*job))) == NULL)
+		err(1, "calloc");
+	for (size_t i = 0; i < ndevs; i++) {
+		if (all) {
+			const fido_dev_info_t *di = fido_dev_info_ptr(devlist,
+			    i);
+
+			job[i].path = strdup(fido_dev_info_path(di));
+			if ((job[i].dev = fido_dev_new_with_info(di)) == NULL)
+				errx(1, "fido_dev_new_with_info");
+		} else
+			job[i].path = strdup(argv[i]);
+		if (job[i].path == NULL)
+			err(1, "strdup");
+	}
+
+	pool = pool_new(ndevs);
+	pool_run(pool, ndevs, reset_run, job);
+	pool_free(&pool);
+
+	for (size_t i = 0; i < ndevs; i++) {
+		if (job[i].r != FIDO_OK)
+			failed = 1;
+		if (ndevs == 1 && job[i].r != FIDO_OK)
+			errx(1, "%s: %s", job[i].path, fido_strerr(job[i].r));
+		if (ndevs > 1)
+			printf("%s: %s\n", job[i].path, job[i].r == FIDO_OK ?
+			    "ok" : fido_strerr(job[i].r));
+		fido_dev_free(&job[i].dev);
+		free(job[i].path);
+	}
+	free(job);
+	fido_dev_info_free(&devlist, RESET_MANIFEST_MAX);
+
+	exit(failed);
+}
@@ -302,56 +302,54 @@ print_byte_array(const char *label, const uint8_t *ba, size_t len)
 	printf("\n");
 }
 
-int
-token_info(int argc, char **argv, char *path)
-{
-	char			*cred_id = NULL;
-	char			*rp_id = NULL;
-	fido_cbor_info_t	*ci = NULL;
-	fido_dev_t		*dev = NULL;
-	int			 ch;
-	int			 credman = 0;
-	int			 r;
-	int			 retrycnt;
+/* what -I reports about a device, fetched ahead of printing */
+struct dev_info {
+	fido_dev_t *dev;
+	fido_cbor_info_t *ci; /* unless cached by dev */
+	fido_bio_info_t *bio; /* NULL if not a biometric device */
+	int open_r;
+	int ci_r;
+	int pin_r;
+	int pin_retries;
+	int uv_r;
+	int uv_retries;
+};
 
-	optind = 1;
+static void
+fetch_info(void *arg, size_t i)
+{
+	struct dev_info *di = (struct dev_info *)arg + i;
 
-	while ((ch = getopt(argc, argv, TOKEN_OPT)) != -1) {
-		switch (ch) {
-		case 'c':
-			credman = 1;
-			break;
-		case 'i':
-			cred_id = optarg;
-			break;
-		case 'k':
-			rp_id = optarg;
-			break;
-		default:
-			break; /* ignore */
-		}
+	if (di->open_r != FIDO_OK || fido_dev_is_fido2(di->dev) == false)
+		return;
+	if (fido_dev_cbor_info(di->dev) == NULL) {
+		if ((di->ci = fido_cbor_info_new()) == NULL)
+			errx(1, "fido_cbor_info_new");
+		if ((di->ci_r = fido_dev_get_cbor_info(di->dev,
+		    di->ci)) != FIDO_OK)
+			return;
 	}
 
-	if (path == NULL || (credman && (cred_id != NULL || rp_id != NULL)))
-		usage();
+	di->pin_r = fido_dev_get_retry_count(di->dev, &di->pin_retries);
+	di->uv_r = fido_dev_get_uv_retry_count(di->dev, &di->uv_retries);
 
-	dev = open_dev(path);
+	if ((di->bio = fido_bio_info_new()) == NULL)
+		errx(1, "fido_bio_info_new");
+	if (fido_bio_dev_get_info(di->dev, di->bio) != FIDO_OK)
+		fido_bio_info_free(&di->bio);
+}
 
-	if (credman)
-		return (credman_get_metadata(dev, path));
-	if (cred_id && rp_id)
-		return (credman_print_rk(dev, path, rp_id, cred_id));
-	if (cred_id || rp_id)
-		usage();
+static void
+print_info(const struct dev_info *di)
+{
+	const fido_cbor_info_t *ci;
 
-	print_attr(dev);
+	print_attr(di->dev);
 
-	if (fido_dev_is_fido2(dev) == false)
-		goto end;
-	if ((ci = fido_cbor_info_new()) == NULL)
-		errx(1, "fido_cbor_info_new");
-	if ((r = fido_dev_get_cbor_info(dev, ci)) != FIDO_OK)
-		errx(1, "fido_dev_get_cbor_info: %s (0x%x)", fido_strerr(r), r);
+	if (fido_dev_is_fido2(di->dev) == false)
+		return;
+	if ((ci = di->ci) == NULL)
+		ci = fido_dev_cbor_info(di->dev);
 
 	/* print supported protocol versions */
 	print_str_array("version", fido_cbor_info_versions_ptr(ci),
@@ -413,18 +411,18 @@ token_info(int argc, char **argv, char *path)
 	print_byte_array("pin protocols", fido_cbor_info_protocols_ptr(ci),
 	    fido_cbor_info_protocols_len(ci));
 
-	if (fido_dev_get_retry_count(dev, &retrycnt) != FIDO_OK)
+	if (di->pin_r != FIDO_OK)
 		printf("pin retries: undefined\n");
 	else
-		printf("pin retries: %d\n", retrycnt);
+		printf("pin retries: %d\n", di->pin_retries);
 
 	printf("pin change required: %s\n",
 	    fido_cbor_info_new_pin_required(ci) ? "true" : "false");
 
-	if (fido_dev_get_uv_retry_count(dev, &retrycnt) != FIDO_OK)
+	if (di->uv_r != FIDO_OK)
 		printf("uv retries: undefined\n");
 	else
-		printf("uv retries: %d\n", retrycnt);
+		printf("uv retries: %d\n", di->uv_retries);
 
 	/* print platform uv attempts */
 	print_uv_attempts(fido_cbor_info_uv_attempts(ci));
@@ -432,10 +430,255 @@ token_info(int argc, char **argv, char *path)
 	/* print supported uv mechanisms */
 	print_uv_modality(fido_cbor_info_uv_modality(ci));
 
-	bio_info(dev);
+	if (di->bio != NULL)
+		bio_info(di->bio);
+}
+
+static void
+free_info(struct dev_info *di)
+{
+	fido_cbor_info_free(&di->ci);
+	fido_bio_info_free(&di->bio);
+	fido_dev_close(di->dev);
+	fido_dev_free(&di->dev);
+}
+
+/*
+ * -I -a: enumerate once, open every device at once, and query them in
+ * parallel; the reports are then printed in enumeration order.
+ */
+static int
+token_info_all(void)
+{
+	fido_dev_info_t *devlist;
+	fido_dev_t **devs;
+	struct dev_info *di;
+	struct pool *pool;
+	size_t ndevs;
+	int *status;
+	int r, failed = 0;
+
+	if ((devlist = fido_dev_info_new(64)) == NULL)
+		errx(1, "fido_dev_info_new");
+	if ((r = fido_dev_info_manifest(devlist, 64, &ndevs)) != FIDO_OK)
+		errx(1, "fido_dev_info_manifest: %s (0x%x)", fido_strerr(r), r);
+	if (ndevs == 0)
+		goto out;
+
+	if ((devs = calloc(ndevs, sizeof(*devs))) == NULL ||
+	    (status = calloc(ndevs, sizeof(*status))) == NULL ||
+	    (di = calloc(ndevs, sizeof(*di))) == NULL)
+		errx(1, "calloc");
+	for (size_t i = 0; i < ndevs; i++) {
+		if ((devs[i] = fido_dev_new_with_info(fido_dev_info_ptr(devlist,
+		    i))) == NULL)
+			errx(1, "fido_dev_new_with_info");
+		status[i] = FIDO_ERR_INTERNAL;
+	}
+
+	(void)fido_dev_open_many(devs, ndevs, status);
+
+	for (size_t i = 0; i < ndevs; i++) {
+		di[i].dev = devs[i];
+		di[i].open_r = status[i];
+	}
+	pool = pool_new(ndevs);
+	pool_run(pool, ndevs, fetch_info, di);
+	pool_free(&pool);
+
+	for (size_t i = 0; i < ndevs; i++) {
+		printf("%sdevice: %s\n", i > 0 ? "\n" : "",
+		    fido_dev_info_path(fido_dev_info_ptr(devlist, i)));
+		if (di[i].open_r != FIDO_OK) {
+			warnx("fido_dev_open %s: %s",
+			    fido_dev_info_path(fido_dev_info_ptr(devlist, i)),
+			    fido_strerr(di[i].open_r));
+			failed = 1;
+		} else if (di[i].ci_r != FIDO_OK) {
+			warnx("fido_dev_get_cbor_info %s: %s (0x%x)",
+			    fido_dev_info_path(fido_dev_info_ptr(devlist, i)),
+			    fido_strerr(di[i].ci_r), di[i].ci_r);
+			failed = 1;
+		} else
+			print_info(&di[i]);
+		free_info(&di[i]);
+	}
+
+	free(devs);
+	free(status);
+	free(di);
+out:
+	fido_dev_info_free(&devlist, ndevs);
+
+	exit(failed);
+}
+
+int
+token_info(int argc, char **argv, char *path)
+{
+	char			*cred_id = NULL;
+	char			*rp_id = NULL;
+	struct dev_info		 di;
+	int			 all = 0;
+	int			 ch;
+	int			 credman = 0;
+
+	optind = 1;
+
+	while ((ch = getopt(argc, argv, TOKEN_OPT)) != -1) {
+		switch (ch) {
+		case 'a':
+			all = 1;
+			break;
+		case 'c':
+			credman = 1;
+			break;
+		case 'i':
+			cred_id = optarg;
+			break;
+		case 'k':
+			rp_id = optarg;
+			break;
+		default:
+			break; /* ignore */
+		}
+	}
+
+	if (all) {
+		if (path != NULL || credman || cred_id != NULL ||
+		    rp_id != NULL)
+			usage();
+		return (token_info_all());
+	}
+	if (path == NULL || (credman && (cred_id != NULL || rp_id != NULL)))
+		usage();
+
+	memset(&di, 0, sizeof(di));
+	di.dev = open_dev(path);
+
+	if (credman)
+		return (credman_get_metadata(di.dev, path));
+	if (cred_id && rp_id)
+		return (credman_print_rk(di.dev, path, rp_id, cred_id));
+	if (cred_id || rp_id)
+		usage();
+
+	fetch_info(&di, 0);
+	if (di.ci_r != FIDO_OK)
+		errx(1, "fido_dev_get_cbor_info: %s (0x%x)",
+		    fido_strerr(di.ci_r), di.ci_r);
+	print_info(&di);
+	free_info(&di);
+
+	exit(0);
+}
+
+static int
+cmp_usec(const void *a, const void *b)
+{
+	const long long x = *(const long long *)a;
+	const long long y = *(const long long *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/* the largest ping payload; FIDO_MAXMSG unless the device reports more */
+static size_t
+bench_maxlen(fido_dev_t *dev)
+{
+	fido_cbor_info_t	*ci;
+	uint64_t		 maxmsgsiz = 0;
 
+	if (!fido_dev_is_fido2(dev))
+		return (FIDO_MAXMSG);
+	if ((ci = fido_cbor_info_new()) == NULL)
+		errx(1, "fido_cbor_info_new");
+	if (fido_dev_get_cbor_info(dev, ci) == FIDO_OK)
+		maxmsgsiz = fido_cbor_info_maxmsgsiz(ci);
 	fido_cbor_info_free(&ci);
-end:
+
+	if (maxmsgsiz <= FIDO_MAXMSG)
+		return (FIDO_MAXMSG);
+	if (maxmsgsiz > UINT16_MAX)
+		return (UINT16_MAX);
+
+	return ((size_t)maxmsgsiz);
+}
+
+static void
+bench_len(fido_dev_t *dev, const unsigned char *buf, size_t len,
+    long long *usec, size_t count)
+{
+	struct timespec	t0, t1;
+	long long	total = 0;
+	int		r;
+
+	for (size_t i = 0; i < count; i++) {
+		if (clock_gettime(CLOCK_MONOTONIC, &t0) != 0)
+			err(1, "clock_gettime");
+		if ((r = fido_dev_ping(dev, buf, len)) != FIDO_OK)
+			errx(1, "fido_dev_ping: %s (0x%x)", fido_strerr(r), r);
+		if (clock_gettime(CLOCK_MONOTONIC, &t1) != 0)
+			err(1, "clock_gettime");
+		timespecsub(&t1, &t0, &t1);
+		usec[i] = (long long)t1.tv_sec * 1000000 + t1.tv_nsec / 1000;
+		total += usec[i];
+	}
+
+	qsort(usec, count, sizeof(*usec), cmp_usec);
+
+	printf("%6zu %8lld %8lld %8lld %8lld %8lld %10.1f\n", len, usec[0],
+	    usec[count / 2], usec[count * 9 / 10], usec[count * 99 / 100],
+	    usec[count - 1], total > 0 ? (double)len * 2 * (double)count *
+	    1000000 / 1024 / (double)total : 0.0);
+}
+
+/*
+ * Time 'count' CTAPHID_PING round trips per payload size, doubling the
+ * size from one byte up to the largest message the device takes.
+ */
+int
+token_bench(int argc, char **argv, char *path)
+{
+	fido_dev_t	*dev;
+	unsigned char	*buf;
+	long long	*usec;
+	size_t		 max;
+	int		 ch, count = 100;
+
+	optind = 1;
+
+	while ((ch = getopt(argc, argv, TOKEN_OPT)) != -1) {
+		switch (ch) {
+		case 'n':
+			if ((count = base10(optarg)) < 1)
+				errx(1, "-n: invalid count %s", optarg);
+			break;
+		default:
+			break; /* ignore */
+		}
+	}
+
+	if (path == NULL)
+		usage();
+
+	dev = open_dev(path);
+	max = bench_maxlen(dev);
+
+	if ((buf = malloc(max)) == NULL ||
+	    (usec = calloc((size_t)count, sizeof(*usec))) == NULL)
+		errx(1, "malloc");
+	for (size_t i = 0; i < max; i++)
+		buf[i] = (unsigned char)i;
+
+	printf("%6s %8s %8s %8s %8s %8s %10s\n", "bytes", "min", "p50",
+	    "p90", "p99", "max", "KiB/s");
+	for (size_t len = 1; len < max; len *= 2)
+		bench_len(dev, buf, len, usec, (size_t)count);
+	bench_len(dev, buf, max, usec, (size_t)count);
+
+	free(usec);
+	free(buf);
 	fido_dev_close(dev);
 	fido_dev_free(&dev);
 
@@ -443,22 +686,31 @@ end:
 }
 
 int
-token_reset(char *path)
+token_serve(int argc, char **argv, char *path)
 {
-	fido_dev_t *dev = NULL;
-	int r;
+	fido_dev_t	*dev;
+	fido_remote_t	*remote;
+	int		 r;
 
-	if (path == NULL)
+	argc -= optind;
+	argv += optind;
+
+	if (path == NULL || argc != 2)
 		usage();
 
 	dev = open_dev(path);
-	if ((r = fido_dev_reset(dev)) != FIDO_OK)
-		errx(1, "fido_dev_reset: %s", fido_strerr(r));
-
+	if ((remote = fido_remote_new()) == NULL)
+		errx(1, "fido_remote_new");
+	if ((r = fido_remote_open(remote, dev, argv[0])) != FIDO_OK)
+		errx(1, "fido_remote_open %s: %s", argv[0], fido_strerr(r));
+	while ((r = fido_remote_work(remote, -1)) == FIDO_OK)
+		continue;
+
+	fido_remote_free(&remote);
 	fido_dev_close(dev);
 	fido_dev_free(&dev);
 
-	exit(0);
+	errx(1, "fido_remote_work: %s", fido_strerr(r));
 }
 
 int
@@ -616,6 +868,7 @@ token_list(int argc, char **argv, char *path)
 	fido_dev_info_t *devlist;
 	size_t ndevs;
 	const char *rp_id = NULL;
+	const char *cache = NULL;
 	int blobs = 0;
 	int enrolls = 0;
 	int keys = 0;
@@ -637,6 +890,9 @@ token_list(int argc, char **argv, char *path)
 			keys = 1;
 			rp_id = optarg;
 			break;
+		case 'o':
+			cache = optarg;
+			break;
 		case 'r':
 			rplist = 1;
 			break;
@@ -645,9 +901,14 @@ token_list(int argc, char **argv, char *path)
 		}
 	}
 
+	if (cache != NULL && (blobs || enrolls || !(keys || rplist)))
+		usage();
+
 	if (blobs || enrolls || keys || rplist) {
 		if (path == NULL)
 			usage();
+		if (cache != NULL)
+			return (credman_list_cached(path, rp_id, cache));
 		if (blobs)
 			return (blob_list(path));
 		if (enrolls)
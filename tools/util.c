@@ -6,6 +6,9 @@
  */
 
 #include <sys/types.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <sys/stat.h>
 
 #include <openssl/ec.h>
@@ -176,11 +179,9 @@ open_dev(const char *path)
 }
 
 int
-get_devopt(fido_dev_t *dev, const char *name, int *val)
+get_devopt(fido_dev_t *dev, uint64_t opt, int *val)
 {
 	fido_cbor_info_t *cbor_info;
-	char * const *names;
-	const bool *values;
 	int r, ok = -1;
 
 	if ((cbor_info = fido_cbor_info_new()) == NULL) {
@@ -193,18 +194,10 @@ get_devopt(fido_dev_t *dev, const char *name, int *val)
 		goto out;
 	}
 
-	if ((names = fido_cbor_info_options_name_ptr(cbor_info)) == NULL ||
-	    (values = fido_cbor_info_options_value_ptr(cbor_info)) == NULL) {
-		warnx("fido_dev_get_cbor_info: NULL name/value pointer");
-		goto out;
-	}
-
-	*val = -1;
-	for (size_t i = 0; i < fido_cbor_info_options_len(cbor_info); i++)
-		if (strcmp(names[i], name) == 0) {
-			*val = values[i];
-			break;
-		}
+	if ((fido_cbor_info_options_present(cbor_info) & opt) == 0)
+		*val = -1;
+	else
+		*val = (fido_cbor_info_options_enabled(cbor_info) & opt) != 0;
 
 	ok = 0;
 out:
@@ -540,15 +533,77 @@ prot_string(int prot)
 	}
 }
 
+#ifdef HAVE_MMAP
+/*
+ * Map the regular file at 'path' read-only into 'out', sparing a copy of
+ * large payloads such as largeBlobs; released with unmap_file().
+ */
+int
+map_file(const char *path, struct blob *out)
+{
+	int fd, ok = -1;
+	struct stat st;
+	void *p;
+
+	out->ptr = NULL;
+	out->len = 0;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		warn("%s: open %s", __func__, path);
+		goto fail;
+	}
+	if (fstat(fd, &st) < 0) {
+		warn("%s: stat %s", __func__, path);
+		goto fail;
+	}
+	if (!S_ISREG(st.st_mode)) {
+		warnx("%s: %s: not a regular file", __func__, path);
+		goto fail;
+	}
+	if (st.st_size < 0 || (uintmax_t)st.st_size > SIZE_MAX) {
+		warnx("%s: stat %s: invalid size", __func__, path);
+		goto fail;
+	}
+	if (st.st_size == 0) {
+		ok = 0; /* nothing to map */
+		goto fail;
+	}
+	if ((p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd,
+	    0)) == MAP_FAILED) {
+		warn("%s: mmap %s", __func__, path);
+		goto fail;
+	}
+
+	out->ptr = p;
+	out->len = (size_t)st.st_size;
+	ok = 0;
+fail:
+	if (fd != -1) {
+		close(fd);
+	}
+
+	return ok;
+}
+
+void
+unmap_file(struct blob *b)
+{
+	if (b->ptr != NULL)
+		munmap(b->ptr, b->len);
+
+	b->ptr = NULL;
+	b->len = 0;
+}
+#else
 int
-read_file(const char *path, u_char **ptr, size_t *len)
+map_file(const char *path, struct blob *out)
 {
 	int fd, ok = -1;
 	struct stat st;
 	ssize_t n;
 
-	*ptr = NULL;
-	*len = 0;
+	out->ptr = NULL;
+	out->len = 0;
 
 	if ((fd = open(path, O_RDONLY)) < 0) {
 		warn("%s: open %s", __func__, path);
@@ -562,16 +617,16 @@ read_file(const char *path, u_char **ptr, size_t *len)
 		warnx("%s: stat %s: invalid size", __func__, path);
 		goto fail;
 	}
-	*len = (size_t)st.st_size;
-	if ((*ptr = malloc(*len)) == NULL) {
+	out->len = (size_t)st.st_size;
+	if ((out->ptr = malloc(out->len)) == NULL) {
 		warn("%s: malloc", __func__);
 		goto fail;
 	}
-	if ((n = read(fd, *ptr, *len)) < 0) {
+	if ((n = read(fd, out->ptr, out->len)) < 0) {
 		warn("%s: read", __func__);
 		goto fail;
 	}
-	if ((size_t)n != *len) {
+	if ((size_t)n != out->len) {
 		warnx("%s: read", __func__);
 		goto fail;
 	}
@@ -582,14 +637,24 @@ fail:
 		close(fd);
 	}
 	if (ok < 0) {
-		free(*ptr);
-		*ptr = NULL;
-		*len = 0;
+		free(out->ptr);
+		out->ptr = NULL;
+		out->len = 0;
 	}
 
 	return ok;
 }
 
+void
+unmap_file(struct blob *b)
+{
+	freezero(b->ptr, b->len);
+
+	b->ptr = NULL;
+	b->len = 0;
+}
+#endif /* HAVE_MMAP */
+
 int
 write_file(const char *path, const u_char *ptr, size_t len)
 {